@@ -0,0 +1,70 @@
+#ifndef CERES_ERROR_TERMS_BATCHED_VISUAL_ERROR_TERM_H_
+#define CERES_ERROR_TERMS_BATCHED_VISUAL_ERROR_TERM_H_
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <ceres/ceres.h>
+#include <glog/logging.h>
+
+#include "ceres-error-terms/common.h"
+
+namespace ceres_error_terms {
+
+// Combines the visual cost functions of several observations, e.g. all
+// observations of one landmark, into a single residual block. Ceres then
+// handles one residual block per landmark instead of one per keypoint, which
+// removes the per-residual-block overhead of the evaluation, the Jacobian
+// bookkeeping and the Schur elimination for large problems.
+//
+// The parameter blocks shared by the observations are only added once, see
+// parameter_blocks() for the blocks to pass to the problem. The loss function
+// of every observation is applied inside the batch, such that the cost and
+// its gradient equal the sum of the individual residual blocks with their
+// loss functions. Hence the batch has to be added without a loss function.
+class BatchedVisualReprojectionError : public ceres::CostFunction {
+ public:
+  BatchedVisualReprojectionError();
+  virtual ~BatchedVisualReprojectionError() {}
+
+  // The cost function must have visual::kResidualSize residuals. Only the
+  // first parameter blocks matching the parameter block sizes of the cost
+  // function are used. The loss function is optional.
+  void addObservation(
+      const std::shared_ptr<ceres::CostFunction>& cost_function,
+      const std::shared_ptr<ceres::LossFunction>& loss_function,
+      const std::vector<double*>& parameter_blocks);
+
+  const std::vector<double*>& parameter_blocks() const {
+    return parameter_blocks_;
+  }
+
+  size_t numObservations() const {
+    return observations_.size();
+  }
+
+  virtual bool Evaluate(
+      double const* const* parameters, double* residuals,
+      double** jacobians) const;
+
+ private:
+  struct Observation {
+    std::shared_ptr<ceres::CostFunction> cost_function;
+    std::shared_ptr<ceres::LossFunction> loss_function;
+    // Index into parameter_blocks_ of every parameter block of the cost
+    // function.
+    std::vector<int> parameter_block_indices;
+  };
+
+  std::vector<Observation> observations_;
+  std::vector<double*> parameter_blocks_;
+  std::unordered_map<double*, int> parameter_block_to_index_;
+  // Size of the Jacobian of the observation with the most parameters.
+  int max_observation_jacobian_size_;
+  int max_observation_num_parameter_blocks_;
+};
+
+}  // namespace ceres_error_terms
+
+#endif  // CERES_ERROR_TERMS_BATCHED_VISUAL_ERROR_TERM_H_
@@ -0,0 +1,76 @@
+#ifndef CERES_ERROR_TERMS_PREINTEGRATED_INERTIAL_ERROR_TERM_INL_H_
+#define CERES_ERROR_TERMS_PREINTEGRATED_INERTIAL_ERROR_TERM_INL_H_
+
+namespace ceres_error_terms {
+
+template <typename T>
+bool PreintegratedInertialErrorTerm::operator()(
+    const T* const pose_from, const T* const gyro_bias_from,
+    const T* const velocity_from, const T* const accel_bias_from,
+    const T* const pose_to, const T* const gyro_bias_to,
+    const T* const velocity_to, const T* const accel_bias_to,
+    T* residuals) const {
+  typedef Eigen::Matrix<T, 3, 1> Vector3T;
+  typedef Eigen::Quaternion<T> QuaternionT;
+
+  const Eigen::Map<const QuaternionT> q_G_B_from(pose_from);
+  const Eigen::Map<const QuaternionT> q_G_B_to(pose_to);
+  const Eigen::Map<const Vector3T> p_G_B_from(
+      pose_from + imu_integrator::kStateOrientationBlockSize);
+  const Eigen::Map<const Vector3T> p_G_B_to(
+      pose_to + imu_integrator::kStateOrientationBlockSize);
+  const Eigen::Map<const Vector3T> b_g_from(gyro_bias_from);
+  const Eigen::Map<const Vector3T> b_g_to(gyro_bias_to);
+  const Eigen::Map<const Vector3T> v_G_from(velocity_from);
+  const Eigen::Map<const Vector3T> v_G_to(velocity_to);
+  const Eigen::Map<const Vector3T> b_a_from(accel_bias_from);
+  const Eigen::Map<const Vector3T> b_a_to(accel_bias_to);
+
+  // First-order correction of the preintegrated motion for the change of the
+  // biases since the preintegration.
+  const Vector3T delta_b_g = b_g_from - linearization_gyro_bias_.cast<T>();
+  const Vector3T delta_b_a = b_a_from - linearization_accel_bias_.cast<T>();
+  const Vector3T half_delta_theta =
+      T(0.5) * d_theta_d_gyro_bias_.cast<T>() * delta_b_g;
+  QuaternionT q_correction(
+      T(1.0), half_delta_theta(0), half_delta_theta(1), half_delta_theta(2));
+  q_correction.normalize();
+  const QuaternionT delta_q = delta_q_.cast<T>() * q_correction;
+  const Vector3T delta_v = delta_v_.cast<T>() +
+                           d_v_d_gyro_bias_.cast<T>() * delta_b_g +
+                           d_v_d_accel_bias_.cast<T>() * delta_b_a;
+  const Vector3T delta_p = delta_p_.cast<T>() +
+                           d_p_d_gyro_bias_.cast<T>() * delta_b_g +
+                           d_p_d_accel_bias_.cast<T>() * delta_b_a;
+
+  const T delta_time(delta_time_seconds_);
+  const Vector3T g_G(T(0.0), T(0.0), T(gravity_magnitude_));
+  const Eigen::Matrix<T, 3, 3> R_B_G_from =
+      q_G_B_from.toRotationMatrix().transpose();
+
+  QuaternionT q_error =
+      delta_q.conjugate() * q_G_B_from.conjugate() * q_G_B_to;
+  if (q_error.w() < T(0.0)) {
+    q_error.coeffs() = -q_error.coeffs();
+  }
+
+  Eigen::Map<Eigen::Matrix<T, kResidualBlockSize, 1>> error(residuals);
+  error.template segment<3>(imu_integrator::kErrorStateOrientationOffset) =
+      T(2.0) * q_error.vec();
+  error.template segment<3>(imu_integrator::kErrorStateGyroBiasOffset) =
+      b_g_to - b_g_from;
+  error.template segment<3>(imu_integrator::kErrorStateVelocityOffset) =
+      R_B_G_from * (v_G_to - v_G_from + g_G * delta_time) - delta_v;
+  error.template segment<3>(imu_integrator::kErrorStateAccelBiasOffset) =
+      b_a_to - b_a_from;
+  error.template segment<3>(imu_integrator::kErrorStatePositionOffset) =
+      R_B_G_from * (p_G_B_to - p_G_B_from - v_G_from * delta_time +
+                    T(0.5) * g_G * delta_time * delta_time) -
+      delta_p;
+  error = sqrt_information_.cast<T>() * error;
+  return true;
+}
+
+}  // namespace ceres_error_terms
+
+#endif  // CERES_ERROR_TERMS_PREINTEGRATED_INERTIAL_ERROR_TERM_INL_H_
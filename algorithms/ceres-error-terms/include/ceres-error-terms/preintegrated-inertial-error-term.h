@@ -0,0 +1,88 @@
+#ifndef CERES_ERROR_TERMS_PREINTEGRATED_INERTIAL_ERROR_TERM_H_
+#define CERES_ERROR_TERMS_PREINTEGRATED_INERTIAL_ERROR_TERM_H_
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <ceres/ceres.h>
+#include <glog/logging.h>
+#include <imu-integrator/common.h>
+
+namespace ceres_error_terms {
+
+// Drop-in replacement for InertialErrorTerm with the same parameter blocks
+// and residual layout [theta, b_g, v_M, b_a, p_M_I]. Instead of integrating
+// the IMU measurements on every change of the begin state, they are
+// integrated once on construction into the motion relative to the begin
+// frame, using the biases given as linearization point. Changes of the biases
+// are applied with the first-order bias Jacobians of the preintegrated motion,
+// hence every evaluation is independent of the number of IMU measurements.
+// The residuals are whitened with the covariance of the preintegrated motion
+// at the linearization point.
+//
+// The rotations are quaternions in JPL convention [x, y, z, w], i.e. the
+// coefficients of B_q_G (JPL), which equal the coefficients of G_q_B
+// (Hamilton).
+class PreintegratedInertialErrorTerm {
+ public:
+  PreintegratedInertialErrorTerm(
+      const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_data,
+      const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps,
+      double gyro_noise_sigma, double gyro_bias_sigma, double acc_noise_sigma,
+      double acc_bias_sigma, double gravity_magnitude,
+      const Eigen::Vector3d& linearization_gyro_bias,
+      const Eigen::Vector3d& linearization_accel_bias);
+
+  // Caller takes ownership.
+  static ceres::CostFunction* Create(
+      const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_data,
+      const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps,
+      double gyro_noise_sigma, double gyro_bias_sigma, double acc_noise_sigma,
+      double acc_bias_sigma, double gravity_magnitude,
+      const Eigen::Vector3d& linearization_gyro_bias,
+      const Eigen::Vector3d& linearization_accel_bias);
+
+  template <typename T>
+  bool operator()(
+      const T* const pose_from, const T* const gyro_bias_from,
+      const T* const velocity_from, const T* const accel_bias_from,
+      const T* const pose_to, const T* const gyro_bias_to,
+      const T* const velocity_to, const T* const accel_bias_to,
+      T* residuals) const;
+
+  static constexpr int kResidualBlockSize = imu_integrator::kErrorStateSize;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ private:
+  void preintegrate(
+      const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_data,
+      const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps,
+      double gyro_noise_sigma, double gyro_bias_sigma, double acc_noise_sigma,
+      double acc_bias_sigma);
+
+  const double gravity_magnitude_;
+  const Eigen::Vector3d linearization_gyro_bias_;
+  const Eigen::Vector3d linearization_accel_bias_;
+
+  // Motion of the end frame relative to the begin frame without gravity.
+  double delta_time_seconds_;
+  Eigen::Quaterniond delta_q_;
+  Eigen::Vector3d delta_v_;
+  Eigen::Vector3d delta_p_;
+
+  // Jacobians of the preintegrated motion w.r.t. the biases.
+  Eigen::Matrix3d d_theta_d_gyro_bias_;
+  Eigen::Matrix3d d_v_d_gyro_bias_;
+  Eigen::Matrix3d d_v_d_accel_bias_;
+  Eigen::Matrix3d d_p_d_gyro_bias_;
+  Eigen::Matrix3d d_p_d_accel_bias_;
+
+  Eigen::Matrix<double, kResidualBlockSize, kResidualBlockSize>
+      sqrt_information_;
+};
+
+}  // namespace ceres_error_terms
+
+#include "./ceres-error-terms/preintegrated-inertial-error-term-inl.h"
+
+#endif  // CERES_ERROR_TERMS_PREINTEGRATED_INERTIAL_ERROR_TERM_H_
@@ -0,0 +1,169 @@
+#include "ceres-error-terms/batched-visual-error-term.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <Eigen/Core>
+
+namespace ceres_error_terms {
+
+BatchedVisualReprojectionError::BatchedVisualReprojectionError()
+    : max_observation_jacobian_size_(0),
+      max_observation_num_parameter_blocks_(0) {
+  set_num_residuals(0);
+}
+
+void BatchedVisualReprojectionError::addObservation(
+    const std::shared_ptr<ceres::CostFunction>& cost_function,
+    const std::shared_ptr<ceres::LossFunction>& loss_function,
+    const std::vector<double*>& parameter_blocks) {
+  CHECK(cost_function);
+  CHECK_EQ(cost_function->num_residuals(), visual::kResidualSize);
+
+  const std::vector<int32_t>& block_sizes =
+      cost_function->parameter_block_sizes();
+  const int num_parameter_blocks = static_cast<int>(block_sizes.size());
+  CHECK_GE(static_cast<int>(parameter_blocks.size()), num_parameter_blocks);
+
+  Observation observation;
+  observation.cost_function = cost_function;
+  observation.loss_function = loss_function;
+  observation.parameter_block_indices.reserve(num_parameter_blocks);
+  int observation_jacobian_size = 0;
+  for (int block_idx = 0; block_idx < num_parameter_blocks; ++block_idx) {
+    double* parameter_block = CHECK_NOTNULL(parameter_blocks[block_idx]);
+    const int block_size = block_sizes[block_idx];
+    const std::pair<std::unordered_map<double*, int>::iterator, bool>
+        it_inserted = parameter_block_to_index_.emplace(
+            parameter_block, static_cast<int>(parameter_blocks_.size()));
+    if (it_inserted.second) {
+      parameter_blocks_.push_back(parameter_block);
+      mutable_parameter_block_sizes()->push_back(block_size);
+    } else {
+      CHECK_EQ(parameter_block_sizes()[it_inserted.first->second], block_size)
+          << "Parameter block " << parameter_block << " is used with "
+          << "different sizes.";
+    }
+    observation.parameter_block_indices.push_back(it_inserted.first->second);
+    observation_jacobian_size += visual::kResidualSize * block_size;
+  }
+  max_observation_jacobian_size_ =
+      std::max(max_observation_jacobian_size_, observation_jacobian_size);
+  max_observation_num_parameter_blocks_ =
+      std::max(max_observation_num_parameter_blocks_, num_parameter_blocks);
+
+  observations_.emplace_back(observation);
+  set_num_residuals(num_residuals() + visual::kResidualSize);
+}
+
+bool BatchedVisualReprojectionError::Evaluate(
+    double const* const* parameters, double* residuals,
+    double** jacobians) const {
+  CHECK_NOTNULL(parameters);
+  CHECK_NOTNULL(residuals);
+
+  typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic,
+                        Eigen::RowMajor>
+      RowMajorMatrix;
+  typedef Eigen::Matrix<double, visual::kResidualSize, Eigen::Dynamic,
+                        Eigen::RowMajor>
+      ObservationJacobian;
+
+  const int num_parameter_blocks = static_cast<int>(parameter_blocks_.size());
+  if (jacobians != nullptr) {
+    for (int block_idx = 0; block_idx < num_parameter_blocks; ++block_idx) {
+      if (jacobians[block_idx] != nullptr) {
+        Eigen::Map<RowMajorMatrix>(
+            jacobians[block_idx], num_residuals(),
+            parameter_block_sizes()[block_idx])
+            .setZero();
+      }
+    }
+  }
+
+  // Scratch memory of the Jacobians of one observation, allocated once per
+  // evaluation as the evaluation may run concurrently.
+  std::vector<double> jacobian_scratch(max_observation_jacobian_size_);
+  std::vector<const double*> observation_parameters(
+      max_observation_num_parameter_blocks_);
+  std::vector<double*> observation_jacobians(
+      max_observation_num_parameter_blocks_);
+
+  for (size_t observation_idx = 0u; observation_idx < observations_.size();
+       ++observation_idx) {
+    const Observation& observation = observations_[observation_idx];
+    const std::vector<int>& block_indices =
+        observation.parameter_block_indices;
+    const int observation_num_blocks = static_cast<int>(block_indices.size());
+    const std::vector<int32_t>& observation_block_sizes =
+        observation.cost_function->parameter_block_sizes();
+
+    bool evaluate_jacobians = false;
+    int scratch_offset = 0;
+    for (int block_idx = 0; block_idx < observation_num_blocks; ++block_idx) {
+      const int batch_block_idx = block_indices[block_idx];
+      observation_parameters[block_idx] = parameters[batch_block_idx];
+      observation_jacobians[block_idx] = nullptr;
+      if (jacobians != nullptr && jacobians[batch_block_idx] != nullptr) {
+        observation_jacobians[block_idx] =
+            jacobian_scratch.data() + scratch_offset;
+        evaluate_jacobians = true;
+      }
+      scratch_offset +=
+          visual::kResidualSize * observation_block_sizes[block_idx];
+    }
+
+    const int residual_offset =
+        visual::kResidualSize * static_cast<int>(observation_idx);
+    Eigen::Map<Eigen::Matrix<double, visual::kResidualSize, 1>> residual(
+        residuals + residual_offset);
+    if (!observation.cost_function->Evaluate(
+            observation_parameters.data(), residual.data(),
+            evaluate_jacobians ? observation_jacobians.data() : nullptr)) {
+      return false;
+    }
+
+    // The residual is scaled with w(s) = sqrt(rho(s) / s), s = |r|^2, such
+    // that its squared norm is the robustified cost rho(s). Its Jacobian is
+    // w * J + 2 * dw/ds * r * r^T * J.
+    double weight = 1.0;
+    double d_weight_d_squared_norm = 0.0;
+    if (observation.loss_function) {
+      const double squared_norm = residual.squaredNorm();
+      double rho[3];
+      observation.loss_function->Evaluate(squared_norm, rho);
+      if (squared_norm > 0.0 && rho[0] > 0.0) {
+        weight = std::sqrt(rho[0] / squared_norm);
+        d_weight_d_squared_norm = (rho[1] * squared_norm - rho[0]) /
+                                  (2.0 * squared_norm * squared_norm * weight);
+      } else {
+        weight = std::sqrt(rho[1]);
+      }
+    }
+
+    if (evaluate_jacobians) {
+      for (int block_idx = 0; block_idx < observation_num_blocks;
+           ++block_idx) {
+        if (observation_jacobians[block_idx] == nullptr) {
+          continue;
+        }
+        const int batch_block_idx = block_indices[block_idx];
+        const int block_size = observation_block_sizes[block_idx];
+        const Eigen::Map<const ObservationJacobian> J(
+            observation_jacobians[block_idx], visual::kResidualSize,
+            block_size);
+        Eigen::Map<RowMajorMatrix> batch_J(
+            jacobians[batch_block_idx], num_residuals(), block_size);
+        batch_J.middleRows<visual::kResidualSize>(residual_offset) +=
+            weight * J +
+            (2.0 * d_weight_d_squared_norm) * residual *
+                (residual.transpose() * J);
+      }
+    }
+    residual *= weight;
+  }
+  return true;
+}
+
+}  // namespace ceres_error_terms
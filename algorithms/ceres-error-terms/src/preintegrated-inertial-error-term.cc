@@ -0,0 +1,196 @@
+#include "ceres-error-terms/preintegrated-inertial-error-term.h"
+
+#include <cmath>
+
+#include <maplab-common/geometry.h>
+
+namespace ceres_error_terms {
+
+namespace {
+constexpr double kSmallAngleRad = 1e-8;
+
+Eigen::Quaterniond exponentialMap(const Eigen::Vector3d& theta) {
+  const double angle = theta.norm();
+  if (angle < kSmallAngleRad) {
+    Eigen::Quaterniond q(
+        1.0, 0.5 * theta.x(), 0.5 * theta.y(), 0.5 * theta.z());
+    q.normalize();
+    return q;
+  }
+  return Eigen::Quaterniond(Eigen::AngleAxisd(angle, theta / angle));
+}
+
+// Right Jacobian of SO(3).
+Eigen::Matrix3d rightJacobian(const Eigen::Vector3d& theta) {
+  const double angle = theta.norm();
+  const Eigen::Matrix3d theta_skew = common::skew(theta);
+  if (angle < kSmallAngleRad) {
+    return Eigen::Matrix3d::Identity() - 0.5 * theta_skew;
+  }
+  const double angle_squared = angle * angle;
+  return Eigen::Matrix3d::Identity() -
+         (1.0 - std::cos(angle)) / angle_squared * theta_skew +
+         (angle - std::sin(angle)) / (angle_squared * angle) * theta_skew *
+             theta_skew;
+}
+}  // namespace
+
+PreintegratedInertialErrorTerm::PreintegratedInertialErrorTerm(
+    const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_data,
+    const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps,
+    double gyro_noise_sigma, double gyro_bias_sigma, double acc_noise_sigma,
+    double acc_bias_sigma, double gravity_magnitude,
+    const Eigen::Vector3d& linearization_gyro_bias,
+    const Eigen::Vector3d& linearization_accel_bias)
+    : gravity_magnitude_(gravity_magnitude),
+      linearization_gyro_bias_(linearization_gyro_bias),
+      linearization_accel_bias_(linearization_accel_bias) {
+  CHECK_GE(imu_data.cols(), 2);
+  CHECK_EQ(imu_data.cols(), imu_timestamps.cols());
+
+  CHECK_GT(gyro_noise_sigma, 0.0);
+  CHECK_GT(gyro_bias_sigma, 0.0);
+  CHECK_GT(acc_noise_sigma, 0.0);
+  CHECK_GT(acc_bias_sigma, 0.0);
+
+  preintegrate(
+      imu_data, imu_timestamps, gyro_noise_sigma, gyro_bias_sigma,
+      acc_noise_sigma, acc_bias_sigma);
+}
+
+ceres::CostFunction* PreintegratedInertialErrorTerm::Create(
+    const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_data,
+    const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps,
+    double gyro_noise_sigma, double gyro_bias_sigma, double acc_noise_sigma,
+    double acc_bias_sigma, double gravity_magnitude,
+    const Eigen::Vector3d& linearization_gyro_bias,
+    const Eigen::Vector3d& linearization_accel_bias) {
+  return new ceres::AutoDiffCostFunction<
+      PreintegratedInertialErrorTerm, kResidualBlockSize,
+      imu_integrator::kStatePoseBlockSize, imu_integrator::kGyroBiasBlockSize,
+      imu_integrator::kVelocityBlockSize, imu_integrator::kAccelBiasBlockSize,
+      imu_integrator::kStatePoseBlockSize, imu_integrator::kGyroBiasBlockSize,
+      imu_integrator::kVelocityBlockSize, imu_integrator::kAccelBiasBlockSize>(
+      new PreintegratedInertialErrorTerm(
+          imu_data, imu_timestamps, gyro_noise_sigma, gyro_bias_sigma,
+          acc_noise_sigma, acc_bias_sigma, gravity_magnitude,
+          linearization_gyro_bias, linearization_accel_bias));
+}
+
+void PreintegratedInertialErrorTerm::preintegrate(
+    const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_data,
+    const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps,
+    double gyro_noise_sigma, double gyro_bias_sigma, double acc_noise_sigma,
+    double acc_bias_sigma) {
+  delta_time_seconds_ = 0.0;
+  delta_q_.setIdentity();
+  delta_v_.setZero();
+  delta_p_.setZero();
+  d_theta_d_gyro_bias_.setZero();
+  d_v_d_gyro_bias_.setZero();
+  d_v_d_accel_bias_.setZero();
+  d_p_d_gyro_bias_.setZero();
+  d_p_d_accel_bias_.setZero();
+
+  // Covariance of the preintegrated [theta, v, p].
+  typedef Eigen::Matrix<double, 9, 9> Matrix9d;
+  Matrix9d covariance = Matrix9d::Zero();
+  Matrix9d A = Matrix9d::Identity();
+  Eigen::Matrix<double, 9, 3> B_gyro = Eigen::Matrix<double, 9, 3>::Zero();
+  Eigen::Matrix<double, 9, 3> B_accel = Eigen::Matrix<double, 9, 3>::Zero();
+  const double gyro_noise_sigma_squared = gyro_noise_sigma * gyro_noise_sigma;
+  const double acc_noise_sigma_squared = acc_noise_sigma * acc_noise_sigma;
+
+  for (int i = 0; i < imu_data.cols() - 1; ++i) {
+    CHECK_GE(imu_timestamps(0, i + 1), imu_timestamps(0, i))
+        << "IMU measurements not properly ordered";
+    const double dt = (imu_timestamps(0, i + 1) - imu_timestamps(0, i)) *
+                      imu_integrator::kNanoSecondsToSeconds;
+    if (dt <= 0.0) {
+      continue;
+    }
+
+    // Midpoint of the debiased measurements of the interval.
+    const Eigen::Matrix<double, 6, 1> imu_reading =
+        0.5 * (imu_data.col(i) + imu_data.col(i + 1));
+    const Eigen::Vector3d acc =
+        imu_reading.segment<3>(imu_integrator::kAccelReadingOffset) -
+        linearization_accel_bias_;
+    const Eigen::Vector3d gyro =
+        imu_reading.segment<3>(imu_integrator::kGyroReadingOffset) -
+        linearization_gyro_bias_;
+
+    const Eigen::Matrix3d R = delta_q_.toRotationMatrix();
+    const Eigen::Matrix3d acc_skew = common::skew(acc);
+    const Eigen::Vector3d delta_theta = gyro * dt;
+    const Eigen::Quaterniond dq = exponentialMap(delta_theta);
+    const Eigen::Matrix3d dR = dq.toRotationMatrix();
+    const Eigen::Matrix3d J_r = rightJacobian(delta_theta);
+    const double dt_squared = dt * dt;
+
+    // Propagate the covariance with the state of the beginning of the
+    // interval.
+    A.block<3, 3>(0, 0) = dR.transpose();
+    A.block<3, 3>(3, 0) = -R * acc_skew * dt;
+    A.block<3, 3>(6, 0) = -0.5 * R * acc_skew * dt_squared;
+    A.block<3, 3>(6, 3) = Eigen::Matrix3d::Identity() * dt;
+    B_gyro.block<3, 3>(0, 0) = J_r * dt;
+    B_accel.block<3, 3>(3, 0) = R * dt;
+    B_accel.block<3, 3>(6, 0) = 0.5 * R * dt_squared;
+    covariance = A * covariance * A.transpose() +
+                 (gyro_noise_sigma_squared / dt) * B_gyro *
+                     B_gyro.transpose() +
+                 (acc_noise_sigma_squared / dt) * B_accel *
+                     B_accel.transpose();
+
+    // Bias Jacobians, position before velocity before rotation as each uses
+    // the previous value of the next.
+    d_p_d_accel_bias_ += d_v_d_accel_bias_ * dt - 0.5 * R * dt_squared;
+    d_p_d_gyro_bias_ += d_v_d_gyro_bias_ * dt -
+                        0.5 * R * acc_skew * d_theta_d_gyro_bias_ * dt_squared;
+    d_v_d_accel_bias_ -= R * dt;
+    d_v_d_gyro_bias_ -= R * acc_skew * d_theta_d_gyro_bias_ * dt;
+    d_theta_d_gyro_bias_ = dR.transpose() * d_theta_d_gyro_bias_ - J_r * dt;
+
+    delta_p_ += delta_v_ * dt + 0.5 * R * acc * dt_squared;
+    delta_v_ += R * acc * dt;
+    delta_q_ = (delta_q_ * dq).normalized();
+    delta_time_seconds_ += dt;
+  }
+  CHECK_GT(delta_time_seconds_, 0.0);
+
+  Eigen::Matrix<double, kResidualBlockSize, kResidualBlockSize>
+      residual_covariance =
+          Eigen::Matrix<double, kResidualBlockSize, kResidualBlockSize>::Zero();
+  const int kMotionOffsets[3] = {imu_integrator::kErrorStateOrientationOffset,
+                                 imu_integrator::kErrorStateVelocityOffset,
+                                 imu_integrator::kErrorStatePositionOffset};
+  for (int row = 0; row < 3; ++row) {
+    for (int col = 0; col < 3; ++col) {
+      residual_covariance.block<3, 3>(
+          kMotionOffsets[row], kMotionOffsets[col]) =
+          covariance.block<3, 3>(3 * row, 3 * col);
+    }
+  }
+  residual_covariance
+      .block<3, 3>(
+          imu_integrator::kErrorStateGyroBiasOffset,
+          imu_integrator::kErrorStateGyroBiasOffset)
+      .diagonal()
+      .setConstant(gyro_bias_sigma * gyro_bias_sigma * delta_time_seconds_);
+  residual_covariance
+      .block<3, 3>(
+          imu_integrator::kErrorStateAccelBiasOffset,
+          imu_integrator::kErrorStateAccelBiasOffset)
+      .diagonal()
+      .setConstant(acc_bias_sigma * acc_bias_sigma * delta_time_seconds_);
+
+  const Eigen::LLT<Eigen::Matrix<double, kResidualBlockSize,
+                                 kResidualBlockSize>>
+      llt(residual_covariance);
+  CHECK(llt.info() == Eigen::Success);
+  sqrt_information_.setIdentity();
+  llt.matrixL().solveInPlace(sqrt_information_);
+}
+
+}  // namespace ceres_error_terms
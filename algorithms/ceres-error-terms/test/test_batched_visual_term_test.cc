@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+#include <ceres/ceres.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/cameras/distortion-fisheye.h>
+#include <aslam/common/memory.h>
+
+#include <ceres-error-terms/batched-visual-error-term.h>
+#include <ceres-error-terms/parameterization/pose-param-jpl.h>
+#include <ceres-error-terms/parameterization/quaternion-param-jpl.h>
+#include <ceres-error-terms/visual-error-term.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+
+using ceres_error_terms::BatchedVisualReprojectionError;
+using ceres_error_terms::VisualReprojectionError;
+
+class BatchedVisualErrorTermTest : public ::testing::Test {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ protected:
+  typedef aslam::FisheyeDistortion DistortionType;
+  typedef aslam::PinholeCamera CameraType;
+  typedef VisualReprojectionError<CameraType, DistortionType> ErrorTerm;
+
+  static constexpr int kNumObservers = 5;
+  static constexpr double kPixelSigma = 0.7;
+
+  virtual void SetUp() {
+    Eigen::VectorXd distortion_parameters(1);
+    distortion_parameters << 0.0;
+    aslam::Distortion::UniquePtr distortion(
+        new DistortionType(distortion_parameters));
+    Eigen::VectorXd intrinsics(4);
+    intrinsics << 300, 300, 320, 240;
+    camera_.reset(new CameraType(intrinsics, 640, 480, distortion));
+
+    landmark_base_pose_ << 0, 0, 0, 1, 0, 0, 0;
+    dummy_7d_0_ << 0, 0, 0, 1, 0, 0, 0;
+    dummy_7d_1_ << 0, 0, 0, 1, 0, 0, 0;
+    camera_q_CI_ << 0, 0, 0, 1;
+    camera_p_CI_.setZero();
+    true_landmark_position_ << 0.2, -0.1, 3.0;
+
+    observer_poses_.resize(kNumObservers);
+    measurements_.resize(kNumObservers);
+    for (int i = 0; i < kNumObservers; ++i) {
+      observer_poses_[i] << 0, 0, 0, 1, 0.4 * (i - 2), 0.1 * i, 0;
+      const Eigen::Vector3d p_C_fi =
+          true_landmark_position_ - observer_poses_[i].tail<3>();
+      CHECK(camera_->project3(p_C_fi, &measurements_[i]).isKeypointVisible());
+    }
+    // Some noise and an outlier in the robust region of the loss.
+    measurements_[1] += Eigen::Vector2d(0.5, -0.3);
+    measurements_[3] += Eigen::Vector2d(40.0, 25.0);
+  }
+
+  std::vector<double*> observationParameterBlocks(
+      const int observer_idx, Eigen::Vector3d* landmark_position) {
+    return {landmark_position->data(),
+            landmark_base_pose_.data(),
+            dummy_7d_0_.data(),
+            dummy_7d_1_.data(),
+            observer_poses_[observer_idx].data(),
+            camera_q_CI_.data(),
+            camera_p_CI_.data(),
+            camera_->getParametersMutable(),
+            camera_->getDistortionMutable()->getParametersMutable()};
+  }
+
+  // Adds all observations either as individual residual blocks or as one
+  // batched residual block and returns the parameter blocks in the order of
+  // insertion.
+  std::vector<double*> buildProblem(
+      const bool batched, Eigen::Vector3d* landmark_position,
+      ceres::Problem* problem) {
+    CHECK_NOTNULL(landmark_position);
+    CHECK_NOTNULL(problem);
+    std::shared_ptr<BatchedVisualReprojectionError> batch(
+        new BatchedVisualReprojectionError);
+    std::vector<double*> parameter_blocks;
+    for (int i = 0; i < kNumObservers; ++i) {
+      std::shared_ptr<ceres::CostFunction> cost(new ErrorTerm(
+          measurements_[i], kPixelSigma,
+          ceres_error_terms::visual::VisualErrorType::kLocalMission,
+          camera_.get()));
+      std::shared_ptr<ceres::LossFunction> loss(
+          new ceres::HuberLoss(3.0 * kPixelSigma));
+      cost_functions_.push_back(cost);
+      loss_functions_.push_back(loss);
+      const std::vector<double*> blocks =
+          observationParameterBlocks(i, landmark_position);
+      if (batched) {
+        batch->addObservation(cost, loss, blocks);
+      } else {
+        problem->AddResidualBlock(cost.get(), loss.get(), blocks);
+      }
+      for (double* block : blocks) {
+        if (std::find(parameter_blocks.begin(), parameter_blocks.end(),
+                      block) == parameter_blocks.end()) {
+          parameter_blocks.push_back(block);
+        }
+      }
+    }
+    if (batched) {
+      EXPECT_EQ(batch->numObservations(), static_cast<size_t>(kNumObservers));
+      EXPECT_EQ(batch->parameter_blocks(), parameter_blocks);
+      cost_functions_.push_back(batch);
+      problem->AddResidualBlock(
+          batch.get(), nullptr, batch->parameter_blocks());
+    }
+
+    problem->SetParameterization(
+        landmark_base_pose_.data(), &pose_parameterization_);
+    for (Eigen::Matrix<double, 7, 1>& observer_pose : observer_poses_) {
+      problem->SetParameterization(
+          observer_pose.data(), &pose_parameterization_);
+    }
+    problem->SetParameterization(
+        camera_q_CI_.data(), &quaternion_parameterization_);
+    problem->SetParameterBlockConstant(dummy_7d_0_.data());
+    problem->SetParameterBlockConstant(dummy_7d_1_.data());
+    return parameter_blocks;
+  }
+
+  static ceres::Problem::Options problemOptions() {
+    ceres::Problem::Options options;
+    options.cost_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+    options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+    options.local_parameterization_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+    return options;
+  }
+
+  std::shared_ptr<CameraType> camera_;
+  ceres_error_terms::JplPoseParameterization pose_parameterization_;
+  ceres_error_terms::JplQuaternionParameterization
+      quaternion_parameterization_;
+  std::vector<std::shared_ptr<ceres::CostFunction>> cost_functions_;
+  std::vector<std::shared_ptr<ceres::LossFunction>> loss_functions_;
+
+  Eigen::Matrix<double, 7, 1> landmark_base_pose_;
+  Eigen::Matrix<double, 7, 1> dummy_7d_0_;
+  Eigen::Matrix<double, 7, 1> dummy_7d_1_;
+  Eigen::Vector4d camera_q_CI_;
+  Eigen::Vector3d camera_p_CI_;
+  Eigen::Vector3d true_landmark_position_;
+  Aligned<std::vector, Eigen::Matrix<double, 7, 1>> observer_poses_;
+  Aligned<std::vector, Eigen::Vector2d> measurements_;
+};
+
+TEST_F(BatchedVisualErrorTermTest, CostAndGradientMatchIndividualTerms) {
+  Eigen::Vector3d landmark_position =
+      true_landmark_position_ + Eigen::Vector3d(0.05, 0.02, -0.1);
+
+  ceres::Problem individual_problem(problemOptions());
+  ceres::Problem::EvaluateOptions individual_options;
+  individual_options.parameter_blocks =
+      buildProblem(false, &landmark_position, &individual_problem);
+  double individual_cost;
+  std::vector<double> individual_gradient;
+  ASSERT_TRUE(individual_problem.Evaluate(
+      individual_options, &individual_cost, nullptr, &individual_gradient,
+      nullptr));
+
+  ceres::Problem batched_problem(problemOptions());
+  ceres::Problem::EvaluateOptions batched_options;
+  batched_options.parameter_blocks =
+      buildProblem(true, &landmark_position, &batched_problem);
+  double batched_cost;
+  std::vector<double> batched_gradient;
+  ASSERT_TRUE(batched_problem.Evaluate(
+      batched_options, &batched_cost, nullptr, &batched_gradient, nullptr));
+
+  EXPECT_EQ(batched_problem.NumResidualBlocks(), 1);
+  EXPECT_EQ(
+      batched_problem.NumResiduals(), individual_problem.NumResiduals());
+  EXPECT_NEAR(batched_cost, individual_cost, 1e-9 * individual_cost);
+  ASSERT_EQ(batched_gradient.size(), individual_gradient.size());
+  for (size_t i = 0u; i < batched_gradient.size(); ++i) {
+    EXPECT_NEAR(
+        batched_gradient[i], individual_gradient[i],
+        1e-8 * std::max(1.0, std::abs(individual_gradient[i])));
+  }
+}
+
+TEST_F(BatchedVisualErrorTermTest, LandmarkOptimizationMatchesIndividualTerms) {
+  const Eigen::Vector3d initial_landmark_position =
+      true_landmark_position_ + Eigen::Vector3d(0.3, -0.2, 0.5);
+
+  ceres::Solver::Options options;
+  options.linear_solver_type = ceres::DENSE_QR;
+  options.max_num_iterations = 100;
+  options.function_tolerance = 1e-16;
+  options.parameter_tolerance = 1e-16;
+  options.gradient_tolerance = 1e-16;
+
+  Eigen::Vector3d landmark_positions[2] = {initial_landmark_position,
+                                           initial_landmark_position};
+  for (int batched = 0; batched < 2; ++batched) {
+    ceres::Problem problem(problemOptions());
+    for (double* block :
+         buildProblem(batched == 1, &landmark_positions[batched], &problem)) {
+      if (block != landmark_positions[batched].data()) {
+        problem.SetParameterBlockConstant(block);
+      }
+    }
+    ceres::Solver::Summary summary;
+    ceres::Solve(options, &problem, &summary);
+    LOG(INFO) << summary.BriefReport();
+  }
+
+  EXPECT_NEAR_EIGEN(landmark_positions[1], landmark_positions[0], 1e-6);
+  EXPECT_NEAR_EIGEN(landmark_positions[1], true_landmark_position_, 1e-2);
+}
+
+MAPLAB_UNITTEST_ENTRYPOINT
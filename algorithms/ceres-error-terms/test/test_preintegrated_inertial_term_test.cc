@@ -0,0 +1,149 @@
+#include <memory>
+
+#include <Eigen/Core>
+#include <Eigen/Dense>
+#include <ceres/ceres.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <ceres-error-terms/parameterization/pose-param-jpl.h>
+#include <ceres-error-terms/preintegrated-inertial-error-term.h>
+#include <maplab-common/gravity-provider.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+
+using ceres_error_terms::PreintegratedInertialErrorTerm;
+
+class PreintegratedInertialErrorTermTest : public ::testing::Test {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ protected:
+  virtual void SetUp() {
+    pose0_ << 0, 0, 0, 1, 0, 0, 0;
+    pose1_ << 0, 0, 0, 1, 1.5, 0, 0;
+
+    accel_bias0_.setZero();
+    accel_bias1_.setZero();
+    gyro_bias0_.setZero();
+    gyro_bias1_.setZero();
+
+    velocity0_ << 1, 0, 0;
+    velocity1_ << 2, 0, 0;
+
+    common::GravityProvider gravity_provider(
+        common::locations::kAltitudeZurichMeters,
+        common::locations::kLatitudeZurichDegrees);
+    gravity_magnitude_ = gravity_provider.getGravityMagnitude();
+
+    imu_timestamps_ << 0, 0.5 * 1e9, 1.0 * 1e9;
+    imu_data_ << 1, 1, 1, 0, 0, 0, gravity_magnitude_, gravity_magnitude_,
+        gravity_magnitude_, 0, 0, 0, 0, 0, 0, 0, 0, 0;
+  }
+
+  ceres::CostFunction* createCost(
+      const Eigen::Vector3d& linearization_gyro_bias,
+      const Eigen::Vector3d& linearization_accel_bias) const {
+    return PreintegratedInertialErrorTerm::Create(
+        imu_data_, imu_timestamps_, 1, 1, 1, 1, gravity_magnitude_,
+        linearization_gyro_bias, linearization_accel_bias);
+  }
+
+  void evaluate(
+      const ceres::CostFunction& cost,
+      Eigen::Matrix<double, 15, 1>* residuals) {
+    CHECK_NOTNULL(residuals);
+    const double* parameters[] = {
+        pose0_.data(),       gyro_bias0_.data(), velocity0_.data(),
+        accel_bias0_.data(), pose1_.data(),      gyro_bias1_.data(),
+        velocity1_.data(),   accel_bias1_.data()};
+    ASSERT_TRUE(cost.Evaluate(parameters, residuals->data(), nullptr));
+  }
+
+  void addResidual() {
+    problem_.AddResidualBlock(
+        createCost(Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero()), NULL,
+        pose0_.data(), gyro_bias0_.data(), velocity0_.data(),
+        accel_bias0_.data(), pose1_.data(), gyro_bias1_.data(),
+        velocity1_.data(), accel_bias1_.data());
+
+    ceres::LocalParameterization* pose_parameterization =
+        new ceres_error_terms::JplPoseParameterization;
+    problem_.SetParameterization(pose0_.data(), pose_parameterization);
+    problem_.SetParameterization(pose1_.data(), pose_parameterization);
+  }
+
+  void solve() {
+    ceres::Solver::Options options;
+    options.linear_solver_type = ceres::DENSE_QR;
+    options.max_num_iterations = 100;
+    options.gradient_tolerance = 1e-50;
+    options.function_tolerance = 1e-50;
+    options.parameter_tolerance = 1e-50;
+    ceres::Solve(options, &problem_, &summary_);
+    LOG(INFO) << summary_.BriefReport();
+  }
+
+  ceres::Problem problem_;
+  ceres::Solver::Summary summary_;
+
+  Eigen::Matrix<int64_t, 1, 3> imu_timestamps_;
+  Eigen::Matrix<double, 6, 3> imu_data_;
+
+  Eigen::Matrix<double, 7, 1> pose0_;
+  Eigen::Matrix<double, 7, 1> pose1_;
+  Eigen::Vector3d accel_bias0_;
+  Eigen::Vector3d accel_bias1_;
+  Eigen::Vector3d gyro_bias0_;
+  Eigen::Vector3d gyro_bias1_;
+  Eigen::Vector3d velocity0_;
+  Eigen::Vector3d velocity1_;
+
+  double gravity_magnitude_;
+};
+
+TEST_F(PreintegratedInertialErrorTermTest, ZeroResidual) {
+  std::unique_ptr<ceres::CostFunction> cost(
+      createCost(Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero()));
+  Eigen::Matrix<double, 15, 1> residuals;
+  evaluate(*cost, &residuals);
+  EXPECT_NEAR_EIGEN(residuals, Eigen::Matrix<double, 15, 1>::Zero(), 1e-12);
+}
+
+TEST_F(PreintegratedInertialErrorTermTest, FinalPositionOptimization) {
+  pose1_.tail<3>() << 1.43, -0.2, 0.175;
+  addResidual();
+
+  problem_.SetParameterBlockConstant(gyro_bias0_.data());
+  problem_.SetParameterBlockConstant(accel_bias0_.data());
+  problem_.SetParameterBlockConstant(gyro_bias1_.data());
+  problem_.SetParameterBlockConstant(accel_bias1_.data());
+  problem_.SetParameterBlockConstant(velocity0_.data());
+  problem_.SetParameterBlockConstant(velocity1_.data());
+  problem_.SetParameterBlockConstant(pose0_.data());
+
+  solve();
+  EXPECT_NEAR_EIGEN(pose1_.tail<3>(), Eigen::Vector3d(1.5, 0, 0), 1e-9);
+  EXPECT_NEAR_EIGEN(pose1_.head<4>(), Eigen::Vector4d(0, 0, 0, 1), 1e-9);
+  EXPECT_LT(summary_.final_cost, 1e-15);
+}
+
+TEST_F(PreintegratedInertialErrorTermTest, FirstOrderBiasCorrection) {
+  // A small change of the biases is corrected to first order, which has to
+  // match the preintegration at the new biases.
+  gyro_bias0_ << 1e-3, -2e-3, 1e-3;
+  accel_bias0_ << 2e-3, 1e-3, -1e-3;
+  std::unique_ptr<ceres::CostFunction> corrected_cost(
+      createCost(Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero()));
+  std::unique_ptr<ceres::CostFunction> preintegrated_cost(
+      createCost(gyro_bias0_, accel_bias0_));
+
+  Eigen::Matrix<double, 15, 1> corrected_residuals;
+  evaluate(*corrected_cost, &corrected_residuals);
+  Eigen::Matrix<double, 15, 1> preintegrated_residuals;
+  evaluate(*preintegrated_cost, &preintegrated_residuals);
+  EXPECT_GT(corrected_residuals.norm(), 1e-4);
+  EXPECT_NEAR_EIGEN(corrected_residuals, preintegrated_residuals, 1e-5);
+}
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,44 @@
+#ifndef DENSE_RECONSTRUCTION_DISPARITY_MATCHER_BACKEND_H_
+#define DENSE_RECONSTRUCTION_DISPARITY_MATCHER_BACKEND_H_
+
+#include <memory>
+
+#include <opencv2/core/core.hpp>
+
+namespace dense_reconstruction {
+namespace stereo {
+
+struct StereoMatcherConfig;
+
+// Computes the disparity map of a rectified stereo pair. The disparities are
+// CV_16SC1 with 4 fractional bits, as computed by the OpenCV matchers. A
+// backend keeps per call buffers and must only be used by one thread at a
+// time.
+class DisparityMatcherBackend {
+ public:
+  virtual ~DisparityMatcherBackend() {}
+
+  virtual void compute(
+      const cv::Mat& first_image_rectified,
+      const cv::Mat& second_image_rectified, cv::Mat* disparity_map) = 0;
+
+  // True if the backend is configured by the sgbm_* parameters of the
+  // config, false if by the bm_* parameters.
+  virtual bool usesSgbmParameters() const = 0;
+
+  // Creates the backend selected by config.backend:
+  //  - "cpu": OpenCV's StereoSGBM or StereoBM, depending on config.use_sgbm.
+  //  - "cuda": OpenCV's CUDA semi-global matching with the sgbm_*
+  //    parameters. Falls back to "cpu" if OpenCV was built without the
+  //    cudastereo module or there is no CUDA device.
+  static std::unique_ptr<DisparityMatcherBackend> create(
+      const StereoMatcherConfig& config);
+
+  // Returns true if the "cuda" backend is compiled in and a device is found.
+  static bool isCudaAvailable();
+};
+
+}  // namespace stereo
+}  // namespace dense_reconstruction
+
+#endif  // DENSE_RECONSTRUCTION_DISPARITY_MATCHER_BACKEND_H_
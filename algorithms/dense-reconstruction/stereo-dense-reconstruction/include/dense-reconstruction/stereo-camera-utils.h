@@ -2,6 +2,7 @@
 #define DENSE_RECONSTRUCTION_STEREO_CAMERA_UTILS_H_
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -157,10 +158,10 @@ class Undistorter {
   explicit Undistorter(
       const CameraParametersPair& input_camera_parameters_pair);
 
-  void undistortImage(const cv::Mat& image, cv::Mat* undistored_image);
+  void undistortImage(const cv::Mat& image, cv::Mat* undistored_image) const;
 
   // Get camera parameters used to build undistorter.
-  const CameraParametersPair& getCameraParametersPair();
+  const CameraParametersPair& getCameraParametersPair() const;
 
   // Generates a new output camera with fx = fy = (scale * (input_fx +
   // input_fy)/2, center point in the center of the image, R = I, and a
@@ -185,6 +186,23 @@ class Undistorter {
   double empty_pixels_;
 };
 
+// Caches the undistorters, i.e. the fixed-point undistortion and
+// rectification maps, by their camera parameters. The maps are only computed
+// once and shared by all users of the same input and output camera, e.g. the
+// matchers of all threads of a stereo pair or of all missions with the same
+// rig. Thread-safe.
+class UndistorterCache {
+ public:
+  std::shared_ptr<const Undistorter> getUndistorter(
+      const CameraParametersPair& camera_parameters_pair);
+
+  size_t size() const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::vector<std::shared_ptr<const Undistorter>> undistorters_;
+};
+
 }  // namespace stereo
 }  // namespace dense_reconstruction
 
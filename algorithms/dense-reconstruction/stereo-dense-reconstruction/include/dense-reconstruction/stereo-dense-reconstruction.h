@@ -1,13 +1,35 @@
 #ifndef DENSE_RECONSTRUCTION_STEREO_DENSE_RECONSTRUCTION_H_
 #define DENSE_RECONSTRUCTION_STEREO_DENSE_RECONSTRUCTION_H_
 
+#include <functional>
+
 #include <aslam/cameras/camera.h>
 #include <map-resources/resource-common.h>
+#include <map-resources/resource-typedefs.h>
+#include <opencv2/core/mat.hpp>
 #include <vi-map/unique-id.h>
 #include <vi-map/vi-map.h>
 
+#include "dense-reconstruction/stereo-camera-utils.h"
+
 namespace dense_reconstruction {
 
+// The depth of the first camera of a stereo pair at one vertex. Depending on
+// the depth resource type, either the depth map or the point cloud is set. The
+// image is the grayscale image of the first camera the depth was computed
+// from.
+struct StereoDepth {
+  const vi_map::Vertex* vertex = nullptr;
+  size_t camera_idx = 0u;
+  cv::Mat image;
+  cv::Mat depth_map;
+  resources::PointCloud point_cloud;
+};
+
+// Called for every computed depth on the thread that runs the reconstruction,
+// in the order in which the stereo matching finishes.
+typedef std::function<void(const StereoDepth&)> StereoDepthCallback;
+
 void computeDepthForAllStereoCameras(
     const backend::ResourceType& depth_resource_type, vi_map::VIMap* vi_map);
 
@@ -16,12 +38,41 @@ void computeDepthForAllStereoCameras(
     const backend::ResourceType& depth_resource_type,
     const vi_map::MissionIdList& selected_mission_ids, vi_map::VIMap* vi_map);
 
+// Same as above, every depth is passed to the callback and only stored as
+// resource if store_depth_resources is set. This allows to fuse the depth into
+// a volumetric map while it is computed, without persisting every depth map.
+void computeDepthForAllStereoCameras(
+    const backend::ResourceType& depth_resource_type,
+    const vi_map::MissionIdList& selected_mission_ids,
+    const bool store_depth_resources, const StereoDepthCallback& depth_callback,
+    vi_map::VIMap* vi_map);
+
 void computeDepthForStereoCamerasOfMission(
     const aslam::CameraId& first_camera_id,
     const aslam::CameraId& second_camera_id,
     const aslam::Transformation& T_C2_C1, const vi_map::MissionId& mission_id,
     const backend::ResourceType& depth_resource_type, vi_map::VIMap* vi_map);
 
+// Same as above, the undistortion and rectification maps are taken from and
+// added to the cache, such that they are only computed once for all missions
+// with the same cameras.
+void computeDepthForStereoCamerasOfMission(
+    const aslam::CameraId& first_camera_id,
+    const aslam::CameraId& second_camera_id,
+    const aslam::Transformation& T_C2_C1, const vi_map::MissionId& mission_id,
+    const backend::ResourceType& depth_resource_type,
+    stereo::UndistorterCache* undistorter_cache, vi_map::VIMap* vi_map);
+
+// Same as above, every depth is passed to the callback, if there is one, and
+// only stored as resource if store_depth_resources is set.
+void computeDepthForStereoCamerasOfMission(
+    const aslam::CameraId& first_camera_id,
+    const aslam::CameraId& second_camera_id,
+    const aslam::Transformation& T_C2_C1, const vi_map::MissionId& mission_id,
+    const backend::ResourceType& depth_resource_type,
+    const bool store_depth_resources, const StereoDepthCallback& depth_callback,
+    stereo::UndistorterCache* undistorter_cache, vi_map::VIMap* vi_map);
+
 }  // namespace dense_reconstruction
 
 #endif  // DENSE_RECONSTRUCTION_STEREO_DENSE_RECONSTRUCTION_H_
@@ -12,6 +12,7 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/opencv.hpp>
 
+#include "dense-reconstruction/disparity-matcher-backend.h"
 #include "dense-reconstruction/stereo-camera-utils.h"
 
 namespace dense_reconstruction {
@@ -31,6 +32,9 @@ struct StereoMatcherConfig {
 
   double downscaling_factor = 1.0;
 
+  // "cpu" or "cuda", see DisparityMatcherBackend::create.
+  std::string backend = "cpu";
+
   bool use_sgbm = true;
 
   int sgbm_min_disparity = 0;
@@ -74,6 +78,13 @@ class StereoMatcher {
       const aslam::Camera& first_camera, const aslam::Camera& second_camera,
       const aslam::Transformation& T_C2_C1, const StereoMatcherConfig& config);
 
+  // Same as above, but the undistorters are taken from the cache and only
+  // created if no other matcher uses the same rectified cameras yet.
+  StereoMatcher(
+      const aslam::Camera& first_camera, const aslam::Camera& second_camera,
+      const aslam::Transformation& T_C2_C1, const StereoMatcherConfig& config,
+      UndistorterCache* undistorter_cache);
+
   // Compute a disparity map for the stereo pair.
   void computeDisparityMap(
       const cv::Mat& first_image, const cv::Mat& second_image,
@@ -127,11 +138,11 @@ class StereoMatcher {
   StereoCameraParameters stereo_camera_params_;
 
   // Convenience class to compute and cache the stereo
-  // undistortion/rectification mapping.
-  std::unique_ptr<Undistorter> undistorter_first_;
-  std::unique_ptr<Undistorter> undistorter_second_;
+  // undistortion/rectification mapping. Possibly shared with other matchers.
+  std::shared_ptr<const Undistorter> undistorter_first_;
+  std::shared_ptr<const Undistorter> undistorter_second_;
 
-  cv::Ptr<cv::StereoMatcher> stereo_matcher_;
+  std::unique_ptr<DisparityMatcherBackend> disparity_matcher_;
 
   // Cached intrinsics:
   double focal_length_;
@@ -0,0 +1,153 @@
+#include "dense-reconstruction/disparity-matcher-backend.h"
+
+#include <memory>
+#include <string>
+
+#include <glog/logging.h>
+#include <opencv2/calib3d/calib3d.hpp>
+#include <opencv2/core/core.hpp>
+#include <opencv2/opencv_modules.hpp>
+
+#ifdef HAVE_OPENCV_CUDASTEREO
+#include <opencv2/core/cuda.hpp>
+#include <opencv2/cudastereo.hpp>
+#endif
+
+#include "dense-reconstruction/stereo-matcher.h"
+
+namespace dense_reconstruction {
+namespace stereo {
+
+namespace {
+// Runs OpenCV's StereoSGBM or StereoBM on the CPU.
+class OpenCvCpuDisparityMatcher : public DisparityMatcherBackend {
+ public:
+  explicit OpenCvCpuDisparityMatcher(const StereoMatcherConfig& config)
+      : use_sgbm_(config.use_sgbm) {
+    if (use_sgbm_) {
+      VLOG(1) << "Stereo matching algorithm used: SGBM";
+      stereo_matcher_ = cv::StereoSGBM::create(
+          config.sgbm_min_disparity, config.sgbm_num_disparities,
+          config.sgbm_sad_window_size, config.sgbm_p1, config.sgbm_p2,
+          config.sgbm_disp12_max_diff, config.sgbm_pre_filter_cap,
+          config.sgbm_uniqueness_ratio, config.sgbm_speckle_window_size,
+          config.sgbm_speckle_range, config.sgbm_mode);
+    } else {
+      VLOG(1) << "Stereo matching algorithm used: BM";
+      stereo_matcher_ = cv::StereoBM::create(
+          config.bm_num_disparities, config.bm_sad_window_size);
+
+      cv::StereoBM* bm_ptr = static_cast<cv::StereoBM*>(stereo_matcher_.get());
+      bm_ptr->setPreFilterCap(config.bm_pre_filter_cap);
+      bm_ptr->setPreFilterSize(config.bm_pre_filter_size);
+      bm_ptr->setMinDisparity(config.bm_min_disparity);
+      bm_ptr->setTextureThreshold(config.bm_texture_threshold);
+      bm_ptr->setUniquenessRatio(config.bm_uniqueness_ratio);
+      bm_ptr->setSpeckleRange(config.bm_speckle_range);
+      bm_ptr->setSpeckleWindowSize(config.bm_speckle_window_size);
+      bm_ptr->setDisp12MaxDiff(config.bm_disp12_max_diff);
+    }
+  }
+
+  void compute(
+      const cv::Mat& first_image_rectified,
+      const cv::Mat& second_image_rectified, cv::Mat* disparity_map) override {
+    CHECK_NOTNULL(disparity_map);
+    CHECK(stereo_matcher_);
+    stereo_matcher_->compute(
+        first_image_rectified, second_image_rectified, *disparity_map);
+  }
+
+  bool usesSgbmParameters() const override {
+    return use_sgbm_;
+  }
+
+ private:
+  const bool use_sgbm_;
+  cv::Ptr<cv::StereoMatcher> stereo_matcher_;
+};
+
+#ifdef HAVE_OPENCV_CUDASTEREO
+// Runs OpenCV's CUDA semi-global matching. The images are staged in
+// page-locked host buffers, such that the uploads, the matching and the
+// download are queued asynchronously on the stream of this backend. Backends
+// of different threads use different streams, so the transfers of one pair
+// overlap with the matching of the others.
+class OpenCvCudaDisparityMatcher : public DisparityMatcherBackend {
+ public:
+  explicit OpenCvCudaDisparityMatcher(const StereoMatcherConfig& config) {
+    CHECK_GT(cv::cuda::getCudaEnabledDeviceCount(), 0);
+    VLOG(1) << "Stereo matching algorithm used: CUDA SGM";
+    stereo_matcher_ = cv::cuda::createStereoSGM(
+        config.sgbm_min_disparity, config.sgbm_num_disparities,
+        config.sgbm_p1, config.sgbm_p2, config.sgbm_uniqueness_ratio,
+        cv::cuda::StereoSGM::MODE_HH4);
+  }
+
+  void compute(
+      const cv::Mat& first_image_rectified,
+      const cv::Mat& second_image_rectified, cv::Mat* disparity_map) override {
+    CHECK_NOTNULL(disparity_map);
+    CHECK(stereo_matcher_);
+    first_image_rectified.copyTo(first_image_host_);
+    second_image_rectified.copyTo(second_image_host_);
+    first_image_device_.upload(first_image_host_, stream_);
+    second_image_device_.upload(second_image_host_, stream_);
+    stereo_matcher_->compute(
+        first_image_device_, second_image_device_, disparity_device_,
+        stream_);
+    disparity_device_.download(disparity_host_, stream_);
+    stream_.waitForCompletion();
+    disparity_host_.createMatHeader().copyTo(*disparity_map);
+  }
+
+  bool usesSgbmParameters() const override {
+    return true;
+  }
+
+ private:
+  cv::Ptr<cv::cuda::StereoSGM> stereo_matcher_;
+  cv::cuda::Stream stream_;
+
+  cv::cuda::HostMem first_image_host_;
+  cv::cuda::HostMem second_image_host_;
+  cv::cuda::HostMem disparity_host_;
+  cv::cuda::GpuMat first_image_device_;
+  cv::cuda::GpuMat second_image_device_;
+  cv::cuda::GpuMat disparity_device_;
+};
+#endif
+}  // namespace
+
+std::unique_ptr<DisparityMatcherBackend> DisparityMatcherBackend::create(
+    const StereoMatcherConfig& config) {
+  if (config.backend == "cuda") {
+#ifdef HAVE_OPENCV_CUDASTEREO
+    if (isCudaAvailable()) {
+      LOG_IF(WARNING, !config.use_sgbm)
+          << "The CUDA stereo matcher backend only supports SGM, ignoring "
+          << "the BM parameters.";
+      return std::unique_ptr<DisparityMatcherBackend>(
+          new OpenCvCudaDisparityMatcher(config));
+    }
+#endif
+    LOG(WARNING) << "The CUDA stereo matcher backend is not available, "
+                 << "falling back to the CPU backend.";
+  } else {
+    CHECK_EQ(config.backend, "cpu")
+        << "Unknown stereo matcher backend '" << config.backend << "'.";
+  }
+  return std::unique_ptr<DisparityMatcherBackend>(
+      new OpenCvCpuDisparityMatcher(config));
+}
+
+bool DisparityMatcherBackend::isCudaAvailable() {
+#ifdef HAVE_OPENCV_CUDASTEREO
+  return cv::cuda::getCudaEnabledDeviceCount() > 0;
+#else
+  return false;
+#endif
+}
+
+}  // namespace stereo
+}  // namespace dense_reconstruction
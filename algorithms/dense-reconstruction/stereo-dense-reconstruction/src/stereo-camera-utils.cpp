@@ -1,6 +1,7 @@
 #include "dense-reconstruction/stereo-camera-utils.h"
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -453,7 +454,7 @@ Undistorter::Undistorter(
 }
 
 void Undistorter::undistortImage(
-    const cv::Mat& image, cv::Mat* undistorted_image) {
+    const cv::Mat& image, cv::Mat* undistorted_image) const {
   if (empty_pixels_) {
     cv::remap(
         image, *undistorted_image, map_x_, map_y_, cv::INTER_LINEAR,
@@ -466,7 +467,7 @@ void Undistorter::undistortImage(
   }
 }
 
-const CameraParametersPair& Undistorter::getCameraParametersPair() {
+const CameraParametersPair& Undistorter::getCameraParametersPair() const {
   return used_camera_parameters_pair_;
 }
 
@@ -561,5 +562,29 @@ void Undistorter::distortPixel(
       distorted_pixel_location_3.y() / distorted_pixel_location_3.z();
 }
 
+std::shared_ptr<const Undistorter> UndistorterCache::getUndistorter(
+    const CameraParametersPair& camera_parameters_pair) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const std::shared_ptr<const Undistorter>& undistorter :
+       undistorters_) {
+    const CameraParametersPair& cached_camera_parameters_pair =
+        undistorter->getCameraParametersPair();
+    if (cached_camera_parameters_pair.distortionProcessing() ==
+            camera_parameters_pair.distortionProcessing() &&
+        cached_camera_parameters_pair == camera_parameters_pair) {
+      return undistorter;
+    }
+  }
+  // The maps are computed while holding the lock, such that concurrent
+  // requests for the same cameras wait instead of computing them again.
+  undistorters_.emplace_back(new Undistorter(camera_parameters_pair));
+  return undistorters_.back();
+}
+
+size_t UndistorterCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return undistorters_.size();
+}
+
 }  // namespace stereo
 }  // namespace dense_reconstruction
@@ -1,17 +1,25 @@
 #include "dense-reconstruction/stereo-dense-reconstruction.h"
 
+#include <algorithm>
+#include <memory>
 #include <string>
+#include <thread>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <Eigen/Dense>
 #include <aslam/cameras/camera.h>
 #include <map-resources/resource-common.h>
 #include <maplab-common/progress-bar.h>
+#include <maplab-common/threading-helpers.h>
+#include <maplab-common/threadsafe-queue.h>
 #include <vi-map/sensor-manager.h>
 #include <vi-map/unique-id.h>
 #include <vi-map/vi-map.h>
 
 #include "dense-reconstruction/disparity-conversion-utils.h"
+#include "dense-reconstruction/disparity-matcher-backend.h"
 #include "dense-reconstruction/resource-utils.h"
 #include "dense-reconstruction/stereo-matcher.h"
 #include "dense-reconstruction/stereo-pair-detection.h"
@@ -39,6 +47,18 @@ DEFINE_bool(
     "This affects the number of disparities and the p1/p2 parameter for the "
     "SGBM.");
 
+DEFINE_int32(
+    dense_stereo_num_threads, 0,
+    "Number of threads that run the stereo matching, each with its own "
+    "matcher. 0 uses the number of hardware threads, or 2 with the CUDA "
+    "backend.");
+
+DEFINE_int32(
+    dense_stereo_pipeline_queue_size, 4,
+    "Maximum number of stereo frames waiting between the image loading, the "
+    "stereo matching and the resource storing, which bounds the memory use of "
+    "the dense reconstruction.");
+
 namespace dense_reconstruction {
 static std::unordered_set<backend::ResourceType, backend::ResourceTypeHash>
     kSupportedDepthTypes{backend::ResourceType::kRawDepthMap,
@@ -113,6 +133,131 @@ bool getSuitableGrayscaleImageForFrame(
   return false;
 }
 
+namespace {
+static const std::string kDisparityMapWindowName = "Disparity Map";
+static const std::string kFirstImageWindowName = "First Image";
+static const std::string kSecondImageWindowName = "Second Image";
+static const std::string kDepthMapWindowName = "Depth Map";
+
+// The images and results of a vertex that are passed from the image loading
+// through the stereo matching to the resource storing.
+struct StereoFrame {
+  vi_map::Vertex* vertex_ptr = nullptr;
+  bool has_images = false;
+  cv::Mat first_image;
+  cv::Mat second_image;
+  cv::Mat disparity_map;
+  cv::Mat depth_map;
+  resources::PointCloud point_cloud;
+};
+typedef std::shared_ptr<StereoFrame> StereoFramePtr;
+
+void computeDepthOfStereoFrame(
+    const stereo::StereoMatcher& matcher, const aslam::Camera& first_camera,
+    const backend::ResourceType& depth_resource_type,
+    const bool keep_first_image, StereoFrame* frame) {
+  CHECK_NOTNULL(frame);
+  CHECK(frame->has_images);
+  CHECK(!frame->first_image.empty());
+  CHECK(!frame->second_image.empty());
+  CHECK_EQ(frame->first_image.type(), CV_8UC1);
+  CHECK_EQ(frame->second_image.type(), CV_8UC1);
+  CHECK_EQ(frame->first_image.cols, frame->second_image.cols);
+  CHECK_EQ(frame->first_image.rows, frame->second_image.rows);
+
+  VLOG(3) << "Computing disparity map for vertex " << frame->vertex_ptr->id();
+
+  cv::Mat first_image_rectified, second_image_rectified;
+  matcher.computeDisparityMap(
+      frame->first_image, frame->second_image, &frame->disparity_map,
+      &first_image_rectified, &second_image_rectified);
+
+  switch (depth_resource_type) {
+    case backend::ResourceType::kPointCloudXYZRGBN:
+      stereo::convertDisparityMapToPointCloud(
+          frame->disparity_map, first_image_rectified, matcher.baseline(),
+          matcher.focal_length(), matcher.cx(), matcher.cy(),
+          matcher.sad_window_size(), matcher.min_disparity(),
+          matcher.num_disparities(), &frame->point_cloud);
+      break;
+    case backend::ResourceType::kRawDepthMap:
+      stereo::convertDisparityMapToDepthMap(
+          frame->disparity_map, first_image_rectified, matcher.baseline(),
+          matcher.focal_length(), matcher.cx(), matcher.cy(),
+          matcher.sad_window_size(), matcher.min_disparity(),
+          matcher.num_disparities(), first_camera, &frame->depth_map);
+      break;
+    default:
+      LOG(FATAL)
+          << "Resource type '"
+          << backend::ResourceTypeNames[static_cast<int>(depth_resource_type)]
+          << "' is not supported as output format of the stereo dense "
+          << "reconstruction.";
+  }
+
+  // Only keep what is still needed for the visualization and the depth
+  // callback.
+  if (!FLAGS_dense_stereo_images_and_result_in_ocv_windows) {
+    if (!keep_first_image) {
+      frame->first_image.release();
+    }
+    frame->second_image.release();
+    frame->disparity_map.release();
+  }
+}
+
+void showStereoFrame(
+    const backend::ResourceType& depth_resource_type,
+    const StereoFrame& frame) {
+  CHECK(frame.has_images);
+  cv::imshow(kFirstImageWindowName, frame.first_image);
+  cv::imshow(kSecondImageWindowName, frame.second_image);
+  cv::Mat color_map_disparity;
+  generateColorMap(frame.disparity_map, &color_map_disparity);
+  cv::imshow(kDisparityMapWindowName, color_map_disparity);
+
+  if (depth_resource_type == backend::ResourceType::kRawDepthMap) {
+    cv::Mat color_map_depth;
+    generateColorMap(frame.depth_map, &color_map_depth);
+    cv::imshow(kDepthMapWindowName, color_map_depth);
+  }
+  cv::waitKey(1);
+}
+
+void storeDepthOfStereoFrame(
+    const size_t first_camera_idx,
+    const backend::ResourceType& depth_resource_type,
+    const StereoFrame& frame, vi_map::VIMap* vi_map) {
+  CHECK_NOTNULL(vi_map);
+  CHECK(frame.has_images);
+
+  switch (depth_resource_type) {
+    case backend::ResourceType::kPointCloudXYZRGBN: {
+      if (frame.point_cloud.size() > 0) {
+        storeFrameResourceWithOptionalOverwrite(
+            frame.point_cloud, first_camera_idx, depth_resource_type,
+            frame.vertex_ptr, vi_map);
+      } else {
+        VLOG(3) << "No 3D points reconstructed.";
+      }
+      break;
+    }
+    case backend::ResourceType::kRawDepthMap: {
+      storeFrameResourceWithOptionalOverwrite(
+          frame.depth_map, first_camera_idx, depth_resource_type,
+          frame.vertex_ptr, vi_map);
+      break;
+    }
+    default:
+      LOG(FATAL)
+          << "Resource type '"
+          << backend::ResourceTypeNames[static_cast<int>(depth_resource_type)]
+          << "' is not supported as output format of the stereo dense "
+          << "reconstruction.";
+  }
+}
+}  // namespace
+
 void computeDepthForAllStereoCameras(
     const backend::ResourceType& depth_resource_type, vi_map::VIMap* vi_map) {
   CHECK_NOTNULL(vi_map);
@@ -126,6 +271,18 @@ void computeDepthForAllStereoCameras(
     const backend::ResourceType& depth_resource_type,
     const vi_map::MissionIdList& selected_mission_ids, vi_map::VIMap* vi_map) {
   CHECK_NOTNULL(vi_map);
+  constexpr bool kStoreDepthResources = true;
+  computeDepthForAllStereoCameras(
+      depth_resource_type, selected_mission_ids, kStoreDepthResources,
+      StereoDepthCallback(), vi_map);
+}
+
+void computeDepthForAllStereoCameras(
+    const backend::ResourceType& depth_resource_type,
+    const vi_map::MissionIdList& selected_mission_ids,
+    const bool store_depth_resources, const StereoDepthCallback& depth_callback,
+    vi_map::VIMap* vi_map) {
+  CHECK_NOTNULL(vi_map);
 
   StereoPairsPerMissionMap stereo_camera_ids_per_mission;
   stereo::findAllStereoCameras(*vi_map, &stereo_camera_ids_per_mission);
@@ -133,6 +290,8 @@ void computeDepthForAllStereoCameras(
   stereo::printStereoCamerasPerMission(
       stereo_camera_ids_per_mission, kVerbosity);
 
+  stereo::UndistorterCache undistorter_cache;
+
   for (const StereoPairIdsPerMission& pair_per_mission :
        stereo_camera_ids_per_mission) {
     for (const StereoPairIdentifier& stereo_pair_identifier :
@@ -154,7 +313,8 @@ void computeDepthForAllStereoCameras(
 
       computeDepthForStereoCamerasOfMission(
           first_camera_id, second_camera_id, T_C2_C1, mission_id,
-          depth_resource_type, vi_map);
+          depth_resource_type, store_depth_resources, depth_callback,
+          &undistorter_cache, vi_map);
     }
   }
 }
@@ -165,6 +325,36 @@ void computeDepthForStereoCamerasOfMission(
     const aslam::Transformation& T_C2_C1, const vi_map::MissionId& mission_id,
     const backend::ResourceType& depth_resource_type, vi_map::VIMap* vi_map) {
   CHECK_NOTNULL(vi_map);
+  stereo::UndistorterCache undistorter_cache;
+  computeDepthForStereoCamerasOfMission(
+      first_camera_id, second_camera_id, T_C2_C1, mission_id,
+      depth_resource_type, &undistorter_cache, vi_map);
+}
+
+void computeDepthForStereoCamerasOfMission(
+    const aslam::CameraId& first_camera_id,
+    const aslam::CameraId& second_camera_id,
+    const aslam::Transformation& T_C2_C1, const vi_map::MissionId& mission_id,
+    const backend::ResourceType& depth_resource_type,
+    stereo::UndistorterCache* undistorter_cache, vi_map::VIMap* vi_map) {
+  CHECK_NOTNULL(undistorter_cache);
+  CHECK_NOTNULL(vi_map);
+  constexpr bool kStoreDepthResources = true;
+  computeDepthForStereoCamerasOfMission(
+      first_camera_id, second_camera_id, T_C2_C1, mission_id,
+      depth_resource_type, kStoreDepthResources, StereoDepthCallback(),
+      undistorter_cache, vi_map);
+}
+
+void computeDepthForStereoCamerasOfMission(
+    const aslam::CameraId& first_camera_id,
+    const aslam::CameraId& second_camera_id,
+    const aslam::Transformation& T_C2_C1, const vi_map::MissionId& mission_id,
+    const backend::ResourceType& depth_resource_type,
+    const bool store_depth_resources, const StereoDepthCallback& depth_callback,
+    stereo::UndistorterCache* undistorter_cache, vi_map::VIMap* vi_map) {
+  CHECK_NOTNULL(undistorter_cache);
+  CHECK_NOTNULL(vi_map);
   CHECK_GT(kSupportedDepthTypes.count(depth_resource_type), 0)
       << "This depth type is not supported! type: "
       << backend::ResourceTypeNames[static_cast<int>(depth_resource_type)];
@@ -183,11 +373,6 @@ void computeDepthForStereoCamerasOfMission(
   const size_t second_camera_idx = ncamera.getCameraIndex(second_camera_id);
   const aslam::Camera& second_camera = ncamera.getCamera(second_camera_idx);
 
-  static const std::string kDisparityMapWindowName = "Disparity Map";
-  static const std::string kFirstImageWindowName = "First Image";
-  static const std::string kSecondImageWindowName = "Second Image";
-  static const std::string kDepthMapWindowName = "Depth Map";
-
   if (FLAGS_dense_stereo_images_and_result_in_ocv_windows) {
     cv::namedWindow(kDisparityMapWindowName, cv::WINDOW_NORMAL);
     cv::namedWindow(kFirstImageWindowName, cv::WINDOW_NORMAL);
@@ -202,8 +387,6 @@ void computeDepthForStereoCamerasOfMission(
     config.adaptParamsBasedOnImageSize(first_camera.imageWidth());
   }
 
-  stereo::StereoMatcher matcher(first_camera, second_camera, T_C2_C1, config);
-
   pose_graph::VertexIdList all_vertices;
   vi_map->getAllVertexIdsInMissionAlongGraph(mission_id, &all_vertices);
 
@@ -215,110 +398,102 @@ void computeDepthForStereoCamerasOfMission(
   const size_t end = static_cast<size_t>(
       FLAGS_dense_stereo_debug_reconstruction_end_fraction_of_trajectory *
       static_cast<double>(all_vertices.size()));
-  size_t counter = 0u;
+  const size_t vertex_idx_end = std::min(end + 1u, all_vertices.size());
+
+  // With the CUDA backend, a few matching threads with their own streams keep
+  // the device busy, more threads only compete for device memory.
+  constexpr size_t kNumCudaMatchingThreads = 2u;
+  const bool uses_cuda = config.backend == "cuda" &&
+                         stereo::DisparityMatcherBackend::isCudaAvailable();
+  size_t num_threads =
+      uses_cuda ? kNumCudaMatchingThreads : common::getNumHardwareThreads();
+  if (FLAGS_dense_stereo_num_threads > 0) {
+    num_threads = static_cast<size_t>(FLAGS_dense_stereo_num_threads);
+  }
+  CHECK_GT(FLAGS_dense_stereo_pipeline_queue_size, 0);
+  const size_t max_queue_size = FLAGS_dense_stereo_pipeline_queue_size;
 
   common::ProgressBar progress_bar(all_vertices.size());
   progress_bar.update(start);
-  for (const pose_graph::VertexId& vertex_id : all_vertices) {
-    if (counter < start) {
-      ++counter;
-      continue;
-    } else if (counter > end) {
-      break;
-    }
-    ++counter;
-
-    vi_map::Vertex* vertex_ptr = vi_map->getVertexPtr(vertex_id);
 
-    cv::Mat first_image, second_image;
-    const bool has_first_image = getSuitableGrayscaleImageForFrame(
-        *vi_map, *vertex_ptr, first_camera_idx, &first_image);
-    const bool has_second_image = getSuitableGrayscaleImageForFrame(
-        *vi_map, *vertex_ptr, second_camera_idx, &second_image);
-    if (!(has_first_image && has_second_image)) {
-      VLOG(3) << "Skipping vertex " << vertex_ptr->id()
-              << " - no suitable image was found.";
-      progress_bar.increment();
-      continue;
+  // The images are loaded by one thread and matched by num_threads threads,
+  // each with its own matcher as the OpenCV matchers keep per call buffers.
+  // The resources are stored and passed to the callback by this thread. A null
+  // pointer marks the end of the frames of every matching thread.
+  common::ThreadSafeQueue<StereoFramePtr> loaded_queue;
+  std::thread loading_thread([&]() {
+    for (size_t idx = start; idx < vertex_idx_end; ++idx) {
+      StereoFramePtr frame(new StereoFrame);
+      frame->vertex_ptr = vi_map->getVertexPtr(all_vertices[idx]);
+      const bool has_first_image = getSuitableGrayscaleImageForFrame(
+          *vi_map, *frame->vertex_ptr, first_camera_idx, &frame->first_image);
+      const bool has_second_image = getSuitableGrayscaleImageForFrame(
+          *vi_map, *frame->vertex_ptr, second_camera_idx,
+          &frame->second_image);
+      frame->has_images = has_first_image && has_second_image;
+      CHECK(loaded_queue.PushBlockingIfFull(frame, max_queue_size));
     }
-
-    VLOG(3) << "Computing disparity map for vertex " << vertex_ptr->id();
-
-    CHECK(!first_image.empty());
-    CHECK(!second_image.empty());
-    CHECK_EQ(first_image.type(), CV_8UC1);
-    CHECK_EQ(second_image.type(), CV_8UC1);
-    CHECK_EQ(first_image.cols, second_image.cols);
-    CHECK_EQ(first_image.rows, second_image.rows);
-
-    if (FLAGS_dense_stereo_images_and_result_in_ocv_windows) {
-      cv::imshow(kFirstImageWindowName, first_image);
-      cv::imshow(kSecondImageWindowName, second_image);
-    }
-
-    cv::Mat disparity_map, first_image_rectified, second_image_rectified;
-    matcher.computeDisparityMap(
-        first_image, second_image, &disparity_map, &first_image_rectified,
-        &second_image_rectified);
-
-    if (FLAGS_dense_stereo_images_and_result_in_ocv_windows) {
-      cv::Mat color_map_disparity;
-      generateColorMap(disparity_map, &color_map_disparity);
-      cv::imshow(kDisparityMapWindowName, color_map_disparity);
+    for (size_t thread_idx = 0u; thread_idx < num_threads; ++thread_idx) {
+      CHECK(loaded_queue.PushBlockingIfFull(nullptr, max_queue_size));
     }
-
-    switch (depth_resource_type) {
-      case backend::ResourceType::kPointCloudXYZRGBN: {
-        resources::PointCloud point_cloud;
-        stereo::convertDisparityMapToPointCloud(
-            disparity_map, first_image_rectified, matcher.baseline(),
-            matcher.focal_length(), matcher.cx(), matcher.cy(),
-            matcher.sad_window_size(), matcher.min_disparity(),
-            matcher.num_disparities(), &point_cloud);
-
-        if (point_cloud.size() > 0) {
-          storeFrameResourceWithOptionalOverwrite(
-              point_cloud, first_camera_idx, depth_resource_type, vertex_ptr,
-              vi_map);
-        } else {
-          VLOG(3) << "No 3D points reconstructed.";
+  });
+
+  common::ThreadSafeQueue<StereoFramePtr> matched_queue;
+  std::vector<std::thread> matching_threads;
+  for (size_t thread_idx = 0u; thread_idx < num_threads; ++thread_idx) {
+    matching_threads.emplace_back([&]() {
+      const stereo::StereoMatcher matcher(
+          first_camera, second_camera, T_C2_C1, config, undistorter_cache);
+      StereoFramePtr frame;
+      while (loaded_queue.PopBlocking(&frame) && frame) {
+        if (frame->has_images) {
+          computeDepthOfStereoFrame(
+              matcher, first_camera, depth_resource_type,
+              static_cast<bool>(depth_callback), frame.get());
         }
-
-        break;
+        CHECK(matched_queue.PushBlockingIfFull(frame, max_queue_size));
       }
-      case backend::ResourceType::kRawDepthMap: {
-        cv::Mat depth_map;
-        stereo::convertDisparityMapToDepthMap(
-            disparity_map, first_image_rectified, matcher.baseline(),
-            matcher.focal_length(), matcher.cx(), matcher.cy(),
-            matcher.sad_window_size(), matcher.min_disparity(),
-            matcher.num_disparities(), first_camera, &depth_map);
-
-        storeFrameResourceWithOptionalOverwrite(
-            depth_map, first_camera_idx, depth_resource_type, vertex_ptr,
-            vi_map);
+      CHECK(matched_queue.PushBlockingIfFull(nullptr, max_queue_size));
+    });
+  }
 
-        if (FLAGS_dense_stereo_images_and_result_in_ocv_windows) {
-          cv::Mat color_map_depth;
-          generateColorMap(depth_map, &color_map_depth);
-          cv::imshow(kDepthMapWindowName, color_map_depth);
-        }
-        break;
-      }
-      default:
-        LOG(FATAL)
-            << "Resource type '"
-            << backend::ResourceTypeNames[static_cast<int>(depth_resource_type)]
-            << "' is not supported as output format of the stereo dense "
-            << "reconstruction.";
+  size_t num_finished_matching_threads = 0u;
+  while (num_finished_matching_threads < num_threads) {
+    StereoFramePtr frame;
+    CHECK(matched_queue.PopBlocking(&frame));
+    if (!frame) {
+      ++num_finished_matching_threads;
+      continue;
     }
-
-    if (FLAGS_dense_stereo_images_and_result_in_ocv_windows) {
-      cv::waitKey(1);
+    if (frame->has_images) {
+      if (FLAGS_dense_stereo_images_and_result_in_ocv_windows) {
+        showStereoFrame(depth_resource_type, *frame);
+      }
+      if (store_depth_resources) {
+        storeDepthOfStereoFrame(
+            first_camera_idx, depth_resource_type, *frame, vi_map);
+      }
+      if (depth_callback) {
+        StereoDepth depth;
+        depth.vertex = frame->vertex_ptr;
+        depth.camera_idx = first_camera_idx;
+        depth.image = frame->first_image;
+        depth.depth_map = frame->depth_map;
+        depth.point_cloud = std::move(frame->point_cloud);
+        depth_callback(depth);
+      }
+    } else {
+      VLOG(3) << "Skipping vertex " << frame->vertex_ptr->id()
+              << " - no suitable image was found.";
     }
     progress_bar.increment();
   }
 
+  loading_thread.join();
+  for (std::thread& matching_thread : matching_threads) {
+    matching_thread.join();
+  }
+
   if (FLAGS_dense_stereo_images_and_result_in_ocv_windows) {
     cv::destroyAllWindows();
   }
@@ -18,6 +18,11 @@ DEFINE_double(
     dense_stereo_downscaling_factor, 1.0,
     "Downscaling factor applied to the images prior to stereo matching.");
 
+DEFINE_string(
+    dense_stereo_matcher_backend, "cpu",
+    "Stereo matcher backend, 'cpu' runs OpenCV's SGBM/BM, 'cuda' runs "
+    "OpenCV's CUDA SGM with the SGBM parameters if available.");
+
 DEFINE_bool(dense_stereo_use_sgbm, true, "Use SGBM if enabled, BM otherwise.");
 
 DEFINE_int32(dense_stereo_sgbm_min_disparity, 0, "");
@@ -77,6 +82,7 @@ StereoMatcherConfig StereoMatcherConfig::getFromGflags() {
 
   // General config:
   config.downscaling_factor = FLAGS_dense_stereo_downscaling_factor;
+  config.backend = FLAGS_dense_stereo_matcher_backend;
   config.use_sgbm = FLAGS_dense_stereo_use_sgbm;
 
   // SGBM config:
@@ -111,6 +117,12 @@ StereoMatcherConfig StereoMatcherConfig::getFromGflags() {
 StereoMatcher::StereoMatcher(
     const aslam::Camera& first_camera, const aslam::Camera& second_camera,
     const aslam::Transformation& T_C2_C1, const StereoMatcherConfig& config)
+    : StereoMatcher(first_camera, second_camera, T_C2_C1, config, nullptr) {}
+
+StereoMatcher::StereoMatcher(
+    const aslam::Camera& first_camera, const aslam::Camera& second_camera,
+    const aslam::Transformation& T_C2_C1, const StereoMatcherConfig& config,
+    UndistorterCache* undistorter_cache)
     : config_(config),
       first_camera_(first_camera),
       second_camera_(second_camera),
@@ -122,36 +134,24 @@ StereoMatcher::StereoMatcher(
       first_camera_, second_camera_, T_C2_C1_, config_.downscaling_factor,
       &stereo_camera_params_);
 
-  undistorter_first_.reset(new Undistorter(stereo_camera_params_.getFirst()));
-  undistorter_second_.reset(new Undistorter(stereo_camera_params_.getSecond()));
-
-  if (config_.use_sgbm) {
-    VLOG(1) << "Stereo matching algorithm used: SGBM";
-    stereo_matcher_ = cv::StereoSGBM::create(
-        config_.sgbm_min_disparity, config_.sgbm_num_disparities,
-        config_.sgbm_sad_window_size, config_.sgbm_p1, config_.sgbm_p2,
-        config_.sgbm_disp12_max_diff, config_.sgbm_pre_filter_cap,
-        config_.sgbm_uniqueness_ratio, config_.sgbm_speckle_window_size,
-        config_.sgbm_speckle_range, config_.sgbm_mode);
+  if (undistorter_cache != nullptr) {
+    undistorter_first_ =
+        undistorter_cache->getUndistorter(stereo_camera_params_.getFirst());
+    undistorter_second_ =
+        undistorter_cache->getUndistorter(stereo_camera_params_.getSecond());
+  } else {
+    undistorter_first_.reset(
+        new Undistorter(stereo_camera_params_.getFirst()));
+    undistorter_second_.reset(
+        new Undistorter(stereo_camera_params_.getSecond()));
+  }
 
+  disparity_matcher_ = DisparityMatcherBackend::create(config_);
+  if (disparity_matcher_->usesSgbmParameters()) {
     min_disparity_ = config_.sgbm_min_disparity;
     num_disparities_ = config_.sgbm_num_disparities;
     sad_window_size_ = config_.sgbm_sad_window_size;
   } else {
-    VLOG(1) << "Stereo matching algorithm used: BM";
-    stereo_matcher_ = cv::StereoBM::create(
-        config_.bm_num_disparities, config_.bm_sad_window_size);
-
-    cv::StereoBM* bm_ptr = static_cast<cv::StereoBM*>(stereo_matcher_.get());
-    bm_ptr->setPreFilterCap(config_.bm_pre_filter_cap);
-    bm_ptr->setPreFilterSize(config_.bm_pre_filter_size);
-    bm_ptr->setMinDisparity(config_.bm_min_disparity);
-    bm_ptr->setTextureThreshold(config_.bm_texture_threshold);
-    bm_ptr->setUniquenessRatio(config_.bm_uniqueness_ratio);
-    bm_ptr->setSpeckleRange(config_.bm_speckle_range);
-    bm_ptr->setSpeckleWindowSize(config_.bm_speckle_window_size);
-    bm_ptr->setDisp12MaxDiff(config_.bm_disp12_max_diff);
-
     min_disparity_ = config_.bm_min_disparity;
     num_disparities_ = config_.bm_num_disparities;
     sad_window_size_ = config_.bm_sad_window_size;
@@ -186,15 +186,15 @@ void StereoMatcher::computeDisparityMap(
   CHECK_NOTNULL(second_image_undistorted);
   CHECK(undistorter_first_);
   CHECK(undistorter_second_);
-  CHECK(stereo_matcher_);
+  CHECK(disparity_matcher_);
 
   VLOG(5) << "Undistorting and rectifying images...";
   undistorter_first_->undistortImage(first_image, first_image_undistorted);
   undistorter_second_->undistortImage(second_image, second_image_undistorted);
 
   VLOG(5) << "Computing disparity map...";
-  stereo_matcher_->compute(
-      *first_image_undistorted, *second_image_undistorted, *disparity_map);
+  disparity_matcher_->compute(
+      *first_image_undistorted, *second_image_undistorted, disparity_map);
   VLOG(5) << "Done.";
 }
 
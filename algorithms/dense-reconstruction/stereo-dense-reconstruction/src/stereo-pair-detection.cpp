@@ -1,5 +1,6 @@
 #include "dense-reconstruction/stereo-pair-detection.h"
 
+#include <cmath>
 #include <sstream>
 #include <unordered_map>
 
@@ -151,73 +152,104 @@ void printStereoCamerasPerMission(
   VLOG(verbosity) << ss.str();
 }
 
-void findAllStereoCameras(
-    const vi_map::VIMap& vi_map,
-    StereoPairsPerMissionMap* stereo_camera_ids_per_mission) {
-  CHECK_NOTNULL(stereo_camera_ids_per_mission);
-
-  vi_map::MissionIdList all_mission_ids;
-  vi_map.getAllMissionIds(&all_mission_ids);
-  for (const vi_map::MissionId& mission_id : all_mission_ids) {
-    const vi_map::SensorManager& sensor_manager = vi_map.getSensorManager();
-    const aslam::NCamera& ncamera =
-        sensor_manager.getNCameraForMission(mission_id);
-
-    std::unordered_map<size_t, size_t> pairs_found;
-
-    for (size_t first_camera_idx = 0u;
-         first_camera_idx < ncamera.getNumCameras(); ++first_camera_idx) {
-      const aslam::Camera& first_camera = ncamera.getCamera(first_camera_idx);
+namespace {
+// Finds the stereo pairs among the cameras of a camera rig.
+void findStereoPairsOfNCamera(
+    const aslam::NCamera& ncamera, StereoPairIdsVector* stereo_pairs) {
+  CHECK_NOTNULL(stereo_pairs)->clear();
+  std::unordered_map<size_t, size_t> pairs_found;
+
+  for (size_t first_camera_idx = 0u;
+       first_camera_idx < ncamera.getNumCameras(); ++first_camera_idx) {
+    const aslam::Camera& first_camera = ncamera.getCamera(first_camera_idx);
+
+    for (size_t second_camera_idx = 0u;
+         second_camera_idx < ncamera.getNumCameras(); ++second_camera_idx) {
+      if (first_camera_idx == second_camera_idx) {
+        continue;
+      }
 
-      for (size_t second_camera_idx = 0u;
-           second_camera_idx < ncamera.getNumCameras(); ++second_camera_idx) {
-        if (first_camera_idx == second_camera_idx) {
+      // Make sure we didn't discover the opposite direciton already.
+      if (pairs_found.count(second_camera_idx) > 0u) {
+        if (pairs_found[second_camera_idx] == first_camera_idx) {
           continue;
         }
+      }
 
-        // Make sure we didn't discover the opposite direciton already.
-        if (pairs_found.count(second_camera_idx) > 0u) {
-          if (pairs_found[second_camera_idx] == first_camera_idx) {
-            continue;
-          }
-        }
-
-        CHECK_LT(second_camera_idx, ncamera.getNumCameras());
-        const aslam::Camera& second_camera =
-            ncamera.getCamera(second_camera_idx);
+      CHECK_LT(second_camera_idx, ncamera.getNumCameras());
+      const aslam::Camera& second_camera =
+          ncamera.getCamera(second_camera_idx);
+
+      const aslam::Transformation& T_C1_B =
+          ncamera.get_T_C_B(first_camera_idx);
+      const aslam::Transformation& T_C2_B =
+          ncamera.get_T_C_B(second_camera_idx);
+      const aslam::Transformation T_C2_C1 = T_C2_B * T_C1_B.inverse();
+
+      // Reject pairs with a too short baseline or too different viewing
+      // directions before projecting the epipoles.
+      const double angle_between_optical_axis =
+          std::acos(T_C2_C1.getRotationMatrix()(2, 2));
+      if (T_C2_C1.getPosition().norm() <= FLAGS_dense_stereo_min_baseline ||
+          angle_between_optical_axis >
+              FLAGS_dense_stereo_max_angle_between_opt_axes) {
+        continue;
+      }
 
-        const aslam::Transformation& T_C1_B =
-            ncamera.get_T_C_B(first_camera_idx);
-        const aslam::Transformation& T_C2_B =
-            ncamera.get_T_C_B(second_camera_idx);
-        const aslam::Transformation T_C2_C1 = T_C2_B * T_C1_B.inverse();
+      StereoPairMetrics stereo_metrics;
+      computeStereoPairMetrics(
+          first_camera, second_camera, T_C2_C1, &stereo_metrics);
 
-        StereoPairMetrics stereo_metrics;
-        computeStereoPairMetrics(
-            first_camera, second_camera, T_C2_C1, &stereo_metrics);
+      if (!isStereoCamera(stereo_metrics)) {
+        continue;
+      }
 
-        if (!isStereoCamera(stereo_metrics)) {
-          continue;
-        }
+      // Write the pair into this map to prevent discovery of another stereo
+      // camera with these two cameras.
+      pairs_found[first_camera_idx] = second_camera_idx;
+
+      // Store stereo pair.
+      StereoPairIdentifier identifier;
+      identifier.first_camera_id = first_camera.getId();
+      identifier.second_camera_id = second_camera.getId();
+      identifier.T_C2_C1 = T_C2_C1;
+      stereo_pairs->push_back(identifier);
+
+      // Found a stereo pair with the current first_camera_idx as first
+      // camera. This camera should not be the first camera for another
+      // pair, because it would overwrite the depth resource of the first
+      // reconstruction.
+      break;
+    }
+  }
+}
+}  // namespace
 
-        // Write the pair into this map to prevent discovery of another stereo
-        // camera with these two cameras.
-        pairs_found[first_camera_idx] = second_camera_idx;
+void findAllStereoCameras(
+    const vi_map::VIMap& vi_map,
+    StereoPairsPerMissionMap* stereo_camera_ids_per_mission) {
+  CHECK_NOTNULL(stereo_camera_ids_per_mission);
 
-        // Store stereo pair.
-        StereoPairIdentifier identifier;
-        identifier.first_camera_id = first_camera.getId();
-        identifier.second_camera_id = second_camera.getId();
-        identifier.T_C2_C1 = T_C2_C1;
+  // Missions recorded with the same camera rig share the stereo pairs, so
+  // every rig is only evaluated once.
+  std::unordered_map<aslam::NCameraId, StereoPairIdsVector> pairs_per_ncamera;
 
-        (*stereo_camera_ids_per_mission)[mission_id].push_back(identifier);
+  vi_map::MissionIdList all_mission_ids;
+  vi_map.getAllMissionIds(&all_mission_ids);
+  const vi_map::SensorManager& sensor_manager = vi_map.getSensorManager();
+  for (const vi_map::MissionId& mission_id : all_mission_ids) {
+    const aslam::NCamera& ncamera =
+        sensor_manager.getNCameraForMission(mission_id);
 
-        // Found a stereo pair with the current first_camera_idx as first
-        // camera. This camera should not be the first camera for another
-        // pair, because it would overwrite the depth resource of the first
-        // reconstruction.
-        break;
-      }
+    std::unordered_map<aslam::NCameraId, StereoPairIdsVector>::iterator it =
+        pairs_per_ncamera.find(ncamera.getId());
+    if (it == pairs_per_ncamera.end()) {
+      it = pairs_per_ncamera.emplace(ncamera.getId(), StereoPairIdsVector())
+               .first;
+      findStereoPairsOfNCamera(ncamera, &it->second);
+    }
+    if (!it->second.empty()) {
+      (*stereo_camera_ids_per_mission)[mission_id] = it->second;
     }
   }
 }
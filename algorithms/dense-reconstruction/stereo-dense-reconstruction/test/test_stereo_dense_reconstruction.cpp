@@ -14,6 +14,7 @@
 #include <opencv2/opencv.hpp>
 
 #include "dense-reconstruction/disparity-conversion-utils.h"
+#include "dense-reconstruction/disparity-matcher-backend.h"
 #include "dense-reconstruction/resource-utils.h"
 #include "dense-reconstruction/stereo-camera-utils.h"
 #include "dense-reconstruction/stereo-matcher.h"
@@ -341,6 +342,72 @@ TEST_F(StereoDenseReconstructionTest, TestStereoDenseReconstructionKitti) {
   computeStereoReconstruction("kitti", 388692u);
 }
 
+TEST_F(StereoDenseReconstructionTest, TestUndistorterCache) {
+  setupKittiStereoDataset();
+  StereoCameraParameters stereo_camera_parameters(scale_);
+  stereo_camera_parameters.setInputCameraParameters(
+      resolution_, T_C1_G_, K_left_, D_left_, DistortionModel::RADTAN,
+      CameraSide::FIRST);
+  stereo_camera_parameters.setInputCameraParameters(
+      resolution_, T_C2_G_, K_right_, D_right_, DistortionModel::RADTAN,
+      CameraSide::SECOND);
+
+  UndistorterCache undistorter_cache;
+  const std::shared_ptr<const Undistorter> undistorter_left =
+      undistorter_cache.getUndistorter(stereo_camera_parameters.getFirst());
+  const std::shared_ptr<const Undistorter> undistorter_right =
+      undistorter_cache.getUndistorter(stereo_camera_parameters.getSecond());
+  EXPECT_NE(undistorter_left, undistorter_right);
+  EXPECT_EQ(
+      undistorter_left,
+      undistorter_cache.getUndistorter(stereo_camera_parameters.getFirst()));
+  EXPECT_EQ(
+      undistorter_right,
+      undistorter_cache.getUndistorter(stereo_camera_parameters.getSecond()));
+  EXPECT_EQ(undistorter_cache.size(), 2u);
+
+  // The cached maps undistort the same way as a new undistorter.
+  const Undistorter undistorter_left_uncached(
+      stereo_camera_parameters.getFirst());
+  cv::Mat img_left_undistorted;
+  undistorter_left->undistortImage(img_left_, &img_left_undistorted);
+  cv::Mat img_left_undistorted_uncached;
+  undistorter_left_uncached.undistortImage(
+      img_left_, &img_left_undistorted_uncached);
+  EXPECT_TRUE(
+      compareImages(img_left_undistorted, img_left_undistorted_uncached));
+}
+
+TEST_F(StereoDenseReconstructionTest, TestCpuDisparityMatcherBackend) {
+  setupKittiStereoDataset();
+  StereoCameraParameters stereo_camera_parameters(scale_);
+  stereo_camera_parameters.setInputCameraParameters(
+      resolution_, T_C1_G_, K_left_, D_left_, DistortionModel::RADTAN,
+      CameraSide::FIRST);
+  stereo_camera_parameters.setInputCameraParameters(
+      resolution_, T_C2_G_, K_right_, D_right_, DistortionModel::RADTAN,
+      CameraSide::SECOND);
+  const Undistorter undistorter_left(stereo_camera_parameters.getFirst());
+  const Undistorter undistorter_right(stereo_camera_parameters.getSecond());
+  cv::Mat img_left_undistorted, img_right_undistorted;
+  undistorter_left.undistortImage(img_left_, &img_left_undistorted);
+  undistorter_right.undistortImage(img_right_, &img_right_undistorted);
+
+  config_.backend = "cpu";
+  std::unique_ptr<DisparityMatcherBackend> backend =
+      DisparityMatcherBackend::create(config_);
+  ASSERT_TRUE(backend != nullptr);
+  EXPECT_EQ(backend->usesSgbmParameters(), config_.use_sgbm);
+
+  cv::Mat img_disparity_backend;
+  backend->compute(
+      img_left_undistorted, img_right_undistorted, &img_disparity_backend);
+  cv::Mat img_disparity;
+  stereo_matcher_->compute(
+      img_left_undistorted, img_right_undistorted, img_disparity);
+  EXPECT_TRUE(compareImages(img_disparity_backend, img_disparity));
+}
+
 }  // namespace stereo
 }  // namespace dense_reconstruction
 
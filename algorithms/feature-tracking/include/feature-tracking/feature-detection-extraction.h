@@ -1,6 +1,8 @@
 #ifndef FEATURE_TRACKING_FEATURE_DETECTION_EXTRACTION_H_
 #define FEATURE_TRACKING_FEATURE_DETECTION_EXTRACTION_H_
 
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -22,11 +24,25 @@ class FeatureDetectorExtractor {
  public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
   explicit FeatureDetectorExtractor(const aslam::Camera& camera);
+  ~FeatureDetectorExtractor();
   void detectAndExtractFeatures(aslam::VisualFrame* frame) const;
+  // Same as calling detectAndExtractFeatures on every frame. With the CUDA
+  // detector backend the uploads and detections of all frames are queued
+  // at once, such that the transfers overlap with the detection.
+  void detectAndExtractFeatures(
+      const std::vector<aslam::VisualFrame*>& frames) const;
   cv::Ptr<cv::DescriptorExtractor> getExtractorPtr() const;
 
  private:
+  class CudaDetector;
+
   void initialize();
+  void detectKeypoints(
+      const cv::Mat& image, std::vector<cv::KeyPoint>* keypoints_cv) const;
+  // Post-processes the detected keypoints, or detects them on the CPU if no
+  // CUDA detector is used, and extracts their descriptors.
+  void extractFeatures(
+      std::vector<cv::KeyPoint>* keypoints, aslam::VisualFrame* frame) const;
 
   /// \brief  A simple non-maximum suppression algorithm that erases keypoints
   ///         in a specified radius around a queried keypoint if their response
@@ -47,6 +63,11 @@ class FeatureDetectorExtractor {
   cv::Ptr<cv::FeatureDetector> detector_;
   cv::Ptr<cv::DescriptorExtractor> extractor_;
 
+  // Only set if the CUDA detector backend is used. Guarded by m_cuda_detector_
+  // as the device buffers are reused across calls.
+  std::unique_ptr<CudaDetector> cuda_detector_;
+  mutable std::mutex m_cuda_detector_;
+
  public:
   // Descriptor extractor settings are stored in this struct.
   const SweFeatureTrackingExtractorSettings extractor_settings_;
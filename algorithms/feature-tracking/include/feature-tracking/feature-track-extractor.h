@@ -1,6 +1,7 @@
 #ifndef FEATURE_TRACKING_FEATURE_TRACK_EXTRACTOR_H_
 #define FEATURE_TRACKING_FEATURE_TRACK_EXTRACTOR_H_
 
+#include <deque>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -9,6 +10,7 @@
 #include <Eigen/Dense>
 #include <aslam/common/memory.h>
 #include <aslam/frames/feature-track.h>
+#include <glog/logging.h>
 #include <maplab-common/macros.h>
 
 namespace aslam {
@@ -19,6 +21,73 @@ class VisualNFrame;
 
 namespace vio_common {
 
+/// \class FeatureTrackObservationPool
+/// \brief Stores the keypoint observations of the active feature tracks as
+///        flat arrays of nframe indices and keypoint indices, one pair of
+///        arrays per slot. Slots of finished tracks are recycled through a
+///        free list and keep the capacity of their arrays, such that extending
+///        a track does not allocate once the pool has warmed up.
+class FeatureTrackObservationPool {
+ public:
+  /// Returns a slot without observations.
+  size_t acquireSlot() {
+    if (free_slots_.empty()) {
+      nframe_indices_.emplace_back();
+      keypoint_indices_.emplace_back();
+      return nframe_indices_.size() - 1u;
+    }
+    const size_t slot = free_slots_.back();
+    free_slots_.pop_back();
+    return slot;
+  }
+
+  /// Clears the observations of the slot and returns it to the free list.
+  void releaseSlot(size_t slot) {
+    clearObservations(slot);
+    free_slots_.push_back(slot);
+  }
+
+  /// Returns all slots to the free list.
+  void releaseAllSlots() {
+    free_slots_.clear();
+    for (size_t slot = nframe_indices_.size(); slot > 0u; --slot) {
+      releaseSlot(slot - 1u);
+    }
+  }
+
+  void clearObservations(size_t slot) {
+    DCHECK_LT(slot, nframe_indices_.size());
+    nframe_indices_[slot].clear();
+    keypoint_indices_[slot].clear();
+  }
+
+  void addObservation(size_t slot, size_t nframe_index, int keypoint_index) {
+    DCHECK_LT(slot, nframe_indices_.size());
+    nframe_indices_[slot].push_back(nframe_index);
+    keypoint_indices_[slot].push_back(keypoint_index);
+  }
+
+  size_t getNumObservations(size_t slot) const {
+    DCHECK_LT(slot, nframe_indices_.size());
+    return nframe_indices_[slot].size();
+  }
+
+  const std::vector<size_t>& getNFrameIndices(size_t slot) const {
+    DCHECK_LT(slot, nframe_indices_.size());
+    return nframe_indices_[slot];
+  }
+
+  const std::vector<int>& getKeypointIndices(size_t slot) const {
+    DCHECK_LT(slot, keypoint_indices_.size());
+    return keypoint_indices_[slot];
+  }
+
+ private:
+  std::vector<std::vector<size_t>> nframe_indices_;
+  std::vector<std::vector<int>> keypoint_indices_;
+  std::vector<size_t> free_slots_;
+};
+
 /// \class FeatureTrackExtractor
 /// \brief This class can be used to extract feature tracks from a stream of
 /// VisualFrames that
@@ -159,22 +228,45 @@ class FeatureTrackExtractor {
   /// \name Internal implementations.
   /// @{
  private:
-  /// Single camera implementation for the stream extractor.
+  /// Single camera implementation for the stream extractor. nframe_index is
+  /// the index of the nframe in the nframe history.
   void extractFromFrameStreamImpl(
-      const aslam::VisualNFrame::ConstPtr& nframe, size_t camera_idx,
-      bool track_persistent_features,
+      const aslam::VisualNFrame::ConstPtr& nframe, size_t nframe_index,
+      size_t camera_idx, bool track_persistent_features,
       aslam::FeatureTracks* tracks_opportunistic_terminated,
       aslam::FeatureTracks* tracks_persistent_new,
       aslam::ContinuedFeatureTracks* tracks_persistent_contiued,
       std::unordered_set<int>* tracks_persistent_terminated);
+
+  /// Appends the nframe to the nframe history and returns its index.
+  size_t addNFrameToHistory(const aslam::VisualNFrame::ConstPtr& nframe);
+  /// Drops the nframes from the history that are neither referenced by an
+  /// active opportunistic track nor the previous nframe.
+  void pruneNFrameHistory();
+
+  /// Builds the feature track of the observations stored in the slot.
+  aslam::FeatureTrack createFeatureTrack(
+      int track_id, size_t camera_idx, size_t slot) const;
   /// @}
 
  private:
   const std::shared_ptr<const aslam::NCamera> camera_rig_;
 
-  typedef std::unordered_map<int, aslam::FeatureTrack> TrackIdToFeatureTrackMap;
-  /// Currently opportunistic tracks stored with their id.
-  std::vector<TrackIdToFeatureTrackMap> opportunistic_tracks_;
+  typedef std::unordered_map<int, size_t> TrackIdToSlotMap;
+  /// Currently opportunistic tracks stored with their id and the slot of their
+  /// observations in the observation pool.
+  std::vector<TrackIdToSlotMap> opportunistic_tracks_;
+  FeatureTrackObservationPool observation_pool_;
+  /// NFrames referenced by the observations in the pool. The nframe with index
+  /// i is stored at nframe_history_[i - nframe_history_begin_].
+  std::deque<std::shared_ptr<const aslam::VisualNFrame>> nframe_history_;
+  size_t nframe_history_begin_;
+
+  /// Buffers of extractFromFrameStreamImpl that are reused for every frame.
+  /// The track id to keypoint index pairs of the previous frame and the track
+  /// ids of the current frame, both sorted by track id.
+  std::vector<std::pair<int, int>> previous_frame_track_id_keypoint_index_;
+  std::vector<int> present_track_ids_;
   /// Currently persistent tracks stored with their id.
   std::vector<std::unordered_set<int>> persistent_trackids_;
   /// Pointer to the previous frame.
@@ -60,13 +60,29 @@ class FeatureTrackingPipeline {
 
   const std::string feature_tracking_ros_base_topic_;
   const bool visualize_keypoint_matches_;
+  /// Set while the keypoints of every nframe are detected by
+  /// detectFeaturesNFrame in a separate pipeline stage before the nframe is
+  /// passed to trackFeaturesNFrame.
+  bool features_detected_in_separate_stage_;
 
  private:
   virtual void initialize(const aslam::NCamera::ConstPtr& ncamera) = 0;
+  virtual void detectFeaturesNFrame(aslam::VisualNFrame* nframe) = 0;
   virtual void trackFeaturesNFrame(
       const aslam::Transformation& T_Bk_Bkp1, aslam::VisualNFrame* nframe_k,
       aslam::VisualNFrame* nframe_kp1) = 0;
 
+  // Loads the images, tracks the features and triangulates the tracks of the
+  // given vertices one after the other.
+  void runTrackingAndTriangulationSequentially(
+      const pose_graph::VertexIdList& vertex_ids, vi_map::VIMap* map);
+
+  // Same as above with bounded queues between the stages, which run
+  // concurrently: loading the raw images, detecting the keypoints, tracking
+  // the nframes in order and triangulating the terminated tracks.
+  void runTrackingAndTriangulationPipelined(
+      const pose_graph::VertexIdList& vertex_ids, vi_map::VIMap* map);
+
   // Loads the raw-images specified in the resources table of the given map and
   // assigns them to the frames of the nframe of the given vertex.
   void assignRawImagesToNFrame(
@@ -77,6 +93,18 @@ class FeatureTrackingPipeline {
   void extractAndTriangulateTerminatedFeatureTracks(
       const aslam::VisualNFrame::ConstPtr& nframe, vi_map::VIMap* map);
 
+  // Returns the feature tracks that terminated before the given nframe.
+  void extractTerminatedFeatureTracks(
+      const aslam::VisualNFrame::ConstPtr& nframe,
+      aslam::FeatureTracksList* terminated_tracks);
+
+  // Triangulates the given feature tracks and adds the successfully
+  // triangulated landmarks to the map.
+  void triangulateFeatureTracks(
+      const aslam::FeatureTracksList& tracks, vi_map::VIMap* map);
+
+  void visualizeKeypoints(const aslam::VisualNFrame::ConstPtr& nframe) const;
+
   aslam_cv_visualization::VisualNFrameFeatureTrackVisualizer
       feature_track_visualizer_;
 
@@ -80,6 +80,9 @@ struct SweFeatureTrackingDetectorSettings {
   size_t min_tracking_distance_to_image_border_px;
 
   double keypoint_uncertainty_px;
+
+  // Backend of the keypoint detection, either "cpu" or "cuda".
+  std::string detector_backend;
 };
 
 }  // namespace feature_tracking
@@ -2,6 +2,7 @@
 #define FEATURE_TRACKING_GRIDED_DETECTOR_H_
 #include <algorithm>
 #include <array>
+#include <cmath>
 #include <vector>
 
 #include <aslam/frames/visual-frame.h>
@@ -44,21 +45,19 @@ inline void localNonMaximumSuppression(
 
   typedef std::vector<KeyPointData>::const_iterator KeyPointDataIterator;
 
-  std::function<bool(const KeyPointData&, KeyPointDataIterator)>  // NOLINT
-      IsInsideCircle = [radius_sq](
-          const KeyPointData& keypoint_1,
-          KeyPointDataIterator keypoint_iterator_2) -> bool {
-    const float x_diff =
-        keypoint_1.coordinates[0] - keypoint_iterator_2->coordinates[0];
-    const float y_diff =
-        keypoint_1.coordinates[1] - keypoint_iterator_2->coordinates[1];
+  // Plain lambdas instead of std::function, such that the compiler can inline
+  // the predicates into the inner loop.
+  auto IsInsideCircle = [radius_sq](
+      const KeyPointData& keypoint_1,
+      const KeyPointData& keypoint_2) -> bool {
+    const float x_diff = keypoint_1.coordinates[0] - keypoint_2.coordinates[0];
+    const float y_diff = keypoint_1.coordinates[1] - keypoint_2.coordinates[1];
     return (x_diff * x_diff + y_diff * y_diff) < radius_sq;
   };
 
-  std::function<size_t(const int, const int, const int)> Clamp =
-      [](  // NOLINT
-          const int lower, const int upper, const int in) -> size_t {
-    return std::min<int>(std::max<int>(in, lower), upper);
+  const int max_row = static_cast<int>(image_height - 1u);
+  auto ClampRow = [max_row](const float y) -> size_t {
+    return std::min<int>(std::max<int>(static_cast<int>(y), 0), max_row);
   };
 
   std::vector<KeyPointData> keypoint_data_vector;
@@ -67,73 +66,79 @@ inline void localNonMaximumSuppression(
     keypoint_data_vector.emplace_back((*keypoints)[i], i);
   }
 
-  // Create LUT of keypoints in y axis.
+  // Create LUT of keypoints in y axis. The LUT only covers the rows that are
+  // searched for the given keypoints, such that suppressing the keypoints of
+  // a small image region does not scale with the image height.
   std::sort(
       keypoint_data_vector.begin(), keypoint_data_vector.end(),
       [](const KeyPointData& lhs, const KeyPointData& rhs) -> bool {
         return lhs.coordinates[1] < rhs.coordinates[1];
       });
+  const size_t first_row = ClampRow(
+      std::floor(keypoint_data_vector.front().coordinates[1] - radius));
+  const size_t last_row = ClampRow(
+      std::ceil(keypoint_data_vector.back().coordinates[1] + radius));
 
   std::vector<size_t> corner_row_LUT;
-  corner_row_LUT.reserve(image_height);
+  corner_row_LUT.reserve(last_row - first_row + 1u);
 
   size_t num_kpts_below_y = 0u;
-  for (size_t y = 0u; y < image_height; ++y) {
+  for (size_t y = first_row; y <= last_row; ++y) {
     while (num_kpts_below_y < num_keypoints &&
            y > keypoint_data_vector[num_kpts_below_y].coordinates[1]) {
       ++num_kpts_below_y;
     }
     corner_row_LUT.push_back(num_kpts_below_y);
   }
-  CHECK_EQ(num_kpts_below_y, keypoint_data_vector.size());
 
   // Create a list of keypoints to reject.
-  std::vector<bool> erase_keypoints(num_keypoints, false);
+  std::vector<unsigned char> erase_keypoints(num_keypoints, 0u);
 
   for (size_t i = 0u; i < num_keypoints; ++i) {
     const KeyPointData& current_keypoint_data = keypoint_data_vector[i];
-    const size_t y_top = Clamp(
-        0, static_cast<int>(image_height - 1),
-        std::floor(current_keypoint_data.coordinates[1] - radius));
-    const size_t y_bottom = Clamp(
-        0, static_cast<int>(image_height - 1),
-        std::ceil(current_keypoint_data.coordinates[1] + radius));
-    CHECK_LT(y_top, image_height);
-    CHECK_LE(y_bottom, image_height);
-
-    CHECK_LT(corner_row_LUT[y_top], keypoint_data_vector.size());
-    CHECK_LE(corner_row_LUT[y_bottom], keypoint_data_vector.size());
-    KeyPointDataIterator nearest_corners_begin =
-        keypoint_data_vector.begin() + corner_row_LUT[y_top];
-    KeyPointDataIterator nearest_corners_end =
-        keypoint_data_vector.begin() + corner_row_LUT[y_bottom];
-
+    const size_t y_top =
+        ClampRow(std::floor(current_keypoint_data.coordinates[1] - radius));
+    const size_t y_bottom =
+        ClampRow(std::ceil(current_keypoint_data.coordinates[1] + radius));
+    DCHECK_GE(y_top, first_row);
+    DCHECK_LE(y_bottom, last_row);
+
+    const KeyPointDataIterator nearest_corners_begin =
+        keypoint_data_vector.begin() + corner_row_LUT[y_top - first_row];
+    const KeyPointDataIterator nearest_corners_end =
+        keypoint_data_vector.begin() + corner_row_LUT[y_bottom - first_row];
+
+    const float response_threshold =
+        ratio_threshold * current_keypoint_data.response;
     for (KeyPointDataIterator it = nearest_corners_begin;
          it != nearest_corners_end; ++it) {
       if (it->keypoint_index == current_keypoint_data.keypoint_index ||
-          erase_keypoints[it->keypoint_index] ||
-          !IsInsideCircle(current_keypoint_data, it)) {
+          erase_keypoints[it->keypoint_index] != 0u ||
+          !IsInsideCircle(current_keypoint_data, *it)) {
         continue;
       }
-      const float response_threshold =
-          ratio_threshold * current_keypoint_data.response;
       if (response_threshold > it->response) {
-        erase_keypoints[it->keypoint_index] = true;
+        erase_keypoints[it->keypoint_index] = 1u;
       }
     }
   }
 
   // Remove the flaged non-maximum keypoints.
-  std::vector<bool>::iterator it_erase = erase_keypoints.begin();
-
-  std::vector<cv::KeyPoint>::iterator it_erase_from = std::remove_if(
-      keypoints->begin(), keypoints->end(),
-      [&it_erase](const cv::KeyPoint & /*keypoint*/) -> bool {
-        return *it_erase++ == true;
-      });
-  keypoints->erase(it_erase_from, keypoints->end());
+  size_t num_kept_keypoints = 0u;
+  for (size_t i = 0u; i < num_keypoints; ++i) {
+    if (erase_keypoints[i] == 0u) {
+      (*keypoints)[num_kept_keypoints++] = (*keypoints)[i];
+    }
+  }
+  keypoints->resize(num_kept_keypoints);
 }
 
+// Detects the keypoints of every grid cell in parallel. Every cell is
+// detected with a border of the non-maximum suppression radius around it,
+// such that keypoints close to the cell boundaries are also suppressed by
+// stronger keypoints of the neighboring cells. Only the keypoints inside the
+// cell are kept and the keypoints of the cells are concatenated in cell order,
+// such that the result does not depend on the scheduling of the cells.
 inline void detectKeypointsGrided(
     const cv::Ptr<cv::FeatureDetector>& detector, const cv::Mat& image,
     const cv::Mat& detection_mask, size_t max_total_keypoints,
@@ -147,24 +152,35 @@ inline void detectKeypointsGrided(
     keypoints->clear();
     return;
   }
-  keypoints->reserve(max_total_keypoints);
 
   constexpr double kCellNumFeaturesScaler = 2.0;
-  int max_per_cell =
+  const int max_per_cell =
       kCellNumFeaturesScaler * max_total_keypoints / (grid_rows * grid_cols);
+  const int border_px =
+      nonmaxsuppression_radius > 0.0f
+          ? static_cast<int>(std::ceil(nonmaxsuppression_radius))
+          : 0;
 
-  std::mutex m_keypoints;
-  auto detectFeaturesOfGridCells = [&](const std::vector<size_t>& range) {
-    for (int cell_idx : range) {
-      int celly = cell_idx / grid_cols;
-      int cellx = cell_idx - celly * grid_cols;
-
-      cv::Range row_range(
+  const size_t num_cells = grid_rows * grid_cols;
+  std::vector<std::vector<cv::KeyPoint>> keypoints_of_cells(num_cells);
+  auto detectFeaturesOfGridCells = [&](
+      const size_t cell_begin, const size_t cell_end) {
+    for (size_t cell_idx = cell_begin; cell_idx < cell_end; ++cell_idx) {
+      const int celly = cell_idx / grid_cols;
+      const int cellx = cell_idx - celly * grid_cols;
+
+      const cv::Range cell_row_range(
           (celly * image.rows) / grid_rows,
           ((celly + 1) * image.rows) / grid_rows);
-      cv::Range col_range(
+      const cv::Range cell_col_range(
           (cellx * image.cols) / grid_cols,
           ((cellx + 1) * image.cols) / grid_cols);
+      const cv::Range row_range(
+          std::max(cell_row_range.start - border_px, 0),
+          std::min(cell_row_range.end + border_px, image.rows));
+      const cv::Range col_range(
+          std::max(cell_col_range.start - border_px, 0),
+          std::min(cell_col_range.end + border_px, image.cols));
 
       cv::Mat sub_image = image(row_range, col_range);
       cv::Mat sub_mask;
@@ -177,11 +193,9 @@ inline void detectKeypointsGrided(
 
       detector->detect(sub_image, sub_keypoints, sub_mask);
 
-      std::vector<cv::KeyPoint>::iterator it = sub_keypoints.begin(),
-                                          end = sub_keypoints.end();
-      for (; it != end; ++it) {
-        it->pt.x += col_range.start;
-        it->pt.y += row_range.start;
+      for (cv::KeyPoint& keypoint : sub_keypoints) {
+        keypoint.pt.x += col_range.start;
+        keypoint.pt.y += row_range.start;
       }
 
       if (nonmaxsuppression_radius > 0.0) {
@@ -190,17 +204,34 @@ inline void detectKeypointsGrided(
             nonmaxsuppression_ratio_threshold, &sub_keypoints);
       }
 
-      std::unique_lock<std::mutex> lock(m_keypoints);
-      keypoints->insert(
-          keypoints->end(), sub_keypoints.begin(), sub_keypoints.end());
+      std::vector<cv::KeyPoint>& cell_keypoints = keypoints_of_cells[cell_idx];
+      cell_keypoints.reserve(sub_keypoints.size());
+      for (const cv::KeyPoint& keypoint : sub_keypoints) {
+        if (keypoint.pt.x >= cell_col_range.start &&
+            keypoint.pt.x < cell_col_range.end &&
+            keypoint.pt.y >= cell_row_range.start &&
+            keypoint.pt.y < cell_row_range.end) {
+          cell_keypoints.push_back(keypoint);
+        }
+      }
     }
   };
 
-  const size_t num_cells = grid_rows * grid_cols;
-  const size_t num_threads = std::max(size_t(1u), num_cells / 2u);
-  common::ParallelProcess(
-      num_cells, detectFeaturesOfGridCells, /*kAlwaysParallelize=*/true,
-      num_threads);
+  const size_t num_threads =
+      std::min(num_cells, common::getNumHardwareThreads());
+  common::ParallelProcessDynamic(
+      num_cells, detectFeaturesOfGridCells, num_threads,
+      common::ParallelSchedule::kDynamic);
+
+  size_t num_keypoints = 0u;
+  for (const std::vector<cv::KeyPoint>& cell_keypoints : keypoints_of_cells) {
+    num_keypoints += cell_keypoints.size();
+  }
+  keypoints->reserve(num_keypoints);
+  for (const std::vector<cv::KeyPoint>& cell_keypoints : keypoints_of_cells) {
+    keypoints->insert(
+        keypoints->end(), cell_keypoints.begin(), cell_keypoints.end());
+  }
   cv::KeyPointsFilter::retainBest(*keypoints, max_total_keypoints);
 }
 
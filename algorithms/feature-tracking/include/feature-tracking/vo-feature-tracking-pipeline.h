@@ -31,12 +31,27 @@ class VOFeatureTrackingPipeline : public FeatureTrackingPipeline {
 
  private:
   virtual void initialize(const aslam::NCamera::ConstPtr& ncamera) override;
+  virtual void detectFeaturesNFrame(aslam::VisualNFrame* nframe) override;
   virtual void trackFeaturesNFrame(
       const aslam::Transformation& T_Bk_Bkp1, aslam::VisualNFrame* nframe_k,
       aslam::VisualNFrame* nframe_kp1) override;
 
+  // Detects features, unless they are detected in a separate stage, and
+  // matches them to the previous frame. Only touches the data of the given
+  // camera, so the cameras can run in parallel.
   void trackFeaturesSingleCamera(
       const aslam::Quaternion& q_Bkp1_Bk, const size_t camera_idx,
+      const bool detect_features_in_frame_k, aslam::VisualFrame* frame_kp1,
+      aslam::VisualFrame* frame_k,
+      aslam::FrameToFrameMatchesWithScore* inlier_matches_with_score_kp1_k,
+      aslam::FrameToFrameMatchesWithScore* outlier_matches_with_score_kp1_k);
+  // Assigns the track ids from the inlier matches.
+  void applyTracksSingleCamera(
+      const size_t camera_idx,
+      const aslam::FrameToFrameMatchesWithScore&
+          inlier_matches_with_score_kp1_k,
+      const aslam::FrameToFrameMatchesWithScore&
+          outlier_matches_with_score_kp1_k,
       aslam::VisualFrame* frame_kp1, aslam::VisualFrame* frame_k,
       aslam::FrameToFrameMatches* inlier_matches_kp1_k,
       aslam::FrameToFrameMatches* outlier_matches_kp1_k);
@@ -54,6 +69,13 @@ class VOFeatureTrackingPipeline : public FeatureTrackingPipeline {
   std::vector<std::unique_ptr<aslam::TrackManager>> track_managers_;
   /// Thread pool for tracking and track extraction.
   std::unique_ptr<aslam::ThreadPool> thread_pool_;
+  /// Keypoint detectors and descriptor extractors of the detection stage of
+  /// the pipelined tracking (one per camera). They are separate from the ones
+  /// above, as the trackers use those extractors concurrently.
+  std::vector<std::unique_ptr<FeatureDetectorExtractor>>
+      detection_stage_detectors_extractors_;
+  /// Thread pool for the detection stage of the pipelined tracking.
+  std::unique_ptr<aslam::ThreadPool> detection_stage_thread_pool_;
 
   bool has_feature_extraction_been_performed_on_first_nframe_;
 };
@@ -11,19 +11,105 @@
 #include <opencv/highgui.h>
 #include <opencv2/core/version.hpp>
 #include <opencv2/features2d.hpp>
+#include <opencv2/opencv_modules.hpp>
 #include <opencv2/xfeatures2d.hpp>
 
+#ifdef HAVE_OPENCV_CUDAFEATURES2D
+#include <opencv2/core/cuda.hpp>
+#include <opencv2/cudafeatures2d.hpp>
+#endif
+
 #include "feature-tracking/grided-detector.h"
 
 DEFINE_bool(use_grided_detections, true, "Use multiple detectors on a grid?");
 
 namespace feature_tracking {
 
+#ifdef HAVE_OPENCV_CUDAFEATURES2D
+// Runs OpenCV's CUDA ORB keypoint detection. The images are staged in
+// page-locked host buffers and all uploads and detections of a batch are
+// queued on one stream before the keypoints are downloaded. The buffers of
+// the batch slots are kept, such that frames of the same size don't
+// reallocate any memory.
+class FeatureDetectorExtractor::CudaDetector {
+ public:
+  explicit CudaDetector(const SweFeatureTrackingDetectorSettings& settings) {
+    detector_ = cv::cuda::ORB::create(
+        settings.orb_detector_number_features,
+        settings.orb_detector_scale_factor,
+        settings.orb_detector_pyramid_levels,
+        settings.orb_detector_edge_threshold,
+        settings.orb_detector_first_level, settings.orb_detector_WTA_K,
+        settings.orb_detector_score_type, settings.orb_detector_patch_size,
+        settings.orb_detector_fast_threshold);
+  }
+
+  static bool isAvailable() {
+    return cv::cuda::getCudaEnabledDeviceCount() > 0;
+  }
+
+  void detect(
+      const std::vector<const cv::Mat*>& images,
+      std::vector<std::vector<cv::KeyPoint>>* keypoints) {
+    CHECK_NOTNULL(keypoints);
+    const size_t num_images = images.size();
+    if (images_host_.size() < num_images) {
+      images_host_.resize(num_images);
+      images_device_.resize(num_images);
+      keypoints_device_.resize(num_images);
+    }
+    for (size_t idx = 0u; idx < num_images; ++idx) {
+      CHECK_EQ(CHECK_NOTNULL(images[idx])->type(), CV_8UC1)
+          << "The CUDA detector only supports 8-bit grayscale images.";
+      images[idx]->copyTo(images_host_[idx]);
+      images_device_[idx].upload(images_host_[idx], stream_);
+      detector_->detectAsync(
+          images_device_[idx], keypoints_device_[idx], cv::noArray(),
+          stream_);
+    }
+    stream_.waitForCompletion();
+
+    keypoints->resize(num_images);
+    for (size_t idx = 0u; idx < num_images; ++idx) {
+      detector_->convert(keypoints_device_[idx], (*keypoints)[idx]);
+    }
+  }
+
+ private:
+  cv::Ptr<cv::cuda::ORB> detector_;
+  cv::cuda::Stream stream_;
+
+  std::vector<cv::cuda::HostMem> images_host_;
+  std::vector<cv::cuda::GpuMat> images_device_;
+  std::vector<cv::cuda::GpuMat> keypoints_device_;
+};
+#else
+class FeatureDetectorExtractor::CudaDetector {
+ public:
+  explicit CudaDetector(
+      const SweFeatureTrackingDetectorSettings& /*settings*/) {
+    LOG(FATAL) << "OpenCV was built without CUDA feature detection.";
+  }
+
+  static bool isAvailable() {
+    return false;
+  }
+
+  void detect(
+      const std::vector<const cv::Mat*>& /*images*/,
+      std::vector<std::vector<cv::KeyPoint>>* /*keypoints*/) {
+    LOG(FATAL) << "OpenCV was built without CUDA feature detection.";
+  }
+};
+#endif
+
 FeatureDetectorExtractor::FeatureDetectorExtractor(const aslam::Camera& camera)
     : camera_(camera) {
   initialize();
 }
 
+FeatureDetectorExtractor::~FeatureDetectorExtractor() {}
+
 void FeatureDetectorExtractor::initialize() {
   CHECK_LT(
       2 * detector_settings_.min_tracking_distance_to_image_border_px,
@@ -48,6 +134,16 @@ void FeatureDetectorExtractor::initialize() {
       detector_settings_.orb_detector_patch_size,
       detector_settings_.orb_detector_fast_threshold);
 
+  if (detector_settings_.detector_backend == "cuda") {
+    if (CudaDetector::isAvailable()) {
+      VLOG(1) << "Detecting keypoints with the CUDA ORB detector.";
+      cuda_detector_.reset(new CudaDetector(detector_settings_));
+    } else {
+      LOG(WARNING) << "The CUDA feature detector backend is not available, "
+                   << "falling back to the CPU backend.";
+    }
+  }
+
   switch (extractor_settings_.descriptor_type) {
     case SweFeatureTrackingExtractorSettings::DescriptorType::kBrisk:
       extractor_ = new brisk::BriskDescriptorExtractor(
@@ -74,18 +170,44 @@ cv::Ptr<cv::DescriptorExtractor> FeatureDetectorExtractor::getExtractorPtr()
 
 void FeatureDetectorExtractor::detectAndExtractFeatures(
     aslam::VisualFrame* frame) const {
-  CHECK_NOTNULL(frame);
-  CHECK(frame->hasRawImage())
-      << "Can only detect keypoints if the frame has a raw image";
-  CHECK_EQ(
-      camera_.getId(),
-      CHECK_NOTNULL(frame->getCameraGeometry().get())->getId());
+  detectAndExtractFeatures(std::vector<aslam::VisualFrame*>{frame});
+}
 
-  timing::Timer timer_detection("keypoint detection");
+void FeatureDetectorExtractor::detectAndExtractFeatures(
+    const std::vector<aslam::VisualFrame*>& frames) const {
+  const size_t num_frames = frames.size();
+  for (aslam::VisualFrame* frame : frames) {
+    CHECK_NOTNULL(frame);
+    CHECK(frame->hasRawImage())
+        << "Can only detect keypoints if the frame has a raw image";
+    CHECK_EQ(
+        camera_.getId(),
+        CHECK_NOTNULL(frame->getCameraGeometry().get())->getId());
+  }
+
+  std::vector<std::vector<cv::KeyPoint>> keypoints_of_frames(num_frames);
+  if (cuda_detector_) {
+    timing::Timer timer_detection("keypoint detection (CUDA)");
+    std::vector<const cv::Mat*> images;
+    images.reserve(num_frames);
+    for (const aslam::VisualFrame* frame : frames) {
+      images.push_back(&frame->getRawImage());
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_cuda_detector_);
+      cuda_detector_->detect(images, &keypoints_of_frames);
+    }
+    timer_detection.Stop();
+  }
 
-  std::vector<cv::KeyPoint> keypoints_cv;
-  const cv::Mat& image = frame->getRawImage();
+  for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+    extractFeatures(&keypoints_of_frames[frame_idx], frames[frame_idx]);
+  }
+}
 
+void FeatureDetectorExtractor::detectKeypoints(
+    const cv::Mat& image, std::vector<cv::KeyPoint>* keypoints_cv) const {
+  CHECK_NOTNULL(keypoints_cv);
   if (FLAGS_use_grided_detections) {
     // Grided detection to ensure a certain distribution of keypoints across
     // the image.
@@ -96,9 +218,9 @@ void FeatureDetectorExtractor::detectAndExtractFeatures(
         detector_settings_.max_feature_count,
         detector_settings_.detector_nonmaxsuppression_radius,
         detector_settings_.detector_nonmaxsuppression_ratio_threshold,
-        kNumGridCols, kNumGridRows, &keypoints_cv);
+        kNumGridCols, kNumGridRows, keypoints_cv);
   } else {
-    detector_->detect(image, keypoints_cv);
+    detector_->detect(image, *keypoints_cv);
 
     if (detector_settings_.detector_use_nonmaxsuppression) {
       timing::Timer timer_nms("non-maximum suppression");
@@ -106,14 +228,37 @@ void FeatureDetectorExtractor::detectAndExtractFeatures(
           camera_.imageHeight(),
           detector_settings_.detector_nonmaxsuppression_radius,
           detector_settings_.detector_nonmaxsuppression_ratio_threshold,
-          &keypoints_cv);
+          keypoints_cv);
 
       statistics::StatsCollector stat_nms(
           "non-maximum suppression (1 image) in ms");
       stat_nms.AddSample(timer_nms.Stop() * 1000);
     }
+    cv::KeyPointsFilter::retainBest(
+        *keypoints_cv, detector_settings_.max_feature_count);
+  }
+}
+
+void FeatureDetectorExtractor::extractFeatures(
+    std::vector<cv::KeyPoint>* keypoints, aslam::VisualFrame* frame) const {
+  CHECK_NOTNULL(keypoints);
+  CHECK_NOTNULL(frame);
+  std::vector<cv::KeyPoint>& keypoints_cv = *keypoints;
+
+  timing::Timer timer_detection("keypoint detection");
+  if (cuda_detector_) {
+    // The keypoints were detected on the whole image by the CUDA detector.
+    if (detector_settings_.detector_use_nonmaxsuppression) {
+      localNonMaximumSuppression(
+          camera_.imageHeight(),
+          detector_settings_.detector_nonmaxsuppression_radius,
+          detector_settings_.detector_nonmaxsuppression_ratio_threshold,
+          &keypoints_cv);
+    }
     cv::KeyPointsFilter::retainBest(
         keypoints_cv, detector_settings_.max_feature_count);
+  } else {
+    detectKeypoints(frame->getRawImage(), &keypoints_cv);
   }
 
   // The ORB detector tries to always return a constant number of keypoints.
@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <iterator>
-
+#include <limits>
+#include <map>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -27,6 +28,7 @@ FeatureTrackExtractor::FeatureTrackExtractor(
     const aslam::NCamera::ConstPtr& camera_rig, size_t max_track_length,
     size_t min_track_length)
     : camera_rig_(camera_rig),
+      nframe_history_begin_(0u),
       min_track_length_(min_track_length),
       max_track_length_(max_track_length) {
   CHECK_GT(min_track_length_, 0u);
@@ -56,12 +58,13 @@ size_t FeatureTrackExtractor::extractFromNFrameStream(
 
   // TODO(schneith): Use the thread pool at some point.
   const bool kTrackPersistentFeatures = false;
+  const size_t nframe_index = addNFrameToHistory(nframe);
   size_t num_tracks = 0;
   for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
     (*tracks_opportunistic_terminated)[camera_idx].reserve(
         nframe->getFrame(camera_idx).getNumKeypointMeasurements());
     extractFromFrameStreamImpl(
-        nframe, camera_idx, kTrackPersistentFeatures,
+        nframe, nframe_index, camera_idx, kTrackPersistentFeatures,
         &(*tracks_opportunistic_terminated)[camera_idx],
         &tracks_persistent_new[camera_idx],
         &tracks_persistent_continued[camera_idx],
@@ -77,6 +80,7 @@ size_t FeatureTrackExtractor::extractFromNFrameStream(
     num_tracks += (*tracks_opportunistic_terminated)[camera_idx].size();
   }
   previous_nframe_ = nframe;
+  pruneNFrameHistory();
   return num_tracks;
 }
 
@@ -104,19 +108,21 @@ void FeatureTrackExtractor::extractFromNFrameStream(
   const double kKeypointToTrackRatioGuess = 0.5;
   const size_t num_reserve = kKeypointToTrackRatioGuess *
                              nframe->getFrame(0).getNumKeypointMeasurements();
+  const size_t nframe_index = addNFrameToHistory(nframe);
   for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
     (*tracks_opportunistic_terminated)[camera_idx].reserve(num_reserve);
     (*tracks_opportunistic_terminated)[camera_idx].reserve(num_reserve);
     (*tracks_persistent_continued)[camera_idx].reserve(num_reserve);
     (*tracks_persistent_terminated)[camera_idx].reserve(num_reserve);
     extractFromFrameStreamImpl(
-        nframe, camera_idx, kTrackpersistentFeatures,
+        nframe, nframe_index, camera_idx, kTrackpersistentFeatures,
         &(*tracks_opportunistic_terminated)[camera_idx],
         &(*tracks_persistent_new)[camera_idx],
         &(*tracks_persistent_continued)[camera_idx],
         &(*tracks_persistent_terminated)[camera_idx]);
   }
   previous_nframe_ = nframe;
+  pruneNFrameHistory();
 }
 
 void FeatureTrackExtractor::extractFromNFrameStream(
@@ -168,8 +174,8 @@ void FeatureTrackExtractor::extractFromNFrameStream(
 }
 
 void FeatureTrackExtractor::extractFromFrameStreamImpl(
-    const aslam::VisualNFrame::ConstPtr& nframe, size_t camera_idx,
-    bool track_persistent_features,
+    const aslam::VisualNFrame::ConstPtr& nframe, size_t nframe_index,
+    size_t camera_idx, bool track_persistent_features,
     aslam::FeatureTracks* tracks_opportunistic_terminated,
     aslam::FeatureTracks* tracks_persistent_new,
     aslam::ContinuedFeatureTracks* tracks_persistent_continued,
@@ -186,37 +192,60 @@ void FeatureTrackExtractor::extractFromFrameStreamImpl(
   CHECK_NOTNULL(tracks_persistent_new);
   CHECK_NOTNULL(tracks_persistent_continued);
   CHECK_NOTNULL(tracks_persistent_terminated);
+  CHECK_GE(nframe_index, nframe_history_begin_);
+  CHECK_LT(nframe_index - nframe_history_begin_, nframe_history_.size());
+  CHECK(nframe_history_[nframe_index - nframe_history_begin_] == nframe);
+  TrackIdToSlotMap& opportunistic_tracks = opportunistic_tracks_[camera_idx];
 
   // If there is a previous frame, we need to build a LUT mapping track id to
-  // keypoint index in
-  // order to be able to quickly look up the keypoint index in the previous
-  // frame for a given new
-  // track id in the current frame.
-  typedef std::unordered_map<int, int> TrackIdToKeypointIndexMap;
-  TrackIdToKeypointIndexMap previous_frame_track_id_keypoint_index_map;
+  // keypoint index in order to be able to quickly look up the keypoint index
+  // in the previous frame for a given new track id in the current frame. The
+  // LUT is a sorted vector that is reused for every frame.
+  size_t previous_nframe_index = 0u;
+  previous_frame_track_id_keypoint_index_.clear();
   if (previous_nframe_) {
+    CHECK_GT(nframe_index, nframe_history_begin_);
+    previous_nframe_index = nframe_index - 1u;
+    CHECK(
+        nframe_history_[previous_nframe_index - nframe_history_begin_] ==
+        previous_nframe_);
     const Eigen::VectorXi& previous_track_ids =
         previous_nframe_->getFrame(camera_idx).getTrackIds();
 
     const size_t num_track_ids = static_cast<size_t>(previous_track_ids.rows());
-    previous_frame_track_id_keypoint_index_map.reserve(num_track_ids);
-
     for (size_t keypoint_idx = 0u; keypoint_idx < num_track_ids;
          ++keypoint_idx) {
       const int track_id = previous_track_ids(keypoint_idx);
       if (track_id >= 0) {
-        previous_frame_track_id_keypoint_index_map.insert(
-            std::make_pair(track_id, keypoint_idx));
+        previous_frame_track_id_keypoint_index_.emplace_back(
+            track_id, keypoint_idx);
       }
     }
+    std::sort(
+        previous_frame_track_id_keypoint_index_.begin(),
+        previous_frame_track_id_keypoint_index_.end());
   }
+  // Returns the keypoint index of the track id in the previous frame or -1 if
+  // the track id isn't observed in the previous frame.
+  auto findKeypointIndexInPreviousFrame = [this](const int track_id) -> int {
+    const std::vector<std::pair<int, int>>::const_iterator it =
+        std::lower_bound(
+            previous_frame_track_id_keypoint_index_.begin(),
+            previous_frame_track_id_keypoint_index_.end(),
+            std::make_pair(track_id, std::numeric_limits<int>::min()));
+    if (it == previous_frame_track_id_keypoint_index_.end() ||
+        it->first != track_id) {
+      return -1;
+    }
+    return it->second;
+  };
 
   // Find currently new and continued tracks.
-  std::unordered_set<int> present_tracks;
   const Eigen::VectorXi& current_track_ids = frame.getTrackIds();
   const size_t num_keypoints = frame.getNumKeypointMeasurements();
   size_t num_track_ids = static_cast<size_t>(current_track_ids.rows());
   CHECK_EQ(num_keypoints, num_track_ids);
+  present_track_ids_.clear();
 
   // Go through all tracks ids and check if the track is new, continued,
   // terminated or persistent.
@@ -228,60 +257,54 @@ void FeatureTrackExtractor::extractFromFrameStreamImpl(
     if (track_id >= 0) {
       CHECK_LT(keypoint_idx_current_frame, num_keypoints);
       // Add all valid tracks_ids seen in this frame to a list that is compared
-      // to the list of
-      // opportunistic tracks to determine which tracks have terminated.
-      present_tracks.insert(track_id);
+      // to the list of opportunistic tracks to determine which tracks have
+      // terminated.
+      present_track_ids_.push_back(track_id);
 
-      TrackIdToFeatureTrackMap::iterator it_track =
-          opportunistic_tracks_[camera_idx].find(track_id);
-      if (it_track != opportunistic_tracks_[camera_idx].end()) {
+      TrackIdToSlotMap::iterator it_track = opportunistic_tracks.find(track_id);
+      if (it_track != opportunistic_tracks.end()) {
         // This is a continued track as there is already an entry in the books.
-        aslam::FeatureTrack& continued_track = it_track->second;
-        const int continued_track_id = continued_track.getTrackId();
-        CHECK_EQ(track_id, continued_track_id);
+        const size_t slot = it_track->second;
 
         // If the track length already reached max-length but the tracks hasn't
-        // terminated yet,
-        // we either cut the track and start a new one or convert it into a
-        // persistent track
-        // depending on the settings of track_persistent_features.
-        if (continued_track.getTrackLength() >= max_track_length_) {
+        // terminated yet, we either cut the track and start a new one or
+        // convert it into a persistent track depending on the settings of
+        // track_persistent_features.
+        if (observation_pool_.getNumObservations(slot) >= max_track_length_) {
           if (track_persistent_features) {
             // Return the current track and convert it to a persistent track.
-            tracks_persistent_new->emplace_back(continued_track);
-            opportunistic_tracks_[camera_idx].erase(it_track);
+            tracks_persistent_new->emplace_back(
+                createFeatureTrack(track_id, camera_idx, slot));
+            observation_pool_.releaseSlot(slot);
+            opportunistic_tracks.erase(it_track);
             // Add it to the list of persistent tracks. This will avoid that a
-            // new opportunistic
-            // track is spawned for this trackid in the next update and future
-            // observations are
-            // returned as ContinuedFeatureTracks messages.
-            persistent_trackids_[camera_idx].insert(continued_track_id);
+            // new opportunistic track is spawned for this trackid in the next
+            // update and future observations are returned as
+            // ContinuedFeatureTracks messages.
+            persistent_trackids_[camera_idx].insert(track_id);
             VLOG(100) << "New persistent track with track id " << track_id
                       << " in camera " << camera_idx;
           } else {
             // Add the track to the terminated tracks. It ends at the previous
             // frame.
-            tracks_opportunistic_terminated->emplace_back(continued_track);
-            opportunistic_tracks_[camera_idx].erase(it_track);
-
-            // Cut and start a new track starting at the current frame.
-            aslam::FeatureTrack new_track(track_id);
-            new_track.addKeypointObservationAtBack(
-                nframe, camera_idx, keypoint_idx_current_frame);
-            CHECK(
-                opportunistic_tracks_[camera_idx]
-                    .emplace(track_id, new_track)
-                    .second);
+            tracks_opportunistic_terminated->emplace_back(
+                createFeatureTrack(track_id, camera_idx, slot));
+
+            // Cut and start a new track starting at the current frame. The
+            // new track reuses the slot of the terminated track.
+            observation_pool_.clearObservations(slot);
+            observation_pool_.addObservation(
+                slot, nframe_index, keypoint_idx_current_frame);
           }
         } else {
           // Simply append the current keypoint to the existing track.
-          continued_track.addKeypointObservationAtBack(
-              nframe, camera_idx, keypoint_idx_current_frame);
+          observation_pool_.addObservation(
+              slot, nframe_index, keypoint_idx_current_frame);
         }
       } else {
         // This is a new track as the TrackId isn't in the books so far. Either
-        // we need to start
-        // a new track or we output a track continuation message.
+        // we need to start a new track or we output a track continuation
+        // message.
         std::unordered_set<int>::const_iterator it =
             persistent_trackids_[camera_idx].find(track_id);
         const bool is_persistent_track =
@@ -290,61 +313,63 @@ void FeatureTrackExtractor::extractFromFrameStreamImpl(
         if (is_persistent_track) {
           // Output the ContinuedFeatureTracks message.
           CHECK(previous_nframe_);
-          TrackIdToKeypointIndexMap::iterator it =
-              previous_frame_track_id_keypoint_index_map.find(track_id);
-          CHECK(it != previous_frame_track_id_keypoint_index_map.end());
-          const int keypoint_idx_in_previous_frame = it->second;
+          const int keypoint_idx_in_previous_frame =
+              findKeypointIndexInPreviousFrame(track_id);
+          CHECK_GE(keypoint_idx_in_previous_frame, 0);
           tracks_persistent_continued->emplace_back(
               track_id, aslam::KeypointIdentifier::create(
                             previous_nframe_, camera_idx,
                             keypoint_idx_in_previous_frame));
         } else {
           // This is a new track.
-          aslam::FeatureTrack new_track(track_id);
+          const size_t slot = observation_pool_.acquireSlot();
 
           // If there is a previous frame and if we can find the track id in the
-          // previous frame,
-          // add its keypoint identifier. This allows but does not force full
-          // track initialization.
-          // This is needed as the tracker writes matches to the frame k-1 and k
-          // when starting a
-          // new track.
+          // previous frame, add its keypoint identifier. This allows but does
+          // not force full track initialization. This is needed as the tracker
+          // writes matches to the frame k-1 and k when starting a new track.
           if (previous_nframe_) {
-            TrackIdToKeypointIndexMap::iterator it =
-                previous_frame_track_id_keypoint_index_map.find(track_id);
-            if (it != previous_frame_track_id_keypoint_index_map.end()) {
+            const int keypoint_idx_in_previous_frame =
+                findKeypointIndexInPreviousFrame(track_id);
+            if (keypoint_idx_in_previous_frame >= 0) {
               // Found the track id in the previous frame.
-              const int keypoint_idx_in_previous_frame = it->second;
-              new_track.addKeypointObservationAtBack(
-                  previous_nframe_, camera_idx, keypoint_idx_in_previous_frame);
+              observation_pool_.addObservation(
+                  slot, previous_nframe_index, keypoint_idx_in_previous_frame);
             }
           }
 
-          new_track.addKeypointObservationAtBack(
-              nframe, camera_idx, keypoint_idx_current_frame);
-          opportunistic_tracks_[camera_idx].emplace(track_id, new_track);
+          observation_pool_.addObservation(
+              slot, nframe_index, keypoint_idx_current_frame);
+          opportunistic_tracks.emplace(track_id, slot);
         }
       }
     }
   }
+  std::sort(present_track_ids_.begin(), present_track_ids_.end());
+  auto isPresentTrack = [this](const int track_id) -> bool {
+    return std::binary_search(
+        present_track_ids_.begin(), present_track_ids_.end(), track_id);
+  };
 
   // Check for opportunistic tracks which terminated in the last frame.
-  TrackIdToFeatureTrackMap::iterator track_it =
-      opportunistic_tracks_[camera_idx].begin();
-  while (track_it != opportunistic_tracks_[camera_idx].end()) {
+  TrackIdToSlotMap::iterator track_it = opportunistic_tracks.begin();
+  while (track_it != opportunistic_tracks.end()) {
     // If it is not new or continued, it is a terminated track!
     const int feature_track_id = track_it->first;
 
-    if (present_tracks.count(feature_track_id) == 0u) {
+    if (!isPresentTrack(feature_track_id)) {
       // Track is not new or continued, so it is a terminated track.
-      const aslam::FeatureTrack& finished_track = track_it->second;
+      const size_t slot = track_it->second;
+      const size_t track_length = observation_pool_.getNumObservations(slot);
       // Only return tracks whose length is at least the min. track length.
-      if (finished_track.getTrackLength() >= min_track_length_) {
-        tracks_opportunistic_terminated->push_back(finished_track);
+      if (track_length >= min_track_length_) {
+        tracks_opportunistic_terminated->emplace_back(
+            createFeatureTrack(feature_track_id, camera_idx, slot));
         VLOG(200) << "Track finished with id " << feature_track_id
-                  << " and length " << finished_track.getTrackLength();
+                  << " and length " << track_length;
       }
-      track_it = opportunistic_tracks_[camera_idx].erase(track_it);
+      observation_pool_.releaseSlot(slot);
+      track_it = opportunistic_tracks.erase(track_it);
     } else {
       ++track_it;
     }
@@ -359,7 +384,7 @@ void FeatureTrackExtractor::extractFromFrameStreamImpl(
 
     // If persistent trackid was not seen during this update, we terminate the
     // persistent track.
-    if (present_tracks.count(feature_track_id) == 0u) {
+    if (!isPresentTrack(feature_track_id)) {
       tracks_persistent_terminated->insert(feature_track_id);
       trackid_it = persistent_trackids_[camera_idx].erase(trackid_it);
     } else {
@@ -368,6 +393,54 @@ void FeatureTrackExtractor::extractFromFrameStreamImpl(
   }
 }
 
+size_t FeatureTrackExtractor::addNFrameToHistory(
+    const aslam::VisualNFrame::ConstPtr& nframe) {
+  CHECK(nframe);
+  nframe_history_.push_back(nframe);
+  return nframe_history_begin_ + nframe_history_.size() - 1u;
+}
+
+void FeatureTrackExtractor::pruneNFrameHistory() {
+  if (nframe_history_.empty()) {
+    return;
+  }
+  // The previous nframe is the last one in the history and always kept.
+  size_t min_referenced_index =
+      nframe_history_begin_ + nframe_history_.size() - 1u;
+  for (const TrackIdToSlotMap& opportunistic_tracks : opportunistic_tracks_) {
+    for (const TrackIdToSlotMap::value_type& track : opportunistic_tracks) {
+      const std::vector<size_t>& nframe_indices =
+          observation_pool_.getNFrameIndices(track.second);
+      DCHECK(!nframe_indices.empty());
+      min_referenced_index =
+          std::min(min_referenced_index, nframe_indices.front());
+    }
+  }
+  while (nframe_history_begin_ < min_referenced_index) {
+    nframe_history_.pop_front();
+    ++nframe_history_begin_;
+  }
+}
+
+aslam::FeatureTrack FeatureTrackExtractor::createFeatureTrack(
+    int track_id, size_t camera_idx, size_t slot) const {
+  const std::vector<size_t>& nframe_indices =
+      observation_pool_.getNFrameIndices(slot);
+  const std::vector<int>& keypoint_indices =
+      observation_pool_.getKeypointIndices(slot);
+  CHECK_EQ(nframe_indices.size(), keypoint_indices.size());
+
+  aslam::FeatureTrack track(track_id);
+  for (size_t i = 0u; i < nframe_indices.size(); ++i) {
+    CHECK_GE(nframe_indices[i], nframe_history_begin_);
+    const size_t history_idx = nframe_indices[i] - nframe_history_begin_;
+    CHECK_LT(history_idx, nframe_history_.size());
+    track.addKeypointObservationAtBack(
+        nframe_history_[history_idx], camera_idx, keypoint_indices[i]);
+  }
+  return track;
+}
+
 size_t FeatureTrackExtractor::extractBatch(
     const aslam::VisualNFrame::ConstPtrVector& nframes,
     aslam::FeatureTracksList* all_tracks) {
@@ -428,11 +501,12 @@ size_t FeatureTrackExtractor::abortAndReturnOpportunisticTracks(
   // Get all opportunistic tracks.
   size_t num_tracks = 0;
   for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
-    for (const TrackIdToFeatureTrackMap::value_type&
-             active_opportunistic_track : opportunistic_tracks_[camera_idx]) {
-      if (active_opportunistic_track.second.getTrackLength() >=
-          min_track_length_) {
-        (*all_tracks)[camera_idx].push_back(active_opportunistic_track.second);
+    for (const TrackIdToSlotMap::value_type& active_opportunistic_track :
+         opportunistic_tracks_[camera_idx]) {
+      const size_t slot = active_opportunistic_track.second;
+      if (observation_pool_.getNumObservations(slot) >= min_track_length_) {
+        (*all_tracks)[camera_idx].emplace_back(createFeatureTrack(
+            active_opportunistic_track.first, camera_idx, slot));
         ++num_tracks;
       }
     }
@@ -457,14 +531,16 @@ void FeatureTrackExtractor::abortAndReturnNLongestOpportunisticTracks(
       TrackLengthOpportunisticTrackMap;
   TrackLengthOpportunisticTrackMap tracklength_track_map;
   for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
-    for (const TrackIdToFeatureTrackMap::value_type&
-             active_opportunistic_track : opportunistic_tracks_[camera_idx]) {
-      const aslam::FeatureTrack& track = active_opportunistic_track.second;
-      if (track.getTrackLength() >= min_track_length) {
+    for (const TrackIdToSlotMap::value_type& active_opportunistic_track :
+         opportunistic_tracks_[camera_idx]) {
+      const size_t track_length = observation_pool_.getNumObservations(
+          active_opportunistic_track.second);
+      if (track_length >= min_track_length) {
         tracklength_track_map.emplace(
             std::make_pair(
-                track.getTrackLength(),
-                CameraIdxTrackIdPair(camera_idx, track.getTrackId())));
+                track_length,
+                CameraIdxTrackIdPair(
+                    camera_idx, active_opportunistic_track.first)));
       }
     }
   }
@@ -480,14 +556,17 @@ void FeatureTrackExtractor::abortAndReturnNLongestOpportunisticTracks(
 
     // Find the active opportunistic track.
     CHECK_LT(camera_idx, opportunistic_tracks_.size());
-    TrackIdToFeatureTrackMap::iterator it_active_opportunistic_track =
+    TrackIdToSlotMap::iterator it_active_opportunistic_track =
         opportunistic_tracks_[camera_idx].find(track_id);
     CHECK(
         it_active_opportunistic_track !=
         opportunistic_tracks_[camera_idx].end());
 
     // Add to output and abort the active track.
-    aborted_tracks->emplace_back(it_active_opportunistic_track->second);
+    const size_t slot = it_active_opportunistic_track->second;
+    aborted_tracks->emplace_back(
+        createFeatureTrack(track_id, camera_idx, slot));
+    observation_pool_.releaseSlot(slot);
     opportunistic_tracks_[camera_idx].erase(it_active_opportunistic_track);
 
     if (aborted_tracks->size() >= num_tracks_to_abort) {
@@ -529,6 +608,8 @@ void FeatureTrackExtractor::reset() {
     opportunistic_tracks_[camera_idx].clear();
     persistent_trackids_[camera_idx].clear();
   }
+  observation_pool_.releaseAllSlots();
+  pruneNFrameHistory();
 }
 
 }  // namespace vio_common
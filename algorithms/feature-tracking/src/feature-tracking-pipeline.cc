@@ -1,5 +1,8 @@
 #include "feature-tracking/feature-tracking-pipeline.h"
 
+#include <memory>
+#include <thread>
+
 #include <aslam/cameras/camera.h>
 #include <aslam/common/pose-types.h>
 #include <aslam/common/statistics/statistics.h>
@@ -13,6 +16,7 @@
 #include <aslam/visualization/feature-track-visualizer.h>
 #include <glog/logging.h>
 #include <maplab-common/progress-bar.h>
+#include <maplab-common/threadsafe-queue.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <vi-map/check-map-consistency.h>
@@ -45,12 +49,23 @@ DEFINE_bool(
     "Flag indicating whether the map is checked for consistency after "
     "rerunning the feature tracking.");
 
+DEFINE_bool(
+    feature_tracker_run_pipelined, true,
+    "Flag indicating whether loading the raw images, detecting keypoints, "
+    "tracking and triangulating run as concurrent pipeline stages.");
+
+DEFINE_int32(
+    feature_tracker_pipeline_queue_size, 4,
+    "Maximum number of nframes buffered between two stages of the pipelined "
+    "feature tracking.");
+
 namespace feature_tracking {
 
 FeatureTrackingPipeline::FeatureTrackingPipeline()
     : feature_tracking_ros_base_topic_("tracking/"),
       visualize_keypoint_matches_(
           FLAGS_feature_tracker_visualize_keypoint_matches),
+      features_detected_in_separate_stage_(false),
       processed_first_nframe_(false) {}
 
 void FeatureTrackingPipeline::runTrackingAndTriangulationForAllMissions(
@@ -105,21 +120,33 @@ void FeatureTrackingPipeline::assignRawImagesToNFrame(
 void FeatureTrackingPipeline::extractAndTriangulateTerminatedFeatureTracks(
     const aslam::VisualNFrame::ConstPtr& nframe, vi_map::VIMap* map) {
   CHECK_NOTNULL(map);
+  aslam::FeatureTracksList terminated_tracks;
+  extractTerminatedFeatureTracks(nframe, &terminated_tracks);
+  triangulateFeatureTracks(terminated_tracks, map);
+}
+
+void FeatureTrackingPipeline::extractTerminatedFeatureTracks(
+    const aslam::VisualNFrame::ConstPtr& nframe,
+    aslam::FeatureTracksList* terminated_tracks) {
+  CHECK_NOTNULL(terminated_tracks);
   CHECK(track_extractor_);
 
-  aslam::FeatureTracksList terminated_tracks;
-  track_extractor_->extractFromNFrameStream(nframe, &terminated_tracks);
+  track_extractor_->extractFromNFrameStream(nframe, terminated_tracks);
 
   if (FLAGS_feature_tracker_visualize_feature_tracks) {
     cv::Mat image;
     feature_track_visualizer_.drawContinuousFeatureTracks(
-        nframe, terminated_tracks, &image);
+        nframe, *terminated_tracks, &image);
 
     const std::string topic =
         feature_tracking_ros_base_topic_ + "/feature_tracks";
     visualization::RVizVisualizationSink::publish(topic, image);
   }
+}
 
+void FeatureTrackingPipeline::triangulateFeatureTracks(
+    const aslam::FeatureTracksList& terminated_tracks, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
   // Iterate over all terminated feature tracks, triangulate them and add them
   // to the map.
   for (const aslam::FeatureTracks& tracks : terminated_tracks) {
@@ -231,17 +258,13 @@ void FeatureTrackingPipeline::runTrackingAndTriangulationForMission(
                                      << " is not present in the map.";
   VLOG(1) << "Running tracking and triangulation for mission with ID "
           << mission_id;
-  nframe_id_to_vertex_id_map_.clear();
 
-  pose_graph::VertexIdList all_vertices;
-  map->getAllVertexIdsInMission(mission_id, &all_vertices);
+  pose_graph::VertexIdList vertex_ids;
+  map->getAllVertexIdsInMissionAlongGraph(mission_id, &vertex_ids);
+  CHECK(!vertex_ids.empty());
+  VLOG(1) << "Processing a total of " << vertex_ids.size() << " vertices.";
 
-  VLOG(1) << "Processing a total of " << all_vertices.size() << " vertices.";
-  common::ProgressBar progress_bar(all_vertices.size());
-
-  pose_graph::VertexId vertex_id_k =
-      map->getMission(mission_id).getRootVertexId();
-  vi_map::Vertex& root_vertex = map->getVertex(vertex_id_k);
+  const vi_map::Vertex& root_vertex = map->getVertex(vertex_ids.front());
   // Initialize pipeline.
   const size_t num_frames = root_vertex.numFrames();
   CHECK_GT(num_frames, 0u);
@@ -255,31 +278,71 @@ void FeatureTrackingPipeline::runTrackingAndTriangulationForMission(
   track_extractor_.reset(new vio_common::FeatureTrackExtractor(ncamera));
   initialize(ncamera);
 
+  // The lookup of the vertices of the nframes is filled before the tracking,
+  // such that the triangulation only reads it.
+  nframe_id_to_vertex_id_map_.clear();
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    const vi_map::Vertex& vertex = map->getVertex(vertex_id);
+    CHECK_EQ(vertex.numFrames(), num_frames);
+    nframe_id_to_vertex_id_map_.insert(
+        std::make_pair(vertex.getVisualNFrame().getId(), vertex_id));
+  }
+
+  if (FLAGS_feature_tracker_run_pipelined) {
+    features_detected_in_separate_stage_ = true;
+    runTrackingAndTriangulationPipelined(vertex_ids, map);
+    features_detected_in_separate_stage_ = false;
+  } else {
+    runTrackingAndTriangulationSequentially(vertex_ids, map);
+  }
+
+  VLOG(1) << "Successfully retracked features and triangulated new landmarks"
+          << " for mission " << mission_id;
+
+  VLOG(1) << "\t Total num successfully triangulated landmarks: "
+          << successfully_triangulated_landmarks_accumulator_.sum();
+  if (successfully_triangulated_landmarks_accumulator_.total_samples() > 0) {
+    VLOG(1) << "\t In percent: "
+            << static_cast<double>(
+                   successfully_triangulated_landmarks_accumulator_.sum()) /
+                   static_cast<double>(
+                       successfully_triangulated_landmarks_accumulator_
+                           .total_samples()) *
+                   100.0
+            << "%";
+  }
+
+  if (FLAGS_feature_tracker_check_map_for_consistency) {
+    VLOG(1) << "Checking the modified map for consistency...";
+    CHECK(vi_map::checkMapConsistency(*map));
+    VLOG(1) << "The modified map is consistent";
+  }
+}
+
+void FeatureTrackingPipeline::runTrackingAndTriangulationSequentially(
+    const pose_graph::VertexIdList& vertex_ids, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  CHECK(!vertex_ids.empty());
+  common::ProgressBar progress_bar(vertex_ids.size());
+
   // Process first nframe.
-  assignRawImagesToNFrame(vertex_id_k, map);
-  aslam::VisualNFrame::Ptr nframe_k = root_vertex.getVisualNFrameShared();
+  assignRawImagesToNFrame(vertex_ids.front(), map);
+  aslam::VisualNFrame::Ptr nframe_k =
+      map->getVertex(vertex_ids.front()).getVisualNFrameShared();
   nframe_k->clearKeypointChannelsOfAllFrames();
-  nframe_id_to_vertex_id_map_.insert(
-      std::make_pair(nframe_k->getId(), vertex_id_k));
   progress_bar.increment();
 
-  pose_graph::VertexId vertex_id_kp1;
-  while (map->getNextVertex(
-      vertex_id_k, map->getGraphTraversalEdgeType(mission_id),
-      &vertex_id_kp1)) {
-    CHECK(vertex_id_k.isValid());
-    CHECK(vertex_id_kp1.isValid());
+  for (size_t idx = 1u; idx < vertex_ids.size(); ++idx) {
+    const pose_graph::VertexId& vertex_id_k = vertex_ids[idx - 1u];
+    const pose_graph::VertexId& vertex_id_kp1 = vertex_ids[idx];
     CHECK_NE(vertex_id_k, vertex_id_kp1);
     CHECK(nframe_k);
 
     assignRawImagesToNFrame(vertex_id_kp1, map);
 
-    vi_map::Vertex& vertex_kp1 = map->getVertex(vertex_id_kp1);
-    CHECK_EQ(vertex_kp1.numFrames(), num_frames);
-    aslam::VisualNFrame::Ptr nframe_kp1 = vertex_kp1.getVisualNFrameShared();
+    aslam::VisualNFrame::Ptr nframe_kp1 =
+        map->getVertex(vertex_id_kp1).getVisualNFrameShared();
     nframe_kp1->clearKeypointChannelsOfAllFrames();
-    nframe_id_to_vertex_id_map_.insert(
-        std::make_pair(nframe_kp1->getId(), vertex_id_kp1));
 
     const aslam::Transformation T_Ik_Ikp1 =
         map->getVertex_T_G_I(vertex_id_k).inverse() *
@@ -294,51 +357,129 @@ void FeatureTrackingPipeline::runTrackingAndTriangulationForMission(
     map->getVertex(vertex_id_kp1).resetObservedLandmarkIdsToInvalid();
     extractAndTriangulateTerminatedFeatureTracks(nframe_kp1, map);
 
-    if (FLAGS_feature_tracker_visualize_keypoints) {
-      cv::Mat image;
-      aslam_cv_visualization::visualizeKeypoints(nframe_kp1, &image);
-      const std::string topic = feature_tracking_ros_base_topic_ + "/keypoints";
-      visualization::RVizVisualizationSink::publish(topic, image);
-    }
+    visualizeKeypoints(nframe_kp1);
 
-    if (FLAGS_feature_tracker_visualize_keypoints_individual_frames) {
-      CHECK_EQ(num_frames, nframe_kp1->getNumFrames());
-      for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
-        cv::Mat image;
-        aslam_cv_visualization::drawKeypoints(
-            nframe_kp1->getFrame(frame_idx), &image);
-        const std::string topic = feature_tracking_ros_base_topic_ +
-                                  "/keypoints_cam" + std::to_string(frame_idx);
-        visualization::RVizVisualizationSink::publish(topic, image);
-      }
+    nframe_k->releaseRawImagesOfAllFrames();
+    nframe_k = nframe_kp1;
+    progress_bar.increment();
+  }
+}
+
+void FeatureTrackingPipeline::runTrackingAndTriangulationPipelined(
+    const pose_graph::VertexIdList& vertex_ids, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  CHECK(!vertex_ids.empty());
+  CHECK_GT(FLAGS_feature_tracker_pipeline_queue_size, 0);
+  const size_t max_queue_size = FLAGS_feature_tracker_pipeline_queue_size;
+  const size_t num_vertices = vertex_ids.size();
+
+  // The stages only exchange the indices of the vertices. Every nframe is
+  // touched by one stage at a time and all landmark related changes of the map
+  // are made by the triangulation stage, which processes the tracks in the
+  // order of the tracking.
+  common::ThreadSafeQueue<size_t> loaded_queue;
+  std::thread loading_thread([&]() {
+    for (size_t idx = 0u; idx < num_vertices; ++idx) {
+      map->getVertex(vertex_ids[idx])
+          .getVisualNFrame()
+          .clearKeypointChannelsOfAllFrames();
+      assignRawImagesToNFrame(vertex_ids[idx], map);
+      CHECK(loaded_queue.PushBlockingIfFull(idx, max_queue_size));
+    }
+  });
+
+  common::ThreadSafeQueue<size_t> detected_queue;
+  std::thread detection_thread([&]() {
+    for (size_t num_detected = 0u; num_detected < num_vertices;
+         ++num_detected) {
+      size_t idx;
+      CHECK(loaded_queue.PopBlocking(&idx));
+      detectFeaturesNFrame(
+          map->getVertex(vertex_ids[idx]).getVisualNFrameShared().get());
+      CHECK(detected_queue.PushBlockingIfFull(idx, max_queue_size));
+    }
+  });
+
+  // A null pointer marks the end of the tracks.
+  typedef std::shared_ptr<aslam::FeatureTracksList> FeatureTracksListPtr;
+  common::ThreadSafeQueue<FeatureTracksListPtr> tracks_queue;
+  std::thread triangulation_thread([&]() {
+    FeatureTracksListPtr terminated_tracks;
+    while (tracks_queue.PopBlocking(&terminated_tracks) && terminated_tracks) {
+      triangulateFeatureTracks(*terminated_tracks, map);
     }
+  });
+
+  // The tracking stage runs on this thread. The landmark ids of a vertex are
+  // reset before any of its tracks are queued for the triangulation.
+  common::ProgressBar progress_bar(num_vertices);
+  aslam::VisualNFrame::Ptr nframe_k;
+  for (size_t idx = 0u; idx < num_vertices; ++idx) {
+    size_t detected_idx;
+    CHECK(detected_queue.PopBlocking(&detected_idx));
+    CHECK_EQ(detected_idx, idx);
+    aslam::VisualNFrame::Ptr nframe_kp1 =
+        map->getVertex(vertex_ids[idx]).getVisualNFrameShared();
+
+    if (idx > 0u) {
+      const pose_graph::VertexId& vertex_id_k = vertex_ids[idx - 1u];
+      const pose_graph::VertexId& vertex_id_kp1 = vertex_ids[idx];
+      CHECK_NE(vertex_id_k, vertex_id_kp1);
+      CHECK(nframe_k);
+
+      const aslam::Transformation T_Ik_Ikp1 =
+          map->getVertex_T_G_I(vertex_id_k).inverse() *
+          map->getVertex_T_G_I(vertex_id_kp1);
+      trackFeaturesNFrame(T_Ik_Ikp1, nframe_k.get(), nframe_kp1.get());
+
+      if (!processed_first_nframe_) {
+        map->getVertex(vertex_id_k).resetObservedLandmarkIdsToInvalid();
+        FeatureTracksListPtr terminated_tracks(new aslam::FeatureTracksList);
+        extractTerminatedFeatureTracks(nframe_k, terminated_tracks.get());
+        CHECK(tracks_queue.PushBlockingIfFull(
+            terminated_tracks, max_queue_size));
+        processed_first_nframe_ = true;
+      }
+      map->getVertex(vertex_id_kp1).resetObservedLandmarkIdsToInvalid();
+      FeatureTracksListPtr terminated_tracks(new aslam::FeatureTracksList);
+      extractTerminatedFeatureTracks(nframe_kp1, terminated_tracks.get());
+      CHECK(
+          tracks_queue.PushBlockingIfFull(terminated_tracks, max_queue_size));
 
-    vertex_id_k = vertex_id_kp1;
-    nframe_k->releaseRawImagesOfAllFrames();
+      visualizeKeypoints(nframe_kp1);
+
+      nframe_k->releaseRawImagesOfAllFrames();
+    }
     nframe_k = nframe_kp1;
     progress_bar.increment();
   }
 
-  VLOG(1) << "Successfully retracked features and triangulated new landmarks"
-          << " for mission " << mission_id;
+  loading_thread.join();
+  detection_thread.join();
+  CHECK(tracks_queue.PushBlockingIfFull(nullptr, max_queue_size));
+  triangulation_thread.join();
+}
 
-  VLOG(1) << "\t Total num successfully triangulated landmarks: "
-          << successfully_triangulated_landmarks_accumulator_.sum();
-  if (successfully_triangulated_landmarks_accumulator_.total_samples() > 0) {
-    VLOG(1) << "\t In percent: "
-            << static_cast<double>(
-                   successfully_triangulated_landmarks_accumulator_.sum()) /
-                   static_cast<double>(
-                       successfully_triangulated_landmarks_accumulator_
-                           .total_samples()) *
-                   100.0
-            << "%";
+void FeatureTrackingPipeline::visualizeKeypoints(
+    const aslam::VisualNFrame::ConstPtr& nframe) const {
+  CHECK(nframe);
+  if (FLAGS_feature_tracker_visualize_keypoints) {
+    cv::Mat image;
+    aslam_cv_visualization::visualizeKeypoints(nframe, &image);
+    const std::string topic = feature_tracking_ros_base_topic_ + "/keypoints";
+    visualization::RVizVisualizationSink::publish(topic, image);
   }
 
-  if (FLAGS_feature_tracker_check_map_for_consistency) {
-    VLOG(1) << "Checking the modified map for consistency...";
-    CHECK(vi_map::checkMapConsistency(*map));
-    VLOG(1) << "The modified map is consistent";
+  if (FLAGS_feature_tracker_visualize_keypoints_individual_frames) {
+    for (size_t frame_idx = 0u; frame_idx < nframe->getNumFrames();
+         ++frame_idx) {
+      cv::Mat image;
+      aslam_cv_visualization::drawKeypoints(
+          nframe->getFrame(frame_idx), &image);
+      const std::string topic = feature_tracking_ros_base_topic_ +
+                                "/keypoints_cam" + std::to_string(frame_idx);
+      visualization::RVizVisualizationSink::publish(topic, image);
+    }
   }
 }
 }  // namespace feature_tracking
@@ -73,6 +73,12 @@ DEFINE_uint64(
     swe_feature_tracking_detector_max_feature_count, 700,
     "Max. number of features to detect. After the whole detection "
     "pipeline the number of features will be cut.");
+DEFINE_string(
+    swe_feature_tracking_detector_backend, "cpu",
+    "Backend that runs the ORB keypoint detection: 'cpu' or 'cuda'. The "
+    "'cuda' backend detects on the whole image instead of a grid and falls "
+    "back to 'cpu' if OpenCV was built without CUDA or no device is found. "
+    "The descriptors are always extracted on the CPU.");
 
 DEFINE_int32(
     feature_tracker_simple_pipeline_brisk_num_octaves, 1,
@@ -163,7 +169,8 @@ SweFeatureTrackingDetectorSettings::SweFeatureTrackingDetectorSettings()
           FLAGS_swe_feature_tracking_detector_orb_fast_threshold),
       max_feature_count(FLAGS_swe_feature_tracking_detector_max_feature_count),
       min_tracking_distance_to_image_border_px(30u),
-      keypoint_uncertainty_px(0.8) {
+      keypoint_uncertainty_px(0.8),
+      detector_backend(FLAGS_swe_feature_tracking_detector_backend) {
   orb_detector_edge_threshold =
       static_cast<int>(min_tracking_distance_to_image_border_px);
 
@@ -173,6 +180,8 @@ SweFeatureTrackingDetectorSettings::SweFeatureTrackingDetectorSettings()
   CHECK_GT(orb_detector_scale_factor, 1.0);
   CHECK_GE(orb_detector_score_lower_bound, 0.0f);
   CHECK_GT(orb_detector_fast_threshold, 0);
+  CHECK(detector_backend == "cpu" || detector_backend == "cuda")
+      << "Unknown feature detector backend: " << detector_backend;
 }
 
 SimpleBriskFeatureTrackingSettings::SimpleBriskFeatureTrackingSettings()
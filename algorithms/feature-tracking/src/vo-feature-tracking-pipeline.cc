@@ -5,6 +5,7 @@
 #include <aslam/tracker/feature-tracker-gyro.h>
 #include <aslam/visualization/basic-visualization.h>
 #include <maplab-common/conversions.h>
+#include <maplab-common/threading-helpers.h>
 #include <visualization/common-rviz-visualization.h>
 
 DEFINE_double(
@@ -63,45 +64,72 @@ void VOFeatureTrackingPipeline::trackFeaturesNFrame(
   CHECK_EQ(num_cameras, track_managers_.size());
   CHECK(ncamera_.get() == nframe_kp1->getNCameraShared().get());
 
-  // Track features for each camera in its own thread.
+  // Detect, match and reject outliers for each camera in its own thread.
   inlier_matches_kp1_k->resize(num_cameras);
   outlier_matches_kp1_k->resize(num_cameras);
+  std::vector<aslam::FrameToFrameMatchesWithScore>
+      inlier_matches_with_score_kp1_k(num_cameras);
+  std::vector<aslam::FrameToFrameMatchesWithScore>
+      outlier_matches_with_score_kp1_k(num_cameras);
 
   CHECK(thread_pool_);
+  const bool detect_features_in_frame_k =
+      !has_feature_extraction_been_performed_on_first_nframe_;
   for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
     aslam::VisualFrame* frame_kp1 =
         nframe_kp1->getFrameShared(camera_idx).get();
     aslam::VisualFrame* frame_k = nframe_k->getFrameShared(camera_idx).get();
     thread_pool_->enqueue(
         &VOFeatureTrackingPipeline::trackFeaturesSingleCamera, this, q_Bkp1_Bk,
-        camera_idx, frame_kp1, frame_k, &(*inlier_matches_kp1_k)[camera_idx],
-        &(*outlier_matches_kp1_k)[camera_idx]);
+        camera_idx, detect_features_in_frame_k, frame_kp1, frame_k,
+        &inlier_matches_with_score_kp1_k[camera_idx],
+        &outlier_matches_with_score_kp1_k[camera_idx]);
   }
   thread_pool_->waitForEmptyQueue();
+  has_feature_extraction_been_performed_on_first_nframe_ = true;
+
+  // The track managers draw new track ids from a shared counter, so the tracks
+  // are assigned sequentially in camera order. This keeps the track ids
+  // independent of the scheduling of the threads above.
+  timing::Timer timer_track_manager(
+      "swe-feature-tracker: trackFeaturesNFrame - track manager");
+  for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
+    aslam::VisualFrame* frame_kp1 =
+        nframe_kp1->getFrameShared(camera_idx).get();
+    aslam::VisualFrame* frame_k = nframe_k->getFrameShared(camera_idx).get();
+    applyTracksSingleCamera(
+        camera_idx, inlier_matches_with_score_kp1_k[camera_idx],
+        outlier_matches_with_score_kp1_k[camera_idx], frame_kp1, frame_k,
+        &(*inlier_matches_kp1_k)[camera_idx],
+        &(*outlier_matches_kp1_k)[camera_idx]);
+  }
+  timer_track_manager.Stop();
 
   timer_eval.Stop();
 }
 
 void VOFeatureTrackingPipeline::trackFeaturesSingleCamera(
     const aslam::Quaternion& q_Bkp1_Bk, const size_t camera_idx,
-    aslam::VisualFrame* frame_kp1, aslam::VisualFrame* frame_k,
-    aslam::FrameToFrameMatches* inlier_matches_kp1_k,
-    aslam::FrameToFrameMatches* outlier_matches_kp1_k) {
+    const bool detect_features_in_frame_k, aslam::VisualFrame* frame_kp1,
+    aslam::VisualFrame* frame_k,
+    aslam::FrameToFrameMatchesWithScore* inlier_matches_with_score_kp1_k,
+    aslam::FrameToFrameMatchesWithScore* outlier_matches_with_score_kp1_k) {
   timing::Timer timer("swe-feature-tracker: trackFeaturesSingleCamera");
-  CHECK_LE(camera_idx, track_managers_.size());
+  CHECK_LT(camera_idx, track_managers_.size());
   CHECK_NOTNULL(frame_k);
   CHECK_NOTNULL(frame_kp1);
-  CHECK_NOTNULL(inlier_matches_kp1_k);
-  CHECK_NOTNULL(outlier_matches_kp1_k);
-  inlier_matches_kp1_k->clear();
-  outlier_matches_kp1_k->clear();
-
-  // Initialize keypoints and descriptors in frame_k, if there aren't any.
-  if (!has_feature_extraction_been_performed_on_first_nframe_) {
-    detectors_extractors_[camera_idx]->detectAndExtractFeatures(frame_k);
-    has_feature_extraction_been_performed_on_first_nframe_ = true;
+  CHECK_NOTNULL(inlier_matches_with_score_kp1_k)->clear();
+  CHECK_NOTNULL(outlier_matches_with_score_kp1_k)->clear();
+
+  // In the pipelined tracking, the detection stage has already extracted the
+  // keypoints and descriptors of both frames.
+  if (!features_detected_in_separate_stage_) {
+    // Initialize keypoints and descriptors in frame_k, if there aren't any.
+    if (detect_features_in_frame_k) {
+      detectors_extractors_[camera_idx]->detectAndExtractFeatures(frame_k);
+    }
+    detectors_extractors_[camera_idx]->detectAndExtractFeatures(frame_kp1);
   }
-  detectors_extractors_[camera_idx]->detectAndExtractFeatures(frame_kp1);
 
   if (FLAGS_detection_visualize_keypoints) {
     cv::Mat image;
@@ -133,9 +161,6 @@ void VOFeatureTrackingPipeline::trackFeaturesSingleCamera(
   stat_tracking.AddSample(timer_tracking.Stop() * 1000);
 
   // Remove outlier matches.
-  aslam::FrameToFrameMatchesWithScore inlier_matches_with_score_kp1_k;
-  aslam::FrameToFrameMatchesWithScore outlier_matches_with_score_kp1_k;
-
   statistics::StatsCollector stat_ransac("Twopt RANSAC (1 image) in ms");
   timing::Timer timer_ransac(
       "swe-feature-tracker: trackFeaturesSingleCamera - ransac");
@@ -145,21 +170,34 @@ void VOFeatureTrackingPipeline::trackFeaturesSingleCamera(
           FLAGS_swe_feature_tracker_deterministic,
           FLAGS_swe_feature_tracker_two_pt_ransac_threshold,
           FLAGS_swe_feature_tracker_two_pt_ransac_max_iterations,
-          &inlier_matches_with_score_kp1_k, &outlier_matches_with_score_kp1_k);
+          inlier_matches_with_score_kp1_k, outlier_matches_with_score_kp1_k);
 
   stat_ransac.AddSample(timer_ransac.Stop() * 1000);
 
   LOG_IF(WARNING, !ransac_success)
       << "Match outlier rejection RANSAC failed on camera " << camera_idx
       << ".";
-  const size_t num_outliers = outlier_matches_with_score_kp1_k.size();
+  const size_t num_outliers = outlier_matches_with_score_kp1_k->size();
   VLOG_IF(3, num_outliers > 0) << "Removed " << num_outliers << " outliers of "
                                << matches_with_score_kp1_k.size()
                                << " matches on camera " << camera_idx << ".";
+}
+
+void VOFeatureTrackingPipeline::applyTracksSingleCamera(
+    const size_t camera_idx,
+    const aslam::FrameToFrameMatchesWithScore& inlier_matches_with_score_kp1_k,
+    const aslam::FrameToFrameMatchesWithScore&
+        outlier_matches_with_score_kp1_k,
+    aslam::VisualFrame* frame_kp1, aslam::VisualFrame* frame_k,
+    aslam::FrameToFrameMatches* inlier_matches_kp1_k,
+    aslam::FrameToFrameMatches* outlier_matches_kp1_k) {
+  CHECK_LT(camera_idx, track_managers_.size());
+  CHECK_NOTNULL(frame_k);
+  CHECK_NOTNULL(frame_kp1);
+  CHECK_NOTNULL(inlier_matches_kp1_k)->clear();
+  CHECK_NOTNULL(outlier_matches_kp1_k)->clear();
 
   // Assign track ids.
-  timing::Timer timer_track_manager(
-      "swe-feature-tracker: trackFeaturesSingleCamera - track manager");
   track_managers_[camera_idx]->applyMatchesToFrames(
       inlier_matches_with_score_kp1_k, frame_kp1, frame_k);
 
@@ -187,7 +225,32 @@ void VOFeatureTrackingPipeline::trackFeaturesSingleCamera(
                                       std::to_string(camera_idx);
     visualization::RVizVisualizationSink::publish(outlier_topic, outlier_image);
   }
-  timer_track_manager.Stop();
+}
+
+void VOFeatureTrackingPipeline::detectFeaturesNFrame(
+    aslam::VisualNFrame* nframe) {
+  CHECK_NOTNULL(nframe);
+  CHECK(ncamera_.get() == nframe->getNCameraShared().get());
+  timing::Timer timer("swe-feature-tracker: detectFeaturesNFrame");
+  const size_t num_cameras = nframe->getNumCameras();
+  if (!detection_stage_thread_pool_) {
+    detection_stage_thread_pool_.reset(
+        new aslam::ThreadPool(
+            common::getNumThreadsForSubsystem(
+                common::ThreadingSubsystem::kFeatureTracking, num_cameras)));
+    for (size_t cam_idx = 0u; cam_idx < num_cameras; ++cam_idx) {
+      detection_stage_detectors_extractors_.emplace_back(
+          new FeatureDetectorExtractor(ncamera_->getCamera(cam_idx)));
+    }
+  }
+  CHECK_EQ(num_cameras, detection_stage_detectors_extractors_.size());
+  for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
+    detection_stage_thread_pool_->enqueue(
+        &FeatureDetectorExtractor::detectAndExtractFeatures,
+        detection_stage_detectors_extractors_[camera_idx].get(),
+        nframe->getFrameShared(camera_idx).get());
+  }
+  detection_stage_thread_pool_->waitForEmptyQueue();
 }
 
 void VOFeatureTrackingPipeline::initialize(
@@ -196,7 +259,10 @@ void VOFeatureTrackingPipeline::initialize(
   ncamera_ = ncamera;
   // Create a thread pool.
   const size_t num_cameras = ncamera_->numCameras();
-  thread_pool_.reset(new aslam::ThreadPool(num_cameras));
+  thread_pool_.reset(
+      new aslam::ThreadPool(
+          common::getNumThreadsForSubsystem(
+              common::ThreadingSubsystem::kFeatureTracking, num_cameras)));
 
   // Create a feature tracker.
   detectors_extractors_.reserve(num_cameras);
@@ -229,5 +295,8 @@ VOFeatureTrackingPipeline::~VOFeatureTrackingPipeline() {
   if (thread_pool_) {
     thread_pool_->stop();
   }
+  if (detection_stage_thread_pool_) {
+    detection_stage_thread_pool_->stop();
+  }
 }
 }  // namespace feature_tracking
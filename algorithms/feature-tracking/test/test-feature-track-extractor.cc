@@ -1109,4 +1109,45 @@ TEST(FeatureTrackExtractor, TestExtractionWithTwoVisualFramesAndExtractBatch) {
   EXPECT_EQ(rig_tracks_batch[1][1].getTrackLength(), 2u);
 }
 
+TEST(FeatureTrackExtractor, TestExtractionFromStreamWithMaxTrackLength) {
+  // A single track observed in 7 frames is cut into tracks of the max. track
+  // length. The remainder is returned when the tracks are aborted.
+  aslam::NCamera::Ptr ncamera = aslam::NCamera::createTestNCamera(1);
+  const size_t kMaxTrackLength = 3u;
+  const size_t kMinTrackLength = 1u;
+  vio_common::FeatureTrackExtractor extractor(
+      ncamera, kMaxTrackLength, kMinTrackLength);
+
+  Eigen::VectorXi track_ids(2);
+  track_ids << 7, -1;
+  Eigen::Matrix2Xd keypoints = Eigen::Matrix2Xd::Ones(2, 2);
+  const size_t kNumFrames = 7u;
+  std::vector<size_t> cut_track_lengths;
+  for (size_t frame_idx = 0u; frame_idx < kNumFrames; ++frame_idx) {
+    aslam::VisualNFrame::Ptr nframe =
+        aslam::VisualNFrame::createEmptyTestVisualNFrame(ncamera, frame_idx);
+    nframe->getFrameShared(0)->setTrackIds(track_ids);
+    nframe->getFrameShared(0)->setKeypointMeasurements(keypoints);
+
+    aslam::FeatureTracksList all_tracks;
+    extractor.extractFromNFrameStream(nframe, &all_tracks);
+    ASSERT_EQ(all_tracks.size(), 1u);
+    for (const aslam::FeatureTrack& track : all_tracks[0]) {
+      EXPECT_EQ(track.getTrackId(), 7);
+      cut_track_lengths.push_back(track.getTrackLength());
+    }
+    EXPECT_EQ(extractor.getNumOpportunisticTracks(0u), 1u);
+  }
+  ASSERT_EQ(cut_track_lengths.size(), 2u);
+  EXPECT_EQ(cut_track_lengths[0], kMaxTrackLength);
+  EXPECT_EQ(cut_track_lengths[1], kMaxTrackLength);
+
+  aslam::FeatureTracksList aborted_tracks;
+  EXPECT_EQ(extractor.abortAndReturnOpportunisticTracks(&aborted_tracks), 1u);
+  ASSERT_EQ(aborted_tracks.size(), 1u);
+  ASSERT_EQ(aborted_tracks[0].size(), 1u);
+  EXPECT_EQ(aborted_tracks[0][0].getTrackLength(), 1u);
+  EXPECT_EQ(extractor.getNumOpportunisticTracks(0u), 0u);
+}
+
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,53 @@
+#ifndef GEOMETRIC_VISION_BATCHED_FIVE_POINT_POSE_ESTIMATOR_H_
+#define GEOMETRIC_VISION_BATCHED_FIVE_POINT_POSE_ESTIMATOR_H_
+
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/cameras/camera.h>
+#include <maplab-common/pose_types.h>
+
+namespace opengv_pose_estimation {
+
+// Drop-in replacement for FivePointPoseEstimator that solves a batch of
+// minimal five-point samples at a time and scores every hypothesis against
+// all correspondences at once. The bearing vectors are stored in contiguous
+// arrays, such that the triangulation and the reprojection errors of all
+// correspondences are a few matrix expressions that Eigen vectorizes, instead
+// of a virtual call and a 2x2 inversion per correspondence and hypothesis.
+//
+// The minimal solver (Nister) and the inlier criterion, the sum of 1 - cos of
+// the reprojection angles in both frames of the midpoint triangulation, are
+// the ones of OpenGV's CentralRelativePoseSacProblem.
+class BatchedFivePointPoseEstimator {
+ public:
+  BatchedFivePointPoseEstimator() : random_seed_(true) {}
+  // If random_seed is false, the samples are drawn from a fixed seed and the
+  // result is deterministic.
+  explicit BatchedFivePointPoseEstimator(bool random_seed)
+      : random_seed_(random_seed) {}
+
+  void ComputePinhole(
+      const Eigen::Matrix2Xd& measurements_a,
+      const Eigen::Matrix2Xd& measurements_b, double pixel_sigma,
+      unsigned int max_ransac_iters, aslam::Camera::ConstPtr camera_ptr,
+      pose::Transformation* output_transform, std::vector<int>* inlier_matches);
+  void Compute(
+      const Eigen::Matrix2Xd& measurements_a,
+      const Eigen::Matrix2Xd& measurements_b, double ransac_threshold,
+      unsigned int max_ransac_iters, aslam::Camera::ConstPtr camera_ptr,
+      pose::Transformation* output_transform, std::vector<int>* inlier_matches);
+
+ private:
+  // Number of minimal samples drawn and scored together.
+  static constexpr int kNumHypothesesPerBatch = 8;
+  // Probability of drawing at least one outlier-free sample used to adapt the
+  // number of iterations to the inlier ratio.
+  static constexpr double kRansacSuccessProbability = 0.99;
+
+  const bool random_seed_;
+};
+
+}  // namespace opengv_pose_estimation
+
+#endif  // GEOMETRIC_VISION_BATCHED_FIVE_POINT_POSE_ESTIMATOR_H_
@@ -30,6 +30,21 @@ class LinearTriangulation {
       const Aligned<std::vector, Eigen::Vector2d>& measurements,
       const Aligned<std::vector, pose::Transformation>& G_T_C,
       Eigen::Vector3d* triangulated_point);
+
+  // Triangulates many points at once from bearing vectors and camera
+  // positions in the global frame that are packed for all points into one
+  // array. The observations of point i are the columns
+  // [observation_offsets[i], observation_offsets[i + 1]), hence there is one
+  // offset more than there are points. Like aslam::linearTriangulateFromNViews
+  // this minimizes the squared distances of the point to the observation rays.
+  // The normal equations are accumulated with fixed-size matrices and solved
+  // in closed form vectorized across all points, without any allocation per
+  // point. success[i] is false if point i has fewer than two observations or
+  // its position is unobservable, e.g. without parallax.
+  void triangulateBatchFromBearings(
+      const Eigen::Matrix3Xd& G_bearing_vectors, const Eigen::Matrix3Xd& G_p_C,
+      const std::vector<size_t>& observation_offsets,
+      Eigen::Matrix3Xd* G_triangulated_points, std::vector<bool>* success);
 };
 
 }  // namespace geometric_vision
@@ -0,0 +1,73 @@
+#ifndef GEOMETRIC_VISION_MULTI_HYPOTHESIS_PNP_H_
+#define GEOMETRIC_VISION_MULTI_HYPOTHESIS_PNP_H_
+
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/pose-types.h>
+#include <maplab-common/pose_types.h>
+
+namespace geometric_vision {
+
+// Absolute pose RANSAC for (multi-)camera rigs that solves a batch of minimal
+// GP3P hypotheses at a time and scores all of them against all
+// correspondences at once. The correspondences are grouped by camera into
+// contiguous arrays, such that scoring a hypothesis reduces to a few matrix
+// expressions over all correspondences of a camera that Eigen vectorizes,
+// instead of a virtual call per correspondence and hypothesis.
+//
+// The interface and the inlier criterion, 1 - cos of the angle between the
+// measured and the reprojected bearing vector, follow
+// aslam::geometric_vision::PnpPoseEstimator.
+class MultiHypothesisPnp {
+ public:
+  // If random_seed is false, the hypotheses are drawn from a fixed seed and
+  // the result is deterministic.
+  MultiHypothesisPnp(bool run_nonlinear_refinement, bool random_seed)
+      : run_nonlinear_refinement_(run_nonlinear_refinement),
+        random_seed_(random_seed) {}
+
+  // Back-projects the keypoint measurements of the pinhole cameras of the rig
+  // and derives the RANSAC threshold from the pixel sigma.
+  // @param[in] measurements Keypoint measurements, one per column.
+  // @param[in] measurement_camera_indices Camera index of every measurement.
+  // @param[in] G_landmark_positions Landmark position of every measurement.
+  // @param[out] T_G_I Estimated pose of the rig body in the global frame.
+  // @param[out] inliers Indices of the inlier measurements.
+  // @param[out] inlier_distances_to_model Score of every inlier.
+  // @param[out] num_iters Number of evaluated hypotheses.
+  // @return True if a pose with at least three inliers was found.
+  bool absoluteMultiPoseRansacPinholeCam(
+      const Eigen::Matrix2Xd& measurements,
+      const std::vector<int>& measurement_camera_indices,
+      const Eigen::Matrix3Xd& G_landmark_positions, double pixel_sigma,
+      int max_ransac_iters, const aslam::NCamera::ConstPtr& ncamera,
+      pose::Transformation* T_G_I, std::vector<int>* inliers,
+      std::vector<double>* inlier_distances_to_model, int* num_iters) const;
+
+  // Same as above with bearing vectors in the frame of the observing camera
+  // and a threshold on 1 - cos of the reprojection angle.
+  bool absoluteMultiPoseRansac(
+      const Eigen::Matrix3Xd& C_bearing_vectors,
+      const std::vector<int>& measurement_camera_indices,
+      const Eigen::Matrix3Xd& G_landmark_positions,
+      const aslam::TransformationVector& T_C_B, double ransac_threshold,
+      int max_ransac_iters, pose::Transformation* T_G_I,
+      std::vector<int>* inliers, std::vector<double>* inlier_distances_to_model,
+      int* num_iters) const;
+
+ private:
+  // Number of minimal samples drawn and scored together.
+  static constexpr int kNumHypothesesPerBatch = 8;
+  // Probability of drawing at least one outlier-free sample used to adapt the
+  // number of iterations to the inlier ratio.
+  static constexpr double kRansacSuccessProbability = 0.99;
+
+  const bool run_nonlinear_refinement_;
+  const bool random_seed_;
+};
+
+}  // namespace geometric_vision
+
+#endif  // GEOMETRIC_VISION_MULTI_HYPOTHESIS_PNP_H_
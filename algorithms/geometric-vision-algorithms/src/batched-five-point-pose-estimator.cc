@@ -0,0 +1,241 @@
+#include "geometric-vision/batched-five-point-pose-estimator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <glog/logging.h>
+#include <opengv/relative_pose/CentralRelativeAdapter.hpp>
+#include <opengv/sac_problems/relative_pose/CentralRelativePoseSacProblem.hpp>
+
+namespace opengv_pose_estimation {
+namespace {
+typedef Eigen::Array<double, 1, Eigen::Dynamic> RowArray;
+
+// Scores a relative pose hypothesis A_T_B against all correspondences with
+// the criterion of OpenGV's CentralRelativePoseSacProblem: every
+// correspondence is triangulated at the midpoint of the closest points of
+// both rays and the distance is the sum of 1 - cos of the angles between the
+// bearing vectors and the reprojections of the midpoint into both frames.
+class RelativePoseInlierScorer {
+ public:
+  RelativePoseInlierScorer(
+      const Eigen::Matrix3Xd& bearing_vectors_a,
+      const Eigen::Matrix3Xd& bearing_vectors_b)
+      : bearing_vectors_a_(bearing_vectors_a),
+        bearing_vectors_b_(bearing_vectors_b),
+        squared_norms_a_(bearing_vectors_a.colwise().squaredNorm().array()),
+        squared_norms_b_(bearing_vectors_b.colwise().squaredNorm().array()) {
+    CHECK_EQ(bearing_vectors_a.cols(), bearing_vectors_b.cols());
+  }
+
+  // Returns the number of correspondences with a distance to the model below
+  // the threshold. The distances of all correspondences are only written if
+  // distances_to_model is not null.
+  int countInliers(
+      const opengv::transformation_t& model, const double threshold,
+      RowArray* distances_to_model) const {
+    const Eigen::Matrix3d A_R_B = model.leftCols<3>();
+    const Eigen::Vector3d A_t_B = model.col(3);
+
+    // Bearing vectors of frame B rotated into frame A.
+    const Eigen::Matrix3Xd A_bearing_vectors_b = A_R_B * bearing_vectors_b_;
+    const RowArray dot_ab =
+        bearing_vectors_a_.cwiseProduct(A_bearing_vectors_b)
+            .colwise()
+            .sum()
+            .array();
+    const RowArray t_dot_a = (A_t_B.transpose() * bearing_vectors_a_).array();
+    const RowArray t_dot_b =
+        (A_t_B.transpose() * A_bearing_vectors_b).array();
+
+    // Closed-form inverse of the 2x2 system of opengv::triangulation::
+    // triangulate2 for the depths along both rays. Parallel rays yield
+    // non-finite distances and are never inliers.
+    const RowArray inverse_determinant =
+        (dot_ab.square() - squared_norms_a_ * squared_norms_b_).inverse();
+    const RowArray depths_a =
+        (dot_ab * t_dot_b - squared_norms_b_ * t_dot_a) * inverse_determinant;
+    const RowArray depths_b =
+        (squared_norms_a_ * t_dot_b - dot_ab * t_dot_a) * inverse_determinant;
+    Eigen::Matrix3Xd A_points =
+        0.5 * (bearing_vectors_a_.array().rowwise() * depths_a +
+               A_bearing_vectors_b.array().rowwise() * depths_b)
+                  .matrix();
+    A_points.colwise() += 0.5 * A_t_B;
+
+    // The reprojection into frame B is evaluated in frame A, the rotation
+    // does not change the angle to the rotated bearing vector.
+    const RowArray distances_a =
+        1.0 - bearing_vectors_a_.cwiseProduct(A_points)
+                      .colwise()
+                      .sum()
+                      .array() /
+                  A_points.colwise().norm().array();
+    A_points.colwise() -= A_t_B;
+    const RowArray distances_b =
+        1.0 - A_bearing_vectors_b.cwiseProduct(A_points)
+                      .colwise()
+                      .sum()
+                      .array() /
+                  A_points.colwise().norm().array();
+    if (distances_to_model != nullptr) {
+      *distances_to_model = distances_a + distances_b;
+      return (*distances_to_model < threshold).count();
+    }
+    return (distances_a + distances_b < threshold).count();
+  }
+
+ private:
+  const Eigen::Matrix3Xd& bearing_vectors_a_;
+  const Eigen::Matrix3Xd& bearing_vectors_b_;
+  const RowArray squared_norms_a_;
+  const RowArray squared_norms_b_;
+};
+}  // namespace
+
+constexpr int BatchedFivePointPoseEstimator::kNumHypothesesPerBatch;
+constexpr double BatchedFivePointPoseEstimator::kRansacSuccessProbability;
+
+void BatchedFivePointPoseEstimator::ComputePinhole(
+    const Eigen::Matrix2Xd& measurements_a,
+    const Eigen::Matrix2Xd& measurements_b, double pixel_sigma,
+    unsigned int max_ransac_iters, aslam::Camera::ConstPtr camera_ptr,
+    pose::Transformation* output_transform, std::vector<int>* inlier_matches) {
+  CHECK_NOTNULL(output_transform);
+  CHECK_NOTNULL(inlier_matches);
+  CHECK_EQ(measurements_a.cols(), measurements_b.cols());
+
+  aslam::PinholeCamera::ConstPtr pinhole_camera_ptr =
+      std::static_pointer_cast<const aslam::PinholeCamera>(camera_ptr);
+  CHECK(pinhole_camera_ptr)
+      << "Couldn't cast camera pointer to pinhole camera type.";
+
+  const double focal_length =
+      (pinhole_camera_ptr->fu() + pinhole_camera_ptr->fv()) / 2.0;
+  const double ransac_threshold = 1.0 - cos(atan(pixel_sigma / focal_length));
+
+  Compute(
+      measurements_a, measurements_b, ransac_threshold, max_ransac_iters,
+      camera_ptr, output_transform, inlier_matches);
+}
+
+void BatchedFivePointPoseEstimator::Compute(
+    const Eigen::Matrix2Xd& measurements_a,
+    const Eigen::Matrix2Xd& measurements_b, double ransac_threshold,
+    unsigned int max_ransac_iters, aslam::Camera::ConstPtr camera_ptr,
+    pose::Transformation* output_transform, std::vector<int>* inlier_matches) {
+  CHECK_NOTNULL(output_transform)->setIdentity();
+  CHECK_NOTNULL(inlier_matches)->clear();
+  CHECK(camera_ptr);
+  CHECK_EQ(measurements_a.cols(), measurements_b.cols());
+  constexpr int kMinimalSampleSize = 5;
+  CHECK_GE(measurements_a.cols(), kMinimalSampleSize);
+  const int num_correspondences = measurements_a.cols();
+  const int max_iters = static_cast<int>(max_ransac_iters);
+
+  Eigen::Matrix3Xd bearing_vectors_a(3, num_correspondences);
+  Eigen::Matrix3Xd bearing_vectors_b(3, num_correspondences);
+  opengv::bearingVectors_t opengv_bearing_vectors_a(num_correspondences);
+  opengv::bearingVectors_t opengv_bearing_vectors_b(num_correspondences);
+  for (int i = 0; i < num_correspondences; ++i) {
+    camera_ptr->backProject3(
+        measurements_a.col(i), &opengv_bearing_vectors_a[i]);
+    opengv_bearing_vectors_a[i].normalize();
+    bearing_vectors_a.col(i) = opengv_bearing_vectors_a[i];
+    camera_ptr->backProject3(
+        measurements_b.col(i), &opengv_bearing_vectors_b[i]);
+    opengv_bearing_vectors_b[i].normalize();
+    bearing_vectors_b.col(i) = opengv_bearing_vectors_b[i];
+  }
+  const RelativePoseInlierScorer scorer(bearing_vectors_a, bearing_vectors_b);
+
+  // The minimal solver and the disambiguation of the decompositions of the
+  // essential matrices are the ones of OpenGV.
+  opengv::relative_pose::CentralRelativeAdapter adapter(
+      opengv_bearing_vectors_a, opengv_bearing_vectors_b,
+      opengv::rotation_t::Identity());
+  typedef opengv::sac_problems::relative_pose::CentralRelativePoseSacProblem
+      RelativePoseSacProblem;
+  const RelativePoseSacProblem relative_pose_problem(
+      adapter, RelativePoseSacProblem::NISTER);
+
+  std::mt19937 random_engine(
+      random_seed_ ? std::random_device()() : std::mt19937::default_seed);
+  std::uniform_int_distribution<int> index_distribution(
+      0, num_correspondences - 1);
+
+  int best_num_inliers = 0;
+  opengv::transformation_t best_model;
+  int num_iters = 0;
+  int num_required_iters = max_iters;
+  std::vector<int> sample(kMinimalSampleSize);
+  opengv::transformations_t hypotheses;
+  hypotheses.reserve(kNumHypothesesPerBatch);
+  while (num_iters < num_required_iters) {
+    // Solve a batch of minimal samples first, then score all hypotheses.
+    hypotheses.clear();
+    const int num_samples =
+        std::min(kNumHypothesesPerBatch, num_required_iters - num_iters);
+    for (int sample_idx = 0; sample_idx < num_samples; ++sample_idx) {
+      for (int i = 0; i < kMinimalSampleSize; ++i) {
+        do {
+          sample[i] = index_distribution(random_engine);
+        } while (std::find(sample.begin(), sample.begin() + i, sample[i]) !=
+                 sample.begin() + i);
+      }
+      opengv::transformation_t hypothesis;
+      if (relative_pose_problem.computeModelCoefficients(sample, hypothesis) &&
+          hypothesis.allFinite()) {
+        hypotheses.push_back(hypothesis);
+      }
+    }
+    num_iters += num_samples;
+
+    for (const opengv::transformation_t& hypothesis : hypotheses) {
+      const int num_inliers =
+          scorer.countInliers(hypothesis, ransac_threshold, nullptr);
+      if (num_inliers > best_num_inliers) {
+        best_num_inliers = num_inliers;
+        best_model = hypothesis;
+      }
+    }
+
+    if (best_num_inliers > 0) {
+      // Adapt the number of iterations to the best inlier ratio so far.
+      const double inlier_ratio = static_cast<double>(best_num_inliers) /
+                                  static_cast<double>(num_correspondences);
+      const double p_no_outliers = std::min(
+          1.0 - std::numeric_limits<double>::epsilon(),
+          std::pow(inlier_ratio, kMinimalSampleSize));
+      const double num_iters_for_success =
+          std::log(1.0 - kRansacSuccessProbability) /
+          std::log(1.0 - p_no_outliers);
+      num_required_iters = static_cast<int>(std::min(
+          static_cast<double>(max_iters), std::ceil(num_iters_for_success)));
+    }
+  }
+
+  if (best_num_inliers == 0) {
+    return;
+  }
+
+  RowArray distances_to_model;
+  scorer.countInliers(best_model, ransac_threshold, &distances_to_model);
+  inlier_matches->reserve(best_num_inliers);
+  for (int i = 0; i < num_correspondences; ++i) {
+    if (distances_to_model(i) < ransac_threshold) {
+      inlier_matches->push_back(i);
+    }
+  }
+
+  output_transform->getPosition() = best_model.rightCols(1);
+  const Eigen::Matrix3d A_R_B = best_model.leftCols(3);
+  output_transform->getRotation().toImplementation() =
+      Eigen::Quaterniond(A_R_B).normalized();
+}
+
+}  // namespace opengv_pose_estimation
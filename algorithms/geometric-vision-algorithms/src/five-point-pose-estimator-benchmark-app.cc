@@ -0,0 +1,145 @@
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/cameras/distortion-null.h>
+#include <aslam/common/timer.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <maplab-common/pose_types.h>
+
+#include "geometric-vision/batched-five-point-pose-estimator.h"
+#include "geometric-vision/five-point-pose-estimator.h"
+
+// Times FivePointPoseEstimator against BatchedFivePointPoseEstimator on
+// synthetic two-view problems of a pinhole camera:
+//   five_point_pose_estimator_benchmark --fp_benchmark_num_correspondences=500
+// Every repetition draws new landmarks and outliers, both estimators solve the
+// same problem. The timings and the mean number of inliers and rotation
+// errors of both estimators are reported.
+
+DEFINE_int32(
+    fp_benchmark_num_correspondences, 200,
+    "Number of correspondences per problem.");
+DEFINE_double(
+    fp_benchmark_outlier_ratio, 0.3,
+    "Ratio of the correspondences that are outliers.");
+DEFINE_int32(
+    fp_benchmark_num_repetitions, 100, "Number of problems to solve.");
+DEFINE_int32(
+    fp_benchmark_max_ransac_iters, 500,
+    "Maximum number of RANSAC iterations of both estimators.");
+
+namespace {
+constexpr double kPixelSigma = 0.8;
+
+void createProblem(
+    const aslam::PinholeCamera& camera, const pose::Transformation& T_A_B,
+    Eigen::Matrix2Xd* measurements_a, Eigen::Matrix2Xd* measurements_b) {
+  CHECK_NOTNULL(measurements_a);
+  CHECK_NOTNULL(measurements_b);
+  const int num_correspondences = FLAGS_fp_benchmark_num_correspondences;
+  const int num_inliers = static_cast<int>(
+      (1.0 - FLAGS_fp_benchmark_outlier_ratio) * num_correspondences);
+  measurements_a->resize(Eigen::NoChange, num_correspondences);
+  measurements_b->resize(Eigen::NoChange, num_correspondences);
+  const pose::Transformation T_B_A = T_A_B.inverse();
+  for (int i = 0; i < num_correspondences;) {
+    const Eigen::Vector3d A_p_fi = camera.createRandomVisiblePoint(i % 5 + 2);
+    Eigen::Vector2d keypoint_a;
+    Eigen::Vector2d keypoint_b;
+    if (!camera.project3(A_p_fi, &keypoint_a).isKeypointVisible() ||
+        !camera.project3(T_B_A * A_p_fi, &keypoint_b).isKeypointVisible()) {
+      continue;
+    }
+    if (i >= num_inliers) {
+      keypoint_b = camera.createRandomKeypoint();
+    } else {
+      keypoint_a += kPixelSigma * Eigen::Vector2d::Random();
+      keypoint_b += kPixelSigma * Eigen::Vector2d::Random();
+    }
+    measurements_a->col(i) = keypoint_a;
+    measurements_b->col(i) = keypoint_b;
+    ++i;
+  }
+}
+
+double rotationError(
+    const pose::Transformation& T_estimated,
+    const pose::Transformation& T_expected) {
+  return (T_estimated.getRotation().inverse() * T_expected.getRotation())
+      .log()
+      .norm();
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InstallFailureSignalHandler();
+  FLAGS_alsologtostderr = true;
+  FLAGS_colorlogtostderr = true;
+  CHECK_GE(FLAGS_fp_benchmark_num_correspondences, 5);
+  CHECK_GE(FLAGS_fp_benchmark_outlier_ratio, 0.0);
+  CHECK_LT(FLAGS_fp_benchmark_outlier_ratio, 1.0);
+
+  Eigen::VectorXd intrinsics(4);
+  intrinsics << 400, 400, 320, 240;
+  aslam::Distortion::UniquePtr distortion(new aslam::NullDistortion);
+  const aslam::PinholeCamera::ConstPtr camera(
+      new aslam::PinholeCamera(intrinsics, 640u, 480u, distortion));
+
+  opengv_pose_estimation::FivePointPoseEstimator estimator;
+  opengv_pose_estimation::BatchedFivePointPoseEstimator batched_estimator;
+
+  size_t num_inliers = 0u;
+  size_t batched_num_inliers = 0u;
+  double rotation_error = 0.0;
+  double batched_rotation_error = 0.0;
+  for (int repetition = 0; repetition < FLAGS_fp_benchmark_num_repetitions;
+       ++repetition) {
+    const Eigen::Vector3d axis = Eigen::Vector3d::Random().normalized();
+    const pose::Transformation T_A_B(
+        pose::Quaternion(Eigen::Quaterniond(Eigen::AngleAxisd(0.1, axis))),
+        Eigen::Vector3d(0.5, 0.1, 0.05));
+    Eigen::Matrix2Xd measurements_a;
+    Eigen::Matrix2Xd measurements_b;
+    createProblem(*camera, T_A_B, &measurements_a, &measurements_b);
+
+    pose::Transformation T_A_B_estimated;
+    std::vector<int> inliers;
+    timing::Timer timer("FivePointPoseEstimator");
+    estimator.ComputePinhole(
+        measurements_a, measurements_b, kPixelSigma,
+        FLAGS_fp_benchmark_max_ransac_iters, camera, &T_A_B_estimated,
+        &inliers);
+    timer.Stop();
+    num_inliers += inliers.size();
+    rotation_error += rotationError(T_A_B_estimated, T_A_B);
+
+    timing::Timer batched_timer("BatchedFivePointPoseEstimator");
+    batched_estimator.ComputePinhole(
+        measurements_a, measurements_b, kPixelSigma,
+        FLAGS_fp_benchmark_max_ransac_iters, camera, &T_A_B_estimated,
+        &inliers);
+    batched_timer.Stop();
+    batched_num_inliers += inliers.size();
+    batched_rotation_error += rotationError(T_A_B_estimated, T_A_B);
+  }
+
+  const double num_repetitions =
+      static_cast<double>(FLAGS_fp_benchmark_num_repetitions);
+  LOG(INFO) << "FivePointPoseEstimator: "
+            << num_inliers / num_repetitions << " inliers and "
+            << rotation_error / num_repetitions
+            << " rad rotation error on average.";
+  LOG(INFO) << "BatchedFivePointPoseEstimator: "
+            << batched_num_inliers / num_repetitions << " inliers and "
+            << batched_rotation_error / num_repetitions
+            << " rad rotation error on average.";
+  timing::Timing::Print(std::cout);
+  return 0;
+}
@@ -5,6 +5,23 @@
 #include <maplab-common/quaternion-math.h>
 
 namespace geometric_vision {
+namespace {
+// Unique coefficients of the symmetric normal equations A * p = b of one
+// point. Every coefficient is stored contiguously for all points such that
+// the solve vectorizes across the points.
+enum NormalEquationCoefficient {
+  kA00,
+  kA01,
+  kA02,
+  kA11,
+  kA12,
+  kA22,
+  kB0,
+  kB1,
+  kB2,
+  kNumNormalEquationCoefficients
+};
+}  // namespace
 
 bool LinearTriangulation::triangulateFromNormalizedTwoViewsHomogeneous(
     const Eigen::Vector2d& measurement0,
@@ -145,4 +162,90 @@ bool LinearTriangulation::triangulateFromNormalizedNViews(
   return true;
 }
 
+void LinearTriangulation::triangulateBatchFromBearings(
+    const Eigen::Matrix3Xd& G_bearing_vectors, const Eigen::Matrix3Xd& G_p_C,
+    const std::vector<size_t>& observation_offsets,
+    Eigen::Matrix3Xd* G_triangulated_points, std::vector<bool>* success) {
+  CHECK_NOTNULL(G_triangulated_points);
+  CHECK_NOTNULL(success);
+  CHECK_EQ(G_bearing_vectors.cols(), G_p_C.cols());
+  CHECK(!observation_offsets.empty());
+  CHECK_LE(
+      observation_offsets.back(),
+      static_cast<size_t>(G_bearing_vectors.cols()));
+  const size_t num_points = observation_offsets.size() - 1u;
+
+  // Every observation constrains the point to its ray, which contributes
+  // (I - v * v^T) * (p - p_C) = 0 with the unit bearing vector v.
+  Eigen::Matrix<double, Eigen::Dynamic, kNumNormalEquationCoefficients>
+      normal_equations(num_points, kNumNormalEquationCoefficients);
+  std::vector<bool> has_enough_observations(num_points);
+  for (size_t point_idx = 0u; point_idx < num_points; ++point_idx) {
+    const size_t begin = observation_offsets[point_idx];
+    const size_t end = observation_offsets[point_idx + 1u];
+    CHECK_LE(begin, end);
+    has_enough_observations[point_idx] = (end - begin) >= 2u;
+
+    Eigen::Matrix3d A = Eigen::Matrix3d::Zero();
+    Eigen::Vector3d b = Eigen::Vector3d::Zero();
+    for (size_t observation_idx = begin; observation_idx < end;
+         ++observation_idx) {
+      const double squared_norm =
+          G_bearing_vectors.col(observation_idx).squaredNorm();
+      if (squared_norm == 0.0) {
+        continue;
+      }
+      const Eigen::Matrix3d ray_projection =
+          Eigen::Matrix3d::Identity() -
+          G_bearing_vectors.col(observation_idx) *
+              G_bearing_vectors.col(observation_idx).transpose() /
+              squared_norm;
+      A += ray_projection;
+      b += ray_projection * G_p_C.col(observation_idx);
+    }
+    normal_equations.row(point_idx) << A(0, 0), A(0, 1), A(0, 2), A(1, 1),
+        A(1, 2), A(2, 2), b(0), b(1), b(2);
+  }
+
+  // Closed-form inverse of the symmetric 3x3 matrices from their cofactors.
+  const Eigen::ArrayXd a00 = normal_equations.col(kA00).array();
+  const Eigen::ArrayXd a01 = normal_equations.col(kA01).array();
+  const Eigen::ArrayXd a02 = normal_equations.col(kA02).array();
+  const Eigen::ArrayXd a11 = normal_equations.col(kA11).array();
+  const Eigen::ArrayXd a12 = normal_equations.col(kA12).array();
+  const Eigen::ArrayXd a22 = normal_equations.col(kA22).array();
+  const Eigen::ArrayXd b0 = normal_equations.col(kB0).array();
+  const Eigen::ArrayXd b1 = normal_equations.col(kB1).array();
+  const Eigen::ArrayXd b2 = normal_equations.col(kB2).array();
+
+  const Eigen::ArrayXd c00 = a11 * a22 - a12 * a12;
+  const Eigen::ArrayXd c01 = a02 * a12 - a01 * a22;
+  const Eigen::ArrayXd c02 = a01 * a12 - a02 * a11;
+  const Eigen::ArrayXd c11 = a00 * a22 - a02 * a02;
+  const Eigen::ArrayXd c12 = a01 * a02 - a00 * a12;
+  const Eigen::ArrayXd c22 = a00 * a11 - a01 * a01;
+  const Eigen::ArrayXd determinant = a00 * c00 + a01 * c01 + a02 * c02;
+
+  G_triangulated_points->resize(Eigen::NoChange, num_points);
+  G_triangulated_points->row(0) =
+      ((c00 * b0 + c01 * b1 + c02 * b2) / determinant).matrix().transpose();
+  G_triangulated_points->row(1) =
+      ((c01 * b0 + c11 * b1 + c12 * b2) / determinant).matrix().transpose();
+  G_triangulated_points->row(2) =
+      ((c02 * b0 + c12 * b1 + c22 * b2) / determinant).matrix().transpose();
+
+  // The matrix is positive semi-definite, hence its determinant is the product
+  // of its eigenvalues. A rank loss shows as a determinant that is small
+  // compared to the cube of the mean eigenvalue.
+  static constexpr double kRankLossTolerance = 1e-5;
+  const Eigen::ArrayXd mean_eigenvalue = (a00 + a11 + a22) / 3.0;
+  const Eigen::ArrayXd min_determinant =
+      kRankLossTolerance * mean_eigenvalue.cube();
+  success->resize(num_points);
+  for (size_t point_idx = 0u; point_idx < num_points; ++point_idx) {
+    (*success)[point_idx] = has_enough_observations[point_idx] &&
+                            determinant(point_idx) > min_determinant(point_idx);
+  }
+}
+
 }  // namespace geometric_vision
@@ -0,0 +1,315 @@
+#include "geometric-vision/multi-hypothesis-pnp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <glog/logging.h>
+#include <opengv/absolute_pose/NoncentralAbsoluteAdapter.hpp>
+#include <opengv/absolute_pose/methods.hpp>
+
+namespace geometric_vision {
+namespace {
+// Correspondences grouped by camera, such that a hypothesis is scored with
+// dense matrix expressions over all correspondences of a camera.
+class InlierScorer {
+ public:
+  InlierScorer(
+      const Eigen::Matrix3Xd& C_bearing_vectors,
+      const std::vector<int>& measurement_camera_indices,
+      const Eigen::Matrix3Xd& G_landmark_positions,
+      const aslam::TransformationVector& T_C_B)
+      : num_correspondences_(C_bearing_vectors.cols()) {
+    const size_t num_cameras = T_C_B.size();
+    std::vector<int> num_correspondences_of_camera(num_cameras, 0);
+    for (const int camera_idx : measurement_camera_indices) {
+      CHECK_GE(camera_idx, 0);
+      CHECK_LT(camera_idx, static_cast<int>(num_cameras));
+      ++num_correspondences_of_camera[camera_idx];
+    }
+
+    cameras_.resize(num_cameras);
+    for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
+      CameraCorrespondences& camera = cameras_[camera_idx];
+      camera.R_C_B = T_C_B[camera_idx].getRotationMatrix();
+      camera.p_C_B = T_C_B[camera_idx].getPosition();
+      camera.C_bearing_vectors.resize(
+          Eigen::NoChange, num_correspondences_of_camera[camera_idx]);
+      camera.G_landmark_positions.resize(
+          Eigen::NoChange, num_correspondences_of_camera[camera_idx]);
+      camera.measurement_indices.reserve(
+          num_correspondences_of_camera[camera_idx]);
+    }
+    for (int measurement_idx = 0; measurement_idx < num_correspondences_;
+         ++measurement_idx) {
+      CameraCorrespondences& camera =
+          cameras_[measurement_camera_indices[measurement_idx]];
+      const int column = static_cast<int>(camera.measurement_indices.size());
+      camera.C_bearing_vectors.col(column) =
+          C_bearing_vectors.col(measurement_idx).normalized();
+      camera.G_landmark_positions.col(column) =
+          G_landmark_positions.col(measurement_idx);
+      camera.measurement_indices.push_back(measurement_idx);
+    }
+  }
+
+  // Returns the number of correspondences with a distance to the model below
+  // the threshold. The distances of all correspondences are only written if
+  // distances_to_model is not null.
+  int countInliers(
+      const Eigen::Matrix3d& R_G_B, const Eigen::Vector3d& p_G_B,
+      const double threshold, Eigen::VectorXd* distances_to_model) const {
+    if (distances_to_model != nullptr) {
+      distances_to_model->resize(num_correspondences_);
+    }
+    const Eigen::Matrix3d R_B_G = R_G_B.transpose();
+    const Eigen::Vector3d p_B_G = -R_B_G * p_G_B;
+    int num_inliers = 0;
+    for (const CameraCorrespondences& camera : cameras_) {
+      if (camera.measurement_indices.empty()) {
+        continue;
+      }
+      const Eigen::Matrix3d R_C_G = camera.R_C_B * R_B_G;
+      const Eigen::Vector3d p_C_G = camera.R_C_B * p_B_G + camera.p_C_B;
+      const Eigen::Matrix3Xd C_landmark_positions =
+          (R_C_G * camera.G_landmark_positions).colwise() + p_C_G;
+      const Eigen::ArrayXd distances =
+          1.0 -
+          (C_landmark_positions.cwiseProduct(camera.C_bearing_vectors)
+               .colwise()
+               .sum()
+               .array() /
+           C_landmark_positions.colwise().norm().array())
+              .transpose();
+      num_inliers += (distances < threshold).count();
+      if (distances_to_model != nullptr) {
+        for (size_t i = 0u; i < camera.measurement_indices.size(); ++i) {
+          (*distances_to_model)(camera.measurement_indices[i]) = distances(i);
+        }
+      }
+    }
+    return num_inliers;
+  }
+
+ private:
+  struct CameraCorrespondences {
+    Eigen::Matrix3d R_C_B;
+    Eigen::Vector3d p_C_B;
+    Eigen::Matrix3Xd C_bearing_vectors;
+    Eigen::Matrix3Xd G_landmark_positions;
+    std::vector<int> measurement_indices;
+  };
+
+  const int num_correspondences_;
+  std::vector<CameraCorrespondences> cameras_;
+};
+
+bool isFiniteTransformation(const opengv::transformation_t& transformation) {
+  return transformation.allFinite() &&
+         std::abs(transformation.leftCols<3>().determinant() - 1.0) < 1e-6;
+}
+}  // namespace
+
+constexpr int MultiHypothesisPnp::kNumHypothesesPerBatch;
+constexpr double MultiHypothesisPnp::kRansacSuccessProbability;
+
+bool MultiHypothesisPnp::absoluteMultiPoseRansacPinholeCam(
+    const Eigen::Matrix2Xd& measurements,
+    const std::vector<int>& measurement_camera_indices,
+    const Eigen::Matrix3Xd& G_landmark_positions, const double pixel_sigma,
+    const int max_ransac_iters, const aslam::NCamera::ConstPtr& ncamera,
+    pose::Transformation* T_G_I, std::vector<int>* inliers,
+    std::vector<double>* inlier_distances_to_model, int* num_iters) const {
+  CHECK(ncamera != nullptr);
+  CHECK_GT(pixel_sigma, 0.0);
+  CHECK_EQ(
+      static_cast<size_t>(measurements.cols()),
+      measurement_camera_indices.size());
+
+  const size_t num_cameras = ncamera->getNumCameras();
+  double focal_length = 0.0;
+  aslam::TransformationVector T_C_B(num_cameras);
+  for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
+    aslam::PinholeCamera::ConstPtr pinhole_camera_ptr =
+        std::dynamic_pointer_cast<const aslam::PinholeCamera>(
+            ncamera->getCameraShared(camera_idx));
+    CHECK(pinhole_camera_ptr)
+        << "Couldn't cast camera pointer to pinhole camera type.";
+    focal_length += pinhole_camera_ptr->fu() + pinhole_camera_ptr->fv();
+    T_C_B[camera_idx] = ncamera->get_T_C_B(camera_idx);
+  }
+  focal_length /= 2.0 * num_cameras;
+  const double ransac_threshold = 1.0 - cos(atan(pixel_sigma / focal_length));
+
+  Eigen::Matrix3Xd C_bearing_vectors(3, measurements.cols());
+  for (int i = 0; i < measurements.cols(); ++i) {
+    Eigen::Vector3d C_bearing_vector;
+    ncamera->getCamera(measurement_camera_indices[i])
+        .backProject3(measurements.col(i), &C_bearing_vector);
+    C_bearing_vectors.col(i) = C_bearing_vector;
+  }
+
+  return absoluteMultiPoseRansac(
+      C_bearing_vectors, measurement_camera_indices, G_landmark_positions,
+      T_C_B, ransac_threshold, max_ransac_iters, T_G_I, inliers,
+      inlier_distances_to_model, num_iters);
+}
+
+bool MultiHypothesisPnp::absoluteMultiPoseRansac(
+    const Eigen::Matrix3Xd& C_bearing_vectors,
+    const std::vector<int>& measurement_camera_indices,
+    const Eigen::Matrix3Xd& G_landmark_positions,
+    const aslam::TransformationVector& T_C_B, const double ransac_threshold,
+    const int max_ransac_iters, pose::Transformation* T_G_I,
+    std::vector<int>* inliers, std::vector<double>* inlier_distances_to_model,
+    int* num_iters) const {
+  CHECK_NOTNULL(T_G_I)->setIdentity();
+  CHECK_NOTNULL(inliers)->clear();
+  CHECK_NOTNULL(inlier_distances_to_model)->clear();
+  CHECK_NOTNULL(num_iters);
+  *num_iters = 0;
+  const int num_correspondences = C_bearing_vectors.cols();
+  CHECK_EQ(G_landmark_positions.cols(), num_correspondences);
+  CHECK_EQ(
+      measurement_camera_indices.size(),
+      static_cast<size_t>(num_correspondences));
+  CHECK_GT(ransac_threshold, 0.0);
+  constexpr int kMinimalSampleSize = 3;
+  if (num_correspondences < kMinimalSampleSize) {
+    return false;
+  }
+
+  const InlierScorer scorer(
+      C_bearing_vectors, measurement_camera_indices, G_landmark_positions,
+      T_C_B);
+
+  // The minimal solver is the GP3P solver of OpenGV, which also handles
+  // samples observed by different cameras of the rig.
+  opengv::bearingVectors_t bearing_vectors;
+  opengv::points_t points;
+  bearing_vectors.reserve(num_correspondences);
+  points.reserve(num_correspondences);
+  for (int i = 0; i < num_correspondences; ++i) {
+    bearing_vectors.emplace_back(C_bearing_vectors.col(i).normalized());
+    points.emplace_back(G_landmark_positions.col(i));
+  }
+  opengv::translations_t camera_offsets;
+  opengv::rotations_t camera_rotations;
+  for (const aslam::Transformation& T_C_B_camera : T_C_B) {
+    // OpenGV requires the T_B_C transformation.
+    const aslam::Transformation T_B_C = T_C_B_camera.inverse();
+    camera_offsets.emplace_back(T_B_C.getPosition());
+    camera_rotations.emplace_back(T_B_C.getRotationMatrix());
+  }
+  opengv::absolute_pose::NoncentralAbsoluteAdapter adapter(
+      bearing_vectors, measurement_camera_indices, points, camera_offsets,
+      camera_rotations);
+
+  std::mt19937 random_engine(
+      random_seed_ ? std::random_device()() : std::mt19937::default_seed);
+  std::uniform_int_distribution<int> index_distribution(
+      0, num_correspondences - 1);
+
+  int best_num_inliers = 0;
+  opengv::transformation_t best_model;
+  int num_required_iters = max_ransac_iters;
+  std::vector<int> sample(kMinimalSampleSize);
+  opengv::transformations_t hypotheses;
+  hypotheses.reserve(4 * kNumHypothesesPerBatch);
+  while (*num_iters < num_required_iters) {
+    // Solve a batch of minimal samples first, then score all hypotheses.
+    hypotheses.clear();
+    const int num_samples =
+        std::min(kNumHypothesesPerBatch, num_required_iters - *num_iters);
+    for (int sample_idx = 0; sample_idx < num_samples; ++sample_idx) {
+      for (int i = 0; i < kMinimalSampleSize; ++i) {
+        do {
+          sample[i] = index_distribution(random_engine);
+        } while (std::find(sample.begin(), sample.begin() + i, sample[i]) !=
+                 sample.begin() + i);
+      }
+      for (const opengv::transformation_t& hypothesis :
+           opengv::absolute_pose::gp3p(adapter, sample)) {
+        if (isFiniteTransformation(hypothesis)) {
+          hypotheses.push_back(hypothesis);
+        }
+      }
+    }
+    *num_iters += num_samples;
+
+    for (const opengv::transformation_t& hypothesis : hypotheses) {
+      const int num_inliers = scorer.countInliers(
+          hypothesis.leftCols<3>(), hypothesis.col(3), ransac_threshold,
+          nullptr);
+      if (num_inliers > best_num_inliers) {
+        best_num_inliers = num_inliers;
+        best_model = hypothesis;
+      }
+    }
+
+    if (best_num_inliers > 0) {
+      // Adapt the number of iterations to the best inlier ratio so far.
+      const double inlier_ratio = static_cast<double>(best_num_inliers) /
+                                  static_cast<double>(num_correspondences);
+      const double p_no_outliers = std::min(
+          1.0 - std::numeric_limits<double>::epsilon(),
+          std::pow(inlier_ratio, kMinimalSampleSize));
+      const double num_iters_for_success =
+          std::log(1.0 - kRansacSuccessProbability) /
+          std::log(1.0 - p_no_outliers);
+      num_required_iters = static_cast<int>(std::min(
+          static_cast<double>(max_ransac_iters),
+          std::ceil(num_iters_for_success)));
+    }
+  }
+
+  if (best_num_inliers < kMinimalSampleSize) {
+    return false;
+  }
+
+  Eigen::VectorXd distances_to_model;
+  scorer.countInliers(
+      best_model.leftCols<3>(), best_model.col(3), ransac_threshold,
+      &distances_to_model);
+  std::vector<int> best_inliers;
+  for (int i = 0; i < num_correspondences; ++i) {
+    if (distances_to_model(i) < ransac_threshold) {
+      best_inliers.push_back(i);
+    }
+  }
+
+  if (run_nonlinear_refinement_) {
+    adapter.sett(best_model.col(3));
+    adapter.setR(best_model.leftCols<3>());
+    const opengv::transformation_t refined_model =
+        opengv::absolute_pose::optimize_nonlinear(adapter, best_inliers);
+    if (isFiniteTransformation(refined_model)) {
+      best_model = refined_model;
+      scorer.countInliers(
+          best_model.leftCols<3>(), best_model.col(3), ransac_threshold,
+          &distances_to_model);
+      best_inliers.clear();
+      for (int i = 0; i < num_correspondences; ++i) {
+        if (distances_to_model(i) < ransac_threshold) {
+          best_inliers.push_back(i);
+        }
+      }
+    }
+  }
+
+  *inliers = best_inliers;
+  inlier_distances_to_model->reserve(inliers->size());
+  for (const int inlier_idx : *inliers) {
+    inlier_distances_to_model->push_back(distances_to_model(inlier_idx));
+  }
+  *T_G_I = pose::Transformation(
+      pose::Quaternion(
+          static_cast<Eigen::Matrix3d>(best_model.leftCols<3>())),
+      static_cast<Eigen::Vector3d>(best_model.col(3)));
+  return true;
+}
+
+}  // namespace geometric_vision
@@ -48,17 +48,23 @@ bool RotationOnlyDetector::isRotationOnlyMotion(
       num_matches = matches_kp1_k[camera_index].size();
     }
 
-    // Iterate through the matches of the camera pair.
-    double deviation_from_parallel_bearing_vector_current_camera = 0.0;
+    // Equations (27) and (28) of referenced paper, evaluated over all matches
+    // of the camera pair at once.
     CHECK_GT(num_matches, 0u);
-    for (size_t match_index = 0; match_index < num_matches; ++match_index) {
-      // Equations (27) and (28) of referenced paper.
-      deviation_from_parallel_bearing_vector_current_camera +=
-          (bearing_vectors_kp1[match_index].normalized() -
-           (q_Ckp1_Ck.getRotationMatrix() * bearing_vectors_k[match_index])
-               .normalized())
-              .norm();
-    }
+    CHECK_EQ(bearing_vectors_kp1.size(), num_matches);
+    CHECK_EQ(bearing_vectors_k.size(), num_matches);
+    const Eigen::Map<const Eigen::Matrix3Xd> C_bearing_vectors_kp1(
+        bearing_vectors_kp1.front().data(), 3, num_matches);
+    const Eigen::Map<const Eigen::Matrix3Xd> C_bearing_vectors_k(
+        bearing_vectors_k.front().data(), 3, num_matches);
+    const Eigen::Matrix3Xd rotated_bearing_vectors_k =
+        q_Ckp1_Ck.getRotationMatrix() * C_bearing_vectors_k;
+    const double deviation_from_parallel_bearing_vector_current_camera =
+        (C_bearing_vectors_kp1.colwise().normalized() -
+         rotated_bearing_vectors_k.colwise().normalized())
+            .colwise()
+            .norm()
+            .sum();
     // Ensure that the threshold is independent of the number of matches.
     deviation_from_parallel_bearing_vector_ +=
         deviation_from_parallel_bearing_vector_current_camera /
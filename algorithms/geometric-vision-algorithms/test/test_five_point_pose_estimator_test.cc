@@ -9,6 +9,7 @@
 #include <aslam/cameras/camera.h>
 #include <aslam/cameras/distortion-fisheye.h>
 
+#include <geometric-vision/batched-five-point-pose-estimator.h>
 #include <geometric-vision/five-point-pose-estimator.h>
 #include <maplab-common/pose_types.h>
 #include <maplab-common/quaternion-math.h>
@@ -21,8 +22,12 @@ INSTANTIATE_TEST_CASE_P(
     OpengvPoseEstimationFivePoint, VariableCameraAngle,
     ::testing::Values(0, M_PI / 24.0, M_PI / 8.0, -M_PI / 8.0, -M_PI / 24.0));
 
-TEST_P(VariableCameraAngle, PinholeCameraFivePointPoseInterface) {
-  opengv_pose_estimation::FivePointPoseEstimator pose_estimator;
+// Estimates the relative pose of two views of random landmarks, including
+// outliers, with the given estimator.
+template <typename PoseEstimator>
+void testPinholeCameraFivePointPose(
+    const double camera_angle, PoseEstimator* pose_estimator) {
+  CHECK_NOTNULL(pose_estimator);
 
   typedef aslam::FisheyeDistortion DistortionType;
   typedef aslam::PinholeCamera CameraType;
@@ -48,10 +53,10 @@ TEST_P(VariableCameraAngle, PinholeCameraFivePointPoseInterface) {
   constexpr double kVariationAngle = M_PI / 36;  // 5 deg.
   Eigen::Quaterniond G_q_C_a(
       Eigen::AngleAxisd(
-          GetParam() - kVariationAngle, Eigen::Vector3d::UnitY()));
+          camera_angle - kVariationAngle, Eigen::Vector3d::UnitY()));
   Eigen::Quaterniond G_q_C_b(
       Eigen::AngleAxisd(
-          GetParam() + kVariationAngle, Eigen::Vector3d::UnitY()));
+          camera_angle + kVariationAngle, Eigen::Vector3d::UnitY()));
   Eigen::Matrix3d G_R_C_a = G_q_C_a.toRotationMatrix();
   Eigen::Matrix3d G_R_C_b = G_q_C_b.toRotationMatrix();
   Eigen::Vector3d G_p_C_a(1, 2.5, 3);
@@ -103,7 +108,7 @@ TEST_P(VariableCameraAngle, PinholeCameraFivePointPoseInterface) {
   constexpr double kPixelSigma = 0.8;
   constexpr double kFocalLength = 100;
   const double kRansacThreshold = 1.0 - cos(atan(kPixelSigma / kFocalLength));
-  pose_estimator.Compute(
+  pose_estimator->Compute(
       measurements_a, measurements_b, kRansacThreshold, 500, camera,
       &estimated_transform, &inlier_matches);
 
@@ -114,4 +119,16 @@ TEST_P(VariableCameraAngle, PinholeCameraFivePointPoseInterface) {
       expected_rotation.coeffs(), 1e-2);
 }
 
+TEST_P(VariableCameraAngle, PinholeCameraFivePointPoseInterface) {
+  opengv_pose_estimation::FivePointPoseEstimator pose_estimator;
+  testPinholeCameraFivePointPose(GetParam(), &pose_estimator);
+}
+
+TEST_P(VariableCameraAngle, PinholeCameraBatchedFivePointPoseInterface) {
+  constexpr bool kRandomSeed = false;
+  opengv_pose_estimation::BatchedFivePointPoseEstimator pose_estimator(
+      kRandomSeed);
+  testPinholeCameraFivePointPose(GetParam(), &pose_estimator);
+}
+
 MAPLAB_UNITTEST_ENTRYPOINT
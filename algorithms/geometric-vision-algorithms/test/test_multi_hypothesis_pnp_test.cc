@@ -0,0 +1,95 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/pose-types.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <geometric-vision/multi-hypothesis-pnp.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+
+namespace geometric_vision {
+
+TEST(MultiHypothesisPnpTest, RecoversRigPoseWithOutliers) {
+  // Two cameras looking to the front and to the left of the rig.
+  aslam::TransformationVector T_C_B(2);
+  T_C_B[0] = aslam::Transformation(
+      aslam::Quaternion(Eigen::Quaterniond::Identity()),
+      Eigen::Vector3d(0.1, 0.0, 0.0));
+  T_C_B[1] = aslam::Transformation(
+      aslam::Quaternion(
+          Eigen::Quaterniond(
+              Eigen::AngleAxisd(M_PI / 2.0, Eigen::Vector3d::UnitY()))),
+      Eigen::Vector3d(-0.1, 0.0, 0.05));
+
+  const aslam::Transformation T_G_B(
+      aslam::Quaternion(
+          Eigen::Quaterniond(
+              Eigen::AngleAxisd(0.3, Eigen::Vector3d(0.1, 1.0, 0.2)
+                                         .normalized()))),
+      Eigen::Vector3d(1.0, -2.0, 0.5));
+
+  constexpr int kNumCorrespondences = 120;
+  constexpr int kEveryNthIsOutlier = 4;
+  std::mt19937 random_engine(42);
+  std::uniform_real_distribution<double> lateral_distribution(-2.0, 2.0);
+  std::uniform_real_distribution<double> depth_distribution(2.0, 10.0);
+
+  Eigen::Matrix3Xd C_bearing_vectors(3, kNumCorrespondences);
+  Eigen::Matrix3Xd G_landmark_positions(3, kNumCorrespondences);
+  std::vector<int> camera_indices(kNumCorrespondences);
+  std::vector<bool> is_outlier(kNumCorrespondences);
+  for (int i = 0; i < kNumCorrespondences; ++i) {
+    camera_indices[i] = i % 2;
+    const Eigen::Vector3d C_landmark(
+        lateral_distribution(random_engine),
+        lateral_distribution(random_engine), depth_distribution(random_engine));
+    G_landmark_positions.col(i) =
+        T_G_B * T_C_B[camera_indices[i]].inverse() * C_landmark;
+    C_bearing_vectors.col(i) = C_landmark.normalized();
+    is_outlier[i] = (i % kEveryNthIsOutlier) == 0;
+    if (is_outlier[i]) {
+      C_bearing_vectors.col(i) =
+          Eigen::Vector3d(
+              lateral_distribution(random_engine),
+              lateral_distribution(random_engine), 4.0)
+              .normalized();
+    }
+  }
+
+  const double ransac_threshold = 1.0 - std::cos(std::atan(1.0 / 300.0));
+  constexpr int kMaxRansacIters = 200;
+  constexpr bool kRunNonlinearRefinement = false;
+  constexpr bool kRandomSeed = false;
+  MultiHypothesisPnp pnp(kRunNonlinearRefinement, kRandomSeed);
+  aslam::Transformation T_G_B_estimate;
+  std::vector<int> inliers;
+  std::vector<double> inlier_distances_to_model;
+  int num_iters = 0;
+  ASSERT_TRUE(
+      pnp.absoluteMultiPoseRansac(
+          C_bearing_vectors, camera_indices, G_landmark_positions, T_C_B,
+          ransac_threshold, kMaxRansacIters, &T_G_B_estimate, &inliers,
+          &inlier_distances_to_model, &num_iters));
+
+  EXPECT_NEAR_ASLAM_TRANSFORMATION(T_G_B_estimate, T_G_B, 1e-6);
+  EXPECT_GT(num_iters, 0);
+  EXPECT_LE(num_iters, kMaxRansacIters);
+  ASSERT_EQ(inliers.size(), inlier_distances_to_model.size());
+  int num_true_inliers = 0;
+  for (int i = 0; i < kNumCorrespondences; ++i) {
+    num_true_inliers += is_outlier[i] ? 0 : 1;
+  }
+  EXPECT_EQ(static_cast<int>(inliers.size()), num_true_inliers);
+  for (size_t i = 0u; i < inliers.size(); ++i) {
+    EXPECT_FALSE(is_outlier[inliers[i]]);
+    EXPECT_LT(inlier_distances_to_model[i], ransac_threshold);
+  }
+}
+
+}  // namespace geometric_vision
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -204,4 +204,53 @@ TEST_P(GeometricVisionNViewParamTest, NoisyNViewTriangulationTest) {
   EXPECT_NEAR_EIGEN(G_p_fi, triangulated_point, 1e-3);
 }
 
+TEST(GeometricVisionBatchTest, BatchTriangulationFromBearingsTest) {
+  const Aligned<std::vector, Eigen::Vector3d> G_p_fi = {
+      Eigen::Vector3d(1.5, 0.0, 4.0), Eigen::Vector3d(0.9, -0.05, 1.43),
+      Eigen::Vector3d(-0.2, -0.25, 1.2), Eigen::Vector3d(3.1, -1.05, 6.1),
+      Eigen::Vector3d(0.1, 0.2, 2.0), Eigen::Vector3d(-1.0, 0.5, 3.0)};
+  const Aligned<std::vector, Eigen::Vector3d> G_p_C = {
+      Eigen::Vector3d(0, 0, 0), Eigen::Vector3d(-3, 0, 0),
+      Eigen::Vector3d(0.85, 0.1, -0.3), Eigen::Vector3d(-0.1, -0.05, 0.4),
+      Eigen::Vector3d(0.7, 0.3, 0.21)};
+  // Points 0 to 3 are seen by a varying number of cameras, point 4 by a
+  // single camera and point 5 twice by the same camera without parallax.
+  const std::vector<size_t> num_observations = {5u, 2u, 3u, 4u, 1u, 2u};
+  const std::vector<bool> expected_success = {true, true, true,
+                                              true, false, false};
+
+  std::vector<size_t> observation_offsets = {0u};
+  Eigen::Matrix3Xd G_bearing_vectors(3, 17);
+  Eigen::Matrix3Xd G_p_C_packed(3, 17);
+  size_t column = 0u;
+  for (size_t point_idx = 0u; point_idx < G_p_fi.size(); ++point_idx) {
+    for (size_t i = 0u; i < num_observations[point_idx]; ++i) {
+      const size_t camera_idx = (point_idx == 5u) ? 0u : i;
+      G_p_C_packed.col(column) = G_p_C[camera_idx];
+      // The bearing vectors do not need to be normalized.
+      G_bearing_vectors.col(column) =
+          (1.0 + i) * (G_p_fi[point_idx] - G_p_C[camera_idx]);
+      ++column;
+    }
+    observation_offsets.push_back(column);
+  }
+  ASSERT_EQ(column, 17u);
+
+  LinearTriangulation triangulator;
+  Eigen::Matrix3Xd G_triangulated_points;
+  std::vector<bool> success;
+  triangulator.triangulateBatchFromBearings(
+      G_bearing_vectors, G_p_C_packed, observation_offsets,
+      &G_triangulated_points, &success);
+  ASSERT_EQ(success.size(), G_p_fi.size());
+  ASSERT_EQ(G_triangulated_points.cols(), static_cast<int>(G_p_fi.size()));
+  for (size_t point_idx = 0u; point_idx < G_p_fi.size(); ++point_idx) {
+    EXPECT_EQ(success[point_idx], expected_success[point_idx]);
+    if (expected_success[point_idx]) {
+      EXPECT_NEAR_EIGEN(
+          G_p_fi[point_idx], G_triangulated_points.col(point_idx), 1e-10);
+    }
+  }
+}
+
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -77,7 +77,7 @@ void ImuIntegratorRK4::integrate(
     next_phi->setZero();
     next_cov->setZero();
 
-    const ScalarType* state_q_ptr = next_state->head(4).data();
+    const ScalarType* state_q_ptr = next_state->template head<4>().data();
     Eigen::Quaternion<ScalarType> B_q_G(state_q_ptr);
     B_q_G.normalize();
 
@@ -174,7 +174,7 @@ void ImuIntegratorRK4::getStateDerivativeRungeKutta(
     Eigen::Matrix<ScalarType, kStateSize, 1>* state_derivative) const {
   CHECK_NOTNULL(state_derivative);
 
-  Eigen::Quaternion<ScalarType> B_q_G(current_state.head(4).data());
+  Eigen::Quaternion<ScalarType> B_q_G(current_state.template head<4>().data());
   // As B_q_G is calculated using linearization, it may not be normalized
   // -> we need to do it explicitly before passing to quaternion object.
   ScalarType o5 = static_cast<ScalarType>(0.5);
@@ -223,7 +223,7 @@ void ImuIntegratorRK4::getCovarianceTransitionDerivativesRungeKutta(
   Eigen::Matrix<ScalarType, kErrorStateSize, kErrorStateSize> phi_cont =
       Eigen::Matrix<ScalarType, kErrorStateSize, kErrorStateSize>::Zero();
 
-  Eigen::Quaternion<ScalarType> B_q_G(current_state.head(4).data());
+  Eigen::Quaternion<ScalarType> B_q_G(current_state.template head<4>().data());
   // As B_q_G is calculated using linearization, it may not be normalized
   // -> we need to do it explicitly before passing to quaternion object.
   B_q_G.normalize();
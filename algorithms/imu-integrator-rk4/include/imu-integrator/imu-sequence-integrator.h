@@ -0,0 +1,83 @@
+#ifndef IMU_INTEGRATOR_IMU_SEQUENCE_INTEGRATOR_H_
+#define IMU_INTEGRATOR_IMU_SEQUENCE_INTEGRATOR_H_
+
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/memory.h>
+
+#include "imu-integrator/common.h"
+#include "imu-integrator/imu-integrator.h"
+
+namespace imu_integrator {
+
+typedef Eigen::Matrix<double, kStateSize, 1> ImuStateVector;
+typedef Aligned<std::vector, ImuStateVector> ImuStateVectorList;
+typedef Eigen::Matrix<double, kErrorStateSize, kErrorStateSize>
+    ImuErrorStateMatrix;
+
+// The IMU measurements of one edge together with the state at its first
+// measurement. The measurements are not owned.
+struct ImuSequence {
+  ImuSequence(
+      const ImuStateVector& _begin_state,
+      const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& _imu_timestamps,
+      const Eigen::Matrix<double, 6, Eigen::Dynamic>& _imu_data)
+      : begin_state(_begin_state),
+        imu_timestamps(&_imu_timestamps),
+        imu_data(&_imu_data) {}
+
+  ImuStateVector begin_state;
+  const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>* imu_timestamps;
+  const Eigen::Matrix<double, 6, Eigen::Dynamic>* imu_data;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+typedef Aligned<std::vector, ImuSequence> ImuSequenceList;
+
+// Integrates all measurements of the sequence with the biases of the begin
+// state and accumulates the transition matrix and the covariance. The phi
+// and Q accumulators are optional; both have to be either valid or null.
+void integrateImuSequence(
+    const ImuIntegratorRK4& integrator, const ImuSequence& sequence,
+    ImuStateVector* end_state, ImuErrorStateMatrix* phi_accum,
+    ImuErrorStateMatrix* Q_accum);
+
+// Integrates the states of many sequences at once, e.g. for all IMU edges of
+// a mission. The sequences are processed in groups of kNumLanes, whose
+// states are stored column-wise in fixed-size matrices, so that every RK4
+// step updates all lanes of a group with the same vectorized operations.
+// Sequences of different lengths are padded with zero-length steps. The
+// groups are distributed over num_threads threads.
+//
+// The results are the same as integrating every sequence with
+// ImuIntegratorRK4::integrateStateOnly up to floating point round-off.
+class BatchImuIntegratorRK4 {
+ public:
+  static constexpr int kNumLanes = 4;
+
+  explicit BatchImuIntegratorRK4(double gravity_acceleration);
+
+  void integrateStatesOnly(
+      const ImuSequenceList& sequences, size_t num_threads,
+      ImuStateVectorList* end_states) const;
+
+ private:
+  typedef Eigen::Matrix<double, kStateSize, kNumLanes> LaneStates;
+  typedef Eigen::Matrix<double, kImuReadingSize, kNumLanes> LaneReadings;
+  typedef Eigen::Array<double, 1, kNumLanes> LaneArray;
+
+  void integrateLaneGroup(
+      const ImuSequenceList& sequences, size_t first_sequence_idx,
+      ImuStateVectorList* end_states) const;
+
+  void getStateDerivatives(
+      const LaneReadings& debiased_imu_readings, const LaneStates& states,
+      LaneStates* state_derivatives) const;
+
+  const double gravity_acceleration_;
+};
+
+}  // namespace imu_integrator
+
+#endif  // IMU_INTEGRATOR_IMU_SEQUENCE_INTEGRATOR_H_
@@ -0,0 +1,255 @@
+#include "imu-integrator/imu-sequence-integrator.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+#include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+
+namespace imu_integrator {
+
+void integrateImuSequence(
+    const ImuIntegratorRK4& integrator, const ImuSequence& sequence,
+    ImuStateVector* end_state, ImuErrorStateMatrix* phi_accum,
+    ImuErrorStateMatrix* Q_accum) {
+  CHECK_NOTNULL(end_state);
+  CHECK_EQ(phi_accum == nullptr, Q_accum == nullptr)
+      << "phi_accum and Q_accum have to be either both valid or be null.";
+  const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps =
+      *CHECK_NOTNULL(sequence.imu_timestamps);
+  const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_data =
+      *CHECK_NOTNULL(sequence.imu_data);
+  CHECK_EQ(imu_data.cols(), imu_timestamps.cols());
+  const bool accumulate_phi_cov = phi_accum != nullptr;
+
+  Eigen::Matrix<double, 2 * kImuReadingSize, 1> debiased_imu_readings;
+  ImuErrorStateMatrix phi;
+  ImuErrorStateMatrix Q;
+  ImuErrorStateMatrix new_accum;
+  if (accumulate_phi_cov) {
+    Q_accum->setZero();
+    phi_accum->setIdentity();
+  }
+
+  ImuStateVector current_state = sequence.begin_state;
+  ImuStateVector next_state;
+  for (int i = 0; i < imu_data.cols() - 1; ++i) {
+    CHECK_GE(imu_timestamps(0, i + 1), imu_timestamps(0, i))
+        << "IMU measurements not properly ordered";
+
+    const Eigen::Matrix<double, kAccelBiasBlockSize, 1> accel_bias =
+        current_state.segment<kAccelBiasBlockSize>(kStateAccelBiasOffset);
+    const Eigen::Matrix<double, kGyroBiasBlockSize, 1> gyro_bias =
+        current_state.segment<kGyroBiasBlockSize>(kStateGyroBiasOffset);
+    debiased_imu_readings
+        << imu_data.col(i).segment<3>(kAccelReadingOffset) - accel_bias,
+        imu_data.col(i).segment<3>(kGyroReadingOffset) - gyro_bias,
+        imu_data.col(i + 1).segment<3>(kAccelReadingOffset) - accel_bias,
+        imu_data.col(i + 1).segment<3>(kGyroReadingOffset) - gyro_bias;
+
+    const double delta_time_seconds =
+        (imu_timestamps(0, i + 1) - imu_timestamps(0, i)) *
+        kNanoSecondsToSeconds;
+    if (accumulate_phi_cov) {
+      integrator.integrate(
+          current_state, debiased_imu_readings, delta_time_seconds,
+          &next_state, &phi, &Q);
+      new_accum.noalias() = phi * (*Q_accum) * phi.transpose();
+      *Q_accum = new_accum + Q;
+      new_accum.noalias() = phi * (*phi_accum);
+      phi_accum->swap(new_accum);
+    } else {
+      integrator.integrateStateOnly(
+          current_state, debiased_imu_readings, delta_time_seconds,
+          &next_state);
+    }
+    current_state = next_state;
+  }
+  *end_state = current_state;
+}
+
+BatchImuIntegratorRK4::BatchImuIntegratorRK4(double gravity_acceleration)
+    : gravity_acceleration_(gravity_acceleration) {}
+
+void BatchImuIntegratorRK4::integrateStatesOnly(
+    const ImuSequenceList& sequences, const size_t num_threads,
+    ImuStateVectorList* end_states) const {
+  CHECK_NOTNULL(end_states)->resize(sequences.size());
+  CHECK_GT(num_threads, 0u);
+
+  const size_t num_lane_groups = (sequences.size() + kNumLanes - 1) / kNumLanes;
+  std::function<void(size_t, size_t)> integrate_lane_groups =
+      [&](size_t begin, size_t end) {
+        for (size_t group_idx = begin; group_idx < end; ++group_idx) {
+          integrateLaneGroup(sequences, group_idx * kNumLanes, end_states);
+        }
+      };
+  common::ParallelProcessDynamic(
+      num_lane_groups, integrate_lane_groups, num_threads);
+}
+
+void BatchImuIntegratorRK4::integrateLaneGroup(
+    const ImuSequenceList& sequences, const size_t first_sequence_idx,
+    ImuStateVectorList* end_states) const {
+  CHECK_NOTNULL(end_states);
+  CHECK_LT(first_sequence_idx, sequences.size());
+  const int num_used_lanes = static_cast<int>(std::min<size_t>(
+      kNumLanes, sequences.size() - first_sequence_idx));
+
+  // Unused lanes keep a valid identity orientation and are never advanced.
+  LaneStates states = LaneStates::Zero();
+  states.row(kStateOrientationOffset + 3).setOnes();
+  int num_steps = 0;
+  for (int lane = 0; lane < num_used_lanes; ++lane) {
+    const ImuSequence& sequence = sequences[first_sequence_idx + lane];
+    CHECK_NOTNULL(sequence.imu_timestamps);
+    CHECK_NOTNULL(sequence.imu_data);
+    CHECK_EQ(sequence.imu_data->cols(), sequence.imu_timestamps->cols());
+    states.col(lane) = sequence.begin_state;
+    num_steps = std::max(
+        num_steps, static_cast<int>(sequence.imu_data->cols()) - 1);
+  }
+
+  LaneReadings readings_k1;
+  LaneReadings readings_k23;
+  LaneReadings readings_k4;
+  LaneArray delta_time_seconds;
+  LaneStates state_der1;
+  LaneStates state_der2;
+  LaneStates state_der3;
+  LaneStates state_der4;
+  LaneStates intermediate_states;
+  Eigen::Matrix<double, kImuReadingSize, 1> biases;
+
+  for (int step = 0; step < num_steps; ++step) {
+    for (int lane = 0; lane < kNumLanes; ++lane) {
+      if (lane >= num_used_lanes ||
+          step + 1 >= sequences[first_sequence_idx + lane].imu_data->cols()) {
+        // Zero-length step, the state of the lane stays unchanged.
+        delta_time_seconds(lane) = 0.0;
+        readings_k1.col(lane).setZero();
+        readings_k23.col(lane).setZero();
+        readings_k4.col(lane).setZero();
+        continue;
+      }
+      const ImuSequence& sequence = sequences[first_sequence_idx + lane];
+      const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps =
+          *sequence.imu_timestamps;
+      CHECK_GE(imu_timestamps(0, step + 1), imu_timestamps(0, step))
+          << "IMU measurements not properly ordered";
+      delta_time_seconds(lane) =
+          (imu_timestamps(0, step + 1) - imu_timestamps(0, step)) *
+          kNanoSecondsToSeconds;
+
+      biases << states.col(lane).segment<kAccelBiasBlockSize>(
+                    kStateAccelBiasOffset),
+          states.col(lane).segment<kGyroBiasBlockSize>(kStateGyroBiasOffset);
+      readings_k1.col(lane) = sequence.imu_data->col(step) - biases;
+      readings_k4.col(lane) = sequence.imu_data->col(step + 1) - biases;
+      if (delta_time_seconds(lane) < std::numeric_limits<double>::epsilon()) {
+        readings_k23.col(lane) = readings_k1.col(lane);
+      } else {
+        readings_k23.col(lane) =
+            readings_k1.col(lane) +
+            (readings_k4.col(lane) - readings_k1.col(lane)) * 0.5;
+      }
+    }
+
+    const LaneArray half_delta_time_seconds = 0.5 * delta_time_seconds;
+    getStateDerivatives(readings_k1, states, &state_der1);
+    intermediate_states =
+        states +
+        (state_der1.array().rowwise() * half_delta_time_seconds).matrix();
+    getStateDerivatives(readings_k23, intermediate_states, &state_der2);
+    intermediate_states =
+        states +
+        (state_der2.array().rowwise() * half_delta_time_seconds).matrix();
+    getStateDerivatives(readings_k23, intermediate_states, &state_der3);
+    intermediate_states =
+        states + (state_der3.array().rowwise() * delta_time_seconds).matrix();
+    getStateDerivatives(readings_k4, intermediate_states, &state_der4);
+
+    states += ((state_der1 + 2.0 * state_der2 + 2.0 * state_der3 + state_der4)
+                   .array()
+                   .rowwise() *
+               delta_time_seconds)
+                  .matrix() /
+              6.0;
+  }
+
+  for (int lane = 0; lane < num_used_lanes; ++lane) {
+    (*end_states)[first_sequence_idx + lane] = states.col(lane);
+  }
+}
+
+void BatchImuIntegratorRK4::getStateDerivatives(
+    const LaneReadings& debiased_imu_readings, const LaneStates& states,
+    LaneStates* state_derivatives) const {
+  CHECK_NOTNULL(state_derivatives);
+
+  // B_q_G in JPL convention [x, y, z, w] per lane. As the intermediate RK4
+  // states are linearized, the quaternions are normalized explicitly.
+  const LaneArray q_norm =
+      states.middleRows<kStateOrientationBlockSize>(kStateOrientationOffset)
+          .colwise()
+          .norm()
+          .array();
+  const LaneArray qx = states.row(kStateOrientationOffset).array() / q_norm;
+  const LaneArray qy = states.row(kStateOrientationOffset + 1).array() / q_norm;
+  const LaneArray qz = states.row(kStateOrientationOffset + 2).array() / q_norm;
+  const LaneArray qw = states.row(kStateOrientationOffset + 3).array() / q_norm;
+
+  const LaneArray ax = debiased_imu_readings.row(kAccelReadingOffset).array();
+  const LaneArray ay =
+      debiased_imu_readings.row(kAccelReadingOffset + 1).array();
+  const LaneArray az =
+      debiased_imu_readings.row(kAccelReadingOffset + 2).array();
+  const LaneArray wx = debiased_imu_readings.row(kGyroReadingOffset).array();
+  const LaneArray wy =
+      debiased_imu_readings.row(kGyroReadingOffset + 1).array();
+  const LaneArray wz =
+      debiased_imu_readings.row(kGyroReadingOffset + 2).array();
+
+  state_derivatives->setZero();  // Bias derivatives are zero.
+
+  // q_dot = 0.5 * Omega(gyro) * B_q_G.
+  state_derivatives->row(kStateOrientationOffset) =
+      (0.5 * (wz * qy - wy * qz + wx * qw)).matrix();
+  state_derivatives->row(kStateOrientationOffset + 1) =
+      (0.5 * (-wz * qx + wx * qz + wy * qw)).matrix();
+  state_derivatives->row(kStateOrientationOffset + 2) =
+      (0.5 * (wy * qx - wx * qy + wz * qw)).matrix();
+  state_derivatives->row(kStateOrientationOffset + 3) =
+      (0.5 * (-wx * qx - wy * qy - wz * qz)).matrix();
+
+  // v_dot = G_R_B * acc - g, with G_R_B the transpose of the JPL rotation
+  // matrix of B_q_G.
+  const LaneArray xx = qx * qx;
+  const LaneArray yy = qy * qy;
+  const LaneArray zz = qz * qz;
+  const LaneArray xy = qx * qy;
+  const LaneArray xz = qx * qz;
+  const LaneArray yz = qy * qz;
+  const LaneArray xw = qx * qw;
+  const LaneArray yw = qy * qw;
+  const LaneArray zw = qz * qw;
+  state_derivatives->row(kStateVelocityOffset) =
+      ((1.0 - 2.0 * (yy + zz)) * ax + 2.0 * (xy - zw) * ay +
+       2.0 * (xz + yw) * az)
+          .matrix();
+  state_derivatives->row(kStateVelocityOffset + 1) =
+      (2.0 * (xy + zw) * ax + (1.0 - 2.0 * (xx + zz)) * ay +
+       2.0 * (yz - xw) * az)
+          .matrix();
+  state_derivatives->row(kStateVelocityOffset + 2) =
+      (2.0 * (xz - yw) * ax + 2.0 * (yz + xw) * ay +
+       (1.0 - 2.0 * (xx + yy)) * az - gravity_acceleration_)
+          .matrix();
+
+  // p_dot = v.
+  state_derivatives->middleRows<kPositionBlockSize>(kStatePositionOffset) =
+      states.middleRows<kVelocityBlockSize>(kStateVelocityOffset);
+}
+
+}  // namespace imu_integrator
@@ -0,0 +1,134 @@
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+#include <maplab-common/threading-helpers.h>
+
+#include "imu-integrator/imu-integrator.h"
+#include "imu-integrator/imu-sequence-integrator.h"
+
+using namespace imu_integrator;  // NOLINT
+
+namespace {
+constexpr double kGravityAcceleration = 9.81;
+constexpr int64_t kImuPeriodNanoseconds = 5000000;
+
+struct SequenceData {
+  Eigen::Matrix<int64_t, 1, Eigen::Dynamic> imu_timestamps;
+  Eigen::Matrix<double, 6, Eigen::Dynamic> imu_data;
+};
+
+// Random IMU edges of different lengths as between keyframes of a mission.
+void generateSequences(
+    const size_t num_sequences, std::vector<SequenceData>* sequence_data,
+    ImuSequenceList* sequences) {
+  CHECK_NOTNULL(sequence_data);
+  CHECK_NOTNULL(sequences);
+  std::mt19937 generator(42u);
+  std::uniform_int_distribution<int> num_measurements_distribution(2, 60);
+  std::uniform_int_distribution<int64_t> jitter_distribution(
+      -kImuPeriodNanoseconds / 10, kImuPeriodNanoseconds / 10);
+  std::normal_distribution<double> normal_distribution(0.0, 1.0);
+
+  sequence_data->resize(num_sequences);
+  for (SequenceData& data : *sequence_data) {
+    const int num_measurements = num_measurements_distribution(generator);
+    data.imu_timestamps.resize(Eigen::NoChange, num_measurements);
+    data.imu_data.resize(Eigen::NoChange, num_measurements);
+    int64_t timestamp_nanoseconds = 0;
+    for (int i = 0; i < num_measurements; ++i) {
+      data.imu_timestamps(0, i) = timestamp_nanoseconds;
+      timestamp_nanoseconds +=
+          kImuPeriodNanoseconds + jitter_distribution(generator);
+      for (int row = 0; row < 6; ++row) {
+        data.imu_data(row, i) = normal_distribution(generator);
+      }
+      data.imu_data(kAccelReadingOffset + 2, i) += kGravityAcceleration;
+    }
+  }
+
+  sequences->clear();
+  for (const SequenceData& data : *sequence_data) {
+    ImuStateVector begin_state;
+    for (int i = 0; i < kStateSize; ++i) {
+      begin_state(i) = normal_distribution(generator);
+    }
+    begin_state.segment<kStateOrientationBlockSize>(kStateOrientationOffset)
+        .normalize();
+    sequences->emplace_back(begin_state, data.imu_timestamps, data.imu_data);
+  }
+}
+}  // namespace
+
+TEST(ImuSequenceIntegrator, StateOnlyMatchesFullIntegration) {
+  std::vector<SequenceData> sequence_data;
+  ImuSequenceList sequences;
+  generateSequences(20u, &sequence_data, &sequences);
+
+  const ImuIntegratorRK4 integrator(0.1, 0.01, 0.1, 0.01, kGravityAcceleration);
+  for (const ImuSequence& sequence : sequences) {
+    ImuStateVector state_only;
+    integrateImuSequence(integrator, sequence, &state_only, nullptr, nullptr);
+    ImuStateVector end_state;
+    ImuErrorStateMatrix phi_accum;
+    ImuErrorStateMatrix Q_accum;
+    integrateImuSequence(
+        integrator, sequence, &end_state, &phi_accum, &Q_accum);
+    EXPECT_NEAR_EIGEN(state_only, end_state, 1e-15);
+    EXPECT_NEAR_EIGEN(Q_accum, Q_accum.transpose(), 1e-12);
+  }
+}
+
+TEST(ImuSequenceIntegrator, BatchedMatchesSequentialIntegration) {
+  std::vector<SequenceData> sequence_data;
+  ImuSequenceList sequences;
+  // Not a multiple of the number of lanes.
+  generateSequences(4001u, &sequence_data, &sequences);
+
+  typedef std::chrono::steady_clock Clock;
+  auto elapsed_ms = [](const Clock::time_point& start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+  };
+
+  const ImuIntegratorRK4 integrator(0.1, 0.01, 0.1, 0.01, kGravityAcceleration);
+  ImuStateVectorList sequential_end_states(sequences.size());
+  Clock::time_point start = Clock::now();
+  for (size_t i = 0u; i < sequences.size(); ++i) {
+    integrateImuSequence(
+        integrator, sequences[i], &sequential_end_states[i], nullptr, nullptr);
+  }
+  const double sequential_ms = elapsed_ms(start);
+
+  const BatchImuIntegratorRK4 batch_integrator(kGravityAcceleration);
+  ImuStateVectorList batched_end_states;
+  start = Clock::now();
+  batch_integrator.integrateStatesOnly(sequences, 1u, &batched_end_states);
+  const double batched_ms = elapsed_ms(start);
+
+  ImuStateVectorList parallel_end_states;
+  start = Clock::now();
+  batch_integrator.integrateStatesOnly(
+      sequences, common::getNumHardwareThreads(), &parallel_end_states);
+  const double parallel_ms = elapsed_ms(start);
+
+  ASSERT_EQ(batched_end_states.size(), sequences.size());
+  ASSERT_EQ(parallel_end_states.size(), sequences.size());
+  for (size_t i = 0u; i < sequences.size(); ++i) {
+    EXPECT_NEAR_EIGEN(sequential_end_states[i], batched_end_states[i], 1e-10);
+    EXPECT_NEAR_EIGEN(batched_end_states[i], parallel_end_states[i], 1e-15);
+  }
+
+  LOG(INFO) << "Integrating " << sequences.size() << " IMU sequences: "
+            << "sequential " << sequential_ms << " ms, batched "
+            << batched_ms << " ms, batched on "
+            << common::getNumHardwareThreads() << " threads " << parallel_ms
+            << " ms.";
+}
+
+MAPLAB_UNITTEST_ENTRYPOINT
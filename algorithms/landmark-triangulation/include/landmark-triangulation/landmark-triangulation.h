@@ -16,5 +16,24 @@ bool retriangulateLandmarksOfMission(
 void retriangulateLandmarksOfVertex(
     const pose_graph::VertexId& storing_vertex_id, vi_map::VIMap* map);
 
+typedef AlignedUnorderedMap<pose_graph::VertexId, aslam::Transformation>
+    VertexIdToTransformationMap;
+
+// Incremental retriangulation: instead of all landmarks of the map, only the
+// landmarks observed by or stored in vertices whose pose changed are
+// retriangulated, e.g. after a loop closure. Take a snapshot of the vertex
+// poses before the change with getAllVertexPoses_G_I and select the vertices
+// that moved with getVerticesWithPoseChange.
+void getAllVertexPoses_G_I(
+    const vi_map::VIMap& map, VertexIdToTransformationMap* T_G_I_map);
+// Vertices without a reference pose are considered changed.
+void getVerticesWithPoseChange(
+    const vi_map::VIMap& map, const VertexIdToTransformationMap& T_G_I_before,
+    const double min_position_change_meters,
+    const double min_rotation_change_radians,
+    pose_graph::VertexIdSet* changed_vertex_ids);
+bool retriangulateLandmarksOfChangedVertices(
+    const pose_graph::VertexIdSet& changed_vertex_ids, vi_map::VIMap* map);
+
 }  // namespace landmark_triangulation
 #endif  // LANDMARK_TRIANGULATION_LANDMARK_TRIANGULATION_H_
@@ -7,6 +7,8 @@
 #include <vector>
 
 #include <Eigen/Core>
+#include <imu-integrator/common.h>
+#include <imu-integrator/imu-integrator.h>
 #include <maplab-common/gravity-provider.h>
 #include <maplab-common/temporal-buffer.h>
 #include <vi-map/unique-id.h>
@@ -63,6 +65,12 @@ class PoseInterpolator {
       std::unordered_map<pose_graph::VertexId, int64_t>* vertex_to_time_map)
       const;
 
+  // Returns the vertices of the mission along the graph that have an outgoing
+  // IMU edge with measurements, together with the time range of that edge.
+  void buildVertexToTimeList(
+      const vi_map::VIMap& map, const vi_map::MissionId& mission_id,
+      std::vector<VertexInformation>* vertices_and_time) const;
+
  private:
   typedef std::pair<int64_t, StateLinearizationPoint> state_buffer_value_type;
   typedef common::TemporalBuffer<
@@ -83,10 +91,6 @@ class PoseInterpolator {
       Eigen::Matrix<int64_t, 1, Eigen::Dynamic>* imu_timestamps,
       Eigen::Matrix<double, 6, Eigen::Dynamic>* imu_data) const;
 
-  void buildVertexToTimeList(
-      const vi_map::VIMap& map, const vi_map::MissionId& mission_id,
-      std::vector<VertexInformation>* vertices_and_time) const;
-
   void computeRequestedPosesInRange(
       const vi_map::VIMap& map, const vi_map::VIMission& mission,
       const pose_graph::VertexId& vertex_begin_id,
@@ -105,5 +109,61 @@ class PoseInterpolator {
       Eigen::Matrix<int64_t, 1, Eigen::Dynamic>* imu_timestamps,
       Eigen::Matrix<double, 6, Eigen::Dynamic>* imu_data) const;
 };
+
+// Interpolates the poses of a single mission like PoseInterpolator, but keeps
+// the integrated IMU states of every edge once they have been computed. Dense
+// or repeated queries, e.g. exporting a high-rate trajectory or assigning a
+// pose to every depth frame, therefore integrate every edge at most once, and
+// a sorted batch of timestamps is answered in a single sweep over the edges.
+// A pose between two IMU measurements is integrated from the cached state at
+// the preceding measurement, so it does not depend on the other timestamps
+// requested. The map must outlive the interpolator and clearCache() has to be
+// called if the vertex states change. Not thread-safe.
+class MissionPoseInterpolator {
+ public:
+  MissionPoseInterpolator(
+      const vi_map::VIMap& map, const vi_map::MissionId& mission_id);
+
+  // Time range of the IMU measurements of the mission in which poses can be
+  // interpolated.
+  int64_t getStartTimeNanoseconds() const;
+  int64_t getEndTimeNanoseconds() const;
+
+  // The timestamps must be sorted in ascending order.
+  void getPosesAtSortedTimes(
+      const std::vector<int64_t>& sorted_timestamps_ns,
+      aslam::TransformationVector* poses_M_I);
+
+  // Timestamps do not need to be sorted, the poses are returned in the order
+  // of the timestamps.
+  void getPosesAtTime(
+      const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& timestamps_ns,
+      aslam::TransformationVector* poses_M_I);
+
+  aslam::Transformation getPoseAtTime(int64_t timestamp_ns);
+
+  void clearCache();
+
+  size_t numIntegratedEdges() const {
+    return num_integrated_edges_;
+  }
+
+ private:
+  // IMU states integrated over one edge, starting from the state of the vertex
+  // the edge leaves. The states have the layout of the ImuIntegratorRK4 state.
+  struct IntegratedEdge {
+    bool is_integrated = false;
+    Eigen::Matrix<double, imu_integrator::kStateSize, Eigen::Dynamic> states;
+  };
+
+  const IntegratedEdge& getIntegratedEdge(size_t edge_idx);
+
+  const vi_map::VIMap& map_;
+  const vi_map::MissionId mission_id_;
+  const imu_integrator::ImuIntegratorRK4 integrator_;
+  std::vector<VertexInformation> vertices_and_time_;
+  std::vector<IntegratedEdge> integrated_edges_;
+  size_t num_integrated_edges_;
+};
 }  // namespace landmark_triangulation
 #endif  // LANDMARK_TRIANGULATION_POSE_INTERPOLATOR_H_
@@ -1,13 +1,16 @@
 #include "landmark-triangulation/landmark-triangulation.h"
 
 #include <functional>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <aslam/common/statistics/statistics.h>
-#include <aslam/triangulation/triangulation.h>
-#include <maplab-common/multi-threaded-progress-bar.h>
+#include <geometric-vision/linear-triangulation.h>
 #include <maplab-common/parallel-process.h>
+#include <maplab-common/progress-bar.h>
+#include <maplab-common/threading-helpers.h>
 #include <vi-map/landmark-quality-metrics.h>
 #include <vi-map/vi-map.h>
 
@@ -18,14 +21,13 @@ typedef AlignedUnorderedMap<aslam::FrameId, aslam::Transformation>
     FrameToPoseMap;
 
 namespace {
-void interpolateVisualFramePosesAllMissions(
-    const vi_map::VIMap& map, FrameToPoseMap* interpolated_frame_poses) {
+void interpolateVisualFramePosesOfMissions(
+    const vi_map::VIMap& map, const vi_map::MissionIdList& mission_ids,
+    FrameToPoseMap* interpolated_frame_poses) {
   CHECK_NOTNULL(interpolated_frame_poses)->clear();
-  // Loop over all missions, vertices and frames and add the interpolated poses
-  // to the map.
+  // Loop over the missions, vertices and frames and add the interpolated
+  // poses to the map.
   size_t total_num_frames = 0u;
-  vi_map::MissionIdList mission_ids;
-  map.getAllMissionIds(&mission_ids);
   for (const vi_map::MissionId mission_id : mission_ids) {
     // Check if there is IMU data.
     std::unordered_map<pose_graph::VertexId, int64_t> vertex_to_time_map;
@@ -90,10 +92,9 @@ void interpolateVisualFramePosesAllMissions(
     if (frame_counter > 0u) {
       VLOG(1) << "Interpolating the exact visual frame poses for "
               << frame_counter << " frames of mission " << mission_id;
-      PoseInterpolator pose_interpolator;
+      MissionPoseInterpolator pose_interpolator(map, mission_id);
       aslam::TransformationVector poses_M_I;
-      pose_interpolator.getPosesAtTime(
-          map, mission_id, pose_timestamps, &poses_M_I);
+      pose_interpolator.getPosesAtTime(pose_timestamps, &poses_M_I);
       CHECK_EQ(poses_M_I.size(), frame_counter);
       for (size_t frame_num = 0u; frame_num < frame_counter; ++frame_num) {
         interpolated_frame_poses->emplace(
@@ -110,107 +111,159 @@ void interpolateVisualFramePosesAllMissions(
   }
 }
 
-void retriangulateLandmarksOfVertex(
-    const FrameToPoseMap& interpolated_frame_poses,
-    pose_graph::VertexId storing_vertex_id, vi_map::VIMap* map) {
-  CHECK_NOTNULL(map);
-  vi_map::Vertex& storing_vertex = map->getVertex(storing_vertex_id);
-  vi_map::LandmarkStore& landmark_store = storing_vertex.getLandmarks();
+void interpolateVisualFramePosesAllMissions(
+    const vi_map::VIMap& map, FrameToPoseMap* interpolated_frame_poses) {
+  vi_map::MissionIdList mission_ids;
+  map.getAllMissionIds(&mission_ids);
+  interpolateVisualFramePosesOfMissions(
+      map, mission_ids, interpolated_frame_poses);
+}
 
-  const aslam::Transformation& T_M_I_storing = storing_vertex.get_T_M_I();
+aslam::Transformation getStoringVertexPose_G_I(
+    const pose_graph::VertexId& storing_vertex_id, const vi_map::VIMap& map) {
+  const aslam::Transformation& T_M_I_storing =
+      map.getVertex(storing_vertex_id).get_T_M_I();
   const aslam::Transformation& T_G_M_storing =
-      const_cast<const vi_map::VIMap*>(map)
-          ->getMissionBaseFrameForVertex(storing_vertex_id)
-          .get_T_G_M();
-  const aslam::Transformation T_G_I_storing = T_G_M_storing * T_M_I_storing;
+      map.getMissionBaseFrameForVertex(storing_vertex_id).get_T_G_M();
+  return T_G_M_storing * T_M_I_storing;
+}
 
-  for (vi_map::Landmark& landmark : landmark_store) {
-    // The following have one entry per measurement:
-    Eigen::Matrix3Xd G_bearing_vectors;
-    Eigen::Matrix3Xd p_G_C_vector;
+// Appends the observation rays of the landmark, i.e. the bearing vectors and
+// camera positions in the global frame, to the packed arrays starting at
+// column *num_columns. Returns false if fewer than two rays are available.
+bool appendLandmarkObservationRays(
+    const FrameToPoseMap& interpolated_frame_poses, const vi_map::VIMap& map,
+    const vi_map::Landmark& landmark, Eigen::Matrix3Xd* G_bearing_vectors,
+    Eigen::Matrix3Xd* p_G_C_vector, size_t* num_columns) {
+  CHECK_NOTNULL(G_bearing_vectors);
+  CHECK_NOTNULL(p_G_C_vector);
+  CHECK_NOTNULL(num_columns);
+
+  const vi_map::KeypointIdentifierList& observations =
+      landmark.getObservations();
+  if (observations.size() < 2u) {
+    statistics::StatsCollector stats(
+        "Landmark triangulation failed too few observations.");
+    stats.IncrementOne();
+    return false;
+  }
+  CHECK_LE(
+      *num_columns + observations.size(),
+      static_cast<size_t>(G_bearing_vectors->cols()));
+  CHECK_EQ(G_bearing_vectors->cols(), p_G_C_vector->cols());
+
+  const size_t first_column = *num_columns;
+  for (const vi_map::KeypointIdentifier& observation : observations) {
+    const pose_graph::VertexId& observer_id = observation.frame_id.vertex_id;
+    CHECK(map.hasVertex(observer_id))
+        << "Observer " << observer_id << " of store landmark "
+        << landmark.id() << " not in currently loaded map!";
+
+    const vi_map::Vertex& observer = map.getVertex(observer_id);
+    const aslam::VisualFrame& visual_frame =
+        observer.getVisualFrame(observation.frame_id.frame_index);
+    const aslam::Transformation& T_G_M_observer =
+        map.getMissionBaseFrameForVertex(observer_id).get_T_G_M();
+
+    // If there are precomputed/interpolated T_M_I, use those.
+    aslam::Transformation T_G_I_observer;
+    FrameToPoseMap::const_iterator it =
+        interpolated_frame_poses.find(visual_frame.getId());
+    if (it != interpolated_frame_poses.end()) {
+      const aslam::Transformation& T_M_I_observer = it->second;
+      T_G_I_observer = T_G_M_observer * T_M_I_observer;
+    } else {
+      const aslam::Transformation& T_M_I_observer = observer.get_T_M_I();
+      T_G_I_observer = T_G_M_observer * T_M_I_observer;
+    }
 
-    landmark.setQuality(vi_map::Landmark::Quality::kBad);
+    Eigen::Vector2d measurement =
+        visual_frame.getKeypointMeasurement(observation.keypoint_index);
 
-    const vi_map::KeypointIdentifierList& observations =
-        landmark.getObservations();
-    if (observations.size() < 2u) {
+    Eigen::Vector3d C_bearing_vector;
+    bool projection_result =
+        observer.getCamera(observation.frame_id.frame_index)
+            ->backProject3(measurement, &C_bearing_vector);
+    if (!projection_result) {
       statistics::StatsCollector stats(
-          "Landmark triangulation failed too few observations.");
+          "Landmark triangulation failed proj failed.");
       stats.IncrementOne();
       continue;
     }
 
-    G_bearing_vectors.resize(Eigen::NoChange, observations.size());
-    p_G_C_vector.resize(Eigen::NoChange, observations.size());
-
-    int num_measurements = 0;
-    for (const vi_map::KeypointIdentifier& observation : observations) {
-      const pose_graph::VertexId& observer_id = observation.frame_id.vertex_id;
-      CHECK(map->hasVertex(observer_id))
-          << "Observer " << observer_id << " of store landmark "
-          << landmark.id() << " not in currently loaded map!";
-
-      const vi_map::Vertex& observer =
-          const_cast<const vi_map::VIMap*>(map)->getVertex(observer_id);
-      const aslam::VisualFrame& visual_frame =
-          observer.getVisualFrame(observation.frame_id.frame_index);
-      const aslam::Transformation& T_G_M_observer =
-          const_cast<const vi_map::VIMap*>(map)
-              ->getMissionBaseFrameForVertex(observer_id)
-              .get_T_G_M();
-
-      // If there are precomputed/interpolated T_M_I, use those.
-      aslam::Transformation T_G_I_observer;
-      FrameToPoseMap::const_iterator it =
-          interpolated_frame_poses.find(visual_frame.getId());
-      if (it != interpolated_frame_poses.end()) {
-        const aslam::Transformation& T_M_I_observer = it->second;
-        T_G_I_observer = T_G_M_observer * T_M_I_observer;
-      } else {
-        const aslam::Transformation& T_M_I_observer = observer.get_T_M_I();
-        T_G_I_observer = T_G_M_observer * T_M_I_observer;
-      }
-
-      Eigen::Vector2d measurement =
-          visual_frame.getKeypointMeasurement(observation.keypoint_index);
+    const aslam::CameraId& cam_id =
+        observer.getCamera(observation.frame_id.frame_index)->getId();
+    aslam::Transformation T_G_C =
+        (T_G_I_observer *
+         observer.getNCameras()->get_T_C_B(cam_id).inverse());
+    G_bearing_vectors->col(*num_columns) =
+        T_G_C.getRotationMatrix() * C_bearing_vector;
+    p_G_C_vector->col(*num_columns) = T_G_C.getPosition();
+    ++(*num_columns);
+  }
 
-      Eigen::Vector3d C_bearing_vector;
-      bool projection_result =
-          observer.getCamera(observation.frame_id.frame_index)
-              ->backProject3(measurement, &C_bearing_vector);
-      if (!projection_result) {
-        statistics::StatsCollector stats(
-            "Landmark triangulation failed proj failed.");
-        stats.IncrementOne();
-        continue;
-      }
+  if (*num_columns - first_column < 2u) {
+    statistics::StatsCollector stats("Landmark triangulation too few meas.");
+    stats.IncrementOne();
+    *num_columns = first_column;
+    return false;
+  }
+  return true;
+}
 
-      const aslam::CameraId& cam_id =
-          observer.getCamera(observation.frame_id.frame_index)->getId();
-      aslam::Transformation T_G_C =
-          (T_G_I_observer *
-           observer.getNCameras()->get_T_C_B(cam_id).inverse());
-      G_bearing_vectors.col(num_measurements) =
-          T_G_C.getRotationMatrix() * C_bearing_vector;
-      p_G_C_vector.col(num_measurements) = T_G_C.getPosition();
-      ++num_measurements;
-    }
-    G_bearing_vectors.conservativeResize(Eigen::NoChange, num_measurements);
-    p_G_C_vector.conservativeResize(Eigen::NoChange, num_measurements);
+// Retriangulates a batch of landmarks with a single call to the batched
+// triangulation, T_G_I_storing holds the pose of the storing vertex of every
+// landmark.
+void retriangulateLandmarkBatch(
+    const FrameToPoseMap& interpolated_frame_poses,
+    const std::vector<vi_map::Landmark*>& landmarks,
+    const Aligned<std::vector, aslam::Transformation>& T_G_I_storing,
+    vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  CHECK_EQ(landmarks.size(), T_G_I_storing.size());
 
-    if (num_measurements < 2) {
-      statistics::StatsCollector stats("Landmark triangulation too few meas.");
-      stats.IncrementOne();
-      continue;
+  // Size the packed arrays once for the whole batch.
+  size_t num_observations = 0u;
+  for (const vi_map::Landmark* landmark : landmarks) {
+    num_observations += CHECK_NOTNULL(landmark)->numberOfObservations();
+  }
+  Eigen::Matrix3Xd G_bearing_vectors(3, num_observations);
+  Eigen::Matrix3Xd p_G_C_vector(3, num_observations);
+
+  // Only the landmarks with enough observation rays are triangulated.
+  std::vector<size_t> triangulated_landmark_indices;
+  triangulated_landmark_indices.reserve(landmarks.size());
+  std::vector<size_t> observation_offsets;
+  observation_offsets.reserve(landmarks.size() + 1u);
+  observation_offsets.push_back(0u);
+  size_t num_columns = 0u;
+  for (size_t landmark_idx = 0u; landmark_idx < landmarks.size();
+       ++landmark_idx) {
+    vi_map::Landmark& landmark = *landmarks[landmark_idx];
+    landmark.setQuality(vi_map::Landmark::Quality::kBad);
+    if (appendLandmarkObservationRays(
+            interpolated_frame_poses, *map, landmark, &G_bearing_vectors,
+            &p_G_C_vector, &num_columns)) {
+      triangulated_landmark_indices.push_back(landmark_idx);
+      observation_offsets.push_back(num_columns);
     }
+  }
 
-    Eigen::Vector3d p_G_fi;
-    aslam::TriangulationResult triangulation_result =
-        aslam::linearTriangulateFromNViews(
-            G_bearing_vectors, p_G_C_vector, &p_G_fi);
-
-    if (triangulation_result.wasTriangulationSuccessful()) {
-      landmark.set_p_B(T_G_I_storing.inverse() * p_G_fi);
+  Eigen::Matrix3Xd p_G_fi;
+  std::vector<bool> triangulation_success;
+  geometric_vision::LinearTriangulation triangulator;
+  triangulator.triangulateBatchFromBearings(
+      G_bearing_vectors, p_G_C_vector, observation_offsets, &p_G_fi,
+      &triangulation_success);
+
+  for (size_t batch_idx = 0u; batch_idx < triangulated_landmark_indices.size();
+       ++batch_idx) {
+    const size_t landmark_idx = triangulated_landmark_indices[batch_idx];
+    vi_map::Landmark& landmark = *landmarks[landmark_idx];
+    if (triangulation_success[batch_idx]) {
+      landmark.set_p_B(
+          T_G_I_storing[landmark_idx].inverse() *
+          static_cast<Eigen::Vector3d>(p_G_fi.col(batch_idx)));
       constexpr bool kReEvaluateQuality = true;
       if (vi_map::isLandmarkWellConstrained(
               *map, landmark, kReEvaluateQuality)) {
@@ -224,22 +277,30 @@ void retriangulateLandmarksOfVertex(
     } else {
       statistics::StatsCollector stats("Landmark triangulation failed");
       stats.IncrementOne();
-      if (triangulation_result.status() ==
-          aslam::TriangulationResult::UNOBSERVABLE) {
-        statistics::StatsCollector stats(
-            "Landmark triangulation failed - unobservable");
-        stats.IncrementOne();
-      } else if (
-          triangulation_result.status() ==
-          aslam::TriangulationResult::UNINITIALIZED) {
-        statistics::StatsCollector stats(
-            "Landmark triangulation failed - uninitialized");
-        stats.IncrementOne();
-      }
+      statistics::StatsCollector stats_unobservable(
+          "Landmark triangulation failed - unobservable");
+      stats_unobservable.IncrementOne();
     }
   }
 }
 
+void retriangulateLandmarksOfVertex(
+    const FrameToPoseMap& interpolated_frame_poses,
+    pose_graph::VertexId storing_vertex_id, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  vi_map::Vertex& storing_vertex = map->getVertex(storing_vertex_id);
+  vi_map::LandmarkStore& landmark_store = storing_vertex.getLandmarks();
+  std::vector<vi_map::Landmark*> landmarks;
+  landmarks.reserve(landmark_store.size());
+  for (vi_map::Landmark& landmark : landmark_store) {
+    landmarks.push_back(&landmark);
+  }
+  const Aligned<std::vector, aslam::Transformation> T_G_I_storing(
+      landmarks.size(), getStoringVertexPose_G_I(storing_vertex_id, *map));
+  retriangulateLandmarkBatch(
+      interpolated_frame_poses, landmarks, T_G_I_storing, map);
+}
+
 bool retriangulateLandmarksOfMission(
     const vi_map::MissionId& mission_id,
     const FrameToPoseMap& interpolated_frame_poses, vi_map::VIMap* map) {
@@ -252,24 +313,26 @@ bool retriangulateLandmarksOfMission(
   const size_t num_vertices = relevant_vertex_ids.size();
   VLOG(1) << "Retriangulating landmarks of " << num_vertices << " vertices.";
 
-  common::MultiThreadedProgressBar progress_bar;
-  std::function<void(const std::vector<size_t>&)> retriangulator =
-      [&relevant_vertex_ids, map, &progress_bar,
-       &interpolated_frame_poses](const std::vector<size_t>& batch) {
-        progress_bar.setNumElements(batch.size());
-        size_t num_processed = 0u;
-        for (size_t item : batch) {
+  // The number of observations per vertex varies a lot, so the vertices are
+  // handed out dynamically to balance the load between the threads.
+  common::ProgressBar progress_bar(num_vertices);
+  std::mutex progress_mutex;
+  size_t num_processed = 0u;
+  std::function<void(size_t, size_t)> retriangulator =
+      [&relevant_vertex_ids, map, &progress_bar, &progress_mutex,
+       &num_processed, &interpolated_frame_poses](size_t begin, size_t end) {
+        for (size_t item = begin; item < end; ++item) {
           CHECK_LT(item, relevant_vertex_ids.size());
           retriangulateLandmarksOfVertex(
               interpolated_frame_poses, relevant_vertex_ids[item], map);
-          progress_bar.update(++num_processed);
         }
+        std::lock_guard<std::mutex> lock(progress_mutex);
+        num_processed += end - begin;
+        progress_bar.update(num_processed);
       };
 
-  static constexpr bool kAlwaysParallelize = false;
   const size_t num_threads = common::getNumHardwareThreads();
-  common::ParallelProcess(
-      num_vertices, retriangulator, kAlwaysParallelize, num_threads);
+  common::ParallelProcessDynamic(num_vertices, retriangulator, num_threads);
   return true;
 }
 }  // namespace
@@ -303,4 +366,110 @@ void retriangulateLandmarksOfVertex(
       empty_frame_to_pose_map, storing_vertex_id, map);
 }
 
+void getAllVertexPoses_G_I(
+    const vi_map::VIMap& map, VertexIdToTransformationMap* T_G_I_map) {
+  CHECK_NOTNULL(T_G_I_map)->clear();
+  pose_graph::VertexIdList vertex_ids;
+  map.getAllVertexIds(&vertex_ids);
+  T_G_I_map->reserve(vertex_ids.size());
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    T_G_I_map->emplace(vertex_id, map.getVertex_T_G_I(vertex_id));
+  }
+}
+
+void getVerticesWithPoseChange(
+    const vi_map::VIMap& map, const VertexIdToTransformationMap& T_G_I_before,
+    const double min_position_change_meters,
+    const double min_rotation_change_radians,
+    pose_graph::VertexIdSet* changed_vertex_ids) {
+  CHECK_NOTNULL(changed_vertex_ids)->clear();
+  CHECK_GE(min_position_change_meters, 0.0);
+  CHECK_GE(min_rotation_change_radians, 0.0);
+  pose_graph::VertexIdList vertex_ids;
+  map.getAllVertexIds(&vertex_ids);
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    VertexIdToTransformationMap::const_iterator it =
+        T_G_I_before.find(vertex_id);
+    if (it == T_G_I_before.end()) {
+      // New vertices have no reference pose.
+      changed_vertex_ids->insert(vertex_id);
+      continue;
+    }
+    const aslam::Transformation T_G_I = map.getVertex_T_G_I(vertex_id);
+    const double position_change =
+        (T_G_I.getPosition() - it->second.getPosition()).norm();
+    const double rotation_change =
+        T_G_I.getRotation().getDisparityAngle(it->second.getRotation());
+    if (position_change > min_position_change_meters ||
+        rotation_change > min_rotation_change_radians) {
+      changed_vertex_ids->insert(vertex_id);
+    }
+  }
+}
+
+bool retriangulateLandmarksOfChangedVertices(
+    const pose_graph::VertexIdSet& changed_vertex_ids, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  if (changed_vertex_ids.empty()) {
+    return true;
+  }
+
+  // A landmark needs to be retriangulated if one of its observers moved or
+  // if its storing vertex moved, as the position is stored relative to it.
+  vi_map::LandmarkIdSet affected_landmark_ids;
+  for (const pose_graph::VertexId& vertex_id : changed_vertex_ids) {
+    const vi_map::Vertex& vertex = map->getVertex(vertex_id);
+    vi_map::LandmarkIdList landmark_ids;
+    vertex.getAllObservedLandmarkIds(&landmark_ids);
+    for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+      if (landmark_id.isValid()) {
+        affected_landmark_ids.insert(landmark_id);
+      }
+    }
+    vertex.getStoredLandmarkIdList(&landmark_ids);
+    affected_landmark_ids.insert(landmark_ids.begin(), landmark_ids.end());
+  }
+  const vi_map::LandmarkIdList affected_landmarks(
+      affected_landmark_ids.begin(), affected_landmark_ids.end());
+
+  // Only interpolate the frame poses of the missions observing the affected
+  // landmarks.
+  vi_map::MissionIdSet observer_mission_ids;
+  for (const vi_map::LandmarkId& landmark_id : affected_landmarks) {
+    vi_map::MissionIdSet landmark_observer_missions;
+    map->getLandmarkObserverMissions(landmark_id, &landmark_observer_missions);
+    observer_mission_ids.insert(
+        landmark_observer_missions.begin(), landmark_observer_missions.end());
+  }
+  FrameToPoseMap interpolated_frame_poses;
+  interpolateVisualFramePosesOfMissions(
+      *map,
+      vi_map::MissionIdList(
+          observer_mission_ids.begin(), observer_mission_ids.end()),
+      &interpolated_frame_poses);
+
+  const size_t num_landmarks = affected_landmarks.size();
+  VLOG(1) << "Retriangulating " << num_landmarks << " landmarks affected by "
+          << changed_vertex_ids.size() << " changed vertices.";
+  std::function<void(size_t, size_t)> retriangulator =
+      [&affected_landmarks, &interpolated_frame_poses, map](
+          size_t begin, size_t end) {
+        std::vector<vi_map::Landmark*> landmarks;
+        Aligned<std::vector, aslam::Transformation> T_G_I_storing;
+        landmarks.reserve(end - begin);
+        T_G_I_storing.reserve(end - begin);
+        for (size_t item = begin; item < end; ++item) {
+          const vi_map::LandmarkId& landmark_id = affected_landmarks[item];
+          landmarks.push_back(&map->getLandmark(landmark_id));
+          T_G_I_storing.push_back(getStoringVertexPose_G_I(
+              map->getLandmarkStoreVertexId(landmark_id), *map));
+        }
+        retriangulateLandmarkBatch(
+            interpolated_frame_poses, landmarks, T_G_I_storing, map);
+      };
+  const size_t num_threads = common::getNumHardwareThreads();
+  common::ParallelProcessDynamic(num_landmarks, retriangulator, num_threads);
+  return true;
+}
+
 }  // namespace landmark_triangulation
@@ -1,11 +1,75 @@
 #include "landmark-triangulation/pose-interpolator.h"
 
+#include <algorithm>
+#include <vector>
+
 #include <aslam/common/time.h>
 #include <glog/logging.h>
 #include <imu-integrator/imu-integrator.h>
 #include <maplab-common/macros.h>
 
 namespace landmark_triangulation {
+namespace {
+imu_integrator::ImuIntegratorRK4 createImuIntegrator(
+    const vi_map::VIMap& map, const vi_map::MissionId& mission_id) {
+  CHECK(mission_id.isValid());
+  const vi_map::Imu& imu_sensor =
+      map.getSensorManager().getSensorForMission<vi_map::Imu>(mission_id);
+  const vi_map::ImuSigmas& imu_sigmas = imu_sensor.getImuSigmas();
+  return imu_integrator::ImuIntegratorRK4(
+      imu_sigmas.gyro_noise_density,
+      imu_sigmas.gyro_bias_random_walk_noise_density,
+      imu_sigmas.acc_noise_density,
+      imu_sigmas.acc_bias_random_walk_noise_density,
+      imu_sensor.getGravityMagnitudeMps2());
+}
+
+typedef Eigen::Matrix<double, imu_integrator::kStateSize, 1> ImuState;
+
+// Integrates the state over one step between two IMU readings, debiased with
+// the biases of the current state.
+void integrateImuStep(
+    const imu_integrator::ImuIntegratorRK4& integrator,
+    const ImuState& current_state,
+    const Eigen::Matrix<double, 6, 1>& imu_reading_begin,
+    const Eigen::Matrix<double, 6, 1>& imu_reading_end,
+    const int64_t delta_time_ns, ImuState* next_state) {
+  CHECK_NOTNULL(next_state);
+  using imu_integrator::kAccelBiasBlockSize;
+  using imu_integrator::kAccelReadingOffset;
+  using imu_integrator::kGyroBiasBlockSize;
+  using imu_integrator::kGyroReadingOffset;
+  using imu_integrator::kImuReadingSize;
+  using imu_integrator::kNanoSecondsToSeconds;
+  using imu_integrator::kStateAccelBiasOffset;
+  using imu_integrator::kStateGyroBiasOffset;
+
+  const Eigen::Vector3d gyro_bias =
+      current_state.segment<kGyroBiasBlockSize>(kStateGyroBiasOffset);
+  const Eigen::Vector3d accel_bias =
+      current_state.segment<kAccelBiasBlockSize>(kStateAccelBiasOffset);
+  Eigen::Matrix<double, 2 * kImuReadingSize, 1> debiased_imu_readings;
+  debiased_imu_readings
+      << imu_reading_begin.segment<3>(kAccelReadingOffset) - accel_bias,
+      imu_reading_begin.segment<3>(kGyroReadingOffset) - gyro_bias,
+      imu_reading_end.segment<3>(kAccelReadingOffset) - accel_bias,
+      imu_reading_end.segment<3>(kGyroReadingOffset) - gyro_bias;
+  integrator.integrateStateOnly(
+      current_state, debiased_imu_readings,
+      delta_time_ns * kNanoSecondsToSeconds, next_state);
+}
+
+aslam::Transformation imuStateToTransformation(const ImuState& state) {
+  Eigen::Quaterniond q_M_I;
+  q_M_I.coeffs() =
+      state.segment<imu_integrator::kStateOrientationBlockSize>(
+          imu_integrator::kStateOrientationOffset);
+  return aslam::Transformation(
+      q_M_I, state.segment<imu_integrator::kPositionBlockSize>(
+                 imu_integrator::kStatePositionOffset));
+}
+}  // namespace
+
 void PoseInterpolator::buildListOfAllRequiredIMUMeasurements(
     const vi_map::VIMap& map, const std::vector<int64_t>& timestamps,
     const pose_graph::EdgeId& imu_edge_id, int start_index, int end_index,
@@ -509,4 +573,192 @@ void PoseInterpolator::getPosesEveryNSeconds(
   return getPosesAtTime(vi_map, mission_id, *pose_times, poses);
 }
 
+MissionPoseInterpolator::MissionPoseInterpolator(
+    const vi_map::VIMap& map, const vi_map::MissionId& mission_id)
+    : map_(map),
+      mission_id_(mission_id),
+      integrator_(createImuIntegrator(map, mission_id)),
+      num_integrated_edges_(0u) {
+  CHECK(
+      map_.getGraphTraversalEdgeType(mission_id_) ==
+      pose_graph::Edge::EdgeType::kViwls);
+  PoseInterpolator pose_interpolator;
+  pose_interpolator.buildVertexToTimeList(
+      map_, mission_id_, &vertices_and_time_);
+  CHECK_GT(vertices_and_time_.size(), 1u)
+      << "The Viwls edges of mission " << mission_id_
+      << " include none at all or only a single IMU "
+      << "measurement. Interpolation is not possible!";
+  integrated_edges_.resize(vertices_and_time_.size());
+}
+
+int64_t MissionPoseInterpolator::getStartTimeNanoseconds() const {
+  return vertices_and_time_.front().timestamp_ns;
+}
+
+int64_t MissionPoseInterpolator::getEndTimeNanoseconds() const {
+  return vertices_and_time_.back().timestamp_ns_end;
+}
+
+void MissionPoseInterpolator::clearCache() {
+  for (IntegratedEdge& integrated_edge : integrated_edges_) {
+    integrated_edge.is_integrated = false;
+    integrated_edge.states.resize(Eigen::NoChange, 0);
+  }
+  num_integrated_edges_ = 0u;
+}
+
+const MissionPoseInterpolator::IntegratedEdge&
+MissionPoseInterpolator::getIntegratedEdge(const size_t edge_idx) {
+  CHECK_LT(edge_idx, integrated_edges_.size());
+  IntegratedEdge& integrated_edge = integrated_edges_[edge_idx];
+  if (integrated_edge.is_integrated) {
+    return integrated_edge;
+  }
+
+  const VertexInformation& vertex_information = vertices_and_time_[edge_idx];
+  const vi_map::ViwlsEdge& imu_edge = map_.getEdgeAs<vi_map::ViwlsEdge>(
+      vertex_information.outgoing_imu_edge_id);
+  const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps =
+      imu_edge.getImuTimestamps();
+  const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_data =
+      imu_edge.getImuData();
+  CHECK_EQ(imu_timestamps.cols(), imu_data.cols());
+  CHECK_GT(imu_timestamps.cols(), 0);
+
+  // Active to passive and direction switch, so no inversion.
+  const vi_map::Vertex& vertex_from =
+      map_.getVertex(vertex_information.vertex_id);
+  const aslam::Transformation& T_M_I = vertex_from.get_T_M_I();
+  integrated_edge.states.resize(Eigen::NoChange, imu_timestamps.cols());
+  integrated_edge.states.col(0)
+      << T_M_I.getRotation().toImplementation().coeffs(),
+      vertex_from.getGyroBias(), vertex_from.get_v_M(),
+      vertex_from.getAccelBias(), T_M_I.getPosition();
+
+  ImuState next_state;
+  for (int i = 0; i < imu_timestamps.cols() - 1; ++i) {
+    CHECK_GE(imu_timestamps(0, i + 1), imu_timestamps(0, i))
+        << "IMU measurements not properly ordered";
+    integrateImuStep(
+        integrator_, integrated_edge.states.col(i), imu_data.col(i),
+        imu_data.col(i + 1), imu_timestamps(0, i + 1) - imu_timestamps(0, i),
+        &next_state);
+    integrated_edge.states.col(i + 1) = next_state;
+  }
+  integrated_edge.is_integrated = true;
+  ++num_integrated_edges_;
+  return integrated_edge;
+}
+
+void MissionPoseInterpolator::getPosesAtSortedTimes(
+    const std::vector<int64_t>& sorted_timestamps_ns,
+    aslam::TransformationVector* poses_M_I) {
+  CHECK_NOTNULL(poses_M_I)->clear();
+  if (sorted_timestamps_ns.empty()) {
+    return;
+  }
+  CHECK_GE(sorted_timestamps_ns.front(), getStartTimeNanoseconds())
+      << "Requested sample out of bounds! First available time is "
+      << getStartTimeNanoseconds() << " but " << sorted_timestamps_ns.front()
+      << " was requested.";
+  CHECK_LE(sorted_timestamps_ns.back(), getEndTimeNanoseconds())
+      << "Requested sample out of bounds! Last available time is "
+      << getEndTimeNanoseconds() << " but " << sorted_timestamps_ns.back()
+      << " was requested.";
+  poses_M_I->reserve(sorted_timestamps_ns.size());
+
+  // Both the edge and the IMU measurement within the edge only move forward
+  // as the timestamps are sorted.
+  size_t edge_idx = 0u;
+  int imu_idx = 0;
+  int64_t previous_timestamp_ns = sorted_timestamps_ns.front();
+  for (const int64_t timestamp_ns : sorted_timestamps_ns) {
+    CHECK_GE(timestamp_ns, previous_timestamp_ns)
+        << "The timestamps are not sorted.";
+    previous_timestamp_ns = timestamp_ns;
+
+    // At the boundary between two edges the state of the vertex is used.
+    while (edge_idx + 1u < vertices_and_time_.size() &&
+           vertices_and_time_[edge_idx + 1u].timestamp_ns <= timestamp_ns) {
+      ++edge_idx;
+      imu_idx = 0;
+    }
+    CHECK_LE(timestamp_ns, vertices_and_time_[edge_idx].timestamp_ns_end)
+        << "No IMU measurements at time " << timestamp_ns << ".";
+
+    const IntegratedEdge& integrated_edge = getIntegratedEdge(edge_idx);
+    const vi_map::ViwlsEdge& imu_edge = map_.getEdgeAs<vi_map::ViwlsEdge>(
+        vertices_and_time_[edge_idx].outgoing_imu_edge_id);
+    const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps =
+        imu_edge.getImuTimestamps();
+    while (imu_idx + 1 < imu_timestamps.cols() &&
+           imu_timestamps(0, imu_idx + 1) <= timestamp_ns) {
+      ++imu_idx;
+    }
+    const int64_t timestamp_before = imu_timestamps(0, imu_idx);
+    if (timestamp_before == timestamp_ns) {
+      poses_M_I->emplace_back(
+          imuStateToTransformation(integrated_edge.states.col(imu_idx)));
+      continue;
+    }
+
+    // Integrate from the preceding measurement with a linearly interpolated
+    // IMU measurement at the requested time.
+    CHECK_LT(imu_idx + 1, imu_timestamps.cols());
+    const int64_t timestamp_after = imu_timestamps(0, imu_idx + 1);
+    CHECK_NE(timestamp_after, timestamp_before);
+    const double alpha =
+        static_cast<double>(timestamp_ns - timestamp_before) /
+        static_cast<double>(timestamp_after - timestamp_before);
+    const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_data =
+        imu_edge.getImuData();
+    const Eigen::Matrix<double, 6, 1> interpolated_imu_reading =
+        (1.0 - alpha) * imu_data.col(imu_idx) +
+        alpha * imu_data.col(imu_idx + 1);
+    ImuState interpolated_state;
+    integrateImuStep(
+        integrator_, integrated_edge.states.col(imu_idx),
+        imu_data.col(imu_idx), interpolated_imu_reading,
+        timestamp_ns - timestamp_before, &interpolated_state);
+    poses_M_I->emplace_back(imuStateToTransformation(interpolated_state));
+  }
+}
+
+void MissionPoseInterpolator::getPosesAtTime(
+    const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& timestamps_ns,
+    aslam::TransformationVector* poses_M_I) {
+  CHECK_NOTNULL(poses_M_I)->clear();
+  const size_t num_timestamps = timestamps_ns.cols();
+  std::vector<size_t> sorted_indices(num_timestamps);
+  for (size_t i = 0u; i < num_timestamps; ++i) {
+    sorted_indices[i] = i;
+  }
+  std::sort(
+      sorted_indices.begin(), sorted_indices.end(),
+      [&timestamps_ns](size_t lhs, size_t rhs) {
+        return timestamps_ns(0, lhs) < timestamps_ns(0, rhs);
+      });
+  std::vector<int64_t> sorted_timestamps_ns(num_timestamps);
+  for (size_t i = 0u; i < num_timestamps; ++i) {
+    sorted_timestamps_ns[i] = timestamps_ns(0, sorted_indices[i]);
+  }
+
+  aslam::TransformationVector sorted_poses_M_I;
+  getPosesAtSortedTimes(sorted_timestamps_ns, &sorted_poses_M_I);
+  CHECK_EQ(sorted_poses_M_I.size(), num_timestamps);
+  poses_M_I->resize(num_timestamps);
+  for (size_t i = 0u; i < num_timestamps; ++i) {
+    (*poses_M_I)[sorted_indices[i]] = sorted_poses_M_I[i];
+  }
+}
+
+aslam::Transformation MissionPoseInterpolator::getPoseAtTime(
+    const int64_t timestamp_ns) {
+  aslam::TransformationVector poses_M_I;
+  getPosesAtSortedTimes({timestamp_ns}, &poses_M_I);
+  CHECK_EQ(poses_M_I.size(), 1u);
+  return poses_M_I.front();
+}
+
 }  // namespace landmark_triangulation
@@ -43,6 +43,42 @@ TEST_F(ViMappingTest, TestLandmarkTriangulation) {
       kPrecision, kMinPassingLandmarkFraction);
 }
 
+TEST_F(ViMappingTest, TestIncrementalLandmarkTriangulation) {
+  vi_map::VIMap* map = test_app_.getMapMutable();
+  VertexIdToTransformationMap T_G_I_before;
+  getAllVertexPoses_G_I(*map, &T_G_I_before);
+
+  pose_graph::VertexIdSet changed_vertex_ids;
+  getVerticesWithPoseChange(*map, T_G_I_before, 0.0, 0.0, &changed_vertex_ids);
+  EXPECT_TRUE(changed_vertex_ids.empty());
+
+  pose_graph::VertexIdList vertex_ids;
+  map->getAllVertexIds(&vertex_ids);
+  ASSERT_FALSE(vertex_ids.empty());
+  const pose_graph::VertexId& moved_vertex_id = vertex_ids.front();
+  Eigen::Map<Eigen::Vector3d> p_M_I(
+      map->getVertex(moved_vertex_id).get_p_M_I_Mutable());
+  p_M_I += Eigen::Vector3d(0.01, 0.0, 0.0);
+  getVerticesWithPoseChange(
+      *map, T_G_I_before, 0.02, 0.0, &changed_vertex_ids);
+  EXPECT_TRUE(changed_vertex_ids.empty());
+  getVerticesWithPoseChange(
+      *map, T_G_I_before, 0.005, 0.0, &changed_vertex_ids);
+  ASSERT_EQ(changed_vertex_ids.size(), 1u);
+  EXPECT_EQ(*changed_vertex_ids.begin(), moved_vertex_id);
+  p_M_I -= Eigen::Vector3d(0.01, 0.0, 0.0);
+
+  // Retriangulating the landmarks of all vertices recovers all landmarks.
+  corruptLandmarks();
+  changed_vertex_ids.clear();
+  changed_vertex_ids.insert(vertex_ids.begin(), vertex_ids.end());
+  EXPECT_TRUE(retriangulateLandmarksOfChangedVertices(changed_vertex_ids, map));
+  constexpr double kPrecision = 0.1;
+  constexpr double kMinPassingLandmarkFraction = 0.99;
+  test_app_.testIfLandmarksMatchReference(
+      kPrecision, kMinPassingLandmarkFraction);
+}
+
 void checkLandmarkQualityInView(
     const vi_map::VIMap& map, int expected_num_unknown_quality,
     int expected_num_good_quality, int expected_num_bad_quality) {
@@ -2,6 +2,7 @@
 #include <random>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <aslam/cameras/camera-pinhole.h>
 #include <aslam/cameras/distortion-fisheye.h>
@@ -140,6 +141,83 @@ TEST_F(ViwlsGraph, PoseInterpolationTestBetweenVertices) {
   }
 }
 
+TEST_F(ViwlsGraph, MissionPoseInterpolationCachesIntegratedEdges) {
+  vimap_gen_.generateVIMap();
+  vi_map::VIMap& vi_map = vimap_gen_.vi_map_;
+  map_optimization_legacy::SixDofPoseGraphGenerator& graph_generator =
+      vimap_gen_.graph_gen_;
+
+  const Eigen::VectorXd& imu_timestamps_seconds =
+      graph_generator.imu_timestamps_seconds_;
+  ASSERT_GT(imu_timestamps_seconds.rows(), 1);
+
+  vi_map::MissionIdList mission_ids;
+  vi_map.getAllMissionIds(&mission_ids);
+  CHECK_EQ(mission_ids.size(), 1u);
+  MissionPoseInterpolator pose_interpolator(vi_map, mission_ids[0]);
+
+  // Query the first half of the data, in between the IMU measurements as
+  // well.
+  constexpr double kSecondsToNanoSeconds = 1e9;
+  std::vector<int64_t> timestamps;
+  std::vector<int> ground_truth_indices;
+  for (int i = 0; i < imu_timestamps_seconds.rows() / 2; ++i) {
+    const int64_t timestamp =
+        kSecondsToNanoSeconds * imu_timestamps_seconds(i, 0);
+    const int64_t next_timestamp =
+        kSecondsToNanoSeconds * imu_timestamps_seconds(i + 1, 0);
+    timestamps.push_back(timestamp);
+    ground_truth_indices.push_back(i);
+    timestamps.push_back((timestamp + next_timestamp) / 2);
+    ground_truth_indices.push_back(-1);
+  }
+
+  aslam::TransformationVector T_M_I_list;
+  pose_interpolator.getPosesAtSortedTimes(timestamps, &T_M_I_list);
+  ASSERT_EQ(T_M_I_list.size(), timestamps.size());
+  const size_t num_integrated_edges = pose_interpolator.numIntegratedEdges();
+  EXPECT_GT(num_integrated_edges, 0u);
+
+  const Eigen::Matrix3Xd& p_GI_gt = graph_generator.positions_;
+  const Eigen::Matrix4Xd& q_GI_gt = graph_generator.rotations_;
+  for (size_t i = 0u; i < timestamps.size(); ++i) {
+    if (ground_truth_indices[i] < 0) {
+      continue;
+    }
+    Eigen::Quaterniond q_GI;
+    q_GI.coeffs() = q_GI_gt.col(ground_truth_indices[i]);
+    EXPECT_NEAR_EIGEN(
+        T_M_I_list[i].getPosition(), p_GI_gt.col(ground_truth_indices[i]),
+        1e-4);
+    EXPECT_NEAR_EIGEN_QUATERNION(
+        T_M_I_list[i].getRotation().toImplementation(), q_GI, 1e-4);
+  }
+
+  // Querying a subset in reverse order neither integrates again nor depends
+  // on the other timestamps of the query.
+  Eigen::Matrix<int64_t, 1, Eigen::Dynamic> reversed_timestamps(
+      timestamps.size() / 2);
+  for (int i = 0; i < reversed_timestamps.cols(); ++i) {
+    reversed_timestamps(0, i) = timestamps[reversed_timestamps.cols() - 1 - i];
+  }
+  aslam::TransformationVector reversed_T_M_I_list;
+  pose_interpolator.getPosesAtTime(reversed_timestamps, &reversed_T_M_I_list);
+  ASSERT_EQ(
+      static_cast<int>(reversed_T_M_I_list.size()), reversed_timestamps.cols());
+  for (int i = 0; i < reversed_timestamps.cols(); ++i) {
+    EXPECT_NEAR_ASLAM_TRANSFORMATION(
+        reversed_T_M_I_list[i],
+        T_M_I_list[reversed_timestamps.cols() - 1 - i], 1e-12);
+  }
+  EXPECT_EQ(pose_interpolator.numIntegratedEdges(), num_integrated_edges);
+
+  pose_interpolator.clearCache();
+  EXPECT_EQ(pose_interpolator.numIntegratedEdges(), 0u);
+  EXPECT_NEAR_ASLAM_TRANSFORMATION(
+      pose_interpolator.getPoseAtTime(timestamps.back()), T_M_I_list.back(),
+      1e-12);
+}
+
 }  // namespace landmark_triangulation
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -39,6 +39,13 @@ class LocalizationEvaluator {
       double* error_meters, bool* ransac_ok);
   void evaluateMission(
       const vi_map::MissionId& mission_id, MissionEvaluationStats* statistics);
+  // Evaluates the vertices of all given missions in a single parallel pass
+  // against the database of this evaluator, such that successive query
+  // missions don't rebuild the database. statistics holds one entry per
+  // mission, in the order of mission_ids.
+  void evaluateMissions(
+      const vi_map::MissionIdList& mission_ids,
+      Aligned<std::vector, MissionEvaluationStats>* statistics);
 
  private:
   vi_map::VIMap* map_;
@@ -74,9 +74,30 @@ bool LocalizationEvaluator::evaluateSingleKeyframe(
 void LocalizationEvaluator::evaluateMission(
     const vi_map::MissionId& mission_id, MissionEvaluationStats* statistics) {
   CHECK_NOTNULL(statistics);
+  Aligned<std::vector, MissionEvaluationStats> mission_statistics;
+  evaluateMissions({mission_id}, &mission_statistics);
+  CHECK_EQ(mission_statistics.size(), 1u);
+  *statistics = mission_statistics.front();
+}
+
+void LocalizationEvaluator::evaluateMissions(
+    const vi_map::MissionIdList& mission_ids,
+    Aligned<std::vector, MissionEvaluationStats>* statistics) {
+  CHECK_NOTNULL(statistics)->clear();
 
+  // The vertices of all missions are queried in one pass, mission_begin marks
+  // where the vertices of every mission start.
   pose_graph::VertexIdList vertices;
-  map_->getAllVertexIdsInMission(mission_id, &vertices);
+  std::vector<size_t> mission_begin;
+  mission_begin.reserve(mission_ids.size() + 1u);
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    mission_begin.push_back(vertices.size());
+    pose_graph::VertexIdList mission_vertices;
+    map_->getAllVertexIdsInMission(mission_id, &mission_vertices);
+    vertices.insert(
+        vertices.end(), mission_vertices.begin(), mission_vertices.end());
+  }
+  mission_begin.push_back(vertices.size());
 
   std::vector<char> is_correct;
   std::vector<char> ransac_ok;
@@ -91,11 +112,13 @@ void LocalizationEvaluator::evaluateMission(
   std::vector<double> errors_meters(
       vertices.size(), std::numeric_limits<double>::infinity());
 
-  std::function<void(const std::vector<size_t>&)> pose_query =
+  // The database is only read by the queries. The query time varies a lot
+  // with the number of matches, so the vertices are handed out dynamically.
+  std::function<void(size_t, size_t)> pose_query =
       [this, &vertices, &is_correct, &inlier_counts, &lc_matches_counts,
        &localization_p_G_I, &errors_meters,
-       &ransac_ok](const std::vector<size_t>& batch) {
-        for (size_t item : batch) {
+       &ransac_ok](const size_t begin, const size_t end) {
+        for (size_t item = begin; item < end; ++item) {
           const pose_graph::VertexId& vertex_id = vertices[item];
           Eigen::Vector3d& pnp_p_G_I = localization_p_G_I[item];
           unsigned int& lc_matches_count = lc_matches_counts[item];
@@ -112,40 +135,49 @@ void LocalizationEvaluator::evaluateMission(
         }
       };
 
-  constexpr bool kAlwaysParallelize = true;
   const size_t num_threads = common::getNumHardwareThreads();
-  common::ParallelProcess(
-      is_correct.size(), pose_query, kAlwaysParallelize, num_threads);
+  common::ParallelProcessDynamic(
+      vertices.size(), pose_query, num_threads,
+      common::ParallelSchedule::kDynamic);
 
   // Copy back all valid results.
-  statistics->num_vertices = 0u;
-  statistics->successful_localizations = 0u;
-  statistics->inliers_counts.reserve(vertices.size());
-  statistics->lc_matches_counts.reserve(vertices.size());
-  statistics->localization_p_G_I.reserve(vertices.size());
-  statistics->num_vertices = 0u;
-  statistics->successful_localizations = 0u;
-  for (size_t i = 0; i < is_correct.size(); ++i) {
-    if (is_correct[i]) {
-      statistics->localization_p_G_I.emplace_back(localization_p_G_I[i]);
-      ++statistics->successful_localizations;
-    } else if (ransac_ok[i]) {
-      statistics->bad_localization_p_G_I.emplace_back(localization_p_G_I[i]);
+  statistics->resize(mission_ids.size());
+  for (size_t mission_idx = 0u; mission_idx < mission_ids.size();
+       ++mission_idx) {
+    MissionEvaluationStats& mission_statistics = (*statistics)[mission_idx];
+    const size_t begin = mission_begin[mission_idx];
+    const size_t end = mission_begin[mission_idx + 1u];
+    mission_statistics.num_vertices = 0u;
+    mission_statistics.successful_localizations = 0u;
+    mission_statistics.inliers_counts.reserve(end - begin);
+    mission_statistics.lc_matches_counts.reserve(end - begin);
+    mission_statistics.localization_p_G_I.reserve(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+      if (is_correct[i]) {
+        mission_statistics.localization_p_G_I.emplace_back(
+            localization_p_G_I[i]);
+        ++mission_statistics.successful_localizations;
+      } else if (ransac_ok[i]) {
+        mission_statistics.bad_localization_p_G_I.emplace_back(
+            localization_p_G_I[i]);
+      }
+      mission_statistics.inliers_counts.emplace_back(inlier_counts[i]);
+      mission_statistics.lc_matches_counts.emplace_back(lc_matches_counts[i]);
+      mission_statistics.localization_errors_meters.emplace_back(
+          errors_meters[i]);
+      ++mission_statistics.num_vertices;
     }
-    statistics->inliers_counts.emplace_back(inlier_counts[i]);
-    statistics->lc_matches_counts.emplace_back(lc_matches_counts[i]);
-    statistics->localization_errors_meters.emplace_back(errors_meters[i]);
-    ++statistics->num_vertices;
-  }
 
-  if (statistics->num_vertices > 0) {
-    VLOG(3) << "Ratio "
-            << static_cast<double>(statistics->successful_localizations) /
-                   statistics->num_vertices
-            << " (" << statistics->successful_localizations << "/"
-            << statistics->num_vertices << ")";
-  } else {
-    LOG(WARNING) << "No vertices in mission: " << mission_id;
+    if (mission_statistics.num_vertices > 0) {
+      VLOG(3) << "Ratio "
+              << static_cast<double>(
+                     mission_statistics.successful_localizations) /
+                     mission_statistics.num_vertices
+              << " (" << mission_statistics.successful_localizations << "/"
+              << mission_statistics.num_vertices << ")";
+    } else {
+      LOG(WARNING) << "No vertices in mission: " << mission_ids[mission_idx];
+    }
   }
 }
 
@@ -1,3 +1,5 @@
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include <maplab-common/test/testing-entrypoint.h>
@@ -145,6 +147,22 @@ class ViMappingTest : public ::testing::Test {
     const double avg_inlier_ratio =
         common::window_vec_ops::computeAverage(inlier_ratios, kInvalidValue);
     EXPECT_GT(avg_inlier_ratio, 0.75);
+
+    // Evaluating the same mission twice in one pass must split the results
+    // per mission in the original vertex order.
+    Aligned<std::vector, localization_evaluator::MissionEvaluationStats>
+        mission_stats;
+    evaluator.evaluateMissions(
+        {query_mission_id, query_mission_id}, &mission_stats);
+    ASSERT_EQ(2u, mission_stats.size());
+    for (const localization_evaluator::MissionEvaluationStats&
+             single_mission_stats : mission_stats) {
+      EXPECT_EQ(stats.num_vertices, single_mission_stats.num_vertices);
+      EXPECT_EQ(
+          stats.successful_localizations,
+          single_mission_stats.successful_localizations);
+      EXPECT_EQ(stats.inliers_counts, single_mission_stats.inliers_counts);
+    }
   }
 
  private:
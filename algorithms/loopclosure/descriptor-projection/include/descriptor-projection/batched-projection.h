@@ -0,0 +1,62 @@
+#ifndef DESCRIPTOR_PROJECTION_BATCHED_PROJECTION_H_
+#define DESCRIPTOR_PROJECTION_BATCHED_PROJECTION_H_
+
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace descriptor_projection {
+
+// Unpacks the bits of a binary descriptor into num_bytes * 8 floats of 0 and
+// 1, in the same order as DescriptorToEigenMatrix(). Every byte is expanded
+// with a lookup table of eight floats, which the compiler copies with vector
+// instructions. The descriptor doesn't need to be aligned.
+void UnpackDescriptorBits(
+    const unsigned char* descriptor, int num_bytes, float* unpacked_bits);
+
+// Projects binary descriptors in batches: the bits of up to batch_size
+// descriptors are unpacked into one float block, which is projected with a
+// single matrix product. This replaces a matrix-vector product per descriptor
+// with a matrix-matrix product per batch, which Eigen blocks for the cache
+// and vectorizes. The descriptors can come from any number of frames.
+class BatchedDescriptorProjector {
+ public:
+  // The projected descriptors are written to the columns of
+  // projected_descriptors, which must have target_dimensions rows. The
+  // projection matrix must outlive the projector.
+  BatchedDescriptorProjector(
+      const Eigen::MatrixXf& projection_matrix, int target_dimensions,
+      int batch_size, Eigen::MatrixXf* projected_descriptors);
+  // Projects the remaining descriptors.
+  ~BatchedDescriptorProjector();
+
+  // Queues the descriptor for projection into the given column. The
+  // descriptor is unpacked immediately, so it doesn't need to stay valid.
+  // All descriptors must have the same size.
+  void addDescriptor(
+      const unsigned char* descriptor, int num_bytes, int column_index);
+
+  // Projects the queued descriptors. The columns of projected_descriptors are
+  // only valid after the descriptors were flushed.
+  void flush();
+
+  int batch_size() const {
+    return batch_size_;
+  }
+
+ private:
+  const Eigen::MatrixXf& projection_matrix_;
+  const int target_dimensions_;
+  const int batch_size_;
+  Eigen::MatrixXf* projected_descriptors_;
+
+  int num_descriptor_bits_;
+  // The unpacked bits of the queued descriptors, one column per descriptor.
+  Eigen::MatrixXf unpacked_bits_;
+  std::vector<int> column_indices_;
+  Eigen::MatrixXf projected_batch_;
+};
+
+}  // namespace descriptor_projection
+
+#endif  // DESCRIPTOR_PROJECTION_BATCHED_PROJECTION_H_
@@ -14,6 +14,7 @@
 #include <glog/logging.h>
 #include <loopclosure-common/types.h>
 #include <maplab-common/macros.h>
+#include <posegraph/unique-id.h>
 #include <vi-map/unique-id.h>
 
 #include "descriptor-projection/projected_image.pb.h"
@@ -30,6 +31,9 @@ struct ProjectedImage {
   Eigen::MatrixXf projected_descriptors;
   Eigen::Matrix2Xd measurements;
   std::vector<PointLandmarkId> landmarks;
+  // Only used for queries: if set, only matches to keyframes of these
+  // vertices are returned. Not serialized.
+  std::shared_ptr<const pose_graph::VertexIdSet> candidate_vertex_ids;
 
   void serialize(proto::ProjectedImage* projected_image) const;
   void deserialize(const proto::ProjectedImage& projected_image);
@@ -8,6 +8,8 @@
 DECLARE_string(lc_projection_matrix_filename);
 DECLARE_int32(lc_target_dimensionality);
 DECLARE_string(lc_projected_quantizer_filename);
+DECLARE_int32(lc_projection_batch_size);
+DECLARE_int32(lc_projection_training_num_threads);
 
 namespace descriptor_projection {
 typedef std::vector<unsigned int> Track;
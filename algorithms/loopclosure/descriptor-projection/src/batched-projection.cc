@@ -0,0 +1,100 @@
+#include "descriptor-projection/batched-projection.h"
+
+#include <cstring>
+
+#include <glog/logging.h>
+
+namespace descriptor_projection {
+
+namespace {
+struct ByteToBitsTable {
+  ByteToBitsTable() {
+    for (int byte = 0; byte < 256; ++byte) {
+      for (int bit = 0; bit < 8; ++bit) {
+        bits[byte][bit] = (byte & (1 << bit)) ? 1.f : 0.f;
+      }
+    }
+  }
+  float bits[256][8];
+};
+
+const ByteToBitsTable& getByteToBitsTable() {
+  static const ByteToBitsTable kTable;
+  return kTable;
+}
+}  // namespace
+
+void UnpackDescriptorBits(
+    const unsigned char* descriptor, int num_bytes, float* unpacked_bits) {
+  CHECK_NOTNULL(descriptor);
+  CHECK_NOTNULL(unpacked_bits);
+  CHECK_GE(num_bytes, 0);
+  const ByteToBitsTable& table = getByteToBitsTable();
+  for (int byte_idx = 0; byte_idx < num_bytes; ++byte_idx) {
+    std::memcpy(
+        unpacked_bits + 8 * byte_idx, table.bits[descriptor[byte_idx]],
+        sizeof(table.bits[0]));
+  }
+}
+
+BatchedDescriptorProjector::BatchedDescriptorProjector(
+    const Eigen::MatrixXf& projection_matrix, int target_dimensions,
+    int batch_size, Eigen::MatrixXf* projected_descriptors)
+    : projection_matrix_(projection_matrix),
+      target_dimensions_(target_dimensions),
+      batch_size_(batch_size),
+      projected_descriptors_(CHECK_NOTNULL(projected_descriptors)),
+      num_descriptor_bits_(0) {
+  CHECK_GT(target_dimensions_, 0);
+  CHECK_LE(target_dimensions_, projection_matrix_.rows());
+  CHECK_GT(batch_size_, 0);
+  CHECK_EQ(projected_descriptors_->rows(), target_dimensions_);
+  column_indices_.reserve(batch_size_);
+}
+
+BatchedDescriptorProjector::~BatchedDescriptorProjector() {
+  flush();
+}
+
+void BatchedDescriptorProjector::addDescriptor(
+    const unsigned char* descriptor, int num_bytes, int column_index) {
+  CHECK_GE(column_index, 0);
+  CHECK_LT(column_index, projected_descriptors_->cols());
+  if (num_descriptor_bits_ == 0) {
+    num_descriptor_bits_ = 8 * num_bytes;
+    CHECK_LE(projection_matrix_.cols(), num_descriptor_bits_)
+        << "Projection matrix dimensions don't match the descriptor length. "
+        << "Double check your setting for feature_descriptor_type.";
+    unpacked_bits_.resize(num_descriptor_bits_, batch_size_);
+  }
+  CHECK_EQ(8 * num_bytes, num_descriptor_bits_)
+      << "All descriptors of a batch must have the same size.";
+
+  const int batch_column = static_cast<int>(column_indices_.size());
+  UnpackDescriptorBits(
+      descriptor, num_bytes, unpacked_bits_.col(batch_column).data());
+  column_indices_.push_back(column_index);
+  if (static_cast<int>(column_indices_.size()) == batch_size_) {
+    flush();
+  }
+}
+
+void BatchedDescriptorProjector::flush() {
+  if (column_indices_.empty()) {
+    return;
+  }
+  const int num_descriptors = static_cast<int>(column_indices_.size());
+  // Only the leading bits are used if the projection matrix was trained on
+  // fewer bits than the descriptor has.
+  projected_batch_.noalias() =
+      projection_matrix_.topLeftCorner(
+          target_dimensions_, projection_matrix_.cols()) *
+      unpacked_bits_.topLeftCorner(projection_matrix_.cols(), num_descriptors);
+  for (int batch_column = 0; batch_column < num_descriptors; ++batch_column) {
+    projected_descriptors_->col(column_indices_[batch_column]) =
+        projected_batch_.col(batch_column);
+  }
+  column_indices_.clear();
+}
+
+}  // namespace descriptor_projection
@@ -132,22 +132,31 @@ void BuildCovarianceMatricesOfMatchesAndNonMatches(
 
     *sample_size_matches = descriptors_from_tracks.size();
 
-    Eigen::MatrixXf matches;
-    matches.resize(descriptor_size, descriptors_from_tracks.size());
-    matches.setZero();
-
-    int matched_idx = 0;
-    for (const size_t& descriptor_idx : descriptors_from_tracks) {
-      matches.block(0, matched_idx, descriptor_size, 1) =
-          all_descriptors.block(0, descriptor_idx, descriptor_size, 1);
-      ++matched_idx;
+    // Accumulate the second moment in blocks of descriptors instead of
+    // gathering all matched descriptors in one matrix.
+    constexpr size_t kMatchesBlockSize = 10000u;
+    Eigen::MatrixXf matches_second_moment;
+    matches_second_moment.setZero(descriptor_size, descriptor_size);
+    Eigen::MatrixXf matches_block;
+    for (size_t block_start = 0u;
+         block_start < descriptors_from_tracks.size();
+         block_start += kMatchesBlockSize) {
+      const size_t block_size = std::min(
+          kMatchesBlockSize, descriptors_from_tracks.size() - block_start);
+      matches_block.resize(descriptor_size, block_size);
+      for (size_t idx = 0u; idx < block_size; ++idx) {
+        matches_block.col(idx) =
+            all_descriptors.col(descriptors_from_tracks[block_start + idx]);
+      }
+      matches_second_moment.noalias() +=
+          matches_block * matches_block.transpose();
     }
 
     CHECK_GT(descriptors_from_tracks.size(), number_of_used_tracks);
 
     // Covariance computation for matches.
     cov_matches->noalias() =
-        (matches * matches.transpose() - sumMuMu) * 2.0 /
+        (matches_second_moment - sumMuMu) * 2.0 /
         static_cast<float>(
             descriptors_from_tracks.size() - number_of_used_tracks);
   }  // Scope to limit memory usage.
@@ -3,6 +3,7 @@
 #include <Eigen/Core>
 #include <Eigen/Dense>
 #include <aslam/common/feature-descriptor-ref.h>
+#include <descriptor-projection/batched-projection.h>
 #include <descriptor-projection/descriptor-projection.h>
 #include <descriptor-projection/flags.h>
 #include <gflags/gflags.h>
@@ -34,20 +35,13 @@ void ProjectDescriptorBlock(
   }
   CHECK_NOTNULL(projected_descriptors);
   projected_descriptors->resize(target_dimensions, raw_descriptors.size());
-  Eigen::MatrixXf converted_descriptors;
-  const int num_descriptor_bytes = raw_descriptors[0].size();
-  const int num_descriptor_bits = num_descriptor_bytes * 8;
-  converted_descriptors.resize(num_descriptor_bits, raw_descriptors.size());
+  BatchedDescriptorProjector projector(
+      projection_matrix, target_dimensions, FLAGS_lc_projection_batch_size,
+      projected_descriptors);
   for (size_t i = 0; i < raw_descriptors.size(); ++i) {
-    DescriptorToEigenMatrix(
-        raw_descriptors[i],
-        converted_descriptors.block(0, i, num_descriptor_bits, 1));
+    projector.addDescriptor(
+        raw_descriptors[i].data(), raw_descriptors[i].size(), i);
   }
-  *projected_descriptors =
-      projection_matrix.block(
-          0, 0, target_dimensions, projection_matrix.cols()) *
-      converted_descriptors.block(
-          0, 0, projection_matrix.cols(), projected_descriptors->cols());
 }
 
 void ProjectDescriptorBlock(
@@ -60,15 +54,8 @@ void ProjectDescriptorBlock(
   }
   CHECK_NOTNULL(projected_descriptors);
   projected_descriptors->resize(target_dimensions, raw_descriptors.cols());
-  Eigen::MatrixXf converted_descriptors;
   const int num_descriptor_bytes = raw_descriptors.rows();
   const int num_descriptor_bits = num_descriptor_bytes * 8;
-  converted_descriptors.resize(num_descriptor_bits, raw_descriptors.cols());
-  for (int i = 0; i < raw_descriptors.cols(); ++i) {
-    DescriptorToEigenMatrix(
-        raw_descriptors.block(0, i, raw_descriptors.rows(), 1),
-        converted_descriptors.block(0, i, num_descriptor_bits, 1));
-  }
 
   if (projection_matrix.cols() == 471) {
     CHECK_EQ(512, num_descriptor_bits)
@@ -80,11 +67,13 @@ void ProjectDescriptorBlock(
         << "Double check your setting for feature_descriptor_type.";
   }
 
-  *projected_descriptors =
-      projection_matrix.block(
-          0, 0, target_dimensions, projection_matrix.cols()) *
-      converted_descriptors.block(
-          0, 0, projection_matrix.cols(), projected_descriptors->cols());
+  BatchedDescriptorProjector projector(
+      projection_matrix, target_dimensions, FLAGS_lc_projection_batch_size,
+      projected_descriptors);
+  for (int i = 0; i < raw_descriptors.cols(); ++i) {
+    projector.addDescriptor(
+        raw_descriptors.col(i).data(), num_descriptor_bytes, i);
+  }
 }
 
 bool LoadprojectionMatrix(Eigen::MatrixXf* projection_matrix) {
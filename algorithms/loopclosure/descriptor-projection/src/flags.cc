@@ -10,3 +10,14 @@ DEFINE_string(
 DEFINE_int32(
     lc_target_dimensionality, 10,
     "The target dimensionality of the projection.");
+DEFINE_int32(
+    lc_projection_batch_size, 2048,
+    "Number of binary descriptors that are unpacked and projected with one "
+    "matrix product. The unpacked batch takes batch size * descriptor bits * "
+    "4 bytes.");
+DEFINE_int32(
+    lc_projection_training_num_threads, 4,
+    "Number of missions whose descriptors are collected and reduced to "
+    "covariance statistics in parallel while training the projection matrix. "
+    "The training memory grows with the number of threads, not with the "
+    "number of missions.");
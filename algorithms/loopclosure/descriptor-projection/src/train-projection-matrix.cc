@@ -1,8 +1,8 @@
 #include "descriptor-projection/train-projection-matrix.h"
 
 #include <iostream>  // NOLINT
+#include <mutex>
 #include <string>
-#include <utility>
 #include <vector>
 
 #include <descriptor-projection/build-projection-matrix.h>
@@ -14,25 +14,15 @@
 #include <loopclosure-common/flags.h>
 #include <loopclosure-common/types.h>
 #include <maplab-common/binary-serialization.h>
+#include <maplab-common/parallel-process.h>
 #include <vi-map/vi-map.h>
 
 namespace descriptor_projection {
-struct SubSetCovariance {
-  unsigned int sample_size_matches;
-  unsigned int sample_size_non_matches;
-  Eigen::MatrixXf cov_matches;
-  Eigen::MatrixXf cov_non_matches;
-  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-};
-
 void TrainProjectionMatrix(const vi_map::VIMap& map) {
   CHECK_NE(FLAGS_lc_projection_matrix_filename, "")
       << "You have to provide a filename to write the projection matrix to.";
 
-  Eigen::MatrixXf cov_matches;
-  Eigen::MatrixXf cov_non_matches;
-  double total_sample_size_matches = 0;
-  double total_sample_size_non_matches = 0;
+  CHECK_GT(FLAGS_lc_projection_training_num_threads, 0);
 
   // Get the descriptor-length.
   unsigned int descriptor_size = -1;
@@ -47,56 +37,61 @@ void TrainProjectionMatrix(const vi_map::VIMap& map) {
                  << FLAGS_feature_descriptor_type;
   }
 
-  // A list to find the dataset with most data points.
-  std::vector<std::pair<vi_map::MissionId, unsigned int> >
-      match_counts_and_datasets;
-
-  // For memory reasons we compute sample covariances on every dataset
-  // and compute a weighted average afterwards.
-
+  // The descriptors of one mission at a time are collected per thread and
+  // reduced to their covariance statistics. The statistics of all missions
+  // are summed up weighted by their sample sizes, such that the memory does
+  // not depend on the number of missions.
   vi_map::MissionIdList all_mission_ids;
   map.getAllMissionIds(&all_mission_ids);
+  CHECK(!all_mission_ids.empty());
 
-  std::vector<SubSetCovariance> covariances;
-  for (const vi_map::MissionId& mission_id : all_mission_ids) {
-    Eigen::MatrixXf all_descriptors;
-    SubSetCovariance subset_covariance;
-    std::vector<descriptor_projection::Track> tracks;
-
-    using descriptor_projection::CollectAndConvertDescriptors;
-    CollectAndConvertDescriptors(
-        map, mission_id, descriptor_size, raw_descriptor_matching_threshold,
-        &all_descriptors, &tracks);
-
-    descriptor_projection::BuildCovarianceMatricesOfMatchesAndNonMatches(
-        descriptor_size, all_descriptors, tracks,
-        &subset_covariance.sample_size_matches,
-        &subset_covariance.sample_size_non_matches,
-        &subset_covariance.cov_matches, &subset_covariance.cov_non_matches);
-
-    match_counts_and_datasets.emplace_back(
-        mission_id, subset_covariance.sample_size_matches);
-
-    total_sample_size_matches += subset_covariance.sample_size_matches;
-    total_sample_size_non_matches += subset_covariance.sample_size_non_matches;
-    covariances.push_back(subset_covariance);
-  }
-
-  CHECK(!covariances.empty());
-  const int descriptor_dims = covariances[0].cov_matches.cols();
-  cov_matches.resize(descriptor_dims, descriptor_dims);
-  cov_matches.setZero();
-  cov_non_matches.resize(descriptor_dims, descriptor_dims);
-  cov_non_matches.setZero();
-
-  for (const SubSetCovariance& subset_covariance : covariances) {
-    cov_matches += subset_covariance.cov_matches *
-                   subset_covariance.sample_size_matches /
-                   total_sample_size_matches;
-    cov_non_matches += subset_covariance.cov_non_matches *
-                       subset_covariance.sample_size_non_matches /
-                       total_sample_size_non_matches;
-  }
+  std::mutex m_weighted_covariance_sums;
+  Eigen::MatrixXf weighted_cov_matches_sum;
+  Eigen::MatrixXf weighted_cov_non_matches_sum;
+  double total_sample_size_matches = 0;
+  double total_sample_size_non_matches = 0;
+  std::function<void(size_t, size_t)> process_missions = [&](
+      size_t begin, size_t end) {
+    for (size_t mission_idx = begin; mission_idx < end; ++mission_idx) {
+      Eigen::MatrixXf all_descriptors;
+      std::vector<descriptor_projection::Track> tracks;
+      descriptor_projection::CollectAndConvertDescriptors(
+          map, all_mission_ids[mission_idx], descriptor_size,
+          raw_descriptor_matching_threshold, &all_descriptors, &tracks);
+
+      unsigned int sample_size_matches;
+      unsigned int sample_size_non_matches;
+      Eigen::MatrixXf cov_matches;
+      Eigen::MatrixXf cov_non_matches;
+      descriptor_projection::BuildCovarianceMatricesOfMatchesAndNonMatches(
+          descriptor_size, all_descriptors, tracks, &sample_size_matches,
+          &sample_size_non_matches, &cov_matches, &cov_non_matches);
+      all_descriptors.resize(0, 0);
+      cov_matches *= static_cast<float>(sample_size_matches);
+      cov_non_matches *= static_cast<float>(sample_size_non_matches);
+
+      std::lock_guard<std::mutex> lock(m_weighted_covariance_sums);
+      if (weighted_cov_matches_sum.size() == 0) {
+        weighted_cov_matches_sum = cov_matches;
+        weighted_cov_non_matches_sum = cov_non_matches;
+      } else {
+        weighted_cov_matches_sum += cov_matches;
+        weighted_cov_non_matches_sum += cov_non_matches;
+      }
+      total_sample_size_matches += sample_size_matches;
+      total_sample_size_non_matches += sample_size_non_matches;
+    }
+  };
+  constexpr size_t kMissionsPerChunk = 1u;
+  common::ParallelProcessDynamic(
+      all_mission_ids.size(), process_missions,
+      FLAGS_lc_projection_training_num_threads,
+      common::ParallelSchedule::kDynamic, kMissionsPerChunk);
+
+  const Eigen::MatrixXf cov_matches =
+      weighted_cov_matches_sum / total_sample_size_matches;
+  const Eigen::MatrixXf cov_non_matches =
+      weighted_cov_non_matches_sum / total_sample_size_non_matches;
 
   Eigen::MatrixXf A;
   descriptor_projection::ComputeProjectionMatrix(
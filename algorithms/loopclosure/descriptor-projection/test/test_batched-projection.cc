@@ -0,0 +1,97 @@
+#include <Eigen/Core>
+#include <descriptor-projection/batched-projection.h>
+#include <descriptor-projection/descriptor-projection.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+
+namespace descriptor_projection {
+
+class BatchedProjectionTest : public ::testing::Test {
+ protected:
+  typedef Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic>
+      RawDescriptors;
+  static constexpr int kDescriptorSizeBytes = 64;
+  static constexpr int kNumDescriptors = 100;
+  static constexpr int kTargetDimensions = 10;
+
+  virtual void SetUp() {
+    std::srand(42);
+    raw_descriptors_ =
+        RawDescriptors::Random(kDescriptorSizeBytes, kNumDescriptors);
+  }
+
+  // Projects every descriptor on its own, as the per-descriptor path does.
+  void projectDescriptorsOneByOne(
+      const Eigen::MatrixXf& projection_matrix,
+      Eigen::MatrixXf* projected_descriptors) const {
+    projected_descriptors->resize(kTargetDimensions, kNumDescriptors);
+    for (int i = 0; i < kNumDescriptors; ++i) {
+      ProjectDescriptor(
+          raw_descriptors_.col(i), projection_matrix, kTargetDimensions,
+          projected_descriptors->col(i));
+    }
+  }
+
+  RawDescriptors raw_descriptors_;
+};
+
+TEST_F(BatchedProjectionTest, UnpackedBitsMatchDescriptorToEigenMatrix) {
+  Eigen::VectorXf expected_bits(8 * kDescriptorSizeBytes);
+  Eigen::VectorXf unpacked_bits(8 * kDescriptorSizeBytes);
+  for (int i = 0; i < kNumDescriptors; ++i) {
+    DescriptorToEigenMatrix(raw_descriptors_.col(i), expected_bits);
+    UnpackDescriptorBits(
+        raw_descriptors_.col(i).data(), kDescriptorSizeBytes,
+        unpacked_bits.data());
+    EXPECT_TRUE(expected_bits == unpacked_bits);
+  }
+}
+
+TEST_F(BatchedProjectionTest, BatchesMatchPerDescriptorProjection) {
+  // A projection matrix that uses fewer bits than the descriptor has, like
+  // the FREAK projection matrix.
+  for (const int num_projected_bits : {8 * kDescriptorSizeBytes, 471}) {
+    const Eigen::MatrixXf projection_matrix =
+        Eigen::MatrixXf::Random(kTargetDimensions, num_projected_bits);
+    Eigen::MatrixXf expected_projected_descriptors;
+    projectDescriptorsOneByOne(
+        projection_matrix, &expected_projected_descriptors);
+
+    // Batch sizes that divide the descriptors evenly, leave a partial batch
+    // and hold all descriptors.
+    for (const int batch_size : {1, 10, 33, 1000}) {
+      Eigen::MatrixXf projected_descriptors(kTargetDimensions, kNumDescriptors);
+      {
+        BatchedDescriptorProjector projector(
+            projection_matrix, kTargetDimensions, batch_size,
+            &projected_descriptors);
+        // Fill the columns in reverse to check the column mapping.
+        for (int i = kNumDescriptors - 1; i >= 0; --i) {
+          projector.addDescriptor(
+              raw_descriptors_.col(i).data(), kDescriptorSizeBytes, i);
+        }
+      }
+      EXPECT_NEAR_EIGEN(
+          expected_projected_descriptors, projected_descriptors, 1e-4);
+    }
+  }
+}
+
+TEST_F(BatchedProjectionTest, ProjectDescriptorBlockMatchesPerDescriptor) {
+  const Eigen::MatrixXf projection_matrix =
+      Eigen::MatrixXf::Random(kTargetDimensions, 8 * kDescriptorSizeBytes);
+  Eigen::MatrixXf expected_projected_descriptors;
+  projectDescriptorsOneByOne(
+      projection_matrix, &expected_projected_descriptors);
+
+  Eigen::MatrixXf projected_descriptors;
+  ProjectDescriptorBlock(
+      raw_descriptors_, projection_matrix, kTargetDimensions,
+      &projected_descriptors);
+  EXPECT_NEAR_EIGEN(
+      expected_projected_descriptors, projected_descriptors, 1e-4);
+}
+
+}  // namespace descriptor_projection
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -15,6 +15,7 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <loopclosure-common/flags.h>
+#include <maplab-common/memory-accounting.h>
 #include <nabo/nabo.h>
 
 namespace loop_closure {
@@ -38,6 +39,11 @@ struct InvertedFile {
   Aligned<std::vector, Descriptor> descriptors_;
   // Each stored descriptor has a corresponding index.
   std::vector<int> indices_;
+
+  inline size_t GetMemoryUsageBytes() const {
+    return ::common::getHeapBytes(descriptors_) +
+           ::common::getHeapBytes(indices_);
+  }
 };
 
 typedef Nabo::NearestNeighbourSearch<float> NNSearch;
@@ -188,6 +194,59 @@ inline void FindClosestWords(
       closest_words);
 }
 
+// Computes the squared Euclidean distances of all queries to all words of a
+// lower dimensional vocabulary as a single matrix product. Entry (i, j) of
+// squared_distances is the distance of word i to query j. The squared norms
+// of the words are passed such that they are only computed once.
+template <typename DerivedQueries>
+inline void ComputeSquaredDistancesToWords(
+    const Eigen::MatrixBase<DerivedQueries>& queries,
+    const Eigen::MatrixXf& words, const Eigen::VectorXf& words_squared_norms,
+    Eigen::MatrixXf* squared_distances) {
+  CHECK_NOTNULL(squared_distances);
+  CHECK_EQ(queries.rows(), words.rows());
+  CHECK_EQ(words_squared_norms.rows(), words.cols());
+  squared_distances->noalias() = -2.0f * words.transpose() * queries;
+  squared_distances->colwise() += words_squared_norms;
+  squared_distances->rowwise() += queries.colwise().squaredNorm();
+  // Rounding can make the distances of words very close to the query
+  // negative.
+  *squared_distances = squared_distances->cwiseMax(0.0f);
+}
+
+// Gets the num_closest_words words with the smallest squared distances to a
+// query, sorted in ascending order of distance. As for the kd-tree search,
+// words farther than max_radius are skipped. indices and distances are resized
+// to the number of words found.
+// This function is thread-safe.
+template <typename DerivedDistances>
+inline void GetClosestWordsFromDistances(
+    const Eigen::MatrixBase<DerivedDistances>& squared_distances,
+    int num_closest_words, float max_radius, Eigen::VectorXi* indices,
+    Eigen::VectorXf* distances) {
+  CHECK_NOTNULL(indices);
+  CHECK_NOTNULL(distances);
+  CHECK_EQ(squared_distances.cols(), 1);
+  CHECK_GT(num_closest_words, 0);
+  const float max_squared_distance = max_radius * max_radius;
+  std::vector<std::pair<float, int> > words;
+  words.reserve(squared_distances.rows());
+  for (int word_idx = 0; word_idx < squared_distances.rows(); ++word_idx) {
+    if (squared_distances(word_idx, 0) <= max_squared_distance) {
+      words.emplace_back(squared_distances(word_idx, 0), word_idx);
+    }
+  }
+  const int num_words =
+      std::min(num_closest_words, static_cast<int>(words.size()));
+  std::partial_sort(words.begin(), words.begin() + num_words, words.end());
+  indices->resize(num_words);
+  distances->resize(num_words);
+  for (int i = 0; i < num_words; ++i) {
+    (*distances)(i) = words[i].first;
+    (*indices)(i) = words[i].second;
+  }
+}
+
 // Adds a database descriptor to the inverted multi-index by either adding it to
 // the vector of descriptors assigned to the same visual word or creating a new
 // visual word entry if no other descriptor had been assigned to this word.
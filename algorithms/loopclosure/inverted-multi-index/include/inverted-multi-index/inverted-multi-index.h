@@ -2,6 +2,8 @@
 #define INVERTED_MULTI_INDEX_INVERTED_MULTI_INDEX_H_
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <limits>
 #include <memory>
@@ -16,6 +18,7 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <maplab-common/eigen-proto.h>
+#include <maplab-common/memory-mapped-file.h>
 #include <nabo/nabo.h>
 
 #include "inverted-multi-index/inverted-multi-index-common.h"
@@ -42,6 +45,9 @@ class InvertedMultiIndex {
   typedef Eigen::Matrix<float, 2 * kDimSubVectors, Eigen::Dynamic>
       DescriptorMatrixType;
   typedef common::InvertedFile<float, 2 * kDimSubVectors> InvFile;
+  static_assert(
+      sizeof(DescriptorType) == 2 * kDimSubVectors * sizeof(float),
+      "The descriptors of an inverted file must be stored contiguously.");
 
   // Creates the index from a given set of visual words. Each column in words_i
   // specifies a cluster center coordinate.
@@ -50,6 +56,8 @@ class InvertedMultiIndex {
       int num_closest_words_for_nn_search)
       : words_1_(words_1),
         words_2_(words_2),
+        words_1_squared_norms_(words_1.colwise().squaredNorm().transpose()),
+        words_2_squared_norms_(words_2.colwise().squaredNorm().transpose()),
         words_1_index_(
             common::NNSearch::createKDTreeLinearHeap(
                 words_1_, kDimSubVectors, common::kCollectTouchStatistics)),
@@ -57,7 +65,11 @@ class InvertedMultiIndex {
             common::NNSearch::createKDTreeLinearHeap(
                 words_2_, kDimSubVectors, common::kCollectTouchStatistics)),
         num_closest_words_for_nn_search_(num_closest_words_for_nn_search),
-        max_db_descriptor_index_(0) {
+        max_db_descriptor_index_(0),
+        mapped_descriptors_(nullptr),
+        mapped_indices_(nullptr),
+        mapped_inverted_file_offsets_(nullptr),
+        num_mapped_inverted_files_(0) {
     CHECK_EQ(words_1.rows(), kDimSubVectors);
     CHECK_GT(words_1.cols(), 0);
     CHECK_EQ(words_2.rows(), kDimSubVectors);
@@ -74,9 +86,23 @@ class InvertedMultiIndex {
     return max_db_descriptor_index_;
   }
 
+  // Memory of the vocabularies and the inverted files, the kd-trees over the
+  // words and mapped inverted files are not included.
+  inline size_t GetMemoryUsageBytes() const {
+    size_t num_bytes = ::common::getHeapBytes(words_1_) +
+                       ::common::getHeapBytes(words_2_) +
+                       ::common::getHeapBytes(word_index_map_) +
+                       ::common::getHeapBytes(inverted_files_);
+    for (const InvFile& inverted_file : inverted_files_) {
+      num_bytes += inverted_file.GetMemoryUsageBytes();
+    }
+    return num_bytes;
+  }
+
   // Clears the inverted multi-index by removing all references to the database
   // descriptors stored in it. Does NOT remove the underlying quantization.
   inline void Clear() {
+    ReleaseMappedInvertedFiles();
     inverted_files_.clear();
     word_index_map_.clear();
     max_db_descriptor_index_ = 0;
@@ -85,6 +111,7 @@ class InvertedMultiIndex {
   // Adds a set of database descriptors to the inverted multi-index.
   // Each column defines a database descriptor.
   void AddDescriptors(const DescriptorMatrixType& descriptors) {
+    CopyMappedInvertedFiles();
     const int num_descriptors = descriptors.cols();
     std::vector<std::pair<int, int> > closest_word;
 
@@ -149,13 +176,20 @@ class InvertedMultiIndex {
       if (word_index_map_it == word_index_map_.end())
         continue;
 
-      const InvFile& inverted_file = inverted_files_[word_index_map_it->second];
-      const size_t num_descriptors = inverted_file.descriptors_.size();
+      const float* descriptors;
+      const int* descriptor_indices;
+      size_t num_descriptors;
+      GetInvertedFile(
+          word_index_map_it->second, &descriptors, &descriptor_indices,
+          &num_descriptors);
       for (size_t j = 0; j < num_descriptors; ++j) {
         const float distance =
-            (inverted_file.descriptors_[j] - query_feature).squaredNorm();
+            (Eigen::Map<const DescriptorType>(
+                 descriptors + j * 2 * kDimSubVectors) -
+             query_feature)
+                .squaredNorm();
         common::InsertNeighbor(
-            inverted_file.indices_[j], distance, num_neighbors,
+            descriptor_indices[j], distance, num_neighbors,
             &nearest_neighbors);
       }
     }
@@ -170,37 +204,163 @@ class InvertedMultiIndex {
     }
   }
 
+  // Finds the n nearest neighbors for each column of query_features, e.g. for
+  // all projected descriptors of an image, and stores them in the
+  // corresponding columns of the outputs. Unlike GetNNearestNeighbors, the
+  // closest words are found exactly, from the distances to all words which
+  // are computed for a block of queries as a single matrix product. The
+  // inverted files are then traversed in order, each once for all queries of
+  // the block that use it.
+  // This function is thread-safe.
+  template <typename DerivedQuery, typename DerivedIndices,
+            typename DerivedDistances>
+  inline void GetNNearestNeighborsForFeatures(
+      const Eigen::MatrixBase<DerivedQuery>& query_features, int num_neighbors,
+      const Eigen::MatrixBase<DerivedIndices>& out_indices,
+      const Eigen::MatrixBase<DerivedDistances>& out_distances) const {
+    CHECK_EQ(query_features.rows(), 2 * kDimSubVectors);
+    CHECK_GT(num_neighbors, 0);
+    const int num_queries = query_features.cols();
+    CHECK_EQ(out_indices.rows(), num_neighbors)
+        << "The indices parameter must be pre-allocated to hold all results.";
+    CHECK_EQ(out_distances.rows(), num_neighbors)
+        << "The distances parameter must be pre-allocated to hold all results.";
+    CHECK_EQ(out_indices.cols(), num_queries)
+        << "The indices parameter must be pre-allocated to hold all results.";
+    CHECK_EQ(out_distances.cols(), num_queries)
+        << "The distances parameter must be pre-allocated to hold all results.";
+
+    Eigen::MatrixBase<DerivedIndices>& indices =
+        const_cast<Eigen::MatrixBase<DerivedIndices>&>(out_indices);
+    Eigen::MatrixBase<DerivedDistances>& distances =
+        const_cast<Eigen::MatrixBase<DerivedDistances>&>(out_distances);
+
+    // Bounds the memory of the distances to the words.
+    constexpr int kNumQueriesPerBlock = 64;
+    const int num_words_2 = words_2_.cols();
+    Eigen::MatrixXf queries;
+    Eigen::MatrixXf word_distances_1;
+    Eigen::MatrixXf word_distances_2;
+    Eigen::VectorXi closest_indices_1;
+    Eigen::VectorXf closest_distances_1;
+    Eigen::VectorXi closest_indices_2;
+    Eigen::VectorXf closest_distances_2;
+    std::vector<std::pair<int, int> > closest_words;
+    // Pairs of inverted file index and query index in the block.
+    std::vector<std::pair<int, int> > inverted_file_queries;
+    std::vector<std::vector<std::pair<float, int> > > nearest_neighbors(
+        kNumQueriesPerBlock);
+
+    for (int block_start = 0; block_start < num_queries;
+         block_start += kNumQueriesPerBlock) {
+      const int num_block_queries =
+          std::min(kNumQueriesPerBlock, num_queries - block_start);
+      queries = query_features.middleCols(block_start, num_block_queries);
+      common::ComputeSquaredDistancesToWords(
+          queries.topRows(kDimSubVectors), words_1_, words_1_squared_norms_,
+          &word_distances_1);
+      common::ComputeSquaredDistancesToWords(
+          queries.bottomRows(kDimSubVectors), words_2_, words_2_squared_norms_,
+          &word_distances_2);
+
+      inverted_file_queries.clear();
+      for (int query_idx = 0; query_idx < num_block_queries; ++query_idx) {
+        common::GetClosestWordsFromDistances(
+            word_distances_1.col(query_idx), num_closest_words_for_nn_search_,
+            FLAGS_lc_knn_max_radius, &closest_indices_1,
+            &closest_distances_1);
+        common::GetClosestWordsFromDistances(
+            word_distances_2.col(query_idx), num_closest_words_for_nn_search_,
+            FLAGS_lc_knn_max_radius, &closest_indices_2,
+            &closest_distances_2);
+        closest_words.clear();
+        if (closest_indices_1.rows() > 0 && closest_indices_2.rows() > 0) {
+          common::MultiSequenceAlgorithm(
+              closest_indices_1, closest_distances_1, closest_indices_2,
+              closest_distances_2, num_closest_words_for_nn_search_,
+              &closest_words);
+        }
+        for (const std::pair<int, int>& closest_word : closest_words) {
+          const std::unordered_map<int, int>::const_iterator
+              word_index_map_it = word_index_map_.find(
+                  closest_word.first * num_words_2 + closest_word.second);
+          if (word_index_map_it != word_index_map_.end()) {
+            inverted_file_queries.emplace_back(
+                word_index_map_it->second, query_idx);
+          }
+        }
+        nearest_neighbors[query_idx].clear();
+        nearest_neighbors[query_idx].reserve(num_neighbors + 1);
+      }
+      std::sort(inverted_file_queries.begin(), inverted_file_queries.end());
+
+      // Every query uses an inverted file at most once and the kept neighbors
+      // don't depend on the order of insertion, so the order of the traversal
+      // doesn't change the results.
+      for (const std::pair<int, int>& inverted_file_query :
+           inverted_file_queries) {
+        const float* descriptors;
+        const int* descriptor_indices;
+        size_t num_descriptors;
+        GetInvertedFile(
+            inverted_file_query.first, &descriptors, &descriptor_indices,
+            &num_descriptors);
+        const int query_idx = inverted_file_query.second;
+        const DescriptorType query = queries.col(query_idx);
+        for (size_t j = 0; j < num_descriptors; ++j) {
+          const float distance = (Eigen::Map<const DescriptorType>(
+                                      descriptors + j * 2 * kDimSubVectors) -
+                                  query)
+                                     .squaredNorm();
+          common::InsertNeighbor(
+              descriptor_indices[j], distance, num_neighbors,
+              &nearest_neighbors[query_idx]);
+        }
+      }
+
+      for (int query_idx = 0; query_idx < num_block_queries; ++query_idx) {
+        const std::vector<std::pair<float, int> >& query_nearest_neighbors =
+            nearest_neighbors[query_idx];
+        const int col = block_start + query_idx;
+        for (size_t i = 0; i < query_nearest_neighbors.size(); ++i) {
+          indices(i, col) = query_nearest_neighbors[i].second;
+          distances(i, col) = query_nearest_neighbors[i].first;
+        }
+        for (int i = query_nearest_neighbors.size(); i < num_neighbors; ++i) {
+          indices(i, col) = -1;
+          distances(i, col) = std::numeric_limits<float>::infinity();
+        }
+      }
+    }
+  }
+
   inline void serialize(
       proto::InvertedMultiIndex* proto_inverted_multi_index) const {
     CHECK_NOTNULL(proto_inverted_multi_index);
 
-    for (const InvFile& inverted_file : inverted_files_) {
+    const int num_inverted_files = GetNumInvertedFiles();
+    for (int inverted_file_idx = 0; inverted_file_idx < num_inverted_files;
+         ++inverted_file_idx) {
       proto::InvertedFile* proto_inverted_file =
           CHECK_NOTNULL(proto_inverted_multi_index->add_inverted_files());
 
-      const size_t num_descriptors = inverted_file.descriptors_.size();
+      const float* descriptor_data;
+      const int* descriptor_indices;
+      size_t num_descriptors;
+      GetInvertedFile(
+          inverted_file_idx, &descriptor_data, &descriptor_indices,
+          &num_descriptors);
       CHECK_GT(num_descriptors, 0u);
 
-      const size_t projected_descriptor_dimensions =
-          static_cast<size_t>(inverted_file.descriptors_[0].rows());
-
-      Eigen::MatrixXf descriptors =
-          Eigen::MatrixXf(projected_descriptor_dimensions, num_descriptors);
-
-      for (size_t descriptor_idx = 0u; descriptor_idx < num_descriptors;
-           ++descriptor_idx) {
-        descriptors.col(descriptor_idx) =
-            inverted_file.descriptors_[descriptor_idx];
-      }
+      const Eigen::MatrixXf descriptors =
+          Eigen::Map<const DescriptorMatrixType>(
+              descriptor_data, 2 * kDimSubVectors, num_descriptors);
 
       ::common::eigen_proto::serialize(
           descriptors, proto_inverted_file->mutable_descriptors());
 
-      const size_t num_indices = inverted_file.indices_.size();
-      CHECK_EQ(num_descriptors, num_indices);
-
-      for (const int index : inverted_file.indices_) {
-        proto_inverted_file->add_indices(index);
+      for (size_t idx = 0u; idx < num_descriptors; ++idx) {
+        proto_inverted_file->add_indices(descriptor_indices[idx]);
       }
     }
 
@@ -220,6 +380,7 @@ class InvertedMultiIndex {
 
   inline void deserialize(
       const proto::InvertedMultiIndex proto_inverted_multi_index) {
+    ReleaseMappedInvertedFiles();
     inverted_files_.clear();
 
     for (const ::loop_closure::proto::InvertedFile& proto_inverted_file :
@@ -262,11 +423,84 @@ class InvertedMultiIndex {
     }
   }
 
+  // Returns the number of inverted files, i.e. the number of visual words with
+  // at least one database descriptor.
+  inline int GetNumInvertedFiles() const {
+    return mapped_file_ != nullptr ? num_mapped_inverted_files_
+                                   : static_cast<int>(inverted_files_.size());
+  }
+
+  // Returns the descriptors of an inverted file, stored contiguously with
+  // 2 * kDimSubVectors floats each, and their indices. They point either into
+  // inverted_files_ or into the mapped file and are valid until the index is
+  // modified.
+  inline void GetInvertedFile(
+      int inverted_file_index, const float** descriptors, const int** indices,
+      size_t* num_descriptors) const {
+    CHECK_NOTNULL(descriptors);
+    CHECK_NOTNULL(indices);
+    CHECK_NOTNULL(num_descriptors);
+    CHECK_GE(inverted_file_index, 0);
+    CHECK_LT(inverted_file_index, GetNumInvertedFiles());
+    if (mapped_file_ != nullptr) {
+      const uint64_t begin = mapped_inverted_file_offsets_[inverted_file_index];
+      const uint64_t end =
+          mapped_inverted_file_offsets_[inverted_file_index + 1];
+      *descriptors = mapped_descriptors_ + begin * 2 * kDimSubVectors;
+      *indices = mapped_indices_ + begin;
+      *num_descriptors = static_cast<size_t>(end - begin);
+      return;
+    }
+    const InvFile& inverted_file = inverted_files_[inverted_file_index];
+    *descriptors = inverted_file.descriptors_.empty()
+                       ? nullptr
+                       : inverted_file.descriptors_.front().data();
+    *indices = inverted_file.indices_.data();
+    *num_descriptors = inverted_file.descriptors_.size();
+  }
+
  protected:
+  // Copies the inverted files out of the mapped file, so that descriptors can
+  // be added. Does nothing if the index isn't mapped.
+  inline void CopyMappedInvertedFiles() {
+    if (mapped_file_ == nullptr) {
+      return;
+    }
+    CHECK(inverted_files_.empty());
+    inverted_files_.resize(num_mapped_inverted_files_);
+    for (int inverted_file_idx = 0;
+         inverted_file_idx < num_mapped_inverted_files_; ++inverted_file_idx) {
+      const float* descriptors;
+      const int* indices;
+      size_t num_descriptors;
+      GetInvertedFile(
+          inverted_file_idx, &descriptors, &indices, &num_descriptors);
+      InvFile& inverted_file = inverted_files_[inverted_file_idx];
+      inverted_file.descriptors_.resize(num_descriptors);
+      memcpy(
+          inverted_file.descriptors_.front().data(), descriptors,
+          num_descriptors * sizeof(DescriptorType));
+      inverted_file.indices_.assign(indices, indices + num_descriptors);
+    }
+    ReleaseMappedInvertedFiles();
+  }
+
+  inline void ReleaseMappedInvertedFiles() {
+    mapped_file_.reset();
+    mapped_descriptors_ = nullptr;
+    mapped_indices_ = nullptr;
+    mapped_inverted_file_offsets_ = nullptr;
+    num_mapped_inverted_files_ = 0;
+  }
+
   // The two sets of cluster centers defining the quantization of the descriptor
   // space as the Cartesian product of the two sets of words.
   Eigen::MatrixXf words_1_;
   Eigen::MatrixXf words_2_;
+  // The squared norms of the words, used to compute the distances to the
+  // words of many queries at once.
+  Eigen::VectorXf words_1_squared_norms_;
+  Eigen::VectorXf words_2_squared_norms_;
   std::shared_ptr<common::NNSearch> words_1_index_;
   std::shared_ptr<common::NNSearch> words_2_index_;
 
@@ -284,6 +518,18 @@ class InvertedMultiIndex {
   Aligned<std::vector, InvFile> inverted_files_;
   // The maximum index of the descriptor indices.
   int max_db_descriptor_index_;
+
+  // Instead of inverted_files_, the inverted files can be read directly from
+  // a memory-mapped loop detector file, see
+  // MatchingBasedLoopDetectorSerializer. Their descriptors and indices are
+  // stored back to back, and the descriptors of inverted file i are in the
+  // range [offsets[i], offsets[i + 1]). The file is kept open while these
+  // pointers are used.
+  std::shared_ptr<const ::common::MemoryMappedFile> mapped_file_;
+  const float* mapped_descriptors_;
+  const int* mapped_indices_;
+  const uint64_t* mapped_inverted_file_offsets_;
+  int num_mapped_inverted_files_;
 };
 }  // namespace inverted_multi_index
 }  // namespace loop_closure
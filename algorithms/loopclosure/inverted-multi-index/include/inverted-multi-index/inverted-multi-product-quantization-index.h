@@ -2,8 +2,10 @@
 #define INVERTED_MULTI_INDEX_INVERTED_MULTI_PRODUCT_QUANTIZATION_INDEX_H_
 
 #include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <limits>
+#include <memory>
 #include <queue>
 #include <tuple>
 #include <unordered_map>
@@ -18,6 +20,7 @@
 #include <product-quantization/product-quantization.h>
 
 #include <inverted-multi-index/inverted-multi-index-common.h>
+#include <inverted-multi-index/packed-codes.h>
 
 DECLARE_double(lc_knn_max_radius);
 
@@ -35,6 +38,15 @@ namespace inverted_multi_index {
 // explanation of the parameters). The inverted multi-index splits descriptors
 // into two parts of dimension kNumComponents / 2 * kNumDimPerComp each. Thus,
 // kNumComponents needs to be a multiple of 2.
+// The codes of the descriptors in each inverted file are stored with one byte
+// per component. For quantizers with at most 16 centers, they are packed with
+// 4 bits per component into blocks of 32 descriptors instead (see
+// packed-codes.h). The search then first computes lower bounds of the
+// distances with SIMD look-ups into a quantized table and only evaluates the
+// exact product quantization distance for descriptors whose bound is smaller
+// than the current n-th nearest neighbor, which gives the same results as
+// evaluating all distances. Optionally, the original descriptors are kept to
+// re-rank the closest product quantization candidates with exact distances.
 template <typename DataType, int kNumComponents, int kNumDimPerComp,
           int kNumCenters>
 class InvertedMultiProductQuantizationIndex {
@@ -51,7 +63,25 @@ class InvertedMultiProductQuantizationIndex {
   // The type of the quantized descriptors that is stored.
   typedef Eigen::Matrix<DataType, kNumComponents, 1> StoredDescriptorType;
 
-  typedef common::InvertedFile<DataType, kNumComponents> InvFile;
+  // Codes with at most 16 centers are packed with 4 bits per component.
+  static constexpr bool kUsePackedCodes =
+      kNumCenters <= kMaxNumCentersForPackedCodes;
+
+  // An inverted file storing the codes of its descriptors as bytes, either
+  // packed into blocks or with one byte per component and descriptor.
+  struct InvFile {
+    inline int GetNumDescriptors() const {
+      return static_cast<int>(indices_.size());
+    }
+
+    inline size_t GetMemoryUsageBytes() const {
+      return ::common::getHeapBytes(codes_) +
+             ::common::getHeapBytes(indices_);
+    }
+
+    std::vector<uint8_t> codes_;
+    std::vector<int> indices_;
+  };
   typedef product_quantization::ProductQuantization<
       kHalfNumComponents, kNumDimPerComp, kNumCenters, DataType>
       ProductQuantizer;
@@ -81,10 +111,13 @@ class InvertedMultiProductQuantizationIndex {
                 words_2_, kOriginalDescDim / 2,
                 common::kCollectTouchStatistics)),
         num_closest_words_for_nn_search_(num_closest_words_for_nn_search),
+        exact_re_ranking_factor_(0),
         max_db_descriptor_index_(0) {
     static_assert(
         kNumComponents % 2 == 0,
         "The number of components needs to be a multiple of 2.");
+    static_assert(
+        kNumCenters <= 256, "The codes need to be representable as bytes.");
 
     CHECK_EQ(words_1.rows(), kOriginalDescDim / 2);
     CHECK_GT(words_1.cols(), 0);
@@ -101,7 +134,7 @@ class InvertedMultiProductQuantizationIndex {
     CHECK_EQ(quantizer_centers_1.rows(), kNumDimPerComp);
     CHECK_EQ(quantizer_centers_2.rows(), kNumDimPerComp);
     CHECK_EQ(quantizer_centers_1.cols(), num_cols_per_pq * words_1.cols());
-    CHECK_EQ(quantizer_centers_1.cols(), num_cols_per_pq * words_1.cols());
+    CHECK_EQ(quantizer_centers_2.cols(), num_cols_per_pq * words_2.cols());
 
     CHECK_GT(num_closest_words_for_nn_search_, 0);
 
@@ -114,7 +147,7 @@ class InvertedMultiProductQuantizationIndex {
 
     quantizers_words_2_.resize(words_2.cols());
     index = 0;
-    for (int i = 0; i < words_1.cols(); ++i, index += num_cols_per_pq) {
+    for (int i = 0; i < words_2.cols(); ++i, index += num_cols_per_pq) {
       quantizers_words_2_[i].SetClusterCenters(
           quantizer_centers_2.block<kNumDimPerComp, num_cols_per_pq>(0, index));
     }
@@ -125,15 +158,45 @@ class InvertedMultiProductQuantizationIndex {
     num_closest_words_for_nn_search_ = num_closest_words_for_nn_search;
   }
 
+  // If the factor is positive, the original descriptors are stored alongside
+  // their codes and the closest factor * n product quantization candidates
+  // of a search are re-ranked with their exact distances. Can only be changed
+  // while the index is empty.
+  void SetExactReRankingFactor(int exact_re_ranking_factor) {
+    CHECK_GE(exact_re_ranking_factor, 0);
+    CHECK_EQ(max_db_descriptor_index_, 0)
+        << "Exact re-ranking can only be changed for an empty index.";
+    exact_re_ranking_factor_ = exact_re_ranking_factor;
+  }
+
+  inline int GetExactReRankingFactor() const {
+    return exact_re_ranking_factor_;
+  }
+
   inline int GetNumDescriptorsInIndex() const {
     return max_db_descriptor_index_;
   }
 
+  // Memory of the vocabularies and the inverted files, the kd-trees over the
+  // words are not included.
+  inline size_t GetMemoryUsageBytes() const {
+    size_t num_bytes = ::common::getHeapBytes(words_1_) +
+                       ::common::getHeapBytes(words_2_) +
+                       ::common::getHeapBytes(word_index_map_) +
+                       ::common::getHeapBytes(inverted_files_) +
+                       ::common::getHeapBytes(exact_descriptors_);
+    for (const InvFile& inverted_file : inverted_files_) {
+      num_bytes += inverted_file.GetMemoryUsageBytes();
+    }
+    return num_bytes;
+  }
+
   // Clears the inverted multi-index by removing all references to the database
   // descriptors stored in it. Does NOT remove the underlying quantization.
   inline void Clear() {
     inverted_files_.clear();
     word_index_map_.clear();
+    exact_descriptors_.clear();
     max_db_descriptor_index_ = 0;
   }
 
@@ -173,9 +236,10 @@ class InvertedMultiProductQuantizationIndex {
           residual_part_2, &quantized_part);
       quantized_residual.template tail<kHalfNumComponents>() = quantized_part;
 
-      common::AddDescriptor<DataType, kNumComponents>(
-          quantized_residual, max_db_descriptor_index_, word_index,
-          &word_index_map_, &inverted_files_);
+      AddCodes(quantized_residual, max_db_descriptor_index_, word_index);
+      if (exact_re_ranking_factor_ > 0) {
+        exact_descriptors_.emplace_back(descriptors.col(i));
+      }
       ++max_db_descriptor_index_;
     }
   }
@@ -216,6 +280,14 @@ class InvertedMultiProductQuantizationIndex {
     // closest words, using product quantization to compute the distances.
     std::vector<std::pair<float, int> > nearest_neighbors;
     nearest_neighbors.reserve(num_neighbors + 1);
+    // With exact re-ranking, more candidates are retrieved using product
+    // quantization than neighbors are returned.
+    const int num_candidates = exact_re_ranking_factor_ > 0
+                                   ? exact_re_ranking_factor_ * num_neighbors
+                                   : num_neighbors;
+    std::vector<std::pair<float, int> > nearest_candidates;
+    nearest_candidates.reserve(num_candidates + 1);
+    std::vector<uint16_t> quantized_sums;
 
     const int num_words_to_use = static_cast<int>(closest_words.size());
     std::unordered_map<int, int>::const_iterator word_index_map_it;
@@ -265,22 +337,28 @@ class InvertedMultiProductQuantizationIndex {
       }
       const LookUpTable& lut2 = table_it->second;
 
+      // The look-up table of the combined descriptor, holding the entries of
+      // each component consecutively.
+      CombinedLookUpTable lut;
+      lut.template leftCols<kHalfNumComponents>() = lut1.transpose();
+      lut.template rightCols<kHalfNumComponents>() = lut2.transpose();
+
       const InvFile& inverted_file = inverted_files_[word_index_map_it->second];
-      const int num_descriptors =
-          static_cast<int>(inverted_file.descriptors_.size());
-      for (int j = 0; j < num_descriptors; ++j) {
-        // Computes the distance between the query and the quantized descriptors
-        // using the look-up tables.
-        float distance = quantizers_words_1_[word1].ComputeDistance(
-            lut1,
-            inverted_file.descriptors_[j].template head<kHalfNumComponents>());
-        distance += quantizers_words_2_[word2].ComputeDistance(
-            lut2,
-            inverted_file.descriptors_[j].template tail<kHalfNumComponents>());
+      ScanInvertedFile(
+          inverted_file, lut, num_candidates, &quantized_sums,
+          &nearest_candidates);
+    }
+
+    if (exact_re_ranking_factor_ > 0) {
+      for (const std::pair<float, int>& candidate : nearest_candidates) {
+        const float distance =
+            (exact_descriptors_[candidate.second] - query_feature)
+                .squaredNorm();
         common::InsertNeighbor(
-            inverted_file.indices_[j], distance, num_neighbors,
-            &nearest_neighbors);
+            candidate.second, distance, num_neighbors, &nearest_neighbors);
       }
+    } else {
+      nearest_neighbors.swap(nearest_candidates);
     }
 
     for (size_t i = 0; i < nearest_neighbors.size(); ++i) {
@@ -294,6 +372,126 @@ class InvertedMultiProductQuantizationIndex {
   }
 
  protected:
+  typedef Eigen::Matrix<float, kNumCenters, kNumComponents> CombinedLookUpTable;
+
+  // Returns the codes of the j-th descriptor of an inverted file.
+  inline void GetStoredDescriptor(
+      const InvFile& inverted_file, int j,
+      StoredDescriptorType* stored_descriptor) const {
+    for (int component = 0; component < kNumComponents; ++component) {
+      const uint8_t code =
+          kUsePackedCodes
+              ? GetPackedCode(
+                    inverted_file.codes_.data(), j, component, kNumComponents)
+              : inverted_file.codes_[j * kNumComponents + component];
+      (*stored_descriptor)[component] = static_cast<DataType>(code);
+    }
+  }
+
+  // Adds the codes of a database descriptor to the inverted file of its word.
+  void AddCodes(
+      const StoredDescriptorType& quantized_descriptor, int descriptor_index,
+      int word_index) {
+    std::unordered_map<int, int>::const_iterator word_index_map_it =
+        word_index_map_.find(word_index);
+    int inverted_file_index;
+    if (word_index_map_it == word_index_map_.end()) {
+      inverted_file_index = static_cast<int>(inverted_files_.size());
+      word_index_map_.emplace(word_index, inverted_file_index);
+      inverted_files_.emplace_back();
+    } else {
+      inverted_file_index = word_index_map_it->second;
+    }
+    InvFile& inverted_file = inverted_files_[inverted_file_index];
+
+    const int j = inverted_file.GetNumDescriptors();
+    if (kUsePackedCodes) {
+      if (j % kPackedCodeBlockSize == 0) {
+        inverted_file.codes_.resize(
+            inverted_file.codes_.size() +
+                GetNumBytesPerPackedCodeBlock(kNumComponents),
+            0u);
+      }
+      for (int component = 0; component < kNumComponents; ++component) {
+        SetPackedCode(
+            j, component, kNumComponents,
+            static_cast<uint8_t>(quantized_descriptor[component]),
+            inverted_file.codes_.data());
+      }
+    } else {
+      for (int component = 0; component < kNumComponents; ++component) {
+        inverted_file.codes_.push_back(
+            static_cast<uint8_t>(quantized_descriptor[component]));
+      }
+    }
+    inverted_file.indices_.push_back(descriptor_index);
+  }
+
+  // Adds the descriptors of an inverted file that are amongst the
+  // num_candidates closest ones to the query to nearest_candidates.
+  // quantized_sums is used as scratch memory for the packed code scan.
+  void ScanInvertedFile(
+      const InvFile& inverted_file, const CombinedLookUpTable& lut,
+      int num_candidates, std::vector<uint16_t>* quantized_sums,
+      std::vector<std::pair<float, int> >* nearest_candidates) const {
+    const int num_descriptors = inverted_file.GetNumDescriptors();
+    if (!kUsePackedCodes) {
+      for (int j = 0; j < num_descriptors; ++j) {
+        const uint8_t* codes = &inverted_file.codes_[j * kNumComponents];
+        float distance = 0.0f;
+        for (int component = 0; component < kNumComponents; ++component) {
+          distance += lut(codes[component], component);
+        }
+        common::InsertNeighbor(
+            inverted_file.indices_[j], distance, num_candidates,
+            nearest_candidates);
+      }
+      return;
+    }
+
+    // The packed codes only index the first kNumCenters entries of each
+    // component, the padding entries are never looked up.
+    Eigen::Matrix<float, kMaxNumCentersForPackedCodes, kNumComponents>
+        padded_lut;
+    padded_lut.setZero();
+    for (int component = 0; component < kNumComponents; ++component) {
+      for (int center = 0; center < kNumCenters; ++center) {
+        padded_lut(center, component) = lut(center, component);
+      }
+    }
+    Eigen::Matrix<uint8_t, kMaxNumCentersForPackedCodes, kNumComponents>
+        quantized_lut;
+    float bias, scale;
+    QuantizeLookUpTable(
+        padded_lut.data(), kNumComponents, quantized_lut.data(), &bias,
+        &scale);
+
+    const size_t num_blocks = GetNumPackedCodeBlocks(num_descriptors);
+    quantized_sums->resize(num_blocks * kPackedCodeBlockSize);
+    ScanPackedCodes(
+        inverted_file.codes_.data(), num_blocks, kNumComponents,
+        quantized_lut.data(), quantized_sums->data());
+
+    const float inverse_scale = 1.0f / scale;
+    for (int j = 0; j < num_descriptors; ++j) {
+      if (static_cast<int>(nearest_candidates->size()) >= num_candidates &&
+          bias + (*quantized_sums)[j] * inverse_scale >
+              nearest_candidates->back().first) {
+        continue;
+      }
+      float distance = 0.0f;
+      for (int component = 0; component < kNumComponents; ++component) {
+        distance += lut(
+            GetPackedCode(
+                inverted_file.codes_.data(), j, component, kNumComponents),
+            component);
+      }
+      common::InsertNeighbor(
+          inverted_file.indices_[j], distance, num_candidates,
+          nearest_candidates);
+    }
+  }
+
   // Given a half of a original descriptor, a vocabulary, and the word from this
   // vocabulary that is closest to the half, computes between residual the
   // descriptor and the cluster center of the word.
@@ -328,9 +526,15 @@ class InvertedMultiProductQuantizationIndex {
   // been used previously without having to re-order large amounts of memory.
   std::unordered_map<int, int> word_index_map_;
   // Vector containing the inverted files, one for each visual word in the
-  // product vocabulary. Each inverted file holds all descriptors assigned to
-  // the corresponding word and their indices.
-  Aligned<std::vector, InvFile> inverted_files_;
+  // product vocabulary. Each inverted file holds the codes of all descriptors
+  // assigned to the corresponding word and their indices.
+  std::vector<InvFile> inverted_files_;
+  // The number of product quantization candidates per neighbor that are
+  // re-ranked with exact distances, 0 disables re-ranking.
+  int exact_re_ranking_factor_;
+  // The original descriptors, indexed by their descriptor index. Only stored
+  // if exact re-ranking is enabled.
+  Aligned<std::vector, InputDescriptorType> exact_descriptors_;
   // The maximum index of the descriptor indices.
   int max_db_descriptor_index_;
 };
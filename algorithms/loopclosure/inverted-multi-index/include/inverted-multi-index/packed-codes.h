@@ -0,0 +1,95 @@
+#ifndef INVERTED_MULTI_INDEX_PACKED_CODES_H_
+#define INVERTED_MULTI_INDEX_PACKED_CODES_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace loop_closure {
+namespace inverted_multi_index {
+// Product quantization codes with at most 16 centers per component are stored
+// with 4 bits per code. The codes of kPackedCodeBlockSize consecutive
+// descriptors of an inverted file form a block, in which the codes of every
+// component take kNumBytesPerPackedComponent bytes: byte i holds the code of
+// descriptor i in its lower and the code of descriptor i + 16 in its upper
+// half. This allows a SIMD register to look up the distances of 16 or 32
+// descriptors at once with a byte shuffle.
+static constexpr int kPackedCodeBlockSize = 32;
+static constexpr int kNumBytesPerPackedComponent = 16;
+static constexpr int kMaxNumCentersForPackedCodes = 16;
+
+inline size_t GetNumPackedCodeBlocks(size_t num_descriptors) {
+  return (num_descriptors + kPackedCodeBlockSize - 1) / kPackedCodeBlockSize;
+}
+
+inline size_t GetNumBytesPerPackedCodeBlock(int num_components) {
+  return static_cast<size_t>(num_components) * kNumBytesPerPackedComponent;
+}
+
+inline void SetPackedCode(
+    int descriptor, int component, int num_components, uint8_t code,
+    uint8_t* packed_codes) {
+  const int descriptor_in_block = descriptor % kPackedCodeBlockSize;
+  const int shift =
+      descriptor_in_block < kNumBytesPerPackedComponent ? 0 : 4;
+  uint8_t& byte =
+      packed_codes
+          [(descriptor / kPackedCodeBlockSize) *
+               GetNumBytesPerPackedCodeBlock(num_components) +
+           component * kNumBytesPerPackedComponent +
+           descriptor_in_block % kNumBytesPerPackedComponent];
+  byte = static_cast<uint8_t>(
+      (byte & ~(0x0f << shift)) | ((code & 0x0f) << shift));
+}
+
+inline uint8_t GetPackedCode(
+    const uint8_t* packed_codes, int descriptor, int component,
+    int num_components) {
+  const int descriptor_in_block = descriptor % kPackedCodeBlockSize;
+  const int shift =
+      descriptor_in_block < kNumBytesPerPackedComponent ? 0 : 4;
+  const uint8_t byte =
+      packed_codes
+          [(descriptor / kPackedCodeBlockSize) *
+               GetNumBytesPerPackedCodeBlock(num_components) +
+           component * kNumBytesPerPackedComponent +
+           descriptor_in_block % kNumBytesPerPackedComponent];
+  return (byte >> shift) & 0x0f;
+}
+
+// Quantizes a look-up table of squared distances, holding the 16 entries of
+// each component consecutively, to 8 bits per entry. The entries of each
+// component are shifted by their minimum and all components share one scale,
+// such that the quantized distance bias + sum / scale of a descriptor is a
+// lower bound of its distance computed with the original look-up table.
+void QuantizeLookUpTable(
+    const float* look_up_table, int num_components,
+    uint8_t* quantized_look_up_table, float* bias, float* scale);
+
+// Sums the quantized look-up table entries over all components for each
+// descriptor of the given blocks of packed codes. sums needs to hold
+// num_blocks * kPackedCodeBlockSize entries. At most 256 components are
+// supported such that the sums cannot overflow.
+void ScanPackedCodes(
+    const uint8_t* packed_codes, size_t num_blocks, int num_components,
+    const uint8_t* quantized_look_up_table, uint16_t* sums);
+
+// The scan kernels that are available. ScanPackedCodes uses the fastest
+// kernel the CPU supports, which is detected on first use.
+enum class PackedCodeScanKernel { kScalar, kSsse3, kAvx2, kNumKernels };
+
+typedef void (*PackedCodeScanFunction)(
+    const uint8_t* packed_codes, size_t num_blocks, int num_components,
+    const uint8_t* quantized_look_up_table, uint16_t* sums);
+
+const char* GetPackedCodeScanKernelName(PackedCodeScanKernel kernel);
+// Checks if the kernel is compiled in and supported by the CPU.
+bool IsPackedCodeScanKernelSupported(PackedCodeScanKernel kernel);
+// The kernel must be supported.
+PackedCodeScanFunction GetPackedCodeScanFunction(PackedCodeScanKernel kernel);
+// Overrides the detected kernel, e.g. for comparisons. The kernel must be
+// supported.
+void SelectPackedCodeScanKernel(PackedCodeScanKernel kernel);
+}  // namespace inverted_multi_index
+}  // namespace loop_closure
+
+#endif  // INVERTED_MULTI_INDEX_PACKED_CODES_H_
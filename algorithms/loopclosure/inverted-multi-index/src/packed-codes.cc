@@ -0,0 +1,330 @@
+#include "inverted-multi-index/packed-codes.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#endif  // __x86_64__
+
+#include <glog/logging.h>
+
+// The SIMD kernels are compiled for their target only, such that the library
+// still runs on CPUs without them.
+#if defined(__x86_64__) && (defined(__clang__) || __GNUC__ >= 5)
+#define INVERTED_MULTI_INDEX_PACKED_CODES_X86_KERNELS
+#endif
+
+namespace loop_closure {
+namespace inverted_multi_index {
+namespace {
+static constexpr int kMaxNumComponents = 256;
+static constexpr float kMaxQuantizedValue = 255.0f;
+// Shrinks the quantization scale slightly, such that rounding errors cannot
+// push a quantized entry above the original one.
+static constexpr float kQuantizationScaleSafetyFactor = 1.0f - 1e-4f;
+
+void ScalarScanPackedCodes(
+    const uint8_t* packed_codes, size_t num_blocks, int num_components,
+    const uint8_t* quantized_look_up_table, uint16_t* sums) {
+  const size_t num_bytes_per_block =
+      GetNumBytesPerPackedCodeBlock(num_components);
+  for (size_t block = 0u; block < num_blocks; ++block) {
+    const uint8_t* block_codes = packed_codes + block * num_bytes_per_block;
+    uint16_t* block_sums = sums + block * kPackedCodeBlockSize;
+    std::fill(block_sums, block_sums + kPackedCodeBlockSize, 0u);
+    for (int component = 0; component < num_components; ++component) {
+      const uint8_t* component_codes =
+          block_codes + component * kNumBytesPerPackedComponent;
+      const uint8_t* component_table =
+          quantized_look_up_table + component * kNumBytesPerPackedComponent;
+      for (int i = 0; i < kNumBytesPerPackedComponent; ++i) {
+        block_sums[i] += component_table[component_codes[i] & 0x0f];
+        block_sums[i + kNumBytesPerPackedComponent] +=
+            component_table[component_codes[i] >> 4];
+      }
+    }
+  }
+}
+
+#if defined(INVERTED_MULTI_INDEX_PACKED_CODES_X86_KERNELS)
+__attribute__((target("ssse3"))) void Ssse3ScanPackedCodes(
+    const uint8_t* packed_codes, size_t num_blocks, int num_components,
+    const uint8_t* quantized_look_up_table, uint16_t* sums) {
+  const size_t num_bytes_per_block =
+      GetNumBytesPerPackedCodeBlock(num_components);
+  const __m128i low_nibble_mask = _mm_set1_epi8(0x0f);
+  const __m128i zero = _mm_setzero_si128();
+  for (size_t block = 0u; block < num_blocks; ++block) {
+    const uint8_t* block_codes = packed_codes + block * num_bytes_per_block;
+    // Sums of the descriptors 0-7, 8-15, 16-23 and 24-31.
+    __m128i sums_0 = zero;
+    __m128i sums_1 = zero;
+    __m128i sums_2 = zero;
+    __m128i sums_3 = zero;
+    for (int component = 0; component < num_components; ++component) {
+      const __m128i codes = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(
+              block_codes + component * kNumBytesPerPackedComponent));
+      const __m128i table = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(
+              quantized_look_up_table +
+              component * kNumBytesPerPackedComponent));
+      const __m128i low_codes = _mm_and_si128(codes, low_nibble_mask);
+      const __m128i high_codes =
+          _mm_and_si128(_mm_srli_epi16(codes, 4), low_nibble_mask);
+      const __m128i low_distances = _mm_shuffle_epi8(table, low_codes);
+      const __m128i high_distances = _mm_shuffle_epi8(table, high_codes);
+      sums_0 = _mm_add_epi16(sums_0, _mm_unpacklo_epi8(low_distances, zero));
+      sums_1 = _mm_add_epi16(sums_1, _mm_unpackhi_epi8(low_distances, zero));
+      sums_2 = _mm_add_epi16(sums_2, _mm_unpacklo_epi8(high_distances, zero));
+      sums_3 = _mm_add_epi16(sums_3, _mm_unpackhi_epi8(high_distances, zero));
+    }
+    __m128i* block_sums =
+        reinterpret_cast<__m128i*>(sums + block * kPackedCodeBlockSize);
+    _mm_storeu_si128(block_sums, sums_0);
+    _mm_storeu_si128(block_sums + 1, sums_1);
+    _mm_storeu_si128(block_sums + 2, sums_2);
+    _mm_storeu_si128(block_sums + 3, sums_3);
+  }
+}
+
+// Looks up two components at once: the two 128 bit lanes of the shuffle hold
+// the codes and the table of consecutive components.
+__attribute__((target("avx2"))) void Avx2ScanPackedCodes(
+    const uint8_t* packed_codes, size_t num_blocks, int num_components,
+    const uint8_t* quantized_look_up_table, uint16_t* sums) {
+  const size_t num_bytes_per_block =
+      GetNumBytesPerPackedCodeBlock(num_components);
+  const int num_component_pairs = num_components / 2;
+  const __m256i low_nibble_mask = _mm256_set1_epi8(0x0f);
+  const __m256i zero = _mm256_setzero_si256();
+  for (size_t block = 0u; block < num_blocks; ++block) {
+    const uint8_t* block_codes = packed_codes + block * num_bytes_per_block;
+    __m256i sums_0 = zero;
+    __m256i sums_1 = zero;
+    __m256i sums_2 = zero;
+    __m256i sums_3 = zero;
+    for (int pair = 0; pair < num_component_pairs; ++pair) {
+      const int offset = 2 * pair * kNumBytesPerPackedComponent;
+      const __m256i codes = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(block_codes + offset));
+      const __m256i table = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(quantized_look_up_table + offset));
+      const __m256i low_codes = _mm256_and_si256(codes, low_nibble_mask);
+      const __m256i high_codes =
+          _mm256_and_si256(_mm256_srli_epi16(codes, 4), low_nibble_mask);
+      const __m256i low_distances = _mm256_shuffle_epi8(table, low_codes);
+      const __m256i high_distances = _mm256_shuffle_epi8(table, high_codes);
+      sums_0 =
+          _mm256_add_epi16(sums_0, _mm256_unpacklo_epi8(low_distances, zero));
+      sums_1 =
+          _mm256_add_epi16(sums_1, _mm256_unpackhi_epi8(low_distances, zero));
+      sums_2 =
+          _mm256_add_epi16(sums_2, _mm256_unpacklo_epi8(high_distances, zero));
+      sums_3 =
+          _mm256_add_epi16(sums_3, _mm256_unpackhi_epi8(high_distances, zero));
+    }
+    // Adds up the partial sums of the two lanes.
+    __m128i block_sums_0 = _mm_add_epi16(
+        _mm256_castsi256_si128(sums_0), _mm256_extracti128_si256(sums_0, 1));
+    __m128i block_sums_1 = _mm_add_epi16(
+        _mm256_castsi256_si128(sums_1), _mm256_extracti128_si256(sums_1, 1));
+    __m128i block_sums_2 = _mm_add_epi16(
+        _mm256_castsi256_si128(sums_2), _mm256_extracti128_si256(sums_2, 1));
+    __m128i block_sums_3 = _mm_add_epi16(
+        _mm256_castsi256_si128(sums_3), _mm256_extracti128_si256(sums_3, 1));
+    if (num_components % 2 != 0) {
+      const int offset = (num_components - 1) * kNumBytesPerPackedComponent;
+      const __m128i low_nibble_mask_128 = _mm_set1_epi8(0x0f);
+      const __m128i zero_128 = _mm_setzero_si128();
+      const __m128i codes = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(block_codes + offset));
+      const __m128i table = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(quantized_look_up_table + offset));
+      const __m128i low_distances = _mm_shuffle_epi8(
+          table, _mm_and_si128(codes, low_nibble_mask_128));
+      const __m128i high_distances = _mm_shuffle_epi8(
+          table,
+          _mm_and_si128(_mm_srli_epi16(codes, 4), low_nibble_mask_128));
+      block_sums_0 = _mm_add_epi16(
+          block_sums_0, _mm_unpacklo_epi8(low_distances, zero_128));
+      block_sums_1 = _mm_add_epi16(
+          block_sums_1, _mm_unpackhi_epi8(low_distances, zero_128));
+      block_sums_2 = _mm_add_epi16(
+          block_sums_2, _mm_unpacklo_epi8(high_distances, zero_128));
+      block_sums_3 = _mm_add_epi16(
+          block_sums_3, _mm_unpackhi_epi8(high_distances, zero_128));
+    }
+    __m128i* block_sums =
+        reinterpret_cast<__m128i*>(sums + block * kPackedCodeBlockSize);
+    _mm_storeu_si128(block_sums, block_sums_0);
+    _mm_storeu_si128(block_sums + 1, block_sums_1);
+    _mm_storeu_si128(block_sums + 2, block_sums_2);
+    _mm_storeu_si128(block_sums + 3, block_sums_3);
+  }
+}
+
+struct CpuFeatures {
+  CpuFeatures() : has_ssse3(false), has_avx2(false) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1u, &eax, &ebx, &ecx, &edx)) {
+      return;
+    }
+    has_ssse3 = (ecx & bit_SSSE3) != 0u;
+    const bool has_osxsave = (ecx & bit_OSXSAVE) != 0u;
+    if (!has_osxsave || __get_cpuid_max(0u, nullptr) < 7u) {
+      return;
+    }
+    // The OS has to save the vector registers on context switches.
+    unsigned int xcr0_low, xcr0_high;
+    __asm__("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+    const bool os_saves_avx = (xcr0_low & 0x6u) == 0x6u;
+
+    __cpuid_count(7u, 0u, eax, ebx, ecx, edx);
+    has_avx2 = os_saves_avx && (ebx & (1u << 5)) != 0u;
+  }
+
+  bool has_ssse3;
+  bool has_avx2;
+};
+
+const CpuFeatures& GetCpuFeatures() {
+  static const CpuFeatures cpu_features;
+  return cpu_features;
+}
+#endif  // INVERTED_MULTI_INDEX_PACKED_CODES_X86_KERNELS
+
+PackedCodeScanKernel DetectBestPackedCodeScanKernel() {
+  for (const PackedCodeScanKernel kernel :
+       {PackedCodeScanKernel::kAvx2, PackedCodeScanKernel::kSsse3}) {
+    if (IsPackedCodeScanKernelSupported(kernel)) {
+      return kernel;
+    }
+  }
+  return PackedCodeScanKernel::kScalar;
+}
+
+void DetectKernelAndScanPackedCodes(
+    const uint8_t* packed_codes, size_t num_blocks, int num_components,
+    const uint8_t* quantized_look_up_table, uint16_t* sums);
+
+std::atomic<PackedCodeScanFunction> selected_scan_function(
+    &DetectKernelAndScanPackedCodes);
+
+void DetectKernelAndScanPackedCodes(
+    const uint8_t* packed_codes, size_t num_blocks, int num_components,
+    const uint8_t* quantized_look_up_table, uint16_t* sums) {
+  const PackedCodeScanFunction function =
+      GetPackedCodeScanFunction(DetectBestPackedCodeScanKernel());
+  selected_scan_function.store(function, std::memory_order_relaxed);
+  function(
+      packed_codes, num_blocks, num_components, quantized_look_up_table, sums);
+}
+}  // namespace
+
+void QuantizeLookUpTable(
+    const float* look_up_table, int num_components,
+    uint8_t* quantized_look_up_table, float* bias, float* scale) {
+  CHECK_NOTNULL(look_up_table);
+  CHECK_NOTNULL(quantized_look_up_table);
+  CHECK_NOTNULL(bias);
+  CHECK_NOTNULL(scale);
+  CHECK_GT(num_components, 0);
+  CHECK_LE(num_components, kMaxNumComponents);
+
+  *bias = 0.0f;
+  float max_range = 0.0f;
+  for (int component = 0; component < num_components; ++component) {
+    const float* component_table =
+        look_up_table + component * kNumBytesPerPackedComponent;
+    const std::pair<const float*, const float*> min_max =
+        std::minmax_element(
+            component_table, component_table + kNumBytesPerPackedComponent);
+    *bias += *min_max.first;
+    max_range = std::max(max_range, *min_max.second - *min_max.first);
+  }
+  *scale = max_range > 0.0f ? kMaxQuantizedValue / max_range : 1.0f;
+
+  const float quantization_scale = *scale * kQuantizationScaleSafetyFactor;
+  for (int component = 0; component < num_components; ++component) {
+    const float* component_table =
+        look_up_table + component * kNumBytesPerPackedComponent;
+    const float component_min = *std::min_element(
+        component_table, component_table + kNumBytesPerPackedComponent);
+    for (int i = 0; i < kNumBytesPerPackedComponent; ++i) {
+      const float quantized_value = std::floor(
+          (component_table[i] - component_min) * quantization_scale);
+      quantized_look_up_table[component * kNumBytesPerPackedComponent + i] =
+          static_cast<uint8_t>(
+              std::min(std::max(quantized_value, 0.0f), kMaxQuantizedValue));
+    }
+  }
+}
+
+void ScanPackedCodes(
+    const uint8_t* packed_codes, size_t num_blocks, int num_components,
+    const uint8_t* quantized_look_up_table, uint16_t* sums) {
+  CHECK_LE(num_components, kMaxNumComponents);
+  selected_scan_function.load(std::memory_order_relaxed)(
+      packed_codes, num_blocks, num_components, quantized_look_up_table, sums);
+}
+
+const char* GetPackedCodeScanKernelName(const PackedCodeScanKernel kernel) {
+  switch (kernel) {
+    case PackedCodeScanKernel::kScalar:
+      return "scalar";
+    case PackedCodeScanKernel::kSsse3:
+      return "SSSE3";
+    case PackedCodeScanKernel::kAvx2:
+      return "AVX2";
+    default:
+      LOG(FATAL) << "Unknown scan kernel " << static_cast<int>(kernel);
+      return "";
+  }
+}
+
+bool IsPackedCodeScanKernelSupported(const PackedCodeScanKernel kernel) {
+  switch (kernel) {
+    case PackedCodeScanKernel::kScalar:
+      return true;
+#if defined(INVERTED_MULTI_INDEX_PACKED_CODES_X86_KERNELS)
+    case PackedCodeScanKernel::kSsse3:
+      return GetCpuFeatures().has_ssse3;
+    case PackedCodeScanKernel::kAvx2:
+      return GetCpuFeatures().has_avx2;
+#endif  // INVERTED_MULTI_INDEX_PACKED_CODES_X86_KERNELS
+    default:
+      return false;
+  }
+}
+
+PackedCodeScanFunction GetPackedCodeScanFunction(
+    const PackedCodeScanKernel kernel) {
+  CHECK(IsPackedCodeScanKernelSupported(kernel))
+      << "The scan kernel " << GetPackedCodeScanKernelName(kernel)
+      << " is not supported.";
+  switch (kernel) {
+    case PackedCodeScanKernel::kScalar:
+      return &ScalarScanPackedCodes;
+#if defined(INVERTED_MULTI_INDEX_PACKED_CODES_X86_KERNELS)
+    case PackedCodeScanKernel::kSsse3:
+      return &Ssse3ScanPackedCodes;
+    case PackedCodeScanKernel::kAvx2:
+      return &Avx2ScanPackedCodes;
+#endif  // INVERTED_MULTI_INDEX_PACKED_CODES_X86_KERNELS
+    default:
+      LOG(FATAL) << "Unknown scan kernel " << static_cast<int>(kernel);
+      return nullptr;
+  }
+}
+
+void SelectPackedCodeScanKernel(const PackedCodeScanKernel kernel) {
+  selected_scan_function.store(
+      GetPackedCodeScanFunction(kernel), std::memory_order_relaxed);
+}
+}  // namespace inverted_multi_index
+}  // namespace loop_closure
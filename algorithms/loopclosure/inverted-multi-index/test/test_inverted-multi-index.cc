@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include <utility>
 #include <vector>
 
@@ -228,6 +229,42 @@ TEST_F(InvertedMultiIndexTest, GetNNearestNeighborsWorks) {
             expected_indices.block(0, 0, num_elements, 1), 1e-9));
   }
 }
+
+TEST_F(InvertedMultiIndexTest, GetNNearestNeighborsForFeaturesWorks) {
+  // Without backtracking, the kd-tree search finds the closest words exactly
+  // as well, which makes the results of both searches the same.
+  FLAGS_lc_knn_epsilon = 0.0;
+
+  // More queries than fit into one block of the batched search.
+  constexpr int kNumDescriptors = 500;
+  constexpr int kNumQueries = 150;
+  constexpr int kNumNeighbors = 10;
+  std::srand(42);
+  const Eigen::MatrixXf descriptors =
+      Eigen::MatrixXf::Random(6, kNumDescriptors);
+  const Eigen::MatrixXf query_descriptors =
+      Eigen::MatrixXf::Random(6, kNumQueries);
+
+  TestableInvertedMultiIndex index(words1_, words2_, 10);
+  index.AddDescriptors(descriptors);
+
+  Eigen::MatrixXi indices(kNumNeighbors, kNumQueries);
+  Eigen::MatrixXf distances(kNumNeighbors, kNumQueries);
+  index.GetNNearestNeighborsForFeatures(
+      query_descriptors, kNumNeighbors, indices, distances);
+
+  for (int i = 0; i < kNumQueries; ++i) {
+    Eigen::VectorXi expected_indices(kNumNeighbors, 1);
+    Eigen::VectorXf expected_distances(kNumNeighbors, 1);
+    index.GetNNearestNeighbors(
+        query_descriptors.block<6, 1>(0, i), kNumNeighbors, expected_indices,
+        expected_distances);
+    for (int j = 0; j < kNumNeighbors; ++j) {
+      EXPECT_EQ(expected_indices(j), indices(j, i));
+      EXPECT_FLOAT_EQ(expected_distances(j), distances(j, i));
+    }
+  }
+}
 }  // namespace
 }  // namespace inverted_multi_index
 }  // namespace loop_closure
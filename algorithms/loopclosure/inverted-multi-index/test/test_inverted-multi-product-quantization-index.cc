@@ -28,6 +28,8 @@ class TestableInvertedMultiPQIndex
   using InvertedMultiProductQuantizationIndex<int, 4, 1, 2>::words_2_index_;
   using InvertedMultiProductQuantizationIndex<int, 4, 1, 2>::word_index_map_;
   using InvertedMultiProductQuantizationIndex<int, 4, 1, 2>::inverted_files_;
+  using InvertedMultiProductQuantizationIndex<int, 4, 1,
+                                              2>::GetStoredDescriptor;
   using InvertedMultiProductQuantizationIndex<int, 4, 1,
                                               2>::max_db_descriptor_index_;
 };
@@ -100,20 +102,19 @@ TEST_F(InvertedMultiProductQuantizationIndexTest, AddDescriptorsWorks) {
   ASSERT_EQ(4, index.inverted_files_.size());
   int counter = 0;
   for (int i = 0; i < 4; ++i) {
-    EXPECT_EQ(
-        index.inverted_files_[i].descriptors_.size(),
-        index.inverted_files_[i].indices_.size());
     ASSERT_EQ(
         expected_num_entries_per_inverted_file[i],
-        index.inverted_files_[i].descriptors_.size());
+        index.inverted_files_[i].GetNumDescriptors());
     for (int j = 0; j < expected_num_entries_per_inverted_file[i]; ++j) {
       EXPECT_EQ(counter, index.inverted_files_[i].indices_[j]);
+      Eigen::Matrix<int, 4, 1> stored_descriptor;
+      index.GetStoredDescriptor(
+          index.inverted_files_[i], j, &stored_descriptor);
       EXPECT_TRUE(
           ::common::MatricesEqual(
-              expected_quantized_descriptors[counter],
-              index.inverted_files_[i].descriptors_[j]))
+              expected_quantized_descriptors[counter], stored_descriptor))
           << "The quantized representation for descriptor " << counter << " ( "
-          << index.inverted_files_[i].descriptors_[j].transpose()
+          << stored_descriptor.transpose()
           << " ) does not match the expected quantized representation ( "
           << expected_quantized_descriptors[counter].transpose() << " ).";
       ++counter;
@@ -0,0 +1,126 @@
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include <Eigen/Core>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include <inverted-multi-index/packed-codes.h>
+
+namespace loop_closure {
+namespace inverted_multi_index {
+namespace {
+class PackedCodesTest : public ::testing::Test {
+ public:
+  void SetUp() {
+    std::srand(42);
+  }
+
+  // Packs random codes for num_descriptors descriptors.
+  void CreateRandomCodes(
+      int num_descriptors, int num_components, std::vector<uint8_t>* codes,
+      std::vector<uint8_t>* packed_codes) const {
+    codes->resize(num_descriptors * num_components);
+    packed_codes->assign(
+        GetNumPackedCodeBlocks(num_descriptors) *
+            GetNumBytesPerPackedCodeBlock(num_components),
+        0u);
+    for (int descriptor = 0; descriptor < num_descriptors; ++descriptor) {
+      for (int component = 0; component < num_components; ++component) {
+        const uint8_t code = static_cast<uint8_t>(std::rand() % 16);
+        (*codes)[descriptor * num_components + component] = code;
+        SetPackedCode(
+            descriptor, component, num_components, code,
+            packed_codes->data());
+      }
+    }
+  }
+};
+
+TEST_F(PackedCodesTest, PackedCodesRoundTrip) {
+  static constexpr int kNumDescriptors = 75;
+  static constexpr int kNumComponents = 10;
+  std::vector<uint8_t> codes, packed_codes;
+  CreateRandomCodes(kNumDescriptors, kNumComponents, &codes, &packed_codes);
+  for (int descriptor = 0; descriptor < kNumDescriptors; ++descriptor) {
+    for (int component = 0; component < kNumComponents; ++component) {
+      EXPECT_EQ(
+          codes[descriptor * kNumComponents + component],
+          GetPackedCode(
+              packed_codes.data(), descriptor, component, kNumComponents));
+    }
+  }
+}
+
+TEST_F(PackedCodesTest, QuantizedDistancesAreLowerBounds) {
+  static constexpr int kNumDescriptors = 100;
+  for (const int num_components : {1, 9, 10}) {
+    std::vector<uint8_t> codes, packed_codes;
+    CreateRandomCodes(kNumDescriptors, num_components, &codes, &packed_codes);
+    const Eigen::MatrixXf look_up_table =
+        Eigen::MatrixXf::Random(kNumBytesPerPackedComponent, num_components)
+            .cwiseAbs();
+    std::vector<uint8_t> quantized_look_up_table(
+        look_up_table.size());
+    float bias, scale;
+    QuantizeLookUpTable(
+        look_up_table.data(), num_components, quantized_look_up_table.data(),
+        &bias, &scale);
+
+    const size_t num_blocks = GetNumPackedCodeBlocks(kNumDescriptors);
+    std::vector<uint16_t> sums(num_blocks * kPackedCodeBlockSize);
+    ScanPackedCodes(
+        packed_codes.data(), num_blocks, num_components,
+        quantized_look_up_table.data(), sums.data());
+    for (int descriptor = 0; descriptor < kNumDescriptors; ++descriptor) {
+      float distance = 0.0f;
+      for (int component = 0; component < num_components; ++component) {
+        distance += look_up_table(
+            codes[descriptor * num_components + component], component);
+      }
+      const float lower_bound = bias + sums[descriptor] / scale;
+      EXPECT_LE(lower_bound, distance + 1e-5f);
+      // Each component loses at most one quantization step.
+      EXPECT_GE(lower_bound, distance - (num_components + 1) / scale);
+    }
+  }
+}
+
+TEST_F(PackedCodesTest, KernelsMatchScalarKernel) {
+  static constexpr int kNumDescriptors = 200;
+  for (const int num_components : {1, 9, 10}) {
+    std::vector<uint8_t> codes, packed_codes;
+    CreateRandomCodes(kNumDescriptors, num_components, &codes, &packed_codes);
+    std::vector<uint8_t> quantized_look_up_table(
+        kNumBytesPerPackedComponent * num_components);
+    for (uint8_t& entry : quantized_look_up_table) {
+      entry = static_cast<uint8_t>(std::rand() % 256);
+    }
+
+    const size_t num_blocks = GetNumPackedCodeBlocks(kNumDescriptors);
+    std::vector<uint16_t> expected_sums(num_blocks * kPackedCodeBlockSize);
+    GetPackedCodeScanFunction(PackedCodeScanKernel::kScalar)(
+        packed_codes.data(), num_blocks, num_components,
+        quantized_look_up_table.data(), expected_sums.data());
+
+    for (int kernel_idx = 0;
+         kernel_idx < static_cast<int>(PackedCodeScanKernel::kNumKernels);
+         ++kernel_idx) {
+      const PackedCodeScanKernel kernel =
+          static_cast<PackedCodeScanKernel>(kernel_idx);
+      if (!IsPackedCodeScanKernelSupported(kernel)) {
+        continue;
+      }
+      std::vector<uint16_t> sums(num_blocks * kPackedCodeBlockSize);
+      GetPackedCodeScanFunction(kernel)(
+          packed_codes.data(), num_blocks, num_components,
+          quantized_look_up_table.data(), sums.data());
+      EXPECT_EQ(expected_sums, sums) << GetPackedCodeScanKernelName(kernel);
+    }
+  }
+}
+}  // namespace
+}  // namespace inverted_multi_index
+}  // namespace loop_closure
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -47,11 +47,32 @@ class LoopClosureHandler {
 
   typedef vi_map::MissionBaseFrameMap MissionBaseFrameMap;
 
+  // The RANSAC result of one query vertex, which doesn't modify the map until
+  // it is applied with applyLoopClosure.
+  struct LoopClosureEstimate {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    pose::Transformation T_G_I_ransac;
+    int num_inliers = 0;
+    double inlier_ratio = 0.0;
+    std::vector<int> inliers;
+    KeypointToLandmarkVector query_keypoint_idx_to_map_landmark_pairs;
+    LandmarkToLandmarkVector query_landmark_to_map_landmark_pairs;
+    vi_map::VertexKeyPointToStructureMatchList inlier_structure_matches;
+  };
+  typedef Aligned<std::vector, LoopClosureEstimate> LoopClosureEstimateVector;
+
   friend class LoopClosureHandlerTest;
 
   explicit LoopClosureHandler(vi_map::VIMap* map,
                               LandmarkToLandmarkMap* landmark_id_old_to_new);
 
+  // If landmark_merges_to_apply is not null, matched landmarks are not merged
+  // in the map right away but added to it, to be merged all at once with
+  // VIMap::mergeLandmarks after handling the loop closures.
+  LoopClosureHandler(
+      vi_map::VIMap* map, LandmarkToLandmarkMap* landmark_id_old_to_new,
+      LandmarkToLandmarkMap* landmark_merges_to_apply);
+
   explicit LoopClosureHandler(
       summary_map::LocalizationSummaryMap const* summary_map,
       LandmarkToLandmarkMap* landmark_id_old_to_new);
@@ -85,6 +106,27 @@ class LoopClosureHandler {
       pose_graph::VertexId* vertex_id_closest_to_structure_matches,
       std::mutex* map_mutex, bool use_random_pnp_seed = true) const;
 
+  // The read-only part of handleLoopClosure. Returns true if the estimate
+  // passes the inlier thresholds. If map_mutex is null, the map is read without
+  // locking, i.e. the caller guarantees that it isn't modified concurrently.
+  bool estimateLoopClosure(
+      const aslam::VisualNFrame& query_vertex_n_frame,
+      const std::vector<vi_map::LandmarkIdList>& query_vertex_landmark_ids,
+      const pose_graph::VertexId& query_vertex_id,
+      const vi_map::VertexKeyPointToStructureMatchList& structure_matches,
+      std::mutex* map_mutex, bool use_random_pnp_seed,
+      LoopClosureEstimate* estimate) const;
+
+  // Merges the matched landmarks and adds the loop-closure edge of an estimate
+  // that passed estimateLoopClosure. Modifies the map and the merge
+  // bookkeeping, so it must not run concurrently with any other query.
+  void applyLoopClosure(
+      const LoopClosureEstimate& estimate,
+      const pose_graph::VertexId& query_vertex_id,
+      bool merge_matching_landmarks, bool add_loopclosure_edges,
+      MergedLandmark3dPositionVector* landmark_pairs_merged,
+      pose_graph::VertexId* vertex_id_closest_to_structure_matches) const;
+
   void updateQueryKeyframeInvalidLandmarkAssociations(
       const std::vector<int>& inliers,
       const KeypointToLandmarkVector& query_keypoint_idx_to_landmark_pairs,
@@ -126,6 +168,7 @@ class LoopClosureHandler {
   vi_map::VIMap* map_;
   summary_map::LocalizationSummaryMap const* summary_map_;
   LandmarkToLandmarkMap* landmark_id_old_to_new_;
+  LandmarkToLandmarkMap* landmark_merges_to_apply_;
 };
 }  // namespace loop_closure_handler
 
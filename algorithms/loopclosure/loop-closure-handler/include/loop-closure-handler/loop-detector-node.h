@@ -12,9 +12,11 @@
 #include <Eigen/Geometry>
 #include <aslam/common/memory.h>
 #include <descriptor-projection/descriptor-projection.h>
+#include <localization-summary-map/projected-descriptor-cache.h>
 #include <localization-summary-map/unique-id.h>
 #include <loopclosure-common/types.h>
 #include <maplab-common/file-serializable.h>
+#include <maplab-common/memory-accounting.h>
 #include <vi-map/mission-baseframe.h>
 #include <vi-map/unique-id.h>
 #include <vi-map/vi-map.h>
@@ -51,6 +53,11 @@ class LoopDetectorNode final
   void detectLoopClosuresAndMergeLandmarks(
       const MissionId& mission, vi_map::VIMap* map);
 
+  // Stores the projected descriptors as mission resources of the map if
+  // --lc_use_projected_descriptor_cache is set, see
+  // summary_map::ProjectedDescriptorCache. Does nothing otherwise.
+  void saveProjectedDescriptorCache(vi_map::VIMap* map);
+
   void addVertexToDatabase(
       const pose_graph::VertexId& vertex_id, const vi_map::VIMap& map);
 
@@ -67,6 +74,12 @@ class LoopDetectorNode final
 
   void addLocalizationSummaryMapToDatabase(
       const summary_map::LocalizationSummaryMap& localization_summary_map);
+  // Adds the observers from first_observer_index on of a summary map that is
+  // already in the database, i.e. the observers that were appended to it with
+  // appendLandmarksToLocalizationSummaryMap, without re-inserting the others.
+  void addAppendedLocalizationSummaryMapObserversToDatabase(
+      const summary_map::LocalizationSummaryMap& localization_summary_map,
+      const size_t first_observer_index);
 
   bool findVertexInDatabase(
       const vi_map::Vertex& query_vertex, const bool merge_landmarks,
@@ -87,6 +100,18 @@ class LoopDetectorNode final
       pose::Transformation* T_G_I, unsigned int* num_of_lc_matches,
       vi_map::VertexKeyPointToStructureMatchList* inlier_structure_matches)
       const;
+  // Same as above, but keeps the given matches of keypoints of the n-frame to
+  // landmarks of the summary map, e.g. the matches that are propagated along
+  // the feature tracks from the previous localization, and only searches the
+  // database for the other keypoints. The kept matches are verified together
+  // with the new ones by the RANSAC.
+  bool findNFrameInSummaryMapDatabase(
+      const aslam::VisualNFrame& n_frame, const bool skip_untracked_keypoints,
+      const summary_map::LocalizationSummaryMap& localization_summary_map,
+      const vi_map::VertexKeyPointToStructureMatchList& known_structure_matches,
+      pose::Transformation* T_G_I, unsigned int* num_of_lc_matches,
+      vi_map::VertexKeyPointToStructureMatchList* inlier_structure_matches)
+      const;
 
   void detectLoopClosuresMissionToDatabase(
       const MissionId& mission_id, const bool merge_landmarks,
@@ -108,6 +133,9 @@ class LoopDetectorNode final
 
   std::string printStatus() const;
 
+  // Adds the memory used by the loop detector database.
+  void getMemoryUsage(common::MemoryUsage* usage) const;
+
   void serialize(
       proto::LoopDetectorNode* proto_loop_detector_node) const override;
   void deserialize(
@@ -115,13 +143,30 @@ class LoopDetectorNode final
 
   static const std::string& getDefaultSerializationFilename();
 
+  // Saves the database in a binary layout, which mapFromBinaryFile maps into
+  // memory instead of parsing it. See MatchingBasedLoopDetectorSerializer.
+  bool saveToBinaryFile(const std::string& file_path) const
+      __attribute__((warn_unused_result));
+  // The node needs to be empty.
+  bool mapFromBinaryFile(const std::string& file_path)
+      __attribute__((warn_unused_result));
+
+  static const std::string& getDefaultBinarySerializationFilename();
+
  private:
   typedef std::vector<size_t> SupsampledToFullIndexMap;
   typedef std::unordered_map<loop_closure::KeyframeId, SupsampledToFullIndexMap>
       KeyframeToKeypointReindexMap;
 
+  void addLocalizationSummaryMapObserversToDatabase(
+      const summary_map::LocalizationSummaryMap& localization_summary_map,
+      const size_t first_observer_index);
+
+  // The keypoints of the known structure matches are not queried, their
+  // matches are added to the result as they are.
   void findNearestNeighborMatchesForNFrame(
       const aslam::VisualNFrame& n_frame, const bool skip_untracked_keypoints,
+      const vi_map::VertexKeyPointToStructureMatchList& known_structure_matches,
       std::vector<vi_map::LandmarkIdList>* query_vertex_landmark_ids,
       unsigned int* num_of_lc_matches,
       loop_closure::FrameToMatches* frame_matches_list) const;
@@ -145,11 +190,13 @@ class LoopDetectorNode final
       loop_closure::ProjectedImage* projected_image) const;
 
   // A localization frame generates fake landmark ids so that the same
-  // interfaces can be used as for loop-closure.
+  // interfaces can be used as for loop-closure. The keypoints that are
+  // flagged in is_keypoint_matched, which may be empty, are not projected.
   void convertLocalizationFrameToProjectedImage(
       const aslam::VisualNFrame& nframe,
       const loop_closure::KeyframeId& keyframe_id,
       const bool skip_untracked_keypoints,
+      const std::vector<char>& is_keypoint_matched,
       const loop_closure::ProjectedImage::Ptr& projected_image,
       KeyframeToKeypointReindexMap* keyframe_to_keypoint_reindexing,
       vi_map::LandmarkIdList* observed_landmark_ids) const;
@@ -163,7 +210,8 @@ class LoopDetectorNode final
       loop_closure_handler::LoopClosureHandler::MergedLandmark3dPositionVector*
           landmark_pairs_merged,
       pose_graph::VertexId* vertex_id_closest_to_structure_matches,
-      std::mutex* map_mutex) const;
+      std::mutex* map_mutex,
+      LandmarkToLandmarkMap* landmark_merges_to_apply) const;
 
   bool convertFrameMatchesToConstraint(
       const loop_closure::FrameIdMatchesPair& query_frame_id_and_matches,
@@ -186,27 +234,35 @@ class LoopDetectorNode final
       vi_map::VertexKeyPointToStructureMatchList* inlier_structure_matches,
       pose_graph::VertexId* vertex_id_closest_to_structure_matches) const;
 
-  void queryVertexInDatabase(
-      const pose_graph::VertexId& query_vertex_id, const bool merge_landmarks,
-      const bool add_lc_edges, vi_map::VIMap* map,
-      vi_map::LoopClosureConstraint* raw_constraint,
-      vi_map::LoopClosureConstraint* inlier_constraint,
-      std::vector<double>* inlier_ratios,
-      aslam::TransformationVector* T_G_M2_vector,
-      loop_closure_handler::LoopClosureHandler::MergedLandmark3dPositionVector*
-          landmark_pairs_merged,
-      std::mutex* map_mutex) const;
+  // Returns true if the vertex poses of the map are in a common, trusted
+  // frame, i.e. all missions have a known baseframe, such that the
+  // candidates of a query can be restricted spatially.
+  bool canUsePosePrior(const vi_map::VIMap& map) const;
+
+  // Projects the frames of the query vertex for the index query. Only reads
+  // the map, so it can run in parallel as long as nothing modifies the map. If
+  // candidate_vertex_ids is set, only matches to these vertices are returned.
+  void projectQueryVertex(
+      const vi_map::VIMap& map, const pose_graph::VertexId& query_vertex_id,
+      const std::shared_ptr<const pose_graph::VertexIdSet>&
+          candidate_vertex_ids,
+      loop_closure::ProjectedImagePtrList* projected_image_ptr_list) const;
 
   loop_closure_visualization::LoopClosureVisualizer::UniquePtr visualizer_;
   std::shared_ptr<loop_detector::LoopDetector> loop_detector_;
+  // Only set if --lc_use_projected_descriptor_cache is set.
+  std::unique_ptr<summary_map::ProjectedDescriptorCache>
+      projected_descriptor_cache_;
   vi_map::MissionIdSet missions_in_database_;
   summary_map::LocalizationSummaryMapIdSet summary_maps_in_database_;
   // The filename of the serialization file.
   static const std::string serialization_filename_;
+  static const std::string binary_serialization_filename_;
   const bool use_random_pnp_seed_;
 
-  // A mapping from the merged landmark id (does not exist anymore) to the
-  // landmark id it was merged into (and should exist).
+  // A mapping from the merged landmark id (does not exist anymore, or is
+  // about to be merged at the end of the current query pass) to the landmark
+  // id it was merged into (and should exist).
   mutable LandmarkToLandmarkMap landmark_id_old_to_new_;
 };
 
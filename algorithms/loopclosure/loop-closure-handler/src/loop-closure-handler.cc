@@ -1,7 +1,15 @@
 #include "loop-closure-handler/loop-closure-handler.h"
 
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
 #include <aslam/common/statistics/statistics.h>
 #include <aslam/geometric-vision/pnp-pose-estimator.h>
+#include <geometric-vision/multi-hypothesis-pnp.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
+#include <maplab-common/tracing.h>
 #include <vi-map-helpers/vi-map-queries.h>
 #include <vi-map/landmark-quality-metrics.h>
 
@@ -15,9 +23,22 @@ DECLARE_bool(lc_filter_underconstrained_landmarks);
 DEFINE_int32(
     lc_num_ransac_iters, 100,
     "Maximum number of ransac iterations for absolute pose recovery.");
+DEFINE_int32(
+    lc_ransac_num_parallel_runs, 1,
+    "Number of independent RANSAC runs per query, which share the "
+    "lc_num_ransac_iters iterations. The runs are evaluated concurrently in "
+    "rounds of at most one run per hardware thread, and no further round is "
+    "started once a run yields a pose that passes lc_min_inlier_count and "
+    "lc_min_inlier_ratio. Only used with random PnP seeds.");
 DEFINE_bool(
     lc_nonlinear_refinement_p3p, false,
     "If nonlinear refinement on all ransac inliers should be run.");
+DEFINE_bool(
+    lc_use_multi_hypothesis_pnp, false,
+    "If the absolute pose RANSAC should solve batches of minimal hypotheses "
+    "and score them against all correspondences at once with the "
+    "vectorized geometric_vision::MultiHypothesisPnp instead of "
+    "aslam::geometric_vision::PnpPoseEstimator.");
 DECLARE_double(lc_switch_variable_variance);
 
 DEFINE_double(
@@ -35,6 +56,114 @@ DEFINE_int32(
     "The minimum loop-closure inlier count to add a loop-closure edge.");
 
 namespace loop_closure_handler {
+namespace {
+struct PnpRansacResult {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  pose::Transformation T_G_I;
+  std::vector<int> inliers;
+  std::vector<double> inlier_distances_to_model;
+  KeypointToInlierIndexWithReprojectionErrorMap
+      keypoint_to_best_structure_match;
+  int num_iters = 0;
+};
+
+bool solveAbsolutePoseRansac(
+    const Eigen::Matrix2Xd& measurements,
+    const std::vector<int>& measurement_camera_indices,
+    const Eigen::Matrix3Xd& G_landmark_positions, const int num_iterations,
+    const aslam::NCamera::ConstPtr& ncamera, const bool use_random_pnp_seed,
+    pose::Transformation* T_G_I, std::vector<int>* inliers,
+    std::vector<double>* inlier_distances_to_model, int* num_iters) {
+  if (FLAGS_lc_use_multi_hypothesis_pnp) {
+    geometric_vision::MultiHypothesisPnp pose_estimator(
+        FLAGS_lc_nonlinear_refinement_p3p, use_random_pnp_seed);
+    return pose_estimator.absoluteMultiPoseRansacPinholeCam(
+        measurements, measurement_camera_indices, G_landmark_positions,
+        FLAGS_lc_ransac_pixel_sigma, num_iterations, ncamera, T_G_I, inliers,
+        inlier_distances_to_model, num_iters);
+  }
+  aslam::geometric_vision::PnpPoseEstimator pose_estimator(
+      FLAGS_lc_nonlinear_refinement_p3p, use_random_pnp_seed);
+  return pose_estimator.absoluteMultiPoseRansacPinholeCam(
+      measurements, measurement_camera_indices, G_landmark_positions,
+      FLAGS_lc_ransac_pixel_sigma, num_iterations, ncamera, T_G_I, inliers,
+      inlier_distances_to_model, num_iters);
+}
+
+// Runs the absolute pose RANSAC, split into lc_ransac_num_parallel_runs
+// independent runs, and returns the run with the most inlier keypoints.
+void runPnpRansac(
+    const Eigen::Matrix2Xd& measurements,
+    const std::vector<int>& measurement_camera_indices,
+    const Eigen::Matrix3Xd& G_landmark_positions,
+    const vi_map::VertexKeyPointToStructureMatchList& structure_matches,
+    const aslam::VisualNFrame& query_vertex_n_frame,
+    const bool use_random_pnp_seed, PnpRansacResult* result) {
+  CHECK_NOTNULL(result);
+  CHECK_GT(FLAGS_lc_ransac_num_parallel_runs, 0);
+  aslam::NCamera::ConstPtr ncamera = query_vertex_n_frame.getNCameraShared();
+  CHECK(ncamera != nullptr);
+
+  auto run_ransac = [&](const int num_iterations, PnpRansacResult* run) {
+    solveAbsolutePoseRansac(
+        measurements, measurement_camera_indices, G_landmark_positions,
+        num_iterations, ncamera, use_random_pnp_seed, &run->T_G_I,
+        &run->inliers, &run->inlier_distances_to_model, &run->num_iters);
+    CHECK_EQ(run->inliers.size(), run->inlier_distances_to_model.size());
+    getBestStructureMatchForEveryKeypoint(
+        run->inliers, run->inlier_distances_to_model, structure_matches,
+        query_vertex_n_frame, &run->keypoint_to_best_structure_match);
+  };
+
+  // Runs with a fixed seed would all draw the same hypotheses.
+  const int num_runs =
+      use_random_pnp_seed ? FLAGS_lc_ransac_num_parallel_runs : 1;
+  if (num_runs == 1) {
+    run_ransac(FLAGS_lc_num_ransac_iters, result);
+    return;
+  }
+
+  const int num_iterations_per_run =
+      std::max(1, (FLAGS_lc_num_ransac_iters + num_runs - 1) / num_runs);
+  const int num_inliers_to_accept = std::max(
+      FLAGS_lc_min_inlier_count,
+      static_cast<int>(std::ceil(
+          FLAGS_lc_min_inlier_ratio * G_landmark_positions.cols())));
+  static const size_t kNumHardwareThreads = common::getNumHardwareThreads();
+  const size_t max_num_runs_per_round =
+      std::min<size_t>(num_runs, kNumHardwareThreads);
+  Aligned<std::vector, PnpRansacResult> runs(max_num_runs_per_round);
+
+  int best_num_inliers = -1;
+  for (size_t first_run = 0u; first_run < static_cast<size_t>(num_runs);
+       first_run += max_num_runs_per_round) {
+    const size_t num_runs_in_round =
+        std::min(max_num_runs_per_round, num_runs - first_run);
+    std::function<void(const std::vector<size_t>&)> round_functor =
+        [&](const std::vector<size_t>& range) {
+          for (const size_t run_idx : range) {
+            run_ransac(num_iterations_per_run, &runs[run_idx]);
+          }
+        };
+    const bool kAlwaysParallelize = false;
+    common::ParallelProcess(
+        num_runs_in_round, round_functor, kAlwaysParallelize,
+        num_runs_in_round);
+
+    for (size_t run_idx = 0u; run_idx < num_runs_in_round; ++run_idx) {
+      const int num_inliers = static_cast<int>(
+          runs[run_idx].keypoint_to_best_structure_match.size());
+      if (num_inliers > best_num_inliers) {
+        best_num_inliers = num_inliers;
+        *result = std::move(runs[run_idx]);
+      }
+    }
+    if (best_num_inliers >= num_inliers_to_accept) {
+      break;
+    }
+  }
+}
+}  // namespace
 
 bool addLoopClosureEdge(
     const pose_graph::VertexId& query_vertex_id,
@@ -101,9 +230,6 @@ bool addLoopClosureEdge(
   CHECK_GT(measurements.cols(), 0);
 
   constexpr bool kUseRandomPnpSeed = true;
-  aslam::geometric_vision::PnpPoseEstimator pose_estimator(
-      FLAGS_lc_nonlinear_refinement_p3p, kUseRandomPnpSeed);
-
   aslam::NCamera::ConstPtr ncamera = vertex.getNCameras();
   CHECK(ncamera != nullptr);
 
@@ -111,10 +237,14 @@ bool addLoopClosureEdge(
   std::vector<int> inliers;
   std::vector<double> inlier_distances_to_model;
   int num_iters;
-  bool pnp_success = pose_estimator.absoluteMultiPoseRansacPinholeCam(
-      measurements, measurement_camera_indices, G_landmark_positions,
-      FLAGS_lc_ransac_pixel_sigma, FLAGS_lc_num_ransac_iters, ncamera,
-      &T_G_Inn_ransac, &inliers, &inlier_distances_to_model, &num_iters);
+  bool pnp_success;
+  {
+    MAPLAB_TRACE_SCOPE("loop_closure", "ransac");
+    pnp_success = solveAbsolutePoseRansac(
+        measurements, measurement_camera_indices, G_landmark_positions,
+        FLAGS_lc_num_ransac_iters, ncamera, kUseRandomPnpSeed,
+        &T_G_Inn_ransac, &inliers, &inlier_distances_to_model, &num_iters);
+  }
 
   if (!pnp_success) {
     // We could not retrieve a pose for the vertex observing matched landmarks.
@@ -168,14 +298,21 @@ bool addLoopClosureEdge(
 
 LoopClosureHandler::LoopClosureHandler(
     vi_map::VIMap* map, LandmarkToLandmarkMap* landmark_id_old_to_new)
+    : LoopClosureHandler(map, landmark_id_old_to_new, nullptr) {}
+
+LoopClosureHandler::LoopClosureHandler(
+    vi_map::VIMap* map, LandmarkToLandmarkMap* landmark_id_old_to_new,
+    LandmarkToLandmarkMap* landmark_merges_to_apply)
     : map_(CHECK_NOTNULL(map)), summary_map_(nullptr),
-      landmark_id_old_to_new_(CHECK_NOTNULL(landmark_id_old_to_new)) {}
+      landmark_id_old_to_new_(CHECK_NOTNULL(landmark_id_old_to_new)),
+      landmark_merges_to_apply_(landmark_merges_to_apply) {}
 
 LoopClosureHandler::LoopClosureHandler(
     summary_map::LocalizationSummaryMap const* summary_map,
     LandmarkToLandmarkMap* landmark_id_old_to_new)
     : map_(nullptr), summary_map_(CHECK_NOTNULL(summary_map)),
-      landmark_id_old_to_new_(CHECK_NOTNULL(landmark_id_old_to_new)) {}
+      landmark_id_old_to_new_(CHECK_NOTNULL(landmark_id_old_to_new)),
+      landmark_merges_to_apply_(nullptr) {}
 
 // Assuming same query_keyframe in each of the constraints on the vector.
 bool LoopClosureHandler::handleLoopClosure(
@@ -231,18 +368,49 @@ bool LoopClosureHandler::handleLoopClosure(
   CHECK_NOTNULL(landmark_pairs_merged);
   CHECK_NOTNULL(map_mutex);
   // Note: vertex_id_closest_to_structure_matches is optional and may be NULL.
-  T_G_I_ransac->setIdentity();
-
-  CHECK_EQ(
-      static_cast<unsigned int>(query_vertex_n_frame.getNumFrames()),
-      query_vertex_landmark_ids.size());
 
   // Make sure only one of those options is selected. We can't merge landmarks
   // and add loopclosure edges at the same time.
   CHECK(!merge_matching_landmarks || !add_loopclosure_edges);
 
-  *num_inliers = 0;
-  *inlier_ratio = 0.0;
+  LoopClosureEstimate estimate;
+  const bool success = estimateLoopClosure(
+      query_vertex_n_frame, query_vertex_landmark_ids, query_vertex_id,
+      structure_matches, map_mutex, use_random_pnp_seed, &estimate);
+  *num_inliers = estimate.num_inliers;
+  *inlier_ratio = estimate.inlier_ratio;
+  *T_G_I_ransac = estimate.T_G_I_ransac;
+  if (!success) {
+    return false;
+  }
+  *inlier_structure_matches = estimate.inlier_structure_matches;
+
+  std::lock_guard<std::mutex> map_lock(*map_mutex);
+  applyLoopClosure(
+      estimate, query_vertex_id, merge_matching_landmarks,
+      add_loopclosure_edges, landmark_pairs_merged,
+      vertex_id_closest_to_structure_matches);
+  return true;
+}
+
+bool LoopClosureHandler::estimateLoopClosure(
+    const aslam::VisualNFrame& query_vertex_n_frame,
+    const std::vector<vi_map::LandmarkIdList>& query_vertex_landmark_ids,
+    const pose_graph::VertexId& query_vertex_id,
+    const vi_map::VertexKeyPointToStructureMatchList& structure_matches,
+    std::mutex* map_mutex, bool use_random_pnp_seed,
+    LoopClosureEstimate* estimate) const {
+  CHECK_NOTNULL(estimate);
+  // Note: map_mutex is optional and may be NULL.
+  estimate->T_G_I_ransac.setIdentity();
+  estimate->num_inliers = 0;
+  estimate->inlier_ratio = 0.0;
+  estimate->inliers.clear();
+  estimate->inlier_structure_matches.clear();
+
+  CHECK_EQ(
+      static_cast<unsigned int>(query_vertex_n_frame.getNumFrames()),
+      query_vertex_landmark_ids.size());
 
   statistics::StatsCollector stats_total_calls(
       "0.0 Loop closure: Total query frames handled");
@@ -262,8 +430,10 @@ bool LoopClosureHandler::handleLoopClosure(
   measurement_camera_indices.resize(total_matches);
 
   // Ordered containers s.t. inliers vector returned from P3P makes sense.
-  KeypointToLandmarkVector query_keypoint_idx_to_map_landmark_pairs;
-  LandmarkToLandmarkVector query_landmark_to_map_landmark_pairs;
+  KeypointToLandmarkVector& query_keypoint_idx_to_map_landmark_pairs =
+      estimate->query_keypoint_idx_to_map_landmark_pairs;
+  LandmarkToLandmarkVector& query_landmark_to_map_landmark_pairs =
+      estimate->query_landmark_to_map_landmark_pairs;
 
   query_keypoint_idx_to_map_landmark_pairs.resize(total_matches);
   query_landmark_to_map_landmark_pairs.resize(total_matches);
@@ -271,7 +441,10 @@ bool LoopClosureHandler::handleLoopClosure(
   int col_idx = 0;
   for (const vi_map::VertexKeyPointToStructureMatch& structure_match :
        structure_matches) {
-    map_mutex->lock();
+    std::unique_lock<std::mutex> map_lock;
+    if (map_mutex != nullptr) {
+      map_lock = std::unique_lock<std::mutex>(*map_mutex);
+    }
     vi_map::LandmarkId db_landmark_id = getLandmarkIdAfterMerges(
         structure_match.landmark_result);
 
@@ -306,7 +479,9 @@ bool LoopClosureHandler::handleLoopClosure(
         query_vertex_n_frame.getFrame(structure_match.frame_index_query)
             .getKeypointMeasurement(structure_match.keypoint_index_query);
     G_landmark_positions.col(col_idx) = getLandmark_p_G_fi(db_landmark_id);
-    map_mutex->unlock();
+    if (map_lock.owns_lock()) {
+      map_lock.unlock();
+    }
 
     // Set the frame correspondence to the correct frame for multi-camera
     // systems. We do this for the single-camera case as well.
@@ -353,34 +528,53 @@ bool LoopClosureHandler::handleLoopClosure(
   query_landmark_to_map_landmark_pairs.resize(col_idx);
   measurement_camera_indices.resize(col_idx);
 
-  aslam::geometric_vision::PnpPoseEstimator pose_estimator(
-      FLAGS_lc_nonlinear_refinement_p3p, use_random_pnp_seed);
-  std::vector<int> inliers;
-  std::vector<double> inlier_distances_to_model;
-  int num_iters;
-
-  aslam::NCamera::ConstPtr ncamera = query_vertex_n_frame.getNCameraShared();
-  CHECK(ncamera != nullptr);
-  pose_estimator.absoluteMultiPoseRansacPinholeCam(
-      measurements, measurement_camera_indices, G_landmark_positions,
-      FLAGS_lc_ransac_pixel_sigma, FLAGS_lc_num_ransac_iters, ncamera,
-      T_G_I_ransac, &inliers, &inlier_distances_to_model, &num_iters);
-  CHECK_EQ(inliers.size(), inlier_distances_to_model.size());
-
-  KeypointToInlierIndexWithReprojectionErrorMap
-      keypoint_to_best_structure_match;
-  getBestStructureMatchForEveryKeypoint(
-      inliers, inlier_distances_to_model, structure_matches,
-      query_vertex_n_frame, &keypoint_to_best_structure_match);
-
-  CHECK_LE(keypoint_to_best_structure_match.size(), inliers.size());
-  *num_inliers = static_cast<int>(keypoint_to_best_structure_match.size());
+  // Inliers are counted once per query keypoint, so the number of matched
+  // query keypoints bounds the inlier count and ratio before RANSAC.
+  std::unordered_set<FrameKeypointIndexPair> matched_query_keypoints;
+  matched_query_keypoints.reserve(valid_matches);
+  for (const KeypointToLandmarkVector::value_type& keypoint_to_landmark :
+       query_keypoint_idx_to_map_landmark_pairs) {
+    matched_query_keypoints.insert(keypoint_to_landmark.first);
+  }
+  const int max_num_inliers = static_cast<int>(matched_query_keypoints.size());
+  if (max_num_inliers < FLAGS_lc_min_inlier_count ||
+      static_cast<double>(max_num_inliers) / valid_matches <
+          FLAGS_lc_min_inlier_ratio) {
+    VLOG(2) << "Bailing out because too few distinct query keypoints. "
+            << "(#keypoints: " << max_num_inliers
+            << ", #valid matches: " << valid_matches << ")";
+    statistics::StatsCollector stats(
+        "LC bailed because too few distinct query keypoints.");
+    stats.IncrementOne();
+    return false;
+  }
 
-  VLOG(3) << "\tnum_inliers " << *num_inliers << " num iters " << num_iters;
+  PnpRansacResult ransac_result;
+  {
+    MAPLAB_TRACE_SCOPE("loop_closure", "ransac");
+    runPnpRansac(
+        measurements, measurement_camera_indices, G_landmark_positions,
+        structure_matches, query_vertex_n_frame, use_random_pnp_seed,
+        &ransac_result);
+  }
+  estimate->T_G_I_ransac = ransac_result.T_G_I;
+  estimate->inliers = ransac_result.inliers;
+  const int num_iters = ransac_result.num_iters;
+  const KeypointToInlierIndexWithReprojectionErrorMap&
+      keypoint_to_best_structure_match =
+          ransac_result.keypoint_to_best_structure_match;
+
+  CHECK_LE(
+      keypoint_to_best_structure_match.size(), estimate->inliers.size());
+  estimate->num_inliers =
+      static_cast<int>(keypoint_to_best_structure_match.size());
+
+  VLOG(3) << "\tnum_inliers " << estimate->num_inliers << " num iters "
+          << num_iters;
   statistics::StatsCollector stats_inlier_count("LC RANSAC inliers");
-  stats_inlier_count.AddSample(*num_inliers);
+  stats_inlier_count.AddSample(estimate->num_inliers);
 
-  if (*num_inliers < FLAGS_lc_min_inlier_count) {
+  if (estimate->num_inliers < FLAGS_lc_min_inlier_count) {
     statistics::StatsCollector stats("LC too few RANSAC inliers");
     stats.IncrementOne();
 
@@ -392,26 +586,27 @@ bool LoopClosureHandler::handleLoopClosure(
   stats.IncrementOne();
 
   CHECK_GT(G_landmark_positions.cols(), 0);
-  *inlier_ratio = static_cast<double>(*num_inliers) /
-                  static_cast<double>(G_landmark_positions.cols());
-  VLOG(4) << "\tinlier_ratio " << *inlier_ratio;
+  estimate->inlier_ratio = static_cast<double>(estimate->num_inliers) /
+                           static_cast<double>(G_landmark_positions.cols());
+  VLOG(4) << "\tinlier_ratio " << estimate->inlier_ratio;
 
   statistics::StatsCollector stats_inlier_ratio("LC RANSAC inlier ratio");
-  stats_inlier_ratio.AddSample(*inlier_ratio);
+  stats_inlier_ratio.AddSample(estimate->inlier_ratio);
 
-  if (*inlier_ratio < FLAGS_lc_min_inlier_ratio) {
+  if (estimate->inlier_ratio < FLAGS_lc_min_inlier_ratio) {
     statistics::StatsCollector statistics_ransac_fail_inlier_ratio(
         "LC ransac fail inlier_ratio");
-    statistics_ransac_fail_inlier_ratio.AddSample(*inlier_ratio);
+    statistics_ransac_fail_inlier_ratio.AddSample(estimate->inlier_ratio);
     statistics::StatsCollector statistics_ransac_fail_num_inliers(
         "LC ransac fail num_inliers");
-    statistics_ransac_fail_num_inliers.AddSample(*num_inliers);
+    statistics_ransac_fail_num_inliers.AddSample(estimate->num_inliers);
     return false;
   }
 
   Eigen::Matrix3Xd landmark_positions;
-  landmark_positions.resize(Eigen::NoChange, *num_inliers);
-  inlier_structure_matches->resize(static_cast<size_t>(*num_inliers));
+  landmark_positions.resize(Eigen::NoChange, estimate->num_inliers);
+  estimate->inlier_structure_matches.resize(
+      static_cast<size_t>(estimate->num_inliers));
 
   int inlier_sequential_idx = 0;
   for (const KeypointToInlierIndexWithReprojectionErrorMap::value_type&
@@ -423,23 +618,34 @@ bool LoopClosureHandler::handleLoopClosure(
     CHECK_LT(inlier_index, G_landmark_positions.cols());
     landmark_positions.block<3, 1>(0, inlier_sequential_idx) =
         G_landmark_positions.block<3, 1>(0, inlier_index);
-    (*inlier_structure_matches)[inlier_sequential_idx] =
+    estimate->inlier_structure_matches[inlier_sequential_idx] =
         structure_matches[inlier_index];
     ++inlier_sequential_idx;
   }
 
   statistics::StatsCollector statistics_ransac_success_inlier_ratio(
       "LC ransac success inlier_ratio");
-  statistics_ransac_success_inlier_ratio.AddSample(*inlier_ratio);
+  statistics_ransac_success_inlier_ratio.AddSample(estimate->inlier_ratio);
   statistics::StatsCollector statistics_ransac_success_num_inliers(
       "LC ransac success num_inliers");
-  statistics_ransac_success_num_inliers.AddSample(*num_inliers);
+  statistics_ransac_success_num_inliers.AddSample(estimate->num_inliers);
   VLOG(10) << "Found loop-closure for query vertex "
            << query_vertex_id.hexString();
+  return true;
+}
+
+void LoopClosureHandler::applyLoopClosure(
+    const LoopClosureEstimate& estimate,
+    const pose_graph::VertexId& query_vertex_id,
+    bool merge_matching_landmarks, bool add_loopclosure_edges,
+    MergedLandmark3dPositionVector* landmark_pairs_merged,
+    pose_graph::VertexId* vertex_id_closest_to_structure_matches) const {
+  CHECK_NOTNULL(landmark_pairs_merged);
+  // Note: vertex_id_closest_to_structure_matches is optional and may be NULL.
+  CHECK(!merge_matching_landmarks || !add_loopclosure_edges);
 
   if (merge_matching_landmarks) {
     CHECK_NOTNULL(map_);
-    std::lock_guard<std::mutex> map_lock(*map_mutex);
 
     // This case should be only handled if a valid query_vertex_id is
     // provided.
@@ -449,7 +655,8 @@ bool LoopClosureHandler::handleLoopClosure(
 
     // Also reassociates keypoints of the query frame.
     mergeLandmarks(
-        inliers, query_landmark_to_map_landmark_pairs, landmark_pairs_merged);
+        estimate.inliers, estimate.query_landmark_to_map_landmark_pairs,
+        landmark_pairs_merged);
 
     // Some of the query frame keypoints may have invalid landmark ids
     // (which means the landmark object don't exist right now), but they
@@ -457,7 +664,8 @@ bool LoopClosureHandler::handleLoopClosure(
     // separately, as it's not true landmark merge.
     vi_map::Vertex& query_vertex = map_->getVertex(query_vertex_id);
     updateQueryKeyframeInvalidLandmarkAssociations(
-        inliers, query_keypoint_idx_to_map_landmark_pairs, &query_vertex);
+        estimate.inliers, estimate.query_keypoint_idx_to_map_landmark_pairs,
+        &query_vertex);
   }
   vi_map::LandmarkIdSet commonly_observed_landmarks;
   if (vertex_id_closest_to_structure_matches != nullptr) {
@@ -467,21 +675,21 @@ bool LoopClosureHandler::handleLoopClosure(
         << "too.";
     *vertex_id_closest_to_structure_matches =
         vi_map_helpers::getVertexIdWithMostOverlappingLandmarks(
-            query_vertex_id, *inlier_structure_matches, *map_,
+            query_vertex_id, estimate.inlier_structure_matches, *map_,
             &commonly_observed_landmarks);
     CHECK(vertex_id_closest_to_structure_matches->isValid());
   }
   if (add_loopclosure_edges) {
     CHECK(!merge_matching_landmarks);
     if (query_vertex_id.isValid() && map_ != nullptr) {
-      if (*inlier_ratio >= FLAGS_lc_edge_min_inlier_ratio &&
-          *num_inliers >= FLAGS_lc_edge_min_inlier_count) {
+      if (estimate.inlier_ratio >= FLAGS_lc_edge_min_inlier_ratio &&
+          estimate.num_inliers >= FLAGS_lc_edge_min_inlier_count) {
         pose_graph::VertexId lc_edge_target_vertex_id;
         if (vertex_id_closest_to_structure_matches == nullptr) {
           CHECK(commonly_observed_landmarks.empty());
           lc_edge_target_vertex_id =
               vi_map_helpers::getVertexIdWithMostOverlappingLandmarks(
-                  query_vertex_id, *inlier_structure_matches, *map_,
+                  query_vertex_id, estimate.inlier_structure_matches, *map_,
                   &commonly_observed_landmarks);
         } else {
           // vertex_id_closest_to_structure_matches was already retrieved
@@ -490,18 +698,15 @@ bool LoopClosureHandler::handleLoopClosure(
         }
         CHECK(lc_edge_target_vertex_id.isValid());
         CHECK(!commonly_observed_landmarks.empty());
-        std::lock_guard<std::mutex> map_lock(*map_mutex);
         addLoopClosureEdge(
             query_vertex_id, commonly_observed_landmarks,
-            lc_edge_target_vertex_id, *T_G_I_ransac, map_);
+            lc_edge_target_vertex_id, estimate.T_G_I_ransac, map_);
       }
     }
   }
 
-  VLOG(4) << "\transac success. Ransac pts: " << G_landmark_positions.cols()
-          << " inliers: " << inliers.size()
-          << " inlier ratio: " << *inlier_ratio << '.';
-  return true;
+  VLOG(4) << "\transac success. Inliers: " << estimate.inliers.size()
+          << " inlier ratio: " << estimate.inlier_ratio << '.';
 }
 
 void LoopClosureHandler::updateQueryKeyframeInvalidLandmarkAssociations(
@@ -612,7 +817,12 @@ void LoopClosureHandler::mergeLandmarks(
           map_->getLandmark_G_p_fi(map_landmark);
 
       stats_total_merge_calls.IncrementOne();
-      map_->mergeLandmarks(query_landmark_to_be_deleted, map_landmark);
+      if (landmark_merges_to_apply_ != nullptr) {
+        landmark_merges_to_apply_->emplace(
+            query_landmark_to_be_deleted, map_landmark);
+      } else {
+        map_->mergeLandmarks(query_landmark_to_be_deleted, map_landmark);
+      }
 
       landmark_pairs_actually_merged->emplace_back(
           p_G_landmark_query, p_G_landmark_map);
@@ -1,9 +1,12 @@
 #include "loop-closure-handler/loop-detector-node.h"
 
 #include <algorithm>
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <sstream>  // NOLINT
 #include <string>
+#include <vector>
 
 #include <Eigen/Geometry>
 #include <aslam/common/statistics/statistics.h>
@@ -18,11 +21,16 @@
 #include <maplab-common/multi-threaded-progress-bar.h>
 #include <maplab-common/parallel-process.h>
 #include <maplab-common/file-system-tools.h>
+#include <maplab-common/memory-budget.h>
 #include <maplab-common/progress-bar.h>
+#include <maplab-common/tracing.h>
 #include <matching-based-loopclosure/detector-settings.h>
 #include <matching-based-loopclosure/loop-detector-interface.h>
+#include <matching-based-loopclosure/loop-detector-serializer.h>
 #include <matching-based-loopclosure/matching-based-engine.h>
 #include <matching-based-loopclosure/scoring.h>
+#include <matching-based-loopclosure/sharded-loop-detector.h>
+#include <vi-map-helpers/spatial-database.h>
 #include <vi-map/landmark-quality-metrics.h>
 
 #include "loop-closure-handler/loop-closure-handler.h"
@@ -33,19 +41,52 @@ DEFINE_bool(
     "If underconstrained landmarks should be filtered for the "
     "loop-closure.");
 DEFINE_bool(lc_use_random_pnp_seed, true, "Use random seed for pnp RANSAC.");
+DEFINE_int32(
+    lc_num_database_shards, 1,
+    "Number of shards the loop-closure database is split into. Missions are "
+    "assigned to shards by their hash and queries are sent to all shards in "
+    "parallel. Each shard is stored in its own binary file.");
+DEFINE_bool(
+    lc_use_pose_prior, false,
+    "Only match query vertices against database vertices within "
+    "--lc_pose_prior_radius_m of their position. Only applied if all "
+    "missions of the map have a known baseframe, i.e. their poses are "
+    "trustworthy, e.g. from GPS or a previous anchoring.");
+DEFINE_double(
+    lc_pose_prior_radius_m, 30.0,
+    "Search radius around the query vertex if --lc_use_pose_prior is set.");
 
 namespace loop_detector_node {
 LoopDetectorNode::LoopDetectorNode()
     : use_random_pnp_seed_(FLAGS_lc_use_random_pnp_seed) {
   matching_based_loopclosure::MatchingBasedEngineSettings
       matching_engine_settings;
-  loop_detector_ =
-      std::make_shared<matching_based_loopclosure::MatchingBasedLoopDetector>(
-          matching_engine_settings);
+  CHECK_GT(FLAGS_lc_num_database_shards, 0);
+  if (FLAGS_lc_num_database_shards > 1) {
+    loop_detector_ =
+        std::make_shared<matching_based_loopclosure::ShardedLoopDetector>(
+            matching_engine_settings, FLAGS_lc_num_database_shards);
+  } else {
+    loop_detector_ =
+        std::make_shared<matching_based_loopclosure::MatchingBasedLoopDetector>(
+            matching_engine_settings);
+  }
+  if (FLAGS_lc_use_projected_descriptor_cache) {
+    projected_descriptor_cache_.reset(
+        new summary_map::ProjectedDescriptorCache(
+            [this](
+                const aslam::VisualFrame::DescriptorsT& descriptors,
+                Eigen::MatrixXf* projected_descriptors) {
+              loop_detector_->ProjectDescriptors(
+                  descriptors, projected_descriptors);
+            }));
+  }
 }
 
 const std::string LoopDetectorNode::serialization_filename_ =
     "loop_detector_node";
+const std::string LoopDetectorNode::binary_serialization_filename_ =
+    "loop_detector_node.bin";
 
 std::string LoopDetectorNode::printStatus() const {
   std::stringstream ss;
@@ -54,12 +95,23 @@ std::string LoopDetectorNode::printStatus() const {
     ss << "\tNum entries:" << loop_detector_->NumEntries() << std::endl;
     ss << "\tNum descriptors: " << loop_detector_->NumDescriptors()
        << std::endl;
+    common::MemoryUsage usage;
+    loop_detector_->GetMemoryUsage(&usage);
+    ss << "\tEstimated memory usage: "
+       << common::formatBytes(usage.getTotalBytes()) << std::endl;
   } else {
     ss << "\t NULL" << std::endl;
   }
   return ss.str();
 }
 
+void LoopDetectorNode::getMemoryUsage(common::MemoryUsage* usage) const {
+  CHECK_NOTNULL(usage);
+  if (loop_detector_ != nullptr) {
+    loop_detector_->GetMemoryUsage(usage);
+  }
+}
+
 bool LoopDetectorNode::convertFrameMatchesToConstraint(
     const loop_closure::FrameIdMatchesPair& query_frame_id_and_matches,
     vi_map::LoopClosureConstraint* constraint_ptr) const {
@@ -135,6 +187,8 @@ void LoopDetectorNode::convertFrameToProjectedImageOnlyUsingProvidedLandmarkIds(
       original_descriptors.rows(), original_descriptors.cols());
   Eigen::Matrix2Xd valid_measurements(2, original_measurements.cols());
   vi_map::LandmarkIdList valid_landmark_ids(original_measurements.cols());
+  std::vector<int> valid_keypoint_indices;
+  valid_keypoint_indices.reserve(original_measurements.cols());
 
   int num_valid_landmarks = 0;
   for (int i = 0; i < original_measurements.cols(); ++i) {
@@ -167,6 +221,7 @@ void LoopDetectorNode::convertFrameToProjectedImageOnlyUsingProvidedLandmarkIds(
           original_measurements.col(i);
       valid_descriptors.col(num_valid_landmarks) = original_descriptors.col(i);
       valid_landmark_ids[num_valid_landmarks] = observed_landmark_ids[i];
+      valid_keypoint_indices.push_back(i);
       ++num_valid_landmarks;
     }
   }
@@ -185,14 +240,31 @@ void LoopDetectorNode::convertFrameToProjectedImageOnlyUsingProvidedLandmarkIds(
 
   projected_image->landmarks.swap(valid_landmark_ids);
   projected_image->measurements.swap(valid_measurements);
-  loop_detector_->ProjectDescriptors(
-      valid_descriptors, &projected_image->projected_descriptors);
+  if (projected_descriptor_cache_ != nullptr) {
+    // The cache holds the projection of all descriptors of the frame, of
+    // which the valid ones are selected.
+    Eigen::MatrixXf all_projected_descriptors;
+    projected_descriptor_cache_->getProjectedDescriptors(
+        map, frame_id, original_descriptors, &all_projected_descriptors);
+    Eigen::MatrixXf& projected_descriptors =
+        projected_image->projected_descriptors;
+    projected_descriptors.resize(
+        all_projected_descriptors.rows(), num_valid_landmarks);
+    for (int i = 0; i < num_valid_landmarks; ++i) {
+      projected_descriptors.col(i) =
+          all_projected_descriptors.col(valid_keypoint_indices[i]);
+    }
+  } else {
+    loop_detector_->ProjectDescriptors(
+        valid_descriptors, &projected_image->projected_descriptors);
+  }
 }
 
 void LoopDetectorNode::convertLocalizationFrameToProjectedImage(
     const aslam::VisualNFrame& nframe,
     const loop_closure::KeyframeId& keyframe_id,
     const bool skip_untracked_keypoints,
+    const std::vector<char>& is_keypoint_matched,
     const loop_closure::ProjectedImage::Ptr& projected_image,
     KeyframeToKeypointReindexMap* keyframe_to_keypoint_reindexing,
     vi_map::LandmarkIdList* observed_landmark_ids) const {
@@ -219,6 +291,10 @@ void LoopDetectorNode::convertLocalizationFrameToProjectedImage(
   const aslam::VisualFrame::DescriptorsT& original_descriptors =
       frame.getDescriptors();
   CHECK_EQ(original_measurements.cols(), original_descriptors.cols());
+  CHECK(
+      is_keypoint_matched.empty() ||
+      static_cast<int>(is_keypoint_matched.size()) ==
+          original_measurements.cols());
   const Eigen::VectorXi* frame_trackids = nullptr;
   if (frame.hasTrackIds()) {
     frame_trackids = &frame.getTrackIds();
@@ -237,6 +313,12 @@ void LoopDetectorNode::convertLocalizationFrameToProjectedImage(
         (*frame_trackids)(i) < 0) {
       continue;
     }
+    if (!is_keypoint_matched.empty() && is_keypoint_matched[i]) {
+      // The keypoint keeps its known match, which refers to its landmark id.
+      (*observed_landmark_ids)[i] =
+          common::createRandomId<vi_map::LandmarkId>();
+      continue;
+    }
 
     valid_measurements.col(num_valid_landmarks) = original_measurements.col(i);
     valid_descriptors.col(num_valid_landmarks) = original_descriptors.col(i);
@@ -309,9 +391,42 @@ void LoopDetectorNode::addVerticesToDatabase(
     const pose_graph::VertexIdList& vertex_ids, const vi_map::VIMap& map) {
   common::ProgressBar progress_bar(vertex_ids.size());
 
-  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
-    progress_bar.increment();
-    addVertexToDatabase(vertex_id, map);
+  // The descriptors of a paged map are loaded in batches, so that only a
+  // bounded amount of them is resident at any time.
+  constexpr size_t kNumVerticesPerDescriptorBatch = 256u;
+  // Rough memory of a keypoint in the database, i.e. its raw and projected
+  // descriptor and its index entries.
+  constexpr size_t kEstimatedDatabaseBytesPerKeypoint = 256u;
+  common::MemoryBudget& memory_budget = common::MemoryBudget::getInstance();
+  for (size_t batch_begin = 0u; batch_begin < vertex_ids.size();
+       batch_begin += kNumVerticesPerDescriptorBatch) {
+    const size_t batch_end = std::min(
+        batch_begin + kNumVerticesPerDescriptorBatch, vertex_ids.size());
+    if (memory_budget.hasBudget()) {
+      // Requested before loading the descriptors, so that the descriptor
+      // pager can page out the previous batches right away.
+      size_t num_keypoints = 0u;
+      for (size_t i = batch_begin; i < batch_end; ++i) {
+        const vi_map::Vertex& vertex = map.getVertex(vertex_ids[i]);
+        for (size_t frame_idx = 0u; frame_idx < vertex.numFrames();
+             ++frame_idx) {
+          if (vertex.isVisualFrameSet(frame_idx)) {
+            num_keypoints +=
+                vertex.getVisualFrame(frame_idx).getNumKeypointMeasurements();
+          }
+        }
+      }
+      memory_budget.requestMemory(
+          num_keypoints * kEstimatedDatabaseBytesPerKeypoint,
+          "loop detector database");
+    }
+    map.ensureDescriptorsLoaded(
+        pose_graph::VertexIdList(
+            vertex_ids.begin() + batch_begin, vertex_ids.begin() + batch_end));
+    for (size_t i = batch_begin; i < batch_end; ++i) {
+      progress_bar.increment();
+      addVertexToDatabase(vertex_ids[i], map);
+    }
   }
 }
 
@@ -319,13 +434,30 @@ void LoopDetectorNode::addLocalizationSummaryMapToDatabase(
     const summary_map::LocalizationSummaryMap& localization_summary_map) {
   CHECK(
       summary_maps_in_database_.emplace(localization_summary_map.id()).second);
+  addLocalizationSummaryMapObserversToDatabase(localization_summary_map, 0u);
+}
 
+void LoopDetectorNode::addAppendedLocalizationSummaryMapObserversToDatabase(
+    const summary_map::LocalizationSummaryMap& localization_summary_map,
+    const size_t first_observer_index) {
+  CHECK_GT(summary_maps_in_database_.count(localization_summary_map.id()), 0u)
+      << "The summary map " << localization_summary_map.id()
+      << " is not in the database yet.";
+  addLocalizationSummaryMapObserversToDatabase(
+      localization_summary_map, first_observer_index);
+}
+
+void LoopDetectorNode::addLocalizationSummaryMapObserversToDatabase(
+    const summary_map::LocalizationSummaryMap& localization_summary_map,
+    const size_t first_observer_index) {
   pose_graph::VertexIdList observer_ids;
   localization_summary_map.getAllObserverIds(&observer_ids);
 
   const Eigen::Matrix3Xf& G_observer_positions =
       localization_summary_map.GObserverPosition();
-  if (observer_ids.empty()) {
+  // The ids of a loaded summary map don't cover observers that were appended
+  // to it afterwards.
+  if (observer_ids.size() != static_cast<size_t>(G_observer_positions.cols())) {
     if (G_observer_positions.cols() > 0) {
       // Vertex ids were not stored in the summary map. Generating random ones.
       observer_ids.resize(G_observer_positions.cols());
@@ -336,6 +468,7 @@ void LoopDetectorNode::addLocalizationSummaryMapToDatabase(
       LOG(FATAL) << "No observers in the summary map found. Is it initialized?";
     }
   }
+  CHECK_LE(first_observer_index, observer_ids.size());
 
   std::vector<std::vector<int>> observer_observations;
   observer_observations.resize(observer_ids.size());
@@ -366,8 +499,8 @@ void LoopDetectorNode::addLocalizationSummaryMapToDatabase(
       observation_to_landmark_index =
           localization_summary_map.observationToLandmarkIndex();
 
-  for (size_t observer_idx = 0; observer_idx < observer_observations.size();
-       ++observer_idx) {
+  for (size_t observer_idx = first_observer_index;
+       observer_idx < observer_observations.size(); ++observer_idx) {
     std::shared_ptr<loop_closure::ProjectedImage> projected_image_ptr =
         std::make_shared<loop_closure::ProjectedImage>();
     loop_closure::ProjectedImage& projected_image = *projected_image_ptr;
@@ -449,6 +582,20 @@ bool LoopDetectorNode::findNFrameInSummaryMapDatabase(
     pose::Transformation* T_G_I, unsigned int* num_of_lc_matches,
     vi_map::VertexKeyPointToStructureMatchList* inlier_structure_matches)
     const {
+  const vi_map::VertexKeyPointToStructureMatchList kNoKnownStructureMatches;
+  return findNFrameInSummaryMapDatabase(
+      n_frame, skip_untracked_keypoints, localization_summary_map,
+      kNoKnownStructureMatches, T_G_I, num_of_lc_matches,
+      inlier_structure_matches);
+}
+
+bool LoopDetectorNode::findNFrameInSummaryMapDatabase(
+    const aslam::VisualNFrame& n_frame, const bool skip_untracked_keypoints,
+    const summary_map::LocalizationSummaryMap& localization_summary_map,
+    const vi_map::VertexKeyPointToStructureMatchList& known_structure_matches,
+    pose::Transformation* T_G_I, unsigned int* num_of_lc_matches,
+    vi_map::VertexKeyPointToStructureMatchList* inlier_structure_matches)
+    const {
   CHECK_NOTNULL(T_G_I);
   CHECK_NOTNULL(num_of_lc_matches);
   CHECK_NOTNULL(inlier_structure_matches);
@@ -462,8 +609,9 @@ bool LoopDetectorNode::findNFrameInSummaryMapDatabase(
   std::vector<vi_map::LandmarkIdList> query_vertex_observed_landmark_ids;
 
   findNearestNeighborMatchesForNFrame(
-      n_frame, skip_untracked_keypoints, &query_vertex_observed_landmark_ids,
-      num_of_lc_matches, &frame_matches_list);
+      n_frame, skip_untracked_keypoints, known_structure_matches,
+      &query_vertex_observed_landmark_ids, num_of_lc_matches,
+      &frame_matches_list);
 
   timing::Timer timer_compute_relative("lc compute absolute transform");
   constexpr bool kMergeLandmarks = false;
@@ -503,9 +651,11 @@ bool LoopDetectorNode::findNFrameInDatabase(
 
   std::vector<vi_map::LandmarkIdList> query_vertex_observed_landmark_ids;
 
+  const vi_map::VertexKeyPointToStructureMatchList kNoKnownStructureMatches;
   findNearestNeighborMatchesForNFrame(
-      n_frame, skip_untracked_keypoints, &query_vertex_observed_landmark_ids,
-      num_of_lc_matches, &frame_matches_list);
+      n_frame, skip_untracked_keypoints, kNoKnownStructureMatches,
+      &query_vertex_observed_landmark_ids, num_of_lc_matches,
+      &frame_matches_list);
 
   timing::Timer timer_compute_relative("lc compute absolute transform");
   constexpr bool kMergeLandmarks = false;
@@ -520,6 +670,7 @@ bool LoopDetectorNode::findNFrameInDatabase(
 
 void LoopDetectorNode::findNearestNeighborMatchesForNFrame(
     const aslam::VisualNFrame& n_frame, const bool skip_untracked_keypoints,
+    const vi_map::VertexKeyPointToStructureMatchList& known_structure_matches,
     std::vector<vi_map::LandmarkIdList>* query_vertex_observed_landmark_ids,
     unsigned int* num_of_lc_matches,
     loop_closure::FrameToMatches* frame_matches_list) const {
@@ -539,6 +690,19 @@ void LoopDetectorNode::findNearestNeighborMatchesForNFrame(
   KeyframeToKeypointReindexMap keyframe_to_keypoint_reindexing;
   keyframe_to_keypoint_reindexing.reserve(num_frames);
 
+  std::vector<std::vector<char>> is_keypoint_matched(num_frames);
+  for (const vi_map::VertexKeyPointToStructureMatch& known_match :
+       known_structure_matches) {
+    const size_t frame_idx = known_match.frame_index_query;
+    CHECK_LT(frame_idx, num_frames);
+    CHECK(n_frame.isFrameSet(frame_idx));
+    const size_t num_keypoints =
+        n_frame.getFrame(frame_idx).getNumKeypointMeasurements();
+    CHECK_LT(known_match.keypoint_index_query, num_keypoints);
+    is_keypoint_matched[frame_idx].resize(num_keypoints, false);
+    is_keypoint_matched[frame_idx][known_match.keypoint_index_query] = true;
+  }
+
   const pose_graph::VertexId query_vertex_id(
       common::createRandomId<pose_graph::VertexId>());
   for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
@@ -557,8 +721,13 @@ void LoopDetectorNode::findNearestNeighborMatchesForNFrame(
           std::make_shared<loop_closure::ProjectedImage>());
       convertLocalizationFrameToProjectedImage(
           n_frame, frame_ids.back(), skip_untracked_keypoints,
-          projected_image_ptr_list.back(), &keyframe_to_keypoint_reindexing,
+          is_keypoint_matched[frame_idx], projected_image_ptr_list.back(),
+          &keyframe_to_keypoint_reindexing,
           &(*query_vertex_observed_landmark_ids)[frame_idx]);
+      if (projected_image_ptr_list.back()->landmarks.empty()) {
+        // All keypoints of the frame are already matched.
+        projected_image_ptr_list.pop_back();
+      }
     }
   }
   timer_preprocess.Stop();
@@ -566,12 +735,12 @@ void LoopDetectorNode::findNearestNeighborMatchesForNFrame(
   loop_detector_->Find(
       projected_image_ptr_list, kParallelFindIfPossible, frame_matches_list);
 
-  // Correct the indices in case untracked keypoints were removed.
+  // Correct the indices in case untracked or matched keypoints were removed.
   // For the pose recovery with RANSAC, the keypoint indices of the frame are
   // decisive, not those stored in the projected image. Therefore, the
   // keypoint indices of the matches (inferred from the projected image) have to
   // be mapped back to the keypoint indices of the frame.
-  if (skip_untracked_keypoints) {
+  if (skip_untracked_keypoints || !known_structure_matches.empty()) {
     for (loop_closure::FrameToMatches::value_type& frame_matches :
          *frame_matches_list) {
       for (loop_closure::Match& match : frame_matches.second) {
@@ -587,6 +756,18 @@ void LoopDetectorNode::findNearestNeighborMatchesForNFrame(
     }
   }
 
+  for (const vi_map::VertexKeyPointToStructureMatch& known_match :
+       known_structure_matches) {
+    const loop_closure::KeyframeId frame_id(
+        query_vertex_id, known_match.frame_index_query);
+    loop_closure::Match match;
+    match.keypoint_id_query =
+        vi_map::KeypointIdentifier(frame_id, known_match.keypoint_index_query);
+    match.keyframe_id_result = known_match.frame_identifier_result;
+    match.landmark_result = known_match.landmark_result;
+    (*frame_matches_list)[frame_id].push_back(match);
+  }
+
   *num_of_lc_matches = loop_closure::getNumberOfMatches(*frame_matches_list);
 }
 
@@ -681,10 +862,12 @@ bool LoopDetectorNode::computeAbsoluteTransformFromFrameMatches(
   loop_closure_handler::LoopClosureHandler::MergedLandmark3dPositionVector
       landmark_pairs_merged;
   std::mutex map_mutex;
+  constexpr LandmarkToLandmarkMap* kApplyLandmarkMergesImmediately = nullptr;
   bool ransac_ok = handleLoopClosures(
       constraint, merge_landmarks, add_lc_edges, &num_inliers, &inlier_ratio,
       map, &T_G_I_ransac, inlier_constraints, &landmark_pairs_merged,
-      vertex_id_closest_to_structure_matches, &map_mutex);
+      vertex_id_closest_to_structure_matches, &map_mutex,
+      kApplyLandmarkMergesImmediately);
 
   statistics::StatsCollector stats_ransac_inliers(
       "LC AbsolutePoseRansacInliers");
@@ -757,30 +940,33 @@ bool LoopDetectorNode::computeAbsoluteTransformFromFrameMatches(
   return ransac_ok;
 }
 
-void LoopDetectorNode::queryVertexInDatabase(
-    const pose_graph::VertexId& query_vertex_id, const bool merge_landmarks,
-    const bool add_lc_edges, vi_map::VIMap* map,
-    vi_map::LoopClosureConstraint* raw_constraint,
-    vi_map::LoopClosureConstraint* inlier_constraint,
-    std::vector<double>* inlier_ratios,
-    aslam::TransformationVector* T_G_M2_vector,
-    loop_closure_handler::LoopClosureHandler::MergedLandmark3dPositionVector*
-        landmark_pairs_merged,
-    std::mutex* map_mutex) const {
-  CHECK_NOTNULL(map);
-  CHECK_NOTNULL(raw_constraint);
-  CHECK_NOTNULL(inlier_constraint);
-  CHECK_NOTNULL(inlier_ratios);
-  CHECK_NOTNULL(T_G_M2_vector);
-  CHECK_NOTNULL(landmark_pairs_merged);
-  CHECK_NOTNULL(map_mutex);
+bool LoopDetectorNode::canUsePosePrior(const vi_map::VIMap& map) const {
+  if (!summary_maps_in_database_.empty() || map.numVertices() < 2u) {
+    // Summary maps have no vertices to compare against.
+    return false;
+  }
+  // The database vertices may have been added from any mission of the map.
+  vi_map::MissionIdList mission_ids;
+  map.getAllMissionIds(&mission_ids);
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    if (!map.getMissionBaseFrameForMission(mission_id).is_T_G_M_known()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void LoopDetectorNode::projectQueryVertex(
+    const vi_map::VIMap& map, const pose_graph::VertexId& query_vertex_id,
+    const std::shared_ptr<const pose_graph::VertexIdSet>& candidate_vertex_ids,
+    loop_closure::ProjectedImagePtrList* projected_image_ptr_list) const {
+  MAPLAB_TRACE_SCOPE("loop_closure", "project vertex");
+  CHECK_NOTNULL(projected_image_ptr_list)->clear();
   CHECK(query_vertex_id.isValid());
 
-  map_mutex->lock();
-  const vi_map::Vertex& query_vertex = map->getVertex(query_vertex_id);
+  const vi_map::Vertex& query_vertex = map.getVertex(query_vertex_id);
   const size_t num_frames = query_vertex.numFrames();
-  loop_closure::ProjectedImagePtrList projected_image_ptr_list;
-  projected_image_ptr_list.reserve(num_frames);
+  projected_image_ptr_list->reserve(num_frames);
 
   for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
     if (query_vertex.isVisualFrameSet(frame_idx) &&
@@ -795,62 +981,17 @@ void LoopDetectorNode::queryVertexInDatabase(
       std::vector<vi_map::LandmarkId> observed_landmark_ids;
       query_vertex.getFrameObservedLandmarkIds(frame_idx,
                                                &observed_landmark_ids);
-      projected_image_ptr_list.push_back(
+      projected_image_ptr_list->push_back(
           std::make_shared<loop_closure::ProjectedImage>());
       const vi_map::VisualFrameIdentifier query_frame_id(
           query_vertex_id, frame_idx);
       constexpr bool kSkipInvalidLandmarkIds = false;
       convertFrameToProjectedImage(
-          *map, query_frame_id, query_vertex.getVisualFrame(frame_idx),
+          map, query_frame_id, query_vertex.getVisualFrame(frame_idx),
           observed_landmark_ids, query_vertex.getMissionId(),
-          kSkipInvalidLandmarkIds, projected_image_ptr_list.back().get());
-    }
-  }
-  map_mutex->unlock();
-
-  loop_closure::FrameToMatches frame_matches;
-  // Do not parallelize if the current function is running in multiple
-  // threads to avoid decrease in performance.
-  constexpr bool kParallelFindIfPossible = false;
-  loop_detector_->Find(
-      projected_image_ptr_list, kParallelFindIfPossible, &frame_matches);
-
-  if (!frame_matches.empty()) {
-    for (const loop_closure::FrameIdMatchesPair& id_and_matches :
-         frame_matches) {
-      vi_map::LoopClosureConstraint tmp_constraint;
-      const bool conversion_success =
-          convertFrameMatchesToConstraint(id_and_matches, &tmp_constraint);
-      if (!conversion_success) {
-        continue;
-      }
-      raw_constraint->query_vertex_id = tmp_constraint.query_vertex_id;
-      raw_constraint->structure_matches.insert(
-          raw_constraint->structure_matches.end(),
-          tmp_constraint.structure_matches.begin(),
-          tmp_constraint.structure_matches.end());
-    }
-
-    int num_inliers = 0;
-    double inlier_ratio = 0.0;
-
-    // The estimated transformation of this vertex to the map.
-    pose::Transformation T_G_I_ransac;
-    constexpr pose_graph::VertexId* kVertexIdClosestToStructureMatches =
-        nullptr;
-    bool ransac_ok = handleLoopClosures(
-        *raw_constraint, merge_landmarks, add_lc_edges, &num_inliers,
-        &inlier_ratio, map, &T_G_I_ransac, inlier_constraint,
-        landmark_pairs_merged, kVertexIdClosestToStructureMatches, map_mutex);
-
-    if (ransac_ok && inlier_ratio != 0.0) {
-      map_mutex->lock();
-      const pose::Transformation& T_M_I = query_vertex.get_T_M_I();
-      const pose::Transformation T_G_M2 = T_G_I_ransac * T_M_I.inverse();
-      map_mutex->unlock();
-
-      T_G_M2_vector->push_back(T_G_M2);
-      inlier_ratios->push_back(inlier_ratio);
+          kSkipInvalidLandmarkIds, projected_image_ptr_list->back().get());
+      projected_image_ptr_list->back()->candidate_vertex_ids =
+          candidate_vertex_ids;
     }
   }
 }
@@ -886,6 +1027,10 @@ void LoopDetectorNode::detectLoopClosuresVerticesToDatabase(
   *num_vertex_candidate_links = 0;
   *summary_landmark_match_inlier_ratio = 0.0;
 
+  // Only the descriptors of the query vertices are needed, the database holds
+  // its own projected copies.
+  map->ensureDescriptorsLoaded(vertices);
+
   if (VLOG_IS_ON(1)) {
     std::ostringstream ss;
     for (const MissionId mission : missions_in_database_) {
@@ -897,71 +1042,205 @@ void LoopDetectorNode::detectLoopClosuresVerticesToDatabase(
   std::vector<double> inlier_ratios;
   aslam::TransformationVector T_G_M_vector;
 
-  std::mutex map_mutex;
-  std::mutex output_mutex;
-
-  loop_closure_handler::LoopClosureHandler::MergedLandmark3dPositionVector
-      landmark_pairs_merged;
+  using loop_closure_handler::LoopClosureHandler;
+  LoopClosureHandler::MergedLandmark3dPositionVector landmark_pairs_merged;
   vi_map::LoopClosureConstraintVector raw_constraints;
-
-  // Then search for all in the database.
-  common::MultiThreadedProgressBar progress_bar;
-
-  std::function<void(const std::vector<size_t>&)> query_helper = [&](
-      const std::vector<size_t>& range) {
-    int num_processed = 0;
-    progress_bar.setNumElements(range.size());
-    for (const size_t job_index : range) {
-      const pose_graph::VertexId& query_vertex_id = vertices[job_index];
-      progress_bar.update(++num_processed);
-
-      // Allocate local buffers to avoid locking.
-      vi_map::LoopClosureConstraint raw_constraint_local;
-      vi_map::LoopClosureConstraint inlier_constraint_local;
-      using loop_closure_handler::LoopClosureHandler;
-      LoopClosureHandler::MergedLandmark3dPositionVector
-          landmark_pairs_merged_local;
-      std::vector<double> inlier_ratios_local;
-      aslam::TransformationVector T_G_M2_vector_local;
-
-      // Perform the actual query.
-      queryVertexInDatabase(
-          query_vertex_id, merge_landmarks, add_lc_edges, map,
-          &raw_constraint_local, &inlier_constraint_local, &inlier_ratios_local,
-          &T_G_M2_vector_local, &landmark_pairs_merged_local, &map_mutex);
-
-      // Lock the output buffers and transfer results.
-      {
-        std::unique_lock<std::mutex> lock_output(output_mutex);
-        if (raw_constraint_local.query_vertex_id.isValid()) {
-          raw_constraints.push_back(raw_constraint_local);
-        }
-        if (inlier_constraint_local.query_vertex_id.isValid()) {
-          inlier_constraints->push_back(inlier_constraint_local);
-        }
-
-        landmark_pairs_merged.insert(
-            landmark_pairs_merged.end(), landmark_pairs_merged_local.begin(),
-            landmark_pairs_merged_local.end());
-        inlier_ratios.insert(
-            inlier_ratios.end(), inlier_ratios_local.begin(),
-            inlier_ratios_local.end());
-        T_G_M_vector.insert(
-            T_G_M_vector.end(), T_G_M2_vector_local.begin(),
-            T_G_M2_vector_local.end());
+  // The matched landmarks are merged at once after all queries, which is much
+  // faster than merging every pair right away.
+  LandmarkToLandmarkMap landmark_merges_to_apply;
+  LandmarkToLandmarkMap* landmark_merges_to_apply_ptr =
+      merge_landmarks ? &landmark_merges_to_apply : nullptr;
+  const LoopClosureHandler handler(
+      map, &landmark_id_old_to_new_, landmark_merges_to_apply_ptr);
+
+  // Restricts the candidates of every query to the database vertices around
+  // it, which saves the matching and RANSAC runs against distant places.
+  typedef vi_map_helpers::SpatialDatabase<pose_graph::VertexId>
+      VertexSpatialDatabase;
+  std::unique_ptr<VertexSpatialDatabase> spatial_database;
+  VertexSpatialDatabase::BatchQueryResult vertices_in_radius;
+  if (FLAGS_lc_use_pose_prior) {
+    CHECK_GT(FLAGS_lc_pose_prior_radius_m, 0.0);
+    if (canUsePosePrior(*map)) {
+      spatial_database.reset(
+          new VertexSpatialDatabase(
+              *map, Eigen::Vector3d::Constant(FLAGS_lc_pose_prior_radius_m)));
+      // Look up the candidates of all queries in one batch, such that the
+      // query threads don't need to lock the map for it.
+      Eigen::Matrix3Xd p_G_queries(3, vertices.size());
+      for (size_t vertex_idx = 0u; vertex_idx < vertices.size();
+           ++vertex_idx) {
+        p_G_queries.col(vertex_idx) =
+            map->getVertex_G_p_I(vertices[vertex_idx]);
       }
+      spatial_database->getObjectIdsInRadius(
+          p_G_queries, FLAGS_lc_pose_prior_radius_m, &vertices_in_radius);
+    } else {
+      LOG(WARNING) << "Not all missions have a known baseframe, the pose "
+                   << "prior is not used.";
     }
-  };
-
-  constexpr bool kAlwaysParallelize = true;
+  }
+  std::atomic<size_t> num_skipped_queries(0u);
+  common::ProgressBar progress_bar(vertices.size());
+
+  // The queries run as a pipeline of stages over batches of vertices. The
+  // projection of the query frames, the index queries and the RANSAC only
+  // read the map and the merge bookkeeping and run in parallel without
+  // locking. The query time per vertex depends strongly on the number of
+  // candidates, so the vertices are handed out dynamically to the threads.
+  // The last stage applies the results serially in the order of the
+  // vertices, i.e. updates the merge bookkeeping, reassociates the query
+  // keypoints and adds the loop-closure edges. The batches bound the memory
+  // of the projected images and matches that are in flight.
+  constexpr size_t kNumVerticesPerBatch = 1024u;
   const size_t num_threads = common::getNumHardwareThreads();
-
+  constexpr std::mutex* kNoMapMutex = nullptr;
   timing::Timer timing_mission_lc("lc query mission");
-  common::ParallelProcess(
-      vertices.size(), query_helper, kAlwaysParallelize, num_threads);
+  for (size_t batch_begin = 0u; batch_begin < vertices.size();
+       batch_begin += kNumVerticesPerBatch) {
+    const size_t batch_size =
+        std::min(kNumVerticesPerBatch, vertices.size() - batch_begin);
+
+    std::vector<loop_closure::ProjectedImagePtrList> projected_images(
+        batch_size);
+    common::ParallelProcessDynamic(
+        batch_size,
+        [&](size_t range_begin, size_t range_end) {
+          for (size_t idx = range_begin; idx < range_end; ++idx) {
+            const size_t vertex_idx = batch_begin + idx;
+            const pose_graph::VertexId& query_vertex_id = vertices[vertex_idx];
+            std::shared_ptr<const pose_graph::VertexIdSet>
+                candidate_vertex_ids;
+            if (spatial_database != nullptr) {
+              const pose_graph::VertexId* candidates_begin =
+                  vertices_in_radius.objectIdsOfQuery(vertex_idx);
+              std::shared_ptr<pose_graph::VertexIdSet>
+                  query_candidate_vertex_ids =
+                      std::make_shared<pose_graph::VertexIdSet>(
+                          candidates_begin,
+                          candidates_begin +
+                              vertices_in_radius.numObjectIdsOfQuery(
+                                  vertex_idx));
+              query_candidate_vertex_ids->erase(query_vertex_id);
+              if (query_candidate_vertex_ids->empty()) {
+                // There is nothing to match against around the vertex.
+                ++num_skipped_queries;
+                continue;
+              }
+              candidate_vertex_ids = query_candidate_vertex_ids;
+            }
+            projectQueryVertex(
+                *map, query_vertex_id, candidate_vertex_ids,
+                &projected_images[idx]);
+          }
+        },
+        num_threads);
+
+    // The index backends are safe for concurrent queries, so the frames of
+    // each vertex are queried in parallel as well if there are fewer
+    // vertices than threads.
+    const bool parallelize_find = batch_size < num_threads;
+    std::vector<loop_closure::FrameToMatches> frame_matches(batch_size);
+    common::ParallelProcessDynamic(
+        batch_size,
+        [&](size_t range_begin, size_t range_end) {
+          for (size_t idx = range_begin; idx < range_end; ++idx) {
+            loop_detector_->Find(
+                projected_images[idx], parallelize_find, &frame_matches[idx]);
+            projected_images[idx].clear();
+          }
+        },
+        num_threads);
+
+    vi_map::LoopClosureConstraintVector raw_constraints_batch(batch_size);
+    LoopClosureHandler::LoopClosureEstimateVector estimates(batch_size);
+    std::vector<char> is_estimate_valid(batch_size, false);
+    common::ParallelProcessDynamic(
+        batch_size,
+        [&](size_t range_begin, size_t range_end) {
+          for (size_t idx = range_begin; idx < range_end; ++idx) {
+            vi_map::LoopClosureConstraint& raw_constraint =
+                raw_constraints_batch[idx];
+            for (const loop_closure::FrameIdMatchesPair& id_and_matches :
+                 frame_matches[idx]) {
+              vi_map::LoopClosureConstraint tmp_constraint;
+              if (!convertFrameMatchesToConstraint(
+                      id_and_matches, &tmp_constraint)) {
+                continue;
+              }
+              raw_constraint.query_vertex_id = tmp_constraint.query_vertex_id;
+              raw_constraint.structure_matches.insert(
+                  raw_constraint.structure_matches.end(),
+                  tmp_constraint.structure_matches.begin(),
+                  tmp_constraint.structure_matches.end());
+            }
+            frame_matches[idx].clear();
+            if (!raw_constraint.query_vertex_id.isValid()) {
+              continue;
+            }
+
+            const vi_map::Vertex& query_vertex =
+                map->getVertex(raw_constraint.query_vertex_id);
+            std::vector<vi_map::LandmarkIdList> query_vertex_landmark_ids;
+            query_vertex.getAllObservedLandmarkIds(&query_vertex_landmark_ids);
+            is_estimate_valid[idx] = handler.estimateLoopClosure(
+                query_vertex.getVisualNFrame(), query_vertex_landmark_ids,
+                raw_constraint.query_vertex_id,
+                raw_constraint.structure_matches, kNoMapMutex,
+                use_random_pnp_seed_, &estimates[idx]);
+          }
+        },
+        num_threads);
+
+    for (size_t idx = 0u; idx < batch_size; ++idx) {
+      const vi_map::LoopClosureConstraint& raw_constraint =
+          raw_constraints_batch[idx];
+      if (!raw_constraint.query_vertex_id.isValid()) {
+        continue;
+      }
+      raw_constraints.push_back(raw_constraint);
+
+      const LoopClosureHandler::LoopClosureEstimate& estimate = estimates[idx];
+      vi_map::LoopClosureConstraint inlier_constraint;
+      inlier_constraint.query_vertex_id = raw_constraint.query_vertex_id;
+      inlier_constraint.structure_matches = estimate.inlier_structure_matches;
+      inlier_constraints->push_back(inlier_constraint);
+      if (!is_estimate_valid[idx]) {
+        continue;
+      }
+
+      constexpr pose_graph::VertexId* kVertexIdClosestToStructureMatches =
+          nullptr;
+      handler.applyLoopClosure(
+          estimate, raw_constraint.query_vertex_id, merge_landmarks,
+          add_lc_edges, &landmark_pairs_merged,
+          kVertexIdClosestToStructureMatches);
+
+      if (estimate.inlier_ratio != 0.0) {
+        const pose::Transformation& T_M_I =
+            map->getVertex(raw_constraint.query_vertex_id).get_T_M_I();
+        T_G_M_vector.push_back(estimate.T_G_I_ransac * T_M_I.inverse());
+        inlier_ratios.push_back(estimate.inlier_ratio);
+      }
+    }
+    progress_bar.update(batch_begin + batch_size);
+  }
   timing_mission_lc.Stop();
 
+  if (!landmark_merges_to_apply.empty()) {
+    timing::Timer timing_merge_landmarks("lc merge landmarks");
+    const size_t num_merged_landmarks =
+        map->mergeLandmarks(landmark_merges_to_apply);
+    timing_merge_landmarks.Stop();
+    VLOG(1) << "Merged " << num_merged_landmarks << " landmarks.";
+  }
+
   VLOG(1) << "Searched " << vertices.size() << " frames.";
+  if (spatial_database != nullptr) {
+    VLOG(1) << "Skipped " << num_skipped_queries.load()
+            << " vertices without other vertices within "
+            << FLAGS_lc_pose_prior_radius_m << " m.";
+  }
 
   // If the plotter object was assigned.
   if (visualizer_) {
@@ -1061,6 +1340,18 @@ void LoopDetectorNode::detectLoopClosuresAndMergeLandmarks(
       &T_G_M2, &inlier_constraints);
 
   VLOG(1) << "Handling loop closures done.";
+  saveProjectedDescriptorCache(map);
+}
+
+void LoopDetectorNode::saveProjectedDescriptorCache(vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  if (projected_descriptor_cache_ == nullptr) {
+    return;
+  }
+  VLOG(1) << "Projected descriptor cache: "
+          << projected_descriptor_cache_->numCacheHits() << " hits, "
+          << projected_descriptor_cache_->numCacheMisses() << " misses.";
+  projected_descriptor_cache_->saveToMap(map);
 }
 
 bool LoopDetectorNode::handleLoopClosures(
@@ -1071,7 +1362,8 @@ bool LoopDetectorNode::handleLoopClosures(
     loop_closure_handler::LoopClosureHandler::MergedLandmark3dPositionVector*
         landmark_pairs_merged,
     pose_graph::VertexId* vertex_id_closest_to_structure_matches,
-    std::mutex* map_mutex) const {
+    std::mutex* map_mutex,
+    LandmarkToLandmarkMap* landmark_merges_to_apply) const {
   CHECK_NOTNULL(num_inliers);
   CHECK_NOTNULL(inlier_ratio);
   CHECK_NOTNULL(map);
@@ -1081,7 +1373,7 @@ bool LoopDetectorNode::handleLoopClosures(
   CHECK_NOTNULL(map_mutex);
   // Note: vertex_id_closest_to_structure_matches is optional and may beb NULL.
   loop_closure_handler::LoopClosureHandler handler(
-      map, &landmark_id_old_to_new_);
+      map, &landmark_id_old_to_new_, landmark_merges_to_apply);
   return handler.handleLoopClosure(
       constraint, merge_landmarks, add_lc_edges, num_inliers, inlier_ratio,
       T_G_I_ransac, inlier_constraints, landmark_pairs_merged,
@@ -1094,6 +1386,8 @@ void LoopDetectorNode::instantiateVisualizer() {
 
 void LoopDetectorNode::clear() {
   loop_detector_->Clear();
+  missions_in_database_.clear();
+  summary_maps_in_database_.clear();
 }
 
 void LoopDetectorNode::serialize(
@@ -1105,6 +1399,7 @@ void LoopDetectorNode::serialize(
         CHECK_NOTNULL(proto_loop_detector_node->add_mission_ids()));
   }
 
+  loop_detector_->Flush();
   loop_detector_->serialize(
       proto_loop_detector_node->mutable_matching_based_loop_detector());
 }
@@ -1129,4 +1424,78 @@ const std::string& LoopDetectorNode::getDefaultSerializationFilename() {
   return serialization_filename_;
 }
 
+bool LoopDetectorNode::saveToBinaryFile(const std::string& file_path) const {
+  const std::shared_ptr<matching_based_loopclosure::ShardedLoopDetector>
+      sharded_loop_detector = std::dynamic_pointer_cast<
+          matching_based_loopclosure::ShardedLoopDetector>(loop_detector_);
+  if (sharded_loop_detector) {
+    sharded_loop_detector->Flush();
+    // Each shard only stores the missions that were assigned to it.
+    std::vector<vi_map::MissionIdSet> shard_missions(
+        sharded_loop_detector->numShards());
+    for (const vi_map::MissionId& mission_id : missions_in_database_) {
+      shard_missions[sharded_loop_detector->getShardIndex(mission_id)].insert(
+          mission_id);
+    }
+    for (size_t shard_idx = 0u; shard_idx < shard_missions.size();
+         ++shard_idx) {
+      if (!matching_based_loopclosure::MatchingBasedLoopDetectorSerializer::
+              saveToBinaryFile(
+                  sharded_loop_detector->getShard(shard_idx),
+                  shard_missions[shard_idx],
+                  matching_based_loopclosure::ShardedLoopDetector::
+                      getShardFilePath(file_path, shard_idx))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::shared_ptr<matching_based_loopclosure::MatchingBasedLoopDetector>
+      matching_based_loop_detector = std::dynamic_pointer_cast<
+          matching_based_loopclosure::MatchingBasedLoopDetector>(
+          loop_detector_);
+  CHECK(matching_based_loop_detector);
+  matching_based_loop_detector->Flush();
+  return matching_based_loopclosure::MatchingBasedLoopDetectorSerializer::
+      saveToBinaryFile(
+          *matching_based_loop_detector, missions_in_database_, file_path);
+}
+
+bool LoopDetectorNode::mapFromBinaryFile(const std::string& file_path) {
+  CHECK(missions_in_database_.empty() && summary_maps_in_database_.empty())
+      << "Only an empty loop detector node can be mapped from a file.";
+  const std::shared_ptr<matching_based_loopclosure::ShardedLoopDetector>
+      sharded_loop_detector = std::dynamic_pointer_cast<
+          matching_based_loopclosure::ShardedLoopDetector>(loop_detector_);
+  if (sharded_loop_detector) {
+    for (size_t shard_idx = 0u; shard_idx < sharded_loop_detector->numShards();
+         ++shard_idx) {
+      if (!matching_based_loopclosure::MatchingBasedLoopDetectorSerializer::
+              mapFromBinaryFile(
+                  matching_based_loopclosure::ShardedLoopDetector::
+                      getShardFilePath(file_path, shard_idx),
+                  &sharded_loop_detector->getShard(shard_idx),
+                  &missions_in_database_)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::shared_ptr<matching_based_loopclosure::MatchingBasedLoopDetector>
+      matching_based_loop_detector = std::dynamic_pointer_cast<
+          matching_based_loopclosure::MatchingBasedLoopDetector>(
+          loop_detector_);
+  CHECK(matching_based_loop_detector);
+  return matching_based_loopclosure::MatchingBasedLoopDetectorSerializer::
+      mapFromBinaryFile(
+          file_path, matching_based_loop_detector.get(),
+          &missions_in_database_);
+}
+
+const std::string& LoopDetectorNode::getDefaultBinarySerializationFilename() {
+  return binary_serialization_filename_;
+}
+
 }  // namespace loop_detector_node
@@ -17,6 +17,8 @@ static const std::string kMatchingLDInvertedMultiIndexString =
 static const std::string
     kMatchingLDInvertedMultiIndexProductQuantizationString =
         "inverted_multi_index_product_quantization";
+static const std::string kMatchingLDMultiIndexHashingString =
+    "multi_index_hashing";
 
 struct MatchingBasedEngineSettings {
   MatchingBasedEngineSettings();
@@ -31,6 +33,7 @@ struct MatchingBasedEngineSettings {
     kMatchingLDInvertedIndex,
     kMatchingLDInvertedMultiIndex,
     kMatchingLDInvertedMultiIndexProductQuantization,
+    kMatchingLDMultiIndexHashing,
   };
 
   void setKeyframeScoringFunctionType(
@@ -46,10 +49,21 @@ struct MatchingBasedEngineSettings {
   std::string projection_matrix_filename;
   std::string projected_quantizer_filename;
   int num_closest_words_for_nn_search;
+  // Only used by the product quantization engine: the number of candidates
+  // per neighbor that are re-ranked with exact distances, 0 disables it.
+  int pq_exact_re_ranking_factor;
+  // Only used by the multi-index hashing engine, which indexes the raw binary
+  // descriptors: the size of the hashed descriptor substrings and the maximal
+  // Hamming radius within which the substrings are probed.
+  int mih_num_substring_bytes;
+  int mih_max_substring_radius;
   double min_image_time_seconds;
   size_t min_verify_matches_num;
   float fraction_best_scores;
   int num_nearest_neighbors;
+  // Number of descriptors that are buffered in the delta segment before they
+  // are merged into the index in the background. 0 inserts directly.
+  size_t delta_segment_max_num_descriptors;
 };
 
 }  // namespace matching_based_loopclosure
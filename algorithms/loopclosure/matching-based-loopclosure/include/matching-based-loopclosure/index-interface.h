@@ -22,6 +22,9 @@ class IndexInterface {
   // The number of individual descriptors in the index.
   virtual int GetNumDescriptorsInIndex() const = 0;
 
+  // Estimated memory used by the stored descriptors and the quantization.
+  virtual size_t GetMemoryUsageBytes() const = 0;
+
   // Use the projection matrix specific to the used index to project the
   // binary descriptors to a lower dimensional, real valued space.
   virtual void ProjectDescriptors(
@@ -33,6 +36,9 @@ class IndexInterface {
 
   // Return the indices and distances of the num_neighbors closest descriptors
   // for every descriptor from the query_features matrix.
+  // Implementations must be safe for concurrent queries, such that the loop
+  // detector can query the frames of a vertex in parallel. Queries don't have
+  // to be safe concurrently with adding descriptors.
   virtual void GetNNearestNeighborsForFeatures(
       const Eigen::MatrixXf& query_features, int num_neighbors,
       Eigen::MatrixXi* indices, Eigen::MatrixXf* distances) const = 0;
@@ -13,6 +13,7 @@
 #include <matching-based-loopclosure/helpers.h>
 #include <matching-based-loopclosure/index-interface.h>
 #include <matching-based-loopclosure/inverted-index.h>
+#include <matching-based-loopclosure/vocabulary-cache.h>
 
 DECLARE_int32(lc_target_dimensionality);
 
@@ -61,15 +62,13 @@ class InvertedIndexInterface : public IndexInterface {
   InvertedIndexInterface(
       const std::string& quantizer_filename,
       int num_closest_words_for_nn_search) {
-    std::ifstream in(quantizer_filename, std::ios_base::binary);
-    CHECK(in.is_open()) << "Failed to read quantizer file from "
-                        << quantizer_filename;
+    vocabulary_ = VocabularyCache::getInstance()
+                      .getVocabulary<InvertedIndexVocabulary>(
+                          quantizer_filename);
 
-    vocabulary_.Load(&in);
-
-    const Eigen::MatrixXf& words_ = vocabulary_.words_;
+    const Eigen::MatrixXf& words_ = vocabulary_->words_;
     CHECK_GT(words_.cols(), 0);
-    CHECK_EQ(kTargetDimensionality, vocabulary_.target_dimensionality_);
+    CHECK_EQ(kTargetDimensionality, vocabulary_->target_dimensionality_);
 
     index_.reset(new Index(words_, num_closest_words_for_nn_search));
   }
@@ -78,6 +77,10 @@ class InvertedIndexInterface : public IndexInterface {
     return index_->GetNumDescriptorsInIndex();
   }
 
+  virtual size_t GetMemoryUsageBytes() const {
+    return index_->GetMemoryUsageBytes();
+  }
+
   virtual void Clear() {
     index_->Clear();
   }
@@ -152,8 +155,8 @@ class InvertedIndexInterface : public IndexInterface {
       Eigen::MatrixXf* projected_descriptors) const {
     CHECK_NOTNULL(projected_descriptors);
     internal::ProjectDescriptors(
-        descriptors, vocabulary_.projection_matrix_,
-        vocabulary_.target_dimensionality_, projected_descriptors);
+        descriptors, vocabulary_->projection_matrix_,
+        vocabulary_->target_dimensionality_, projected_descriptors);
   }
 
   virtual void ProjectDescriptors(
@@ -161,13 +164,13 @@ class InvertedIndexInterface : public IndexInterface {
       Eigen::MatrixXf* projected_descriptors) const {
     CHECK_NOTNULL(projected_descriptors);
     internal::ProjectDescriptors(
-        descriptors, vocabulary_.projection_matrix_,
-        vocabulary_.target_dimensionality_, projected_descriptors);
+        descriptors, vocabulary_->projection_matrix_,
+        vocabulary_->target_dimensionality_, projected_descriptors);
   }
 
  private:
   std::shared_ptr<Index> index_;
-  InvertedIndexVocabulary vocabulary_;
+  std::shared_ptr<const InvertedIndexVocabulary> vocabulary_;
 };
 }  // namespace loop_closure
 #endif  // MATCHING_BASED_LOOPCLOSURE_INVERTED_INDEX_INTERFACE_H_
@@ -14,6 +14,7 @@
 #include <aslam/common/memory.h>
 #include <glog/logging.h>
 #include <loopclosure-common/flags.h>
+#include <maplab-common/memory-accounting.h>
 #include <nabo/nabo.h>
 
 namespace loop_closure {
@@ -60,6 +61,22 @@ class InvertedIndex {
     return db_descriptors_.size();
   }
 
+  // Memory of the vocabulary and the database descriptors, the kd-tree over
+  // the words is not included.
+  inline size_t GetMemoryUsageBytes() const {
+    size_t num_bytes = common::getHeapBytes(words_) +
+                       common::getHeapBytes(word_index_map_) +
+                       common::getHeapBytes(db_descriptors_) +
+                       common::getHeapBytes(db_descriptor_indices_);
+    for (const DescriptorBucket& bucket : db_descriptors_) {
+      num_bytes += common::getHeapBytes(bucket);
+    }
+    for (const std::vector<int>& indices : db_descriptor_indices_) {
+      num_bytes += common::getHeapBytes(indices);
+    }
+    return num_bytes;
+  }
+
   // Clears the inverted index by removing all references to the database
   // descriptors stored in it. Does NOT remove the underlying quantization.
   inline void Clear() {
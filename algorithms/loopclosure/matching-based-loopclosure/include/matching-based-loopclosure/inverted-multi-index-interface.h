@@ -15,6 +15,7 @@
 #include "matching-based-loopclosure/helpers.h"
 #include "matching-based-loopclosure/index-interface.h"
 #include "matching-based-loopclosure/matching_based_loop_detector.pb.h"
+#include "matching-based-loopclosure/vocabulary-cache.h"
 
 DECLARE_int32(lc_target_dimensionality);
 
@@ -106,18 +107,16 @@ class InvertedMultiIndexInterface : public IndexInterface {
   InvertedMultiIndexInterface(
       const std::string& quantizer_filename,
       int num_closest_words_for_nn_search) {
-    std::ifstream in(quantizer_filename, std::ios_base::binary);
-    CHECK(in.is_open()) << "Failed to read quantizer file from "
-                        << quantizer_filename;
+    vocabulary_ =
+        VocabularyCache::getInstance()
+            .getVocabulary<InvertedMultiIndexVocabulary>(quantizer_filename);
 
-    vocabulary_.Load(&in);
-
-    const Eigen::MatrixXf& words_1 = vocabulary_.words_first_half_;
-    const Eigen::MatrixXf& words_2 = vocabulary_.words_second_half_;
+    const Eigen::MatrixXf& words_1 = vocabulary_->words_first_half_;
+    const Eigen::MatrixXf& words_2 = vocabulary_->words_second_half_;
     CHECK_GT(words_1.cols(), 0);
     CHECK_GT(words_2.cols(), 0);
 
-    CHECK_EQ(kSubSpaceDimensionality, vocabulary_.target_dimensionality_ / 2);
+    CHECK_EQ(kSubSpaceDimensionality, vocabulary_->target_dimensionality_ / 2);
 
     index_.reset(new Index(words_1, words_2, num_closest_words_for_nn_search));
   }
@@ -126,6 +125,10 @@ class InvertedMultiIndexInterface : public IndexInterface {
     return index_->GetNumDescriptorsInIndex();
   }
 
+  virtual size_t GetMemoryUsageBytes() const {
+    return index_->GetMemoryUsageBytes();
+  }
+
   virtual void Clear() {
     index_->Clear();
   }
@@ -166,11 +169,6 @@ class InvertedMultiIndexInterface : public IndexInterface {
       const Eigen::MatrixBase<DerivedQuery>& query_features, int num_neighbors,
       const Eigen::MatrixBase<DerivedIndices>& indices_const,
       const Eigen::MatrixBase<DerivedDistances>& distances_const) const {
-    Eigen::MatrixBase<DerivedIndices>& indices =
-        internal::CastConstEigenMatrixToNonConst(indices_const);
-    Eigen::MatrixBase<DerivedDistances>& distances =
-        internal::CastConstEigenMatrixToNonConst(distances_const);
-
     CHECK_EQ(indices_const.rows(), num_neighbors)
         << "The indices parameter must be pre-allocated to hold all results.";
     CHECK_EQ(distances_const.rows(), num_neighbors)
@@ -180,12 +178,9 @@ class InvertedMultiIndexInterface : public IndexInterface {
     CHECK_EQ(distances_const.cols(), query_features.cols())
         << "The distances parameter must be pre-allocated to hold all results.";
 
-    for (int i = 0; i < query_features.cols(); ++i) {
-      GetNNearestNeighbors(
-          query_features.template block<2 * kSubSpaceDimensionality, 1>(0, i),
-          num_neighbors, indices.block(0, i, num_neighbors, 1),
-          distances.block(0, i, num_neighbors, 1));
-    }
+    CHECK(index_ != nullptr);
+    index_->GetNNearestNeighborsForFeatures(
+        query_features, num_neighbors, indices_const, distances_const);
   }
 
   virtual void GetNNearestNeighborsForFeatures(
@@ -202,8 +197,8 @@ class InvertedMultiIndexInterface : public IndexInterface {
       Eigen::MatrixXf* projected_descriptors) const {
     CHECK_NOTNULL(projected_descriptors);
     internal::ProjectDescriptors(
-        descriptors, vocabulary_.projection_matrix_,
-        vocabulary_.target_dimensionality_, projected_descriptors);
+        descriptors, vocabulary_->projection_matrix_,
+        vocabulary_->target_dimensionality_, projected_descriptors);
   }
 
   virtual void ProjectDescriptors(
@@ -211,8 +206,8 @@ class InvertedMultiIndexInterface : public IndexInterface {
       Eigen::MatrixXf* projected_descriptors) const {
     CHECK_NOTNULL(projected_descriptors);
     internal::ProjectDescriptors(
-        descriptors, vocabulary_.projection_matrix_,
-        vocabulary_.target_dimensionality_, projected_descriptors);
+        descriptors, vocabulary_->projection_matrix_,
+        vocabulary_->target_dimensionality_, projected_descriptors);
   }
 
   void serialize(
@@ -235,7 +230,7 @@ class InvertedMultiIndexInterface : public IndexInterface {
 
  private:
   std::shared_ptr<Index> index_;
-  InvertedMultiIndexVocabulary vocabulary_;
+  std::shared_ptr<const InvertedMultiIndexVocabulary> vocabulary_;
 };
 
 using inverted_multi_index::InvertedMultiProductQuantizationIndex;
@@ -255,44 +250,47 @@ class InvertedMultiProductQuantizationIndexInterface : public IndexInterface {
 
   InvertedMultiProductQuantizationIndexInterface(
       const std::string& quantizer_filename,
-      int num_closest_words_for_nn_search) {
-    std::ifstream in(quantizer_filename, std::ios_base::binary);
-    CHECK(in.is_open()) << "Failed to read quantizer file from "
-                        << quantizer_filename;
-
-    vocabulary_.Load(&in);
+      int num_closest_words_for_nn_search, int exact_re_ranking_factor = 0) {
+    vocabulary_ = VocabularyCache::getInstance()
+                      .getVocabulary<InvertedMultiIndexProductVocabulary>(
+                          quantizer_filename);
 
-    const Eigen::MatrixXf& words_1 = vocabulary_.words_first_half_;
-    const Eigen::MatrixXf& words_2 = vocabulary_.words_second_half_;
+    const Eigen::MatrixXf& words_1 = vocabulary_->words_first_half_;
+    const Eigen::MatrixXf& words_2 = vocabulary_->words_second_half_;
 
     CHECK_GT(words_1.cols(), 0);
     CHECK_GT(words_2.cols(), 0);
 
-    int number_of_components = vocabulary_.number_of_components;
-    int number_of_centers = vocabulary_.number_of_centers;
+    int number_of_components = vocabulary_->number_of_components;
+    int number_of_centers = vocabulary_->number_of_centers;
     int number_of_dimensions_per_component =
-        vocabulary_.number_of_dimensions_per_component;
+        vocabulary_->number_of_dimensions_per_component;
     const Eigen::MatrixXf& quantizer_centers_1 =
-        vocabulary_.quantizer_centers_1;
+        vocabulary_->quantizer_centers_1;
     const Eigen::MatrixXf& quantizer_centers_2 =
-        vocabulary_.quantizer_centers_2;
+        vocabulary_->quantizer_centers_2;
 
     CHECK_EQ(number_of_components, kNumSubSpaceComponents);
     CHECK_EQ(number_of_centers, kNumCenters);
     CHECK_EQ(number_of_dimensions_per_component, kNumDimPerComp);
 
-    CHECK_EQ(kSubSpaceDimensionality, vocabulary_.target_dimensionality_ / 2);
+    CHECK_EQ(kSubSpaceDimensionality, vocabulary_->target_dimensionality_ / 2);
 
     index_.reset(
         new Index(
             words_1, words_2, quantizer_centers_1, quantizer_centers_2,
             num_closest_words_for_nn_search));
+    index_->SetExactReRankingFactor(exact_re_ranking_factor);
   }
 
   virtual int GetNumDescriptorsInIndex() const {
     return index_->GetNumDescriptorsInIndex();
   }
 
+  virtual size_t GetMemoryUsageBytes() const {
+    return index_->GetMemoryUsageBytes();
+  }
+
   virtual void Clear() {
     index_->Clear();
   }
@@ -368,8 +366,8 @@ class InvertedMultiProductQuantizationIndexInterface : public IndexInterface {
       Eigen::MatrixXf* projected_descriptors) const {
     CHECK_NOTNULL(projected_descriptors);
     internal::ProjectDescriptors(
-        descriptors, vocabulary_.projection_matrix_,
-        vocabulary_.target_dimensionality_, projected_descriptors);
+        descriptors, vocabulary_->projection_matrix_,
+        vocabulary_->target_dimensionality_, projected_descriptors);
   }
 
   virtual void ProjectDescriptors(
@@ -377,13 +375,13 @@ class InvertedMultiProductQuantizationIndexInterface : public IndexInterface {
       Eigen::MatrixXf* projected_descriptors) const {
     CHECK_NOTNULL(projected_descriptors);
     internal::ProjectDescriptors(
-        descriptors, vocabulary_.projection_matrix_,
-        vocabulary_.target_dimensionality_, projected_descriptors);
+        descriptors, vocabulary_->projection_matrix_,
+        vocabulary_->target_dimensionality_, projected_descriptors);
   }
 
  private:
   std::shared_ptr<Index> index_;
-  InvertedMultiIndexProductVocabulary vocabulary_;
+  std::shared_ptr<const InvertedMultiIndexProductVocabulary> vocabulary_;
 };
 
 }  // namespace loop_closure
@@ -1,7 +1,6 @@
 #ifndef MATCHING_BASED_LOOPCLOSURE_KD_TREE_INDEX_INTERFACE_H_
 #define MATCHING_BASED_LOOPCLOSURE_KD_TREE_INDEX_INTERFACE_H_
 #include <memory>
-#include <mutex>
 #include <string>
 #include <vector>
 
@@ -13,6 +12,7 @@
 #include <matching-based-loopclosure/helpers.h>
 #include <matching-based-loopclosure/index-interface.h>
 #include <matching-based-loopclosure/kd-tree-index.h>
+#include <matching-based-loopclosure/vocabulary-cache.h>
 
 DECLARE_int32(lc_target_dimensionality);
 namespace loop_closure {
@@ -23,10 +23,8 @@ class KDTreeIndexInterface : public IndexInterface {
   typedef KDTreeIndex<kTargetDimensionality> Index;
 
   explicit KDTreeIndexInterface(const std::string& projection_matrix_filepath) {
-    std::ifstream deserializer(projection_matrix_filepath);
-    CHECK(deserializer.is_open()) << "Cannot load projection matrix from file: "
-                                  << projection_matrix_filepath;
-    common::Deserialize(&projection_matrix_, &deserializer);
+    projection_matrix_ = VocabularyCache::getInstance().getProjectionMatrix(
+        projection_matrix_filepath);
 
     index_.reset(new Index());
   }
@@ -35,12 +33,15 @@ class KDTreeIndexInterface : public IndexInterface {
     return index_->GetNumDescriptorsInIndex();
   }
 
+  virtual size_t GetMemoryUsageBytes() const {
+    return index_->GetMemoryUsageBytes();
+  }
+
   virtual void Clear() {
     index_->Clear();
   }
   virtual void AddDescriptors(const Eigen::MatrixXf& descriptors) {
     CHECK_EQ(descriptors.rows(), kTargetDimensionality);
-    std::lock_guard<std::mutex> lock(index_mutex_);
     CHECK(index_ != nullptr);
     index_->AddDescriptors(descriptors);
   }
@@ -61,8 +62,6 @@ class KDTreeIndexInterface : public IndexInterface {
         << "The distances parameter must be pre-allocated to hold all results.";
 
     Eigen::MatrixXf query_feature_dyn = query_feature;
-
-    std::lock_guard<std::mutex> lock(index_mutex_);
     CHECK(index_ != nullptr);
     index_->GetNNearestNeighbors(
         query_feature_dyn, num_neighbors, indices_const, distances_const);
@@ -73,7 +72,6 @@ class KDTreeIndexInterface : public IndexInterface {
       Eigen::MatrixXi* indices, Eigen::MatrixXf* distances) const {
     CHECK_NOTNULL(indices);
     CHECK_NOTNULL(distances);
-    std::lock_guard<std::mutex> lock(index_mutex_);
     CHECK(index_ != nullptr);
     index_->GetNNearestNeighbors(
         query_features, num_neighbors, indices, distances);
@@ -87,7 +85,7 @@ class KDTreeIndexInterface : public IndexInterface {
 
     timing::Timer timer_proj("PL 1.1 project");
     descriptor_projection::ProjectDescriptorBlock(
-        descriptors, projection_matrix_, kTargetDimensionality,
+        descriptors, *projection_matrix_, kTargetDimensionality,
         projected_descriptors);
     timer_proj.Stop();
   }
@@ -100,15 +98,14 @@ class KDTreeIndexInterface : public IndexInterface {
 
     timing::Timer timer_proj("PL 1.1 project");
     descriptor_projection::ProjectDescriptorBlock(
-        descriptors, projection_matrix_, kTargetDimensionality,
+        descriptors, *projection_matrix_, kTargetDimensionality,
         projected_descriptors);
     timer_proj.Stop();
   }
 
  private:
   std::shared_ptr<Index> index_;
-  Eigen::MatrixXf projection_matrix_;
-  mutable std::mutex index_mutex_;
+  std::shared_ptr<const Eigen::MatrixXf> projection_matrix_;
 };
 }  // namespace loop_closure
 #endif  // MATCHING_BASED_LOOPCLOSURE_KD_TREE_INDEX_INTERFACE_H_
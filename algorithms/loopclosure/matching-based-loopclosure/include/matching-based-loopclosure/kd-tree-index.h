@@ -4,6 +4,8 @@
 #include <algorithm>
 #include <functional>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <queue>
 #include <tuple>
 #include <unordered_map>
@@ -14,6 +16,8 @@
 #include <aslam/common/memory.h>
 #include <descriptor-projection/flags.h>
 #include <glog/logging.h>
+#include <loopclosure-common/flags.h>
+#include <maplab-common/memory-accounting.h>
 #include <nabo/nabo.h>
 
 namespace loop_closure {
@@ -37,13 +41,14 @@ class KDTreeIndex {
   KDTreeIndex() {}
 
   inline void Clear() {
-    index_data_.resize(Eigen::NoChange, 0);
-    index_.reset();
+    std::lock_guard<std::mutex> lock(mutex_);
+    search_index_.reset();
     pending_descriptor_blocks_.clear();
   }
 
   inline int GetNumDescriptorsInIndex() const {
-    int num_descriptors = index_data_.cols();
+    std::lock_guard<std::mutex> lock(mutex_);
+    int num_descriptors = search_index_ ? search_index_->data.cols() : 0;
     for (const std::shared_ptr<Eigen::MatrixXf>& pending_block :
          pending_descriptor_blocks_) {
       num_descriptors += pending_block->cols();
@@ -51,52 +56,39 @@ class KDTreeIndex {
     return num_descriptors;
   }
 
+  // Memory of the indexed and pending descriptors, the kd-tree itself is not
+  // included.
+  inline size_t GetMemoryUsageBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t num_bytes =
+        search_index_ ? common::getHeapBytes(search_index_->data) : 0u;
+    for (const std::shared_ptr<Eigen::MatrixXf>& pending_block :
+         pending_descriptor_blocks_) {
+      num_bytes += common::getHeapBytes(*pending_block);
+    }
+    return num_bytes;
+  }
+
   // Adds descriptors to an internal waiting list. These descriptors will be
   // added on the next time the index is queried.
   void AddDescriptors(const DescriptorMatrixType& descriptors) {
+    std::lock_guard<std::mutex> lock(mutex_);
     pending_descriptor_blocks_.push_back(
         aligned_shared<Eigen::MatrixXf>(descriptors));
   }
 
+  // Builds a new kd-tree from the indexed and the pending descriptors. Queries
+  // that are still running keep using the previous kd-tree.
   void RefreshIndex() const {
-    if (pending_descriptor_blocks_.empty())
-      return;
-
-    int total_num_descriptors_to_add = 0;
-    for (const std::shared_ptr<Eigen::MatrixXf>& descriptor_block :
-         pending_descriptor_blocks_) {
-      CHECK(descriptor_block != nullptr);
-      total_num_descriptors_to_add += descriptor_block->cols();
-    }
-    int old_num_descriptors = index_data_.cols();
-    int new_num_descriptors =
-        total_num_descriptors_to_add + old_num_descriptors;
-
-    index_data_.conservativeResize(kDimVectors, new_num_descriptors);
-
-    int curr_offset = old_num_descriptors;
-    for (const std::shared_ptr<Eigen::MatrixXf>& descriptor_block :
-         pending_descriptor_blocks_) {
-      const DescriptorMatrixType& descriptors = *descriptor_block;
-      int num_descriptors = descriptors.cols();
-      index_data_.block(0, curr_offset, kDimVectors, num_descriptors) =
-          descriptors;
-      curr_offset += num_descriptors;
-    }
-
-    if (index_data_.cols() == 0) {
-      pending_descriptor_blocks_.clear();
-      index_.reset();
-      return;
-    }
-    index_.reset(
-        NNSearch::createKDTreeLinearHeap(
-            index_data_, kDimVectors, kCollectTouchStatistics));
-    pending_descriptor_blocks_.clear();
+    std::lock_guard<std::mutex> lock(mutex_);
+    RefreshIndexLocked();
   }
 
   // Finds the n nearest neighbors for a given query feature.
-  // This function is thread-safe.
+  // This function is thread-safe, concurrent queries only synchronize to get
+  // the current kd-tree and then search it in parallel. The kd-tree is const
+  // during the search and all search state lives on the stack of the calling
+  // thread.
   inline void GetNNearestNeighbors(
       const Eigen::MatrixXf& query_features, int num_neighbors,
       Eigen::MatrixXi* indices, Eigen::MatrixXf* distances) const {
@@ -108,23 +100,79 @@ class KDTreeIndex {
     CHECK_EQ(distances->rows(), num_neighbors)
         << "The distances parameter must be pre-allocated to hold all results.";
 
-    // Lazy refresh of the index if more data was added in the meantime.
-    RefreshIndex();
-    if (!index_) {
+    std::shared_ptr<const SearchIndex> search_index;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      // Lazy refresh of the index if more data was added in the meantime.
+      RefreshIndexLocked();
+      search_index = search_index_;
+    }
+    if (!search_index) {
       indices->setConstant(-1);
       distances->setConstant(std::numeric_limits<float>::infinity());
       LOG(WARNING) << "The kd-tree index is not available.";
       return;
     }
-    const NNSearch& index_ref = *index_;
-    index_ref.knn(
+    search_index->kd_tree->knn(
         query_features, *indices, *distances, num_neighbors, kSearchNNEpsilon,
         kSearchOptionsDefault, FLAGS_lc_knn_max_radius);
   }
 
  protected:
-  mutable std::shared_ptr<NNSearch> index_;
-  mutable Eigen::MatrixXf index_data_;
+  // The kd-tree references the descriptors it was built from, so both are
+  // replaced together.
+  struct SearchIndex {
+    Eigen::MatrixXf data;
+    std::unique_ptr<NNSearch> kd_tree;
+  };
+
+  void RefreshIndexLocked() const {
+    if (pending_descriptor_blocks_.empty())
+      return;
+
+    int total_num_descriptors_to_add = 0;
+    for (const std::shared_ptr<Eigen::MatrixXf>& descriptor_block :
+         pending_descriptor_blocks_) {
+      CHECK(descriptor_block != nullptr);
+      total_num_descriptors_to_add += descriptor_block->cols();
+    }
+    const int old_num_descriptors =
+        search_index_ ? search_index_->data.cols() : 0;
+    const int new_num_descriptors =
+        total_num_descriptors_to_add + old_num_descriptors;
+    if (new_num_descriptors == 0) {
+      pending_descriptor_blocks_.clear();
+      search_index_.reset();
+      return;
+    }
+
+    // The previous data is copied, queries might still be using it.
+    std::shared_ptr<SearchIndex> search_index = std::make_shared<SearchIndex>();
+    search_index->data.resize(kDimVectors, new_num_descriptors);
+    if (old_num_descriptors > 0) {
+      search_index->data.leftCols(old_num_descriptors) = search_index_->data;
+    }
+    int curr_offset = old_num_descriptors;
+    for (const std::shared_ptr<Eigen::MatrixXf>& descriptor_block :
+         pending_descriptor_blocks_) {
+      const DescriptorMatrixType& descriptors = *descriptor_block;
+      int num_descriptors = descriptors.cols();
+      search_index->data.block(0, curr_offset, kDimVectors, num_descriptors) =
+          descriptors;
+      curr_offset += num_descriptors;
+    }
+
+    search_index->kd_tree.reset(
+        NNSearch::createKDTreeLinearHeap(
+            search_index->data, kDimVectors, kCollectTouchStatistics));
+    search_index_ = search_index;
+    pending_descriptor_blocks_.clear();
+  }
+
+  // Guards the search index and the pending descriptors, but not the
+  // searches.
+  mutable std::mutex mutex_;
+  mutable std::shared_ptr<const SearchIndex> search_index_;
   mutable std::vector<std::shared_ptr<Eigen::MatrixXf> >
       pending_descriptor_blocks_;
 };
@@ -6,6 +6,7 @@
 
 #include <descriptor-projection/descriptor-projection.h>
 #include <loopclosure-common/types.h>
+#include <maplab-common/memory-accounting.h>
 
 #include "matching-based-loopclosure/helpers.h"
 #include "matching-based-loopclosure/matching_based_loop_detector.pb.h"
@@ -40,10 +41,17 @@ class LoopDetector {
       const loop_closure::DescriptorContainer& descriptors,
       Eigen::MatrixXf* projected_descriptors) const = 0;
 
+  // Makes all inserted images part of the descriptor index, e.g. before
+  // serializing the loop detector.
+  virtual void Flush() = 0;
+
   virtual void Clear() = 0;
   virtual size_t NumEntries() const = 0;
   virtual int NumDescriptors() const = 0;
 
+  // Adds the memory used by the database images and the descriptor index.
+  virtual void GetMemoryUsage(common::MemoryUsage* usage) const = 0;
+
   virtual void serialize(
       matching_based_loopclosure::proto::MatchingBasedLoopDetector*
           matching_based_loop_detector) const = 0;
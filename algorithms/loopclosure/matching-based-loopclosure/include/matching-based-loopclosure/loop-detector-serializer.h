@@ -0,0 +1,95 @@
+#ifndef MATCHING_BASED_LOOPCLOSURE_LOOP_DETECTOR_SERIALIZER_H_
+#define MATCHING_BASED_LOOPCLOSURE_LOOP_DETECTOR_SERIALIZER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <descriptor-projection/descriptor-projection.h>
+#include <loopclosure-common/types.h>
+#include <maplab-common/memory-mapped-file.h>
+#include <vi-map/unique-id.h>
+
+namespace matching_based_loopclosure {
+class MatchingBasedLoopDetector;
+
+// The database images and descriptor to keypoint assignments of a loop
+// detector, read directly from a memory-mapped binary file.
+class MappedLoopDetectorDatabase {
+ public:
+  struct KeyframeRecord {
+    uint64_t vertex_id[2];
+    uint64_t dataset_id[2];
+    int64_t timestamp_nanoseconds;
+    uint32_t frame_index;
+    uint32_t num_keypoints;
+    // Index of the first keypoint in the landmark and measurement sections.
+    uint64_t first_keypoint;
+  };
+  struct DescriptorRecord {
+    uint32_t keyframe_index;
+    uint32_t keypoint_index;
+  };
+
+  size_t numKeyframes() const {
+    return num_keyframes_;
+  }
+  size_t numDescriptors() const {
+    return num_descriptors_;
+  }
+
+  void getKeyframeId(
+      size_t keyframe_index, loop_closure::KeyframeId* keyframe_id) const;
+
+  // Returns the keypoint of a database descriptor, together with the
+  // timestamp and dataset of its image and the observed landmark.
+  void getKeypoint(
+      int descriptor_index, loop_closure::KeypointId* keypoint_id,
+      int64_t* timestamp_nanoseconds, loop_closure::DatasetId* dataset_id,
+      loop_closure::PointLandmarkId* landmark_id) const;
+
+  // Returns a database image as it is stored by the loop detector, i.e.
+  // without projected descriptors.
+  void getProjectedImage(
+      size_t keyframe_index,
+      loop_closure::ProjectedImage* projected_image) const;
+
+ private:
+  friend class MatchingBasedLoopDetectorSerializer;
+
+  std::shared_ptr<const common::MemoryMappedFile> mapped_file_;
+  const KeyframeRecord* keyframes_ = nullptr;
+  size_t num_keyframes_ = 0u;
+  const DescriptorRecord* descriptors_ = nullptr;
+  size_t num_descriptors_ = 0u;
+  // Two entries per keypoint each.
+  const uint64_t* landmark_ids_ = nullptr;
+  const double* measurements_ = nullptr;
+};
+
+// Saves a loop detector using the inverted multi-index in a binary layout,
+// which can be memory-mapped instead of parsed. The file contains the words,
+// the inverted files, the database images and the descriptor to keypoint
+// assignments as raw, aligned sections. When mapping it, the inverted files
+// and the database are read in place, so loading only needs to rebuild the
+// small word and keyframe maps and the pages are shared between all processes
+// that map the same file. The first insertion into a mapped detector copies
+// the mapped data into the regular containers.
+class MatchingBasedLoopDetectorSerializer {
+ public:
+  static bool saveToBinaryFile(
+      const MatchingBasedLoopDetector& loop_detector,
+      const vi_map::MissionIdSet& missions_in_database,
+      const std::string& file_path);
+
+  // The loop detector needs to be empty and use the same vocabulary as the
+  // one which was saved.
+  static bool mapFromBinaryFile(
+      const std::string& file_path, MatchingBasedLoopDetector* loop_detector,
+      vi_map::MissionIdSet* missions_in_database);
+};
+
+}  // namespace matching_based_loopclosure
+
+#endif  // MATCHING_BASED_LOOPCLOSURE_LOOP_DETECTOR_SERIALIZER_H_
@@ -2,235 +2,246 @@
 #define MATCHING_BASED_LOOPCLOSURE_MATCHING_BASED_ENGINE_INL_H_
 
 #include <algorithm>
-#include <queue>
-#include <unordered_map>
-#include <unordered_set>
-#include <utility>
+#include <mutex>
+#include <numeric>
+#include <string>
 #include <vector>
 
-#include <aslam/common/reader-writer-lock.h>
 #include <vi-map/unique-id.h>
 
 #include "matching-based-loopclosure/matching-based-engine.h"
 
-namespace std {
-template <>
-struct hash<vi_map::FrameKeyPointToStructureMatch> {
-  std::size_t operator()(
-      const vi_map::FrameKeyPointToStructureMatch& value) const {
-    const std::size_t h0(
-        std::hash<vi_map::KeypointIdentifier>()(value.keypoint_id_query));
-    const std::size_t h1(
-        std::hash<vi_map::VisualFrameIdentifier>()(value.keyframe_id_result));
-    const std::size_t h2(
-        std::hash<vi_map::LandmarkId>()(value.landmark_result));
-    return h0 ^ h1 ^ h2;
+namespace matching_based_loopclosure {
+
+namespace internal {
+// Orders matches by landmark first, such that matches sharing a landmark are
+// adjacent, then by query keypoint, such that matches of a keypoint to the
+// same landmark are adjacent, and finally by the result keyframe, such that
+// identical matches are adjacent.
+inline bool isMatchOrderedBefore(
+    const loop_closure::Match& lhs, const loop_closure::Match& rhs) {
+  if (lhs.landmark_result != rhs.landmark_result) {
+    return lhs.landmark_result < rhs.landmark_result;
+  }
+  if (lhs.keypoint_id_query.frame_id != rhs.keypoint_id_query.frame_id) {
+    return lhs.keypoint_id_query.frame_id < rhs.keypoint_id_query.frame_id;
   }
-};
+  if (lhs.keypoint_id_query.keypoint_index !=
+      rhs.keypoint_id_query.keypoint_index) {
+    return lhs.keypoint_id_query.keypoint_index <
+           rhs.keypoint_id_query.keypoint_index;
+  }
+  return lhs.keyframe_id_result < rhs.keyframe_id_result;
+}
 
-template <>
-struct hash<std::pair<vi_map::KeypointIdentifier, vi_map::LandmarkId>> {
-  std::size_t operator()(
-      const std::pair<vi_map::KeypointIdentifier, vi_map::LandmarkId>& value)
-      const {
-    const std::size_t h1(std::hash<vi_map::KeypointIdentifier>()(value.first));
-    const std::size_t h2(std::hash<vi_map::LandmarkId>()(value.second));
-    return h1 ^ h2;
+inline bool haveSameKeypointAndLandmark(
+    const loop_closure::Match& lhs, const loop_closure::Match& rhs) {
+  return lhs.landmark_result == rhs.landmark_result &&
+         lhs.keypoint_id_query == rhs.keypoint_id_query;
+}
+
+// Returns the root of the component with path halving.
+inline size_t findComponentRoot(
+    size_t id_index, std::vector<size_t>* component_parents) {
+  std::vector<size_t>& parents = *component_parents;
+  while (parents[id_index] != id_index) {
+    parents[id_index] = parents[parents[id_index]];
+    id_index = parents[id_index];
   }
-};
-}  // namespace std
+  return id_index;
+}
+}  // namespace internal
 
-namespace matching_based_loopclosure {
+template <typename IdType>
+MatchingBasedLoopDetector::CovisibilityFilteringBuffers<IdType>&
+MatchingBasedLoopDetector::getCovisibilityFilteringBuffers() {
+  static thread_local CovisibilityFilteringBuffers<IdType> buffers;
+  return buffers;
+}
 
 template <typename IdType>
 void MatchingBasedLoopDetector::doCovisibilityFiltering(
     const loop_closure::IdToMatches<IdType>& id_to_matches_map,
     const bool make_matches_unique,
     loop_closure::FrameToMatches* frame_matches_ptr,
-    std::mutex* frame_matches_mutex) const {
+    std::mutex* frame_matches_mutex, const DeltaSegment* delta_segment) const {
   // WARNING: Do not clear frame matches. It is intended that new matches can
   // be added to already existing matches. The mutex passed to the function
   // can be nullptr, in which case locking is disabled.
   CHECK_NOTNULL(frame_matches_ptr);
   loop_closure::FrameToMatches& frame_matches = *frame_matches_ptr;
 
-  typedef int ComponentId;
-  constexpr ComponentId kInvalidComponentId = -1;
-  typedef std::unordered_map<loop_closure::Match, ComponentId>
-      MatchesToComponents;
-  typedef std::unordered_map<ComponentId,
-                             std::unordered_set<loop_closure::Match>>
-      Components;
-  typedef std::unordered_map<vi_map::LandmarkId,
-                             std::vector<loop_closure::Match>>
-      LandmarkMatches;
-
   const size_t num_matches_to_filter =
       loop_closure::getNumberOfMatches(id_to_matches_map);
   if (num_matches_to_filter == 0u) {
     return;
   }
 
-  MatchesToComponents matches_to_components;
-  LandmarkMatches landmark_matches;
-  // To avoid rehashing, we reserve at least twice the number of elements.
-  matches_to_components.reserve(num_matches_to_filter * 2u);
-  // Reserving the number of matches is still conservative because the number
-  // of matched landmarks is smaller than the number of matches.
-  landmark_matches.reserve(num_matches_to_filter);
+  // The buffers are only cleared, such that they keep their capacity for the
+  // next query of this thread.
+  CovisibilityFilteringBuffers<IdType>& buffers =
+      getCovisibilityFilteringBuffers<IdType>();
+  computeRelevantIdsForFiltering(id_to_matches_map, delta_segment, &buffers);
 
+  // Assign a dense index to every ID (keyframe or vertex) that is not
+  // skipped.
+  std::vector<MatchAndIdIndex>& matches = buffers.matches;
+  matches.clear();
+  size_t num_ids = 0u;
   for (const typename loop_closure::IdToMatches<IdType>::value_type&
            id_matches_pair : id_to_matches_map) {
+    if (skipId(buffers.relevant_ids, id_matches_pair.first)) {
+      continue;
+    }
     for (const loop_closure::Match& match : id_matches_pair.second) {
-      landmark_matches[match.landmark_result].emplace_back(match);
-      matches_to_components.emplace(match, kInvalidComponentId);
+      matches.emplace_back(&match, num_ids);
     }
+    ++num_ids;
   }
+  if (num_ids == 0u) {
+    return;
+  }
+  std::sort(
+      matches.begin(), matches.end(),
+      [](const MatchAndIdIndex& lhs, const MatchAndIdIndex& rhs) -> bool {
+        return internal::isMatchOrderedBefore(*lhs.first, *rhs.first);
+      });
 
-  IdToScoreMap<IdType> id_to_score_map;
-  computeRelevantIdsForFiltering(id_to_matches_map, &id_to_score_map);
+  // Find the connected sets of keyframes or vertices, which are connected if
+  // they observe a common landmark. Matches to the same landmark are
+  // adjacent after sorting.
+  std::vector<size_t>& component_parents = buffers.component_parents;
+  component_parents.resize(num_ids);
+  std::iota(component_parents.begin(), component_parents.end(), 0u);
+  for (size_t match_idx = 1u; match_idx < matches.size(); ++match_idx) {
+    if (matches[match_idx].first->landmark_result !=
+        matches[match_idx - 1u].first->landmark_result) {
+      continue;
+    }
+    const size_t root = internal::findComponentRoot(
+        matches[match_idx].second, &component_parents);
+    const size_t previous_root = internal::findComponentRoot(
+        matches[match_idx - 1u].second, &component_parents);
+    if (root != previous_root) {
+      component_parents[root] = previous_root;
+    }
+  }
 
-  ComponentId count_component_index = 0;
+  // The size of a component is its number of distinct matches. Identical
+  // matches are adjacent after sorting.
+  std::vector<size_t>& component_sizes = buffers.component_sizes;
+  component_sizes.assign(num_ids, 0u);
   size_t max_component_size = 0u;
-  ComponentId max_component_id = kInvalidComponentId;
-  Components components;
-  for (const MatchesToComponents::value_type& match_to_component :
-       matches_to_components) {
-    if (match_to_component.second != kInvalidComponentId)
+  size_t max_component_root = 0u;
+  for (size_t match_idx = 0u; match_idx < matches.size(); ++match_idx) {
+    if (match_idx > 0u &&
+        *matches[match_idx].first == *matches[match_idx - 1u].first) {
       continue;
-    ComponentId component_id = count_component_index++;
-
-    // Find the largest set of keyframes connected by landmark covisibility.
-    std::queue<loop_closure::Match> exploration_queue;
-    exploration_queue.push(match_to_component.first);
-    while (!exploration_queue.empty()) {
-      const loop_closure::Match& exploration_match = exploration_queue.front();
-
-      if (skipMatch(id_to_score_map, exploration_match)) {
-        exploration_queue.pop();
-        continue;
-      }
-
-      const MatchesToComponents::iterator exploration_match_and_component =
-          matches_to_components.find(exploration_match);
-      CHECK(exploration_match_and_component != matches_to_components.end());
-
-      if (exploration_match_and_component->second == kInvalidComponentId) {
-        // Not part of a connected component.
-        exploration_match_and_component->second = component_id;
-        components[component_id].insert(exploration_match);
-        // Mark all observations (which are matches) from this ID (keyframe or
-        // vertex) as visited.
-        const typename loop_closure::IdToMatches<IdType>::const_iterator
-            id_and_matches =
-                getIteratorForMatch(id_to_matches_map, exploration_match);
-        CHECK(id_and_matches != id_to_matches_map.cend());
-        const std::vector<loop_closure::Match>& id_matches =
-            id_and_matches->second;
-        for (const loop_closure::Match& id_match : id_matches) {
-          matches_to_components[id_match] = component_id;
-          components[component_id].insert(id_match);
-
-          // Put all observations of this landmark on the stack.
-          const std::vector<loop_closure::Match>& lm_matches =
-              landmark_matches[id_match.landmark_result];
-          for (const loop_closure::Match& lm_match : lm_matches) {
-            if (matches_to_components[lm_match] == kInvalidComponentId) {
-              exploration_queue.push(lm_match);
-            }
-          }
-        }
-
-        if (components[component_id].size() > max_component_size) {
-          max_component_size = components[component_id].size();
-          max_component_id = component_id;
-        }
-      }
-      exploration_queue.pop();
+    }
+    const size_t root = internal::findComponentRoot(
+        matches[match_idx].second, &component_parents);
+    if (++component_sizes[root] > max_component_size) {
+      max_component_size = component_sizes[root];
+      max_component_root = root;
     }
   }
 
   // Only store the structure matches if there is a relevant amount of them.
-  if (max_component_size > settings_.min_verify_matches_num) {
-    const std::unordered_set<loop_closure::Match>& matches_max_component =
-        components[max_component_id];
-    typedef std::pair<loop_closure::KeypointId, vi_map::LandmarkId>
-        KeypointLandmarkPair;
-    std::unordered_set<KeypointLandmarkPair> used_matches;
-    if (make_matches_unique) {
-      // Conservative reserve to avoid rehashing.
-      used_matches.reserve(2u * matches_max_component.size());
+  if (max_component_size <= settings_.min_verify_matches_num) {
+    return;
+  }
+  auto lock = (frame_matches_mutex == nullptr)
+                  ? std::unique_lock<std::mutex>()
+                  : std::unique_lock<std::mutex>(*frame_matches_mutex);
+  const loop_closure::Match* last_added_match = nullptr;
+  for (const MatchAndIdIndex& match_and_id_index : matches) {
+    if (internal::findComponentRoot(
+            match_and_id_index.second, &component_parents) !=
+        max_component_root) {
+      continue;
     }
-    auto lock = (frame_matches_mutex == nullptr)
-                    ? std::unique_lock<std::mutex>()
-                    : std::unique_lock<std::mutex>(*frame_matches_mutex);
-    for (const loop_closure::Match& structure_match : matches_max_component) {
-      if (make_matches_unique) {
-        // clang-format off
-        const bool is_match_unique = used_matches.emplace(
-                structure_match.keypoint_id_query,
-                structure_match.landmark_result).second;
-        // clang-format on
-        if (!is_match_unique) {
-          // Skip duplicate (keypoint to landmark) structure matches.
-          continue;
-        }
+    const loop_closure::Match& structure_match = *match_and_id_index.first;
+    if (last_added_match != nullptr) {
+      // Skip duplicate (keypoint to landmark) structure matches if requested,
+      // and identical matches in any case.
+      if (make_matches_unique ? internal::haveSameKeypointAndLandmark(
+                                    structure_match, *last_added_match)
+                              : structure_match == *last_added_match) {
+        continue;
       }
-      frame_matches[structure_match.keypoint_id_query.frame_id].push_back(
-          structure_match);
     }
+    frame_matches[structure_match.keypoint_id_query.frame_id].push_back(
+        structure_match);
+    last_added_match = &structure_match;
   }
 }
 
 template <>
-typename loop_closure::FrameToMatches::const_iterator
-MatchingBasedLoopDetector::getIteratorForMatch(
-    const loop_closure::FrameToMatches& frame_to_matches,
-    const loop_closure::Match& match) const {
-  return frame_to_matches.find(match.keyframe_id_result);
-}
-
-template <>
-typename loop_closure::VertexToMatches::const_iterator
-MatchingBasedLoopDetector::getIteratorForMatch(
-    const loop_closure::VertexToMatches& vertex_to_matches,
-    const loop_closure::Match& match) const {
-  return vertex_to_matches.find(match.keyframe_id_result.vertex_id);
-}
-
-template <>
-bool MatchingBasedLoopDetector::skipMatch(
-    const IdToScoreMap<loop_closure::KeyframeId>& frame_to_score_map,
-    const loop_closure::Match& match) const {
-  const typename IdToScoreMap<loop_closure::KeyframeId>::const_iterator iter =
-      frame_to_score_map.find(match.keyframe_id_result);
-  return iter == frame_to_score_map.cend();
+inline bool MatchingBasedLoopDetector::skipId(
+    const std::vector<loop_closure::KeyframeId>& relevant_keyframe_ids,
+    const loop_closure::KeyframeId& keyframe_id) const {
+  return !std::binary_search(
+      relevant_keyframe_ids.cbegin(), relevant_keyframe_ids.cend(),
+      keyframe_id);
 }
 
 template <>
-bool MatchingBasedLoopDetector::skipMatch(
-    const IdToScoreMap<loop_closure::VertexId>& /* vertex_to_score_map */,
-    const loop_closure::Match& /* match */) const {
+inline bool MatchingBasedLoopDetector::skipId(
+    const std::vector<loop_closure::VertexId>& /* relevant_vertex_ids */,
+    const loop_closure::VertexId& /* vertex_id */) const {
   // We do not skip vertices because we want to consider all keyframes that
   // passed the keyframe covisibility filtering step.
   return false;
 }
 
 template <>
-void MatchingBasedLoopDetector::computeRelevantIdsForFiltering(
+inline void MatchingBasedLoopDetector::computeRelevantIdsForFiltering(
     const loop_closure::FrameToMatches& frame_to_matches,
-    IdToScoreMap<loop_closure::KeyframeId>* frame_to_score_map) const {
-  CHECK_NOTNULL(frame_to_score_map)->clear();
+    const DeltaSegment* delta_segment,
+    CovisibilityFilteringBuffers<loop_closure::KeyframeId>* buffers) const {
+  CHECK_NOTNULL(buffers);
+  std::vector<loop_closure::KeyframeId>& relevant_keyframe_ids =
+      buffers->relevant_ids;
+  relevant_keyframe_ids.clear();
   // Score each keyframe, then take the part which is in the
   // top fraction and allow only matches to landmarks which are associated with
   // these keyframes.
 
-  scoring::ScoreList<loop_closure::KeyframeId> score_list;
-  timing::Timer timer_scoring("Loop Closure: scoring for covisibility filter");
+  const KeyframeIdToNumDescriptorsMap* keyframe_id_to_num_descriptors =
+      &keyframe_id_to_num_descriptors_;
+  size_t num_descriptors_in_database =
+      static_cast<size_t>(index_interface_->GetNumDescriptorsInIndex());
+  KeyframeIdToNumDescriptorsMap& matched_keyframe_id_to_num_descriptors =
+      buffers->matched_id_to_num_descriptors;
+  matched_keyframe_id_to_num_descriptors.clear();
+  if (delta_segment != nullptr && !delta_segment->images.empty()) {
+    // Only the descriptor counts of the matched keyframes are combined, the
+    // index and the delta segment keep their own.
+    matched_keyframe_id_to_num_descriptors.reserve(frame_to_matches.size());
+    for (const loop_closure::FrameToMatches::value_type& frame_matches :
+         frame_to_matches) {
+      KeyframeIdToNumDescriptorsMap::const_iterator it =
+          keyframe_id_to_num_descriptors_.find(frame_matches.first);
+      if (it == keyframe_id_to_num_descriptors_.cend()) {
+        it = delta_segment->keyframe_id_to_num_descriptors.find(
+            frame_matches.first);
+        CHECK(it != delta_segment->keyframe_id_to_num_descriptors.cend());
+      }
+      matched_keyframe_id_to_num_descriptors.emplace(*it);
+    }
+    keyframe_id_to_num_descriptors = &matched_keyframe_id_to_num_descriptors;
+    num_descriptors_in_database += delta_segment->num_descriptors;
+  }
+
+  scoring::ScoreList<loop_closure::KeyframeId>& score_list = buffers->scores;
+  // A static name keeps the timer from allocating its tag for every query.
+  static const std::string kScoringTimerName =
+      "Loop Closure: scoring for covisibility filter";
+  timing::Timer timer_scoring(kScoringTimerName);
   CHECK(compute_keyframe_scores_);
   compute_keyframe_scores_(
-      frame_to_matches, keyframe_id_to_num_descriptors_,
-      static_cast<size_t>(NumDescriptors()), &score_list);
+      frame_to_matches, *keyframe_id_to_num_descriptors,
+      num_descriptors_in_database, &score_list);
   timer_scoring.Stop();
 
   // We want to take matches from the best n score keyframes, but make sure
@@ -249,14 +260,20 @@ void MatchingBasedLoopDetector::computeRelevantIdsForFiltering(
          const scoring::Score<loop_closure::KeyframeId>& rhs) -> bool {
         return lhs.second > rhs.second;
       });
-  frame_to_score_map->insert(
-      score_list.begin(), score_list.begin() + num_score_ids_to_evaluate);
+  // Sorted for the lookup in skipId.
+  for (size_t score_idx = 0u; score_idx < num_score_ids_to_evaluate;
+       ++score_idx) {
+    relevant_keyframe_ids.push_back(score_list[score_idx].first);
+  }
+  std::sort(relevant_keyframe_ids.begin(), relevant_keyframe_ids.end());
 }
 
 template <>
-void MatchingBasedLoopDetector::computeRelevantIdsForFiltering(
+inline void MatchingBasedLoopDetector::computeRelevantIdsForFiltering(
     const loop_closure::VertexToMatches& /* vertex_to_matches */,
-    IdToScoreMap<loop_closure::VertexId>* /* vertex_to_score_map */) const {
+    const DeltaSegment* /* delta_segment */,
+    CovisibilityFilteringBuffers<loop_closure::VertexId>* /* buffers */)
+    const {
   // We do not have to score vertices to filter unlikely matches because this
   // is done already at keyframe level.
 }
@@ -1,7 +1,10 @@
 #ifndef MATCHING_BASED_LOOPCLOSURE_MATCHING_BASED_ENGINE_H_
 #define MATCHING_BASED_LOOPCLOSURE_MATCHING_BASED_ENGINE_H_
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -17,13 +20,23 @@
 #include "matching-based-loopclosure/scoring.h"
 
 namespace matching_based_loopclosure {
-
+class MappedLoopDetectorDatabase;
+
+// If settings.delta_segment_max_num_descriptors is positive, inserted images
+// are first added to a small delta segment, which is searched exhaustively
+// alongside the index. Inserting only publishes a new snapshot of the delta
+// segment and doesn't block queries. Once the delta segment holds enough
+// descriptors, a background thread merges it into the index, which blocks
+// queries only while these descriptors are added.
 class MatchingBasedLoopDetector : public loop_detector::LoopDetector {
  public:
+  friend class MatchingBasedLoopDetectorSerializer;
+  friend class CovisibilityFilteringTest;  // Test.
+
   explicit MatchingBasedLoopDetector(
       const MatchingBasedEngineSettings& settings);
 
-  virtual ~MatchingBasedLoopDetector() = default;
+  virtual ~MatchingBasedLoopDetector();
 
   // Find a set of provided images (consisting of projected descriptors), that
   // belong to the same vertex, in the database.
@@ -47,8 +60,13 @@ class MatchingBasedLoopDetector : public loop_detector::LoopDetector {
       const std::vector<aslam::common::FeatureDescriptorConstRef>& descriptors,
       Eigen::MatrixXf* projected_descriptors) const override;
 
+  // Merges the delta segment into the index.
+  void Flush() override;
+
   void Clear() override;
 
+  void GetMemoryUsage(common::MemoryUsage* usage) const override;
+
   void serialize(proto::MatchingBasedLoopDetector* matching_based_loop_detector)
       const override;
   void deserialize(
@@ -69,46 +87,72 @@ class MatchingBasedLoopDetector : public loop_detector::LoopDetector {
       KeyframeToMatchesMap;
   typedef loop_closure::IdToMatches<loop_closure::VertexId> VertexToMatchesMap;
 
+  // A match and the dense index of its keyframe or vertex.
+  typedef std::pair<const loop_closure::Match*, size_t> MatchAndIdIndex;
+
+  // Scratch space of the covisibility filtering. Every thread keeps its own
+  // buffers, which are cleared but not freed between queries, such that the
+  // filtering doesn't allocate once they have grown to the query size.
   template <typename IdType>
-  using IdToScoreMap = std::unordered_map<IdType, scoring::ScoreType>;
+  struct CovisibilityFilteringBuffers {
+    std::vector<MatchAndIdIndex> matches;
+    // Union-find forest over the dense ID indices.
+    std::vector<size_t> component_parents;
+    std::vector<size_t> component_sizes;
+    // Sorted IDs that pass the scoring, only used for keyframes.
+    std::vector<IdType> relevant_ids;
+    scoring::ScoreList<IdType> scores;
+    loop_closure::IdToNumDescriptors<IdType> matched_id_to_num_descriptors;
+  };
+
+  // Recently inserted images, including their projected descriptors, in the
+  // order of insertion. A published segment is never modified. Inserting
+  // publishes a copy with the new image instead, such that queries can use
+  // a snapshot without locking.
+  struct DeltaSegment {
+    std::vector<loop_closure::ProjectedImage::ConstPtr> images;
+    KeyframeIdToNumDescriptorsMap keyframe_id_to_num_descriptors;
+    size_t num_descriptors = 0u;
+  };
+  struct DeltaNeighbor {
+    float distance;
+    const loop_closure::ProjectedImage* image;
+    int keypoint_index;
+  };
 
   void setKeyframeScoringFunction();
   void setDetectorEngine();
 
-  size_t NumEntries() const override {
-    return database_.size();
-  }
+  size_t NumEntries() const override;
 
-  int NumDescriptors() const override {
-    return index_interface_->GetNumDescriptorsInIndex();
-  }
+  int NumDescriptors() const override;
 
   // Find the largest connected subgraph of keyframes or vertices and landmarks
-  // to be passed to RANSAC. This is just a plain BFS over landmarks and
-  // keyframes or vertices. This function adds matches to the already existing
-  // matches. There is an option to pass a mutex that is used to lock the
-  // (output) frame matches.
+  // to be passed to RANSAC. The matches are sorted by landmark and the
+  // keyframes or vertices sharing a landmark are joined with union-find. This
+  // function adds matches to the already existing matches. There is an option
+  // to pass a mutex that is used to lock the (output) frame matches.
   template <typename IdType>
   void doCovisibilityFiltering(
       const loop_closure::IdToMatches<IdType>& id_to_matches,
       const bool make_matches_unique,
       loop_closure::FrameToMatches* frame_matches,
-      std::mutex* frame_matches_mutex = nullptr) const;
+      std::mutex* frame_matches_mutex = nullptr,
+      const DeltaSegment* delta_segment = nullptr) const;
+  // Fills the relevant IDs of the buffers. The delta segment can be nullptr
+  // if it is empty.
   template <typename IdType>
   void computeRelevantIdsForFiltering(
       const loop_closure::IdToMatches<IdType>& frame_to_matches,
-      IdToScoreMap<IdType>* frame_to_score_map) const;
-  // Skip match if not in the set of keyframes that see a lot of the matched
-  // landmarks.
+      const DeltaSegment* delta_segment,
+      CovisibilityFilteringBuffers<IdType>* buffers) const;
+  // Skip the matches of an ID if it is not in the set of keyframes that see a
+  // lot of the matched landmarks.
   template <typename IdType>
-  bool skipMatch(
-      const IdToScoreMap<IdType>& frame_to_score_map,
-      const loop_closure::Match& match) const;
+  bool skipId(const std::vector<IdType>& relevant_ids, const IdType& id) const;
   template <typename IdType>
-  typename loop_closure::IdToMatches<IdType>::const_iterator
-  getIteratorForMatch(
-      const loop_closure::IdToMatches<IdType>& frame_to_matches,
-      const loop_closure::Match& match) const;
+  static CovisibilityFilteringBuffers<IdType>&
+  getCovisibilityFilteringBuffers();
 
   // Returns true if the match has been successfully retrieved. Returns false,
   // if the match was too close in time to the query vertex.
@@ -116,17 +160,60 @@ class MatchingBasedLoopDetector : public loop_detector::LoopDetector {
       int nn_match_descriptor_index,
       const loop_closure::ProjectedImage& projected_image_query,
       int keypoint_index_query, loop_closure::Match* structure_match) const;
+  bool getMatchForKeypoint(
+      const loop_closure::KeypointId& keypoint_id_result,
+      int64_t timestamp_nanoseconds_result,
+      const loop_closure::DatasetId& dataset_id_result,
+      const loop_closure::PointLandmarkId& landmark_id_result,
+      const loop_closure::ProjectedImage& projected_image_query,
+      int keypoint_index_query, loop_closure::Match* structure_match) const;
   int getNumNeighborsToSearch() const;
 
+  // Adds the image to the index and the database. The write lock needs to be
+  // held.
+  void insertIntoIndex(const loop_closure::ProjectedImage& projected_image);
+
+  std::shared_ptr<const DeltaSegment> getDeltaSegment() const;
+  // Finds the num_neighbors closest descriptors in the delta segment, sorted
+  // by ascending distance.
+  void findDeltaNeighbors(
+      const DeltaSegment& delta_segment,
+      const Eigen::Ref<const Eigen::VectorXf>& query_descriptor,
+      int num_neighbors, std::vector<DeltaNeighbor>* delta_neighbors) const;
+  void insertIntoDeltaSegment(
+      const loop_closure::ProjectedImage& projected_image);
+  // Moves the images of the delta segment into the index.
+  void mergeDeltaSegment();
+  void mergeThreadLoop();
+
+  // Copies the mapped database into database_ and
+  // descriptor_index_to_keypoint_id_. Does nothing if it isn't mapped.
+  void copyMappedDatabase();
+
   const MatchingBasedEngineSettings settings_;
   Database database_;
   KeyframeIdToNumDescriptorsMap keyframe_id_to_num_descriptors_;
   DescriptorIndexToKeypointIdMap descriptor_index_to_keypoint_id_;
   int descriptor_index_;
   std::shared_ptr<loop_closure::IndexInterface> index_interface_;
+  // If set, the database images and descriptor to keypoint assignments are
+  // read from this instead of database_ and descriptor_index_to_keypoint_id_,
+  // which are empty.
+  std::shared_ptr<const MappedLoopDetectorDatabase> mapped_database_;
   scoring::computeScoresFunction<loop_closure::KeyframeId>
       compute_keyframe_scores_;
   mutable aslam::ReaderWriterMutex read_write_mutex;
+
+  // Only accessed with std::atomic_load and std::atomic_store.
+  std::shared_ptr<const DeltaSegment> delta_segment_;
+  // Serializes publishing new delta segments. If both are needed, it is
+  // locked after read_write_mutex.
+  std::mutex delta_segment_mutex_;
+  std::thread merge_thread_;
+  std::mutex merge_mutex_;
+  std::condition_variable merge_condition_;
+  bool merge_requested_;
+  bool shutdown_requested_;
 };
 }  // namespace matching_based_loopclosure
 
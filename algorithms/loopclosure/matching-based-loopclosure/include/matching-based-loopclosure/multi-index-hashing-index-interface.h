@@ -0,0 +1,99 @@
+#ifndef MATCHING_BASED_LOOPCLOSURE_MULTI_INDEX_HASHING_INDEX_INTERFACE_H_
+#define MATCHING_BASED_LOOPCLOSURE_MULTI_INDEX_HASHING_INDEX_INTERFACE_H_
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/timer.h>
+
+#include "matching-based-loopclosure/helpers.h"
+#include "matching-based-loopclosure/index-interface.h"
+#include "matching-based-loopclosure/multi-index-hashing-index.h"
+
+namespace loop_closure {
+// Indexes the raw binary descriptors and searches them by Hamming distance.
+// The "projection" only packs the descriptor bytes into floats, see
+// multi_index_hashing::PackDescriptor(), and the returned distances are
+// Hamming distances.
+class MultiIndexHashingIndexInterface : public IndexInterface {
+ public:
+  typedef multi_index_hashing::MultiIndexHashingIndex Index;
+
+  MultiIndexHashingIndexInterface(
+      int num_substring_bytes, int max_substring_radius) {
+    index_.reset(new Index(num_substring_bytes, max_substring_radius));
+  }
+
+  virtual int GetNumDescriptorsInIndex() const {
+    return index_->GetNumDescriptorsInIndex();
+  }
+
+  virtual size_t GetMemoryUsageBytes() const {
+    return index_->GetMemoryUsageBytes();
+  }
+
+  virtual void Clear() {
+    index_->Clear();
+  }
+
+  virtual void AddDescriptors(const Eigen::MatrixXf& descriptors) {
+    CHECK(index_ != nullptr);
+    index_->AddDescriptors(descriptors);
+  }
+
+  virtual void GetNNearestNeighborsForFeatures(
+      const Eigen::MatrixXf& query_features, int num_neighbors,
+      Eigen::MatrixXi* indices, Eigen::MatrixXf* distances) const {
+    CHECK_NOTNULL(indices);
+    CHECK_NOTNULL(distances);
+    CHECK(index_ != nullptr);
+    index_->GetNNearestNeighbors(
+        query_features, num_neighbors, *indices, *distances);
+  }
+
+  virtual void ProjectDescriptors(
+      const DescriptorContainer& descriptors,
+      Eigen::MatrixXf* projected_descriptors) const {
+    CHECK_NOTNULL(projected_descriptors);
+    const int num_bytes = static_cast<int>(descriptors.rows());
+    projected_descriptors->resize(
+        num_bytes / multi_index_hashing::kNumBytesPerPackedWord,
+        descriptors.cols());
+
+    timing::Timer timer_pack("Loop Closure: Pack descriptors");
+    for (int col_idx = 0; col_idx < descriptors.cols(); ++col_idx) {
+      multi_index_hashing::PackDescriptor(
+          descriptors.col(col_idx).data(), num_bytes,
+          projected_descriptors->col(col_idx));
+    }
+    timer_pack.Stop();
+  }
+
+  virtual void ProjectDescriptors(
+      const std::vector<aslam::common::FeatureDescriptorConstRef>& descriptors,
+      Eigen::MatrixXf* projected_descriptors) const {
+    CHECK_NOTNULL(projected_descriptors);
+    if (descriptors.empty()) {
+      projected_descriptors->resize(0, 0);
+      return;
+    }
+    const int num_bytes = static_cast<int>(descriptors.front().size());
+    projected_descriptors->resize(
+        num_bytes / multi_index_hashing::kNumBytesPerPackedWord,
+        descriptors.size());
+
+    timing::Timer timer_pack("Loop Closure: Pack descriptors");
+    for (size_t col_idx = 0u; col_idx < descriptors.size(); ++col_idx) {
+      CHECK_EQ(static_cast<int>(descriptors[col_idx].size()), num_bytes);
+      multi_index_hashing::PackDescriptor(
+          descriptors[col_idx].data(), num_bytes,
+          projected_descriptors->col(col_idx));
+    }
+    timer_pack.Stop();
+  }
+
+ private:
+  std::shared_ptr<Index> index_;
+};
+}  // namespace loop_closure
+#endif  // MATCHING_BASED_LOOPCLOSURE_MULTI_INDEX_HASHING_INDEX_INTERFACE_H_
@@ -0,0 +1,298 @@
+#ifndef MATCHING_BASED_LOOPCLOSURE_MULTI_INDEX_HASHING_INDEX_H_
+#define MATCHING_BASED_LOOPCLOSURE_MULTI_INDEX_HASHING_INDEX_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+#include <maplab-common/memory-accounting.h>
+#include <vocabulary-tree/hamming.h>
+
+namespace loop_closure {
+namespace multi_index_hashing {
+
+// The binary descriptors are passed through the float based index interface
+// as 16 bit words, every float holds two descriptor bytes. The words are
+// exactly representable, such that the packing is lossless.
+static constexpr int kNumBytesPerPackedWord = 2;
+
+inline void PackDescriptor(
+    const unsigned char* descriptor, int num_bytes,
+    Eigen::Ref<Eigen::VectorXf> packed_descriptor) {
+  CHECK_NOTNULL(descriptor);
+  CHECK_EQ(num_bytes % kNumBytesPerPackedWord, 0);
+  CHECK_EQ(packed_descriptor.rows(), num_bytes / kNumBytesPerPackedWord);
+  for (int word_idx = 0; word_idx < packed_descriptor.rows(); ++word_idx) {
+    const uint16_t word =
+        static_cast<uint16_t>(descriptor[2 * word_idx]) |
+        static_cast<uint16_t>(descriptor[2 * word_idx + 1]) << 8;
+    packed_descriptor[word_idx] = static_cast<float>(word);
+  }
+}
+
+inline void UnpackDescriptor(
+    const Eigen::Ref<const Eigen::VectorXf>& packed_descriptor,
+    unsigned char* descriptor) {
+  CHECK_NOTNULL(descriptor);
+  for (int word_idx = 0; word_idx < packed_descriptor.rows(); ++word_idx) {
+    const uint16_t word = static_cast<uint16_t>(packed_descriptor[word_idx]);
+    descriptor[2 * word_idx] = static_cast<unsigned char>(word & 0xff);
+    descriptor[2 * word_idx + 1] = static_cast<unsigned char>(word >> 8);
+  }
+}
+
+// Nearest neighbor index for binary descriptors based on multi-index hashing
+// (Norouzi et al., "Fast Search in Hamming Space with Multi-Index Hashing").
+// The descriptors are split into disjoint substrings, each of which is used
+// as key of a separate hash table. If two descriptors are within a Hamming
+// distance of r, at least one of their m substrings is within a distance of
+// floor(r / m). The search therefore probes all keys within an increasing
+// substring radius and verifies the candidates with the full Hamming
+// distance, until the nearest neighbors are guaranteed to be found or the
+// maximal substring radius is reached.
+class MultiIndexHashingIndex {
+ public:
+  typedef uint32_t SubstringKey;
+  typedef std::unordered_map<SubstringKey, std::vector<int>> HashTable;
+
+  MultiIndexHashingIndex(int num_substring_bytes, int max_substring_radius)
+      : num_substring_bytes_(num_substring_bytes),
+        max_substring_radius_(max_substring_radius),
+        num_descriptor_bytes_(0) {
+    CHECK_GT(num_substring_bytes_, 0);
+    CHECK_LE(num_substring_bytes_, static_cast<int>(sizeof(SubstringKey)));
+    CHECK_GE(max_substring_radius_, 0);
+  }
+
+  inline void Clear() {
+    descriptors_.clear();
+    hash_tables_.clear();
+    num_descriptor_bytes_ = 0;
+  }
+
+  inline int GetNumDescriptorsInIndex() const {
+    if (num_descriptor_bytes_ == 0) {
+      return 0;
+    }
+    return static_cast<int>(descriptors_.size()) / num_descriptor_bytes_;
+  }
+
+  // The raw descriptor bits and the descriptor indices in the hash tables.
+  inline size_t GetMemoryUsageBytes() const {
+    size_t num_bytes = common::getHeapBytes(descriptors_);
+    for (const HashTable& hash_table : hash_tables_) {
+      num_bytes += common::getHeapBytes(hash_table);
+      for (const HashTable::value_type& key_and_bucket : hash_table) {
+        num_bytes += common::getHeapBytes(key_and_bucket.second);
+      }
+    }
+    return num_bytes;
+  }
+
+  inline int num_descriptor_bytes() const {
+    return num_descriptor_bytes_;
+  }
+
+  // Adds the packed descriptors, see PackDescriptor(), to the index.
+  void AddDescriptors(const Eigen::MatrixXf& packed_descriptors) {
+    if (packed_descriptors.cols() == 0) {
+      return;
+    }
+    const int num_descriptor_bytes =
+        static_cast<int>(packed_descriptors.rows()) * kNumBytesPerPackedWord;
+    if (num_descriptor_bytes_ == 0) {
+      InitializeHashTables(num_descriptor_bytes);
+    }
+    CHECK_EQ(num_descriptor_bytes, num_descriptor_bytes_)
+        << "All descriptors in the index must have the same size.";
+
+    int descriptor_index = GetNumDescriptorsInIndex();
+    descriptors_.resize(
+        descriptors_.size() +
+        packed_descriptors.cols() * num_descriptor_bytes_);
+    for (int col_idx = 0; col_idx < packed_descriptors.cols();
+         ++col_idx, ++descriptor_index) {
+      unsigned char* descriptor = GetDescriptor(descriptor_index);
+      UnpackDescriptor(packed_descriptors.col(col_idx), descriptor);
+      for (size_t substring_idx = 0u; substring_idx < hash_tables_.size();
+           ++substring_idx) {
+        hash_tables_[substring_idx][GetSubstringKey(descriptor, substring_idx)]
+            .push_back(descriptor_index);
+      }
+    }
+  }
+
+  // Returns the indices and Hamming distances of the num_neighbors nearest
+  // descriptors for every packed query descriptor, sorted by distance.
+  // Missing neighbors are reported with index -1 and infinite distance.
+  template <typename DerivedIndices, typename DerivedDistances>
+  void GetNNearestNeighbors(
+      const Eigen::MatrixXf& packed_queries, int num_neighbors,
+      const Eigen::MatrixBase<DerivedIndices>& indices_const,
+      const Eigen::MatrixBase<DerivedDistances>& distances_const) const {
+    CHECK_GT(num_neighbors, 0);
+    Eigen::MatrixBase<DerivedIndices>& indices =
+        const_cast<Eigen::MatrixBase<DerivedIndices>&>(indices_const);
+    Eigen::MatrixBase<DerivedDistances>& distances =
+        const_cast<Eigen::MatrixBase<DerivedDistances>&>(distances_const);
+    CHECK_EQ(indices.rows(), num_neighbors);
+    CHECK_EQ(indices.cols(), packed_queries.cols());
+    CHECK_EQ(distances.rows(), num_neighbors);
+    CHECK_EQ(distances.cols(), packed_queries.cols());
+    indices.setConstant(-1);
+    distances.setConstant(std::numeric_limits<float>::infinity());
+    if (num_descriptor_bytes_ == 0) {
+      return;
+    }
+    CHECK_EQ(
+        static_cast<int>(packed_queries.rows()) * kNumBytesPerPackedWord,
+        num_descriptor_bytes_);
+
+    std::vector<unsigned char> query(num_descriptor_bytes_);
+    std::vector<std::pair<unsigned int, int>> neighbors;
+    std::unordered_set<int> visited_descriptors;
+    for (int query_idx = 0; query_idx < packed_queries.cols(); ++query_idx) {
+      UnpackDescriptor(packed_queries.col(query_idx), query.data());
+      SearchDescriptor(
+          query.data(), num_neighbors, &visited_descriptors, &neighbors);
+      for (size_t neighbor_idx = 0u; neighbor_idx < neighbors.size();
+           ++neighbor_idx) {
+        indices(neighbor_idx, query_idx) = neighbors[neighbor_idx].second;
+        distances(neighbor_idx, query_idx) =
+            static_cast<float>(neighbors[neighbor_idx].first);
+      }
+    }
+  }
+
+ private:
+  void InitializeHashTables(int num_descriptor_bytes) {
+    CHECK_GT(num_descriptor_bytes, 0);
+    CHECK_EQ(num_descriptor_bytes % 16, 0)
+        << "The Hamming kernels require a multiple of 16 bytes.";
+    num_descriptor_bytes_ = num_descriptor_bytes;
+    const int num_substrings =
+        (num_descriptor_bytes_ + num_substring_bytes_ - 1) /
+        num_substring_bytes_;
+    hash_tables_.resize(num_substrings);
+  }
+
+  inline unsigned char* GetDescriptor(int descriptor_index) {
+    return descriptors_.data() + descriptor_index * num_descriptor_bytes_;
+  }
+  inline const unsigned char* GetDescriptor(int descriptor_index) const {
+    return descriptors_.data() + descriptor_index * num_descriptor_bytes_;
+  }
+
+  // The last substring is shorter if the descriptor size is not a multiple
+  // of the substring size.
+  inline int GetNumSubstringBits(size_t substring_idx) const {
+    const int first_byte =
+        static_cast<int>(substring_idx) * num_substring_bytes_;
+    return 8 * std::min(
+                   num_substring_bytes_, num_descriptor_bytes_ - first_byte);
+  }
+
+  inline SubstringKey GetSubstringKey(
+      const unsigned char* descriptor, size_t substring_idx) const {
+    const int first_byte =
+        static_cast<int>(substring_idx) * num_substring_bytes_;
+    const int num_bytes = GetNumSubstringBits(substring_idx) / 8;
+    SubstringKey key = 0u;
+    for (int byte_idx = 0; byte_idx < num_bytes; ++byte_idx) {
+      key |= static_cast<SubstringKey>(descriptor[first_byte + byte_idx])
+             << (8 * byte_idx);
+    }
+    return key;
+  }
+
+  // Calls the function for every key that differs from the given key in
+  // exactly num_flips of the bits [first_bit, num_bits).
+  template <typename Function>
+  void ForEachKeyAtDistance(
+      SubstringKey key, int first_bit, int num_bits, int num_flips,
+      const Function& function) const {
+    if (num_flips == 0) {
+      function(key);
+      return;
+    }
+    for (int bit = first_bit; bit <= num_bits - num_flips; ++bit) {
+      ForEachKeyAtDistance(
+          key ^ (SubstringKey(1u) << bit), bit + 1, num_bits, num_flips - 1,
+          function);
+    }
+  }
+
+  void SearchDescriptor(
+      const unsigned char* query, int num_neighbors,
+      std::unordered_set<int>* visited_descriptors,
+      std::vector<std::pair<unsigned int, int>>* neighbors) const {
+    CHECK_NOTNULL(visited_descriptors)->clear();
+    CHECK_NOTNULL(neighbors)->clear();
+    const size_t num_neighbors_size = static_cast<size_t>(num_neighbors);
+    const auto verify_candidates = [&](const std::vector<int>& bucket) {
+      for (const int descriptor_index : bucket) {
+        if (!visited_descriptors->insert(descriptor_index).second) {
+          continue;
+        }
+        const std::pair<unsigned int, int> neighbor(
+            HammingDistanceOfBytes(
+                query, GetDescriptor(descriptor_index), num_descriptor_bytes_),
+            descriptor_index);
+        if (neighbors->size() >= num_neighbors_size) {
+          if (neighbor >= neighbors->back()) {
+            continue;
+          }
+          neighbors->pop_back();
+        }
+        neighbors->insert(
+            std::upper_bound(neighbors->begin(), neighbors->end(), neighbor),
+            neighbor);
+      }
+    };
+
+    const int num_substrings = static_cast<int>(hash_tables_.size());
+    for (int radius = 0; radius <= max_substring_radius_; ++radius) {
+      for (size_t substring_idx = 0u; substring_idx < hash_tables_.size();
+           ++substring_idx) {
+        const HashTable& hash_table = hash_tables_[substring_idx];
+        const int num_bits = GetNumSubstringBits(substring_idx);
+        if (radius > num_bits) {
+          continue;
+        }
+        ForEachKeyAtDistance(
+            GetSubstringKey(query, substring_idx), 0, num_bits, radius,
+            [&](SubstringKey key) {
+              const HashTable::const_iterator it = hash_table.find(key);
+              if (it != hash_table.end()) {
+                verify_candidates(it->second);
+              }
+            });
+      }
+      // All descriptors with a distance below (radius + 1) * num_substrings
+      // have at least one substring within the probed radius.
+      if (neighbors->size() >= num_neighbors_size &&
+          neighbors->back().first <
+              static_cast<unsigned int>((radius + 1) * num_substrings)) {
+        break;
+      }
+    }
+  }
+
+  const int num_substring_bytes_;
+  const int max_substring_radius_;
+  int num_descriptor_bytes_;
+  // The raw descriptors, num_descriptor_bytes_ per descriptor.
+  std::vector<unsigned char> descriptors_;
+  std::vector<HashTable> hash_tables_;
+};
+
+}  // namespace multi_index_hashing
+}  // namespace loop_closure
+
+#endif  // MATCHING_BASED_LOOPCLOSURE_MULTI_INDEX_HASHING_INDEX_H_
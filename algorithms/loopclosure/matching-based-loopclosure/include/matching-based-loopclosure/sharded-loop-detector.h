@@ -0,0 +1,78 @@
+#ifndef MATCHING_BASED_LOOPCLOSURE_SHARDED_LOOP_DETECTOR_H_
+#define MATCHING_BASED_LOOPCLOSURE_SHARDED_LOOP_DETECTOR_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <descriptor-projection/descriptor-projection.h>
+#include <loopclosure-common/types.h>
+
+#include "matching-based-loopclosure/detector-settings.h"
+#include "matching-based-loopclosure/loop-detector-interface.h"
+#include "matching-based-loopclosure/matching-based-engine.h"
+
+namespace matching_based_loopclosure {
+
+// Splits the database into independent loop detectors (shards). Images are
+// assigned to shards by the hash of their mission, such that the landmarks
+// of a mission and thus the covisibility clusters don't span shards. A query
+// is sent to all shards in parallel and the result of the shard with the
+// most matches is kept, which corresponds to selecting the largest
+// covisibility cluster in an unsharded database. Each shard can be
+// serialized and loaded on its own.
+class ShardedLoopDetector : public loop_detector::LoopDetector {
+ public:
+  ShardedLoopDetector(
+      const MatchingBasedEngineSettings& settings, size_t num_shards);
+
+  virtual ~ShardedLoopDetector() = default;
+
+  void Find(
+      const loop_closure::ProjectedImagePtrList& projected_image_ptr_list,
+      const bool parallelize_if_possible,
+      loop_closure::FrameToMatches* frame_matches) const override;
+
+  void Insert(
+      const loop_closure::ProjectedImage::Ptr& projected_image_ptr) override;
+
+  void ProjectDescriptors(
+      const loop_closure::DescriptorContainer& descriptors,
+      Eigen::MatrixXf* projected_descriptors) const override;
+
+  void ProjectDescriptors(
+      const std::vector<aslam::common::FeatureDescriptorConstRef>& descriptors,
+      Eigen::MatrixXf* projected_descriptors) const override;
+
+  void Flush() override;
+  void Clear() override;
+  size_t NumEntries() const override;
+  int NumDescriptors() const override;
+
+  void GetMemoryUsage(common::MemoryUsage* usage) const override;
+
+  // The shards are stored as nested loop detectors.
+  void serialize(proto::MatchingBasedLoopDetector* matching_based_loop_detector)
+      const override;
+  void deserialize(
+      const proto::MatchingBasedLoopDetector& matching_based_loop_detector)
+      override;
+
+  size_t numShards() const {
+    return shards_.size();
+  }
+  size_t getShardIndex(const loop_closure::DatasetId& dataset_id) const;
+  MatchingBasedLoopDetector& getShard(size_t shard_index);
+  const MatchingBasedLoopDetector& getShard(size_t shard_index) const;
+
+  // The file of a shard, given the file of the whole database.
+  static std::string getShardFilePath(
+      const std::string& file_path, size_t shard_index);
+
+ private:
+  std::vector<std::unique_ptr<MatchingBasedLoopDetector>> shards_;
+};
+
+}  // namespace matching_based_loopclosure
+
+#endif  // MATCHING_BASED_LOOPCLOSURE_SHARDED_LOOP_DETECTOR_H_
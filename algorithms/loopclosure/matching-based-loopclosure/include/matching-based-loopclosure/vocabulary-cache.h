@@ -0,0 +1,69 @@
+#ifndef MATCHING_BASED_LOOPCLOSURE_VOCABULARY_CACHE_H_
+#define MATCHING_BASED_LOOPCLOSURE_VOCABULARY_CACHE_H_
+
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+
+#include <Eigen/Core>
+#include <maplab-common/macros.h>
+
+namespace loop_closure {
+
+// Process-wide cache of the vocabularies and projection matrices that the
+// index interfaces load from disk. Every detector of the process, e.g. the
+// shards of a sharded detector or the detectors of anchoring and the
+// localizer, shares one read-only copy per file instead of loading its own.
+//
+// The entries are reference counted: the cache only keeps weak references, so
+// a file is released once the last index that uses it is destroyed. A file is
+// identified by its real path, size and modification time, such that a
+// vocabulary that is retrained in place is loaded again.
+class VocabularyCache {
+ public:
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(VocabularyCache);
+
+  static VocabularyCache& getInstance();
+
+  // Loads the vocabulary with Vocabulary::Load(std::ifstream*) if no other
+  // user holds it.
+  template <typename Vocabulary>
+  std::shared_ptr<const Vocabulary> getVocabulary(const std::string& filename);
+
+  std::shared_ptr<const Eigen::MatrixXf> getProjectionMatrix(
+      const std::string& filename);
+
+  // The number of files that are currently held by at least one user.
+  size_t numLoadedFiles();
+
+ private:
+  VocabularyCache() = default;
+
+  typedef std::function<std::shared_ptr<const void>(std::ifstream*)> Loader;
+  std::shared_ptr<const void> getOrLoad(
+      const std::string& filename, const std::type_index& type,
+      const Loader& loader);
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, std::weak_ptr<const void>> entries_;
+};
+
+template <typename Vocabulary>
+std::shared_ptr<const Vocabulary> VocabularyCache::getVocabulary(
+    const std::string& filename) {
+  const Loader loader = [](std::ifstream* in) -> std::shared_ptr<const void> {
+    std::shared_ptr<Vocabulary> vocabulary(new Vocabulary);
+    vocabulary->Load(in);
+    return vocabulary;
+  };
+  return std::static_pointer_cast<const Vocabulary>(
+      getOrLoad(filename, std::type_index(typeid(Vocabulary)), loader));
+}
+
+}  // namespace loop_closure
+
+#endif  // MATCHING_BASED_LOOPCLOSURE_VOCABULARY_CACHE_H_
@@ -28,6 +28,27 @@ DEFINE_int32(
 DEFINE_int32(
     lc_num_words_for_nn_search, 10,
     "Number of nearest words to retrieve in the inverted index.");
+DEFINE_int32(
+    lc_pq_exact_re_ranking_factor, 0,
+    "Number of product quantization candidates per neighbor that are "
+    "re-ranked with exact distances. Keeps the projected descriptors in "
+    "memory. 0 disables re-ranking.");
+DEFINE_int32(
+    lc_mih_num_substring_bytes, 2,
+    "Number of descriptor bytes per hash table key of the multi-index hashing "
+    "engine. Longer substrings give fewer candidates per key, but more keys "
+    "within a given radius.");
+DEFINE_int32(
+    lc_mih_max_substring_radius, 2,
+    "Maximal Hamming radius within which the substrings of the multi-index "
+    "hashing engine are probed. Neighbors that are farther away than "
+    "(radius + 1) * number of substrings can be missed.");
+DEFINE_uint64(
+    lc_delta_segment_max_num_descriptors, 0u,
+    "Number of descriptors of inserted images that are buffered in a delta "
+    "segment, which is searched exhaustively, before they are merged into "
+    "the index in the background. This allows inserting images without "
+    "blocking queries. 0 inserts images into the index directly.");
 
 namespace matching_based_loopclosure {
 
@@ -35,11 +56,20 @@ MatchingBasedEngineSettings::MatchingBasedEngineSettings()
     : projection_matrix_filename(FLAGS_lc_projection_matrix_filename),
       projected_quantizer_filename(FLAGS_lc_projected_quantizer_filename),
       num_closest_words_for_nn_search(FLAGS_lc_num_words_for_nn_search),
+      pq_exact_re_ranking_factor(FLAGS_lc_pq_exact_re_ranking_factor),
+      mih_num_substring_bytes(FLAGS_lc_mih_num_substring_bytes),
+      mih_max_substring_radius(FLAGS_lc_mih_max_substring_radius),
       min_image_time_seconds(FLAGS_lc_min_image_time_seconds),
       min_verify_matches_num(FLAGS_lc_min_verify_matches_num),
       fraction_best_scores(FLAGS_lc_fraction_best_scores),
-      num_nearest_neighbors(FLAGS_lc_num_neighbors) {
+      num_nearest_neighbors(FLAGS_lc_num_neighbors),
+      delta_segment_max_num_descriptors(
+          FLAGS_lc_delta_segment_max_num_descriptors) {
   CHECK_GT(num_closest_words_for_nn_search, 0);
+  CHECK_GE(pq_exact_re_ranking_factor, 0);
+  CHECK_GT(mih_num_substring_bytes, 0);
+  CHECK_LE(mih_num_substring_bytes, 4);
+  CHECK_GE(mih_max_substring_radius, 0);
   CHECK_GE(min_image_time_seconds, 0.0);
   CHECK_GE(min_verify_matches_num, 0u);
   CHECK_GT(fraction_best_scores, 0.f);
@@ -106,6 +136,8 @@ void MatchingBasedEngineSettings::setDetectorEngineType(
       kMatchingLDInvertedMultiIndexProductQuantizationString) {
     detector_engine_type =
         DetectorEngineType::kMatchingLDInvertedMultiIndexProductQuantization;
+  } else if (detector_engine_string == kMatchingLDMultiIndexHashingString) {
+    detector_engine_type = DetectorEngineType::kMatchingLDMultiIndexHashing;
   } else {
     LOG(FATAL) << "Unknown loop detector engine type: "
                << detector_engine_string;
@@ -0,0 +1,538 @@
+#include "matching-based-loopclosure/loop-detector-serializer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <aslam/common/timer.h>
+#include <glog/logging.h>
+
+#include "matching-based-loopclosure/inverted-multi-index-interface.h"
+#include "matching-based-loopclosure/matching-based-engine.h"
+
+namespace matching_based_loopclosure {
+namespace {
+constexpr uint32_t kBinaryMagicNumber = 0x424d444cu;  // "LDMB"
+constexpr uint32_t kBinaryVersion = 1u;
+// Cache line alignment, which also keeps every section aligned for its type.
+constexpr uint64_t kBinarySectionAlignment = 64u;
+
+typedef MappedLoopDetectorDatabase::KeyframeRecord KeyframeRecord;
+typedef MappedLoopDetectorDatabase::DescriptorRecord DescriptorRecord;
+
+struct BinaryHeader {
+  uint32_t magic_number;
+  uint32_t version;
+  uint64_t descriptor_dimensions;
+  uint64_t num_words_1;
+  uint64_t num_words_2;
+  uint64_t num_inverted_files;
+  uint64_t num_descriptors;
+  uint64_t num_keyframes;
+  uint64_t num_missions;
+  // Byte offsets of the sections from the beginning of the file.
+  uint64_t words_1_offset;
+  uint64_t words_2_offset;
+  uint64_t word_indices_offset;
+  uint64_t inverted_file_offsets_offset;
+  uint64_t inverted_file_descriptors_offset;
+  uint64_t inverted_file_indices_offset;
+  uint64_t descriptor_records_offset;
+  uint64_t keyframe_records_offset;
+  uint64_t landmark_ids_offset;
+  uint64_t measurements_offset;
+  uint64_t mission_ids_offset;
+  uint64_t file_size;
+};
+
+uint64_t alignSectionOffset(uint64_t offset) {
+  return (offset + kBinarySectionAlignment - 1u) / kBinarySectionAlignment *
+         kBinarySectionAlignment;
+}
+
+// Places the sections one after the other, given the sizes in the header.
+void computeBinaryLayout(BinaryHeader* header) {
+  CHECK_NOTNULL(header);
+  const uint64_t subspace_dimensions = header->descriptor_dimensions / 2u;
+  uint64_t offset = sizeof(BinaryHeader);
+  auto add_section = [&offset](uint64_t num_bytes) {
+    const uint64_t section_offset = alignSectionOffset(offset);
+    offset = section_offset + num_bytes;
+    return section_offset;
+  };
+  header->words_1_offset =
+      add_section(subspace_dimensions * header->num_words_1 * sizeof(float));
+  header->words_2_offset =
+      add_section(subspace_dimensions * header->num_words_2 * sizeof(float));
+  header->word_indices_offset =
+      add_section(header->num_inverted_files * sizeof(int32_t));
+  header->inverted_file_offsets_offset =
+      add_section((header->num_inverted_files + 1u) * sizeof(uint64_t));
+  header->inverted_file_descriptors_offset = add_section(
+      header->descriptor_dimensions * header->num_descriptors * sizeof(float));
+  header->inverted_file_indices_offset =
+      add_section(header->num_descriptors * sizeof(int32_t));
+  header->descriptor_records_offset =
+      add_section(header->num_descriptors * sizeof(DescriptorRecord));
+  header->keyframe_records_offset =
+      add_section(header->num_keyframes * sizeof(KeyframeRecord));
+  header->landmark_ids_offset =
+      add_section(2u * header->num_descriptors * sizeof(uint64_t));
+  header->measurements_offset =
+      add_section(2u * header->num_descriptors * sizeof(double));
+  header->mission_ids_offset =
+      add_section(2u * header->num_missions * sizeof(uint64_t));
+  header->file_size = alignSectionOffset(offset);
+}
+
+// Pads the file up to the section offset and writes the section.
+bool writeSection(
+    uint64_t section_offset, const void* data, uint64_t num_bytes,
+    std::ofstream* file) {
+  CHECK_NOTNULL(file);
+  const uint64_t position = static_cast<uint64_t>(file->tellp());
+  CHECK_LE(position, section_offset);
+  const std::string padding(section_offset - position, '\0');
+  file->write(padding.data(), padding.size());
+  if (num_bytes > 0u) {
+    file->write(static_cast<const char*>(data), num_bytes);
+  }
+  return file->good();
+}
+
+template <typename Type>
+const Type* getSection(
+    const common::MemoryMappedFile& mapped_file, uint64_t section_offset) {
+  CHECK_EQ(section_offset % kBinarySectionAlignment, 0u);
+  CHECK_LE(section_offset, mapped_file.size());
+  return reinterpret_cast<const Type*>(mapped_file.data() + section_offset);
+}
+
+template <typename IdType>
+void idToUint64(const IdType& id, uint64_t* id_uint64) {
+  CHECK_NOTNULL(id_uint64);
+  aslam::HashId hash_id;
+  id.toHashId(&hash_id);
+  hash_id.toUint64(id_uint64);
+}
+
+template <typename IdType>
+void idFromUint64(const uint64_t* id_uint64, IdType* id) {
+  CHECK_NOTNULL(id_uint64);
+  CHECK_NOTNULL(id);
+  aslam::HashId hash_id;
+  hash_id.fromUint64(id_uint64);
+  id->fromHashId(hash_id);
+}
+}  // namespace
+
+void MappedLoopDetectorDatabase::getKeyframeId(
+    size_t keyframe_index, loop_closure::KeyframeId* keyframe_id) const {
+  CHECK_NOTNULL(keyframe_id);
+  CHECK_LT(keyframe_index, num_keyframes_);
+  const KeyframeRecord& keyframe = keyframes_[keyframe_index];
+  idFromUint64(keyframe.vertex_id, &keyframe_id->vertex_id);
+  keyframe_id->frame_index = keyframe.frame_index;
+}
+
+void MappedLoopDetectorDatabase::getKeypoint(
+    int descriptor_index, loop_closure::KeypointId* keypoint_id,
+    int64_t* timestamp_nanoseconds, loop_closure::DatasetId* dataset_id,
+    loop_closure::PointLandmarkId* landmark_id) const {
+  CHECK_NOTNULL(keypoint_id);
+  CHECK_NOTNULL(timestamp_nanoseconds);
+  CHECK_NOTNULL(dataset_id);
+  CHECK_NOTNULL(landmark_id);
+  CHECK_GE(descriptor_index, 0);
+  CHECK_LT(static_cast<size_t>(descriptor_index), num_descriptors_);
+  const DescriptorRecord& descriptor = descriptors_[descriptor_index];
+  getKeyframeId(descriptor.keyframe_index, &keypoint_id->frame_id);
+  keypoint_id->keypoint_index = descriptor.keypoint_index;
+
+  const KeyframeRecord& keyframe = keyframes_[descriptor.keyframe_index];
+  CHECK_LT(descriptor.keypoint_index, keyframe.num_keypoints);
+  *timestamp_nanoseconds = keyframe.timestamp_nanoseconds;
+  idFromUint64(keyframe.dataset_id, dataset_id);
+  const uint64_t keypoint = keyframe.first_keypoint + descriptor.keypoint_index;
+  idFromUint64(landmark_ids_ + 2u * keypoint, landmark_id);
+}
+
+void MappedLoopDetectorDatabase::getProjectedImage(
+    size_t keyframe_index,
+    loop_closure::ProjectedImage* projected_image) const {
+  CHECK_NOTNULL(projected_image);
+  CHECK_LT(keyframe_index, num_keyframes_);
+  const KeyframeRecord& keyframe = keyframes_[keyframe_index];
+  projected_image->timestamp_nanoseconds = keyframe.timestamp_nanoseconds;
+  getKeyframeId(keyframe_index, &projected_image->keyframe_id);
+  idFromUint64(keyframe.dataset_id, &projected_image->dataset_id);
+  projected_image->projected_descriptors.resize(Eigen::NoChange, 0);
+  projected_image->measurements = Eigen::Map<const Eigen::Matrix2Xd>(
+      measurements_ + 2u * keyframe.first_keypoint, 2, keyframe.num_keypoints);
+  projected_image->landmarks.resize(keyframe.num_keypoints);
+  for (uint32_t keypoint_idx = 0u; keypoint_idx < keyframe.num_keypoints;
+       ++keypoint_idx) {
+    idFromUint64(
+        landmark_ids_ + 2u * (keyframe.first_keypoint + keypoint_idx),
+        &projected_image->landmarks[keypoint_idx]);
+  }
+}
+
+bool MatchingBasedLoopDetectorSerializer::saveToBinaryFile(
+    const MatchingBasedLoopDetector& loop_detector,
+    const vi_map::MissionIdSet& missions_in_database,
+    const std::string& file_path) {
+  CHECK(!file_path.empty());
+  timing::Timer timer("Loop detector: save binary");
+  aslam::ScopedReadLock lock(&loop_detector.read_write_mutex);
+  CHECK(loop_detector.mapped_database_ == nullptr)
+      << "Saving a mapped loop detector is not supported, it is already "
+      << "stored in a file.";
+  CHECK(loop_detector.getDeltaSegment()->images.empty())
+      << "The delta segment needs to be flushed before saving.";
+
+  std::shared_ptr<loop_closure::InvertedMultiIndexInterface>
+      inverted_multi_index_interface =
+          std::dynamic_pointer_cast<loop_closure::InvertedMultiIndexInterface>(
+              loop_detector.index_interface_);
+  if (!inverted_multi_index_interface) {
+    LOG(ERROR) << "Only loop detectors using the inverted multi-index can be "
+               << "saved in the binary layout.";
+    return false;
+  }
+  const loop_closure::InvertedMultiIndexInterface::Index& index =
+      *CHECK_NOTNULL(inverted_multi_index_interface->index_.get());
+  constexpr int kDescriptorDimensions =
+      2 * loop_closure::InvertedMultiIndexInterface::kSubSpaceDimensionality;
+
+  // The database images in a fixed order and their keypoints back to back.
+  std::unordered_map<loop_closure::KeyframeId, uint32_t> keyframe_indices;
+  std::vector<KeyframeRecord> keyframes;
+  keyframe_indices.reserve(loop_detector.database_.size());
+  keyframes.reserve(loop_detector.database_.size());
+  std::vector<uint64_t> landmark_ids;
+  std::vector<double> measurements;
+  landmark_ids.reserve(2u * loop_detector.descriptor_index_);
+  measurements.reserve(2u * loop_detector.descriptor_index_);
+  for (const MatchingBasedLoopDetector::Database::value_type& database_entry :
+       loop_detector.database_) {
+    const loop_closure::ProjectedImage& projected_image =
+        *database_entry.second;
+    const size_t num_keypoints = projected_image.landmarks.size();
+    CHECK_EQ(
+        static_cast<size_t>(projected_image.measurements.cols()),
+        num_keypoints);
+
+    KeyframeRecord keyframe;
+    memset(&keyframe, 0, sizeof(KeyframeRecord));
+    idToUint64(database_entry.first.vertex_id, keyframe.vertex_id);
+    idToUint64(projected_image.dataset_id, keyframe.dataset_id);
+    keyframe.timestamp_nanoseconds = projected_image.timestamp_nanoseconds;
+    keyframe.frame_index = database_entry.first.frame_index;
+    keyframe.num_keypoints = num_keypoints;
+    keyframe.first_keypoint = landmark_ids.size() / 2u;
+    for (const loop_closure::PointLandmarkId& landmark_id :
+         projected_image.landmarks) {
+      landmark_ids.resize(landmark_ids.size() + 2u);
+      idToUint64(landmark_id, &landmark_ids[landmark_ids.size() - 2u]);
+    }
+    measurements.insert(
+        measurements.end(), projected_image.measurements.data(),
+        projected_image.measurements.data() + 2u * num_keypoints);
+
+    CHECK(keyframe_indices.emplace(database_entry.first, keyframes.size())
+              .second);
+    keyframes.push_back(keyframe);
+  }
+
+  // The descriptor indices are assigned consecutively on insertion.
+  const size_t num_descriptors = loop_detector.descriptor_index_;
+  CHECK_EQ(loop_detector.descriptor_index_to_keypoint_id_.size(),
+           num_descriptors);
+  CHECK_EQ(landmark_ids.size(), 2u * num_descriptors);
+  std::vector<DescriptorRecord> descriptor_records(num_descriptors);
+  for (const MatchingBasedLoopDetector::DescriptorIndexToKeypointIdMap::
+           value_type& descriptor_keypoint :
+       loop_detector.descriptor_index_to_keypoint_id_) {
+    CHECK_GE(descriptor_keypoint.first, 0);
+    CHECK_LT(static_cast<size_t>(descriptor_keypoint.first), num_descriptors);
+    const std::unordered_map<loop_closure::KeyframeId, uint32_t>::
+        const_iterator keyframe_it =
+            keyframe_indices.find(descriptor_keypoint.second.frame_id);
+    CHECK(keyframe_it != keyframe_indices.end());
+    DescriptorRecord& descriptor_record =
+        descriptor_records[descriptor_keypoint.first];
+    descriptor_record.keyframe_index = keyframe_it->second;
+    descriptor_record.keypoint_index =
+        descriptor_keypoint.second.keypoint_index;
+  }
+
+  // The inverted files back to back, each with the word it belongs to.
+  const int num_inverted_files = index.GetNumInvertedFiles();
+  std::vector<int32_t> word_indices(num_inverted_files, -1);
+  for (const std::pair<const int, int>& word_index : index.word_index_map_) {
+    CHECK_LT(word_index.second, num_inverted_files);
+    word_indices[word_index.second] = word_index.first;
+  }
+  std::vector<uint64_t> inverted_file_offsets(num_inverted_files + 1, 0u);
+  for (int inverted_file_idx = 0; inverted_file_idx < num_inverted_files;
+       ++inverted_file_idx) {
+    CHECK_GE(word_indices[inverted_file_idx], 0);
+    const float* descriptors;
+    const int* indices;
+    size_t num_inverted_file_descriptors;
+    index.GetInvertedFile(
+        inverted_file_idx, &descriptors, &indices,
+        &num_inverted_file_descriptors);
+    inverted_file_offsets[inverted_file_idx + 1] =
+        inverted_file_offsets[inverted_file_idx] +
+        num_inverted_file_descriptors;
+  }
+  CHECK_EQ(inverted_file_offsets.back(), num_descriptors);
+
+  std::vector<uint64_t> mission_ids(2u * missions_in_database.size());
+  size_t mission_idx = 0u;
+  for (const vi_map::MissionId& mission_id : missions_in_database) {
+    idToUint64(mission_id, &mission_ids[2u * mission_idx]);
+    ++mission_idx;
+  }
+
+  BinaryHeader header;
+  memset(&header, 0, sizeof(BinaryHeader));
+  header.magic_number = kBinaryMagicNumber;
+  header.version = kBinaryVersion;
+  header.descriptor_dimensions = kDescriptorDimensions;
+  header.num_words_1 = index.words_1_.cols();
+  header.num_words_2 = index.words_2_.cols();
+  header.num_inverted_files = num_inverted_files;
+  header.num_descriptors = num_descriptors;
+  header.num_keyframes = keyframes.size();
+  header.num_missions = missions_in_database.size();
+  computeBinaryLayout(&header);
+
+  std::ofstream file(file_path, std::ios::out | std::ios::binary);
+  if (!file.is_open()) {
+    LOG(ERROR) << "Could not open \"" << file_path << "\" for writing.";
+    return false;
+  }
+  file.write(reinterpret_cast<const char*>(&header), sizeof(BinaryHeader));
+  bool success =
+      writeSection(
+          header.words_1_offset, index.words_1_.data(),
+          index.words_1_.size() * sizeof(float), &file) &&
+      writeSection(
+          header.words_2_offset, index.words_2_.data(),
+          index.words_2_.size() * sizeof(float), &file) &&
+      writeSection(
+          header.word_indices_offset, word_indices.data(),
+          word_indices.size() * sizeof(int32_t), &file) &&
+      writeSection(
+          header.inverted_file_offsets_offset, inverted_file_offsets.data(),
+          inverted_file_offsets.size() * sizeof(uint64_t), &file);
+  // The descriptors and indices of the inverted files are written one
+  // inverted file at a time to avoid another copy of the whole index.
+  success &= writeSection(
+      header.inverted_file_descriptors_offset, nullptr, 0u, &file);
+  for (int inverted_file_idx = 0;
+       success && inverted_file_idx < num_inverted_files;
+       ++inverted_file_idx) {
+    const float* descriptors;
+    const int* indices;
+    size_t num_inverted_file_descriptors;
+    index.GetInvertedFile(
+        inverted_file_idx, &descriptors, &indices,
+        &num_inverted_file_descriptors);
+    file.write(
+        reinterpret_cast<const char*>(descriptors),
+        num_inverted_file_descriptors * kDescriptorDimensions * sizeof(float));
+    success &= file.good();
+  }
+  success &=
+      writeSection(header.inverted_file_indices_offset, nullptr, 0u, &file);
+  for (int inverted_file_idx = 0;
+       success && inverted_file_idx < num_inverted_files;
+       ++inverted_file_idx) {
+    const float* descriptors;
+    const int* indices;
+    size_t num_inverted_file_descriptors;
+    index.GetInvertedFile(
+        inverted_file_idx, &descriptors, &indices,
+        &num_inverted_file_descriptors);
+    file.write(
+        reinterpret_cast<const char*>(indices),
+        num_inverted_file_descriptors * sizeof(int32_t));
+    success &= file.good();
+  }
+  success = success &&
+            writeSection(
+                header.descriptor_records_offset, descriptor_records.data(),
+                descriptor_records.size() * sizeof(DescriptorRecord), &file) &&
+            writeSection(
+                header.keyframe_records_offset, keyframes.data(),
+                keyframes.size() * sizeof(KeyframeRecord), &file) &&
+            writeSection(
+                header.landmark_ids_offset, landmark_ids.data(),
+                landmark_ids.size() * sizeof(uint64_t), &file) &&
+            writeSection(
+                header.measurements_offset, measurements.data(),
+                measurements.size() * sizeof(double), &file) &&
+            writeSection(
+                header.mission_ids_offset, mission_ids.data(),
+                mission_ids.size() * sizeof(uint64_t), &file) &&
+            writeSection(header.file_size, nullptr, 0u, &file);
+  LOG_IF(ERROR, !success) << "Writing \"" << file_path << "\" failed.";
+  return success;
+}
+
+bool MatchingBasedLoopDetectorSerializer::mapFromBinaryFile(
+    const std::string& file_path, MatchingBasedLoopDetector* loop_detector,
+    vi_map::MissionIdSet* missions_in_database) {
+  CHECK(!file_path.empty());
+  CHECK_NOTNULL(loop_detector);
+  CHECK_NOTNULL(missions_in_database);
+  timing::Timer timer("Loop detector: map binary");
+
+  std::shared_ptr<common::MemoryMappedFile> mapped_file =
+      std::make_shared<common::MemoryMappedFile>();
+  if (!mapped_file->open(file_path)) {
+    return false;
+  }
+  BinaryHeader header;
+  if (mapped_file->size() < sizeof(BinaryHeader)) {
+    LOG(ERROR) << "\"" << file_path << "\" is too small for a loop detector.";
+    return false;
+  }
+  memcpy(&header, mapped_file->data(), sizeof(BinaryHeader));
+  if (header.magic_number != kBinaryMagicNumber ||
+      header.version != kBinaryVersion) {
+    LOG(ERROR) << "\"" << file_path << "\" is not a binary loop detector of "
+               << "version " << kBinaryVersion << ".";
+    return false;
+  }
+  BinaryHeader expected_layout = header;
+  computeBinaryLayout(&expected_layout);
+  if (memcmp(&header, &expected_layout, sizeof(BinaryHeader)) != 0 ||
+      mapped_file->size() < header.file_size) {
+    LOG(ERROR) << "The binary loop detector \"" << file_path
+               << "\" is corrupt or truncated.";
+    return false;
+  }
+
+  std::shared_ptr<loop_closure::InvertedMultiIndexInterface>
+      inverted_multi_index_interface =
+          std::dynamic_pointer_cast<loop_closure::InvertedMultiIndexInterface>(
+              loop_detector->index_interface_);
+  if (!inverted_multi_index_interface) {
+    LOG(ERROR) << "Only loop detectors using the inverted multi-index can be "
+               << "mapped from the binary layout.";
+    return false;
+  }
+  loop_closure::InvertedMultiIndexInterface::Index& index =
+      *CHECK_NOTNULL(inverted_multi_index_interface->index_.get());
+
+  // The inverted files store projected descriptors and word indices, which
+  // are only meaningful for the vocabulary they were created with.
+  const int subspace_dimensions =
+      loop_closure::InvertedMultiIndexInterface::kSubSpaceDimensionality;
+  if (header.descriptor_dimensions != 2u * subspace_dimensions ||
+      header.num_words_1 != static_cast<uint64_t>(index.words_1_.cols()) ||
+      header.num_words_2 != static_cast<uint64_t>(index.words_2_.cols()) ||
+      memcmp(
+          index.words_1_.data(),
+          getSection<float>(*mapped_file, header.words_1_offset),
+          index.words_1_.size() * sizeof(float)) != 0 ||
+      memcmp(
+          index.words_2_.data(),
+          getSection<float>(*mapped_file, header.words_2_offset),
+          index.words_2_.size() * sizeof(float)) != 0) {
+    LOG(ERROR) << "The binary loop detector \"" << file_path << "\" was "
+               << "created with a different vocabulary.";
+    return false;
+  }
+
+  aslam::ScopedWriteLock lock(&loop_detector->read_write_mutex);
+  CHECK(loop_detector->database_.empty() &&
+        loop_detector->mapped_database_ == nullptr &&
+        loop_detector->getDeltaSegment()->images.empty())
+      << "Only an empty loop detector can be mapped from a file.";
+  CHECK_EQ(index.GetNumDescriptorsInIndex(), 0);
+
+  // The keyframe and word maps are rebuilt, everything that scales with the
+  // number of descriptors stays in the mapped file.
+  std::shared_ptr<MappedLoopDetectorDatabase> mapped_database =
+      std::make_shared<MappedLoopDetectorDatabase>();
+  mapped_database->mapped_file_ = mapped_file;
+  mapped_database->keyframes_ =
+      getSection<KeyframeRecord>(*mapped_file, header.keyframe_records_offset);
+  mapped_database->num_keyframes_ = header.num_keyframes;
+  mapped_database->descriptors_ = getSection<DescriptorRecord>(
+      *mapped_file, header.descriptor_records_offset);
+  mapped_database->num_descriptors_ = header.num_descriptors;
+  mapped_database->landmark_ids_ =
+      getSection<uint64_t>(*mapped_file, header.landmark_ids_offset);
+  mapped_database->measurements_ =
+      getSection<double>(*mapped_file, header.measurements_offset);
+
+  loop_detector->keyframe_id_to_num_descriptors_.clear();
+  loop_detector->keyframe_id_to_num_descriptors_.reserve(header.num_keyframes);
+  uint64_t num_keypoints = 0u;
+  for (size_t keyframe_idx = 0u; keyframe_idx < header.num_keyframes;
+       ++keyframe_idx) {
+    loop_closure::KeyframeId keyframe_id;
+    mapped_database->getKeyframeId(keyframe_idx, &keyframe_id);
+    CHECK(keyframe_id.isValid());
+    const KeyframeRecord& keyframe = mapped_database->keyframes_[keyframe_idx];
+    CHECK_EQ(keyframe.first_keypoint, num_keypoints);
+    num_keypoints += keyframe.num_keypoints;
+    CHECK(loop_detector->keyframe_id_to_num_descriptors_
+              .emplace(keyframe_id, keyframe.num_keypoints)
+              .second);
+  }
+  CHECK_EQ(num_keypoints, header.num_descriptors);
+  loop_detector->descriptor_index_ = header.num_descriptors;
+  loop_detector->mapped_database_ = mapped_database;
+
+  const int32_t* word_indices =
+      getSection<int32_t>(*mapped_file, header.word_indices_offset);
+  index.Clear();
+  index.word_index_map_.reserve(header.num_inverted_files);
+  for (size_t inverted_file_idx = 0u;
+       inverted_file_idx < header.num_inverted_files; ++inverted_file_idx) {
+    CHECK(index.word_index_map_
+              .emplace(word_indices[inverted_file_idx], inverted_file_idx)
+              .second);
+  }
+  index.mapped_inverted_file_offsets_ = getSection<uint64_t>(
+      *mapped_file, header.inverted_file_offsets_offset);
+  CHECK_EQ(
+      index.mapped_inverted_file_offsets_[header.num_inverted_files],
+      header.num_descriptors);
+  index.mapped_descriptors_ = getSection<float>(
+      *mapped_file, header.inverted_file_descriptors_offset);
+  index.mapped_indices_ =
+      getSection<int>(*mapped_file, header.inverted_file_indices_offset);
+  index.num_mapped_inverted_files_ = header.num_inverted_files;
+  index.max_db_descriptor_index_ = header.num_descriptors;
+  index.mapped_file_ = mapped_file;
+
+  const uint64_t* mission_ids =
+      getSection<uint64_t>(*mapped_file, header.mission_ids_offset);
+  for (size_t mission_idx = 0u; mission_idx < header.num_missions;
+       ++mission_idx) {
+    vi_map::MissionId mission_id;
+    idFromUint64(mission_ids + 2u * mission_idx, &mission_id);
+    CHECK(mission_id.isValid());
+    missions_in_database->insert(mission_id);
+  }
+
+  VLOG(1) << "Mapped a loop detector with " << header.num_descriptors
+          << " descriptors in " << header.num_keyframes << " images from \""
+          << file_path << "\".";
+  return true;
+}
+
+}  // namespace matching_based_loopclosure
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -20,16 +21,26 @@
 #include "matching-based-loopclosure/inverted-index-interface.h"
 #include "matching-based-loopclosure/inverted-multi-index-interface.h"
 #include "matching-based-loopclosure/kd-tree-index-interface.h"
+#include "matching-based-loopclosure/loop-detector-serializer.h"
 #include "matching-based-loopclosure/matching-based-engine.h"
+#include "matching-based-loopclosure/multi-index-hashing-index-interface.h"
 #include "matching-based-loopclosure/scoring.h"
 
 namespace matching_based_loopclosure {
 
 MatchingBasedLoopDetector::MatchingBasedLoopDetector(
     const MatchingBasedEngineSettings& settings)
-    : settings_(settings), descriptor_index_(0) {
+    : settings_(settings),
+      descriptor_index_(0),
+      delta_segment_(std::make_shared<DeltaSegment>()),
+      merge_requested_(false),
+      shutdown_requested_(false) {
   setKeyframeScoringFunction();
   setDetectorEngine();
+  if (settings_.delta_segment_max_num_descriptors > 0u) {
+    merge_thread_ =
+        std::thread(&MatchingBasedLoopDetector::mergeThreadLoop, this);
+  }
 
   VLOG(1) << "Initializing loop-detector:"
           << "\n\tengine: " << settings_.detector_engine_type_string
@@ -38,6 +49,17 @@ MatchingBasedLoopDetector::MatchingBasedLoopDetector(
           << "\n\tproj matrix: " << settings_.projection_matrix_filename;
 }
 
+MatchingBasedLoopDetector::~MatchingBasedLoopDetector() {
+  if (merge_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(merge_mutex_);
+      shutdown_requested_ = true;
+    }
+    merge_condition_.notify_one();
+    merge_thread_.join();
+  }
+}
+
 void MatchingBasedLoopDetector::ProjectDescriptors(
     const aslam::VisualFrame::DescriptorsT& descriptors,
     Eigen::MatrixXf* projected_descriptors) const {
@@ -63,6 +85,11 @@ void MatchingBasedLoopDetector::Find(
 
   timing::Timer timer_find("Loop Closure: Find projected images of vertex.");
   aslam::ScopedReadLock lock(&read_write_mutex);
+  // The delta segment is only replaced by a merge while the write lock is
+  // held, so the snapshot doesn't overlap with the index.
+  const std::shared_ptr<const DeltaSegment> delta_segment = getDeltaSegment();
+  const DeltaSegment* delta_segment_to_search =
+      delta_segment->images.empty() ? nullptr : delta_segment.get();
 
   const int num_neighbors_to_search = getNumNeighborsToSearch();
   const size_t num_query_frames = projected_image_ptr_list.size();
@@ -101,22 +128,56 @@ void MatchingBasedLoopDetector::Find(
       timer_get_nn.Stop();
 
       KeyframeToMatchesMap keyframe_to_matches_map;
+      std::vector<DeltaNeighbor> delta_neighbors;
       for (int keypoint_idx = 0; keypoint_idx < indices.cols();
            ++keypoint_idx) {
+        if (delta_segment_to_search != nullptr) {
+          findDeltaNeighbors(
+              *delta_segment_to_search,
+              projected_image_query.projected_descriptors.col(keypoint_idx),
+              num_neighbors_to_search, &delta_neighbors);
+        }
+        // Merges the neighbors from the index and the delta segment, which
+        // are both sorted by distance.
+        int index_neighbor_idx = 0;
+        size_t delta_neighbor_idx = 0u;
         for (int nn_search_idx = 0; nn_search_idx < indices.rows();
              ++nn_search_idx) {
-          const int nn_match_descriptor_idx =
-              indices(nn_search_idx, keypoint_idx);
-          const float nn_match_distance =
-              distances(nn_search_idx, keypoint_idx);
-          if (nn_match_descriptor_idx == -1 ||
-              nn_match_distance == std::numeric_limits<float>::infinity()) {
+          const bool has_index_neighbor =
+              index_neighbor_idx < indices.rows() &&
+              indices(index_neighbor_idx, keypoint_idx) != -1 &&
+              distances(index_neighbor_idx, keypoint_idx) !=
+                  std::numeric_limits<float>::infinity();
+          const bool has_delta_neighbor =
+              delta_segment_to_search != nullptr &&
+              delta_neighbor_idx < delta_neighbors.size();
+          if (!has_index_neighbor && !has_delta_neighbor) {
             break;  // No more results for this feature.
           }
           loop_closure::Match structure_match;
-          if (!getMatchForDescriptorIndex(
-                  nn_match_descriptor_idx, projected_image_query, keypoint_idx,
-                  &structure_match)) {
+          bool is_match_valid;
+          if (has_delta_neighbor &&
+              (!has_index_neighbor ||
+               delta_neighbors[delta_neighbor_idx].distance <
+                   distances(index_neighbor_idx, keypoint_idx))) {
+            const DeltaNeighbor& delta_neighbor =
+                delta_neighbors[delta_neighbor_idx++];
+            const loop_closure::ProjectedImage& image = *delta_neighbor.image;
+            const loop_closure::PointLandmarkId landmark_id =
+                image.landmarks.empty()
+                    ? loop_closure::PointLandmarkId()
+                    : image.landmarks[delta_neighbor.keypoint_index];
+            is_match_valid = getMatchForKeypoint(
+                loop_closure::KeypointId(
+                    image.keyframe_id, delta_neighbor.keypoint_index),
+                image.timestamp_nanoseconds, image.dataset_id, landmark_id,
+                projected_image_query, keypoint_idx, &structure_match);
+          } else {
+            is_match_valid = getMatchForDescriptorIndex(
+                indices(index_neighbor_idx++, keypoint_idx),
+                projected_image_query, keypoint_idx, &structure_match);
+          }
+          if (!is_match_valid) {
             continue;
           }
 
@@ -129,7 +190,8 @@ void MatchingBasedLoopDetector::Find(
       // removing non-unique matches can split covisibility clusters.
       doCovisibilityFiltering(
           keyframe_to_matches_map, !use_vertex_covis_filter,
-          &temporary_frame_matches, covis_frame_matches_mutex_ptr);
+          &temporary_frame_matches, covis_frame_matches_mutex_ptr,
+          delta_segment_to_search);
     }
   };
   if (parallelize) {
@@ -176,27 +238,69 @@ bool MatchingBasedLoopDetector::getMatchForDescriptorIndex(
     int keypoint_index_query, loop_closure::Match* structure_match_ptr) const {
   CHECK_GE(nn_match_descriptor_index, 0);
   CHECK_NOTNULL(structure_match_ptr);
-  loop_closure::Match& structure_match = *structure_match_ptr;
 
-  const DescriptorIndexToKeypointIdMap::const_iterator iter_keypoint_id_result =
-      descriptor_index_to_keypoint_id_.find(nn_match_descriptor_index);
-  CHECK(iter_keypoint_id_result != descriptor_index_to_keypoint_id_.cend());
-  const loop_closure::KeypointId& keypoint_id_result =
-      iter_keypoint_id_result->second;
-  CHECK(keypoint_id_result.isValid());
+  loop_closure::KeypointId keypoint_id_result;
+  int64_t timestamp_nanoseconds_result;
+  loop_closure::DatasetId dataset_id_result;
+  loop_closure::PointLandmarkId landmark_id_result;
+  if (mapped_database_ != nullptr) {
+    mapped_database_->getKeypoint(
+        nn_match_descriptor_index, &keypoint_id_result,
+        &timestamp_nanoseconds_result, &dataset_id_result,
+        &landmark_id_result);
+    CHECK(keypoint_id_result.isValid());
+  } else {
+    const DescriptorIndexToKeypointIdMap::const_iterator
+        iter_keypoint_id_result =
+            descriptor_index_to_keypoint_id_.find(nn_match_descriptor_index);
+    CHECK(iter_keypoint_id_result != descriptor_index_to_keypoint_id_.cend());
+    keypoint_id_result = iter_keypoint_id_result->second;
+    CHECK(keypoint_id_result.isValid());
+
+    const Database::const_iterator iter_image_result =
+        database_.find(keypoint_id_result.frame_id);
+    CHECK(iter_image_result != database_.cend());
+    const loop_closure::ProjectedImage& projected_image_result =
+        *iter_image_result->second;
+    timestamp_nanoseconds_result =
+        projected_image_result.timestamp_nanoseconds;
+    dataset_id_result = projected_image_result.dataset_id;
+    if (!projected_image_result.landmarks.empty()) {
+      CHECK_LT(
+          keypoint_id_result.keypoint_index,
+          projected_image_result.landmarks.size());
+      landmark_id_result =
+          projected_image_result.landmarks[keypoint_id_result.keypoint_index];
+    }
+  }
+  return getMatchForKeypoint(
+      keypoint_id_result, timestamp_nanoseconds_result, dataset_id_result,
+      landmark_id_result, projected_image_query, keypoint_index_query,
+      structure_match_ptr);
+}
 
-  const Database::const_iterator iter_image_result =
-      database_.find(keypoint_id_result.frame_id);
-  CHECK(iter_image_result != database_.cend());
-  const loop_closure::ProjectedImage& projected_image_result =
-      *iter_image_result->second;
+bool MatchingBasedLoopDetector::getMatchForKeypoint(
+    const loop_closure::KeypointId& keypoint_id_result,
+    int64_t timestamp_nanoseconds_result,
+    const loop_closure::DatasetId& dataset_id_result,
+    const loop_closure::PointLandmarkId& landmark_id_result,
+    const loop_closure::ProjectedImage& projected_image_query,
+    int keypoint_index_query, loop_closure::Match* structure_match_ptr) const {
+  CHECK_NOTNULL(structure_match_ptr);
+  loop_closure::Match& structure_match = *structure_match_ptr;
 
   // Skip matches to images which are too close in time.
   if (std::abs(
           projected_image_query.timestamp_nanoseconds -
-          projected_image_result.timestamp_nanoseconds) <
+          timestamp_nanoseconds_result) <
           settings_.min_image_time_seconds * kSecondsToNanoSeconds &&
-      projected_image_query.dataset_id == projected_image_result.dataset_id) {
+      projected_image_query.dataset_id == dataset_id_result) {
+    return false;
+  }
+  // Skip matches to keyframes outside of the spatial prior of the query.
+  if (projected_image_query.candidate_vertex_ids != nullptr &&
+      projected_image_query.candidate_vertex_ids->count(
+          keypoint_id_result.frame_id.vertex_id) == 0u) {
     return false;
   }
 
@@ -206,27 +310,85 @@ bool MatchingBasedLoopDetector::getMatchForDescriptorIndex(
       static_cast<size_t>(keypoint_index_query);
   structure_match.keyframe_id_result = keypoint_id_result.frame_id;
 
-  if (!projected_image_result.landmarks.empty()) {
-    CHECK_LT(
-        keypoint_id_result.keypoint_index,
-        projected_image_result.landmarks.size());
-    structure_match.landmark_result =
-        projected_image_result.landmarks[keypoint_id_result.keypoint_index];
+  if (landmark_id_result.isValid()) {
+    structure_match.landmark_result = landmark_id_result;
     CHECK(structure_match.isValid());
   }
   return true;
 }
 
+size_t MatchingBasedLoopDetector::NumEntries() const {
+  // Locks to not count images twice while they are merged.
+  aslam::ScopedReadLock lock(&read_write_mutex);
+  const size_t num_delta_entries = getDeltaSegment()->images.size();
+  if (mapped_database_ != nullptr) {
+    return mapped_database_->numKeyframes() + num_delta_entries;
+  }
+  return database_.size() + num_delta_entries;
+}
+
+int MatchingBasedLoopDetector::NumDescriptors() const {
+  aslam::ScopedReadLock lock(&read_write_mutex);
+  return index_interface_->GetNumDescriptorsInIndex() +
+         static_cast<int>(getDeltaSegment()->num_descriptors);
+}
+
+void MatchingBasedLoopDetector::copyMappedDatabase() {
+  if (mapped_database_ == nullptr) {
+    return;
+  }
+  CHECK(database_.empty());
+  CHECK(descriptor_index_to_keypoint_id_.empty());
+  const size_t num_keyframes = mapped_database_->numKeyframes();
+  database_.reserve(num_keyframes);
+  for (size_t keyframe_idx = 0u; keyframe_idx < num_keyframes;
+       ++keyframe_idx) {
+    std::shared_ptr<loop_closure::ProjectedImage> projected_image(
+        new loop_closure::ProjectedImage);
+    mapped_database_->getProjectedImage(keyframe_idx, projected_image.get());
+    CHECK(database_.emplace(projected_image->keyframe_id, projected_image)
+              .second);
+  }
+  const size_t num_descriptors = mapped_database_->numDescriptors();
+  descriptor_index_to_keypoint_id_.reserve(num_descriptors);
+  for (size_t descriptor_idx = 0u; descriptor_idx < num_descriptors;
+       ++descriptor_idx) {
+    loop_closure::KeypointId keypoint_id;
+    int64_t timestamp_nanoseconds;
+    loop_closure::DatasetId dataset_id;
+    loop_closure::PointLandmarkId landmark_id;
+    const DescriptorIndex descriptor_index =
+        static_cast<DescriptorIndex>(descriptor_idx);
+    mapped_database_->getKeypoint(
+        descriptor_index, &keypoint_id, &timestamp_nanoseconds, &dataset_id,
+        &landmark_id);
+    CHECK(
+        descriptor_index_to_keypoint_id_.emplace(descriptor_index, keypoint_id)
+            .second);
+  }
+  mapped_database_.reset();
+}
+
 void MatchingBasedLoopDetector::Insert(
     const loop_closure::ProjectedImage::Ptr& projected_image_ptr) {
   CHECK(projected_image_ptr != nullptr);
   const loop_closure::ProjectedImage& projected_image = *projected_image_ptr;
-
-  aslam::ScopedWriteLock lock(&read_write_mutex);
   CHECK(projected_image.keyframe_id.isValid());
   CHECK_EQ(
       projected_image.projected_descriptors.cols(),
       static_cast<int>(projected_image.landmarks.size()));
+
+  if (settings_.delta_segment_max_num_descriptors > 0u) {
+    insertIntoDeltaSegment(projected_image);
+    return;
+  }
+  aslam::ScopedWriteLock lock(&read_write_mutex);
+  insertIntoIndex(projected_image);
+}
+
+void MatchingBasedLoopDetector::insertIntoIndex(
+    const loop_closure::ProjectedImage& projected_image) {
+  copyMappedDatabase();
   for (int keypoint_idx = 0;
        keypoint_idx < projected_image.projected_descriptors.cols();
        ++keypoint_idx) {
@@ -257,14 +419,198 @@ void MatchingBasedLoopDetector::Insert(
       << "Duplicate projected image in database.";
 }
 
+std::shared_ptr<const MatchingBasedLoopDetector::DeltaSegment>
+MatchingBasedLoopDetector::getDeltaSegment() const {
+  return std::atomic_load(&delta_segment_);
+}
+
+void MatchingBasedLoopDetector::findDeltaNeighbors(
+    const DeltaSegment& delta_segment,
+    const Eigen::Ref<const Eigen::VectorXf>& query_descriptor,
+    int num_neighbors, std::vector<DeltaNeighbor>* delta_neighbors) const {
+  CHECK_NOTNULL(delta_neighbors)->clear();
+  CHECK_GT(num_neighbors, 0);
+  const auto is_closer = [](
+      const DeltaNeighbor& lhs, const DeltaNeighbor& rhs) -> bool {
+    return lhs.distance < rhs.distance;
+  };
+  Eigen::RowVectorXf squared_distances;
+  for (const loop_closure::ProjectedImage::ConstPtr& image :
+       delta_segment.images) {
+    squared_distances = (image->projected_descriptors.colwise() -
+                         query_descriptor)
+                            .colwise()
+                            .squaredNorm();
+    for (int keypoint_idx = 0; keypoint_idx < squared_distances.cols();
+         ++keypoint_idx) {
+      const DeltaNeighbor neighbor{squared_distances[keypoint_idx],
+                                   image.get(), keypoint_idx};
+      if (static_cast<int>(delta_neighbors->size()) >= num_neighbors) {
+        if (!is_closer(neighbor, delta_neighbors->back())) {
+          continue;
+        }
+        delta_neighbors->pop_back();
+      }
+      delta_neighbors->insert(
+          std::upper_bound(
+              delta_neighbors->begin(), delta_neighbors->end(), neighbor,
+              is_closer),
+          neighbor);
+    }
+  }
+}
+
+void MatchingBasedLoopDetector::insertIntoDeltaSegment(
+    const loop_closure::ProjectedImage& projected_image) {
+  const loop_closure::ProjectedImage::ConstPtr projected_copy =
+      std::make_shared<loop_closure::ProjectedImage>(projected_image);
+  const size_t num_descriptors =
+      static_cast<size_t>(projected_image.projected_descriptors.cols());
+
+  bool request_merge;
+  {
+    std::lock_guard<std::mutex> lock(delta_segment_mutex_);
+    std::shared_ptr<DeltaSegment> delta_segment =
+        std::make_shared<DeltaSegment>(*getDeltaSegment());
+    CHECK(
+        delta_segment->keyframe_id_to_num_descriptors
+            .emplace(projected_image.keyframe_id, num_descriptors)
+            .second)
+        << "Duplicate projected image in database.";
+    delta_segment->images.emplace_back(projected_copy);
+    delta_segment->num_descriptors += num_descriptors;
+    request_merge = delta_segment->num_descriptors >=
+                    settings_.delta_segment_max_num_descriptors;
+    std::atomic_store(
+        &delta_segment_,
+        std::shared_ptr<const DeltaSegment>(std::move(delta_segment)));
+  }
+
+  if (request_merge) {
+    {
+      std::lock_guard<std::mutex> lock(merge_mutex_);
+      merge_requested_ = true;
+    }
+    merge_condition_.notify_one();
+  }
+}
+
+void MatchingBasedLoopDetector::mergeDeltaSegment() {
+  aslam::ScopedWriteLock lock(&read_write_mutex);
+  const std::shared_ptr<const DeltaSegment> merged_segment = getDeltaSegment();
+  if (merged_segment->images.empty()) {
+    return;
+  }
+  for (const loop_closure::ProjectedImage::ConstPtr& image :
+       merged_segment->images) {
+    insertIntoIndex(*image);
+  }
+
+  // Images inserted during the merge are appended to the merged ones and
+  // stay in the delta segment.
+  std::lock_guard<std::mutex> delta_segment_lock(delta_segment_mutex_);
+  const std::shared_ptr<const DeltaSegment> current_segment =
+      getDeltaSegment();
+  std::shared_ptr<DeltaSegment> remaining_segment =
+      std::make_shared<DeltaSegment>();
+  for (size_t image_idx = merged_segment->images.size();
+       image_idx < current_segment->images.size(); ++image_idx) {
+    const loop_closure::ProjectedImage::ConstPtr& image =
+        current_segment->images[image_idx];
+    const size_t num_descriptors =
+        static_cast<size_t>(image->projected_descriptors.cols());
+    remaining_segment->images.emplace_back(image);
+    remaining_segment->keyframe_id_to_num_descriptors.emplace(
+        image->keyframe_id, num_descriptors);
+    remaining_segment->num_descriptors += num_descriptors;
+  }
+  std::atomic_store(
+      &delta_segment_,
+      std::shared_ptr<const DeltaSegment>(std::move(remaining_segment)));
+}
+
+void MatchingBasedLoopDetector::mergeThreadLoop() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(merge_mutex_);
+      merge_condition_.wait(
+          lock, [this]() { return merge_requested_ || shutdown_requested_; });
+      if (shutdown_requested_) {
+        return;
+      }
+      merge_requested_ = false;
+    }
+    timing::Timer timer_merge("Loop Closure: merge delta segment");
+    mergeDeltaSegment();
+  }
+}
+
+void MatchingBasedLoopDetector::Flush() {
+  mergeDeltaSegment();
+}
+
 void MatchingBasedLoopDetector::Clear() {
   aslam::ScopedWriteLock lock(&read_write_mutex);
+  {
+    std::lock_guard<std::mutex> delta_segment_lock(delta_segment_mutex_);
+    std::atomic_store(
+        &delta_segment_,
+        std::shared_ptr<const DeltaSegment>(std::make_shared<DeltaSegment>()));
+  }
+  mapped_database_.reset();
   database_.clear();
+  keyframe_id_to_num_descriptors_.clear();
   descriptor_index_to_keypoint_id_.clear();
   index_interface_->Clear();
   descriptor_index_ = 0;
 }
 
+void MatchingBasedLoopDetector::GetMemoryUsage(
+    common::MemoryUsage* usage) const {
+  CHECK_NOTNULL(usage);
+  typedef common::MemoryUsage::Category Category;
+  aslam::ScopedReadLock lock(&read_write_mutex);
+  for (const Database::value_type& keyframe_id_and_image : database_) {
+    const loop_closure::ProjectedImage& projected_image =
+        *keyframe_id_and_image.second;
+    usage->add(
+        Category::kDescriptors,
+        sizeof(projected_image) +
+            common::getHeapBytes(projected_image.projected_descriptors));
+    usage->add(
+        Category::kKeypoints,
+        common::getHeapBytes(projected_image.measurements));
+    usage->add(
+        Category::kLandmarkObservations,
+        common::getHeapBytes(projected_image.landmarks));
+  }
+  usage->add(
+      Category::kIndexStructures,
+      common::getHeapBytes(database_) +
+          common::getHeapBytes(keyframe_id_to_num_descriptors_) +
+          common::getHeapBytes(descriptor_index_to_keypoint_id_) +
+          index_interface_->GetMemoryUsageBytes());
+
+  const std::shared_ptr<const DeltaSegment> delta_segment = getDeltaSegment();
+  for (const loop_closure::ProjectedImage::ConstPtr& projected_image :
+       delta_segment->images) {
+    usage->add(
+        Category::kDescriptors,
+        sizeof(*projected_image) +
+            common::getHeapBytes(projected_image->projected_descriptors));
+    usage->add(
+        Category::kKeypoints,
+        common::getHeapBytes(projected_image->measurements));
+    usage->add(
+        Category::kLandmarkObservations,
+        common::getHeapBytes(projected_image->landmarks));
+  }
+  usage->add(
+      Category::kIndexStructures,
+      common::getHeapBytes(delta_segment->images) +
+          common::getHeapBytes(delta_segment->keyframe_id_to_num_descriptors));
+}
+
 void MatchingBasedLoopDetector::setKeyframeScoringFunction() {
   typedef MatchingBasedEngineSettings::KeyframeScoringFunctionType
       ScoringFunctionType;
@@ -317,7 +663,19 @@ void MatchingBasedLoopDetector::setDetectorEngine() {
       index_interface_.reset(
           new loop_closure::InvertedMultiProductQuantizationIndexInterface(
               settings_.projected_quantizer_filename,
-              settings_.num_closest_words_for_nn_search));
+              settings_.num_closest_words_for_nn_search,
+              settings_.pq_exact_re_ranking_factor));
+      break;
+    }
+    case DetectorEngineType::kMatchingLDMultiIndexHashing: {
+      // The delta segment compares the projected descriptors by euclidean
+      // distance, which is meaningless for the packed binary descriptors.
+      CHECK_EQ(settings_.delta_segment_max_num_descriptors, 0u)
+          << "The multi-index hashing engine doesn't support a delta segment.";
+      index_interface_.reset(
+          new loop_closure::MultiIndexHashingIndexInterface(
+              settings_.mih_num_substring_bytes,
+              settings_.mih_max_substring_radius));
       break;
     }
     default: {
@@ -359,6 +717,11 @@ void MatchingBasedLoopDetector::serialize(
       settings_.detector_engine_type_string,
       kMatchingLDInvertedMultiIndexString)
       << "Only the inverted multi-index can be serialized at the moment.";
+  CHECK(mapped_database_ == nullptr)
+      << "A mapped loop detector can't be serialized to protobuf, it is "
+      << "already stored in a file.";
+  CHECK(getDeltaSegment()->images.empty())
+      << "The delta segment needs to be flushed before serializing.";
 
   for (const DescriptorIndexToKeypointIdMap::value_type&
            descriptor_index_keypoint_pair : descriptor_index_to_keypoint_id_) {
@@ -0,0 +1,176 @@
+#include "matching-based-loopclosure/sharded-loop-detector.h"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
+
+namespace matching_based_loopclosure {
+
+namespace {
+// The private overrides of the shards are accessible through the interface.
+const loop_detector::LoopDetector& asInterface(
+    const MatchingBasedLoopDetector& loop_detector) {
+  return loop_detector;
+}
+}  // namespace
+
+ShardedLoopDetector::ShardedLoopDetector(
+    const MatchingBasedEngineSettings& settings, const size_t num_shards) {
+  CHECK_GT(num_shards, 0u);
+  shards_.reserve(num_shards);
+  for (size_t shard_idx = 0u; shard_idx < num_shards; ++shard_idx) {
+    shards_.emplace_back(new MatchingBasedLoopDetector(settings));
+  }
+}
+
+void ShardedLoopDetector::Find(
+    const loop_closure::ProjectedImagePtrList& projected_image_ptr_list,
+    const bool parallelize_if_possible,
+    loop_closure::FrameToMatches* frame_matches) const {
+  CHECK_NOTNULL(frame_matches)->clear();
+  const size_t num_shards = shards_.size();
+  std::vector<loop_closure::FrameToMatches> shard_frame_matches(num_shards);
+  std::function<void(const std::vector<size_t>&)> query_shards =
+      [&](const std::vector<size_t>& range) {
+        for (const size_t shard_idx : range) {
+          shards_[shard_idx]->Find(
+              projected_image_ptr_list, parallelize_if_possible,
+              &shard_frame_matches[shard_idx]);
+        }
+      };
+  const bool parallelize = parallelize_if_possible && num_shards > 1u;
+  if (parallelize) {
+    static const size_t kNumHardwareThreads = common::getNumHardwareThreads();
+    common::ParallelProcess(
+        num_shards, query_shards, parallelize,
+        std::min<size_t>(num_shards, kNumHardwareThreads));
+  } else {
+    std::vector<size_t> shard_indices(num_shards);
+    std::iota(shard_indices.begin(), shard_indices.end(), 0u);
+    query_shards(shard_indices);
+  }
+
+  // Each shard returns its largest covisibility cluster for the query, of
+  // which the largest one is kept.
+  size_t best_shard_idx = 0u;
+  size_t max_num_matches = 0u;
+  for (size_t shard_idx = 0u; shard_idx < num_shards; ++shard_idx) {
+    const size_t num_matches =
+        loop_closure::getNumberOfMatches(shard_frame_matches[shard_idx]);
+    if (num_matches > max_num_matches) {
+      max_num_matches = num_matches;
+      best_shard_idx = shard_idx;
+    }
+  }
+  frame_matches->swap(shard_frame_matches[best_shard_idx]);
+}
+
+void ShardedLoopDetector::Insert(
+    const loop_closure::ProjectedImage::Ptr& projected_image_ptr) {
+  CHECK(projected_image_ptr != nullptr);
+  shards_[getShardIndex(projected_image_ptr->dataset_id)]->Insert(
+      projected_image_ptr);
+}
+
+void ShardedLoopDetector::ProjectDescriptors(
+    const loop_closure::DescriptorContainer& descriptors,
+    Eigen::MatrixXf* projected_descriptors) const {
+  // All shards use the same projection.
+  shards_.front()->ProjectDescriptors(descriptors, projected_descriptors);
+}
+
+void ShardedLoopDetector::ProjectDescriptors(
+    const std::vector<aslam::common::FeatureDescriptorConstRef>& descriptors,
+    Eigen::MatrixXf* projected_descriptors) const {
+  shards_.front()->ProjectDescriptors(descriptors, projected_descriptors);
+}
+
+void ShardedLoopDetector::Flush() {
+  for (const std::unique_ptr<MatchingBasedLoopDetector>& shard : shards_) {
+    shard->Flush();
+  }
+}
+
+void ShardedLoopDetector::Clear() {
+  for (const std::unique_ptr<MatchingBasedLoopDetector>& shard : shards_) {
+    shard->Clear();
+  }
+}
+
+size_t ShardedLoopDetector::NumEntries() const {
+  size_t num_entries = 0u;
+  for (const std::unique_ptr<MatchingBasedLoopDetector>& shard : shards_) {
+    num_entries += asInterface(*shard).NumEntries();
+  }
+  return num_entries;
+}
+
+int ShardedLoopDetector::NumDescriptors() const {
+  int num_descriptors = 0;
+  for (const std::unique_ptr<MatchingBasedLoopDetector>& shard : shards_) {
+    num_descriptors += asInterface(*shard).NumDescriptors();
+  }
+  return num_descriptors;
+}
+
+void ShardedLoopDetector::GetMemoryUsage(common::MemoryUsage* usage) const {
+  CHECK_NOTNULL(usage);
+  for (const std::unique_ptr<MatchingBasedLoopDetector>& shard : shards_) {
+    shard->GetMemoryUsage(usage);
+  }
+}
+
+void ShardedLoopDetector::serialize(
+    proto::MatchingBasedLoopDetector* proto_matching_based_loop_detector)
+    const {
+  CHECK_NOTNULL(proto_matching_based_loop_detector);
+  for (const std::unique_ptr<MatchingBasedLoopDetector>& shard : shards_) {
+    shard->serialize(proto_matching_based_loop_detector->add_shards());
+  }
+}
+
+void ShardedLoopDetector::deserialize(
+    const proto::MatchingBasedLoopDetector&
+        proto_matching_based_loop_detector) {
+  CHECK_EQ(
+      static_cast<size_t>(proto_matching_based_loop_detector.shards_size()),
+      shards_.size())
+      << "The loop detector has been serialized with a different number of "
+      << "shards.";
+  for (size_t shard_idx = 0u; shard_idx < shards_.size(); ++shard_idx) {
+    shards_[shard_idx]->deserialize(
+        proto_matching_based_loop_detector.shards(static_cast<int>(shard_idx)));
+  }
+}
+
+size_t ShardedLoopDetector::getShardIndex(
+    const loop_closure::DatasetId& dataset_id) const {
+  CHECK(dataset_id.isValid());
+  return dataset_id.hashToSizeT() % shards_.size();
+}
+
+MatchingBasedLoopDetector& ShardedLoopDetector::getShard(
+    const size_t shard_index) {
+  CHECK_LT(shard_index, shards_.size());
+  return *shards_[shard_index];
+}
+
+const MatchingBasedLoopDetector& ShardedLoopDetector::getShard(
+    const size_t shard_index) const {
+  CHECK_LT(shard_index, shards_.size());
+  return *shards_[shard_index];
+}
+
+std::string ShardedLoopDetector::getShardFilePath(
+    const std::string& file_path, const size_t shard_index) {
+  return file_path + ".shard" + std::to_string(shard_index);
+}
+
+}  // namespace matching_based_loopclosure
@@ -2,6 +2,8 @@
 
 #include <algorithm>
 #include <cstdio>
+#include <functional>
+#include <random>
 #include <vector>
 
 #include <Eigen/Core>
@@ -11,6 +13,8 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <loopclosure-common/types.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 #include <vi-map/vi-map.h>
 #include <vocabulary-tree/tree-builder.h>
 
@@ -33,6 +37,16 @@ DEFINE_int32(
 DEFINE_int32(
     lc_product_quantization_num_words, 256,
     "Number of words in the product vocabulary.");
+DEFINE_int32(
+    lc_vocabulary_kmeans_restarts, 1,
+    "Number of k-means restarts per vocabulary, which are run in parallel.");
+DEFINE_int32(
+    lc_vocabulary_kmeans_max_iterations, 100,
+    "Maximum number of k-means iterations per vocabulary.");
+DEFINE_int32(
+    lc_vocabulary_kmeans_mini_batch_size, 0,
+    "If positive, the vocabularies are trained with mini-batch k-means on "
+    "batches of this size instead of Lloyd's algorithm.");
 
 DECLARE_string(load_map);
 
@@ -57,8 +71,14 @@ void MakeVocabulary(
 
   // Create tree.
   static constexpr int kLevels = 1;
+  CHECK_GT(FLAGS_lc_vocabulary_kmeans_restarts, 0);
+  CHECK_GT(FLAGS_lc_vocabulary_kmeans_max_iterations, 0);
+  CHECK_GE(FLAGS_lc_vocabulary_kmeans_mini_batch_size, 0);
   ProjectedTreeBuilder builder(descriptor_zero);
-  builder.kmeans().SetRestarts(1);
+  builder.kmeans().SetRestarts(FLAGS_lc_vocabulary_kmeans_restarts);
+  builder.kmeans().SetMaxIterations(FLAGS_lc_vocabulary_kmeans_max_iterations);
+  builder.kmeans().SetMiniBatchSize(
+      FLAGS_lc_vocabulary_kmeans_mini_batch_size);
   builder.Build(descriptors, num_words, kLevels);
   VLOG(3) << "Done. Got " << builder.tree().centers().size() << " centers";
 
@@ -88,12 +108,18 @@ void LoadBinaryFeaturesFromDataset(
                  << FLAGS_feature_descriptor_type;
   }
 
-  CHECK_NOTNULL(descriptors);
+  CHECK_GT(FLAGS_lc_num_descriptors_to_train, 0);
+  const int max_num_descriptors = FLAGS_lc_num_descriptors_to_train;
 
   vi_map::MissionIdList all_mission_ids;
   map.getAllMissionIds(&all_mission_ids);
 
-  loop_closure::DescriptorContainer all_descriptors;
+  // The descriptors are streamed mission by mission into a reservoir sample,
+  // such that the training set is drawn uniformly from all missions while
+  // at most one mission and the sample are held in memory.
+  std::mt19937 generator(42);
+  int num_sampled_descriptors = 0;
+  size_t num_visited_descriptors = 0u;
   for (const vi_map::MissionId& mission_id : all_mission_ids) {
     std::vector<descriptor_projection::Track> tracks;
 
@@ -102,22 +128,34 @@ void LoadBinaryFeaturesFromDataset(
     CollectAndConvertDescriptors(
         map, mission_id, descriptor_size, raw_descriptor_matching_threshold,
         &mission_descriptors, &tracks);
-    int old_size = all_descriptors.cols();
-    all_descriptors.conservativeResize(
-        Eigen::NoChange, old_size + mission_descriptors.cols());
-    all_descriptors.block(
-        0, old_size, mission_descriptors.rows(), mission_descriptors.cols()) =
-        mission_descriptors;
-    if (all_descriptors.cols() >= FLAGS_lc_num_descriptors_to_train) {
-      break;
+    if (mission_descriptors.cols() == 0) {
+      continue;
+    }
+    if (num_sampled_descriptors == 0) {
+      descriptors->resize(mission_descriptors.rows(), max_num_descriptors);
+    }
+    CHECK_EQ(descriptors->rows(), mission_descriptors.rows());
+
+    for (int i = 0; i < mission_descriptors.cols();
+         ++i, ++num_visited_descriptors) {
+      if (num_sampled_descriptors < max_num_descriptors) {
+        descriptors->col(num_sampled_descriptors) = mission_descriptors.col(i);
+        ++num_sampled_descriptors;
+        continue;
+      }
+      std::uniform_int_distribution<size_t> slot_distribution(
+          0u, num_visited_descriptors);
+      const size_t slot = slot_distribution(generator);
+      if (slot < static_cast<size_t>(max_num_descriptors)) {
+        descriptors->col(slot) = mission_descriptors.col(i);
+      }
     }
   }
+  descriptors->conservativeResize(Eigen::NoChange, num_sampled_descriptors);
 
-  if (all_descriptors.cols() > FLAGS_lc_num_descriptors_to_train) {
-    LOG(WARNING) << "Truncated number of descriptors "
-                 << FLAGS_lc_num_descriptors_to_train;
-    all_descriptors.conservativeResize(
-        Eigen::NoChange, FLAGS_lc_num_descriptors_to_train);
+  if (num_visited_descriptors > static_cast<size_t>(max_num_descriptors)) {
+    LOG(WARNING) << "Sampled " << max_num_descriptors << " out of "
+                 << num_visited_descriptors << " descriptors.";
   }
 }
 
@@ -155,19 +193,31 @@ void MakeProductVocabularies(
   Aligned<std::vector, DescriptorVector> descriptors_v1;
   descriptors_v1.resize(base_vocabulary.cols());
 
-  for (const ProjectedDescriptorType& projected_descriptor :
-       input_descriptors) {
-    int best_word = 0;
-    float best_distance = std::numeric_limits<float>::max();
-    for (int i = 0; i < base_vocabulary.cols(); ++i) {
-      float distance =
-          (base_vocabulary.col(i) - projected_descriptor).squaredNorm();
-      if (distance < best_distance) {
-        best_distance = distance;
-        best_word = i;
-      }
-    }
-    descriptors_v1[best_word].push_back(projected_descriptor);
+  std::vector<int> best_words(input_descriptors.size());
+  std::function<void(const std::vector<size_t>&)> assign_words =
+      [&](const std::vector<size_t>& range) {
+        for (const size_t descriptor_idx : range) {
+          const ProjectedDescriptorType& projected_descriptor =
+              input_descriptors[descriptor_idx];
+          int best_word = 0;
+          float best_distance = std::numeric_limits<float>::max();
+          for (int i = 0; i < base_vocabulary.cols(); ++i) {
+            float distance =
+                (base_vocabulary.col(i) - projected_descriptor).squaredNorm();
+            if (distance < best_distance) {
+              best_distance = distance;
+              best_word = i;
+            }
+          }
+          best_words[descriptor_idx] = best_word;
+        }
+      };
+  const bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      input_descriptors.size(), assign_words, kAlwaysParallelize,
+      common::getNumHardwareThreads());
+  for (size_t i = 0u; i < input_descriptors.size(); ++i) {
+    descriptors_v1[best_words[i]].push_back(input_descriptors[i]);
   }
 
   const int kHalfDescriptorLength = FLAGS_lc_target_dimensionality / 2;
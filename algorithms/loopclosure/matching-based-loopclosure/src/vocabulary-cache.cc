@@ -0,0 +1,83 @@
+#include "matching-based-loopclosure/vocabulary-cache.h"
+
+#include <sys/stat.h>
+
+#include <sstream>  // NOLINT
+#include <string>
+#include <unordered_map>
+
+#include <glog/logging.h>
+#include <maplab-common/binary-serialization.h>
+#include <maplab-common/file-system-tools.h>
+
+namespace loop_closure {
+
+VocabularyCache& VocabularyCache::getInstance() {
+  static VocabularyCache instance;
+  return instance;
+}
+
+std::shared_ptr<const Eigen::MatrixXf> VocabularyCache::getProjectionMatrix(
+    const std::string& filename) {
+  const Loader loader = [](std::ifstream* in) -> std::shared_ptr<const void> {
+    std::shared_ptr<Eigen::MatrixXf> projection_matrix =
+        std::make_shared<Eigen::MatrixXf>();
+    common::Deserialize(projection_matrix.get(), in);
+    return projection_matrix;
+  };
+  return std::static_pointer_cast<const Eigen::MatrixXf>(
+      getOrLoad(filename, std::type_index(typeid(Eigen::MatrixXf)), loader));
+}
+
+size_t VocabularyCache::numLoadedFiles() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t num_loaded_files = 0u;
+  for (const std::unordered_map<std::string, std::weak_ptr<const void>>::
+           value_type& entry : entries_) {
+    if (!entry.second.expired()) {
+      ++num_loaded_files;
+    }
+  }
+  return num_loaded_files;
+}
+
+std::shared_ptr<const void> VocabularyCache::getOrLoad(
+    const std::string& filename, const std::type_index& type,
+    const Loader& loader) {
+  struct stat file_status;
+  CHECK_EQ(stat(filename.c_str(), &file_status), 0)
+      << "Failed to read vocabulary file from " << filename;
+  std::ostringstream key;
+  key << type.name() << ':' << common::getRealPath(filename) << ':'
+      << file_status.st_size << ':' << file_status.st_mtime;
+
+  // Loading under the lock makes concurrent users of the same file wait for
+  // a single load instead of each loading their own copy.
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::weak_ptr<const void>& entry = entries_[key.str()];
+  std::shared_ptr<const void> loaded = entry.lock();
+  if (loaded != nullptr) {
+    return loaded;
+  }
+
+  // Drop the entries of released files, e.g. of outdated file versions.
+  for (std::unordered_map<std::string, std::weak_ptr<const void>>::iterator
+           it = entries_.begin();
+       it != entries_.end();) {
+    if (it->second.expired() && &it->second != &entry) {
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  std::ifstream in(filename, std::ios_base::binary);
+  CHECK(in.is_open()) << "Failed to read vocabulary file from " << filename;
+  VLOG(1) << "Loading " << filename << '.';
+  loaded = loader(&in);
+  CHECK(loaded != nullptr);
+  entry = loaded;
+  return loaded;
+}
+
+}  // namespace loop_closure
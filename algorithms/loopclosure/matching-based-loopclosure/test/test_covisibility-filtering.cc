@@ -0,0 +1,315 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <Eigen/Core>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <vi-map/unique-id.h>
+
+#include "matching-based-loopclosure/detector-settings.h"
+#include "matching-based-loopclosure/matching-based-engine.h"
+
+namespace {
+// Counts the heap allocations of the whole process.
+std::atomic<size_t> num_allocations(0u);
+}  // namespace
+
+void* operator new(std::size_t size) {
+  ++num_allocations;
+  void* ptr = std::malloc(size == 0u ? 1u : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+namespace matching_based_loopclosure {
+
+namespace {
+struct MatchHash {
+  size_t operator()(const loop_closure::Match& match) const {
+    return std::hash<vi_map::KeypointIdentifier>()(match.keypoint_id_query) ^
+           std::hash<vi_map::VisualFrameIdentifier>()(
+               match.keyframe_id_result) ^
+           std::hash<vi_map::LandmarkId>()(match.landmark_result);
+  }
+};
+
+bool isMatchLess(
+    const loop_closure::Match& lhs, const loop_closure::Match& rhs) {
+  return internal::isMatchOrderedBefore(lhs, rhs);
+}
+
+void getSortedMatches(
+    const loop_closure::FrameToMatches& frame_matches,
+    loop_closure::MatchVector* matches) {
+  CHECK_NOTNULL(matches)->clear();
+  for (const loop_closure::FrameToMatches::value_type& frame_matches_pair :
+       frame_matches) {
+    matches->insert(
+        matches->end(), frame_matches_pair.second.begin(),
+        frame_matches_pair.second.end());
+  }
+  std::sort(matches->begin(), matches->end(), isMatchLess);
+}
+}  // namespace
+
+class CovisibilityFilteringTest : public ::testing::Test {
+ protected:
+  static constexpr int kNumQueries = 20;
+  static constexpr int kNumKeypointsPerImage = 100;
+  static constexpr int kNumQueryKeypoints = 200;
+  static constexpr int kNumMatchesPerKeypoint = 3;
+  static constexpr int kDescriptorDimensions = 10;
+
+  virtual void SetUp() {
+    std::srand(42);
+    // Two groups of keyframes that observe disjoint sets of landmarks. The
+    // larger group forms the largest covisibility cluster.
+    addKeyframeGroup(10, 150);
+    addKeyframeGroup(5, 100);
+    loop_detector_.reset(new MatchingBasedLoopDetector(settings_));
+    for (const loop_closure::ProjectedImage::Ptr& image : database_images_) {
+      loop_detector_->Insert(image);
+    }
+    loop_detector_->Flush();
+  }
+
+  void addKeyframeGroup(const int num_keyframes, const int num_landmarks) {
+    std::vector<vi_map::LandmarkId> landmark_ids(num_landmarks);
+    for (vi_map::LandmarkId& landmark_id : landmark_ids) {
+      common::generateId(&landmark_id);
+    }
+    const vi_map::MissionId mission_id =
+        common::createRandomId<vi_map::MissionId>();
+    for (int image_idx = 0; image_idx < num_keyframes; ++image_idx) {
+      loop_closure::ProjectedImage::Ptr projected_image =
+          std::make_shared<loop_closure::ProjectedImage>();
+      common::generateId(&projected_image->keyframe_id.vertex_id);
+      projected_image->keyframe_id.frame_index = 0u;
+      projected_image->dataset_id = mission_id;
+      projected_image->timestamp_nanoseconds = image_idx * 1e9;
+      projected_image->projected_descriptors = Eigen::MatrixXf::Random(
+          kDescriptorDimensions, kNumKeypointsPerImage);
+      projected_image->measurements =
+          Eigen::Matrix2Xd::Random(2, kNumKeypointsPerImage);
+      for (int keypoint_idx = 0; keypoint_idx < kNumKeypointsPerImage;
+           ++keypoint_idx) {
+        projected_image->landmarks.push_back(
+            landmark_ids[std::rand() % num_landmarks]);
+      }
+      database_images_.push_back(projected_image);
+    }
+  }
+
+  // Matches random query keypoints to random database keypoints, including
+  // some identical matches.
+  void generateQueryMatches(
+      loop_closure::FrameToMatches* keyframe_to_matches) const {
+    CHECK_NOTNULL(keyframe_to_matches)->clear();
+    loop_closure::KeyframeId query_keyframe_id;
+    common::generateId(&query_keyframe_id.vertex_id);
+    query_keyframe_id.frame_index = 0u;
+    for (int keypoint_idx = 0; keypoint_idx < kNumQueryKeypoints;
+         ++keypoint_idx) {
+      for (int nn_idx = 0; nn_idx < kNumMatchesPerKeypoint; ++nn_idx) {
+        const loop_closure::ProjectedImage& image =
+            *database_images_[std::rand() % database_images_.size()];
+        loop_closure::Match match;
+        match.keypoint_id_query.frame_id = query_keyframe_id;
+        match.keypoint_id_query.keypoint_index = keypoint_idx;
+        match.keyframe_id_result = image.keyframe_id;
+        match.landmark_result =
+            image.landmarks[std::rand() % kNumKeypointsPerImage];
+        loop_closure::MatchVector& matches =
+            (*keyframe_to_matches)[match.keyframe_id_result];
+        matches.push_back(match);
+        if (std::rand() % 10 == 0) {
+          matches.push_back(match);
+        }
+      }
+    }
+  }
+
+  void doCovisibilityFiltering(
+      const loop_closure::FrameToMatches& keyframe_to_matches,
+      const bool make_matches_unique,
+      loop_closure::FrameToMatches* frame_matches) const {
+    loop_detector_->doCovisibilityFiltering(
+        keyframe_to_matches, make_matches_unique, frame_matches);
+  }
+
+  // The breadth-first search over hash maps that the filtering replaced.
+  void doReferenceCovisibilityFiltering(
+      const loop_closure::FrameToMatches& keyframe_to_matches,
+      const bool make_matches_unique,
+      loop_closure::FrameToMatches* frame_matches) const {
+    typedef std::unordered_map<loop_closure::Match, int, MatchHash>
+        MatchesToComponents;
+    MatchesToComponents matches_to_components;
+    std::unordered_map<vi_map::LandmarkId, loop_closure::MatchVector>
+        landmark_matches;
+    for (const loop_closure::FrameToMatches::value_type& id_matches_pair :
+         keyframe_to_matches) {
+      for (const loop_closure::Match& match : id_matches_pair.second) {
+        landmark_matches[match.landmark_result].emplace_back(match);
+        matches_to_components.emplace(match, -1);
+      }
+    }
+
+    MatchingBasedLoopDetector::CovisibilityFilteringBuffers<
+        loop_closure::KeyframeId>
+        buffers;
+    loop_detector_->computeRelevantIdsForFiltering(
+        keyframe_to_matches, nullptr, &buffers);
+    const std::unordered_set<loop_closure::KeyframeId> relevant_keyframe_ids(
+        buffers.relevant_ids.begin(), buffers.relevant_ids.end());
+
+    int num_components = 0;
+    size_t max_component_size = 0u;
+    int max_component_id = -1;
+    std::unordered_map<int,
+                       std::unordered_set<loop_closure::Match, MatchHash>>
+        components;
+    for (const MatchesToComponents::value_type& match_to_component :
+         matches_to_components) {
+      if (match_to_component.second != -1) {
+        continue;
+      }
+      const int component_id = num_components++;
+      std::queue<loop_closure::Match> exploration_queue;
+      exploration_queue.push(match_to_component.first);
+      while (!exploration_queue.empty()) {
+        const loop_closure::Match exploration_match = exploration_queue.front();
+        exploration_queue.pop();
+        if (relevant_keyframe_ids.count(
+                exploration_match.keyframe_id_result) == 0u ||
+            matches_to_components[exploration_match] != -1) {
+          continue;
+        }
+        for (const loop_closure::Match& id_match : keyframe_to_matches.at(
+                 exploration_match.keyframe_id_result)) {
+          matches_to_components[id_match] = component_id;
+          components[component_id].insert(id_match);
+          for (const loop_closure::Match& lm_match :
+               landmark_matches[id_match.landmark_result]) {
+            if (matches_to_components[lm_match] == -1) {
+              exploration_queue.push(lm_match);
+            }
+          }
+        }
+        if (components[component_id].size() > max_component_size) {
+          max_component_size = components[component_id].size();
+          max_component_id = component_id;
+        }
+      }
+    }
+
+    if (max_component_size > settings_.min_verify_matches_num) {
+      std::unordered_set<vi_map::LandmarkId> used_landmarks;
+      std::unordered_set<loop_closure::Match, MatchHash> used_matches;
+      for (const loop_closure::Match& match : components[max_component_id]) {
+        loop_closure::Match unique_match = match;
+        if (make_matches_unique) {
+          unique_match.keyframe_id_result = loop_closure::KeyframeId();
+        }
+        if (used_matches.insert(unique_match).second) {
+          (*frame_matches)[match.keypoint_id_query.frame_id].push_back(match);
+        }
+      }
+    }
+  }
+
+  MatchingBasedEngineSettings settings_;
+  std::unique_ptr<MatchingBasedLoopDetector> loop_detector_;
+  loop_closure::ProjectedImagePtrList database_images_;
+};
+
+TEST_F(CovisibilityFilteringTest, MatchesReferenceBreadthFirstSearch) {
+  for (int query_idx = 0; query_idx < kNumQueries; ++query_idx) {
+    loop_closure::FrameToMatches keyframe_to_matches;
+    generateQueryMatches(&keyframe_to_matches);
+    for (const bool make_matches_unique : {false, true}) {
+      loop_closure::FrameToMatches frame_matches;
+      doCovisibilityFiltering(
+          keyframe_to_matches, make_matches_unique, &frame_matches);
+      loop_closure::FrameToMatches reference_frame_matches;
+      doReferenceCovisibilityFiltering(
+          keyframe_to_matches, make_matches_unique, &reference_frame_matches);
+      ASSERT_EQ(1u, frame_matches.size());
+      ASSERT_EQ(1u, reference_frame_matches.size());
+
+      loop_closure::MatchVector matches;
+      getSortedMatches(frame_matches, &matches);
+      loop_closure::MatchVector reference_matches;
+      getSortedMatches(reference_frame_matches, &reference_matches);
+      ASSERT_EQ(reference_matches.size(), matches.size());
+      for (size_t match_idx = 0u; match_idx < matches.size(); ++match_idx) {
+        // Which of the keyframes observing the landmark is kept is arbitrary
+        // for unique matches.
+        EXPECT_TRUE(internal::haveSameKeypointAndLandmark(
+            reference_matches[match_idx], matches[match_idx]));
+        if (!make_matches_unique) {
+          EXPECT_TRUE(reference_matches[match_idx] == matches[match_idx]);
+        }
+      }
+    }
+  }
+}
+
+TEST_F(CovisibilityFilteringTest, AllocationsPerQuery) {
+  std::vector<loop_closure::FrameToMatches> queries(kNumQueries);
+  for (loop_closure::FrameToMatches& keyframe_to_matches : queries) {
+    generateQueryMatches(&keyframe_to_matches);
+  }
+  // Warms up the buffers of this thread.
+  loop_closure::FrameToMatches frame_matches;
+  doCovisibilityFiltering(queries.front(), true, &frame_matches);
+
+  size_t num_allocations_reference = 0u;
+  size_t num_allocations_flat = 0u;
+  size_t num_allocations_flat_without_output = 0u;
+  for (const loop_closure::FrameToMatches& keyframe_to_matches : queries) {
+    frame_matches.clear();
+    size_t num_allocations_before = num_allocations;
+    doReferenceCovisibilityFiltering(keyframe_to_matches, true, &frame_matches);
+    num_allocations_reference += num_allocations - num_allocations_before;
+
+    frame_matches.clear();
+    num_allocations_before = num_allocations;
+    doCovisibilityFiltering(keyframe_to_matches, true, &frame_matches);
+    num_allocations_flat += num_allocations - num_allocations_before;
+
+    // Keeps the output from allocating, which leaves the filtering itself.
+    ASSERT_EQ(1u, frame_matches.size());
+    loop_closure::MatchVector& matches = frame_matches.begin()->second;
+    matches.clear();
+    matches.reserve(kNumQueryKeypoints * kNumMatchesPerKeypoint);
+    num_allocations_before = num_allocations;
+    doCovisibilityFiltering(keyframe_to_matches, true, &frame_matches);
+    num_allocations_flat_without_output +=
+        num_allocations - num_allocations_before;
+  }
+
+  LOG(INFO) << "Allocations per query, breadth-first search over hash maps: "
+            << num_allocations_reference / kNumQueries;
+  LOG(INFO) << "Allocations per query, flat arrays: "
+            << num_allocations_flat / kNumQueries;
+  LOG(INFO) << "Allocations per query, flat arrays without output: "
+            << num_allocations_flat_without_output / kNumQueries;
+  EXPECT_LT(num_allocations_flat, num_allocations_reference);
+  EXPECT_EQ(0u, num_allocations_flat_without_output);
+}
+
+}  // namespace matching_based_loopclosure
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,127 @@
+#include <memory>
+
+#include <Eigen/Core>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <vi-map/unique-id.h>
+
+#include "matching-based-loopclosure/detector-settings.h"
+#include "matching-based-loopclosure/matching-based-engine.h"
+
+namespace matching_based_loopclosure {
+
+class DeltaSegmentTest : public ::testing::Test {
+ protected:
+  static constexpr int kNumImages = 50;
+  static constexpr int kNumKeypointsPerImage = 100;
+  static constexpr int kDescriptorDimensions = 10;
+
+  virtual void SetUp() {
+    std::srand(42);
+    const vi_map::MissionId database_mission_id =
+        common::createRandomId<vi_map::MissionId>();
+    for (int image_idx = 0; image_idx < kNumImages; ++image_idx) {
+      loop_closure::ProjectedImage::Ptr projected_image =
+          std::make_shared<loop_closure::ProjectedImage>();
+      common::generateId(&projected_image->keyframe_id.vertex_id);
+      projected_image->keyframe_id.frame_index = 0u;
+      projected_image->dataset_id = database_mission_id;
+      projected_image->timestamp_nanoseconds = image_idx * 1e9;
+      projected_image->projected_descriptors = Eigen::MatrixXf::Random(
+          kDescriptorDimensions, kNumKeypointsPerImage);
+      projected_image->measurements =
+          Eigen::Matrix2Xd::Random(2, kNumKeypointsPerImage);
+      projected_image->landmarks.resize(kNumKeypointsPerImage);
+      for (vi_map::LandmarkId& landmark_id : projected_image->landmarks) {
+        common::generateId(&landmark_id);
+      }
+      database_images_.push_back(projected_image);
+
+      // Queries from another mission close to the database descriptors.
+      loop_closure::ProjectedImage::Ptr query_image =
+          std::make_shared<loop_closure::ProjectedImage>(*projected_image);
+      common::generateId(&query_image->keyframe_id.vertex_id);
+      common::generateId(&query_image->dataset_id);
+      query_image->projected_descriptors +=
+          0.01 * Eigen::MatrixXf::Random(
+                     kDescriptorDimensions, kNumKeypointsPerImage);
+      query_images_.push_back(query_image);
+    }
+  }
+
+  // Every query should be matched to the image it was created from.
+  void expectQueriesFindTheirImages(
+      const MatchingBasedLoopDetector& loop_detector) const {
+    for (int image_idx = 0; image_idx < kNumImages; ++image_idx) {
+      const loop_closure::ProjectedImagePtrList query(
+          1u, query_images_[image_idx]);
+      loop_closure::FrameToMatches frame_matches;
+      loop_detector.Find(query, false, &frame_matches);
+      ASSERT_EQ(1u, frame_matches.size());
+      const loop_closure::MatchVector& matches = frame_matches.begin()->second;
+      ASSERT_FALSE(matches.empty());
+      for (const loop_closure::Match& match : matches) {
+        EXPECT_EQ(
+            database_images_[image_idx]->keyframe_id,
+            match.keyframe_id_result);
+      }
+    }
+  }
+
+  loop_closure::ProjectedImagePtrList database_images_;
+  loop_closure::ProjectedImagePtrList query_images_;
+};
+
+TEST_F(DeltaSegmentTest, QueriesFindImagesInDeltaSegmentAndIndex) {
+  MatchingBasedEngineSettings settings;
+  // Large enough to keep all images in the delta segment.
+  settings.delta_segment_max_num_descriptors =
+      2u * kNumImages * kNumKeypointsPerImage;
+  MatchingBasedLoopDetector loop_detector(settings);
+  const loop_detector::LoopDetector& loop_detector_interface = loop_detector;
+
+  // The first half is merged into the index, the second half stays in the
+  // delta segment.
+  for (int image_idx = 0; image_idx < kNumImages / 2; ++image_idx) {
+    loop_detector.Insert(database_images_[image_idx]);
+  }
+  loop_detector.Flush();
+  for (int image_idx = kNumImages / 2; image_idx < kNumImages; ++image_idx) {
+    loop_detector.Insert(database_images_[image_idx]);
+  }
+  EXPECT_EQ(
+      static_cast<size_t>(kNumImages), loop_detector_interface.NumEntries());
+  EXPECT_EQ(
+      kNumImages * kNumKeypointsPerImage,
+      loop_detector_interface.NumDescriptors());
+  expectQueriesFindTheirImages(loop_detector);
+
+  loop_detector.Flush();
+  EXPECT_EQ(
+      static_cast<size_t>(kNumImages), loop_detector_interface.NumEntries());
+  expectQueriesFindTheirImages(loop_detector);
+}
+
+TEST_F(DeltaSegmentTest, BackgroundMergeKeepsAllImages) {
+  MatchingBasedEngineSettings settings;
+  settings.delta_segment_max_num_descriptors = 3u * kNumKeypointsPerImage;
+  MatchingBasedLoopDetector loop_detector(settings);
+  const loop_detector::LoopDetector& loop_detector_interface = loop_detector;
+
+  for (const loop_closure::ProjectedImage::Ptr& image : database_images_) {
+    loop_detector.Insert(image);
+  }
+  // Images are either in the delta segment or the index at any time.
+  EXPECT_EQ(
+      static_cast<size_t>(kNumImages), loop_detector_interface.NumEntries());
+  expectQueriesFindTheirImages(loop_detector);
+
+  loop_detector.Flush();
+  EXPECT_EQ(
+      kNumImages * kNumKeypointsPerImage,
+      loop_detector_interface.NumDescriptors());
+  expectQueriesFindTheirImages(loop_detector);
+}
+
+}  // namespace matching_based_loopclosure
+
+MAPLAB_UNITTEST_ENTRYPOINT
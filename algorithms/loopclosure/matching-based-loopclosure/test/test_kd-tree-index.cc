@@ -0,0 +1,99 @@
+#include <thread>
+#include <vector>
+
+#include <Eigen/Core>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "matching-based-loopclosure/kd-tree-index.h"
+
+namespace loop_closure {
+namespace kd_tree_index {
+
+TEST(KDTreeIndexTest, ConcurrentQueriesMatchSerialQueries) {
+  constexpr int kDimensions = 10;
+  constexpr int kNumDescriptorsPerBlock = 1000;
+  constexpr int kNumQueries = 200;
+  constexpr int kNumNeighbors = 5;
+  constexpr int kNumThreads = 8;
+  std::srand(42);
+
+  typedef KDTreeIndex<kDimensions> Index;
+  Index serial_index;
+  Index concurrent_index;
+  for (int block_idx = 0; block_idx < 3; ++block_idx) {
+    const Index::DescriptorMatrixType descriptors =
+        Index::DescriptorMatrixType::Random(
+            kDimensions, kNumDescriptorsPerBlock);
+    serial_index.AddDescriptors(descriptors);
+    concurrent_index.AddDescriptors(descriptors);
+  }
+  const Eigen::MatrixXf queries =
+      Eigen::MatrixXf::Random(kDimensions, kNumQueries);
+
+  Eigen::MatrixXi expected_indices(kNumNeighbors, kNumQueries);
+  Eigen::MatrixXf expected_distances(kNumNeighbors, kNumQueries);
+  serial_index.GetNNearestNeighbors(
+      queries, kNumNeighbors, &expected_indices, &expected_distances);
+
+  // The pending descriptors are indexed by whichever query comes first.
+  std::vector<Eigen::MatrixXi> indices(
+      kNumThreads, Eigen::MatrixXi(kNumNeighbors, kNumQueries));
+  std::vector<Eigen::MatrixXf> distances(
+      kNumThreads, Eigen::MatrixXf(kNumNeighbors, kNumQueries));
+  std::vector<std::thread> threads;
+  for (int thread_idx = 0; thread_idx < kNumThreads; ++thread_idx) {
+    threads.emplace_back([&, thread_idx]() {
+      concurrent_index.GetNNearestNeighbors(
+          queries, kNumNeighbors, &indices[thread_idx],
+          &distances[thread_idx]);
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(
+      3 * kNumDescriptorsPerBlock, concurrent_index.GetNumDescriptorsInIndex());
+  for (int thread_idx = 0; thread_idx < kNumThreads; ++thread_idx) {
+    EXPECT_TRUE(expected_indices == indices[thread_idx]);
+    EXPECT_TRUE(expected_distances == distances[thread_idx]);
+  }
+}
+
+TEST(KDTreeIndexTest, QueriesKeepTheirIndexWhileDescriptorsAreAdded) {
+  constexpr int kDimensions = 10;
+  constexpr int kNumNeighbors = 1;
+  std::srand(43);
+
+  typedef KDTreeIndex<kDimensions> Index;
+  Index index;
+  const Index::DescriptorMatrixType descriptors =
+      Index::DescriptorMatrixType::Random(kDimensions, 100);
+  index.AddDescriptors(descriptors);
+
+  // Every query finds the descriptor it is equal to, while other threads
+  // add descriptors and rebuild the kd-tree.
+  std::thread writer([&]() {
+    for (int i = 0; i < 50; ++i) {
+      index.AddDescriptors(
+          Index::DescriptorMatrixType::Ones(kDimensions, 10) * (10.0f + i));
+      index.RefreshIndex();
+    }
+  });
+  for (int i = 0; i < 500; ++i) {
+    const int descriptor_idx = i % descriptors.cols();
+    Eigen::MatrixXi indices(kNumNeighbors, 1);
+    Eigen::MatrixXf distances(kNumNeighbors, 1);
+    index.GetNNearestNeighbors(
+        descriptors.col(descriptor_idx), kNumNeighbors, &indices, &distances);
+    EXPECT_EQ(descriptor_idx, indices(0, 0));
+    EXPECT_EQ(0.0f, distances(0, 0));
+  }
+  writer.join();
+  EXPECT_EQ(600, index.GetNumDescriptorsInIndex());
+}
+
+}  // namespace kd_tree_index
+}  // namespace loop_closure
+
+MAPLAB_UNITTEST_ENTRYPOINT
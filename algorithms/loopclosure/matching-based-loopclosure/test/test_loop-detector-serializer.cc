@@ -0,0 +1,124 @@
+#include <memory>
+#include <string>
+
+#include <Eigen/Core>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <vi-map/unique-id.h>
+
+#include "matching-based-loopclosure/detector-settings.h"
+#include "matching-based-loopclosure/loop-detector-serializer.h"
+#include "matching-based-loopclosure/matching-based-engine.h"
+
+namespace matching_based_loopclosure {
+
+class LoopDetectorSerializerTest : public ::testing::Test {
+ protected:
+  static constexpr int kNumImages = 50;
+  static constexpr int kNumKeypointsPerImage = 100;
+  static constexpr int kDescriptorDimensions = 10;
+
+  loop_closure::ProjectedImage::Ptr createImage(
+      const vi_map::MissionId& mission_id, int image_idx) const {
+    loop_closure::ProjectedImage::Ptr projected_image =
+        std::make_shared<loop_closure::ProjectedImage>();
+    common::generateId(&projected_image->keyframe_id.vertex_id);
+    projected_image->keyframe_id.frame_index = 0u;
+    projected_image->dataset_id = mission_id;
+    projected_image->timestamp_nanoseconds = image_idx * 1e9;
+    projected_image->projected_descriptors =
+        Eigen::MatrixXf::Random(kDescriptorDimensions, kNumKeypointsPerImage);
+    projected_image->measurements =
+        Eigen::Matrix2Xd::Random(2, kNumKeypointsPerImage);
+    projected_image->landmarks.resize(kNumKeypointsPerImage);
+    for (vi_map::LandmarkId& landmark_id : projected_image->landmarks) {
+      common::generateId(&landmark_id);
+    }
+    return projected_image;
+  }
+
+  void expectSameMatches(
+      const loop_closure::FrameToMatches& expected,
+      const loop_closure::FrameToMatches& actual) const {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (const loop_closure::FrameIdMatchesPair& frame_matches : expected) {
+      const loop_closure::FrameToMatches::const_iterator it =
+          actual.find(frame_matches.first);
+      ASSERT_TRUE(it != actual.end());
+      EXPECT_EQ(frame_matches.second.size(), it->second.size());
+    }
+  }
+};
+
+TEST_F(LoopDetectorSerializerTest, MappedDetectorFindsSameMatches) {
+  std::srand(42);
+  const MatchingBasedEngineSettings settings;
+  MatchingBasedLoopDetector loop_detector(settings);
+
+  vi_map::MissionIdSet missions;
+  const vi_map::MissionId database_mission_id =
+      common::createRandomId<vi_map::MissionId>();
+  missions.insert(database_mission_id);
+  loop_closure::ProjectedImagePtrList query_images;
+  for (int image_idx = 0; image_idx < kNumImages; ++image_idx) {
+    loop_closure::ProjectedImage::Ptr projected_image =
+        createImage(database_mission_id, image_idx);
+    loop_detector.Insert(projected_image);
+
+    // Queries from another mission close to the database descriptors.
+    loop_closure::ProjectedImage::Ptr query_image =
+        std::make_shared<loop_closure::ProjectedImage>(*projected_image);
+    common::generateId(&query_image->keyframe_id.vertex_id);
+    common::generateId(&query_image->dataset_id);
+    query_image->projected_descriptors +=
+        0.01 * Eigen::MatrixXf::Random(
+                   kDescriptorDimensions, kNumKeypointsPerImage);
+    query_images.push_back(query_image);
+  }
+
+  const std::string kFilePath = "./loop_detector_node.bin";
+  ASSERT_TRUE(
+      MatchingBasedLoopDetectorSerializer::saveToBinaryFile(
+          loop_detector, missions, kFilePath));
+
+  MatchingBasedLoopDetector mapped_loop_detector(settings);
+  vi_map::MissionIdSet mapped_missions;
+  ASSERT_TRUE(
+      MatchingBasedLoopDetectorSerializer::mapFromBinaryFile(
+          kFilePath, &mapped_loop_detector, &mapped_missions));
+  EXPECT_EQ(missions, mapped_missions);
+  // The sizes are only accessible through the interface.
+  const loop_detector::LoopDetector& original_interface = loop_detector;
+  const loop_detector::LoopDetector& mapped_interface = mapped_loop_detector;
+  EXPECT_EQ(original_interface.NumEntries(), mapped_interface.NumEntries());
+  EXPECT_EQ(
+      original_interface.NumDescriptors(), mapped_interface.NumDescriptors());
+
+  for (const loop_closure::ProjectedImage::Ptr& query_image : query_images) {
+    const loop_closure::ProjectedImagePtrList query(1u, query_image);
+    loop_closure::FrameToMatches expected_matches;
+    loop_detector.Find(query, false, &expected_matches);
+    loop_closure::FrameToMatches mapped_matches;
+    mapped_loop_detector.Find(query, false, &mapped_matches);
+    expectSameMatches(expected_matches, mapped_matches);
+  }
+
+  // Inserting copies the mapped data, after which the detector behaves like
+  // the original one.
+  const loop_closure::ProjectedImage::Ptr new_image =
+      createImage(database_mission_id, kNumImages);
+  loop_detector.Insert(new_image);
+  mapped_loop_detector.Insert(new_image);
+  EXPECT_EQ(kNumImages + 1u, mapped_interface.NumEntries());
+  for (const loop_closure::ProjectedImage::Ptr& query_image : query_images) {
+    const loop_closure::ProjectedImagePtrList query(1u, query_image);
+    loop_closure::FrameToMatches expected_matches;
+    loop_detector.Find(query, false, &expected_matches);
+    loop_closure::FrameToMatches mapped_matches;
+    mapped_loop_detector.Find(query, false, &mapped_matches);
+    expectSameMatches(expected_matches, mapped_matches);
+  }
+}
+
+}  // namespace matching_based_loopclosure
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <bitset>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include <Eigen/Core>
+#include <loopclosure-common/types.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "matching-based-loopclosure/multi-index-hashing-index-interface.h"
+#include "matching-based-loopclosure/multi-index-hashing-index.h"
+
+namespace loop_closure {
+namespace multi_index_hashing {
+
+class MultiIndexHashingIndexTest : public ::testing::Test {
+ protected:
+  static constexpr int kDescriptorSizeBytes = 48;
+  static constexpr int kNumDescriptors = 2000;
+  static constexpr int kNumQueries = 100;
+  static constexpr int kMaxNumFlippedBits = 8;
+
+  virtual void SetUp() {
+    std::srand(42);
+    descriptors_ =
+        DescriptorContainer::Random(kDescriptorSizeBytes, kNumDescriptors);
+    queries_.resize(kDescriptorSizeBytes, kNumQueries);
+    for (int query_idx = 0; query_idx < kNumQueries; ++query_idx) {
+      queries_.col(query_idx) = descriptors_.col(query_idx * 7);
+      const int num_flipped_bits = std::rand() % (kMaxNumFlippedBits + 1);
+      for (int flip_idx = 0; flip_idx < num_flipped_bits; ++flip_idx) {
+        const int bit = std::rand() % (8 * kDescriptorSizeBytes);
+        queries_(bit / 8, query_idx) ^=
+            static_cast<unsigned char>(1u << (bit % 8));
+      }
+    }
+  }
+
+  unsigned int getHammingDistance(int descriptor_idx, int query_idx) const {
+    unsigned int distance = 0u;
+    for (int byte_idx = 0; byte_idx < kDescriptorSizeBytes; ++byte_idx) {
+      distance += std::bitset<8>(
+                      descriptors_(byte_idx, descriptor_idx) ^
+                      queries_(byte_idx, query_idx))
+                      .count();
+    }
+    return distance;
+  }
+
+  DescriptorContainer descriptors_;
+  DescriptorContainer queries_;
+};
+
+TEST_F(MultiIndexHashingIndexTest, PackingIsLossless) {
+  MultiIndexHashingIndexInterface index_interface(2, 2);
+  Eigen::MatrixXf packed_descriptors;
+  index_interface.ProjectDescriptors(descriptors_, &packed_descriptors);
+  ASSERT_EQ(
+      kDescriptorSizeBytes / kNumBytesPerPackedWord, packed_descriptors.rows());
+  ASSERT_EQ(kNumDescriptors, packed_descriptors.cols());
+
+  DescriptorContainer unpacked_descriptors(
+      kDescriptorSizeBytes, kNumDescriptors);
+  for (int col_idx = 0; col_idx < kNumDescriptors; ++col_idx) {
+    UnpackDescriptor(
+        packed_descriptors.col(col_idx),
+        unpacked_descriptors.col(col_idx).data());
+  }
+  EXPECT_TRUE(descriptors_ == unpacked_descriptors);
+}
+
+TEST_F(MultiIndexHashingIndexTest, NearestNeighborsMatchExhaustiveSearch) {
+  for (const int num_substring_bytes : {1, 2, 3, 4}) {
+    MultiIndexHashingIndexInterface index_interface(num_substring_bytes, 1);
+    Eigen::MatrixXf packed_descriptors;
+    index_interface.ProjectDescriptors(descriptors_, &packed_descriptors);
+    index_interface.AddDescriptors(packed_descriptors);
+    EXPECT_EQ(kNumDescriptors, index_interface.GetNumDescriptorsInIndex());
+    EXPECT_GE(
+        index_interface.GetMemoryUsageBytes(),
+        static_cast<size_t>(kDescriptorSizeBytes * kNumDescriptors));
+
+    Eigen::MatrixXf packed_queries;
+    index_interface.ProjectDescriptors(queries_, &packed_queries);
+    constexpr int kNumNeighbors = 1;
+    Eigen::MatrixXi indices(kNumNeighbors, kNumQueries);
+    Eigen::MatrixXf distances(kNumNeighbors, kNumQueries);
+    index_interface.GetNNearestNeighborsForFeatures(
+        packed_queries, kNumNeighbors, &indices, &distances);
+
+    // The queries are within kMaxNumFlippedBits of their source descriptor,
+    // which is less than the number of substrings, so the nearest neighbor
+    // is found at substring radius 0.
+    for (int query_idx = 0; query_idx < kNumQueries; ++query_idx) {
+      unsigned int expected_distance = std::numeric_limits<unsigned>::max();
+      for (int descriptor_idx = 0; descriptor_idx < kNumDescriptors;
+           ++descriptor_idx) {
+        expected_distance = std::min(
+            expected_distance, getHammingDistance(descriptor_idx, query_idx));
+      }
+      ASSERT_NE(-1, indices(0, query_idx));
+      EXPECT_EQ(static_cast<float>(expected_distance), distances(0, query_idx));
+      EXPECT_EQ(
+          expected_distance,
+          getHammingDistance(indices(0, query_idx), query_idx));
+    }
+  }
+}
+
+TEST_F(MultiIndexHashingIndexTest, MissingNeighborsAreInvalid) {
+  MultiIndexHashingIndexInterface index_interface(2, 0);
+  Eigen::MatrixXf packed_queries;
+  index_interface.ProjectDescriptors(queries_, &packed_queries);
+  constexpr int kNumNeighbors = 3;
+  Eigen::MatrixXi indices(kNumNeighbors, kNumQueries);
+  Eigen::MatrixXf distances(kNumNeighbors, kNumQueries);
+  index_interface.GetNNearestNeighborsForFeatures(
+      packed_queries, kNumNeighbors, &indices, &distances);
+  EXPECT_TRUE((indices.array() == -1).all());
+  EXPECT_TRUE(
+      (distances.array() == std::numeric_limits<float>::infinity()).all());
+
+  // At substring radius 0, the farther neighbors are usually not found.
+  Eigen::MatrixXf packed_descriptors;
+  index_interface.ProjectDescriptors(descriptors_, &packed_descriptors);
+  index_interface.AddDescriptors(packed_descriptors);
+  index_interface.GetNNearestNeighborsForFeatures(
+      packed_queries, kNumNeighbors, &indices, &distances);
+  for (int query_idx = 0; query_idx < kNumQueries; ++query_idx) {
+    ASSERT_NE(-1, indices(0, query_idx));
+    for (int neighbor_idx = 1; neighbor_idx < kNumNeighbors; ++neighbor_idx) {
+      if (indices(neighbor_idx, query_idx) == -1) {
+        EXPECT_EQ(
+            std::numeric_limits<float>::infinity(),
+            distances(neighbor_idx, query_idx));
+      } else {
+        EXPECT_LE(
+            distances(neighbor_idx - 1, query_idx),
+            distances(neighbor_idx, query_idx));
+      }
+    }
+  }
+}
+
+}  // namespace multi_index_hashing
+}  // namespace loop_closure
+
+MAPLAB_UNITTEST_ENTRYPOINT
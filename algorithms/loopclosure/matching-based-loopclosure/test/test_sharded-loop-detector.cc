@@ -0,0 +1,177 @@
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <vi-map/unique-id.h>
+
+#include "matching-based-loopclosure/detector-settings.h"
+#include "matching-based-loopclosure/matching-based-engine.h"
+#include "matching-based-loopclosure/sharded-loop-detector.h"
+
+namespace matching_based_loopclosure {
+
+class ShardedLoopDetectorTest : public ::testing::Test {
+ protected:
+  static constexpr int kNumMissions = 6;
+  static constexpr int kNumImagesPerMission = 10;
+  static constexpr int kNumKeypointsPerImage = 100;
+  static constexpr int kDescriptorDimensions = 10;
+  static constexpr size_t kNumShards = 3u;
+
+  virtual void SetUp() {
+    std::srand(42);
+    for (int mission_idx = 0; mission_idx < kNumMissions; ++mission_idx) {
+      const vi_map::MissionId mission_id =
+          common::createRandomId<vi_map::MissionId>();
+      for (int image_idx = 0; image_idx < kNumImagesPerMission; ++image_idx) {
+        loop_closure::ProjectedImage::Ptr projected_image =
+            std::make_shared<loop_closure::ProjectedImage>();
+        common::generateId(&projected_image->keyframe_id.vertex_id);
+        projected_image->keyframe_id.frame_index = 0u;
+        projected_image->dataset_id = mission_id;
+        projected_image->timestamp_nanoseconds = image_idx * 1e9;
+        projected_image->projected_descriptors = Eigen::MatrixXf::Random(
+            kDescriptorDimensions, kNumKeypointsPerImage);
+        projected_image->measurements =
+            Eigen::Matrix2Xd::Random(2, kNumKeypointsPerImage);
+        projected_image->landmarks.resize(kNumKeypointsPerImage);
+        for (vi_map::LandmarkId& landmark_id : projected_image->landmarks) {
+          common::generateId(&landmark_id);
+        }
+        database_images_.push_back(projected_image);
+
+        loop_closure::ProjectedImage::Ptr query_image =
+            std::make_shared<loop_closure::ProjectedImage>(*projected_image);
+        common::generateId(&query_image->keyframe_id.vertex_id);
+        common::generateId(&query_image->dataset_id);
+        query_image->projected_descriptors +=
+            0.01 * Eigen::MatrixXf::Random(
+                       kDescriptorDimensions, kNumKeypointsPerImage);
+        query_images_.push_back(query_image);
+      }
+    }
+  }
+
+  loop_closure::ProjectedImagePtrList database_images_;
+  loop_closure::ProjectedImagePtrList query_images_;
+};
+
+TEST_F(ShardedLoopDetectorTest, ImagesAreShardedByMission) {
+  MatchingBasedEngineSettings settings;
+  ShardedLoopDetector loop_detector(settings, kNumShards);
+  for (const loop_closure::ProjectedImage::Ptr& image : database_images_) {
+    loop_detector.Insert(image);
+  }
+  ASSERT_EQ(static_cast<size_t>(kNumShards), loop_detector.numShards());
+  EXPECT_EQ(database_images_.size(), loop_detector.NumEntries());
+  EXPECT_EQ(
+      static_cast<int>(database_images_.size()) * kNumKeypointsPerImage,
+      loop_detector.NumDescriptors());
+
+  std::vector<size_t> expected_num_entries(kNumShards, 0u);
+  for (const loop_closure::ProjectedImage::Ptr& image : database_images_) {
+    ++expected_num_entries[loop_detector.getShardIndex(image->dataset_id)];
+  }
+  for (size_t shard_idx = 0u; shard_idx < kNumShards; ++shard_idx) {
+    const loop_detector::LoopDetector& shard =
+        loop_detector.getShard(shard_idx);
+    EXPECT_EQ(expected_num_entries[shard_idx], shard.NumEntries());
+  }
+}
+
+TEST_F(ShardedLoopDetectorTest, QueriesFindImagesInAllShards) {
+  MatchingBasedEngineSettings settings;
+  ShardedLoopDetector loop_detector(settings, kNumShards);
+  for (const loop_closure::ProjectedImage::Ptr& image : database_images_) {
+    loop_detector.Insert(image);
+  }
+
+  for (const bool parallelize : {false, true}) {
+    for (size_t image_idx = 0u; image_idx < query_images_.size();
+         ++image_idx) {
+      const loop_closure::ProjectedImagePtrList query(
+          1u, query_images_[image_idx]);
+      loop_closure::FrameToMatches frame_matches;
+      loop_detector.Find(query, parallelize, &frame_matches);
+      ASSERT_EQ(1u, frame_matches.size());
+      const loop_closure::MatchVector& matches = frame_matches.begin()->second;
+      ASSERT_FALSE(matches.empty());
+      for (const loop_closure::Match& match : matches) {
+        EXPECT_EQ(
+            database_images_[image_idx]->keyframe_id,
+            match.keyframe_id_result);
+      }
+    }
+  }
+}
+
+TEST_F(ShardedLoopDetectorTest, QueriesOnlyMatchCandidateVertices) {
+  MatchingBasedEngineSettings settings;
+  ShardedLoopDetector loop_detector(settings, kNumShards);
+  for (const loop_closure::ProjectedImage::Ptr& image : database_images_) {
+    loop_detector.Insert(image);
+  }
+
+  constexpr size_t kQueryIndex = 0u;
+  constexpr size_t kOtherIndex = 1u;
+  loop_closure::ProjectedImage::Ptr query_image =
+      std::make_shared<loop_closure::ProjectedImage>(
+          *query_images_[kQueryIndex]);
+  const loop_closure::ProjectedImagePtrList query(1u, query_image);
+
+  // The matching image is not a candidate.
+  std::shared_ptr<pose_graph::VertexIdSet> candidate_vertex_ids =
+      std::make_shared<pose_graph::VertexIdSet>();
+  candidate_vertex_ids->insert(
+      database_images_[kOtherIndex]->keyframe_id.vertex_id);
+  query_image->candidate_vertex_ids = candidate_vertex_ids;
+  loop_closure::FrameToMatches frame_matches;
+  constexpr bool kParallelize = false;
+  loop_detector.Find(query, kParallelize, &frame_matches);
+  for (const loop_closure::FrameToMatches::value_type& frame_and_matches :
+       frame_matches) {
+    for (const loop_closure::Match& match : frame_and_matches.second) {
+      EXPECT_EQ(
+          database_images_[kOtherIndex]->keyframe_id.vertex_id,
+          match.keyframe_id_result.vertex_id);
+    }
+  }
+
+  candidate_vertex_ids->insert(
+      database_images_[kQueryIndex]->keyframe_id.vertex_id);
+  frame_matches.clear();
+  loop_detector.Find(query, kParallelize, &frame_matches);
+  ASSERT_EQ(1u, frame_matches.size());
+  for (const loop_closure::Match& match : frame_matches.begin()->second) {
+    EXPECT_EQ(
+        database_images_[kQueryIndex]->keyframe_id, match.keyframe_id_result);
+  }
+}
+
+TEST_F(ShardedLoopDetectorTest, SerializationKeepsShards) {
+  MatchingBasedEngineSettings settings;
+  ShardedLoopDetector loop_detector(settings, kNumShards);
+  for (const loop_closure::ProjectedImage::Ptr& image : database_images_) {
+    loop_detector.Insert(image);
+  }
+  proto::MatchingBasedLoopDetector proto_loop_detector;
+  loop_detector.serialize(&proto_loop_detector);
+  EXPECT_EQ(static_cast<int>(kNumShards), proto_loop_detector.shards_size());
+
+  ShardedLoopDetector deserialized_loop_detector(settings, kNumShards);
+  deserialized_loop_detector.deserialize(proto_loop_detector);
+  EXPECT_EQ(
+      loop_detector.NumEntries(), deserialized_loop_detector.NumEntries());
+  for (size_t shard_idx = 0u; shard_idx < kNumShards; ++shard_idx) {
+    const loop_detector::LoopDetector& shard =
+        loop_detector.getShard(shard_idx);
+    const loop_detector::LoopDetector& deserialized_shard =
+        deserialized_loop_detector.getShard(shard_idx);
+    EXPECT_EQ(shard.NumEntries(), deserialized_shard.NumEntries());
+  }
+}
+
+}  // namespace matching_based_loopclosure
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,87 @@
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include <Eigen/Core>
+#include <descriptor-projection/flags.h>
+#include <maplab-common/binary-serialization.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "matching-based-loopclosure/inverted-index-interface.h"
+#include "matching-based-loopclosure/vocabulary-cache.h"
+
+namespace loop_closure {
+
+class VocabularyCacheTest : public ::testing::Test {
+ protected:
+  void writeMatrix(const std::string& filename, const Eigen::MatrixXf& matrix) {
+    std::ofstream out(filename, std::ios_base::binary);
+    ASSERT_TRUE(out.is_open());
+    common::Serialize(matrix, &out);
+  }
+};
+
+TEST_F(VocabularyCacheTest, ProjectionMatrixIsShared) {
+  const std::string kFilename = "vocabulary_cache_test_projection_matrix.dat";
+  const Eigen::MatrixXf matrix = Eigen::MatrixXf::Random(10, 20);
+  writeMatrix(kFilename, matrix);
+
+  VocabularyCache& cache = VocabularyCache::getInstance();
+  std::shared_ptr<const Eigen::MatrixXf> first =
+      cache.getProjectionMatrix(kFilename);
+  std::shared_ptr<const Eigen::MatrixXf> second =
+      cache.getProjectionMatrix(kFilename);
+  ASSERT_TRUE(first != nullptr);
+  EXPECT_EQ(first.get(), second.get());
+  EXPECT_TRUE(first->isApprox(matrix));
+  EXPECT_EQ(1u, cache.numLoadedFiles());
+
+  first.reset();
+  second.reset();
+  EXPECT_EQ(0u, cache.numLoadedFiles());
+}
+
+TEST_F(VocabularyCacheTest, ChangedFileIsLoadedAgain) {
+  const std::string kFilename = "vocabulary_cache_test_changed_file.dat";
+  writeMatrix(kFilename, Eigen::MatrixXf::Random(10, 20));
+
+  VocabularyCache& cache = VocabularyCache::getInstance();
+  const std::shared_ptr<const Eigen::MatrixXf> before =
+      cache.getProjectionMatrix(kFilename);
+
+  const Eigen::MatrixXf changed_matrix = Eigen::MatrixXf::Random(10, 30);
+  writeMatrix(kFilename, changed_matrix);
+  const std::shared_ptr<const Eigen::MatrixXf> after =
+      cache.getProjectionMatrix(kFilename);
+  EXPECT_NE(before.get(), after.get());
+  EXPECT_EQ(20, before->cols());
+  EXPECT_TRUE(after->isApprox(changed_matrix));
+}
+
+TEST_F(VocabularyCacheTest, VocabularyIsShared) {
+  const std::string kFilename = "vocabulary_cache_test_vocabulary.dat";
+  InvertedIndexVocabulary vocabulary;
+  vocabulary.words_ =
+      Eigen::MatrixXf::Random(FLAGS_lc_target_dimensionality, 50);
+  vocabulary.projection_matrix_ =
+      Eigen::MatrixXf::Random(FLAGS_lc_target_dimensionality, 256);
+  {
+    std::ofstream out(kFilename, std::ios_base::binary);
+    ASSERT_TRUE(out.is_open());
+    vocabulary.Save(&out);
+  }
+
+  VocabularyCache& cache = VocabularyCache::getInstance();
+  const std::shared_ptr<const InvertedIndexVocabulary> first =
+      cache.getVocabulary<InvertedIndexVocabulary>(kFilename);
+  const std::shared_ptr<const InvertedIndexVocabulary> second =
+      cache.getVocabulary<InvertedIndexVocabulary>(kFilename);
+  EXPECT_EQ(first.get(), second.get());
+  EXPECT_TRUE(first->words_.isApprox(vocabulary.words_));
+  EXPECT_TRUE(
+      first->projection_matrix_.isApprox(vocabulary.projection_matrix_));
+}
+
+}  // namespace loop_closure
+
+MAPLAB_UNITTEST_ENTRYPOINT
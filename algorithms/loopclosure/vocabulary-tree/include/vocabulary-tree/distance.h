@@ -93,9 +93,7 @@ struct Hamming {
     if (a.size() == 64) {
       return HammingDistance512(a.data(), b.data());
     } else if (a.size() == 48) {
-      unsigned int sum1 = HammingDistance256(a.data(), b.data());
-      unsigned int sum2 = HammingDistance128(a.data() + 32, b.data() + 32);
-      return sum1 + sum2;
+      return HammingDistanceOfBytes(a.data(), b.data(), 48u);
     } else if (a.size() == 32) {
       return HammingDistance256(a.data(), b.data());
     } else {
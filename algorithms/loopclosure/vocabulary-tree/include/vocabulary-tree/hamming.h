@@ -1,5 +1,8 @@
 #ifndef VOCABULARY_TREE_HAMMING_H_
 #define VOCABULARY_TREE_HAMMING_H_
+
+#include <cstddef>
+
 namespace loop_closure {
 inline unsigned int HammingDistance32(unsigned int a, unsigned int b);
 inline unsigned int HammingDistance128(
@@ -8,8 +11,37 @@ inline unsigned int HammingDistance256(
     const unsigned char d1[32], const unsigned char d2[32]);
 inline unsigned int HammingDistance512(
     const unsigned char d1[64], const unsigned char d2[64]);
+inline unsigned int HammingDistanceOfBytes(
+    const unsigned char* d1, const unsigned char* d2, size_t num_bytes);
 inline unsigned int HammingDistance(
     const unsigned char* d1, const unsigned char* d2, unsigned int numBits);
+
+// Implementations of the Hamming distance of descriptors whose size is a
+// multiple of 16 bytes. On x86, the distance functions above use the fastest
+// kernel the CPU supports, which is detected on first use. On ARM, they use
+// the NEON kernel.
+enum class HammingKernel {
+  kSsse3,
+  kPopcnt,
+  kAvx2,
+  kAvx512Vpopcntdq,
+  kNeon,
+  kNumKernels
+};
+
+typedef unsigned int (*HammingKernelFunction)(
+    const unsigned char* d1, const unsigned char* d2, size_t num_bytes);
+
+const char* getHammingKernelName(HammingKernel kernel);
+// Checks if the kernel is compiled in and supported by the CPU.
+bool isHammingKernelSupported(HammingKernel kernel);
+// The kernel must be supported. The descriptors don't need to be aligned.
+HammingKernelFunction getHammingKernelFunction(HammingKernel kernel);
+// The kernel that is used by the distance functions above.
+HammingKernel getSelectedHammingKernel();
+// Overrides the detected kernel, e.g. for comparisons. The kernel must be
+// supported.
+void selectHammingKernel(HammingKernel kernel);
 }  // namespace loop_closure
 
 #include "vocabulary-tree/impl/hamming-inl.h"
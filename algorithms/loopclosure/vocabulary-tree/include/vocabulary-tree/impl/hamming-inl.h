@@ -1,7 +1,13 @@
 #ifndef VOCABULARY_TREE_HAMMING_INL_H_
 #define VOCABULARY_TREE_HAMMING_INL_H_
 
-#if !defined(__ARM_NEON__)
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#else
 #include <emmintrin.h>
 #include <tmmintrin.h>
 #endif  // __ARM_NEON__
@@ -83,21 +89,30 @@ __inline__ uint32_t NEONPopcntofXORed(
     const int numberOf128BitWords) {
   CHECK_NOTNULL(signature1);
   CHECK_NOTNULL(signature2);
-  uint32_t result = 0;
 
+  // Sums the counts of the bytes pairwise into 16-bit lanes, which don't
+  // overflow for fewer than 4096 words, and reduces the lanes only once.
+  uint16x8_t accumulator = vdupq_n_u16(0u);
   for (int i = 0; i < numberOf128BitWords; ++i) {
-    uint8x16_t xor_result = veorq_u8(signature1[i], signature2[i]);
-    uint8x16_t set_bits = vcntq_u8(xor_result);
-    uint8_t result_popcnt[16];
-    vst1q_u8(result_popcnt, set_bits);
-    for (int j = 0; j < 16; ++j) {
-      result += result_popcnt[j];
-    }
+    const uint8x16_t xor_result = veorq_u8(signature1[i], signature2[i]);
+    accumulator = vpadalq_u8(accumulator, vcntq_u8(xor_result));
   }
-  return result;
+  return vaddlvq_u16(accumulator);
 }
 #endif
 
+namespace internal {
+// The kernel used by the distance functions on x86, which initially points to
+// a function that detects the best kernel on its first call.
+extern std::atomic<HammingKernelFunction> selected_hamming_kernel_function;
+
+inline unsigned int SelectedKernelHammingDistance(
+    const unsigned char* d1, const unsigned char* d2, size_t num_bytes) {
+  return selected_hamming_kernel_function.load(std::memory_order_relaxed)(
+      d1, d2, num_bytes);
+}
+}  // namespace internal
+
 // Hamming distance for 128 bits.
 inline unsigned int HammingDistance128(
     const unsigned char d1[16], const unsigned char d2[16]) {
@@ -167,10 +182,7 @@ inline unsigned int HammingDistance128(
   return out_value;
 #endif  // __aarch64__
 #else   // __ARM_NEON__
-  const __m128i* a = reinterpret_cast<const __m128i*>(d1);
-  const __m128i* b = reinterpret_cast<const __m128i*>(d2);
-
-  return SSSE3PopcntofXORed<1>(a, b);
+  return internal::SelectedKernelHammingDistance(d1, d2, 16u);
 #endif  // __ARM_NEON__
 }
 
@@ -260,10 +272,7 @@ inline unsigned int HammingDistance256(
   return out_value;
 #endif  // __aarch64__
 #else   // __ARM_NEON__
-  const __m128i* a = reinterpret_cast<const __m128i*>(d1);
-  const __m128i* b = reinterpret_cast<const __m128i*>(d2);
-
-  return SSSE3PopcntofXORed<2>(a, b);
+  return internal::SelectedKernelHammingDistance(d1, d2, 32u);
 #endif  // __ARM_NEON__
 }
 
@@ -280,13 +289,32 @@ inline unsigned int HammingDistance512(
   return HammingDistance256(d1, d2) + HammingDistance256(d1 + 32, d2 + 32);
 #endif
 #else
-  const __m128i* a = reinterpret_cast<const __m128i*>(d1);
-  const __m128i* b = reinterpret_cast<const __m128i*>(d2);
-
-  return SSSE3PopcntofXORed<4>(a, b);
+  return internal::SelectedKernelHammingDistance(d1, d2, 64u);
 #endif
 }
 
+// Hamming distance for a multiple of 16 bytes.
+inline unsigned int HammingDistanceOfBytes(
+    const unsigned char* d1, const unsigned char* d2, size_t num_bytes) {
+  CHECK_EQ(num_bytes % 16u, 0u);
+#ifdef __ARM_NEON__
+#ifdef __aarch64__
+  return NEONPopcntofXORed(
+      reinterpret_cast<const uint8x16_t*>(d1),
+      reinterpret_cast<const uint8x16_t*>(d2),
+      static_cast<int>(num_bytes / 16u));
+#else   // __aarch64__
+  unsigned int distance = 0u;
+  for (size_t byte_idx = 0u; byte_idx < num_bytes; byte_idx += 16u) {
+    distance += HammingDistance128(d1 + byte_idx, d2 + byte_idx);
+  }
+  return distance;
+#endif  // __aarch64__
+#else   // __ARM_NEON__
+  return internal::SelectedKernelHammingDistance(d1, d2, num_bytes);
+#endif  // __ARM_NEON__
+}
+
 // Hamming distance for different vector sizes.
 inline unsigned int HammingDistance(
     const unsigned char* d1, const unsigned char* d2, unsigned int numBits) {
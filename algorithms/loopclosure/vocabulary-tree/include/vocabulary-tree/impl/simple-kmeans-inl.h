@@ -4,8 +4,11 @@
 #define VOCABULARY_TREE_SIMPLE_KMEANS_INL_H_
 
 #include <algorithm>
+#include <functional>
 #include <iostream>  // NOLINT
+#include <iterator>
 #include <limits>
+#include <random>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -50,6 +53,29 @@ ClusterMean(
   aslam::common::DescriptorMean(features, mean);
 }
 
+// Eigen Matrix type features.
+template <class Feature>
+typename std::enable_if<std::is_floating_point<typename Feature::Scalar>::value,
+                        void>::type
+MiniBatchUpdateCenter(
+    const Feature& feature, size_t num_assigned_features,
+    Feature* const center) {
+  CHECK_NOTNULL(center);
+  CHECK_GT(num_assigned_features, 0u);
+  *center += (feature - *center) /
+             static_cast<typename Feature::Scalar>(num_assigned_features);
+}
+
+// Binary features.
+template <class Feature>
+typename std::enable_if<std::is_integral<typename Feature::value_type>::value,
+                        void>::type
+MiniBatchUpdateCenter(
+    const Feature& /*feature*/, size_t /*num_assigned_features*/,
+    Feature* const /*center*/) {
+  LOG(FATAL) << "Mini-batch k-means is not supported for binary features.";
+}
+
 template <class Feature, class Distance, class FeatureAllocator>
 SimpleKmeans<Feature, Distance, FeatureAllocator>::SimpleKmeans(
     const Feature& zero, const Distance& d)
@@ -57,7 +83,8 @@ SimpleKmeans<Feature, Distance, FeatureAllocator>::SimpleKmeans(
       distance_(d),
       choose_centers_(InitKMeansPlusPlus<Feature>(zero)),
       max_iterations_(100),
-      restarts_(1) {}
+      restarts_(1),
+      mini_batch_size_(0u) {}
 
 template <class Feature, class Distance, class FeatureAllocator>
 typename SimpleKmeans<Feature, Distance, FeatureAllocator>::SquaredDistanceType
@@ -87,34 +114,66 @@ SimpleKmeans<Feature, Distance, FeatureAllocator>::ClusterPointers(
   CHECK_NOTNULL(centers);
   CHECK(*centers);
   CHECK_NOTNULL(membership);
+  CHECK_GT(restarts_, 0u);
   std::mt19937 generator(random_seed);
   typedef typename SimpleKmeans<Feature, Distance, FeatureAllocator>::Centers
       Centers;
 
-  Centers new_centers =
-      aligned_shared<std::vector<Feature, FeatureAllocator> >(**centers);
-
-  std::vector<unsigned int> new_membership(features.size());
-  (*centers)->clear();
-
-  SquaredDistanceType least_sse =
-      std::numeric_limits<SquaredDistanceType>::max();
-
-  for (size_t starts = 0; starts < restarts_; ++starts) {
-    choose_centers_(features, k, distance_, generator(), new_centers.get());
-
-    VLOG(3) << "#\tCluster run " << starts;
-    VLOG(3) << "Have " << new_centers->size() << " centers" << std::endl;
-    SquaredDistanceType sse =
-        ClusterOnce(features, k, generator(), &new_centers, &new_membership);
-    if (sse < least_sse) {
-      least_sse = sse;
-      *centers = new_centers;
-      *membership = new_membership;
-    }
+  // Draw the seeds of all restarts up front, such that the result doesn't
+  // depend on the order in which the restarts are run.
+  std::vector<int> initializer_seeds(restarts_);
+  std::vector<int> clustering_seeds(restarts_);
+  for (size_t start = 0u; start < restarts_; ++start) {
+    initializer_seeds[start] = generator();
+    clustering_seeds[start] = generator();
   }
+
+  std::vector<Centers> restart_centers(restarts_);
+  std::vector<std::vector<unsigned int> > restart_memberships(restarts_);
+  std::vector<SquaredDistanceType> restart_sse(restarts_);
+  std::function<void(const std::vector<size_t>&)> restart_functor =
+      [&](const std::vector<size_t>& range) {
+        for (const size_t start : range) {
+          // The initial centers are passed on for the InitGiven initializer.
+          Centers& new_centers = restart_centers[start];
+          new_centers =
+              aligned_shared<std::vector<Feature, FeatureAllocator> >(
+                  **centers);
+          choose_centers_(
+              features, k, distance_, initializer_seeds[start],
+              new_centers.get());
+
+          VLOG(3) << "#\tCluster run " << start;
+          VLOG(3) << "Have " << new_centers->size() << " centers" << std::endl;
+          std::vector<unsigned int>& new_membership =
+              restart_memberships[start];
+          new_membership.assign(features.size(), -1);
+          if (mini_batch_size_ > 0u) {
+            restart_sse[start] = ClusterOnceMiniBatch(
+                features, k, clustering_seeds[start], &new_centers,
+                &new_membership);
+          } else {
+            restart_sse[start] = ClusterOnce(
+                features, k, clustering_seeds[start], &new_centers,
+                &new_membership);
+          }
+        }
+      };
+  // Nested calls are fine, the assignment steps of all restarts share the
+  // thread pool.
+  const bool kAlwaysParallelize = false;
+  static const size_t kNumHardwareThreads = common::getNumHardwareThreads();
+  common::ParallelProcess(
+      restarts_, restart_functor, kAlwaysParallelize,
+      std::min(restarts_, kNumHardwareThreads));
+
+  const size_t best_start = std::distance(
+      restart_sse.begin(),
+      std::min_element(restart_sse.begin(), restart_sse.end()));
+  *centers = restart_centers[best_start];
+  membership->swap(restart_memberships[best_start]);
   CHECK(!(*centers)->empty());
-  return least_sse;
+  return restart_sse[best_start];
 }
 
 // This class is the default implementation of a search accelerator that
@@ -499,5 +558,68 @@ SimpleKmeans<Feature, Distance, FeatureAllocator>::ClusterOnce(
   }
   return sse;
 }
+
+template <class Feature, class Distance, class FeatureAllocator>
+typename SimpleKmeans<Feature, Distance, FeatureAllocator>::SquaredDistanceType
+SimpleKmeans<Feature, Distance, FeatureAllocator>::ClusterOnceMiniBatch(
+    const std::vector<Feature*>& features, size_t k, int random_seed,
+    typename SimpleKmeans<Feature, Distance, FeatureAllocator>::Centers* const
+        centers,
+    std::vector<unsigned int>* const membership) const {
+  CHECK_NOTNULL(centers);
+  CHECK_NOTNULL(membership);
+  CHECK(!features.empty());
+  CHECK_EQ((*centers)->size(), k);
+
+  typedef
+      typename GetSearchAccelerator<Feature, Distance, FeatureAllocator>::type
+          SearchAccelerator;
+  typedef ThreadedClusteringHelper<Feature, Distance, FeatureAllocator,
+                                   SearchAccelerator>
+      ClusteringHelper;
+  const bool kAlwaysParallelize = false;
+  static const size_t kNumHardwareThreads = common::getNumHardwareThreads();
+
+  std::mt19937 generator(random_seed);
+  std::uniform_int_distribution<size_t> feature_distribution(
+      0u, features.size() - 1u);
+  const size_t batch_size = std::min(mini_batch_size_, features.size());
+  std::vector<Feature*> batch(batch_size);
+  std::vector<unsigned int> batch_membership;
+  std::vector<size_t> center_counts(k, 0u);
+
+  for (size_t iter = 0; iter < max_iterations_; ++iter) {
+    for (Feature*& feature : batch) {
+      feature = features[feature_distribution(generator)];
+    }
+
+    SearchAccelerator search_accelerator(*centers, distance_);
+    batch_membership.assign(batch_size, -1);
+    ClusteringHelper helper(
+        search_accelerator, &batch, centers->get(), &batch_membership);
+    common::ParallelProcess(
+        batch_size, helper, kAlwaysParallelize, kNumHardwareThreads);
+
+    for (size_t i = 0u; i < batch_size; ++i) {
+      const unsigned int center_idx = batch_membership[i];
+      MiniBatchUpdateCenter(
+          *batch[i], ++center_counts[center_idx], &(**centers)[center_idx]);
+    }
+  }
+
+  // Assign all features to the final centers.
+  SearchAccelerator search_accelerator(*centers, distance_);
+  membership->assign(features.size(), -1);
+  ClusteringHelper helper(
+      search_accelerator, &features, centers->get(), membership);
+  common::ParallelProcess(
+      features.size(), helper, kAlwaysParallelize, kNumHardwareThreads);
+
+  SquaredDistanceType sse = SquaredDistanceType();
+  for (size_t i = 0; i < features.size(); ++i) {
+    sse += distance_(*features[i], (**centers)[(*membership)[i]]);
+  }
+  return sse;
+}
 }  // namespace loop_closure
 #endif  // VOCABULARY_TREE_SIMPLE_KMEANS_INL_H_
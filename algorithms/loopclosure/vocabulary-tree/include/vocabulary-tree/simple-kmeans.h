@@ -7,6 +7,7 @@
 #include <functional>
 #include <limits>
 #include <memory>
+#include <numeric>
 #include <random>
 #include <vector>
 
@@ -26,8 +27,8 @@ template <typename Feature>
 struct InitGiven;
 
 // Class for performing K-means clustering, optimized for a particular feature
-// type and metric. The standard Lloyd's algorithm is used. By default, cluster
-// centers are initialized randomly.
+// type and metric. The standard Lloyd's algorithm is used, unless a mini-batch
+// size is set. By default, cluster centers are initialized with kmeans++.
 template <class Feature, class Distance = distance::L2<Feature>,
           class FeatureAllocator = typename DefaultAllocator<Feature>::type>
 class SimpleKmeans {
@@ -55,6 +56,8 @@ class SimpleKmeans {
     max_iterations_ = iters;
   }
 
+  // The restarts are run in parallel and the clustering with the smallest
+  // sum of squared errors is kept.
   size_t GetRestarts() const {
     return restarts_;
   }
@@ -62,6 +65,19 @@ class SimpleKmeans {
     restarts_ = restarts;
   }
 
+  // If positive, mini-batch k-means (Sculley, 2010) is used instead of Lloyd's
+  // algorithm: Every iteration assigns a random sample of this many features
+  // and moves their centers towards them with a per-center learning rate of
+  // one over the number of features assigned so far. The features are only
+  // assigned to the final centers once. Only supported for floating point
+  // features.
+  size_t GetMiniBatchSize() const {
+    return mini_batch_size_;
+  }
+  void SetMiniBatchSize(size_t mini_batch_size) {
+    mini_batch_size_ = mini_batch_size;
+  }
+
   // Partition a set of features into k clusters.
   // - features   The features to be clustered.
   // - k          The number of clusters.
@@ -90,12 +106,17 @@ class SimpleKmeans {
       const std::vector<Feature*>& features, size_t k, int random_seed,
       Centers* const centers,
       std::vector<unsigned int>* const membership) const;
+  SquaredDistanceType ClusterOnceMiniBatch(
+      const std::vector<Feature*>& features, size_t k, int random_seed,
+      Centers* const centers,
+      std::vector<unsigned int>* const membership) const;
 
   Feature zero_;
   Distance distance_;
   Initializer choose_centers_;
   size_t max_iterations_;
   size_t restarts_;
+  size_t mini_batch_size_;
 };
 
 // Initializer for K-means that randomly selects k features as the cluster
@@ -121,7 +142,7 @@ struct InitRandom {
     }
     // Take the first k permuted features as the initial centers
     for (size_t i = 0; i < centers->size(); ++i) {
-      centers[i] = *features_perm[i];
+      (*centers)[i] = *features_perm[i];
     }
   }
 
@@ -193,19 +214,7 @@ struct InitKMeansPlusPlus {
     (*centers)[0] = (*descriptors[descriptor_idx]);
     ++num_centers;
 
-    // Compute the initial distances.
     std::vector<double>::iterator minimum_distance_iterator;
-    minimum_distance_iterator = minimum_distances.begin();
-
-    std::vector<double> distances;
-    parallel_distance(
-        distance, (*centers)[num_centers - 1], descriptors, &distances);
-
-    for (size_t i = 0; i < descriptors.size();
-         ++i, ++minimum_distance_iterator) {
-      *minimum_distance_iterator = distances[i];
-    }
-
     while (num_centers < k) {
       minimum_distance_iterator = minimum_distances.begin();
       std::vector<double> distances;
@@ -223,10 +232,11 @@ struct InitKMeansPlusPlus {
           minimum_distances.begin(), minimum_distances.end(), 0.0);
 
       if (distance_sum > 0) {
+        std::uniform_real_distribution<double> cutoff_distribution(
+            0.0, distance_sum);
         double random_cutoff;
         do {
-          random_cutoff =
-              (static_cast<double>(generator()) / RAND_MAX) * distance_sum;
+          random_cutoff = cutoff_distribution(generator);
         } while (random_cutoff == 0.0);
 
         double partial_sum = 0;
@@ -0,0 +1,325 @@
+#include "vocabulary-tree/hamming.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#endif  // __x86_64__
+
+#include <glog/logging.h>
+
+// The kernels for extensions beyond SSSE3 are compiled for their target only,
+// such that the library still runs on CPUs without them.
+#if defined(__x86_64__) && (defined(__clang__) || __GNUC__ >= 5)
+#define VOCABULARY_TREE_HAMMING_X86_KERNELS
+#if defined(__clang__) || __GNUC__ >= 7
+#define VOCABULARY_TREE_HAMMING_AVX512_KERNEL
+#endif
+#endif
+
+namespace loop_closure {
+
+namespace {
+#if !defined(__ARM_NEON__)
+unsigned int Ssse3HammingDistance(
+    const unsigned char* d1, const unsigned char* d2, size_t num_bytes) {
+  const __m128i popcount_4bit =
+      _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m128i mask_4bit = _mm_set1_epi8(0x0f);
+  __m128i accumulator = _mm_setzero_si128();
+  for (size_t byte_idx = 0u; byte_idx < num_bytes; byte_idx += 16u) {
+    const __m128i xor_result = _mm_xor_si128(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(d1 + byte_idx)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(d2 + byte_idx)));
+    const __m128i lower_nibbles = _mm_and_si128(xor_result, mask_4bit);
+    const __m128i higher_nibbles =
+        _mm_and_si128(_mm_srli_epi16(xor_result, 4), mask_4bit);
+    const __m128i counts = _mm_add_epi8(
+        _mm_shuffle_epi8(popcount_4bit, lower_nibbles),
+        _mm_shuffle_epi8(popcount_4bit, higher_nibbles));
+    accumulator = _mm_add_epi64(
+        accumulator, _mm_sad_epu8(counts, _mm_setzero_si128()));
+  }
+  return static_cast<unsigned int>(
+      _mm_cvtsi128_si32(accumulator) +
+      _mm_cvtsi128_si32(_mm_unpackhi_epi64(accumulator, accumulator)));
+}
+#elif defined(__aarch64__)
+unsigned int NeonHammingDistance(
+    const unsigned char* d1, const unsigned char* d2, size_t num_bytes) {
+  uint16x8_t accumulator = vdupq_n_u16(0u);
+  unsigned int distance = 0u;
+  for (size_t byte_idx = 0u; byte_idx < num_bytes; byte_idx += 16u) {
+    const uint8x16_t xor_result =
+        veorq_u8(vld1q_u8(d1 + byte_idx), vld1q_u8(d2 + byte_idx));
+    accumulator = vpadalq_u8(accumulator, vcntq_u8(xor_result));
+    // Reduces the lanes before they can overflow.
+    if ((byte_idx / 16u) % 2048u == 2047u) {
+      distance += vaddlvq_u16(accumulator);
+      accumulator = vdupq_n_u16(0u);
+    }
+  }
+  return distance + vaddlvq_u16(accumulator);
+}
+#else   // __aarch64__
+unsigned int NeonHammingDistance(
+    const unsigned char* d1, const unsigned char* d2, size_t num_bytes) {
+  unsigned int distance = 0u;
+  for (size_t byte_idx = 0u; byte_idx < num_bytes; byte_idx += 16u) {
+    distance += HammingDistance128(d1 + byte_idx, d2 + byte_idx);
+  }
+  return distance;
+}
+#endif  // __ARM_NEON__
+
+#if defined(VOCABULARY_TREE_HAMMING_X86_KERNELS)
+__attribute__((target("popcnt"))) inline unsigned int PopcntOfXORedWords(
+    const unsigned char* d1, const unsigned char* d2, size_t num_bytes) {
+  uint64_t distance = 0u;
+  for (size_t byte_idx = 0u; byte_idx < num_bytes; byte_idx += 8u) {
+    uint64_t word1, word2;
+    std::memcpy(&word1, d1 + byte_idx, sizeof(word1));
+    std::memcpy(&word2, d2 + byte_idx, sizeof(word2));
+    distance += _mm_popcnt_u64(word1 ^ word2);
+  }
+  return static_cast<unsigned int>(distance);
+}
+
+__attribute__((target("popcnt"))) unsigned int PopcntHammingDistance(
+    const unsigned char* d1, const unsigned char* d2, size_t num_bytes) {
+  return PopcntOfXORedWords(d1, d2, num_bytes);
+}
+
+// Same nibble lookup as the SSSE3 kernel on 32 bytes at a time. The 16 bytes
+// left of descriptors such as 48 byte ones are counted with POPCNT.
+__attribute__((target("avx2,popcnt"))) unsigned int Avx2HammingDistance(
+    const unsigned char* d1, const unsigned char* d2, size_t num_bytes) {
+  const __m256i popcount_4bit = _mm256_setr_epi8(
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1,
+      2, 2, 3, 2, 3, 3, 4);
+  const __m256i mask_4bit = _mm256_set1_epi8(0x0f);
+  __m256i accumulator = _mm256_setzero_si256();
+  size_t byte_idx = 0u;
+  for (; byte_idx + 32u <= num_bytes; byte_idx += 32u) {
+    const __m256i xor_result = _mm256_xor_si256(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(d1 + byte_idx)),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(d2 + byte_idx)));
+    const __m256i lower_nibbles = _mm256_and_si256(xor_result, mask_4bit);
+    const __m256i higher_nibbles =
+        _mm256_and_si256(_mm256_srli_epi16(xor_result, 4), mask_4bit);
+    const __m256i counts = _mm256_add_epi8(
+        _mm256_shuffle_epi8(popcount_4bit, lower_nibbles),
+        _mm256_shuffle_epi8(popcount_4bit, higher_nibbles));
+    accumulator = _mm256_add_epi64(
+        accumulator, _mm256_sad_epu8(counts, _mm256_setzero_si256()));
+  }
+  const __m128i sum = _mm_add_epi64(
+      _mm256_castsi256_si128(accumulator),
+      _mm256_extracti128_si256(accumulator, 1));
+  const uint64_t distance = static_cast<uint64_t>(_mm_cvtsi128_si64(sum)) +
+                            static_cast<uint64_t>(_mm_extract_epi64(sum, 1));
+  return static_cast<unsigned int>(distance) +
+         PopcntOfXORedWords(
+             d1 + byte_idx, d2 + byte_idx, num_bytes - byte_idx);
+}
+
+#if defined(VOCABULARY_TREE_HAMMING_AVX512_KERNEL)
+// Counts the bits of 64 bytes at a time with VPOPCNTQ. The remaining words
+// are read with a masked load, which doesn't touch the memory past the end.
+__attribute__((target("avx512f,avx512vpopcntdq"))) unsigned int
+Avx512VpopcntdqHammingDistance(
+    const unsigned char* d1, const unsigned char* d2, size_t num_bytes) {
+  __m512i accumulator = _mm512_setzero_si512();
+  size_t byte_idx = 0u;
+  for (; byte_idx + 64u <= num_bytes; byte_idx += 64u) {
+    const __m512i xor_result =
+        _mm512_xor_si512(_mm512_loadu_si512(d1 + byte_idx),
+                         _mm512_loadu_si512(d2 + byte_idx));
+    accumulator =
+        _mm512_add_epi64(accumulator, _mm512_popcnt_epi64(xor_result));
+  }
+  if (byte_idx < num_bytes) {
+    const __mmask8 mask =
+        static_cast<__mmask8>((1u << ((num_bytes - byte_idx) / 8u)) - 1u);
+    const __m512i xor_result = _mm512_xor_si512(
+        _mm512_maskz_loadu_epi64(mask, d1 + byte_idx),
+        _mm512_maskz_loadu_epi64(mask, d2 + byte_idx));
+    accumulator =
+        _mm512_add_epi64(accumulator, _mm512_popcnt_epi64(xor_result));
+  }
+  uint64_t counts[8];
+  _mm512_storeu_si512(counts, accumulator);
+  uint64_t distance = 0u;
+  for (const uint64_t count : counts) {
+    distance += count;
+  }
+  return static_cast<unsigned int>(distance);
+}
+#endif  // VOCABULARY_TREE_HAMMING_AVX512_KERNEL
+
+struct CpuFeatures {
+  CpuFeatures()
+      : has_popcnt(false),
+        has_avx2(false),
+        has_avx512_vpopcntdq(false) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1u, &eax, &ebx, &ecx, &edx)) {
+      return;
+    }
+    has_popcnt = (ecx & bit_POPCNT) != 0u;
+    const bool has_osxsave = (ecx & bit_OSXSAVE) != 0u;
+    if (!has_osxsave || __get_cpuid_max(0u, nullptr) < 7u) {
+      return;
+    }
+    // The OS has to save the vector registers on context switches.
+    unsigned int xcr0_low, xcr0_high;
+    __asm__("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+    const bool os_saves_avx = (xcr0_low & 0x6u) == 0x6u;
+    const bool os_saves_avx512 = (xcr0_low & 0xe6u) == 0xe6u;
+
+    __cpuid_count(7u, 0u, eax, ebx, ecx, edx);
+    has_avx2 = os_saves_avx && (ebx & (1u << 5)) != 0u;
+    const bool has_avx512f = (ebx & (1u << 16)) != 0u;
+    has_avx512_vpopcntdq =
+        os_saves_avx512 && has_avx512f && (ecx & (1u << 14)) != 0u;
+  }
+
+  bool has_popcnt;
+  bool has_avx2;
+  bool has_avx512_vpopcntdq;
+};
+
+const CpuFeatures& getCpuFeatures() {
+  static const CpuFeatures cpu_features;
+  return cpu_features;
+}
+#endif  // VOCABULARY_TREE_HAMMING_X86_KERNELS
+
+// Prefers the kernels that count more bytes per instruction.
+HammingKernel detectBestHammingKernel() {
+  for (const HammingKernel kernel :
+       {HammingKernel::kAvx512Vpopcntdq, HammingKernel::kAvx2,
+        HammingKernel::kPopcnt, HammingKernel::kNeon}) {
+    if (isHammingKernelSupported(kernel)) {
+      return kernel;
+    }
+  }
+  return HammingKernel::kSsse3;
+}
+
+unsigned int DetectKernelAndComputeHammingDistance(
+    const unsigned char* d1, const unsigned char* d2, size_t num_bytes) {
+  const HammingKernelFunction function =
+      getHammingKernelFunction(detectBestHammingKernel());
+  internal::selected_hamming_kernel_function.store(
+      function, std::memory_order_relaxed);
+  return function(d1, d2, num_bytes);
+}
+}  // namespace
+
+namespace internal {
+std::atomic<HammingKernelFunction> selected_hamming_kernel_function(
+    &DetectKernelAndComputeHammingDistance);
+}  // namespace internal
+
+const char* getHammingKernelName(const HammingKernel kernel) {
+  switch (kernel) {
+    case HammingKernel::kSsse3:
+      return "SSSE3";
+    case HammingKernel::kPopcnt:
+      return "POPCNT";
+    case HammingKernel::kAvx2:
+      return "AVX2";
+    case HammingKernel::kAvx512Vpopcntdq:
+      return "AVX-512 VPOPCNTDQ";
+    case HammingKernel::kNeon:
+      return "NEON";
+    default:
+      LOG(FATAL) << "Unknown Hamming kernel " << static_cast<int>(kernel);
+      return "";
+  }
+}
+
+bool isHammingKernelSupported(const HammingKernel kernel) {
+  switch (kernel) {
+#if defined(__ARM_NEON__)
+    case HammingKernel::kNeon:
+      return true;
+#else   // __ARM_NEON__
+    // The library is compiled with SSSE3.
+    case HammingKernel::kSsse3:
+      return true;
+#if defined(VOCABULARY_TREE_HAMMING_X86_KERNELS)
+    case HammingKernel::kPopcnt:
+      return getCpuFeatures().has_popcnt;
+    case HammingKernel::kAvx2:
+      return getCpuFeatures().has_avx2 && getCpuFeatures().has_popcnt;
+#if defined(VOCABULARY_TREE_HAMMING_AVX512_KERNEL)
+    case HammingKernel::kAvx512Vpopcntdq:
+      return getCpuFeatures().has_avx512_vpopcntdq;
+#endif  // VOCABULARY_TREE_HAMMING_AVX512_KERNEL
+#endif  // VOCABULARY_TREE_HAMMING_X86_KERNELS
+#endif  // __ARM_NEON__
+    default:
+      return false;
+  }
+}
+
+HammingKernelFunction getHammingKernelFunction(const HammingKernel kernel) {
+  CHECK(isHammingKernelSupported(kernel))
+      << "The Hamming kernel " << getHammingKernelName(kernel)
+      << " is not supported.";
+  switch (kernel) {
+#if defined(__ARM_NEON__)
+    case HammingKernel::kNeon:
+      return &NeonHammingDistance;
+#else   // __ARM_NEON__
+    case HammingKernel::kSsse3:
+      return &Ssse3HammingDistance;
+#if defined(VOCABULARY_TREE_HAMMING_X86_KERNELS)
+    case HammingKernel::kPopcnt:
+      return &PopcntHammingDistance;
+    case HammingKernel::kAvx2:
+      return &Avx2HammingDistance;
+#if defined(VOCABULARY_TREE_HAMMING_AVX512_KERNEL)
+    case HammingKernel::kAvx512Vpopcntdq:
+      return &Avx512VpopcntdqHammingDistance;
+#endif  // VOCABULARY_TREE_HAMMING_AVX512_KERNEL
+#endif  // VOCABULARY_TREE_HAMMING_X86_KERNELS
+#endif  // __ARM_NEON__
+    default:
+      LOG(FATAL) << "Unknown Hamming kernel " << static_cast<int>(kernel);
+      return nullptr;
+  }
+}
+
+HammingKernel getSelectedHammingKernel() {
+  HammingKernelFunction function =
+      internal::selected_hamming_kernel_function.load(
+          std::memory_order_relaxed);
+  if (function == &DetectKernelAndComputeHammingDistance) {
+    return detectBestHammingKernel();
+  }
+  for (size_t kernel_idx = 0u;
+       kernel_idx < static_cast<size_t>(HammingKernel::kNumKernels);
+       ++kernel_idx) {
+    const HammingKernel kernel = static_cast<HammingKernel>(kernel_idx);
+    if (isHammingKernelSupported(kernel) &&
+        getHammingKernelFunction(kernel) == function) {
+      return kernel;
+    }
+  }
+  LOG(FATAL) << "The selected Hamming kernel is unknown.";
+  return HammingKernel::kSsse3;
+}
+
+void selectHammingKernel(const HammingKernel kernel) {
+  internal::selected_hamming_kernel_function.store(
+      getHammingKernelFunction(kernel), std::memory_order_relaxed);
+}
+
+}  // namespace loop_closure
@@ -0,0 +1,170 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "vocabulary-tree/hamming.h"
+
+namespace {
+// FREAK and BRISK descriptors have 512 bits, the 384 bits are BRISK
+// descriptors without the last 16 bytes.
+constexpr size_t kDescriptorSizesBytes[] = {16u, 32u, 48u, 64u};
+
+unsigned int ReferenceHammingDistance(
+    const unsigned char* d1, const unsigned char* d2, size_t num_bytes) {
+  unsigned int distance = 0u;
+  for (size_t byte_idx = 0u; byte_idx < num_bytes; ++byte_idx) {
+    unsigned char xor_result = d1[byte_idx] ^ d2[byte_idx];
+    for (; xor_result != 0u; xor_result &= xor_result - 1u) {
+      ++distance;
+    }
+  }
+  return distance;
+}
+
+std::vector<unsigned char> GenerateDescriptors(
+    size_t num_bytes, std::mt19937* generator) {
+  std::uniform_int_distribution<int> byte_distribution(0, 255);
+  std::vector<unsigned char> descriptors(num_bytes);
+  for (unsigned char& byte : descriptors) {
+    byte = static_cast<unsigned char>(byte_distribution(*generator));
+  }
+  return descriptors;
+}
+
+std::vector<loop_closure::HammingKernel> GetSupportedKernels() {
+  std::vector<loop_closure::HammingKernel> kernels;
+  for (size_t kernel_idx = 0u;
+       kernel_idx <
+       static_cast<size_t>(loop_closure::HammingKernel::kNumKernels);
+       ++kernel_idx) {
+    const loop_closure::HammingKernel kernel =
+        static_cast<loop_closure::HammingKernel>(kernel_idx);
+    if (loop_closure::isHammingKernelSupported(kernel)) {
+      kernels.push_back(kernel);
+    }
+  }
+  return kernels;
+}
+}  // namespace
+
+TEST(VocabularyTree, HammingKernelsMatchReference) {
+  constexpr size_t kNumDescriptors = 1000u;
+  std::mt19937 generator(42u);
+  const std::vector<loop_closure::HammingKernel> kernels =
+      GetSupportedKernels();
+  ASSERT_FALSE(kernels.empty());
+
+  for (const size_t num_bytes : kDescriptorSizesBytes) {
+    // Offsets the descriptors by one byte to check unaligned reads.
+    const std::vector<unsigned char> descriptors1 =
+        GenerateDescriptors(kNumDescriptors * num_bytes + 1u, &generator);
+    const std::vector<unsigned char> descriptors2 =
+        GenerateDescriptors(kNumDescriptors * num_bytes + 1u, &generator);
+    for (const loop_closure::HammingKernel kernel : kernels) {
+      const loop_closure::HammingKernelFunction function =
+          loop_closure::getHammingKernelFunction(kernel);
+      for (size_t descriptor_idx = 0u; descriptor_idx < kNumDescriptors;
+           ++descriptor_idx) {
+        const unsigned char* d1 =
+            descriptors1.data() + 1u + descriptor_idx * num_bytes;
+        const unsigned char* d2 =
+            descriptors2.data() + 1u + descriptor_idx * num_bytes;
+        ASSERT_EQ(
+            ReferenceHammingDistance(d1, d2, num_bytes),
+            function(d1, d2, num_bytes))
+            << loop_closure::getHammingKernelName(kernel) << " for "
+            << num_bytes << " bytes";
+      }
+      // All bits differ.
+      std::vector<unsigned char> zeros(num_bytes, 0u);
+      std::vector<unsigned char> ones(num_bytes, 0xffu);
+      EXPECT_EQ(8u * num_bytes, function(zeros.data(), ones.data(), num_bytes));
+      EXPECT_EQ(0u, function(ones.data(), ones.data(), num_bytes));
+    }
+  }
+}
+
+TEST(VocabularyTree, HammingDistanceUsesSelectedKernel) {
+  const loop_closure::HammingKernel detected_kernel =
+      loop_closure::getSelectedHammingKernel();
+  EXPECT_TRUE(loop_closure::isHammingKernelSupported(detected_kernel));
+  LOG(INFO) << "Detected Hamming kernel: "
+            << loop_closure::getHammingKernelName(detected_kernel);
+
+  std::mt19937 generator(43u);
+  const std::vector<unsigned char> d1 = GenerateDescriptors(64u, &generator);
+  const std::vector<unsigned char> d2 = GenerateDescriptors(64u, &generator);
+  for (const loop_closure::HammingKernel kernel : GetSupportedKernels()) {
+    loop_closure::selectHammingKernel(kernel);
+    EXPECT_EQ(kernel, loop_closure::getSelectedHammingKernel());
+    EXPECT_EQ(
+        ReferenceHammingDistance(d1.data(), d2.data(), 16u),
+        loop_closure::HammingDistance128(d1.data(), d2.data()));
+    EXPECT_EQ(
+        ReferenceHammingDistance(d1.data(), d2.data(), 32u),
+        loop_closure::HammingDistance256(d1.data(), d2.data()));
+    EXPECT_EQ(
+        ReferenceHammingDistance(d1.data(), d2.data(), 48u),
+        loop_closure::HammingDistanceOfBytes(d1.data(), d2.data(), 48u));
+    EXPECT_EQ(
+        ReferenceHammingDistance(d1.data(), d2.data(), 64u),
+        loop_closure::HammingDistance(d1.data(), d2.data(), 512u));
+  }
+  loop_closure::selectHammingKernel(detected_kernel);
+}
+
+// Compares the kernels on the distances of a query descriptor to 100000
+// descriptors, as when searching the words of a vocabulary. Only the results
+// are checked, the timings are logged.
+TEST(VocabularyTree, HammingKernelBenchmark) {
+  constexpr size_t kNumDescriptors = 100000u;
+  constexpr size_t kNumRepetitions = 10u;
+  std::mt19937 generator(44u);
+
+  typedef std::chrono::steady_clock Clock;
+  for (const size_t num_bytes : kDescriptorSizesBytes) {
+    const std::vector<unsigned char> query =
+        GenerateDescriptors(num_bytes, &generator);
+    const std::vector<unsigned char> descriptors =
+        GenerateDescriptors(kNumDescriptors * num_bytes, &generator);
+
+    uint64_t reference_sum = 0u;
+    for (size_t descriptor_idx = 0u; descriptor_idx < kNumDescriptors;
+         ++descriptor_idx) {
+      reference_sum += ReferenceHammingDistance(
+          query.data(), descriptors.data() + descriptor_idx * num_bytes,
+          num_bytes);
+    }
+
+    for (const loop_closure::HammingKernel kernel : GetSupportedKernels()) {
+      const loop_closure::HammingKernelFunction function =
+          loop_closure::getHammingKernelFunction(kernel);
+      uint64_t sum = 0u;
+      const Clock::time_point start = Clock::now();
+      for (size_t repetition = 0u; repetition < kNumRepetitions;
+           ++repetition) {
+        for (size_t descriptor_idx = 0u; descriptor_idx < kNumDescriptors;
+             ++descriptor_idx) {
+          sum += function(
+              query.data(), descriptors.data() + descriptor_idx * num_bytes,
+              num_bytes);
+        }
+      }
+      const double elapsed_ns =
+          std::chrono::duration<double, std::nano>(Clock::now() - start)
+              .count();
+      EXPECT_EQ(kNumRepetitions * reference_sum, sum);
+      LOG(INFO) << loop_closure::getHammingKernelName(kernel) << ", "
+                << 8u * num_bytes << " bits: "
+                << elapsed_ns / (kNumRepetitions * kNumDescriptors)
+                << " ns per distance.";
+    }
+  }
+}
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,100 @@
+#include <cstdio>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <vocabulary-tree/distance.h>
+#include <vocabulary-tree/simple-kmeans.h>
+#include <vocabulary-tree/types.h>
+
+#include "./floating-point-test-helpers.h"
+
+typedef loop_closure::SimpleKmeans<DescriptorType,
+                                   loop_closure::distance::L2<DescriptorType> >
+    Kmeans;
+
+TEST(VocabularyTree, SimpleKMeans_MiniBatchKMeansCluster) {
+  std::mt19937 generator(40);
+  static const size_t kNumfeaturesPerCluster = 100;
+  static const size_t kNumClusters = 20;
+  DescriptorVector gt_centers;
+  DescriptorVector descriptors;
+  std::vector<unsigned int> membership;
+  std::vector<unsigned int> gt_membership;
+
+  GenerateTestData(
+      kNumfeaturesPerCluster, kNumClusters, generator(), &gt_centers,
+      &descriptors, &membership, &gt_membership);
+
+  DescriptorType descriptor_zero;
+  descriptor_zero.setConstant(
+      kDescriptorDimensionality, 1, static_cast<Scalar>(0));
+  Kmeans kmeans(descriptor_zero);
+  kmeans.SetRestarts(4u);
+
+  // Both variants start from the same kmeans++ seeding.
+  const int kSeed = 42;
+  std::shared_ptr<DescriptorVector> centers =
+      aligned_shared<DescriptorVector>();
+  const Kmeans::SquaredDistanceType lloyd_sse =
+      kmeans.Cluster(descriptors, kNumClusters, kSeed, &membership, &centers);
+
+  kmeans.SetMiniBatchSize(200u);
+  std::shared_ptr<DescriptorVector> mini_batch_centers =
+      aligned_shared<DescriptorVector>();
+  std::vector<unsigned int> mini_batch_membership;
+  const Kmeans::SquaredDistanceType mini_batch_sse = kmeans.Cluster(
+      descriptors, kNumClusters, kSeed, &mini_batch_membership,
+      &mini_batch_centers);
+  ASSERT_EQ(kNumClusters, mini_batch_centers->size());
+  ASSERT_EQ(descriptors.size(), mini_batch_membership.size());
+  EXPECT_LT(mini_batch_sse, 1.05 * lloyd_sse);
+
+  // The membership is the assignment to the closest final center.
+  loop_closure::distance::L2<DescriptorType> l2_distance;
+  for (size_t i = 0u; i < descriptors.size(); ++i) {
+    const unsigned int assigned_center = mini_batch_membership[i];
+    for (size_t center_idx = 0u; center_idx < kNumClusters; ++center_idx) {
+      EXPECT_LE(
+          l2_distance(descriptors[i], (*mini_batch_centers)[assigned_center]),
+          l2_distance(descriptors[i], (*mini_batch_centers)[center_idx]));
+    }
+  }
+}
+
+TEST(VocabularyTree, SimpleKMeans_ParallelRestartsAreDeterministic) {
+  std::mt19937 generator(40);
+  static const size_t kNumfeaturesPerCluster = 50;
+  static const size_t kNumClusters = 20;
+  DescriptorVector gt_centers;
+  DescriptorVector descriptors;
+  std::vector<unsigned int> membership;
+  std::vector<unsigned int> gt_membership;
+
+  GenerateTestData(
+      kNumfeaturesPerCluster, kNumClusters, generator(), &gt_centers,
+      &descriptors, &membership, &gt_membership);
+
+  DescriptorType descriptor_zero;
+  descriptor_zero.setConstant(
+      kDescriptorDimensionality, 1, static_cast<Scalar>(0));
+  Kmeans kmeans(descriptor_zero);
+  kmeans.SetRestarts(5u);
+
+  const int kSeed = 42;
+  std::shared_ptr<DescriptorVector> centers =
+      aligned_shared<DescriptorVector>();
+  const Kmeans::SquaredDistanceType sse =
+      kmeans.Cluster(descriptors, kNumClusters, kSeed, &membership, &centers);
+  std::vector<unsigned int> other_membership;
+  std::shared_ptr<DescriptorVector> other_centers =
+      aligned_shared<DescriptorVector>();
+  EXPECT_EQ(
+      sse, kmeans.Cluster(
+               descriptors, kNumClusters, kSeed, &other_membership,
+               &other_centers));
+  EXPECT_EQ(membership, other_membership);
+}
+
+MAPLAB_UNITTEST_ENTRYPOINT
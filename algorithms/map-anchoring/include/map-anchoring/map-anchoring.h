@@ -40,6 +40,13 @@ bool anchorMissionUsingProvidedLoopDetector(
     const loop_detector_node::LoopDetectorNode& loop_detector,
     vi_map::VIMap* map);
 
+// Anchors the mission with the estimated T_G_M if the probe was successful.
+bool applyProbeResult(
+    const vi_map::MissionId& mission_id, const ProbeResult& probe_result,
+    vi_map::VIMap* map);
+
+// Only reads the map, so several missions can be probed in parallel as long
+// as their descriptors are loaded.
 void probeMissionAnchoring(
     const vi_map::MissionId& mission_id,
     const loop_detector_node::LoopDetectorNode& loop_detector,
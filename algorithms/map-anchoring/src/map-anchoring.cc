@@ -1,6 +1,11 @@
 #include "map-anchoring/map-anchoring.h"
 
+#include <vector>
+
+#include <aslam/common/memory.h>
 #include <loop-closure-handler/loop-detector-node.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 #include <vi-map/vi-map.h>
 #include <visualization/viwls-graph-plotter.h>
 
@@ -37,7 +42,10 @@ bool anchorMission(const vi_map::MissionId& mission_id, vi_map::VIMap* map) {
   loop_detector_node::LoopDetectorNode loop_detector;
   addAllMissionsWithKnownBaseFrameToProvidedLoopDetector(*map, &loop_detector);
 
-  return anchorMissionUsingProvidedLoopDetector(mission_id, loop_detector, map);
+  const bool success =
+      anchorMissionUsingProvidedLoopDetector(mission_id, loop_detector, map);
+  loop_detector.saveProjectedDescriptorCache(map);
+  return success;
 }
 
 bool anchorAllMissions(vi_map::VIMap* map) {
@@ -49,7 +57,7 @@ bool anchorAllMissions(
     vi_map::VIMap* map, const visualization::ViwlsGraphRvizPlotter* plotter) {
   CHECK_NOTNULL(map);
   // Build a list of all unknown baseframes.
-  std::queue<vi_map::MissionId> missions_with_unknown_baseframe;
+  vi_map::MissionIdList missions_with_unknown_baseframe;
   vi_map::MissionIdList all_missions;
   map->getAllMissionIds(&all_missions);
   for (const vi_map::MissionId& mission_id : all_missions) {
@@ -57,7 +65,7 @@ bool anchorAllMissions(
     const vi_map::MissionBaseFrame& base_frame =
         map->getMissionBaseFrame(mission.getBaseFrameId());
     if (!base_frame.is_T_G_M_known()) {
-      missions_with_unknown_baseframe.push(mission_id);
+      missions_with_unknown_baseframe.push_back(mission_id);
     }
   }
 
@@ -71,59 +79,64 @@ bool anchorAllMissions(
     return true;
   }
 
-  // A loop-detector to which we add all the missions we have already anchored.
-  // This allows us to avoid building the index over and over as we anchor new
-  // missions.
+  // The database of the missions with a known baseframe is built once and
+  // only extended by the missions that get anchored.
   loop_detector_node::LoopDetectorNode loop_detector;
+  VLOG(1) << "Adding known missions to loop-detector.";
+  addAllMissionsWithKnownBaseFrameToProvidedLoopDetector(*map, &loop_detector);
 
-  // Add the known missions to the database.
-  bool initial_mission_added = false;
-
-  // How often do we try to anchor. Prevent locking forever.
-  constexpr int kTrialsPerMission = 2;
-  int remaining_trials_for_mission = kTrialsPerMission;
+  // Every round probes all remaining missions in parallel against the
+  // database and then anchors the successful ones. The probes only read the
+  // map, the descriptors of the query missions are paged in beforehand. The
+  // rounds continue as long as missions get anchored, as a mission may only
+  // overlap with missions that got anchored in the previous round.
+  const size_t num_threads = common::getNumHardwareThreads();
+  int round = 0;
   while (!missions_with_unknown_baseframe.empty()) {
-    if (FLAGS_add_anchored_missions_to_database || !initial_mission_added) {
-      VLOG(1) << "Adding known missions to loop-detector.";
-      // Add all missions that have a known base-frame (if any).
-      addAllMissionsWithKnownBaseFrameToProvidedLoopDetector(
-          *map, &loop_detector);
-      initial_mission_added = true;
+    ++round;
+    VLOG(1) << "Anchoring round " << round << ": probing "
+            << missions_with_unknown_baseframe.size() << " missions.";
+    for (const vi_map::MissionId& mission_id :
+         missions_with_unknown_baseframe) {
+      map->ensureDescriptorsLoadedForMission(mission_id);
     }
 
-    vi_map::MissionId mission_id = missions_with_unknown_baseframe.front();
-    missions_with_unknown_baseframe.pop();
-
-    // Assemble the current working set.
-    vi_map::MissionIdSet selected_missions;
-    selected_missions.insert(mission_id);
-    vi_map::MissionIdList all_missions;
-    map->getAllMissionIds(&all_missions);
-    for (const vi_map::MissionId& mission_id : all_missions) {
-      const vi_map::MissionBaseFrame& base_frame =
-          map->getMissionBaseFrameForMission(mission_id);
-      if (base_frame.is_T_G_M_known()) {
-        selected_missions.insert(mission_id);
+    Aligned<std::vector, ProbeResult> probe_results(
+        missions_with_unknown_baseframe.size());
+    common::ParallelProcessDynamic(
+        missions_with_unknown_baseframe.size(),
+        [&](const size_t range_begin, const size_t range_end) {
+          for (size_t mission_idx = range_begin; mission_idx < range_end;
+               ++mission_idx) {
+            probeMissionAnchoring(
+                missions_with_unknown_baseframe[mission_idx], loop_detector,
+                map, &probe_results[mission_idx]);
+          }
+        },
+        num_threads, common::ParallelSchedule::kDynamic);
+
+    vi_map::MissionIdList anchored_missions;
+    vi_map::MissionIdList remaining_missions;
+    for (size_t mission_idx = 0u;
+         mission_idx < missions_with_unknown_baseframe.size(); ++mission_idx) {
+      const vi_map::MissionId& mission_id =
+          missions_with_unknown_baseframe[mission_idx];
+      if (applyProbeResult(mission_id, probe_results[mission_idx], map)) {
+        anchored_missions.push_back(mission_id);
+      } else {
+        remaining_missions.push_back(mission_id);
       }
     }
-    map->selectMissions(selected_missions);
-
-    VLOG(1) << "Trying to anchor mission " << mission_id << ".";
-    bool success =
-        anchorMissionUsingProvidedLoopDetector(mission_id, loop_detector, map);
-
-    if (!success) {
-      LOG(WARNING) << "Failed to anchor mission " << mission_id
-                   << ", pushing it back to the work-list.";
-      --remaining_trials_for_mission;
-      if (remaining_trials_for_mission > 0) {
-        missions_with_unknown_baseframe.push(mission_id);
-        continue;
-      }
+    missions_with_unknown_baseframe.swap(remaining_missions);
+    if (anchored_missions.empty()) {
+      break;
+    }
 
-      // Continuing to next mission, reset number of remaining trials.
-      remaining_trials_for_mission = kTrialsPerMission;
-      continue;
+    if (FLAGS_add_anchored_missions_to_database) {
+      for (const vi_map::MissionId& mission_id : anchored_missions) {
+        loop_detector.addMissionToDatabase(mission_id, *map);
+      }
+      VLOG(1) << loop_detector.printStatus();
     }
 
     if (plotter != nullptr) {
@@ -131,18 +144,16 @@ bool anchorAllMissions(
     }
   }
 
+  loop_detector.saveProjectedDescriptorCache(map);
   if (!missions_with_unknown_baseframe.empty()) {
     LOG(ERROR) << "Could not anchor all missions. Still have the following "
                << "unanchored:";
-    while (!missions_with_unknown_baseframe.empty()) {
-      vi_map::MissionId mission_id = missions_with_unknown_baseframe.front();
-      missions_with_unknown_baseframe.pop();
+    for (const vi_map::MissionId& mission_id :
+         missions_with_unknown_baseframe) {
       LOG(ERROR) << "\t" << mission_id;
     }
-    map->resetMissionSelection();
     return false;
   }
-  map->resetMissionSelection();
   VLOG(3) << "All missions anchored.";
   return true;
 }
@@ -192,7 +203,14 @@ bool anchorMissionUsingProvidedLoopDetector(
   // Probe.
   ProbeResult probe_result;
   probeMissionAnchoring(mission_id, loop_detector, map, &probe_result);
+  return applyProbeResult(mission_id, probe_result, map);
+}
 
+bool applyProbeResult(
+    const vi_map::MissionId& mission_id, const ProbeResult& probe_result,
+    vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  CHECK(map->hasMission(mission_id));
   if (probe_result.wasSuccessful()) {
     CHECK(!probe_result.matching_missions.empty());
     VLOG(1) << "Probe successful, will anchor mission " << mission_id;
@@ -31,6 +31,7 @@
 #include <vi-map/vi-mission.h>
 
 #include "map-optimization-legacy/ba-optimization-options.h"
+#include "map-optimization-legacy/double-window.h"
 
 DECLARE_bool(verbose_ba);
 
@@ -43,8 +44,6 @@ class LossFunctionWrapper;
 
 namespace map_optimization_legacy {
 
-class DoubleWindow;
-
 class GraphBaOptimizer {
  public:
   template <typename CallbackType>
@@ -84,6 +83,15 @@ class GraphBaOptimizer {
   void doubleWindowBaOptimization(
       const DoubleWindow& double_window, int num_iterations);
 
+  // Optimizes the double windows in the given order. Windows that share no
+  // vertices and landmarks are optimized concurrently on up to num_threads
+  // threads, each on its own copy of the vertex poses, and merged back into
+  // the map afterwards. Overlapping windows are optimized after the windows
+  // they overlap with. The mission baseframes are held constant.
+  void doubleWindowBaOptimization(
+      const DoubleWindow::PtrVector& double_windows, int num_iterations,
+      size_t num_threads);
+
   void alignMissions(
       const std::function<void(const vi_map::VIMap&)>& callback,
       const vi_map::MissionIdSet& missions,
@@ -176,6 +184,24 @@ class GraphBaOptimizer {
 
   void addDoubleWindowVisualResidualBlocks(const DoubleWindow& double_window);
 
+  // Builds and solves the problem of a double window without copying the
+  // optimized vertex poses back to the map. Returns false if the window
+  // could not be optimized.
+  bool solveDoubleWindowProblem(
+      const DoubleWindow& double_window, int num_iterations,
+      bool fix_all_baseframes, int num_solver_threads);
+
+  // The map data a double window optimization reads or writes in place.
+  struct DoubleWindowFootprint {
+    pose_graph::VertexIdSet vertices;
+    vi_map::LandmarkIdSet landmarks;
+
+    bool overlaps(const DoubleWindowFootprint& other) const;
+  };
+  void getDoubleWindowFootprint(
+      const DoubleWindow& double_window,
+      DoubleWindowFootprint* footprint) const;
+
   void addInertialResidualBlocks(
       bool fix_gyro_bias, bool fix_accel_bias, bool fix_velocity,
       bool use_given_edges, const pose_graph::EdgeIdList& edges,
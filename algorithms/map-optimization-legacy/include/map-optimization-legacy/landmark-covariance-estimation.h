@@ -1,6 +1,8 @@
 #ifndef MAP_OPTIMIZATION_LEGACY_LANDMARK_COVARIANCE_ESTIMATION_H_
 #define MAP_OPTIMIZATION_LEGACY_LANDMARK_COVARIANCE_ESTIMATION_H_
 
+#include <vector>
+
 #include <map-optimization-legacy/graph-ba-optimizer.h>
 
 namespace map_optimization_legacy {
@@ -18,6 +20,14 @@ class LandmarkCovarianceEstimation : public GraphBaOptimizer {
  private:
   void addErrorTerms(const pose_graph::VertexIdSet& fixed_vertices);
   void calculateCovariance(ceres::Problem* problem);
+
+  // Recovers the 3x3 marginal covariances of the given landmarks from the
+  // Schur complement of all landmarks in the problem. Returns false if the
+  // reduced camera system could not be factorized.
+  bool calculateCovarianceFromSchurComplement(
+      const vi_map::LandmarkIdList& landmark_ids, ceres::Problem* problem);
+  void calculateCovarianceWithCeres(
+      const vi_map::LandmarkIdList& landmark_ids, ceres::Problem* problem);
 };
 
 }  // namespace map_optimization_legacy
@@ -1,6 +1,8 @@
 #include "map-optimization-legacy/graph-ba-optimizer.h"
 
+#include <algorithm>
 #include <cmath>
+#include <functional>
 
 #include <ceres/loss_function.h>
 #include <gflags/gflags.h>
@@ -27,6 +29,7 @@
 #include <ceres-error-terms/visual-error-term-factory.h>
 #include <ceres-error-terms/visual-error-term.h>
 #include <maplab-common/gravity-provider.h>
+#include <maplab-common/parallel-process.h>
 #include <maplab-common/pose_types.h>
 #include <maplab-common/progress-bar.h>
 #include <maplab-common/quaternion-math.h>
@@ -89,8 +92,9 @@ ceres::Solver::Options GraphBaOptimizer::getDefaultSolverOptions() const {
   options.function_tolerance = 1e-12;
   options.gradient_tolerance = 1e-10;
   options.parameter_tolerance = 1e-8;
-  options.num_threads = common::getNumHardwareThreads();
-  options.num_linear_solver_threads = common::getNumHardwareThreads();
+  options.num_threads = common::getNumThreadsForSubsystem(
+      common::ThreadingSubsystem::kOptimization);
+  options.num_linear_solver_threads = options.num_threads;
   options.jacobi_scaling = false;
   options.initial_trust_region_radius = 1e5;
   options.max_trust_region_radius = 1e20;
@@ -418,6 +422,173 @@ void GraphBaOptimizer::visualBaOptimization(
 
 void GraphBaOptimizer::doubleWindowBaOptimization(
     const DoubleWindow& double_window, int num_iterations) {
+  constexpr bool kFixAllBaseframes = false;
+  if (!solveDoubleWindowProblem(
+          double_window, num_iterations, kFixAllBaseframes,
+          common::getNumHardwareThreads())) {
+    return;
+  }
+
+  pose_graph::VertexIdSet all_dw_vertices_set;
+  double_window.getAllWindowVertices(&all_dw_vertices_set);
+  pose_graph::VertexIdList all_dw_vertices(
+      all_dw_vertices_set.begin(), all_dw_vertices_set.end());
+  const bool kCopyVertices = true;
+  const bool kCopyBaseframes = true;
+  const bool kCopyCameras = true;
+  const bool kCopyOptionalSensorExtrinsics = true;
+  copyDataOfSelectedVerticesToMap(
+      kCopyVertices, kCopyBaseframes, kCopyCameras,
+      kCopyOptionalSensorExtrinsics, all_dw_vertices);
+
+  // This function will flag all landmarks behind the camera as bad.
+  removeLandmarksBehindCamera();
+}
+
+void GraphBaOptimizer::doubleWindowBaOptimization(
+    const DoubleWindow::PtrVector& double_windows, int num_iterations,
+    size_t num_threads) {
+  CHECK_GT(num_threads, 0u);
+  if (double_windows.empty()) {
+    return;
+  }
+
+  // Group the windows into rounds of windows that can be optimized
+  // concurrently. A window goes into the round after the last round holding
+  // an earlier window it overlaps with, such that it starts from the
+  // optimized state of that window as it would in a sequential optimization.
+  std::vector<DoubleWindowFootprint> footprints(double_windows.size());
+  for (size_t window_idx = 0u; window_idx < double_windows.size();
+       ++window_idx) {
+    CHECK(double_windows[window_idx] != nullptr);
+    getDoubleWindowFootprint(
+        *double_windows[window_idx], &footprints[window_idx]);
+  }
+  std::vector<std::vector<size_t>> rounds;
+  std::vector<size_t> window_rounds(double_windows.size(), 0u);
+  for (size_t window_idx = 0u; window_idx < double_windows.size();
+       ++window_idx) {
+    size_t round_idx = 0u;
+    for (size_t other_idx = 0u; other_idx < window_idx; ++other_idx) {
+      if (window_rounds[other_idx] >= round_idx &&
+          footprints[window_idx].overlaps(footprints[other_idx])) {
+        round_idx = window_rounds[other_idx] + 1u;
+      }
+    }
+    if (round_idx == rounds.size()) {
+      rounds.emplace_back();
+    }
+    rounds[round_idx].push_back(window_idx);
+    window_rounds[window_idx] = round_idx;
+  }
+  VLOG(1) << "Optimizing " << double_windows.size() << " double windows in "
+          << rounds.size() << " rounds on " << num_threads << " threads.";
+
+  const int num_hardware_threads = common::getNumHardwareThreads();
+  for (const std::vector<size_t>& round : rounds) {
+    // Every window is solved on a separate optimizer holding its own copy of
+    // the vertex, baseframe and extrinsics states. Landmarks, velocities and
+    // biases are optimized in place in the map, which is safe as the windows
+    // of a round do not share any of them. The baseframes are shared by all
+    // windows of a mission and are therefore held constant.
+    const size_t num_round_threads = std::min(num_threads, round.size());
+    const int num_solver_threads = std::max(
+        1, num_hardware_threads / static_cast<int>(num_round_threads));
+    std::vector<std::unique_ptr<GraphBaOptimizer>> window_optimizers(
+        round.size());
+    std::vector<char> window_solved(round.size(), false);
+    std::function<void(size_t, size_t)> solve_windows =
+        [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            window_optimizers[i].reset(new GraphBaOptimizer(&map_));
+            constexpr bool kFixAllBaseframes = true;
+            window_solved[i] = window_optimizers[i]->solveDoubleWindowProblem(
+                *double_windows[round[i]], num_iterations, kFixAllBaseframes,
+                num_solver_threads);
+          }
+        };
+    common::ParallelProcessDynamic(
+        round.size(), solve_windows, num_round_threads,
+        common::ParallelSchedule::kDynamic);
+
+    // Merge the per-window states back into the map once all windows of the
+    // round are solved, as the optimizers read the map while they are set up.
+    for (size_t i = 0u; i < round.size(); ++i) {
+      if (!window_solved[i]) {
+        continue;
+      }
+      pose_graph::VertexIdSet window_vertices;
+      double_windows[round[i]]->getAllWindowVertices(&window_vertices);
+      const pose_graph::VertexIdList window_vertex_list(
+          window_vertices.begin(), window_vertices.end());
+      constexpr bool kCopyVertices = true;
+      constexpr bool kCopyBaseframes = false;
+      constexpr bool kCopyCameras = false;
+      constexpr bool kCopyOptionalSensorExtrinsics = false;
+      window_optimizers[i]->copyDataOfSelectedVerticesToMap(
+          kCopyVertices, kCopyBaseframes, kCopyCameras,
+          kCopyOptionalSensorExtrinsics, window_vertex_list);
+    }
+  }
+
+  // Refresh the pose copies of this optimizer with the merged map state.
+  vertex_id_to_pose_idx_.clear();
+  baseframe_id_to_baseframe_idx_.clear();
+  sensor_id_to_extrinsics_col_idx_.clear();
+  camera_id_to_T_C_I_idx_.clear();
+  camera_id_to_ncamera_ids_.clear();
+  copyDataFromMap();
+
+  // This function will flag all landmarks behind the camera as bad.
+  removeLandmarksBehindCamera();
+}
+
+void GraphBaOptimizer::getDoubleWindowFootprint(
+    const DoubleWindow& double_window,
+    DoubleWindowFootprint* footprint) const {
+  CHECK_NOTNULL(footprint);
+  double_window.getAllWindowVertices(&footprint->vertices);
+  footprint->landmarks = double_window.getLandmarksSeenFromInnerWindow();
+
+  // The inertial terms optimize the velocities and biases of the edge
+  // vertices in place and the visual terms depend on the landmark store
+  // vertices.
+  pose_graph::EdgeIdList all_window_edges = double_window.getInnerWindowEdges();
+  all_window_edges.insert(
+      all_window_edges.end(), double_window.getOuterWindowEdges().begin(),
+      double_window.getOuterWindowEdges().end());
+  for (const pose_graph::EdgeId& edge_id : all_window_edges) {
+    const vi_map::Edge& edge = const_map_.getEdgeAs<vi_map::Edge>(edge_id);
+    footprint->vertices.insert(edge.from());
+    footprint->vertices.insert(edge.to());
+  }
+  for (const vi_map::LandmarkId& landmark_id : footprint->landmarks) {
+    if (const_map_.hasLandmark(landmark_id)) {
+      footprint->vertices.insert(
+          const_map_.getLandmarkStoreVertexId(landmark_id));
+    }
+  }
+}
+
+bool GraphBaOptimizer::DoubleWindowFootprint::overlaps(
+    const DoubleWindowFootprint& other) const {
+  for (const pose_graph::VertexId& vertex_id : vertices) {
+    if (other.vertices.count(vertex_id) > 0u) {
+      return true;
+    }
+  }
+  for (const vi_map::LandmarkId& landmark_id : landmarks) {
+    if (other.landmarks.count(landmark_id) > 0u) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool GraphBaOptimizer::solveDoubleWindowProblem(
+    const DoubleWindow& double_window, int num_iterations,
+    bool fix_all_baseframes, int num_solver_threads) {
+  CHECK_GT(num_solver_threads, 0);
   problem_information_.clearProblemInformation();
 
   const BaOptimizationOptions options;
@@ -462,7 +633,7 @@ void GraphBaOptimizer::doubleWindowBaOptimization(
     if (!double_window.isMissionToOptimizeSet()) {
       LOG(ERROR) << "Mission ID to optimize is not set. "
                  << "Aborting optimization...";
-      return;
+      return false;
     } else {
       CHECK(map_.hasMission(double_window.getMissionToOptimize()));
       pose_graph::VertexIdSet all_dw_vertices;
@@ -520,37 +691,28 @@ void GraphBaOptimizer::doubleWindowBaOptimization(
     fixVertices(fixed_vertices_set);
     fixVerticesAndObservedLandmarks(fixed_mission_vertices_set);
   }
+  if (fix_all_baseframes) {
+    fixBaseframes();
+  }
 
   ceres::Solver::Options solver_options = getDefaultSolverOptions();
   solver_options.max_num_iterations = num_iterations;
   solver_options.gradient_tolerance = 1e2;
   solver_options.function_tolerance = 1e-4;
+  solver_options.num_threads = num_solver_threads;
+  solver_options.num_linear_solver_threads = num_solver_threads;
   ceres_problem_.reset(
       new ceres::Problem(ceres_error_terms::getDefaultProblemOptions()));
   buildProblem(ceres_problem_.get());
 
-  // Don't copy the data using the default method, we will do it selectively
-  // below.
+  // Don't copy the data using the default method, the caller copies the
+  // window vertices selectively.
   static constexpr bool kCopyDataFromSolverBackToMap = false;
   ceres::Solver::Summary summary;
   solve(
       kCopyDataFromSolverBackToMap, solver_options, ceres_problem_.get(),
       &summary);
-
-  pose_graph::VertexIdSet all_dw_vertices_set;
-  double_window.getAllWindowVertices(&all_dw_vertices_set);
-  pose_graph::VertexIdList all_dw_vertices(
-      all_dw_vertices_set.begin(), all_dw_vertices_set.end());
-  const bool kCopyVertices = true;
-  const bool kCopyBaseframes = true;
-  const bool kCopyCameras = true;
-  const bool kCopyOptionalSensorExtrinsics = true;
-  copyDataOfSelectedVerticesToMap(
-      kCopyVertices, kCopyBaseframes, kCopyCameras,
-      kCopyOptionalSensorExtrinsics, all_dw_vertices);
-
-  // This function will flag all landmarks behind the camera as bad.
-  removeLandmarksBehindCamera();
+  return true;
 }
 
 void GraphBaOptimizer::visualBaOptimizationWithCallback(
@@ -1,8 +1,19 @@
 #include <map-optimization-legacy/landmark-covariance-estimation.h>
 
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <Eigen/Cholesky>
 #include <Eigen/Core>
+#include <Eigen/SparseCholesky>
+#include <Eigen/SparseCore>
+#include <aslam/common/memory.h>
+#include <aslam/common/timer.h>
 #include <ceres/ceres.h>
 #include <gflags/gflags.h>
+#include <maplab-common/parallel-process.h>
 #include <maplab-common/threading-helpers.h>
 #include <vi-map/landmark-quality-metrics.h>
 
@@ -13,6 +24,17 @@ DEFINE_uint64(
 DEFINE_uint64(
     cov_estimation_min_observations_per_frame, 5,
     "Minimum required number of observations per frame.");
+DEFINE_bool(
+    cov_estimation_use_schur_complement, true,
+    "Recover the landmark covariances from the Schur complement of the "
+    "landmarks instead of using ceres::Covariance. Falls back to "
+    "ceres::Covariance if the reduced camera system is not positive "
+    "definite.");
+DEFINE_double(
+    cov_estimation_landmark_sampling_ratio, 1.0,
+    "Ratio of the well-constrained landmarks, evenly spread over the map, "
+    "whose covariance is estimated. The covariance of the other landmarks is "
+    "left unchanged.");
 
 namespace map_optimization_legacy {
 
@@ -71,19 +93,17 @@ void LandmarkCovarianceEstimation::addErrorTerms(
 
 void LandmarkCovarianceEstimation::calculateCovariance(
     ceres::Problem* problem) {
-  ceres::Covariance::Options covariance_options;
-  covariance_options.algorithm_type = ceres::SUITE_SPARSE_QR;
-  covariance_options.num_threads = common::getNumHardwareThreads();
-  covariance_options.min_reciprocal_condition_number = 1e-32;
-  covariance_options.apply_loss_function = true;
-  ceres::Covariance covariance(covariance_options);
-
-  std::vector<std::pair<const double*, const double*> > covariance_blocks;
+  CHECK_NOTNULL(problem);
+  CHECK_GT(FLAGS_cov_estimation_landmark_sampling_ratio, 0.0);
+  CHECK_LE(FLAGS_cov_estimation_landmark_sampling_ratio, 1.0);
 
   pose_graph::VertexIdList all_vertices;
   const_map_.getAllVertexIds(&all_vertices);
 
   vi_map::LandmarkIdSet added_landmarks;
+  vi_map::LandmarkIdList landmarks_to_estimate;
+  size_t num_well_constrained_landmarks = 0u;
+  const double sampling_ratio = FLAGS_cov_estimation_landmark_sampling_ratio;
 
   LOG(INFO) << "Adding covariance blocks";
   for (const pose_graph::VertexId& vertex_id : all_vertices) {
@@ -108,11 +128,17 @@ void LandmarkCovarianceEstimation::calculateCovariance(
               // If not, there must be some inconsistency in choosing the
               // well-constrained landmarks.
               CHECK(problem->HasParameterBlock(landmark.get_p_B_Mutable()));
-              covariance_blocks.push_back(
-                  std::make_pair(
-                      landmark.get_p_B_Mutable(), landmark.get_p_B_Mutable()));
-
               added_landmarks.insert(landmark.id());
+
+              // Take the landmarks at which the sampled count increases.
+              const size_t sampled_count_before = static_cast<size_t>(
+                  num_well_constrained_landmarks * sampling_ratio);
+              ++num_well_constrained_landmarks;
+              if (static_cast<size_t>(
+                      num_well_constrained_landmarks * sampling_ratio) >
+                  sampled_count_before) {
+                landmarks_to_estimate.push_back(landmark.id());
+              }
             } else {
               // Not enough landmarks, let's put something big to covariance
               // diagonal.
@@ -127,11 +153,196 @@ void LandmarkCovarianceEstimation::calculateCovariance(
     }  // Loop over all frames in a vertex.
   }    // Loop over all vertices.
 
-  LOG(INFO) << "Calculating covariance.";
+  LOG(INFO) << "Calculating covariance of " << landmarks_to_estimate.size()
+            << " out of " << num_well_constrained_landmarks
+            << " well-constrained landmarks.";
+  if (landmarks_to_estimate.empty()) {
+    return;
+  }
+  if (FLAGS_cov_estimation_use_schur_complement) {
+    if (calculateCovarianceFromSchurComplement(
+            landmarks_to_estimate, problem)) {
+      return;
+    }
+    LOG(WARNING) << "Recovering the landmark covariances from the Schur "
+                 << "complement failed, falling back to ceres::Covariance.";
+  }
+  calculateCovarianceWithCeres(landmarks_to_estimate, problem);
+}
+
+bool LandmarkCovarianceEstimation::calculateCovarianceFromSchurComplement(
+    const vi_map::LandmarkIdList& landmark_ids, ceres::Problem* problem) {
+  CHECK_NOTNULL(problem);
+  timing::Timer timer("Landmark covariance from Schur complement");
+  typedef Eigen::SparseMatrix<double> SparseMatrix;
+  typedef Eigen::SparseMatrix<double, Eigen::RowMajor> RowMajorSparseMatrix;
+  constexpr int kLandmarkSize = 3;
+
+  // Landmarks only share residuals with non-landmark parameters, hence the
+  // information matrix H = J^T * J = [A B; B^T C] has a block-diagonal C
+  // with one 3x3 block per landmark. With the reduced camera system
+  // S = A - B * C^-1 * B^T, the marginal covariance of landmark i is
+  // C_i^-1 + (B_i * C_i^-1)^T * S^-1 * (B_i * C_i^-1).
+  std::unordered_set<double*> landmark_blocks_in_problem;
+  vi_map::LandmarkIdList all_landmark_ids;
+  const_map_.getAllLandmarkIds(&all_landmark_ids);
+  for (const vi_map::LandmarkId& landmark_id : all_landmark_ids) {
+    double* p_B = map_.getLandmark(landmark_id).get_p_B_Mutable();
+    if (problem->HasParameterBlock(p_B)) {
+      landmark_blocks_in_problem.insert(p_B);
+    }
+  }
+
+  // Order the variable parameter blocks as [non-landmarks, landmarks]. The
+  // constant blocks are left out, which makes Ceres treat them as constant.
+  std::vector<double*> all_parameter_blocks;
+  problem->GetParameterBlocks(&all_parameter_blocks);
+  ceres::Problem::EvaluateOptions evaluate_options;
+  evaluate_options.num_threads = common::getNumHardwareThreads();
+  std::vector<double*> landmark_blocks;
+  int num_camera_parameters = 0;
+  for (double* parameter_block : all_parameter_blocks) {
+    if (problem_information_.isParameterBlockConstant(parameter_block)) {
+      continue;
+    }
+    if (landmark_blocks_in_problem.count(parameter_block) > 0u) {
+      CHECK_EQ(
+          problem->ParameterBlockLocalSize(parameter_block), kLandmarkSize);
+      landmark_blocks.push_back(parameter_block);
+    } else {
+      evaluate_options.parameter_blocks.push_back(parameter_block);
+      num_camera_parameters +=
+          problem->ParameterBlockLocalSize(parameter_block);
+    }
+  }
+  std::unordered_map<const double*, int> landmark_block_to_idx;
+  for (size_t landmark_idx = 0u; landmark_idx < landmark_blocks.size();
+       ++landmark_idx) {
+    landmark_block_to_idx.emplace(
+        landmark_blocks[landmark_idx], static_cast<int>(landmark_idx));
+    evaluate_options.parameter_blocks.push_back(landmark_blocks[landmark_idx]);
+  }
+  std::vector<int> landmark_indices;
+  landmark_indices.reserve(landmark_ids.size());
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+    const std::unordered_map<const double*, int>::const_iterator it =
+        landmark_block_to_idx.find(
+            map_.getLandmark(landmark_id).get_p_B_Mutable());
+    CHECK(it != landmark_block_to_idx.end());
+    landmark_indices.push_back(it->second);
+  }
+
+  ceres::CRSMatrix crs_jacobian;
+  double cost;
+  if (!problem->Evaluate(
+          evaluate_options, &cost, nullptr, nullptr, &crs_jacobian)) {
+    LOG(WARNING) << "Evaluating the Jacobian failed.";
+    return false;
+  }
+  const Eigen::Map<const RowMajorSparseMatrix> J(
+      crs_jacobian.num_rows, crs_jacobian.num_cols,
+      crs_jacobian.values.size(), crs_jacobian.rows.data(),
+      crs_jacobian.cols.data(), crs_jacobian.values.data());
+  const SparseMatrix J_col_major(J);
+  const SparseMatrix H = J_col_major.transpose() * J_col_major;
+  const int num_landmark_parameters = H.cols() - num_camera_parameters;
+  CHECK_EQ(
+      num_landmark_parameters,
+      kLandmarkSize * static_cast<int>(landmark_blocks.size()));
+
+  // Invert the landmark blocks of C.
+  Aligned<std::vector, Eigen::Matrix3d> C_inv_blocks(landmark_blocks.size());
+  std::vector<Eigen::Triplet<double>> C_inv_triplets;
+  C_inv_triplets.reserve(kLandmarkSize * num_landmark_parameters);
+  for (size_t landmark_idx = 0u; landmark_idx < landmark_blocks.size();
+       ++landmark_idx) {
+    const int col_idx =
+        num_camera_parameters + kLandmarkSize * static_cast<int>(landmark_idx);
+    const Eigen::Matrix3d C_i =
+        H.block(col_idx, col_idx, kLandmarkSize, kLandmarkSize).toDense();
+    const Eigen::LLT<Eigen::Matrix3d> C_i_llt(C_i);
+    if (C_i_llt.info() != Eigen::Success) {
+      LOG(WARNING) << "Landmark information block is not positive definite.";
+      return false;
+    }
+    C_inv_blocks[landmark_idx] = C_i_llt.solve(Eigen::Matrix3d::Identity());
+    for (int row = 0; row < kLandmarkSize; ++row) {
+      for (int col = 0; col < kLandmarkSize; ++col) {
+        C_inv_triplets.emplace_back(
+            col_idx - num_camera_parameters + row,
+            col_idx - num_camera_parameters + col,
+            C_inv_blocks[landmark_idx](row, col));
+      }
+    }
+  }
+  SparseMatrix C_inv(num_landmark_parameters, num_landmark_parameters);
+  C_inv.setFromTriplets(C_inv_triplets.begin(), C_inv_triplets.end());
+
+  const SparseMatrix B = H.topRightCorner(
+      num_camera_parameters, num_landmark_parameters);
+  const SparseMatrix B_C_inv = B * C_inv;
+  Eigen::SimplicialLDLT<SparseMatrix> S_ldlt;
+  if (num_camera_parameters > 0) {
+    const SparseMatrix A =
+        H.topLeftCorner(num_camera_parameters, num_camera_parameters);
+    const SparseMatrix S = A - SparseMatrix(B_C_inv * B.transpose());
+    S_ldlt.compute(S);
+    if (S_ldlt.info() != Eigen::Success ||
+        S_ldlt.vectorD().minCoeff() <= 0.0) {
+      LOG(WARNING) << "The reduced camera system is not positive definite.";
+      return false;
+    }
+  }
+
+  // The marginals of the landmarks are independent given the factorization.
+  Aligned<std::vector, Eigen::Matrix3d> covariances(landmark_ids.size());
+  std::function<void(size_t, size_t)> recover_marginals =
+      [&](size_t begin, size_t end) {
+        Eigen::MatrixXd B_C_inv_i;
+        for (size_t i = begin; i < end; ++i) {
+          const int landmark_idx = landmark_indices[i];
+          covariances[i] = C_inv_blocks[landmark_idx];
+          if (num_camera_parameters > 0) {
+            B_C_inv_i = B_C_inv
+                            .middleCols(
+                                kLandmarkSize * landmark_idx, kLandmarkSize)
+                            .toDense();
+            covariances[i].noalias() +=
+                B_C_inv_i.transpose() * S_ldlt.solve(B_C_inv_i);
+          }
+        }
+      };
+  common::ParallelProcessDynamic(
+      landmark_ids.size(), recover_marginals, common::getNumHardwareThreads());
+
+  LOG(INFO) << "Storing covariance in landmark objects.";
+  for (size_t i = 0u; i < landmark_ids.size(); ++i) {
+    map_.getLandmark(landmark_ids[i]).set_p_B_Covariance(covariances[i]);
+  }
+  return true;
+}
+
+void LandmarkCovarianceEstimation::calculateCovarianceWithCeres(
+    const vi_map::LandmarkIdList& landmark_ids, ceres::Problem* problem) {
+  CHECK_NOTNULL(problem);
+  ceres::Covariance::Options covariance_options;
+  covariance_options.algorithm_type = ceres::SUITE_SPARSE_QR;
+  covariance_options.num_threads = common::getNumHardwareThreads();
+  covariance_options.min_reciprocal_condition_number = 1e-32;
+  covariance_options.apply_loss_function = true;
+  ceres::Covariance covariance(covariance_options);
+
+  std::vector<std::pair<const double*, const double*> > covariance_blocks;
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+    vi_map::Landmark& landmark = map_.getLandmark(landmark_id);
+    covariance_blocks.push_back(
+        std::make_pair(landmark.get_p_B_Mutable(), landmark.get_p_B_Mutable()));
+  }
+
   CHECK(covariance.Compute(covariance_blocks, problem));
 
   LOG(INFO) << "Storing covariance in landmark objects.";
-  for (const vi_map::LandmarkId& landmark_id : added_landmarks) {
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
     vi_map::Landmark& landmark = map_.getLandmark(landmark_id);
     Eigen::Matrix<double, 3, 3, Eigen::RowMajor> position_covariance;
 
@@ -0,0 +1,114 @@
+#include <algorithm>
+
+#include <Eigen/Core>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+#include <vi-map/vi-map.h>
+
+#include "map-optimization-legacy/landmark-covariance-estimation.h"
+#include "map-optimization-legacy/test/6dof-vi-map-gen.h"
+
+DECLARE_bool(cov_estimation_use_schur_complement);
+DECLARE_double(cov_estimation_landmark_sampling_ratio);
+
+namespace map_optimization_legacy {
+
+class LandmarkCovarianceTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    vimap_gen_.generateVIMap();
+    vi_map::VIMap& map = vimap_gen_.vi_map_;
+    fixed_vertices_.insert(
+        map.getMission(map.getIdOfFirstMission()).getRootVertexId());
+    map.getAllLandmarkIds(&landmark_ids_);
+
+    // Mark the covariances that are not estimated.
+    for (const vi_map::LandmarkId& landmark_id : landmark_ids_) {
+      map.getLandmark(landmark_id)
+          .set_p_B_Covariance(-Eigen::Matrix3d::Identity());
+    }
+  }
+
+  virtual void TearDown() {
+    FLAGS_cov_estimation_use_schur_complement = true;
+    FLAGS_cov_estimation_landmark_sampling_ratio = 1.0;
+  }
+
+  void estimateCovariances(vi_map::VIMap* map) {
+    LandmarkCovarianceEstimation estimation(CHECK_NOTNULL(map));
+    estimation.assignCovarianceToLandmarks(fixed_vertices_);
+  }
+
+  SixDofVIMapGenerator vimap_gen_;
+  pose_graph::VertexIdSet fixed_vertices_;
+  vi_map::LandmarkIdList landmark_ids_;
+};
+
+TEST_F(LandmarkCovarianceTest, SchurComplementMatchesCeresCovariance) {
+  vi_map::VIMap& schur_map = vimap_gen_.vi_map_;
+  vi_map::VIMap ceres_map;
+  ceres_map.deepCopy(schur_map);
+
+  FLAGS_cov_estimation_use_schur_complement = false;
+  estimateCovariances(&ceres_map);
+  FLAGS_cov_estimation_use_schur_complement = true;
+  estimateCovariances(&schur_map);
+
+  size_t num_estimated_covariances = 0u;
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids_) {
+    Eigen::Matrix3d ceres_covariance;
+    Eigen::Matrix3d schur_covariance;
+    ASSERT_TRUE(
+        ceres_map.getLandmark(landmark_id)
+            .get_p_B_Covariance(&ceres_covariance));
+    ASSERT_TRUE(
+        schur_map.getLandmark(landmark_id)
+            .get_p_B_Covariance(&schur_covariance));
+    const double tolerance = 1e-4 * std::max(1.0, ceres_covariance.norm());
+    EXPECT_NEAR_EIGEN(schur_covariance, ceres_covariance, tolerance);
+    if (ceres_covariance(0, 0) > 0.0) {
+      ++num_estimated_covariances;
+    }
+  }
+  EXPECT_GT(num_estimated_covariances, 0u);
+}
+
+TEST_F(LandmarkCovarianceTest, SampledLandmarksAreSubset) {
+  vi_map::VIMap& sampled_map = vimap_gen_.vi_map_;
+  vi_map::VIMap full_map;
+  full_map.deepCopy(sampled_map);
+
+  estimateCovariances(&full_map);
+  FLAGS_cov_estimation_landmark_sampling_ratio = 0.5;
+  estimateCovariances(&sampled_map);
+
+  const Eigen::Matrix3d kNotEstimated = -Eigen::Matrix3d::Identity();
+  size_t num_full = 0u;
+  size_t num_sampled = 0u;
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids_) {
+    Eigen::Matrix3d full_covariance;
+    Eigen::Matrix3d sampled_covariance;
+    ASSERT_TRUE(
+        full_map.getLandmark(landmark_id).get_p_B_Covariance(&full_covariance));
+    ASSERT_TRUE(
+        sampled_map.getLandmark(landmark_id)
+            .get_p_B_Covariance(&sampled_covariance));
+    if (full_covariance != kNotEstimated) {
+      ++num_full;
+    }
+    if (sampled_covariance != kNotEstimated) {
+      ++num_sampled;
+      // The marginals do not depend on which other landmarks are recovered.
+      EXPECT_NEAR_EIGEN(sampled_covariance, full_covariance, 1e-12);
+    }
+  }
+  EXPECT_GT(num_sampled, 0u);
+  EXPECT_LT(num_sampled, num_full);
+}
+
+}  // namespace map_optimization_legacy
+
+MAPLAB_UNITTEST_ENTRYPOINT
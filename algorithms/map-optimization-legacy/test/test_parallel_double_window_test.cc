@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/memory.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+#include <vi-map/vi-map.h>
+
+#include "map-optimization-legacy/double-window.h"
+#include "map-optimization-legacy/graph-ba-optimizer.h"
+#include "map-optimization-legacy/test/6dof-vi-map-gen.h"
+
+namespace map_optimization_legacy {
+
+// Double window over a consecutive range of the vertices of a mission. Only
+// landmarks that are exclusively observed from within the window are part of
+// the window, such that windows far apart from each other are independent.
+class ConsecutiveVertexDoubleWindow : public DoubleWindow {
+ public:
+  ConsecutiveVertexDoubleWindow(
+      const vi_map::VIMap& map, const pose_graph::VertexIdList& vertices,
+      const size_t inner_begin, const size_t inner_end,
+      const size_t num_outer_vertices) {
+    CHECK_LT(inner_begin, inner_end);
+    CHECK_LE(inner_end, vertices.size());
+    const size_t outer_begin =
+        inner_begin - std::min(inner_begin, num_outer_vertices);
+    const size_t outer_end =
+        std::min(vertices.size(), inner_end + num_outer_vertices);
+    for (size_t idx = outer_begin; idx < outer_end; ++idx) {
+      if (idx >= inner_begin && idx < inner_end) {
+        vertices_inner_window_.insert(vertices[idx]);
+        inner_window_positions_.push_back(map.getVertex_G_p_I(vertices[idx]));
+      } else {
+        vertices_outer_window_.insert(vertices[idx]);
+      }
+    }
+
+    for (size_t idx = outer_begin; idx + 1u < outer_end; ++idx) {
+      pose_graph::EdgeIdSet outgoing_edges;
+      map.getVertex(vertices[idx]).getOutgoingEdges(&outgoing_edges);
+      for (const pose_graph::EdgeId& edge_id : outgoing_edges) {
+        const vi_map::Edge& edge = map.getEdgeAs<vi_map::Edge>(edge_id);
+        if (vertices_inner_window_.count(edge.from()) > 0u &&
+            vertices_inner_window_.count(edge.to()) > 0u) {
+          edges_inner_window_.push_back(edge_id);
+        } else if (isVertexInDoubleWindow(edge.to())) {
+          edges_outer_window_.push_back(edge_id);
+        }
+      }
+    }
+
+    for (const pose_graph::VertexId& vertex_id : vertices_inner_window_) {
+      vi_map::LandmarkIdList landmark_ids;
+      map.getVertex(vertex_id).getAllObservedLandmarkIds(&landmark_ids);
+      for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+        if (!landmark_id.isValid() || !map.hasLandmark(landmark_id)) {
+          continue;
+        }
+        bool observed_only_from_window = isVertexInDoubleWindow(
+            map.getLandmarkStoreVertexId(landmark_id));
+        for (const vi_map::KeypointIdentifier& observation :
+             map.getLandmark(landmark_id).getObservations()) {
+          observed_only_from_window &=
+              isVertexInDoubleWindow(observation.frame_id.vertex_id);
+        }
+        if (observed_only_from_window) {
+          landmarks_seen_from_inner_window.insert(landmark_id);
+        }
+      }
+    }
+  }
+
+  double getSquaredDistanceToInnerWindow(
+      const Eigen::Vector3d& p_G) const override {
+    double min_squared_distance = std::numeric_limits<double>::max();
+    for (const Eigen::Vector3d& p_G_inner : inner_window_positions_) {
+      min_squared_distance =
+          std::min(min_squared_distance, (p_G - p_G_inner).squaredNorm());
+    }
+    return min_squared_distance;
+  }
+
+ private:
+  Aligned<std::vector, Eigen::Vector3d> inner_window_positions_;
+};
+
+class ParallelDoubleWindowTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    vimap_gen_.generateVIMap();
+    vi_map::VIMap& map = vimap_gen_.vi_map_;
+    map.getAllVertexIdsInMissionAlongGraph(
+        map.getIdOfFirstMission(), &vertices_);
+    ASSERT_EQ(vertices_.size(), 20u);
+  }
+
+  // Two windows far apart and one overlapping the first one.
+  void createDoubleWindows(
+      const vi_map::VIMap& map, DoubleWindow::PtrVector* double_windows) {
+    CHECK_NOTNULL(double_windows)->clear();
+    constexpr size_t kNumOuterVertices = 2u;
+    double_windows->emplace_back(new ConsecutiveVertexDoubleWindow(
+        map, vertices_, 2u, 6u, kNumOuterVertices));
+    double_windows->emplace_back(new ConsecutiveVertexDoubleWindow(
+        map, vertices_, 13u, 17u, kNumOuterVertices));
+    double_windows->emplace_back(new ConsecutiveVertexDoubleWindow(
+        map, vertices_, 4u, 8u, kNumOuterVertices));
+  }
+
+  void corruptVertexPositions(vi_map::VIMap* map) {
+    CHECK_NOTNULL(map);
+    for (size_t idx = 0u; idx < vertices_.size(); ++idx) {
+      const double offset = 0.02 * static_cast<double>(idx % 5u);
+      Eigen::Map<Eigen::Vector3d> p_M_I(
+          map->getVertex(vertices_[idx]).get_p_M_I_Mutable());
+      p_M_I += Eigen::Vector3d(offset, -offset, 0.5 * offset);
+    }
+  }
+
+  SixDofVIMapGenerator vimap_gen_;
+  pose_graph::VertexIdList vertices_;
+};
+
+TEST_F(ParallelDoubleWindowTest, ParallelMatchesSequentialOptimization) {
+  vi_map::VIMap& parallel_map = vimap_gen_.vi_map_;
+  corruptVertexPositions(&parallel_map);
+  vi_map::VIMap sequential_map;
+  sequential_map.deepCopy(parallel_map);
+
+  constexpr int kNumIterations = 10;
+  DoubleWindow::PtrVector sequential_windows;
+  createDoubleWindows(sequential_map, &sequential_windows);
+  for (const DoubleWindow::Ptr& double_window : sequential_windows) {
+    GraphBaOptimizer optimizer(&sequential_map);
+    optimizer.doubleWindowBaOptimization(*double_window, kNumIterations);
+  }
+
+  DoubleWindow::PtrVector parallel_windows;
+  createDoubleWindows(parallel_map, &parallel_windows);
+  constexpr size_t kNumThreads = 3u;
+  GraphBaOptimizer optimizer(&parallel_map);
+  optimizer.doubleWindowBaOptimization(
+      parallel_windows, kNumIterations, kNumThreads);
+
+  for (const pose_graph::VertexId& vertex_id : vertices_) {
+    const vi_map::Vertex& sequential_vertex =
+        sequential_map.getVertex(vertex_id);
+    const vi_map::Vertex& parallel_vertex = parallel_map.getVertex(vertex_id);
+    EXPECT_NEAR_EIGEN(
+        sequential_vertex.get_p_M_I(), parallel_vertex.get_p_M_I(), 1e-4);
+    EXPECT_NEAR_EIGEN_QUATERNION(
+        sequential_vertex.get_q_M_I(), parallel_vertex.get_q_M_I(), 1e-4);
+    EXPECT_NEAR_EIGEN(
+        sequential_vertex.get_v_M(), parallel_vertex.get_v_M(), 1e-4);
+  }
+
+  vi_map::LandmarkIdList landmark_ids;
+  parallel_map.getAllLandmarkIds(&landmark_ids);
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+    EXPECT_NEAR_EIGEN(
+        sequential_map.getLandmark(landmark_id).get_p_B(),
+        parallel_map.getLandmark(landmark_id).get_p_B(), 1e-4);
+  }
+}
+
+}  // namespace map_optimization_legacy
+
+MAPLAB_UNITTEST_ENTRYPOINT
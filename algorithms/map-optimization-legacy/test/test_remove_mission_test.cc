@@ -135,6 +135,21 @@ TEST_F(RemoveMissionTest, MapConsistencyTestWithMergedLandmarkObservations) {
   EXPECT_EQ(map_.numMissions(), 1u);
 }
 
+TEST_F(RemoveMissionTest, RemoveAllMissionsLeavesEmptyMap) {
+  addCrossMissionObservations();
+  ASSERT_TRUE(checkMapConsistency(map_));
+  vi_map::MissionIdList mission_ids;
+  map_.getAllMissionIds(&mission_ids);
+  ASSERT_EQ(2u, mission_ids.size());
+  map_.removeMission(mission_ids[0], true);
+  EXPECT_TRUE(checkMapConsistency(map_));
+  map_.removeMission(mission_ids[1], true);
+  EXPECT_EQ(0u, map_.numMissions());
+  EXPECT_EQ(0u, map_.numVertices());
+  EXPECT_EQ(0u, map_.numEdges());
+  EXPECT_EQ(0u, map_.numLandmarksInIndex());
+}
+
 }  // namespace map_optimization_legacy
 
 MAPLAB_UNITTEST_ENTRYPOINT
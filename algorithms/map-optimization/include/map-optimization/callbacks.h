@@ -1,12 +1,15 @@
 #ifndef MAP_OPTIMIZATION_CALLBACKS_H_
 #define MAP_OPTIMIZATION_CALLBACKS_H_
 
+#include <cstddef>
 #include <memory>
 #include <vector>
 
 #include <ceres-error-terms/ceres-signal-handler.h>
+#include <ceres-error-terms/problem-information.h>
 #include <ceres/iteration_callback.h>
 #include <map-optimization/optimization-state-buffer.h>
+#include <maplab-common/file-logger.h>
 #include <visualization/viwls-graph-plotter.h>
 
 namespace map_optimization {
@@ -75,6 +78,37 @@ class VisualizationCallback : public ceres::IterationCallback {
   size_t iteration_;
 };
 
+// Records where the time of every solver iteration goes, such that solver
+// configurations can be compared. Ceres only reports the total time of an
+// iteration and the time of its linear solve, the remainder is attributed to
+// the evaluation of the residuals and Jacobians (including the line search
+// and the step evaluation). Every iteration is written as one CSV line to the
+// logger, if given, and recorded as trace events while tracing is recording.
+// Several solves can share one logger, they are told apart by the solve
+// index.
+class ProfilingCallback : public ceres::IterationCallback {
+ public:
+  ProfilingCallback(
+      const ceres_error_terms::ProblemInformation& problem_information,
+      size_t solve_index, const std::shared_ptr<common::FileLogger>& logger);
+
+  ceres::CallbackReturnType operator()(const ceres::IterationSummary& summary);
+
+  // Writes the header of the CSV lines.
+  static void writeCsvHeader(common::FileLogger* logger);
+
+ private:
+  size_t getNumActiveResidualBlocks() const;
+
+  const ceres_error_terms::ProblemInformation& problem_information_;
+  const size_t solve_index_;
+  const std::shared_ptr<common::FileLogger> logger_;
+
+  // Count iterations locally as outlier rejection optimization is restarting
+  // the ceres solver multiple times and zeroing the iteration count.
+  size_t iteration_;
+};
+
 inline void appendSignalHandlerCallback(
     std::vector<std::shared_ptr<ceres::IterationCallback>>* callbacks) {
   CHECK_NOTNULL(callbacks);
@@ -98,6 +132,15 @@ inline void appendVisualizationCallbacks(
   }
 }
 
+inline void appendProfilingCallback(
+    const ceres_error_terms::ProblemInformation& problem_information,
+    size_t solve_index, const std::shared_ptr<common::FileLogger>& logger,
+    std::vector<std::shared_ptr<ceres::IterationCallback>>* callbacks) {
+  CHECK_NOTNULL(callbacks);
+  callbacks->emplace_back(
+      new ProfilingCallback(problem_information, solve_index, logger));
+}
+
 }  // namespace map_optimization
 
 #endif  // MAP_OPTIMIZATION_CALLBACKS_H_
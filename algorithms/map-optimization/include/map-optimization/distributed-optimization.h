@@ -0,0 +1,51 @@
+#ifndef MAP_OPTIMIZATION_DISTRIBUTED_OPTIMIZATION_H_
+#define MAP_OPTIMIZATION_DISTRIBUTED_OPTIMIZATION_H_
+
+#include <functional>
+
+#include <map-optimization/outlier-rejection-solver.h>
+#include <map-optimization/vi-optimization-builder.h>
+#include <maplab-common/network-common.h>
+#include <vi-map/unique-id.h>
+
+namespace vi_map {
+class VIMap;
+}  // namespace vi_map
+
+namespace map_optimization {
+
+// Solves the problem of one mission cluster. The request holds the map slice
+// of the cluster serialized with vi_map::serialization::serializeToRawArray,
+// the response has to hold the optimized slice in the same format. The worker
+// allocates the response data with new uint8_t[], which is released by the
+// caller. Returns false if the cluster could not be optimized.
+//
+// The transport is up to the worker, e.g. it can send the request to another
+// node and block until the response arrives.
+typedef std::function<bool(
+    const network::RawMessageDataList& request,
+    network::RawMessageDataList* response)>
+    ClusterOptimizationWorker;
+
+// Returns a worker that optimizes the clusters in this process with
+// VIMapOptimizer::optimizeVisualInertial. This is also what a worker node
+// runs on the requests it receives. outlier_rejection_options is optional.
+ClusterOptimizationWorker createLocalClusterOptimizationWorker(
+    const ViProblemOptions& options,
+    const OutlierRejectionSolverOptions* outlier_rejection_options);
+
+// Splits the missions into clusters of missions that share landmarks, which
+// are independent problems, and optimizes each cluster with the worker. Up to
+// num_parallel_jobs clusters are in flight at the same time and each holds a
+// copy of its map slice in memory. The keyframe states, landmarks and
+// baseframes of the optimized slices are merged back into the map; the
+// sensor calibrations are left untouched. Returns false if any cluster
+// failed, the other clusters are merged nonetheless.
+bool optimizeMissionClustersDistributed(
+    const vi_map::MissionIdSet& missions_to_optimize,
+    const ClusterOptimizationWorker& worker, const size_t num_parallel_jobs,
+    vi_map::VIMap* map);
+
+}  // namespace map_optimization
+
+#endif  // MAP_OPTIMIZATION_DISTRIBUTED_OPTIMIZATION_H_
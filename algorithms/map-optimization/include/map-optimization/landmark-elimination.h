@@ -0,0 +1,34 @@
+#ifndef MAP_OPTIMIZATION_LANDMARK_ELIMINATION_H_
+#define MAP_OPTIMIZATION_LANDMARK_ELIMINATION_H_
+
+#include "map-optimization/optimization-problem.h"
+
+namespace map_optimization {
+
+// Eliminates the landmarks of the visual terms into relative pose constraints
+// between keyframes, linearized at the current state of the map. Every
+// landmark is expressed in the frame of its store vertex, hence it constrains
+// the relative pose of the store vertex and each of its other observers. For
+// every such pair, the landmarks they share are Schur-eliminated from the
+// linearized reprojection errors of the pair, which leaves the information of
+// their relative pose. This is a pairwise approximation of the reduced camera
+// system of a full bundle adjustment, which is accurate close to the
+// linearization point, e.g. after a full visual-inertial optimization.
+//
+// Only pairs within the same mission that share at least
+// min_num_common_landmarks landmarks are constrained. The landmarks
+// themselves are not part of the problem, use
+// addLandmarkBackSubstitutionTerms() to update them afterwards. Returns the
+// number of constraints added.
+int addLandmarkEliminatedPoseTerms(
+    const size_t min_num_common_landmarks, OptimizationProblem* problem);
+
+// Adds the visual terms of all landmarks stored in the missions of the problem
+// with fixed keyframe poses and camera calibrations, such that solving the
+// problem re-estimates each landmark from its observations independently.
+// This is the back-substitution step after solving a problem built with
+// addLandmarkEliminatedPoseTerms().
+void addLandmarkBackSubstitutionTerms(OptimizationProblem* problem);
+
+}  // namespace map_optimization
+#endif  // MAP_OPTIMIZATION_LANDMARK_ELIMINATION_H_
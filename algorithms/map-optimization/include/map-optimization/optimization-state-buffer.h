@@ -13,20 +13,41 @@ namespace map_optimization {
 // Buffer for all states that can not be optimized directly on the map. For
 // example the rotation of the keyframe pose is stored in a different
 // convention than the optimization expects, hence, it is buffered here.
+// The keyframe states are stored as a structure of arrays indexed by a dense
+// vertex index, which follows the order of the vertices along the graph of
+// each mission. Importing and exporting the states hence walks all arrays
+// linearly and only needs a single vertex lookup per keyframe. The index of a
+// vertex can be looked up once with getVertexIndex() and then be used for all
+// of its states, including the baseframe of its mission, without any further
+// hash lookups.
 class OptimizationStateBuffer {
  public:
   void importStatesOfMissions(
       const vi_map::VIMap& map, const vi_map::MissionIdSet& mission_ids);
   void copyAllStatesBackToMap(vi_map::VIMap* map) const;
+  // Only copies the pose, velocity and biases of the given vertices.
+  void copyKeyframeStatesBackToMap(
+      const pose_graph::VertexIdSet& vertex_ids, vi_map::VIMap* map) const;
+
+  size_t getVertexIndex(const pose_graph::VertexId& id) const;
 
   double* get_vertex_q_IM__M_p_MI_JPL(const pose_graph::VertexId& id);
+  double* get_vertex_v_M(const pose_graph::VertexId& id);
+  double* get_vertex_gyro_bias(const pose_graph::VertexId& id);
+  double* get_vertex_accel_bias(const pose_graph::VertexId& id);
+  double* get_vertex_q_IM__M_p_MI_JPL(const size_t vertex_idx);
+  double* get_vertex_v_M(const size_t vertex_idx);
+  double* get_vertex_gyro_bias(const size_t vertex_idx);
+  double* get_vertex_accel_bias(const size_t vertex_idx);
+  // Baseframe of the mission of the vertex.
+  double* get_vertex_baseframe_q_GM__G_p_GM_JPL(const size_t vertex_idx);
   double* get_baseframe_q_GM__G_p_GM_JPL(const vi_map::MissionBaseFrameId& id);
   double* get_camera_extrinsics_q_CI__C_p_CI_JPL(const aslam::CameraId& id);
   double* get_sensor_extrinsics_q_RS_JPL(const vi_map::SensorId& id);
   double* get_sensor_extrinsics_R_p_RS(const vi_map::SensorId& id);
 
  private:
-  void importKeyframePosesOfMissions(
+  void importKeyframeStatesOfMissions(
       const vi_map::VIMap& map, const vi_map::MissionIdSet& mission_ids);
   void importBaseframePoseOfMissions(
       const vi_map::VIMap& map, const vi_map::MissionIdSet& mission_ids);
@@ -34,14 +55,23 @@ class OptimizationStateBuffer {
       const vi_map::VIMap& map, const vi_map::MissionIdSet& mission_ids);
   void importCameraCalibrationsOfMissions(
       const vi_map::VIMap& map, const vi_map::MissionIdSet& mission_ids);
-  void copyAllKeyframePosesBackToMap(vi_map::VIMap* map) const;
+  void copyAllKeyframeStatesBackToMap(vi_map::VIMap* map) const;
+  void copyKeyframeStateBackToMap(
+      const size_t vertex_idx, vi_map::VIMap* map) const;
   void copyAllBaseframePosesBackToMap(vi_map::VIMap* map) const;
   void copyAllSensorCalibrationsBackToMap(vi_map::VIMap* map) const;
   void copyAllCameraCalibrationsBackToMap(vi_map::VIMap* map) const;
 
   // Keyframe poses as a 7d vector: [q_IM_xyzw, M_p_MI]  (passive JPL).
   std::unordered_map<pose_graph::VertexId, size_t> vertex_id_to_vertex_idx_;
+  pose_graph::VertexIdList vertex_idx_to_vertex_id_;
   Eigen::Matrix<double, 7, Eigen::Dynamic> vertex_q_IM__M_p_MI_;
+  // Keyframe velocities and IMU biases, in the same order as the poses.
+  Eigen::Matrix<double, 3, Eigen::Dynamic> vertex_v_M_;
+  Eigen::Matrix<double, 3, Eigen::Dynamic> vertex_gyro_bias_;
+  Eigen::Matrix<double, 3, Eigen::Dynamic> vertex_accel_bias_;
+  // Column of the baseframe of the mission of every vertex.
+  std::vector<size_t> vertex_idx_to_baseframe_idx_;
 
   // Mission baseframe poses as a 7d vector: [q_IM_xyzw, M_p_MI] (passive JPL).
   std::unordered_map<vi_map::MissionBaseFrameId, size_t>
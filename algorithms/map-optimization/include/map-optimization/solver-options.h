@@ -2,6 +2,7 @@
 #define MAP_OPTIMIZATION_SOLVER_OPTIONS_H_
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <ceres/ceres.h>
@@ -10,9 +11,16 @@
 DECLARE_int32(ba_num_iterations);
 DECLARE_bool(ba_use_cgnr_linear_solver);
 DECLARE_bool(ba_use_jacobi_scaling);
+DECLARE_string(ba_linear_solver);
 
 namespace map_optimization {
 
+// True if the linear solver should be picked per problem, see
+// selectLinearSolverForProblem() in solver.h.
+inline bool isAutomaticLinearSolverSelectionEnabled() {
+  return !FLAGS_ba_use_cgnr_linear_solver && FLAGS_ba_linear_solver == "auto";
+}
+
 inline ceres::Solver::Options initSolverOptionsFromFlags() {
   ceres::Solver::Options options;
   options.minimizer_progress_to_stdout = true;
@@ -20,8 +28,9 @@ inline ceres::Solver::Options initSolverOptionsFromFlags() {
   options.function_tolerance = 1e-12;
   options.gradient_tolerance = 1e-10;
   options.parameter_tolerance = 1e-8;
-  options.num_threads = common::getNumHardwareThreads();
-  options.num_linear_solver_threads = common::getNumHardwareThreads();
+  options.num_threads = common::getNumThreadsForSubsystem(
+      common::ThreadingSubsystem::kOptimization);
+  options.num_linear_solver_threads = options.num_threads;
   options.jacobi_scaling = FLAGS_ba_use_jacobi_scaling;
   options.initial_trust_region_radius = 1e5;
   options.max_trust_region_radius = 1e20;
@@ -29,8 +38,14 @@ inline ceres::Solver::Options initSolverOptionsFromFlags() {
   options.trust_region_strategy_type = ceres::LEVENBERG_MARQUARDT;
   if (FLAGS_ba_use_cgnr_linear_solver) {
     options.linear_solver_type = ceres::CGNR;
-  } else {
+  } else if (isAutomaticLinearSolverSelectionEnabled()) {
+    // Replaced once the problem is known.
     options.linear_solver_type = ceres::SPARSE_NORMAL_CHOLESKY;
+  } else {
+    CHECK(
+        ceres::StringToLinearSolverType(
+            FLAGS_ba_linear_solver, &options.linear_solver_type))
+        << "Unknown linear solver: " << FLAGS_ba_linear_solver;
   }
 
   options.sparse_linear_algebra_library_type = ceres::SUITE_SPARSE;
@@ -5,6 +5,28 @@
 
 namespace map_optimization {
 
+// Picks the linear solver for the given ceres problem that was built from the
+// optimization problem. Problems without landmarks use a sparse Cholesky
+// factorization. All other problems eliminate the landmarks first using a
+// Schur complement solver. The reduced camera system is factorized densely
+// if it is small or mostly filled, sparsely up to a medium size, and solved
+// iteratively with a Schur-Jacobi preconditioner beyond that. Approximate
+// choices for visual-inertial maps with 15 states per keyframe:
+//
+//   map                          keyframes  landmarks   linear solver
+//   pose graph / inertial only   any        0           SPARSE_NORMAL_CHOLESKY
+//   single session, short        <= 130     any         DENSE_SCHUR
+//   single session, long         <= 13000   any         SPARSE_SCHUR
+//   large multi-session          > 13000    any         ITERATIVE_SCHUR
+//
+// A reduced camera system that is filled to at least a quarter is factorized
+// densely for up to twice as many keyframes, e.g. for short sessions in which
+// every keyframe sees most of the landmarks.
+void selectLinearSolverForProblem(
+    const ceres::Problem& problem,
+    map_optimization::OptimizationProblem* optimization_problem,
+    ceres::Solver::Options* solver_options);
+
 ceres::TerminationType solve(
     const ceres::Solver::Options& solver_options,
     map_optimization::OptimizationProblem* optimization_problem);
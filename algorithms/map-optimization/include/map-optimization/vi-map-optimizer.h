@@ -1,11 +1,16 @@
 #ifndef MAP_OPTIMIZATION_VI_MAP_OPTIMIZER_H_
 #define MAP_OPTIMIZATION_VI_MAP_OPTIMIZER_H_
 
+#include <atomic>
+#include <memory>
 #include <string>
 
 #include <ceres/ceres.h>
+#include <map-optimization/optimization-problem.h>
 #include <map-optimization/outlier-rejection-solver.h>
 #include <map-optimization/vi-optimization-builder.h>
+#include <maplab-common/file-logger.h>
+#include <posegraph/unique-id.h>
 #include <vi-map/unique-id.h>
 
 namespace visualization {
@@ -39,9 +44,53 @@ class VIMapOptimizer {
           outlier_rejection_options,
       vi_map::VIMap* map);
 
+  // Only optimizes the neighborhood of the seed vertices, e.g. the vertices
+  // of a loop closure or newly appended vertices, and keeps the rest of the
+  // map fixed. See constructLocalViProblem.
+  bool optimizeVisualInertialLocally(
+      const map_optimization::ViProblemOptions& options,
+      const pose_graph::VertexIdSet& seed_vertex_ids, const int num_hops,
+      const map_optimization::OutlierRejectionSolverOptions* const
+          outlier_rejection_options,
+      vi_map::VIMap* map);
+
+  // Optimizes the keyframes of the missions with the landmarks eliminated into
+  // relative pose constraints, which is much cheaper than
+  // optimizeVisualInertial() but only accurate close to the current state of
+  // the map, e.g. for re-optimizations. Afterwards the landmarks are
+  // re-estimated from the optimized keyframes, unless they are fixed. See
+  // constructReducedViProblem.
+  bool optimizeVisualInertialReduced(
+      const map_optimization::ViProblemOptions& options,
+      const vi_map::MissionIdSet& missions_to_optimize, vi_map::VIMap* map);
+
+  // Splits the vertices of the missions into partitions of co-observing
+  // vertices with METIS and optimizes each partition on its own, in parallel,
+  // with its neighbors held fixed. Then the neighborhood of the separators
+  // between the partitions is optimized to align them, and optionally the
+  // full problem as refinement. Only the problems of the partitions solved at
+  // the same time are held in memory.
+  bool optimizeVisualInertialHierarchically(
+      const map_optimization::ViProblemOptions& options,
+      const vi_map::MissionIdSet& missions_to_optimize,
+      const unsigned int num_partitions,
+      const map_optimization::OutlierRejectionSolverOptions* const
+          outlier_rejection_options,
+      vi_map::VIMap* map);
+
  private:
+  void solveProblem(
+      const ceres::Solver::Options& solver_options,
+      const map_optimization::OutlierRejectionSolverOptions* const
+          outlier_rejection_options,
+      map_optimization::OptimizationProblem* optimization_problem);
+
   visualization::ViwlsGraphRvizPlotter* plotter_;
   bool signal_handler_enabled_;
+
+  // Per-iteration profile of all solves, nullptr if disabled.
+  std::shared_ptr<common::FileLogger> profiling_logger_;
+  std::atomic<size_t> num_solves_;
 };
 
 }  // namespace map_optimization
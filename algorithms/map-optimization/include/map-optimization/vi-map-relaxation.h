@@ -28,6 +28,12 @@ class VIMapRelaxation {
       const ceres::Solver::Options& solver_options,
       const vi_map::MissionIdList& mission_id_list, vi_map::VIMap* map);
 
+  // Relaxes every mission on its own with the loop closures within the
+  // mission. The missions are solved in parallel and share the thread budget
+  // of the solver. Returns false if no mission has a loop closure.
+  bool relaxMissionsIndependently(
+      const vi_map::MissionIdList& mission_id_list, vi_map::VIMap* map);
+
  private:
   void detectLoopclosures(vi_map::MissionIdSet mission_ids, vi_map::VIMap* map);
 
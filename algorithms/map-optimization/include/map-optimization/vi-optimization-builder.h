@@ -46,5 +46,39 @@ OptimizationProblem* constructViProblem(
     const vi_map::MissionIdSet& mission_ids, const ViProblemOptions& options,
     vi_map::VIMap* map);
 
+// Caller takes ownership. Builds a problem that only optimizes the vertices
+// within num_hops co-visibility hops of the seed vertices, i.e. vertices that
+// observe a common landmark, and the landmarks these vertices observe. All
+// other vertices that observe or store these landmarks or are connected to
+// the window by an inertial edge are added as fixed boundary, which also fixes
+// the gauge of the window.
+OptimizationProblem* constructLocalViProblem(
+    const pose_graph::VertexIdSet& seed_vertex_ids, const int num_hops,
+    const ViProblemOptions& options, vi_map::VIMap* map);
+
+// Caller takes ownership. Builds a problem that only optimizes the vertices
+// of the partition and the landmarks stored in them. Landmarks stored outside
+// of the partition are left out entirely, so problems of disjoint partitions
+// never share a landmark. As above, all other vertices connected to the
+// partition are added as fixed boundary.
+OptimizationProblem* constructPartitionViProblem(
+    const pose_graph::VertexIdSet& partition_vertex_ids,
+    const ViProblemOptions& options, vi_map::VIMap* map);
+
+// Caller takes ownership. Builds a pose-only problem in which the landmarks
+// are eliminated into relative pose constraints between the keyframes, see
+// addLandmarkEliminatedPoseTerms(). It is linearized at the current state of
+// the map, hence it is a cheap alternative to constructViProblem() for
+// re-optimizations after a full visual-inertial optimization. The landmarks
+// are updated afterwards with constructLandmarkBackSubstitutionProblem().
+OptimizationProblem* constructReducedViProblem(
+    const vi_map::MissionIdSet& mission_ids, const ViProblemOptions& options,
+    vi_map::VIMap* map);
+
+// Caller takes ownership. Builds a problem that only optimizes the landmarks
+// stored in the missions with all keyframes and calibrations fixed.
+OptimizationProblem* constructLandmarkBackSubstitutionProblem(
+    const vi_map::MissionIdSet& mission_ids, vi_map::VIMap* map);
+
 }  // namespace map_optimization
 #endif  // MAP_OPTIMIZATION_VI_OPTIMIZATION_BUILDER_H_
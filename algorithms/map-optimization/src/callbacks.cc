@@ -0,0 +1,90 @@
+#include "map-optimization/callbacks.h"
+
+#include <cstdint>
+#include <sstream>
+
+#include <maplab-common/tracing.h>
+
+namespace map_optimization {
+
+ProfilingCallback::ProfilingCallback(
+    const ceres_error_terms::ProblemInformation& problem_information,
+    size_t solve_index, const std::shared_ptr<common::FileLogger>& logger)
+    : problem_information_(problem_information),
+      solve_index_(solve_index),
+      logger_(logger),
+      iteration_(0u) {}
+
+void ProfilingCallback::writeCsvHeader(common::FileLogger* logger) {
+  CHECK_NOTNULL(logger);
+  *logger << "solve,iteration,wall_time_s,evaluation_time_s,"
+          << "linear_solver_time_s,linear_solver_iterations,"
+          << "num_active_residual_blocks,cost,cost_change,"
+          << "relative_cost_reduction,step_is_successful\n";
+}
+
+size_t ProfilingCallback::getNumActiveResidualBlocks() const {
+  size_t num_active_residual_blocks = 0u;
+  for (const ceres_error_terms::ProblemInformation::ResidualInformationMap::
+           value_type& residual_block : problem_information_.residual_blocks) {
+    if (residual_block.second.active_) {
+      ++num_active_residual_blocks;
+    }
+  }
+  return num_active_residual_blocks;
+}
+
+ceres::CallbackReturnType ProfilingCallback::operator()(
+    const ceres::IterationSummary& summary) {
+  const double wall_time_s = summary.iteration_time_in_seconds;
+  const double linear_solver_time_s = summary.step_solver_time_in_seconds;
+  const double evaluation_time_s = wall_time_s - linear_solver_time_s;
+  const size_t num_active_residual_blocks = getNumActiveResidualBlocks();
+  // The cost change is relative to the cost before the iteration.
+  const double cost_before_iteration = summary.cost + summary.cost_change;
+  const double relative_cost_reduction =
+      cost_before_iteration > 0.0 ? summary.cost_change / cost_before_iteration
+                                  : 0.0;
+
+  VLOG(2) << "Solve " << solve_index_ << " iteration " << iteration_ << ": "
+          << wall_time_s << " s, evaluation " << evaluation_time_s
+          << " s, linear solver " << linear_solver_time_s << " s, "
+          << num_active_residual_blocks << " residual blocks, cost change "
+          << summary.cost_change;
+
+  if (logger_ != nullptr && logger_->isOpen()) {
+    // Format the whole line first, such that lines of concurrent solves
+    // sharing the logger don't interleave.
+    std::ostringstream line;
+    line << solve_index_ << "," << iteration_ << "," << wall_time_s << ","
+         << evaluation_time_s << "," << linear_solver_time_s << ","
+         << summary.linear_solver_iterations << ","
+         << num_active_residual_blocks << "," << summary.cost << ","
+         << summary.cost_change << "," << relative_cost_reduction << ","
+         << summary.step_is_successful << "\n";
+    *logger_ << line.str();
+  }
+
+  if (common::tracing::isRecording()) {
+    // Ceres solves for the step first and evaluates the problem at the new
+    // state afterwards.
+    constexpr double kNanosecondsPerSecond = 1e9;
+    const int64_t end_ns = common::tracing::getTimestampNanoseconds();
+    const int64_t start_ns =
+        end_ns - static_cast<int64_t>(wall_time_s * kNanosecondsPerSecond);
+    const int64_t linear_solver_end_ns =
+        start_ns +
+        static_cast<int64_t>(linear_solver_time_s * kNanosecondsPerSecond);
+    common::tracing::recordEvent(
+        "optimization", "ceres iteration", start_ns, end_ns);
+    common::tracing::recordEvent(
+        "optimization", "ceres linear solve", start_ns, linear_solver_end_ns);
+    common::tracing::recordEvent(
+        "optimization", "ceres evaluation", linear_solver_end_ns, end_ns);
+  }
+
+  ++iteration_;
+  return ceres::SOLVER_CONTINUE;
+}
+
+}  // namespace map_optimization
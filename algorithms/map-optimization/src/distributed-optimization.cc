@@ -0,0 +1,183 @@
+#include "map-optimization/distributed-optimization.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <aslam/common/timer.h>
+#include <maplab-common/parallel-process.h>
+#include <vi-map-helpers/mission-clustering-coobservation.h>
+#include <vi-map/vi-map-serialization.h>
+#include <vi-map/vi-map.h>
+
+#include "map-optimization/vi-map-optimizer.h"
+
+namespace map_optimization {
+
+namespace {
+void deleteRawMessageData(network::RawMessageDataList* raw_data) {
+  CHECK_NOTNULL(raw_data);
+  for (const network::RawMessageData& raw_data_part : *raw_data) {
+    delete[] static_cast<uint8_t*>(raw_data_part.first);
+  }
+  raw_data->clear();
+}
+
+// Copies the map and removes all missions that are not part of the cluster.
+void extractClusterSlice(
+    const vi_map::VIMap& map, const vi_map::MissionIdSet& cluster_mission_ids,
+    vi_map::VIMap* slice) {
+  CHECK_NOTNULL(slice);
+  slice->deepCopy(map);
+  vi_map::MissionIdList mission_ids;
+  slice->getAllMissionIds(&mission_ids);
+  constexpr bool kRemoveBaseframe = true;
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    if (cluster_mission_ids.count(mission_id) == 0u) {
+      slice->removeMission(mission_id, kRemoveBaseframe);
+    }
+  }
+}
+
+// Copies the states the optimization changes from the optimized slice back
+// into the map.
+void mergeClusterSlice(const vi_map::VIMap& slice, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  vi_map::MissionIdList mission_ids;
+  slice.getAllMissionIds(&mission_ids);
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    CHECK(map->hasMission(mission_id));
+    map->getMissionBaseFrameForMission(mission_id)
+        .set_T_G_M(slice.getMissionBaseFrameForMission(mission_id).get_T_G_M());
+  }
+
+  pose_graph::VertexIdList vertex_ids;
+  slice.getAllVertexIds(&vertex_ids);
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    const vi_map::Vertex& optimized_vertex = slice.getVertex(vertex_id);
+    CHECK(map->hasVertex(vertex_id));
+    vi_map::Vertex& vertex = map->getVertex(vertex_id);
+    vertex.set_T_M_I(optimized_vertex.get_T_M_I());
+    vertex.set_v_M(optimized_vertex.get_v_M());
+    vertex.setAccelBias(optimized_vertex.getAccelBias());
+    vertex.setGyroBias(optimized_vertex.getGyroBias());
+
+    vi_map::LandmarkStore& landmark_store = vertex.getLandmarks();
+    for (const vi_map::Landmark& optimized_landmark :
+         optimized_vertex.getLandmarks()) {
+      CHECK(landmark_store.hasLandmark(optimized_landmark.id()));
+      vi_map::Landmark& landmark =
+          landmark_store.getLandmark(optimized_landmark.id());
+      landmark.set_p_B(optimized_landmark.get_p_B());
+      landmark.setQuality(optimized_landmark.getQuality());
+    }
+  }
+}
+}  // namespace
+
+ClusterOptimizationWorker createLocalClusterOptimizationWorker(
+    const ViProblemOptions& options,
+    const OutlierRejectionSolverOptions* outlier_rejection_options) {
+  std::shared_ptr<const OutlierRejectionSolverOptions>
+      outlier_rejection_options_copy;
+  if (outlier_rejection_options != nullptr) {
+    outlier_rejection_options_copy =
+        std::make_shared<OutlierRejectionSolverOptions>(
+            *outlier_rejection_options);
+  }
+
+  return [options, outlier_rejection_options_copy](
+             const network::RawMessageDataList& request,
+             network::RawMessageDataList* response) -> bool {
+    CHECK_NOTNULL(response)->clear();
+    constexpr size_t kStartIndex = 0u;
+    vi_map::VIMap slice;
+    vi_map::serialization::deserializeFromRawArray(
+        request, kStartIndex, &slice);
+
+    vi_map::MissionIdSet mission_ids;
+    slice.getAllMissionIds(&mission_ids);
+
+    visualization::ViwlsGraphRvizPlotter* plotter = nullptr;
+    constexpr bool kSignalHandlerEnabled = false;
+    VIMapOptimizer optimizer(plotter, kSignalHandlerEnabled);
+    if (!optimizer.optimizeVisualInertial(
+            options, mission_ids, outlier_rejection_options_copy.get(),
+            &slice)) {
+      return false;
+    }
+    vi_map::serialization::serializeToRawArray(slice, response);
+    return true;
+  };
+}
+
+bool optimizeMissionClustersDistributed(
+    const vi_map::MissionIdSet& missions_to_optimize,
+    const ClusterOptimizationWorker& worker, const size_t num_parallel_jobs,
+    vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  CHECK(worker);
+  CHECK_GT(num_parallel_jobs, 0u);
+
+  if (missions_to_optimize.empty()) {
+    LOG(WARNING) << "Nothing to optimize.";
+    return false;
+  }
+
+  const std::vector<vi_map::MissionIdSet> clusters =
+      vi_map_helpers::clusterMissionByLandmarkCoobservations(
+          *map, missions_to_optimize);
+  LOG(INFO) << "Optimizing " << clusters.size()
+            << " mission clusters with up to " << num_parallel_jobs
+            << " parallel jobs.";
+
+  // Slicing reads the whole map and merging writes to it, hence both are
+  // serialized. The workers run concurrently.
+  std::mutex map_mutex;
+  std::atomic<size_t> num_failed_clusters(0u);
+  std::function<void(size_t, size_t)> optimize_clusters =
+      [&](size_t begin, size_t end) {
+        for (size_t cluster_idx = begin; cluster_idx < end; ++cluster_idx) {
+          network::RawMessageDataList request;
+          {
+            timing::Timer timer_slice("BA: Serialize cluster");
+            std::lock_guard<std::mutex> lock(map_mutex);
+            vi_map::VIMap slice;
+            extractClusterSlice(*map, clusters[cluster_idx], &slice);
+            vi_map::serialization::serializeToRawArray(slice, &request);
+            timer_slice.Stop();
+          }
+
+          network::RawMessageDataList response;
+          const bool success = worker(request, &response);
+          deleteRawMessageData(&request);
+          if (!success) {
+            LOG(ERROR) << "Optimizing mission cluster " << cluster_idx
+                       << " failed.";
+            deleteRawMessageData(&response);
+            ++num_failed_clusters;
+            continue;
+          }
+
+          timing::Timer timer_merge("BA: Merge cluster");
+          constexpr size_t kStartIndex = 0u;
+          vi_map::VIMap optimized_slice;
+          vi_map::serialization::deserializeFromRawArray(
+              response, kStartIndex, &optimized_slice);
+          deleteRawMessageData(&response);
+          {
+            std::lock_guard<std::mutex> lock(map_mutex);
+            mergeClusterSlice(optimized_slice, map);
+          }
+          timer_merge.Stop();
+        }
+      };
+  common::ParallelProcessDynamic(
+      clusters.size(), optimize_clusters, num_parallel_jobs,
+      common::ParallelSchedule::kDynamic);
+
+  return num_failed_clusters == 0u;
+}
+
+}  // namespace map_optimization
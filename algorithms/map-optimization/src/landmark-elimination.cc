@@ -0,0 +1,313 @@
+#include "map-optimization/landmark-elimination.h"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <aslam/cameras/camera.h>
+#include <aslam/common/pose-types.h>
+#include <ceres-error-terms/six-dof-block-pose-error-term-autodiff.h>
+#include <ceres/ceres.h>
+#include <maplab-common/geometry.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
+#include <vi-map/landmark-quality-metrics.h>
+
+#include "map-optimization/optimization-state-fixing.h"
+#include "map-optimization/optimization-terms-addition.h"
+
+namespace map_optimization {
+
+namespace {
+// Information of the relative pose of an observer with respect to the store
+// vertex of the landmarks they share, in the tangent space of a left
+// perturbation [delta_p, delta_theta] of T_O_S.
+struct PairInformation {
+  PairInformation() : information(Matrix6d::Zero()), num_landmarks(0u) {}
+
+  typedef Eigen::Matrix<double, 6, 6> Matrix6d;
+  Matrix6d information;
+  size_t num_landmarks;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+typedef std::unordered_map<
+    pose_graph::VertexId, PairInformation,
+    std::hash<pose_graph::VertexId>, std::equal_to<pose_graph::VertexId>,
+    Eigen::aligned_allocator<
+        std::pair<const pose_graph::VertexId, PairInformation>>>
+    ObserverToPairInformationMap;
+
+// Jacobian of the whitened reprojection error of the point p_I, given in the
+// IMU frame of the observing vertex, with respect to p_I. Returns false if
+// the point doesn't project into the camera.
+bool getWhitenedPointJacobian(
+    const vi_map::Vertex& vertex, const size_t frame_idx,
+    const size_t keypoint_idx, const Eigen::Vector3d& p_I,
+    Eigen::Matrix<double, 2, 3>* J_p_I) {
+  CHECK_NOTNULL(J_p_I);
+  const aslam::Camera::ConstPtr camera = vertex.getCamera(frame_idx);
+  CHECK(camera != nullptr);
+  const aslam::Transformation& T_C_I =
+      vertex.getVisualNFrame().getNCamera().get_T_C_B(frame_idx);
+  const Eigen::Vector3d p_C = T_C_I * p_I;
+
+  Eigen::Vector2d keypoint;
+  Eigen::Matrix<double, 2, 3> J_p_C;
+  const aslam::ProjectionResult projection_result =
+      camera->project3(p_C, &keypoint, &J_p_C);
+  if (projection_result != aslam::ProjectionResult::KEYPOINT_VISIBLE) {
+    return false;
+  }
+  const double sigma =
+      vertex.getVisualFrame(frame_idx).getKeypointMeasurementUncertainty(
+          keypoint_idx);
+  CHECK_GT(sigma, 0.0);
+  *J_p_I = J_p_C * T_C_I.getRotationMatrix() / sigma;
+  return true;
+}
+
+// Eliminates all landmarks stored in the store vertex into the information of
+// the relative pose of the store vertex and each of their observers.
+void eliminateLandmarksOfStoreVertex(
+    const vi_map::VIMap& map, const vi_map::Vertex& store_vertex,
+    ObserverToPairInformationMap* observer_to_pair_information) {
+  CHECK_NOTNULL(observer_to_pair_information)->clear();
+  const aslam::Transformation T_M_S = store_vertex.get_T_M_I();
+
+  for (const vi_map::Landmark& landmark : store_vertex.getLandmarks()) {
+    if (!vi_map::isLandmarkWellConstrained(map, landmark)) {
+      continue;
+    }
+    const Eigen::Vector3d& p_S = landmark.get_p_B();
+
+    // The observations of the store vertex constrain the landmark only.
+    Eigen::Matrix3d H_ll_store = Eigen::Matrix3d::Zero();
+    typedef std::unordered_map<pose_graph::VertexId,
+                               std::vector<vi_map::KeypointIdentifier>>
+        ObserverToObservationsMap;
+    ObserverToObservationsMap observer_to_observations;
+    for (const vi_map::KeypointIdentifier& observation :
+         landmark.getObservations()) {
+      const pose_graph::VertexId& observer_id = observation.frame_id.vertex_id;
+      if (observer_id != store_vertex.id()) {
+        observer_to_observations[observer_id].push_back(observation);
+        continue;
+      }
+      Eigen::Matrix<double, 2, 3> J_l;
+      if (getWhitenedPointJacobian(
+              store_vertex, observation.frame_id.frame_index,
+              observation.keypoint_index, p_S, &J_l)) {
+        H_ll_store += J_l.transpose() * J_l;
+      }
+    }
+    if (H_ll_store.isZero()) {
+      // Without an observation of the store vertex, the landmark doesn't
+      // relate the store vertex to any observer.
+      continue;
+    }
+
+    for (const ObserverToObservationsMap::value_type& observer_observations :
+         observer_to_observations) {
+      const vi_map::Vertex& observer =
+          map.getVertex(observer_observations.first);
+      if (observer.getMissionId() != store_vertex.getMissionId()) {
+        continue;
+      }
+      const aslam::Transformation T_O_S =
+          observer.get_T_M_I().inverse() * T_M_S;
+      const Eigen::Vector3d p_O = T_O_S * p_S;
+      const Eigen::Matrix3d R_O_S = T_O_S.getRotationMatrix();
+
+      // d p_O / d [delta_p, delta_theta] for T_O_S <- Exp(delta) * T_O_S.
+      Eigen::Matrix<double, 3, 6> J_p_O_pose;
+      J_p_O_pose << Eigen::Matrix3d::Identity(), -common::skew(p_O);
+
+      Eigen::Matrix3d H_ll = H_ll_store;
+      Eigen::Matrix<double, 6, 3> H_xl = Eigen::Matrix<double, 6, 3>::Zero();
+      PairInformation::Matrix6d H_xx = PairInformation::Matrix6d::Zero();
+      bool has_valid_observation = false;
+      for (const vi_map::KeypointIdentifier& observation :
+           observer_observations.second) {
+        Eigen::Matrix<double, 2, 3> J_p_I;
+        if (!getWhitenedPointJacobian(
+                observer, observation.frame_id.frame_index,
+                observation.keypoint_index, p_O, &J_p_I)) {
+          continue;
+        }
+        const Eigen::Matrix<double, 2, 6> J_x = J_p_I * J_p_O_pose;
+        const Eigen::Matrix<double, 2, 3> J_l = J_p_I * R_O_S;
+        H_xx += J_x.transpose() * J_x;
+        H_xl += J_x.transpose() * J_l;
+        H_ll += J_l.transpose() * J_l;
+        has_valid_observation = true;
+      }
+      if (!has_valid_observation) {
+        continue;
+      }
+
+      // Schur complement of the landmark.
+      const Eigen::LDLT<Eigen::Matrix3d> H_ll_ldlt(H_ll);
+      if (H_ll_ldlt.info() != Eigen::Success || !H_ll_ldlt.isPositive()) {
+        continue;
+      }
+      PairInformation& pair_information =
+          (*observer_to_pair_information)[observer.id()];
+      pair_information.information +=
+          H_xx - H_xl * H_ll_ldlt.solve(H_xl.transpose());
+      ++pair_information.num_landmarks;
+    }
+  }
+}
+
+// The relative pose is only observable up to scale from the landmarks of the
+// pair, the information is regularized relative to its magnitude to make it
+// invertible.
+constexpr double kRelativeRegularization = 1e-6;
+}  // namespace
+
+int addLandmarkEliminatedPoseTerms(
+    const size_t min_num_common_landmarks, OptimizationProblem* problem) {
+  CHECK_NOTNULL(problem);
+  CHECK_GT(min_num_common_landmarks, 0u);
+
+  vi_map::VIMap* map = CHECK_NOTNULL(problem->getMapMutable());
+  OptimizationStateBuffer* buffer =
+      CHECK_NOTNULL(problem->getOptimizationStateBufferMutable());
+  ceres_error_terms::ProblemInformation* problem_information =
+      CHECK_NOTNULL(problem->getProblemInformationMutable());
+  const std::shared_ptr<ceres::LocalParameterization>& pose_parameterization =
+      problem->getLocalParameterizations().pose_parameterization;
+
+  pose_graph::VertexIdList store_vertex_ids;
+  for (const vi_map::MissionId& mission_id : problem->getMissionIds()) {
+    pose_graph::VertexIdList mission_vertex_ids;
+    map->getAllVertexIdsInMissionAlongGraph(mission_id, &mission_vertex_ids);
+    store_vertex_ids.insert(
+        store_vertex_ids.end(), mission_vertex_ids.begin(),
+        mission_vertex_ids.end());
+  }
+
+  // Store vertices only read the map and write their own results, hence they
+  // are eliminated in parallel.
+  const size_t num_store_vertices = store_vertex_ids.size();
+  std::vector<ObserverToPairInformationMap> pair_informations(
+      num_store_vertices);
+  std::function<void(size_t, size_t)> eliminate_landmarks =
+      [&](size_t begin, size_t end) {
+        for (size_t idx = begin; idx < end; ++idx) {
+          eliminateLandmarksOfStoreVertex(
+              *map, map->getVertex(store_vertex_ids[idx]),
+              &pair_informations[idx]);
+        }
+      };
+  common::ParallelProcessDynamic(
+      num_store_vertices, eliminate_landmarks,
+      common::getNumHardwareThreads());
+
+  // Added in the order of the vertices, such that the problem doesn't depend
+  // on the scheduling.
+  int num_residuals_added = 0;
+  for (size_t idx = 0u; idx < num_store_vertices; ++idx) {
+    const vi_map::Vertex& store_vertex =
+        map->getVertex(store_vertex_ids[idx]);
+    std::vector<pose_graph::VertexId> observer_ids;
+    for (const ObserverToPairInformationMap::value_type& observer_information :
+         pair_informations[idx]) {
+      observer_ids.push_back(observer_information.first);
+    }
+    std::sort(observer_ids.begin(), observer_ids.end());
+
+    for (const pose_graph::VertexId& observer_id : observer_ids) {
+      const PairInformation& pair_information =
+          pair_informations[idx].at(observer_id);
+      if (pair_information.num_landmarks < min_num_common_landmarks) {
+        continue;
+      }
+      const vi_map::Vertex& observer = map->getVertex(observer_id);
+      const aslam::Transformation T_S_O =
+          store_vertex.get_T_M_I().inverse() * observer.get_T_M_I();
+
+      // The error term uses the translation of T_S_O and a right perturbation
+      // of its rotation, which equals -diag(R_S_O, I) * delta.
+      Eigen::Matrix<double, 6, 6> rotate_tangent =
+          Eigen::Matrix<double, 6, 6>::Identity();
+      rotate_tangent.topLeftCorner<3, 3>() = T_S_O.getRotationMatrix();
+      Eigen::Matrix<double, 6, 6> error_information =
+          rotate_tangent * pair_information.information *
+          rotate_tangent.transpose();
+      error_information = 0.5 * (error_information +
+                                 error_information.transpose().eval());
+      const double regularization =
+          kRelativeRegularization *
+          std::max(error_information.trace() / 6.0, 1.0);
+      error_information.diagonal().array() += regularization;
+      const Eigen::Matrix<double, 6, 6> error_covariance =
+          error_information.ldlt().solve(
+              Eigen::Matrix<double, 6, 6>::Identity());
+
+      std::shared_ptr<ceres::CostFunction> pose_term_cost(
+          new ceres::AutoDiffCostFunction<
+              ceres_error_terms::SixDoFBlockPoseErrorTerm,
+              ceres_error_terms::SixDoFBlockPoseErrorTerm::residualBlockSize,
+              ceres_error_terms::poseblocks::kPoseSize,
+              ceres_error_terms::poseblocks::kPoseSize>(
+              new ceres_error_terms::SixDoFBlockPoseErrorTerm(
+                  T_S_O, error_covariance)));
+
+      // The keyframe poses in the buffer are [q_M_I_xyzw, M_p_MI] as the
+      // passive JPL rotation equals the active Hamilton one.
+      double* store_vertex_q_IM__M_p_MI =
+          buffer->get_vertex_q_IM__M_p_MI_JPL(store_vertex.id());
+      double* observer_q_IM__M_p_MI =
+          buffer->get_vertex_q_IM__M_p_MI_JPL(observer_id);
+      problem_information->addResidualBlock(
+          ceres_error_terms::ResidualType::kOdometry, pose_term_cost, nullptr,
+          {store_vertex_q_IM__M_p_MI, observer_q_IM__M_p_MI});
+      problem_information->setParameterization(
+          store_vertex_q_IM__M_p_MI, pose_parameterization);
+      problem_information->setParameterization(
+          observer_q_IM__M_p_MI, pose_parameterization);
+
+      OptimizationProblem::ProblemBookkeeping* bookkeeping =
+          problem->getProblemBookkeepingMutable();
+      bookkeeping->keyframes_in_problem.emplace(store_vertex.id());
+      bookkeeping->keyframes_in_problem.emplace(observer_id);
+      ++num_residuals_added;
+    }
+  }
+
+  VLOG(1) << "Eliminated the landmarks into " << num_residuals_added
+          << " relative pose constraints.";
+  return num_residuals_added;
+}
+
+void addLandmarkBackSubstitutionTerms(OptimizationProblem* problem) {
+  CHECK_NOTNULL(problem);
+
+  constexpr bool kFixLandmarkPositions = false;
+  constexpr bool kFixIntrinsics = true;
+  constexpr bool kFixExtrinsicsRotation = true;
+  constexpr bool kFixExtrinsicsTranslation = true;
+  constexpr size_t kMinLandmarksPerFrame = 0u;
+  addVisualTerms(
+      kFixLandmarkPositions, kFixIntrinsics, kFixExtrinsicsRotation,
+      kFixExtrinsicsTranslation, kMinLandmarksPerFrame, problem);
+
+  // With all keyframes fixed, the landmarks are independent of each other.
+  OptimizationStateBuffer* buffer =
+      CHECK_NOTNULL(problem->getOptimizationStateBufferMutable());
+  ceres_error_terms::ProblemInformation* problem_information =
+      CHECK_NOTNULL(problem->getProblemInformationMutable());
+  for (const pose_graph::VertexId& vertex_id :
+       problem->getProblemBookkeepingMutable()->keyframes_in_problem) {
+    problem_information->setParameterBlockConstantIfPartOfTheProblem(
+        buffer->get_vertex_q_IM__M_p_MI_JPL(vertex_id));
+  }
+  fixAllBaseframesInProblem(problem);
+}
+
+}  // namespace map_optimization
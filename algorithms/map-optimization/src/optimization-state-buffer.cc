@@ -11,11 +11,61 @@
 
 namespace map_optimization {
 
+size_t OptimizationStateBuffer::getVertexIndex(
+    const pose_graph::VertexId& id) const {
+  const size_t index = common::getChecked(vertex_id_to_vertex_idx_, id);
+  CHECK_LT(index, vertex_idx_to_vertex_id_.size());
+  return index;
+}
+
 double* OptimizationStateBuffer::get_vertex_q_IM__M_p_MI_JPL(
     const pose_graph::VertexId& id) {
-  const size_t index = common::getChecked(vertex_id_to_vertex_idx_, id);
-  CHECK_LT(index, static_cast<size_t>(vertex_q_IM__M_p_MI_.cols()));
-  return vertex_q_IM__M_p_MI_.col(index).data();
+  return get_vertex_q_IM__M_p_MI_JPL(getVertexIndex(id));
+}
+
+double* OptimizationStateBuffer::get_vertex_v_M(
+    const pose_graph::VertexId& id) {
+  return get_vertex_v_M(getVertexIndex(id));
+}
+
+double* OptimizationStateBuffer::get_vertex_gyro_bias(
+    const pose_graph::VertexId& id) {
+  return get_vertex_gyro_bias(getVertexIndex(id));
+}
+
+double* OptimizationStateBuffer::get_vertex_accel_bias(
+    const pose_graph::VertexId& id) {
+  return get_vertex_accel_bias(getVertexIndex(id));
+}
+
+double* OptimizationStateBuffer::get_vertex_q_IM__M_p_MI_JPL(
+    const size_t vertex_idx) {
+  DCHECK_LT(vertex_idx, static_cast<size_t>(vertex_q_IM__M_p_MI_.cols()));
+  return vertex_q_IM__M_p_MI_.col(vertex_idx).data();
+}
+
+double* OptimizationStateBuffer::get_vertex_v_M(const size_t vertex_idx) {
+  DCHECK_LT(vertex_idx, static_cast<size_t>(vertex_v_M_.cols()));
+  return vertex_v_M_.col(vertex_idx).data();
+}
+
+double* OptimizationStateBuffer::get_vertex_gyro_bias(const size_t vertex_idx) {
+  DCHECK_LT(vertex_idx, static_cast<size_t>(vertex_gyro_bias_.cols()));
+  return vertex_gyro_bias_.col(vertex_idx).data();
+}
+
+double* OptimizationStateBuffer::get_vertex_accel_bias(
+    const size_t vertex_idx) {
+  DCHECK_LT(vertex_idx, static_cast<size_t>(vertex_accel_bias_.cols()));
+  return vertex_accel_bias_.col(vertex_idx).data();
+}
+
+double* OptimizationStateBuffer::get_vertex_baseframe_q_GM__G_p_GM_JPL(
+    const size_t vertex_idx) {
+  DCHECK_LT(vertex_idx, vertex_idx_to_baseframe_idx_.size());
+  const size_t baseframe_idx = vertex_idx_to_baseframe_idx_[vertex_idx];
+  DCHECK_LT(baseframe_idx, static_cast<size_t>(baseframe_q_GM__G_p_GM_.cols()));
+  return baseframe_q_GM__G_p_GM_.col(baseframe_idx).data();
 }
 
 double* OptimizationStateBuffer::get_baseframe_q_GM__G_p_GM_JPL(
@@ -47,39 +97,60 @@ double* OptimizationStateBuffer::get_sensor_extrinsics_R_p_RS(
 }
 
 void OptimizationStateBuffer::copyAllStatesBackToMap(vi_map::VIMap* map) const {
-  copyAllKeyframePosesBackToMap(map);
+  copyAllKeyframeStatesBackToMap(map);
   copyAllBaseframePosesBackToMap(map);
   copyAllSensorCalibrationsBackToMap(map);
   copyAllCameraCalibrationsBackToMap(map);
 }
 
-void OptimizationStateBuffer::copyAllKeyframePosesBackToMap(
+void OptimizationStateBuffer::copyAllKeyframeStatesBackToMap(
     vi_map::VIMap* map) const {
   CHECK_NOTNULL(map);
-  CHECK_EQ(
-      static_cast<size_t>(vertex_q_IM__M_p_MI_.cols()),
-      vertex_id_to_vertex_idx_.size());
-  typedef std::pair<const pose_graph::VertexId, size_t> value_type;
-  for (const value_type& vertex_id_idx : vertex_id_to_vertex_idx_) {
-    vi_map::Vertex& vertex = map->getVertex(vertex_id_idx.first);
-    const size_t vertex_idx = vertex_id_idx.second;
-    Eigen::Map<Eigen::Quaterniond> map_q_M_I(vertex.get_q_M_I_Mutable());
-    Eigen::Map<Eigen::Vector3d> map_p_M_I(vertex.get_p_M_I_Mutable());
-
-    CHECK_LT(vertex_idx, static_cast<size_t>(vertex_q_IM__M_p_MI_.cols()));
-
-    // Change from JPL passive quaternion used by error terms to active Hamilton
-    // quaternion.
-    Eigen::Quaterniond q_I_M_JPL;
-    q_I_M_JPL.coeffs() = vertex_q_IM__M_p_MI_.col(vertex_idx).head<4>();
-    assertValidQuaternion(q_I_M_JPL);
-
-    // I_q_G_JPL is in fact equal to active G_q_I - no inverse is needed.
-    map_q_M_I = q_I_M_JPL;
-    map_p_M_I = vertex_q_IM__M_p_MI_.col(vertex_idx).tail<3>();
+  const size_t num_vertices = vertex_idx_to_vertex_id_.size();
+  CHECK_EQ(static_cast<size_t>(vertex_q_IM__M_p_MI_.cols()), num_vertices);
+  CHECK_EQ(static_cast<size_t>(vertex_v_M_.cols()), num_vertices);
+  CHECK_EQ(static_cast<size_t>(vertex_gyro_bias_.cols()), num_vertices);
+  CHECK_EQ(static_cast<size_t>(vertex_accel_bias_.cols()), num_vertices);
+
+  // Walk the states in buffer order such that all arrays are read linearly.
+  for (size_t vertex_idx = 0u; vertex_idx < num_vertices; ++vertex_idx) {
+    copyKeyframeStateBackToMap(vertex_idx, map);
   }
 }
 
+void OptimizationStateBuffer::copyKeyframeStatesBackToMap(
+    const pose_graph::VertexIdSet& vertex_ids, vi_map::VIMap* map) const {
+  CHECK_NOTNULL(map);
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    copyKeyframeStateBackToMap(getVertexIndex(vertex_id), map);
+  }
+}
+
+void OptimizationStateBuffer::copyKeyframeStateBackToMap(
+    const size_t vertex_idx, vi_map::VIMap* map) const {
+  CHECK_NOTNULL(map);
+  vi_map::Vertex& vertex = map->getVertex(vertex_idx_to_vertex_id_[vertex_idx]);
+  Eigen::Map<Eigen::Quaterniond> map_q_M_I(vertex.get_q_M_I_Mutable());
+  Eigen::Map<Eigen::Vector3d> map_p_M_I(vertex.get_p_M_I_Mutable());
+
+  // Change from JPL passive quaternion used by error terms to active Hamilton
+  // quaternion.
+  Eigen::Quaterniond q_I_M_JPL;
+  q_I_M_JPL.coeffs() = vertex_q_IM__M_p_MI_.col(vertex_idx).head<4>();
+  assertValidQuaternion(q_I_M_JPL);
+
+  // I_q_G_JPL is in fact equal to active G_q_I - no inverse is needed.
+  map_q_M_I = q_I_M_JPL;
+  map_p_M_I = vertex_q_IM__M_p_MI_.col(vertex_idx).tail<3>();
+
+  Eigen::Map<Eigen::Vector3d>(vertex.get_v_M_Mutable()) =
+      vertex_v_M_.col(vertex_idx);
+  Eigen::Map<Eigen::Vector3d>(vertex.getGyroBiasMutable()) =
+      vertex_gyro_bias_.col(vertex_idx);
+  Eigen::Map<Eigen::Vector3d>(vertex.getAccelBiasMutable()) =
+      vertex_accel_bias_.col(vertex_idx);
+}
+
 void OptimizationStateBuffer::copyAllBaseframePosesBackToMap(
     vi_map::VIMap* map) const {
   CHECK_NOTNULL(map);
@@ -166,27 +237,39 @@ void OptimizationStateBuffer::copyAllSensorCalibrationsBackToMap(
 
 void OptimizationStateBuffer::importStatesOfMissions(
     const vi_map::VIMap& map, const vi_map::MissionIdSet& mission_ids) {
-  importKeyframePosesOfMissions(map, mission_ids);
+  importKeyframeStatesOfMissions(map, mission_ids);
   importBaseframePoseOfMissions(map, mission_ids);
   importCameraCalibrationsOfMissions(map, mission_ids);
   importSensorCalibrationsOfMissions(map, mission_ids);
 }
 
-void OptimizationStateBuffer::importKeyframePosesOfMissions(
+void OptimizationStateBuffer::importKeyframeStatesOfMissions(
     const vi_map::VIMap& map, const vi_map::MissionIdSet& mission_ids) {
-  pose_graph::VertexIdList all_vertices;
+  vertex_idx_to_vertex_id_.clear();
+  vertex_idx_to_baseframe_idx_.clear();
+  // The baseframes are imported in the same order of the missions, hence the
+  // baseframe index of a vertex is the index of its mission.
+  size_t mission_idx = 0u;
   pose_graph::VertexIdList mission_vertices;
   for (const vi_map::MissionId& mission_id : mission_ids) {
     map.getAllVertexIdsInMissionAlongGraph(mission_id, &mission_vertices);
-    all_vertices.insert(
-        all_vertices.end(), mission_vertices.begin(), mission_vertices.end());
+    vertex_idx_to_vertex_id_.insert(
+        vertex_idx_to_vertex_id_.end(), mission_vertices.begin(),
+        mission_vertices.end());
+    vertex_idx_to_baseframe_idx_.resize(
+        vertex_idx_to_vertex_id_.size(), mission_idx);
+    ++mission_idx;
   }
-  vertex_id_to_vertex_idx_.reserve(all_vertices.size());
-  vertex_q_IM__M_p_MI_.resize(Eigen::NoChange, all_vertices.size());
+  const size_t num_vertices = vertex_idx_to_vertex_id_.size();
+  vertex_id_to_vertex_idx_.reserve(num_vertices);
+  vertex_q_IM__M_p_MI_.resize(Eigen::NoChange, num_vertices);
+  vertex_v_M_.resize(Eigen::NoChange, num_vertices);
+  vertex_gyro_bias_.resize(Eigen::NoChange, num_vertices);
+  vertex_accel_bias_.resize(Eigen::NoChange, num_vertices);
 
-  size_t vertex_idx = 0u;
-  for (const pose_graph::VertexId& vertex_id : all_vertices) {
-    const vi_map::Vertex& ba_vertex = map.getVertex(vertex_id);
+  for (size_t vertex_idx = 0u; vertex_idx < num_vertices; ++vertex_idx) {
+    const vi_map::Vertex& ba_vertex =
+        map.getVertex(vertex_idx_to_vertex_id_[vertex_idx]);
 
     Eigen::Quaterniond q_M_I = ba_vertex.get_q_M_I();
     ensurePositiveQuaternion(q_M_I.coeffs());
@@ -196,14 +279,13 @@ void OptimizationStateBuffer::importKeyframePosesOfMissions(
     // which the error terms use. No inverse is required.
     vertex_q_IM__M_p_MI_.col(vertex_idx) << q_M_I.coeffs(),
         ba_vertex.get_p_M_I();
+    vertex_v_M_.col(vertex_idx) = ba_vertex.get_v_M();
+    vertex_gyro_bias_.col(vertex_idx) = ba_vertex.getGyroBias();
+    vertex_accel_bias_.col(vertex_idx) = ba_vertex.getAccelBias();
     CHECK(ba_vertex.id().isValid());
     CHECK(vertex_id_to_vertex_idx_.emplace(ba_vertex.id(), vertex_idx).second);
-    ++vertex_idx;
   }
-  CHECK_EQ(
-      static_cast<size_t>(vertex_q_IM__M_p_MI_.cols()),
-      vertex_id_to_vertex_idx_.size());
-  CHECK_EQ(all_vertices.size(), vertex_id_to_vertex_idx_.size());
+  CHECK_EQ(num_vertices, vertex_id_to_vertex_idx_.size());
 }
 
 void OptimizationStateBuffer::importBaseframePoseOfMissions(
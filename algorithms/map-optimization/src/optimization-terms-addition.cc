@@ -1,194 +1,314 @@
 #include "map-optimization/optimization-terms-addition.h"
 
+#include <functional>
 #include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include <ceres-error-terms/batched-visual-error-term.h>
 #include <ceres-error-terms/inertial-error-term.h>
+#include <ceres-error-terms/preintegrated-inertial-error-term.h>
 #include <ceres-error-terms/visual-error-term-factory.h>
 #include <ceres-error-terms/visual-error-term.h>
+#include <aslam/common/timer.h>
 #include <ceres/ceres.h>
+#include <gflags/gflags.h>
+#include <maplab-common/parallel-process.h>
 #include <maplab-common/progress-bar.h>
+#include <maplab-common/threading-helpers.h>
 #include <vi-map-helpers/vi-map-queries.h>
 #include <vi-map/landmark-quality-metrics.h>
 
+DEFINE_bool(
+    ba_use_imu_preintegration, false,
+    "Use inertial terms that preintegrate the IMU measurements once at the "
+    "current biases and correct for bias changes to first order, instead of "
+    "re-integrating the measurements whenever the begin state changes.");
+DEFINE_bool(
+    ba_batch_visual_terms_per_landmark, false,
+    "Add all visual observations of a landmark as a single residual block "
+    "instead of one residual block per keypoint. This reduces the overhead "
+    "per residual block of Ceres for large problems.");
+
 namespace map_optimization {
 
-bool addVisualTermForKeypoint(
-    const int keypoint_idx, const int frame_idx,
-    const bool fix_landmark_positions, const bool fix_intrinsics,
-    const bool fix_extrinsics_rotation, const bool fix_extrinsics_translation,
-    const std::shared_ptr<ceres::LocalParameterization>& pose_parameterization,
-    const std::shared_ptr<ceres::LocalParameterization>&
-        baseframe_parameterization,
-    const std::shared_ptr<ceres::LocalParameterization>&
-        camera_parameterization,
-    vi_map::Vertex* vertex_ptr, OptimizationProblem* problem) {
-  CHECK_NOTNULL(vertex_ptr);
-  CHECK_NOTNULL(problem);
+namespace {
+// Everything that is needed to add the visual term of one keypoint to the
+// problem. Creating the terms only reads the map and the state buffer and can
+// run in parallel, only adding them to the problem is serial.
+struct VisualTerm {
+  vi_map::LandmarkId landmark_id;
+  ceres_error_terms::visual::VisualErrorType error_term_type;
+  std::shared_ptr<ceres::CostFunction> cost_function;
+  std::shared_ptr<ceres::LossFunction> loss_function;
+  std::vector<double*> cost_term_args;
+  std::vector<double*> dummies_to_set_constant;
 
-  CHECK(pose_parameterization != nullptr);
-  CHECK(baseframe_parameterization != nullptr);
-  CHECK(camera_parameterization != nullptr);
+  double* landmark_p_B;
+  double* landmark_store_vertex_q_IM__M_p_MI;
+  double* vertex_q_IM__M_p_MI;
+  double* landmark_store_baseframe_q_GM__G_p_GM;
+  double* observer_baseframe_q_GM__G_p_GM;
+  double* camera_q_CI;
+  double* camera_C_p_CI;
+  double* camera_intrinsics;
+  // nullptr if the camera has no distortion.
+  double* camera_distortion;
+};
+
+// All observations of a landmark in a single residual block, see
+// FLAGS_ba_batch_visual_terms_per_landmark.
+struct LandmarkVisualTermBatch {
+  vi_map::LandmarkId landmark_id;
+  std::shared_ptr<ceres_error_terms::BatchedVisualReprojectionError>
+      cost_function;
+};
+
+// States shared by all keypoints of a frame, such that they are only looked
+// up once per frame. The vertex is mutable as the problem optimizes the
+// camera parameters in place.
+struct FrameStates {
+  size_t vertex_idx;
+  aslam::Camera::Ptr camera;
+  double* camera_q_CI;
+};
+
+void getFrameStates(
+    const int frame_idx, vi_map::Vertex* vertex,
+    OptimizationStateBuffer* buffer, FrameStates* frame_states) {
+  CHECK_NOTNULL(vertex);
+  CHECK_NOTNULL(buffer);
+  CHECK_NOTNULL(frame_states);
+  frame_states->vertex_idx = buffer->getVertexIndex(vertex->id());
+  frame_states->camera = vertex->getCamera(frame_idx);
+  CHECK(frame_states->camera != nullptr);
+  const aslam::CameraId& camera_id = frame_states->camera->getId();
+  CHECK(camera_id.isValid());
+  frame_states->camera_q_CI =
+      buffer->get_camera_extrinsics_q_CI__C_p_CI_JPL(camera_id);
+}
+
+void createVisualTermForKeypoint(
+    const int keypoint_idx, const int frame_idx, const vi_map::Vertex& vertex,
+    const FrameStates& frame_states, OptimizationProblem* problem,
+    VisualTerm* term) {
+  CHECK_NOTNULL(problem);
+  CHECK_NOTNULL(term);
 
   OptimizationStateBuffer* buffer =
       CHECK_NOTNULL(problem->getOptimizationStateBufferMutable());
   vi_map::VIMap* map = CHECK_NOTNULL(problem->getMapMutable());
-  ceres_error_terms::ProblemInformation* problem_information =
-      CHECK_NOTNULL(problem->getProblemInformationMutable());
 
-  const aslam::VisualFrame& visual_frame =
-      vertex_ptr->getVisualFrame(frame_idx);
+  const aslam::VisualFrame& visual_frame = vertex.getVisualFrame(frame_idx);
   CHECK_GE(keypoint_idx, 0);
   CHECK_LT(
       keypoint_idx,
       static_cast<int>(visual_frame.getNumKeypointMeasurements()));
 
-  const vi_map::LandmarkId landmark_id =
-      vertex_ptr->getObservedLandmarkId(frame_idx, keypoint_idx);
+  term->landmark_id = vertex.getObservedLandmarkId(frame_idx, keypoint_idx);
 
   // The keypoint must have a valid association with a landmark.
-  CHECK(landmark_id.isValid());
+  CHECK(term->landmark_id.isValid());
 
-  vi_map::Vertex& landmark_store_vertex =
-      map->getLandmarkStoreVertex(landmark_id);
-  vi_map::Landmark& landmark = map->getLandmark(landmark_id);
+  const vi_map::Vertex& landmark_store_vertex =
+      map->getLandmarkStoreVertex(term->landmark_id);
+  vi_map::Landmark& landmark = map->getLandmark(term->landmark_id);
 
-  const aslam::Camera::Ptr camera_ptr = vertex_ptr->getCamera(frame_idx);
-  CHECK(camera_ptr != nullptr);
+  const aslam::Camera::Ptr& camera_ptr = frame_states.camera;
 
   const Eigen::Vector2d& image_point_distorted =
-      vertex_ptr->getVisualFrame(frame_idx).getKeypointMeasurement(
-          keypoint_idx);
+      visual_frame.getKeypointMeasurement(keypoint_idx);
   const double image_point_uncertainty =
-      vertex_ptr->getVisualFrame(frame_idx).getKeypointMeasurementUncertainty(
-          keypoint_idx);
+      visual_frame.getKeypointMeasurementUncertainty(keypoint_idx);
 
   // As defined here: http://en.wikipedia.org/wiki/Huber_Loss_Function
   double huber_loss_delta = 3.0;
 
-  ceres_error_terms::visual::VisualErrorType error_term_type;
-  if (vertex_ptr->id() != landmark_store_vertex.id()) {
+  if (vertex.id() != landmark_store_vertex.id()) {
     // Verify if the landmark and keyframe belong to the same mission.
-    if (vertex_ptr->getMissionId() == landmark_store_vertex.getMissionId()) {
-      error_term_type =
+    if (vertex.getMissionId() == landmark_store_vertex.getMissionId()) {
+      term->error_term_type =
           ceres_error_terms::visual::VisualErrorType::kLocalMission;
     } else {
-      error_term_type = ceres_error_terms::visual::VisualErrorType::kGlobal;
+      term->error_term_type =
+          ceres_error_terms::visual::VisualErrorType::kGlobal;
       huber_loss_delta = 10.0;
     }
   } else {
-    error_term_type =
+    term->error_term_type =
         ceres_error_terms::visual::VisualErrorType::kLocalKeyframe;
   }
 
-  double* distortion_params = nullptr;
+  term->camera_distortion = nullptr;
   if (camera_ptr->getDistortion().getType() !=
       aslam::Distortion::Type::kNoDistortion) {
-    distortion_params =
-        camera_ptr->getDistortionMutable()->getParametersMutable();
-    CHECK_NOTNULL(distortion_params);
+    term->camera_distortion = CHECK_NOTNULL(
+        camera_ptr->getDistortionMutable()->getParametersMutable());
   }
+  term->camera_intrinsics = camera_ptr->getParametersMutable();
 
-  vi_map::MissionBaseFrameId observer_baseframe_id =
-      map->getMissionForVertex(vertex_ptr->id()).getBaseFrameId();
-  vi_map::MissionBaseFrameId store_baseframe_id =
-      map->getMissionForVertex(landmark_store_vertex.id()).getBaseFrameId();
-  double* observer_baseframe_q_GM__G_p_GM =
-      buffer->get_baseframe_q_GM__G_p_GM_JPL(observer_baseframe_id);
-  double* landmark_store_baseframe_q_GM__G_p_GM =
-      buffer->get_baseframe_q_GM__G_p_GM_JPL(store_baseframe_id);
-
-  double* vertex_q_IM__M_p_MI =
-      buffer->get_vertex_q_IM__M_p_MI_JPL(vertex_ptr->id());
-  double* landmark_store_vertex_q_IM__M_p_MI =
-      buffer->get_vertex_q_IM__M_p_MI_JPL(landmark_store_vertex.id());
-
-  const aslam::CameraId& camera_id = camera_ptr->getId();
-  CHECK(camera_id.isValid());
-  double* camera_q_CI =
-      buffer->get_camera_extrinsics_q_CI__C_p_CI_JPL(camera_id);
+  const size_t landmark_store_vertex_idx =
+      buffer->getVertexIndex(landmark_store_vertex.id());
+  term->observer_baseframe_q_GM__G_p_GM =
+      buffer->get_vertex_baseframe_q_GM__G_p_GM_JPL(frame_states.vertex_idx);
+  term->landmark_store_baseframe_q_GM__G_p_GM =
+      buffer->get_vertex_baseframe_q_GM__G_p_GM_JPL(landmark_store_vertex_idx);
+
+  term->vertex_q_IM__M_p_MI =
+      buffer->get_vertex_q_IM__M_p_MI_JPL(frame_states.vertex_idx);
+  term->landmark_store_vertex_q_IM__M_p_MI =
+      buffer->get_vertex_q_IM__M_p_MI_JPL(landmark_store_vertex_idx);
+
+  term->camera_q_CI = frame_states.camera_q_CI;
   // The visual error term requires the camera rotation and translation
   // to be feeded separately. Shifting by 4 = the quaternione size.
-  double* camera_C_p_CI = camera_q_CI + 4;
+  term->camera_C_p_CI = term->camera_q_CI + 4;
+  term->landmark_p_B = landmark.get_p_B_Mutable();
 
-  std::shared_ptr<ceres::CostFunction> visual_term_cost(
+  term->cost_function.reset(
       ceres_error_terms::createVisualCostFunction<
           ceres_error_terms::VisualReprojectionError>(
-          image_point_distorted, image_point_uncertainty, error_term_type,
-          camera_ptr.get()));
-
-  std::vector<double*> cost_term_args = {
-      landmark.get_p_B_Mutable(),
-      landmark_store_vertex_q_IM__M_p_MI,
-      landmark_store_baseframe_q_GM__G_p_GM,
-      observer_baseframe_q_GM__G_p_GM,
-      vertex_q_IM__M_p_MI,
-      camera_q_CI,
-      camera_C_p_CI,
-      camera_ptr->getParametersMutable(),
-      camera_ptr->getDistortionMutable()->getParametersMutable()};
+          image_point_distorted, image_point_uncertainty,
+          term->error_term_type, camera_ptr.get()));
+
+  term->cost_term_args = {term->landmark_p_B,
+                          term->landmark_store_vertex_q_IM__M_p_MI,
+                          term->landmark_store_baseframe_q_GM__G_p_GM,
+                          term->observer_baseframe_q_GM__G_p_GM,
+                          term->vertex_q_IM__M_p_MI,
+                          term->camera_q_CI,
+                          term->camera_C_p_CI,
+                          term->camera_intrinsics,
+                          camera_ptr->getDistortionMutable()
+                              ->getParametersMutable()};
 
   // Certain types of visual cost terms (as indicated by error_term_type) do not
   // use all of the pointer arguments. Ceres, however, requires us to provide
   // valid pointers so we replace unnecessary arguments with dummy variables
   // filled with NaNs. The function also returns the pointers of the dummies
   // used so that we can set them constant below.
-  std::vector<double*> dummies_to_set_constant;
   ceres_error_terms::replaceUnusedArgumentsOfVisualCostFunctionWithDummies(
-      error_term_type, &cost_term_args, &dummies_to_set_constant);
+      term->error_term_type, &term->cost_term_args,
+      &term->dummies_to_set_constant);
 
-  for (double* dummy : dummies_to_set_constant) {
-    problem_information->setParameterBlockConstant(dummy);
-  }
+  term->loss_function.reset(new ceres::LossFunctionWrapper(
+      new ceres::HuberLoss(huber_loss_delta * image_point_uncertainty),
+      ceres::TAKE_OWNERSHIP));
+}
 
-  std::shared_ptr<ceres::LossFunction> loss_function(
-      new ceres::LossFunctionWrapper(
-          new ceres::HuberLoss(huber_loss_delta * image_point_uncertainty),
-          ceres::TAKE_OWNERSHIP));
+// Sets the parameterizations and the fixed blocks of the parameter blocks of
+// the term.
+void setVisualTermParameterProperties(
+    const VisualTerm& term, const bool fix_landmark_positions,
+    const bool fix_intrinsics, const bool fix_extrinsics_rotation,
+    const bool fix_extrinsics_translation,
+    const std::shared_ptr<ceres::LocalParameterization>& pose_parameterization,
+    const std::shared_ptr<ceres::LocalParameterization>&
+        baseframe_parameterization,
+    const std::shared_ptr<ceres::LocalParameterization>&
+        camera_parameterization,
+    ceres_error_terms::ProblemInformation* problem_information) {
+  CHECK_NOTNULL(problem_information);
 
-  problem_information->addResidualBlock(
-      ceres_error_terms::ResidualType::kVisualReprojectionError,
-      visual_term_cost, loss_function, cost_term_args);
+  for (double* dummy : term.dummies_to_set_constant) {
+    problem_information->setParameterBlockConstant(dummy);
+  }
 
-  if (error_term_type !=
+  if (term.error_term_type !=
       ceres_error_terms::visual::VisualErrorType::kLocalKeyframe) {
     problem_information->setParameterization(
-        landmark_store_vertex_q_IM__M_p_MI, pose_parameterization);
+        term.landmark_store_vertex_q_IM__M_p_MI, pose_parameterization);
     problem_information->setParameterization(
-        vertex_q_IM__M_p_MI, pose_parameterization);
+        term.vertex_q_IM__M_p_MI, pose_parameterization);
 
-    if (error_term_type ==
+    if (term.error_term_type ==
         ceres_error_terms::visual::VisualErrorType::kGlobal) {
       problem_information->setParameterization(
-          landmark_store_baseframe_q_GM__G_p_GM, baseframe_parameterization);
+          term.landmark_store_baseframe_q_GM__G_p_GM,
+          baseframe_parameterization);
       problem_information->setParameterization(
-          observer_baseframe_q_GM__G_p_GM, baseframe_parameterization);
+          term.observer_baseframe_q_GM__G_p_GM, baseframe_parameterization);
     }
   }
 
   problem_information->setParameterization(
-      camera_q_CI, camera_parameterization);
+      term.camera_q_CI, camera_parameterization);
 
   if (fix_landmark_positions) {
-    problem_information->setParameterBlockConstant(landmark.get_p_B_Mutable());
+    problem_information->setParameterBlockConstant(term.landmark_p_B);
   }
   if (fix_intrinsics) {
-    problem_information->setParameterBlockConstant(
-        camera_ptr->getParametersMutable());
-    if (camera_ptr->getDistortion().getType() !=
-        aslam::Distortion::Type::kNoDistortion) {
-      problem_information->setParameterBlockConstant(
-          camera_ptr->getDistortionMutable()->getParametersMutable());
+    problem_information->setParameterBlockConstant(term.camera_intrinsics);
+    if (term.camera_distortion != nullptr) {
+      problem_information->setParameterBlockConstant(term.camera_distortion);
     }
   }
   if (fix_extrinsics_rotation) {
-    problem_information->setParameterBlockConstant(camera_q_CI);
+    problem_information->setParameterBlockConstant(term.camera_q_CI);
   }
   if (fix_extrinsics_translation) {
-    problem_information->setParameterBlockConstant(camera_C_p_CI);
+    problem_information->setParameterBlockConstant(term.camera_C_p_CI);
   }
+}
+
+void addVisualTermToProblem(
+    const VisualTerm& term, const bool fix_landmark_positions,
+    const bool fix_intrinsics, const bool fix_extrinsics_rotation,
+    const bool fix_extrinsics_translation,
+    const std::shared_ptr<ceres::LocalParameterization>& pose_parameterization,
+    const std::shared_ptr<ceres::LocalParameterization>&
+        baseframe_parameterization,
+    const std::shared_ptr<ceres::LocalParameterization>&
+        camera_parameterization,
+    OptimizationProblem* problem) {
+  CHECK_NOTNULL(problem);
+  ceres_error_terms::ProblemInformation* problem_information =
+      CHECK_NOTNULL(problem->getProblemInformationMutable());
+
+  setVisualTermParameterProperties(
+      term, fix_landmark_positions, fix_intrinsics, fix_extrinsics_rotation,
+      fix_extrinsics_translation, pose_parameterization,
+      baseframe_parameterization, camera_parameterization,
+      problem_information);
+
+  problem_information->addResidualBlock(
+      ceres_error_terms::ResidualType::kVisualReprojectionError,
+      term.cost_function, term.loss_function, term.cost_term_args);
 
   problem->getProblemBookkeepingMutable()->landmarks_in_problem.emplace(
-      landmark_id, visual_term_cost.get());
+      term.landmark_id, term.cost_function.get());
+}
+}  // namespace
+
+bool addVisualTermForKeypoint(
+    const int keypoint_idx, const int frame_idx,
+    const bool fix_landmark_positions, const bool fix_intrinsics,
+    const bool fix_extrinsics_rotation, const bool fix_extrinsics_translation,
+    const std::shared_ptr<ceres::LocalParameterization>& pose_parameterization,
+    const std::shared_ptr<ceres::LocalParameterization>&
+        baseframe_parameterization,
+    const std::shared_ptr<ceres::LocalParameterization>&
+        camera_parameterization,
+    vi_map::Vertex* vertex_ptr, OptimizationProblem* problem) {
+  CHECK_NOTNULL(vertex_ptr);
+  CHECK_NOTNULL(problem);
+
+  CHECK(pose_parameterization != nullptr);
+  CHECK(baseframe_parameterization != nullptr);
+  CHECK(camera_parameterization != nullptr);
+
+  FrameStates frame_states;
+  getFrameStates(
+      frame_idx, vertex_ptr, problem->getOptimizationStateBufferMutable(),
+      &frame_states);
+  VisualTerm term;
+  createVisualTermForKeypoint(
+      keypoint_idx, frame_idx, *vertex_ptr, frame_states, problem, &term);
+  addVisualTermToProblem(
+      term, fix_landmark_positions, fix_intrinsics, fix_extrinsics_rotation,
+      fix_extrinsics_translation, pose_parameterization,
+      baseframe_parameterization, camera_parameterization, problem);
   return true;
 }
 
@@ -205,70 +325,140 @@ void addVisualTermsForVertices(
   CHECK_NOTNULL(problem);
 
   vi_map::VIMap* map = CHECK_NOTNULL(problem->getMapMutable());
+  OptimizationStateBuffer* buffer =
+      CHECK_NOTNULL(problem->getOptimizationStateBufferMutable());
   const vi_map::MissionIdSet& missions_to_optimize = problem->getMissionIds();
 
-  for (const pose_graph::VertexId& vertex_id : vertices) {
-    vi_map::Vertex& vertex = map->getVertex(vertex_id);
-    const size_t num_frames = vertex.numFrames();
-    for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
-      if (!vertex.isVisualFrameSet(frame_idx) ||
-          !vertex.isVisualFrameValid(frame_idx)) {
-        continue;
-      }
-
-      if (min_landmarks_per_frame > 0) {
-        vi_map_helpers::VIMapQueries queries(*map);
-        const size_t num_frame_good_landmarks =
-            queries.getNumWellConstrainedLandmarks(vertex, frame_idx);
-        if (num_frame_good_landmarks < min_landmarks_per_frame) {
-          VLOG(3) << " Skipping this visual keyframe. Only "
-                  << num_frame_good_landmarks
-                  << " well constrained landmarks, but "
-                  << min_landmarks_per_frame << " required";
-          continue;
-        }
-      }
-      problem->getProblemBookkeepingMutable()->keyframes_in_problem.emplace(
-          vertex_id);
-
-      const aslam::VisualFrame& visual_frame = vertex.getVisualFrame(frame_idx);
-      const size_t num_keypoints = visual_frame.getNumKeypointMeasurements();
-
-      for (size_t keypoint_idx = 0u; keypoint_idx < num_keypoints;
-           ++keypoint_idx) {
-        const vi_map::LandmarkId landmark_id =
-            vertex.getObservedLandmarkId(frame_idx, keypoint_idx);
-        // Invalid landmark_id means that the keypoint is not actually
-        // associated to an existing landmark object.
-        if (!landmark_id.isValid()) {
+  // The cost functions of every vertex are created in parallel into their own
+  // batch, the batches are then added to the problem in the order of the
+  // vertices, such that the problem doesn't depend on the scheduling.
+  const size_t num_vertices = vertices.size();
+  std::vector<std::vector<VisualTerm>> vertex_terms(num_vertices);
+  std::vector<unsigned char> is_keyframe_in_problem(num_vertices, 0u);
+  std::function<void(size_t, size_t)> create_terms = [&](
+      size_t begin, size_t end) {
+    vi_map_helpers::VIMapQueries queries(*map);
+    for (size_t vertex_idx = begin; vertex_idx < end; ++vertex_idx) {
+      vi_map::Vertex& vertex = map->getVertex(vertices[vertex_idx]);
+      std::vector<VisualTerm>& terms = vertex_terms[vertex_idx];
+      const size_t num_frames = vertex.numFrames();
+      for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+        if (!vertex.isVisualFrameSet(frame_idx) ||
+            !vertex.isVisualFrameValid(frame_idx)) {
           continue;
         }
 
-        const vi_map::Vertex& landmark_store_vertex =
-            map->getLandmarkStoreVertex(landmark_id);
-
-        // Skip if the landmark is stored in a mission that should not be
-        // optimized.
-        if (missions_to_optimize.count(landmark_store_vertex.getMissionId()) ==
-            0u) {
-          continue;
+        if (min_landmarks_per_frame > 0) {
+          const size_t num_frame_good_landmarks =
+              queries.getNumWellConstrainedLandmarks(vertex, frame_idx);
+          if (num_frame_good_landmarks < min_landmarks_per_frame) {
+            VLOG(3) << " Skipping this visual keyframe. Only "
+                    << num_frame_good_landmarks
+                    << " well constrained landmarks, but "
+                    << min_landmarks_per_frame << " required";
+            continue;
+          }
         }
-
-        vi_map::Landmark& landmark = map->getLandmark(landmark_id);
-
-        // Skip if the current landmark is not well constrained.
-        if (!vi_map::isLandmarkWellConstrained(*map, landmark)) {
-          continue;
+        is_keyframe_in_problem[vertex_idx] = 1u;
+
+        const aslam::VisualFrame& visual_frame =
+            vertex.getVisualFrame(frame_idx);
+        const size_t num_keypoints = visual_frame.getNumKeypointMeasurements();
+        FrameStates frame_states;
+        getFrameStates(frame_idx, &vertex, buffer, &frame_states);
+
+        for (size_t keypoint_idx = 0u; keypoint_idx < num_keypoints;
+             ++keypoint_idx) {
+          const vi_map::LandmarkId landmark_id =
+              vertex.getObservedLandmarkId(frame_idx, keypoint_idx);
+          // Invalid landmark_id means that the keypoint is not actually
+          // associated to an existing landmark object.
+          if (!landmark_id.isValid()) {
+            continue;
+          }
+
+          const vi_map::Vertex& landmark_store_vertex =
+              map->getLandmarkStoreVertex(landmark_id);
+
+          // Skip if the landmark is stored in a mission that should not be
+          // optimized.
+          if (missions_to_optimize.count(
+                  landmark_store_vertex.getMissionId()) == 0u) {
+            continue;
+          }
+
+          const vi_map::Landmark& landmark = map->getLandmark(landmark_id);
+
+          // Skip if the current landmark is not well constrained.
+          if (!vi_map::isLandmarkWellConstrained(*map, landmark)) {
+            continue;
+          }
+
+          terms.emplace_back();
+          createVisualTermForKeypoint(
+              keypoint_idx, frame_idx, vertex, frame_states, problem,
+              &terms.back());
         }
-
-        addVisualTermForKeypoint(
-            keypoint_idx, frame_idx, fix_landmark_positions, fix_intrinsics,
+      }
+    }
+  };
+  timing::Timer timer_create("BA: Create visual terms");
+  common::ParallelProcessDynamic(
+      num_vertices, create_terms, common::getNumHardwareThreads());
+  timer_create.Stop();
+
+  timing::Timer timer_add("BA: Add visual terms");
+  // Batches of the observations of every landmark in the order of the first
+  // observation.
+  std::vector<LandmarkVisualTermBatch> landmark_batches;
+  std::unordered_map<vi_map::LandmarkId, size_t> landmark_batch_indices;
+  for (size_t vertex_idx = 0u; vertex_idx < num_vertices; ++vertex_idx) {
+    if (is_keyframe_in_problem[vertex_idx] != 0u) {
+      problem->getProblemBookkeepingMutable()->keyframes_in_problem.emplace(
+          vertices[vertex_idx]);
+    }
+    for (const VisualTerm& term : vertex_terms[vertex_idx]) {
+      if (!FLAGS_ba_batch_visual_terms_per_landmark) {
+        addVisualTermToProblem(
+            term, fix_landmark_positions, fix_intrinsics,
             fix_extrinsics_rotation, fix_extrinsics_translation,
             pose_parameterization, baseframe_parameterization,
-            camera_parameterization, &vertex, problem);
+            camera_parameterization, problem);
+        continue;
+      }
+      setVisualTermParameterProperties(
+          term, fix_landmark_positions, fix_intrinsics,
+          fix_extrinsics_rotation, fix_extrinsics_translation,
+          pose_parameterization, baseframe_parameterization,
+          camera_parameterization, problem->getProblemInformationMutable());
+      const std::pair<std::unordered_map<vi_map::LandmarkId, size_t>::iterator,
+                      bool>
+          it_inserted = landmark_batch_indices.emplace(
+              term.landmark_id, landmark_batches.size());
+      if (it_inserted.second) {
+        landmark_batches.emplace_back();
+        landmark_batches.back().landmark_id = term.landmark_id;
+        landmark_batches.back().cost_function.reset(
+            new ceres_error_terms::BatchedVisualReprojectionError);
       }
+      landmark_batches[it_inserted.first->second]
+          .cost_function->addObservation(
+              term.cost_function, term.loss_function, term.cost_term_args);
     }
+    // Release the terms of the vertex right away, they're no longer needed.
+    std::vector<VisualTerm>().swap(vertex_terms[vertex_idx]);
   }
+
+  for (const LandmarkVisualTermBatch& batch : landmark_batches) {
+    // The loss functions of the observations are applied within the batch.
+    problem->getProblemInformationMutable()->addResidualBlock(
+        ceres_error_terms::ResidualType::kVisualReprojectionError,
+        batch.cost_function, std::shared_ptr<ceres::LossFunction>(),
+        batch.cost_function->parameter_blocks());
+    problem->getProblemBookkeepingMutable()->landmarks_in_problem.emplace(
+        batch.landmark_id, batch.cost_function.get());
+  }
+  timer_add.Stop();
 }
 
 void addVisualTerms(
@@ -339,38 +529,84 @@ int addInertialTermsForEdges(
   OptimizationStateBuffer* buffer =
       CHECK_NOTNULL(problem->getOptimizationStateBufferMutable());
 
+  // The inertial error terms integrate the IMU measurements of their edge
+  // on construction, so they are created in parallel and then added to the
+  // problem in the order of the edges.
+  const size_t num_edges = edges.size();
+  std::vector<std::shared_ptr<ceres::CostFunction>> inertial_term_costs(
+      num_edges);
+  std::function<void(size_t, size_t)> create_terms = [&](
+      size_t begin, size_t end) {
+    for (size_t edge_idx = begin; edge_idx < end; ++edge_idx) {
+      const vi_map::ViwlsEdge& inertial_edge =
+          map->getEdgeAs<vi_map::ViwlsEdge>(edges[edge_idx]);
+      if (FLAGS_ba_use_imu_preintegration) {
+        // Preintegrated at the biases of the begin vertex.
+        const vi_map::Vertex& vertex_from =
+            map->getVertex(inertial_edge.from());
+        inertial_term_costs[edge_idx].reset(
+            ceres_error_terms::PreintegratedInertialErrorTerm::Create(
+                inertial_edge.getImuData(), inertial_edge.getImuTimestamps(),
+                imu_sigmas.gyro_noise_density,
+                imu_sigmas.gyro_bias_random_walk_noise_density,
+                imu_sigmas.acc_noise_density,
+                imu_sigmas.acc_bias_random_walk_noise_density,
+                gravity_magnitude, vertex_from.getGyroBias(),
+                vertex_from.getAccelBias()));
+      } else {
+        inertial_term_costs[edge_idx].reset(
+            new ceres_error_terms::InertialErrorTerm(
+                inertial_edge.getImuData(), inertial_edge.getImuTimestamps(),
+                imu_sigmas.gyro_noise_density,
+                imu_sigmas.gyro_bias_random_walk_noise_density,
+                imu_sigmas.acc_noise_density,
+                imu_sigmas.acc_bias_random_walk_noise_density,
+                gravity_magnitude));
+      }
+    }
+  };
+  timing::Timer timer_create("BA: Create inertial terms");
+  common::ParallelProcessDynamic(
+      num_edges, create_terms, common::getNumHardwareThreads());
+  timer_create.Stop();
+
+  timing::Timer timer_add("BA: Add inertial terms");
   int num_residuals_added = 0;
-  for (const pose_graph::EdgeId edge_id : edges) {
+  for (size_t edge_idx = 0u; edge_idx < num_edges; ++edge_idx) {
     const vi_map::ViwlsEdge& inertial_edge =
-        map->getEdgeAs<vi_map::ViwlsEdge>(edge_id);
-
-    std::shared_ptr<ceres_error_terms::InertialErrorTerm> inertial_term_cost(
-        new ceres_error_terms::InertialErrorTerm(
-            inertial_edge.getImuData(), inertial_edge.getImuTimestamps(),
-            imu_sigmas.gyro_noise_density,
-            imu_sigmas.gyro_bias_random_walk_noise_density,
-            imu_sigmas.acc_noise_density,
-            imu_sigmas.acc_bias_random_walk_noise_density, gravity_magnitude));
+        map->getEdgeAs<vi_map::ViwlsEdge>(edges[edge_idx]);
+    const std::shared_ptr<ceres::CostFunction>& inertial_term_cost =
+        inertial_term_costs[edge_idx];
 
-    vi_map::Vertex& vertex_from = map->getVertex(inertial_edge.from());
-    vi_map::Vertex& vertex_to = map->getVertex(inertial_edge.to());
+    const pose_graph::VertexId& vertex_from_id = inertial_edge.from();
+    const pose_graph::VertexId& vertex_to_id = inertial_edge.to();
 
     problem->getProblemBookkeepingMutable()->keyframes_in_problem.emplace(
-        vertex_from.id());
+        vertex_from_id);
     problem->getProblemBookkeepingMutable()->keyframes_in_problem.emplace(
-        vertex_to.id());
+        vertex_to_id);
 
+    const size_t vertex_from_idx = buffer->getVertexIndex(vertex_from_id);
+    const size_t vertex_to_idx = buffer->getVertexIndex(vertex_to_id);
     double* vertex_from_q_IM__M_p_MI =
-        buffer->get_vertex_q_IM__M_p_MI_JPL(inertial_edge.from());
+        buffer->get_vertex_q_IM__M_p_MI_JPL(vertex_from_idx);
     double* vertex_to_q_IM__M_p_MI =
-        buffer->get_vertex_q_IM__M_p_MI_JPL(inertial_edge.to());
+        buffer->get_vertex_q_IM__M_p_MI_JPL(vertex_to_idx);
+    double* vertex_from_gyro_bias =
+        buffer->get_vertex_gyro_bias(vertex_from_idx);
+    double* vertex_to_gyro_bias = buffer->get_vertex_gyro_bias(vertex_to_idx);
+    double* vertex_from_v_M = buffer->get_vertex_v_M(vertex_from_idx);
+    double* vertex_to_v_M = buffer->get_vertex_v_M(vertex_to_idx);
+    double* vertex_from_accel_bias =
+        buffer->get_vertex_accel_bias(vertex_from_idx);
+    double* vertex_to_accel_bias =
+        buffer->get_vertex_accel_bias(vertex_to_idx);
 
     problem->getProblemInformationMutable()->addResidualBlock(
         ceres_error_terms::ResidualType::kInertial, inertial_term_cost, nullptr,
-        {vertex_from_q_IM__M_p_MI, vertex_from.getGyroBiasMutable(),
-         vertex_from.get_v_M_Mutable(), vertex_from.getAccelBiasMutable(),
-         vertex_to_q_IM__M_p_MI, vertex_to.getGyroBiasMutable(),
-         vertex_to.get_v_M_Mutable(), vertex_to.getAccelBiasMutable()});
+        {vertex_from_q_IM__M_p_MI, vertex_from_gyro_bias, vertex_from_v_M,
+         vertex_from_accel_bias, vertex_to_q_IM__M_p_MI, vertex_to_gyro_bias,
+         vertex_to_v_M, vertex_to_accel_bias});
 
     problem->getProblemInformationMutable()->setParameterization(
         vertex_from_q_IM__M_p_MI, pose_parameterization);
@@ -379,25 +615,26 @@ int addInertialTermsForEdges(
 
     if (fix_gyro_bias) {
       problem->getProblemInformationMutable()->setParameterBlockConstant(
-          vertex_to.getGyroBiasMutable());
+          vertex_to_gyro_bias);
       problem->getProblemInformationMutable()->setParameterBlockConstant(
-          vertex_from.getGyroBiasMutable());
+          vertex_from_gyro_bias);
     }
     if (fix_accel_bias) {
       problem->getProblemInformationMutable()->setParameterBlockConstant(
-          vertex_to.getAccelBiasMutable());
+          vertex_to_accel_bias);
       problem->getProblemInformationMutable()->setParameterBlockConstant(
-          vertex_from.getAccelBiasMutable());
+          vertex_from_accel_bias);
     }
     if (fix_velocity) {
       problem->getProblemInformationMutable()->setParameterBlockConstant(
-          vertex_to.get_v_M_Mutable());
+          vertex_to_v_M);
       problem->getProblemInformationMutable()->setParameterBlockConstant(
-          vertex_from.get_v_M_Mutable());
+          vertex_from_v_M);
     }
 
     ++num_residuals_added;
   }
+  timer_add.Stop();
 
   return num_residuals_added;
 }
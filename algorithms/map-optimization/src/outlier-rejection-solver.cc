@@ -1,8 +1,15 @@
 #include "map-optimization/outlier-rejection-solver.h"
 
+#include <vector>
+
 #include <aslam/common/timer.h>
 #include <ceres/ceres.h>
 #include <gflags/gflags.h>
+#include <maplab-common/accessors.h>
+#include <maplab-common/tracing.h>
+
+#include "map-optimization/solver-options.h"
+#include "map-optimization/solver.h"
 
 DEFINE_int32(
     ba_outlier_rejection_reject_every_n_iters, 3,
@@ -107,14 +114,9 @@ void findOutlierLandmarks(
 ceres::TerminationType solveStep(
     const OutlierRejectionSolverOptions& rejection_options,
     const ceres::Solver::Options& solver_options,
-    OptimizationProblem* optimization_problem,
-    OutlierRejectionCallback* callback) {
-  CHECK_NOTNULL(optimization_problem);
+    OutlierRejectionCallback* callback, ceres::Problem* problem) {
   CHECK_NOTNULL(callback);
-
-  ceres::Problem problem(ceres_error_terms::getDefaultProblemOptions());
-  ceres_error_terms::buildCeresProblemFromProblemInformation(
-      optimization_problem->getProblemInformationMutable(), &problem);
+  CHECK_NOTNULL(problem);
 
   ceres::Solver::Options local_options = solver_options;
   local_options.callbacks.push_back(callback);
@@ -129,15 +131,51 @@ ceres::TerminationType solveStep(
   local_options.update_state_every_iteration = true;
 
   ceres::Solver::Summary summary;
-  ceres::Solve(local_options, &problem, &summary);
+  {
+    MAPLAB_TRACE_SCOPE("optimization", "ceres solve");
+    ceres::Solve(local_options, problem, &summary);
+  }
 
   return summary.termination_type;
 }
 
+// Removes the residual block of the given cost function from the problem, as
+// well as all of its parameter blocks that are left without any residuals,
+// such that the problem matches one rebuilt from the active residuals.
+void removeCostFunctionFromProblem(
+    ceres::CostFunction* cost_function,
+    ceres_error_terms::ProblemInformation* problem_information,
+    ceres::Problem* problem) {
+  CHECK_NOTNULL(cost_function);
+  CHECK_NOTNULL(problem_information);
+  CHECK_NOTNULL(problem);
+
+  const ceres_error_terms::ResidualInformation& residual_information =
+      common::getChecked(problem_information->residual_blocks, cost_function);
+  CHECK(residual_information.active_);
+  CHECK_NOTNULL(residual_information.latest_residual_block_id);
+  problem->RemoveResidualBlock(residual_information.latest_residual_block_id);
+
+  std::vector<ceres::ResidualBlockId> remaining_residual_blocks;
+  for (double* parameter_block : residual_information.parameter_blocks) {
+    if (!problem->HasParameterBlock(parameter_block)) {
+      // Already removed, the block appears twice in this residual.
+      continue;
+    }
+    problem->GetResidualBlocksForParameterBlock(
+        parameter_block, &remaining_residual_blocks);
+    if (remaining_residual_blocks.empty()) {
+      problem->RemoveParameterBlock(parameter_block);
+    }
+  }
+  problem_information->deactivateCostFunction(cost_function);
+}
+
 void rejectOutliers(
     const OutlierRejectionSolverOptions& rejection_options,
-    OptimizationProblem* optimization_problem) {
+    OptimizationProblem* optimization_problem, ceres::Problem* problem) {
   CHECK_NOTNULL(optimization_problem);
+  CHECK_NOTNULL(problem);
 
   vi_map::VIMap& map = *optimization_problem->getMapMutable();
 
@@ -165,10 +203,11 @@ void rejectOutliers(
 
   for (const vi_map::LandmarkId& landmark_id : outlier_landmarks) {
     const auto range = landmarks_in_problem.equal_range(landmark_id);
-    // Deactivate all observation constraints of this landmark.
+    // Remove all observation constraints of this landmark in place.
     for (auto it = range.first; it != range.second; ++it) {
-      optimization_problem->getProblemInformationMutable()
-          ->deactivateCostFunction(it->second);
+      removeCostFunctionFromProblem(
+          it->second, optimization_problem->getProblemInformationMutable(),
+          problem);
     }
     landmarks_in_problem.erase(landmark_id);
     map.getLandmark(landmark_id).setQuality(vi_map::Landmark::Quality::kBad);
@@ -214,12 +253,37 @@ ceres::TerminationType solveWithOutlierRejection(
 
   OutlierRejectionCallback callback(solver_options.initial_trust_region_radius);
 
+  // The problem is built once and kept across all rounds, rejected landmarks
+  // are removed from it in place. Together with the state that is updated in
+  // place and the reused trust region radius, every round continues where
+  // the last one stopped.
+  ceres::Problem::Options problem_options =
+      ceres_error_terms::getDefaultProblemOptions();
+  // Removing residual blocks is linear in the problem size otherwise.
+  problem_options.enable_fast_removal = true;
+  ceres::Problem problem(problem_options);
+  {
+    timing::Timer timer_build("BA: Build problem");
+    MAPLAB_TRACE_SCOPE("optimization", "build ceres problem");
+    ceres_error_terms::buildCeresProblemFromProblemInformation(
+        optimization_problem->getProblemInformationMutable(), &problem);
+    timer_build.Stop();
+  }
+
   ceres::TerminationType termination_type =
       ceres::TerminationType::NO_CONVERGENCE;
   for (int i = 0; i < num_outer_iters; ++i) {
+    // The ordering must only contain blocks that are still in the problem,
+    // hence the solver is picked again after every outlier rejection.
+    ceres::Solver::Options round_solver_options = solver_options;
+    if (isAutomaticLinearSolverSelectionEnabled()) {
+      selectLinearSolverForProblem(
+          problem, optimization_problem, &round_solver_options);
+    }
+
     timing::Timer timer_solve("BA: Solve");
     termination_type = solveStep(
-        rejection_options, solver_options, optimization_problem, &callback);
+        rejection_options, round_solver_options, &callback, &problem);
     timer_solve.Stop();
 
     timing::Timer timer_copy("BA: CopyDataToMap");
@@ -228,7 +292,8 @@ ceres::TerminationType solveWithOutlierRejection(
     timer_copy.Stop();
 
     timing::Timer timer_reject("BA: Outlier rejection");
-    rejectOutliers(rejection_options, optimization_problem);
+    MAPLAB_TRACE_SCOPE("optimization", "outlier rejection");
+    rejectOutliers(rejection_options, optimization_problem, &problem);
     timer_reject.Stop();
 
     if (termination_type != ceres::TerminationType::NO_CONVERGENCE) {
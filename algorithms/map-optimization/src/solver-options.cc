@@ -3,3 +3,10 @@
 DEFINE_int32(ba_num_iterations, 30, "Max. number of iterations.");
 DEFINE_bool(ba_use_jacobi_scaling, true, "Use jacobin scaling.");
 DEFINE_bool(ba_use_cgnr_linear_solver, false, "Use CGNR linear solver?");
+DEFINE_string(
+    ba_linear_solver, "auto",
+    "Linear solver of the optimization: auto, sparse_normal_cholesky, "
+    "dense_schur, sparse_schur, iterative_schur or cgnr. auto picks the "
+    "solver, the elimination ordering and the preconditioner from the size "
+    "and sparsity of every problem. Overridden by "
+    "--ba_use_cgnr_linear_solver.");
@@ -1,9 +1,124 @@
 #include "map-optimization/solver.h"
 
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <aslam/common/timer.h>
+#include <ceres-error-terms/common.h>
 #include <ceres-error-terms/problem-information.h>
 #include <ceres/ceres.h>
+#include <maplab-common/tracing.h>
+
+#include "map-optimization/solver-options.h"
 
 namespace map_optimization {
+namespace {
+// Size of the reduced camera system up to which it is factorized densely.
+constexpr int kMaxDenseSchurSize = 2000;
+// Size of the reduced camera system up to which it is factorized sparsely.
+// Beyond, the fill-in of the factorization becomes too expensive.
+constexpr int kMaxSparseSchurSize = 200000;
+// Estimated ratio of non-zero blocks in the reduced camera system above which
+// it is considered to be dense.
+constexpr double kMinDenseFillRatio = 0.25;
+}  // namespace
+
+void selectLinearSolverForProblem(
+    const ceres::Problem& problem,
+    map_optimization::OptimizationProblem* optimization_problem,
+    ceres::Solver::Options* solver_options) {
+  CHECK_NOTNULL(optimization_problem);
+  CHECK_NOTNULL(solver_options);
+  vi_map::VIMap* map = CHECK_NOTNULL(optimization_problem->getMapMutable());
+  const ceres_error_terms::ProblemInformation& problem_information =
+      *CHECK_NOTNULL(optimization_problem->getProblemInformationMutable());
+
+  // Number of visual observations per landmark. A residual block can contain
+  // several observations if the visual terms are batched.
+  std::unordered_map<vi_map::LandmarkId, size_t> landmark_num_observations;
+  for (const std::pair<const vi_map::LandmarkId, ceres::CostFunction*>&
+           landmark_cost : optimization_problem->getProblemBookkeepingMutable()
+                               ->landmarks_in_problem) {
+    landmark_num_observations[landmark_cost.first] +=
+        landmark_cost.second->num_residuals() /
+        ceres_error_terms::visual::kResidualSize;
+  }
+
+  // Landmark blocks which are optimized are eliminated first, all other
+  // blocks form the reduced camera system.
+  std::unordered_set<const double*> landmark_blocks;
+  double sum_squared_num_observations = 0.0;
+  for (const std::pair<const vi_map::LandmarkId, size_t>& landmark_count :
+       landmark_num_observations) {
+    double* p_B = map->getLandmark(landmark_count.first).get_p_B_Mutable();
+    if (problem.HasParameterBlock(p_B) &&
+        !problem_information.isParameterBlockConstant(p_B)) {
+      landmark_blocks.insert(p_B);
+      sum_squared_num_observations +=
+          static_cast<double>(landmark_count.second) * landmark_count.second;
+    }
+  }
+
+  std::vector<double*> parameter_blocks;
+  problem.GetParameterBlocks(&parameter_blocks);
+  int reduced_system_size = 0;
+  for (double* parameter_block : parameter_blocks) {
+    if (landmark_blocks.count(parameter_block) == 0u &&
+        !problem_information.isParameterBlockConstant(parameter_block)) {
+      reduced_system_size += problem.ParameterBlockLocalSize(parameter_block);
+    }
+  }
+
+  if (landmark_blocks.empty()) {
+    solver_options->linear_solver_type = ceres::SPARSE_NORMAL_CHOLESKY;
+    solver_options->linear_solver_ordering.reset();
+    VLOG(1) << "Linear solver: SPARSE_NORMAL_CHOLESKY for a problem without "
+            << "landmarks.";
+    return;
+  }
+
+  // Every landmark couples all of its observers, hence the number of
+  // non-zero blocks of the reduced camera system is at most the sum of the
+  // squared number of observations.
+  const double num_keyframes = std::max<double>(
+      1.0, optimization_problem->getProblemBookkeepingMutable()
+               ->keyframes_in_problem.size());
+  const double fill_ratio = std::min(
+      1.0, sum_squared_num_observations / (num_keyframes * num_keyframes));
+
+  if (reduced_system_size <= kMaxDenseSchurSize ||
+      (fill_ratio >= kMinDenseFillRatio &&
+       reduced_system_size <= 2 * kMaxDenseSchurSize)) {
+    solver_options->linear_solver_type = ceres::DENSE_SCHUR;
+  } else if (reduced_system_size <= kMaxSparseSchurSize) {
+    solver_options->linear_solver_type = ceres::SPARSE_SCHUR;
+  } else {
+    solver_options->linear_solver_type = ceres::ITERATIVE_SCHUR;
+    solver_options->preconditioner_type = ceres::SCHUR_JACOBI;
+  }
+
+  // Eliminate the landmarks first.
+  std::shared_ptr<ceres::ParameterBlockOrdering> ordering =
+      std::make_shared<ceres::ParameterBlockOrdering>();
+  constexpr int kLandmarkGroup = 0;
+  constexpr int kReducedSystemGroup = 1;
+  for (double* parameter_block : parameter_blocks) {
+    ordering->AddElementToGroup(
+        parameter_block, landmark_blocks.count(parameter_block) > 0u
+                             ? kLandmarkGroup
+                             : kReducedSystemGroup);
+  }
+  solver_options->linear_solver_ordering = ordering;
+
+  VLOG(1) << "Linear solver: "
+          << ceres::LinearSolverTypeToString(
+                 solver_options->linear_solver_type)
+          << " for " << landmark_blocks.size() << " landmarks, a reduced "
+          << "system of size " << reduced_system_size << " and a fill ratio of "
+          << fill_ratio << ".";
+}
 
 ceres::TerminationType solve(
     const ceres::Solver::Options& solver_options,
@@ -11,11 +126,27 @@ ceres::TerminationType solve(
   CHECK_NOTNULL(optimization_problem);
 
   ceres::Problem problem(ceres_error_terms::getDefaultProblemOptions());
-  ceres_error_terms::buildCeresProblemFromProblemInformation(
-      optimization_problem->getProblemInformationMutable(), &problem);
+  {
+    MAPLAB_TRACE_SCOPE("optimization", "build ceres problem");
+    timing::Timer timer_build("BA: Build problem");
+    ceres_error_terms::buildCeresProblemFromProblemInformation(
+        optimization_problem->getProblemInformationMutable(), &problem);
+    timer_build.Stop();
+  }
+
+  ceres::Solver::Options problem_solver_options = solver_options;
+  if (isAutomaticLinearSolverSelectionEnabled()) {
+    selectLinearSolverForProblem(
+        problem, optimization_problem, &problem_solver_options);
+  }
 
   ceres::Solver::Summary summary;
-  ceres::Solve(solver_options, &problem, &summary);
+  {
+    MAPLAB_TRACE_SCOPE("optimization", "ceres solve");
+    timing::Timer timer_solve("BA: Solve");
+    ceres::Solve(problem_solver_options, &problem, &summary);
+    timer_solve.Stop();
+  }
 
   optimization_problem->getOptimizationStateBufferMutable()
       ->copyAllStatesBackToMap(optimization_problem->getMapMutable());
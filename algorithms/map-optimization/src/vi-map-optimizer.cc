@@ -1,27 +1,122 @@
 #include "map-optimization/vi-map-optimizer.h"
 
+#include <algorithm>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include <aslam/common/timer.h>
+#include <ceres-error-terms/problem-information.h>
 #include <map-optimization/callbacks.h>
 #include <map-optimization/outlier-rejection-solver.h>
 #include <map-optimization/solver-options.h>
 #include <map-optimization/solver.h>
 #include <map-optimization/vi-optimization-builder.h>
 #include <maplab-common/file-logger.h>
+#include <maplab-common/parallel-process.h>
 #include <maplab-common/progress-bar.h>
+#include <maplab-common/threading-helpers.h>
+#include <maplab-common/tracing.h>
+#include <vi-map-helpers/vi-map-partitioner.h>
 #include <visualization/viwls-graph-plotter.h>
 
 DEFINE_int32(
     ba_visualize_every_n_iterations, 3,
     "Update the visualization every n optimization iterations.");
+DEFINE_string(
+    ba_profiling_csv_file, "",
+    "If set, the wall time, evaluation time, linear solver time, number of "
+    "active residual blocks and cost reduction of every solver iteration are "
+    "written to this CSV file. The iterations are also recorded as trace "
+    "events while tracing is recording.");
+DEFINE_int32(
+    ba_hierarchical_num_threads, 0,
+    "Number of partitions that are solved at the same time by the "
+    "hierarchical optimization, which bounds its memory use. 0 uses the "
+    "number of hardware threads.");
+DEFINE_int32(
+    ba_hierarchical_separator_num_hops, 1,
+    "Number of co-visibility hops around the partition separators that are "
+    "optimized to align the partitions.");
+DEFINE_bool(
+    ba_hierarchical_refine, false,
+    "Solve the full problem after aligning the partitions.");
 
 namespace map_optimization {
+namespace {
+// Vertices that share a landmark or an inertial edge with a vertex of another
+// partition.
+void getSeparatorVertices(
+    const vi_map::VIMap& map,
+    const std::unordered_map<pose_graph::VertexId, size_t>& vertex_partition,
+    pose_graph::VertexIdSet* separator_vertex_ids) {
+  CHECK_NOTNULL(separator_vertex_ids)->clear();
+  vi_map::LandmarkIdList landmark_ids;
+  map.getAllLandmarkIds(&landmark_ids);
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+    const pose_graph::VertexId store_vertex_id =
+        map.getLandmarkStoreVertexId(landmark_id);
+    const std::unordered_map<pose_graph::VertexId, size_t>::const_iterator
+        store_partition = vertex_partition.find(store_vertex_id);
+    if (store_partition == vertex_partition.end()) {
+      continue;
+    }
+    map.getLandmark(landmark_id)
+        .forEachObservation(
+            [&](const vi_map::KeypointIdentifier& keypoint_id) {
+              const pose_graph::VertexId& observer_id =
+                  keypoint_id.frame_id.vertex_id;
+              const std::unordered_map<pose_graph::VertexId,
+                                       size_t>::const_iterator
+                  observer_partition = vertex_partition.find(observer_id);
+              if (observer_partition != vertex_partition.end() &&
+                  observer_partition->second != store_partition->second) {
+                separator_vertex_ids->insert(observer_id);
+                separator_vertex_ids->insert(store_vertex_id);
+              }
+            });
+  }
+
+  pose_graph::EdgeIdList edge_ids;
+  map.getAllEdgeIds(&edge_ids);
+  for (const pose_graph::EdgeId& edge_id : edge_ids) {
+    if (map.getEdgeType(edge_id) != pose_graph::Edge::EdgeType::kViwls) {
+      continue;
+    }
+    const vi_map::ViwlsEdge& edge = map.getEdgeAs<vi_map::ViwlsEdge>(edge_id);
+    const std::unordered_map<pose_graph::VertexId, size_t>::const_iterator
+        from_partition = vertex_partition.find(edge.from());
+    const std::unordered_map<pose_graph::VertexId, size_t>::const_iterator
+        to_partition = vertex_partition.find(edge.to());
+    if (from_partition != vertex_partition.end() &&
+        to_partition != vertex_partition.end() &&
+        from_partition->second != to_partition->second) {
+      separator_vertex_ids->insert(edge.from());
+      separator_vertex_ids->insert(edge.to());
+    }
+  }
+}
+}  // namespace
 
 VIMapOptimizer::VIMapOptimizer(
     visualization::ViwlsGraphRvizPlotter* plotter, bool signal_handler_enabled)
-    : plotter_(plotter), signal_handler_enabled_(signal_handler_enabled) {}
+    : plotter_(plotter),
+      signal_handler_enabled_(signal_handler_enabled),
+      num_solves_(0u) {
+  if (!FLAGS_ba_profiling_csv_file.empty()) {
+    profiling_logger_ =
+        std::make_shared<common::FileLogger>(FLAGS_ba_profiling_csv_file);
+    if (profiling_logger_->isOpen()) {
+      map_optimization::ProfilingCallback::writeCsvHeader(
+          profiling_logger_.get());
+    } else {
+      profiling_logger_.reset();
+    }
+  }
+}
 
 bool VIMapOptimizer::optimizeVisualInertial(
     const map_optimization::ViProblemOptions& options,
@@ -54,11 +149,219 @@ bool VIMapOptimizer::optimizeVisualInertial(
     return false;
   }
 
+  // The setup is timed separately from the solve, such that the cost of
+  // constructing the problem shows up in the timing summary.
+  timing::Timer timer_setup("BA: Setup problem");
   map_optimization::OptimizationProblem::UniquePtr optimization_problem(
       map_optimization::constructViProblem(missions_to_optimize, options, map));
   CHECK(optimization_problem != nullptr);
+  timer_setup.Stop();
+
+  solveProblem(
+      solver_options, outlier_rejection_options, optimization_problem.get());
+  return true;
+}
+
+bool VIMapOptimizer::optimizeVisualInertialLocally(
+    const map_optimization::ViProblemOptions& options,
+    const pose_graph::VertexIdSet& seed_vertex_ids, const int num_hops,
+    const map_optimization::OutlierRejectionSolverOptions* const
+        outlier_rejection_options,
+    vi_map::VIMap* map) {
+  // outlier_rejection_options is optional.
+  CHECK_NOTNULL(map);
+
+  if (seed_vertex_ids.empty()) {
+    LOG(WARNING) << "Nothing to optimize.";
+    return false;
+  }
+
+  timing::Timer timer_setup("BA: Setup problem");
+  map_optimization::OptimizationProblem::UniquePtr optimization_problem(
+      map_optimization::constructLocalViProblem(
+          seed_vertex_ids, num_hops, options, map));
+  CHECK(optimization_problem != nullptr);
+  timer_setup.Stop();
+
+  solveProblem(
+      map_optimization::initSolverOptionsFromFlags(),
+      outlier_rejection_options, optimization_problem.get());
+  return true;
+}
+
+bool VIMapOptimizer::optimizeVisualInertialReduced(
+    const map_optimization::ViProblemOptions& options,
+    const vi_map::MissionIdSet& missions_to_optimize, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+
+  if (missions_to_optimize.empty()) {
+    LOG(WARNING) << "Nothing to optimize.";
+    return false;
+  }
+
+  timing::Timer timer_setup("BA: Setup reduced problem");
+  map_optimization::OptimizationProblem::UniquePtr optimization_problem(
+      map_optimization::constructReducedViProblem(
+          missions_to_optimize, options, map));
+  CHECK(optimization_problem != nullptr);
+  timer_setup.Stop();
+
+  // The landmarks are not part of the problem, hence there is nothing to
+  // reject.
+  const ceres::Solver::Options solver_options =
+      map_optimization::initSolverOptionsFromFlags();
+  solveProblem(solver_options, nullptr, optimization_problem.get());
+  optimization_problem.reset();
+
+  if (options.fix_landmark_positions) {
+    return true;
+  }
+
+  timing::Timer timer_back_substitution("BA: Setup landmark back-substitution");
+  map_optimization::OptimizationProblem::UniquePtr back_substitution_problem(
+      map_optimization::constructLandmarkBackSubstitutionProblem(
+          missions_to_optimize, map));
+  CHECK(back_substitution_problem != nullptr);
+  timer_back_substitution.Stop();
+
+  solveProblem(solver_options, nullptr, back_substitution_problem.get());
+  return true;
+}
+
+bool VIMapOptimizer::optimizeVisualInertialHierarchically(
+    const map_optimization::ViProblemOptions& options,
+    const vi_map::MissionIdSet& missions_to_optimize,
+    const unsigned int num_partitions,
+    const map_optimization::OutlierRejectionSolverOptions* const
+        outlier_rejection_options,
+    vi_map::VIMap* map) {
+  // outlier_rejection_options is optional.
+  CHECK_NOTNULL(map);
+  CHECK_GT(num_partitions, 0u);
+
+  if (missions_to_optimize.empty()) {
+    LOG(WARNING) << "Nothing to optimize.";
+    return false;
+  }
+
+  std::vector<pose_graph::VertexIdList> metis_partitioning;
+  vi_map_helpers::VIMapPartitioner partitioner;
+  partitioner.partitionMapWithMetis(*map, num_partitions, &metis_partitioning);
+
+  // Only keep the vertices of the missions to optimize.
+  std::vector<pose_graph::VertexIdSet> partitions;
+  std::unordered_map<pose_graph::VertexId, size_t> vertex_partition;
+  for (const pose_graph::VertexIdList& metis_partition : metis_partitioning) {
+    pose_graph::VertexIdSet partition;
+    for (const pose_graph::VertexId& vertex_id : metis_partition) {
+      if (missions_to_optimize.count(map->getMissionIdForVertex(vertex_id)) >
+          0u) {
+        partition.insert(vertex_id);
+        vertex_partition.emplace(vertex_id, partitions.size());
+      }
+    }
+    if (!partition.empty()) {
+      partitions.emplace_back(std::move(partition));
+    }
+  }
+  LOG(INFO) << "Optimizing " << partitions.size() << " partitions.";
+
+  // Every partition problem only holds the landmarks stored in its partition
+  // and reads all other states from its own buffer, so the solves only touch
+  // disjoint parts of the map. Building the problems and copying the states
+  // back reads and writes vertex states of the map and is serialized. The
+  // camera calibration is shared by all partitions and thus kept fixed.
+  map_optimization::ViProblemOptions partition_options = options;
+  partition_options.fix_intrinsics = true;
+  partition_options.fix_extrinsics_rotation = true;
+  partition_options.fix_extrinsics_translation = true;
+  // Counting the well constrained landmarks of a frame reads landmarks of
+  // other partitions.
+  partition_options.min_landmarks_per_frame = 0u;
+
+  ceres::Solver::Options partition_solver_options =
+      map_optimization::initSolverOptionsFromFlags();
+  partition_solver_options.num_threads = 1;
+  partition_solver_options.minimizer_progress_to_stdout = false;
+
+  std::mutex map_mutex;
+  std::function<void(size_t, size_t)> solve_partitions =
+      [&](const size_t begin, const size_t end) {
+        for (size_t partition_idx = begin; partition_idx < end;
+             ++partition_idx) {
+          const pose_graph::VertexIdSet& partition = partitions[partition_idx];
+          map_optimization::OptimizationProblem::UniquePtr
+              optimization_problem;
+          {
+            std::lock_guard<std::mutex> lock(map_mutex);
+            optimization_problem.reset(
+                map_optimization::constructPartitionViProblem(
+                    partition, partition_options, map));
+          }
+          CHECK(optimization_problem != nullptr);
+
+          ceres::Problem problem(ceres_error_terms::getDefaultProblemOptions());
+          ceres_error_terms::buildCeresProblemFromProblemInformation(
+              optimization_problem->getProblemInformationMutable(), &problem);
+          ceres::Solver::Summary summary;
+          ceres::Solve(partition_solver_options, &problem, &summary);
+          VLOG(1) << "Partition " << partition_idx << " with "
+                  << partition.size() << " vertices: "
+                  << summary.BriefReport();
+
+          std::lock_guard<std::mutex> lock(map_mutex);
+          optimization_problem->getOptimizationStateBufferMutable()
+              ->copyKeyframeStatesBackToMap(partition, map);
+        }
+      };
+  const size_t num_threads =
+      FLAGS_ba_hierarchical_num_threads > 0
+          ? static_cast<size_t>(FLAGS_ba_hierarchical_num_threads)
+          : common::getNumHardwareThreads();
+  common::ParallelProcessDynamic(
+      partitions.size(), solve_partitions, num_threads,
+      common::ParallelSchedule::kDynamic);
+
+  // Align the partitions by optimizing the neighborhood of their separators.
+  pose_graph::VertexIdSet separator_vertex_ids;
+  getSeparatorVertices(*map, vertex_partition, &separator_vertex_ids);
+  if (!separator_vertex_ids.empty()) {
+    LOG(INFO) << "Aligning the partitions along " << separator_vertex_ids.size()
+              << " separator vertices.";
+    map_optimization::OptimizationProblem::UniquePtr optimization_problem(
+        map_optimization::constructLocalViProblem(
+            separator_vertex_ids, FLAGS_ba_hierarchical_separator_num_hops,
+            options, map));
+    CHECK(optimization_problem != nullptr);
+    solveProblem(
+        map_optimization::initSolverOptionsFromFlags(),
+        outlier_rejection_options, optimization_problem.get());
+  }
+
+  if (FLAGS_ba_hierarchical_refine) {
+    LOG(INFO) << "Refining the full problem.";
+    return optimizeVisualInertial(
+        options, missions_to_optimize, outlier_rejection_options, map);
+  }
+  return true;
+}
+
+void VIMapOptimizer::solveProblem(
+    const ceres::Solver::Options& solver_options,
+    const map_optimization::OutlierRejectionSolverOptions* const
+        outlier_rejection_options,
+    map_optimization::OptimizationProblem* optimization_problem) {
+  CHECK_NOTNULL(optimization_problem);
+  vi_map::VIMap* map = optimization_problem->getMapMutable();
 
   std::vector<std::shared_ptr<ceres::IterationCallback>> callbacks;
+  // Added first, such that the time spent in the other callbacks is not
+  // attributed to the next iteration.
+  if (profiling_logger_ != nullptr || common::tracing::isRecording()) {
+    map_optimization::appendProfilingCallback(
+        *optimization_problem->getProblemInformationMutable(), num_solves_++,
+        profiling_logger_, &callbacks);
+  }
   if (plotter_) {
     map_optimization::appendVisualizationCallbacks(
         FLAGS_ba_visualize_every_n_iterations,
@@ -73,16 +376,15 @@ bool VIMapOptimizer::optimizeVisualInertial(
   if (outlier_rejection_options != nullptr) {
     map_optimization::solveWithOutlierRejection(
         solver_options_with_callbacks, *outlier_rejection_options,
-        optimization_problem.get());
+        optimization_problem);
   } else {
     map_optimization::solve(
-        solver_options_with_callbacks, optimization_problem.get());
+        solver_options_with_callbacks, optimization_problem);
   }
 
   if (plotter_ != nullptr) {
     plotter_->visualizeMap(*map);
   }
-  return true;
 }
 
 }  // namespace map_optimization
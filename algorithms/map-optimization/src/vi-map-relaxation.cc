@@ -1,18 +1,47 @@
 #include "map-optimization/vi-map-relaxation.h"
 
+#include <algorithm>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include <aslam/common/timer.h>
+#include <ceres-error-terms/six-dof-block-pose-error-term-autodiff.h>
+#include <gflags/gflags.h>
 #include <loop-closure-handler/loop-detector-node.h>
 #include <map-optimization/augment-loopclosure.h>
 #include <map-optimization/callbacks.h>
+#include <map-optimization/optimization-state-fixing.h>
 #include <map-optimization/outlier-rejection-solver.h>
 #include <map-optimization/solver-options.h>
 #include <map-optimization/solver.h>
 #include <map-optimization/vi-optimization-builder.h>
 #include <maplab-common/file-logger.h>
+#include <maplab-common/parallel-process.h>
 #include <maplab-common/progress-bar.h>
+#include <maplab-common/threading-helpers.h>
+
+DEFINE_bool(
+    relax_pose_graph_only, true,
+    "Relax only the pose graph of the keyframes, i.e. the relative poses "
+    "between consecutive keyframes and the loop closure edges, instead of the "
+    "full visual-inertial problem with fixed landmarks and IMU states.");
+DEFINE_double(
+    relax_odometry_position_sigma_m, 0.05,
+    "Standard deviation of the relative position between consecutive "
+    "keyframes in the pose graph relaxation.");
+DEFINE_double(
+    relax_odometry_orientation_sigma_rad, 0.005,
+    "Standard deviation of the relative orientation between consecutive "
+    "keyframes in the pose graph relaxation.");
+DEFINE_int32(
+    relax_missions_num_parallel, 0,
+    "Number of missions that relax_missions_independently solves at the same "
+    "time. The solver threads are split among them. 0 uses one mission per "
+    "solver thread.");
 
 namespace visualization {
 class ViwlsGraphRvizPlotter;
@@ -20,6 +49,188 @@ class ViwlsGraphRvizPlotter;
 
 namespace map_optimization {
 
+namespace {
+// Constrains every pair of consecutive keyframes of the missions to their
+// current relative pose, which is the odometry the loop closures correct.
+void addOdometryPoseGraphTerms(OptimizationProblem* problem) {
+  CHECK_NOTNULL(problem);
+  CHECK_GT(FLAGS_relax_odometry_position_sigma_m, 0.0);
+  CHECK_GT(FLAGS_relax_odometry_orientation_sigma_rad, 0.0);
+
+  const vi_map::VIMap& map = *CHECK_NOTNULL(problem->getMapMutable());
+  OptimizationStateBuffer* buffer =
+      CHECK_NOTNULL(problem->getOptimizationStateBufferMutable());
+  ceres_error_terms::ProblemInformation* problem_information =
+      CHECK_NOTNULL(problem->getProblemInformationMutable());
+  const std::shared_ptr<ceres::LocalParameterization>& pose_parameterization =
+      problem->getLocalParameterizations().pose_parameterization;
+
+  Eigen::Matrix<double, 6, 6> T_A_B_covariance =
+      Eigen::Matrix<double, 6, 6>::Zero();
+  T_A_B_covariance.diagonal().head<3>().setConstant(
+      FLAGS_relax_odometry_position_sigma_m *
+      FLAGS_relax_odometry_position_sigma_m);
+  T_A_B_covariance.diagonal().tail<3>().setConstant(
+      FLAGS_relax_odometry_orientation_sigma_rad *
+      FLAGS_relax_odometry_orientation_sigma_rad);
+
+  OptimizationProblem::ProblemBookkeeping* bookkeeping =
+      problem->getProblemBookkeepingMutable();
+  size_t num_residual_blocks_added = 0u;
+  for (const vi_map::MissionId& mission_id : problem->getMissionIds()) {
+    pose_graph::VertexIdList vertex_ids;
+    map.getAllVertexIdsInMissionAlongGraph(mission_id, &vertex_ids);
+    if (vertex_ids.size() < 2u) {
+      continue;
+    }
+
+    // The error terms only read the map, hence they are created in parallel
+    // and added in the order of the vertices.
+    const size_t num_terms = vertex_ids.size() - 1u;
+    std::vector<std::shared_ptr<ceres::CostFunction>> odometry_costs(
+        num_terms);
+    std::function<void(size_t, size_t)> create_odometry_costs =
+        [&](size_t begin, size_t end) {
+          for (size_t idx = begin; idx < end; ++idx) {
+            const pose::Transformation T_A_B =
+                map.getVertex(vertex_ids[idx]).get_T_M_I().inverse() *
+                map.getVertex(vertex_ids[idx + 1u]).get_T_M_I();
+            odometry_costs[idx].reset(
+                new ceres::AutoDiffCostFunction<
+                    ceres_error_terms::SixDoFBlockPoseErrorTerm,
+                    ceres_error_terms::SixDoFBlockPoseErrorTerm::
+                        residualBlockSize,
+                    ceres_error_terms::poseblocks::kPoseSize,
+                    ceres_error_terms::poseblocks::kPoseSize>(
+                    new ceres_error_terms::SixDoFBlockPoseErrorTerm(
+                        T_A_B, T_A_B_covariance)));
+          }
+        };
+    common::ParallelProcessDynamic(
+        num_terms, create_odometry_costs, common::getNumHardwareThreads());
+
+    for (size_t idx = 0u; idx < num_terms; ++idx) {
+      // The keyframe poses in the buffer are [q_M_I_xyzw, M_p_MI] as the
+      // passive JPL rotation equals the active Hamilton one.
+      double* vertex_from_q_IM__M_p_MI =
+          buffer->get_vertex_q_IM__M_p_MI_JPL(vertex_ids[idx]);
+      double* vertex_to_q_IM__M_p_MI =
+          buffer->get_vertex_q_IM__M_p_MI_JPL(vertex_ids[idx + 1u]);
+      problem_information->addResidualBlock(
+          ceres_error_terms::ResidualType::kOdometry, odometry_costs[idx],
+          nullptr, {vertex_from_q_IM__M_p_MI, vertex_to_q_IM__M_p_MI});
+      problem_information->setParameterization(
+          vertex_from_q_IM__M_p_MI, pose_parameterization);
+      problem_information->setParameterization(
+          vertex_to_q_IM__M_p_MI, pose_parameterization);
+      bookkeeping->keyframes_in_problem.emplace(vertex_ids[idx]);
+      bookkeeping->keyframes_in_problem.emplace(vertex_ids[idx + 1u]);
+      ++num_residual_blocks_added;
+    }
+  }
+
+  VLOG(1) << "Added " << num_residual_blocks_added
+          << " odometry pose graph error terms.";
+}
+
+// Holds the first keyframe of every mission cluster fixed. Unlike in the
+// visual-inertial problem, the gravity direction is not observable from the
+// pose graph, hence the rotation is fixed as well.
+void fixPoseGraphGauge(OptimizationProblem* problem) {
+  CHECK_NOTNULL(problem);
+  const vi_map::VIMap& map = *CHECK_NOTNULL(problem->getMapMutable());
+  OptimizationStateBuffer* buffer =
+      CHECK_NOTNULL(problem->getOptimizationStateBufferMutable());
+  const OptimizationProblem::ProblemBookkeeping& bookkeeping =
+      *problem->getProblemBookkeepingMutable();
+
+  for (const vi_map::MissionIdSet& cluster_mission_ids :
+       problem->getMissionCoobservationClusters()) {
+    CHECK(!cluster_mission_ids.empty());
+    const vi_map::MissionId& first_mission_id = *cluster_mission_ids.begin();
+    pose_graph::VertexIdList vertex_ids;
+    map.getAllVertexIdsInMissionAlongGraph(first_mission_id, &vertex_ids);
+    for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+      if (bookkeeping.keyframes_in_problem.count(vertex_id) > 0u) {
+        problem->getProblemInformationMutable()->setParameterBlockConstant(
+            buffer->get_vertex_q_IM__M_p_MI_JPL(vertex_id));
+        break;
+      }
+    }
+  }
+}
+
+// Caller takes ownership.
+OptimizationProblem* constructViRelaxationProblem(
+    const vi_map::MissionIdSet& mission_ids, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  map_optimization::ViProblemOptions options =
+      map_optimization::ViProblemOptions::initFromGFlags();
+
+  // Specific relaxation options.
+  options.fix_accel_bias = true;
+  options.fix_gyro_bias = true;
+  options.fix_velocity = true;
+
+  options.fix_intrinsics = true;
+  options.fix_extrinsics_rotation = true;
+  options.fix_extrinsics_translation = true;
+  options.fix_landmark_positions = true;
+
+  OptimizationProblem* problem =
+      map_optimization::constructViProblem(mission_ids, options, map);
+  CHECK_NOTNULL(problem);
+
+  augmentViProblemWithLoopclosureEdges(problem);
+  return problem;
+}
+
+// Caller takes ownership. The problem only holds the keyframe poses, which
+// makes it an order of magnitude smaller than the visual-inertial problem.
+// With the default automatic linear solver selection it is solved with a
+// sparse Cholesky factorization of the normal equations.
+OptimizationProblem* constructPoseGraphProblem(
+    const vi_map::MissionIdSet& mission_ids, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  OptimizationProblem* problem = new OptimizationProblem(map, mission_ids);
+  addOdometryPoseGraphTerms(problem);
+  augmentViProblemWithLoopclosureEdges(problem);
+  fixPoseGraphGauge(problem);
+  fixAllBaseframesInProblem(problem);
+  return problem;
+}
+
+// Caller takes ownership.
+OptimizationProblem* constructRelaxationProblem(
+    const vi_map::MissionIdSet& mission_ids, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  if (FLAGS_relax_pose_graph_only) {
+    return constructPoseGraphProblem(mission_ids, map);
+  }
+  return constructViRelaxationProblem(mission_ids, map);
+}
+
+// Counts the loop closure edges between two vertices of the same mission.
+void countLoopclosureEdgesWithinMissions(
+    const vi_map::VIMap& map,
+    std::unordered_map<vi_map::MissionId, int>* num_lc_edges_of_missions) {
+  CHECK_NOTNULL(num_lc_edges_of_missions)->clear();
+  pose_graph::EdgeIdList edges;
+  map.getAllEdgeIds(&edges);
+  for (const pose_graph::EdgeId& edge_id : edges) {
+    if (map.getEdgeType(edge_id) != pose_graph::Edge::EdgeType::kLoopClosure) {
+      continue;
+    }
+    const vi_map::Edge& edge = map.getEdgeAs<vi_map::Edge>(edge_id);
+    const vi_map::MissionId& mission_id =
+        map.getMissionIdForVertex(edge.from());
+    if (mission_id == map.getMissionIdForVertex(edge.to())) {
+      ++(*num_lc_edges_of_missions)[mission_id];
+    }
+  }
+}
+}  // namespace
+
 VIMapRelaxation::VIMapRelaxation(
     visualization::ViwlsGraphRvizPlotter* plotter, bool signal_handler_enabled)
     : plotter_(plotter), signal_handler_enabled_(signal_handler_enabled) {}
@@ -100,24 +311,11 @@ bool VIMapRelaxation::relax(
   }
   LOG(INFO) << num_lc_edges << " loopclosure edges found.";
 
-  map_optimization::ViProblemOptions options =
-      map_optimization::ViProblemOptions::initFromGFlags();
-
-  // Specific relaxation options.
-  options.fix_accel_bias = true;
-  options.fix_gyro_bias = true;
-  options.fix_velocity = true;
-
-  options.fix_intrinsics = true;
-  options.fix_extrinsics_rotation = true;
-  options.fix_extrinsics_translation = true;
-  options.fix_landmark_positions = true;
-
-  map_optimization::OptimizationProblem* optimization_problem =
-      map_optimization::constructViProblem(mission_ids, options, map);
-  CHECK_NOTNULL(optimization_problem);
-
-  augmentViProblemWithLoopclosureEdges(optimization_problem);
+  timing::Timer timer_setup("Relaxation: Setup problem");
+  OptimizationProblem::UniquePtr optimization_problem(
+      constructRelaxationProblem(mission_ids, map));
+  CHECK(optimization_problem != nullptr);
+  timer_setup.Stop();
 
   std::vector<std::shared_ptr<ceres::IterationCallback>> callbacks;
   map_optimization::appendSignalHandlerCallback(&callbacks);
@@ -133,7 +331,8 @@ bool VIMapRelaxation::relax(
   map_optimization::addCallbacksToSolverOptions(
       callbacks, &solver_options_with_callbacks);
 
-  map_optimization::solve(solver_options_with_callbacks, optimization_problem);
+  map_optimization::solve(
+      solver_options_with_callbacks, optimization_problem.get());
 
   visualizePosegraph(*map);
 
@@ -148,4 +347,92 @@ bool VIMapRelaxation::relax(
   return true;
 }
 
+bool VIMapRelaxation::relaxMissionsIndependently(
+    const vi_map::MissionIdList& mission_id_list, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  CHECK_GE(FLAGS_relax_missions_num_parallel, 0);
+
+  // The loop detection adds the edges to the map and hence runs mission by
+  // mission before the solves.
+  for (const vi_map::MissionId& mission_id : mission_id_list) {
+    detectLoopclosures({mission_id}, map);
+  }
+
+  std::unordered_map<vi_map::MissionId, int> num_lc_edges_of_missions;
+  countLoopclosureEdgesWithinMissions(*map, &num_lc_edges_of_missions);
+  vi_map::MissionIdList missions_to_relax;
+  for (const vi_map::MissionId& mission_id : mission_id_list) {
+    const int num_lc_edges = num_lc_edges_of_missions[mission_id];
+    if (num_lc_edges == 0) {
+      LOG(WARNING) << "No loop closure edges found in mission " << mission_id
+                   << ", it is not relaxed.";
+      continue;
+    }
+    LOG(INFO) << num_lc_edges << " loopclosure edges found in mission "
+              << mission_id << '.';
+    missions_to_relax.push_back(mission_id);
+  }
+  if (missions_to_relax.empty()) {
+    map->removeLoopClosureEdges();
+    return false;
+  }
+
+  // Split the solver threads among the missions that are solved at the same
+  // time.
+  ceres::Solver::Options solver_options =
+      map_optimization::initSolverOptionsFromFlags();
+  const size_t num_solver_threads =
+      static_cast<size_t>(std::max(solver_options.num_threads, 1));
+  const size_t num_parallel_missions = std::min(
+      missions_to_relax.size(),
+      FLAGS_relax_missions_num_parallel > 0
+          ? static_cast<size_t>(FLAGS_relax_missions_num_parallel)
+          : num_solver_threads);
+  solver_options.num_threads = static_cast<int>(
+      std::max<size_t>(num_solver_threads / num_parallel_missions, 1u));
+  solver_options.minimizer_progress_to_stdout = false;
+  LOG(INFO) << "Relaxing " << missions_to_relax.size() << " missions, "
+            << num_parallel_missions << " at a time with "
+            << solver_options.num_threads << " solver threads each.";
+
+  // Every problem only holds the states of its mission and the solves only
+  // touch the state buffers of the problems. Building the problems reads
+  // the shared pose graph and copying the states back writes it, hence both
+  // are serialized. The visualization and signal handler callbacks are not
+  // used as they are not safe to run for several solves at once.
+  std::mutex map_mutex;
+  std::function<void(size_t, size_t)> relax_missions =
+      [&](const size_t begin, const size_t end) {
+        for (size_t mission_idx = begin; mission_idx < end; ++mission_idx) {
+          const vi_map::MissionIdSet mission_ids{
+              missions_to_relax[mission_idx]};
+          OptimizationProblem::UniquePtr optimization_problem;
+          {
+            std::lock_guard<std::mutex> lock(map_mutex);
+            optimization_problem.reset(
+                constructRelaxationProblem(mission_ids, map));
+          }
+          CHECK(optimization_problem != nullptr);
+
+          map_optimization::solve(solver_options, optimization_problem.get());
+
+          std::lock_guard<std::mutex> lock(map_mutex);
+          optimization_problem->getOptimizationStateBufferMutable()
+              ->copyAllStatesBackToMap(map);
+        }
+      };
+  common::ParallelProcessDynamic(
+      missions_to_relax.size(), relax_missions, num_parallel_missions,
+      common::ParallelSchedule::kDynamic);
+
+  visualizePosegraph(*map);
+
+  const size_t number_of_loop_closure_edges_removed =
+      map->removeLoopClosureEdges();
+  LOG(INFO) << "Removed " << number_of_loop_closure_edges_removed
+            << " loop closures edges.";
+
+  return true;
+}
+
 }  // namespace map_optimization
@@ -1,8 +1,15 @@
 #include "map-optimization/vi-optimization-builder.h"
 
+#include <unordered_map>
+#include <utility>
+
 #include <gflags/gflags.h>
+#include <maplab-common/memory-budget.h>
+#include <maplab-common/tracing.h>
 #include <vi-map-helpers/mission-clustering-coobservation.h>
+#include <vi-map/landmark-quality-metrics.h>
 
+#include "map-optimization/landmark-elimination.h"
 #include "map-optimization/optimization-state-fixing.h"
 
 DEFINE_bool(
@@ -44,8 +51,271 @@ DEFINE_int32(
     "Minimum number of landmarks a frame must observe to be included in the "
     "problem.");
 
+DEFINE_int32(
+    ba_reduced_min_common_landmarks, 5,
+    "Minimum number of landmarks a store vertex and an observer must share to "
+    "be constrained by the reduced visual-inertial problem.");
+
 namespace map_optimization {
 
+namespace {
+// Rough memory of the problem per vertex, i.e. its states and inertial term,
+// and per keypoint, i.e. its visual term and the residual block in ceres.
+constexpr size_t kEstimatedProblemBytesPerVertex = 1024u;
+constexpr size_t kEstimatedProblemBytesPerKeypoint = 512u;
+
+size_t estimateViProblemBytes(
+    const vi_map::MissionIdSet& mission_ids, const vi_map::VIMap& map) {
+  size_t num_bytes = 0u;
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    pose_graph::VertexIdList vertex_ids;
+    map.getAllVertexIdsInMission(mission_id, &vertex_ids);
+    for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+      const vi_map::Vertex& vertex = map.getVertex(vertex_id);
+      num_bytes += kEstimatedProblemBytesPerVertex;
+      for (size_t frame_idx = 0u; frame_idx < vertex.numFrames(); ++frame_idx) {
+        if (vertex.isVisualFrameSet(frame_idx)) {
+          num_bytes += kEstimatedProblemBytesPerKeypoint *
+                       vertex.getVisualFrame(frame_idx)
+                           .getNumKeypointMeasurements();
+        }
+      }
+    }
+  }
+  return num_bytes;
+}
+
+void applyViGaugeFixes(
+    const ViProblemOptions& options, OptimizationProblem* problem) {
+  CHECK_NOTNULL(problem);
+
+  // Fixing open DoF of the visual(-inertial) problem. We assume that if there
+  // is inertial data, that all missions will have them.
+  const bool visual_only =
+      options.add_visual_constraints && !options.add_inertial_constraints;
+
+  // Determine and apply the gauge fixes.
+  MissionClusterGaugeFixes fixes_of_mission_cluster;
+  if (!visual_only) {
+    fixes_of_mission_cluster.position_dof_fixed = true;
+    fixes_of_mission_cluster.rotation_dof_fixed = FixedRotationDoF::kYaw;
+    fixes_of_mission_cluster.scale_fixed = false;
+  } else {
+    fixes_of_mission_cluster.position_dof_fixed = true;
+    fixes_of_mission_cluster.rotation_dof_fixed = FixedRotationDoF::kAll;
+    fixes_of_mission_cluster.scale_fixed = true;
+  }
+  const size_t num_clusters = problem->getMissionCoobservationClusters().size();
+  std::vector<MissionClusterGaugeFixes> vi_cluster_fixes(
+      num_clusters, fixes_of_mission_cluster);
+
+  // Merge with already applied fixes (if necessary).
+  const std::vector<MissionClusterGaugeFixes>* already_applied_cluster_fixes =
+      problem->getAppliedGaugeFixesForInitialVertices();
+  if (already_applied_cluster_fixes) {
+    std::vector<MissionClusterGaugeFixes> merged_fixes;
+    mergeGaugeFixes(
+        vi_cluster_fixes, *already_applied_cluster_fixes, &merged_fixes);
+    problem->applyGaugeFixesForInitialVertices(merged_fixes);
+  } else {
+    problem->applyGaugeFixesForInitialVertices(vi_cluster_fixes);
+  }
+}
+
+// Adds all vertices that observe a landmark seen by any of the given vertices.
+void addCovisibleVertices(
+    const vi_map::VIMap& map, const pose_graph::VertexIdSet& vertex_ids,
+    pose_graph::VertexIdSet* covisible_vertex_ids) {
+  CHECK_NOTNULL(covisible_vertex_ids);
+  vi_map::LandmarkIdSet landmark_ids;
+  map.getAllLandmarkIdsObservedAtVertices(vertex_ids, &landmark_ids);
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+    map.getLandmark(landmark_id)
+        .forEachObservation(
+            [covisible_vertex_ids](
+                const vi_map::KeypointIdentifier& keypoint_id) {
+              covisible_vertex_ids->insert(keypoint_id.frame_id.vertex_id);
+            });
+  }
+}
+
+// Adds the visual terms of the vertex for the given landmarks only, such that
+// the vertices at the boundary of a window don't pull further landmarks into
+// the problem.
+void addVisualTermsOfVertexForLandmarks(
+    const ViProblemOptions& options, const vi_map::LandmarkIdSet& landmark_ids,
+    vi_map::Vertex* vertex, OptimizationProblem* problem) {
+  CHECK_NOTNULL(vertex);
+  CHECK_NOTNULL(problem);
+  const vi_map::VIMap& map = *problem->getMapMutable();
+  const OptimizationProblem::LocalParameterizations& parameterizations =
+      problem->getLocalParameterizations();
+
+  const size_t num_frames = vertex->numFrames();
+  for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+    if (!vertex->isVisualFrameSet(frame_idx) ||
+        !vertex->isVisualFrameValid(frame_idx)) {
+      continue;
+    }
+    if (options.min_landmarks_per_frame > 0) {
+      vi_map_helpers::VIMapQueries queries(map);
+      if (queries.getNumWellConstrainedLandmarks(*vertex, frame_idx) <
+          options.min_landmarks_per_frame) {
+        continue;
+      }
+    }
+
+    const size_t num_keypoints =
+        vertex->getVisualFrame(frame_idx).getNumKeypointMeasurements();
+    for (size_t keypoint_idx = 0u; keypoint_idx < num_keypoints;
+         ++keypoint_idx) {
+      const vi_map::LandmarkId landmark_id =
+          vertex->getObservedLandmarkId(frame_idx, keypoint_idx);
+      if (!landmark_id.isValid() || landmark_ids.count(landmark_id) == 0u ||
+          !vi_map::isLandmarkWellConstrained(
+              map, map.getLandmark(landmark_id))) {
+        continue;
+      }
+      addVisualTermForKeypoint(
+          keypoint_idx, frame_idx, options.fix_landmark_positions,
+          options.fix_intrinsics, options.fix_extrinsics_rotation,
+          options.fix_extrinsics_translation,
+          parameterizations.pose_parameterization,
+          parameterizations.baseframe_parameterization,
+          parameterizations.quaternion_parameterization, vertex, problem);
+      problem->getProblemBookkeepingMutable()->keyframes_in_problem.emplace(
+          vertex->id());
+    }
+  }
+}
+
+// Builds a problem that optimizes the window vertices and the window
+// landmarks. All other vertices that observe or store a window landmark or
+// are connected to the window by an inertial edge are added as fixed
+// boundary, which also fixes the gauge of the window.
+OptimizationProblem* constructWindowViProblem(
+    const pose_graph::VertexIdSet& window_vertex_ids,
+    const vi_map::LandmarkIdSet& window_landmark_ids,
+    const ViProblemOptions& options, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  CHECK(options.isValid());
+
+  LOG_IF(
+      FATAL,
+      !options.add_visual_constraints && !options.add_inertial_constraints)
+      << "Either enable visual or inertial constraints; otherwise don't call "
+      << "this function.";
+
+  pose_graph::VertexIdSet boundary_vertex_ids;
+  if (options.add_visual_constraints) {
+    for (const vi_map::LandmarkId& landmark_id : window_landmark_ids) {
+      const vi_map::Landmark& landmark = map->getLandmark(landmark_id);
+      landmark.forEachObservation(
+          [&boundary_vertex_ids](
+              const vi_map::KeypointIdentifier& keypoint_id) {
+            boundary_vertex_ids.insert(keypoint_id.frame_id.vertex_id);
+          });
+      boundary_vertex_ids.insert(map->getLandmarkStoreVertexId(landmark_id));
+    }
+  }
+  std::unordered_map<vi_map::MissionId, pose_graph::EdgeIdList>
+      inertial_edges_of_mission;
+  if (options.add_inertial_constraints) {
+    pose_graph::EdgeIdSet window_edge_ids;
+    for (const pose_graph::VertexId& vertex_id : window_vertex_ids) {
+      pose_graph::EdgeIdSet edge_ids;
+      map->getVertex(vertex_id).getAllEdges(&edge_ids);
+      window_edge_ids.insert(edge_ids.begin(), edge_ids.end());
+    }
+    for (const pose_graph::EdgeId& edge_id : window_edge_ids) {
+      if (map->getEdgeType(edge_id) != pose_graph::Edge::EdgeType::kViwls) {
+        continue;
+      }
+      const vi_map::ViwlsEdge& edge =
+          map->getEdgeAs<vi_map::ViwlsEdge>(edge_id);
+      boundary_vertex_ids.insert(edge.from());
+      boundary_vertex_ids.insert(edge.to());
+      inertial_edges_of_mission[map->getMissionIdForVertex(edge.from())]
+          .push_back(edge_id);
+    }
+  }
+  for (const pose_graph::VertexId& vertex_id : window_vertex_ids) {
+    boundary_vertex_ids.erase(vertex_id);
+  }
+
+  vi_map::MissionIdSet mission_ids;
+  for (const pose_graph::VertexId& vertex_id : window_vertex_ids) {
+    mission_ids.insert(map->getMissionIdForVertex(vertex_id));
+  }
+  for (const pose_graph::VertexId& vertex_id : boundary_vertex_ids) {
+    mission_ids.insert(map->getMissionIdForVertex(vertex_id));
+  }
+  VLOG(1) << "Window problem with " << window_vertex_ids.size()
+          << " optimized and " << boundary_vertex_ids.size()
+          << " fixed boundary vertices of " << mission_ids.size()
+          << " mission(s).";
+
+  OptimizationProblem* problem = new OptimizationProblem(map, mission_ids);
+  if (options.add_visual_constraints) {
+    for (const pose_graph::VertexId& vertex_id : window_vertex_ids) {
+      addVisualTermsOfVertexForLandmarks(
+          options, window_landmark_ids, &map->getVertex(vertex_id), problem);
+    }
+    for (const pose_graph::VertexId& vertex_id : boundary_vertex_ids) {
+      addVisualTermsOfVertexForLandmarks(
+          options, window_landmark_ids, &map->getVertex(vertex_id), problem);
+    }
+  }
+  if (options.add_inertial_constraints) {
+    const vi_map::SensorManager& sensor_manager = map->getSensorManager();
+    const OptimizationProblem::LocalParameterizations& parameterizations =
+        problem->getLocalParameterizations();
+    for (const std::pair<const vi_map::MissionId, pose_graph::EdgeIdList>&
+             mission_and_edges : inertial_edges_of_mission) {
+      const vi_map::ImuSigmas& imu_sigmas =
+          sensor_manager
+              .getSensorForMission<vi_map::Imu>(mission_and_edges.first)
+              .getImuSigmas();
+      addInertialTermsForEdges(
+          options.fix_gyro_bias, options.fix_accel_bias, options.fix_velocity,
+          options.gravity_magnitude, imu_sigmas,
+          parameterizations.pose_parameterization, mission_and_edges.second,
+          problem);
+    }
+  }
+
+  // The fixed boundary vertices already fix the gauge of the window. Only if
+  // the window covers everything it is connected to, the gauge is fixed as
+  // for the full problem.
+  OptimizationStateBuffer* buffer =
+      problem->getOptimizationStateBufferMutable();
+  ceres_error_terms::ProblemInformation* problem_information =
+      problem->getProblemInformationMutable();
+  bool boundary_in_problem = false;
+  for (const pose_graph::VertexId& vertex_id : boundary_vertex_ids) {
+    if (problem_information->setParameterBlockConstantIfPartOfTheProblem(
+            buffer->get_vertex_q_IM__M_p_MI_JPL(vertex_id))) {
+      boundary_in_problem = true;
+    }
+    if (options.add_inertial_constraints) {
+      problem_information->setParameterBlockConstantIfPartOfTheProblem(
+          buffer->get_vertex_v_M(vertex_id));
+      problem_information->setParameterBlockConstantIfPartOfTheProblem(
+          buffer->get_vertex_gyro_bias(vertex_id));
+      problem_information->setParameterBlockConstantIfPartOfTheProblem(
+          buffer->get_vertex_accel_bias(vertex_id));
+    }
+  }
+  if (!boundary_in_problem) {
+    applyViGaugeFixes(options, problem);
+  }
+
+  fixAllBaseframesInProblem(problem);
+
+  return problem;
+}
+}  // namespace
+
 ViProblemOptions ViProblemOptions::initFromGFlags() {
   ViProblemOptions options;
 
@@ -73,6 +343,7 @@ ViProblemOptions ViProblemOptions::initFromGFlags() {
 OptimizationProblem* constructViProblem(
     const vi_map::MissionIdSet& mission_ids, const ViProblemOptions& options,
     vi_map::VIMap* map) {
+  MAPLAB_TRACE_SCOPE("optimization", "construct vi problem");
   CHECK(map);
   CHECK(options.isValid());
 
@@ -82,6 +353,13 @@ OptimizationProblem* constructViProblem(
       << "Either enable visual or inertial constraints; otherwise don't call "
       << "this function.";
 
+  // Makes room for the problem, e.g. by evicting cached resources.
+  common::MemoryBudget& memory_budget = common::MemoryBudget::getInstance();
+  if (memory_budget.hasBudget()) {
+    memory_budget.requestMemory(
+        estimateViProblemBytes(mission_ids, *map), "VI problem");
+  }
+
   OptimizationProblem* problem = new OptimizationProblem(map, mission_ids);
   if (options.add_visual_constraints) {
     addVisualTerms(
@@ -95,42 +373,101 @@ OptimizationProblem* constructViProblem(
         options.gravity_magnitude, problem);
   }
 
-  // Fixing open DoF of the visual(-inertial) problem. We assume that if there
-  // is inertial data, that all missions will have them.
-  const bool visual_only =
-      options.add_visual_constraints && !options.add_inertial_constraints;
+  applyViGaugeFixes(options, problem);
 
-  // Determine and apply the gauge fixes.
-  MissionClusterGaugeFixes fixes_of_mission_cluster;
-  if (!visual_only) {
-    fixes_of_mission_cluster.position_dof_fixed = true;
-    fixes_of_mission_cluster.rotation_dof_fixed = FixedRotationDoF::kYaw;
-    fixes_of_mission_cluster.scale_fixed = false;
-  } else {
-    fixes_of_mission_cluster.position_dof_fixed = true;
-    fixes_of_mission_cluster.rotation_dof_fixed = FixedRotationDoF::kAll;
-    fixes_of_mission_cluster.scale_fixed = true;
+  // Baseframes are fixed in the non mission-alignment problems.
+  fixAllBaseframesInProblem(problem);
+
+  return problem;
+}
+
+OptimizationProblem* constructLocalViProblem(
+    const pose_graph::VertexIdSet& seed_vertex_ids, const int num_hops,
+    const ViProblemOptions& options, vi_map::VIMap* map) {
+  MAPLAB_TRACE_SCOPE("optimization", "construct local vi problem");
+  CHECK(map);
+  CHECK(!seed_vertex_ids.empty());
+  CHECK_GE(num_hops, 0);
+
+  // Grow the window of optimized vertices hop by hop over co-visibility.
+  pose_graph::VertexIdSet window_vertex_ids = seed_vertex_ids;
+  pose_graph::VertexIdSet frontier_vertex_ids = seed_vertex_ids;
+  for (int hop = 0; hop < num_hops && !frontier_vertex_ids.empty(); ++hop) {
+    pose_graph::VertexIdSet covisible_vertex_ids;
+    addCovisibleVertices(*map, frontier_vertex_ids, &covisible_vertex_ids);
+    frontier_vertex_ids.clear();
+    for (const pose_graph::VertexId& vertex_id : covisible_vertex_ids) {
+      if (window_vertex_ids.insert(vertex_id).second) {
+        frontier_vertex_ids.insert(vertex_id);
+      }
+    }
   }
-  const size_t num_clusters = problem->getMissionCoobservationClusters().size();
-  std::vector<MissionClusterGaugeFixes> vi_cluster_fixes(
-      num_clusters, fixes_of_mission_cluster);
 
-  // Merge with already applied fixes (if necessary).
-  const std::vector<MissionClusterGaugeFixes>* already_applied_cluster_fixes =
-      problem->getAppliedGaugeFixesForInitialVertices();
-  if (already_applied_cluster_fixes) {
-    std::vector<MissionClusterGaugeFixes> merged_fixes;
-    mergeGaugeFixes(
-        vi_cluster_fixes, *already_applied_cluster_fixes, &merged_fixes);
-    problem->applyGaugeFixesForInitialVertices(merged_fixes);
-  } else {
-    problem->applyGaugeFixesForInitialVertices(vi_cluster_fixes);
+  vi_map::LandmarkIdSet window_landmark_ids;
+  map->getAllLandmarkIdsObservedAtVertices(
+      window_vertex_ids, &window_landmark_ids);
+  return constructWindowViProblem(
+      window_vertex_ids, window_landmark_ids, options, map);
+}
+
+OptimizationProblem* constructPartitionViProblem(
+    const pose_graph::VertexIdSet& partition_vertex_ids,
+    const ViProblemOptions& options, vi_map::VIMap* map) {
+  MAPLAB_TRACE_SCOPE("optimization", "construct partition vi problem");
+  CHECK(map);
+  CHECK(!partition_vertex_ids.empty());
+
+  vi_map::LandmarkIdSet partition_landmark_ids;
+  for (const pose_graph::VertexId& vertex_id : partition_vertex_ids) {
+    for (const vi_map::Landmark& landmark :
+         map->getVertex(vertex_id).getLandmarks()) {
+      partition_landmark_ids.insert(landmark.id());
+    }
   }
+  return constructWindowViProblem(
+      partition_vertex_ids, partition_landmark_ids, options, map);
+}
 
-  // Baseframes are fixed in the non mission-alignment problems.
+OptimizationProblem* constructReducedViProblem(
+    const vi_map::MissionIdSet& mission_ids, const ViProblemOptions& options,
+    vi_map::VIMap* map) {
+  MAPLAB_TRACE_SCOPE("optimization", "construct reduced vi problem");
+  CHECK(map);
+  CHECK(options.isValid());
+  CHECK_GT(FLAGS_ba_reduced_min_common_landmarks, 0);
+
+  LOG_IF(
+      FATAL,
+      !options.add_visual_constraints && !options.add_inertial_constraints)
+      << "Either enable visual or inertial constraints; otherwise don't call "
+      << "this function.";
+
+  OptimizationProblem* problem = new OptimizationProblem(map, mission_ids);
+  if (options.add_visual_constraints) {
+    addLandmarkEliminatedPoseTerms(
+        FLAGS_ba_reduced_min_common_landmarks, problem);
+  }
+  if (options.add_inertial_constraints) {
+    addInertialTerms(
+        options.fix_gyro_bias, options.fix_accel_bias, options.fix_velocity,
+        options.gravity_magnitude, problem);
+  }
+
+  applyViGaugeFixes(options, problem);
   fixAllBaseframesInProblem(problem);
 
   return problem;
 }
 
+OptimizationProblem* constructLandmarkBackSubstitutionProblem(
+    const vi_map::MissionIdSet& mission_ids, vi_map::VIMap* map) {
+  MAPLAB_TRACE_SCOPE(
+      "optimization", "construct landmark back-substitution problem");
+  CHECK(map);
+
+  OptimizationProblem* problem = new OptimizationProblem(map, mission_ids);
+  addLandmarkBackSubstitutionTerms(problem);
+  return problem;
+}
+
 }  // namespace map_optimization
@@ -1,10 +1,18 @@
+#include <unordered_set>
+
 #include <ceres/ceres.h>
 #include <map-manager/map-manager.h>
 #include <maplab-common/test/testing-entrypoint.h>
 #include <maplab-common/test/testing-predicates.h>
 #include <vi-mapping-test-app/vi-mapping-test-app.h>
 
+#include "map-optimization/distributed-optimization.h"
+#include "map-optimization/solver.h"
 #include "map-optimization/vi-map-optimizer.h"
+#include "map-optimization/vi-optimization-builder.h"
+
+DECLARE_bool(ba_batch_visual_terms_per_landmark);
+DECLARE_bool(ba_hierarchical_refine);
 
 namespace visual_inertial_mapping {
 
@@ -88,6 +96,223 @@ TEST_F(ViMappingTest, TestCorruptedVisualOptimization) {
       kPrecisionM, kMinPassingLandmarkFraction);
 }
 
+TEST_F(ViMappingTest, TestCorruptedBatchedVisualInertialOptimization) {
+  corruptVertices();
+  corruptLandmarks();
+
+  FLAGS_ba_batch_visual_terms_per_landmark = true;
+  const bool kVisionOnly = false;
+  EXPECT_TRUE(optimize(kVisionOnly));
+  FLAGS_ba_batch_visual_terms_per_landmark = false;
+
+  const double kPrecisionM = 0.01;
+  test_app_.testIfKeyframesMatchReference(kPrecisionM);
+  const double kMinPassingLandmarkFraction = 0.99;
+  test_app_.testIfLandmarksMatchReference(
+      kPrecisionM, kMinPassingLandmarkFraction);
+}
+
+TEST_F(ViMappingTest, TestLocalProblemFixesBoundary) {
+  vi_map::VIMap* map = CHECK_NOTNULL(test_app_.getMapMutable());
+  pose_graph::VertexIdList vertex_ids;
+  map->getAllVertexIdsAlongGraphsSortedByTimestamp(&vertex_ids);
+  ASSERT_GT(vertex_ids.size(), 2u);
+  const pose_graph::VertexId& seed_vertex_id =
+      vertex_ids[vertex_ids.size() / 2u];
+
+  map_optimization::ViProblemOptions options =
+      map_optimization::ViProblemOptions::initFromGFlags();
+  constexpr int kNumHops = 0;
+  map_optimization::OptimizationProblem::UniquePtr problem(
+      map_optimization::constructLocalViProblem(
+          {seed_vertex_id}, kNumHops, options, map));
+  ASSERT_TRUE(problem != nullptr);
+
+  const std::unordered_set<pose_graph::VertexId>& keyframes_in_problem =
+      problem->getProblemBookkeepingMutable()->keyframes_in_problem;
+  EXPECT_GT(keyframes_in_problem.count(seed_vertex_id), 0u);
+  // The seed vertex is connected to the boundary by co-visibility and by its
+  // inertial edges.
+  ASSERT_GT(keyframes_in_problem.size(), 1u);
+  EXPECT_LT(keyframes_in_problem.size(), vertex_ids.size());
+
+  ceres_error_terms::ProblemInformation* problem_information =
+      problem->getProblemInformationMutable();
+  map_optimization::OptimizationStateBuffer* buffer =
+      problem->getOptimizationStateBufferMutable();
+  for (const pose_graph::VertexId& vertex_id : keyframes_in_problem) {
+    EXPECT_EQ(
+        vertex_id != seed_vertex_id,
+        problem_information->isParameterBlockConstant(
+            buffer->get_vertex_q_IM__M_p_MI_JPL(vertex_id)));
+  }
+}
+
+TEST_F(ViMappingTest, TestCorruptedLocalVisualInertialOptimization) {
+  corruptVertices();
+  corruptLandmarks();
+
+  // With all vertices as seeds, the window covers the whole map.
+  vi_map::VIMap* map = CHECK_NOTNULL(test_app_.getMapMutable());
+  pose_graph::VertexIdList vertex_ids;
+  map->getAllVertexIds(&vertex_ids);
+  const pose_graph::VertexIdSet seed_vertex_ids(
+      vertex_ids.begin(), vertex_ids.end());
+
+  map_optimization::ViProblemOptions options =
+      map_optimization::ViProblemOptions::initFromGFlags();
+  visualization::ViwlsGraphRvizPlotter* plotter = nullptr;
+  constexpr bool kSignalHandlerEnabled = false;
+  map_optimization::VIMapOptimizer optimizer(plotter, kSignalHandlerEnabled);
+  map_optimization::OutlierRejectionSolverOptions rejection_options =
+      map_optimization::OutlierRejectionSolverOptions::initFromFlags();
+  constexpr int kNumHops = 1;
+  EXPECT_TRUE(
+      optimizer.optimizeVisualInertialLocally(
+          options, seed_vertex_ids, kNumHops, &rejection_options, map));
+
+  const double kPrecisionM = 0.01;
+  test_app_.testIfKeyframesMatchReference(kPrecisionM);
+  const double kMinPassingLandmarkFraction = 0.99;
+  test_app_.testIfLandmarksMatchReference(
+      kPrecisionM, kMinPassingLandmarkFraction);
+}
+
+TEST_F(ViMappingTest, TestCorruptedHierarchicalVisualInertialOptimization) {
+  corruptVertices();
+  corruptLandmarks();
+
+  vi_map::VIMap* map = CHECK_NOTNULL(test_app_.getMapMutable());
+  vi_map::MissionIdSet mission_ids;
+  map->getAllMissionIds(&mission_ids);
+
+  map_optimization::ViProblemOptions options =
+      map_optimization::ViProblemOptions::initFromGFlags();
+  visualization::ViwlsGraphRvizPlotter* plotter = nullptr;
+  constexpr bool kSignalHandlerEnabled = false;
+  map_optimization::VIMapOptimizer optimizer(plotter, kSignalHandlerEnabled);
+  map_optimization::OutlierRejectionSolverOptions rejection_options =
+      map_optimization::OutlierRejectionSolverOptions::initFromFlags();
+  FLAGS_ba_hierarchical_refine = true;
+  constexpr unsigned int kNumPartitions = 4u;
+  EXPECT_TRUE(
+      optimizer.optimizeVisualInertialHierarchically(
+          options, mission_ids, kNumPartitions, &rejection_options, map));
+
+  const double kPrecisionM = 0.01;
+  test_app_.testIfKeyframesMatchReference(kPrecisionM);
+  const double kMinPassingLandmarkFraction = 0.99;
+  test_app_.testIfLandmarksMatchReference(
+      kPrecisionM, kMinPassingLandmarkFraction);
+}
+
+TEST_F(ViMappingTest, TestCorruptedDistributedVisualInertialOptimization) {
+  corruptVertices();
+  corruptLandmarks();
+
+  vi_map::VIMap* map = CHECK_NOTNULL(test_app_.getMapMutable());
+  vi_map::MissionIdSet mission_ids;
+  map->getAllMissionIds(&mission_ids);
+
+  // The local worker goes through the same serialization as a remote one.
+  map_optimization::ViProblemOptions options =
+      map_optimization::ViProblemOptions::initFromGFlags();
+  map_optimization::OutlierRejectionSolverOptions rejection_options =
+      map_optimization::OutlierRejectionSolverOptions::initFromFlags();
+  const map_optimization::ClusterOptimizationWorker worker =
+      map_optimization::createLocalClusterOptimizationWorker(
+          options, &rejection_options);
+  constexpr size_t kNumParallelJobs = 2u;
+  EXPECT_TRUE(
+      map_optimization::optimizeMissionClustersDistributed(
+          mission_ids, worker, kNumParallelJobs, map));
+
+  const double kPrecisionM = 0.01;
+  test_app_.testIfKeyframesMatchReference(kPrecisionM);
+  const double kMinPassingLandmarkFraction = 0.99;
+  test_app_.testIfLandmarksMatchReference(
+      kPrecisionM, kMinPassingLandmarkFraction);
+}
+
+TEST_F(ViMappingTest, TestReducedVisualInertialOptimization) {
+  // The reduced problem is linearized at the keyframes of the map, hence only
+  // the landmarks are corrupted and recovered by the back-substitution.
+  corruptLandmarks();
+
+  vi_map::VIMap* map = CHECK_NOTNULL(test_app_.getMapMutable());
+  vi_map::MissionIdSet mission_ids;
+  map->getAllMissionIds(&mission_ids);
+
+  map_optimization::ViProblemOptions options =
+      map_optimization::ViProblemOptions::initFromGFlags();
+  map_optimization::OptimizationProblem::UniquePtr problem(
+      map_optimization::constructReducedViProblem(mission_ids, options, map));
+  ASSERT_TRUE(problem != nullptr);
+  EXPECT_TRUE(problem->getProblemBookkeepingMutable()
+                  ->landmarks_in_problem.empty());
+  EXPECT_FALSE(
+      problem->getProblemBookkeepingMutable()->keyframes_in_problem.empty());
+  problem.reset();
+
+  visualization::ViwlsGraphRvizPlotter* plotter = nullptr;
+  constexpr bool kSignalHandlerEnabled = false;
+  map_optimization::VIMapOptimizer optimizer(plotter, kSignalHandlerEnabled);
+  EXPECT_TRUE(
+      optimizer.optimizeVisualInertialReduced(options, mission_ids, map));
+
+  const double kPrecisionM = 0.01;
+  test_app_.testIfKeyframesMatchReference(kPrecisionM);
+  const double kMinPassingLandmarkFraction = 0.99;
+  test_app_.testIfLandmarksMatchReference(
+      kPrecisionM, kMinPassingLandmarkFraction);
+}
+
+TEST_F(ViMappingTest, TestAutomaticLinearSolverSelection) {
+  vi_map::VIMap* map = CHECK_NOTNULL(test_app_.getMapMutable());
+  vi_map::MissionIdSet mission_ids;
+  map->getAllMissionIds(&mission_ids);
+
+  map_optimization::ViProblemOptions options =
+      map_optimization::ViProblemOptions::initFromGFlags();
+  map_optimization::OptimizationProblem::UniquePtr problem(
+      map_optimization::constructViProblem(mission_ids, options, map));
+  ASSERT_TRUE(problem != nullptr);
+  ceres::Problem ceres_problem(ceres_error_terms::getDefaultProblemOptions());
+  ceres_error_terms::buildCeresProblemFromProblemInformation(
+      problem->getProblemInformationMutable(), &ceres_problem);
+
+  // The landmarks of the test map are eliminated first.
+  ceres::Solver::Options solver_options;
+  map_optimization::selectLinearSolverForProblem(
+      ceres_problem, problem.get(), &solver_options);
+  EXPECT_TRUE(
+      solver_options.linear_solver_type == ceres::DENSE_SCHUR ||
+      solver_options.linear_solver_type == ceres::SPARSE_SCHUR);
+  ASSERT_TRUE(solver_options.linear_solver_ordering != nullptr);
+  EXPECT_EQ(
+      ceres_problem.NumParameterBlocks(),
+      solver_options.linear_solver_ordering->NumElements());
+  EXPECT_EQ(2, solver_options.linear_solver_ordering->NumGroups());
+  ceres::Solver::Summary summary;
+  ceres::Solve(solver_options, &ceres_problem, &summary);
+  EXPECT_TRUE(summary.IsSolutionUsable()) << summary.FullReport();
+
+  // Without any landmarks to eliminate, the normal equations are solved
+  // directly.
+  options.add_visual_constraints = false;
+  problem.reset(
+      map_optimization::constructViProblem(mission_ids, options, map));
+  ASSERT_TRUE(problem != nullptr);
+  ceres::Problem inertial_problem(
+      ceres_error_terms::getDefaultProblemOptions());
+  ceres_error_terms::buildCeresProblemFromProblemInformation(
+      problem->getProblemInformationMutable(), &inertial_problem);
+  map_optimization::selectLinearSolverForProblem(
+      inertial_problem, problem.get(), &solver_options);
+  EXPECT_EQ(ceres::SPARSE_NORMAL_CHOLESKY, solver_options.linear_solver_type);
+  EXPECT_TRUE(solver_options.linear_solver_ordering == nullptr);
+}
+
 }  // namespace visual_inertial_mapping
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -1,6 +1,7 @@
 #ifndef MAP_SPARSIFICATION_GRAPH_PARTITION_SAMPLER_H_
 #define MAP_SPARSIFICATION_GRAPH_PARTITION_SAMPLER_H_
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -21,11 +22,22 @@ class GraphPartitionSampler : public SamplerBase {
  public:
   MAPLAB_POINTER_TYPEDEFS(GraphPartitionSampler);
 
+  typedef std::function<SamplerBase::Ptr()> SamplerCreator;
+
+  // Samples all segments one after the other with the given sampler.
   explicit GraphPartitionSampler(map_sparsification::SamplerBase::Ptr sampler);
+  // Samples the segments concurrently, every segment with its own sampler
+  // created by sampler_creator. The number of segments sampled at the same
+  // time is set by --sparsification_partition_sampling_num_threads.
+  explicit GraphPartitionSampler(const SamplerCreator& sampler_creator);
   virtual ~GraphPartitionSampler();
 
   void setMaxPartitionedSummarizationFraction(double fraction);
 
+  // The map is partitioned such that every partition holds at most about
+  // this many well constrained landmarks.
+  void setMaxNumLandmarksPerPartition(size_t max_num_landmarks_per_partition);
+
   virtual void sample(
       const vi_map::VIMap& map, unsigned int total_desired_num_landmarks,
       vi_map::LandmarkIdSet* summary_store_landmark_ids);
@@ -48,6 +60,13 @@ class GraphPartitionSampler : public SamplerBase {
  private:
   void partitionMapIfNecessary(const vi_map::VIMap& map);
 
+  // Collects the good quality landmarks of the segment and samples them down
+  // to the retain ratio of all landmarks of the segment.
+  void sampleSegment(
+      const vi_map::VIMap& map, double retain_ratio, size_t segment_idx,
+      SamplerBase* sampler, vi_map::LandmarkIdSet* segment_landmark_ids,
+      vi_map::LandmarkIdSet* segment_summary_landmark_ids) const;
+
   void plotSegment(const vi_map::VIMap& map, int segment_index);
   void plotLandmarks(
       const vi_map::VIMap& map, int segment_index,
@@ -55,15 +74,17 @@ class GraphPartitionSampler : public SamplerBase {
       bool are_globally_selected);
 
   map_sparsification::SamplerBase::Ptr sampler_;
+  SamplerCreator sampler_creator_;
   std::vector<pose_graph::VertexIdList> posegraph_partitioning_;
   double max_partitioned_summarization_fraction_;
+  size_t max_num_landmarks_per_partition_;
 
   std::vector<vi_map::LandmarkIdSet> partition_landmarks_;
 
   std::unique_ptr<map_sparsification_visualization::MapSparsificationVisualizer>
       visualizer_;
 
-  static constexpr size_t kMaxNumLandmarkPerPartition = 5000u;
+  static constexpr size_t kDefaultMaxNumLandmarksPerPartition = 5000u;
 };
 
 }  // namespace map_sparsification
@@ -0,0 +1,20 @@
+#ifndef MAP_SPARSIFICATION_HEURISTIC_SCORING_DESCRIPTOR_BIT_STATISTICS_H_
+#define MAP_SPARSIFICATION_HEURISTIC_SCORING_DESCRIPTOR_BIT_STATISTICS_H_
+
+#include <cstddef>
+
+namespace map_sparsification {
+namespace scoring {
+
+// Returns the root mean square Hamming distance of the binary descriptors to
+// their bitwise majority descriptor, the same statistic as
+// aslam::common::descriptor_utils::descriptorMeanStandardDeviation. The
+// descriptors are compared in 64 bit words with the popcnt instruction if the
+// CPU supports it. Returns 0 if there are no descriptors.
+double descriptorMeanStandardDeviation(
+    const unsigned char* const* descriptors, size_t num_descriptors,
+    size_t descriptor_size_bytes);
+
+}  // namespace scoring
+}  // namespace map_sparsification
+#endif  // MAP_SPARSIFICATION_HEURISTIC_SCORING_DESCRIPTOR_BIT_STATISTICS_H_
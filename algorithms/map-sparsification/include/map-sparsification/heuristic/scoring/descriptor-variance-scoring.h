@@ -1,9 +1,8 @@
 #ifndef MAP_SPARSIFICATION_HEURISTIC_SCORING_DESCRIPTOR_VARIANCE_SCORING_H_
 #define MAP_SPARSIFICATION_HEURISTIC_SCORING_DESCRIPTOR_VARIANCE_SCORING_H_
 
-#include <algorithm>
+#include <vector>
 
-#include <aslam/common/descriptor-utils.h>
 #include <map-sparsification/heuristic/scoring/scoring-function.h>
 #include <vi-map/unique-id.h>
 #include <vi-map/vi-map.h>
@@ -19,17 +18,14 @@ class DescriptorVarianceScoring : public ScoringFunction {
   virtual ~DescriptorVarianceScoring() {}
 
  private:
-  virtual inline double scoreImpl(
-      const vi_map::LandmarkId& landmark_id, const vi_map::VIMap& map) const {
-    CHECK(map.hasLandmark(landmark_id));
-    vi_map::VIMap::DescriptorsType descriptors;
-    map.getLandmarkDescriptors(landmark_id, &descriptors);
-    const double descriptor_std_dev =
-        aslam::common::descriptor_utils::descriptorMeanStandardDeviation(
-            descriptors);
-    return std::max(
-        descriptor_dev_scoring_threshold_ - descriptor_std_dev, 0.0);
-  }
+  virtual double scoreImpl(
+      const vi_map::LandmarkId& landmark_id, const vi_map::VIMap& map) const;
+
+  // Packs the descriptors of all observer vertices of the landmarks into a
+  // descriptor arena once and scores the landmarks in parallel from it.
+  virtual void scoreBatchImpl(
+      const vi_map::LandmarkIdList& landmark_ids, const vi_map::VIMap& map,
+      std::vector<double>* raw_scores) const;
 
   double descriptor_dev_scoring_threshold_;
 };
@@ -1,6 +1,8 @@
 #ifndef MAP_SPARSIFICATION_HEURISTIC_SCORING_OBSERVATION_COUNT_SCORING_H_
 #define MAP_SPARSIFICATION_HEURISTIC_SCORING_OBSERVATION_COUNT_SCORING_H_
 
+#include <vector>
+
 #include <map-sparsification/heuristic/scoring/scoring-function.h>
 #include <vi-map/unique-id.h>
 #include <vi-map/vi-map.h>
@@ -20,6 +22,16 @@ class ObservationCountScoringFunction : public ScoringFunction {
     CHECK(map.hasLandmark(landmark_id));
     return map.getLandmark(landmark_id).numberOfObserverVertices();
   }
+
+  virtual void scoreBatchImpl(
+      const vi_map::LandmarkIdList& landmark_ids, const vi_map::VIMap& map,
+      std::vector<double>* raw_scores) const {
+    CHECK_NOTNULL(raw_scores)->resize(landmark_ids.size());
+    for (size_t i = 0u; i < landmark_ids.size(); ++i) {
+      (*raw_scores)[i] =
+          map.getLandmark(landmark_ids[i]).numberOfObserverVertices();
+    }
+  }
 };
 
 }  // namespace scoring
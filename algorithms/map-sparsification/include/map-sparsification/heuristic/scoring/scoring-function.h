@@ -1,6 +1,9 @@
 #ifndef MAP_SPARSIFICATION_HEURISTIC_SCORING_SCORING_FUNCTION_H_
 #define MAP_SPARSIFICATION_HEURISTIC_SCORING_SCORING_FUNCTION_H_
 
+#include <vector>
+
+#include <glog/logging.h>
 #include <maplab-common/macros.h>
 #include <vi-map/unique-id.h>
 #include <vi-map/vi-map.h>
@@ -22,6 +25,21 @@ class ScoringFunction {
     return weight_ * raw_score;
   }
 
+  // Adds the weighted scores of all landmarks to the scores, e.g. of all
+  // landmarks of a map segment in one pass.
+  void addScores(
+      const vi_map::LandmarkIdList& store_landmark_ids,
+      const vi_map::VIMap& map, std::vector<double>* scores) const {
+    CHECK_NOTNULL(scores);
+    CHECK_EQ(store_landmark_ids.size(), scores->size());
+    std::vector<double> raw_scores;
+    scoreBatchImpl(store_landmark_ids, map, &raw_scores);
+    CHECK_EQ(store_landmark_ids.size(), raw_scores.size());
+    for (size_t i = 0u; i < raw_scores.size(); ++i) {
+      (*scores)[i] += weight_ * raw_scores[i];
+    }
+  }
+
   void setWeight(double weight) {
     weight_ = weight;
   }
@@ -30,6 +48,18 @@ class ScoringFunction {
   virtual double scoreImpl(
       const vi_map::LandmarkId& store_landmark_id,
       const vi_map::VIMap& map) const = 0;
+
+  // Scores the landmarks one by one, override if the landmarks can be scored
+  // more efficiently together.
+  virtual void scoreBatchImpl(
+      const vi_map::LandmarkIdList& store_landmark_ids,
+      const vi_map::VIMap& map, std::vector<double>* raw_scores) const {
+    CHECK_NOTNULL(raw_scores)->resize(store_landmark_ids.size());
+    for (size_t i = 0u; i < store_landmark_ids.size(); ++i) {
+      (*raw_scores)[i] = scoreImpl(store_landmark_ids[i], map);
+    }
+  }
+
   double weight_;
 };
 
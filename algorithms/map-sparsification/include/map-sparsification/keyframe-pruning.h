@@ -31,9 +31,19 @@ size_t selectKeyframesBasedOnHeuristics(
     const KeyframingHeuristicsOptions& options,
     std::vector<pose_graph::VertexId>* selected_keyframes);
 
+// Selects the keyframes of every mission from its root to its last vertex,
+// which is always added as a keyframe. The missions are processed in
+// parallel, the keyframes of mission_ids[i] are returned in
+// (*mission_keyframe_ids)[i].
+void selectKeyframesOfMissionsBasedOnHeuristics(
+    const vi_map::VIMap& map, const vi_map::MissionIdList& mission_ids,
+    const KeyframingHeuristicsOptions& options,
+    std::vector<pose_graph::VertexIdList>* mission_keyframe_ids);
+
 // Discard all vertices between keyframes and just discards all visual
 // information contained in these frames. The IMU measurements of the edges
-// will be concatenated into a new edge.
+// will be concatenated into a new edge. All vertices of the mission are
+// merged in a single pass over the backbone.
 size_t removeVerticesBetweenKeyframes(
     const pose_graph::VertexIdList& keyframe_ids, vi_map::VIMap* map);
 
@@ -0,0 +1,47 @@
+#ifndef MAP_SPARSIFICATION_OPTIMIZATION_GREEDY_COVERAGE_SPARSIFICATION_H_
+#define MAP_SPARSIFICATION_OPTIMIZATION_GREEDY_COVERAGE_SPARSIFICATION_H_
+
+#include <string>
+#include <vector>
+
+#include <vi-map/unique-id.h>
+#include <vi-map/vi-map.h>
+
+#include "map-sparsification/sampler-base.h"
+
+namespace map_sparsification {
+
+// Approximates the landmark selection of LpSolveSparsification by maximizing
+// the submodular function
+//   f(S) = sum_{l in S} num_observations(l)
+//          + kCoverageGain * sum_{keyframes k} min(|S intersect L_k|, n_k)
+// with a lazy greedy algorithm, where L_k are the landmarks of the segment
+// observed by keyframe k and n_k = min(min_keypoints_per_keyframe, |L_k|).
+// The large coverage gain takes the role of the slack variable penalty of
+// the ILP, such that the keyframe constraints are fulfilled first.
+//
+// Unlike the ILP, the lazy greedy selection scales to large segments. If the
+// time limit is reached, the remaining landmarks are selected by their last
+// evaluated gains without re-evaluating them.
+class GreedyCoverageSparsification : public SamplerBase {
+ public:
+  explicit GreedyCoverageSparsification(unsigned int min_keypoints_per_keyframe)
+      : min_keypoints_per_keyframe_(min_keypoints_per_keyframe) {}
+
+  virtual void sampleMapSegment(
+      const vi_map::VIMap& map, unsigned int desired_num_landmarks,
+      unsigned int time_limit_seconds,
+      const vi_map::LandmarkIdSet& segment_store_landmark_id_set,
+      const pose_graph::VertexIdList& segment_vertex_id_list,
+      vi_map::LandmarkIdSet* summary_store_landmark_ids);
+
+  virtual std::string getTypeString() const {
+    return "greedy_coverage";
+  }
+
+ private:
+  const unsigned int min_keypoints_per_keyframe_;
+};
+
+}  // namespace map_sparsification
+#endif  // MAP_SPARSIFICATION_OPTIMIZATION_GREEDY_COVERAGE_SPARSIFICATION_H_
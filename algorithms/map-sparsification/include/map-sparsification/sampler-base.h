@@ -25,6 +25,12 @@ class SamplerBase {
     // If the map is too large, partition the map using METIS and the solve
     // and ILP problem.
     kLpsolvePartitionIlp = 4,
+    // Selects landmarks greedily such that the keyframes keep enough
+    // landmarks. Approximates kLpsolveIlp in bounded time for large maps.
+    kGreedyCoverage = 5,
+    // Partitions the map like kLpsolvePartitionIlp, but into much larger
+    // partitions that are sampled with kGreedyCoverage.
+    kGreedyCoveragePartition = 6,
   };
 
   virtual ~SamplerBase() {}
@@ -1,7 +1,13 @@
 #include "map-sparsification/graph-partition-sampler.h"
 
+#include <string>
+#include <vector>
+
 #include <aslam/common/timer.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 #include <vi-map-helpers/vi-map-partitioner.h>
 #include <vi-map-helpers/vi-map-queries.h>
 #include <visualization/color-palette.h>
@@ -10,9 +16,29 @@
 
 namespace map_sparsification {
 
+constexpr size_t GraphPartitionSampler::kDefaultMaxNumLandmarksPerPartition;
+
+DEFINE_uint64(
+    sparsification_partition_sampling_num_threads, 0u,
+    "Number of map partitions that are sampled concurrently by the "
+    "partitioned landmark sampler. (0: number of hardware threads)");
+
 GraphPartitionSampler::GraphPartitionSampler(
     map_sparsification::SamplerBase::Ptr sampler)
-    : sampler_(sampler), max_partitioned_summarization_fraction_(1.0) {
+    : sampler_(sampler),
+      max_partitioned_summarization_fraction_(1.0),
+      max_num_landmarks_per_partition_(kDefaultMaxNumLandmarksPerPartition) {
+  CHECK(sampler_);
+}
+
+GraphPartitionSampler::GraphPartitionSampler(
+    const SamplerCreator& sampler_creator)
+    : sampler_creator_(sampler_creator),
+      max_partitioned_summarization_fraction_(1.0),
+      max_num_landmarks_per_partition_(kDefaultMaxNumLandmarksPerPartition) {
+  CHECK(sampler_creator_);
+  // Used for the global sampling stage.
+  sampler_ = sampler_creator_();
   CHECK(sampler_);
 }
 
@@ -24,15 +50,16 @@ void GraphPartitionSampler::partitionMapIfNecessary(const vi_map::VIMap& map) {
   queries.getAllWellConstrainedLandmarkIds(&well_constrained_landmarks);
 
   const size_t num_landmarks = well_constrained_landmarks.size();
-  if (num_landmarks < kMaxNumLandmarkPerPartition) {
+  if (num_landmarks < max_num_landmarks_per_partition_) {
     posegraph_partitioning_.resize(1u);
     map.getAllVertexIds(&(posegraph_partitioning_[0]));
   } else {
     const size_t num_partitions = std::ceil(
-        static_cast<double>(num_landmarks) / kMaxNumLandmarkPerPartition);
+        static_cast<double>(num_landmarks) / max_num_landmarks_per_partition_);
     LOG(INFO) << "Number of well constrained landmarks exceeds "
-              << kMaxNumLandmarkPerPartition << ". Will partition the graph "
-              << "into " << num_partitions << " partitions.";
+              << max_num_landmarks_per_partition_
+              << ". Will partition the graph into " << num_partitions
+              << " partitions.";
     vi_map_helpers::VIMapPartitioner partitioner;
     partitioner.partitionMapWithMetis(
         map, num_partitions, &posegraph_partitioning_);
@@ -47,6 +74,12 @@ void GraphPartitionSampler::setMaxPartitionedSummarizationFraction(
   max_partitioned_summarization_fraction_ = fraction;
 }
 
+void GraphPartitionSampler::setMaxNumLandmarksPerPartition(
+    size_t max_num_landmarks_per_partition) {
+  CHECK_GT(max_num_landmarks_per_partition, 0u);
+  max_num_landmarks_per_partition_ = max_num_landmarks_per_partition;
+}
+
 void GraphPartitionSampler::sample(
     const vi_map::VIMap& map, unsigned int total_desired_num_landmarks,
     vi_map::LandmarkIdSet* summary_landmark_ids) {
@@ -77,72 +110,52 @@ void GraphPartitionSampler::sample(
                                partition_landmarks_,
                                kGloballySelectedLandmarks);
   }
-  partition_landmarks_.resize(posegraph_partitioning_.size());
-
-  // TODO(dymczykm) Parallelize this.
-  for (unsigned int i = 0; i < posegraph_partitioning_.size(); ++i) {
-    LOG(INFO) << "Sampling cluster " << (i + 1) << " of "
-              << posegraph_partitioning_.size();
-    if (visualizer_) {
-      visualizer_->plotSegment(map, posegraph_partitioning_, i);
-    }
+  const size_t num_segments = posegraph_partitioning_.size();
+  partition_landmarks_.resize(num_segments);
 
-    vi_map::LandmarkIdSet segment_landmark_id_set;
-    unsigned int num_segment_landmarks = 0;
-    LOG(INFO) << "\tBuilding the landmark set for the segment";
-    for (const pose_graph::VertexId& vertex_id : posegraph_partitioning_[i]) {
-      for (const vi_map::Landmark landmark :
-           map.getVertex(vertex_id).getLandmarks()) {
-        ++num_segment_landmarks;
-        if (map.getLandmark(landmark.id()).getQuality() ==
-            vi_map::Landmark::Quality::kGood) {
-          segment_landmark_id_set.insert(landmark.id());
+  // The segments are sampled concurrently if every segment can get its own
+  // sampler, the results are merged in the order of the segments.
+  size_t num_threads = 1u;
+  if (sampler_creator_) {
+    num_threads = FLAGS_sparsification_partition_sampling_num_threads > 0u
+                      ? FLAGS_sparsification_partition_sampling_num_threads
+                      : common::getNumHardwareThreads();
+  }
+  std::vector<vi_map::LandmarkIdSet> segment_landmark_ids(num_segments);
+  std::vector<vi_map::LandmarkIdSet> segment_summary_landmark_ids(
+      num_segments);
+  common::ParallelProcessDynamic(
+      num_segments,
+      [&](const size_t segment_begin, const size_t segment_end) {
+        for (size_t segment_idx = segment_begin; segment_idx < segment_end;
+             ++segment_idx) {
+          SamplerBase::Ptr segment_sampler =
+              sampler_creator_ ? sampler_creator_() : sampler_;
+          CHECK(segment_sampler);
+          sampleSegment(
+              map, retain_ratio, segment_idx, segment_sampler.get(),
+              &segment_landmark_ids[segment_idx],
+              &segment_summary_landmark_ids[segment_idx]);
         }
-      }
-    }
+      },
+      num_threads, common::ParallelSchedule::kDynamic);
 
-    unsigned int desired_num_landmarks = retain_ratio * num_segment_landmarks;
-
-    // Time limit of the sampling process of a single map partition.
-    const unsigned int kSegmentTimeLimitSeconds = 8;
-
-    LOG(INFO) << "\tSampling out of " << segment_landmark_id_set.size()
-              << " landmarks, desired: " << desired_num_landmarks;
-    if (segment_landmark_id_set.size() > desired_num_landmarks) {
-      vi_map::LandmarkIdSet segment_summary_landmark_ids;
-
-      timing::Timer sampling_timer(
-          "GraphPartitionSampler: " +
-          std::to_string(posegraph_partitioning_.size()) +
-          "partitions_sampling_timer");
-      sampler_->sampleMapSegment(
-          map, desired_num_landmarks, kSegmentTimeLimitSeconds,
-          segment_landmark_id_set, posegraph_partitioning_[i],
-          &segment_summary_landmark_ids);
-      sampling_timer.Stop();
-
-      LOG(INFO) << "\t" << segment_summary_landmark_ids.size()
-                << " landmarks inserted from this segment.";
-      summary_landmark_ids->insert(
-          segment_summary_landmark_ids.begin(),
-          segment_summary_landmark_ids.end());
-    } else {
-      LOG(WARNING) << "Landmark quality filtering left only "
-                   << segment_landmark_id_set.size()
-                   << " landmarks, less than " << desired_num_landmarks
-                   << " landmarks desired. Summarization is not needed.";
-      summary_landmark_ids->insert(segment_landmark_id_set.begin(),
-                                         segment_landmark_id_set.end());
-    }
+  for (size_t segment_idx = 0u; segment_idx < num_segments; ++segment_idx) {
+    summary_landmark_ids->insert(
+        segment_summary_landmark_ids[segment_idx].begin(),
+        segment_summary_landmark_ids[segment_idx].end());
 
     if (visualizer_) {
-      partition_landmarks_[i].insert(segment_landmark_id_set.begin(),
-                                     segment_landmark_id_set.end());
+      visualizer_->plotSegment(map, posegraph_partitioning_, segment_idx);
+      partition_landmarks_[segment_idx].insert(
+          segment_landmark_ids[segment_idx].begin(),
+          segment_landmark_ids[segment_idx].end());
 
       const bool kGloballySelectedLandmarks = false;
-      visualizer_->plotLandmarks(map, i, segment_landmark_id_set,
-                                 posegraph_partitioning_, partition_landmarks_,
-                                 kGloballySelectedLandmarks);
+      visualizer_->plotLandmarks(
+          map, segment_idx, segment_landmark_ids[segment_idx],
+          posegraph_partitioning_, partition_landmarks_,
+          kGloballySelectedLandmarks);
     }
   }
 
@@ -179,6 +192,64 @@ void GraphPartitionSampler::sample(
             << summary_landmark_ids->size();
 }
 
+void GraphPartitionSampler::sampleSegment(
+    const vi_map::VIMap& map, const double retain_ratio,
+    const size_t segment_idx, SamplerBase* sampler,
+    vi_map::LandmarkIdSet* segment_landmark_ids,
+    vi_map::LandmarkIdSet* segment_summary_landmark_ids) const {
+  CHECK_NOTNULL(sampler);
+  CHECK_NOTNULL(segment_landmark_ids)->clear();
+  CHECK_NOTNULL(segment_summary_landmark_ids)->clear();
+  CHECK_LT(segment_idx, posegraph_partitioning_.size());
+  const pose_graph::VertexIdList& segment_vertex_ids =
+      posegraph_partitioning_[segment_idx];
+
+  LOG(INFO) << "Sampling cluster " << (segment_idx + 1) << " of "
+            << posegraph_partitioning_.size();
+
+  unsigned int num_segment_landmarks = 0;
+  for (const pose_graph::VertexId& vertex_id : segment_vertex_ids) {
+    for (const vi_map::Landmark landmark :
+         map.getVertex(vertex_id).getLandmarks()) {
+      ++num_segment_landmarks;
+      if (map.getLandmark(landmark.id()).getQuality() ==
+          vi_map::Landmark::Quality::kGood) {
+        segment_landmark_ids->insert(landmark.id());
+      }
+    }
+  }
+
+  unsigned int desired_num_landmarks = retain_ratio * num_segment_landmarks;
+
+  // Time limit of the sampling process of a single map partition.
+  const unsigned int kSegmentTimeLimitSeconds = 8;
+
+  LOG(INFO) << "\tCluster " << (segment_idx + 1) << ": sampling out of "
+            << segment_landmark_ids->size()
+            << " landmarks, desired: " << desired_num_landmarks;
+  if (segment_landmark_ids->size() > desired_num_landmarks) {
+    timing::Timer sampling_timer(
+        "GraphPartitionSampler: " +
+        std::to_string(posegraph_partitioning_.size()) +
+        "partitions_sampling_timer");
+    sampler->sampleMapSegment(
+        map, desired_num_landmarks, kSegmentTimeLimitSeconds,
+        *segment_landmark_ids, segment_vertex_ids,
+        segment_summary_landmark_ids);
+    sampling_timer.Stop();
+
+    LOG(INFO) << "\tCluster " << (segment_idx + 1) << ": "
+              << segment_summary_landmark_ids->size()
+              << " landmarks inserted from this segment.";
+  } else {
+    LOG(WARNING) << "Landmark quality filtering left only "
+                 << segment_landmark_ids->size() << " landmarks, less than "
+                 << desired_num_landmarks
+                 << " landmarks desired. Summarization is not needed.";
+    *segment_summary_landmark_ids = *segment_landmark_ids;
+  }
+}
+
 void GraphPartitionSampler::instantiateVisualizer() {
   visualizer_.reset(
       new map_sparsification_visualization::MapSparsificationVisualizer());
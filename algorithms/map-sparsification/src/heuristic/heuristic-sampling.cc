@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <map>
 #include <unordered_map>
+#include <vector>
 
 namespace map_sparsification {
 namespace sampling {
@@ -26,13 +27,21 @@ void LandmarkSamplingWithCostFunctions::sampleMapSegment(
   CHECK_NOTNULL(summary_landmark_ids);
   *summary_landmark_ids = segment_landmark_id_set;
 
+  // Every scoring function scores all landmarks of the segment in one pass.
+  const vi_map::LandmarkIdList segment_landmark_ids(
+      summary_landmark_ids->begin(), summary_landmark_ids->end());
+  std::vector<double> segment_landmark_scores(segment_landmark_ids.size(), 0.0);
+  for (const ScoringFunction::ConstPtr& scoring_function : scoring_functions_) {
+    scoring_function->addScores(
+        segment_landmark_ids, map, &segment_landmark_scores);
+  }
   LandmarkScoreMap landmark_scores;
-  for (const vi_map::LandmarkId& landmark_id : *summary_landmark_ids) {
-    double landmark_score = 0.0;
-    for (unsigned int i = 0; i < scoring_functions_.size(); ++i) {
-      landmark_score += (*scoring_functions_[i])(landmark_id, map);
-    }
-    CHECK(landmark_scores.emplace(landmark_id, landmark_score).second);
+  landmark_scores.reserve(segment_landmark_ids.size());
+  for (size_t i = 0u; i < segment_landmark_ids.size(); ++i) {
+    CHECK(
+        landmark_scores
+            .emplace(segment_landmark_ids[i], segment_landmark_scores[i])
+            .second);
   }
 
   KeyframeKeypointCountMap keyframe_keypoint_counts;
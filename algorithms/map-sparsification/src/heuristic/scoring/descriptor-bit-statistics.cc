@@ -0,0 +1,126 @@
+#include "map-sparsification/heuristic/scoring/descriptor-bit-statistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <glog/logging.h>
+
+// The popcnt kernel is compiled for its target only, such that the library
+// still runs on CPUs without it.
+#if defined(__x86_64__) && (defined(__clang__) || __GNUC__ >= 5)
+#define MAP_SPARSIFICATION_POPCNT_KERNEL
+#endif
+
+namespace map_sparsification {
+namespace scoring {
+
+namespace {
+constexpr size_t kNumBytesPerWord = sizeof(uint64_t);
+
+// Both helpers are always inlined, such that the popcount builtin compiles to
+// the popcnt instruction in the popcnt kernel.
+__attribute__((always_inline)) inline uint64_t loadWord(
+    const unsigned char* descriptor, const size_t word_idx,
+    const size_t descriptor_size_bytes) {
+  const size_t byte_idx = word_idx * kNumBytesPerWord;
+  uint64_t word = 0u;
+  std::memcpy(
+      &word, descriptor + byte_idx,
+      std::min(kNumBytesPerWord, descriptor_size_bytes - byte_idx));
+  return word;
+}
+
+__attribute__((always_inline)) inline double sumOfSquaredDistancesToMean(
+    const std::vector<uint64_t>& mean_words,
+    const unsigned char* const* descriptors, const size_t num_descriptors,
+    const size_t descriptor_size_bytes) {
+  double sum_of_squared_distances = 0.0;
+  for (size_t descriptor_idx = 0u; descriptor_idx < num_descriptors;
+       ++descriptor_idx) {
+    uint64_t distance = 0u;
+    for (size_t word_idx = 0u; word_idx < mean_words.size(); ++word_idx) {
+      distance += __builtin_popcountll(
+          loadWord(
+              descriptors[descriptor_idx], word_idx, descriptor_size_bytes) ^
+          mean_words[word_idx]);
+    }
+    sum_of_squared_distances += static_cast<double>(distance * distance);
+  }
+  return sum_of_squared_distances;
+}
+
+#if defined(MAP_SPARSIFICATION_POPCNT_KERNEL)
+__attribute__((target("popcnt"))) double popcntSumOfSquaredDistancesToMean(
+    const std::vector<uint64_t>& mean_words,
+    const unsigned char* const* descriptors, const size_t num_descriptors,
+    const size_t descriptor_size_bytes) {
+  return sumOfSquaredDistancesToMean(
+      mean_words, descriptors, num_descriptors, descriptor_size_bytes);
+}
+
+bool isPopcntSupported() {
+  static const bool kIsPopcntSupported = __builtin_cpu_supports("popcnt");
+  return kIsPopcntSupported;
+}
+#endif  // MAP_SPARSIFICATION_POPCNT_KERNEL
+}  // namespace
+
+double descriptorMeanStandardDeviation(
+    const unsigned char* const* descriptors, const size_t num_descriptors,
+    const size_t descriptor_size_bytes) {
+  if (num_descriptors == 0u) {
+    return 0.0;
+  }
+  CHECK_NOTNULL(descriptors);
+
+  // Count the set bits of every bit position to get the majority descriptor.
+  std::vector<uint32_t> bit_counts(descriptor_size_bytes * 8u, 0u);
+  for (size_t descriptor_idx = 0u; descriptor_idx < num_descriptors;
+       ++descriptor_idx) {
+    const unsigned char* descriptor =
+        CHECK_NOTNULL(descriptors[descriptor_idx]);
+    for (size_t byte_idx = 0u; byte_idx < descriptor_size_bytes; ++byte_idx) {
+      const unsigned char byte = descriptor[byte_idx];
+      uint32_t* byte_bit_counts = &bit_counts[byte_idx * 8u];
+      for (size_t bit_idx = 0u; bit_idx < 8u; ++bit_idx) {
+        byte_bit_counts[bit_idx] += (byte >> bit_idx) & 1u;
+      }
+    }
+  }
+
+  const size_t num_words =
+      (descriptor_size_bytes + kNumBytesPerWord - 1u) / kNumBytesPerWord;
+  std::vector<unsigned char> mean_descriptor(
+      num_words * kNumBytesPerWord, 0u);
+  for (size_t byte_idx = 0u; byte_idx < descriptor_size_bytes; ++byte_idx) {
+    for (size_t bit_idx = 0u; bit_idx < 8u; ++bit_idx) {
+      if (2u * bit_counts[byte_idx * 8u + bit_idx] > num_descriptors) {
+        mean_descriptor[byte_idx] |= static_cast<unsigned char>(1u << bit_idx);
+      }
+    }
+  }
+  std::vector<uint64_t> mean_words(num_words);
+  std::memcpy(
+      mean_words.data(), mean_descriptor.data(), mean_descriptor.size());
+
+  double sum_of_squared_distances;
+#if defined(MAP_SPARSIFICATION_POPCNT_KERNEL)
+  if (isPopcntSupported()) {
+    sum_of_squared_distances = popcntSumOfSquaredDistancesToMean(
+        mean_words, descriptors, num_descriptors, descriptor_size_bytes);
+  } else {
+    sum_of_squared_distances = sumOfSquaredDistancesToMean(
+        mean_words, descriptors, num_descriptors, descriptor_size_bytes);
+  }
+#else
+  sum_of_squared_distances = sumOfSquaredDistancesToMean(
+      mean_words, descriptors, num_descriptors, descriptor_size_bytes);
+#endif  // MAP_SPARSIFICATION_POPCNT_KERNEL
+  return std::sqrt(sum_of_squared_distances / num_descriptors);
+}
+
+}  // namespace scoring
+}  // namespace map_sparsification
@@ -0,0 +1,75 @@
+#include "map-sparsification/heuristic/scoring/descriptor-variance-scoring.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
+#include <vi-map/descriptor-arena.h>
+
+#include "map-sparsification/heuristic/scoring/descriptor-bit-statistics.h"
+
+namespace map_sparsification {
+namespace scoring {
+
+double DescriptorVarianceScoring::scoreImpl(
+    const vi_map::LandmarkId& landmark_id, const vi_map::VIMap& map) const {
+  CHECK(map.hasLandmark(landmark_id));
+  vi_map::VIMap::DescriptorsType descriptors;
+  map.getLandmarkDescriptors(landmark_id, &descriptors);
+  std::vector<const unsigned char*> descriptor_ptrs(descriptors.cols());
+  for (int i = 0; i < descriptors.cols(); ++i) {
+    descriptor_ptrs[i] = descriptors.col(i).data();
+  }
+  const double descriptor_std_dev = descriptorMeanStandardDeviation(
+      descriptor_ptrs.data(), descriptor_ptrs.size(), descriptors.rows());
+  return std::max(descriptor_dev_scoring_threshold_ - descriptor_std_dev, 0.0);
+}
+
+void DescriptorVarianceScoring::scoreBatchImpl(
+    const vi_map::LandmarkIdList& landmark_ids, const vi_map::VIMap& map,
+    std::vector<double>* raw_scores) const {
+  CHECK_NOTNULL(raw_scores)->assign(landmark_ids.size(), 0.0);
+  if (landmark_ids.empty()) {
+    return;
+  }
+
+  pose_graph::VertexIdList observer_vertex_ids;
+  pose_graph::VertexIdSet observer_vertex_id_set;
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+    for (const vi_map::KeypointIdentifier& observation :
+         map.getLandmark(landmark_id).getObservations()) {
+      const pose_graph::VertexId& vertex_id = observation.frame_id.vertex_id;
+      if (observer_vertex_id_set.insert(vertex_id).second) {
+        observer_vertex_ids.push_back(vertex_id);
+      }
+    }
+  }
+  const vi_map::DescriptorArena descriptor_arena(map, observer_vertex_ids);
+  const size_t descriptor_size_bytes =
+      descriptor_arena.getDescriptorSizeBytes();
+
+  common::ParallelProcessDynamic(
+      landmark_ids.size(),
+      [&](const size_t landmark_begin, const size_t landmark_end) {
+        std::vector<const unsigned char*> descriptors;
+        for (size_t landmark_idx = landmark_begin; landmark_idx < landmark_end;
+             ++landmark_idx) {
+          const vi_map::KeypointIdentifierList& observations =
+              map.getLandmark(landmark_ids[landmark_idx]).getObservations();
+          descriptors.clear();
+          for (const vi_map::KeypointIdentifier& observation : observations) {
+            descriptors.push_back(descriptor_arena.getDescriptor(observation));
+          }
+          const double descriptor_std_dev = descriptorMeanStandardDeviation(
+              descriptors.data(), descriptors.size(), descriptor_size_bytes);
+          (*raw_scores)[landmark_idx] = std::max(
+              descriptor_dev_scoring_threshold_ - descriptor_std_dev, 0.0);
+        }
+      },
+      common::getNumHardwareThreads());
+}
+
+}  // namespace scoring
+}  // namespace map_sparsification
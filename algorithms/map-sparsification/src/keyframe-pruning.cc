@@ -6,6 +6,8 @@
 #include <Eigen/Core>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 #include <posegraph/unique-id.h>
 #include <vi-map-helpers/vi-map-queries.h>
 #include <vi-map/vi-map.h>
@@ -17,31 +19,12 @@ DEFINE_double(kf_rotation_threshold_deg, 20,
 DEFINE_uint64(kf_every_nth_vertex, 10, "Force a keyframe every n-th vertex.");
 DEFINE_uint64(kf_min_shared_landmarks_obs, 20,
               "Coobserved landmark number to add a new keyframe.");
+DEFINE_uint64(
+    kf_num_threads, 0u,
+    "Number of threads to select the keyframes of multiple missions with. "
+    "(0: number of hardware threads)");
 
 namespace map_sparsification {
-namespace {
-size_t removeAllVerticesBetweenTwoVertices(
-    pose_graph::Edge::EdgeType traversal_edge,
-    const pose_graph::VertexId& start_kf_id,
-    const pose_graph::VertexId& end_kf_id,
-    vi_map::VIMap* map) {
-  CHECK_NOTNULL(map);
-  CHECK(traversal_edge != pose_graph::Edge::EdgeType::kUndefined);
-  CHECK(start_kf_id.isValid());
-  CHECK(end_kf_id.isValid());
-
-  size_t num_merged_vertices = 0u;
-  pose_graph::VertexId current_vertex_id;
-  while (map->getNextVertex(start_kf_id, traversal_edge, &current_vertex_id) &&
-         current_vertex_id != end_kf_id) {
-    CHECK(current_vertex_id.isValid());
-    CHECK(start_kf_id != current_vertex_id);
-    map->mergeNeighboringVertices(start_kf_id, current_vertex_id);
-    ++num_merged_vertices;
-  }
-  return num_merged_vertices;
-}
-}  // namespace
 
 KeyframingHeuristicsOptions
 KeyframingHeuristicsOptions::initializeFromGFlags() {
@@ -152,26 +135,51 @@ size_t selectKeyframesBasedOnHeuristics(
   return selected_keyframes->size();
 }
 
+void selectKeyframesOfMissionsBasedOnHeuristics(
+    const vi_map::VIMap& map, const vi_map::MissionIdList& mission_ids,
+    const KeyframingHeuristicsOptions& options,
+    std::vector<pose_graph::VertexIdList>* mission_keyframe_ids) {
+  CHECK_NOTNULL(mission_keyframe_ids)->clear();
+  mission_keyframe_ids->resize(mission_ids.size());
+
+  // The selection only reads the map, so the missions are processed
+  // concurrently.
+  const size_t num_threads = FLAGS_kf_num_threads > 0u
+                                 ? FLAGS_kf_num_threads
+                                 : common::getNumHardwareThreads();
+  common::ParallelProcessDynamic(
+      mission_ids.size(),
+      [&](const size_t mission_begin, const size_t mission_end) {
+        for (size_t mission_idx = mission_begin; mission_idx < mission_end;
+             ++mission_idx) {
+          const vi_map::MissionId& mission_id = mission_ids[mission_idx];
+          CHECK(mission_id.isValid());
+          const pose_graph::VertexId& root_vertex_id =
+              map.getMission(mission_id).getRootVertexId();
+          CHECK(root_vertex_id.isValid());
+          const pose_graph::VertexId last_vertex_id =
+              map.getLastVertexIdOfMission(mission_id);
+
+          pose_graph::VertexIdList& keyframe_ids =
+              (*mission_keyframe_ids)[mission_idx];
+          selectKeyframesBasedOnHeuristics(
+              map, root_vertex_id, last_vertex_id, options, &keyframe_ids);
+          if (!keyframe_ids.empty() && keyframe_ids.back() != last_vertex_id) {
+            keyframe_ids.emplace_back(last_vertex_id);
+          }
+        }
+      },
+      num_threads, common::ParallelSchedule::kDynamic);
+}
+
 size_t removeVerticesBetweenKeyframes(
     const pose_graph::VertexIdList& keyframe_ids, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
   // Nothing to remove if there are less than two keyframes.
   if (keyframe_ids.size() < 2) {
     return 0u;
   }
-
-  const vi_map::MissionId& mission_id =
-      map->getMissionIdForVertex(keyframe_ids.front());
-  pose_graph::Edge::EdgeType traversal_edge =
-      map->getGraphTraversalEdgeType(mission_id);
-
-  size_t num_removed_vertices = 0u;
-  for (size_t idx = 0u; idx < keyframe_ids.size() - 1; ++idx) {
-    CHECK_EQ(mission_id, map->getMissionIdForVertex(keyframe_ids[idx + 1]))
-        << "All keyframes must be of the same mission.";
-    num_removed_vertices += removeAllVerticesBetweenTwoVertices(
-        traversal_edge, keyframe_ids[idx], keyframe_ids[idx + 1], map);
-  }
-  return num_removed_vertices;
+  return map->mergeAllVerticesBetweenVertices(keyframe_ids);
 }
 
 }  // namespace map_sparsification
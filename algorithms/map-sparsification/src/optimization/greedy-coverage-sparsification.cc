@@ -0,0 +1,169 @@
+#include "map-sparsification/optimization/greedy-coverage-sparsification.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace map_sparsification {
+
+namespace {
+// Gain of covering one more of the required landmarks of a keyframe. Larger
+// than the observation count of any landmark, such that covering the
+// keyframes always takes precedence.
+constexpr double kCoverageGain = 1e6;
+
+// The clock is only checked every few selection steps.
+constexpr size_t kNumStepsPerTimeCheck = 256u;
+
+struct LandmarkGain {
+  double gain;
+  size_t landmark_idx;
+
+  bool operator<(const LandmarkGain& other) const {
+    // Ties are broken by the landmark index to keep the selection
+    // deterministic.
+    if (gain != other.gain) {
+      return gain < other.gain;
+    }
+    return landmark_idx > other.landmark_idx;
+  }
+};
+}  // namespace
+
+void GreedyCoverageSparsification::sampleMapSegment(
+    const vi_map::VIMap& map, unsigned int desired_num_landmarks,
+    unsigned int time_limit_seconds,
+    const vi_map::LandmarkIdSet& segment_landmark_id_set,
+    const pose_graph::VertexIdList& segment_vertex_id_list,
+    vi_map::LandmarkIdSet* summary_landmark_ids) {
+  CHECK_NOTNULL(summary_landmark_ids)->clear();
+
+  // Bail out early if the desired count is smaller than the current count.
+  if (segment_landmark_id_set.size() <= desired_num_landmarks) {
+    LOG(WARNING) << "Nothing to summarize, bailing out early.";
+    summary_landmark_ids->insert(
+        segment_landmark_id_set.begin(), segment_landmark_id_set.end());
+    return;
+  }
+
+  const std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::now() +
+      std::chrono::seconds(time_limit_seconds);
+
+  const vi_map::LandmarkIdList landmark_ids(
+      segment_landmark_id_set.begin(), segment_landmark_id_set.end());
+  const size_t num_landmarks = landmark_ids.size();
+  std::unordered_map<vi_map::LandmarkId, size_t> landmark_ids_to_indices;
+  std::vector<double> observation_scores(num_landmarks);
+  for (size_t landmark_idx = 0u; landmark_idx < num_landmarks;
+       ++landmark_idx) {
+    const vi_map::LandmarkId& landmark_id = landmark_ids[landmark_idx];
+    landmark_ids_to_indices.emplace(landmark_id, landmark_idx);
+    observation_scores[landmark_idx] = static_cast<double>(
+        map.getLandmark(landmark_id).getObservations().size());
+  }
+
+  // The keyframes of the segment observing every landmark and the number of
+  // landmarks every keyframe still needs to fulfill its constraint.
+  std::vector<std::vector<size_t>> landmark_keyframes(num_landmarks);
+  std::vector<unsigned int> num_missing_keyframe_landmarks;
+  num_missing_keyframe_landmarks.reserve(segment_vertex_id_list.size());
+  for (const pose_graph::VertexId& vertex_id : segment_vertex_id_list) {
+    vi_map::LandmarkIdList observed_landmark_ids;
+    map.getVertex(vertex_id).getAllObservedLandmarkIds(&observed_landmark_ids);
+    std::unordered_set<size_t> keyframe_landmarks;
+    for (const vi_map::LandmarkId& landmark_id : observed_landmark_ids) {
+      if (!landmark_id.isValid()) {
+        continue;
+      }
+      const std::unordered_map<vi_map::LandmarkId, size_t>::const_iterator it =
+          landmark_ids_to_indices.find(landmark_id);
+      if (it != landmark_ids_to_indices.end()) {
+        keyframe_landmarks.insert(it->second);
+      }
+    }
+
+    const size_t keyframe_idx = num_missing_keyframe_landmarks.size();
+    num_missing_keyframe_landmarks.push_back(
+        std::min<size_t>(
+            min_keypoints_per_keyframe_, keyframe_landmarks.size()));
+    for (const size_t landmark_idx : keyframe_landmarks) {
+      landmark_keyframes[landmark_idx].push_back(keyframe_idx);
+    }
+  }
+
+  auto computeGain = [&](const size_t landmark_idx) -> double {
+    double gain = observation_scores[landmark_idx];
+    for (const size_t keyframe_idx : landmark_keyframes[landmark_idx]) {
+      if (num_missing_keyframe_landmarks[keyframe_idx] > 0u) {
+        gain += kCoverageGain;
+      }
+    }
+    return gain;
+  };
+
+  std::vector<LandmarkGain> initial_gains(num_landmarks);
+  for (size_t landmark_idx = 0u; landmark_idx < num_landmarks;
+       ++landmark_idx) {
+    initial_gains[landmark_idx].gain = computeGain(landmark_idx);
+    initial_gains[landmark_idx].landmark_idx = landmark_idx;
+  }
+  std::priority_queue<LandmarkGain> gain_queue(
+      std::less<LandmarkGain>(), std::move(initial_gains));
+
+  // The gains only decrease as more landmarks are selected, so the queue
+  // holds upper bounds of the gains. The top landmark is selected as soon as
+  // its re-evaluated gain didn't change.
+  bool time_limit_reached = false;
+  size_t num_steps = 0u;
+  while (summary_landmark_ids->size() < desired_num_landmarks) {
+    CHECK(!gain_queue.empty());
+    LandmarkGain landmark_gain = gain_queue.top();
+    gain_queue.pop();
+
+    if (!time_limit_reached && (++num_steps % kNumStepsPerTimeCheck) == 0u &&
+        std::chrono::steady_clock::now() > deadline) {
+      LOG(WARNING) << "Greedy landmark selection reached the time limit of "
+                   << time_limit_seconds << "s, selecting the remaining "
+                   << (desired_num_landmarks - summary_landmark_ids->size())
+                   << " landmarks by their last evaluated gain.";
+      time_limit_reached = true;
+    }
+
+    if (!time_limit_reached) {
+      const double gain = computeGain(landmark_gain.landmark_idx);
+      if (gain < landmark_gain.gain) {
+        landmark_gain.gain = gain;
+        gain_queue.push(landmark_gain);
+        continue;
+      }
+    }
+
+    summary_landmark_ids->insert(landmark_ids[landmark_gain.landmark_idx]);
+    for (const size_t keyframe_idx :
+         landmark_keyframes[landmark_gain.landmark_idx]) {
+      if (num_missing_keyframe_landmarks[keyframe_idx] > 0u) {
+        --num_missing_keyframe_landmarks[keyframe_idx];
+      }
+    }
+  }
+  CHECK_EQ(desired_num_landmarks, summary_landmark_ids->size());
+
+  const size_t num_unconstrained_keyframes = std::count_if(
+      num_missing_keyframe_landmarks.begin(),
+      num_missing_keyframe_landmarks.end(),
+      [](const unsigned int num_missing) { return num_missing > 0u; });
+  if (num_unconstrained_keyframes > 0u) {
+    LOG(WARNING) << num_unconstrained_keyframes << " keyframes have less than "
+                 << min_keypoints_per_keyframe_ << " selected landmarks.";
+  }
+}
+
+}  // namespace map_sparsification
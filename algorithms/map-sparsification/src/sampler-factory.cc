@@ -9,6 +9,7 @@
 #include "map-sparsification/heuristic/random-sampling.h"
 #include "map-sparsification/heuristic/scoring/descriptor-variance-scoring.h"
 #include "map-sparsification/heuristic/scoring/observation-count-scoring.h"
+#include "map-sparsification/optimization/greedy-coverage-sparsification.h"
 #include "map-sparsification/optimization/lp-solve-sparsification.h"
 
 namespace map_sparsification {
@@ -17,6 +18,10 @@ DEFINE_int32(sparsification_min_keypoints_per_keyframe, 30,
              "Minimum desired number of keypoints per each map keyframe");
 DEFINE_double(sparsification_descriptor_dev_scoring_threshold, 10,
               "Minimum desired number of keypoints per each map keyframe");
+DEFINE_uint64(
+    sparsification_greedy_max_landmarks_per_partition, 100000u,
+    "Maximum number of well constrained landmarks per map partition of the "
+    "partitioned greedy coverage landmark sampler.");
 
 SamplerBase::Ptr createSampler(SamplerBase::Type sampler_type) {
   typedef map_sparsification::sampling::NoLandmarkSampling NoLandmarkSampling;
@@ -76,10 +81,27 @@ SamplerBase::Ptr createSampler(SamplerBase::Type sampler_type) {
               FLAGS_sparsification_min_keypoints_per_keyframe));
     } break;
     case SamplerBase::Type::kLpsolvePartitionIlp: {
-      SamplerBase::Ptr ilp_sampler =
-          createSampler(SamplerBase::Type::kLpsolveIlp);
-      CHECK(ilp_sampler != nullptr);
-      sampler.reset(new GraphPartitionSampler(ilp_sampler));
+      // Every partition gets its own ILP sampler, such that the partitions
+      // can be sampled concurrently.
+      GraphPartitionSampler::SamplerCreator ilp_sampler_creator = []() {
+        return createSampler(SamplerBase::Type::kLpsolveIlp);
+      };
+      sampler.reset(new GraphPartitionSampler(ilp_sampler_creator));
+    } break;
+    case SamplerBase::Type::kGreedyCoverage: {
+      sampler.reset(
+          new GreedyCoverageSparsification(
+              FLAGS_sparsification_min_keypoints_per_keyframe));
+    } break;
+    case SamplerBase::Type::kGreedyCoveragePartition: {
+      GraphPartitionSampler::SamplerCreator greedy_sampler_creator = []() {
+        return createSampler(SamplerBase::Type::kGreedyCoverage);
+      };
+      GraphPartitionSampler::Ptr partition_sampler(
+          new GraphPartitionSampler(greedy_sampler_creator));
+      partition_sampler->setMaxNumLandmarksPerPartition(
+          FLAGS_sparsification_greedy_max_landmarks_per_partition);
+      sampler = partition_sampler;
     } break;
     default:
       LOG(FATAL) << "Unknown landmark sampler type: "
@@ -1,9 +1,13 @@
+#include <cmath>
 #include <memory>
+#include <random>
+#include <vector>
 
 #include <Eigen/Core>
 
 #include <map-sparsification/heuristic/cost-functions/min-keypoints-per-keyframe-cost.h>
 #include <map-sparsification/heuristic/heuristic-sampling.h>
+#include <map-sparsification/heuristic/scoring/descriptor-bit-statistics.h>
 #include <map-sparsification/heuristic/scoring/descriptor-variance-scoring.h>
 #include <map-sparsification/heuristic/scoring/observation-count-scoring.h>
 #include <maplab-common/test/testing-entrypoint.h>
@@ -235,4 +239,52 @@ TEST_F(MapSparsification, KeyframeKeypointConstraintSparsificationTest) {
   expectPreservedLandmark(summary_landmark_list, landmark_to_be_preserved);
 }
 
+TEST(DescriptorBitStatistics, MatchesBitwiseMeanStandardDeviation) {
+  std::mt19937 random_engine(42);
+  std::uniform_int_distribution<int> random_byte(0, 255);
+  // Descriptor sizes that are and aren't multiples of the 64 bit words.
+  for (const size_t descriptor_size_bytes : {48u, 64u, 13u}) {
+    constexpr size_t kNumDescriptors = 17u;
+    std::vector<std::vector<unsigned char>> descriptors(
+        kNumDescriptors, std::vector<unsigned char>(descriptor_size_bytes));
+    std::vector<const unsigned char*> descriptor_ptrs;
+    for (std::vector<unsigned char>& descriptor : descriptors) {
+      for (unsigned char& byte : descriptor) {
+        byte = static_cast<unsigned char>(random_byte(random_engine));
+      }
+      descriptor_ptrs.push_back(descriptor.data());
+    }
+
+    auto getBit = [](
+        const std::vector<unsigned char>& descriptor, const size_t bit_idx) {
+      return (descriptor[bit_idx / 8u] >> (bit_idx % 8u)) & 1u;
+    };
+    double sum_of_squared_distances = 0.0;
+    for (const std::vector<unsigned char>& descriptor : descriptors) {
+      size_t distance = 0u;
+      for (size_t bit_idx = 0u; bit_idx < descriptor_size_bytes * 8u;
+           ++bit_idx) {
+        size_t num_set_bits = 0u;
+        for (const std::vector<unsigned char>& other : descriptors) {
+          num_set_bits += getBit(other, bit_idx);
+        }
+        const unsigned int mean_bit = 2u * num_set_bits > kNumDescriptors;
+        distance += getBit(descriptor, bit_idx) != mean_bit;
+      }
+      sum_of_squared_distances += distance * distance;
+    }
+    const double expected_std_dev =
+        std::sqrt(sum_of_squared_distances / kNumDescriptors);
+
+    EXPECT_NEAR(
+        expected_std_dev,
+        map_sparsification::scoring::descriptorMeanStandardDeviation(
+            descriptor_ptrs.data(), kNumDescriptors, descriptor_size_bytes),
+        1e-9);
+  }
+  EXPECT_EQ(
+      0.0, map_sparsification::scoring::descriptorMeanStandardDeviation(
+               nullptr, 0u, 48u));
+}
+
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -1,3 +1,4 @@
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
 #include <maplab-common/test/testing-entrypoint.h>
 #include <maplab-common/test/testing-predicates.h>
@@ -10,6 +11,8 @@
 
 namespace map_sparsification {
 
+DECLARE_uint64(sparsification_partition_sampling_num_threads);
+
 class ViMappingTest : public ::testing::Test {
  protected:
   virtual void SetUp() {
@@ -26,8 +29,29 @@ class ViMappingTest : public ::testing::Test {
     }
   }
 
-  void constructSampler() {
-    sampler_ = createSampler(SamplerBase::Type::kLpsolveIlp);
+  void constructSampler(
+      SamplerBase::Type sampler_type = SamplerBase::Type::kLpsolveIlp) {
+    sampler_ = createSampler(sampler_type);
+  }
+
+  void sampleLandmarksWithTimeLimit(
+      unsigned int time_limit_seconds,
+      vi_map::LandmarkIdSet* landmarks_to_keep) {
+    CHECK(sampler_ != nullptr);
+    CHECK_NOTNULL(landmarks_to_keep);
+    const vi_map::VIMap& vi_map = *CHECK_NOTNULL(test_app_.getMapMutable());
+
+    vi_map::LandmarkIdSet all_landmark_ids;
+    vi_map.getAllLandmarkIds(&all_landmark_ids);
+    pose_graph::VertexIdList all_vertex_ids;
+    vi_map.getAllVertexIds(&all_vertex_ids);
+
+    const size_t desired_num_landmarks = 0.25 * all_landmark_ids.size();
+    sampler_->sampleMapSegment(
+        vi_map, desired_num_landmarks, time_limit_seconds, all_landmark_ids,
+        all_vertex_ids, landmarks_to_keep);
+
+    EXPECT_EQ(desired_num_landmarks, landmarks_to_keep->size());
   }
 
   void sampleLandmarks(vi_map::LandmarkIdSet* landmarks_to_keep) {
@@ -58,6 +82,22 @@ class ViMappingTest : public ::testing::Test {
     EXPECT_LE(landmarks_to_keep->size(), desired_num_landmarks);
   }
 
+  void sampleLandmarksWithConcurrentPartitioning(
+      vi_map::LandmarkIdSet* landmarks_to_keep) {
+    CHECK_NOTNULL(landmarks_to_keep);
+    const vi_map::VIMap& vi_map = *CHECK_NOTNULL(test_app_.getMapMutable());
+
+    GraphPartitionSampler partition_sampler([]() {
+      return createSampler(SamplerBase::Type::kLpsolveIlp);
+    });
+
+    const size_t num_landmarks = vi_map.numLandmarksInIndex();
+    const size_t desired_num_landmarks = 0.25 * num_landmarks;
+    partition_sampler.sample(vi_map, desired_num_landmarks, landmarks_to_keep);
+
+    EXPECT_LE(landmarks_to_keep->size(), desired_num_landmarks);
+  }
+
   void evaluteLandmarkSelection(
       const vi_map::LandmarkIdSet& landmarks_to_keep) {
     const vi_map::VIMap& vi_map = *CHECK_NOTNULL(test_app_.getMapMutable());
@@ -122,6 +162,36 @@ TEST_F(ViMappingTest, PartitionedLpsolveLandmarkSparsificationWorks) {
   evaluteLandmarkSelection(landmarks_to_keep);
 }
 
+TEST_F(ViMappingTest, GreedyCoverageLandmarkSparsificationWorks) {
+  constructSampler(SamplerBase::Type::kGreedyCoverage);
+
+  vi_map::LandmarkIdSet landmarks_to_keep;
+  sampleLandmarks(&landmarks_to_keep);
+
+  evaluteLandmarkSelection(landmarks_to_keep);
+}
+
+TEST_F(ViMappingTest, GreedyCoverageWorksWithoutTime) {
+  constructSampler(SamplerBase::Type::kGreedyCoverage);
+
+  // Once the time is up, the remaining landmarks are selected by their last
+  // evaluated gains.
+  constexpr unsigned int kTimeLimitSeconds = 0u;
+  vi_map::LandmarkIdSet landmarks_to_keep;
+  sampleLandmarksWithTimeLimit(kTimeLimitSeconds, &landmarks_to_keep);
+
+  evaluteLandmarkSelection(landmarks_to_keep);
+}
+
+TEST_F(ViMappingTest, ConcurrentPartitionedLpsolveLandmarkSparsificationWorks) {
+  FLAGS_sparsification_partition_sampling_num_threads = 4u;
+
+  vi_map::LandmarkIdSet landmarks_to_keep;
+  sampleLandmarksWithConcurrentPartitioning(&landmarks_to_keep);
+
+  evaluteLandmarkSelection(landmarks_to_keep);
+}
+
 }  // namespace map_sparsification
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -1,9 +1,11 @@
 #ifndef ONLINE_MAP_BUILDERS_STREAM_MAP_BUILDER_H_
 #define ONLINE_MAP_BUILDERS_STREAM_MAP_BUILDER_H_
 
+#include <deque>
 #include <memory>
 
 #include <Eigen/Dense>
+#include <map-sparsification/keyframe-pruning.h>
 #include <posegraph/unique-id.h>
 #include <sensors/imu.h>
 #include <sensors/sensor.h>
@@ -24,6 +26,14 @@ class VIMap;
 }
 
 namespace online_map_builders {
+// Builds a VI map from a stream of VIO updates. If online keyframing is
+// enabled (--map_builder_online_keyframing), the keyframing heuristics of the
+// map sparsification are applied while mapping: every vertex that is not
+// selected as keyframe is merged into the preceding keyframe as soon as its
+// successor has been added, i.e. its visual frame is dropped and its IMU edge
+// is concatenated with the next one. As no landmarks exist during online
+// mapping, the co-observation criterion counts the feature tracks the vertex
+// shares with the last keyframe.
 class StreamMapBuilder {
  public:
   StreamMapBuilder(
@@ -32,7 +42,8 @@ class StreamMapBuilder {
       const std::shared_ptr<aslam::NCamera>& camera_rig,
       vi_map::Imu::UniquePtr imu, vi_map::VIMap* map);
 
-  // Deep copies the nframe.
+  // Deep copies the nframe. Without the deep copy, the vertex shares the
+  // nframe of the update.
   void apply(const vio::VioUpdate& update);
   void apply(const vio::VioUpdate& update, bool deep_copy_nframe);
 
@@ -49,6 +60,10 @@ class StreamMapBuilder {
 
   bool checkConsistency() const;
 
+  size_t getNumMergedVertices() const {
+    return num_merged_vertices_;
+  }
+
  private:
   void addRootViwlsVertex(
       const std::shared_ptr<aslam::VisualNFrame>& nframe,
@@ -66,8 +81,18 @@ class StreamMapBuilder {
 
   void addImuEdge(
       pose_graph::VertexId target_vertex_id,
-      const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps,
-      const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_measurements);
+      Eigen::Matrix<int64_t, 1, Eigen::Dynamic> imu_timestamps,
+      Eigen::Matrix<double, 6, Eigen::Dynamic> imu_measurements);
+
+  // Releases the images of the vertices that fall out of the most recent
+  // kKeepNMostRecentImages vertices before the last one.
+  void releaseOldVisualFrameImages(const pose_graph::VertexId& new_vertex_id);
+
+  // Decides whether the last added vertex is a keyframe and merges the
+  // vertex before it into the last keyframe if it was not.
+  void applyOnlineKeyframing(const pose_graph::VertexId& previous_vertex_id);
+  bool isKeyframe(const pose_graph::VertexId& vertex_id) const;
+  void resetOnlineKeyframing(const pose_graph::VertexId& keyframe_id);
 
   inline const vi_map::VIMap* constMap() const;
 
@@ -77,6 +102,17 @@ class StreamMapBuilder {
   pose_graph::VertexId last_vertex_;
   const std::shared_ptr<aslam::NCamera> camera_rig_;
 
+  const bool online_keyframing_;
+  const map_sparsification::KeyframingHeuristicsOptions keyframing_options_;
+  pose_graph::VertexId last_keyframe_;
+  bool last_vertex_is_keyframe_;
+  size_t num_vertices_since_last_keyframe_;
+  size_t num_merged_vertices_;
+
+  // The most recent vertices that may still hold images, oldest first. This
+  // avoids walking the whole mission back for every new vertex.
+  std::deque<pose_graph::VertexId> vertices_with_images_;
+
   static constexpr size_t kKeepNMostRecentImages = 10u;
 };
 
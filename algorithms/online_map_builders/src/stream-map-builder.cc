@@ -1,8 +1,13 @@
 #include "online-map-builders/stream-map-builder.h"
 
+#include <algorithm>
+#include <unordered_set>
+#include <utility>
+
 #include <aslam/common/stl-helpers.h>
 #include <aslam/frames/visual-nframe.h>
 #include <glog/logging.h>
+#include <maplab-common/conversions.h>
 #include <vi-map-helpers/vi-map-manipulation.h>
 #include <vi-map-helpers/vi-map-queries.h>
 #include <vi-map/check-map-consistency.h>
@@ -14,8 +19,49 @@ DEFINE_bool(
     map_builder_save_image_as_resources, false,
     "Store the images associated with the visual frames to the map resource "
     "folder.");
+DEFINE_bool(
+    map_builder_online_keyframing, false,
+    "Apply the keyframing heuristics (--kf_*) while building the map and "
+    "merge all non-keyframe vertices into IMU edges on the fly.");
 
 namespace online_map_builders {
+namespace {
+size_t getNumberOfCommonTracks(
+    const vi_map::Vertex& vertex_a, const vi_map::Vertex& vertex_b) {
+  std::unordered_set<int> track_ids_a;
+  const aslam::VisualNFrame& nframe_a = vertex_a.getVisualNFrame();
+  for (size_t frame_idx = 0u; frame_idx < nframe_a.getNumFrames();
+       ++frame_idx) {
+    if (!nframe_a.isFrameSet(frame_idx)) {
+      continue;
+    }
+    const Eigen::VectorXi& track_ids =
+        nframe_a.getFrame(frame_idx).getTrackIds();
+    for (int i = 0; i < track_ids.rows(); ++i) {
+      if (track_ids(i) >= 0) {
+        track_ids_a.insert(track_ids(i));
+      }
+    }
+  }
+
+  size_t num_common_tracks = 0u;
+  const aslam::VisualNFrame& nframe_b = vertex_b.getVisualNFrame();
+  for (size_t frame_idx = 0u; frame_idx < nframe_b.getNumFrames();
+       ++frame_idx) {
+    if (!nframe_b.isFrameSet(frame_idx)) {
+      continue;
+    }
+    const Eigen::VectorXi& track_ids =
+        nframe_b.getFrame(frame_idx).getTrackIds();
+    for (int i = 0; i < track_ids.rows(); ++i) {
+      if (track_ids(i) >= 0 && track_ids_a.count(track_ids(i)) > 0u) {
+        ++num_common_tracks;
+      }
+    }
+  }
+  return num_common_tracks;
+}
+}  // namespace
 
 const vi_map::VIMap* StreamMapBuilder::constMap() const {
   return map_;
@@ -36,7 +82,14 @@ StreamMapBuilder::StreamMapBuilder(
     : map_(CHECK_NOTNULL(map)),
       manipulation_(map),
       mission_id_(common::createRandomId<vi_map::MissionId>()),
-      camera_rig_(camera_rig) {
+      camera_rig_(camera_rig),
+      online_keyframing_(FLAGS_map_builder_online_keyframing),
+      keyframing_options_(
+          map_sparsification::KeyframingHeuristicsOptions::
+              initializeFromGFlags()),
+      last_vertex_is_keyframe_(true),
+      num_vertices_since_last_keyframe_(0u),
+      num_merged_vertices_(0u) {
   CHECK(camera_rig);
   map_->addNewMissionWithBaseframe(
       mission_id_, aslam::Transformation(),
@@ -50,7 +103,14 @@ StreamMapBuilder::StreamMapBuilder(
     : map_(CHECK_NOTNULL(map)),
       manipulation_(map),
       mission_id_(common::createRandomId<vi_map::MissionId>()),
-      camera_rig_(camera_rig) {
+      camera_rig_(camera_rig),
+      online_keyframing_(FLAGS_map_builder_online_keyframing),
+      keyframing_options_(
+          map_sparsification::KeyframingHeuristicsOptions::
+              initializeFromGFlags()),
+      last_vertex_is_keyframe_(true),
+      num_vertices_since_last_keyframe_(0u),
+      num_merged_vertices_(0u) {
   CHECK(camera_rig);
   map_->addNewMissionWithBaseframe(
       mission_id_, aslam::Transformation(),
@@ -82,12 +142,17 @@ void StreamMapBuilder::apply(
 
   if (!last_vertex_.isValid()) {
     addRootViwlsVertex(nframe_to_insert, update.vinode);
+    resetOnlineKeyframing(last_vertex_);
   } else {
     CHECK(mission_id_.isValid());
+    const pose_graph::VertexId previous_vertex_id = last_vertex_;
     addViwlsVertexAndEdge(
         nframe_to_insert, update.vinode,
         update.keyframe_and_imudata->imu_timestamps,
         update.keyframe_and_imudata->imu_measurements);
+    if (online_keyframing_) {
+      applyOnlineKeyframing(previous_vertex_id);
+    }
 
     if (update.localization_state == vio::LocalizationState::kLocalized ||
         update.localization_state == vio::LocalizationState::kMapTracking) {
@@ -104,6 +169,7 @@ void StreamMapBuilder::addRootViwlsVertex(
 
   pose_graph::VertexId root_vertex_id = addViwlsVertex(nframe, vinode_state);
   CHECK(root_vertex_id.isValid());
+  releaseOldVisualFrameImages(root_vertex_id);
 
   CHECK(!constMap()->getMission(mission_id_).getRootVertexId().isValid())
       << "Root vertex has already been set for this mission.";
@@ -124,10 +190,32 @@ void StreamMapBuilder::addViwlsVertexAndEdge(
   pose_graph::VertexId new_vertex_id = addViwlsVertex(nframe, vinode_state);
 
   addImuEdge(new_vertex_id, imu_timestamps, imu_data);
+  releaseOldVisualFrameImages(new_vertex_id);
+}
 
-  if (kKeepNMostRecentImages > 0u) {
-    manipulation_.releaseOldVisualFrameImages(
-        last_vertex_, kKeepNMostRecentImages);
+void StreamMapBuilder::releaseOldVisualFrameImages(
+    const pose_graph::VertexId& new_vertex_id) {
+  if (kKeepNMostRecentImages == 0u) {
+    return;
+  }
+  vertices_with_images_.push_back(new_vertex_id);
+  // Same as VIMapManipulation::releaseOldVisualFrameImages on the vertex
+  // before the new one, which keeps the images of that vertex and the
+  // kKeepNMostRecentImages vertices before it.
+  while (vertices_with_images_.size() > kKeepNMostRecentImages + 2u) {
+    const pose_graph::VertexId vertex_id = vertices_with_images_.front();
+    vertices_with_images_.pop_front();
+    // Vertices merged by the online keyframing no longer exist.
+    if (!constMap()->hasVertex(vertex_id)) {
+      continue;
+    }
+    vi_map::Vertex& vertex = map_->getVertex(vertex_id);
+    for (size_t frame_idx = 0u; frame_idx < vertex.numFrames(); ++frame_idx) {
+      const aslam::VisualFrame& frame = vertex.getVisualFrame(frame_idx);
+      if (frame.isValid() && frame.hasRawImage()) {
+        vertex.getVisualFrameShared(frame_idx)->releaseRawImage();
+      }
+    }
   }
 }
 
@@ -152,8 +240,8 @@ pose_graph::VertexId StreamMapBuilder::addViwlsVertex(
   pose_graph::VertexId vertex_id =
       common::createRandomId<pose_graph::VertexId>();
   vi_map::Vertex* map_vertex = new vi_map::Vertex(
-      vertex_id, vinode_state.getImuBias(), nframe, invalid_landmark_ids,
-      mission_id_);
+      vertex_id, vinode_state.getImuBias(), nframe,
+      std::move(invalid_landmark_ids), mission_id_);
   // Set pose and velocity.
   map_vertex->set_T_M_I(vinode_state.get_T_M_I());
   map_vertex->set_v_M(vinode_state.get_v_M_I());
@@ -182,13 +270,76 @@ void StreamMapBuilder::removeAllVerticesAfterVertexId(
     pose_graph::VertexIdList* removed_vertex_ids) {
   CHECK_NOTNULL(removed_vertex_ids);
   manipulation_.removePosegraphAfter(vertex_id_from, removed_vertex_ids);
+  for (const pose_graph::VertexId& removed_vertex_id : *removed_vertex_ids) {
+    vertices_with_images_.erase(
+        std::remove(
+            vertices_with_images_.begin(), vertices_with_images_.end(),
+            removed_vertex_id),
+        vertices_with_images_.end());
+  }
   last_vertex_ = vertex_id_from;
+  resetOnlineKeyframing(vertex_id_from);
+}
+
+void StreamMapBuilder::applyOnlineKeyframing(
+    const pose_graph::VertexId& previous_vertex_id) {
+  CHECK(last_keyframe_.isValid());
+  CHECK(previous_vertex_id.isValid());
+  CHECK(last_vertex_.isValid());
+
+  // The previous vertex now has an outgoing edge, hence it can be merged
+  // without touching the most recent vertex.
+  if (!last_vertex_is_keyframe_) {
+    CHECK_NE(previous_vertex_id, last_keyframe_);
+    map_->mergeNeighboringVertices(last_keyframe_, previous_vertex_id);
+    ++num_merged_vertices_;
+  }
+
+  last_vertex_is_keyframe_ = isKeyframe(last_vertex_);
+  if (last_vertex_is_keyframe_) {
+    last_keyframe_ = last_vertex_;
+    num_vertices_since_last_keyframe_ = 0u;
+  } else {
+    ++num_vertices_since_last_keyframe_;
+  }
+}
+
+bool StreamMapBuilder::isKeyframe(
+    const pose_graph::VertexId& vertex_id) const {
+  // Same conditions and order as in
+  // map_sparsification::selectKeyframesBasedOnHeuristics.
+  if (num_vertices_since_last_keyframe_ >=
+      keyframing_options_.kf_every_nth_vertex) {
+    return true;
+  }
+
+  const vi_map::Vertex& keyframe = constMap()->getVertex(last_keyframe_);
+  const vi_map::Vertex& vertex = constMap()->getVertex(vertex_id);
+  if (getNumberOfCommonTracks(keyframe, vertex) <
+      keyframing_options_.kf_min_shared_landmarks_obs) {
+    return true;
+  }
+
+  const aslam::Transformation T_Ikf_I =
+      keyframe.get_T_M_I().inverse() * vertex.get_T_M_I();
+  return T_Ikf_I.getPosition().norm() >=
+             keyframing_options_.kf_distance_threshold_m ||
+         aslam::AngleAxis(T_Ikf_I.getRotation()).angle() >=
+             keyframing_options_.kf_rotation_threshold_deg * kDegToRad;
+}
+
+void StreamMapBuilder::resetOnlineKeyframing(
+    const pose_graph::VertexId& keyframe_id) {
+  CHECK(keyframe_id.isValid());
+  last_keyframe_ = keyframe_id;
+  last_vertex_is_keyframe_ = true;
+  num_vertices_since_last_keyframe_ = 0u;
 }
 
 void StreamMapBuilder::addImuEdge(
     pose_graph::VertexId target_vertex_id,
-    const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps,
-    const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_measurements) {
+    Eigen::Matrix<int64_t, 1, Eigen::Dynamic> imu_timestamps,
+    Eigen::Matrix<double, 6, Eigen::Dynamic> imu_measurements) {
   CHECK(last_vertex_.isValid());
   CHECK(target_vertex_id.isValid());
   CHECK_EQ(imu_timestamps.cols(), imu_measurements.cols());
@@ -245,8 +396,8 @@ void StreamMapBuilder::addImuEdge(
   pose_graph::EdgeId edge_id = common::createRandomId<pose_graph::EdgeId>();
   map_->addEdge(
       aligned_unique<vi_map::ViwlsEdge>(
-          edge_id, last_vertex_, target_vertex_id, imu_timestamps,
-          imu_measurements));
+          edge_id, last_vertex_, target_vertex_id, std::move(imu_timestamps),
+          std::move(imu_measurements)));
 
   last_vertex_ = target_vertex_id;
 }
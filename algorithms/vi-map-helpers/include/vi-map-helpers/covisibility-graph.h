@@ -0,0 +1,97 @@
+#ifndef VI_MAP_HELPERS_COVISIBILITY_GRAPH_H_
+#define VI_MAP_HELPERS_COVISIBILITY_GRAPH_H_
+
+#include <unordered_map>
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/accessors.h>
+#include <maplab-common/macros.h>
+#include <posegraph/unique-id.h>
+#include <vi-map/unique-id.h>
+
+namespace vi_map {
+class VIMap;
+}  // namespace vi_map
+
+namespace vi_map_helpers {
+
+// Weighted adjacency between nodes that observe common landmarks. The
+// neighbors of every node are sorted from most to least common landmarks.
+template <typename NodeIdType>
+class CovisibilityAdjacency {
+ public:
+  struct Neighbor {
+    NodeIdType id;
+    int num_common_landmarks;
+  };
+  typedef std::vector<Neighbor> NeighborList;
+
+  size_t numNodes() const {
+    return node_id_to_neighbors_.size();
+  }
+  bool hasNode(const NodeIdType& node_id) const {
+    return node_id_to_neighbors_.count(node_id) > 0u;
+  }
+  const NeighborList& getNeighbors(const NodeIdType& node_id) const {
+    return common::getChecked(node_id_to_neighbors_, node_id);
+  }
+  // Zero if the nodes don't observe any common landmark.
+  int getNumCommonLandmarks(
+      const NodeIdType& node_id, const NodeIdType& other_node_id) const {
+    // The neighbor lists are short, a scan beats a lookup structure.
+    for (const Neighbor& neighbor : getNeighbors(node_id)) {
+      if (neighbor.id == other_node_id) {
+        return neighbor.num_common_landmarks;
+      }
+    }
+    return 0;
+  }
+
+ private:
+  friend class CovisibilityGraph;
+  std::unordered_map<NodeIdType, NeighborList> node_id_to_neighbors_;
+};
+
+// Counts the landmarks the vertices and visual frames of a map have in
+// common, once for all nodes, so that the co-observation queries of
+// VIMapQueries become lookups. Built on demand: the graph is a snapshot and
+// is not updated if the landmark observations of the map change afterwards.
+//
+// The counts match those of the VIMapQueries variants without a graph. The
+// count of a vertex and a neighbor is the number of observations of the
+// neighbor of the landmarks observed by the vertex, and a vertex is its own
+// neighbor. The count of a frame and a neighbor is the number of pairs of
+// observations of the same landmark, and a frame is not its own neighbor.
+class CovisibilityGraph {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(CovisibilityGraph);
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(CovisibilityGraph);
+  typedef CovisibilityAdjacency<pose_graph::VertexId> VertexAdjacency;
+  typedef CovisibilityAdjacency<vi_map::VisualFrameIdentifier> FrameAdjacency;
+
+  // Builds the neighbors of all vertices of the map and their frames.
+  explicit CovisibilityGraph(const vi_map::VIMap& map);
+  // Builds the neighbors of the given vertices and their frames only, e.g.
+  // of a mission. Their neighbors can be any vertex or frame of the map.
+  CovisibilityGraph(
+      const vi_map::VIMap& map, const pose_graph::VertexIdList& vertex_ids);
+
+  const VertexAdjacency& getVertexAdjacency() const {
+    return vertex_adjacency_;
+  }
+  const FrameAdjacency& getFrameAdjacency() const {
+    return frame_adjacency_;
+  }
+
+ private:
+  void build(
+      const vi_map::VIMap& map, const pose_graph::VertexIdList& vertex_ids);
+
+  VertexAdjacency vertex_adjacency_;
+  FrameAdjacency frame_adjacency_;
+};
+
+}  // namespace vi_map_helpers
+
+#endif  // VI_MAP_HELPERS_COVISIBILITY_GRAPH_H_
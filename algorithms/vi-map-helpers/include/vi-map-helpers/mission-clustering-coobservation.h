@@ -1,6 +1,7 @@
 #ifndef VI_MAP_HELPERS_MISSION_CLUSTERING_COOBSERVATION_H_
 #define VI_MAP_HELPERS_MISSION_CLUSTERING_COOBSERVATION_H_
 
+#include <cstdint>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -9,19 +10,37 @@
 
 namespace vi_map_helpers {
 
+// Mission-by-mission matrix that tells whether two of the given missions
+// observe a common landmark. Only observations of the given missions are
+// considered. The matrix is computed in a single parallel pass over the
+// landmarks of the map and stored as one bitset per mission.
 class MissionCoobservationCachedQuery {
  public:
   MissionCoobservationCachedQuery(
       const vi_map::VIMap& vi_map, const vi_map::MissionIdSet& mission_ids);
 
+  bool hasCommonObservations(
+      const vi_map::MissionId& mission_id,
+      const vi_map::MissionId& other_mission_id) const;
   bool hasCommonObservations(
       const vi_map::MissionId& mission_id,
       const vi_map::MissionIdSet& other_mission_ids) const;
 
  private:
-  typedef std::unordered_map<vi_map::MissionId, vi_map::LandmarkIdSet>
-      MissionLandmarksMap;
-  MissionLandmarksMap mission_landmark_map_;
+  static constexpr size_t kNumBitsPerWord = 64u;
+
+  const uint64_t* getRow(const vi_map::MissionId& mission_id) const;
+  bool isBitSet(const uint64_t* row, const size_t mission_idx) const {
+    return (row[mission_idx / kNumBitsPerWord] >>
+            (mission_idx % kNumBitsPerWord)) &
+           1u;
+  }
+
+  std::unordered_map<vi_map::MissionId, size_t> mission_indices_;
+  size_t num_words_per_row_;
+  // Row-major, the bit of mission j in the row of mission i is set if both
+  // missions observe a common landmark.
+  std::vector<uint64_t> coobservation_bits_;
 };
 
 std::vector<vi_map::MissionIdSet> clusterMissionByLandmarkCoobservations(
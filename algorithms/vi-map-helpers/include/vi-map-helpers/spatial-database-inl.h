@@ -2,11 +2,55 @@
 #define VI_MAP_HELPERS_SPATIAL_DATABASE_INL_H_
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <limits>
+#include <numeric>
+#include <utility>
 #include <vector>
 
 namespace vi_map_helpers {
 
+namespace internal {
+// Number of bits of every grid index in a Morton code.
+constexpr int kNumMortonCodeBitsPerAxis = 21;
+
+// Spreads the lower 21 bits of the value to every third bit.
+inline uint64_t spreadBitsBy3(const uint64_t value) {
+  uint64_t bits = value & 0x1fffffull;
+  bits = (bits | bits << 32) & 0x1f00000000ffffull;
+  bits = (bits | bits << 16) & 0x1f0000ff0000ffull;
+  bits = (bits | bits << 8) & 0x100f00f00f00f00full;
+  bits = (bits | bits << 4) & 0x10c30c30c30c30c3ull;
+  bits = (bits | bits << 2) & 0x1249249249249249ull;
+  return bits;
+}
+
+// Inverse of spreadBitsBy3.
+inline uint32_t compactBitsBy3(const uint64_t bits) {
+  uint64_t value = bits & 0x1249249249249249ull;
+  value = (value ^ (value >> 2)) & 0x10c30c30c30c30c3ull;
+  value = (value ^ (value >> 4)) & 0x100f00f00f00f00full;
+  value = (value ^ (value >> 8)) & 0x1f0000ff0000ffull;
+  value = (value ^ (value >> 16)) & 0x1f00000000ffffull;
+  value = (value ^ (value >> 32)) & 0x1fffffull;
+  return static_cast<uint32_t>(value);
+}
+
+// Interleaves the bits of the non-negative grid indices.
+inline uint64_t computeMortonCode(const Eigen::Vector3i& grid_index_3d) {
+  return spreadBitsBy3(grid_index_3d[0]) |
+         (spreadBitsBy3(grid_index_3d[1]) << 1) |
+         (spreadBitsBy3(grid_index_3d[2]) << 2);
+}
+
+inline Eigen::Vector3i decodeMortonCode(const uint64_t morton_code) {
+  return Eigen::Vector3i(
+      compactBitsBy3(morton_code), compactBitsBy3(morton_code >> 1),
+      compactBitsBy3(morton_code >> 2));
+}
+}  // namespace internal
+
 template <typename ObjectIdType>
 SpatialDatabase<ObjectIdType>::SpatialDatabase(
     const vi_map::VIMap& map, const Eigen::Vector3i& grid_resolution)
@@ -20,25 +64,7 @@ SpatialDatabase<ObjectIdType>::SpatialDatabase(
   CHECK_GT(box_size.maxCoeff(), 0)
       << "The spatial database can not be created with only one vertex.";
   grid_cell_size_ = box_size.cwiseQuotient(grid_resolution.cast<double>());
-
-  for (const ObjectIdType& object_id : all_map_object_ids) {
-    Eigen::Vector3d p_G_I = map.get_p_G(object_id);
-    Eigen::Vector3i grid_index_3d;
-    getGridIndexForPosition(p_G_I, &grid_index_3d);
-    spatial_map_[grid_index_3d].push_back(object_id);
-    vi_map::MissionIdSet mission_ids;
-    // For Vertices always only one mission, for StoreLandmarkIds multiple.
-    map_.getMissionIds(object_id, &mission_ids);
-    for (const vi_map::MissionId& mission_id : mission_ids) {
-      auto found = mission_map_.find(mission_id);
-      if (found == mission_map_.end()) {
-        GridCellSet cell_set({grid_index_3d});
-        mission_map_.insert(std::make_pair(mission_id, cell_set));
-      } else {
-        found->second.insert(grid_index_3d);
-      }
-    }
-  }
+  insertObjects(all_map_object_ids);
 }
 
 template <typename ObjectIdType>
@@ -62,97 +88,222 @@ SpatialDatabase<ObjectIdType>::SpatialDatabase(
   // size and not by passing the grid resolution (splitting factor).
   p_G_max_ =
       grid_cell_size_.cwiseProduct(grid_resolution_.cast<double>()) + p_G_min_;
+  insertObjects(all_map_object_ids);
+}
 
-  for (const ObjectIdType& object_id : all_map_object_ids) {
-    Eigen::Vector3d p_G_I = map.get_p_G(object_id);
+template <typename ObjectIdType>
+void SpatialDatabase<ObjectIdType>::insertObjects(
+    const std::vector<ObjectIdType>& object_ids) {
+  const size_t num_objects = object_ids.size();
+  Eigen::Matrix3Xd p_G_objects(3, num_objects);
+  std::vector<uint64_t> object_codes(num_objects);
+  max_cell_grid_index_.setZero();
+  for (size_t object_idx = 0u; object_idx < num_objects; ++object_idx) {
+    const ObjectIdType& object_id = object_ids[object_idx];
+    p_G_objects.col(object_idx) = map_.get_p_G(object_id);
     Eigen::Vector3i grid_index_3d;
-    getGridIndexForPosition(p_G_I, &grid_index_3d);
-    spatial_map_[grid_index_3d].push_back(object_id);
+    getGridIndexForPosition(p_G_objects.col(object_idx), &grid_index_3d);
+    CHECK_GE(grid_index_3d.minCoeff(), 0);
+    CHECK_LT(
+        grid_index_3d.maxCoeff(), 1 << internal::kNumMortonCodeBitsPerAxis)
+        << "The grid resolution is too high.";
+    object_codes[object_idx] = internal::computeMortonCode(grid_index_3d);
+    max_cell_grid_index_ = max_cell_grid_index_.cwiseMax(grid_index_3d);
+
     vi_map::MissionIdSet mission_ids;
     // For Vertices always only one mission, for StoreLandmarkIds multiple.
     map_.getMissionIds(object_id, &mission_ids);
     for (const vi_map::MissionId& mission_id : mission_ids) {
-      auto found = mission_map_.find(mission_id);
-      if (found == mission_map_.end()) {
-        GridCellSet cell_set({grid_index_3d});
-        mission_map_.insert(std::make_pair(mission_id, cell_set));
-      } else {
-        found->second.insert(grid_index_3d);
-      }
+      mission_map_[mission_id].insert(grid_index_3d);
     }
   }
+
+  // Sort the objects by their cells, the objects of a cell keep their order.
+  std::vector<size_t> sorted_object_indices(num_objects);
+  std::iota(sorted_object_indices.begin(), sorted_object_indices.end(), 0u);
+  std::stable_sort(
+      sorted_object_indices.begin(), sorted_object_indices.end(),
+      [&object_codes](const size_t lhs, const size_t rhs) {
+        return object_codes[lhs] < object_codes[rhs];
+      });
+
+  cell_codes_.clear();
+  cell_begin_.clear();
+  object_ids_.clear();
+  object_ids_.reserve(num_objects);
+  p_G_objects_.resize(3, num_objects);
+  for (size_t sorted_idx = 0u; sorted_idx < num_objects; ++sorted_idx) {
+    const size_t object_idx = sorted_object_indices[sorted_idx];
+    if (cell_codes_.empty() || cell_codes_.back() != object_codes[object_idx]) {
+      cell_codes_.push_back(object_codes[object_idx]);
+      cell_begin_.push_back(sorted_idx);
+    }
+    object_ids_.push_back(object_ids[object_idx]);
+    p_G_objects_.col(sorted_idx) = p_G_objects.col(object_idx);
+  }
+  cell_begin_.push_back(num_objects);
 }
 
 template <typename ObjectIdType>
-void SpatialDatabase<ObjectIdType>::getGridResolution(
-    Eigen::Vector3i* resolution) const {
-  CHECK_NOTNULL(resolution);
-  *resolution = grid_resolution_;
+int SpatialDatabase<ObjectIdType>::findCell(
+    const Eigen::Vector3i& grid_index_3d) const {
+  if (grid_index_3d.minCoeff() < 0 ||
+      (grid_index_3d.array() > max_cell_grid_index_.array()).any()) {
+    return -1;
+  }
+  const uint64_t morton_code = internal::computeMortonCode(grid_index_3d);
+  const std::vector<uint64_t>::const_iterator it =
+      std::lower_bound(cell_codes_.begin(), cell_codes_.end(), morton_code);
+  if (it == cell_codes_.end() || *it != morton_code) {
+    return -1;
+  }
+  return static_cast<int>(it - cell_codes_.begin());
 }
 
 template <typename ObjectIdType>
-typename SpatialDatabase<ObjectIdType>::const_iterator
-SpatialDatabase<ObjectIdType>::begin() const {
-  return spatial_map_.begin();
+template <typename VisitCellFunction>
+void SpatialDatabase<ObjectIdType>::forEachCellInBox(
+    const Eigen::Vector3i& min_grid_index,
+    const Eigen::Vector3i& max_grid_index,
+    const VisitCellFunction& visit_cell) const {
+  const Eigen::Vector3i min_index = min_grid_index.cwiseMax(0);
+  const Eigen::Vector3i max_index =
+      max_grid_index.cwiseMin(max_cell_grid_index_);
+  if ((min_index.array() > max_index.array()).any()) {
+    return;
+  }
+
+  // All cells of the box have a Morton code between the ones of the box
+  // corners. Scan the non-empty cells of that range if there are fewer of
+  // them than cells in the box, otherwise look up every cell of the box.
+  const std::vector<uint64_t>::const_iterator range_begin = std::lower_bound(
+      cell_codes_.begin(), cell_codes_.end(),
+      internal::computeMortonCode(min_index));
+  const std::vector<uint64_t>::const_iterator range_end = std::upper_bound(
+      range_begin, cell_codes_.end(), internal::computeMortonCode(max_index));
+  const Eigen::Matrix<size_t, 3, 1> box_size =
+      (max_index - min_index).cast<size_t>() +
+      Eigen::Matrix<size_t, 3, 1>::Ones();
+  const size_t num_box_cells = box_size[0] * box_size[1] * box_size[2];
+
+  if (static_cast<size_t>(range_end - range_begin) <= num_box_cells) {
+    for (std::vector<uint64_t>::const_iterator it = range_begin;
+         it != range_end; ++it) {
+      const Eigen::Vector3i grid_index_3d = internal::decodeMortonCode(*it);
+      if ((grid_index_3d.array() >= min_index.array()).all() &&
+          (grid_index_3d.array() <= max_index.array()).all()) {
+        visit_cell(static_cast<size_t>(it - cell_codes_.begin()));
+      }
+    }
+    return;
+  }
+  for (int x_index = min_index[0]; x_index <= max_index[0]; ++x_index) {
+    for (int y_index = min_index[1]; y_index <= max_index[1]; ++y_index) {
+      for (int z_index = min_index[2]; z_index <= max_index[2]; ++z_index) {
+        const uint64_t morton_code = internal::computeMortonCode(
+            Eigen::Vector3i(x_index, y_index, z_index));
+        const std::vector<uint64_t>::const_iterator it =
+            std::lower_bound(range_begin, range_end, morton_code);
+        if (it != range_end && *it == morton_code) {
+          visit_cell(static_cast<size_t>(it - cell_codes_.begin()));
+        }
+      }
+    }
+  }
 }
 
 template <typename ObjectIdType>
-typename SpatialDatabase<ObjectIdType>::const_iterator
-SpatialDatabase<ObjectIdType>::end() const {
-  return spatial_map_.end();
+void SpatialDatabase<ObjectIdType>::getGridResolution(
+    Eigen::Vector3i* resolution) const {
+  CHECK_NOTNULL(resolution);
+  *resolution = grid_resolution_;
 }
 
 template <typename ObjectIdType>
-void SpatialDatabase<ObjectIdType>::getObjectIdsInRadius(
+void SpatialDatabase<ObjectIdType>::appendObjectIdsInRadius(
     const Eigen::Vector3d& p_G_center, double radius,
-    std::unordered_set<ObjectIdType>* neighbors) const {
-  CHECK_NOTNULL(neighbors)->clear();
+    std::vector<ObjectIdType>* object_ids) const {
+  CHECK_NOTNULL(object_ids);
   CHECK_GT(radius, 0.0);
-  Eigen::Vector3i grid_index_3d;
-
-  getGridIndexForPosition(p_G_center, &grid_index_3d);
 
   // Check if entire grid is inside radius by checking if center of the grid
   // has more distance to the sphere border than the diagonal of the grid.
-  if (radius - ((p_G_min_ - p_G_max_) / 2 - p_G_center).norm() >
+  if (radius - ((p_G_min_ + p_G_max_) / 2 - p_G_center).norm() >
       (p_G_min_ - p_G_max_).norm()) {
-    std::vector<ObjectIdType> all_objects;
-    map_.getAllIds(&all_objects);
-    neighbors->insert(all_objects.begin(), all_objects.end());
+    object_ids->insert(
+        object_ids->end(), object_ids_.begin(), object_ids_.end());
     return;
   }
 
-  // Calculate number of grid units in x, y, and z directions
-  // that are maximally needed to cover the sphere of given radius in space.
-  Eigen::Vector3d radius_in_grid_units, unit_vector(1, 1, 1);
-  radius_in_grid_units = radius * unit_vector;
-  radius_in_grid_units.cwiseQuotient(grid_cell_size_);
-  // Add 1 in order to get ceiling after casting int.
-  radius_in_grid_units += unit_vector;
-  Eigen::Vector3i num_of_grid_units_in_radius =
-      radius_in_grid_units.cast<int>();
-  for (int x_index = -num_of_grid_units_in_radius[0];
-       x_index <= num_of_grid_units_in_radius[0]; ++x_index) {
-    for (int y_index = -num_of_grid_units_in_radius[1];
-         y_index <= num_of_grid_units_in_radius[1]; ++y_index) {
-      for (int z_index = -num_of_grid_units_in_radius[2];
-           z_index <= num_of_grid_units_in_radius[2]; ++z_index) {
-        Eigen::Vector3i local_index_3d(x_index, y_index, z_index);
-        local_index_3d += grid_index_3d;
-        if (isCellEmpty(local_index_3d)) {
-          continue;
+  const Eigen::Vector3d radius_vector = Eigen::Vector3d::Constant(radius);
+  Eigen::Vector3i min_grid_index, max_grid_index;
+  getGridIndexForPosition(p_G_center - radius_vector, &min_grid_index);
+  getGridIndexForPosition(p_G_center + radius_vector, &max_grid_index);
+
+  const double squared_radius = radius * radius;
+  forEachCellInBox(
+      min_grid_index, max_grid_index, [&](const size_t cell_idx) {
+        const Eigen::Vector3d p_G_cell_min =
+            p_G_min_ +
+            grid_cell_size_.cwiseProduct(
+                internal::decodeMortonCode(cell_codes_[cell_idx])
+                    .cast<double>());
+        const Eigen::Vector3d p_G_cell_max = p_G_cell_min + grid_cell_size_;
+        // Skip the cells outside of the sphere and take all objects of the
+        // cells inside of it.
+        const Eigen::Vector3d nearest_distance =
+            (p_G_cell_min - p_G_center)
+                .cwiseMax(p_G_center - p_G_cell_max)
+                .cwiseMax(0.0);
+        if (nearest_distance.squaredNorm() > squared_radius) {
+          return;
         }
-        std::vector<ObjectIdType> local_objects;
-        getObjectIdsOfGridIndex(local_index_3d, &local_objects);
-        for (const ObjectIdType& object_id : local_objects) {
-          const Eigen::Vector3d distance = p_G_center - map_.get_p_G(object_id);
-          if (distance.norm() <= radius) {
-            neighbors->insert(object_id);
+        const size_t cell_begin = cell_begin_[cell_idx];
+        const size_t cell_end = cell_begin_[cell_idx + 1u];
+        const Eigen::Vector3d farthest_distance =
+            (p_G_center - p_G_cell_min)
+                .cwiseAbs()
+                .cwiseMax((p_G_cell_max - p_G_center).cwiseAbs());
+        if (farthest_distance.squaredNorm() <= squared_radius) {
+          object_ids->insert(
+              object_ids->end(), object_ids_.begin() + cell_begin,
+              object_ids_.begin() + cell_end);
+          return;
+        }
+        for (size_t object_idx = cell_begin; object_idx < cell_end;
+             ++object_idx) {
+          if ((p_G_objects_.col(object_idx) - p_G_center).squaredNorm() <=
+              squared_radius) {
+            object_ids->push_back(object_ids_[object_idx]);
           }
         }
-      }
-    }
+      });
+}
+
+template <typename ObjectIdType>
+void SpatialDatabase<ObjectIdType>::getObjectIdsInRadius(
+    const Eigen::Vector3d& p_G_center, double radius,
+    std::unordered_set<ObjectIdType>* neighbors) const {
+  CHECK_NOTNULL(neighbors)->clear();
+  std::vector<ObjectIdType> object_ids;
+  appendObjectIdsInRadius(p_G_center, radius, &object_ids);
+  neighbors->insert(object_ids.begin(), object_ids.end());
+}
+
+template <typename ObjectIdType>
+void SpatialDatabase<ObjectIdType>::getObjectIdsInRadius(
+    const Eigen::Matrix3Xd& p_G_centers, double radius,
+    BatchQueryResult* result) const {
+  CHECK_NOTNULL(result);
+  result->object_ids.clear();
+  result->query_begin.clear();
+  result->query_begin.reserve(p_G_centers.cols() + 1u);
+  for (int query_idx = 0; query_idx < p_G_centers.cols(); ++query_idx) {
+    result->query_begin.push_back(result->object_ids.size());
+    appendObjectIdsInRadius(
+        p_G_centers.col(query_idx), radius, &result->object_ids);
   }
+  result->query_begin.push_back(result->object_ids.size());
 }
 
 template <typename ObjectIdType>
@@ -172,13 +323,7 @@ void SpatialDatabase<ObjectIdType>::getObjectIdsOfMissionInRadius(
 template <typename ObjectIdType>
 bool SpatialDatabase<ObjectIdType>::isCellEmpty(
     const Eigen::Vector3i& grid_index_3d) const {
-  typename std::unordered_map<Eigen::Vector3i,
-                              std::vector<ObjectIdType>>::const_iterator
-      grid_iterator = spatial_map_.find(grid_index_3d);
-  if (grid_iterator != spatial_map_.end()) {
-    return grid_iterator->second.empty();
-  }
-  return true;
+  return findCell(grid_index_3d) < 0;
 }
 
 template <typename ObjectIdType>
@@ -269,53 +414,64 @@ double SpatialDatabase<ObjectIdType>::getSquaredDistanceToGridCell(
 }
 
 template <typename ObjectIdType>
-void SpatialDatabase<ObjectIdType>::getObjectIdsInCuboid(
+void SpatialDatabase<ObjectIdType>::appendObjectIdsInCuboid(
     const Eigen::Vector3d& p_G_min, const Eigen::Vector3d& p_G_max,
-    std::vector<ObjectIdType>* output_object_ids) const {
-  CHECK_NOTNULL(output_object_ids)->clear();
+    std::vector<ObjectIdType>* object_ids) const {
+  CHECK_NOTNULL(object_ids);
   Eigen::Vector3i min_grid_index, max_grid_index;
   getGridIndexForPosition(p_G_max, &max_grid_index);
   getGridIndexForPosition(p_G_min, &min_grid_index);
-  for (int x_index = min_grid_index[0]; x_index <= max_grid_index[0];
-       ++x_index) {
-    bool local_grid_unit_is_at_border_x =
-        (x_index == min_grid_index[0]) || (x_index == max_grid_index[0]);
-
-    for (int y_index = min_grid_index[1]; y_index <= max_grid_index[1];
-         ++y_index) {
-      bool local_grid_unit_is_at_border_xy = local_grid_unit_is_at_border_x ||
-                                             (y_index == min_grid_index[1]) ||
-                                             (y_index == max_grid_index[1]);
-      for (int z_index = min_grid_index[2]; z_index <= max_grid_index[2];
-           ++z_index) {
-        bool local_grid_unit_is_at_border = local_grid_unit_is_at_border_xy ||
-                                            (z_index == min_grid_index[2]) ||
-                                            (z_index == max_grid_index[2]);
-        Eigen::Vector3i local_index_3d(x_index, y_index, z_index);
-
-        std::vector<ObjectIdType> local_objects;
-        getObjectIdsOfGridIndex(local_index_3d, &local_objects);
-        if (local_grid_unit_is_at_border) {
-          for (const ObjectIdType& object_id : local_objects) {
-            Eigen::Vector3d p_G_X = map_.get_p_G(object_id);
-            bool object_is_inside_cuboid = true;
-            for (int i = 0; i < 3; ++i) {
-              object_is_inside_cuboid = object_is_inside_cuboid &&
-                                        (p_G_X[i] <= p_G_max[i]) &&
-                                        (p_G_X[i] >= p_G_min[i]);
-            }
-            if (object_is_inside_cuboid) {
-              output_object_ids->push_back(object_id);
-            }
+  forEachCellInBox(
+      min_grid_index, max_grid_index, [&](const size_t cell_idx) {
+        const Eigen::Vector3i grid_index_3d =
+            internal::decodeMortonCode(cell_codes_[cell_idx]);
+        const size_t cell_begin = cell_begin_[cell_idx];
+        const size_t cell_end = cell_begin_[cell_idx + 1u];
+        // Only the objects of the cells at the border of the cuboid need to
+        // be checked.
+        const bool cell_is_at_border =
+            (grid_index_3d.array() == min_grid_index.array()).any() ||
+            (grid_index_3d.array() == max_grid_index.array()).any();
+        if (!cell_is_at_border) {
+          object_ids->insert(
+              object_ids->end(), object_ids_.begin() + cell_begin,
+              object_ids_.begin() + cell_end);
+          return;
+        }
+        for (size_t object_idx = cell_begin; object_idx < cell_end;
+             ++object_idx) {
+          const Eigen::Vector3d& p_G_X = p_G_objects_.col(object_idx);
+          if ((p_G_X.array() <= p_G_max.array()).all() &&
+              (p_G_X.array() >= p_G_min.array()).all()) {
+            object_ids->push_back(object_ids_[object_idx]);
           }
-        } else {
-          output_object_ids->insert(
-              output_object_ids->end(), local_objects.begin(),
-              local_objects.end());
         }
-      }
-    }
+      });
+}
+
+template <typename ObjectIdType>
+void SpatialDatabase<ObjectIdType>::getObjectIdsInCuboid(
+    const Eigen::Vector3d& p_G_min, const Eigen::Vector3d& p_G_max,
+    std::vector<ObjectIdType>* output_object_ids) const {
+  CHECK_NOTNULL(output_object_ids)->clear();
+  appendObjectIdsInCuboid(p_G_min, p_G_max, output_object_ids);
+}
+
+template <typename ObjectIdType>
+void SpatialDatabase<ObjectIdType>::getObjectIdsInCuboid(
+    const Eigen::Matrix3Xd& p_G_mins, const Eigen::Matrix3Xd& p_G_maxs,
+    BatchQueryResult* result) const {
+  CHECK_NOTNULL(result);
+  CHECK_EQ(p_G_mins.cols(), p_G_maxs.cols());
+  result->object_ids.clear();
+  result->query_begin.clear();
+  result->query_begin.reserve(p_G_mins.cols() + 1u);
+  for (int query_idx = 0; query_idx < p_G_mins.cols(); ++query_idx) {
+    result->query_begin.push_back(result->object_ids.size());
+    appendObjectIdsInCuboid(
+        p_G_mins.col(query_idx), p_G_maxs.col(query_idx), &result->object_ids);
   }
+  result->query_begin.push_back(result->object_ids.size());
 }
 
 template <typename ObjectIdType>
@@ -339,9 +495,11 @@ void SpatialDatabase<ObjectIdType>::getObjectIdsOfGridIndex(
     std::vector<ObjectIdType>* grid_unit_vertex_ids) const {
   CHECK_NOTNULL(grid_unit_vertex_ids);
   grid_unit_vertex_ids->clear();
-  auto it = spatial_map_.find(grid_index);
-  if (it != spatial_map_.end()) {
-    *grid_unit_vertex_ids = it->second;
+  const int cell_idx = findCell(grid_index);
+  if (cell_idx >= 0) {
+    grid_unit_vertex_ids->assign(
+        object_ids_.begin() + cell_begin_[cell_idx],
+        object_ids_.begin() + cell_begin_[cell_idx + 1]);
   }
 }
 
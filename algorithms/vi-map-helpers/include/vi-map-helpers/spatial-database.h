@@ -1,6 +1,7 @@
 #ifndef VI_MAP_HELPERS_SPATIAL_DATABASE_H_
 #define VI_MAP_HELPERS_SPATIAL_DATABASE_H_
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -34,20 +35,37 @@ class VIMap;
 
 namespace vi_map_helpers {
 
+// Uniform grid over the bounding box of all objects of a type in the map. The
+// non-empty cells are stored contiguously in the order of their Morton codes,
+// together with the ids and positions of their objects, such that cells close
+// in space are close in memory and no query needs to access the map.
 template <typename ObjectIdType>
 class SpatialDatabase {
  public:
-  typedef std::unordered_map<Eigen::Vector3i, std::vector<ObjectIdType>>
-      SpatialMap;
-
   typedef AlignedUnorderedSet<Eigen::Vector3i> GridCellSet;
 
   typedef AlignedUnorderedMap<vi_map::MissionId, GridCellSet>
       MissionGridCellsMap;
 
-  typedef typename SpatialMap::value_type value_type;
-
-  typedef typename SpatialMap::const_iterator const_iterator;
+  // Results of a batch query. The ids of the objects found by query i are
+  // object_ids[query_begin[i]] until object_ids[query_begin[i + 1]]. Passing
+  // the same result to subsequent queries reuses its buffers.
+  struct BatchQueryResult {
+    std::vector<ObjectIdType> object_ids;
+    std::vector<size_t> query_begin;
+
+    inline size_t numQueries() const {
+      return query_begin.empty() ? 0u : query_begin.size() - 1u;
+    }
+    inline size_t numObjectIdsOfQuery(const size_t query_idx) const {
+      CHECK_LT(query_idx, numQueries());
+      return query_begin[query_idx + 1u] - query_begin[query_idx];
+    }
+    inline const ObjectIdType* objectIdsOfQuery(const size_t query_idx) const {
+      CHECK_LT(query_idx, numQueries());
+      return object_ids.data() + query_begin[query_idx];
+    }
+  };
 
   SpatialDatabase(
       const vi_map::VIMap& map, const Eigen::Vector3i& grid_resolution);
@@ -55,16 +73,17 @@ class SpatialDatabase {
   SpatialDatabase(
       const vi_map::VIMap& map, const Eigen::Vector3d& grid_cell_size);
 
-  const_iterator begin() const;
-
-  const_iterator end() const;
-
   void getGridResolution(Eigen::Vector3i* resolution) const;
 
   void getObjectIdsInRadius(
       const Eigen::Vector3d& p_G_center, double radius_meters,
       std::unordered_set<ObjectIdType>* neighbors) const;
 
+  // Finds the objects within the radius of every column of p_G_centers.
+  void getObjectIdsInRadius(
+      const Eigen::Matrix3Xd& p_G_centers, double radius_meters,
+      BatchQueryResult* result) const;
+
   void getObjectIdsOfMissionInRadius(
       const vi_map::MissionId& mission_id, const Eigen::Vector3d& p_G_center,
       double radius, std::unordered_set<ObjectIdType>* neighbors) const;
@@ -81,6 +100,12 @@ class SpatialDatabase {
       const Eigen::Vector3d& p_G_min, const Eigen::Vector3d& p_G_max,
       std::vector<ObjectIdType>* output_vertex_ids) const;
 
+  // Finds the objects within the cuboid spanned by the corresponding columns
+  // of p_G_mins and p_G_maxs for every column.
+  void getObjectIdsInCuboid(
+      const Eigen::Matrix3Xd& p_G_mins, const Eigen::Matrix3Xd& p_G_maxs,
+      BatchQueryResult* result) const;
+
   void getObjectIdsOfMissionInCuboid(
       const vi_map::MissionId& mission_id, const Eigen::Vector3d& p_G_min,
       const Eigen::Vector3d& p_G_max,
@@ -99,19 +124,49 @@ class SpatialDatabase {
 
   const vi_map::VIMap& getMap() const;
 
+  // Returns the number of non-empty grid cells.
   inline size_t size() const {
-    return spatial_map_.size();
+    return cell_codes_.size();
   }
 
   inline size_t empty() const { return size() == 0u; }
 
  private:
+  void insertObjects(const std::vector<ObjectIdType>& object_ids);
+
+  // Returns the index of the non-empty cell or -1 if the cell is empty.
+  int findCell(const Eigen::Vector3i& grid_index_3d) const;
+
+  // Calls visit_cell with the index of every non-empty cell within the grid
+  // index box from min_grid_index to max_grid_index.
+  template <typename VisitCellFunction>
+  void forEachCellInBox(
+      const Eigen::Vector3i& min_grid_index,
+      const Eigen::Vector3i& max_grid_index,
+      const VisitCellFunction& visit_cell) const;
+
+  void appendObjectIdsInRadius(
+      const Eigen::Vector3d& p_G_center, double radius,
+      std::vector<ObjectIdType>* object_ids) const;
+  void appendObjectIdsInCuboid(
+      const Eigen::Vector3d& p_G_min, const Eigen::Vector3d& p_G_max,
+      std::vector<ObjectIdType>* object_ids) const;
+
   Eigen::Vector3d grid_cell_size_;
   Eigen::Vector3i grid_resolution_;
   Eigen::Vector3d p_G_min_;
   Eigen::Vector3d p_G_max_;
 
-  SpatialMap spatial_map_;
+  // Sorted Morton codes of the non-empty cells. The objects of cell i are
+  // object_ids_[cell_begin_[i]] until object_ids_[cell_begin_[i + 1]], their
+  // positions are the corresponding columns of p_G_objects_.
+  std::vector<uint64_t> cell_codes_;
+  std::vector<size_t> cell_begin_;
+  std::vector<ObjectIdType> object_ids_;
+  Eigen::Matrix3Xd p_G_objects_;
+  // Largest grid index of the non-empty cells along every axis.
+  Eigen::Vector3i max_cell_grid_index_;
+
   const VIMapGeometry map_geometry_;
   MissionGridCellsMap mission_map_;
 
@@ -2,6 +2,7 @@
 #define VI_MAP_HELPERS_VI_MAP_DESCRIPTOR_UTILS_H_
 
 #include <Eigen/Core>
+#include <vi-map/descriptor-arena.h>
 #include <vi-map/vi-map.h>
 
 namespace vi_map_helpers {
@@ -12,6 +13,13 @@ void getDescriptorClosestToMedian(
     const vi_map::VIMap& map,
     Eigen::Matrix<unsigned char, Eigen::Dynamic, 1>* descriptor,
     size_t* descriptor_index);
+// Same, reading the descriptors from an arena holding all observer frames,
+// for computing the median descriptor of many landmarks.
+void getDescriptorClosestToMedian(
+    const vi_map::KeypointIdentifierList& observations,
+    const vi_map::DescriptorArena& descriptor_arena,
+    Eigen::Matrix<unsigned char, Eigen::Dynamic, 1>* descriptor,
+    size_t* descriptor_index);
 
 }  // namespace vi_map_helpers
 
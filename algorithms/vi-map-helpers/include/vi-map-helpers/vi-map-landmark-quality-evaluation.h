@@ -1,6 +1,10 @@
 #ifndef VI_MAP_HELPERS_VI_MAP_LANDMARK_QUALITY_EVALUATION_H_
 #define VI_MAP_HELPERS_VI_MAP_LANDMARK_QUALITY_EVALUATION_H_
 
+#include <cstddef>
+
+#include <vi-map/unique-id.h>
+
 namespace vi_map {
 class VIMap;
 }  // namespace vi_map
@@ -10,6 +14,20 @@ namespace vi_map_helpers {
 void evaluateLandmarkQuality(vi_map::VIMap* map);
 void resetLandmarkQualityToUnknown(vi_map::VIMap* map);
 
+// The quality kUnknown marks a landmark as dirty. After a localized edit, e.g.
+// retriangulating or merging some landmarks, only the touched landmarks need
+// to be reset to unknown; evaluateUnknownLandmarkQuality then re-evaluates
+// just these instead of all landmarks of the map. Landmarks that no longer
+// exist in the map are skipped.
+void evaluateLandmarkQuality(
+    const vi_map::LandmarkIdSet& landmark_ids, vi_map::VIMap* map);
+void resetLandmarkQualityToUnknown(
+    const vi_map::LandmarkIdSet& landmark_ids, vi_map::VIMap* map);
+
+// Evaluates the quality of all landmarks with unknown quality and returns the
+// number of evaluated landmarks.
+size_t evaluateUnknownLandmarkQuality(vi_map::VIMap* map);
+
 }  // namespace vi_map_helpers
 
 #endif  // VI_MAP_HELPERS_VI_MAP_LANDMARK_QUALITY_EVALUATION_H_
@@ -1,21 +1,30 @@
 #ifndef VI_MAP_HELPERS_VI_MAP_NEAREST_NEIGHBOR_LOOKUP_INL_H_
 #define VI_MAP_HELPERS_VI_MAP_NEAREST_NEIGHBOR_LOOKUP_INL_H_
 
+#include <algorithm>
+#include <cmath>
 #include <functional>
 #include <limits>
 #include <unordered_set>
+#include <vector>
 
 #include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
 
 namespace vi_map_helpers {
 
+template <typename QueryType, typename DataType>
+constexpr size_t VIMapNearestNeighborLookup<
+    QueryType, DataType>::kMinNumPendingChangesToMerge;
+
 // VIMap wrapper class that provides a nearest-neighbor vertex query.
 template <typename QueryType, typename DataType>
 VIMapNearestNeighborLookup<QueryType, DataType>::VIMapNearestNeighborLookup(
     const vi_map::VIMap& map)
-    : map_(map) {
+    : map_(map), num_removed_data_items_(0u) {
   buildIndex();
   CHECK_EQ(nn_index_data_.cols(), data_items_.size());
+  is_removed_.assign(data_items_.size(), false);
   CHECK_EQ(size(), data_items_.size());
 }
 
@@ -26,10 +35,126 @@ bool VIMapNearestNeighborLookup<QueryType, DataType>::empty() const {
 
 template <typename QueryType, typename DataType>
 size_t VIMapNearestNeighborLookup<QueryType, DataType>::size() const {
+  CHECK_GE(data_items_.size(), num_removed_data_items_);
+  return data_items_.size() - num_removed_data_items_;
+}
+
+template <typename QueryType, typename DataType>
+size_t VIMapNearestNeighborLookup<QueryType, DataType>::numIndexedDataItems()
+    const {
   CHECK_GE(nn_index_data_.cols(), 0u);
   return static_cast<size_t>(nn_index_data_.cols());
 }
 
+template <typename QueryType, typename DataType>
+bool VIMapNearestNeighborLookup<QueryType, DataType>::findClosestDataItemIndex(
+    const Eigen::VectorXd& query_vector, size_t* data_item_idx) const {
+  CHECK_NOTNULL(data_item_idx);
+  CHECK_EQ(data_items_.size(), numIndexedDataItems() + buffered_data_.size());
+  bool found = false;
+  double min_distance_squared = std::numeric_limits<double>::infinity();
+
+  const int num_indexed_data_items = static_cast<int>(numIndexedDataItems());
+  if (num_indexed_data_items > 0) {
+    CHECK(nn_index_);
+    CHECK_EQ(query_vector.rows(), nn_index_data_.rows());
+    constexpr double kSearchNNEpsilon = 0.0;
+    const int kOptionFlags = Nabo::NNSearchD::ALLOW_SELF_MATCH;
+    // The removed data items are still in the k-d tree, so the number of
+    // neighbors is doubled until one of them isn't removed.
+    int num_neighbors = 1;
+    while (!found) {
+      Eigen::VectorXi index = Eigen::VectorXi::Constant(num_neighbors, -1);
+      Eigen::VectorXd distance_squared = Eigen::VectorXd::Constant(
+          num_neighbors, std::numeric_limits<double>::infinity());
+      nn_index_->knn(query_vector, index, distance_squared, num_neighbors,
+                     kSearchNNEpsilon, kOptionFlags);
+      for (int result_idx = 0; result_idx < num_neighbors; ++result_idx) {
+        const int nn_index = index(result_idx);
+        if (nn_index < 0 || distance_squared(result_idx) ==
+                                std::numeric_limits<double>::infinity()) {
+          break;
+        }
+        CHECK_LT(nn_index, num_indexed_data_items);
+        if (!is_removed_[nn_index]) {
+          *data_item_idx = static_cast<size_t>(nn_index);
+          min_distance_squared = distance_squared(result_idx);
+          found = true;
+          break;
+        }
+      }
+      if (num_neighbors == num_indexed_data_items) {
+        break;
+      }
+      num_neighbors = std::min(2 * num_neighbors, num_indexed_data_items);
+    }
+  }
+
+  for (size_t buffer_idx = 0u; buffer_idx < buffered_data_.size();
+       ++buffer_idx) {
+    const size_t buffered_item_idx = numIndexedDataItems() + buffer_idx;
+    if (is_removed_[buffered_item_idx]) {
+      continue;
+    }
+    CHECK_EQ(query_vector.rows(), buffered_data_[buffer_idx].rows());
+    const double distance_squared =
+        (buffered_data_[buffer_idx] - query_vector).squaredNorm();
+    if (distance_squared < min_distance_squared) {
+      *data_item_idx = buffered_item_idx;
+      min_distance_squared = distance_squared;
+      found = true;
+    }
+  }
+  return found;
+}
+
+template <typename QueryType, typename DataType>
+void VIMapNearestNeighborLookup<QueryType, DataType>::
+    findDataItemIndicesWithinRadius(
+        const Eigen::VectorXd& query_vector, const double search_radius,
+        std::vector<size_t>* data_item_indices) const {
+  CHECK_NOTNULL(data_item_indices)->clear();
+  CHECK_EQ(data_items_.size(), numIndexedDataItems() + buffered_data_.size());
+
+  const int num_neighbors = static_cast<int>(numIndexedDataItems());
+  if (num_neighbors > 0) {
+    CHECK(nn_index_);
+    Eigen::VectorXi index = Eigen::VectorXi::Constant(num_neighbors, -1);
+
+    Eigen::VectorXd distance_squared = Eigen::VectorXd::Constant(
+        num_neighbors, std::numeric_limits<double>::infinity());
+    constexpr double kSearchNNEpsilon = 0.0;
+    const int kOptionFlags = Nabo::NNSearchD::ALLOW_SELF_MATCH;
+    CHECK_EQ(query_vector.rows(), nn_index_data_.rows());
+    nn_index_->knn(query_vector, index, distance_squared, num_neighbors,
+                   kSearchNNEpsilon, kOptionFlags, search_radius);
+
+    int result_idx = 0;
+    while (result_idx < num_neighbors &&
+           distance_squared[result_idx] <
+               std::numeric_limits<double>::infinity()) {
+      const int nn_index = index(result_idx);
+      CHECK_LT(nn_index, num_neighbors);
+      if (!is_removed_[nn_index]) {
+        data_item_indices->push_back(static_cast<size_t>(nn_index));
+      }
+      ++result_idx;
+    }
+  }
+
+  const double search_radius_squared = search_radius * search_radius;
+  for (size_t buffer_idx = 0u; buffer_idx < buffered_data_.size();
+       ++buffer_idx) {
+    const size_t buffered_item_idx = numIndexedDataItems() + buffer_idx;
+    CHECK_EQ(query_vector.rows(), buffered_data_[buffer_idx].rows());
+    if (!is_removed_[buffered_item_idx] &&
+        (buffered_data_[buffer_idx] - query_vector).squaredNorm() <=
+            search_radius_squared) {
+      data_item_indices->push_back(buffered_item_idx);
+    }
+  }
+}
+
 template <typename QueryType, typename DataType>
 bool VIMapNearestNeighborLookup<QueryType, DataType>::getClosestDataItem(
     const QueryType& query, DataType* closest_data_item) const {
@@ -39,27 +164,11 @@ bool VIMapNearestNeighborLookup<QueryType, DataType>::getClosestDataItem(
                  << "Can't look for closest data item.";
     return false;
   }
-  CHECK(nn_index_);
-  CHECK_EQ(size(), data_items_.size());
 
-  constexpr int kNumNeighbors = 1;
-
-  Eigen::VectorXi index = Eigen::VectorXi::Constant(kNumNeighbors, -1);
-  Eigen::VectorXd distance_squared = Eigen::VectorXd::Constant(
-      kNumNeighbors, std::numeric_limits<double>::infinity());
-  constexpr double kSearchNNEpsilon = 0.0;
-  const int kOptionFlags = Nabo::NNSearchD::ALLOW_SELF_MATCH;
-  const Eigen::VectorXd query_vector = queryTypeToVector(query);
-  CHECK_EQ(query_vector.rows(), nn_index_data_.rows());
-  nn_index_->knn(query_vector, index, distance_squared, kNumNeighbors,
-                 kSearchNNEpsilon, kOptionFlags);
-  const double nn_distance_squared = distance_squared(0);
-  const int nn_index = index(0);
-
-  if (nn_index >= 0 &&
-      nn_distance_squared != std::numeric_limits<double>::infinity()) {
-    CHECK_LT(nn_index, data_items_.size());
-    *closest_data_item = data_items_[nn_index];
+  size_t data_item_idx;
+  if (findClosestDataItemIndex(queryTypeToVector(query), &data_item_idx)) {
+    CHECK_LT(data_item_idx, data_items_.size());
+    *closest_data_item = data_items_[data_item_idx];
     return true;
   }
   return false;
@@ -78,31 +187,166 @@ VIMapNearestNeighborLookup<QueryType, DataType>::getAllDataItemsWithinRadius(
                  << "Can't look for data items within a radius.";
     return;
   }
-  CHECK(nn_index_);
-  CHECK_EQ(size(), data_items_.size());
 
-  const int num_neighbors = size();
-  CHECK_GT(num_neighbors, 0);
-
-  Eigen::VectorXi index = Eigen::VectorXi::Constant(num_neighbors, -1);
-
-  Eigen::VectorXd distance_squared = Eigen::VectorXd::Constant(
-      num_neighbors, std::numeric_limits<double>::infinity());
-  constexpr double kSearchNNEpsilon = 0.0;
-  const int kOptionFlags = Nabo::NNSearchD::ALLOW_SELF_MATCH;
-  const Eigen::VectorXd query_vector = queryTypeToVector(query);
-  CHECK_EQ(query_vector.rows(), nn_index_data_.rows());
-  nn_index_->knn(query_vector, index, distance_squared, num_neighbors,
-                 kSearchNNEpsilon, kOptionFlags, search_radius);
-
-  size_t result_idx = 0u;
-  while (result_idx < num_neighbors &&
-         distance_squared[result_idx] <
-             std::numeric_limits<double>::infinity()) {
-    const int nn_index = index(result_idx);
-    CHECK_LT(nn_index, data_items_.size());
-    data_items_within_search_radius->emplace(data_items_[nn_index]);
-    ++result_idx;
+  std::vector<size_t> data_item_indices;
+  findDataItemIndicesWithinRadius(
+      queryTypeToVector(query), search_radius, &data_item_indices);
+  for (const size_t data_item_idx : data_item_indices) {
+    data_items_within_search_radius->emplace(data_items_[data_item_idx]);
+  }
+}
+
+template <typename QueryType, typename DataType>
+bool VIMapNearestNeighborLookup<QueryType, DataType>::getClosestDataItems(
+    const Aligned<std::vector, QueryType>& queries, const size_t num_threads,
+    Aligned<std::vector, DataType>* closest_data_items) const {
+  CHECK_NOTNULL(closest_data_items)->clear();
+  if (empty()) {
+    LOG(WARNING) << "The nearest-neighbor index is empty. "
+                 << "Can't look for closest data items.";
+    return false;
+  }
+
+  closest_data_items->resize(queries.size());
+  common::ParallelProcessDynamic(
+      queries.size(),
+      [&](const size_t query_begin, const size_t query_end) {
+        for (size_t query_idx = query_begin; query_idx < query_end;
+             ++query_idx) {
+          size_t data_item_idx;
+          CHECK(findClosestDataItemIndex(
+              queryTypeToVector(queries[query_idx]), &data_item_idx));
+          (*closest_data_items)[query_idx] = data_items_[data_item_idx];
+        }
+      },
+      num_threads);
+  return true;
+}
+
+template <typename QueryType, typename DataType>
+void VIMapNearestNeighborLookup<QueryType, DataType>::
+    getAllDataItemsWithinRadius(
+        const Aligned<std::vector, QueryType>& queries,
+        const double search_radius, const size_t num_threads,
+        std::vector<Aligned<std::vector, DataType>>*
+            data_items_within_search_radius) const {
+  CHECK_NOTNULL(data_items_within_search_radius)->clear();
+  data_items_within_search_radius->resize(queries.size());
+  if (empty()) {
+    LOG(WARNING) << "The nearest-neighbor index is empty. "
+                 << "Can't look for data items within a radius.";
+    return;
+  }
+
+  common::ParallelProcessDynamic(
+      queries.size(),
+      [&](const size_t query_begin, const size_t query_end) {
+        std::vector<size_t> data_item_indices;
+        for (size_t query_idx = query_begin; query_idx < query_end;
+             ++query_idx) {
+          findDataItemIndicesWithinRadius(
+              queryTypeToVector(queries[query_idx]), search_radius,
+              &data_item_indices);
+          Aligned<std::vector, DataType>& data_items =
+              (*data_items_within_search_radius)[query_idx];
+          data_items.reserve(data_item_indices.size());
+          for (const size_t data_item_idx : data_item_indices) {
+            data_items.emplace_back(data_items_[data_item_idx]);
+          }
+        }
+      },
+      num_threads);
+}
+
+template <typename QueryType, typename DataType>
+void VIMapNearestNeighborLookup<QueryType, DataType>::addDataItem(
+    const QueryType& query, const DataType& data_item) {
+  const Eigen::VectorXd data_item_as_vector = queryTypeToVector(query);
+  if (numIndexedDataItems() > 0u) {
+    CHECK_EQ(data_item_as_vector.rows(), nn_index_data_.rows());
+  }
+  if (!buffered_data_.empty()) {
+    CHECK_EQ(data_item_as_vector.rows(), buffered_data_.front().rows());
+  }
+  data_items_.emplace_back(data_item);
+  buffered_data_.emplace_back(data_item_as_vector);
+  is_removed_.push_back(false);
+  mergePendingChangesIfNecessary();
+}
+
+template <typename QueryType, typename DataType>
+size_t VIMapNearestNeighborLookup<QueryType, DataType>::removeDataItems(
+    const std::function<bool(const DataType&)>& should_remove) {
+  CHECK(should_remove);
+  size_t num_removed_data_items = 0u;
+  for (size_t data_item_idx = 0u; data_item_idx < data_items_.size();
+       ++data_item_idx) {
+    if (!is_removed_[data_item_idx] &&
+        should_remove(data_items_[data_item_idx])) {
+      is_removed_[data_item_idx] = true;
+      ++num_removed_data_items;
+    }
+  }
+  num_removed_data_items_ += num_removed_data_items;
+  mergePendingChangesIfNecessary();
+  return num_removed_data_items;
+}
+
+template <typename QueryType, typename DataType>
+void VIMapNearestNeighborLookup<QueryType,
+                                DataType>::mergePendingChangesIfNecessary() {
+  const size_t max_num_pending_changes = std::max(
+      kMinNumPendingChangesToMerge,
+      static_cast<size_t>(
+          std::sqrt(static_cast<double>(numIndexedDataItems()))));
+  if (buffered_data_.size() + num_removed_data_items_ >
+      max_num_pending_changes) {
+    mergePendingChanges();
+  }
+}
+
+template <typename QueryType, typename DataType>
+void VIMapNearestNeighborLookup<QueryType, DataType>::mergePendingChanges() {
+  if (buffered_data_.empty() && num_removed_data_items_ == 0u) {
+    return;
+  }
+  const size_t num_data_items = size();
+  const int dimension = buffered_data_.empty()
+                            ? static_cast<int>(nn_index_data_.rows())
+                            : static_cast<int>(buffered_data_.front().rows());
+  VLOG(3) << "Merging " << buffered_data_.size() << " added and "
+          << num_removed_data_items_ << " removed data items into the "
+          << "nearest-neighbor index.";
+
+  Eigen::MatrixXd merged_index_data(dimension, num_data_items);
+  std::vector<DataType> merged_data_items;
+  merged_data_items.reserve(num_data_items);
+  for (size_t data_item_idx = 0u; data_item_idx < data_items_.size();
+       ++data_item_idx) {
+    if (is_removed_[data_item_idx]) {
+      continue;
+    }
+    const size_t col_idx = merged_data_items.size();
+    if (data_item_idx < numIndexedDataItems()) {
+      merged_index_data.col(col_idx) = nn_index_data_.col(data_item_idx);
+    } else {
+      merged_index_data.col(col_idx) =
+          buffered_data_[data_item_idx - numIndexedDataItems()];
+    }
+    merged_data_items.emplace_back(data_items_[data_item_idx]);
+  }
+  CHECK_EQ(merged_data_items.size(), num_data_items);
+
+  // The k-d tree references the index data, so it is dropped first.
+  nn_index_.reset();
+  nn_index_data_.swap(merged_index_data);
+  data_items_.swap(merged_data_items);
+  buffered_data_.clear();
+  is_removed_.assign(num_data_items, false);
+  num_removed_data_items_ = 0u;
+  if (num_data_items > 0u) {
+    nn_index_.reset(
+        Nabo::NNSearchD::createKDTreeLinearHeap(nn_index_data_, dimension));
   }
 }
 
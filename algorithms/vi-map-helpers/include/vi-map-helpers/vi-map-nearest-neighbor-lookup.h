@@ -60,6 +60,13 @@ struct hash<vi_map::GpsUtmMeasurementMissionPair> {
 namespace vi_map_helpers {
 
 // VIMap wrapper class that provides a nearest-neighbor vertex query.
+//
+// The lookup can be updated incrementally: added data items are kept in a
+// buffer that is searched exhaustively, removed data items are only marked as
+// removed. Once there are more pending changes than about the square root of
+// the number of items in the k-d tree, the buffer is merged into a rebuilt
+// k-d tree, which keeps both the queries and the amortized updates cheap.
+// The const queries can run concurrently, but not concurrently with updates.
 template <typename QueryType, typename DataType>
 class VIMapNearestNeighborLookup {
  public:
@@ -92,16 +99,58 @@ class VIMapNearestNeighborLookup {
       std::unordered_set<DataType, std::hash<DataType>, std::equal_to<DataType>,
                          Allocator>* data_items_within_search_radius) const;
 
+  // Batch versions of the queries above, distributed over num_threads
+  // threads. getClosestDataItems returns false if the lookup is empty.
+  bool getClosestDataItems(
+      const Aligned<std::vector, QueryType>& queries, const size_t num_threads,
+      Aligned<std::vector, DataType>* closest_data_items) const;
+  void getAllDataItemsWithinRadius(
+      const Aligned<std::vector, QueryType>& queries,
+      const double search_radius, const size_t num_threads,
+      std::vector<Aligned<std::vector, DataType>>*
+          data_items_within_search_radius) const;
+
+  // Adds a data item that is found at the location of the given query.
+  void addDataItem(const QueryType& query, const DataType& data_item);
+
+  // Removes all data items for which should_remove returns true and returns
+  // their number.
+  size_t removeDataItems(
+      const std::function<bool(const DataType&)>& should_remove);
+
+  // Merges the added data items into the k-d tree and drops the removed ones.
+  void mergePendingChanges();
+
+  // Number of data items in the lookup, excluding the removed ones.
   inline size_t size() const;
   inline bool empty() const;
 
  private:
   inline void buildIndex();
 
+  // Finds the closest data item that isn't removed.
+  bool findClosestDataItemIndex(
+      const Eigen::VectorXd& query_vector, size_t* data_item_idx) const;
+  void findDataItemIndicesWithinRadius(
+      const Eigen::VectorXd& query_vector, const double search_radius,
+      std::vector<size_t>* data_item_indices) const;
+
+  inline size_t numIndexedDataItems() const;
+  void mergePendingChangesIfNecessary();
+
+  // Pending changes are merged once there are more than this many of them or
+  // more than the square root of the number of indexed data items.
+  static constexpr size_t kMinNumPendingChangesToMerge = 32u;
+
   const vi_map::VIMap& map_;
   std::unique_ptr<Nabo::NNSearchD> nn_index_;
   Eigen::MatrixXd nn_index_data_;
+  // The first numIndexedDataItems() data items are in the k-d tree, the
+  // vectors of the remaining ones are buffered in buffered_data_.
   std::vector<DataType> data_items_;
+  Aligned<std::vector, Eigen::VectorXd> buffered_data_;
+  std::vector<bool> is_removed_;
+  size_t num_removed_data_items_;
 };
 
 typedef VIMapNearestNeighborLookup<aslam::Position3D, pose_graph::VertexId>
@@ -5,10 +5,10 @@
 #include <unordered_map>
 #include <vector>
 
-#include <Eigen/Sparse>
 #include <vi-map/vi-map.h>
 
 namespace vi_map_helpers {
+class CovisibilityGraph;
 
 class VIMapPartitioner {
  public:
@@ -19,33 +19,52 @@ class VIMapPartitioner {
       std::vector<pose_graph::VertexIdList>* partitioning);
 
   // Partitions the vertices of the VIMap based on the coobserved landmarks
-  // graph.
+  // graph. The graph is handed to METIS in memory, by default to its
+  // multilevel k-way partitioning, see the flags in vi-map-partitioner.cc.
   void partitionMapWithMetis(
       const vi_map::VIMap& map, const unsigned int num_partitions,
       std::vector<pose_graph::VertexIdList>* partitioning) const;
+  // Same as above, but reuses a covisibility graph of all vertices of the
+  // map, e.g. if the map is partitioned repeatedly.
+  void partitionMapWithMetis(
+      const vi_map::VIMap& map, const CovisibilityGraph& covisibility_graph,
+      const unsigned int num_partitions,
+      std::vector<pose_graph::VertexIdList>* partitioning) const;
 
  private:
-  struct GraphEdge {
-    size_t vertex_index;
-    size_t score;
+  // Undirected graph in the compressed sparse row format of METIS: the
+  // neighbors of vertex i are
+  //   adjacent_vertices[vertex_offsets[i]], ...,
+  //   adjacent_vertices[vertex_offsets[i + 1] - 1]
+  // and every edge is stored once for each of its two vertices.
+  struct CoobserverGraph {
+    std::vector<int32_t> vertex_offsets;
+    std::vector<int32_t> adjacent_vertices;
+    std::vector<int32_t> edge_weights;
+
+    size_t numVertices() const {
+      return vertex_offsets.empty() ? 0u : vertex_offsets.size() - 1u;
+    }
+    size_t numEdges() const {
+      return adjacent_vertices.size() / 2u;
+    }
   };
-  typedef std::vector<GraphEdge> GraphEdgeVector;
-  typedef Eigen::Triplet<int32_t> EdgeTriplet;
 
   // This method finds coobserver edges between posegraph vertices. The edges
   // are weighted according to the number of landmarks coobserved by the two
-  // vertices.
+  // vertices, summed over both directions. The vertices are processed in
+  // parallel.
   //
   // It supports vertex indices as provided by assignAndGetVertexIndices. The
   // output of the method is also ordered according to the vertex indexing.
   //
   // min_number_of_common_landmarks denotes the minimum number of coobserved
   // landmarks to create an edge.
-  void getCoobserverEdges(
-      const vi_map::VIMap& map,
+  void getCoobserverGraph(
+      const vi_map::VIMap& map, const CovisibilityGraph& covisibility_graph,
       const std::unordered_map<pose_graph::VertexId, size_t>& vertex_indices,
       const unsigned int min_number_of_common_landmarks,
-      unsigned int* total_num_edges, std::vector<GraphEdgeVector>* edges) const;
+      CoobserverGraph* graph) const;
 
   // This method provides a mapping between VIMap vertex IDs and vertex indices
   // that are used by METIS interface.
@@ -53,9 +72,8 @@ class VIMapPartitioner {
       const vi_map::VIMap& map,
       std::unordered_map<pose_graph::VertexId, size_t>* vertex_indices) const;
 
-  void partitionGraphFromTriplets(
-      const std::vector<EdgeTriplet>& edge_triplets,
-      const size_t num_graph_vertices, const size_t num_partitions,
+  void partitionGraph(
+      const CoobserverGraph& graph, const size_t num_partitions,
       bool require_contiguous_partitions,
       std::vector<int32_t>* partition_indices) const;
 
@@ -7,10 +7,13 @@
 #include <vector>
 
 #include <aslam/common/pose-types.h>
+#include <posegraph/pose-graph-adjacency.h>
 #include <posegraph/unique-id.h>
 #include <vi-map/loop-constraint.h>
 #include <vi-map/unique-id.h>
 
+#include "vi-map-helpers/covisibility-graph.h"
+
 namespace vi_map {
 class Vertex;
 class VIMap;
@@ -75,6 +78,13 @@ class VIMapQueries {
   void getVertexIdsAlongGraphForMissions(
       const vi_map::MissionIdList& mission_id_list,
       vi_map::MissionVertexIdList* mission_to_vertex_ids_map) const;
+  // The variants taking an adjacency traverse the given snapshot of the pose
+  // graph, see VIMap::getPoseGraphAdjacency(). They are faster if several
+  // traversals are done on an unchanged graph.
+  void getVertexIdsAlongGraphForMissions(
+      const vi_map::MissionIdList& mission_id_list,
+      const pose_graph::PoseGraphAdjacency& adjacency,
+      vi_map::MissionVertexIdList* mission_to_vertex_ids_map) const;
 
   // ====================
   // LANDMARK ID IN
@@ -92,6 +102,13 @@ class VIMapQueries {
       const vi_map::Vertex& vertex, const size_t frame_index,
       const size_t min_common_landmarks,
       vi_map::VisualFrameIdentifierList* result) const;
+  // The variants taking a covisibility graph look the common landmarks up in
+  // the graph instead of counting them, see CovisibilityGraph.
+  void getVisualFramesWithCommonLandmarksSortedMostToLeast(
+      const vi_map::Vertex& vertex, const size_t frame_index,
+      const size_t min_common_landmarks,
+      const CovisibilityGraph& covisibility_graph,
+      vi_map::VisualFrameIdentifierList* result) const;
   size_t getNumWellConstrainedLandmarks(
       const vi_map::Vertex& vertex, const size_t frame_index) const;
 
@@ -102,14 +119,30 @@ class VIMapQueries {
       const pose_graph::VertexId& starting_vertex,
       const bool include_starting_vertex,
       pose_graph::VertexIdList* result) const;
+  void getFollowingVertexIdsAlongGraph(
+      const pose_graph::VertexId& starting_vertex,
+      const bool include_starting_vertex,
+      const pose_graph::PoseGraphAdjacency& adjacency,
+      pose_graph::VertexIdList* result) const;
   // Includes starting vertex.
   void getFollowingVertexIdsAlongGraph(
       const pose_graph::VertexId& starting_vertex,
       pose_graph::VertexIdList* result) const;
+  // Vertices of the mission of the given vertex at most max_hops steps
+  // along the graph away from it, in either direction, closest first.
+  void getVertexIdsWithinHopsAlongGraph(
+      const pose_graph::VertexId& vertex_id, const size_t max_hops,
+      const pose_graph::PoseGraphAdjacency& adjacency,
+      pose_graph::VertexIdList* result) const;
   int getVerticesWithCommonLandmarks(
       const pose_graph::VertexId& vertex_id, int num_matches_to_return,
       int min_number_common_landmarks,
       pose_graph::VertexIdList* coobserver_vertex_ids) const;
+  int getVerticesWithCommonLandmarks(
+      const pose_graph::VertexId& vertex_id, int num_matches_to_return,
+      int min_number_common_landmarks,
+      const CovisibilityGraph& covisibility_graph,
+      pose_graph::VertexIdList* coobserver_vertex_ids) const;
 
   struct VertexCommonLandmarksCount {
     int in_common;
@@ -123,6 +156,10 @@ class VIMapQueries {
   int getVerticesWithCommonLandmarks(
       const pose_graph::VertexId& vertex_id, int min_number_common_landmarks,
       VertexCommonLandmarksCountVector* coobserver_vertex_ids) const;
+  int getVerticesWithCommonLandmarks(
+      const pose_graph::VertexId& vertex_id, int min_number_common_landmarks,
+      const CovisibilityGraph& covisibility_graph,
+      VertexCommonLandmarksCountVector* coobserver_vertex_ids) const;
   int getVertexWithMostLandmarksInCommon(
       const pose_graph::VertexId& vertex_id,
       pose_graph::VertexId* best_match_vertex_id) const;
@@ -140,6 +177,11 @@ class VIMapQueries {
   int getNumberOfCommonLandmarks(
       const pose_graph::VertexId& vertex_1,
       const pose_graph::VertexId& vertex_2) const;
+  // The graph must contain the neighbors of vertex_1.
+  int getNumberOfCommonLandmarks(
+      const pose_graph::VertexId& vertex_1,
+      const pose_graph::VertexId& vertex_2,
+      const CovisibilityGraph& covisibility_graph) const;
 
   void getCoobservingVertices(
       const pose_graph::VertexIdSet& given_vertices,
@@ -166,6 +208,10 @@ class VIMapQueries {
   void getBoundaryVertexIds(
       const pose_graph::VertexIdList& inner_vertices,
       pose_graph::VertexIdList* boundary_vertices) const;
+  void getBoundaryVertexIds(
+      const pose_graph::VertexIdSet& inner_vertices,
+      const pose_graph::PoseGraphAdjacency& adjacency,
+      pose_graph::VertexIdList* boundary_vertices) const;
 
   template <typename VertexIdContainerType>
   inline void getConsecutiveLandmarkObserverGroupsFromMission(
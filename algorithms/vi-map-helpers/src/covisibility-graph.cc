@@ -0,0 +1,164 @@
+#include "vi-map-helpers/covisibility-graph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
+#include <vi-map/landmark-handles.h>
+#include <vi-map/vi-map.h>
+
+namespace vi_map_helpers {
+
+namespace {
+// The nodes are counted by handle and converted to their ids for the lists.
+template <typename NodeIdType, typename NodeHandleType, typename HandleToId>
+void countsToSortedNeighbors(
+    const std::unordered_map<NodeHandleType, int>& counts,
+    const HandleToId& handle_to_id,
+    typename CovisibilityAdjacency<NodeIdType>::NeighborList* neighbors) {
+  CHECK_NOTNULL(neighbors)->clear();
+  neighbors->reserve(counts.size());
+  for (const std::pair<const NodeHandleType, int>& count : counts) {
+    neighbors->push_back({handle_to_id(count.first), count.second});
+  }
+  std::sort(
+      neighbors->begin(), neighbors->end(),
+      [](const typename CovisibilityAdjacency<NodeIdType>::Neighbor& lhs,
+         const typename CovisibilityAdjacency<NodeIdType>::Neighbor& rhs) {
+        return lhs.num_common_landmarks > rhs.num_common_landmarks;
+      });
+}
+
+inline uint64_t getFrameKey(const vi_map::FrameHandle& frame) {
+  return (static_cast<uint64_t>(frame.vertex) << 32u) | frame.frame_index;
+}
+}  // namespace
+
+CovisibilityGraph::CovisibilityGraph(const vi_map::VIMap& map) {
+  pose_graph::VertexIdList vertex_ids;
+  map.getAllVertexIds(&vertex_ids);
+  build(map, vertex_ids);
+}
+
+CovisibilityGraph::CovisibilityGraph(
+    const vi_map::VIMap& map, const pose_graph::VertexIdList& vertex_ids) {
+  build(map, vertex_ids);
+}
+
+void CovisibilityGraph::build(
+    const vi_map::VIMap& map, const pose_graph::VertexIdList& vertex_ids) {
+  const size_t num_vertices = vertex_ids.size();
+  std::vector<VertexAdjacency::NeighborList> vertex_neighbors(num_vertices);
+  std::vector<std::vector<vi_map::VisualFrameIdentifier>> frame_ids(
+      num_vertices);
+  std::vector<std::vector<FrameAdjacency::NeighborList>> frame_neighbors(
+      num_vertices);
+
+  // The landmarks and their observations are resolved once, such that the
+  // counting below only indexes arrays by handle.
+  const vi_map::LandmarkHandleTable handles(map);
+  const std::function<pose_graph::VertexId(vi_map::VertexHandle)>
+      vertex_handle_to_id = [&handles](const vi_map::VertexHandle vertex) {
+        return handles.getVertexId(vertex);
+      };
+  const std::function<vi_map::VisualFrameIdentifier(uint64_t)>
+      frame_key_to_id = [&handles](const uint64_t frame_key) {
+        return vi_map::VisualFrameIdentifier(
+            handles.getVertexId(
+                static_cast<vi_map::VertexHandle>(frame_key >> 32u)),
+            static_cast<size_t>(frame_key & 0xffffffffu));
+      };
+
+  // Every vertex is processed on its own, the map is only read.
+  std::function<void(const std::vector<size_t>&)> count_function =
+      [&](const std::vector<size_t>& range) {
+        for (const size_t vertex_idx : range) {
+          const pose_graph::VertexId& vertex_id = vertex_ids[vertex_idx];
+          const vi_map::Vertex& vertex = map.getVertex(vertex_id);
+          const vi_map::VertexHandle vertex_handle =
+              handles.getVertexHandle(vertex_id);
+          CHECK_NE(vertex_handle, vi_map::kInvalidVertexHandle);
+
+          std::vector<vi_map::LandmarkHandle> landmark_handles;
+          for (size_t frame_idx = 0u;
+               frame_idx < handles.numFrames(vertex_handle); ++frame_idx) {
+            for (const vi_map::LandmarkHandle landmark :
+                 handles.getFrameObservedLandmarks(vertex_handle, frame_idx)) {
+              if (landmark != vi_map::kInvalidLandmarkHandle) {
+                landmark_handles.push_back(landmark);
+              }
+            }
+          }
+          std::sort(landmark_handles.begin(), landmark_handles.end());
+          landmark_handles.erase(
+              std::unique(landmark_handles.begin(), landmark_handles.end()),
+              landmark_handles.end());
+          std::unordered_map<vi_map::VertexHandle, int> vertex_counts;
+          for (const vi_map::LandmarkHandle landmark : landmark_handles) {
+            for (const vi_map::FrameHandle& frame :
+                 handles.getObservingFrames(landmark)) {
+              ++vertex_counts[frame.vertex];
+            }
+          }
+          countsToSortedNeighbors<pose_graph::VertexId>(
+              vertex_counts, vertex_handle_to_id,
+              &vertex_neighbors[vertex_idx]);
+
+          for (size_t frame_idx = 0u; frame_idx < vertex.numFrames();
+               ++frame_idx) {
+            if (!vertex.isVisualFrameSet(frame_idx)) {
+              continue;
+            }
+            const vi_map::VisualFrameIdentifier frame_id(vertex_id, frame_idx);
+            const uint64_t frame_key = getFrameKey(
+                {vertex_handle, static_cast<uint32_t>(frame_idx)});
+            std::unordered_map<uint64_t, int> frame_counts;
+            for (const vi_map::LandmarkHandle landmark :
+                 handles.getFrameObservedLandmarks(vertex_handle, frame_idx)) {
+              if (landmark == vi_map::kInvalidLandmarkHandle) {
+                continue;
+              }
+              for (const vi_map::FrameHandle& frame :
+                   handles.getObservingFrames(landmark)) {
+                const uint64_t other_frame_key = getFrameKey(frame);
+                if (other_frame_key != frame_key) {
+                  ++frame_counts[other_frame_key];
+                }
+              }
+            }
+            frame_ids[vertex_idx].push_back(frame_id);
+            frame_neighbors[vertex_idx].emplace_back();
+            countsToSortedNeighbors<vi_map::VisualFrameIdentifier>(
+                frame_counts, frame_key_to_id,
+                &frame_neighbors[vertex_idx].back());
+          }
+        }
+      };
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      num_vertices, count_function, kAlwaysParallelize,
+      common::getNumHardwareThreads());
+
+  vertex_adjacency_.node_id_to_neighbors_.reserve(num_vertices);
+  for (size_t vertex_idx = 0u; vertex_idx < num_vertices; ++vertex_idx) {
+    CHECK(
+        vertex_adjacency_.node_id_to_neighbors_
+            .emplace(
+                vertex_ids[vertex_idx],
+                std::move(vertex_neighbors[vertex_idx]))
+            .second)
+        << "Vertex " << vertex_ids[vertex_idx]
+        << " has been added to the covisibility graph twice.";
+    for (size_t i = 0u; i < frame_ids[vertex_idx].size(); ++i) {
+      frame_adjacency_.node_id_to_neighbors_.emplace(
+          frame_ids[vertex_idx][i], std::move(frame_neighbors[vertex_idx][i]));
+    }
+  }
+}
+
+}  // namespace vi_map_helpers
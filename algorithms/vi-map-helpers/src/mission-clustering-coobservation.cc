@@ -1,53 +1,119 @@
 #include "vi-map-helpers/mission-clustering-coobservation.h"
 
+#include <algorithm>
+#include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 #include <maplab-common/accessors.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 #include <vi-map/vi-map.h>
 
-#include "vi-map-helpers/vi-map-queries.h"
-
 namespace vi_map_helpers {
-namespace {
-bool haveCommonElements(
-    const vi_map::LandmarkIdSet& set_a, const vi_map::LandmarkIdSet& set_b) {
-  // Make sure we loop over the smaller set.
-  if (set_b.size() < set_a.size()) {
-    return haveCommonElements(set_b, set_a);
-  }
 
-  for (const vi_map::LandmarkId& landmark_id : set_a) {
-    if (set_b.count(landmark_id) > 0u) {
-      return true;
-    }
-  }
-  return false;
-}
-}  // namespace
+constexpr size_t MissionCoobservationCachedQuery::kNumBitsPerWord;
 
 MissionCoobservationCachedQuery::MissionCoobservationCachedQuery(
-    const vi_map::VIMap& vi_map, const vi_map::MissionIdSet& mission_ids) {
+    const vi_map::VIMap& vi_map, const vi_map::MissionIdSet& mission_ids)
+    : num_words_per_row_(
+          (mission_ids.size() + kNumBitsPerWord - 1u) / kNumBitsPerWord),
+      coobservation_bits_(mission_ids.size() * num_words_per_row_, 0u) {
   for (const vi_map::MissionId& mission_id : mission_ids) {
-    vi_map_helpers::VIMapQueries queries(vi_map);
-    queries.getLandmarksObservedByMission(
-        mission_id, &mission_landmark_map_[mission_id]);
+    CHECK(vi_map.hasMission(mission_id));
+    mission_indices_.emplace(mission_id, mission_indices_.size());
+  }
+  if (mission_ids.empty()) {
+    return;
   }
+
+  vi_map::LandmarkIdList landmark_ids;
+  vi_map.getAllLandmarkIds(&landmark_ids);
+
+  // Every range of landmarks is accumulated in its own matrix, which are
+  // combined at the end.
+  std::mutex coobservation_bits_mutex;
+  const size_t num_threads = common::getNumHardwareThreads();
+  common::ParallelProcessDynamic(
+      landmark_ids.size(),
+      [&](const size_t begin, const size_t end) {
+        std::vector<uint64_t> coobservation_bits(
+            coobservation_bits_.size(), 0u);
+        std::vector<uint64_t> observer_missions(num_words_per_row_);
+        std::vector<size_t> observer_mission_indices;
+        for (size_t landmark_idx = begin; landmark_idx < end; ++landmark_idx) {
+          std::fill(observer_missions.begin(), observer_missions.end(), 0u);
+          observer_mission_indices.clear();
+          vi_map.getLandmark(landmark_ids[landmark_idx])
+              .forEachObservation(
+                  [&](const vi_map::KeypointIdentifier& keypoint_id) {
+                    const pose_graph::VertexId& vertex_id =
+                        keypoint_id.frame_id.vertex_id;
+                    if (!vi_map.hasVertex(vertex_id)) {
+                      return;
+                    }
+                    const std::unordered_map<vi_map::MissionId,
+                                             size_t>::const_iterator it =
+                        mission_indices_.find(
+                            vi_map.getMissionIdForVertex(vertex_id));
+                    if (it == mission_indices_.end()) {
+                      return;
+                    }
+                    const size_t mission_idx = it->second;
+                    uint64_t& word =
+                        observer_missions[mission_idx / kNumBitsPerWord];
+                    const uint64_t mission_bit =
+                        uint64_t{1u} << (mission_idx % kNumBitsPerWord);
+                    if ((word & mission_bit) == 0u) {
+                      word |= mission_bit;
+                      observer_mission_indices.push_back(mission_idx);
+                    }
+                  });
+
+          for (const size_t mission_idx : observer_mission_indices) {
+            uint64_t* row =
+                &coobservation_bits[mission_idx * num_words_per_row_];
+            for (size_t word_idx = 0u; word_idx < num_words_per_row_;
+                 ++word_idx) {
+              row[word_idx] |= observer_missions[word_idx];
+            }
+          }
+        }
+
+        std::lock_guard<std::mutex> lock(coobservation_bits_mutex);
+        for (size_t word_idx = 0u; word_idx < coobservation_bits_.size();
+             ++word_idx) {
+          coobservation_bits_[word_idx] |= coobservation_bits[word_idx];
+        }
+      },
+      num_threads);
+}
+
+const uint64_t* MissionCoobservationCachedQuery::getRow(
+    const vi_map::MissionId& mission_id) const {
+  CHECK(mission_id.isValid());
+  const size_t mission_idx = common::getChecked(mission_indices_, mission_id);
+  return &coobservation_bits_[mission_idx * num_words_per_row_];
 }
 
 bool MissionCoobservationCachedQuery::hasCommonObservations(
     const vi_map::MissionId& mission_id,
-    const vi_map::MissionIdSet& other_mission_ids) const {
-  CHECK(mission_id.isValid());
-  const vi_map::LandmarkIdSet& landmarks_of_mission =
-      common::getChecked(mission_landmark_map_, mission_id);
+    const vi_map::MissionId& other_mission_id) const {
+  CHECK(other_mission_id.isValid());
+  return isBitSet(
+      getRow(mission_id),
+      common::getChecked(mission_indices_, other_mission_id));
+}
 
+bool MissionCoobservationCachedQuery::hasCommonObservations(
+    const vi_map::MissionId& mission_id,
+    const vi_map::MissionIdSet& other_mission_ids) const {
+  const uint64_t* row = getRow(mission_id);
   for (const vi_map::MissionId& other_mission_id : other_mission_ids) {
-    const vi_map::LandmarkIdSet& landmarks_of_other_mission =
-        common::getChecked(mission_landmark_map_, other_mission_id);
-
-    if (haveCommonElements(landmarks_of_mission, landmarks_of_other_mission)) {
+    CHECK(other_mission_id.isValid());
+    if (isBitSet(
+            row, common::getChecked(mission_indices_, other_mission_id))) {
       return true;
     }
   }
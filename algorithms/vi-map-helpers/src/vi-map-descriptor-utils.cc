@@ -85,4 +85,30 @@ void getDescriptorClosestToMedian(
       observations[median_descriptor_index], map, descriptor);
 }
 
+void getDescriptorClosestToMedian(
+    const vi_map::KeypointIdentifierList& observations,
+    const vi_map::DescriptorArena& descriptor_arena,
+    Eigen::Matrix<unsigned char, Eigen::Dynamic, 1>* descriptor,
+    size_t* descriptor_index) {
+  CHECK_NOTNULL(descriptor);
+  CHECK_NOTNULL(descriptor_index);
+  if (observations.empty()) {
+    return;
+  }
+
+  vi_map::DescriptorArena::DescriptorsT raw_descriptors;
+  descriptor_arena.getDescriptorsOfObservations(
+      observations, &raw_descriptors);
+  CHECK_GT(raw_descriptors.rows(), 0);
+
+  size_t median_descriptor_index = 0u;
+  if (observations.size() > 1u) {
+    aslam::common::descriptor_utils::getIndexOfDescriptorClosestToMedian(
+        raw_descriptors, &median_descriptor_index);
+  }
+  CHECK_LT(median_descriptor_index, observations.size());
+  *descriptor = raw_descriptors.col(median_descriptor_index);
+  *descriptor_index = median_descriptor_index;
+}
+
 }  // namespace vi_map_helpers
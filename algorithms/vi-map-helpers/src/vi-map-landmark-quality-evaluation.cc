@@ -1,8 +1,11 @@
 #include "vi-map-helpers/vi-map-landmark-quality-evaluation.h"
 
+#include <mutex>
+
 #include <glog/logging.h>
 #include <maplab-common/multi-threaded-progress-bar.h>
 #include <maplab-common/parallel-process.h>
+#include <maplab-common/progress-bar.h>
 #include <maplab-common/threading-helpers.h>
 #include <vi-map/landmark-quality-metrics.h>
 #include <vi-map/landmark.h>
@@ -10,24 +13,25 @@
 
 namespace vi_map_helpers {
 
-void evaluateLandmarkQuality(vi_map::VIMap* map) {
+namespace {
+void evaluateLandmarkQualityOfLandmarks(
+    const vi_map::LandmarkIdList& landmark_ids, vi_map::VIMap* map) {
   CHECK_NOTNULL(map);
   constexpr bool kEvaluateLandmarkQuality = true;
-
-  vi_map::LandmarkIdList landmark_ids;
-  map->getAllLandmarkIds(&landmark_ids);
   const size_t num_landmarks = landmark_ids.size();
 
   VLOG(1) << "Evaluating quality of landmarks of " << num_landmarks
           << " landmarks.";
 
-  common::MultiThreadedProgressBar progress_bar;
-
-  std::function<void(const std::vector<size_t>&)> evaluator =
-      [&landmark_ids, map, &progress_bar](const std::vector<size_t>& batch) {
-        progress_bar.setNumElements(batch.size());
-        size_t num_processed = 0u;
-        for (size_t idx : batch) {
+  // The cost of the quality evaluation depends on the number of observations
+  // of a landmark, so the landmarks are handed out dynamically.
+  common::ProgressBar progress_bar(num_landmarks);
+  std::mutex progress_mutex;
+  size_t num_processed = 0u;
+  std::function<void(size_t, size_t)> evaluator =
+      [&landmark_ids, map, &progress_bar, &progress_mutex, &num_processed](
+          size_t begin, size_t end) {
+        for (size_t idx = begin; idx < end; ++idx) {
           CHECK_LT(idx, landmark_ids.size());
           const vi_map::LandmarkId& landmark_id = landmark_ids[idx];
           CHECK(landmark_id.isValid());
@@ -37,14 +41,57 @@ void evaluateLandmarkQuality(vi_map::VIMap* map) {
                   *map, landmark, kEvaluateLandmarkQuality)
                   ? vi_map::Landmark::Quality::kGood
                   : vi_map::Landmark::Quality::kBad);
-          progress_bar.update(++num_processed);
         }
+        std::lock_guard<std::mutex> lock(progress_mutex);
+        num_processed += end - begin;
+        progress_bar.update(num_processed);
       };
 
-  static constexpr bool kAlwaysParallelize = false;
   const size_t num_threads = common::getNumHardwareThreads();
-  common::ParallelProcess(
-      num_landmarks, evaluator, kAlwaysParallelize, num_threads);
+  common::ParallelProcessDynamic(num_landmarks, evaluator, num_threads);
+}
+
+void getLandmarksInMap(
+    const vi_map::LandmarkIdSet& landmark_ids, const vi_map::VIMap& map,
+    vi_map::LandmarkIdList* landmarks_in_map) {
+  CHECK_NOTNULL(landmarks_in_map)->clear();
+  landmarks_in_map->reserve(landmark_ids.size());
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+    if (map.hasLandmark(landmark_id)) {
+      landmarks_in_map->push_back(landmark_id);
+    }
+  }
+}
+}  // namespace
+
+void evaluateLandmarkQuality(vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  vi_map::LandmarkIdList landmark_ids;
+  map->getAllLandmarkIds(&landmark_ids);
+  evaluateLandmarkQualityOfLandmarks(landmark_ids, map);
+}
+
+void evaluateLandmarkQuality(
+    const vi_map::LandmarkIdSet& landmark_ids, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  vi_map::LandmarkIdList landmarks_in_map;
+  getLandmarksInMap(landmark_ids, *map, &landmarks_in_map);
+  evaluateLandmarkQualityOfLandmarks(landmarks_in_map, map);
+}
+
+size_t evaluateUnknownLandmarkQuality(vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  vi_map::LandmarkIdList landmark_ids;
+  map->getAllLandmarkIds(&landmark_ids);
+  vi_map::LandmarkIdList unknown_landmark_ids;
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+    if (map->getLandmark(landmark_id).getQuality() ==
+        vi_map::Landmark::Quality::kUnknown) {
+      unknown_landmark_ids.push_back(landmark_id);
+    }
+  }
+  evaluateLandmarkQualityOfLandmarks(unknown_landmark_ids, map);
+  return unknown_landmark_ids.size();
 }
 
 void resetLandmarkQualityToUnknown(vi_map::VIMap* map) {
@@ -74,4 +121,15 @@ void resetLandmarkQualityToUnknown(vi_map::VIMap* map) {
       num_landmarks, evaluator, kAlwaysParallelize, num_threads);
 }
 
+void resetLandmarkQualityToUnknown(
+    const vi_map::LandmarkIdSet& landmark_ids, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+    if (map->hasLandmark(landmark_id)) {
+      map->getLandmark(landmark_id)
+          .setQuality(vi_map::Landmark::Quality::kUnknown);
+    }
+  }
+}
+
 }  // namespace vi_map_helpers
@@ -462,10 +462,7 @@ void VIMapManipulation::releaseOldVisualFrameImages(
 size_t VIMapManipulation::removeBadLandmarks() {
   vi_map::LandmarkIdList bad_landmark_ids;
   queries_.getAllNotWellConstrainedLandmarkIds(&bad_landmark_ids);
-
-  for (const vi_map::LandmarkId& bad_landmark_id : bad_landmark_ids) {
-    map_.removeLandmark(bad_landmark_id);
-  }
+  map_.removeLandmarks(bad_landmark_ids);
   return bad_landmark_ids.size();
 }
 
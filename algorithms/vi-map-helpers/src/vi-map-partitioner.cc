@@ -1,49 +1,69 @@
 #include "vi-map-helpers/vi-map-partitioner.h"
 
+#include <algorithm>
 #include <fstream>  // NOLINT
+#include <type_traits>
 #include <vector>
 
+#include <gflags/gflags.h>
 #include <maplab-common/file-logger.h>
-#include <maplab-common/progress-bar.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 #include <metis.h>
+#include <vi-map-helpers/covisibility-graph.h>
 #include <vi-map-helpers/vi-map-queries.h>
 #include <vi-map/vi-map.h>
 
+DEFINE_uint64(
+    vi_map_partitioner_num_threads, 0u,
+    "Number of threads used to build the coobserver graph that is "
+    "partitioned. (0: number of hardware threads)");
+DEFINE_bool(
+    vi_map_partitioner_recursive_bisection, false,
+    "Partition the coobserver graph with the multilevel recursive bisection "
+    "of METIS instead of its multilevel k-way partitioning. Slower, but "
+    "sometimes better balanced for few partitions.");
+
 namespace vi_map_helpers {
 
+static_assert(
+    std::is_same<idx_t, int32_t>::value,
+    "The coobserver graph is passed to METIS without conversion, METIS needs "
+    "to be built with 32 bit indices.");
+
 const std::string VIMapPartitioner::kFileName = "metis_graph";
 
 void VIMapPartitioner::partitionMapWithMetis(
     const vi_map::VIMap& map, const unsigned int num_partitions,
     std::vector<pose_graph::VertexIdList>* partitioning) const {
+  const CovisibilityGraph covisibility_graph(map);
+  partitionMapWithMetis(map, covisibility_graph, num_partitions, partitioning);
+}
+
+void VIMapPartitioner::partitionMapWithMetis(
+    const vi_map::VIMap& map, const CovisibilityGraph& covisibility_graph,
+    const unsigned int num_partitions,
+    std::vector<pose_graph::VertexIdList>* partitioning) const {
   CHECK_NOTNULL(partitioning)->clear();
+  CHECK_GT(num_partitions, 0u);
   partitioning->resize(num_partitions);
 
   // An unordered map for quick index retrieval.
   std::unordered_map<pose_graph::VertexId, size_t> vertex_indices;
   assignAndGetVertexIndices(map, &vertex_indices);
-  const unsigned int num_vertices = vertex_indices.size();
-
-  std::vector<GraphEdgeVector> edges;
-  unsigned int total_num_edges;
-  getCoobserverEdges(
-      map, vertex_indices, kMinNumberOfCoobservedLandmarks, &total_num_edges,
-      &edges);
-
-  typedef Eigen::Triplet<idx_t> EdgeTriplet;
-  std::vector<EdgeTriplet> edge_triplets;
-  // Triplets will store each edge twice (= in both directions).
-  edge_triplets.reserve(2 * total_num_edges);
-  for (unsigned int i = 0; i < edges.size(); ++i) {
-    for (const GraphEdge& edge : edges[i]) {
-      edge_triplets.push_back(EdgeTriplet(i, edge.vertex_index, edge.score));
-    }
+  if (vertex_indices.empty()) {
+    LOG(WARNING) << "The map has no vertices, nothing to partition.";
+    return;
   }
 
+  CoobserverGraph graph;
+  getCoobserverGraph(
+      map, covisibility_graph, vertex_indices, kMinNumberOfCoobservedLandmarks,
+      &graph);
+
   std::vector<idx_t> part;
   static constexpr bool kRequireContiguous = true;
-  partitionGraphFromTriplets(
-      edge_triplets, num_vertices, num_partitions, kRequireContiguous, &part);
+  partitionGraph(graph, num_partitions, kRequireContiguous, &part);
 
   pose_graph::VertexIdList all_vertex_ids;
   map.getAllVertexIds(&all_vertex_ids);
@@ -56,18 +76,20 @@ void VIMapPartitioner::partitionMapWithMetis(
   }
 }
 
-void VIMapPartitioner::partitionGraphFromTriplets(
-    const std::vector<EdgeTriplet>& edge_triplets,
-    const size_t num_graph_vertices, const size_t num_partitions,
+void VIMapPartitioner::partitionGraph(
+    const CoobserverGraph& graph, const size_t num_partitions,
     const bool require_contiguous_partitions,
     std::vector<int32_t>* partition_indices) const {
   CHECK_NOTNULL(partition_indices)->clear();
+  const size_t num_graph_vertices = graph.numVertices();
+  CHECK_GT(num_graph_vertices, 0u);
+  CHECK_EQ(graph.adjacent_vertices.size(), graph.edge_weights.size());
   partition_indices->resize(num_graph_vertices);
 
-  Eigen::SparseMatrix<idx_t> edge_matrix(
-      num_graph_vertices, num_graph_vertices);
-  edge_matrix.setFromTriplets(edge_triplets.begin(), edge_triplets.end());
-  edge_matrix.makeCompressed();
+  // METIS doesn't modify the graph, but takes non-const pointers.
+  idx_t* xadj = const_cast<idx_t*>(graph.vertex_offsets.data());
+  idx_t* adjncy = const_cast<idx_t*>(graph.adjacent_vertices.data());
+  idx_t* adjwgt = const_cast<idx_t*>(graph.edge_weights.data());
 
   // idx_t and real_t are types defined by METIS in metis.h header file.
   idx_t nvtxs = num_graph_vertices;
@@ -83,41 +105,52 @@ void VIMapPartitioner::partitionGraphFromTriplets(
   idx_t options[METIS_NOPTIONS];
   METIS_SetDefaultOptions(options);
 
-  // Force contiguous partitions if possible.
-  options[METIS_OPTION_CONTIG] = (require_contiguous_partitions ? 1u : 0u);
-
-  // Default options of the command line METIS.
-  // For details see:
-  // http://glaros.dtc.umn.edu/gkhome/fetch/sw/metis/manual.pdf
-  //
-  // K-way graph partitioning that supports contiguous partitions constraint.
-  options[METIS_OPTION_PTYPE] = METIS_PTYPE_KWAY;
-  // Objective: edge-cut minimization.
-  options[METIS_OPTION_OBJTYPE] = METIS_OBJTYPE_CUT;
-  // Coarsening method: sorted heavy-edge.
-  options[METIS_OPTION_CTYPE] = METIS_CTYPE_SHEM;
-  // Refinement method: Greedy-based cut and volume refinement.
-  options[METIS_OPTION_RTYPE] = METIS_RTYPE_GREEDY;
-  // Initial partitioning method: not documented MetisRB method, used by
-  // default by command-line tool.
-  options[METIS_OPTION_IPTYPE] = METIS_IPTYPE_RANDOM;
-  // Partitioning will try to minimize the maximum degree of subdomain graph.
-  options[METIS_OPTION_MINCONN] = 0u;
-  // Coarsening will use 2-hop matching if needed.
-  options[METIS_OPTION_NO2HOP] = 0u;
   // Indexing starting from 0 (C-style).
   options[METIS_OPTION_NUMBERING] = 0u;
   // Output timing and initial partitioning information.
   options[METIS_OPTION_DBGLVL] = METIS_DBG_TIME | METIS_DBG_IPART;
 
-  int status = METIS_PartGraphKway(
-      &nvtxs, &ncon, edge_matrix.outerIndexPtr(), edge_matrix.innerIndexPtr(),
-      vwgt, vsize, edge_matrix.valuePtr(), &nparts, tpwgts, ubvec, options,
-      &objval, &partition_indices->front());
+  int status;
+  if (FLAGS_vi_map_partitioner_recursive_bisection) {
+    // The contiguous partitions constraint is only supported by the k-way
+    // partitioning, the other options keep their defaults.
+    status = METIS_PartGraphRecursive(
+        &nvtxs, &ncon, xadj, adjncy, vwgt, vsize, adjwgt, &nparts, tpwgts,
+        ubvec, options, &objval, &partition_indices->front());
+  } else {
+    // Force contiguous partitions if possible.
+    options[METIS_OPTION_CONTIG] = (require_contiguous_partitions ? 1u : 0u);
+
+    // Default options of the command line METIS.
+    // For details see:
+    // http://glaros.dtc.umn.edu/gkhome/fetch/sw/metis/manual.pdf
+    //
+    // K-way graph partitioning that supports contiguous partitions
+    // constraint.
+    options[METIS_OPTION_PTYPE] = METIS_PTYPE_KWAY;
+    // Objective: edge-cut minimization.
+    options[METIS_OPTION_OBJTYPE] = METIS_OBJTYPE_CUT;
+    // Coarsening method: sorted heavy-edge.
+    options[METIS_OPTION_CTYPE] = METIS_CTYPE_SHEM;
+    // Refinement method: Greedy-based cut and volume refinement.
+    options[METIS_OPTION_RTYPE] = METIS_RTYPE_GREEDY;
+    // Initial partitioning method: not documented MetisRB method, used by
+    // default by command-line tool.
+    options[METIS_OPTION_IPTYPE] = METIS_IPTYPE_RANDOM;
+    // Partitioning will try to minimize the maximum degree of subdomain
+    // graph.
+    options[METIS_OPTION_MINCONN] = 0u;
+    // Coarsening will use 2-hop matching if needed.
+    options[METIS_OPTION_NO2HOP] = 0u;
+
+    status = METIS_PartGraphKway(
+        &nvtxs, &ncon, xadj, adjncy, vwgt, vsize, adjwgt, &nparts, tpwgts,
+        ubvec, options, &objval, &partition_indices->front());
+  }
 
   switch (status) {
     case METIS_OK:
-      LOG(INFO) << "METIS partitioning finished.";
+      LOG(INFO) << "METIS partitioning finished, edge cut: " << objval << ".";
       break;
     case METIS_ERROR_INPUT:
       LOG(FATAL) << "Wrong METIS input format.";
@@ -126,13 +159,14 @@ void VIMapPartitioner::partitionGraphFromTriplets(
       LOG(FATAL) << "METIS could not allocate memory.";
       break;
     case METIS_ERROR:
-      if (require_contiguous_partitions) {
+      if (require_contiguous_partitions &&
+          !FLAGS_vi_map_partitioner_recursive_bisection) {
         LOG(WARNING) << "Experienced a METIS error, will omit the contiguous "
                      << "graph constraint and try again.";
         static constexpr bool kRequireContiguousPartitions = false;
-        partitionGraphFromTriplets(
-            edge_triplets, num_graph_vertices, num_partitions,
-            kRequireContiguousPartitions, partition_indices);
+        partitionGraph(
+            graph, num_partitions, kRequireContiguousPartitions,
+            partition_indices);
       } else {
         LOG(FATAL) << "METIS error.";
       }
@@ -143,56 +177,110 @@ void VIMapPartitioner::partitionGraphFromTriplets(
   }
 }
 
-void VIMapPartitioner::getCoobserverEdges(
-    const vi_map::VIMap& map,
+void VIMapPartitioner::getCoobserverGraph(
+    const vi_map::VIMap& map, const CovisibilityGraph& covisibility_graph,
     const std::unordered_map<pose_graph::VertexId, size_t>& vertex_indices,
     const unsigned int min_number_of_common_landmarks,
-    unsigned int* total_num_edges, std::vector<GraphEdgeVector>* edges) const {
-  CHECK_NOTNULL(edges)->clear();
-  *CHECK_NOTNULL(total_num_edges) = 0u;
+    CoobserverGraph* graph) const {
+  CHECK_NOTNULL(graph);
   CHECK_EQ(vertex_indices.size(), map.numVertices());
-
   const size_t num_vertices = vertex_indices.size();
-  edges->resize(num_vertices);
-
-  typedef std::pair<pose_graph::VertexId, size_t> VertexIndexPair;
-
-  vi_map_helpers::VIMapQueries vi_map_queries(map);
-  unsigned int index = 0u;
-  common::ProgressBar progress_bar(num_vertices);
-  LOG(INFO) << "Partitioning the graph...";
-  for (const VertexIndexPair& vertex_index : vertex_indices) {
-    VLOG(5) << "Processing vertex " << index++ << "/" << (num_vertices - 1);
-
-    vi_map_helpers::VIMapQueries::VertexCommonLandmarksCountVector
-        coobserver_vertex_ids;
-
-    vi_map_queries.getVerticesWithCommonLandmarks(
-        vertex_index.first, min_number_of_common_landmarks,
-        &coobserver_vertex_ids);
-
-    for (const vi_map_helpers::VIMapQueries::VertexCommonLandmarksCount&
-             coobserver_vertex : coobserver_vertex_ids) {
-      std::unordered_map<pose_graph::VertexId, size_t>::const_iterator it =
-          vertex_indices.find(coobserver_vertex.vertex_id);
-      CHECK(it != vertex_indices.end());
-      unsigned int coobserver_index = it->second;
-      CHECK_LT(coobserver_index, edges->size());
-
-      GraphEdge edge_to_coobserver;
-      edge_to_coobserver.vertex_index = coobserver_index;
-      edge_to_coobserver.score = coobserver_vertex.in_common;
-      (*edges)[vertex_index.second].push_back(edge_to_coobserver);
-
-      GraphEdge edge_from_coobserver;
-      edge_from_coobserver.vertex_index = vertex_index.second;
-      edge_from_coobserver.score = coobserver_vertex.in_common;
-      (*edges)[coobserver_index].push_back(edge_from_coobserver);
-
-      ++(*total_num_edges);
+
+  pose_graph::VertexIdList vertex_ids(num_vertices);
+  for (const std::pair<const pose_graph::VertexId, size_t>& vertex_index :
+       vertex_indices) {
+    CHECK_LT(vertex_index.second, num_vertices);
+    vertex_ids[vertex_index.second] = vertex_index.first;
+  }
+
+  typedef std::pair<int32_t, int32_t> NeighborWeightPair;
+  typedef std::vector<NeighborWeightPair> NeighborWeightPairs;
+
+  // The coobservers of every vertex are only read from the covisibility
+  // graph, so the vertices can be processed in parallel. A vertex is its own
+  // coobserver, but METIS doesn't accept self-loops.
+  LOG(INFO) << "Building the coobserver graph of " << num_vertices
+            << " vertices...";
+  const VIMapQueries vi_map_queries(map);
+  std::vector<NeighborWeightPairs> coobservers(num_vertices);
+  const size_t num_threads = FLAGS_vi_map_partitioner_num_threads > 0u
+                                 ? FLAGS_vi_map_partitioner_num_threads
+                                 : common::getNumHardwareThreads();
+  common::ParallelProcessDynamic(
+      num_vertices,
+      [&](const size_t begin, const size_t end) {
+        VIMapQueries::VertexCommonLandmarksCountVector coobserver_vertex_ids;
+        for (size_t vertex_idx = begin; vertex_idx < end; ++vertex_idx) {
+          vi_map_queries.getVerticesWithCommonLandmarks(
+              vertex_ids[vertex_idx], min_number_of_common_landmarks,
+              covisibility_graph, &coobserver_vertex_ids);
+          NeighborWeightPairs& vertex_coobservers = coobservers[vertex_idx];
+          vertex_coobservers.reserve(coobserver_vertex_ids.size());
+          for (const VIMapQueries::VertexCommonLandmarksCount&
+                   coobserver_vertex : coobserver_vertex_ids) {
+            std::unordered_map<pose_graph::VertexId, size_t>::const_iterator
+                it = vertex_indices.find(coobserver_vertex.vertex_id);
+            CHECK(it != vertex_indices.end());
+            if (it->second != vertex_idx) {
+              vertex_coobservers.emplace_back(
+                  it->second, coobserver_vertex.in_common);
+            }
+          }
+        }
+      },
+      num_threads);
+
+  // The counts aren't symmetric, every edge gets the sum of the counts of
+  // both of its directions.
+  std::vector<NeighborWeightPairs> reverse_coobservers(num_vertices);
+  for (size_t vertex_idx = 0u; vertex_idx < num_vertices; ++vertex_idx) {
+    for (const NeighborWeightPair& coobserver : coobservers[vertex_idx]) {
+      reverse_coobservers[coobserver.first].emplace_back(
+          vertex_idx, coobserver.second);
+    }
+  }
+  common::ParallelProcessDynamic(
+      num_vertices,
+      [&](const size_t begin, const size_t end) {
+        for (size_t vertex_idx = begin; vertex_idx < end; ++vertex_idx) {
+          NeighborWeightPairs& neighbors = coobservers[vertex_idx];
+          neighbors.insert(
+              neighbors.end(), reverse_coobservers[vertex_idx].begin(),
+              reverse_coobservers[vertex_idx].end());
+          NeighborWeightPairs().swap(reverse_coobservers[vertex_idx]);
+          std::sort(neighbors.begin(), neighbors.end());
+
+          size_t num_unique_neighbors = 0u;
+          for (const NeighborWeightPair& neighbor : neighbors) {
+            if (num_unique_neighbors > 0u &&
+                neighbors[num_unique_neighbors - 1u].first == neighbor.first) {
+              neighbors[num_unique_neighbors - 1u].second += neighbor.second;
+            } else {
+              neighbors[num_unique_neighbors++] = neighbor;
+            }
+          }
+          neighbors.resize(num_unique_neighbors);
+        }
+      },
+      num_threads);
+
+  graph->vertex_offsets.resize(num_vertices + 1u);
+  graph->vertex_offsets[0] = 0;
+  for (size_t vertex_idx = 0u; vertex_idx < num_vertices; ++vertex_idx) {
+    graph->vertex_offsets[vertex_idx + 1u] =
+        graph->vertex_offsets[vertex_idx] + coobservers[vertex_idx].size();
+  }
+  graph->adjacent_vertices.resize(graph->vertex_offsets.back());
+  graph->edge_weights.resize(graph->vertex_offsets.back());
+  for (size_t vertex_idx = 0u; vertex_idx < num_vertices; ++vertex_idx) {
+    size_t edge_idx = graph->vertex_offsets[vertex_idx];
+    for (const NeighborWeightPair& neighbor : coobservers[vertex_idx]) {
+      graph->adjacent_vertices[edge_idx] = neighbor.first;
+      graph->edge_weights[edge_idx] = neighbor.second;
+      ++edge_idx;
     }
-    progress_bar.increment();
   }
+  VLOG(1) << "The coobserver graph has " << graph->numEdges() << " edges.";
 }
 
 void VIMapPartitioner::assignAndGetVertexIndices(
@@ -216,11 +304,11 @@ void VIMapPartitioner::exportGraphToMetis(const vi_map::VIMap& map) const {
   assignAndGetVertexIndices(map, &vertex_indices);
   const unsigned int num_vertices = vertex_indices.size();
 
-  std::vector<GraphEdgeVector> edges;
-  unsigned int total_num_edges;
-  getCoobserverEdges(
-      map, vertex_indices, kMinNumberOfCoobservedLandmarks, &total_num_edges,
-      &edges);
+  const CovisibilityGraph covisibility_graph(map);
+  CoobserverGraph graph;
+  getCoobserverGraph(
+      map, covisibility_graph, vertex_indices, kMinNumberOfCoobservedLandmarks,
+      &graph);
 
   LOG(INFO) << "Exporting graph data to a file...";
   common::FileLogger metis_graph_export(kFileName);
@@ -230,12 +318,14 @@ void VIMapPartitioner::exportGraphToMetis(const vi_map::VIMap& map) const {
   // * number of vertices
   // * number of edges
   // * 001 - weights only on edges
-  metis_graph_export << num_vertices << " " << total_num_edges << " 001"
+  metis_graph_export << num_vertices << " " << graph.numEdges() << " 001"
                      << std::endl;
   for (unsigned int i = 0; i < num_vertices; ++i) {
-    for (const GraphEdge& edge : edges[i]) {
+    for (int32_t edge_idx = graph.vertex_offsets[i];
+         edge_idx < graph.vertex_offsets[i + 1]; ++edge_idx) {
       // METIS requires vertex numbering to start from 1.
-      metis_graph_export << (edge.vertex_index + 1) << " " << edge.score << " ";
+      metis_graph_export << (graph.adjacent_vertices[edge_idx] + 1) << " "
+                         << graph.edge_weights[edge_idx] << " ";
     }
     metis_graph_export << std::endl;
   }
@@ -1,10 +1,14 @@
 #include "vi-map-helpers/vi-map-queries.h"
 
 #include <algorithm>
+#include <functional>
 #include <unordered_set>
+#include <vector>
 
 #include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
 #include <maplab-common/progress-bar.h>
+#include <maplab-common/threading-helpers.h>
 #include <vi-map/landmark-quality-metrics.h>
 #include <vi-map/vi-map.h>
 
@@ -89,13 +93,39 @@ void VIMapQueries::getAllWellConstrainedLandmarkIds(
 void VIMapQueries::getAllNotWellConstrainedLandmarkIds(
     vi_map::LandmarkIdList* bad_landmarks_ids) const {
   CHECK_NOTNULL(bad_landmarks_ids)->clear();
-  bad_landmarks_ids->reserve(map_.numLandmarks());
 
-  map_.forEachLandmark([&bad_landmarks_ids](const vi_map::Landmark& landmark) {
-    if (landmark.getQuality() == vi_map::Landmark::Quality::kBad) {
-      bad_landmarks_ids->emplace_back(landmark.id());
-    }
-  });
+  // The landmark stores of the vertices are scanned in parallel, the results
+  // are concatenated in vertex order to keep the output deterministic.
+  pose_graph::VertexIdList vertex_ids;
+  map_.getAllVertexIds(&vertex_ids);
+  std::vector<vi_map::LandmarkIdList> bad_landmark_ids_per_vertex(
+      vertex_ids.size());
+  std::function<void(size_t, size_t)> collect_bad_landmarks =
+      [&](const size_t begin, const size_t end) {
+        for (size_t idx = begin; idx < end; ++idx) {
+          for (const vi_map::Landmark& landmark :
+               map_.getVertex(vertex_ids[idx]).getLandmarks()) {
+            if (landmark.getQuality() == vi_map::Landmark::Quality::kBad) {
+              bad_landmark_ids_per_vertex[idx].emplace_back(landmark.id());
+            }
+          }
+        }
+      };
+  common::ParallelProcessDynamic(
+      vertex_ids.size(), collect_bad_landmarks,
+      common::getNumHardwareThreads());
+
+  size_t num_bad_landmarks = 0u;
+  for (const vi_map::LandmarkIdList& landmark_ids :
+       bad_landmark_ids_per_vertex) {
+    num_bad_landmarks += landmark_ids.size();
+  }
+  bad_landmarks_ids->reserve(num_bad_landmarks);
+  for (const vi_map::LandmarkIdList& landmark_ids :
+       bad_landmark_ids_per_vertex) {
+    bad_landmarks_ids->insert(
+        bad_landmarks_ids->end(), landmark_ids.begin(), landmark_ids.end());
+  }
 }
 
 void VIMapQueries::forIdsOfObservedLandmarksOfEachVertexWhile(
@@ -213,6 +243,27 @@ void VIMapQueries::getVertexIdsAlongGraphForMissions(
   CHECK_EQ(mission_to_vertex_ids_map->size(), mission_id_list.size());
 }
 
+void VIMapQueries::getVertexIdsAlongGraphForMissions(
+    const vi_map::MissionIdList& mission_id_list,
+    const pose_graph::PoseGraphAdjacency& adjacency,
+    vi_map::MissionVertexIdList* mission_to_vertex_ids_map) const {
+  CHECK_NOTNULL(mission_to_vertex_ids_map)->clear();
+
+  for (const vi_map::MissionId& mission_id : mission_id_list) {
+    CHECK(mission_id.isValid());
+    pose_graph::VertexIdList& mission_vertex_id_list =
+        (*mission_to_vertex_ids_map)[mission_id];
+    const pose_graph::VertexId& root_vertex_id =
+        map_.getMission(mission_id).getRootVertexId();
+    if (root_vertex_id.isValid()) {
+      adjacency.getVertexIdsAlongEdges(
+          adjacency.getVertexIndex(root_vertex_id),
+          map_.getGraphTraversalEdgeType(mission_id), &mission_vertex_id_list);
+    }
+  }
+  CHECK_EQ(mission_to_vertex_ids_map->size(), mission_id_list.size());
+}
+
 void VIMapQueries::getCommonObserversForLandmarks(
     const vi_map::LandmarkIdList& landmarks,
     pose_graph::VertexIdList* result) const {
@@ -295,6 +346,37 @@ void VIMapQueries::getVisualFramesWithCommonLandmarksSortedMostToLeast(
   result->resize(cutoff - result->begin());
 }
 
+void VIMapQueries::getVisualFramesWithCommonLandmarksSortedMostToLeast(
+    const vi_map::Vertex& vertex, const size_t frame_index,
+    const size_t min_common_landmarks,
+    const CovisibilityGraph& covisibility_graph,
+    vi_map::VisualFrameIdentifierList* result) const {
+  CHECK_NOTNULL(result)->clear();
+  const vi_map::VisualFrameIdentifier self(vertex.id(), frame_index);
+  const CovisibilityGraph::FrameAdjacency::NeighborList& neighbors =
+      covisibility_graph.getFrameAdjacency().getNeighbors(self);
+
+  // The neighbors are sorted from most to least common landmarks already.
+  for (const CovisibilityGraph::FrameAdjacency::Neighbor& neighbor :
+       neighbors) {
+    if (static_cast<size_t>(neighbor.num_common_landmarks) <
+        min_common_landmarks) {
+      break;
+    }
+    result->push_back(neighbor.id);
+  }
+
+  if (min_common_landmarks == 0) {
+    const std::unordered_set<vi_map::VisualFrameIdentifier> neighbor_frames(
+        result->begin(), result->end());
+    map_.forEachVisualFrame([&](const vi_map::VisualFrameIdentifier& frame_id) {
+      if (neighbor_frames.count(frame_id) == 0u && frame_id != self) {
+        result->push_back(frame_id);
+      }
+    });
+  }
+}
+
 size_t VIMapQueries::getNumWellConstrainedLandmarks(
     const vi_map::Vertex& vertex, const size_t frame_index) const {
   CHECK(vertex.isVisualFrameSet(frame_index));
@@ -340,6 +422,23 @@ void VIMapQueries::getFollowingVertexIdsAlongGraph(
       current_vertex_id, map_.getGraphTraversalEdgeType(mission_id),
       &current_vertex_id));
 }
+void VIMapQueries::getFollowingVertexIdsAlongGraph(
+    const pose_graph::VertexId& starting_vertex,
+    const bool include_starting_vertex,
+    const pose_graph::PoseGraphAdjacency& adjacency,
+    pose_graph::VertexIdList* result) const {
+  CHECK_NOTNULL(result)->clear();
+  const pose_graph::Edge::EdgeType edge_type = map_.getGraphTraversalEdgeType(
+      map_.getVertex(starting_vertex).getMissionId());
+
+  pose_graph::PoseGraphAdjacency::VertexIndex vertex_index =
+      adjacency.getVertexIndex(starting_vertex);
+  if (!include_starting_vertex &&
+      !adjacency.getNextVertex(vertex_index, edge_type, &vertex_index)) {
+    return;
+  }
+  adjacency.getVertexIdsAlongEdges(vertex_index, edge_type, result);
+}
 void VIMapQueries::getFollowingVertexIdsAlongGraph(
     const pose_graph::VertexId& starting_vertex,
     pose_graph::VertexIdList* result) const {
@@ -348,6 +447,17 @@ void VIMapQueries::getFollowingVertexIdsAlongGraph(
       starting_vertex, kIncludeStartingVertex, result);
 }
 
+void VIMapQueries::getVertexIdsWithinHopsAlongGraph(
+    const pose_graph::VertexId& vertex_id, const size_t max_hops,
+    const pose_graph::PoseGraphAdjacency& adjacency,
+    pose_graph::VertexIdList* result) const {
+  CHECK_NOTNULL(result)->clear();
+  adjacency.getVertexIdsWithinHops(
+      adjacency.getVertexIndex(vertex_id),
+      map_.getGraphTraversalEdgeType(map_.getVertex(vertex_id).getMissionId()),
+      max_hops, result);
+}
+
 int VIMapQueries::getVerticesWithCommonLandmarks(
     const pose_graph::VertexId& vertex_id, int num_matches_to_return,
     int min_number_common_landmarks,
@@ -372,6 +482,43 @@ int VIMapQueries::getVerticesWithCommonLandmarks(
   return coobserver_vertex_ids->size();
 }
 
+int VIMapQueries::getVerticesWithCommonLandmarks(
+    const pose_graph::VertexId& vertex_id, int num_matches_to_return,
+    int min_number_common_landmarks,
+    const CovisibilityGraph& covisibility_graph,
+    pose_graph::VertexIdList* coobserver_vertex_ids) const {
+  CHECK_NOTNULL(coobserver_vertex_ids)->clear();
+  CHECK_GE(num_matches_to_return, 0);
+
+  for (const CovisibilityGraph::VertexAdjacency::Neighbor& neighbor :
+       covisibility_graph.getVertexAdjacency().getNeighbors(vertex_id)) {
+    if (static_cast<int>(coobserver_vertex_ids->size()) ==
+            num_matches_to_return ||
+        neighbor.num_common_landmarks < min_number_common_landmarks) {
+      break;
+    }
+    coobserver_vertex_ids->push_back(neighbor.id);
+  }
+  return coobserver_vertex_ids->size();
+}
+
+int VIMapQueries::getVerticesWithCommonLandmarks(
+    const pose_graph::VertexId& vertex_id, int min_number_common_landmarks,
+    const CovisibilityGraph& covisibility_graph,
+    VertexCommonLandmarksCountVector* coobserver_vertex_ids) const {
+  CHECK_NOTNULL(coobserver_vertex_ids)->clear();
+
+  for (const CovisibilityGraph::VertexAdjacency::Neighbor& neighbor :
+       covisibility_graph.getVertexAdjacency().getNeighbors(vertex_id)) {
+    if (neighbor.num_common_landmarks < min_number_common_landmarks) {
+      break;
+    }
+    coobserver_vertex_ids->emplace_back(
+        neighbor.num_common_landmarks, neighbor.id);
+  }
+  return coobserver_vertex_ids->size();
+}
+
 int VIMapQueries::getVerticesWithCommonLandmarks(
     const pose_graph::VertexId& vertex_id, int min_number_common_landmarks,
     VertexCommonLandmarksCountVector* coobserver_vertex_ids) const {
@@ -413,6 +560,14 @@ int VIMapQueries::getNumberOfCommonLandmarks(
   return getNumberOfCommonLandmarks(vertex_1, vertex_2, nullptr);
 }
 
+int VIMapQueries::getNumberOfCommonLandmarks(
+    const pose_graph::VertexId& vertex_1,
+    const pose_graph::VertexId& vertex_2,
+    const CovisibilityGraph& covisibility_graph) const {
+  return covisibility_graph.getVertexAdjacency().getNumCommonLandmarks(
+      vertex_1, vertex_2);
+}
+
 // Returns the number of common landmarks of vertex 1 and 2
 // NOTE:  The landmarks argument of this function is allowed to be a
 //        nullptr. However if only the number of common landmarks is
@@ -658,6 +813,52 @@ void VIMapQueries::getBoundaryVertexIds(
   }
 }
 
+void VIMapQueries::getBoundaryVertexIds(
+    const pose_graph::VertexIdSet& inner_vertices,
+    const pose_graph::PoseGraphAdjacency& adjacency,
+    pose_graph::VertexIdList* boundary_vertices) const {
+  CHECK_NOTNULL(boundary_vertices)->clear();
+
+  typedef pose_graph::PoseGraphAdjacency::VertexIndex VertexIndex;
+  VertexIndex candidate_vertex_index;
+
+  // A set is used to filter out duplicate ids.
+  pose_graph::VertexIdSet boundary_vertex_set;
+  for (const pose_graph::VertexId& inner_vertex_id : inner_vertices) {
+    const vi_map::MissionId& mission_id =
+        map_.getVertex(inner_vertex_id).getMissionId();
+    CHECK(mission_id.isValid());
+    const pose_graph::Edge::EdgeType edge_type =
+        map_.getGraphTraversalEdgeType(mission_id);
+    const VertexIndex inner_vertex_index =
+        adjacency.getVertexIndex(inner_vertex_id);
+
+    if (adjacency.getNextVertex(
+            inner_vertex_index, edge_type, &candidate_vertex_index)) {
+      const pose_graph::VertexId& candidate_vertex_id =
+          adjacency.getVertexId(candidate_vertex_index);
+      if (inner_vertices.count(candidate_vertex_id) == 0u) {
+        boundary_vertex_set.insert(candidate_vertex_id);
+      }
+    }
+    if (adjacency.getPreviousVertex(
+            inner_vertex_index, edge_type, &candidate_vertex_index)) {
+      const pose_graph::VertexId& candidate_vertex_id =
+          adjacency.getVertexId(candidate_vertex_index);
+      if (inner_vertices.count(candidate_vertex_id) == 0u) {
+        boundary_vertex_set.insert(candidate_vertex_id);
+      }
+    }
+  }
+
+  boundary_vertices->insert(
+      boundary_vertices->end(), boundary_vertex_set.begin(),
+      boundary_vertex_set.end());
+  if (boundary_vertices->empty()) {
+    LOG(WARNING) << "No boundary vertices found!";
+  }
+}
+
 void VIMapQueries::forEachWellConstrainedObservedLandmark(
     const vi_map::Vertex& vertex,
     const std::function<void(
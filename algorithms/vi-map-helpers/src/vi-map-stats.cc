@@ -8,6 +8,8 @@
 #include <posegraph/unique-id.h>
 #include <vi-map/vi-map.h>
 
+#include "vi-map-helpers/covisibility-graph.h"
+
 namespace vi_map_helpers {
 
 VIMapStats::VIMapStats(const vi_map::VIMap& map)
@@ -127,12 +129,14 @@ void VIMapStats::getNumLandmarksObservedByOtherMissionsForEachVertexAlongGraph(
   result->resize(ordered_vertices_of_mission.size());
 
   VLOG(3) << "Counting amount of landmarks observed by other missions...";
+  const CovisibilityGraph covisibility_graph(
+      map_, ordered_vertices_of_mission);
   common::ProgressBar progress_bar(ordered_vertices_of_mission.size());
-  // DO NOT PARALLELIZE (not worth due to cache mutexes)!
   for (size_t i = 0u; i < ordered_vertices_of_mission.size(); ++i) {
     VIMapQueries::VertexCommonLandmarksCountVector common_landmarks;
     map_queries_.getVerticesWithCommonLandmarks(
-        ordered_vertices_of_mission[i], 0, &common_landmarks);
+        ordered_vertices_of_mission[i], 0, covisibility_graph,
+        &common_landmarks);
 
     (*result)[i] = 0u;
     for (const VIMapQueries::VertexCommonLandmarksCount& count :
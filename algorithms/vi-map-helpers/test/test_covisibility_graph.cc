@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <unordered_map>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <vi-map/test/vi-map-generator.h>
+#include <vi-map/vi-map.h>
+
+#include "vi-map-helpers/covisibility-graph.h"
+#include "vi-map-helpers/vi-map-queries.h"
+
+namespace vi_map_helpers {
+
+class CovisibilityGraphTest : public ::testing::Test {
+ protected:
+  static constexpr size_t kRandomSeed = 42u;
+  static constexpr size_t kNumVertices = 6u;
+
+  CovisibilityGraphTest() : map_(), generator_(map_, kRandomSeed) {}
+
+  virtual void SetUp() {
+    pose::Transformation T_G_M;
+    const vi_map::MissionId mission_id = generator_.createMission(T_G_M);
+    for (size_t i = 0u; i < kNumVertices; ++i) {
+      pose::Transformation T_G_I;
+      T_G_I.getPosition() << static_cast<double>(i), 0.0, 0.0;
+      vertex_ids_.push_back(generator_.createVertex(mission_id, T_G_I));
+    }
+    // Every landmark is observed by a window of consecutive vertices with a
+    // varying length, so that the vertices have different co-observers.
+    for (size_t i = 0u; i < 3u * kNumVertices; ++i) {
+      const size_t storing_idx = i % kNumVertices;
+      const size_t window_size = 1u + i % 3u;
+      pose_graph::VertexIdList observer_ids;
+      for (size_t j = 1u;
+           j <= window_size && storing_idx + j < kNumVertices; ++j) {
+        observer_ids.push_back(vertex_ids_[storing_idx + j]);
+      }
+      generator_.createLandmark(
+          Eigen::Vector3d(static_cast<double>(i), 0.0, 5.0),
+          vertex_ids_[storing_idx], observer_ids);
+    }
+    generator_.generateMap();
+  }
+
+  vi_map::VIMap map_;
+  vi_map::VIMapGenerator generator_;
+  pose_graph::VertexIdList vertex_ids_;
+};
+
+TEST_F(CovisibilityGraphTest, MatchesQueriesWithoutGraph) {
+  const VIMapQueries queries(map_);
+  const CovisibilityGraph covisibility_graph(map_);
+  EXPECT_EQ(kNumVertices, covisibility_graph.getVertexAdjacency().numNodes());
+
+  for (const pose_graph::VertexId& vertex_id : vertex_ids_) {
+    for (const pose_graph::VertexId& other_vertex_id : vertex_ids_) {
+      EXPECT_EQ(
+          queries.getNumberOfCommonLandmarks(vertex_id, other_vertex_id),
+          queries.getNumberOfCommonLandmarks(
+              vertex_id, other_vertex_id, covisibility_graph));
+    }
+
+    constexpr int kMinNumberCommonLandmarks = 2;
+    VIMapQueries::VertexCommonLandmarksCountVector coobservers;
+    queries.getVerticesWithCommonLandmarks(
+        vertex_id, kMinNumberCommonLandmarks, &coobservers);
+    VIMapQueries::VertexCommonLandmarksCountVector graph_coobservers;
+    queries.getVerticesWithCommonLandmarks(
+        vertex_id, kMinNumberCommonLandmarks, covisibility_graph,
+        &graph_coobservers);
+    ASSERT_EQ(coobservers.size(), graph_coobservers.size());
+    std::unordered_map<pose_graph::VertexId, int> counts;
+    for (const VIMapQueries::VertexCommonLandmarksCount& count : coobservers) {
+      counts[count.vertex_id] = count.in_common;
+    }
+    for (size_t i = 0u; i < graph_coobservers.size(); ++i) {
+      EXPECT_EQ(
+          counts[graph_coobservers[i].vertex_id],
+          graph_coobservers[i].in_common);
+      if (i > 0u) {
+        EXPECT_GE(
+            graph_coobservers[i - 1u].in_common,
+            graph_coobservers[i].in_common);
+      }
+    }
+
+    const vi_map::Vertex& vertex = map_.getVertex(vertex_id);
+    for (size_t frame_idx = 0u; frame_idx < vertex.numFrames(); ++frame_idx) {
+      if (!vertex.isVisualFrameSet(frame_idx)) {
+        continue;
+      }
+      constexpr size_t kMinCommonLandmarks = 1u;
+      vi_map::VisualFrameIdentifierList frames;
+      queries.getVisualFramesWithCommonLandmarksSortedMostToLeast(
+          vertex, frame_idx, kMinCommonLandmarks, &frames);
+      vi_map::VisualFrameIdentifierList graph_frames;
+      queries.getVisualFramesWithCommonLandmarksSortedMostToLeast(
+          vertex, frame_idx, kMinCommonLandmarks, covisibility_graph,
+          &graph_frames);
+      std::sort(frames.begin(), frames.end());
+      std::sort(graph_frames.begin(), graph_frames.end());
+      EXPECT_EQ(frames, graph_frames);
+    }
+  }
+}
+
+TEST_F(CovisibilityGraphTest, BuildsOnlyTheGivenVertices) {
+  const pose_graph::VertexIdList vertex_ids = {vertex_ids_[0], vertex_ids_[1]};
+  const CovisibilityGraph covisibility_graph(map_, vertex_ids);
+  const CovisibilityGraph::VertexAdjacency& adjacency =
+      covisibility_graph.getVertexAdjacency();
+  EXPECT_EQ(2u, adjacency.numNodes());
+  EXPECT_TRUE(adjacency.hasNode(vertex_ids_[0]));
+  EXPECT_FALSE(adjacency.hasNode(vertex_ids_[2]));
+  // The neighbors of the given vertices aren't restricted.
+  EXPECT_GT(adjacency.getNumCommonLandmarks(vertex_ids_[1], vertex_ids_[2]), 0);
+  EXPECT_EQ(
+      0, adjacency.getNumCommonLandmarks(
+             vertex_ids_[0], vertex_ids_[kNumVertices - 1u]));
+}
+
+}  // namespace vi_map_helpers
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/unique-id.h>
+#include <vi-map/landmark.h>
+#include <vi-map/test/vi-map-test-helpers.h>
+#include <vi-map/unique-id.h>
+#include <vi-map/vi-map.h>
+
+#include "vi-map-helpers/vi-map-landmark-quality-evaluation.h"
+
+namespace vi_map_helpers {
+
+class LandmarkQualityEvaluationTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    vi_map::test::generateMap(kNumVertices, &map_);
+    map_.getAllLandmarkIds(&landmark_ids_);
+    ASSERT_GT(landmark_ids_.size(), 2u);
+
+    // The landmarks of the generated map have no observations and are thus
+    // evaluated as bad, so marking them as good shows which landmarks were
+    // re-evaluated.
+    for (const vi_map::LandmarkId& landmark_id : landmark_ids_) {
+      map_.getLandmark(landmark_id)
+          .setQuality(vi_map::Landmark::Quality::kGood);
+    }
+    for (size_t idx = 0u; idx < landmark_ids_.size(); idx += 2u) {
+      dirty_landmark_ids_.insert(landmark_ids_[idx]);
+    }
+  }
+
+  void expectOnlyDirtyLandmarksEvaluated() const {
+    for (const vi_map::LandmarkId& landmark_id : landmark_ids_) {
+      EXPECT_EQ(
+          dirty_landmark_ids_.count(landmark_id) > 0u
+              ? vi_map::Landmark::Quality::kBad
+              : vi_map::Landmark::Quality::kGood,
+          map_.getLandmark(landmark_id).getQuality());
+    }
+  }
+
+  static constexpr size_t kNumVertices = 20u;
+
+  vi_map::VIMap map_;
+  vi_map::LandmarkIdList landmark_ids_;
+  vi_map::LandmarkIdSet dirty_landmark_ids_;
+};
+
+constexpr size_t LandmarkQualityEvaluationTest::kNumVertices;
+
+TEST_F(LandmarkQualityEvaluationTest, EvaluateGivenLandmarks) {
+  vi_map::LandmarkIdSet landmark_ids = dirty_landmark_ids_;
+  vi_map::LandmarkId removed_landmark_id;
+  common::generateId(&removed_landmark_id);
+  landmark_ids.insert(removed_landmark_id);
+
+  evaluateLandmarkQuality(landmark_ids, &map_);
+  expectOnlyDirtyLandmarksEvaluated();
+}
+
+TEST_F(LandmarkQualityEvaluationTest, EvaluateUnknownLandmarks) {
+  resetLandmarkQualityToUnknown(dirty_landmark_ids_, &map_);
+  EXPECT_EQ(
+      dirty_landmark_ids_.size(), evaluateUnknownLandmarkQuality(&map_));
+  expectOnlyDirtyLandmarksEvaluated();
+
+  // Nothing is left to evaluate.
+  EXPECT_EQ(0u, evaluateUnknownLandmarkQuality(&map_));
+}
+
+}  // namespace vi_map_helpers
+
+MAPLAB_UNITTEST_ENTRYPOINT
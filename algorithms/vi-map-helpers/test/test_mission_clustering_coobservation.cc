@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include <Eigen/Core>
 #include <aslam/common/pose-types.h>
 #include <gtest/gtest.h>
@@ -107,6 +109,64 @@ TEST(MissionClusteringCoobservation, ClusterMissionByLandmarkCoobservations) {
   EXPECT_TRUE(clustersEqualWithoutOrdering(expected_clusters, clusters));
 }
 
+TEST(MissionClusteringCoobservation, CoobservationsOfManyMissions) {
+  // More missions than bits in a word of the coobservation matrix. Every
+  // mission observes a common landmark with the next one, except for every
+  // third mission.
+  constexpr size_t kNumMissions = 70u;
+  constexpr size_t kNumMissionsPerCluster = 3u;
+  vi_map::VIMap map;
+  vi_map::VIMapGenerator generator(map, /*random_seed=*/0);
+  vi_map::MissionIdList M;
+  pose_graph::VertexIdList V;
+  for (size_t i = 0u; i < kNumMissions; ++i) {
+    aslam::Transformation dummy_pose;
+    M.emplace_back(generator.createMission(dummy_pose));
+    V.emplace_back(generator.createVertex(M.back(), dummy_pose));
+  }
+  const Eigen::Vector3d dummy_position(0, 0, 100);
+  for (size_t i = 0u; i + 1u < kNumMissions; ++i) {
+    if ((i + 1u) % kNumMissionsPerCluster != 0u) {
+      generator.createLandmark(dummy_position, V[i], {V[i + 1u]});
+    }
+  }
+  generator.generateMap();
+
+  auto shareLandmark = [&](const size_t i, const size_t j) {
+    return (i + 1u == j && j % kNumMissionsPerCluster != 0u) ||
+           (j + 1u == i && i % kNumMissionsPerCluster != 0u);
+  };
+
+  const vi_map::MissionIdSet mission_to_query(M.begin(), M.end());
+  const MissionCoobservationCachedQuery coobservations(map, mission_to_query);
+  for (size_t i = 0u; i < kNumMissions; ++i) {
+    // A mission observes its own landmarks, unless it has none.
+    const bool observes_landmarks = (i > 0u && shareLandmark(i, i - 1u)) ||
+                                    (i + 1u < kNumMissions &&
+                                     shareLandmark(i, i + 1u));
+    for (size_t j = 0u; j < kNumMissions; ++j) {
+      const bool expected =
+          shareLandmark(i, j) || (i == j && observes_landmarks);
+      EXPECT_EQ(expected, coobservations.hasCommonObservations(M[i], M[j]))
+          << "Missions " << i << " and " << j;
+    }
+  }
+
+  std::vector<vi_map::MissionIdSet> expected_clusters;
+  for (size_t i = 0u; i < kNumMissions; i += kNumMissionsPerCluster) {
+    vi_map::MissionIdSet cluster;
+    for (size_t j = i; j < std::min(i + kNumMissionsPerCluster, kNumMissions);
+         ++j) {
+      cluster.emplace(M[j]);
+    }
+    expected_clusters.emplace_back(cluster);
+  }
+  EXPECT_TRUE(
+      clustersEqualWithoutOrdering(
+          expected_clusters,
+          clusterMissionByLandmarkCoobservations(map, mission_to_query)));
+}
+
 }  // namespace vi_map_helpers
 
 MAPLAB_UNITTEST_ENTRYPOINT
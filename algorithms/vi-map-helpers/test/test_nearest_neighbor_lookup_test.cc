@@ -3,6 +3,7 @@
 #include <Eigen/Core>
 #include <gtest/gtest.h>
 #include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/unique-id.h>
 #include <vi-map/test/vi-map-generator.h>
 
 #include "vi-map-helpers/vi-map-nearest-neighbor-lookup.h"
@@ -205,6 +206,149 @@ TEST(VIMapNearestNeighborLookupTest, MultipleVertexRadiusLookup) {
   }
 }
 
+TEST(VIMapNearestNeighborLookupTest, IncrementalUpdatesAndBatchQueries) {
+  vi_map::VIMap map;
+  vi_map::VIMapGenerator generator(map, kSeed);
+  const vi_map::MissionId mission_id = generator.createMission();
+  CHECK(mission_id.isValid());
+
+  srand(kSeed);
+
+  const size_t kNumVerticesInMap = 20u;
+  VertexIdToMeasurementMap vertex_id_to_data_item_map;
+  for (size_t idx = 0u; idx < kNumVerticesInMap; ++idx) {
+    aslam::Transformation T_G_I;
+    T_G_I.getPosition() = 1e3 * Eigen::Vector3d::Random();
+    const pose_graph::VertexId vertex_id =
+        generator.createVertex(mission_id, T_G_I);
+    CHECK(vertex_id.isValid());
+    vertex_id_to_data_item_map.emplace(
+        vertex_id, queryTypeToVector(T_G_I.getPosition()));
+  }
+
+  generator.generateMap();
+
+  VIMapNearestNeighborLookupVertexId nn_query_database(map);
+  EXPECT_EQ(kNumVerticesInMap, nn_query_database.size());
+
+  std::mt19937 random_number_generator(kSeed);
+  std::uniform_real_distribution<> uniform_distribution(0.0, 1e3);
+
+  // Enough updates to trigger several merges of the pending changes.
+  const size_t kNumUpdateRounds = 10u;
+  const size_t kNumAddedVerticesPerRound = 15u;
+  const size_t kNumQueries = 20u;
+  const size_t kNumThreads = 4u;
+  for (size_t round_idx = 0u; round_idx < kNumUpdateRounds; ++round_idx) {
+    for (size_t idx = 0u; idx < kNumAddedVerticesPerRound; ++idx) {
+      pose_graph::VertexId vertex_id;
+      common::generateId(&vertex_id);
+      const aslam::Position3D p_G_I = 1e3 * aslam::Position3D::Random();
+      nn_query_database.addDataItem(p_G_I, vertex_id);
+      vertex_id_to_data_item_map.emplace(vertex_id, queryTypeToVector(p_G_I));
+    }
+
+    // Remove the vertices within a random ball.
+    const Eigen::VectorXd p_G_removal_center =
+        1e3 * Eigen::VectorXd::Random(3);
+    const double removal_radius =
+        0.3 * uniform_distribution(random_number_generator);
+    size_t expected_num_removed_vertices = 0u;
+    for (VertexIdToMeasurementMap::iterator it =
+             vertex_id_to_data_item_map.begin();
+         it != vertex_id_to_data_item_map.end();) {
+      if ((it->second - p_G_removal_center).norm() <= removal_radius) {
+        it = vertex_id_to_data_item_map.erase(it);
+        ++expected_num_removed_vertices;
+      } else {
+        ++it;
+      }
+    }
+    EXPECT_EQ(
+        expected_num_removed_vertices,
+        nn_query_database.removeDataItems(
+            [&](const pose_graph::VertexId& vertex_id) {
+              return vertex_id_to_data_item_map.count(vertex_id) == 0u;
+            }));
+    if (round_idx == kNumUpdateRounds / 2u) {
+      nn_query_database.mergePendingChanges();
+    }
+    ASSERT_EQ(vertex_id_to_data_item_map.size(), nn_query_database.size());
+
+    MeasurementsList p_G_Is;
+    for (const VertexIdToMeasurementMap::value_type& vertex_id_and_p_G_I :
+         vertex_id_to_data_item_map) {
+      p_G_Is.emplace_back(vertex_id_and_p_G_I.second);
+    }
+
+    Aligned<std::vector, aslam::Position3D> p_G_I_queries(kNumQueries);
+    for (aslam::Position3D& p_G_I_query : p_G_I_queries) {
+      p_G_I_query = 1e3 * aslam::Position3D::Random();
+    }
+    const double search_radius = uniform_distribution(random_number_generator);
+
+    Aligned<std::vector, pose_graph::VertexId> closest_vertex_ids;
+    ASSERT_TRUE(
+        nn_query_database.getClosestDataItems(
+            p_G_I_queries, kNumThreads, &closest_vertex_ids));
+    ASSERT_EQ(kNumQueries, closest_vertex_ids.size());
+
+    std::vector<Aligned<std::vector, pose_graph::VertexId>>
+        vertex_ids_within_search_radius;
+    nn_query_database.getAllDataItemsWithinRadius(
+        p_G_I_queries, search_radius, kNumThreads,
+        &vertex_ids_within_search_radius);
+    ASSERT_EQ(kNumQueries, vertex_ids_within_search_radius.size());
+
+    for (size_t query_idx = 0u; query_idx < kNumQueries; ++query_idx) {
+      const Eigen::VectorXd p_G_I_query =
+          queryTypeToVector(p_G_I_queries[query_idx]);
+
+      VertexIdToMeasurementMap::const_iterator p_G_I_iterator =
+          vertex_id_to_data_item_map.find(closest_vertex_ids[query_idx]);
+      ASSERT_TRUE(p_G_I_iterator != vertex_id_to_data_item_map.end());
+      EXPECT_EQ(
+          getGroundTruthClosestDataItem(p_G_Is, p_G_I_query),
+          p_G_I_iterator->second);
+
+      pose_graph::VertexId single_query_closest_vertex_id;
+      EXPECT_TRUE(
+          nn_query_database.getClosestDataItem(
+              p_G_I_queries[query_idx], &single_query_closest_vertex_id));
+      EXPECT_EQ(closest_vertex_ids[query_idx], single_query_closest_vertex_id);
+
+      MeasurementsSet p_G_Is_within_search_radius;
+      for (const pose_graph::VertexId& vertex_id :
+           vertex_ids_within_search_radius[query_idx]) {
+        p_G_I_iterator = vertex_id_to_data_item_map.find(vertex_id);
+        ASSERT_TRUE(p_G_I_iterator != vertex_id_to_data_item_map.end());
+        p_G_Is_within_search_radius.emplace(p_G_I_iterator->second);
+      }
+      EXPECT_EQ(
+          vertex_ids_within_search_radius[query_idx].size(),
+          p_G_Is_within_search_radius.size());
+
+      MeasurementsSet ground_truth_p_G_Is_within_search_radius;
+      getGroundTruthAllDataItemsWithinRadius(
+          p_G_Is, p_G_I_query, search_radius,
+          &ground_truth_p_G_Is_within_search_radius);
+      EXPECT_EQ(
+          ground_truth_p_G_Is_within_search_radius,
+          p_G_Is_within_search_radius);
+    }
+  }
+
+  // Removing all data items leaves an empty lookup.
+  nn_query_database.removeDataItems(
+      [](const pose_graph::VertexId& /*vertex_id*/) { return true; });
+  EXPECT_TRUE(nn_query_database.empty());
+  Aligned<std::vector, pose_graph::VertexId> closest_vertex_ids;
+  EXPECT_FALSE(
+      nn_query_database.getClosestDataItems(
+          Aligned<std::vector, aslam::Position3D>(1u), kNumThreads,
+          &closest_vertex_ids));
+}
+
 TEST(VIMapNearestNeighborLookupTest, MultipleGPSWGSMeasurementsNNLookup) {
   vi_map::VIMap map;
   vi_map::VIMapGenerator generator(map, kSeed);
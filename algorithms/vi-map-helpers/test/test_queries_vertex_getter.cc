@@ -131,6 +131,64 @@ TEST_F(ViMapQueriesTest, VIMapGetCoobservingVertices) {
     EXPECT_TRUE(is_coobserving);
   }
 }
+
+TEST_F(ViMapQueriesTest, AdjacencyTraversalsMatchMapTraversals) {
+  generateMap();
+  VIMapQueries map_query(map_);
+  const pose_graph::PoseGraphAdjacency::ConstPtr adjacency =
+      map_.getPoseGraphAdjacency();
+  ASSERT_TRUE(adjacency != nullptr);
+
+  vi_map::MissionIdList mission_ids;
+  map_.getAllMissionIds(&mission_ids);
+  vi_map::MissionVertexIdList mission_to_vertex_ids;
+  map_query.getVertexIdsAlongGraphForMissions(
+      mission_ids, &mission_to_vertex_ids);
+  vi_map::MissionVertexIdList adjacency_mission_to_vertex_ids;
+  map_query.getVertexIdsAlongGraphForMissions(
+      mission_ids, *adjacency, &adjacency_mission_to_vertex_ids);
+  EXPECT_EQ(mission_to_vertex_ids, adjacency_mission_to_vertex_ids);
+
+  ASSERT_EQ(1u, mission_ids.size());
+  const pose_graph::VertexIdList& vertex_ids_along_graph =
+      mission_to_vertex_ids[mission_ids.front()];
+  ASSERT_EQ(kNumVertices, vertex_ids_along_graph.size());
+  const pose_graph::VertexId& middle_vertex_id = vertex_ids_along_graph[2];
+  for (const bool include_starting_vertex : {true, false}) {
+    pose_graph::VertexIdList following_vertex_ids;
+    map_query.getFollowingVertexIdsAlongGraph(
+        middle_vertex_id, include_starting_vertex, &following_vertex_ids);
+    pose_graph::VertexIdList adjacency_following_vertex_ids;
+    map_query.getFollowingVertexIdsAlongGraph(
+        middle_vertex_id, include_starting_vertex, *adjacency,
+        &adjacency_following_vertex_ids);
+    EXPECT_EQ(following_vertex_ids, adjacency_following_vertex_ids);
+  }
+
+  const pose_graph::VertexIdSet inner_vertices = {middle_vertex_id};
+  pose_graph::VertexIdList boundary_vertices;
+  map_query.getBoundaryVertexIds(inner_vertices, &boundary_vertices);
+  pose_graph::VertexIdList adjacency_boundary_vertices;
+  map_query.getBoundaryVertexIds(
+      inner_vertices, *adjacency, &adjacency_boundary_vertices);
+  EXPECT_EQ(
+      pose_graph::VertexIdSet(
+          boundary_vertices.begin(), boundary_vertices.end()),
+      pose_graph::VertexIdSet(
+          adjacency_boundary_vertices.begin(),
+          adjacency_boundary_vertices.end()));
+  EXPECT_EQ(2u, adjacency_boundary_vertices.size());
+
+  pose_graph::VertexIdList vertex_ids_within_hops;
+  constexpr size_t kMaxHops = 2u;
+  map_query.getVertexIdsWithinHopsAlongGraph(
+      middle_vertex_id, kMaxHops, *adjacency, &vertex_ids_within_hops);
+  EXPECT_EQ(
+      pose_graph::VertexIdSet(
+          vertex_ids_along_graph.begin(), vertex_ids_along_graph.end()),
+      pose_graph::VertexIdSet(
+          vertex_ids_within_hops.begin(), vertex_ids_within_hops.end()));
+}
 }  // namespace vi_map_helpers
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -221,6 +221,67 @@ TYPED_TEST(SpatialDatabaseTest, getNoNeighborObject) {
   EXPECT_EQ(0u, neighbor_object_ids.size());
 }
 
+TYPED_TEST(SpatialDatabaseTest, BatchRadiusQueriesMatchSingleQueries) {
+  this->generateMissions();
+  SpatialDatabase<TypeParam> spatial_db(this->map_, this->xyz_resolution_);
+  Eigen::Matrix3Xd p_G_centers(3, 4);
+  p_G_centers << 0, .5, 5, 2, 0, .5, 5, 1, 0, .5, 5, 1;
+  constexpr double kRadius = 0.87;
+
+  typename SpatialDatabase<TypeParam>::BatchQueryResult result;
+  // Run the batch twice to check that the result buffers are reset.
+  for (int run = 0; run < 2; ++run) {
+    spatial_db.getObjectIdsInRadius(p_G_centers, kRadius, &result);
+    ASSERT_EQ(4u, result.numQueries());
+    for (int query_idx = 0; query_idx < p_G_centers.cols(); ++query_idx) {
+      std::unordered_set<TypeParam> expected_object_ids;
+      spatial_db.getObjectIdsInRadius(
+          p_G_centers.col(query_idx), kRadius, &expected_object_ids);
+      const TypeParam* object_ids = result.objectIdsOfQuery(query_idx);
+      const std::unordered_set<TypeParam> object_ids_of_query(
+          object_ids, object_ids + result.numObjectIdsOfQuery(query_idx));
+      EXPECT_EQ(
+          expected_object_ids.size(), result.numObjectIdsOfQuery(query_idx));
+      EXPECT_EQ(expected_object_ids, object_ids_of_query);
+    }
+  }
+  EXPECT_EQ(3u, result.numObjectIdsOfQuery(0u));
+  EXPECT_EQ(0u, result.numObjectIdsOfQuery(2u));
+}
+
+TYPED_TEST(SpatialDatabaseTest, BatchCuboidQueriesMatchSingleQueries) {
+  this->generateMissions();
+  SpatialDatabase<TypeParam> spatial_db(this->map_, this->xyz_resolution_);
+  Eigen::Matrix3Xd p_G_mins(3, 3), p_G_maxs(3, 3);
+  p_G_mins << -1, 0.5, 4, -1, 0.5, 4, -1, 0.5, 4;
+  p_G_maxs << 1.1, 2.5, 5, 1.1, 1.5, 5, 1.1, 1.5, 5;
+
+  typename SpatialDatabase<TypeParam>::BatchQueryResult result;
+  spatial_db.getObjectIdsInCuboid(p_G_mins, p_G_maxs, &result);
+  ASSERT_EQ(3u, result.numQueries());
+  for (int query_idx = 0; query_idx < p_G_mins.cols(); ++query_idx) {
+    std::vector<TypeParam> expected_object_ids;
+    spatial_db.getObjectIdsInCuboid(
+        p_G_mins.col(query_idx), p_G_maxs.col(query_idx),
+        &expected_object_ids);
+    const TypeParam* object_ids = result.objectIdsOfQuery(query_idx);
+    EXPECT_EQ(
+        expected_object_ids,
+        std::vector<TypeParam>(
+            object_ids, object_ids + result.numObjectIdsOfQuery(query_idx)));
+  }
+  EXPECT_EQ(11u, result.numObjectIdsOfQuery(0u));
+  EXPECT_EQ(0u, result.numObjectIdsOfQuery(2u));
+}
+
+TYPED_TEST(SpatialDatabaseTest, CellsOutsideOfGridAreEmpty) {
+  this->generateMissions();
+  SpatialDatabase<TypeParam> spatial_db(this->map_, this->xyz_resolution_);
+  EXPECT_FALSE(spatial_db.isCellEmpty(Eigen::Vector3i(1, 1, 1)));
+  EXPECT_TRUE(spatial_db.isCellEmpty(Eigen::Vector3i(-1, 1, 1)));
+  EXPECT_TRUE(spatial_db.isCellEmpty(Eigen::Vector3i(1, 5, 1)));
+}
+
 TYPED_TEST(SpatialDatabaseTest, EmptyMapSpatialDatabase) {
   this->xyz_resolution_ << 3, 3, 3;
   this->generator_.generateMap();
@@ -0,0 +1,117 @@
+#include <unordered_map>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <vi-map/test/vi-map-generator.h>
+#include <vi-map/vi-map.h>
+
+#include "vi-map-helpers/covisibility-graph.h"
+#include "vi-map-helpers/vi-map-partitioner.h"
+
+namespace vi_map_helpers {
+
+class VIMapPartitionerTest : public ::testing::Test {
+ protected:
+  static constexpr size_t kRandomSeed = 42u;
+  static constexpr size_t kNumVerticesPerCluster = 8u;
+  static constexpr size_t kNumLandmarksPerVertex = 3u;
+  static constexpr size_t kNumLandmarksBetweenClusters = 5u;
+
+  VIMapPartitionerTest() : map_(), generator_(map_, kRandomSeed) {}
+
+  // Creates two clusters of vertices that observe many common landmarks
+  // within the cluster, connected by a few landmarks observed by the last
+  // vertex of the first and the first vertex of the second cluster.
+  virtual void SetUp() {
+    pose::Transformation T_G_M;
+    const vi_map::MissionId mission_id = generator_.createMission(T_G_M);
+    clusters_.resize(2u);
+    for (size_t i = 0u; i < 2u * kNumVerticesPerCluster; ++i) {
+      pose::Transformation T_G_I;
+      T_G_I.getPosition() << static_cast<double>(i), 0.0, 0.0;
+      clusters_[i / kNumVerticesPerCluster].push_back(
+          generator_.createVertex(mission_id, T_G_I));
+    }
+
+    size_t landmark_idx = 0u;
+    for (const pose_graph::VertexIdList& cluster : clusters_) {
+      for (const pose_graph::VertexId& storing_vertex_id : cluster) {
+        pose_graph::VertexIdList observer_ids;
+        for (const pose_graph::VertexId& vertex_id : cluster) {
+          if (vertex_id != storing_vertex_id) {
+            observer_ids.push_back(vertex_id);
+          }
+        }
+        for (size_t i = 0u; i < kNumLandmarksPerVertex; ++i) {
+          createLandmark(storing_vertex_id, observer_ids, &landmark_idx);
+        }
+      }
+    }
+    for (size_t i = 0u; i < kNumLandmarksBetweenClusters; ++i) {
+      createLandmark(
+          clusters_[0].back(), {clusters_[1].front()}, &landmark_idx);
+    }
+    generator_.generateMap();
+  }
+
+  void createLandmark(
+      const pose_graph::VertexId& storing_vertex_id,
+      const pose_graph::VertexIdList& observer_ids, size_t* landmark_idx) {
+    CHECK_NOTNULL(landmark_idx);
+    generator_.createLandmark(
+        Eigen::Vector3d(static_cast<double>(*landmark_idx), 0.0, 5.0),
+        storing_vertex_id, observer_ids);
+    ++(*landmark_idx);
+  }
+
+  // Checks that every vertex is in exactly one partition and that the
+  // partitions match the clusters.
+  void expectPartitionsMatchClusters(
+      const std::vector<pose_graph::VertexIdList>& partitioning) const {
+    ASSERT_EQ(clusters_.size(), partitioning.size());
+    std::unordered_map<pose_graph::VertexId, size_t> vertex_partitions;
+    for (size_t partition_idx = 0u; partition_idx < partitioning.size();
+         ++partition_idx) {
+      for (const pose_graph::VertexId& vertex_id :
+           partitioning[partition_idx]) {
+        EXPECT_TRUE(vertex_partitions.emplace(vertex_id, partition_idx).second);
+      }
+    }
+    EXPECT_EQ(map_.numVertices(), vertex_partitions.size());
+
+    for (const pose_graph::VertexIdList& cluster : clusters_) {
+      ASSERT_GT(vertex_partitions.count(cluster.front()), 0u);
+      const size_t cluster_partition_idx = vertex_partitions[cluster.front()];
+      EXPECT_EQ(cluster.size(), partitioning[cluster_partition_idx].size());
+      for (const pose_graph::VertexId& vertex_id : cluster) {
+        ASSERT_GT(vertex_partitions.count(vertex_id), 0u);
+        EXPECT_EQ(cluster_partition_idx, vertex_partitions[vertex_id]);
+      }
+    }
+  }
+
+  vi_map::VIMap map_;
+  vi_map::VIMapGenerator generator_;
+  std::vector<pose_graph::VertexIdList> clusters_;
+};
+
+TEST_F(VIMapPartitionerTest, PartitionsAlongWeakestCoobservations) {
+  VIMapPartitioner partitioner;
+  std::vector<pose_graph::VertexIdList> partitioning;
+  partitioner.partitionMapWithMetis(map_, clusters_.size(), &partitioning);
+  expectPartitionsMatchClusters(partitioning);
+}
+
+TEST_F(VIMapPartitionerTest, PartitionsWithGivenCovisibilityGraph) {
+  const CovisibilityGraph covisibility_graph(map_);
+  VIMapPartitioner partitioner;
+  std::vector<pose_graph::VertexIdList> partitioning;
+  partitioner.partitionMapWithMetis(
+      map_, covisibility_graph, clusters_.size(), &partitioning);
+  expectPartitionsMatchClusters(partitioning);
+}
+
+}  // namespace vi_map_helpers
+
+MAPLAB_UNITTEST_ENTRYPOINT
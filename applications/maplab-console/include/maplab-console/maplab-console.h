@@ -2,6 +2,7 @@
 #define MAPLAB_CONSOLE_MAPLAB_CONSOLE_H_
 
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 #include <console-common/console.h>
@@ -13,6 +14,10 @@ class ViwlsGraphRvizPlotter;
 
 namespace maplab {
 
+struct PluginManifestEntry;
+
+// Plugins are loaded lazily on the first use of one of their commands, see
+// the flag lazy_load_plugins.
 class MapLabConsole : public common::Console {
  public:
   // This takes in argc and argv as gflags initialization is delayed until after
@@ -22,8 +27,15 @@ class MapLabConsole : public common::Console {
 
  private:
   void discoverAndInstallPlugins(int argc, char** argv);
+  void* openPluginLibrary(const std::string& plugin_library_path);
+  // Fills in the manifest entry except for the modification time, if given.
+  bool installPluginFromLibrary(
+      void* handle, const std::string& plugin_library_path,
+      PluginManifestEntry* manifest_entry);
+  visualization::ViwlsGraphRvizPlotter* getPlotter();
 
   std::vector<void*> plugin_handles_;
+  std::unordered_set<std::string> installed_plugin_libraries_;
   visualization::ViwlsGraphRvizPlotter::UniquePtr plotter_;
 };
 
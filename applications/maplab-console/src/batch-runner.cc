@@ -1,11 +1,24 @@
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include <console-common/console.h>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
-#include <map-manager/map-manager.h>
-#include <vi-map/vi-map.h>
-#include <visualization/viwls-graph-plotter.h>
+#include <maplab-common/file-system-tools.h>
 #include <yaml-cpp/yaml.h>
 
 #include "maplab-console/maplab-console.h"
@@ -25,6 +38,12 @@
 //     - command1
 //     - command2
 //     - command3
+//
+// Every map is processed in its own process, such that a crashing map doesn't
+// stop the batch and maps can be processed concurrently. The concurrently
+// processed maps share the thread and memory budget given by the flags
+// below. A summary of the status and duration of every map is printed at the
+// end.
 
 const std::string kMapFolderTemplate("<CURRENT_VIMAP_FOLDER>");
 const std::string kConsoleName = "maplab-batch-runner";
@@ -56,6 +75,24 @@ DEFINE_string(
     batch_control_file, "",
     "Filename of the yaml file that "
     "contains the batch processing information.");
+DEFINE_uint64(
+    batch_runner_num_parallel_maps, 1u,
+    "Number of maps that are processed concurrently.");
+DEFINE_uint64(
+    batch_runner_num_threads, 0u,
+    "Number of threads shared by the concurrently processed maps. (0: number "
+    "of hardware threads)");
+DEFINE_double(
+    batch_runner_memory_budget_gb, 0.0,
+    "Address space in GB shared by the concurrently processed maps. A map "
+    "exceeding its share fails. (0: unlimited)");
+DEFINE_string(
+    batch_runner_log_folder, "",
+    "If set, the output of every map is written to a log file in this folder "
+    "instead of the terminal.");
+
+DECLARE_uint64(num_hardware_threads);
+DECLARE_bool(ros_free);
 
 bool replaceSubstring(
     const std::string& from, const std::string& to, std::string* full_string) {
@@ -68,6 +105,133 @@ bool replaceSubstring(
   return true;
 }
 
+struct MapProcessingResult {
+  MapProcessingResult() : exit_status(-1), duration_s(0.0) {}
+  // As returned by waitpid.
+  int exit_status;
+  double duration_s;
+  std::chrono::steady_clock::time_point start_time;
+};
+
+// Runs all commands on the map and returns the exit code of the map process.
+int runCommandsOnMap(
+    const BatchControlInformation& control_information,
+    const std::string& map_folder, int argc, char** argv) {
+  maplab::MapLabConsole console(kConsoleName, argc, argv);
+
+  const size_t num_cmds = control_information.commands.size();
+  size_t num_failed_cmds = 0u;
+  size_t cmd_idx = 1u;
+  for (const std::string& command : control_information.commands) {
+    // Replace the map_folder template string for the current command.
+    std::string actual_command = command;
+    replaceSubstring(kMapFolderTemplate, map_folder, &actual_command);
+
+    LOG(INFO) << "\t Running command (" << cmd_idx << " / " << num_cmds
+              << "): " << actual_command;
+
+    // Run the command.
+    if (console.RunCommand(actual_command) != common::kSuccess) {
+      LOG(ERROR) << "\t Command failed!";
+      ++num_failed_cmds;
+    } else {
+      LOG(INFO) << "\t Command successful.";
+    }
+    ++cmd_idx;
+  }
+  LOG(INFO) << "Done running map.";
+  return num_failed_cmds == 0u ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+std::string getLogFilePath(
+    const size_t map_idx, const std::string& map_folder) {
+  std::string simplified_map_folder = map_folder;
+  common::simplifyPath(&simplified_map_folder);
+  std::string path, map_name;
+  common::splitPathAndFilename(simplified_map_folder, &path, &map_name);
+  std::stringstream log_file_name;
+  log_file_name << map_idx << "_" << map_name << ".log";
+  return common::concatenateFolderAndFileName(
+      FLAGS_batch_runner_log_folder, log_file_name.str());
+}
+
+// Forks a process that processes the map with the given share of the thread
+// and memory budget.
+pid_t startMapProcess(
+    const BatchControlInformation& control_information, const size_t map_idx,
+    const size_t num_threads_per_map, const rlim_t memory_per_map_bytes,
+    int argc, char** argv) {
+  CHECK_LT(map_idx, control_information.vi_map_folder_paths.size());
+  const std::string& map_folder =
+      control_information.vi_map_folder_paths[map_idx];
+
+  std::cout.flush();
+  std::fflush(nullptr);
+  const pid_t pid = fork();
+  CHECK_GE(pid, 0) << "Failed to fork the process for map " << map_folder;
+  if (pid > 0) {
+    return pid;
+  }
+
+  if (!FLAGS_batch_runner_log_folder.empty()) {
+    const std::string log_file_path = getLogFilePath(map_idx, map_folder);
+    if (std::freopen(log_file_path.c_str(), "w", stdout) == nullptr ||
+        dup2(fileno(stdout), fileno(stderr)) < 0) {
+      LOG(ERROR) << "Failed to redirect the output to " << log_file_path;
+      _exit(EXIT_FAILURE);
+    }
+  }
+  if (memory_per_map_bytes > 0u) {
+    struct rlimit address_space_limit;
+    address_space_limit.rlim_cur = memory_per_map_bytes;
+    address_space_limit.rlim_max = memory_per_map_bytes;
+    CHECK_EQ(setrlimit(RLIMIT_AS, &address_space_limit), 0);
+  }
+  FLAGS_num_hardware_threads = num_threads_per_map;
+
+  LOG(INFO) << "Running map (" << map_idx + 1u << " / "
+            << control_information.vi_map_folder_paths.size()
+            << "): " << map_folder;
+  const int exit_code =
+      runCommandsOnMap(control_information, map_folder, argc, argv);
+  std::cout.flush();
+  std::fflush(nullptr);
+  _exit(exit_code);
+}
+
+void printSummary(
+    const BatchControlInformation& control_information,
+    const std::vector<MapProcessingResult>& results,
+    const double total_duration_s) {
+  CHECK_EQ(control_information.vi_map_folder_paths.size(), results.size());
+  std::stringstream summary;
+  summary << "Batch summary:\n";
+  size_t num_failed_maps = 0u;
+  for (size_t map_idx = 0u; map_idx < results.size(); ++map_idx) {
+    const MapProcessingResult& result = results[map_idx];
+    std::string status = "success";
+    if (WIFSIGNALED(result.exit_status)) {
+      status =
+          "crashed with signal " + std::to_string(WTERMSIG(result.exit_status));
+    } else if (
+        !WIFEXITED(result.exit_status) ||
+        WEXITSTATUS(result.exit_status) != EXIT_SUCCESS) {
+      status = "failed commands";
+    }
+    if (status != "success") {
+      ++num_failed_maps;
+    }
+    summary << "  [" << map_idx + 1u << "] " << std::setw(9) << std::fixed
+            << std::setprecision(1) << result.duration_s << " s  " << status
+            << "  " << control_information.vi_map_folder_paths[map_idx]
+            << "\n";
+  }
+  summary << "Processed " << results.size() << " maps in " << std::fixed
+          << std::setprecision(1) << total_duration_s << " s, "
+          << num_failed_maps << " of them failed.";
+  LOG(INFO) << summary.str();
+}
+
 int main(int argc, char** argv) {
   google::InitGoogleLogging(argv[0]);
   google::ParseCommandLineFlags(&argc, &argv, true);
@@ -77,9 +241,8 @@ int main(int argc, char** argv) {
 
   CHECK_NE(FLAGS_batch_control_file, "")
       << "You have to provide the path to the batch control yaml-file.";
-
-  visualization::ViwlsGraphRvizPlotter::Ptr plotter(
-      new visualization::ViwlsGraphRvizPlotter());
+  CHECK_GT(FLAGS_batch_runner_num_parallel_maps, 0u);
+  CHECK_GE(FLAGS_batch_runner_memory_budget_gb, 0.0);
 
   BatchControlInformation control_information;
   if (!YAML::Load(FLAGS_batch_control_file, &control_information)) {
@@ -93,52 +256,77 @@ int main(int argc, char** argv) {
                                << FLAGS_batch_control_file;
   LOG_IF(FATAL, num_cmds == 0u) << "No commands supplied with file: "
                                << FLAGS_batch_control_file;
+  if (!FLAGS_batch_runner_log_folder.empty()) {
+    CHECK(common::createPath(FLAGS_batch_runner_log_folder))
+        << "Failed to create the log folder "
+        << FLAGS_batch_runner_log_folder;
+  }
+
+  // Split the budgets evenly between the concurrently processed maps.
+  // common::getNumHardwareThreads() caches its result, so it must only be
+  // called by the map processes after their share is set.
+  const size_t num_parallel_maps =
+      std::min<size_t>(FLAGS_batch_runner_num_parallel_maps, num_maps);
+  const size_t num_threads =
+      FLAGS_batch_runner_num_threads > 0u
+          ? FLAGS_batch_runner_num_threads
+          : std::max<size_t>(1u, std::thread::hardware_concurrency());
+  const size_t num_threads_per_map =
+      std::max<size_t>(1u, num_threads / num_parallel_maps);
+  constexpr double kNumBytesPerGigabyte = 1024.0 * 1024.0 * 1024.0;
+  const rlim_t memory_per_map_bytes = static_cast<rlim_t>(
+      FLAGS_batch_runner_memory_budget_gb * kNumBytesPerGigabyte /
+      num_parallel_maps);
+  if (num_parallel_maps > 1u && !FLAGS_ros_free) {
+    // The concurrently processed maps would all start the same ROS node.
+    LOG(WARNING) << "Disabling the visualization to process maps concurrently.";
+    FLAGS_ros_free = true;
+  }
 
   LOG(INFO) << "Got " << num_cmds << " commands to apply on " << num_maps
-            << " maps.";
+            << " maps, processing " << num_parallel_maps
+            << " maps concurrently with " << num_threads_per_map
+            << " threads each.";
 
   // Process all commands for all maps.
-  maplab::MapLabConsole console(kConsoleName, argc, argv);
-
-  size_t map_idx = 1u;
-  for (const std::string& map_folder :
-       control_information.vi_map_folder_paths) {
-    LOG(INFO) << "Running map (" << map_idx << " / " << num_maps
-              << "): " << map_folder;
-
-    // Release all maps from memory.
-    vi_map::VIMapManager map_manager;
-    std::unordered_set<std::string> all_map_keys;
-    map_manager.getAllMapKeys(&all_map_keys);
-    for (const std::string& key : all_map_keys) {
-      map_manager.deleteMap(key);
-    }
-    const std::string kNoMapSelected = "";
-    console.setSelectedMapKey(kNoMapSelected);
-
-    // Run all commands on this map.
-    size_t cmd_idx = 1u;
-    for (const std::string& command : control_information.commands) {
-      // Replace the map_folder template string for the current command.
-      std::string actual_command = command;
-      replaceSubstring(kMapFolderTemplate, map_folder, &actual_command);
-
-      LOG(INFO) << "\t Running command (" << cmd_idx << " / " << num_cmds
-                << "): " << actual_command;
-
-      // Run the command.
-      if (console.RunCommand(actual_command) != common::kSuccess) {
-        LOG(ERROR) << "\t Command failed!";
-      } else {
-        LOG(INFO) << "\t Command successful.";
-      }
-      ++cmd_idx;
+  const std::chrono::steady_clock::time_point batch_start_time =
+      std::chrono::steady_clock::now();
+  std::vector<MapProcessingResult> results(num_maps);
+  std::unordered_map<pid_t, size_t> running_map_indices;
+  size_t next_map_idx = 0u;
+  while (next_map_idx < num_maps || !running_map_indices.empty()) {
+    while (next_map_idx < num_maps &&
+           running_map_indices.size() < num_parallel_maps) {
+      results[next_map_idx].start_time = std::chrono::steady_clock::now();
+      const pid_t pid = startMapProcess(
+          control_information, next_map_idx, num_threads_per_map,
+          memory_per_map_bytes, argc, argv);
+      running_map_indices.emplace(pid, next_map_idx);
+      ++next_map_idx;
     }
 
-    LOG(INFO) << "Done running map.";
-    ++map_idx;
+    int exit_status = 0;
+    const pid_t pid = waitpid(-1, &exit_status, 0);
+    CHECK_GT(pid, 0) << "Failed to wait for the map processes.";
+    const std::unordered_map<pid_t, size_t>::iterator it =
+        running_map_indices.find(pid);
+    CHECK(it != running_map_indices.end());
+    MapProcessingResult& result = results[it->second];
+    result.exit_status = exit_status;
+    result.duration_s = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() -
+                            result.start_time)
+                            .count();
+    LOG(INFO) << "Finished map (" << it->second + 1u << " / " << num_maps
+              << "): " << control_information.vi_map_folder_paths[it->second];
+    running_map_indices.erase(it);
   }
 
+  const double total_duration_s =
+      std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - batch_start_time)
+          .count();
+  printSummary(control_information, results, total_duration_s);
   LOG(INFO) << "Done. Processed " << num_cmds << " commands for " << num_maps
             << " maps.";
 }
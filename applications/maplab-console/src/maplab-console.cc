@@ -1,17 +1,113 @@
 #include "maplab-console/maplab-console.h"
 
 #include <dlfcn.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 
+#include <cstdint>
 #include <cstdlib>
 #include <fstream>  // NOLINT
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
+#include <utility>
 
 #include <gflags/gflags.h>
 #include <maplab-common/file-system-tools.h>
+#include <maplab-common/yaml-serialization.h>
 #include <visualization/rviz-visualization-sink.h>
+#include <yaml-cpp/yaml.h>
 
 DEFINE_bool(ros_free, false, "Enable this flag to run on systems without ROS");
+DEFINE_bool(
+    lazy_load_plugins, true,
+    "Only load a plugin once one of its commands is used. The commands of the "
+    "plugins are cached in a manifest next to the plugin list. All plugins are "
+    "loaded at startup if the console is started with flags of a plugin.");
+
+namespace maplab {
+
+// The commands of a plugin library, valid as long as the library isn't
+// modified.
+struct PluginManifestEntry {
+  int64_t modification_time_s;
+  std::string plugin_id;
+  common::CommandRegisterer::Commands commands;
+};
+typedef std::unordered_map<std::string, PluginManifestEntry> PluginManifest;
+
+namespace {
+const std::string kPluginManifestSuffix = ".manifest.yaml";  // NOLINT
+
+bool getModificationTime(
+    const std::string& path, int64_t* modification_time_s) {
+  CHECK_NOTNULL(modification_time_s);
+  struct stat status;
+  if (stat(path.c_str(), &status) != 0) {
+    return false;
+  }
+  *modification_time_s = static_cast<int64_t>(status.st_mtime);
+  return true;
+}
+
+// Flags of plugins are only known once the plugins are loaded.
+bool areAllFlagsKnown(int argc, char** argv) {
+  for (int i = 1; i < argc; ++i) {
+    std::string flag = argv[i];
+    if (flag.size() < 2u || flag[0] != '-') {
+      continue;
+    }
+    flag = flag.substr(flag[1] == '-' ? 2u : 1u);
+    flag = flag.substr(0u, flag.find('='));
+    std::string value;
+    if (!google::GetCommandLineOption(flag.c_str(), &value) &&
+        !(flag.compare(0u, 2u, "no") == 0 &&
+          google::GetCommandLineOption(flag.substr(2u).c_str(), &value))) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+}  // namespace maplab
+
+namespace YAML {
+// The callbacks of the commands are set by the console.
+template <>
+struct convert<maplab::PluginManifestEntry> {
+  static Node encode(const maplab::PluginManifestEntry& rhs) {
+    Node node;
+    node["modification_time_s"] = rhs.modification_time_s;
+    node["plugin_id"] = rhs.plugin_id;
+    for (const common::CommandRegisterer::Command& command : rhs.commands) {
+      Node command_node;
+      command_node["commands"] = command.commands;
+      command_node["help_text"] = command.help_text;
+      command_node["async"] =
+          command.processing_model == common::Processing::Async;
+      node["commands"].push_back(command_node);
+    }
+    return node;
+  }
+  static bool decode(const Node& node, maplab::PluginManifestEntry& rhs) {
+    rhs.modification_time_s = node["modification_time_s"].as<int64_t>();
+    rhs.plugin_id = node["plugin_id"].as<std::string>();
+    rhs.commands.clear();
+    for (const Node& command_node : node["commands"]) {
+      rhs.commands.emplace_back(
+          std::initializer_list<std::string>(), std::function<int()>(),
+          command_node["help_text"].as<std::string>(),
+          command_node["async"].as<bool>() ? common::Processing::Async
+                                           : common::Processing::Sync,
+          rhs.plugin_id);
+      rhs.commands.back().commands =
+          command_node["commands"].as<std::vector<std::string> >();
+    }
+    return true;
+  }
+};
+}  // namespace YAML
 
 namespace maplab {
 
@@ -76,57 +172,158 @@ void MapLabConsole::discoverAndInstallPlugins(int argc, char** argv) {
     }
   }
 
-  // Dynamically load found plugins.
+  // The plugins can only be loaded lazily if the command line flags can be
+  // parsed without them.
+  bool are_flags_parsed = false;
+  if (areAllFlagsKnown(argc, argv)) {
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    are_flags_parsed = true;
+  }
+
+  const std::string manifest_file_path =
+      std::string(plugin_list_file_path) + kPluginManifestSuffix;
+  PluginManifest manifest;
+  std::vector<std::string> plugins_to_load;
+  if (are_flags_parsed && FLAGS_lazy_load_plugins) {
+    if (common::fileExists(manifest_file_path) &&
+        !YAML::Load(manifest_file_path, &manifest)) {
+      LOG(WARNING) << "Failed to read the plugin manifest "
+                   << manifest_file_path << ", loading all plugins.";
+      manifest.clear();
+    }
+    for (const std::string& plugin_library_path : discovered_plugins) {
+      const PluginManifest::const_iterator it =
+          manifest.find(plugin_library_path);
+      int64_t modification_time_s;
+      if (it != manifest.end() &&
+          getModificationTime(plugin_library_path, &modification_time_s) &&
+          modification_time_s == it->second.modification_time_s) {
+        addLazyPlugin(
+            it->second.plugin_id, it->second.commands,
+            [this, plugin_library_path]() -> bool {
+              void* handle = openPluginLibrary(plugin_library_path);
+              if (handle == nullptr ||
+                  !installPluginFromLibrary(
+                      handle, plugin_library_path, nullptr)) {
+                return false;
+              }
+              addAllGFlagsToCompletion();
+              return true;
+            });
+      } else {
+        plugins_to_load.push_back(plugin_library_path);
+      }
+    }
+  } else {
+    plugins_to_load.assign(
+        discovered_plugins.begin(), discovered_plugins.end());
+  }
+
+  // Dynamically load the remaining plugins.
   std::vector<std::pair</*plugin_handle=*/void*, /*plugin_file=*/std::string>>
       try_load_plugins_handle_path;
-  for (const std::string& plugin_library_path : discovered_plugins) {
-    void* handle = dlopen(plugin_library_path.c_str(), RTLD_LAZY);
-    if (handle == nullptr) {
-      LOG(ERROR) << "Failed to load library " << plugin_library_path
-                 << ". Error message: " << dlerror();
-      continue;
+  for (const std::string& plugin_library_path : plugins_to_load) {
+    void* handle = openPluginLibrary(plugin_library_path);
+    if (handle != nullptr) {
+      try_load_plugins_handle_path.emplace_back(handle, plugin_library_path);
     }
-    try_load_plugins_handle_path.emplace_back(handle, plugin_library_path);
   }
 
   // Now that all plugins are loaded we can parse the flags and add them to the
   // completion index.
-  google::ParseCommandLineFlags(&argc, &argv, true);
+  if (!are_flags_parsed) {
+    google::ParseCommandLineFlags(&argc, &argv, true);
+  }
   addAllGFlagsToCompletion();
 
-  if (!FLAGS_ros_free) {
-    visualization::RVizVisualizationSink::init();
-    plotter_.reset(new visualization::ViwlsGraphRvizPlotter);
-    LOG(INFO) << "RVIZ visualization initialized!";
+  if (try_load_plugins_handle_path.empty()) {
+    return;
   }
-
   for (const std::pair<void*, std::string>& handle_libpath :
        try_load_plugins_handle_path) {
-    void* handle = handle_libpath.first;
-    common::PluginCreateFunction create_function =
-        common::PluginCreateFunction(dlsym(handle, "createConsolePlugin"));
-    common::PluginDestroyFunction destroy_function =
-        common::PluginDestroyFunction(dlsym(handle, "destroyConsolePlugin"));
-    if (create_function == nullptr || destroy_function == nullptr) {
-      LOG(ERROR) << "Error loading the functions from plugin "
-                 << handle_libpath.second << ". Error message: " << dlerror()
-                 << "\nMake sure that your plugin implements the functions "
-                 << "\"ConsolePluginBase* "
-                 << "createConsolePlugin(common::Console*, "
-                 << "visualization::ViwlsGraphRvizPlotter)\" and \"void "
-                 << "destroyConsolePlugin(common::ConsolePluginBase*)";
-      CHECK_EQ(dlclose(handle), 0);
-      continue;
+    PluginManifestEntry manifest_entry;
+    if (installPluginFromLibrary(
+            handle_libpath.first, handle_libpath.second, &manifest_entry) &&
+        getModificationTime(
+            handle_libpath.second, &manifest_entry.modification_time_s)) {
+      manifest[handle_libpath.second] = manifest_entry;
     }
-    plugin_handles_.emplace_back(handle);
+  }
+
+  // Update the manifest such that the plugins can be loaded lazily next time.
+  for (PluginManifest::iterator it = manifest.begin(); it != manifest.end();) {
+    if (discovered_plugins.count(it->first) == 0u) {
+      it = manifest.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  std::ofstream manifest_stream(manifest_file_path);
+  if (manifest_stream.is_open()) {
+    YAML::Save(manifest, &manifest_stream);
+  } else {
+    LOG(WARNING) << "Failed to write the plugin manifest "
+                 << manifest_file_path << ".";
+  }
+}
+
+void* MapLabConsole::openPluginLibrary(const std::string& plugin_library_path) {
+  void* handle = dlopen(plugin_library_path.c_str(), RTLD_LAZY);
+  if (handle == nullptr) {
+    LOG(ERROR) << "Failed to load library " << plugin_library_path
+               << ". Error message: " << dlerror();
+  }
+  return handle;
+}
+
+bool MapLabConsole::installPluginFromLibrary(
+    void* handle, const std::string& plugin_library_path,
+    PluginManifestEntry* manifest_entry) {
+  CHECK_NOTNULL(handle);
+  if (!installed_plugin_libraries_.emplace(plugin_library_path).second) {
+    LOG(ERROR) << "The plugin " << plugin_library_path
+               << " is already installed.";
+    CHECK_EQ(dlclose(handle), 0);
+    return false;
+  }
+  common::PluginCreateFunction create_function =
+      common::PluginCreateFunction(dlsym(handle, "createConsolePlugin"));
+  common::PluginDestroyFunction destroy_function =
+      common::PluginDestroyFunction(dlsym(handle, "destroyConsolePlugin"));
+  if (create_function == nullptr || destroy_function == nullptr) {
+    LOG(ERROR) << "Error loading the functions from plugin "
+               << plugin_library_path << ". Error message: " << dlerror()
+               << "\nMake sure that your plugin implements the functions "
+               << "\"ConsolePluginBase* "
+               << "createConsolePlugin(common::Console*, "
+               << "visualization::ViwlsGraphRvizPlotter)\" and \"void "
+               << "destroyConsolePlugin(common::ConsolePluginBase*)";
+    CHECK_EQ(dlclose(handle), 0);
+    return false;
+  }
+  plugin_handles_.emplace_back(handle);
 
-    // Create and install plugin.
-    common::ConsolePluginPtr plugin(
-        create_function(this, plotter_.get()), destroy_function);
-    VLOG(1) << "Installed plugin " << plugin->getPluginId() << " from "
-            << handle_libpath.second << ".";
-    installPlugin(std::move(plugin));
+  // Create and install plugin.
+  common::ConsolePluginPtr plugin(
+      create_function(this, getPlotter()), destroy_function);
+  VLOG(1) << "Installed plugin " << plugin->getPluginId() << " from "
+          << plugin_library_path << ".";
+  if (manifest_entry != nullptr) {
+    manifest_entry->plugin_id = plugin->getPluginId();
+    manifest_entry->commands = getCommandsOfPlugin(*plugin);
+  }
+  installPlugin(std::move(plugin));
+  return true;
+}
+
+visualization::ViwlsGraphRvizPlotter* MapLabConsole::getPlotter() {
+  // The visualization is only set up once the first plugin is loaded.
+  if (!FLAGS_ros_free && plotter_ == nullptr) {
+    visualization::RVizVisualizationSink::init();
+    plotter_.reset(new visualization::ViwlsGraphRvizPlotter);
+    LOG(INFO) << "RVIZ visualization initialized!";
   }
+  return plotter_.get();
 }
 
 }  // namespace maplab
@@ -4,9 +4,12 @@
 #include <glog/logging.h>
 #include <localization-summary-map/localization-summary-map-creation.h>
 #include <localization-summary-map/localization-summary-map.h>
+#include <localization-summary-map/tiled-localization-summary-map.h>
 #include <maplab-common/sigint-breaker.h>
 #include <maplab-common/threading-helpers.h>
 #include <message-flow/message-dispatcher-fifo.h>
+#include <message-flow/message-dispatcher-priority.h>
+#include <message-flow/message-flow-recorder.h>
 #include <message-flow/message-flow.h>
 #include <ros/ros.h>
 #include <sensors/imu.h>
@@ -14,6 +17,8 @@
 #include <signal.h>
 #include <vi-map/vi-map-serialization.h>
 
+#include "rovioli/flow-topic-serialization.h"
+#include "rovioli/flow-topics.h"
 #include "rovioli/rovioli-node.h"
 
 DEFINE_string(
@@ -42,6 +47,18 @@ DEFINE_bool(
     optimize_map_to_localization_map, false,
     "Optimize and process the map into a localization map before "
     "saving it.");
+DEFINE_string(
+    message_flow_latency_export_file, "",
+    "If set, the message delivery latency histograms of all subscribers are "
+    "written to this CSV file on shutdown.");
+DEFINE_string(
+    rovioli_record_message_log, "",
+    "If set, the raw IMU and image measurements are recorded to this message "
+    "log, which can be replayed with rovioli_replay.");
+DEFINE_bool(
+    message_flow_prioritize_sensor_data, false,
+    "Deliver IMU and image measurements ahead of the other topics instead of "
+    "delivering all topics in publishing order.");
 
 DECLARE_bool(map_builder_save_image_as_resources);
 
@@ -57,7 +74,18 @@ int main(int argc, char** argv) {
 
   // Optionally load localization map.
   std::unique_ptr<summary_map::LocalizationSummaryMap> localization_map;
-  if (!FLAGS_vio_localization_map_folder.empty()) {
+  std::unique_ptr<summary_map::TiledLocalizationSummaryMap>
+      tiled_localization_map;
+  if (!FLAGS_vio_localization_map_folder.empty() &&
+      summary_map::TiledLocalizationSummaryMap::hasTilesOnFileSystem(
+          FLAGS_vio_localization_map_folder)) {
+    tiled_localization_map.reset(new summary_map::TiledLocalizationSummaryMap);
+    CHECK(
+        tiled_localization_map->loadFromFolder(
+            FLAGS_vio_localization_map_folder))
+        << "Could not load a tiled localization summary map from "
+        << FLAGS_vio_localization_map_folder << ".";
+  } else if (!FLAGS_vio_localization_map_folder.empty()) {
     localization_map.reset(new summary_map::LocalizationSummaryMap);
     if (!localization_map->loadFromFolder(FLAGS_vio_localization_map_folder)) {
       LOG(WARNING) << "Could not load a localization summary map from "
@@ -99,9 +127,31 @@ int main(int argc, char** argv) {
 
   // Construct the application.
   ros::AsyncSpinner ros_spinner(common::getNumHardwareThreads());
-  std::unique_ptr<message_flow::MessageFlow> flow(
-      message_flow::MessageFlow::create<message_flow::MessageDispatcherFifo>(
-          common::getNumHardwareThreads()));
+  std::unique_ptr<message_flow::MessageFlow> flow;
+  if (FLAGS_message_flow_prioritize_sensor_data) {
+    // The sensor subscribers of ROVIO share an exclusivity group, so they must
+    // not be moved to dedicated threads.
+    message_flow::MessageDispatcherPriority::Options dispatcher_options(
+        common::getNumThreadsForSubsystem(
+            common::ThreadingSubsystem::kMessageFlow));
+    dispatcher_options
+        .topic_options[message_flow_topics::IMU_MEASUREMENTS::kMessageTopic]
+        .priority = 2;
+    dispatcher_options
+        .topic_options[message_flow_topics::IMAGE_MEASUREMENTS::kMessageTopic]
+        .priority = 1;
+    dispatcher_options
+        .topic_options[message_flow_topics::RAW_VIMAP::kMessageTopic]
+        .priority = -1;
+    flow.reset(
+        message_flow::MessageFlow::create<
+            message_flow::MessageDispatcherPriority>(dispatcher_options));
+  } else {
+    flow.reset(
+        message_flow::MessageFlow::create<message_flow::MessageDispatcherFifo>(
+            common::getNumThreadsForSubsystem(
+                common::ThreadingSubsystem::kMessageFlow)));
+  }
 
   if (FLAGS_map_builder_save_image_as_resources &&
       FLAGS_save_map_folder.empty()) {
@@ -121,9 +171,20 @@ int main(int argc, char** argv) {
     }
   }
 
+  std::unique_ptr<message_flow::MessageFlowRecorder> recorder;
+  if (!FLAGS_rovioli_record_message_log.empty()) {
+    recorder.reset(
+        new message_flow::MessageFlowRecorder(
+            FLAGS_rovioli_record_message_log,
+            kExclusivityGroupIdMessageFlowRecorder));
+    recorder->recordTopic<message_flow_topics::IMU_MEASUREMENTS>(flow.get());
+    recorder->recordTopic<message_flow_topics::IMAGE_MEASUREMENTS>(flow.get());
+  }
+
   rovioli::RovioliNode rovio_localization_node(
       camera_system, std::move(maplab_imu_sensor), rovio_imu_sigmas,
-      save_map_folder, localization_map.get(), flow.get());
+      save_map_folder, localization_map.get(), tiled_localization_map.get(),
+      flow.get());
 
   // Start the pipeline. The ROS spinner will handle SIGINT for us and abort
   // the application on CTRL+C.
@@ -141,6 +202,11 @@ int main(int argc, char** argv) {
   flow->shutdown();
   flow->waitUntilIdle();
 
+  LOG(INFO) << "\n" << flow->printDeliveryQueueLatencyStatistics();
+  if (!FLAGS_message_flow_latency_export_file.empty()) {
+    flow->exportDeliveryQueueLatencies(FLAGS_message_flow_latency_export_file);
+  }
+
   if (!save_map_folder.empty()) {
     rovio_localization_node.saveMapAndOptionallyOptimize(
         save_map_folder, FLAGS_overwrite_existing_map,
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include <aslam/cameras/ncamera.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <localization-summary-map/localization-summary-map.h>
+#include <localization-summary-map/tiled-localization-summary-map.h>
+#include <maplab-common/threading-helpers.h>
+#include <message-flow/message-dispatcher-fifo.h>
+#include <message-flow/message-flow-recorder.h>
+#include <message-flow/message-flow.h>
+#include <sensors/imu.h>
+#include <sensors/sensor-factory.h>
+
+#include "rovioli/feature-tracking-flow.h"
+#include "rovioli/flow-topic-serialization.h"
+#include "rovioli/flow-topics.h"
+#include "rovioli/imu-camera-synchronizer-flow.h"
+#include "rovioli/localizer-flow.h"
+#include "rovioli/map-builder-flow.h"
+#include "rovioli/rovio-flow.h"
+#include "rovioli/synced-nframe-throttler-flow.h"
+
+// Replays a message log recorded with rovioli --rovioli_record_message_log
+// into a selectable subset of the ROVIOLI flows, without ROS in the loop, and
+// reports the throughput and the delivery latencies of every stage.
+
+DEFINE_string(message_log, "", "Path to the message log to replay.");
+DEFINE_double(
+    message_log_playback_rate, 0.0,
+    "Playback rate of the message log. Real-time corresponds to 1.0, 0.0 "
+    "replays the log as fast as possible.");
+DEFINE_string(
+    ncamera_calibration, "ncamera.yaml",
+    "Path to the camera calibration yaml.");
+DEFINE_string(
+    imu_parameters_rovio, "imu-rovio.yaml",
+    "Path to the imu configuration yaml for ROVIO.");
+DEFINE_string(
+    imu_parameters_maplab, "imu-maplab.yaml",
+    "Path to the imu configuration yaml for MAPLAB.");
+DEFINE_string(
+    vio_localization_map_folder, "",
+    "Path to a localization summary map. If set, the localizer is run.");
+DEFINE_bool(
+    replay_run_rovio, false,
+    "Run ROVIO on the replayed data. Always enabled for the map builder.");
+DEFINE_bool(
+    replay_run_map_builder, false,
+    "Run the map builder on the replayed data.");
+DEFINE_string(
+    replay_save_map_folder, "",
+    "Save the map built during the replay to this folder; if empty nothing is "
+    "saved.");
+DEFINE_string(
+    replay_latency_export_file, "",
+    "If set, the message delivery latency histograms are written to this CSV "
+    "file.");
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InstallFailureSignalHandler();
+  FLAGS_alsologtostderr = true;
+  FLAGS_colorlogtostderr = true;
+
+  CHECK(!FLAGS_message_log.empty()) << "No message log given.";
+
+  aslam::NCamera::Ptr camera_system =
+      aslam::NCamera::loadFromYaml(FLAGS_ncamera_calibration);
+  CHECK(camera_system) << "Could not load the camera calibration from: \'"
+                       << FLAGS_ncamera_calibration << "\'";
+  vi_map::Imu::UniquePtr maplab_imu_sensor =
+      vi_map::createFromYaml<vi_map::Imu>(FLAGS_imu_parameters_maplab);
+  CHECK(maplab_imu_sensor)
+      << "Could not load IMU parameters for MAPLAB from: \'"
+      << FLAGS_imu_parameters_maplab << "\'";
+
+  std::unique_ptr<summary_map::LocalizationSummaryMap> localization_map;
+  std::unique_ptr<summary_map::TiledLocalizationSummaryMap>
+      tiled_localization_map;
+  if (!FLAGS_vio_localization_map_folder.empty() &&
+      summary_map::TiledLocalizationSummaryMap::hasTilesOnFileSystem(
+          FLAGS_vio_localization_map_folder)) {
+    tiled_localization_map.reset(new summary_map::TiledLocalizationSummaryMap);
+    CHECK(
+        tiled_localization_map->loadFromFolder(
+            FLAGS_vio_localization_map_folder))
+        << "Could not load a tiled localization summary map from "
+        << FLAGS_vio_localization_map_folder << ".";
+  } else if (!FLAGS_vio_localization_map_folder.empty()) {
+    localization_map.reset(new summary_map::LocalizationSummaryMap);
+    CHECK(localization_map->loadFromFolder(FLAGS_vio_localization_map_folder))
+        << "Could not load a localization summary map from "
+        << FLAGS_vio_localization_map_folder << ".";
+  }
+
+  std::unique_ptr<message_flow::MessageFlow> flow(
+      message_flow::MessageFlow::create<message_flow::MessageDispatcherFifo>(
+          common::getNumThreadsForSubsystem(
+              common::ThreadingSubsystem::kMessageFlow)));
+
+  // The feature tracking always runs, as all other maplab stages depend on it.
+  rovioli::ImuCameraSynchronizerFlow synchronizer_flow(camera_system);
+  synchronizer_flow.attachToMessageFlow(flow.get());
+  rovioli::FeatureTrackingFlow tracker_flow(camera_system, *maplab_imu_sensor);
+  tracker_flow.attachToMessageFlow(flow.get());
+
+  std::unique_ptr<rovioli::SyncedNFrameThrottlerFlow> throttler_flow;
+  std::unique_ptr<rovioli::LocalizerFlow> localizer_flow;
+  if (localization_map || tiled_localization_map) {
+    throttler_flow.reset(new rovioli::SyncedNFrameThrottlerFlow);
+    throttler_flow->attachToMessageFlow(flow.get());
+    constexpr bool kVisualizeLocalization = false;
+    if (tiled_localization_map) {
+      localizer_flow.reset(
+          new rovioli::LocalizerFlow(
+              *tiled_localization_map, kVisualizeLocalization));
+    } else {
+      localizer_flow.reset(
+          new rovioli::LocalizerFlow(
+              *localization_map, kVisualizeLocalization));
+    }
+    localizer_flow->attachToMessageFlow(flow.get());
+  }
+
+  std::unique_ptr<rovioli::RovioFlow> rovio_flow;
+  if (FLAGS_replay_run_rovio || FLAGS_replay_run_map_builder) {
+    vi_map::ImuSigmas rovio_imu_sigmas;
+    CHECK(rovio_imu_sigmas.loadFromYaml(FLAGS_imu_parameters_rovio))
+        << "Could not load IMU parameters for ROVIO from: \'"
+        << FLAGS_imu_parameters_rovio << "\'";
+    rovio_flow.reset(new rovioli::RovioFlow(*camera_system, rovio_imu_sigmas));
+    rovio_flow->attachToMessageFlow(flow.get());
+  }
+
+  std::unique_ptr<rovioli::MapBuilderFlow> map_builder_flow;
+  if (FLAGS_replay_run_map_builder) {
+    map_builder_flow.reset(
+        new rovioli::MapBuilderFlow(
+            camera_system, std::move(maplab_imu_sensor),
+            FLAGS_replay_save_map_folder));
+    map_builder_flow->attachToMessageFlow(flow.get());
+  }
+
+  message_flow::MessageFlowPlayer player(FLAGS_message_log);
+  player.replayTopic<message_flow_topics::IMU_MEASUREMENTS>(flow.get());
+  player.replayTopic<message_flow_topics::IMAGE_MEASUREMENTS>(flow.get());
+
+  const std::chrono::steady_clock::time_point start_time =
+      std::chrono::steady_clock::now();
+  const size_t num_messages = player.play(FLAGS_message_log_playback_rate);
+  flow->waitUntilIdle();
+  const double duration_s =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                    start_time)
+          .count();
+
+  LOG(INFO) << "Replayed " << num_messages << " messages in " << duration_s
+            << " s (" << num_messages / std::max(duration_s, 1e-9)
+            << " messages/s).";
+  LOG(INFO) << "\n" << flow->printDeliveryQueueLatencyStatistics();
+  if (!FLAGS_replay_latency_export_file.empty()) {
+    flow->exportDeliveryQueueLatencies(FLAGS_replay_latency_export_file);
+  }
+
+  flow->shutdown();
+  flow->waitUntilIdle();
+
+  if (map_builder_flow && !FLAGS_replay_save_map_folder.empty()) {
+    constexpr bool kOverwriteExistingMap = true;
+    constexpr bool kProcessToLocalizationMap = false;
+    map_builder_flow->saveMapAndOptionallyOptimize(
+        FLAGS_replay_save_map_folder, kOverwriteExistingMap,
+        kProcessToLocalizationMap);
+  }
+  return 0;
+}
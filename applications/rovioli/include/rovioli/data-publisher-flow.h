@@ -1,8 +1,11 @@
 #ifndef ROVIOLI_DATA_PUBLISHER_FLOW_H_
 #define ROVIOLI_DATA_PUBLISHER_FLOW_H_
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 
 #include <maplab-common/conversions.h>
 #include <maplab-common/timeout-counter.h>
@@ -20,6 +23,7 @@
 #pragma GCC diagnostic pop
 
 #include "rovioli/flow-topics.h"
+#include "rovioli/processing-latency-statistics.h"
 
 namespace rovioli {
 
@@ -35,12 +39,16 @@ class DataPublisherFlow {
   const std::string kTopicBiasGyro = kGeneralTopicPrefix + "bias_gyro";
 
   DataPublisherFlow();
+  ~DataPublisherFlow();
 
   void attachToMessageFlow(message_flow::MessageFlow* flow);
   void visualizeMap(const vi_map::VIMap& vi_map) const;
 
  private:
   void registerPublishers();
+  // Publishes the map and the debug markers at their own rates, such that
+  // they never block the delivery of the estimates.
+  void visualizationThreadWorker();
   void stateCallback(
       int64_t timestamp_ns, const vio::ViNodeState& vinode,
       const bool has_T_G_M, const aslam::Transformation& T_G_M);
@@ -48,6 +56,11 @@ class DataPublisherFlow {
       const vio::ViNodeState& vinode, const bool has_T_G_M,
       const aslam::Transformation& T_G_M);
   void localizationCallback(const Eigen::Vector3d& p_G_I_lc_pnp);
+  void publishDebugMarkers(
+      const visualization::SphereVector& T_M_I_spheres,
+      const visualization::SphereVector& T_G_I_spheres,
+      const visualization::SphereVector& T_G_I_loc_spheres) const;
+  void printLatencyStatisticsIfDue();
 
   std::unique_ptr<visualization::ViwlsGraphRvizPlotter> plotter_;
   ros::NodeHandle node_handle_;
@@ -58,8 +71,33 @@ class DataPublisherFlow {
   ros::Publisher pub_imu_acc_bias_;
   ros::Publisher pub_imu_gyro_bias_;
 
+  // The state messages are preallocated and reused for every estimate.
+  std::mutex m_state_messages_;
+  geometry_msgs::PoseStamped T_M_I_message_;
+  geometry_msgs::PoseStamped T_G_I_message_;
+  geometry_msgs::PoseStamped T_G_M_message_;
+  geometry_msgs::Vector3Stamped velocity_message_;
+  geometry_msgs::Vector3Stamped bias_message_;
+
+  std::thread visualization_thread_;
+  std::mutex m_visualization_;
+  std::condition_variable cv_visualization_;
+  bool shutdown_visualization_;
+  // Latest map that is not yet visualized, null if there is none.
+  VIMapWithMutex::ConstPtr map_to_visualize_;
+  bool have_debug_markers_changed_;
   common::TimeoutCounter map_publisher_timeout_;
+  common::TimeoutCounter debug_marker_publisher_timeout_;
+
+  // Latencies from the image receive time to the publication of the
+  // estimates, printed every --rovioli_latency_statistics_interval_s.
+  ProcessingLatencyStatistics rovio_estimate_latencies_;
+  ProcessingLatencyStatistics vio_update_latencies_;
+  ProcessingLatencyStatistics localization_latencies_;
+  common::TimeoutCounter latency_statistics_timeout_;
+  std::mutex m_latency_statistics_timeout_;
 
+  // Guarded by m_visualization_.
   visualization::SphereVector T_M_I_spheres_;
   visualization::SphereVector T_G_I_spheres_;
   visualization::SphereVector T_G_I_loc_spheres_;
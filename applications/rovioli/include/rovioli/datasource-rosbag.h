@@ -2,12 +2,15 @@
 #define ROVIOLI_DATASOURCE_ROSBAG_H_
 
 #include <atomic>
+#include <future>
 #include <memory>
 #include <string>
 #include <thread>
 #include <vector>
 
 #include <aslam/common/time.h>
+#include <maplab-common/thread-pool.h>
+#include <maplab-common/threadsafe-queue.h>
 #include <vio-common/rostopic-settings.h>
 #include <vio-common/vio-types.h>
 
@@ -27,6 +30,12 @@
 
 namespace rovioli {
 
+// Plays back the camera and IMU messages of a rosbag. With
+// --vio_rosbag_max_speed the bag timing is ignored and the messages are
+// released as fast as the subscribers consume them: a read-ahead thread
+// iterates the bag, which reads and decompresses the chunks, the images are
+// converted to cv::Mat on a small thread pool and the results are released in
+// bag order from a bounded queue.
 class DataSourceRosbag : public DataSource {
  public:
   DataSourceRosbag(
@@ -43,9 +52,28 @@ class DataSourceRosbag : public DataSource {
   virtual std::string getDatasetName() const;
 
  private:
+  struct PrefetchedMessage {
+    MAPLAB_POINTER_TYPEDEFS(PrefetchedMessage);
+    enum class Type { kImage, kImu, kEndOfData };
+
+    Type type;
+    std::shared_future<vio::ImageMeasurement::Ptr> image_measurement;
+    vio::ImuMeasurement::Ptr imu_measurement;
+  };
+
   void streamingWorker();
+  void maxSpeedStreamingWorker();
+  void prefetchWorker();
+
+  void publishImageMeasurement(
+      const vio::ImageMeasurement::Ptr& image_measurement);
+  void publishImuMeasurement(const vio::ImuMeasurement::Ptr& imu_measurement);
+  void finishStreaming();
 
   std::unique_ptr<std::thread> streaming_thread_;
+  std::unique_ptr<std::thread> prefetch_thread_;
+  std::unique_ptr<common::ThreadPool> image_conversion_pool_;
+  common::ThreadSafeQueue<PrefetchedMessage::Ptr> prefetched_messages_;
   std::atomic<bool> shutdown_requested_;
   std::atomic<bool> all_data_streamed_;
   std::string rosbag_path_filename_;
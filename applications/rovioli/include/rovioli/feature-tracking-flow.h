@@ -38,6 +38,8 @@ class FeatureTrackingFlow {
                   nframe_imu);
           if (success) {
             // This will only fail for the first frame.
+            nframe_imu->processing_timestamps.stamp(
+                vio::ProcessingStage::kFeatureTracked);
             publish_result(nframe_imu);
           }
         });
@@ -0,0 +1,29 @@
+#ifndef ROVIOLI_FLOW_TOPIC_SERIALIZATION_H_
+#define ROVIOLI_FLOW_TOPIC_SERIALIZATION_H_
+
+#include <string>
+
+#include <message-flow/message-log.h>
+#include <vio-common/vio-types.h>
+
+// Serializers of the raw sensor topics for recording and replaying ROVIOLI
+// pipelines with the message flow recorder and player.
+namespace message_flow {
+template <>
+struct MessageSerializer<vio::ImuMeasurement::Ptr> {
+  static void serialize(
+      const vio::ImuMeasurement::Ptr& message, std::string* payload);
+  static bool deserialize(
+      const std::string& payload, vio::ImuMeasurement::Ptr* message);
+};
+
+template <>
+struct MessageSerializer<vio::ImageMeasurement::Ptr> {
+  static void serialize(
+      const vio::ImageMeasurement::Ptr& message, std::string* payload);
+  static bool deserialize(
+      const std::string& payload, vio::ImageMeasurement::Ptr* message);
+};
+}  // namespace message_flow
+
+#endif  // ROVIOLI_FLOW_TOPIC_SERIALIZATION_H_
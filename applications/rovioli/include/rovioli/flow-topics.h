@@ -23,6 +23,11 @@ MESSAGE_FLOW_TOPIC(
 MESSAGE_FLOW_TOPIC(
     THROTTLED_TRACKED_NFRAMES_AND_IMU, vio::SynchronizedNFrameImu::ConstPtr);
 
+// Throttled nframes whose downstream processing has finished, as feedback for
+// the adaptive throttler.
+MESSAGE_FLOW_TOPIC(
+    PROCESSED_THROTTLED_NFRAMES, vio::SynchronizedNFrameImu::ConstPtr);
+
 // Output of the localizer.
 MESSAGE_FLOW_TOPIC(LOCALIZATION_RESULT, vio::LocalizationResult::ConstPtr);
 
@@ -40,4 +45,8 @@ MESSAGE_FLOW_TOPIC(RAW_VIMAP, rovioli::VIMapWithMutex::ConstPtr);
 // corresponding to the publishing order and no sensor can be left behind.
 constexpr int kExclusivityGroupIdRovioSensorSubscribers = 0;
 
+// Exclusivity group of the message flow recorder, such that the sensor data is
+// recorded in publishing order.
+constexpr int kExclusivityGroupIdMessageFlowRecorder = 1;
+
 #endif  // ROVIOLI_FLOW_TOPICS_H_
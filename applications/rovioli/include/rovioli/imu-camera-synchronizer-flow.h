@@ -32,7 +32,9 @@ class ImuCameraSynchronizerFlow {
         [this](const vio::ImageMeasurement::Ptr& image) {
           CHECK(image);
           this->synchronizing_pipeline_.addCameraImage(
-              image->camera_index, image->image, image->timestamp);
+              image->camera_index, image->image, image->timestamp,
+              image->processing_timestamps.get(
+                  vio::ProcessingStage::kImageReceived));
         });
     // IMU input.
     flow->registerSubscriber<message_flow_topics::IMU_MEASUREMENTS>(
@@ -2,12 +2,14 @@
 #define ROVIOLI_IMU_CAMERA_SYNCHRONIZER_H_
 
 #include <atomic>
+#include <map>
 #include <memory>
 #include <vector>
 
 #include <Eigen/Core>
 #include <aslam/cameras/ncamera.h>
 #include <aslam/pipeline/visual-npipeline.h>
+#include <maplab-common/lock-free-bounded-queue.h>
 #include <opencv2/core/core.hpp>
 #include <vio-common/imu-measurements-buffer.h>
 #include <vio-common/vio-types.h>
@@ -15,6 +17,12 @@
 
 namespace rovioli {
 
+// Synchronizes the images to nframes and attaches the IMU measurements since
+// the previous nframe. The measurements are handed over from the sensor
+// callbacks through one lock-free queue per sensor, so adding a measurement
+// never waits for the synchronization; it only blocks if the queue of the
+// sensor is full. A dedicated thread per sensor moves the measurements from
+// its queue into the visual pipeline or the IMU buffer.
 class ImuCameraSynchronizer {
  public:
   MAPLAB_POINTER_TYPEDEFS(ImuCameraSynchronizer);
@@ -30,6 +38,11 @@ class ImuCameraSynchronizer {
       const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_measurements);
   void addCameraImage(
       size_t camera_index, const cv::Mat& image, int64_t timestamp);
+  // The receive time of the image is used for the processing timestamps of
+  // the synchronized nframe; negative if unknown.
+  void addCameraImage(
+      size_t camera_index, const cv::Mat& image, int64_t timestamp,
+      int64_t received_timestamp_ns);
 
   void registerSynchronizedNFrameImuCallback(
       const std::function<void(const vio::SynchronizedNFrameImu::Ptr&)>& cb);
@@ -39,13 +52,37 @@ class ImuCameraSynchronizer {
   static constexpr size_t kFramesToSkipAtInit = 1u;
 
  private:
+  struct ImuSample {
+    int64_t timestamp_ns;
+    // Unaligned, as the queue cells are not allocated with Eigen alignment.
+    Eigen::Matrix<double, 6, 1, Eigen::DontAlign> imu_data;
+  };
+  struct PendingImage {
+    size_t camera_index;
+    cv::Mat image;
+    int64_t timestamp_ns;
+    int64_t received_timestamp_ns;
+  };
+
   void checkIfMessagesAreIncomingWorker();
+  void imuIngestionThreadWorker();
+  void imageIngestionThreadWorker();
   void processDataThreadWorker();
+  // Sets the receive time of the earliest received image of the nframe and
+  // forgets the receive times of all images up to the nframe.
+  void setImageReceivedTimestamp(
+      const aslam::VisualNFrame& nframe,
+      vio::ProcessingTimestamps* processing_timestamps);
 
   const aslam::NCamera::Ptr camera_system_;
 
   aslam::VisualNPipeline::UniquePtr visual_pipeline_;
   vio_common::ImuMeasurementBuffer::UniquePtr imu_buffer_;
+
+  // Each queue has a single producer, the callback of its sensor, and a
+  // single consumer, the ingestion thread of its sensor.
+  common::LockFreeBoundedQueue<ImuSample> imu_ingestion_queue_;
+  common::LockFreeBoundedQueue<PendingImage> image_ingestion_queue_;
   const int64_t kImuBufferLengthNanoseconds;
 
   // Number of already skipped frames.
@@ -58,6 +95,11 @@ class ImuCameraSynchronizer {
   // flag.
   int64_t min_nframe_timestamp_diff_ns_;
 
+  // Receive times of the images in the visual pipeline by image timestamp.
+  // Written by the image ingestion thread.
+  std::map<int64_t, int64_t> image_received_timestamps_ns_;
+  std::mutex m_image_received_timestamps_ns_;
+
   std::vector<std::function<void(const vio::SynchronizedNFrameImu::Ptr&)>>
       nframe_callbacks_;
   std::mutex m_nframe_callbacks_;
@@ -67,14 +109,16 @@ class ImuCameraSynchronizer {
   std::condition_variable cv_shutdown_;
 
   std::thread check_if_messages_are_incomfing_thread_;
+  std::thread imu_ingestion_thread_;
+  std::thread image_ingestion_thread_;
   std::thread process_thread_;
   std::mutex mutex_check_if_messages_are_incoming_;
 
   // Indicates the timestamp when either the last message was received or the
   // check that messages are (still) incoming was performed last (whichever
   // happend most recently).
-  int64_t time_last_imu_message_received_or_checked_ns_;
-  int64_t time_last_camera_message_received_or_checked_ns_;
+  std::atomic<int64_t> time_last_imu_message_received_or_checked_ns_;
+  std::atomic<int64_t> time_last_camera_message_received_or_checked_ns_;
 };
 
 }  // namespace rovioli
@@ -1,7 +1,13 @@
 #ifndef ROVIOLI_LOCALIZER_FLOW_H_
 #define ROVIOLI_LOCALIZER_FLOW_H_
 
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
 #include <localization-summary-map/localization-summary-map.h>
+#include <localization-summary-map/tiled-localization-summary-map.h>
 #include <message-flow/message-flow.h>
 #include <vio-common/vio-types.h>
 
@@ -10,40 +16,45 @@
 
 namespace rovioli {
 
+// Localizes the throttled nframes against a localization summary map. With
+// --rovioli_localize_asynchronously the localization runs on a dedicated
+// thread: the subscriber callback only hands the nframe over and returns,
+// nframes that arrive while a localization is running replace each other, so
+// only the newest one is localized next. The results are published from the
+// localization thread and carry the timestamp of their nframe.
 class LocalizerFlow {
  public:
-  explicit LocalizerFlow(
+  LocalizerFlow(
       const summary_map::LocalizationSummaryMap& localization_map,
-      const bool visualize_localization)
-      : localizer_(localization_map, visualize_localization) {}
-
-  void attachToMessageFlow(message_flow::MessageFlow* flow) {
-    CHECK_NOTNULL(flow);
-    static constexpr char kSubscriberNodeName[] = "LocalizerFlow";
-
-    // Subscribe-publish: nframe to localization.
-    std::function<void(vio::LocalizationResult::ConstPtr)> publish_result =
-        flow->registerPublisher<message_flow_topics::LOCALIZATION_RESULT>();
-
-    // NOTE: the publisher function pointer is copied intentionally; otherwise
-    // we would capture a reference to a temporary.
-    flow->registerSubscriber<
-        message_flow_topics::THROTTLED_TRACKED_NFRAMES_AND_IMU>(
-        kSubscriberNodeName, message_flow::DeliveryOptions(),
-        [publish_result,
-         this](const vio::SynchronizedNFrameImu::ConstPtr& nframe_imu) {
-          CHECK(nframe_imu);
-          vio::LocalizationResult::Ptr loc_result(new vio::LocalizationResult);
-          const bool success = this->localizer_.localizeNFrame(
-              nframe_imu->nframe, loc_result.get());
-          if (success) {
-            publish_result(loc_result);
-          }
-        });
-  }
+      const bool visualize_localization);
+  LocalizerFlow(
+      const summary_map::TiledLocalizationSummaryMap& tiled_localization_map,
+      const bool visualize_localization);
+  ~LocalizerFlow();
+
+  void attachToMessageFlow(message_flow::MessageFlow* flow);
+
+  // Stops the localization thread; pending nframes are discarded.
+  void shutdown();
 
  private:
+  void localizeAndPublish(const vio::SynchronizedNFrameImu::ConstPtr& nframe);
+  void asynchronousLocalizationWorker();
+
   Localizer localizer_;
+  std::function<void(vio::LocalizationResult::ConstPtr)> publish_result_;
+  // Reports every localized nframe to the throttler, whether the
+  // localization succeeded or not.
+  std::function<void(vio::SynchronizedNFrameImu::ConstPtr)>
+      publish_processed_nframe_;
+
+  const bool localize_asynchronously_;
+  std::mutex m_latest_nframe_imu_;
+  std::condition_variable cv_latest_nframe_imu_;
+  vio::SynchronizedNFrameImu::ConstPtr latest_nframe_imu_;
+  size_t num_skipped_nframes_;
+  bool shutdown_requested_;
+  std::thread localization_thread_;
 };
 }  // namespace rovioli
 #endif  // ROVIOLI_LOCALIZER_FLOW_H_
@@ -1,9 +1,16 @@
 #ifndef ROVIOLI_LOCALIZER_H_
 #define ROVIOLI_LOCALIZER_H_
 
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+#include <localization-summary-map/landmark-spatial-index.h>
 #include <localization-summary-map/localization-summary-map.h>
+#include <localization-summary-map/tiled-localization-summary-map.h>
 #include <loop-closure-handler/loop-detector-node.h>
 #include <maplab-common/macros.h>
+#include <vi-map/loop-constraint.h>
 #include <vio-common/vio-types.h>
 
 namespace rovioli {
@@ -19,25 +26,99 @@ class Localizer {
   Localizer(
       const summary_map::LocalizationSummaryMap& localization_summary_map,
       const bool visualize_localization);
+  // Loads the tiles of the map on demand, such that the loaded tiles stay
+  // within --rovioli_localization_tile_memory_budget_mb. Once localized, the
+  // tiles within --rovioli_localization_tile_radius_m of the last localized
+  // position are queried. Until then, or after too many consecutive
+  // failures, every query moves on to the next tiles in order of their
+  // distance to the last localized position.
+  Localizer(
+      const summary_map::TiledLocalizationSummaryMap& tiled_localization_map,
+      const bool visualize_localization);
 
   LocalizationMode getCurrentLocalizationMode() const;
 
+  // If --rovioli_localization_map_tracking_radius_m is positive, the localizer
+  // switches to map tracking after a successful global localization and falls
+  // back to global localization after too many consecutive failures.
   bool localizeNFrame(
       const aslam::VisualNFrame::ConstPtr& nframe,
-      vio::LocalizationResult* localization_result) const;
+      vio::LocalizationResult* localization_result);
 
  private:
   bool localizeNFrameGlobal(
       const aslam::VisualNFrame::ConstPtr& nframe,
       aslam::Transformation* T_G_I_lc_pnp) const;
+  // Only queries the landmarks around the last localized position. The
+  // keypoints that continue a feature track of an inlier of the last
+  // localization keep its landmark, only the other keypoints are queried.
   bool localizeNFrameMapTracking(
       const aslam::VisualNFrame::ConstPtr& nframe,
-      aslam::Transformation* T_G_I_lc_pnp) const;
+      aslam::Transformation* T_G_I_lc_pnp);
+
+  // Propagates the tracked landmark matches to the keypoints of the n-frame
+  // with the same track ids.
+  void getTrackedStructureMatches(
+      const aslam::VisualNFrame& nframe,
+      vi_map::VertexKeyPointToStructureMatchList* structure_matches) const;
+  void updateTrackedStructureMatches(
+      const aslam::VisualNFrame& nframe,
+      const vi_map::VertexKeyPointToStructureMatchList&
+          inlier_structure_matches);
+
+  // Rebuilds the map tracking database from the landmarks around the given
+  // position. Returns false if there are no landmarks.
+  bool rebuildMapTrackingDatabase(const Eigen::Vector3d& p_G_center);
+
+  // Queries the tiles of the current localization mode.
+  bool localizeNFrameInTiles(
+      const aslam::VisualNFrame::ConstPtr& nframe,
+      aslam::Transformation* T_G_I_lc_pnp);
+  // The next tiles of the global search that fit into the memory budget.
+  void getNextGlobalSearchTiles(std::vector<size_t>* tile_indices);
+  // Keeps the leading tiles that fit into the memory budget, at least one.
+  void limitTilesToMemoryBudget(std::vector<size_t>* tile_indices) const;
+  // Loads the tiles and rebuilds the global database from them if they
+  // differ from the active tiles. Evicts the least recently used tiles
+  // that are not needed once the memory budget is exceeded.
+  bool activateTiles(const std::vector<size_t>& tile_indices);
+  void updateLocalizationMode(
+      const bool localization_success, const aslam::Transformation& T_G_I);
 
   LocalizationMode current_localization_mode_;
   loop_detector_node::LoopDetectorNode::UniquePtr global_loop_detector_;
 
-  const summary_map::LocalizationSummaryMap& localization_summary_map_;
+  // Exactly one of the two maps is set. With the tiled map, the global loop
+  // detector holds the active tiles, which are merged into
+  // active_tiles_summary_map_.
+  const summary_map::LocalizationSummaryMap* localization_summary_map_;
+  const summary_map::TiledLocalizationSummaryMap* tiled_localization_map_;
+
+  const double map_tracking_radius_m_;
+  summary_map::LandmarkSpatialIndex::UniquePtr landmark_spatial_index_;
+  loop_detector_node::LoopDetectorNode::UniquePtr map_tracking_loop_detector_;
+  summary_map::LocalizationSummaryMap::UniquePtr map_tracking_summary_map_;
+  Eigen::Vector3d p_G_map_tracking_database_center_;
+  aslam::Transformation T_G_I_last_localization_;
+  int num_consecutive_map_tracking_failures_;
+  // The inlier matches of the last map tracking localization, per frame of
+  // the n-frame and keyed by the track id of their keypoint.
+  std::vector<std::unordered_map<int, vi_map::VertexKeyPointToStructureMatch>>
+      tracked_structure_matches_;
+
+  struct LoadedTile {
+    summary_map::LocalizationSummaryMap::Ptr summary_map;
+    size_t last_used;
+  };
+  const size_t tile_memory_budget_bytes_;
+  std::unordered_map<size_t, LoadedTile> loaded_tiles_;
+  size_t loaded_tiles_num_bytes_;
+  size_t tile_use_counter_;
+  // Sorted indices of the tiles in the global database.
+  std::vector<size_t> active_tile_indices_;
+  summary_map::LocalizationSummaryMap::UniquePtr active_tiles_summary_map_;
+  // Position of the global search in the tiles sorted by distance.
+  size_t global_search_tile_offset_;
 };
 
 }  // namespace rovioli
@@ -4,7 +4,9 @@
 #include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include <aslam/cameras/ncamera.h>
 #include <message-flow/message-flow.h>
@@ -12,6 +14,7 @@
 #include <sensors/imu.h>
 #include <vi-map/vi-map.h>
 #include <vio-common/vio-types.h>
+#include <vio-common/vio-update.h>
 
 #include "rovioli/flow-topics.h"
 #include "rovioli/vi-map-with-mutex.h"
@@ -21,6 +24,13 @@ namespace rovioli {
 
 // Note that the VisualNFrames are not deep-copied and the passed shared-pointer
 // is direcly added to the map.
+//
+// With --rovioli_map_builder_segment_num_vertices the map is built in
+// segments to bound the memory: once the resident map reaches the given number
+// of vertices, its landmarks are initialized, it is saved to
+// <save_map_folder>_segments/segment_<n> and a new map is started from the
+// last vertex. On save, the saved segments are stitched into the final map as
+// missions sharing the same odometry frame.
 class MapBuilderFlow {
  public:
   MapBuilderFlow(
@@ -33,6 +43,14 @@ class MapBuilderFlow {
       const bool process_to_localization_map);
 
  private:
+  void startNewSegment();
+  // Expects the caller to hold m_map_builder_ and the map mutex.
+  void flushSegment();
+  void initializeLandmarksOfResidentMission();
+
+  // Protects map_with_mutex_ and stream_map_builder_, which are replaced when a
+  // segment is flushed. Has to be locked before the map mutex.
+  std::mutex m_map_builder_;
   VIMapWithMutex::Ptr map_with_mutex_;
 
   // If set then all incoming callbacks that cause operations on the map will be
@@ -40,7 +58,14 @@ class MapBuilderFlow {
   std::atomic<bool> mapping_terminated_;
 
   VioUpdateBuilder vio_update_builder_;
-  online_map_builders::StreamMapBuilder stream_map_builder_;
+  const std::shared_ptr<aslam::NCamera> n_camera_;
+  const vi_map::Imu::UniquePtr imu_;
+  const std::string save_map_folder_;
+  std::unique_ptr<online_map_builders::StreamMapBuilder> stream_map_builder_;
+
+  const size_t segment_num_vertices_;
+  std::vector<std::string> saved_segment_folders_;
+  vio::VioUpdate::ConstPtr last_vio_update_;
 };
 
 }  // namespace rovioli
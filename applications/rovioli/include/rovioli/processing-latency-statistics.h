@@ -0,0 +1,45 @@
+#ifndef ROVIOLI_PROCESSING_LATENCY_STATISTICS_H_
+#define ROVIOLI_PROCESSING_LATENCY_STATISTICS_H_
+
+#include <array>
+#include <string>
+
+#include <maplab-common/histograms.h>
+#include <maplab-common/macros.h>
+#include <vio-common/vio-types.h>
+
+namespace rovioli {
+
+// Collects the latency from the receive time of an image to every processing
+// stage it passed. Samples without a receive time are ignored. Samples can be
+// added concurrently from multiple threads.
+class ProcessingLatencyStatistics {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(ProcessingLatencyStatistics);
+
+  explicit ProcessingLatencyStatistics(const std::string& name)
+      : name_(name) {}
+
+  void addSample(const vio::ProcessingTimestamps& processing_timestamps);
+
+  // Prints the number of samples and the p50, p99 and max latency of every
+  // stage with samples.
+  std::string print() const;
+  void reset();
+
+  const common::histograms::ExponentialHistogram& getLatencyHistogram(
+      vio::ProcessingStage stage) const {
+    return histograms_[static_cast<size_t>(stage)];
+  }
+
+ private:
+  const std::string name_;
+  std::array<
+      common::histograms::ExponentialHistogram,
+      vio::ProcessingTimestamps::kNumStages>
+      histograms_;
+};
+
+}  // namespace rovioli
+
+#endif  // ROVIOLI_PROCESSING_LATENCY_STATISTICS_H_
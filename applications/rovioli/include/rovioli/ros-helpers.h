@@ -40,6 +40,7 @@ inline vio::ImuMeasurement::Ptr convertRosImuToMaplabImu(
 inline vio::ImageMeasurement::Ptr convertRosImageToMaplabImage(
     const sensor_msgs::ImageConstPtr& image_message, size_t camera_idx) {
   CHECK(image_message);
+  const int64_t received_timestamp_ns = vio::ProcessingTimestamps::now();
   cv_bridge::CvImageConstPtr cv_ptr;
   try {
     // Convert the image to MONO8 if necessary.
@@ -59,6 +60,8 @@ inline vio::ImageMeasurement::Ptr convertRosImageToMaplabImage(
   image_measurement->timestamp =
       rosTimeToNanoseconds(image_message->header.stamp);
   image_measurement->camera_index = camera_idx;
+  image_measurement->processing_timestamps.set(
+      vio::ProcessingStage::kImageReceived, received_timestamp_ns);
   return image_measurement;
 }
 
@@ -16,6 +16,10 @@ struct RovioEstimate {
 
   aslam::Transformation T_G_M;
   bool has_T_G_M;
+
+  // The receive time is only set for estimates that are the first to include
+  // a new image.
+  vio::ProcessingTimestamps processing_timestamps;
 };
 }  // namespace rovioli
 #endif  // ROVIOLI_ROVIO_ESTIMATE_H_
@@ -1,10 +1,14 @@
 #ifndef ROVIOLI_ROVIO_FLOW_H_
 #define ROVIOLI_ROVIO_FLOW_H_
 
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <utility>
 #include <vector>
 
+#include <maplab-common/lock-free-bounded-queue.h>
 #include <message-flow/message-flow.h>
 #include <sensors/imu.h>
 #include <vio-common/vio-types.h>
@@ -23,12 +27,30 @@ class RovioFlow {
   void processRovioUpdate(const rovio::RovioState& state);
 
  private:
+  void processImuMeasurement(
+      const vio::ImuMeasurement& imu, bool update_filter);
+  // Feeds the batched IMU measurements to ROVIO. Waits a short while for
+  // the measurements up to the given timestamp that may still be in flight.
+  void feedBatchedImuMeasurements(int64_t timestamp_ns);
+
   std::unique_ptr<rovio::RovioInterface> rovio_interface_;
   std::function<void(const RovioEstimate::ConstPtr&)> publish_rovio_estimates_;
 
   // Indicates if the camera at the corresponding index should be used for
   // motion tracking.
   std::vector<char> is_camera_idx_active_in_motion_tracking_;
+
+  // Timestamp [s] and receive time [ns] of the images passed to ROVIO that
+  // are not yet included in a published estimate. Only accessed from the
+  // exclusivity group of the ROVIO subscribers.
+  std::deque<std::pair<double, int64_t>> pending_image_received_timestamps_;
+
+  // IMU measurements that are batched until the next image or localization
+  // update. Filled by the IMU subscriber, which is outside of the
+  // exclusivity group, and drained from within the exclusivity group.
+  common::LockFreeBoundedQueue<vio::ImuMeasurement::ConstPtr>
+      batched_imu_measurements_;
+  int64_t last_fed_imu_timestamp_ns_;
 };
 }  // namespace rovioli
 #endif  // ROVIOLI_ROVIO_FLOW_H_
@@ -26,6 +26,8 @@ class RovioliNode final {
       const vi_map::ImuSigmas& rovio_imu_sigmas,
       const std::string& save_map_folder,
       const summary_map::LocalizationSummaryMap* const localization_map,
+      const summary_map::TiledLocalizationSummaryMap* const
+          tiled_localization_map,
       message_flow::MessageFlow* flow);
   ~RovioliNode();
 
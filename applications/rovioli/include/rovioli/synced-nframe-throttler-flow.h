@@ -30,9 +30,26 @@ class SyncedNFrameThrottlerFlow {
           const bool should_publish =
               this->throttler_.shouldPublishNFrame(nframe_imu);
           if (should_publish) {
+            nframe_imu->processing_timestamps.stamp(
+                vio::ProcessingStage::kThrottled);
             publish_result(nframe_imu);
           }
         });
+
+    flow->registerSubscriber<message_flow_topics::PROCESSED_THROTTLED_NFRAMES>(
+        kSubscriberNodeName, message_flow::DeliveryOptions(),
+        [this](const vio::SynchronizedNFrameImu::ConstPtr& nframe_imu) {
+          CHECK(nframe_imu);
+          const vio::ProcessingTimestamps& processing_timestamps =
+              nframe_imu->processing_timestamps;
+          if (!processing_timestamps.has(vio::ProcessingStage::kThrottled)) {
+            return;
+          }
+          this->throttler_.reportProcessedNFrame(
+              nframe_imu->nframe->getMinTimestampNanoseconds(),
+              vio::ProcessingTimestamps::now() -
+                  processing_timestamps.get(vio::ProcessingStage::kThrottled));
+        });
   }
 
  private:
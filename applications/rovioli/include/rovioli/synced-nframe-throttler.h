@@ -1,7 +1,9 @@
 #ifndef ROVIOLI_SYNCED_NFRAME_THROTTLER_H_
 #define ROVIOLI_SYNCED_NFRAME_THROTTLER_H_
 
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include <vio-common/imu-measurements-buffer.h>
@@ -10,6 +12,12 @@
 
 namespace rovioli {
 
+// Forwards the nframes at most at the output frequency. With
+// --vio_throttler_adaptive the output frequency follows the load of the
+// downstream consumers within the minimum and maximum frequency: it is
+// reduced while the processing latency of the forwarded nframes exceeds the
+// target or while they queue up, and slowly raised again while the consumers
+// keep up.
 class SyncedNFrameThrottler {
  public:
   MAPLAB_POINTER_TYPEDEFS(SyncedNFrameThrottler);
@@ -19,13 +27,39 @@ class SyncedNFrameThrottler {
   bool shouldPublishNFrame(
       const vio::SynchronizedNFrameImu::ConstPtr& synced_nframe_imu);
 
+  // Reports that the downstream processing of a forwarded nframe finished
+  // after the given latency. The nframes that were forwarded after it are
+  // considered queued. Only has an effect in adaptive mode.
+  void reportProcessedNFrame(
+      const int64_t nframe_timestamp_ns, const int64_t processing_latency_ns);
+
+  // The current maximum output frequency.
+  double getOutputFrequencyHz() const;
+  // The frequency of the forwarded nframes over the last report interval, in
+  // sensor time. 0 until the first interval is complete.
+  double getEffectiveOutputFrequencyHz() const;
+
  private:
-  // Minimum interval of the output, as configured by the maximum frequency
-  // flag.
-  const int64_t min_nframe_timestamp_diff_ns_;
+  void setOutputFrequencyHz(const double output_frequency_hz);
+  void updateEffectiveOutputFrequency(const int64_t nframe_timestamp_ns);
 
+  const bool is_adaptive_;
+  const double min_output_frequency_hz_;
+  const double max_output_frequency_hz_;
+  const int64_t target_latency_ns_;
+
+  mutable std::mutex mutex_;
+  double output_frequency_hz_;
+  // Minimum interval of the output, given by the output frequency.
+  int64_t min_nframe_timestamp_diff_ns_;
   int64_t previous_nframe_timestamp_ns_;
-  std::mutex m_previous_nframe_timestamp_ns_;
+  // Timestamps of the forwarded nframes that haven't been reported as
+  // processed yet, in forwarding order.
+  std::deque<int64_t> queued_nframe_timestamps_ns_;
+
+  int64_t report_interval_start_timestamp_ns_;
+  size_t num_nframes_in_report_interval_;
+  double effective_output_frequency_hz_;
 };
 
 }  // namespace rovioli
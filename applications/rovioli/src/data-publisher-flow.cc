@@ -1,5 +1,7 @@
 #include "rovioli/data-publisher-flow.h"
 
+#include <chrono>
+
 #include <maplab-common/file-logger.h>
 #include <minkindr_conversions/kindr_msg.h>
 
@@ -7,6 +9,21 @@ DEFINE_double(
     map_publish_interval_s, 2.0,
     "Interval of publishing the visual-inertial map to ROS [seconds].");
 
+DEFINE_double(
+    rovioli_debug_marker_publish_interval_s, 1.0,
+    "Interval of publishing the debug markers of --publish_debug_markers "
+    "[seconds].");
+
+DEFINE_double(
+    rovioli_visualization_landmark_voxel_size_m, 0.1,
+    "If positive, only one landmark per voxel of this size is visualized in "
+    "the map published by ROVIOLI.");
+
+DEFINE_uint64(
+    rovioli_visualization_max_num_landmarks, 100000u,
+    "Maximum number of landmarks in the map published by ROVIOLI, larger "
+    "clouds are decimated evenly. (0: unlimited)");
+
 DEFINE_bool(
     publish_only_on_keyframes, false,
     "Publish frames only on keyframes instead of the IMU measurements. This "
@@ -26,16 +43,48 @@ DEFINE_bool(
     "Set to false to disable map visualization. Note: map building needs to be "
     "active for the visualization.");
 
+DEFINE_double(
+    rovioli_latency_statistics_interval_s, 10.0,
+    "Interval of printing the latencies from the image reception to the "
+    "publication of the estimates [seconds]. Disabled if 0.");
+
 DECLARE_bool(rovioli_run_map_builder);
 
 namespace rovioli {
 
 DataPublisherFlow::DataPublisherFlow()
-    : map_publisher_timeout_(
+    : shutdown_visualization_(false),
+      have_debug_markers_changed_(false),
+      map_publisher_timeout_(
           common::TimeoutCounter(
-              FLAGS_map_publish_interval_s * kSecondsToNanoSeconds)) {
+              FLAGS_map_publish_interval_s * kSecondsToNanoSeconds)),
+      debug_marker_publisher_timeout_(
+          FLAGS_rovioli_debug_marker_publish_interval_s *
+          kSecondsToNanoSeconds),
+      rovio_estimate_latencies_("ROVIO estimates"),
+      vio_update_latencies_("VIO updates"),
+      localization_latencies_("localization results"),
+      latency_statistics_timeout_(
+          FLAGS_rovioli_latency_statistics_interval_s *
+          kSecondsToNanoSeconds) {
+  CHECK_GE(FLAGS_rovioli_latency_statistics_interval_s, 0.0);
+  CHECK_GE(FLAGS_rovioli_debug_marker_publish_interval_s, 0.0);
   visualization::RVizVisualizationSink::init();
   plotter_.reset(new visualization::ViwlsGraphRvizPlotter);
+  plotter_->setLandmarkDecimation(
+      FLAGS_rovioli_visualization_landmark_voxel_size_m,
+      FLAGS_rovioli_visualization_max_num_landmarks);
+}
+
+DataPublisherFlow::~DataPublisherFlow() {
+  {
+    std::lock_guard<std::mutex> lock(m_visualization_);
+    shutdown_visualization_ = true;
+  }
+  cv_visualization_.notify_all();
+  if (visualization_thread_.joinable()) {
+    visualization_thread_.join();
+  }
 }
 
 void DataPublisherFlow::registerPublishers() {
@@ -56,17 +105,23 @@ void DataPublisherFlow::registerPublishers() {
 void DataPublisherFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
   CHECK_NOTNULL(flow);
   registerPublishers();
+  CHECK(!visualization_thread_.joinable());
+  visualization_thread_ =
+      std::thread(&DataPublisherFlow::visualizationThreadWorker, this);
   static constexpr char kSubscriberNodeName[] = "DataPublisherFlow";
 
   if (FLAGS_rovioli_run_map_builder && FLAGS_rovioli_visualize_map) {
+    // Only the latest map is worth visualizing. It is visualized on the
+    // visualization thread.
+    message_flow::DeliveryOptions map_delivery_options;
+    map_delivery_options.queue_full_policy =
+        message_flow::QueueFullPolicy::kKeepLatest;
     flow->registerSubscriber<message_flow_topics::RAW_VIMAP>(
-        kSubscriberNodeName, message_flow::DeliveryOptions(),
+        kSubscriberNodeName, map_delivery_options,
         [this](const VIMapWithMutex::ConstPtr& map_with_mutex) {
-          if (map_publisher_timeout_.reached()) {
-            std::lock_guard<std::mutex> lock(map_with_mutex->mutex);
-            visualizeMap(map_with_mutex->vi_map);
-            map_publisher_timeout_.reset();
-          }
+          CHECK(map_with_mutex != nullptr);
+          std::lock_guard<std::mutex> lock(m_visualization_);
+          map_to_visualize_ = map_with_mutex;
         });
   }
 
@@ -76,6 +131,10 @@ void DataPublisherFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
       [&](const vio::LocalizationResult::ConstPtr& localization) {
         CHECK(localization != nullptr);
         localizationCallback(localization->T_G_I_lc_pnp.getPosition());
+        vio::ProcessingTimestamps processing_timestamps =
+            localization->processing_timestamps;
+        processing_timestamps.stamp(vio::ProcessingStage::kPublished);
+        localization_latencies_.addSample(processing_timestamps);
       });
 
   flow->registerSubscriber<message_flow_topics::ROVIO_ESTIMATES>(
@@ -86,6 +145,11 @@ void DataPublisherFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
           stateCallback(
               state->timestamp_s * kSecondsToNanoSeconds, state->vinode,
               state->has_T_G_M, state->T_G_M);
+          vio::ProcessingTimestamps processing_timestamps =
+              state->processing_timestamps;
+          processing_timestamps.stamp(vio::ProcessingStage::kPublished);
+          rovio_estimate_latencies_.addSample(processing_timestamps);
+          printLatencyStatisticsIfDue();
         }
       });
 
@@ -104,6 +168,15 @@ void DataPublisherFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
               vio_update->timestamp_ns, vio_update->vinode, has_T_G_M,
               vio_update->T_G_M);
         }
+
+        CHECK(vio_update->keyframe_and_imudata);
+        vio::ProcessingTimestamps processing_timestamps =
+            vio_update->keyframe_and_imudata->processing_timestamps;
+        if (FLAGS_publish_only_on_keyframes) {
+          processing_timestamps.stamp(vio::ProcessingStage::kPublished);
+        }
+        vio_update_latencies_.addSample(processing_timestamps);
+        printLatencyStatisticsIfDue();
       });
 
   // CSV export for end-to-end test.
@@ -140,6 +213,45 @@ void DataPublisherFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
   }
 }
 
+void DataPublisherFlow::visualizationThreadWorker() {
+  // The rate limits are not tied to any message, so they are polled.
+  constexpr int kPollPeriodMs = 50;
+  std::unique_lock<std::mutex> lock(m_visualization_);
+  while (true) {
+    cv_visualization_.wait_for(
+        lock, std::chrono::milliseconds(kPollPeriodMs),
+        [this]() { return shutdown_visualization_; });
+    if (shutdown_visualization_) {
+      return;
+    }
+
+    if (have_debug_markers_changed_ &&
+        debug_marker_publisher_timeout_.reached()) {
+      have_debug_markers_changed_ = false;
+      const visualization::SphereVector T_M_I_spheres = T_M_I_spheres_;
+      const visualization::SphereVector T_G_I_spheres = T_G_I_spheres_;
+      const visualization::SphereVector T_G_I_loc_spheres =
+          T_G_I_loc_spheres_;
+      lock.unlock();
+      publishDebugMarkers(T_M_I_spheres, T_G_I_spheres, T_G_I_loc_spheres);
+      debug_marker_publisher_timeout_.reset();
+      lock.lock();
+    }
+
+    if (map_to_visualize_ != nullptr && map_publisher_timeout_.reached()) {
+      VIMapWithMutex::ConstPtr map_with_mutex;
+      map_with_mutex.swap(map_to_visualize_);
+      lock.unlock();
+      {
+        std::lock_guard<std::mutex> map_lock(map_with_mutex->mutex);
+        visualizeMap(map_with_mutex->vi_map);
+      }
+      map_publisher_timeout_.reset();
+      lock.lock();
+    }
+  }
+}
+
 void DataPublisherFlow::visualizeMap(const vi_map::VIMap& vi_map) const {
   static constexpr bool kPublishBaseframes = true;
   static constexpr bool kPublishVertices = true;
@@ -165,60 +277,61 @@ void DataPublisherFlow::stateCallback(
     int64_t timestamp_ns, const vio::ViNodeState& vinode, const bool has_T_G_M,
     const aslam::Transformation& T_G_M) {
   ros::Time timestamp_ros = createRosTimestamp(timestamp_ns);
-
-  // Publish pose in mission frame.
   const aslam::Transformation& T_M_I = vinode.get_T_M_I();
-  geometry_msgs::PoseStamped T_M_I_message;
-  tf::poseStampedKindrToMsg(
-      T_M_I, timestamp_ros, visualization::kDefaultMissionFrame,
-      &T_M_I_message);
-  pub_pose_T_M_I_.publish(T_M_I_message);
+  const aslam::Transformation T_G_I = T_G_M * T_M_I;
+  {
+    std::lock_guard<std::mutex> lock(m_state_messages_);
+
+    // Publish pose in mission frame.
+    tf::poseStampedKindrToMsg(
+        T_M_I, timestamp_ros, visualization::kDefaultMissionFrame,
+        &T_M_I_message_);
+    pub_pose_T_M_I_.publish(T_M_I_message_);
+
+    // Publish pose in global frame.
+    tf::poseStampedKindrToMsg(
+        T_G_I, timestamp_ros, visualization::kDefaultMapFrame,
+        &T_G_I_message_);
+    pub_pose_T_G_I_.publish(T_G_I_message_);
+
+    // Publish baseframe transformation.
+    tf::poseStampedKindrToMsg(
+        T_G_M, timestamp_ros, visualization::kDefaultMapFrame,
+        &T_G_M_message_);
+    pub_baseframe_T_G_M_.publish(T_G_M_message_);
+
+    // Publish velocity.
+    const Eigen::Vector3d& v_M_I = vinode.get_v_M_I();
+    velocity_message_.header.stamp = timestamp_ros;
+    velocity_message_.vector.x = v_M_I[0];
+    velocity_message_.vector.y = v_M_I[1];
+    velocity_message_.vector.z = v_M_I[2];
+    pub_velocity_I_.publish(velocity_message_);
+
+    // Publish IMU bias.
+    bias_message_.header.stamp = timestamp_ros;
+    Eigen::Matrix<double, 6, 1> imu_bias_acc_gyro = vinode.getImuBias();
+    bias_message_.vector.x = imu_bias_acc_gyro[0];
+    bias_message_.vector.y = imu_bias_acc_gyro[1];
+    bias_message_.vector.z = imu_bias_acc_gyro[2];
+    pub_imu_acc_bias_.publish(bias_message_);
+
+    bias_message_.vector.x = imu_bias_acc_gyro[3];
+    bias_message_.vector.y = imu_bias_acc_gyro[4];
+    bias_message_.vector.z = imu_bias_acc_gyro[5];
+    pub_imu_gyro_bias_.publish(bias_message_);
+  }
+
   visualization::publishTF(
       T_M_I, visualization::kDefaultMissionFrame,
       visualization::kDefaultImuFrame, timestamp_ros);
-
-  // Publish pose in global frame.
-  aslam::Transformation T_G_I = T_G_M * T_M_I;
-  geometry_msgs::PoseStamped T_G_I_message;
-  tf::poseStampedKindrToMsg(
-      T_G_I, timestamp_ros, visualization::kDefaultMapFrame, &T_G_I_message);
-  pub_pose_T_G_I_.publish(T_G_I_message);
   visualization::publishTF(
       T_G_I, visualization::kDefaultMapFrame, visualization::kDefaultImuFrame,
       timestamp_ros);
-
-  // Publish baseframe transformation.
-  geometry_msgs::PoseStamped T_G_M_message;
-  tf::poseStampedKindrToMsg(
-      T_G_M, timestamp_ros, visualization::kDefaultMapFrame, &T_G_M_message);
-  pub_baseframe_T_G_M_.publish(T_G_M_message);
   visualization::publishTF(
       T_G_M, visualization::kDefaultMapFrame,
       visualization::kDefaultMissionFrame, timestamp_ros);
 
-  // Publish velocity.
-  const Eigen::Vector3d& v_M_I = vinode.get_v_M_I();
-  geometry_msgs::Vector3Stamped velocity_msg;
-  velocity_msg.header.stamp = timestamp_ros;
-  velocity_msg.vector.x = v_M_I[0];
-  velocity_msg.vector.y = v_M_I[1];
-  velocity_msg.vector.z = v_M_I[2];
-  pub_velocity_I_.publish(velocity_msg);
-
-  // Publish IMU bias.
-  geometry_msgs::Vector3Stamped bias_msg;
-  bias_msg.header.stamp = timestamp_ros;
-  Eigen::Matrix<double, 6, 1> imu_bias_acc_gyro = vinode.getImuBias();
-  bias_msg.vector.x = imu_bias_acc_gyro[0];
-  bias_msg.vector.y = imu_bias_acc_gyro[1];
-  bias_msg.vector.z = imu_bias_acc_gyro[2];
-  pub_imu_acc_bias_.publish(bias_msg);
-
-  bias_msg.vector.x = imu_bias_acc_gyro[3];
-  bias_msg.vector.y = imu_bias_acc_gyro[4];
-  bias_msg.vector.z = imu_bias_acc_gyro[5];
-  pub_imu_gyro_bias_.publish(bias_msg);
-
   if (FLAGS_publish_debug_markers) {
     stateDebugCallback(vinode, has_T_G_M, T_G_M);
   }
@@ -227,32 +340,65 @@ void DataPublisherFlow::stateCallback(
 void DataPublisherFlow::stateDebugCallback(
     const vio::ViNodeState& vinode, const bool has_T_G_M,
     const aslam::Transformation& T_G_M) {
-  constexpr size_t kMarkerId = 0u;
   visualization::Sphere sphere;
   const aslam::Transformation& T_M_I = vinode.get_T_M_I();
   sphere.position = T_M_I.getPosition();
   sphere.radius = 0.2;
   sphere.color = visualization::kCommonGreen;
   sphere.alpha = 0.8;
+
+  std::lock_guard<std::mutex> lock(m_visualization_);
   T_M_I_spheres_.push_back(sphere);
-  visualization::publishSpheres(
-      T_M_I_spheres_, kMarkerId, visualization::kDefaultMapFrame, "debug",
-      "debug_T_M_I");
 
-  // Publish ROVIO global frame if it is available.
+  // Add ROVIO global frame if it is available.
   if (has_T_G_M) {
     aslam::Transformation T_G_I = T_G_M * T_M_I;
-    visualization::Sphere sphere;
     sphere.position = T_G_I.getPosition();
-    sphere.radius = 0.2;
     sphere.color = visualization::kCommonWhite;
-    sphere.alpha = 0.8;
     T_G_I_spheres_.push_back(sphere);
+  }
+  have_debug_markers_changed_ = true;
+}
 
+void DataPublisherFlow::publishDebugMarkers(
+    const visualization::SphereVector& T_M_I_spheres,
+    const visualization::SphereVector& T_G_I_spheres,
+    const visualization::SphereVector& T_G_I_loc_spheres) const {
+  constexpr size_t kMarkerId = 0u;
+  if (!T_M_I_spheres.empty()) {
     visualization::publishSpheres(
-        T_G_I_spheres_, kMarkerId, visualization::kDefaultMapFrame, "debug",
+        T_M_I_spheres, kMarkerId, visualization::kDefaultMapFrame, "debug",
+        "debug_T_M_I");
+  }
+  if (!T_G_I_spheres.empty()) {
+    visualization::publishSpheres(
+        T_G_I_spheres, kMarkerId, visualization::kDefaultMapFrame, "debug",
         "debug_T_G_I");
   }
+  if (!T_G_I_loc_spheres.empty()) {
+    visualization::publishSpheres(
+        T_G_I_loc_spheres, kMarkerId, visualization::kDefaultMapFrame,
+        "debug", "debug_T_G_I_raw_localizations");
+  }
+}
+
+void DataPublisherFlow::printLatencyStatisticsIfDue() {
+  if (FLAGS_rovioli_latency_statistics_interval_s <= 0.0) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(
+      m_latency_statistics_timeout_, std::try_to_lock);
+  if (!lock.owns_lock() || !latency_statistics_timeout_.reached()) {
+    return;
+  }
+  latency_statistics_timeout_.reset();
+  LOG(INFO) << "\n"
+            << rovio_estimate_latencies_.print()
+            << vio_update_latencies_.print()
+            << localization_latencies_.print();
+  rovio_estimate_latencies_.reset();
+  vio_update_latencies_.reset();
+  localization_latencies_.reset();
 }
 
 void DataPublisherFlow::localizationCallback(
@@ -262,12 +408,10 @@ void DataPublisherFlow::localizationCallback(
   sphere.radius = 0.2;
   sphere.color = visualization::kCommonRed;
   sphere.alpha = 0.8;
-  T_G_I_loc_spheres_.push_back(sphere);
 
-  constexpr size_t kMarkerId = 0u;
-  visualization::publishSpheres(
-      T_G_I_loc_spheres_, kMarkerId, visualization::kDefaultMapFrame, "debug",
-      "debug_T_G_I_raw_localizations");
+  std::lock_guard<std::mutex> lock(m_visualization_);
+  T_G_I_loc_spheres_.push_back(sphere);
+  have_debug_markers_changed_ = true;
 }
 
 }  //  namespace rovioli
@@ -2,6 +2,7 @@
 
 #include <atomic>
 #include <chrono>
+#include <future>
 #include <memory>
 #include <string>
 #include <vector>
@@ -10,6 +11,8 @@
 #include <boost/bind.hpp>
 #include <maplab-common/accessors.h>
 #include <maplab-common/file-system-tools.h>
+#include <maplab-common/thread-pool.h>
+#include <maplab-common/threadsafe-queue.h>
 #include <vio-common/rostopic-settings.h>
 
 #pragma GCC diagnostic push
@@ -30,6 +33,18 @@ DEFINE_double(
     vio_rosbag_realtime_playback_rate, 1.0,
     "Playback rate of the ROSBAG. Real-time corresponds to 1.0. "
     "This only makes sense when using offline data sources.");
+DEFINE_bool(
+    vio_rosbag_max_speed, false,
+    "Ignore the bag timing and play back the ROSBAG as fast as the "
+    "subscribers consume the messages, e.g. for offline batch mapping. The "
+    "bag is read ahead on a separate thread and the images are converted in "
+    "parallel.");
+DEFINE_int32(
+    vio_rosbag_max_speed_num_conversion_threads, 2,
+    "Number of threads converting the images with --vio_rosbag_max_speed.");
+DEFINE_int32(
+    vio_rosbag_max_speed_prefetch_queue_size, 256,
+    "Maximum number of messages read ahead with --vio_rosbag_max_speed.");
 DEFINE_bool(
     rovioli_zero_initial_timestamps, false,
     "If set to true, the timestamps outputted by the estimator start with 0. "
@@ -55,15 +70,37 @@ DataSourceRosbag::~DataSourceRosbag() {
 }
 
 void DataSourceRosbag::startStreaming() {
+  if (!FLAGS_vio_rosbag_max_speed) {
+    streaming_thread_.reset(
+        new std::thread(std::bind(&DataSourceRosbag::streamingWorker, this)));
+    return;
+  }
+
+  CHECK_GT(FLAGS_vio_rosbag_max_speed_num_conversion_threads, 0);
+  CHECK_GT(FLAGS_vio_rosbag_max_speed_prefetch_queue_size, 0);
+  image_conversion_pool_.reset(
+      new common::ThreadPool(
+          FLAGS_vio_rosbag_max_speed_num_conversion_threads));
+  prefetch_thread_.reset(
+      new std::thread(std::bind(&DataSourceRosbag::prefetchWorker, this)));
   streaming_thread_.reset(
-      new std::thread(std::bind(&DataSourceRosbag::streamingWorker, this)));
+      new std::thread(
+          std::bind(&DataSourceRosbag::maxSpeedStreamingWorker, this)));
 }
 
 void DataSourceRosbag::shutdown() {
   shutdown_requested_ = true;
+  // Unblocks the prefetch thread if the queue is full and the streaming
+  // thread if it is empty.
+  prefetched_messages_.Shutdown();
+  if (prefetch_thread_ != nullptr && prefetch_thread_->joinable()) {
+    prefetch_thread_->join();
+  }
   if (streaming_thread_ != nullptr && streaming_thread_->joinable()) {
     streaming_thread_->join();
   }
+  // Finishes the pending image conversions.
+  image_conversion_pool_.reset();
 }
 
 std::string DataSourceRosbag::getDatasetName() const {
@@ -154,30 +191,15 @@ void DataSourceRosbag::streamingWorker() {
     if (image_message) {
       const size_t camera_idx =
           common::getChecked(ros_topics_.camera_topic_cam_index_map, topic);
-      vio::ImageMeasurement::Ptr image_measurement =
-          convertRosImageToMaplabImage(image_message, camera_idx);
-
-      // Shift timestamps to start at 0.
-      if (!FLAGS_rovioli_zero_initial_timestamps ||
-          shiftByFirstTimestamp(&(image_measurement->timestamp))) {
-        VLOG(3) << "Publish Image measurement...";
-        invokeImageCallbacks(image_measurement);
-      }
+      publishImageMeasurement(
+          convertRosImageToMaplabImage(image_message, camera_idx));
     }
 
     // Enqueue IMU messages.
     if (topic == ros_topics_.imu_topic) {
       sensor_msgs::ImuConstPtr imu_msg =
           message.instantiate<sensor_msgs::Imu>();
-      vio::ImuMeasurement::Ptr imu_measurement =
-          convertRosImuToMaplabImu(imu_msg);
-
-      // Shift timestamps to start at 0.
-      if (!FLAGS_rovioli_zero_initial_timestamps ||
-          shiftByFirstTimestamp(&(imu_measurement->timestamp))) {
-        VLOG(3) << "Publish IMU measurement...";
-        invokeImuCallbacks(imu_measurement);
-      }
+      publishImuMeasurement(convertRosImuToMaplabImu(imu_msg));
     }
 
     // Wait for the time between messages.
@@ -191,10 +213,103 @@ void DataSourceRosbag::streamingWorker() {
     }
     ++it_message;
   }
+  finishStreaming();
+}
+
+void DataSourceRosbag::prefetchWorker() {
+  CHECK(bag_view_);
+  CHECK(image_conversion_pool_);
+  const size_t max_queue_size = FLAGS_vio_rosbag_max_speed_prefetch_queue_size;
+  for (const rosbag::MessageInstance& message : *bag_view_) {
+    if (shutdown_requested_) {
+      return;
+    }
+    const std::string& topic = message.getTopic();
+    CHECK(!topic.empty());
+
+    PrefetchedMessage::Ptr prefetched_message;
+    sensor_msgs::ImageConstPtr image_message =
+        message.instantiate<sensor_msgs::Image>();
+    if (image_message) {
+      const size_t camera_idx =
+          common::getChecked(ros_topics_.camera_topic_cam_index_map, topic);
+      // The conversion tasks need to be copyable, hence the shared promise.
+      std::shared_ptr<std::promise<vio::ImageMeasurement::Ptr>> promise =
+          std::make_shared<std::promise<vio::ImageMeasurement::Ptr>>();
+      prefetched_message = std::make_shared<PrefetchedMessage>();
+      prefetched_message->type = PrefetchedMessage::Type::kImage;
+      prefetched_message->image_measurement = promise->get_future().share();
+      image_conversion_pool_->enqueue([promise, image_message, camera_idx]() {
+        promise->set_value(
+            convertRosImageToMaplabImage(image_message, camera_idx));
+      });
+    } else if (topic == ros_topics_.imu_topic) {
+      prefetched_message = std::make_shared<PrefetchedMessage>();
+      prefetched_message->type = PrefetchedMessage::Type::kImu;
+      prefetched_message->imu_measurement =
+          convertRosImuToMaplabImu(message.instantiate<sensor_msgs::Imu>());
+    }
+
+    if (prefetched_message &&
+        !prefetched_messages_.PushBlockingIfFull(
+            prefetched_message, max_queue_size)) {
+      // The queue was shut down.
+      return;
+    }
+  }
+
+  PrefetchedMessage::Ptr end_of_data = std::make_shared<PrefetchedMessage>();
+  end_of_data->type = PrefetchedMessage::Type::kEndOfData;
+  prefetched_messages_.PushBlockingIfFull(end_of_data, max_queue_size);
+}
+
+void DataSourceRosbag::maxSpeedStreamingWorker() {
+  PrefetchedMessage::Ptr prefetched_message;
+  while (!shutdown_requested_ &&
+         prefetched_messages_.PopBlocking(&prefetched_message)) {
+    CHECK(prefetched_message);
+    switch (prefetched_message->type) {
+      case PrefetchedMessage::Type::kImage:
+        publishImageMeasurement(prefetched_message->image_measurement.get());
+        break;
+      case PrefetchedMessage::Type::kImu:
+        publishImuMeasurement(prefetched_message->imu_measurement);
+        break;
+      case PrefetchedMessage::Type::kEndOfData:
+        finishStreaming();
+        return;
+      default:
+        LOG(FATAL) << "Unknown prefetched message type.";
+    }
+  }
+}
+
+void DataSourceRosbag::publishImageMeasurement(
+    const vio::ImageMeasurement::Ptr& image_measurement) {
+  CHECK(image_measurement);
+  // Shift timestamps to start at 0.
+  if (!FLAGS_rovioli_zero_initial_timestamps ||
+      shiftByFirstTimestamp(&(image_measurement->timestamp))) {
+    VLOG(3) << "Publish Image measurement...";
+    invokeImageCallbacks(image_measurement);
+  }
+}
+
+void DataSourceRosbag::publishImuMeasurement(
+    const vio::ImuMeasurement::Ptr& imu_measurement) {
+  CHECK(imu_measurement);
+  // Shift timestamps to start at 0.
+  if (!FLAGS_rovioli_zero_initial_timestamps ||
+      shiftByFirstTimestamp(&(imu_measurement->timestamp))) {
+    VLOG(3) << "Publish IMU measurement...";
+    invokeImuCallbacks(imu_measurement);
+  }
+}
+
+void DataSourceRosbag::finishStreaming() {
   LOG(INFO) << "Rosbag playback finished!";
   all_data_streamed_ = true;
   invokeEndOfDataCallbacks();
-  return;
 }
 
 }  // namespace rovioli
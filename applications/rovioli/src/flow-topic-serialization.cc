@@ -0,0 +1,108 @@
+#include "rovioli/flow-topic-serialization.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <aslam/common/memory.h>
+#include <glog/logging.h>
+#include <opencv2/core/core.hpp>
+
+namespace message_flow {
+namespace {
+template <typename Type>
+void appendValue(const Type& value, std::string* payload) {
+  CHECK_NOTNULL(payload)->append(
+      reinterpret_cast<const char*>(&value), sizeof(Type));
+}
+
+template <typename Type>
+bool readValue(const std::string& payload, size_t* offset, Type* value) {
+  CHECK_NOTNULL(offset);
+  CHECK_NOTNULL(value);
+  if (*offset + sizeof(Type) > payload.size()) {
+    return false;
+  }
+  memcpy(value, payload.data() + *offset, sizeof(Type));
+  *offset += sizeof(Type);
+  return true;
+}
+}  // namespace
+
+void MessageSerializer<vio::ImuMeasurement::Ptr>::serialize(
+    const vio::ImuMeasurement::Ptr& message, std::string* payload) {
+  CHECK(message);
+  CHECK_NOTNULL(payload)->clear();
+  appendValue(message->timestamp, payload);
+  payload->append(
+      reinterpret_cast<const char*>(message->imu_data.data()),
+      sizeof(double) * message->imu_data.size());
+}
+
+bool MessageSerializer<vio::ImuMeasurement::Ptr>::deserialize(
+    const std::string& payload, vio::ImuMeasurement::Ptr* message) {
+  CHECK_NOTNULL(message);
+  vio::ImuMeasurement::Ptr imu_measurement =
+      aligned_shared<vio::ImuMeasurement>();
+  size_t offset = 0u;
+  if (!readValue(payload, &offset, &imu_measurement->timestamp)) {
+    return false;
+  }
+  const size_t num_data_bytes =
+      sizeof(double) * imu_measurement->imu_data.size();
+  if (offset + num_data_bytes != payload.size()) {
+    return false;
+  }
+  memcpy(
+      imu_measurement->imu_data.data(), payload.data() + offset,
+      num_data_bytes);
+  *message = imu_measurement;
+  return true;
+}
+
+void MessageSerializer<vio::ImageMeasurement::Ptr>::serialize(
+    const vio::ImageMeasurement::Ptr& message, std::string* payload) {
+  CHECK(message);
+  CHECK_NOTNULL(payload)->clear();
+  const cv::Mat image =
+      message->image.isContinuous() ? message->image : message->image.clone();
+  appendValue(message->timestamp, payload);
+  appendValue(static_cast<int32_t>(message->camera_index), payload);
+  appendValue(static_cast<int32_t>(image.rows), payload);
+  appendValue(static_cast<int32_t>(image.cols), payload);
+  appendValue(static_cast<int32_t>(image.type()), payload);
+  payload->append(
+      reinterpret_cast<const char*>(image.data),
+      image.total() * image.elemSize());
+}
+
+bool MessageSerializer<vio::ImageMeasurement::Ptr>::deserialize(
+    const std::string& payload, vio::ImageMeasurement::Ptr* message) {
+  CHECK_NOTNULL(message);
+  vio::ImageMeasurement::Ptr image_measurement =
+      aligned_shared<vio::ImageMeasurement>();
+  size_t offset = 0u;
+  int32_t camera_index, rows, cols, type;
+  if (!readValue(payload, &offset, &image_measurement->timestamp) ||
+      !readValue(payload, &offset, &camera_index) ||
+      !readValue(payload, &offset, &rows) ||
+      !readValue(payload, &offset, &cols) ||
+      !readValue(payload, &offset, &type) || rows < 0 || cols < 0) {
+    return false;
+  }
+  image_measurement->camera_index = camera_index;
+  image_measurement->image.create(rows, cols, type);
+  const size_t num_data_bytes =
+      image_measurement->image.total() * image_measurement->image.elemSize();
+  if (offset + num_data_bytes != payload.size()) {
+    return false;
+  }
+  memcpy(
+      image_measurement->image.data, payload.data() + offset, num_data_bytes);
+  // A replayed image is received when it is read from the log.
+  image_measurement->processing_timestamps.stamp(
+      vio::ProcessingStage::kImageReceived);
+  *message = image_measurement;
+  return true;
+}
+}  // namespace message_flow
@@ -1,5 +1,7 @@
 #include "rovioli/imu-camera-synchronizer.h"
 
+#include <algorithm>
+
 #include <aslam/pipeline/visual-pipeline-null.h>
 #include <maplab-common/conversions.h>
 
@@ -11,6 +13,14 @@ DEFINE_double(
     vio_nframe_sync_max_output_frequency_hz, 10.0,
     "Maximum output frequency of the synchronized IMU-NFrame structures "
     "from the synchronizer.");
+DEFINE_int32(
+    vio_nframe_sync_imu_ingestion_queue_size, 4096,
+    "Number of IMU measurements that can be queued for the synchronizer "
+    "before the IMU callback blocks.");
+DEFINE_int32(
+    vio_nframe_sync_image_ingestion_queue_size, 50,
+    "Number of images that can be queued for the synchronizer before the "
+    "image callback blocks.");
 
 namespace rovioli {
 
@@ -18,6 +28,9 @@ ImuCameraSynchronizer::ImuCameraSynchronizer(
     const aslam::NCamera::Ptr& camera_system)
     : camera_system_(camera_system),
       kImuBufferLengthNanoseconds(aslam::time::seconds(30u)),
+      imu_ingestion_queue_(FLAGS_vio_nframe_sync_imu_ingestion_queue_size),
+      image_ingestion_queue_(
+          FLAGS_vio_nframe_sync_image_ingestion_queue_size),
       frame_skip_counter_(0u),
       previous_nframe_timestamp_ns_(-1),
       min_nframe_timestamp_diff_ns_(
@@ -54,6 +67,10 @@ ImuCameraSynchronizer::ImuCameraSynchronizer(
 
   check_if_messages_are_incomfing_thread_ = std::thread(
       &ImuCameraSynchronizer::checkIfMessagesAreIncomingWorker, this);
+  imu_ingestion_thread_ =
+      std::thread(&ImuCameraSynchronizer::imuIngestionThreadWorker, this);
+  image_ingestion_thread_ =
+      std::thread(&ImuCameraSynchronizer::imageIngestionThreadWorker, this);
   process_thread_ =
       std::thread(&ImuCameraSynchronizer::processDataThreadWorker, this);
 }
@@ -64,23 +81,69 @@ ImuCameraSynchronizer::~ImuCameraSynchronizer() {
 
 void ImuCameraSynchronizer::addCameraImage(
     size_t camera_index, const cv::Mat& image, int64_t timestamp) {
-  constexpr int kMaxNFrameQueueSize = 50;
-  CHECK(visual_pipeline_ != nullptr);
+  addCameraImage(camera_index, image, timestamp, -1);
+}
+
+void ImuCameraSynchronizer::addCameraImage(
+    size_t camera_index, const cv::Mat& image, int64_t timestamp,
+    int64_t received_timestamp_ns) {
   time_last_camera_message_received_or_checked_ns_ =
       aslam::time::nanoSecondsSinceEpoch();
-  if (!visual_pipeline_->processImageBlockingIfFull(
-          camera_index, image, timestamp, kMaxNFrameQueueSize)) {
-    shutdown();
-  }
+  PendingImage pending_image;
+  pending_image.camera_index = camera_index;
+  pending_image.image = image;
+  pending_image.timestamp_ns = timestamp;
+  pending_image.received_timestamp_ns = received_timestamp_ns;
+  image_ingestion_queue_.Push(pending_image);
 }
 
 void ImuCameraSynchronizer::addImuMeasurements(
     const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& timestamps_nanoseconds,
     const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_measurements) {
-  CHECK(imu_buffer_ != nullptr);
+  CHECK_EQ(timestamps_nanoseconds.cols(), imu_measurements.cols());
   time_last_imu_message_received_or_checked_ns_ =
       aslam::time::nanoSecondsSinceEpoch();
-  imu_buffer_->addMeasurements(timestamps_nanoseconds, imu_measurements);
+  ImuSample imu_sample;
+  for (int idx = 0; idx < timestamps_nanoseconds.cols(); ++idx) {
+    imu_sample.timestamp_ns = timestamps_nanoseconds(idx);
+    imu_sample.imu_data = imu_measurements.col(idx);
+    imu_ingestion_queue_.Push(imu_sample);
+  }
+}
+
+void ImuCameraSynchronizer::imuIngestionThreadWorker() {
+  CHECK(imu_buffer_ != nullptr);
+  ImuSample imu_sample;
+  while (imu_ingestion_queue_.PopBlocking(&imu_sample)) {
+    imu_buffer_->addMeasurement(imu_sample.timestamp_ns, imu_sample.imu_data);
+  }
+}
+
+void ImuCameraSynchronizer::imageIngestionThreadWorker() {
+  CHECK(visual_pipeline_ != nullptr);
+  constexpr int kMaxNFrameQueueSize = 50;
+  PendingImage pending_image;
+  while (image_ingestion_queue_.PopBlocking(&pending_image)) {
+    if (pending_image.received_timestamp_ns >= 0) {
+      std::lock_guard<std::mutex> lock(m_image_received_timestamps_ns_);
+      int64_t& earliest_received_timestamp_ns =
+          image_received_timestamps_ns_
+              .emplace(
+                  pending_image.timestamp_ns,
+                  pending_image.received_timestamp_ns)
+              .first->second;
+      earliest_received_timestamp_ns = std::min(
+          earliest_received_timestamp_ns,
+          pending_image.received_timestamp_ns);
+    }
+    if (!visual_pipeline_->processImageBlockingIfFull(
+            pending_image.camera_index, pending_image.image,
+            pending_image.timestamp_ns, kMaxNFrameQueueSize)) {
+      // The pipeline only fails if it has been shut down.
+      return;
+    }
+    pending_image.image.release();
+  }
 }
 
 void ImuCameraSynchronizer::checkIfMessagesAreIncomingWorker() {
@@ -125,6 +188,8 @@ void ImuCameraSynchronizer::processDataThreadWorker() {
       // Shutdown.
       return;
     }
+    vio::ProcessingTimestamps processing_timestamps;
+    setImageReceivedTimestamp(*new_nframe, &processing_timestamps);
 
     // Block the previous nframe timestamp so that no other thread can use it.
     // It should wait till this iteration is done.
@@ -151,6 +216,7 @@ void ImuCameraSynchronizer::processDataThreadWorker() {
     vio::SynchronizedNFrameImu::Ptr new_imu_nframe_measurement(
         new vio::SynchronizedNFrameImu);
     new_imu_nframe_measurement->nframe = new_nframe;
+    new_imu_nframe_measurement->processing_timestamps = processing_timestamps;
 
     // Wait for the required IMU data.
     CHECK(aslam::time::isValidTime(previous_nframe_timestamp_ns_));
@@ -216,6 +282,8 @@ void ImuCameraSynchronizer::processDataThreadWorker() {
     // is inconsistent.
     initial_sync_succeeded_ = true;
 
+    new_imu_nframe_measurement->processing_timestamps.stamp(
+        vio::ProcessingStage::kSynchronized);
     std::lock_guard<std::mutex> callback_lock(m_nframe_callbacks_);
     for (const std::function<void(const vio::SynchronizedNFrameImu::Ptr&)>&
              callback : nframe_callbacks_) {
@@ -224,6 +292,33 @@ void ImuCameraSynchronizer::processDataThreadWorker() {
   }
 }
 
+void ImuCameraSynchronizer::setImageReceivedTimestamp(
+    const aslam::VisualNFrame& nframe,
+    vio::ProcessingTimestamps* processing_timestamps) {
+  CHECK_NOTNULL(processing_timestamps);
+  const int64_t min_timestamp_ns = nframe.getMinTimestampNanoseconds();
+  const int64_t max_timestamp_ns = nframe.getMaxTimestampNanoseconds();
+  std::lock_guard<std::mutex> lock(m_image_received_timestamps_ns_);
+  std::map<int64_t, int64_t>::iterator it =
+      image_received_timestamps_ns_.begin();
+  for (; it != image_received_timestamps_ns_.end() &&
+         it->first <= max_timestamp_ns;
+       ++it) {
+    if (it->first < min_timestamp_ns) {
+      continue;
+    }
+    if (!processing_timestamps->has(vio::ProcessingStage::kImageReceived) ||
+        it->second <
+            processing_timestamps->get(vio::ProcessingStage::kImageReceived)) {
+      processing_timestamps->set(
+          vio::ProcessingStage::kImageReceived, it->second);
+    }
+  }
+  // Images of dropped nframes are forgotten as well.
+  image_received_timestamps_ns_.erase(
+      image_received_timestamps_ns_.begin(), it);
+}
+
 void ImuCameraSynchronizer::registerSynchronizedNFrameImuCallback(
     const std::function<void(const vio::SynchronizedNFrameImu::Ptr&)>&
         callback) {
@@ -234,8 +329,16 @@ void ImuCameraSynchronizer::registerSynchronizedNFrameImuCallback(
 
 void ImuCameraSynchronizer::shutdown() {
   shutdown_ = true;
+  imu_ingestion_queue_.Shutdown();
+  image_ingestion_queue_.Shutdown();
   visual_pipeline_->shutdown();
   imu_buffer_->shutdown();
+  if (imu_ingestion_thread_.joinable()) {
+    imu_ingestion_thread_.join();
+  }
+  if (image_ingestion_thread_.joinable()) {
+    image_ingestion_thread_.join();
+  }
   if (process_thread_.joinable()) {
     process_thread_.join();
   }
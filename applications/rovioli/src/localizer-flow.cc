@@ -0,0 +1,135 @@
+#include "rovioli/localizer-flow.h"
+
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <localization-summary-map/localization-summary-map.h>
+#include <message-flow/message-flow.h>
+#include <vio-common/vio-types.h>
+
+DEFINE_bool(
+    rovioli_localize_asynchronously, false,
+    "Run the localization on a dedicated thread against the newest nframe "
+    "only. Nframes that arrive while a localization is running are skipped "
+    "and the results are published asynchronously.");
+
+namespace rovioli {
+
+LocalizerFlow::LocalizerFlow(
+    const summary_map::LocalizationSummaryMap& localization_map,
+    const bool visualize_localization)
+    : localizer_(localization_map, visualize_localization),
+      localize_asynchronously_(FLAGS_rovioli_localize_asynchronously),
+      num_skipped_nframes_(0u),
+      shutdown_requested_(false) {}
+
+LocalizerFlow::LocalizerFlow(
+    const summary_map::TiledLocalizationSummaryMap& tiled_localization_map,
+    const bool visualize_localization)
+    : localizer_(tiled_localization_map, visualize_localization),
+      localize_asynchronously_(FLAGS_rovioli_localize_asynchronously),
+      num_skipped_nframes_(0u),
+      shutdown_requested_(false) {}
+
+LocalizerFlow::~LocalizerFlow() {
+  shutdown();
+}
+
+void LocalizerFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
+  CHECK_NOTNULL(flow);
+  static constexpr char kSubscriberNodeName[] = "LocalizerFlow";
+
+  // Subscribe-publish: nframe to localization.
+  publish_result_ =
+      flow->registerPublisher<message_flow_topics::LOCALIZATION_RESULT>();
+  publish_processed_nframe_ = flow->registerPublisher<
+      message_flow_topics::PROCESSED_THROTTLED_NFRAMES>();
+
+  // Localizing outdated frames only adds latency, so only the latest frame
+  // is kept if the localizer falls behind.
+  message_flow::DeliveryOptions delivery_options;
+  delivery_options.queue_full_policy =
+      message_flow::QueueFullPolicy::kKeepLatest;
+
+  if (!localize_asynchronously_) {
+    flow->registerSubscriber<
+        message_flow_topics::THROTTLED_TRACKED_NFRAMES_AND_IMU>(
+        kSubscriberNodeName, delivery_options,
+        [this](const vio::SynchronizedNFrameImu::ConstPtr& nframe_imu) {
+          CHECK(nframe_imu);
+          this->localizeAndPublish(nframe_imu);
+        });
+    return;
+  }
+
+  CHECK(!localization_thread_.joinable())
+      << "The localizer can only be attached to one message flow.";
+  localization_thread_ =
+      std::thread(&LocalizerFlow::asynchronousLocalizationWorker, this);
+  flow->registerSubscriber<
+      message_flow_topics::THROTTLED_TRACKED_NFRAMES_AND_IMU>(
+      kSubscriberNodeName, delivery_options,
+      [this](const vio::SynchronizedNFrameImu::ConstPtr& nframe_imu) {
+        CHECK(nframe_imu);
+        {
+          std::lock_guard<std::mutex> lock(this->m_latest_nframe_imu_);
+          if (this->latest_nframe_imu_) {
+            ++this->num_skipped_nframes_;
+          }
+          this->latest_nframe_imu_ = nframe_imu;
+        }
+        this->cv_latest_nframe_imu_.notify_one();
+      });
+}
+
+void LocalizerFlow::shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(m_latest_nframe_imu_);
+    shutdown_requested_ = true;
+    latest_nframe_imu_.reset();
+  }
+  cv_latest_nframe_imu_.notify_all();
+  if (localization_thread_.joinable()) {
+    localization_thread_.join();
+    VLOG(1) << "The asynchronous localization skipped " << num_skipped_nframes_
+            << " nframes.";
+  }
+}
+
+void LocalizerFlow::localizeAndPublish(
+    const vio::SynchronizedNFrameImu::ConstPtr& nframe_imu) {
+  CHECK(nframe_imu);
+  CHECK(publish_result_);
+  vio::LocalizationResult::Ptr loc_result(new vio::LocalizationResult);
+  const bool success =
+      localizer_.localizeNFrame(nframe_imu->nframe, loc_result.get());
+  if (success) {
+    loc_result->processing_timestamps = nframe_imu->processing_timestamps;
+    loc_result->processing_timestamps.stamp(vio::ProcessingStage::kLocalized);
+    publish_result_(loc_result);
+  }
+  CHECK(publish_processed_nframe_);
+  publish_processed_nframe_(nframe_imu);
+}
+
+void LocalizerFlow::asynchronousLocalizationWorker() {
+  while (true) {
+    vio::SynchronizedNFrameImu::ConstPtr nframe_imu;
+    {
+      std::unique_lock<std::mutex> lock(m_latest_nframe_imu_);
+      cv_latest_nframe_imu_.wait(lock, [this]() {
+        return shutdown_requested_ || latest_nframe_imu_ != nullptr;
+      });
+      if (shutdown_requested_) {
+        return;
+      }
+      nframe_imu.swap(latest_nframe_imu_);
+    }
+    localizeAndPublish(nframe_imu);
+  }
+}
+
+}  // namespace rovioli
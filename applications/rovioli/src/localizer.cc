@@ -1,15 +1,62 @@
 #include "rovioli/localizer.h"
 
+#include <algorithm>
+#include <vector>
+
+#include <Eigen/Core>
+#include <gflags/gflags.h>
+#include <localization-summary-map/landmark-spatial-index.h>
+#include <localization-summary-map/localization-summary-map-creation.h>
 #include <localization-summary-map/localization-summary-map.h>
 #include <loop-closure-handler/loop-detector-node.h>
+#include <maplab-common/unique-id.h>
 #include <vio-common/vio-types.h>
 
+DEFINE_double(
+    rovioli_localization_map_tracking_radius_m, 0.0,
+    "If positive, the localizer switches to map tracking once it is "
+    "localized: only the landmarks within this radius around the last "
+    "localized position are queried, which keeps the query cost independent "
+    "of the size of the localization map.");
+DEFINE_int32(
+    rovioli_localization_map_tracking_max_failures, 5,
+    "Number of consecutive failed map tracking localizations after which the "
+    "localizer falls back to global localization.");
+DEFINE_bool(
+    rovioli_localization_map_tracking_reuse_tracked_matches, true,
+    "During map tracking, the keypoints that continue a feature track of an "
+    "inlier of the last localization keep its landmark and are not matched "
+    "against the map again.");
+DEFINE_double(
+    rovioli_localization_tile_radius_m, 30.0,
+    "With a tiled localization map, the tiles within this radius around the "
+    "last localized position are queried once the localizer is localized.");
+DEFINE_int32(
+    rovioli_localization_tile_memory_budget_mb, 512,
+    "Memory budget for the loaded tiles of a tiled localization map. At least "
+    "one tile is always loaded.");
+
 namespace rovioli {
+namespace {
+// The map tracking database covers a larger radius than the query radius, so
+// that it only needs to be rebuilt when the last localized position moved
+// more than half the query radius away from the center of the database.
+constexpr double kMapTrackingDatabaseRadiusFactor = 1.5;
+constexpr double kMapTrackingDatabaseRebuildDistanceFactor = 0.5;
+}  // namespace
 
 Localizer::Localizer(
     const summary_map::LocalizationSummaryMap& localization_summary_map,
     const bool visualize_localization)
-    : localization_summary_map_(localization_summary_map) {
+    : localization_summary_map_(&localization_summary_map),
+      tiled_localization_map_(nullptr),
+      map_tracking_radius_m_(FLAGS_rovioli_localization_map_tracking_radius_m),
+      p_G_map_tracking_database_center_(Eigen::Vector3d::Zero()),
+      num_consecutive_map_tracking_failures_(0),
+      tile_memory_budget_bytes_(0u),
+      loaded_tiles_num_bytes_(0u),
+      tile_use_counter_(0u),
+      global_search_tile_offset_(0u) {
   current_localization_mode_ = Localizer::LocalizationMode::kGlobal;
 
   global_loop_detector_.reset(new loop_detector_node::LoopDetectorNode);
@@ -21,8 +68,46 @@ Localizer::Localizer(
 
   LOG(INFO) << "Creating localization database...";
   global_loop_detector_->addLocalizationSummaryMapToDatabase(
-      localization_summary_map_);
+      *localization_summary_map_);
   LOG(INFO) << "Done.";
+
+  if (map_tracking_radius_m_ > 0.0) {
+    // A cell size of the query radius limits a query to 3x3x3 cells.
+    landmark_spatial_index_.reset(
+        new summary_map::LandmarkSpatialIndex(
+            localization_summary_map_->GLandmarkPosition(),
+            map_tracking_radius_m_));
+    map_tracking_loop_detector_.reset(new loop_detector_node::LoopDetectorNode);
+  }
+}
+
+Localizer::Localizer(
+    const summary_map::TiledLocalizationSummaryMap& tiled_localization_map,
+    const bool visualize_localization)
+    : localization_summary_map_(nullptr),
+      tiled_localization_map_(&tiled_localization_map),
+      map_tracking_radius_m_(FLAGS_rovioli_localization_tile_radius_m),
+      p_G_map_tracking_database_center_(Eigen::Vector3d::Zero()),
+      num_consecutive_map_tracking_failures_(0),
+      tile_memory_budget_bytes_(
+          static_cast<size_t>(
+              FLAGS_rovioli_localization_tile_memory_budget_mb) *
+          1024u * 1024u),
+      loaded_tiles_num_bytes_(0u),
+      tile_use_counter_(0u),
+      global_search_tile_offset_(0u) {
+  CHECK_GT(tiled_localization_map_->numTiles(), 0u);
+  CHECK_GE(map_tracking_radius_m_, 0.0);
+  CHECK_GT(FLAGS_rovioli_localization_tile_memory_budget_mb, 0);
+  current_localization_mode_ = Localizer::LocalizationMode::kGlobal;
+
+  global_loop_detector_.reset(new loop_detector_node::LoopDetectorNode);
+  if (visualize_localization) {
+    global_loop_detector_->instantiateVisualizer();
+  }
+  LOG(INFO) << "Localizing in " << tiled_localization_map_->numTiles()
+            << " tiles of " << tiled_localization_map_->tileSizeMeters()
+            << " m, which are loaded on demand.";
 }
 
 Localizer::LocalizationMode Localizer::getCurrentLocalizationMode() const {
@@ -31,46 +116,337 @@ Localizer::LocalizationMode Localizer::getCurrentLocalizationMode() const {
 
 bool Localizer::localizeNFrame(
     const aslam::VisualNFrame::ConstPtr& nframe,
-    vio::LocalizationResult* localization_result) const {
+    vio::LocalizationResult* localization_result) {
   CHECK(nframe);
   CHECK_NOTNULL(localization_result);
 
   bool result = false;
-  switch (current_localization_mode_) {
-    case Localizer::LocalizationMode::kGlobal:
-      result = localizeNFrameGlobal(nframe, &localization_result->T_G_I_lc_pnp);
-      break;
-    case Localizer::LocalizationMode::kMapTracking:
-      result =
-          localizeNFrameMapTracking(nframe, &localization_result->T_G_I_lc_pnp);
-      break;
-    default:
-      LOG(FATAL) << "Unknown localization mode.";
-      break;
+  if (tiled_localization_map_ != nullptr) {
+    result = localizeNFrameInTiles(nframe, &localization_result->T_G_I_lc_pnp);
+  } else {
+    switch (current_localization_mode_) {
+      case Localizer::LocalizationMode::kGlobal:
+        result =
+            localizeNFrameGlobal(nframe, &localization_result->T_G_I_lc_pnp);
+        break;
+      case Localizer::LocalizationMode::kMapTracking:
+        result = localizeNFrameMapTracking(
+            nframe, &localization_result->T_G_I_lc_pnp);
+        break;
+      default:
+        LOG(FATAL) << "Unknown localization mode.";
+        break;
+    }
   }
 
   localization_result->timestamp = nframe->getMinTimestampNanoseconds();
   localization_result->nframe_id = nframe->getId();
   localization_result->localization_type = current_localization_mode_;
+
+  updateLocalizationMode(result, localization_result->T_G_I_lc_pnp);
   return result;
 }
 
 bool Localizer::localizeNFrameGlobal(
     const aslam::VisualNFrame::ConstPtr& nframe,
     aslam::Transformation* T_G_I_lc_pnp) const {
+  CHECK_NOTNULL(localization_summary_map_);
   constexpr bool kSkipUntrackedKeypoints = false;
   unsigned int num_lc_matches;
   vi_map::VertexKeyPointToStructureMatchList inlier_structure_matches;
   return global_loop_detector_->findNFrameInSummaryMapDatabase(
-      *nframe, kSkipUntrackedKeypoints, localization_summary_map_, T_G_I_lc_pnp,
-      &num_lc_matches, &inlier_structure_matches);
+      *nframe, kSkipUntrackedKeypoints, *localization_summary_map_,
+      T_G_I_lc_pnp, &num_lc_matches, &inlier_structure_matches);
 }
 
 bool Localizer::localizeNFrameMapTracking(
-    const aslam::VisualNFrame::ConstPtr& /*nframe*/,
-    aslam::Transformation* /*T_G_I_lc_pnp*/) const {
-  LOG(FATAL) << "Not implemented yet.";
-  return false;
+    const aslam::VisualNFrame::ConstPtr& nframe,
+    aslam::Transformation* T_G_I_lc_pnp) {
+  CHECK(nframe);
+  CHECK_NOTNULL(T_G_I_lc_pnp);
+  CHECK(map_tracking_loop_detector_);
+
+  const Eigen::Vector3d p_G_prior = T_G_I_last_localization_.getPosition();
+  if (!map_tracking_summary_map_ ||
+      (p_G_prior - p_G_map_tracking_database_center_).norm() >
+          kMapTrackingDatabaseRebuildDistanceFactor * map_tracking_radius_m_) {
+    if (!rebuildMapTrackingDatabase(p_G_prior)) {
+      return false;
+    }
+  }
+
+  vi_map::VertexKeyPointToStructureMatchList tracked_structure_matches;
+  if (FLAGS_rovioli_localization_map_tracking_reuse_tracked_matches) {
+    getTrackedStructureMatches(*nframe, &tracked_structure_matches);
+  }
+
+  constexpr bool kSkipUntrackedKeypoints = false;
+  unsigned int num_lc_matches;
+  vi_map::VertexKeyPointToStructureMatchList inlier_structure_matches;
+  const bool success =
+      map_tracking_loop_detector_->findNFrameInSummaryMapDatabase(
+          *nframe, kSkipUntrackedKeypoints, *map_tracking_summary_map_,
+          tracked_structure_matches, T_G_I_lc_pnp, &num_lc_matches,
+          &inlier_structure_matches);
+  VLOG(3) << "Map tracking reused " << tracked_structure_matches.size()
+          << " tracked matches of " << num_lc_matches << " matches.";
+
+  if (success &&
+      FLAGS_rovioli_localization_map_tracking_reuse_tracked_matches) {
+    updateTrackedStructureMatches(*nframe, inlier_structure_matches);
+  } else {
+    tracked_structure_matches_.clear();
+  }
+  return success;
+}
+
+void Localizer::getTrackedStructureMatches(
+    const aslam::VisualNFrame& nframe,
+    vi_map::VertexKeyPointToStructureMatchList* structure_matches) const {
+  CHECK_NOTNULL(structure_matches)->clear();
+  CHECK(map_tracking_summary_map_);
+  const size_t num_frames =
+      std::min(nframe.getNumFrames(), tracked_structure_matches_.size());
+  for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+    const std::unordered_map<int, vi_map::VertexKeyPointToStructureMatch>&
+        frame_matches = tracked_structure_matches_[frame_idx];
+    if (frame_matches.empty() || !nframe.isFrameSet(frame_idx) ||
+        !nframe.isFrameValid(frame_idx) ||
+        !nframe.getFrame(frame_idx).hasTrackIds()) {
+      continue;
+    }
+    const Eigen::VectorXi& track_ids = nframe.getFrame(frame_idx).getTrackIds();
+    for (int keypoint_idx = 0; keypoint_idx < track_ids.rows();
+         ++keypoint_idx) {
+      const int track_id = track_ids(keypoint_idx);
+      if (track_id < 0) {
+        continue;
+      }
+      const std::unordered_map<int, vi_map::VertexKeyPointToStructureMatch>::
+          const_iterator it = frame_matches.find(track_id);
+      // The map tracking database may have been rebuilt without the landmark.
+      if (it == frame_matches.end() ||
+          !map_tracking_summary_map_->hasLandmark(it->second.landmark_result)) {
+        continue;
+      }
+      vi_map::VertexKeyPointToStructureMatch structure_match = it->second;
+      structure_match.keypoint_index_query = keypoint_idx;
+      structure_match.frame_index_query = frame_idx;
+      structure_matches->push_back(structure_match);
+    }
+  }
+}
+
+void Localizer::updateTrackedStructureMatches(
+    const aslam::VisualNFrame& nframe,
+    const vi_map::VertexKeyPointToStructureMatchList&
+        inlier_structure_matches) {
+  tracked_structure_matches_.clear();
+  tracked_structure_matches_.resize(nframe.getNumFrames());
+  for (const vi_map::VertexKeyPointToStructureMatch& structure_match :
+       inlier_structure_matches) {
+    const size_t frame_idx = structure_match.frame_index_query;
+    CHECK_LT(frame_idx, tracked_structure_matches_.size());
+    const aslam::VisualFrame& frame = nframe.getFrame(frame_idx);
+    if (!frame.hasTrackIds()) {
+      continue;
+    }
+    const int track_id =
+        frame.getTrackIds()(structure_match.keypoint_index_query);
+    if (track_id >= 0) {
+      // A keypoint can only keep one landmark.
+      tracked_structure_matches_[frame_idx].emplace(track_id, structure_match);
+    }
+  }
+}
+
+bool Localizer::rebuildMapTrackingDatabase(const Eigen::Vector3d& p_G_center) {
+  CHECK(landmark_spatial_index_);
+  CHECK(map_tracking_loop_detector_);
+  map_tracking_loop_detector_->clear();
+  map_tracking_summary_map_.reset();
+
+  std::vector<int> landmark_indices;
+  landmark_spatial_index_->getLandmarkIndicesWithinRadius(
+      p_G_center, kMapTrackingDatabaseRadiusFactor * map_tracking_radius_m_,
+      &landmark_indices);
+  if (landmark_indices.empty()) {
+    VLOG(1) << "No landmarks for map tracking around " << p_G_center.transpose()
+            << ".";
+    return false;
+  }
+
+  map_tracking_summary_map_.reset(new summary_map::LocalizationSummaryMap);
+  summary_map::LocalizationSummaryMapId summary_map_id;
+  common::generateId(&summary_map_id);
+  map_tracking_summary_map_->setId(summary_map_id);
+  summary_map::createLocalizationSummaryMapFromLandmarkIndices(
+      *localization_summary_map_, landmark_indices,
+      map_tracking_summary_map_.get());
+  map_tracking_loop_detector_->addLocalizationSummaryMapToDatabase(
+      *map_tracking_summary_map_);
+  p_G_map_tracking_database_center_ = p_G_center;
+  VLOG(3) << "Rebuilt the map tracking database with "
+          << landmark_indices.size() << " of "
+          << landmark_spatial_index_->numLandmarks() << " landmarks.";
+  return true;
+}
+
+bool Localizer::localizeNFrameInTiles(
+    const aslam::VisualNFrame::ConstPtr& nframe,
+    aslam::Transformation* T_G_I_lc_pnp) {
+  CHECK(nframe);
+  CHECK_NOTNULL(T_G_I_lc_pnp);
+  CHECK_NOTNULL(tiled_localization_map_);
+
+  std::vector<size_t> tile_indices;
+  if (current_localization_mode_ == LocalizationMode::kMapTracking) {
+    tiled_localization_map_->getTilesWithinRadius(
+        T_G_I_last_localization_.getPosition(), map_tracking_radius_m_,
+        &tile_indices);
+    limitTilesToMemoryBudget(&tile_indices);
+  } else {
+    getNextGlobalSearchTiles(&tile_indices);
+  }
+  if (tile_indices.empty() || !activateTiles(tile_indices)) {
+    return false;
+  }
+
+  constexpr bool kSkipUntrackedKeypoints = false;
+  unsigned int num_lc_matches;
+  vi_map::VertexKeyPointToStructureMatchList inlier_structure_matches;
+  return global_loop_detector_->findNFrameInSummaryMapDatabase(
+      *nframe, kSkipUntrackedKeypoints, *active_tiles_summary_map_,
+      T_G_I_lc_pnp, &num_lc_matches, &inlier_structure_matches);
+}
+
+void Localizer::getNextGlobalSearchTiles(std::vector<size_t>* tile_indices) {
+  CHECK_NOTNULL(tile_indices)->clear();
+  CHECK_NOTNULL(tiled_localization_map_);
+  // Before the first localization, the search starts at the origin.
+  std::vector<size_t> sorted_tile_indices;
+  tiled_localization_map_->getTilesSortedByDistance(
+      T_G_I_last_localization_.getPosition(), &sorted_tile_indices);
+  const size_t num_tiles = sorted_tile_indices.size();
+  if (global_search_tile_offset_ >= num_tiles) {
+    global_search_tile_offset_ = 0u;
+  }
+  tile_indices->assign(
+      sorted_tile_indices.begin() + global_search_tile_offset_,
+      sorted_tile_indices.end());
+  limitTilesToMemoryBudget(tile_indices);
+  global_search_tile_offset_ += tile_indices->size();
+}
+
+void Localizer::limitTilesToMemoryBudget(
+    std::vector<size_t>* tile_indices) const {
+  CHECK_NOTNULL(tile_indices);
+  CHECK_NOTNULL(tiled_localization_map_);
+  size_t num_bytes = 0u;
+  size_t num_tiles_within_budget = 0u;
+  for (const size_t tile_idx : *tile_indices) {
+    num_bytes += tiled_localization_map_->getTile(tile_idx).num_bytes;
+    if (num_tiles_within_budget > 0u && num_bytes > tile_memory_budget_bytes_) {
+      break;
+    }
+    ++num_tiles_within_budget;
+  }
+  tile_indices->resize(num_tiles_within_budget);
+}
+
+bool Localizer::activateTiles(const std::vector<size_t>& tile_indices) {
+  CHECK(!tile_indices.empty());
+  CHECK_NOTNULL(tiled_localization_map_);
+  std::vector<size_t> sorted_tile_indices = tile_indices;
+  std::sort(sorted_tile_indices.begin(), sorted_tile_indices.end());
+  ++tile_use_counter_;
+  for (const size_t tile_idx : sorted_tile_indices) {
+    LoadedTile& loaded_tile = loaded_tiles_[tile_idx];
+    loaded_tile.last_used = tile_use_counter_;
+    if (!loaded_tile.summary_map) {
+      loaded_tile.summary_map = tiled_localization_map_->loadTile(tile_idx);
+      if (!loaded_tile.summary_map) {
+        loaded_tiles_.erase(tile_idx);
+        return false;
+      }
+      loaded_tiles_num_bytes_ +=
+          tiled_localization_map_->getTile(tile_idx).num_bytes;
+    }
+  }
+  if (sorted_tile_indices == active_tile_indices_) {
+    return true;
+  }
+
+  // Evict the least recently used tiles that are not needed for this query.
+  while (loaded_tiles_num_bytes_ > tile_memory_budget_bytes_) {
+    std::unordered_map<size_t, LoadedTile>::iterator least_recently_used =
+        loaded_tiles_.end();
+    for (std::unordered_map<size_t, LoadedTile>::iterator it =
+             loaded_tiles_.begin();
+         it != loaded_tiles_.end(); ++it) {
+      if (it->second.last_used < tile_use_counter_ &&
+          (least_recently_used == loaded_tiles_.end() ||
+           it->second.last_used < least_recently_used->second.last_used)) {
+        least_recently_used = it;
+      }
+    }
+    if (least_recently_used == loaded_tiles_.end()) {
+      break;
+    }
+    loaded_tiles_num_bytes_ -=
+        tiled_localization_map_->getTile(least_recently_used->first).num_bytes;
+    loaded_tiles_.erase(least_recently_used);
+  }
+
+  std::vector<const summary_map::LocalizationSummaryMap*> tile_summary_maps;
+  tile_summary_maps.reserve(sorted_tile_indices.size());
+  for (const size_t tile_idx : sorted_tile_indices) {
+    tile_summary_maps.push_back(loaded_tiles_.at(tile_idx).summary_map.get());
+  }
+  active_tiles_summary_map_.reset(new summary_map::LocalizationSummaryMap);
+  summary_map::LocalizationSummaryMapId summary_map_id;
+  common::generateId(&summary_map_id);
+  active_tiles_summary_map_->setId(summary_map_id);
+  summary_map::mergeLocalizationSummaryMaps(
+      tile_summary_maps, active_tiles_summary_map_.get());
+
+  global_loop_detector_->clear();
+  global_loop_detector_->addLocalizationSummaryMapToDatabase(
+      *active_tiles_summary_map_);
+  active_tile_indices_.swap(sorted_tile_indices);
+  VLOG(3) << "Activated " << active_tile_indices_.size() << " tiles with "
+          << active_tiles_summary_map_->GLandmarkPosition().cols()
+          << " landmarks, " << loaded_tiles_.size() << " tiles are loaded.";
+  return true;
+}
+
+void Localizer::updateLocalizationMode(
+    const bool localization_success, const aslam::Transformation& T_G_I) {
+  if (!landmark_spatial_index_ && tiled_localization_map_ == nullptr) {
+    // Map tracking is disabled.
+    return;
+  }
+
+  if (localization_success) {
+    T_G_I_last_localization_ = T_G_I;
+    num_consecutive_map_tracking_failures_ = 0;
+    if (current_localization_mode_ == LocalizationMode::kGlobal) {
+      VLOG(1) << "Localized, switching to map tracking.";
+      current_localization_mode_ = LocalizationMode::kMapTracking;
+      global_search_tile_offset_ = 0u;
+    }
+    return;
+  }
+
+  if (current_localization_mode_ == LocalizationMode::kMapTracking &&
+      ++num_consecutive_map_tracking_failures_ >=
+          FLAGS_rovioli_localization_map_tracking_max_failures) {
+    VLOG(1) << "Map tracking failed " << num_consecutive_map_tracking_failures_
+            << " times in a row, switching to global localization.";
+    current_localization_mode_ = LocalizationMode::kGlobal;
+    num_consecutive_map_tracking_failures_ = 0;
+    tracked_structure_matches_.clear();
+  }
 }
 
 }  // namespace rovioli
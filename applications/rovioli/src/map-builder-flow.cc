@@ -1,11 +1,17 @@
 #include "rovioli/map-builder-flow.h"
 
+#include <algorithm>
 #include <functional>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <string>
 
 #include <landmark-triangulation/landmark-triangulation.h>
 #include <localization-summary-map/localization-summary-map-creation.h>
 #include <localization-summary-map/localization-summary-map.h>
 #include <maplab-common/file-logger.h>
+#include <maplab-common/file-system-tools.h>
 #include <maplab-common/map-manager-config.h>
 #include <mapping-workflows-plugin/localization-map-creation.h>
 #include <vi-map-helpers/vi-map-landmark-quality-evaluation.h>
@@ -17,6 +23,12 @@
 DEFINE_double(
     localization_map_keep_landmark_fraction, 0.0,
     "Fraction of landmarks to keep when creating a localization summary map.");
+DEFINE_int32(
+    rovioli_map_builder_segment_num_vertices, 0,
+    "If positive, the map is built in segments of this many vertices that are "
+    "saved to <save_map_folder>_segments and released from memory, and "
+    "stitched into one map on save. Requires a map folder. 0 keeps the whole "
+    "map in memory.");
 DECLARE_bool(rovioli_visualize_map);
 
 namespace rovioli {
@@ -24,13 +36,71 @@ namespace rovioli {
 MapBuilderFlow::MapBuilderFlow(
     const std::shared_ptr<aslam::NCamera>& n_camera, vi_map::Imu::UniquePtr imu,
     const std::string& save_map_folder)
-    : map_with_mutex_(aligned_shared<VIMapWithMutex>()),
-      mapping_terminated_(false),
-      stream_map_builder_(n_camera, std::move(imu), &map_with_mutex_->vi_map) {
-  if (!save_map_folder.empty()) {
-    VLOG(1) << "Set VIMap folder to: " << save_map_folder;
-    map_with_mutex_->vi_map.setMapFolder(save_map_folder);
+    : mapping_terminated_(false),
+      n_camera_(n_camera),
+      imu_(std::move(imu)),
+      save_map_folder_(save_map_folder),
+      segment_num_vertices_(
+          std::max(FLAGS_rovioli_map_builder_segment_num_vertices, 0)) {
+  CHECK(n_camera_);
+  CHECK(imu_);
+  CHECK(segment_num_vertices_ == 0u || !save_map_folder_.empty())
+      << "Building the map in segments requires a map folder.";
+  CHECK(segment_num_vertices_ == 0u || segment_num_vertices_ >= 2u);
+  startNewSegment();
+}
+
+void MapBuilderFlow::startNewSegment() {
+  map_with_mutex_ = aligned_shared<VIMapWithMutex>();
+  std::string map_folder = save_map_folder_;
+  if (segment_num_vertices_ > 0u) {
+    std::ostringstream segment_name;
+    segment_name << "segment_" << std::setfill('0') << std::setw(4)
+                 << saved_segment_folders_.size();
+    map_folder = common::concatenateFolderAndFileName(
+        save_map_folder_ + "_segments", segment_name.str());
   }
+  if (!map_folder.empty()) {
+    VLOG(1) << "Set VIMap folder to: " << map_folder;
+    map_with_mutex_->vi_map.setMapFolder(map_folder);
+  }
+  // Every segment is a mission with its own copy of the IMU.
+  stream_map_builder_.reset(
+      new online_map_builders::StreamMapBuilder(
+          n_camera_, vi_map::Imu::UniquePtr(new vi_map::Imu(*imu_)),
+          &map_with_mutex_->vi_map));
+}
+
+void MapBuilderFlow::flushSegment() {
+  CHECK(last_vio_update_);
+  initializeLandmarksOfResidentMission();
+
+  const std::string segment_folder = map_with_mutex_->vi_map.getMapFolder();
+  backend::SaveConfig save_config;
+  save_config.overwrite_existing_files = true;
+  CHECK(
+      vi_map::serialization::saveMapToFolder(
+          segment_folder, save_config, &map_with_mutex_->vi_map))
+      << "Failed to save the map segment to " << segment_folder << ".";
+  saved_segment_folders_.push_back(segment_folder);
+  VLOG(1) << "Saved map segment " << saved_segment_folders_.size() << " with "
+          << map_with_mutex_->vi_map.numVertices() << " vertices to "
+          << segment_folder << ".";
+
+  // The new segment starts at the last vertex of the flushed one, so that the
+  // IMU measurements up to the next vertex are kept.
+  startNewSegment();
+  constexpr bool kDeepCopyNFrame = false;
+  stream_map_builder_->apply(*last_vio_update_, kDeepCopyNFrame);
+}
+
+void MapBuilderFlow::initializeLandmarksOfResidentMission() {
+  VLOG(1) << "Initializing landmarks of created map.";
+  const vi_map::MissionId& mission_id = stream_map_builder_->getMissionId();
+  vi_map_helpers::VIMapManipulation manipulation(&map_with_mutex_->vi_map);
+  manipulation.initializeLandmarksFromUnusedFeatureTracksOfMission(mission_id);
+  landmark_triangulation::retriangulateLandmarksOfMission(
+      mission_id, &map_with_mutex_->vi_map);
 }
 
 void MapBuilderFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
@@ -43,7 +113,9 @@ void MapBuilderFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
       kSubscriberNodeName, message_flow::DeliveryOptions(),
       [this, map_publish_function](const vio::VioUpdate::ConstPtr& vio_update) {
         CHECK(vio_update != nullptr);
+        VIMapWithMutex::Ptr map_with_mutex;
         {
+          std::lock_guard<std::mutex> builder_lock(m_map_builder_);
           std::lock_guard<std::mutex> lock(map_with_mutex_->mutex);
           if (mapping_terminated_) {
             return;
@@ -52,9 +124,15 @@ void MapBuilderFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
           // current and previous frame; therefore the most recent VisualNFrame
           // added to the map might still be modified.
           constexpr bool kDeepCopyNFrame = false;
-          stream_map_builder_.apply(*vio_update, kDeepCopyNFrame);
+          stream_map_builder_->apply(*vio_update, kDeepCopyNFrame);
+          last_vio_update_ = vio_update;
+          map_with_mutex = map_with_mutex_;
+          if (segment_num_vertices_ > 0u &&
+              map_with_mutex_->vi_map.numVertices() >= segment_num_vertices_) {
+            flushSegment();
+          }
         }
-        map_publish_function(map_with_mutex_);
+        map_publish_function(map_with_mutex);
       });
 
   std::function<void(const vio::VioUpdate::ConstPtr&)>
@@ -91,13 +169,15 @@ void MapBuilderFlow::saveMapAndOptionallyOptimize(
     const std::string& path, const bool overwrite_existing_map,
     const bool process_to_localization_map) {
   CHECK(!path.empty());
-  CHECK(map_with_mutex_);
 
+  std::lock_guard<std::mutex> builder_lock(m_map_builder_);
+  CHECK(map_with_mutex_);
   std::lock_guard<std::mutex> lock(map_with_mutex_->mutex);
   mapping_terminated_ = true;
 
   // Early exit if the map is empty.
-  if (map_with_mutex_->vi_map.numVertices() < 3u) {
+  if (saved_segment_folders_.empty() &&
+      map_with_mutex_->vi_map.numVertices() < 3u) {
     LOG(WARNING) << "Map is empty; nothing will be saved.";
     return;
   }
@@ -107,20 +187,22 @@ void MapBuilderFlow::saveMapAndOptionallyOptimize(
     plotter = aligned_unique<visualization::ViwlsGraphRvizPlotter>();
   }
 
-  {
-    VLOG(1) << "Initializing landmarks of created map.";
-    // There should only be one mission in the map.
-    vi_map::MissionIdList mission_ids;
-    map_with_mutex_->vi_map.getAllMissionIds(&mission_ids);
-    CHECK_EQ(mission_ids.size(), 1u);
-    const vi_map::MissionId& id_of_first_mission = mission_ids.front();
-
-    vi_map_helpers::VIMapManipulation manipulation(&map_with_mutex_->vi_map);
-    manipulation.initializeLandmarksFromUnusedFeatureTracksOfMission(
-        id_of_first_mission);
-
-    landmark_triangulation::retriangulateLandmarksOfMission(
-        id_of_first_mission, &map_with_mutex_->vi_map);
+  // There should only be one mission in the resident map.
+  CHECK_EQ(map_with_mutex_->vi_map.numMissions(), 1u);
+  initializeLandmarksOfResidentMission();
+
+  // Stitch the flushed segments into the final map.
+  for (const std::string& segment_folder : saved_segment_folders_) {
+    vi_map::VIMap segment_map;
+    CHECK(
+        vi_map::serialization::loadMapFromFolder(segment_folder, &segment_map))
+        << "Failed to load the map segment from " << segment_folder << ".";
+    map_with_mutex_->vi_map.mergeAllMissionsFromMap(segment_map);
+  }
+  if (!saved_segment_folders_.empty()) {
+    LOG(INFO) << "Stitched " << saved_segment_folders_.size()
+              << " map segments into a map with "
+              << map_with_mutex_->vi_map.numMissions() << " missions.";
   }
 
   backend::SaveConfig save_config;
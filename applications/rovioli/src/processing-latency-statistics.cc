@@ -0,0 +1,93 @@
+#include "rovioli/processing-latency-statistics.h"
+
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include <glog/logging.h>
+
+namespace rovioli {
+namespace {
+const char* getProcessingStageName(vio::ProcessingStage stage) {
+  switch (stage) {
+    case vio::ProcessingStage::kImageReceived:
+      return "image-received";
+    case vio::ProcessingStage::kSynchronized:
+      return "synchronized";
+    case vio::ProcessingStage::kFeatureTracked:
+      return "feature-tracked";
+    case vio::ProcessingStage::kThrottled:
+      return "throttled";
+    case vio::ProcessingStage::kLocalized:
+      return "localized";
+    case vio::ProcessingStage::kEstimated:
+      return "estimated";
+    case vio::ProcessingStage::kPublished:
+      return "published";
+    default:
+      LOG(FATAL) << "Unknown processing stage " << static_cast<int>(stage);
+  }
+  return "";
+}
+}  // namespace
+
+void ProcessingLatencyStatistics::addSample(
+    const vio::ProcessingTimestamps& processing_timestamps) {
+  if (!processing_timestamps.has(vio::ProcessingStage::kImageReceived)) {
+    return;
+  }
+  const int64_t received_timestamp_ns =
+      processing_timestamps.get(vio::ProcessingStage::kImageReceived);
+  // The receive time itself is the reference, hence it has no latency.
+  for (size_t stage_idx = 1u; stage_idx < histograms_.size(); ++stage_idx) {
+    const vio::ProcessingStage stage =
+        static_cast<vio::ProcessingStage>(stage_idx);
+    if (processing_timestamps.has(stage)) {
+      const int64_t latency_ns =
+          processing_timestamps.get(stage) - received_timestamp_ns;
+      histograms_[stage_idx].addSample(
+          latency_ns > 0 ? static_cast<uint64_t>(latency_ns) : 0u);
+    }
+  }
+}
+
+std::string ProcessingLatencyStatistics::print() const {
+  constexpr size_t kNumAlignment = 20u;
+  constexpr size_t kNumAlignmentNumbers = 10u;
+  constexpr double kNanosecondsToMilliseconds = 1e-6;
+  std::stringstream output;
+  output << "Latencies of the " << name_
+         << " since the image was received [ms]:" << std::endl;
+  output << std::setiosflags(std::ios::left) << std::setw(kNumAlignment)
+         << "stage" << std::setw(kNumAlignmentNumbers) << "count"
+         << std::setw(kNumAlignmentNumbers) << "p50"
+         << std::setw(kNumAlignmentNumbers) << "p99"
+         << std::setw(kNumAlignmentNumbers) << "max" << std::endl;
+  output << std::fixed << std::setprecision(3);
+  for (size_t stage_idx = 1u; stage_idx < histograms_.size(); ++stage_idx) {
+    const common::histograms::ExponentialHistogram& histogram =
+        histograms_[stage_idx];
+    if (histogram.getNumSamples() == 0u) {
+      continue;
+    }
+    output << std::setw(kNumAlignment)
+           << getProcessingStageName(
+                  static_cast<vio::ProcessingStage>(stage_idx))
+           << std::setw(kNumAlignmentNumbers) << histogram.getNumSamples()
+           << std::setw(kNumAlignmentNumbers)
+           << histogram.getPercentile(50.0) * kNanosecondsToMilliseconds
+           << std::setw(kNumAlignmentNumbers)
+           << histogram.getPercentile(99.0) * kNanosecondsToMilliseconds
+           << std::setw(kNumAlignmentNumbers)
+           << histogram.getMax() * kNanosecondsToMilliseconds << std::endl;
+  }
+  return output.str();
+}
+
+void ProcessingLatencyStatistics::reset() {
+  for (common::histograms::ExponentialHistogram& histogram : histograms_) {
+    histogram.reset();
+  }
+}
+
+}  // namespace rovioli
@@ -1,5 +1,6 @@
 #include "rovioli/rovio-flow.h"
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <vector>
@@ -22,6 +23,20 @@ DEFINE_bool(
     "Update the filter state for IMU measurement; if false the IMU measurements"
     " are queued and the state is only forward propagated before the next "
     "update.");
+DEFINE_bool(
+    rovio_batch_imu_measurements, false,
+    "Batch the IMU measurements in a lock-free buffer and feed them to ROVIO "
+    "right before the next image or localization update instead of one by "
+    "one in the sensor exclusivity group. No estimates are published at IMU "
+    "rate in this mode.");
+DEFINE_int32(
+    rovio_imu_batch_capacity, 4096,
+    "Number of IMU measurements that can be batched before the oldest ones "
+    "are dropped.");
+DEFINE_double(
+    rovio_imu_batch_max_wait_ms, 5.0,
+    "Maximum time an image update waits for the IMU measurements up to its "
+    "timestamp if they are not yet batched.");
 DEFINE_string(
     rovio_active_camera_indices, "0",
     "Comma separated indices of cameras to use for motion tracking.");
@@ -38,7 +53,11 @@ void ensurePositiveQuaternion(aslam::Quaternion* quat) {
 
 RovioFlow::RovioFlow(
     const aslam::NCamera& camera_calibration,
-    const vi_map::ImuSigmas& imu_sigmas) {
+    const vi_map::ImuSigmas& imu_sigmas)
+    : batched_imu_measurements_(FLAGS_rovio_imu_batch_capacity),
+      last_fed_imu_timestamp_ns_(-1) {
+  CHECK_GT(FLAGS_rovio_imu_batch_capacity, 0);
+  CHECK_GE(FLAGS_rovio_imu_batch_max_wait_ms, 0.0);
   // Multi-camera support in ROVIO is still experimental. Therefore, only a
   // single camera will be used for motion tracking per default.
   const size_t num_cameras = camera_calibration.getNumCameras();
@@ -103,20 +122,29 @@ void RovioFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
       kExclusivityGroupIdRovioSensorSubscribers;
 
   // Input IMU.
-  flow->registerSubscriber<message_flow_topics::IMU_MEASUREMENTS>(
-      kSubscriberNodeName, rovio_subscriber_options,
-      [this](const vio::ImuMeasurement::ConstPtr& imu) {
-        // Do not apply the predictions but only queue them. They will be
-        // applied before the next update.
-        const bool measurement_accepted =
-            this->rovio_interface_->processImuUpdate(
-                imu->imu_data.head<3>(), imu->imu_data.tail<3>(),
-                aslam::time::to_seconds(imu->timestamp),
-                FLAGS_rovio_update_filter_on_imu);
-        LOG_IF(
-            WARNING, !measurement_accepted && rovio_interface_->isInitialized())
-            << "ROVIO rejected IMU measurement. Latency is too large.";
-      });
+  if (FLAGS_rovio_batch_imu_measurements) {
+    // The IMU subscriber only batches the measurements and therefore does
+    // not need to wait for the ROVIO updates of the exclusivity group.
+    flow->registerSubscriber<message_flow_topics::IMU_MEASUREMENTS>(
+        kSubscriberNodeName, message_flow::DeliveryOptions(),
+        [this](const vio::ImuMeasurement::ConstPtr& imu) {
+          CHECK(imu);
+          const bool dropped_oldest =
+              batched_imu_measurements_
+                  .PushNonBlockingDroppingOldestElementIfFull(
+                      imu, FLAGS_rovio_imu_batch_capacity);
+          LOG_IF_EVERY_N(WARNING, dropped_oldest, 100)
+              << "Dropped batched IMU measurements as no image or "
+              << "localization update drained them.";
+        });
+  } else {
+    flow->registerSubscriber<message_flow_topics::IMU_MEASUREMENTS>(
+        kSubscriberNodeName, rovio_subscriber_options,
+        [this](const vio::ImuMeasurement::ConstPtr& imu) {
+          CHECK(imu);
+          processImuMeasurement(*imu, FLAGS_rovio_update_filter_on_imu);
+        });
+  }
   // Input camera.
   flow->registerSubscriber<message_flow_topics::IMAGE_MEASUREMENTS>(
       kSubscriberNodeName, rovio_subscriber_options,
@@ -128,6 +156,16 @@ void RovioFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
           return;
         }
 
+        if (image->processing_timestamps.has(
+                vio::ProcessingStage::kImageReceived)) {
+          pending_image_received_timestamps_.emplace_back(
+              aslam::time::to_seconds(image->timestamp),
+              image->processing_timestamps.get(
+                  vio::ProcessingStage::kImageReceived));
+        }
+        if (FLAGS_rovio_batch_imu_measurements) {
+          feedBatchedImuMeasurements(image->timestamp);
+        }
         const bool measurement_accepted =
             this->rovio_interface_->processImageUpdate(
                 image->camera_index, image->image,
@@ -141,6 +179,9 @@ void RovioFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
       kSubscriberNodeName, rovio_subscriber_options,
       [this](const vio::LocalizationResult::ConstPtr& localization_result) {
         CHECK(localization_result);
+        if (FLAGS_rovio_batch_imu_measurements) {
+          feedBatchedImuMeasurements(localization_result->timestamp);
+        }
         // ROVIO coordinate frames:
         //  - J: Inertial frame of pose update
         //  - V: Body frame of pose update sensor
@@ -167,9 +208,49 @@ void RovioFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
       std::bind(&RovioFlow::processRovioUpdate, this, std::placeholders::_1));
 }
 
+void RovioFlow::processImuMeasurement(
+    const vio::ImuMeasurement& imu, bool update_filter) {
+  // If the filter is not updated, the predictions are only queued. They will
+  // be applied before the next update.
+  const bool measurement_accepted = rovio_interface_->processImuUpdate(
+      imu.imu_data.head<3>(), imu.imu_data.tail<3>(),
+      aslam::time::to_seconds(imu.timestamp), update_filter);
+  LOG_IF(WARNING, !measurement_accepted && rovio_interface_->isInitialized())
+      << "ROVIO rejected IMU measurement. Latency is too large.";
+  last_fed_imu_timestamp_ns_ =
+      std::max(last_fed_imu_timestamp_ns_, imu.timestamp);
+}
+
+void RovioFlow::feedBatchedImuMeasurements(const int64_t timestamp_ns) {
+  // The IMU subscriber is not part of the exclusivity group, so the
+  // measurements up to the update can still be in delivery. ROVIO can only
+  // process the update once it got the IMU measurements up to its timestamp.
+  const int64_t wait_deadline_ns =
+      aslam::time::nanoSecondsSinceEpoch() +
+      static_cast<int64_t>(FLAGS_rovio_imu_batch_max_wait_ms * 1e6);
+  vio::ImuMeasurement::ConstPtr imu;
+  while (true) {
+    if (!batched_imu_measurements_.PopNonBlocking(&imu)) {
+      const int64_t remaining_wait_ns =
+          wait_deadline_ns - aslam::time::nanoSecondsSinceEpoch();
+      if (last_fed_imu_timestamp_ns_ >= timestamp_ns ||
+          remaining_wait_ns <= 0 ||
+          !batched_imu_measurements_.PopTimeout(&imu, remaining_wait_ns)) {
+        break;
+      }
+    }
+    CHECK(imu);
+    // The filter is updated by the image or localization update that
+    // follows.
+    constexpr bool kUpdateFilter = false;
+    processImuMeasurement(*imu, kUpdateFilter);
+  }
+}
+
 void RovioFlow::processRovioUpdate(const rovio::RovioState& state) {
   if (!state.getIsInitialized()) {
     LOG(WARNING) << "ROVIO not yet initialized. Discarding state update.";
+    pending_image_received_timestamps_.clear();
     return;
   }
 
@@ -201,6 +282,23 @@ void RovioFlow::processRovioUpdate(const rovio::RovioState& state) {
     ensurePositiveQuaternion(&T_G_M.getRotation());
     rovio_estimate->T_G_M = T_G_M;
   }
+
+  // The estimate includes all images up to its timestamp. If there are
+  // several, the latency is measured from the earliest one.
+  bool includes_new_image = false;
+  while (!pending_image_received_timestamps_.empty() &&
+         pending_image_received_timestamps_.front().first <=
+             rovio_estimate->timestamp_s) {
+    if (!includes_new_image) {
+      rovio_estimate->processing_timestamps.set(
+          vio::ProcessingStage::kImageReceived,
+          pending_image_received_timestamps_.front().second);
+      includes_new_image = true;
+    }
+    pending_image_received_timestamps_.pop_front();
+  }
+  rovio_estimate->processing_timestamps.stamp(
+      vio::ProcessingStage::kEstimated);
   publish_rovio_estimates_(rovio_estimate);
 }
 }  // namespace rovioli
@@ -27,9 +27,13 @@ RovioliNode::RovioliNode(
     const vi_map::ImuSigmas& rovio_imu_sigmas,
     const std::string& save_map_folder,
     const summary_map::LocalizationSummaryMap* const localization_map,
+    const summary_map::TiledLocalizationSummaryMap* const
+        tiled_localization_map,
     message_flow::MessageFlow* flow)
     : is_datasource_exhausted_(false) {
-  // localization_summary_map is optional and can be a nullptr.
+  // The localization maps are optional and can be nullptrs, at most one of
+  // them may be set.
+  CHECK(localization_map == nullptr || tiled_localization_map == nullptr);
   CHECK(camera_system);
   CHECK(maplab_imu_sensor);
   CHECK_NOTNULL(flow);
@@ -43,14 +47,20 @@ RovioliNode::RovioliNode(
   rovio_flow_.reset(new RovioFlow(*camera_system, rovio_imu_sigmas));
   rovio_flow_->attachToMessageFlow(flow);
 
-  const bool localization_enabled = localization_map != nullptr;
+  const bool localization_enabled =
+      localization_map != nullptr || tiled_localization_map != nullptr;
   if (FLAGS_rovioli_run_map_builder || localization_enabled) {
     // If there's no localization and no map should be built, no maplab feature
     // tracking is needed.
     if (localization_enabled) {
       constexpr bool kVisualizeLocalization = true;
-      localizer_flow_.reset(
-          new LocalizerFlow(*localization_map, kVisualizeLocalization));
+      if (tiled_localization_map != nullptr) {
+        localizer_flow_.reset(
+            new LocalizerFlow(*tiled_localization_map, kVisualizeLocalization));
+      } else {
+        localizer_flow_.reset(
+            new LocalizerFlow(*localization_map, kVisualizeLocalization));
+      }
       localizer_flow_->attachToMessageFlow(flow);
     }
 
@@ -1,19 +1,65 @@
 #include "rovioli/synced-nframe-throttler.h"
 
+#include <algorithm>
+
 #include <maplab-common/conversions.h>
 
 DEFINE_double(
     vio_throttler_max_output_frequency_hz, 1.0,
     "Maximum output frequency of the synchronized IMU-NFrame structures "
     "from the synchronizer.");
+DEFINE_bool(
+    vio_throttler_adaptive, false,
+    "Adapt the output frequency of the throttler to the processing latency "
+    "and queue depth of the downstream consumers, between "
+    "--vio_throttler_min_output_frequency_hz and "
+    "--vio_throttler_max_output_frequency_hz.");
+DEFINE_double(
+    vio_throttler_min_output_frequency_hz, 0.2,
+    "Minimum output frequency of the adaptive throttler.");
+DEFINE_double(
+    vio_throttler_adaptive_target_latency_ms, 200.0,
+    "The adaptive throttler reduces the output frequency while the "
+    "downstream processing of the forwarded nframes takes longer than this.");
+DEFINE_int32(
+    vio_throttler_adaptive_max_queue_depth, 1,
+    "The adaptive throttler reduces the output frequency while more "
+    "forwarded nframes than this are waiting to be processed.");
 
 namespace rovioli {
+namespace {
+// Multiplicative decrease on overload and a slower multiplicative increase
+// while the consumers keep up with margin, such that the frequency settles
+// just below the load limit.
+constexpr double kFrequencyDecreaseFactor = 0.7;
+constexpr double kFrequencyIncreaseFactor = 1.05;
+constexpr double kLatencyMarginForIncrease = 0.5;
+constexpr int64_t kReportIntervalNs =
+    static_cast<int64_t>(10 * kSecondsToNanoSeconds);
+}  // namespace
 
 SyncedNFrameThrottler::SyncedNFrameThrottler()
-    : min_nframe_timestamp_diff_ns_(
-          kSecondsToNanoSeconds / FLAGS_vio_throttler_max_output_frequency_hz),
-      previous_nframe_timestamp_ns_(-1) {
+    : is_adaptive_(FLAGS_vio_throttler_adaptive),
+      min_output_frequency_hz_(
+          is_adaptive_ ? FLAGS_vio_throttler_min_output_frequency_hz
+                       : FLAGS_vio_throttler_max_output_frequency_hz),
+      max_output_frequency_hz_(FLAGS_vio_throttler_max_output_frequency_hz),
+      target_latency_ns_(
+          static_cast<int64_t>(
+              FLAGS_vio_throttler_adaptive_target_latency_ms *
+              kMilliSecondsToNanoSeconds)),
+      output_frequency_hz_(0.0),
+      min_nframe_timestamp_diff_ns_(0),
+      previous_nframe_timestamp_ns_(-1),
+      report_interval_start_timestamp_ns_(-1),
+      num_nframes_in_report_interval_(0u),
+      effective_output_frequency_hz_(0.0) {
   CHECK_GT(FLAGS_vio_throttler_max_output_frequency_hz, 0.);
+  CHECK_GT(min_output_frequency_hz_, 0.);
+  CHECK_LE(min_output_frequency_hz_, max_output_frequency_hz_);
+  CHECK_GT(target_latency_ns_, 0);
+  CHECK_GE(FLAGS_vio_throttler_adaptive_max_queue_depth, 0);
+  setOutputFrequencyHz(max_output_frequency_hz_);
 }
 
 bool SyncedNFrameThrottler::shouldPublishNFrame(
@@ -23,21 +69,96 @@ bool SyncedNFrameThrottler::shouldPublishNFrame(
   const int64_t current_timestamp =
       synced_nframe_imu->nframe->getMinTimestampNanoseconds();
 
-  std::unique_lock<std::mutex> lock(m_previous_nframe_timestamp_ns_);
-  if (previous_nframe_timestamp_ns_ == -1) {
-    previous_nframe_timestamp_ns_ = current_timestamp;
-    return true;
-  }
-
-  CHECK_GE(previous_nframe_timestamp_ns_, 0);
-  CHECK_GT(current_timestamp, previous_nframe_timestamp_ns_);
-  if (current_timestamp - previous_nframe_timestamp_ns_ <
-      min_nframe_timestamp_diff_ns_) {
-    return false;
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (previous_nframe_timestamp_ns_ != -1) {
+    CHECK_GE(previous_nframe_timestamp_ns_, 0);
+    CHECK_GT(current_timestamp, previous_nframe_timestamp_ns_);
+    if (current_timestamp - previous_nframe_timestamp_ns_ <
+        min_nframe_timestamp_diff_ns_) {
+      return false;
+    }
   }
 
   previous_nframe_timestamp_ns_ = current_timestamp;
+  if (is_adaptive_) {
+    queued_nframe_timestamps_ns_.push_back(current_timestamp);
+  }
+  updateEffectiveOutputFrequency(current_timestamp);
   return true;
 }
 
+void SyncedNFrameThrottler::reportProcessedNFrame(
+    const int64_t nframe_timestamp_ns, const int64_t processing_latency_ns) {
+  if (!is_adaptive_) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  // The consumers may skip nframes, e.g. the asynchronous localization, so
+  // every nframe up to the processed one has left the queue.
+  while (!queued_nframe_timestamps_ns_.empty() &&
+         queued_nframe_timestamps_ns_.front() <= nframe_timestamp_ns) {
+    queued_nframe_timestamps_ns_.pop_front();
+  }
+  const size_t queue_depth = queued_nframe_timestamps_ns_.size();
+
+  if (processing_latency_ns > target_latency_ns_ ||
+      queue_depth >
+          static_cast<size_t>(FLAGS_vio_throttler_adaptive_max_queue_depth)) {
+    setOutputFrequencyHz(output_frequency_hz_ * kFrequencyDecreaseFactor);
+  } else if (
+      processing_latency_ns < kLatencyMarginForIncrease * target_latency_ns_ &&
+      queue_depth == 0u) {
+    setOutputFrequencyHz(output_frequency_hz_ * kFrequencyIncreaseFactor);
+  }
+}
+
+double SyncedNFrameThrottler::getOutputFrequencyHz() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return output_frequency_hz_;
+}
+
+double SyncedNFrameThrottler::getEffectiveOutputFrequencyHz() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return effective_output_frequency_hz_;
+}
+
+void SyncedNFrameThrottler::setOutputFrequencyHz(
+    const double output_frequency_hz) {
+  const double previous_output_frequency_hz = output_frequency_hz_;
+  output_frequency_hz_ = std::min(
+      max_output_frequency_hz_,
+      std::max(min_output_frequency_hz_, output_frequency_hz));
+  min_nframe_timestamp_diff_ns_ =
+      static_cast<int64_t>(kSecondsToNanoSeconds / output_frequency_hz_);
+  if (output_frequency_hz_ != previous_output_frequency_hz) {
+    VLOG(3) << "Throttler output frequency: " << output_frequency_hz_
+            << " Hz.";
+  }
+}
+
+void SyncedNFrameThrottler::updateEffectiveOutputFrequency(
+    const int64_t nframe_timestamp_ns) {
+  if (report_interval_start_timestamp_ns_ == -1) {
+    report_interval_start_timestamp_ns_ = nframe_timestamp_ns;
+    return;
+  }
+  ++num_nframes_in_report_interval_;
+  const int64_t interval_ns =
+      nframe_timestamp_ns - report_interval_start_timestamp_ns_;
+  if (interval_ns < kReportIntervalNs) {
+    return;
+  }
+  effective_output_frequency_hz_ =
+      num_nframes_in_report_interval_ * kSecondsToNanoSeconds /
+      static_cast<double>(interval_ns);
+  if (is_adaptive_) {
+    LOG(INFO) << "Throttler effective output frequency: "
+              << effective_output_frequency_hz_ << " Hz, maximum: "
+              << output_frequency_hz_ << " Hz, queued nframes: "
+              << queued_nframe_timestamps_ns_.size() << ".";
+  }
+  report_interval_start_timestamp_ns_ = nframe_timestamp_ns;
+  num_nframes_in_report_interval_ = 0u;
+}
+
 }  // namespace rovioli
@@ -150,6 +150,9 @@ void VioUpdateBuilder::findMatchAndPublish() {
     last_localization_state_ = vio::LocalizationState::kUninitialized;
   }
 
+  oldest_unmatched_synced_nframe->processing_timestamps.stamp(
+      vio::ProcessingStage::kEstimated);
+
   // Publish VIO update.
   CHECK(vio_update_publish_function_);
   vio_update_publish_function_(vio_update);
@@ -1,3 +1,4 @@
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
 #include <localization-summary-map/localization-summary-map-creation.h>
 #include <localization-summary-map/localization-summary-map.h>
@@ -8,6 +9,9 @@
 
 #include "rovioli/localizer.h"
 
+DECLARE_double(rovioli_localization_map_tracking_radius_m);
+DECLARE_bool(rovioli_localization_map_tracking_reuse_tracked_matches);
+
 namespace rovioli {
 
 class ViMappingTest : public ::testing::Test {
@@ -32,6 +36,11 @@ class ViMappingTest : public ::testing::Test {
     localizer_.reset(new Localizer(summary_map_, kVisualizeLocalization));
   }
 
+  Localizer::LocalizationMode getCurrentLocalizationMode() const {
+    CHECK(localizer_);
+    return localizer_->getCurrentLocalizationMode();
+  }
+
   double evaluateRecall() {
     const vi_map::VIMap& vi_map = *test_app_.getMapMutable();
 
@@ -74,6 +83,30 @@ TEST_F(ViMappingTest, LocalizerWithSummaryMapWorks) {
   EXPECT_GT(recall, kRecallThreshold);
 }
 
+TEST_F(ViMappingTest, LocalizerWithMapTrackingWorks) {
+  FLAGS_rovioli_localization_map_tracking_radius_m = 10.0;
+  createSummaryMapAndInitLocalizer();
+  const double recall = evaluateRecall();
+  FLAGS_rovioli_localization_map_tracking_radius_m = 0.0;
+
+  constexpr double kRecallThreshold = 0.6;
+  EXPECT_GT(recall, kRecallThreshold);
+  EXPECT_EQ(
+      Localizer::LocalizationMode::kMapTracking, getCurrentLocalizationMode());
+}
+
+TEST_F(ViMappingTest, LocalizerWithMapTrackingWithoutTrackedMatchesWorks) {
+  FLAGS_rovioli_localization_map_tracking_radius_m = 10.0;
+  FLAGS_rovioli_localization_map_tracking_reuse_tracked_matches = false;
+  createSummaryMapAndInitLocalizer();
+  const double recall = evaluateRecall();
+  FLAGS_rovioli_localization_map_tracking_radius_m = 0.0;
+  FLAGS_rovioli_localization_map_tracking_reuse_tracked_matches = true;
+
+  constexpr double kRecallThreshold = 0.6;
+  EXPECT_GT(recall, kRecallThreshold);
+}
+
 }  // namespace rovioli
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,115 @@
+#include <aslam/cameras/ncamera.h>
+#include <aslam/frames/visual-nframe.h>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <maplab-common/conversions.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "rovioli/synced-nframe-throttler.h"
+
+DECLARE_bool(vio_throttler_adaptive);
+DECLARE_double(vio_throttler_max_output_frequency_hz);
+DECLARE_double(vio_throttler_min_output_frequency_hz);
+DECLARE_double(vio_throttler_adaptive_target_latency_ms);
+
+namespace rovioli {
+
+class SyncedNFrameThrottlerTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    constexpr size_t kNumCameras = 1u;
+    n_camera_ = aslam::NCamera::createTestNCamera(kNumCameras);
+    FLAGS_vio_throttler_max_output_frequency_hz = 10.0;
+    FLAGS_vio_throttler_min_output_frequency_hz = 1.0;
+    FLAGS_vio_throttler_adaptive_target_latency_ms = 100.0;
+  }
+
+  virtual void TearDown() {
+    FLAGS_vio_throttler_adaptive = false;
+    FLAGS_vio_throttler_max_output_frequency_hz = 1.0;
+    FLAGS_vio_throttler_min_output_frequency_hz = 0.2;
+    FLAGS_vio_throttler_adaptive_target_latency_ms = 200.0;
+  }
+
+  vio::SynchronizedNFrameImu::ConstPtr createNFrame(
+      const int64_t timestamp_ns) const {
+    vio::SynchronizedNFrameImu::Ptr synced_nframe_imu =
+        aligned_shared<vio::SynchronizedNFrameImu>();
+    synced_nframe_imu->nframe =
+        aslam::VisualNFrame::createEmptyTestVisualNFrame(
+            n_camera_, timestamp_ns);
+    return synced_nframe_imu;
+  }
+
+  // Feeds nframes at 100 Hz for the given duration and reports every
+  // forwarded nframe as processed with the given latency. Returns the number
+  // of forwarded nframes.
+  size_t feedNFrames(
+      const int64_t duration_ns, const int64_t processing_latency_ns,
+      SyncedNFrameThrottler* throttler) {
+    CHECK_NOTNULL(throttler);
+    constexpr int64_t kNFrameIntervalNs = 10 * kMilliSecondsToNanoSeconds;
+    size_t num_forwarded = 0u;
+    const int64_t end_timestamp_ns = timestamp_ns_ + duration_ns;
+    for (; timestamp_ns_ < end_timestamp_ns;
+         timestamp_ns_ += kNFrameIntervalNs) {
+      if (throttler->shouldPublishNFrame(createNFrame(timestamp_ns_))) {
+        ++num_forwarded;
+        throttler->reportProcessedNFrame(timestamp_ns_, processing_latency_ns);
+      }
+    }
+    return num_forwarded;
+  }
+
+  aslam::NCamera::Ptr n_camera_;
+  int64_t timestamp_ns_ = 1;
+};
+
+TEST_F(SyncedNFrameThrottlerTest, FixedRate) {
+  SyncedNFrameThrottler throttler;
+  constexpr int64_t kHighLatencyNs = 1000 * kMilliSecondsToNanoSeconds;
+  const size_t num_forwarded = feedNFrames(
+      static_cast<int64_t>(10 * kSecondsToNanoSeconds), kHighLatencyNs,
+      &throttler);
+  EXPECT_NEAR(100u, num_forwarded, 1u);
+  EXPECT_DOUBLE_EQ(10.0, throttler.getOutputFrequencyHz());
+}
+
+TEST_F(SyncedNFrameThrottlerTest, AdaptiveRateFollowsLatency) {
+  FLAGS_vio_throttler_adaptive = true;
+  SyncedNFrameThrottler throttler;
+  EXPECT_DOUBLE_EQ(10.0, throttler.getOutputFrequencyHz());
+
+  // Overloaded consumers reduce the rate down to the minimum.
+  constexpr int64_t kHighLatencyNs = 1000 * kMilliSecondsToNanoSeconds;
+  feedNFrames(
+      static_cast<int64_t>(35 * kSecondsToNanoSeconds), kHighLatencyNs,
+      &throttler);
+  EXPECT_DOUBLE_EQ(1.0, throttler.getOutputFrequencyHz());
+  EXPECT_NEAR(1.0, throttler.getEffectiveOutputFrequencyHz(), 0.2);
+
+  // Idle consumers raise it again up to the maximum.
+  constexpr int64_t kLowLatencyNs = 10 * kMilliSecondsToNanoSeconds;
+  feedNFrames(
+      static_cast<int64_t>(60 * kSecondsToNanoSeconds), kLowLatencyNs,
+      &throttler);
+  EXPECT_DOUBLE_EQ(10.0, throttler.getOutputFrequencyHz());
+}
+
+TEST_F(SyncedNFrameThrottlerTest, AdaptiveRateFollowsQueueDepth) {
+  FLAGS_vio_throttler_adaptive = true;
+  SyncedNFrameThrottler throttler;
+  int64_t timestamp_ns = 1;
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(throttler.shouldPublishNFrame(createNFrame(timestamp_ns)));
+    timestamp_ns += static_cast<int64_t>(kSecondsToNanoSeconds);
+  }
+  // Two forwarded nframes are still queued after the first one is processed.
+  constexpr int64_t kLowLatencyNs = 10 * kMilliSecondsToNanoSeconds;
+  throttler.reportProcessedNFrame(1, kLowLatencyNs);
+  EXPECT_LT(throttler.getOutputFrequencyHz(), 10.0);
+}
+
+}  // namespace rovioli
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,78 @@
+#ifndef MAP_MANAGER_BACKGROUND_MAP_SAVE_INL_H_
+#define MAP_MANAGER_BACKGROUND_MAP_SAVE_INL_H_
+
+#include <chrono>  // NOLINT
+#include <string>
+#include <utility>
+
+#include <glog/logging.h>
+#include <maplab-common/map-traits.h>
+
+namespace backend {
+
+template <typename MapType>
+BackgroundMapSave<MapType>::BackgroundMapSave(
+    const std::string& key, const std::string& folder_path,
+    const SaveConfig& config, AlignedUniquePtr<MapType> snapshot)
+    : key_(key),
+      folder_path_(folder_path),
+      config_(config),
+      snapshot_(std::move(snapshot)),
+      start_time_(std::chrono::steady_clock::now()),
+      is_saved_successfully_(false),
+      is_done_(false) {
+  CHECK(!key_.empty());
+  CHECK(!folder_path_.empty());
+  CHECK(snapshot_ != nullptr);
+  // Started last, all members must be initialized.
+  save_thread_ = std::thread(&BackgroundMapSave<MapType>::save, this);
+}
+
+template <typename MapType>
+BackgroundMapSave<MapType>::~BackgroundMapSave() {
+  if (!is_done_) {
+    LOG(INFO) << "Waiting for the background save of map \"" << key_
+              << "\" to " << folder_path_ << " to finish.";
+  }
+  wait();
+}
+
+template <typename MapType>
+double BackgroundMapSave<MapType>::getElapsedSeconds() const {
+  const std::chrono::steady_clock::time_point end_time =
+      is_done_ ? end_time_ : std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end_time - start_time_).count();
+}
+
+template <typename MapType>
+bool BackgroundMapSave<MapType>::wait() {
+  if (save_thread_.joinable()) {
+    save_thread_.join();
+  }
+  CHECK(is_done_);
+  return is_saved_successfully_;
+}
+
+template <typename MapType>
+void BackgroundMapSave<MapType>::save() {
+  VLOG(1) << "Saving map \"" << key_ << "\" to " << folder_path_
+          << " in the background.";
+  is_saved_successfully_ =
+      traits<MapType>::saveToFolder(folder_path_, config_, snapshot_.get());
+  // The snapshot isn't needed anymore, free it right away.
+  snapshot_.reset();
+  end_time_ = std::chrono::steady_clock::now();
+  is_done_ = true;
+
+  if (is_saved_successfully_) {
+    LOG(INFO) << "Saved map \"" << key_ << "\" to " << folder_path_ << " in "
+              << getElapsedSeconds() << " s in the background.";
+  } else {
+    LOG(ERROR) << "Saving map \"" << key_ << "\" to " << folder_path_
+               << " in the background failed.";
+  }
+}
+
+}  // namespace backend
+
+#endif  // MAP_MANAGER_BACKGROUND_MAP_SAVE_INL_H_
@@ -0,0 +1,79 @@
+#ifndef MAP_MANAGER_BACKGROUND_MAP_SAVE_H_
+#define MAP_MANAGER_BACKGROUND_MAP_SAVE_H_
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+
+#include <aslam/common/memory.h>
+#include <maplab-common/macros.h>
+#include <maplab-common/map-manager-config.h>
+
+namespace backend {
+
+/// \brief A map save that runs on a thread of its own.
+///
+/// Saves a snapshot of the map, so that the map in the storage can be used
+/// and modified while the snapshot is written. See
+/// MapManager::saveMapToFolderInBackground(). Waits for the save to finish
+/// when destroyed.
+/// \tparam MapType Type of the map.
+template <typename MapType>
+class BackgroundMapSave {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(BackgroundMapSave);
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(BackgroundMapSave);
+
+  /// \brief Starts saving the snapshot.
+  /// \param key Key of the map the snapshot was taken of.
+  /// \param folder_path Folder in which the snapshot is saved.
+  /// \param config Save config, see MapManager::saveMapToFolder().
+  /// \param snapshot Copy of the map, owned by the save from now on.
+  BackgroundMapSave(
+      const std::string& key, const std::string& folder_path,
+      const SaveConfig& config, AlignedUniquePtr<MapType> snapshot);
+  ~BackgroundMapSave();
+
+  const std::string& getMapKey() const {
+    return key_;
+  }
+  const std::string& getFolderPath() const {
+    return folder_path_;
+  }
+
+  /// \brief Checks if the save has finished, successfully or not.
+  bool isDone() const {
+    return is_done_;
+  }
+
+  /// \brief Seconds since the save has been started, or how long it took if
+  /// it has finished.
+  double getElapsedSeconds() const;
+
+  /// \brief Blocks until the save has finished.
+  /// \returns True if the snapshot was saved successfully.
+  bool wait();
+
+ private:
+  void save();
+
+  const std::string key_;
+  const std::string folder_path_;
+  const SaveConfig config_;
+  AlignedUniquePtr<MapType> snapshot_;
+
+  const std::chrono::steady_clock::time_point start_time_;
+  // Written by the save thread before is_done_ is set.
+  std::chrono::steady_clock::time_point end_time_;
+  bool is_saved_successfully_;
+  std::atomic<bool> is_done_;
+
+  std::thread save_thread_;
+};
+
+}  // namespace backend
+
+#include "map-manager/background-map-save-inl.h"
+
+#endif  // MAP_MANAGER_BACKGROUND_MAP_SAVE_H_
@@ -1,7 +1,8 @@
 #ifndef MAP_MANAGER_MAP_MANAGER_INL_H_
 #define MAP_MANAGER_MAP_MANAGER_INL_H_
 
-#include <chrono>    // NOLINT
+#include <chrono>  // NOLINT
+#include <functional>
 #include <iostream>  // NOLINT
 #include <memory>
 #include <sstream>
@@ -13,17 +14,28 @@
 #include <vector>
 
 #include <aslam/common/reader-writer-lock.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <maplab-common/file-system-tools.h>
 #include <maplab-common/map-manager-config.h>
 #include <maplab-common/map-traits.h>
+#include <maplab-common/parallel-process.h>
 #include <maplab-common/proto-serialization-helper.h>
 #include <maplab-common/text-formatting.h>
 
 #include "map-manager/map-manager.h"
 #include "map-manager/map-storage.h"
 
+DECLARE_uint64(map_manager_num_load_threads);
+
 namespace backend {
+namespace internal {
+inline size_t getNumLoadAndMergeThreads() {
+  return FLAGS_map_manager_num_load_threads > 0u
+             ? FLAGS_map_manager_num_load_threads
+             : common::getNumHardwareThreads();
+}
+}  // namespace internal
 
 template <typename MapType>
 MapManager<MapType>::MapManager()
@@ -55,6 +67,72 @@ MapManager<MapType>::getMapReadAccess(const std::string& key) const {
   return map_storage_->getMapReadAccess(key);
 }
 
+template <typename MapType>
+template <bool kIsWriteAccess>
+MapManager<MapType>::MissionAccess<kIsWriteAccess>::MissionAccess(
+    typename MapStorage<MapType>::MapAndMutex* map_handle,
+    aslam::ReaderWriterMutex* mission_mutex)
+    : map_(CHECK_NOTNULL(map_handle)->map.get()),
+      map_handle_(map_handle),
+      mission_mutex_(CHECK_NOTNULL(mission_mutex)) {}
+
+template <typename MapType>
+template <bool kIsWriteAccess>
+MapManager<MapType>::MissionAccess<kIsWriteAccess>::MissionAccess(
+    MissionAccess&& other)
+    : map_(other.map_),
+      map_handle_(other.map_handle_),
+      mission_mutex_(other.mission_mutex_) {
+  other.map_ = nullptr;
+  other.map_handle_ = nullptr;
+  other.mission_mutex_ = nullptr;
+}
+
+template <typename MapType>
+template <bool kIsWriteAccess>
+MapManager<MapType>::MissionAccess<kIsWriteAccess>::~MissionAccess() {
+  if (map_handle_ == nullptr) {
+    // Moved from.
+    return;
+  }
+  if (kIsWriteAccess) {
+    mission_mutex_->releaseWriteLock();
+  } else {
+    mission_mutex_->releaseReadLock();
+  }
+  map_handle_->releaseMissionAccess();
+}
+
+template <typename MapType>
+template <typename MissionIdType>
+typename MapManager<MapType>::MissionWriteAccess
+MapManager<MapType>::getMissionWriteAccess(
+    const std::string& key, const MissionIdType& mission_id) {
+  aslam::ScopedReadLock lock(map_storage_->getContainerMutex());
+  typename MapStorage<MapType>::MapAndMutex* map_handle =
+      map_storage_->getMapAndMutex(key);
+  map_handle->acquireMissionAccess();
+  aslam::ReaderWriterMutex* mission_mutex = CHECK_NOTNULL(
+      traits<MapType>::getMissionMutex(*map_handle->map, mission_id));
+  mission_mutex->acquireWriteLock();
+  return MissionWriteAccess(map_handle, mission_mutex);
+}
+
+template <typename MapType>
+template <typename MissionIdType>
+typename MapManager<MapType>::MissionReadAccess
+MapManager<MapType>::getMissionReadAccess(
+    const std::string& key, const MissionIdType& mission_id) const {
+  aslam::ScopedReadLock lock(map_storage_->getContainerMutex());
+  typename MapStorage<MapType>::MapAndMutex* map_handle =
+      map_storage_->getMapAndMutex(key);
+  map_handle->acquireMissionAccess();
+  aslam::ReaderWriterMutex* mission_mutex = CHECK_NOTNULL(
+      traits<MapType>::getMissionMutex(*map_handle->map, mission_id));
+  mission_mutex->acquireReadLock();
+  return MissionReadAccess(map_handle, mission_mutex);
+}
+
 template <typename MapType>
 bool MapManager<MapType>::hasMap(const std::string& key) const {
   aslam::ScopedReadLock lock(map_storage_->getContainerMutex());
@@ -170,6 +248,63 @@ void MapManager<MapType>::mergeMaps(
       *source_map_merge_from, source_map_merge_base.get());
 }
 
+template <typename MapType>
+void MapManager<MapType>::mergeAndDeleteMap(
+    const std::string& source_key_merge_base,
+    const std::string& source_key_merge_from) {
+  CHECK(source_key_merge_base != source_key_merge_from)
+      << "Cannot merge maps because the two map keys are identical (\""
+      << source_key_merge_base << "\").";
+  CHECK(hasMap(source_key_merge_base)) << "Source map key \""
+                                       << source_key_merge_base
+                                       << "\" doesn't exist.";
+  AlignedUniquePtr<MapType> source_map_merge_from =
+      releaseMap(source_key_merge_from);
+  MapWriteAccess source_map_merge_base =
+      getMapWriteAccess(source_key_merge_base);
+  traits<MapType>::mergeAndConsumeMap(
+      source_map_merge_from.get(), source_map_merge_base.get());
+}
+
+template <typename MapType>
+void MapManager<MapType>::mergeAndDeleteMaps(
+    const std::string& source_key_merge_base,
+    const std::vector<std::string>& source_keys_merge_from) {
+  // Pairs of maps are merged concurrently in rounds, every round halves the
+  // number of maps left, until everything is merged into the base map.
+  std::vector<std::string> keys_to_merge;
+  keys_to_merge.reserve(source_keys_merge_from.size() + 1u);
+  keys_to_merge.push_back(source_key_merge_base);
+  keys_to_merge.insert(
+      keys_to_merge.end(), source_keys_merge_from.begin(),
+      source_keys_merge_from.end());
+
+  const size_t num_threads = internal::getNumLoadAndMergeThreads();
+  while (keys_to_merge.size() > 1u) {
+    const size_t num_merges = keys_to_merge.size() / 2u;
+    std::function<void(size_t, size_t)> merge_pairs =
+        [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            mergeAndDeleteMap(
+                keys_to_merge[2u * i], keys_to_merge[2u * i + 1u]);
+          }
+        };
+    constexpr size_t kMergesPerChunk = 1u;
+    common::ParallelProcessDynamic(
+        num_merges, merge_pairs, num_threads,
+        common::ParallelSchedule::kDynamic, kMergesPerChunk);
+
+    // The base maps of this round are merged in the next one.
+    std::vector<std::string> remaining_keys;
+    remaining_keys.reserve(keys_to_merge.size() - num_merges);
+    for (size_t i = 0u; i < keys_to_merge.size(); i += 2u) {
+      remaining_keys.push_back(keys_to_merge[i]);
+    }
+    keys_to_merge.swap(remaining_keys);
+  }
+  CHECK_EQ(keys_to_merge.front(), source_key_merge_base);
+}
+
 template <typename MapType>
 void MapManager<MapType>::getMapFolder(
     const std::string& map_key, std::string* map_folder) const {
@@ -325,9 +460,27 @@ bool MapManager<MapType>::loadAllMapsFromFolder(
     new_keys->insert(key_list.cbegin(), key_list.cend());
   }
 
-  // Load and insert all maps.
+  // Load all maps concurrently, loading is mostly I/O and deserialization of
+  // independent files, and insert them afterwards.
   CHECK_EQ(map_list.size(), key_list.size());
-  for (size_t i = 0u; i < map_list.size(); ++i) {
+  const size_t num_maps = map_list.size();
+  std::vector<AlignedUniquePtr<MapType>> maps(num_maps);
+  std::unique_ptr<bool[]> is_map_loaded(new bool[num_maps]);
+  std::function<void(size_t, size_t)> load_maps =
+      [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          maps[i] = aligned_unique<MapType>();
+          is_map_loaded[i] =
+              traits<MapType>::loadFromFolder(map_list[i], maps[i].get());
+        }
+      };
+  const size_t num_threads = internal::getNumLoadAndMergeThreads();
+  constexpr size_t kMapsPerChunk = 1u;
+  common::ParallelProcessDynamic(
+      num_maps, load_maps, num_threads, common::ParallelSchedule::kDynamic,
+      kMapsPerChunk);
+
+  for (size_t i = 0u; i < num_maps; ++i) {
     const std::string& map_folder = map_list[i];
     const std::string& key_name = key_list[i];
     CHECK(!map_folder.empty());
@@ -335,10 +488,8 @@ bool MapManager<MapType>::loadAllMapsFromFolder(
     CHECK(isKeyValid(key_name));
     CHECK(!map_storage_->hasMap(key_name));
 
-    AlignedUniquePtr<MapType> map = aligned_unique<MapType>();
-    CHECK(traits<MapType>::loadFromFolder(map_folder, map.get()))
-        << "Loading map " << map_folder << " failed.";
-    map_storage_->addMap(key_name, map);
+    CHECK(is_map_loaded[i]) << "Loading map " << map_folder << " failed.";
+    map_storage_->addMap(key_name, maps[i]);
     VLOG(1) << "Loaded map " << key_name;
   }
   return true;
@@ -369,6 +520,42 @@ bool MapManager<MapType>::saveMapToFolder(
   return traits<MapType>::saveToFolder(folder_path, config, map.get());
 }
 
+template <typename MapType>
+typename BackgroundMapSave<MapType>::Ptr
+MapManager<MapType>::saveMapToFolderInBackground(
+    const std::string& key, const std::string& folder_path,
+    const SaveConfig& config) const {
+  CHECK(!key.empty());
+  CHECK(!folder_path.empty());
+  if (config.move_resources_when_migrating &&
+      config.migrate_resources_settings !=
+          SaveConfig::MigrateResourcesSettings::kDontMigrateResourceFolder) {
+    LOG(ERROR) << "Resources can't be moved by a background save, the map "
+               << "\"" << key << "\" still refers to them.";
+    return nullptr;
+  }
+
+  AlignedUniquePtr<MapType> snapshot = aligned_unique<MapType>();
+  {
+    map_storage_->getContainerMutex()->acquireReadLock();
+    if (!map_storage_->hasMap(key)) {
+      map_storage_->getContainerMutex()->releaseReadLock();
+      LOG(ERROR) << "Map with key \"" << key << "\" doesn't exist.";
+      return nullptr;
+    }
+    MapReadAccess map = map_storage_->getMapReadAccess(key);
+    map_storage_->getContainerMutex()->releaseReadLock();
+    traits<MapType>::deepCopy(*map, snapshot.get());
+  }
+
+  // The snapshot doesn't track the changes of the map, only changed files
+  // can't be saved.
+  SaveConfig snapshot_config(config);
+  snapshot_config.save_only_changes = false;
+  return std::make_shared<BackgroundMapSave<MapType>>(
+      key, folder_path, snapshot_config, std::move(snapshot));
+}
+
 template <typename MapType>
 bool MapManager<MapType>::saveMapToMapFolder(const std::string& key) const {
   const SaveConfig config;
@@ -9,6 +9,7 @@
 #include <maplab-common/map-manager-config.h>
 #include <maplab-common/monitor.h>
 
+#include "map-manager/background-map-save.h"
 #include "map-manager/map-storage.h"
 
 namespace backend {
@@ -66,6 +67,45 @@ class MapManager {
   typedef typename common::Monitor<MapType>::WriteAccess MapWriteAccess;
   typedef typename common::Monitor<MapType>::ReadAccess MapReadAccess;
 
+  /// \brief Access to a single mission of a map, see getMissionWriteAccess().
+  ///
+  /// Releases the locks when it goes out of scope.
+  /// \tparam kIsWriteAccess Locks the mission for writing if true and for
+  /// reading otherwise.
+  template <bool kIsWriteAccess>
+  class MissionAccess {
+   public:
+    typedef typename std::conditional<
+        kIsWriteAccess, MapType, const MapType>::type AccessType;
+
+    MissionAccess(MissionAccess&& other);
+    ~MissionAccess();
+
+    AccessType* operator->() const {
+      return map_;
+    }
+    AccessType& operator*() const {
+      return *map_;
+    }
+    AccessType* get() const {
+      return map_;
+    }
+
+   private:
+    friend class MapManager<MapType>;
+    MissionAccess(
+        typename MapStorage<MapType>::MapAndMutex* map_handle,
+        aslam::ReaderWriterMutex* mission_mutex);
+    MissionAccess(const MissionAccess&) = delete;
+    MissionAccess& operator=(const MissionAccess&) = delete;
+
+    AccessType* map_;
+    typename MapStorage<MapType>::MapAndMutex* map_handle_;
+    aslam::ReaderWriterMutex* mission_mutex_;
+  };
+  typedef MissionAccess<true> MissionWriteAccess;
+  typedef MissionAccess<false> MissionReadAccess;
+
   MapManager();
   ~MapManager() {}
 
@@ -95,6 +135,33 @@ class MapManager {
   /// \returns Thread safe read access of the map.
   MapReadAccess getMapReadAccess(const std::string& key) const;
 
+  /// \brief Returns a map for write access to one of its missions.
+  ///
+  /// Accesses to different missions of the same map don't block each other,
+  /// e.g. to run mission-local algorithms concurrently. They block the
+  /// accesses to the whole map, i.e. getMapWriteAccess() and
+  /// getMapReadAccess(), and are blocked by them. The caller must only
+  /// modify the given mission and the data that belongs to it only. A
+  /// thread must not hold more than one access to the same map.
+  ///
+  /// The map type provides the mission mutexes, see
+  /// MapTraits::getMissionMutex(). Crashes when no map can be found under
+  /// the given key.
+  /// \param key Key of the map to be returned.
+  /// \param mission_id Id of the mission to be locked.
+  /// \returns Thread safe write access of the mission.
+  template <typename MissionIdType>
+  MissionWriteAccess getMissionWriteAccess(
+      const std::string& key, const MissionIdType& mission_id);
+
+  /// \brief Returns a const map for read access to one of its missions.
+  ///
+  /// Same as getMissionWriteAccess(), but other read accesses to the same
+  /// mission don't block.
+  template <typename MissionIdType>
+  MissionReadAccess getMissionReadAccess(
+      const std::string& key, const MissionIdType& mission_id) const;
+
   /// \brief Checks if a specified map exists.
   ///
   /// Calls MapStorage::hasMap().
@@ -182,6 +249,31 @@ class MapManager {
       const std::string& source_key_merge_base,
       const std::string& source_key_merge_from);
 
+  /// \brief Merges \p source_key_merge_from into \p source_key_merge_base and
+  /// removes it from the storage.
+  ///
+  /// Unlike mergeMaps() followed by deleteMap(), this moves the data of the
+  /// merged map if the map type supports it, see MapTraits::mergeAndConsumeMap.
+  /// \param source_key_merge_base The base map for the merge operation.
+  /// \param source_key_merge_from The map which will be merged into the base
+  /// map and deleted.
+  void mergeAndDeleteMap(
+      const std::string& source_key_merge_base,
+      const std::string& source_key_merge_from);
+
+  /// \brief Merges all of \p source_keys_merge_from into \p
+  /// source_key_merge_base and removes them from the storage.
+  ///
+  /// Same as calling mergeAndDeleteMap() for every map, but merges the maps
+  /// as a tree reduction: the maps are merged pairwise and concurrently until
+  /// only the base map is left.
+  /// \param source_key_merge_base The base map for the merge operation.
+  /// \param source_keys_merge_from The maps which will be merged into the
+  /// base map and deleted.
+  void mergeAndDeleteMaps(
+      const std::string& source_key_merge_base,
+      const std::vector<std::string>& source_keys_merge_from);
+
   // TODO(eggerk): implement split.
 
   /// \brief Return the currently set map folder of a map. Crashes if the map
@@ -224,7 +316,8 @@ class MapManager {
   ///
   /// The keys under which the maps are stored are determined by the filename.
   /// If a key already
-  /// exists in the storage, this operation will fail.
+  /// exists in the storage, this operation will fail. The maps are loaded
+  /// concurrently, see --map_manager_num_load_threads.
   /// \param folder_path Path of the folder containing the maps to load.
   /// \returns True if all maps in the folder are successfully loaded and at
   /// least one map has been loaded.
@@ -252,6 +345,23 @@ class MapManager {
       const std::string& key, const std::string& folder_path,
       const SaveConfig& config) const;
 
+  /// \brief Saves a snapshot of a map to a folder on a background thread.
+  ///
+  /// Takes a copy of the map while holding read access, which is cheap for
+  /// map types that share their data with copies until either is modified,
+  /// and saves the copy on a thread of its own. The map can be used and
+  /// modified as soon as this function returns. Unlike saveMapToFolder(),
+  /// the map folder of the map isn't updated and the save always rewrites
+  /// all map files. Resources can't be moved, as the map still refers to
+  /// them.
+  /// \param key Key of the map to save.
+  /// \param folder_path Folder in which the map should be saved.
+  /// \param config Save config, see saveMapToFolder().
+  /// \returns Handle of the running save, nullptr if it couldn't be started.
+  typename BackgroundMapSave<MapType>::Ptr saveMapToFolderInBackground(
+      const std::string& key, const std::string& folder_path,
+      const SaveConfig& config) const;
+
   /// \brief Saves a map into its map folder as specified by the map's metadata.
   /// \param key Key of the map to save.
   /// \param overwrite_existing_file If set to true, any already existing file
@@ -160,6 +160,16 @@ MapStorage<MapType>::releaseMapAndMutex(const std::string& key) {
   return std::move(map_and_mutex);
 }
 
+template <typename MapType>
+typename MapStorage<MapType>::MapAndMutex* MapStorage<MapType>::getMapAndMutex(
+    const std::string& key) {
+  const MapStorageContainerIterator it = map_storage_container_.find(key);
+  CHECK(it != map_storage_container_.end()) << "Map with key \"" << key
+                                            << "\" does not exist!";
+  CHECK(it->second->map != nullptr) << "Stored map is nullptr!";
+  return it->second.get();
+}
+
 template <typename MapType>
 void MapStorage<MapType>::renameMap(
     const std::string& old_key, const std::string& new_key) {
@@ -2,6 +2,7 @@
 #define MAP_MANAGER_MAP_STORAGE_H_
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -46,8 +47,33 @@ class MapStorage {
     /// \brief Mutex to lock access to the map in this handle.
     mutable aslam::ReaderWriterMutex map_mutex;
 
+    /// \brief Guards the number of mission accesses.
+    std::mutex mission_access_mutex;
+
+    /// \brief Number of mission accesses of the map, see
+    /// MapManager::getMissionWriteAccess(). They share one write lock of
+    /// map_mutex, taken by the first and released by the last of them.
+    size_t num_mission_accesses;
+
     explicit MapAndMutex(AlignedUniquePtr<MapType>& map_)  // NOLINT
-        : map(std::move(map_)) {}
+        : map(std::move(map_)), num_mission_accesses(0u) {}
+
+    void acquireMissionAccess() {
+      std::lock_guard<std::mutex> lock(mission_access_mutex);
+      if (num_mission_accesses == 0u) {
+        map_mutex.acquireWriteLock();
+      }
+      ++num_mission_accesses;
+    }
+
+    void releaseMissionAccess() {
+      std::lock_guard<std::mutex> lock(mission_access_mutex);
+      CHECK_GT(num_mission_accesses, 0u);
+      --num_mission_accesses;
+      if (num_mission_accesses == 0u) {
+        map_mutex.releaseWriteLock();
+      }
+    }
   };
 
   /// \brief Get an instance of this map storage.
@@ -150,6 +176,13 @@ class MapStorage {
   /// returns Unique pointer to the released map and mutex.
   std::unique_ptr<MapAndMutex> releaseMapAndMutex(const std::string& key);
 
+  /// \brief Returns the map and mutex stored under the given key.
+  ///
+  /// Crashes if no map with the given key exists.
+  /// \param key Key of the map.
+  /// \returns Pointer to the map and mutex, owned by the storage.
+  MapAndMutex* getMapAndMutex(const std::string& key);
+
   /// \brief Renames a certain map by changing the key associated with it.
   ///
   /// Crashes when no map exists under old_key or when a map already exists
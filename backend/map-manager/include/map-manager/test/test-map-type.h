@@ -3,6 +3,8 @@
 
 #include <string>
 
+#include <aslam/common/reader-writer-lock.h>
+#include <glog/logging.h>
 #include <maplab-common/map-traits.h>
 
 namespace backend {
@@ -10,7 +12,9 @@ namespace backend {
 // Test class to unit test basic map manager functionality.
 class TestMapType : public MapInterface<TestMapType> {
  public:
-  TestMapType() : counter_(0u) {}
+  static constexpr size_t kNumMissions = 2u;
+
+  TestMapType() : counter_(0u), mission_counters_{0u, 0u} {}
 
   bool hasMapFolder() {
     return false;
@@ -20,7 +24,9 @@ class TestMapType : public MapInterface<TestMapType> {
 
   virtual void deepCopy(const TestMapType& /*other*/) {}
   virtual void mergeAllMissionsFromMap(
-      const TestMapType& /*source_map_merge_from*/) {}
+      const TestMapType& source_map_merge_from) {
+    counter_ += source_map_merge_from.counter_;
+  }
 
   static std::string getSubFolderName() {
     return "";
@@ -43,9 +49,26 @@ class TestMapType : public MapInterface<TestMapType> {
     return counter_;
   }
 
+  // Missions are identified by their index.
+  aslam::ReaderWriterMutex* getMissionMutex(size_t mission_index) const {
+    CHECK_LT(mission_index, kNumMissions);
+    return &mission_mutexes_[mission_index];
+  }
+  void incrementMissionCounter(size_t mission_index) {
+    CHECK_LT(mission_index, kNumMissions);
+    ++mission_counters_[mission_index];
+  }
+  size_t getMissionCounter(size_t mission_index) const {
+    CHECK_LT(mission_index, kNumMissions);
+    return mission_counters_[mission_index];
+  }
+
  private:
   size_t counter_;
+  size_t mission_counters_[kNumMissions];
+  mutable aslam::ReaderWriterMutex mission_mutexes_[kNumMissions];
 };
+constexpr size_t TestMapType::kNumMissions;
 
 template <>
 struct traits<TestMapType> : public MapTraits<TestMapType> {};
@@ -0,0 +1,6 @@
+#include <gflags/gflags.h>
+
+DEFINE_uint64(
+    map_manager_num_load_threads, 0u,
+    "Number of maps the map manager loads or merges concurrently. "
+    "(0: number of hardware threads)");
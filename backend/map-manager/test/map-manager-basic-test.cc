@@ -1,3 +1,4 @@
+#include <atomic>
 #include <chrono>
 #include <string>
 #include <thread>
@@ -312,4 +313,133 @@ TEST_F(MapManagerBasicTest, ReleaseMapWhileInUse) {
   }
 }
 
+TEST_F(MapManagerBasicTest, MergeAndDeleteMaps) {
+  constexpr size_t kNumberOfMaps = 7u;
+  std::vector<std::string> keys;
+  for (size_t i = 0u; i < kNumberOfMaps; ++i) {
+    keys.push_back("map_" + std::to_string(i));
+    map_->incrementCounter();
+    map_manager_.addMap(keys.back(), map_);
+    map_.reset(new backend::TestMapType());
+  }
+
+  const std::vector<std::string> keys_to_merge(keys.begin() + 1, keys.end());
+  map_manager_.mergeAndDeleteMaps(keys.front(), keys_to_merge);
+  EXPECT_EQ(1u, map_manager_.numberOfMaps());
+  ASSERT_TRUE(map_manager_.hasMap(keys.front()));
+  EXPECT_EQ(
+      kNumberOfMaps,
+      map_manager_.getMapReadAccess(keys.front())->getCounter());
+}
+
+TEST_F(MapManagerBasicTest, SaveMapInBackground) {
+  const backend::SaveConfig config;
+  EXPECT_EQ(
+      nullptr, map_manager_.saveMapToFolderInBackground(
+                   TestStrings::kFirstMapKey, "folder", config));
+
+  addSampleMapToStorage();
+  backend::BackgroundMapSave<backend::TestMapType>::Ptr background_save =
+      map_manager_.saveMapToFolderInBackground(
+          TestStrings::kFirstMapKey, "folder", config);
+  ASSERT_NE(nullptr, background_save);
+  EXPECT_EQ(TestStrings::kFirstMapKey, background_save->getMapKey());
+  // The map can be modified while the snapshot is being saved.
+  map_manager_.getMapWriteAccess(TestStrings::kFirstMapKey)
+      ->incrementCounter();
+  // The test map type fails to save.
+  EXPECT_FALSE(background_save->wait());
+  EXPECT_TRUE(background_save->isDone());
+  EXPECT_GE(background_save->getElapsedSeconds(), 0.0);
+
+  backend::SaveConfig move_resources_config;
+  move_resources_config.migrate_resources_settings = backend::SaveConfig::
+      MigrateResourcesSettings::kMigrateResourcesToMapFolder;
+  move_resources_config.move_resources_when_migrating = true;
+  EXPECT_EQ(
+      nullptr, map_manager_.saveMapToFolderInBackground(
+                   TestStrings::kFirstMapKey, "folder",
+                   move_resources_config));
+}
+
+TEST_F(MapManagerBasicTest, MissionAccessesOfDifferentMissionsDontBlock) {
+  addSampleMapToStorage();
+  std::atomic<bool> is_first_mission_locked(false);
+  std::atomic<bool> is_second_mission_locked(false);
+
+  std::thread first_mission_thread([&]() {
+    backend::MapManager<backend::TestMapType>::MissionWriteAccess map =
+        map_manager_.getMissionWriteAccess(TestStrings::kFirstMapKey, 0u);
+    is_first_mission_locked = true;
+    // Wait for the other mission while holding the access.
+    constexpr size_t kSleepTimeMs = 5u;
+    constexpr size_t kMaxNumSleeps = 1000u;
+    for (size_t i = 0u; i < kMaxNumSleeps && !is_second_mission_locked; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(kSleepTimeMs));
+    }
+    EXPECT_TRUE(is_second_mission_locked);
+    map->incrementMissionCounter(0u);
+  });
+  std::thread second_mission_thread([&]() {
+    constexpr size_t kSleepTimeMs = 5u;
+    while (!is_first_mission_locked) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(kSleepTimeMs));
+    }
+    backend::MapManager<backend::TestMapType>::MissionWriteAccess map =
+        map_manager_.getMissionWriteAccess(TestStrings::kFirstMapKey, 1u);
+    is_second_mission_locked = true;
+    map->incrementMissionCounter(1u);
+  });
+  first_mission_thread.join();
+  second_mission_thread.join();
+
+  const backend::MapManager<backend::TestMapType>::MapReadAccess map =
+      map_manager_.getMapReadAccess(TestStrings::kFirstMapKey);
+  EXPECT_EQ(1u, map->getMissionCounter(0u));
+  EXPECT_EQ(1u, map->getMissionCounter(1u));
+}
+
+TEST_F(MapManagerBasicTest, MissionAccessesExcludeConflictingAccesses) {
+  addSampleMapToStorage();
+  constexpr size_t kNumberOfThreads = 10u;
+  constexpr size_t kSleepTimeMs = 10u;
+  std::vector<std::thread> worker_threads;
+
+  // Accesses to the same mission are serialized.
+  for (size_t i = 0u; i < kNumberOfThreads; ++i) {
+    const size_t mission_index = i % backend::TestMapType::kNumMissions;
+    worker_threads.emplace_back([&, mission_index]() {
+      backend::MapManager<backend::TestMapType>::MissionWriteAccess map =
+          map_manager_.getMissionWriteAccess(
+              TestStrings::kFirstMapKey, mission_index);
+      const size_t counter_begin = map->getMissionCounter(mission_index);
+      std::this_thread::sleep_for(std::chrono::milliseconds(kSleepTimeMs));
+      map->incrementMissionCounter(mission_index);
+      EXPECT_EQ(counter_begin + 1u, map->getMissionCounter(mission_index));
+    });
+  }
+  // Accesses to the whole map wait for all mission accesses and vice versa.
+  for (size_t i = 0u; i < kNumberOfThreads; ++i) {
+    worker_threads.emplace_back([&]() {
+      backend::MapManager<backend::TestMapType>::MapReadAccess map =
+          map_manager_.getMapReadAccess(TestStrings::kFirstMapKey);
+      const size_t counter_begin =
+          map->getMissionCounter(0u) + map->getMissionCounter(1u);
+      std::this_thread::sleep_for(std::chrono::milliseconds(kSleepTimeMs));
+      EXPECT_EQ(
+          counter_begin,
+          map->getMissionCounter(0u) + map->getMissionCounter(1u));
+    });
+  }
+  for (std::thread& thread : worker_threads) {
+    thread.join();
+  }
+
+  const backend::MapManager<backend::TestMapType>::MapReadAccess map =
+      map_manager_.getMapReadAccess(TestStrings::kFirstMapKey);
+  EXPECT_EQ(
+      kNumberOfThreads,
+      map->getMissionCounter(0u) + map->getMissionCounter(1u));
+}
+
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,78 @@
+#ifndef MAP_RESOURCES_CHUNKED_POINT_CLOUD_H_
+#define MAP_RESOURCES_CHUNKED_POINT_CLOUD_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+#include "map-resources/resource-typedefs.h"
+
+namespace backend {
+
+// Binary point cloud format that groups the points into cubic chunks, such
+// that readers can decode only the chunks of a region. The header and the
+// chunk index are followed by the coordinates, normals and colors of all
+// points, each grouped by chunk. Within a chunk, the points are ordered such
+// that every prefix is spread evenly over the chunk, so reading a prefix
+// gives a coarser level of detail.
+
+// Checks if the data starts with the header of a chunked point cloud.
+bool isEncodedChunkedPointCloud(const char* data, size_t num_bytes);
+
+// All points must be finite.
+void encodeChunkedPointCloud(
+    const resources::PointCloud& point_cloud, double chunk_size_meters,
+    std::string* encoded_point_cloud);
+
+// Decodes the points from an encoded point cloud, e.g. one that is mapped to
+// memory, which then only reads the pages of the requested chunks. The data
+// has to stay valid for the lifetime of the reader.
+class ChunkedPointCloudReader {
+ public:
+  ChunkedPointCloudReader(const char* data, size_t num_bytes);
+
+  // False if the data is not a valid chunked point cloud.
+  bool isValid() const {
+    return is_valid_;
+  }
+
+  size_t getNumPoints() const;
+  size_t getNumChunks() const;
+
+  // The level of detail in (0, 1] is the fraction of the points of every
+  // chunk that is read.
+  void readPointCloud(
+      double level_of_detail, resources::PointCloud* point_cloud) const;
+  // Only reads the points inside of the box.
+  void readPointCloudInRegion(
+      const Eigen::AlignedBox3f& region, double level_of_detail,
+      resources::PointCloud* point_cloud) const;
+
+ private:
+  struct Chunk {
+    Eigen::AlignedBox3f box;
+    uint64_t first_point;
+    uint64_t num_points;
+  };
+
+  // Reads all points if region is nullptr.
+  void readPoints(
+      const Eigen::AlignedBox3f* region, double level_of_detail,
+      resources::PointCloud* point_cloud) const;
+
+  bool is_valid_;
+  uint64_t num_points_;
+  bool has_normals_;
+  bool has_colors_;
+  std::vector<Chunk> chunks_;
+  const char* xyz_data_;
+  const char* normals_data_;
+  const char* colors_data_;
+};
+
+}  // namespace backend
+
+#endif  // MAP_RESOURCES_CHUNKED_POINT_CLOUD_H_
@@ -0,0 +1,29 @@
+#ifndef MAP_RESOURCES_DEPTH_MAP_CODEC_H_
+#define MAP_RESOURCES_DEPTH_MAP_CODEC_H_
+
+#include <cstddef>
+#include <string>
+
+#include <opencv2/core.hpp>
+
+namespace backend {
+
+// Lossless codec for single-channel 16-bit images such as depth and disparity
+// maps. Every pixel is predicted from its left neighbor, or from the one above
+// in the first column, and the difference is stored in 1 to 3 bytes. Runs of
+// pixels that match their prediction, e.g. invalid depth, take 2 bytes per
+// run. Encoding and decoding are a single pass over the pixels without entropy
+// coding.
+
+// Checks if the data starts with the header of an encoded depth map.
+bool isEncodedDepthMap(const char* data, size_t num_bytes);
+
+// The depth map must be of type CV_16UC1.
+void encodeDepthMap(const cv::Mat& depth_map, std::string* encoded_depth_map);
+
+// Returns false if the data is not a valid encoded depth map.
+bool decodeDepthMap(const char* data, size_t num_bytes, cv::Mat* depth_map);
+
+}  // namespace backend
+
+#endif  // MAP_RESOURCES_DEPTH_MAP_CODEC_H_
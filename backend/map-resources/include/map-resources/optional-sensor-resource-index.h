@@ -0,0 +1,80 @@
+#ifndef MAP_RESOURCES_OPTIONAL_SENSOR_RESOURCE_INDEX_H_
+#define MAP_RESOURCES_OPTIONAL_SENSOR_RESOURCE_INDEX_H_
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "map-resources/optional-sensor-resources.h"
+#include "map-resources/resource-common.h"
+
+namespace backend {
+
+// Sorted, contiguous snapshot of the timestamps and resource ids of the
+// optional resources of one sensor. The timestamps are stored in their own
+// array, such that the queries binary search a contiguous block of memory
+// instead of walking the nodes of the map of OptionalSensorResources. The
+// index does not follow later changes of the resources, rebuild it after
+// adding or deleting resources.
+class OptionalSensorResourceIndex {
+ public:
+  static constexpr size_t kInvalidIndex = std::numeric_limits<size_t>::max();
+
+  OptionalSensorResourceIndex() = default;
+  explicit OptionalSensorResourceIndex(
+      const OptionalSensorResources& resources);
+
+  void rebuild(const OptionalSensorResources& resources);
+
+  inline size_t size() const {
+    return timestamps_ns_.size();
+  }
+  inline bool empty() const {
+    return timestamps_ns_.empty();
+  }
+  inline int64_t getTimestampNs(const size_t index) const {
+    DCHECK_LT(index, timestamps_ns_.size());
+    return timestamps_ns_[index];
+  }
+  inline const ResourceId& getResourceId(const size_t index) const {
+    DCHECK_LT(index, resource_ids_.size());
+    return resource_ids_[index];
+  }
+
+  // Same result as OptionalSensorResources::getClosestResourceId in
+  // O(log n). Returns kInvalidIndex if no resource is within the tolerance.
+  size_t getClosestIndex(int64_t timestamp_ns, int64_t tolerance_ns) const;
+  bool getClosestResourceId(
+      int64_t timestamp_ns, int64_t tolerance_ns,
+      StampedResourceId* stamped_resource_id) const;
+
+  // Gets all resources with timestamp_lower_ns <= timestamp <=
+  // timestamp_upper_ns in temporal order.
+  void getResourceIdsInRange(
+      int64_t timestamp_lower_ns, int64_t timestamp_upper_ns,
+      std::vector<StampedResourceId>* stamped_resource_ids) const;
+
+  // Finds the index of the closest resource within the tolerance for every
+  // timestamp, or kInvalidIndex, with the same result as getClosestIndex.
+  // The timestamps are visited in temporal order in one merge-style sweep
+  // over the index; unsorted timestamps are sorted first.
+  void associateClosestIndices(
+      const std::vector<int64_t>& timestamps_ns, int64_t tolerance_ns,
+      std::vector<size_t>* closest_indices) const;
+
+ private:
+  // Picks the closer one of the resources before and at the lower bound
+  // position of the timestamp.
+  size_t selectClosestIndex(
+      size_t lower_bound_index, int64_t timestamp_ns,
+      int64_t tolerance_ns) const;
+
+  std::vector<int64_t> timestamps_ns_;
+  std::vector<ResourceId> resource_ids_;
+};
+
+}  // namespace backend
+
+#endif  // MAP_RESOURCES_OPTIONAL_SENSOR_RESOURCE_INDEX_H_
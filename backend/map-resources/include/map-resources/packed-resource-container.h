@@ -0,0 +1,123 @@
+#ifndef MAP_RESOURCES_PACKED_RESOURCE_CONTAINER_H_
+#define MAP_RESOURCES_PACKED_RESOURCE_CONTAINER_H_
+
+#include <cstdint>
+#include <fstream>  // NOLINT
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <maplab-common/macros.h>
+#include <maplab-common/memory-mapped-file.h>
+
+#include "map-resources/resource-common.h"
+
+namespace backend {
+
+// Stores the resources of one type in one resource folder as records in
+// append-only segment files, instead of one file per resource. A record is a
+// small header followed by the encoded resource. Replacing or deleting a
+// resource appends a record that supersedes the previous one, compact()
+// rewrites the live records to reclaim the space of the superseded ones.
+//
+// The offset index of the resources is rebuilt from the record headers when
+// the container is opened. Reads map the segments into memory, so they don't
+// copy the resource before decoding it. Thread safe, the read functions run
+// outside of the lock.
+class PackedResourceContainer {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(PackedResourceContainer);
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(PackedResourceContainer);
+
+  // Gets the encoded resource, the data is only valid during the call.
+  typedef std::function<bool(const char*, size_t)> ReadFunction;
+
+  // Opens the container with the segments in the given folder, which is
+  // created with the first segment. A new segment is started once the last
+  // one has reached max_segment_bytes.
+  PackedResourceContainer(
+      const std::string& container_folder, size_t max_segment_bytes);
+
+  // Folder of the container of a resource type in a resource folder.
+  static void getContainerFolder(
+      const std::string& resource_folder, const ResourceType& type,
+      std::string* container_folder);
+
+  bool hasResource(const ResourceId& id) const;
+
+  // Replaces the resource if the container has it already.
+  void putResource(const ResourceId& id, const std::string& encoded_resource);
+
+  // Returns false if the container doesn't have the resource, the result of
+  // the read function otherwise.
+  bool readResource(const ResourceId& id, const ReadFunction& read) const;
+
+  // Returns false if the container doesn't have the resource.
+  bool deleteResource(const ResourceId& id);
+
+  // Rewrites the live records into new segments and deletes the old segments.
+  void compact();
+
+  size_t getNumResources() const;
+  size_t getNumSegments() const;
+  // Size of all segments.
+  size_t getNumBytes() const;
+  // Size of the records that have been superseded.
+  size_t getNumUnusedBytes() const;
+
+ private:
+  struct Segment {
+    std::string file_path;
+    // Size of the valid part of the segment.
+    uint64_t num_bytes;
+    // Mapped on the first read, remapped once it doesn't cover an appended
+    // record. Readers keep a reference for the duration of a read.
+    common::MemoryMappedFile::Ptr mapped_file;
+  };
+
+  struct RecordLocation {
+    size_t segment_idx;
+    // Offset of the encoded resource in the segment.
+    uint64_t offset;
+    uint64_t num_bytes;
+  };
+
+  void openSegments();
+  // Adds the records of a segment to the index. Returns false if the segment
+  // is corrupt, all records up to the corruption are kept.
+  bool scanSegment(size_t segment_idx);
+  void addRecordToIndex(
+      const ResourceId& id, bool is_deleted, const RecordLocation& location);
+
+  void startSegment();
+  void appendRecord(
+      const ResourceId& id, bool is_deleted, const char* data,
+      uint64_t num_bytes);
+
+  size_t getNumSegmentBytes() const;
+
+  // Maps the segment if the mapping ends before end_offset.
+  common::MemoryMappedFile::Ptr getMappedFile(
+      uint64_t end_offset, Segment* segment) const;
+
+  const std::string container_folder_;
+  const size_t max_segment_bytes_;
+
+  mutable std::mutex mutex_;
+  mutable std::vector<Segment> segments_;
+  std::unordered_map<ResourceId, RecordLocation> index_;
+  size_t num_unused_bytes_;
+  // Number of the next segment file, higher than those of all segments.
+  size_t next_segment_number_;
+  // Appends to the last segment, opened on the first append.
+  std::ofstream segment_stream_;
+  // False if the last segment is corrupt, then the next record goes into a
+  // new segment.
+  bool can_append_to_last_segment_;
+};
+
+}  // namespace backend
+
+#endif  // MAP_RESOURCES_PACKED_RESOURCE_CONTAINER_H_
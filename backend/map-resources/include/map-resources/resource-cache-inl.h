@@ -1,6 +1,12 @@
 #ifndef MAP_RESOURCES_RESOURCE_CACHE_INL_H_
 #define MAP_RESOURCES_RESOURCE_CACHE_INL_H_
 
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
 #include "map-resources/resource-common.h"
 
 namespace backend {
@@ -9,20 +15,18 @@ template <typename DataType>
 bool ResourceCache::getResource(
     const ResourceId& id, const ResourceType& type, DataType* resource) {
   CHECK_NOTNULL(resource);
-  typename Cache<DataType>::ResourceDeque* cache = getCache<DataType>(type);
+  std::lock_guard<std::mutex> lock(getMutex(type));
+  typename Cache<DataType>::Resources* cache = getCache<DataType>(type);
 
   bool found = false;
   if (cache != nullptr) {
-    typename Cache<DataType>::ConstIterator it = std::find_if(
-        cache->begin(), cache->end(),
-        [id](const typename Cache<DataType>::Element& element) {
-          return element.first == id;
-        });
-    if (it != cache->end()) {
-      *resource = it->second;
+    typename std::unordered_map<
+        ResourceId, typename Cache<DataType>::Iterator>::const_iterator it =
+        cache->index.find(id);
+    if (it != cache->index.end()) {
+      *resource = it->second->resource;
       found = true;
-
-      // TODO(mfehr): Do something to the cache depending on the strategy.
+      touchElement<DataType>(it->second, cache);
     }
   }
 
@@ -37,40 +41,66 @@ bool ResourceCache::getResource(
 template <typename DataType>
 void ResourceCache::putResource(
     const ResourceId& id, const ResourceType& type, const DataType& resource) {
-  typename Cache<DataType>::ResourceDeque* cache = getCache<DataType>(type);
+  CHECK(tryPutResource<DataType>(id, type, resource))
+      << "Cannot put same resource in the cache twice! Id: " << id.hexString();
+}
+
+template <typename DataType>
+bool ResourceCache::tryPutResource(
+    const ResourceId& id, const ResourceType& type, const DataType& resource) {
+  // Resources larger than the quota or the budget are not cached. The
+  // others are inserted after evicting, otherwise kLFU would evict them
+  // right away.
+  const size_t num_bytes = getResourceMemoryBytes(resource);
+  const size_t max_cache_bytes = getMaxCacheBytes(type);
+  const bool fits_in_cache =
+      config_.max_cache_size > 0u &&
+      (max_cache_bytes == 0u || num_bytes <= max_cache_bytes) &&
+      (config_.max_total_cache_bytes == 0u ||
+       num_bytes <= config_.max_total_cache_bytes);
+  if (fits_in_cache) {
+    // Takes the locks of the other types, so it runs before locking this one.
+    evictResourcesForBudget(num_bytes);
+  }
+
+  std::lock_guard<std::mutex> lock(getMutex(type));
+  typename Cache<DataType>::Resources* cache = getCache<DataType>(type);
   if (cache == nullptr) {
     cache = initCache<DataType>(type);
   }
 
   // Check if it is already in the cache.
-  typename Cache<DataType>::ConstIterator it = std::find_if(
-      cache->begin(), cache->end(),
-      [id](const typename Cache<DataType>::Element& element) {
-        return element.first == id;
-      });
-  CHECK(it == cache->end())
-      << "Cannot put same resource in the cache twice! Id: " << id.hexString();
+  if (cache->index.count(id) > 0u) {
+    return false;
+  }
 
-  cache->emplace_back(id, resource);
-  if (cache->size() > config_.max_cache_size) {
-    cache->pop_front();
+  if (fits_in_cache) {
+    evictResources<DataType>(type, num_bytes, cache);
+    // New resources start in the group of the resources that were never
+    // accessed, which is the first group for all strategies.
+    typename Cache<DataType>::ElementList& group = cache->groups[0u];
+    group.emplace_back(id, resource, num_bytes);
+    group.back().last_access = ++access_counter_;
+    cache->index.emplace(id, std::prev(group.end()));
+    cache->num_bytes += num_bytes;
+    num_bytes_ += num_bytes;
   }
 
   updateCacheSizeStatistic<DataType>(type, *cache, &statistic_);
+  return true;
 }
 
 template <typename DataType>
 bool ResourceCache::deleteResource(
     const ResourceId& id, const ResourceType& type) {
-  typename Cache<DataType>::ResourceDeque* cache = getCache<DataType>(type);
+  std::lock_guard<std::mutex> lock(getMutex(type));
+  typename Cache<DataType>::Resources* cache = getCache<DataType>(type);
   if (cache != nullptr) {
-    typename Cache<DataType>::Iterator it = std::find_if(
-        cache->begin(), cache->end(),
-        [id](const typename Cache<DataType>::Element& element) {
-          return element.first == id;
-        });
-    if (it != cache->end()) {
-      cache->erase(it);
+    typename std::unordered_map<
+        ResourceId, typename Cache<DataType>::Iterator>::iterator it =
+        cache->index.find(id);
+    if (it != cache->index.end()) {
+      eraseElement<DataType>(it->second, cache);
 
       updateCacheSizeStatistic<DataType>(type, *cache, &statistic_);
       return true;
@@ -80,35 +110,187 @@ bool ResourceCache::deleteResource(
 }
 
 template <typename DataType>
-typename ResourceCache::Cache<DataType>::ResourceDequePtr&
+bool ResourceCache::hasResource(
+    const ResourceId& id, const ResourceType& type) {
+  std::lock_guard<std::mutex> lock(getMutex(type));
+  const typename Cache<DataType>::Resources* cache = getCache<DataType>(type);
+  return cache != nullptr && cache->index.count(id) > 0u;
+}
+
+template <typename DataType>
+void ResourceCache::touchElement(
+    typename Cache<DataType>::Iterator it,
+    typename Cache<DataType>::Resources* cache) {
+  CHECK_NOTNULL(cache);
+  if (config_.strategy != Strategy::kFIFO) {
+    it->last_access = ++access_counter_;
+  }
+  switch (config_.strategy) {
+    case Strategy::kFIFO:
+      break;
+    case Strategy::kLRU: {
+      typename Cache<DataType>::ElementList& group = cache->groups[0u];
+      group.splice(group.end(), group, it);
+      break;
+    }
+    case Strategy::kLFU: {
+      // Splicing keeps the iterator in the index valid.
+      const typename std::map<
+          size_t, typename Cache<DataType>::ElementList>::iterator
+          source_group_it = cache->groups.find(it->num_accesses);
+      CHECK(source_group_it != cache->groups.end());
+      ++(it->num_accesses);
+      typename Cache<DataType>::ElementList& target_group =
+          cache->groups[it->num_accesses];
+      target_group.splice(target_group.end(), source_group_it->second, it);
+      if (source_group_it->second.empty()) {
+        cache->groups.erase(source_group_it);
+      }
+      break;
+    }
+    default:
+      LOG(FATAL) << "Unknown resource cache strategy: "
+                 << static_cast<int>(config_.strategy);
+  }
+}
+
+template <typename DataType>
+void ResourceCache::evictResources(
+    const ResourceType& type, size_t num_bytes_to_fit,
+    typename Cache<DataType>::Resources* cache) {
+  CHECK_NOTNULL(cache);
+  const size_t max_cache_bytes = getMaxCacheBytes(type);
+  while (!cache->index.empty() &&
+         (cache->index.size() >= config_.max_cache_size ||
+          (max_cache_bytes > 0u &&
+           cache->num_bytes + num_bytes_to_fit > max_cache_bytes))) {
+    CHECK(!cache->groups.empty());
+    CHECK(!cache->groups.begin()->second.empty());
+    eraseElement<DataType>(cache->groups.begin()->second.begin(), cache);
+    ++(statistic_.eviction[static_cast<size_t>(type)]);
+  }
+}
+
+template <typename DataType>
+void ResourceCache::eraseElement(
+    typename Cache<DataType>::Iterator it,
+    typename Cache<DataType>::Resources* cache) {
+  CHECK_NOTNULL(cache);
+  const size_t group_key =
+      (config_.strategy == Strategy::kLFU) ? it->num_accesses : 0u;
+  const typename std::map<
+      size_t, typename Cache<DataType>::ElementList>::iterator group_it =
+      cache->groups.find(group_key);
+  CHECK(group_it != cache->groups.end());
+
+  CHECK_GE(cache->num_bytes, it->num_bytes);
+  cache->num_bytes -= it->num_bytes;
+  CHECK_GE(num_bytes_.fetch_sub(it->num_bytes), it->num_bytes);
+  CHECK_EQ(cache->index.erase(it->id), 1u);
+  group_it->second.erase(it);
+  if (group_it->second.empty()) {
+    cache->groups.erase(group_it);
+  }
+}
+
+template <typename DataType>
+typename ResourceCache::Cache<DataType>::ResourcesPtr&
 ResourceCache::getCachePtr(const ResourceType& /*type*/) {
   LOG(FATAL) << "Implement ResourceCache::getCachePtr for your DataType!";
 }
 
 template <typename DataType>
-typename ResourceCache::Cache<DataType>::ResourceDeque* ResourceCache::getCache(
+typename ResourceCache::Cache<DataType>::Resources* ResourceCache::getCache(
     const ResourceType& type) {
   return getCachePtr<DataType>(type).get();
 }
 
 template <typename DataType>
-typename ResourceCache::Cache<DataType>::ResourceDeque*
+typename ResourceCache::Cache<DataType>::Resources*
 ResourceCache::initCache(const ResourceType& type) {
-  typename ResourceCache::Cache<DataType>::ResourceDequePtr& cache_ptr =
+  typename ResourceCache::Cache<DataType>::ResourcesPtr& cache_ptr =
       getCachePtr<DataType>(type);
-  cache_ptr.reset(new typename ResourceCache::Cache<DataType>::ResourceDeque);
+  cache_ptr.reset(new typename ResourceCache::Cache<DataType>::Resources);
   return CHECK_NOTNULL(cache_ptr.get());
 }
 
+template <typename DataType>
+void ResourceCache::initResourceTypeMap(
+    typename Cache<DataType>::ResourceTypeMap* cache) {
+  CHECK_NOTNULL(cache)->reserve(kNumResourceTypes);
+  for (size_t type_idx = 0u; type_idx < kNumResourceTypes; ++type_idx) {
+    cache->emplace(static_cast<ResourceType>(type_idx), nullptr);
+  }
+}
+
+template <typename DataType>
+size_t ResourceCache::getCacheMemoryBytes(
+    const typename Cache<DataType>::ResourceTypeMap& cache) const {
+  size_t num_bytes = 0u;
+  for (const typename Cache<DataType>::ResourceTypeMap::value_type&
+           type_and_cache : cache) {
+    std::lock_guard<std::mutex> lock(getMutex(type_and_cache.first));
+    if (!type_and_cache.second) {
+      continue;
+    }
+    num_bytes += type_and_cache.second->index.size() *
+                     sizeof(typename Cache<DataType>::Element) +
+                 type_and_cache.second->num_bytes;
+  }
+  return num_bytes;
+}
+
+template <typename DataType>
+void ResourceCache::findEvictionCandidate(
+    typename Cache<DataType>::ResourceTypeMap* cache,
+    EvictionCandidate* candidate) {
+  CHECK_NOTNULL(cache);
+  CHECK_NOTNULL(candidate);
+  for (typename Cache<DataType>::ResourceTypeMap::value_type& type_and_cache :
+       *cache) {
+    const ResourceType type = type_and_cache.first;
+    std::lock_guard<std::mutex> lock(getMutex(type));
+    const typename Cache<DataType>::Resources* resources =
+        type_and_cache.second.get();
+    if (resources == nullptr || resources->index.empty()) {
+      continue;
+    }
+    // The next resource this type would evict competes with those of the
+    // other types, compared by the same order as within a type.
+    const size_t group = resources->groups.begin()->first;
+    const typename Cache<DataType>::ConstIterator it =
+        resources->groups.begin()->second.begin();
+    if (candidate->evict &&
+        std::make_pair(group, it->last_access) >=
+            std::make_pair(candidate->group, candidate->last_access)) {
+      continue;
+    }
+    candidate->group = group;
+    candidate->last_access = it->last_access;
+    candidate->evict = [this, type]() {
+      std::lock_guard<std::mutex> lock(getMutex(type));
+      typename Cache<DataType>::Resources* resources = getCache<DataType>(type);
+      if (resources == nullptr || resources->index.empty()) {
+        return;
+      }
+      eraseElement<DataType>(
+          resources->groups.begin()->second.begin(), resources);
+      ++(statistic_.eviction[static_cast<size_t>(type)]);
+      updateCacheSizeStatistic<DataType>(type, *resources, &statistic_);
+    };
+  }
+}
+
 template <typename DataType>
 void updateCacheSizeStatistic(
     const ResourceType& type,
-    const typename ResourceCache::Cache<DataType>::ResourceDeque& cache,
+    const typename ResourceCache::Cache<DataType>::Resources& cache,
     CacheStatistic* statistic) {
   CHECK_NOTNULL(statistic);
   const size_t type_idx = static_cast<size_t>(type);
   CHECK_LT(type_idx, statistic->cache_size.size());
-  statistic->cache_size[type_idx] = cache.size();
+  statistic->cache_size[type_idx] = cache.index.size();
+  statistic->cache_bytes[type_idx] = cache.num_bytes;
 }
 
 }  // namespace backend
@@ -1,14 +1,21 @@
 #ifndef MAP_RESOURCES_RESOURCE_CACHE_H_
 #define MAP_RESOURCES_RESOURCE_CACHE_H_
 
-#include <deque>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include <glog/logging.h>
+#include <maplab-common/memory-accounting.h>
+#include <maplab-common/memory-budget.h>
 #include <maplab-common/unique-id.h>
 #include <opencv2/core/core.hpp>
 
@@ -19,7 +26,11 @@ namespace backend {
 struct CacheStatistic {
   std::vector<size_t> hit = std::vector<size_t>(kNumResourceTypes, 0u);
   std::vector<size_t> miss = std::vector<size_t>(kNumResourceTypes, 0u);
+  std::vector<size_t> eviction = std::vector<size_t>(kNumResourceTypes, 0u);
   std::vector<size_t> cache_size = std::vector<size_t>(kNumResourceTypes, 0u);
+  std::vector<size_t> cache_bytes = std::vector<size_t>(kNumResourceTypes, 0u);
+  // Name of the eviction strategy of the cache, see ResourceCache::Strategy.
+  std::string strategy;
 
   void reset();
   void printToLog(int verbosity) const;
@@ -27,24 +38,52 @@ struct CacheStatistic {
 
   size_t getNumHits(const ResourceType& type) const;
   size_t getNumMiss(const ResourceType& type) const;
+  size_t getNumEvictions(const ResourceType& type) const;
+  // Hits per lookup, 0 if there was no lookup.
+  double getHitRate(const ResourceType& type) const;
 };
 
-class ResourceCache {
+// Safe to use from multiple threads. Every resource type has its own lock, so
+// threads that use different resource types don't block each other, and
+// evicting to meet the memory budget holds at most one of the locks at a time.
+// The cache registers with the memory budget of the process and evicts
+// resources when other components request memory, the evicted resources are
+// reloaded from disk on their next access.
+class ResourceCache : public common::MemoryBudget::Consumer {
   friend struct CacheStatistic;
 
  public:
-  ResourceCache() {}
-
-  enum class Strategy { kFIFO = 0u };
+  // Decides which resource is evicted when the cache of a resource type is
+  // full, or which resource of all types when the cache exceeds its memory
+  // budget:
+  //  - kFIFO: the oldest one.
+  //  - kLRU: the one that has not been accessed for the longest time.
+  //  - kLFU: the one with the fewest accesses, the least recently accessed
+  //    one among those.
+  enum class Strategy { kFIFO = 0u, kLRU = 1u, kLFU = 2u };
 
   struct Config {
     size_t allocated_cache_size = 0u;
+    // Maximum number of resources per resource type.
     size_t max_cache_size = 100u;
+    // Memory budget of the resources of all types together. 0 means no
+    // limit.
+    size_t max_total_cache_bytes = 0u;
+    // Optional memory quotas of single resource types. Resources are evicted
+    // until all limits are met, resources that exceed a limit on their own
+    // are not cached.
+    std::unordered_map<ResourceType, size_t, ResourceTypeHash>
+        max_cache_bytes_per_type;
     bool cache_newest_resource = false;
     Strategy strategy = Strategy::kFIFO;
+
+    // Reads the strategy and the limits from the resource_cache_* flags.
+    static Config getFromGflags();
   };
 
-  explicit ResourceCache(const Config& cache_config) : config_(cache_config) {}
+  ResourceCache() : ResourceCache(Config::getFromGflags()) {}
+  explicit ResourceCache(const Config& cache_config);
+  virtual ~ResourceCache();
 
   template <typename DataType>
   bool getResource(
@@ -54,39 +93,140 @@ class ResourceCache {
   void putResource(
       const ResourceId& id, const ResourceType& type, const DataType& resource);
 
+  // Same as putResource(), but returns false instead of failing if the
+  // resource is cached already, e.g. because another thread loaded it at the
+  // same time.
+  template <typename DataType>
+  bool tryPutResource(
+      const ResourceId& id, const ResourceType& type, const DataType& resource);
+
   template <typename DataType>
   bool deleteResource(const ResourceId& id, const ResourceType& type);
 
+  // Checks if the resource is cached, without touching it or the statistic.
+  template <typename DataType>
+  bool hasResource(const ResourceId& id, const ResourceType& type);
+
   void resetStatistic();
 
-  const CacheStatistic& getStatistic() const;
+  // Copy of the statistic, each resource type is consistent on its own.
+  CacheStatistic getStatistic() const;
 
   const Config& getConfig() const;
 
+  // Adds the memory of all cached resources.
+  void accumulateMemoryUsage(common::MemoryUsage* usage) const;
+
+  // common::MemoryBudget::Consumer
+  std::string getMemoryConsumerName() const override;
+  size_t getReleasableMemoryBytes() const override;
+  size_t releaseMemory(size_t num_bytes) override;
+
   template <typename DataType>
   struct Cache {
-    typedef std::pair<ResourceId, DataType> Element;
-    typedef std::deque<std::pair<ResourceId, DataType>> ResourceDeque;
-    typedef std::unique_ptr<ResourceDeque> ResourceDequePtr;
-    typedef std::unique_ptr<const ResourceDeque> ResourceDequeConstPtr;
-    typedef std::unordered_map<ResourceType, ResourceDequePtr, ResourceTypeHash>
+    struct Element {
+      Element(
+          const ResourceId& _id, const DataType& _resource, size_t _num_bytes)
+          : id(_id), resource(_resource), num_bytes(_num_bytes) {}
+
+      ResourceId id;
+      DataType resource;
+      size_t num_bytes;
+      size_t num_accesses = 0u;
+      // Time of the insertion (kFIFO) or the last access (kLRU, kLFU) in
+      // cache operations, orders the evictions across resource types.
+      size_t last_access = 0u;
+    };
+    typedef std::list<Element> ElementList;
+    typedef typename ElementList::const_iterator ConstIterator;
+    typedef typename ElementList::iterator Iterator;
+
+    // Cached resources of one type. The elements are grouped by their access
+    // count for kLFU and all in group 0 otherwise, each group is ordered by
+    // insertion (kFIFO) or last access (kLRU, kLFU). The front of the first
+    // group is evicted next. Lookups go through the index, so getting,
+    // putting and evicting a resource doesn't search the elements.
+    struct Resources {
+      std::map<size_t, ElementList> groups;
+      std::unordered_map<ResourceId, Iterator> index;
+      size_t num_bytes = 0u;
+    };
+    typedef std::unique_ptr<Resources> ResourcesPtr;
+    typedef std::unordered_map<ResourceType, ResourcesPtr, ResourceTypeHash>
         ResourceTypeMap;
-    typedef typename ResourceDeque::const_iterator ConstIterator;
-    typedef typename ResourceDeque::iterator Iterator;
   };
 
  private:
+  // The cache of a type must only be used while holding its lock.
+  std::mutex& getMutex(const ResourceType& type) const;
+
   template <typename DataType>
-  typename Cache<DataType>::ResourceDeque* getCache(const ResourceType& type);
+  typename Cache<DataType>::Resources* getCache(const ResourceType& type);
 
   template <typename DataType>
-  typename Cache<DataType>::ResourceDeque* initCache(const ResourceType& type);
+  typename Cache<DataType>::Resources* initCache(const ResourceType& type);
 
   // NOTE: [ADD_RESOURCE_DATA_TYPE] Implement and add declaration below.
   template <typename DataType>
-  typename Cache<DataType>::ResourceDequePtr& getCachePtr(
+  typename Cache<DataType>::ResourcesPtr& getCachePtr(
       const ResourceType& type);
 
+  // Moves an element to the group and position of its next access.
+  template <typename DataType>
+  void touchElement(
+      typename Cache<DataType>::Iterator it,
+      typename Cache<DataType>::Resources* cache);
+
+  // Evicts resources until a resource of num_bytes_to_fit fits in the cache
+  // without exceeding the size limits.
+  template <typename DataType>
+  void evictResources(
+      const ResourceType& type, size_t num_bytes_to_fit,
+      typename Cache<DataType>::Resources* cache);
+
+  template <typename DataType>
+  void eraseElement(
+      typename Cache<DataType>::Iterator it,
+      typename Cache<DataType>::Resources* cache);
+
+  // Reserves the entries of all resource types, so that the maps are not
+  // modified anymore while several threads use them.
+  template <typename DataType>
+  static void initResourceTypeMap(
+      typename Cache<DataType>::ResourceTypeMap* cache);
+
+  template <typename DataType>
+  size_t getCacheMemoryBytes(
+      const typename Cache<DataType>::ResourceTypeMap& cache) const;
+
+  // Memory quota of the resource type, 0 if it has none.
+  size_t getMaxCacheBytes(const ResourceType& type) const;
+
+  // Next resource to evict to meet the memory budget. Evicting takes the lock
+  // of the type again, so it evicts the next resource of that type at that
+  // time, which another thread may have changed in the meantime.
+  struct EvictionCandidate {
+    size_t group = 0u;
+    size_t last_access = 0u;
+    std::function<void()> evict;
+  };
+
+  template <typename DataType>
+  void findEvictionCandidate(
+      typename Cache<DataType>::ResourceTypeMap* cache,
+      EvictionCandidate* candidate);
+
+  // Evicts resources of any type until num_bytes_to_fit fit in the memory
+  // budget. Must be called without holding any of the locks. Threads that put
+  // resources at the same time can exceed the budget by those resources until
+  // the next insertion.
+  void evictResourcesForBudget(size_t num_bytes_to_fit);
+
+  // Evicts resources of any type, in the order of the strategy, until the
+  // cache holds at most max_num_bytes. Must be called without holding any of
+  // the locks.
+  void evictResourcesDownTo(size_t max_num_bytes);
+
   // NOTE: [ADD_RESOURCE_DATA_TYPE] Add member.
   Cache<cv::Mat>::ResourceTypeMap image_cache_;
   Cache<std::string>::ResourceTypeMap text_cache_;
@@ -95,39 +235,55 @@ class ResourceCache {
   Cache<voxblox::EsdfMap>::ResourceTypeMap voxblox_esdf_map_cache_;
   Cache<voxblox::OccupancyMap>::ResourceTypeMap voxblox_occupancy_map_cache_;
 
+  // The entries of a type are guarded by the lock of the type.
   CacheStatistic statistic_;
 
-  Config config_;
+  const Config config_;
+
+  mutable std::array<std::mutex, kNumResourceTypes> mutexes_;
+
+  // Memory of the resources of all types.
+  std::atomic<size_t> num_bytes_;
+  // Counts the cache operations, see Element::last_access.
+  std::atomic<size_t> access_counter_;
 };
 
 template <>
-typename ResourceCache::Cache<cv::Mat>::ResourceDequePtr&
+typename ResourceCache::Cache<cv::Mat>::ResourcesPtr&
 ResourceCache::getCachePtr<cv::Mat>(const ResourceType& type);
 
 template <>
-typename ResourceCache::Cache<std::string>::ResourceDequePtr&
+typename ResourceCache::Cache<std::string>::ResourcesPtr&
 ResourceCache::getCachePtr<std::string>(const ResourceType& type);
 
 template <>
-typename ResourceCache::Cache<resources::PointCloud>::ResourceDequePtr&
+typename ResourceCache::Cache<resources::PointCloud>::ResourcesPtr&
 ResourceCache::getCachePtr<resources::PointCloud>(const ResourceType& type);
 
 template <>
-typename ResourceCache::Cache<voxblox::TsdfMap>::ResourceDequePtr&
+typename ResourceCache::Cache<voxblox::TsdfMap>::ResourcesPtr&
 ResourceCache::getCachePtr<voxblox::TsdfMap>(const ResourceType& type);
 
 template <>
-typename ResourceCache::Cache<voxblox::EsdfMap>::ResourceDequePtr&
+typename ResourceCache::Cache<voxblox::EsdfMap>::ResourcesPtr&
 ResourceCache::getCachePtr<voxblox::EsdfMap>(const ResourceType& type);
 
 template <>
-typename ResourceCache::Cache<voxblox::OccupancyMap>::ResourceDequePtr&
+typename ResourceCache::Cache<voxblox::OccupancyMap>::ResourcesPtr&
 ResourceCache::getCachePtr<voxblox::OccupancyMap>(const ResourceType& type);
 
+// NOTE: [ADD_RESOURCE_DATA_TYPE] Implement and add declaration below.
+size_t getResourceMemoryBytes(const cv::Mat& resource);
+size_t getResourceMemoryBytes(const std::string& resource);
+size_t getResourceMemoryBytes(const resources::PointCloud& resource);
+size_t getResourceMemoryBytes(const voxblox::TsdfMap& resource);
+size_t getResourceMemoryBytes(const voxblox::EsdfMap& resource);
+size_t getResourceMemoryBytes(const voxblox::OccupancyMap& resource);
+
 template <typename DataType>
 void updateCacheSizeStatistic(
     const ResourceType& type,
-    const typename ResourceCache::Cache<DataType>::ResourceDeque& cache,
+    const typename ResourceCache::Cache<DataType>::Resources& cache,
     CacheStatistic* statistic);
 
 }  // namespace backend
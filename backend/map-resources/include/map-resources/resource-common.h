@@ -49,6 +49,7 @@ enum class ResourceType {
   kVoxbloxTsdfMap,
   kVoxbloxEsdfMap,
   kVoxbloxOccupancyMap,
+  kProjectedDescriptorCache,
   kCount
 };
 
@@ -77,7 +78,8 @@ const std::array<std::string, kNumResourceTypes> ResourceTypeNames = {
      /*kPointCloudXYZRGBN*/ "color_point_cloud_type",
      /*kVoxbloxTsdfMap*/ "voxblox_tsdf_map",
      /*kVoxbloxEsdfMap*/ "voxblox_esdf_map",
-     /*kVoxbloxOccupancyMap*/ "voxblox_occupancy_map"}};
+     /*kVoxbloxOccupancyMap*/ "voxblox_occupancy_map",
+     /*kProjectedDescriptorCache*/ "projected_descriptor_caches"}};
 
 // NOTE: [ADD_RESOURCE_TYPE] Add suffix.
 const std::array<std::string, kNumResourceTypes> ResourceTypeFileSuffix = {
@@ -101,7 +103,11 @@ const std::array<std::string, kNumResourceTypes> ResourceTypeFileSuffix = {
      /*kPointCloudXYZRGBN*/ ".ply",
      /*kVoxbloxTsdfMap*/ ".tsdf.voxblox",
      /*kVoxbloxEsdfMap*/ ".esdf.voxblox",
-     /*kVoxbloxOccupancyMap*/ ".occupancy.voxblox"}};
+     /*kVoxbloxOccupancyMap*/ ".occupancy.voxblox",
+     /*kProjectedDescriptorCache*/ ".bin"}};
+
+// Fails for names that are not in ResourceTypeNames.
+ResourceType getResourceTypeFromName(const std::string& name);
 
 struct ResourceTypeHash {
   template <typename T>
@@ -119,10 +119,13 @@ void getPointFromPointCloud(
     const resources::PointCloud& point_cloud, const size_t index,
     Eigen::Vector3d* point_C, resources::RgbaColor* color);
 
-template <typename PointCloudType>
-bool convertDepthMapToPointCloud(
-    const cv::Mat& depth_map, const cv::Mat& image, const aslam::Camera& camera,
-    PointCloudType* point_cloud) {
+namespace internal {
+// Converts the depth map using the bearing functor, which returns false if a
+// pixel has no valid bearing or writes its bearing vector with z == 1.
+template <typename PointCloudType, typename BearingFunctor>
+bool convertDepthMapToPointCloudImpl(
+    const cv::Mat& depth_map, const cv::Mat& image,
+    const BearingFunctor& get_bearing, PointCloudType* point_cloud) {
   CHECK_NOTNULL(point_cloud);
   CHECK(!depth_map.empty());
   CHECK_GT(depth_map.rows, 0);
@@ -148,32 +151,22 @@ bool convertDepthMapToPointCloud(
   resizePointCloud(valid_depth_entries, point_cloud);
 
   constexpr double kMillimetersToMeters = 1e-3;
-  constexpr double kEpsilon = 1e-6;
 
   resources::RgbaColor color(255u, 255u, 255u, 255u);
   const uint16_t* depth_map_ptr;
+  Eigen::Vector3d bearing_C;
   size_t num_points = 0u;
   for (int v = 0; v < depth_map.rows; ++v) {
     depth_map_ptr = depth_map.ptr<uint16_t>(v);
     for (int u = 0; u < depth_map.cols; ++u) {
       const uint16_t depth = depth_map_ptr[u];
-      if (depth == 0u) {
+      if (depth == 0u || !get_bearing(u, v, &bearing_C)) {
         continue;
       }
 
-      Eigen::Vector3d point_C;
-      Eigen::Vector2d image_point;
-      image_point << u, v;
-      camera.backProject3(image_point, &point_C);
       const double depth_in_meters =
           static_cast<double>(depth) * kMillimetersToMeters;
-
-      if (point_C.z() < kEpsilon) {
-        continue;
-      }
-
-      point_C /= point_C.z();
-      point_C = depth_in_meters * point_C;
+      const Eigen::Vector3d point_C = depth_in_meters * bearing_C;
 
       if (has_image) {
         if (has_three_channels) {
@@ -204,6 +197,46 @@ bool convertDepthMapToPointCloud(
 
   return true;
 }
+}  // namespace internal
+
+template <typename PointCloudType>
+bool convertDepthMapToPointCloud(
+    const cv::Mat& depth_map, const cv::Mat& image, const aslam::Camera& camera,
+    PointCloudType* point_cloud) {
+  auto get_bearing = [&camera](
+      const int u, const int v, Eigen::Vector3d* bearing_C) -> bool {
+    constexpr double kEpsilon = 1e-6;
+    const Eigen::Vector2d image_point(u, v);
+    camera.backProject3(image_point, bearing_C);
+    if (bearing_C->z() < kEpsilon) {
+      return false;
+    }
+    *bearing_C /= bearing_C->z();
+    return true;
+  };
+  return internal::convertDepthMapToPointCloudImpl(
+      depth_map, image, get_bearing, point_cloud);
+}
+
+template <typename PointCloudType>
+bool convertDepthMapToPointCloud(
+    const cv::Mat& depth_map, const cv::Mat& image,
+    const DepthMapBackProjectionTable& table, PointCloudType* point_cloud) {
+  CHECK_EQ(depth_map.cols, table.width);
+  CHECK_EQ(depth_map.rows, table.height);
+  CHECK_EQ(table.bearings.cols(), table.width * table.height);
+  auto get_bearing = [&table](
+      const int u, const int v, Eigen::Vector3d* bearing_C) -> bool {
+    const int pixel_index = v * table.width + u;
+    if (!table.is_valid[pixel_index]) {
+      return false;
+    }
+    *bearing_C << table.bearings.col(pixel_index), 1.0;
+    return true;
+  };
+  return internal::convertDepthMapToPointCloudImpl(
+      depth_map, image, get_bearing, point_cloud);
+}
 
 template <typename InputPointCloud, typename OutputPointCloud>
 bool convertPointCloudType(
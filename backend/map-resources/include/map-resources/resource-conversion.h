@@ -20,6 +20,32 @@ bool convertDepthMapToPointCloud(
     const cv::Mat& depth_map, const cv::Mat& image, const aslam::Camera& camera,
     PointCloudType* point_cloud);
 
+// Bearing vectors of all pixels of a depth map, normalized to a z component
+// of one, such that a depth map can be converted to a point cloud without
+// running the camera model for every pixel. The table only depends on the
+// camera, so it can be computed once and shared between all depth maps of that
+// camera.
+struct DepthMapBackProjectionTable {
+  DepthMapBackProjectionTable() : width(0), height(0) {}
+  int width;
+  int height;
+  // x and y of the normalized bearing vectors in row-major pixel order.
+  Eigen::Matrix2Xd bearings;
+  // False for pixels that do not back-project in front of the camera.
+  std::vector<unsigned char> is_valid;
+};
+
+void computeDepthMapBackProjectionTable(
+    const aslam::Camera& camera, int width, int height,
+    DepthMapBackProjectionTable* table);
+
+// Same as above, but looks the bearing vectors up in the back-projection
+// table, which has to match the size of the depth map.
+template <typename PointCloudType>
+bool convertDepthMapToPointCloud(
+    const cv::Mat& depth_map, const cv::Mat& image,
+    const DepthMapBackProjectionTable& table, PointCloudType* point_cloud);
+
 template <typename InputPointCloud, typename OutputPointCloud>
 bool convertPointCloudType(
     const InputPointCloud& input_cloud, OutputPointCloud* output_cloud);
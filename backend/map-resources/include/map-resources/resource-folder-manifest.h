@@ -0,0 +1,85 @@
+#ifndef MAP_RESOURCES_RESOURCE_FOLDER_MANIFEST_H_
+#define MAP_RESOURCES_RESOURCE_FOLDER_MANIFEST_H_
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <maplab-common/macros.h>
+
+#include "map-resources/resource-common.h"
+
+namespace backend {
+
+// Index of the resource files in a resource folder, persisted in the folder
+// such that checking whether resources exist doesn't need to check every
+// file. The index of a resource type is only rebuilt from a listing of its
+// folder if the modification time of the folder changed since the index
+// was saved, which happens whenever a file is added or removed. Only the new
+// files are checked individually then.
+//
+// Doesn't cover the resources in packed containers, which keep an index of
+// their own. Not thread safe.
+class ResourceFolderManifest {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(ResourceFolderManifest);
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(ResourceFolderManifest);
+
+  struct ResourceFileInfo {
+    uint64_t num_bytes;
+    // Modification time of the file in seconds since the epoch.
+    int64_t modification_time_s;
+  };
+
+  static constexpr const char* kManifestFileName = "resource_manifest.txt";
+
+  explicit ResourceFolderManifest(const std::string& resource_folder);
+
+  // Loads the saved manifest, rescans the type folders that changed since and
+  // saves the manifest again if anything changed. Saving fails silently if
+  // the folder is read-only.
+  void update();
+
+  bool hasResource(const ResourceId& id, const ResourceType& type) const;
+  // Returns false if the folder doesn't have the resource.
+  bool getResourceFileInfo(
+      const ResourceId& id, const ResourceType& type,
+      ResourceFileInfo* info) const;
+
+  size_t getNumResources() const;
+  // Number of type folders that were rescanned by the last update.
+  size_t getNumRescannedTypeFolders() const {
+    return num_rescanned_type_folders_;
+  }
+
+ private:
+  typedef std::unordered_map<ResourceId, ResourceFileInfo> ResourceFileInfoMap;
+
+  struct TypeFolder {
+    TypeFolder() : modification_time_s(-1), scan_time_s(-1) {}
+    // Modification time of the type folder when it was scanned, -1 if it
+    // didn't exist.
+    int64_t modification_time_s;
+    // When the type folder was scanned. Changes within the same second as
+    // the scan don't change the modification time reliably, scans at such
+    // times are repeated.
+    int64_t scan_time_s;
+    ResourceFileInfoMap files;
+  };
+
+  bool load();
+  bool save() const;
+  // Returns true if the type folder changed since the last scan.
+  bool updateTypeFolder(const ResourceType& type, TypeFolder* type_folder);
+
+  const std::string resource_folder_;
+  std::string manifest_file_path_;
+  std::vector<TypeFolder> type_folders_;
+  size_t num_rescanned_type_folders_;
+};
+
+}  // namespace backend
+
+#endif  // MAP_RESOURCES_RESOURCE_FOLDER_MANIFEST_H_
@@ -0,0 +1,112 @@
+#ifndef MAP_RESOURCES_RESOURCE_IO_STATISTICS_H_
+#define MAP_RESOURCES_RESOURCE_IO_STATISTICS_H_
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "map-resources/resource-common.h"
+
+namespace backend {
+
+// Bucket 0 of the latency histograms counts the operations that took less
+// than 1 us, bucket i the ones that took [2^(i-1), 2^i) us and the last
+// bucket all slower ones, i.e. the histograms resolve latencies up to ~4 s.
+constexpr size_t kNumIoLatencyBuckets = 23u;
+
+// Loads and stores of resources from and to disk by resource type. Cache hits
+// don't load anything, they are counted in the CacheStatistic.
+struct ResourceIoStatistic {
+  typedef std::array<size_t, kNumIoLatencyBuckets> LatencyHistogram;
+
+  std::vector<size_t> num_loads = std::vector<size_t>(kNumResourceTypes, 0u);
+  std::vector<size_t> num_stores = std::vector<size_t>(kNumResourceTypes, 0u);
+  std::vector<size_t> bytes_loaded =
+      std::vector<size_t>(kNumResourceTypes, 0u);
+  std::vector<size_t> bytes_stored =
+      std::vector<size_t>(kNumResourceTypes, 0u);
+  // Time spent in the file system, i.e. opening and reading or writing the
+  // resource files and packed containers.
+  std::vector<int64_t> read_ns = std::vector<int64_t>(kNumResourceTypes, 0);
+  std::vector<int64_t> write_ns = std::vector<int64_t>(kNumResourceTypes, 0);
+  // Time spent decoding and encoding the resources. Some formats are parsed
+  // while they are read, e.g. voxblox layers and PLY point clouds, their
+  // parsing counts as file system time.
+  std::vector<int64_t> decode_ns = std::vector<int64_t>(kNumResourceTypes, 0);
+  std::vector<int64_t> encode_ns = std::vector<int64_t>(kNumResourceTypes, 0);
+  // File system latency of the single loads.
+  std::vector<LatencyHistogram> read_latency_histogram =
+      std::vector<LatencyHistogram>(kNumResourceTypes, LatencyHistogram());
+
+  void reset();
+  // True if nothing was loaded or stored.
+  bool empty() const;
+
+  // The loads and stores that happened since the earlier statistic was
+  // taken.
+  ResourceIoStatistic getDifference(const ResourceIoStatistic& earlier) const;
+
+  // Upper end of the histogram bucket in which the given fraction of the
+  // loads of the type finished their file system reads, 0 if there were no
+  // loads.
+  double getReadLatencyQuantileMicroseconds(
+      const ResourceType& type, const double quantile) const;
+
+  void printToLog(int verbosity) const;
+  // Only lists the resource types that were loaded or stored.
+  std::string print() const;
+};
+
+// Collects the I/O statistic of the resource loaders of all maps of the
+// process, such that it can be reported per console command. Safe to use from
+// multiple threads.
+class ResourceIoStatistics {
+ public:
+  // Measures a load or store from its construction on. The time that the
+  // thread spends in ScopedCodecTimers in between counts as decoding or
+  // encoding time, the rest as file system time.
+  class OperationTimer {
+   public:
+    OperationTimer();
+    void finishLoad(const ResourceType& type, size_t num_bytes) const;
+    void finishStore(const ResourceType& type, size_t num_bytes) const;
+
+   private:
+    void getTimes(int64_t* file_system_ns, int64_t* codec_ns) const;
+
+    const std::chrono::steady_clock::time_point start_;
+    const int64_t thread_codec_ns_at_start_;
+  };
+
+  // Wraps the decoding or encoding of a resource.
+  class ScopedCodecTimer {
+   public:
+    ScopedCodecTimer();
+    ~ScopedCodecTimer();
+
+   private:
+    const std::chrono::steady_clock::time_point start_;
+  };
+
+  static void recordLoad(
+      const ResourceType& type, size_t num_bytes, int64_t read_ns,
+      int64_t decode_ns);
+  static void recordStore(
+      const ResourceType& type, size_t num_bytes, int64_t write_ns,
+      int64_t encode_ns);
+
+  static ResourceIoStatistic getStatistic();
+  static void reset();
+
+ private:
+  static int64_t& getThreadCodecNanoseconds();
+};
+
+// Size of the file, 0 if it doesn't exist.
+size_t getFileSizeBytes(const std::string& file_path);
+
+}  // namespace backend
+
+#endif  // MAP_RESOURCES_RESOURCE_IO_STATISTICS_H_
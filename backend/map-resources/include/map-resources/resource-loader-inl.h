@@ -3,10 +3,15 @@
 
 #include <string>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <maplab-common/file-system-tools.h>
+#include <maplab-common/tracing.h>
 
 #include "map-resources/resource-common.h"
+#include "map-resources/resource-io-statistics.h"
+
+DECLARE_bool(resource_use_packed_containers);
 
 namespace backend {
 
@@ -20,9 +25,28 @@ void ResourceLoader::addResource(
     cache_.putResource<DataType>(id, type, resource);
   }
 
+  MAPLAB_TRACE_SCOPE("resources", "save resource");
+  const ResourceIoStatistics::OperationTimer store_timer;
+  std::string encoded_resource;
+  bool is_encoded = false;
+  if (FLAGS_resource_use_packed_containers) {
+    const ResourceIoStatistics::ScopedCodecTimer encode_timer;
+    is_encoded = encodeResource<DataType>(type, resource, &encoded_resource);
+  }
+  if (is_encoded) {
+    PackedResourceContainer* container =
+        CHECK_NOTNULL(getPackedContainer(folder, type, true));
+    CHECK(!container->hasResource(id))
+        << "The packed container in " << folder << " has the resource "
+        << id.hexString() << " already!";
+    container->putResource(id, encoded_resource);
+    store_timer.finishStore(type, encoded_resource.size());
+    return;
+  }
   std::string file_path;
   getResourceFilePath(id, type, folder, &file_path);
   saveResourceToFile(file_path, type, resource);
+  store_timer.finishStore(type, getFileSizeBytes(file_path));
 }
 
 template <typename DataType>
@@ -34,25 +58,75 @@ void ResourceLoader::getResource(
   if (cache_.getResource<DataType>(id, type, resource)) {
     return;
   } else {
-    std::string file_path;
-    getResourceFilePath(id, type, folder, &file_path);
-    CHECK(loadResourceFromFile(file_path, type, resource))
+    MAPLAB_TRACE_SCOPE("resources", "load resource");
+    CHECK(loadResource<DataType>(id, type, folder, resource))
         << "Failed to load " << ResourceTypeNames[static_cast<size_t>(type)]
         << " resource with id " << id.hexString()
-        << " from file: " << file_path;
-    cache_.putResource<DataType>(id, type, *resource);
+        << " from folder: " << folder;
+    // Another thread may have loaded it at the same time.
+    cache_.tryPutResource<DataType>(id, type, *resource);
   }
 }
 
+template <typename DataType>
+bool ResourceLoader::getCachedResource(
+    const ResourceId& id, const ResourceType& type, DataType* resource) const {
+  CHECK_NOTNULL(resource);
+  return cache_.getResource<DataType>(id, type, resource);
+}
+
+template <typename DataType>
+void ResourceLoader::cacheResource(
+    const ResourceId& id, const ResourceType& type,
+    const DataType& resource) const {
+  cache_.tryPutResource<DataType>(id, type, resource);
+}
+
+template <typename DataType>
+bool ResourceLoader::isResourceCached(
+    const ResourceId& id, const ResourceType& type) const {
+  return cache_.hasResource<DataType>(id, type);
+}
+
 template <typename DataType>
 bool ResourceLoader::checkResourceFile(
     const ResourceId& id, const ResourceType& type,
     const std::string& folder) const {
   CHECK(!folder.empty());
   DataType resource;
+  return loadResource<DataType>(id, type, folder, &resource);
+}
+
+template <typename DataType>
+bool ResourceLoader::loadResource(
+    const ResourceId& id, const ResourceType& type, const std::string& folder,
+    DataType* resource) const {
+  CHECK(!folder.empty());
+  CHECK_NOTNULL(resource);
+  const ResourceIoStatistics::OperationTimer load_timer;
+  const PackedResourceContainer* container =
+      getPackedContainer(folder, type, false);
+  if (container != nullptr && container->hasResource(id)) {
+    size_t num_bytes_read = 0u;
+    const bool success = container->readResource(
+        id, [this, &type, resource, &num_bytes_read](
+                const char* data, size_t num_bytes) {
+          num_bytes_read = num_bytes;
+          const ResourceIoStatistics::ScopedCodecTimer decode_timer;
+          return decodeResource<DataType>(type, data, num_bytes, resource);
+        });
+    if (success) {
+      load_timer.finishLoad(type, num_bytes_read);
+    }
+    return success;
+  }
   std::string file_path;
   getResourceFilePath(id, type, folder, &file_path);
-  return loadResourceFromFile(file_path, type, &resource);
+  const bool success = loadResourceFromFile(file_path, type, resource);
+  if (success) {
+    load_timer.finishLoad(type, getFileSizeBytes(file_path));
+  }
+  return success;
 }
 
 template <typename DataType>
@@ -73,6 +147,23 @@ void ResourceLoader::replaceResource(
   addResource<DataType>(id, type, folder, resource);
 }
 
+template <typename DataType>
+bool ResourceLoader::encodeResource(
+    const ResourceType& /*type*/, const DataType& /*resource*/,
+    std::string* /*encoded_resource*/) const {
+  return false;
+}
+
+template <typename DataType>
+bool ResourceLoader::decodeResource(
+    const ResourceType& type, const char* /*data*/, size_t /*num_bytes*/,
+    DataType* /*resource*/) const {
+  LOG(FATAL) << "ResourceLoader::decodeResource() is not implemented for "
+             << "this DataType! Cannot decode resource of type "
+             << ResourceTypeNames[static_cast<size_t>(type)] << ".";
+  return false;
+}
+
 template <typename DataType>
 void ResourceLoader::saveResourceToFile(
     const std::string& file, const ResourceType& type,
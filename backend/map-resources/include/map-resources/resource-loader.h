@@ -1,13 +1,22 @@
 #ifndef MAP_RESOURCES_RESOURCE_LOADER_H_
 #define MAP_RESOURCES_RESOURCE_LOADER_H_
 
+#include <mutex>
 #include <string>
+#include <unordered_map>
 
+#include <Eigen/Geometry>
+
+#include "map-resources/packed-resource-container.h"
 #include "map-resources/resource-cache.h"
 #include "map-resources/resource-common.h"
 
 namespace backend {
 
+// Stores every resource in its own file, or, with
+// --resource_use_packed_containers, the resources of the data types that can
+// be encoded into memory in one packed container per resource type and
+// folder. Resources are read from both, so maps can mix them.
 class ResourceLoader {
  public:
   ResourceLoader() {}
@@ -37,15 +46,50 @@ class ResourceLoader {
       const ResourceId& id, const ResourceType& type,
       const std::string& folder) const;
 
+  // Loads the resource from the packed container of the folder if the
+  // container has it, from the resource file otherwise. Doesn't use the
+  // cache.
+  template <typename DataType>
+  bool loadResource(
+      const ResourceId& id, const ResourceType& type, const std::string& folder,
+      DataType* resource) const;
+
+  // Loads the points of a point cloud resource that are inside of the region,
+  // see ChunkedPointCloudReader for the level of detail. Chunked point clouds
+  // are read only partially, PLY point clouds are read completely and then
+  // cropped. Doesn't use the cache.
+  bool loadPointCloudRegion(
+      const ResourceId& id, const ResourceType& type, const std::string& folder,
+      const Eigen::AlignedBox3f& region, const double level_of_detail,
+      resources::PointCloud* point_cloud) const;
+
+  // Looks the resource up in the cache only, counts as a cache hit or miss.
+  template <typename DataType>
+  bool getCachedResource(
+      const ResourceId& id, const ResourceType& type,
+      DataType* resource) const;
+
+  // Puts the resource in the cache unless it is cached already, e.g. after
+  // loading it on another thread.
+  template <typename DataType>
+  void cacheResource(
+      const ResourceId& id, const ResourceType& type,
+      const DataType& resource) const;
+
+  template <typename DataType>
+  bool isResourceCached(const ResourceId& id, const ResourceType& type) const;
+
   template <typename DataType>
   void replaceResource(
       const ResourceId& id, const ResourceType& type, const std::string& folder,
       const DataType& resource);
 
-  const CacheStatistic& getCacheStatistic() const;
+  CacheStatistic getCacheStatistic() const;
 
   const ResourceCache::Config& getCacheConfig() const;
 
+  void accumulateCacheMemoryUsage(common::MemoryUsage* usage) const;
+
   bool resourceFileExists(
       const ResourceId& id, const ResourceType& type,
       const std::string& folder) const;
@@ -54,10 +98,21 @@ class ResourceLoader {
       const ResourceId& id, const ResourceType& type, const std::string& folder,
       std::string* file_path) const;
 
+  // Gets the file the resource is stored in, such that it can be copied
+  // without decoding it. Returns false if the resource is not stored in a
+  // file of its own, e.g. because the packed container of the folder has it.
+  bool getStandaloneResourceFilePath(
+      const ResourceId& id, const ResourceType& type, const std::string& folder,
+      std::string* file_path) const;
+
   void deleteResourceFile(
       const ResourceId& id, const ResourceType& type,
       const std::string& folder);
 
+  // Compacts the packed containers of the folder in which the superseded
+  // records exceed --resource_packed_compaction_threshold.
+  void compactPackedContainers(const std::string& folder);
+
   // NOTE: [ADD_RESOURCE_DATA_TYPE] Implement and add declaration below.
   template <typename DataType>
   void saveResourceToFile(
@@ -70,8 +125,34 @@ class ResourceLoader {
       const std::string& file_path, const ResourceType& type,
       DataType* resource) const;
 
+  // Encodes the resource for packed containers. Returns false for the data
+  // types that can't be encoded into memory, their resources are always
+  // stored in files.
+  // NOTE: [ADD_RESOURCE_DATA_TYPE] Implement and add declaration below.
+  template <typename DataType>
+  bool encodeResource(
+      const ResourceType& type, const DataType& resource,
+      std::string* encoded_resource) const;
+
+  // NOTE: [ADD_RESOURCE_DATA_TYPE] Implement and add declaration below.
+  template <typename DataType>
+  bool decodeResource(
+      const ResourceType& type, const char* data, size_t num_bytes,
+      DataType* resource) const;
+
  private:
+  // Returns nullptr if the folder has no container for the resource type,
+  // unless create is true.
+  PackedResourceContainer* getPackedContainer(
+      const std::string& folder, const ResourceType& type,
+      bool create) const;
+
   mutable ResourceCache cache_;
+
+  // Containers by container folder, opened on first use.
+  mutable std::mutex packed_containers_mutex_;
+  mutable std::unordered_map<std::string, PackedResourceContainer::Ptr>
+      packed_containers_;
 };
 
 // Implementation for cv::Mat resources.
@@ -83,6 +164,14 @@ template <>
 bool ResourceLoader::loadResourceFromFile(
     const std::string& file_path, const ResourceType& type,
     cv::Mat* resource) const;
+template <>
+bool ResourceLoader::encodeResource(
+    const ResourceType& type, const cv::Mat& resource,
+    std::string* encoded_resource) const;
+template <>
+bool ResourceLoader::decodeResource(
+    const ResourceType& type, const char* data, size_t num_bytes,
+    cv::Mat* resource) const;
 
 // Implementation for std::string resources.
 template <>
@@ -93,6 +182,14 @@ template <>
 bool ResourceLoader::loadResourceFromFile(
     const std::string& file_path, const ResourceType& type,
     std::string* resource) const;
+template <>
+bool ResourceLoader::encodeResource(
+    const ResourceType& type, const std::string& resource,
+    std::string* encoded_resource) const;
+template <>
+bool ResourceLoader::decodeResource(
+    const ResourceType& type, const char* data, size_t num_bytes,
+    std::string* resource) const;
 
 // Implementation for voxblox::TsdfMap resources.
 template <>
@@ -133,6 +230,14 @@ template <>
 bool ResourceLoader::loadResourceFromFile(
     const std::string& file_path, const ResourceType& type,
     resources::PointCloud* resource) const;
+template <>
+bool ResourceLoader::encodeResource(
+    const ResourceType& type, const resources::PointCloud& resource,
+    std::string* encoded_resource) const;
+template <>
+bool ResourceLoader::decodeResource(
+    const ResourceType& type, const char* data, size_t num_bytes,
+    resources::PointCloud* resource) const;
 
 }  // namespace backend
 
@@ -1,9 +1,15 @@
 #ifndef MAP_RESOURCES_RESOURCE_MAP_INL_H_
 #define MAP_RESOURCES_RESOURCE_MAP_INL_H_
 
+#include <functional>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include <aslam/common/reader-writer-lock.h>
+#include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 
 #include "map-resources/resource-common.h"
 #include "map-resources/resource-map.h"
@@ -14,7 +20,10 @@ template <typename DataType>
 bool ResourceMap::getResource(
     const ResourceId& id, const ResourceType& type, DataType* resource) const {
   CHECK_NOTNULL(resource);
-  aslam::ScopedWriteLock lock(&resource_mutex_);
+  // Before locking, the prefetch threads need the lock to finish loading.
+  notifyResourcePrefetcher(id, type);
+  // The cache is thread-safe, so readers load resources concurrently.
+  aslam::ScopedReadLock lock(&resource_mutex_);
   const ResourceInfoMap& info_map =
       resource_info_map_[static_cast<size_t>(type)];
   const ResourceInfoMap::const_iterator it = info_map.find(id);
@@ -29,6 +38,68 @@ bool ResourceMap::getResource(
   }
 }
 
+template <typename DataType>
+bool ResourceMap::getResources(
+    const std::vector<ResourceId>& ids, const ResourceType& type,
+    std::vector<DataType>* resources) const {
+  CHECK_NOTNULL(resources)->clear();
+  resources->resize(ids.size());
+
+  // Indices and folders of the resources that need to be loaded.
+  std::vector<size_t> indices_to_load;
+  std::vector<std::string> folders;
+  bool all_resources_exist = true;
+  {
+    aslam::ScopedReadLock lock(&resource_mutex_);
+    const ResourceInfoMap& info_map =
+        resource_info_map_[static_cast<size_t>(type)];
+    for (size_t idx = 0u; idx < ids.size(); ++idx) {
+      const ResourceInfoMap::const_iterator it = info_map.find(ids[idx]);
+      if (it == info_map.cend()) {
+        all_resources_exist = false;
+        continue;
+      }
+      if (resource_loader_.getCachedResource<DataType>(
+              ids[idx], type, &(*resources)[idx])) {
+        continue;
+      }
+      indices_to_load.push_back(idx);
+      folders.emplace_back();
+      getFolderFromIndex(it->second.folder_idx, &folders.back());
+    }
+  }
+  if (indices_to_load.empty()) {
+    return all_resources_exist;
+  }
+
+  const std::function<void(size_t, size_t)> load_resources =
+      [&](size_t begin, size_t end) {
+        for (size_t load_idx = begin; load_idx < end; ++load_idx) {
+          const size_t idx = indices_to_load[load_idx];
+          CHECK(resource_loader_.loadResource<DataType>(
+              ids[idx], type, folders[load_idx], &(*resources)[idx]))
+              << "Failed to load "
+              << ResourceTypeNames[static_cast<size_t>(type)]
+              << " resource with id " << ids[idx].hexString()
+              << " from folder: " << folders[load_idx];
+        }
+      };
+  common::ParallelProcessDynamic(
+      indices_to_load.size(), load_resources, common::getNumHardwareThreads());
+
+  aslam::ScopedReadLock lock(&resource_mutex_);
+  const ResourceInfoMap& info_map =
+      resource_info_map_[static_cast<size_t>(type)];
+  for (const size_t idx : indices_to_load) {
+    // The resource may have been deleted in the meantime.
+    if (info_map.count(ids[idx]) > 0u) {
+      resource_loader_.cacheResource<DataType>(
+          ids[idx], type, (*resources)[idx]);
+    }
+  }
+  return all_resources_exist;
+}
+
 template <typename DataType>
 void ResourceMap::addResource(
     const ResourceType& type, const DataType& resource, ResourceId* id) {
@@ -162,6 +233,51 @@ bool ResourceMap::checkResource(
   }
 }
 
+template <typename DataType>
+void ResourceMap::prefetchResources(
+    const ResourceIdAndTypeList& sequence) const {
+  std::lock_guard<std::mutex> lock(prefetcher_mutex_);
+  // Stop the previous prefetch first, its threads may still be loading.
+  prefetcher_.reset();
+  if (sequence.empty()) {
+    return;
+  }
+  prefetcher_.reset(new ResourcePrefetcher(
+      sequence, [this](const ResourceId& id, const ResourceType& type) {
+        prefetchResource<DataType>(id, type);
+      }));
+}
+
+template <typename DataType>
+void ResourceMap::prefetchResource(
+    const ResourceId& id, const ResourceType& type) const {
+  std::string folder;
+  {
+    aslam::ScopedReadLock lock(&resource_mutex_);
+    const ResourceInfoMap& info_map =
+        resource_info_map_[static_cast<size_t>(type)];
+    const ResourceInfoMap::const_iterator it = info_map.find(id);
+    if (it == info_map.cend() ||
+        resource_loader_.isResourceCached<DataType>(id, type)) {
+      return;
+    }
+    getFolderFromIndex(it->second.folder_idx, &folder);
+  }
+
+  DataType resource;
+  if (!resource_loader_.loadResource<DataType>(id, type, folder, &resource)) {
+    VLOG(1) << "Failed to prefetch resource " << id.hexString()
+            << " from folder: " << folder;
+    return;
+  }
+
+  aslam::ScopedReadLock lock(&resource_mutex_);
+  // The resource may have been deleted in the meantime.
+  if (resource_info_map_[static_cast<size_t>(type)].count(id) > 0u) {
+    resource_loader_.cacheResource<DataType>(id, type, resource);
+  }
+}
+
 }  // namespace backend
 
 #endif  // MAP_RESOURCES_RESOURCE_MAP_INL_H_
@@ -1,6 +1,8 @@
 #ifndef MAP_RESOURCES_RESOURCE_MAP_H_
 #define MAP_RESOURCES_RESOURCE_MAP_H_
 
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -9,6 +11,7 @@
 
 #include "map-resources/resource-common.h"
 #include "map-resources/resource-loader.h"
+#include "map-resources/resource-prefetcher.h"
 
 #include "map-resources/resource_metadata.pb.h"
 
@@ -75,6 +78,11 @@ class ResourceMap {
     std::vector<std::string> external_resource_folders;
   };
 
+  // Moves or copies all resources to the folder, in parallel on
+  // --resource_migration_num_threads threads. Files are renamed, reflinked or
+  // hardlinked where the file system allows it, see ResourceLoader. Calling
+  // it again after an interruption skips the resources that were migrated
+  // already.
   void migrateAllResourcesToFolder(
       const std::string& resource_folder, const bool move_resources);
   void migrateAllResourcesToMapResourceFolder(const bool move_resources);
@@ -154,6 +162,9 @@ class ResourceMap {
   size_t numResources() const;
   size_t numResourcesOfType(const ResourceType& type) const;
 
+  // Adds the memory of the cached resources and the resource info index.
+  void accumulateResourceMemoryUsage(common::MemoryUsage* usage) const;
+
   std::string printCacheStatistics() const;
   void printCacheStatisticsToLog(int verbosity) const;
 
@@ -165,9 +176,31 @@ class ResourceMap {
   void cleanupResourceFolders();
 
   // Check if all resource files are present. Does not check the content of the
-  // resource files.
+  // resource files. Uses the manifests of the resource folders, see
+  // ResourceFolderManifest, such that only the type folders that changed
+  // since the last check are listed.
   bool checkResourceFileSystem() const;
 
+  // Loads the resources into the resource cache on background threads, in
+  // the order of the sequence and ahead of getting them, such that the disk
+  // access overlaps with the work on the previous resources. All resources
+  // must be of DataType. Replaces the previous prefetch, if any. See
+  // ResourcePrefetcher for the size of the window.
+  template <typename DataType>
+  void prefetchResources(const ResourceIdAndTypeList& sequence) const;
+  void stopPrefetchingResources() const;
+
+  // Gets the file the resource is stored in, see
+  // ResourceLoader::getStandaloneResourceFilePath(). Returns false if the
+  // resource is not part of the map or not stored in a file of its own.
+  bool getResourceFilePath(
+      const ResourceId& id, const ResourceType& type,
+      std::string* file_path) const;
+
+  // Returns true if the resource is registered in the map, regardless of
+  // whether it is cached or in which folder it is stored.
+  bool hasResourceInfo(const ResourceId& id, const ResourceType& type) const;
+
  protected:
   // Check if the resource file is present and attempt to load it to verify its
   // content.
@@ -196,6 +229,24 @@ class ResourceMap {
   bool getResource(
       const ResourceId& id, const ResourceType& type, DataType* resource) const;
 
+  // Gets many resources of the same type at once, in the order of the ids.
+  // The resources that aren't cached are read and decoded in parallel,
+  // without holding the lock. Returns false if any of the resources doesn't
+  // exist, these are left default constructed.
+  template <typename DataType>
+  bool getResources(
+      const std::vector<ResourceId>& ids, const ResourceType& type,
+      std::vector<DataType>* resources) const;
+
+  // Gets the points of a point cloud resource inside of the region, without
+  // caching them. Only reads the chunks in the region if the point cloud is
+  // stored as a chunked point cloud, see --resource_point_cloud_chunk_meters.
+  // Returns false if the resource doesn't exist.
+  bool getPointCloudRegion(
+      const ResourceId& id, const ResourceType& type,
+      const Eigen::AlignedBox3f& region, const double level_of_detail,
+      resources::PointCloud* point_cloud) const;
+
   // Returns true if the resource was successfully deleted, false if it didn't
   // exist in the first place. By default it also deletes the file on the
   // file-system.
@@ -235,6 +286,15 @@ class ResourceMap {
 
   bool resourceFileExists(const ResourceId& id, const ResourceType& type) const;
 
+  // Loads a resource into the cache, called by the prefetch threads. Doesn't
+  // hold the lock while reading the file.
+  template <typename DataType>
+  void prefetchResource(const ResourceId& id, const ResourceType& type) const;
+
+  // Moves the prefetch window, see ResourcePrefetcher::notifyConsumed().
+  void notifyResourcePrefetcher(
+      const ResourceId& id, const ResourceType& type) const;
+
   MetaData meta_data_;
 
   typedef std::unordered_map<ResourceId, ResourceInfo> ResourceInfoMap;
@@ -244,6 +304,11 @@ class ResourceMap {
   ResourceLoader resource_loader_;
 
   mutable aslam::ReaderWriterMutex resource_mutex_;
+
+  mutable std::mutex prefetcher_mutex_;
+  // Declared last, such that the prefetch threads are stopped before the
+  // members they use are destroyed.
+  mutable std::unique_ptr<ResourcePrefetcher> prefetcher_;
 };
 
 }  // namespace backend
@@ -0,0 +1,76 @@
+#ifndef MAP_RESOURCES_RESOURCE_PREFETCHER_H_
+#define MAP_RESOURCES_RESOURCE_PREFETCHER_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <maplab-common/macros.h>
+
+#include "map-resources/resource-common.h"
+
+namespace backend {
+
+typedef std::pair<ResourceId, ResourceType> ResourceIdAndType;
+typedef std::vector<ResourceIdAndType> ResourceIdAndTypeList;
+
+// Loads the resources of a sequence on background threads, in the order of
+// the sequence and at most a window of resources ahead of the consumer. The
+// consumer reports the resources it gets, which moves the window along. Use it
+// through ResourceMap::prefetchResources().
+class ResourcePrefetcher {
+ public:
+  // Loads a resource from disk into the cache.
+  typedef std::function<void(const ResourceId&, const ResourceType&)>
+      LoadFunction;
+
+  // The window size and the number of threads come from the
+  // resource_prefetch_* flags.
+  ResourcePrefetcher(
+      const ResourceIdAndTypeList& sequence, const LoadFunction& load_function);
+  ResourcePrefetcher(
+      const ResourceIdAndTypeList& sequence, const LoadFunction& load_function,
+      size_t window_size, size_t num_threads);
+  // Stops loading and waits for the resources that are being loaded.
+  ~ResourcePrefetcher();
+
+  // Moves the window past the resource if it is part of the sequence, and
+  // blocks while it is being loaded, so that the consumer finds it in the
+  // cache instead of loading it a second time.
+  void notifyConsumed(const ResourceId& id, const ResourceType& type);
+
+  // Number of resources the threads have loaded or are loading.
+  size_t getNumPrefetched() const;
+
+ private:
+  void workerLoop();
+
+  const ResourceIdAndTypeList sequence_;
+  // Position in the sequence of every resource id.
+  std::unordered_map<ResourceId, size_t> sequence_indices_;
+  const LoadFunction load_function_;
+  const size_t window_size_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  // Next resource to load.
+  size_t next_index_;
+  // Resources before this index have been consumed.
+  size_t consumed_index_;
+  size_t num_prefetched_;
+  std::unordered_set<ResourceId> ids_being_loaded_;
+  bool stop_requested_;
+
+  std::vector<std::thread> threads_;
+
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(ResourcePrefetcher);
+};
+
+}  // namespace backend
+
+#endif  // MAP_RESOURCES_RESOURCE_PREFETCHER_H_
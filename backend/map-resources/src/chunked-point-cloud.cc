@@ -0,0 +1,343 @@
+#include "map-resources/chunked-point-cloud.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace backend {
+
+namespace {
+constexpr uint32_t kMagicNumber = 0x5043524du;  // "MRCP"
+constexpr uint32_t kVersion = 1u;
+constexpr uint32_t kHasNormalsFlag = 1u << 0;
+constexpr uint32_t kHasColorsFlag = 1u << 1;
+
+struct ChunkedPointCloudHeader {
+  uint32_t magic_number;
+  uint32_t version;
+  uint32_t flags;
+  float chunk_size_meters;
+  uint64_t num_points;
+  uint64_t num_chunks;
+};
+static_assert(
+    sizeof(ChunkedPointCloudHeader) == 32u, "Unexpected header padding.");
+
+struct ChunkIndexEntry {
+  // Bounding box of the points of the chunk.
+  float min[3];
+  float max[3];
+  uint64_t first_point;
+  uint64_t num_points;
+};
+static_assert(
+    sizeof(ChunkIndexEntry) == 40u, "Unexpected chunk index entry padding.");
+
+typedef std::array<int32_t, 3> ChunkKey;
+
+constexpr size_t kNumBytesPerCoordinates = 3u * sizeof(float);
+constexpr size_t kNumBytesPerColor = 3u * sizeof(unsigned char);
+
+constexpr size_t kNumMortonBitsPerAxis = 10u;
+
+// Orders the points of a chunk by their reversed Morton code, i.e. their
+// position on an octree over the chunk read from the finest level up. Every
+// prefix then spreads evenly over the chunk.
+void getProgressiveOrder(
+    const resources::PointCloud& point_cloud, const ChunkKey& key,
+    const double chunk_size_meters, const std::vector<size_t>& point_indices,
+    std::vector<size_t>* ordered_point_indices) {
+  CHECK_NOTNULL(ordered_point_indices)->clear();
+  constexpr uint32_t kNumCellsPerAxis = 1u << kNumMortonBitsPerAxis;
+  std::vector<std::pair<uint32_t, size_t>> codes_and_point_indices;
+  codes_and_point_indices.reserve(point_indices.size());
+  for (const size_t point_idx : point_indices) {
+    uint32_t reversed_code = 0u;
+    for (size_t axis = 0u; axis < 3u; ++axis) {
+      const double offset =
+          point_cloud.xyz[3u * point_idx + axis] / chunk_size_meters -
+          key[axis];
+      const uint32_t cell = static_cast<uint32_t>(std::min(
+          std::max(offset * kNumCellsPerAxis, 0.0),
+          static_cast<double>(kNumCellsPerAxis - 1u)));
+      // Bit b of the cell goes to bit 3 * (bits - 1 - b) + axis of the
+      // reversed code.
+      for (size_t bit = 0u; bit < kNumMortonBitsPerAxis; ++bit) {
+        reversed_code |= ((cell >> bit) & 1u)
+                         << (3u * (kNumMortonBitsPerAxis - 1u - bit) + axis);
+      }
+    }
+    codes_and_point_indices.emplace_back(reversed_code, point_idx);
+  }
+  std::sort(codes_and_point_indices.begin(), codes_and_point_indices.end());
+  ordered_point_indices->reserve(point_indices.size());
+  for (const std::pair<uint32_t, size_t>& code_and_point_idx :
+       codes_and_point_indices) {
+    ordered_point_indices->push_back(code_and_point_idx.second);
+  }
+}
+
+template <typename ValueType>
+void appendValues(
+    const std::vector<ValueType>& values, size_t point_idx,
+    std::string* encoded_point_cloud) {
+  encoded_point_cloud->append(
+      reinterpret_cast<const char*>(&values[3u * point_idx]),
+      3u * sizeof(ValueType));
+}
+}  // namespace
+
+bool isEncodedChunkedPointCloud(const char* data, size_t num_bytes) {
+  if (data == nullptr || num_bytes < sizeof(ChunkedPointCloudHeader)) {
+    return false;
+  }
+  uint32_t magic_number;
+  std::memcpy(&magic_number, data, sizeof(magic_number));
+  return magic_number == kMagicNumber;
+}
+
+void encodeChunkedPointCloud(
+    const resources::PointCloud& point_cloud, double chunk_size_meters,
+    std::string* encoded_point_cloud) {
+  CHECK_NOTNULL(encoded_point_cloud)->clear();
+  CHECK_GT(chunk_size_meters, 0.0);
+  const size_t num_points = point_cloud.size();
+  const bool has_normals = !point_cloud.normals.empty();
+  const bool has_colors = !point_cloud.colors.empty();
+  if (has_normals) {
+    CHECK_EQ(point_cloud.normals.size(), point_cloud.xyz.size());
+  }
+  if (has_colors) {
+    CHECK_EQ(point_cloud.colors.size(), point_cloud.xyz.size());
+  }
+
+  // Ordered map, so the encoding is deterministic.
+  std::map<ChunkKey, std::vector<size_t>> point_indices_per_chunk;
+  for (size_t point_idx = 0u; point_idx < num_points; ++point_idx) {
+    ChunkKey key;
+    for (size_t axis = 0u; axis < 3u; ++axis) {
+      const float coordinate = point_cloud.xyz[3u * point_idx + axis];
+      CHECK(std::isfinite(coordinate))
+          << "Point " << point_idx << " of the point cloud is not finite.";
+      key[axis] =
+          static_cast<int32_t>(std::floor(coordinate / chunk_size_meters));
+    }
+    point_indices_per_chunk[key].push_back(point_idx);
+  }
+
+  const ChunkedPointCloudHeader header{
+      kMagicNumber,
+      kVersion,
+      (has_normals ? kHasNormalsFlag : 0u) | (has_colors ? kHasColorsFlag : 0u),
+      static_cast<float>(chunk_size_meters),
+      num_points,
+      point_indices_per_chunk.size()};
+  const size_t num_bytes_per_point =
+      kNumBytesPerCoordinates + (has_normals ? kNumBytesPerCoordinates : 0u) +
+      (has_colors ? kNumBytesPerColor : 0u);
+  encoded_point_cloud->reserve(
+      sizeof(header) + header.num_chunks * sizeof(ChunkIndexEntry) +
+      num_points * num_bytes_per_point);
+  encoded_point_cloud->append(
+      reinterpret_cast<const char*>(&header), sizeof(header));
+
+  std::vector<size_t> ordered_point_indices;
+  ordered_point_indices.reserve(num_points);
+  std::vector<size_t> chunk_point_indices;
+  for (const std::pair<const ChunkKey, std::vector<size_t>>& chunk :
+       point_indices_per_chunk) {
+    ChunkIndexEntry entry;
+    for (size_t axis = 0u; axis < 3u; ++axis) {
+      entry.min[axis] = std::numeric_limits<float>::max();
+      entry.max[axis] = std::numeric_limits<float>::lowest();
+      for (const size_t point_idx : chunk.second) {
+        const float coordinate = point_cloud.xyz[3u * point_idx + axis];
+        entry.min[axis] = std::min(entry.min[axis], coordinate);
+        entry.max[axis] = std::max(entry.max[axis], coordinate);
+      }
+    }
+    entry.first_point = ordered_point_indices.size();
+    entry.num_points = chunk.second.size();
+    encoded_point_cloud->append(
+        reinterpret_cast<const char*>(&entry), sizeof(entry));
+
+    getProgressiveOrder(
+        point_cloud, chunk.first, chunk_size_meters, chunk.second,
+        &chunk_point_indices);
+    ordered_point_indices.insert(
+        ordered_point_indices.end(), chunk_point_indices.begin(),
+        chunk_point_indices.end());
+  }
+
+  for (const size_t point_idx : ordered_point_indices) {
+    appendValues(point_cloud.xyz, point_idx, encoded_point_cloud);
+  }
+  if (has_normals) {
+    for (const size_t point_idx : ordered_point_indices) {
+      appendValues(point_cloud.normals, point_idx, encoded_point_cloud);
+    }
+  }
+  if (has_colors) {
+    for (const size_t point_idx : ordered_point_indices) {
+      appendValues(point_cloud.colors, point_idx, encoded_point_cloud);
+    }
+  }
+}
+
+ChunkedPointCloudReader::ChunkedPointCloudReader(
+    const char* data, size_t num_bytes)
+    : is_valid_(false),
+      num_points_(0u),
+      has_normals_(false),
+      has_colors_(false),
+      xyz_data_(nullptr),
+      normals_data_(nullptr),
+      colors_data_(nullptr) {
+  if (!isEncodedChunkedPointCloud(data, num_bytes)) {
+    return;
+  }
+  ChunkedPointCloudHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  if (header.version != kVersion) {
+    VLOG(1) << "Unknown chunked point cloud version " << header.version
+            << ".";
+    return;
+  }
+  has_normals_ = (header.flags & kHasNormalsFlag) != 0u;
+  has_colors_ = (header.flags & kHasColorsFlag) != 0u;
+  num_points_ = header.num_points;
+
+  // Checks the sizes before multiplying them, so corrupt counts can't
+  // overflow.
+  const size_t num_index_bytes = num_bytes - sizeof(header);
+  if (header.num_chunks > num_index_bytes / sizeof(ChunkIndexEntry)) {
+    VLOG(1) << "Chunked point cloud is truncated.";
+    return;
+  }
+  const size_t num_data_bytes =
+      num_index_bytes - header.num_chunks * sizeof(ChunkIndexEntry);
+  const size_t num_bytes_per_point =
+      kNumBytesPerCoordinates + (has_normals_ ? kNumBytesPerCoordinates : 0u) +
+      (has_colors_ ? kNumBytesPerColor : 0u);
+  if (num_data_bytes / num_bytes_per_point != num_points_ ||
+      num_data_bytes % num_bytes_per_point != 0u) {
+    VLOG(1) << "Chunked point cloud doesn't match its size.";
+    return;
+  }
+
+  const char* entry_data = data + sizeof(header);
+  chunks_.resize(header.num_chunks);
+  uint64_t next_point = 0u;
+  for (Chunk& chunk : chunks_) {
+    ChunkIndexEntry entry;
+    std::memcpy(&entry, entry_data, sizeof(entry));
+    entry_data += sizeof(entry);
+    if (entry.first_point != next_point ||
+        entry.num_points > num_points_ - next_point) {
+      VLOG(1) << "Chunked point cloud has a corrupt chunk index.";
+      chunks_.clear();
+      return;
+    }
+    next_point += entry.num_points;
+
+    chunk.box.min() = Eigen::Vector3f(entry.min[0], entry.min[1], entry.min[2]);
+    chunk.box.max() = Eigen::Vector3f(entry.max[0], entry.max[1], entry.max[2]);
+    chunk.first_point = entry.first_point;
+    chunk.num_points = entry.num_points;
+  }
+  if (next_point != num_points_) {
+    VLOG(1) << "Chunked point cloud has a corrupt chunk index.";
+    chunks_.clear();
+    return;
+  }
+
+  xyz_data_ = entry_data;
+  const char* next_data = xyz_data_ + num_points_ * kNumBytesPerCoordinates;
+  if (has_normals_) {
+    normals_data_ = next_data;
+    next_data += num_points_ * kNumBytesPerCoordinates;
+  }
+  if (has_colors_) {
+    colors_data_ = next_data;
+  }
+  is_valid_ = true;
+}
+
+size_t ChunkedPointCloudReader::getNumPoints() const {
+  CHECK(is_valid_);
+  return num_points_;
+}
+
+size_t ChunkedPointCloudReader::getNumChunks() const {
+  CHECK(is_valid_);
+  return chunks_.size();
+}
+
+void ChunkedPointCloudReader::readPointCloud(
+    double level_of_detail, resources::PointCloud* point_cloud) const {
+  readPoints(nullptr, level_of_detail, point_cloud);
+}
+
+void ChunkedPointCloudReader::readPointCloudInRegion(
+    const Eigen::AlignedBox3f& region, double level_of_detail,
+    resources::PointCloud* point_cloud) const {
+  readPoints(&region, level_of_detail, point_cloud);
+}
+
+void ChunkedPointCloudReader::readPoints(
+    const Eigen::AlignedBox3f* region, double level_of_detail,
+    resources::PointCloud* point_cloud) const {
+  CHECK(is_valid_);
+  CHECK_NOTNULL(point_cloud);
+  CHECK_GT(level_of_detail, 0.0);
+  CHECK_LE(level_of_detail, 1.0);
+  point_cloud->xyz.clear();
+  point_cloud->normals.clear();
+  point_cloud->colors.clear();
+
+  for (const Chunk& chunk : chunks_) {
+    if (region != nullptr && !region->intersects(chunk.box)) {
+      continue;
+    }
+    const size_t num_points_to_read = static_cast<size_t>(
+        std::ceil(level_of_detail * static_cast<double>(chunk.num_points)));
+    // Only the points at the chunk boundary need to be checked against the
+    // region.
+    const bool check_region = region != nullptr && !region->contains(chunk.box);
+    for (size_t point_idx = chunk.first_point;
+         point_idx < chunk.first_point + num_points_to_read; ++point_idx) {
+      float xyz[3];
+      std::memcpy(
+          xyz, xyz_data_ + point_idx * kNumBytesPerCoordinates,
+          kNumBytesPerCoordinates);
+      if (check_region &&
+          !region->contains(Eigen::Vector3f(xyz[0], xyz[1], xyz[2]))) {
+        continue;
+      }
+      point_cloud->xyz.insert(point_cloud->xyz.end(), xyz, xyz + 3);
+      if (has_normals_) {
+        float normal[3];
+        std::memcpy(
+            normal, normals_data_ + point_idx * kNumBytesPerCoordinates,
+            kNumBytesPerCoordinates);
+        point_cloud->normals.insert(
+            point_cloud->normals.end(), normal, normal + 3);
+      }
+      if (has_colors_) {
+        const unsigned char* color = reinterpret_cast<const unsigned char*>(
+            colors_data_ + point_idx * kNumBytesPerColor);
+        point_cloud->colors.insert(
+            point_cloud->colors.end(), color, color + 3);
+      }
+    }
+  }
+}
+
+}  // namespace backend
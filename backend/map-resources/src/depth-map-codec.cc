@@ -0,0 +1,193 @@
+#include "map-resources/depth-map-codec.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <glog/logging.h>
+
+namespace backend {
+
+namespace {
+constexpr uint32_t kMagicNumber = 0x4d44524du;  // "MRDM"
+constexpr uint32_t kVersion = 1u;
+
+struct DepthMapHeader {
+  uint32_t magic_number;
+  uint32_t version;
+  uint32_t rows;
+  uint32_t cols;
+};
+
+// The first bits of a code tell its kind:
+//  - 0xxxxxxx: residual below 2^7.
+//  - 10xxxxxx + 1 byte: residual below 2^14.
+//  - 110xxxxx + 1 byte: run of up to 2^13 zero residuals.
+//  - 111000xx + 2 bytes: residual below 2^18.
+// The residuals are zigzag encoded, which maps the differences of 16-bit
+// values to 17 bits.
+constexpr uint32_t kMaxOneByteResidual = 1u << 7;
+constexpr uint32_t kMaxTwoByteResidual = 1u << 14;
+constexpr uint32_t kMaxRunLength = 1u << 13;
+constexpr uint8_t kTwoByteResidualCode = 0x80u;
+constexpr uint8_t kRunCode = 0xc0u;
+constexpr uint8_t kThreeByteResidualCode = 0xe0u;
+
+inline uint32_t zigzagEncode(const int32_t residual) {
+  return (static_cast<uint32_t>(residual) << 1) ^
+         static_cast<uint32_t>(residual >> 31);
+}
+
+inline int32_t zigzagDecode(const uint32_t code) {
+  return static_cast<int32_t>(code >> 1) ^ -static_cast<int32_t>(code & 1u);
+}
+
+inline uint16_t getPrediction(
+    const cv::Mat& depth_map, int row, int col, const uint16_t* row_ptr) {
+  if (col > 0) {
+    return row_ptr[col - 1];
+  }
+  return (row > 0) ? depth_map.ptr<uint16_t>(row - 1)[0] : 0u;
+}
+
+void appendRun(uint32_t run_length, std::string* encoded_depth_map) {
+  while (run_length > 0u) {
+    const uint32_t length = std::min(run_length, kMaxRunLength);
+    const uint32_t value = length - 1u;
+    encoded_depth_map->push_back(static_cast<char>(kRunCode | (value >> 8)));
+    encoded_depth_map->push_back(static_cast<char>(value & 0xffu));
+    run_length -= length;
+  }
+}
+
+void appendResidual(const uint32_t code, std::string* encoded_depth_map) {
+  if (code < kMaxOneByteResidual) {
+    encoded_depth_map->push_back(static_cast<char>(code));
+  } else if (code < kMaxTwoByteResidual) {
+    encoded_depth_map->push_back(
+        static_cast<char>(kTwoByteResidualCode | (code >> 8)));
+    encoded_depth_map->push_back(static_cast<char>(code & 0xffu));
+  } else {
+    encoded_depth_map->push_back(
+        static_cast<char>(kThreeByteResidualCode | (code >> 16)));
+    encoded_depth_map->push_back(static_cast<char>((code >> 8) & 0xffu));
+    encoded_depth_map->push_back(static_cast<char>(code & 0xffu));
+  }
+}
+}  // namespace
+
+bool isEncodedDepthMap(const char* data, size_t num_bytes) {
+  if (data == nullptr || num_bytes < sizeof(DepthMapHeader)) {
+    return false;
+  }
+  uint32_t magic_number;
+  std::memcpy(&magic_number, data, sizeof(magic_number));
+  return magic_number == kMagicNumber;
+}
+
+void encodeDepthMap(const cv::Mat& depth_map, std::string* encoded_depth_map) {
+  CHECK_NOTNULL(encoded_depth_map)->clear();
+  CHECK_EQ(depth_map.type(), CV_16UC1)
+      << "The depth map codec only supports CV_16UC1 images.";
+
+  const DepthMapHeader header{kMagicNumber, kVersion,
+                              static_cast<uint32_t>(depth_map.rows),
+                              static_cast<uint32_t>(depth_map.cols)};
+  // Most residuals of smooth depth maps take one byte.
+  encoded_depth_map->reserve(sizeof(header) + depth_map.total());
+  encoded_depth_map->append(
+      reinterpret_cast<const char*>(&header), sizeof(header));
+
+  uint32_t run_length = 0u;
+  for (int row = 0; row < depth_map.rows; ++row) {
+    const uint16_t* row_ptr = depth_map.ptr<uint16_t>(row);
+    for (int col = 0; col < depth_map.cols; ++col) {
+      const int32_t residual =
+          static_cast<int32_t>(row_ptr[col]) -
+          static_cast<int32_t>(getPrediction(depth_map, row, col, row_ptr));
+      if (residual == 0) {
+        ++run_length;
+        continue;
+      }
+      appendRun(run_length, encoded_depth_map);
+      run_length = 0u;
+      appendResidual(zigzagEncode(residual), encoded_depth_map);
+    }
+  }
+  appendRun(run_length, encoded_depth_map);
+}
+
+bool decodeDepthMap(const char* data, size_t num_bytes, cv::Mat* depth_map) {
+  CHECK_NOTNULL(depth_map);
+  if (!isEncodedDepthMap(data, num_bytes)) {
+    return false;
+  }
+  DepthMapHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  if (header.version != kVersion) {
+    VLOG(1) << "Unknown depth map codec version " << header.version << ".";
+    return false;
+  }
+  depth_map->create(
+      static_cast<int>(header.rows), static_cast<int>(header.cols), CV_16UC1);
+
+  const uint8_t* code = reinterpret_cast<const uint8_t*>(data);
+  const uint8_t* const code_end = code + num_bytes;
+  code += sizeof(header);
+  uint32_t run_length = 0u;
+  for (int row = 0; row < depth_map->rows; ++row) {
+    uint16_t* row_ptr = depth_map->ptr<uint16_t>(row);
+    for (int col = 0; col < depth_map->cols; ++col) {
+      const uint16_t prediction =
+          getPrediction(*depth_map, row, col, row_ptr);
+      if (run_length > 0u) {
+        --run_length;
+        row_ptr[col] = prediction;
+        continue;
+      }
+      if (code == code_end) {
+        VLOG(1) << "Encoded depth map is truncated.";
+        return false;
+      }
+
+      uint32_t residual_code;
+      const size_t num_remaining_bytes = code_end - code;
+      if ((*code & 0x80u) == 0u) {
+        residual_code = *code;
+        code += 1;
+      } else if ((*code & 0xc0u) == kTwoByteResidualCode &&
+                 num_remaining_bytes >= 2u) {
+        residual_code = ((code[0] & 0x3fu) << 8) | code[1];
+        code += 2;
+      } else if ((*code & 0xe0u) == kRunCode && num_remaining_bytes >= 2u) {
+        // This pixel is the first of the run.
+        run_length = ((code[0] & 0x1fu) << 8) | code[1];
+        code += 2;
+        row_ptr[col] = prediction;
+        continue;
+      } else if ((*code & 0xfcu) == kThreeByteResidualCode &&
+                 num_remaining_bytes >= 3u) {
+        residual_code = ((code[0] & 0x03u) << 16) | (code[1] << 8) | code[2];
+        code += 3;
+      } else {
+        VLOG(1) << "Encoded depth map is corrupt.";
+        return false;
+      }
+      const int32_t value =
+          static_cast<int32_t>(prediction) + zigzagDecode(residual_code);
+      if (value < 0 || value > 0xffff) {
+        VLOG(1) << "Encoded depth map is corrupt.";
+        return false;
+      }
+      row_ptr[col] = static_cast<uint16_t>(value);
+    }
+  }
+  if (run_length > 0u || code != code_end) {
+    VLOG(1) << "Encoded depth map doesn't match its size.";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace backend
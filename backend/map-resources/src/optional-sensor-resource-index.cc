@@ -0,0 +1,138 @@
+#include "map-resources/optional-sensor-resource-index.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+#include <vector>
+
+namespace backend {
+
+constexpr size_t OptionalSensorResourceIndex::kInvalidIndex;
+
+OptionalSensorResourceIndex::OptionalSensorResourceIndex(
+    const OptionalSensorResources& resources) {
+  rebuild(resources);
+}
+
+void OptionalSensorResourceIndex::rebuild(
+    const OptionalSensorResources& resources) {
+  timestamps_ns_.clear();
+  resource_ids_.clear();
+
+  resources.lockContainer();
+  const StampedResourceIds& stamped_resource_ids =
+      resources.buffered_values();
+  timestamps_ns_.reserve(stamped_resource_ids.size());
+  resource_ids_.reserve(stamped_resource_ids.size());
+  for (const StampedResourceIds::value_type& stamped_resource_id :
+       stamped_resource_ids) {
+    timestamps_ns_.push_back(stamped_resource_id.first);
+    resource_ids_.push_back(stamped_resource_id.second);
+  }
+  resources.unlockContainer();
+}
+
+size_t OptionalSensorResourceIndex::selectClosestIndex(
+    const size_t lower_bound_index, const int64_t timestamp_ns,
+    const int64_t tolerance_ns) const {
+  const size_t num_resources = timestamps_ns_.size();
+  if (num_resources == 0u) {
+    return kInvalidIndex;
+  }
+
+  size_t closest_index;
+  if (lower_bound_index == num_resources) {
+    closest_index = num_resources - 1u;
+  } else if (
+      lower_bound_index == 0u ||
+      timestamps_ns_[lower_bound_index] == timestamp_ns) {
+    closest_index = lower_bound_index;
+  } else {
+    // Like the temporal buffer, prefer the later resource on a tie.
+    const int64_t delta_before_ns =
+        timestamp_ns - timestamps_ns_[lower_bound_index - 1u];
+    const int64_t delta_after_ns =
+        timestamps_ns_[lower_bound_index] - timestamp_ns;
+    closest_index = delta_before_ns < delta_after_ns ? lower_bound_index - 1u
+                                                     : lower_bound_index;
+  }
+
+  if (std::abs(timestamps_ns_[closest_index] - timestamp_ns) > tolerance_ns) {
+    return kInvalidIndex;
+  }
+  return closest_index;
+}
+
+size_t OptionalSensorResourceIndex::getClosestIndex(
+    const int64_t timestamp_ns, const int64_t tolerance_ns) const {
+  CHECK_GE(tolerance_ns, 0);
+  const size_t lower_bound_index =
+      std::lower_bound(
+          timestamps_ns_.begin(), timestamps_ns_.end(), timestamp_ns) -
+      timestamps_ns_.begin();
+  return selectClosestIndex(lower_bound_index, timestamp_ns, tolerance_ns);
+}
+
+bool OptionalSensorResourceIndex::getClosestResourceId(
+    const int64_t timestamp_ns, const int64_t tolerance_ns,
+    StampedResourceId* stamped_resource_id) const {
+  CHECK_NOTNULL(stamped_resource_id);
+  const size_t closest_index = getClosestIndex(timestamp_ns, tolerance_ns);
+  if (closest_index == kInvalidIndex) {
+    return false;
+  }
+  stamped_resource_id->first = timestamps_ns_[closest_index];
+  stamped_resource_id->second = resource_ids_[closest_index];
+  return true;
+}
+
+void OptionalSensorResourceIndex::getResourceIdsInRange(
+    const int64_t timestamp_lower_ns, const int64_t timestamp_upper_ns,
+    std::vector<StampedResourceId>* stamped_resource_ids) const {
+  CHECK_NOTNULL(stamped_resource_ids)->clear();
+  CHECK_LE(timestamp_lower_ns, timestamp_upper_ns);
+  const std::vector<int64_t>::const_iterator begin = std::lower_bound(
+      timestamps_ns_.begin(), timestamps_ns_.end(), timestamp_lower_ns);
+  const std::vector<int64_t>::const_iterator end =
+      std::upper_bound(begin, timestamps_ns_.end(), timestamp_upper_ns);
+  stamped_resource_ids->reserve(end - begin);
+  for (std::vector<int64_t>::const_iterator it = begin; it != end; ++it) {
+    const size_t index = it - timestamps_ns_.begin();
+    stamped_resource_ids->emplace_back(*it, resource_ids_[index]);
+  }
+}
+
+void OptionalSensorResourceIndex::associateClosestIndices(
+    const std::vector<int64_t>& timestamps_ns, const int64_t tolerance_ns,
+    std::vector<size_t>* closest_indices) const {
+  CHECK_NOTNULL(closest_indices);
+  CHECK_GE(tolerance_ns, 0);
+  const size_t num_timestamps = timestamps_ns.size();
+  closest_indices->assign(num_timestamps, kInvalidIndex);
+  if (timestamps_ns_.empty()) {
+    return;
+  }
+
+  // The vertex timestamps of a mission are usually sorted already.
+  std::vector<size_t> order(num_timestamps);
+  std::iota(order.begin(), order.end(), 0u);
+  if (!std::is_sorted(timestamps_ns.begin(), timestamps_ns.end())) {
+    std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+      return timestamps_ns[lhs] < timestamps_ns[rhs];
+    });
+  }
+
+  const size_t num_resources = timestamps_ns_.size();
+  size_t lower_bound_index = 0u;
+  for (const size_t timestamp_idx : order) {
+    const int64_t timestamp_ns = timestamps_ns[timestamp_idx];
+    while (lower_bound_index < num_resources &&
+           timestamps_ns_[lower_bound_index] < timestamp_ns) {
+      ++lower_bound_index;
+    }
+    (*closest_indices)[timestamp_idx] =
+        selectClosestIndex(lower_bound_index, timestamp_ns, tolerance_ns);
+  }
+}
+
+}  // namespace backend
@@ -0,0 +1,399 @@
+#include "map-resources/packed-resource-container.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/file-system-tools.h>
+
+namespace backend {
+
+namespace {
+constexpr uint32_t kSegmentMagicNumber = 0x5350524du;  // "MRPS"
+constexpr uint32_t kSegmentVersion = 1u;
+constexpr uint32_t kRecordMagicNumber = 0x4350524du;  // "MRPC"
+
+constexpr char kContainerFolderName[] = "packed";
+constexpr char kSegmentFilePrefix[] = "segment_";
+constexpr char kSegmentFileSuffix[] = ".pack";
+constexpr size_t kIdHexLength = 32u;
+
+struct SegmentHeader {
+  uint32_t magic_number;
+  uint32_t version;
+};
+
+struct RecordHeader {
+  uint32_t magic_number;
+  uint32_t is_deleted;
+  char id_hex[kIdHexLength];
+  uint64_t num_bytes;
+};
+
+std::string getSegmentFilePath(
+    const std::string& container_folder, const size_t segment_number) {
+  return common::concatenateFolderAndFileName(
+      container_folder, kSegmentFilePrefix + std::to_string(segment_number) +
+                            kSegmentFileSuffix);
+}
+
+// Returns false if the file name isn't the one of a segment.
+bool getSegmentNumber(const std::string& file_path, size_t* segment_number) {
+  CHECK_NOTNULL(segment_number);
+  std::string folder, file_name;
+  common::splitPathAndFilename(file_path, &folder, &file_name);
+  const size_t prefix_length = std::strlen(kSegmentFilePrefix);
+  const size_t suffix_length = std::strlen(kSegmentFileSuffix);
+  if (file_name.size() <= prefix_length + suffix_length ||
+      file_name.compare(0u, prefix_length, kSegmentFilePrefix) != 0 ||
+      file_name.compare(
+          file_name.size() - suffix_length, suffix_length,
+          kSegmentFileSuffix) != 0) {
+    return false;
+  }
+  const std::string number = file_name.substr(
+      prefix_length, file_name.size() - prefix_length - suffix_length);
+  if (!std::all_of(number.begin(), number.end(), ::isdigit)) {
+    return false;
+  }
+  *segment_number = std::strtoull(number.c_str(), nullptr, 10);
+  return true;
+}
+}  // namespace
+
+PackedResourceContainer::PackedResourceContainer(
+    const std::string& container_folder, size_t max_segment_bytes)
+    : container_folder_(container_folder),
+      max_segment_bytes_(max_segment_bytes),
+      num_unused_bytes_(0u),
+      next_segment_number_(0u),
+      can_append_to_last_segment_(false) {
+  CHECK(!container_folder_.empty());
+  CHECK_GT(max_segment_bytes_, 0u);
+  openSegments();
+}
+
+void PackedResourceContainer::getContainerFolder(
+    const std::string& resource_folder, const ResourceType& type,
+    std::string* container_folder) {
+  CHECK(!resource_folder.empty());
+  CHECK_NOTNULL(container_folder)->clear();
+  common::concatenateFolderAndFileName(
+      resource_folder, ResourceTypeNames[static_cast<size_t>(type)],
+      container_folder);
+  common::concatenateFolderAndFileName(
+      *container_folder, kContainerFolderName, container_folder);
+}
+
+void PackedResourceContainer::openSegments() {
+  if (!common::pathExists(container_folder_)) {
+    return;
+  }
+  std::vector<std::string> file_paths;
+  common::getAllFilesInFolder(container_folder_, &file_paths);
+  std::vector<std::pair<size_t, std::string>> numbered_file_paths;
+  for (const std::string& file_path : file_paths) {
+    size_t segment_number;
+    if (getSegmentNumber(file_path, &segment_number)) {
+      numbered_file_paths.emplace_back(segment_number, file_path);
+    }
+  }
+  // Later records supersede earlier ones.
+  std::sort(numbered_file_paths.begin(), numbered_file_paths.end());
+
+  for (const std::pair<size_t, std::string>& numbered_file_path :
+       numbered_file_paths) {
+    segments_.emplace_back();
+    segments_.back().file_path = numbered_file_path.second;
+    segments_.back().num_bytes = 0u;
+    can_append_to_last_segment_ = scanSegment(segments_.size() - 1u);
+    next_segment_number_ = numbered_file_path.first + 1u;
+  }
+  VLOG(3) << "Opened packed resource container " << container_folder_
+          << " with " << index_.size() << " resources in " << segments_.size()
+          << " segments.";
+}
+
+bool PackedResourceContainer::scanSegment(const size_t segment_idx) {
+  CHECK_LT(segment_idx, segments_.size());
+  Segment& segment = segments_[segment_idx];
+  common::MemoryMappedFile mapped_file;
+  if (!mapped_file.open(segment.file_path)) {
+    return false;
+  }
+  mapped_file.adviseSequentialRead();
+  const char* data = mapped_file.data();
+  const uint64_t size = mapped_file.size();
+
+  SegmentHeader segment_header;
+  if (size < sizeof(segment_header)) {
+    LOG(WARNING) << "Packed resource segment " << segment.file_path
+                 << " is too small, ignoring it.";
+    return false;
+  }
+  std::memcpy(&segment_header, data, sizeof(segment_header));
+  if (segment_header.magic_number != kSegmentMagicNumber ||
+      segment_header.version != kSegmentVersion) {
+    LOG(WARNING) << "Packed resource segment " << segment.file_path
+                 << " has an unknown format, ignoring it.";
+    return false;
+  }
+
+  uint64_t offset = sizeof(segment_header);
+  while (offset < size) {
+    RecordHeader record_header;
+    if (size - offset < sizeof(record_header)) {
+      break;
+    }
+    std::memcpy(&record_header, data + offset, sizeof(record_header));
+    if (record_header.magic_number != kRecordMagicNumber ||
+        size - offset - sizeof(record_header) < record_header.num_bytes) {
+      break;
+    }
+    ResourceId id;
+    if (!id.fromHexString(
+            std::string(record_header.id_hex, kIdHexLength))) {
+      break;
+    }
+    const RecordLocation location{segment_idx, offset + sizeof(record_header),
+                                  record_header.num_bytes};
+    addRecordToIndex(id, record_header.is_deleted != 0u, location);
+    offset = location.offset + location.num_bytes;
+  }
+  segment.num_bytes = offset;
+
+  if (offset < size) {
+    // E.g. after a crash while appending a record, the next records go into
+    // a new segment.
+    LOG(WARNING) << "Packed resource segment " << segment.file_path
+                 << " is corrupt after " << offset << " of " << size
+                 << " bytes, ignoring the rest.";
+    num_unused_bytes_ += size - offset;
+    return false;
+  }
+  return true;
+}
+
+void PackedResourceContainer::addRecordToIndex(
+    const ResourceId& id, const bool is_deleted,
+    const RecordLocation& location) {
+  const std::unordered_map<ResourceId, RecordLocation>::iterator it =
+      index_.find(id);
+  if (it != index_.end()) {
+    num_unused_bytes_ += sizeof(RecordHeader) + it->second.num_bytes;
+  }
+  if (is_deleted) {
+    // A deletion record is never needed again once it has been read.
+    num_unused_bytes_ += sizeof(RecordHeader) + location.num_bytes;
+    if (it != index_.end()) {
+      index_.erase(it);
+    }
+  } else if (it != index_.end()) {
+    it->second = location;
+  } else {
+    index_.emplace(id, location);
+  }
+}
+
+void PackedResourceContainer::startSegment() {
+  segment_stream_.close();
+  const std::string file_path =
+      getSegmentFilePath(container_folder_, next_segment_number_);
+  CHECK(!common::fileExists(file_path)) << file_path;
+  CHECK(common::createPathToFile(file_path));
+  segment_stream_.open(file_path, std::ios::binary | std::ios::trunc);
+  CHECK(segment_stream_.is_open())
+      << "Could not create packed resource segment " << file_path;
+
+  const SegmentHeader segment_header{kSegmentMagicNumber, kSegmentVersion};
+  segment_stream_.write(
+      reinterpret_cast<const char*>(&segment_header), sizeof(segment_header));
+  CHECK(segment_stream_.good())
+      << "Could not write packed resource segment " << file_path;
+
+  segments_.emplace_back();
+  segments_.back().file_path = file_path;
+  segments_.back().num_bytes = sizeof(segment_header);
+  ++next_segment_number_;
+  can_append_to_last_segment_ = true;
+}
+
+void PackedResourceContainer::appendRecord(
+    const ResourceId& id, const bool is_deleted, const char* data,
+    const uint64_t num_bytes) {
+  CHECK(data != nullptr || num_bytes == 0u);
+  if (!can_append_to_last_segment_ || segments_.empty() ||
+      segments_.back().num_bytes >= max_segment_bytes_) {
+    startSegment();
+  } else if (!segment_stream_.is_open()) {
+    segment_stream_.open(
+        segments_.back().file_path, std::ios::binary | std::ios::app);
+    CHECK(segment_stream_.is_open())
+        << "Could not open packed resource segment "
+        << segments_.back().file_path;
+  }
+
+  RecordHeader record_header;
+  record_header.magic_number = kRecordMagicNumber;
+  record_header.is_deleted = is_deleted ? 1u : 0u;
+  const std::string id_hex = id.hexString();
+  CHECK_EQ(id_hex.size(), kIdHexLength);
+  std::memcpy(record_header.id_hex, id_hex.data(), kIdHexLength);
+  record_header.num_bytes = num_bytes;
+  segment_stream_.write(
+      reinterpret_cast<const char*>(&record_header), sizeof(record_header));
+  segment_stream_.write(data, num_bytes);
+  // Reads map the file, so the record must be in the file right away.
+  segment_stream_.flush();
+  Segment& segment = segments_.back();
+  CHECK(segment_stream_.good())
+      << "Could not write to packed resource segment " << segment.file_path;
+
+  const RecordLocation location{segments_.size() - 1u,
+                                segment.num_bytes + sizeof(record_header),
+                                num_bytes};
+  segment.num_bytes = location.offset + num_bytes;
+  addRecordToIndex(id, is_deleted, location);
+}
+
+common::MemoryMappedFile::Ptr PackedResourceContainer::getMappedFile(
+    const uint64_t end_offset, Segment* segment) const {
+  CHECK_NOTNULL(segment);
+  if (!segment->mapped_file || segment->mapped_file->size() < end_offset) {
+    common::MemoryMappedFile::Ptr mapped_file =
+        std::make_shared<common::MemoryMappedFile>();
+    if (!mapped_file->open(segment->file_path)) {
+      return common::MemoryMappedFile::Ptr();
+    }
+    CHECK_GE(mapped_file->size(), end_offset) << segment->file_path;
+    segment->mapped_file = mapped_file;
+  }
+  return segment->mapped_file;
+}
+
+bool PackedResourceContainer::hasResource(const ResourceId& id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return index_.count(id) > 0u;
+}
+
+void PackedResourceContainer::putResource(
+    const ResourceId& id, const std::string& encoded_resource) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  appendRecord(id, false, encoded_resource.data(), encoded_resource.size());
+}
+
+bool PackedResourceContainer::readResource(
+    const ResourceId& id, const ReadFunction& read) const {
+  CHECK(read);
+  common::MemoryMappedFile::Ptr mapped_file;
+  RecordLocation location;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::unordered_map<ResourceId, RecordLocation>::const_iterator it =
+        index_.find(id);
+    if (it == index_.end()) {
+      return false;
+    }
+    location = it->second;
+    CHECK_LT(location.segment_idx, segments_.size());
+    mapped_file = getMappedFile(
+        location.offset + location.num_bytes,
+        &segments_[location.segment_idx]);
+    if (!mapped_file) {
+      return false;
+    }
+  }
+  // The mapping stays valid even if the segment is deleted by compact().
+  return read(mapped_file->data() + location.offset, location.num_bytes);
+}
+
+bool PackedResourceContainer::deleteResource(const ResourceId& id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (index_.count(id) == 0u) {
+    return false;
+  }
+  appendRecord(id, true, nullptr, 0u);
+  return true;
+}
+
+void PackedResourceContainer::compact() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (num_unused_bytes_ == 0u) {
+    return;
+  }
+  const size_t num_bytes_before = getNumSegmentBytes();
+
+  // Keeps the records in the order they were written, so that reading them
+  // in that order stays sequential.
+  std::vector<std::pair<ResourceId, RecordLocation>> records(
+      index_.begin(), index_.end());
+  std::sort(
+      records.begin(), records.end(),
+      [](const std::pair<ResourceId, RecordLocation>& lhs,
+         const std::pair<ResourceId, RecordLocation>& rhs) {
+        return std::make_pair(lhs.second.segment_idx, lhs.second.offset) <
+               std::make_pair(rhs.second.segment_idx, rhs.second.offset);
+      });
+
+  std::vector<Segment> old_segments;
+  old_segments.swap(segments_);
+  index_.clear();
+  num_unused_bytes_ = 0u;
+  segment_stream_.close();
+  can_append_to_last_segment_ = false;
+  for (const std::pair<ResourceId, RecordLocation>& record : records) {
+    const RecordLocation& location = record.second;
+    const common::MemoryMappedFile::Ptr mapped_file = getMappedFile(
+        location.offset + location.num_bytes,
+        &old_segments[location.segment_idx]);
+    CHECK(mapped_file) << "Could not read packed resource segment "
+                       << old_segments[location.segment_idx].file_path;
+    appendRecord(
+        record.first, false, mapped_file->data() + location.offset,
+        location.num_bytes);
+  }
+  segment_stream_.close();
+
+  // The new segments supersede the old ones, so deleting the old ones in
+  // order is safe even if it is interrupted.
+  for (const Segment& segment : old_segments) {
+    CHECK(common::deleteFile(segment.file_path)) << segment.file_path;
+  }
+  VLOG(1) << "Compacted packed resource container " << container_folder_
+          << " from " << num_bytes_before << " to " << getNumSegmentBytes()
+          << " bytes.";
+}
+
+size_t PackedResourceContainer::getNumResources() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return index_.size();
+}
+
+size_t PackedResourceContainer::getNumSegments() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return segments_.size();
+}
+
+size_t PackedResourceContainer::getNumBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return getNumSegmentBytes();
+}
+
+size_t PackedResourceContainer::getNumSegmentBytes() const {
+  size_t num_bytes = 0u;
+  for (const Segment& segment : segments_) {
+    num_bytes += segment.num_bytes;
+  }
+  return num_bytes;
+}
+
+size_t PackedResourceContainer::getNumUnusedBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_unused_bytes_;
+}
+
+}  // namespace backend
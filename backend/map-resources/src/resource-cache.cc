@@ -1,49 +1,272 @@
 #include "map-resources/resource-cache.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+#include <gflags/gflags.h>
+
+DEFINE_string(
+    resource_cache_strategy, "fifo",
+    "Eviction strategy of the resource cache: fifo, lru (least recently "
+    "used) or lfu (least frequently used).");
+DEFINE_uint64(
+    resource_cache_max_size, 100u,
+    "Maximum number of cached resources per resource type.");
+DEFINE_uint64(
+    resource_cache_max_megabytes, 0u,
+    "Memory budget of the cached resources of all types together in MB, 0 "
+    "means no limit.");
+DEFINE_string(
+    resource_cache_type_quotas, "",
+    "Memory quotas of single resource types in MB, as comma-separated "
+    "<resource type name>:<MB> pairs, e.g. "
+    "\"raw_depth_maps:512,point_cloud_type:1024\".");
+
 namespace backend {
 
+namespace {
+std::string getStrategyName(const ResourceCache::Strategy strategy) {
+  switch (strategy) {
+    case ResourceCache::Strategy::kFIFO:
+      return "fifo";
+    case ResourceCache::Strategy::kLRU:
+      return "lru";
+    case ResourceCache::Strategy::kLFU:
+      return "lfu";
+    default:
+      LOG(FATAL) << "Unknown resource cache strategy: "
+                 << static_cast<int>(strategy);
+  }
+  return "";
+}
+
+constexpr size_t kBytesPerMegabyte = 1024u * 1024u;
+
+void parseTypeQuotas(
+    const std::string& quotas,
+    std::unordered_map<ResourceType, size_t, ResourceTypeHash>*
+        max_cache_bytes_per_type) {
+  CHECK_NOTNULL(max_cache_bytes_per_type)->clear();
+  std::stringstream quotas_stream(quotas);
+  std::string quota;
+  while (std::getline(quotas_stream, quota, ',')) {
+    if (quota.empty()) {
+      continue;
+    }
+    // Type names can contain spaces, but no colons.
+    const size_t separator = quota.rfind(':');
+    CHECK_NE(separator, std::string::npos)
+        << "Resource cache quotas must be <resource type name>:<MB> pairs, "
+        << "got \"" << quota << "\".";
+    const ResourceType type =
+        getResourceTypeFromName(quota.substr(0u, separator));
+    const size_t num_megabytes =
+        std::strtoull(quota.c_str() + separator + 1u, nullptr, 10);
+    (*max_cache_bytes_per_type)[type] = num_megabytes * kBytesPerMegabyte;
+  }
+}
+}  // namespace
+
+ResourceCache::Config ResourceCache::Config::getFromGflags() {
+  Config config;
+  if (FLAGS_resource_cache_strategy == "fifo") {
+    config.strategy = Strategy::kFIFO;
+  } else if (FLAGS_resource_cache_strategy == "lru") {
+    config.strategy = Strategy::kLRU;
+  } else if (FLAGS_resource_cache_strategy == "lfu") {
+    config.strategy = Strategy::kLFU;
+  } else {
+    LOG(FATAL) << "Unknown resource cache strategy: "
+               << FLAGS_resource_cache_strategy
+               << ", use one of fifo, lru or lfu.";
+  }
+  config.max_cache_size = FLAGS_resource_cache_max_size;
+  config.max_total_cache_bytes =
+      FLAGS_resource_cache_max_megabytes * kBytesPerMegabyte;
+  parseTypeQuotas(
+      FLAGS_resource_cache_type_quotas, &config.max_cache_bytes_per_type);
+  return config;
+}
+
+ResourceCache::ResourceCache(const Config& cache_config)
+    : config_(cache_config), num_bytes_(0u), access_counter_(0u) {
+  statistic_.strategy = getStrategyName(config_.strategy);
+  // NOTE: [ADD_RESOURCE_DATA_TYPE] Add cache.
+  initResourceTypeMap<cv::Mat>(&image_cache_);
+  initResourceTypeMap<std::string>(&text_cache_);
+  initResourceTypeMap<resources::PointCloud>(&pointcloud_cache_);
+  initResourceTypeMap<voxblox::TsdfMap>(&voxblox_tsdf_map_cache_);
+  initResourceTypeMap<voxblox::EsdfMap>(&voxblox_esdf_map_cache_);
+  initResourceTypeMap<voxblox::OccupancyMap>(&voxblox_occupancy_map_cache_);
+  common::MemoryBudget::getInstance().registerConsumer(this);
+}
+
+ResourceCache::~ResourceCache() {
+  common::MemoryBudget::getInstance().unregisterConsumer(this);
+}
+
+std::mutex& ResourceCache::getMutex(const ResourceType& type) const {
+  const size_t type_idx = static_cast<size_t>(type);
+  CHECK_LT(type_idx, mutexes_.size());
+  return mutexes_[type_idx];
+}
+
+size_t ResourceCache::getMaxCacheBytes(const ResourceType& type) const {
+  const std::unordered_map<ResourceType, size_t, ResourceTypeHash>::
+      const_iterator it = config_.max_cache_bytes_per_type.find(type);
+  return (it == config_.max_cache_bytes_per_type.end()) ? 0u : it->second;
+}
+
+void ResourceCache::evictResourcesForBudget(size_t num_bytes_to_fit) {
+  if (config_.max_total_cache_bytes == 0u) {
+    return;
+  }
+  if (num_bytes_to_fit >= config_.max_total_cache_bytes) {
+    evictResourcesDownTo(0u);
+  } else {
+    evictResourcesDownTo(config_.max_total_cache_bytes - num_bytes_to_fit);
+  }
+}
+
+void ResourceCache::evictResourcesDownTo(size_t max_num_bytes) {
+  while (num_bytes_ > max_num_bytes) {
+    // NOTE: [ADD_RESOURCE_DATA_TYPE] Add cache.
+    EvictionCandidate candidate;
+    findEvictionCandidate<cv::Mat>(&image_cache_, &candidate);
+    findEvictionCandidate<std::string>(&text_cache_, &candidate);
+    findEvictionCandidate<resources::PointCloud>(
+        &pointcloud_cache_, &candidate);
+    findEvictionCandidate<voxblox::TsdfMap>(
+        &voxblox_tsdf_map_cache_, &candidate);
+    findEvictionCandidate<voxblox::EsdfMap>(
+        &voxblox_esdf_map_cache_, &candidate);
+    findEvictionCandidate<voxblox::OccupancyMap>(
+        &voxblox_occupancy_map_cache_, &candidate);
+    if (!candidate.evict) {
+      // Other threads evicted everything in the meantime.
+      return;
+    }
+    candidate.evict();
+  }
+}
+
+std::string ResourceCache::getMemoryConsumerName() const {
+  return "resource cache";
+}
+
+size_t ResourceCache::getReleasableMemoryBytes() const {
+  return num_bytes_;
+}
+
+size_t ResourceCache::releaseMemory(size_t num_bytes) {
+  const size_t num_bytes_before = num_bytes_;
+  evictResourcesDownTo(
+      num_bytes >= num_bytes_before ? 0u : num_bytes_before - num_bytes);
+  const size_t num_bytes_after = num_bytes_;
+  return num_bytes_before > num_bytes_after ? num_bytes_before - num_bytes_after
+                                            : 0u;
+}
+
 template <>
-typename ResourceCache::Cache<cv::Mat>::ResourceDequePtr&
+typename ResourceCache::Cache<cv::Mat>::ResourcesPtr&
 ResourceCache::getCachePtr<cv::Mat>(const ResourceType& type) {
-  return image_cache_[type];
+  return image_cache_.at(type);
 }
 
 template <>
-typename ResourceCache::Cache<std::string>::ResourceDequePtr&
+typename ResourceCache::Cache<std::string>::ResourcesPtr&
 ResourceCache::getCachePtr<std::string>(const ResourceType& type) {
-  return text_cache_[type];
+  return text_cache_.at(type);
 }
 
 template <>
-typename ResourceCache::Cache<resources::PointCloud>::ResourceDequePtr&
+typename ResourceCache::Cache<resources::PointCloud>::ResourcesPtr&
 ResourceCache::getCachePtr<resources::PointCloud>(const ResourceType& type) {
-  return pointcloud_cache_[type];
+  return pointcloud_cache_.at(type);
 }
 
 template <>
-typename ResourceCache::Cache<voxblox::TsdfMap>::ResourceDequePtr&
+typename ResourceCache::Cache<voxblox::TsdfMap>::ResourcesPtr&
 ResourceCache::getCachePtr<voxblox::TsdfMap>(const ResourceType& type) {
-  return voxblox_tsdf_map_cache_[type];
+  return voxblox_tsdf_map_cache_.at(type);
 }
 
 template <>
-typename ResourceCache::Cache<voxblox::EsdfMap>::ResourceDequePtr&
+typename ResourceCache::Cache<voxblox::EsdfMap>::ResourcesPtr&
 ResourceCache::getCachePtr<voxblox::EsdfMap>(const ResourceType& type) {
-  return voxblox_esdf_map_cache_[type];
+  return voxblox_esdf_map_cache_.at(type);
 }
 
 template <>
-typename ResourceCache::Cache<voxblox::OccupancyMap>::ResourceDequePtr&
+typename ResourceCache::Cache<voxblox::OccupancyMap>::ResourcesPtr&
 ResourceCache::getCachePtr<voxblox::OccupancyMap>(const ResourceType& type) {
-  return voxblox_occupancy_map_cache_[type];
+  return voxblox_occupancy_map_cache_.at(type);
 }
 
 void ResourceCache::resetStatistic() {
-  statistic_.reset();
+  for (size_t type_idx = 0u; type_idx < kNumResourceTypes; ++type_idx) {
+    std::lock_guard<std::mutex> lock(mutexes_[type_idx]);
+    statistic_.hit[type_idx] = 0u;
+    statistic_.miss[type_idx] = 0u;
+    statistic_.eviction[type_idx] = 0u;
+  }
+}
+
+CacheStatistic ResourceCache::getStatistic() const {
+  CacheStatistic statistic;
+  statistic.strategy = statistic_.strategy;
+  for (size_t type_idx = 0u; type_idx < kNumResourceTypes; ++type_idx) {
+    std::lock_guard<std::mutex> lock(mutexes_[type_idx]);
+    statistic.hit[type_idx] = statistic_.hit[type_idx];
+    statistic.miss[type_idx] = statistic_.miss[type_idx];
+    statistic.eviction[type_idx] = statistic_.eviction[type_idx];
+    statistic.cache_size[type_idx] = statistic_.cache_size[type_idx];
+    statistic.cache_bytes[type_idx] = statistic_.cache_bytes[type_idx];
+  }
+  return statistic;
+}
+
+void ResourceCache::accumulateMemoryUsage(common::MemoryUsage* usage) const {
+  CHECK_NOTNULL(usage);
+  // NOTE: [ADD_RESOURCE_DATA_TYPE] Add cache.
+  const size_t num_bytes =
+      getCacheMemoryBytes<cv::Mat>(image_cache_) +
+      getCacheMemoryBytes<std::string>(text_cache_) +
+      getCacheMemoryBytes<resources::PointCloud>(pointcloud_cache_) +
+      getCacheMemoryBytes<voxblox::TsdfMap>(voxblox_tsdf_map_cache_) +
+      getCacheMemoryBytes<voxblox::EsdfMap>(voxblox_esdf_map_cache_) +
+      getCacheMemoryBytes<voxblox::OccupancyMap>(voxblox_occupancy_map_cache_);
+  usage->add(common::MemoryUsage::Category::kCachedResources, num_bytes);
+}
+
+size_t getResourceMemoryBytes(const cv::Mat& resource) {
+  return resource.total() * resource.elemSize();
+}
+
+size_t getResourceMemoryBytes(const std::string& resource) {
+  return resource.capacity();
+}
+
+size_t getResourceMemoryBytes(const resources::PointCloud& resource) {
+  return common::getHeapBytes(resource.xyz) +
+         common::getHeapBytes(resource.normals) +
+         common::getHeapBytes(resource.colors);
+}
+
+size_t getResourceMemoryBytes(const voxblox::TsdfMap& resource) {
+  return resource.getTsdfLayer().getMemorySize();
 }
 
-const CacheStatistic& ResourceCache::getStatistic() const {
-  return statistic_;
+size_t getResourceMemoryBytes(const voxblox::EsdfMap& resource) {
+  return resource.getEsdfLayer().getMemorySize();
+}
+
+size_t getResourceMemoryBytes(const voxblox::OccupancyMap& resource) {
+  return resource.getOccupancyLayer().getMemorySize();
 }
 
 size_t CacheStatistic::getNumHits(const ResourceType& type) const {
@@ -54,10 +277,23 @@ size_t CacheStatistic::getNumMiss(const ResourceType& type) const {
   return miss[static_cast<size_t>(type)];
 }
 
+size_t CacheStatistic::getNumEvictions(const ResourceType& type) const {
+  return eviction[static_cast<size_t>(type)];
+}
+
+double CacheStatistic::getHitRate(const ResourceType& type) const {
+  const size_t num_lookups = getNumHits(type) + getNumMiss(type);
+  if (num_lookups == 0u) {
+    return 0.0;
+  }
+  return static_cast<double>(getNumHits(type)) / num_lookups;
+}
+
 void CacheStatistic::reset() {
   for (size_t idx = 0u; idx < kNumResourceTypes; ++idx) {
     hit[idx] = 0u;
     miss[idx] = 0u;
+    eviction[idx] = 0u;
   }
 }
 
@@ -69,16 +305,20 @@ std::string CacheStatistic::print() const {
   CHECK_EQ(hit.size(), miss.size());
 
   std::stringstream ss;
-  ss << "Resource Cache Statistics:\n";
+  ss << "Resource Cache Statistics (strategy: " << strategy << "):\n";
   for (size_t type_idx = 0u; type_idx < kNumResourceTypes; ++type_idx) {
     std::stringstream ss_name;
     ss_name << std::left << std::setw(30)
             << ("Cache [" + ResourceTypeNames[type_idx] + "]:");
     const std::string& padded_name = ss_name.str();
 
+    const ResourceType type = static_cast<ResourceType>(type_idx);
     ss << "  " << padded_name << "\t"
-       << " entries: " << cache_size[type_idx] << " hits: " << hit[type_idx]
-       << " miss: " << miss[type_idx] << std::endl;
+       << " entries: " << cache_size[type_idx]
+       << " bytes: " << cache_bytes[type_idx] << " hits: " << hit[type_idx]
+       << " miss: " << miss[type_idx] << " hit rate: " << std::fixed
+       << std::setprecision(1) << 100.0 * getHitRate(type) << "%"
+       << " evictions: " << eviction[type_idx] << std::endl;
   }
   return ss.str();
 }
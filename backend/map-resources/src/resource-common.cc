@@ -1,12 +1,22 @@
 #include "map-resources/resource-common.h"
 
+#include <algorithm>
 #include <string>
 
+#include <glog/logging.h>
 #include <opencv2/core.hpp>
 #include <voxblox/utils/layer_utils.h>
 
 namespace backend {
 
+ResourceType getResourceTypeFromName(const std::string& name) {
+  const std::array<std::string, kNumResourceTypes>::const_iterator it =
+      std::find(ResourceTypeNames.begin(), ResourceTypeNames.end(), name);
+  CHECK(it != ResourceTypeNames.end())
+      << "Unknown resource type name: \"" << name << "\".";
+  return static_cast<ResourceType>(it - ResourceTypeNames.begin());
+}
+
 // NOTE: [ADD_RESOURCE_DATA_TYPE] Implement.
 template <>
 bool isSameResource(const cv::Mat& resource_A, const cv::Mat& resource_B) {
@@ -50,6 +50,34 @@ bool convertDepthMapWithImageToPointCloud(
       depth_map, image, camera, &voxblox_point_cloud);
 }
 
+void computeDepthMapBackProjectionTable(
+    const aslam::Camera& camera, const int width, const int height,
+    DepthMapBackProjectionTable* table) {
+  CHECK_NOTNULL(table);
+  CHECK_GT(width, 0);
+  CHECK_GT(height, 0);
+  table->width = width;
+  table->height = height;
+  table->bearings.resize(Eigen::NoChange, width * height);
+  table->is_valid.assign(width * height, 0u);
+
+  constexpr double kEpsilon = 1e-6;
+  Eigen::Vector3d bearing_C;
+  for (int v = 0; v < height; ++v) {
+    for (int u = 0; u < width; ++u) {
+      const int pixel_index = v * width + u;
+      camera.backProject3(Eigen::Vector2d(u, v), &bearing_C);
+      if (bearing_C.z() < kEpsilon) {
+        table->bearings.col(pixel_index).setZero();
+        continue;
+      }
+      table->bearings.col(pixel_index) =
+          bearing_C.head<2>() / bearing_C.z();
+      table->is_valid[pixel_index] = 1u;
+    }
+  }
+}
+
 template <>
 void addPointToPointCloud(
     const Eigen::Vector3d& point_C, const size_t index,
@@ -0,0 +1,266 @@
+#include "map-resources/resource-folder-manifest.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <ctime>
+#include <fstream>  // NOLINT
+#include <sstream>
+#include <string>
+
+#include <glog/logging.h>
+#include <maplab-common/file-system-tools.h>
+
+namespace backend {
+
+namespace {
+const std::string kManifestHeader = "maplab_resource_manifest";  // NOLINT
+constexpr int kManifestVersion = 1;
+// The length of the hex strings of resource ids.
+constexpr size_t kNumHexCharacters = 32u;
+
+bool getModificationTime(
+    const std::string& path, int64_t* modification_time_s,
+    uint64_t* num_bytes) {
+  CHECK_NOTNULL(modification_time_s);
+  struct stat status;
+  if (stat(path.c_str(), &status) != 0) {
+    return false;
+  }
+  *modification_time_s = static_cast<int64_t>(status.st_mtime);
+  if (num_bytes != nullptr) {
+    *num_bytes = static_cast<uint64_t>(status.st_size);
+  }
+  return true;
+}
+
+// Gets the id from a file name of a resource of the given type.
+bool getResourceIdFromFileName(
+    const std::string& file_name, const ResourceType& type, ResourceId* id) {
+  CHECK_NOTNULL(id);
+  const std::string suffix = ResourceTypeFileSuffix[static_cast<size_t>(type)];
+  if (file_name.size() != kNumHexCharacters + suffix.size() ||
+      file_name.compare(kNumHexCharacters, suffix.size(), suffix) != 0) {
+    return false;
+  }
+  const std::string hex_string = file_name.substr(0u, kNumHexCharacters);
+  if (!std::all_of(hex_string.begin(), hex_string.end(), [](char c) {
+        return std::isxdigit(static_cast<unsigned char>(c)) != 0;
+      })) {
+    return false;
+  }
+  return id->fromHexString(hex_string);
+}
+}  // namespace
+
+constexpr const char* ResourceFolderManifest::kManifestFileName;
+
+ResourceFolderManifest::ResourceFolderManifest(
+    const std::string& resource_folder)
+    : resource_folder_(resource_folder),
+      type_folders_(kNumResourceTypes),
+      num_rescanned_type_folders_(0u) {
+  CHECK(!resource_folder_.empty());
+  common::concatenateFolderAndFileName(
+      resource_folder_, kManifestFileName, &manifest_file_path_);
+}
+
+void ResourceFolderManifest::update() {
+  if (!load()) {
+    VLOG(2) << "No valid resource manifest in " << resource_folder_
+            << ", scanning all resource files.";
+    type_folders_.assign(kNumResourceTypes, TypeFolder());
+  }
+
+  num_rescanned_type_folders_ = 0u;
+  for (size_t type_idx = 0u; type_idx < kNumResourceTypes; ++type_idx) {
+    if (updateTypeFolder(
+            static_cast<ResourceType>(type_idx), &type_folders_[type_idx])) {
+      ++num_rescanned_type_folders_;
+    }
+  }
+  if (num_rescanned_type_folders_ > 0u && !save()) {
+    VLOG(2) << "Could not save the resource manifest to "
+            << manifest_file_path_ << ".";
+  }
+}
+
+bool ResourceFolderManifest::hasResource(
+    const ResourceId& id, const ResourceType& type) const {
+  return type_folders_[static_cast<size_t>(type)].files.count(id) > 0u;
+}
+
+bool ResourceFolderManifest::getResourceFileInfo(
+    const ResourceId& id, const ResourceType& type,
+    ResourceFileInfo* info) const {
+  CHECK_NOTNULL(info);
+  const ResourceFileInfoMap& files =
+      type_folders_[static_cast<size_t>(type)].files;
+  const ResourceFileInfoMap::const_iterator it = files.find(id);
+  if (it == files.cend()) {
+    return false;
+  }
+  *info = it->second;
+  return true;
+}
+
+size_t ResourceFolderManifest::getNumResources() const {
+  size_t num_resources = 0u;
+  for (const TypeFolder& type_folder : type_folders_) {
+    num_resources += type_folder.files.size();
+  }
+  return num_resources;
+}
+
+bool ResourceFolderManifest::updateTypeFolder(
+    const ResourceType& type, TypeFolder* type_folder) {
+  CHECK_NOTNULL(type_folder);
+  std::string type_folder_path;
+  common::concatenateFolderAndFileName(
+      resource_folder_, ResourceTypeNames[static_cast<size_t>(type)],
+      &type_folder_path);
+
+  int64_t modification_time_s = -1;
+  getModificationTime(type_folder_path, &modification_time_s, nullptr);
+  if (modification_time_s == type_folder->modification_time_s &&
+      modification_time_s < type_folder->scan_time_s) {
+    return false;
+  }
+
+  type_folder->modification_time_s = modification_time_s;
+  type_folder->scan_time_s = static_cast<int64_t>(std::time(nullptr));
+  if (modification_time_s < 0) {
+    type_folder->files.clear();
+    return true;
+  }
+  DIR* directory = opendir(type_folder_path.c_str());
+  if (directory == nullptr) {
+    type_folder->files.clear();
+    return true;
+  }
+
+  // Keeps the files that are still there and only checks the new ones.
+  ResourceFileInfoMap files;
+  struct dirent* entry;
+  while ((entry = readdir(directory)) != nullptr) {
+    ResourceId id;
+    if (!getResourceIdFromFileName(entry->d_name, type, &id)) {
+      continue;
+    }
+    const ResourceFileInfoMap::const_iterator it =
+        type_folder->files.find(id);
+    if (it != type_folder->files.cend()) {
+      files.emplace(id, it->second);
+      continue;
+    }
+    ResourceFileInfo info;
+    if (getModificationTime(
+            type_folder_path + "/" + entry->d_name, &info.modification_time_s,
+            &info.num_bytes)) {
+      files.emplace(id, info);
+    }
+  }
+  closedir(directory);
+  type_folder->files.swap(files);
+  return true;
+}
+
+bool ResourceFolderManifest::load() {
+  std::ifstream manifest_file(manifest_file_path_);
+  if (!manifest_file.is_open()) {
+    return false;
+  }
+  std::string header;
+  int version;
+  if (!(manifest_file >> header >> version) || header != kManifestHeader ||
+      version != kManifestVersion) {
+    return false;
+  }
+
+  // Every type folder has a line "folder <modification time> <scan time>
+  // <type name>", followed by a line "file <id> <size> <modification time>"
+  // for each of its files. Type names can contain spaces.
+  type_folders_.assign(kNumResourceTypes, TypeFolder());
+  TypeFolder* type_folder = nullptr;
+  std::string line;
+  std::getline(manifest_file, line);
+  while (std::getline(manifest_file, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    std::istringstream line_stream(line);
+    std::string kind;
+    line_stream >> kind;
+    if (kind == "folder") {
+      int64_t modification_time_s, scan_time_s;
+      std::string type_name;
+      if (!(line_stream >> modification_time_s >> scan_time_s) ||
+          !std::getline(line_stream >> std::ws, type_name)) {
+        return false;
+      }
+      size_t type_idx = 0u;
+      while (type_idx < kNumResourceTypes &&
+             type_name != ResourceTypeNames[type_idx]) {
+        ++type_idx;
+      }
+      if (type_idx == kNumResourceTypes) {
+        // Written by a version with other resource types.
+        return false;
+      }
+      type_folder = &type_folders_[type_idx];
+      type_folder->modification_time_s = modification_time_s;
+      type_folder->scan_time_s = scan_time_s;
+    } else if (kind == "file" && type_folder != nullptr) {
+      std::string hex_string;
+      ResourceFileInfo info;
+      ResourceId id;
+      if (!(line_stream >> hex_string >> info.num_bytes >>
+            info.modification_time_s) ||
+          !id.fromHexString(hex_string)) {
+        return false;
+      }
+      type_folder->files.emplace(id, info);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ResourceFolderManifest::save() const {
+  if (!common::pathExists(resource_folder_)) {
+    return false;
+  }
+  // Writes to a temporary file first, such that readers never see a partial
+  // manifest.
+  const std::string temporary_file_path = manifest_file_path_ + ".tmp";
+  {
+    std::ofstream manifest_file(temporary_file_path, std::ios::trunc);
+    if (!manifest_file.is_open()) {
+      return false;
+    }
+    manifest_file << kManifestHeader << " " << kManifestVersion << "\n";
+    for (size_t type_idx = 0u; type_idx < kNumResourceTypes; ++type_idx) {
+      const TypeFolder& type_folder = type_folders_[type_idx];
+      manifest_file << "folder " << type_folder.modification_time_s << " "
+                    << type_folder.scan_time_s << " "
+                    << ResourceTypeNames[type_idx] << "\n";
+      for (const ResourceFileInfoMap::value_type& file : type_folder.files) {
+        manifest_file << "file " << file.first.hexString() << " "
+                      << file.second.num_bytes << " "
+                      << file.second.modification_time_s << "\n";
+      }
+    }
+    if (!manifest_file.good()) {
+      return false;
+    }
+  }
+  return std::rename(
+             temporary_file_path.c_str(), manifest_file_path_.c_str()) == 0;
+}
+
+}  // namespace backend
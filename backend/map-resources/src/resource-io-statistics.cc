@@ -0,0 +1,238 @@
+#include "map-resources/resource-io-statistics.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <mutex>
+#include <sstream>  // NOLINT
+#include <string>
+
+#include <glog/logging.h>
+
+namespace backend {
+
+namespace {
+
+std::mutex& getStatisticMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+ResourceIoStatistic& getProcessStatistic() {
+  static ResourceIoStatistic statistic;
+  return statistic;
+}
+
+size_t getLatencyBucket(const int64_t latency_ns) {
+  int64_t latency_us = latency_ns / 1000;
+  size_t bucket = 0u;
+  while (latency_us > 0 && bucket + 1u < kNumIoLatencyBuckets) {
+    latency_us >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+double getMilliseconds(const int64_t nanoseconds) {
+  return nanoseconds * 1e-6;
+}
+
+}  // namespace
+
+void ResourceIoStatistic::reset() {
+  *this = ResourceIoStatistic();
+}
+
+bool ResourceIoStatistic::empty() const {
+  for (size_t type_idx = 0u; type_idx < kNumResourceTypes; ++type_idx) {
+    if (num_loads[type_idx] > 0u || num_stores[type_idx] > 0u) {
+      return false;
+    }
+  }
+  return true;
+}
+
+ResourceIoStatistic ResourceIoStatistic::getDifference(
+    const ResourceIoStatistic& earlier) const {
+  ResourceIoStatistic difference;
+  for (size_t type_idx = 0u; type_idx < kNumResourceTypes; ++type_idx) {
+    CHECK_GE(num_loads[type_idx], earlier.num_loads[type_idx])
+        << "The earlier statistic is newer.";
+    CHECK_GE(num_stores[type_idx], earlier.num_stores[type_idx])
+        << "The earlier statistic is newer.";
+    difference.num_loads[type_idx] =
+        num_loads[type_idx] - earlier.num_loads[type_idx];
+    difference.num_stores[type_idx] =
+        num_stores[type_idx] - earlier.num_stores[type_idx];
+    difference.bytes_loaded[type_idx] =
+        bytes_loaded[type_idx] - earlier.bytes_loaded[type_idx];
+    difference.bytes_stored[type_idx] =
+        bytes_stored[type_idx] - earlier.bytes_stored[type_idx];
+    difference.read_ns[type_idx] =
+        read_ns[type_idx] - earlier.read_ns[type_idx];
+    difference.write_ns[type_idx] =
+        write_ns[type_idx] - earlier.write_ns[type_idx];
+    difference.decode_ns[type_idx] =
+        decode_ns[type_idx] - earlier.decode_ns[type_idx];
+    difference.encode_ns[type_idx] =
+        encode_ns[type_idx] - earlier.encode_ns[type_idx];
+    for (size_t bucket = 0u; bucket < kNumIoLatencyBuckets; ++bucket) {
+      difference.read_latency_histogram[type_idx][bucket] =
+          read_latency_histogram[type_idx][bucket] -
+          earlier.read_latency_histogram[type_idx][bucket];
+    }
+  }
+  return difference;
+}
+
+double ResourceIoStatistic::getReadLatencyQuantileMicroseconds(
+    const ResourceType& type, const double quantile) const {
+  CHECK_GE(quantile, 0.0);
+  CHECK_LE(quantile, 1.0);
+  const size_t type_idx = static_cast<size_t>(type);
+  const size_t num_type_loads = num_loads[type_idx];
+  if (num_type_loads == 0u) {
+    return 0.0;
+  }
+  const size_t num_loads_below =
+      std::max<size_t>(1u, std::ceil(quantile * num_type_loads));
+  size_t num_loads_in_buckets = 0u;
+  for (size_t bucket = 0u; bucket < kNumIoLatencyBuckets; ++bucket) {
+    num_loads_in_buckets += read_latency_histogram[type_idx][bucket];
+    if (num_loads_in_buckets >= num_loads_below) {
+      return static_cast<double>(1u << bucket);
+    }
+  }
+  return static_cast<double>(1u << (kNumIoLatencyBuckets - 1u));
+}
+
+void ResourceIoStatistic::printToLog(int verbosity) const {
+  VLOG(verbosity) << print();
+}
+
+std::string ResourceIoStatistic::print() const {
+  std::stringstream ss;
+  ss << "Resource I/O Statistics:\n";
+  if (empty()) {
+    ss << "  No resources were loaded or stored.\n";
+    return ss.str();
+  }
+  for (size_t type_idx = 0u; type_idx < kNumResourceTypes; ++type_idx) {
+    if (num_loads[type_idx] == 0u && num_stores[type_idx] == 0u) {
+      continue;
+    }
+    std::stringstream ss_name;
+    ss_name << std::left << std::setw(30)
+            << ("I/O [" + ResourceTypeNames[type_idx] + "]:");
+    const ResourceType type = static_cast<ResourceType>(type_idx);
+    ss << "  " << ss_name.str() << "\t" << std::fixed << std::setprecision(1)
+       << " loads: " << num_loads[type_idx]
+       << " bytes: " << bytes_loaded[type_idx]
+       << " read: " << getMilliseconds(read_ns[type_idx]) << " ms"
+       << " decode: " << getMilliseconds(decode_ns[type_idx]) << " ms"
+       << " read latency p50/p99: <"
+       << getReadLatencyQuantileMicroseconds(type, 0.5) << "/<"
+       << getReadLatencyQuantileMicroseconds(type, 0.99) << " us"
+       << " stores: " << num_stores[type_idx]
+       << " bytes: " << bytes_stored[type_idx]
+       << " write: " << getMilliseconds(write_ns[type_idx]) << " ms"
+       << " encode: " << getMilliseconds(encode_ns[type_idx]) << " ms"
+       << std::endl;
+  }
+  return ss.str();
+}
+
+ResourceIoStatistics::OperationTimer::OperationTimer()
+    : start_(std::chrono::steady_clock::now()),
+      thread_codec_ns_at_start_(getThreadCodecNanoseconds()) {}
+
+void ResourceIoStatistics::OperationTimer::getTimes(
+    int64_t* file_system_ns, int64_t* codec_ns) const {
+  CHECK_NOTNULL(file_system_ns);
+  CHECK_NOTNULL(codec_ns);
+  const int64_t total_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start_)
+          .count();
+  *codec_ns = getThreadCodecNanoseconds() - thread_codec_ns_at_start_;
+  *file_system_ns = std::max<int64_t>(0, total_ns - *codec_ns);
+}
+
+void ResourceIoStatistics::OperationTimer::finishLoad(
+    const ResourceType& type, const size_t num_bytes) const {
+  int64_t read_ns, decode_ns;
+  getTimes(&read_ns, &decode_ns);
+  recordLoad(type, num_bytes, read_ns, decode_ns);
+}
+
+void ResourceIoStatistics::OperationTimer::finishStore(
+    const ResourceType& type, const size_t num_bytes) const {
+  int64_t write_ns, encode_ns;
+  getTimes(&write_ns, &encode_ns);
+  recordStore(type, num_bytes, write_ns, encode_ns);
+}
+
+ResourceIoStatistics::ScopedCodecTimer::ScopedCodecTimer()
+    : start_(std::chrono::steady_clock::now()) {}
+
+ResourceIoStatistics::ScopedCodecTimer::~ScopedCodecTimer() {
+  getThreadCodecNanoseconds() +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start_)
+          .count();
+}
+
+void ResourceIoStatistics::recordLoad(
+    const ResourceType& type, const size_t num_bytes, const int64_t read_ns,
+    const int64_t decode_ns) {
+  const size_t type_idx = static_cast<size_t>(type);
+  CHECK_LT(type_idx, kNumResourceTypes);
+  const size_t bucket = getLatencyBucket(read_ns);
+  std::lock_guard<std::mutex> lock(getStatisticMutex());
+  ResourceIoStatistic& statistic = getProcessStatistic();
+  ++statistic.num_loads[type_idx];
+  statistic.bytes_loaded[type_idx] += num_bytes;
+  statistic.read_ns[type_idx] += read_ns;
+  statistic.decode_ns[type_idx] += decode_ns;
+  ++statistic.read_latency_histogram[type_idx][bucket];
+}
+
+void ResourceIoStatistics::recordStore(
+    const ResourceType& type, const size_t num_bytes, const int64_t write_ns,
+    const int64_t encode_ns) {
+  const size_t type_idx = static_cast<size_t>(type);
+  CHECK_LT(type_idx, kNumResourceTypes);
+  std::lock_guard<std::mutex> lock(getStatisticMutex());
+  ResourceIoStatistic& statistic = getProcessStatistic();
+  ++statistic.num_stores[type_idx];
+  statistic.bytes_stored[type_idx] += num_bytes;
+  statistic.write_ns[type_idx] += write_ns;
+  statistic.encode_ns[type_idx] += encode_ns;
+}
+
+ResourceIoStatistic ResourceIoStatistics::getStatistic() {
+  std::lock_guard<std::mutex> lock(getStatisticMutex());
+  return getProcessStatistic();
+}
+
+void ResourceIoStatistics::reset() {
+  std::lock_guard<std::mutex> lock(getStatisticMutex());
+  getProcessStatistic().reset();
+}
+
+int64_t& ResourceIoStatistics::getThreadCodecNanoseconds() {
+  thread_local int64_t codec_ns = 0;
+  return codec_ns;
+}
+
+size_t getFileSizeBytes(const std::string& file_path) {
+  struct stat file_status;
+  if (stat(file_path.c_str(), &file_status) != 0) {
+    return 0u;
+  }
+  return static_cast<size_t>(file_status.st_size);
+}
+
+}  // namespace backend
@@ -1,49 +1,416 @@
 #include "map-resources/resource-loader.h"
 
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+
+#include <cmath>
 #include <cstdio>
 #include <fstream>  // NOLINT
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
 
+#include <gflags/gflags.h>
 #include <maplab-common/file-system-tools.h>
+#include <maplab-common/memory-mapped-file.h>
+#include <maplab-common/string-tools.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <voxblox/io/layer_io.h>
 
+#include "map-resources/chunked-point-cloud.h"
+#include "map-resources/depth-map-codec.h"
+#include "map-resources/resource-io-statistics.h"
 #include "map-resources/tinyply/tinyply.h"
 
+DEFINE_bool(
+    resource_use_packed_containers, false,
+    "Store new image, text and point cloud resources in one packed container "
+    "per resource type and resource folder instead of one file per resource. "
+    "Resources are read from both regardless of this flag.");
+DEFINE_uint64(
+    resource_packed_segment_megabytes, 256u,
+    "Size in MB after which packed resource containers start a new segment "
+    "file.");
+DEFINE_double(
+    resource_packed_compaction_threshold, 0.25,
+    "Fraction of superseded records above which cleaning up the resource "
+    "folders compacts a packed resource container.");
+DEFINE_string(
+    resource_depth_map_codec_types, "",
+    "Comma separated names of the depth and disparity map resource types, e.g. "
+    "raw_depth_maps,optimized_depth_maps,disparity_maps, that are stored with "
+    "the lossless depth map codec instead of as PGM. The files keep their "
+    "suffix. Resources are read in both formats regardless of this flag.");
+DEFINE_double(
+    resource_point_cloud_chunk_meters, 0.0,
+    "If positive, point cloud resources are stored in the chunked point cloud "
+    "format with chunks of this edge length instead of as PLY, so regions of "
+    "them can be loaded without reading the whole cloud. This reorders the "
+    "points. The files keep their suffix. Resources are read in both formats "
+    "regardless of this flag.");
+DEFINE_bool(
+    resource_migration_use_hardlinks, false,
+    "Hardlink resource files when copying them to another resource folder on "
+    "the same file system and they can't be reflinked. The map code never "
+    "modifies resource files in place, but other tools editing a file would "
+    "change it in both folders.");
+
 namespace backend {
 
+namespace {
+constexpr size_t kBytesPerMegabyte = 1024u * 1024u;
+constexpr size_t kMigrationCopyBufferBytes = 4u * kBytesPerMegabyte;
+
+// NOTE: [ADD_RESOURCE_TYPE] Add case if you add a new cv::Mat resource type.
+void getImageReadModeAndType(
+    const ResourceType& type, int* read_mode, int* image_type) {
+  CHECK_NOTNULL(read_mode);
+  CHECK_NOTNULL(image_type);
+  switch (type) {
+    case ResourceType::kRawDepthMap:
+    case ResourceType::kOptimizedDepthMap:
+      *read_mode = CV_LOAD_IMAGE_UNCHANGED;
+      *image_type = CV_16U;
+      break;
+    case ResourceType::kUndistortedImage:
+    case ResourceType::kRectifiedImage:
+    case ResourceType::kImageForDepthMap:
+    case ResourceType::kRawImage:
+      *read_mode = CV_LOAD_IMAGE_GRAYSCALE;
+      *image_type = CV_8U;
+      break;
+    case ResourceType::kUndistortedColorImage:
+    case ResourceType::kRectifiedColorImage:
+    case ResourceType::kColorImageForDepthMap:
+    case ResourceType::kRawColorImage:
+      *read_mode = CV_LOAD_IMAGE_COLOR;
+      *image_type = CV_8UC3;
+      break;
+    case ResourceType::kDisparityMap:
+      *read_mode = CV_LOAD_IMAGE_UNCHANGED;
+      *image_type = CV_16U;
+      break;
+    default:
+      LOG(FATAL) << "Unknown cv::Mat resource type: "
+                 << ResourceTypeNames[static_cast<size_t>(type)];
+  }
+}
+
+bool isDepthMapType(const ResourceType& type) {
+  return type == ResourceType::kRawDepthMap ||
+         type == ResourceType::kOptimizedDepthMap ||
+         type == ResourceType::kDisparityMap;
+}
+
+bool useDepthMapCodec(const ResourceType& type) {
+  if (!isDepthMapType(type) || FLAGS_resource_depth_map_codec_types.empty()) {
+    return false;
+  }
+  std::vector<std::string> type_names;
+  common::tokenizeString(
+      FLAGS_resource_depth_map_codec_types, ',', true /*remove_empty*/,
+      &type_names);
+  for (const std::string& type_name : type_names) {
+    const ResourceType codec_type = getResourceTypeFromName(type_name);
+    CHECK(isDepthMapType(codec_type))
+        << "The depth map codec doesn't support resources of type "
+        << type_name << ".";
+    if (codec_type == type) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Decodes both depth maps stored with the codec and images in any format
+// OpenCV can read.
+bool decodeImage(
+    const ResourceType& type, const int read_mode, const char* data,
+    const size_t num_bytes, cv::Mat* resource) {
+  CHECK_NOTNULL(data);
+  CHECK_NOTNULL(resource);
+  if (isDepthMapType(type) && isEncodedDepthMap(data, num_bytes)) {
+    return decodeDepthMap(data, num_bytes, resource);
+  }
+  // Wraps the data without copying it.
+  const cv::Mat buffer(
+      1, static_cast<int>(num_bytes), CV_8U, const_cast<char*>(data));
+  *resource = cv::imdecode(buffer, read_mode);
+  return true;
+}
+
+bool isValidImage(
+    const ResourceType& type, const int image_type, const std::string& source,
+    const cv::Mat& resource) {
+  if (CV_MAT_TYPE(resource.type()) != image_type) {
+    VLOG(1) << "cv::Mat Resource at: " << source << " has wrong image type!";
+    return false;
+  }
+
+  bool empty_resource = !resource.data || resource.empty();
+  if (empty_resource) {
+    VLOG(1) << "Loading resource of type "
+            << ResourceTypeNames[static_cast<size_t>(type)] << " from "
+            << source << " failed!";
+    return false;
+  }
+  return true;
+}
+
+// NOTE: [ADD_RESOURCE_TYPE] Add case if you add a new string resource type.
+void checkIsTextType(const ResourceType& type) {
+  switch (type) {
+    case ResourceType::kPmvsReconstructionPath:
+    case ResourceType::kTsdfGridPath:
+    case ResourceType::kEsdfGridPath:
+    case ResourceType::kOccupancyGridPath:
+    // TODO(mfehr): don't read and write path resources to file but store it
+    // in the maps meta data.
+
+    //  Fall through intended.
+    case ResourceType::kText:
+    // Binary data that is stored the same way as text.
+    case ResourceType::kProjectedDescriptorCache:
+      break;
+    default:
+      LOG(FATAL) << "Unknown text resource type: "
+                 << ResourceTypeNames[static_cast<size_t>(type)];
+  }
+}
+
+void writePointCloud(
+    const resources::PointCloud& resource, std::ostream* output_stream) {
+  CHECK_NOTNULL(output_stream);
+  tinyply::PlyFile ply_file;
+
+  // Const-casting is necessary as tinyply requires non-const access to the
+  // vectors for reading.
+  ply_file.add_properties_to_element(
+      "vertex", {"x", "y", "z"}, const_cast<std::vector<float>&>(resource.xyz));
+  if (!resource.normals.empty()) {
+    ply_file.add_properties_to_element(
+        "vertex", {"nx", "ny", "nz"},
+        const_cast<std::vector<float>&>(resource.normals));
+  }
+  if (!resource.colors.empty()) {
+    ply_file.add_properties_to_element(
+        "vertex", {"red", "green", "blue"},
+        const_cast<std::vector<unsigned char>&>(resource.colors));
+  }
+
+  ply_file.comments.push_back("generated by tinyply from maplab");
+  ply_file.write(*output_stream, true);
+}
+
+void readPointCloud(
+    std::istream* input_stream, resources::PointCloud* resource) {
+  CHECK_NOTNULL(input_stream);
+  CHECK_NOTNULL(resource);
+  tinyply::PlyFile ply_file(*input_stream);
+  const int xyz_point_count = ply_file.request_properties_from_element(
+      "vertex", {"x", "y", "z"}, resource->xyz);
+  const int colors_count = ply_file.request_properties_from_element(
+      "vertex", {"nx", "ny", "nz"}, resource->normals);
+  const int normals_count = ply_file.request_properties_from_element(
+      "vertex", {"red", "green", "blue"}, resource->colors);
+  if (xyz_point_count > 0) {
+    if (colors_count > 0) {
+      // If colors are present, their count should match the point count.
+      CHECK_EQ(xyz_point_count, colors_count);
+    }
+    if (normals_count > 0) {
+      // If normals are present, their count should match the point count.
+      CHECK_EQ(xyz_point_count, normals_count);
+    }
+
+    ply_file.read(*input_stream);
+  }
+}
+
+// Decodes both chunked point clouds and PLY files.
+void decodePointCloud(
+    const char* data, size_t num_bytes, resources::PointCloud* resource) {
+  CHECK_NOTNULL(data);
+  CHECK_NOTNULL(resource);
+  if (isEncodedChunkedPointCloud(data, num_bytes)) {
+    const ChunkedPointCloudReader reader(data, num_bytes);
+    CHECK(reader.isValid()) << "Corrupt chunked point cloud.";
+    reader.readPointCloud(1.0 /*level_of_detail*/, resource);
+    return;
+  }
+  // tinyply reads from streams only.
+  std::istringstream input_stream(
+      std::string(data, num_bytes), std::ios::in | std::ios::binary);
+  readPointCloud(&input_stream, resource);
+}
+
+// Keeps the points of a point cloud that isn't chunked that are inside of the
+// region, subsampled to the level of detail.
+void cropPointCloud(
+    const resources::PointCloud& point_cloud, const Eigen::AlignedBox3f& region,
+    const double level_of_detail, resources::PointCloud* region_point_cloud) {
+  CHECK_NOTNULL(region_point_cloud);
+  CHECK_GT(level_of_detail, 0.0);
+  CHECK_LE(level_of_detail, 1.0);
+  region_point_cloud->xyz.clear();
+  region_point_cloud->normals.clear();
+  region_point_cloud->colors.clear();
+  const size_t step =
+      static_cast<size_t>(std::round(1.0 / level_of_detail));
+  for (size_t point_idx = 0u; point_idx < point_cloud.size();
+       point_idx += step) {
+    const size_t offset = 3u * point_idx;
+    const Eigen::Vector3f point(
+        point_cloud.xyz[offset], point_cloud.xyz[offset + 1u],
+        point_cloud.xyz[offset + 2u]);
+    if (!region.contains(point)) {
+      continue;
+    }
+    region_point_cloud->xyz.insert(
+        region_point_cloud->xyz.end(), point_cloud.xyz.begin() + offset,
+        point_cloud.xyz.begin() + offset + 3u);
+    if (!point_cloud.normals.empty()) {
+      region_point_cloud->normals.insert(
+          region_point_cloud->normals.end(),
+          point_cloud.normals.begin() + offset,
+          point_cloud.normals.begin() + offset + 3u);
+    }
+    if (!point_cloud.colors.empty()) {
+      region_point_cloud->colors.insert(
+          region_point_cloud->colors.end(),
+          point_cloud.colors.begin() + offset,
+          point_cloud.colors.begin() + offset + 3u);
+    }
+  }
+}
+
+// Clones the file on file systems with copy-on-write support, e.g. btrfs or
+// XFS, which takes constant time and no space.
+bool reflinkFile(const std::string& source, const std::string& destination) {
+#ifdef FICLONE
+  const int source_fd = open(source.c_str(), O_RDONLY);
+  if (source_fd < 0) {
+    return false;
+  }
+  const int destination_fd =
+      open(destination.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (destination_fd < 0) {
+    close(source_fd);
+    return false;
+  }
+  const bool success = ioctl(destination_fd, FICLONE, source_fd) == 0;
+  close(source_fd);
+  close(destination_fd);
+  return success;
+#else
+  return false;
+#endif
+}
+
+// Moves or copies a resource file to a path that doesn't exist yet, the
+// cheapest way the file system allows: renaming, reflinking or, with
+// --resource_migration_use_hardlinks, hardlinking. Otherwise it copies the
+// content into a temporary file which is renamed once complete, so the
+// destination never holds a partial file.
+void transferResourceFile(
+    const std::string& source, const std::string& destination,
+    const bool move_file) {
+  if (move_file && std::rename(source.c_str(), destination.c_str()) == 0) {
+    return;
+  }
+
+  const std::string temporary_file_path = destination + ".migrating";
+  if (!reflinkFile(source, temporary_file_path)) {
+    if (!move_file && FLAGS_resource_migration_use_hardlinks &&
+        link(source.c_str(), destination.c_str()) == 0) {
+      std::remove(temporary_file_path.c_str());
+      return;
+    }
+    std::ifstream source_file(source, std::ios::binary);
+    std::ofstream temporary_file(
+        temporary_file_path, std::ios::binary | std::ios::trunc);
+    CHECK(source_file.is_open()) << "path: \'" << source << "\'";
+    CHECK(temporary_file.is_open())
+        << "path: \'" << temporary_file_path << "\'";
+    // Large blocks, the default stream buffers are a few KB.
+    std::vector<char> buffer(kMigrationCopyBufferBytes);
+    while (source_file.read(buffer.data(), buffer.size()) ||
+           source_file.gcount() > 0) {
+      temporary_file.write(buffer.data(), source_file.gcount());
+    }
+    temporary_file.close();
+    CHECK(!temporary_file.fail())
+        << "Failed to copy resource file " << source << " to "
+        << temporary_file_path << ".";
+  }
+  CHECK_EQ(
+      std::rename(temporary_file_path.c_str(), destination.c_str()), 0)
+      << "Failed to rename " << temporary_file_path << " to " << destination
+      << ".";
+  if (move_file) {
+    common::deleteFile(source);
+  }
+}
+}  // namespace
+
 void ResourceLoader::migrateResource(
     const ResourceId& id, const ResourceType& type,
     const std::string& old_folder, const std::string& new_folder,
     const bool move_resource) {
   CHECK(!old_folder.empty());
   CHECK(!new_folder.empty());
+
+  PackedResourceContainer* old_container =
+      getPackedContainer(old_folder, type, false);
+  if (old_container != nullptr && old_container->hasResource(id)) {
+    // Packed resources stay packed, the encoding is the same.
+    PackedResourceContainer* new_container =
+        CHECK_NOTNULL(getPackedContainer(new_folder, type, true));
+    if (!new_container->hasResource(id)) {
+      CHECK(old_container->readResource(
+          id, [&id, new_container](const char* data, size_t num_bytes) {
+            new_container->putResource(id, std::string(data, num_bytes));
+            return true;
+          }));
+    }
+    if (move_resource) {
+      CHECK(old_container->deleteResource(id));
+    }
+    return;
+  }
+
   std::string old_file_path;
   getResourceFilePath(id, type, old_folder, &old_file_path);
-  CHECK(common::fileExists(old_file_path))
-      << "path: \'" << old_file_path << "\'";
-
   std::string new_file_path;
   getResourceFilePath(id, type, new_folder, &new_file_path);
-  CHECK(!common::fileExists(new_file_path));
-  CHECK(common::createPathToFile(new_file_path));
-
-  std::ifstream source_file(old_file_path, std::ios::binary);
-  std::ofstream destination_file(new_file_path, std::ios::binary);
-  CHECK(source_file.is_open());
-  CHECK(destination_file.is_open());
-
-  // Copy the file.
-  destination_file << source_file.rdbuf();
-
-  if (move_resource) {
-    common::deleteFile(old_file_path);
+  if (common::fileExists(new_file_path)) {
+    // Left by an interrupted migration, the file is complete as it is renamed
+    // into place.
+    VLOG(3) << "Resource file was migrated already: " << new_file_path;
+    if (move_resource && common::fileExists(old_file_path)) {
+      common::deleteFile(old_file_path);
+    }
+    return;
   }
+  CHECK(common::fileExists(old_file_path))
+      << "path: \'" << old_file_path << "\'";
+  CHECK(common::createPathToFile(new_file_path));
+  transferResourceFile(old_file_path, new_file_path, move_resource);
 }
 
 void ResourceLoader::deleteResourceFile(
     const ResourceId& id, const ResourceType& type, const std::string& folder) {
   CHECK(!folder.empty());
+  PackedResourceContainer* container = getPackedContainer(folder, type, false);
+  if (container != nullptr && container->deleteResource(id)) {
+    return;
+  }
   std::string file_path;
   getResourceFilePath(id, type, folder, &file_path);
   CHECK_EQ(std::remove(file_path.c_str()), 0);
@@ -67,23 +434,95 @@ bool ResourceLoader::resourceFileExists(
     const ResourceId& id, const ResourceType& type,
     const std::string& folder) const {
   CHECK(!folder.empty());
+  const PackedResourceContainer* container =
+      getPackedContainer(folder, type, false);
+  if (container != nullptr && container->hasResource(id)) {
+    return true;
+  }
   std::string file_path;
   getResourceFilePath(id, type, folder, &file_path);
   return common::fileExists(file_path);
 }
 
+bool ResourceLoader::getStandaloneResourceFilePath(
+    const ResourceId& id, const ResourceType& type, const std::string& folder,
+    std::string* file_path) const {
+  CHECK(!folder.empty());
+  CHECK_NOTNULL(file_path);
+  const PackedResourceContainer* container =
+      getPackedContainer(folder, type, false);
+  if (container != nullptr && container->hasResource(id)) {
+    return false;
+  }
+  getResourceFilePath(id, type, folder, file_path);
+  return common::fileExists(*file_path);
+}
+
+PackedResourceContainer* ResourceLoader::getPackedContainer(
+    const std::string& folder, const ResourceType& type,
+    const bool create) const {
+  CHECK(!folder.empty());
+  std::string container_folder;
+  PackedResourceContainer::getContainerFolder(folder, type, &container_folder);
+
+  std::lock_guard<std::mutex> lock(packed_containers_mutex_);
+  const std::unordered_map<std::string, PackedResourceContainer::Ptr>::
+      const_iterator it = packed_containers_.find(container_folder);
+  if (it != packed_containers_.end()) {
+    return it->second.get();
+  }
+  // Folders without a container aren't remembered, another resource loader
+  // may create one.
+  if (!create && !common::pathExists(container_folder)) {
+    return nullptr;
+  }
+  PackedResourceContainer::Ptr container(new PackedResourceContainer(
+      container_folder,
+      FLAGS_resource_packed_segment_megabytes * kBytesPerMegabyte));
+  packed_containers_.emplace(container_folder, container);
+  return container.get();
+}
+
+void ResourceLoader::compactPackedContainers(const std::string& folder) {
+  CHECK(!folder.empty());
+  for (size_t type_idx = 0u; type_idx < kNumResourceTypes; ++type_idx) {
+    PackedResourceContainer* container =
+        getPackedContainer(folder, static_cast<ResourceType>(type_idx), false);
+    if (container == nullptr) {
+      continue;
+    }
+    const size_t num_bytes = container->getNumBytes();
+    if (num_bytes > 0u && container->getNumUnusedBytes() >
+                              FLAGS_resource_packed_compaction_threshold *
+                                  static_cast<double>(num_bytes)) {
+      container->compact();
+    }
+  }
+}
+
 template <>
 void ResourceLoader::saveResourceToFile<cv::Mat>(
-    const std::string& file_path, const ResourceType& /*type*/,
+    const std::string& file_path, const ResourceType& type,
     const cv::Mat& resource) const {
   CHECK(!file_path.empty());
   CHECK(!common::fileExists(file_path));
   CHECK(common::createPathToFile(file_path));
+  if (useDepthMapCodec(type)) {
+    std::string encoded_resource;
+    {
+      const ResourceIoStatistics::ScopedCodecTimer encode_timer;
+      encodeDepthMap(resource, &encoded_resource);
+    }
+    std::ofstream file_stream(file_path, std::ios::binary);
+    file_stream.write(encoded_resource.data(), encoded_resource.size());
+    CHECK(file_stream.good())
+        << "Failed to store cv::Mat to " << file_path << ".";
+    return;
+  }
   CHECK(cv::imwrite(file_path, resource))
       << "Failed to store cv::Mat to " << file_path << ".";
 }
 
-// NOTE: [ADD_RESOURCE_TYPE] Add case if you add a new cv::Mat resource type.
 template <>
 bool ResourceLoader::loadResourceFromFile<cv::Mat>(
     const std::string& file_path, const ResourceType& type,
@@ -95,50 +534,65 @@ bool ResourceLoader::loadResourceFromFile<cv::Mat>(
     return false;
   }
 
-  bool wrong_type = false;
-  switch (type) {
-    case ResourceType::kRawDepthMap:
-    case ResourceType::kOptimizedDepthMap:
-      *resource = cv::imread(file_path, CV_LOAD_IMAGE_UNCHANGED);
-      wrong_type = CV_MAT_TYPE(resource->type()) != CV_16U;
-      break;
-    case ResourceType::kUndistortedImage:
-    case ResourceType::kRectifiedImage:
-    case ResourceType::kImageForDepthMap:
-    case ResourceType::kRawImage:
-      *resource = cv::imread(file_path, CV_LOAD_IMAGE_GRAYSCALE);
-      wrong_type = CV_MAT_TYPE(resource->type()) != CV_8U;
-      break;
-    case ResourceType::kUndistortedColorImage:
-    case ResourceType::kRectifiedColorImage:
-    case ResourceType::kColorImageForDepthMap:
-    case ResourceType::kRawColorImage:
-      *resource = cv::imread(file_path, CV_LOAD_IMAGE_COLOR);
-      wrong_type = CV_MAT_TYPE(resource->type()) != CV_8UC3;
-      break;
-    case ResourceType::kDisparityMap:
-      *resource = cv::imread(file_path, CV_LOAD_IMAGE_UNCHANGED);
-      wrong_type = CV_MAT_TYPE(resource->type()) != CV_16U;
-      break;
-    default:
-      LOG(FATAL) << "Unknown cv::Mat resource type: "
-                 << ResourceTypeNames[static_cast<size_t>(type)];
-  }
-  if (wrong_type) {
-    VLOG(1) << "cv::Mat Resource at: " << file_path << " has wrong image type!";
+  int read_mode, image_type;
+  getImageReadModeAndType(type, &read_mode, &image_type);
+  // The file is read completely before it is decoded, such that the I/O
+  // statistics can tell reading and decoding apart. Depth maps might have
+  // been stored with the depth map codec, which cv::imread can't tell apart.
+  std::ifstream file_stream(file_path, std::ios::binary);
+  const std::string file_content(
+      (std::istreambuf_iterator<char>(file_stream)),
+      std::istreambuf_iterator<char>());
+  if (file_content.empty()) {
+    VLOG(1) << "Resource file is empty! Path: " << file_path;
     return false;
   }
+  {
+    const ResourceIoStatistics::ScopedCodecTimer decode_timer;
+    if (!decodeImage(
+            type, read_mode, file_content.data(), file_content.size(),
+            resource)) {
+      VLOG(1) << "Failed to decode image at: " << file_path;
+      return false;
+    }
+  }
+  return isValidImage(type, image_type, file_path, *resource);
+}
 
-  bool empty_resource = !resource->data || resource->empty();
-  if (empty_resource) {
-    VLOG(1) << "Loading resource of type "
-            << ResourceTypeNames[static_cast<size_t>(type)] << " from "
-            << file_path << " failed!";
-    return false;
+template <>
+bool ResourceLoader::encodeResource<cv::Mat>(
+    const ResourceType& type, const cv::Mat& resource,
+    std::string* encoded_resource) const {
+  CHECK_NOTNULL(encoded_resource);
+  // Same format as the resource files.
+  if (useDepthMapCodec(type)) {
+    encodeDepthMap(resource, encoded_resource);
+    return true;
   }
+  std::vector<unsigned char> buffer;
+  CHECK(cv::imencode(
+      ResourceTypeFileSuffix[static_cast<size_t>(type)], resource, buffer))
+      << "Failed to encode cv::Mat resource of type "
+      << ResourceTypeNames[static_cast<size_t>(type)] << ".";
+  encoded_resource->assign(buffer.begin(), buffer.end());
   return true;
 }
 
+template <>
+bool ResourceLoader::decodeResource<cv::Mat>(
+    const ResourceType& type, const char* data, size_t num_bytes,
+    cv::Mat* resource) const {
+  CHECK_NOTNULL(data);
+  CHECK_NOTNULL(resource);
+  int read_mode, image_type;
+  getImageReadModeAndType(type, &read_mode, &image_type);
+  if (!decodeImage(type, read_mode, data, num_bytes, resource)) {
+    VLOG(1) << "Failed to decode depth map from packed container.";
+    return false;
+  }
+  return isValidImage(type, image_type, "packed container", *resource);
+}
+
 template <>
 void ResourceLoader::saveResourceToFile<std::string>(
     const std::string& file_path, const ResourceType& /*type*/,
@@ -153,7 +607,6 @@ void ResourceLoader::saveResourceToFile<std::string>(
   text_file << resource;
 }
 
-// NOTE: [ADD_RESOURCE_TYPE] Add case if you add a new string resource type.
 template <>
 bool ResourceLoader::loadResourceFromFile<std::string>(
     const std::string& file_path, const ResourceType& type,
@@ -170,24 +623,10 @@ bool ResourceLoader::loadResourceFromFile<std::string>(
     VLOG(1) << "Could not open text resource file " << file_path;
     return false;
   }
+  checkIsTextType(type);
   std::stringstream buffer;
-  switch (type) {
-    case ResourceType::kPmvsReconstructionPath:
-    case ResourceType::kTsdfGridPath:
-    case ResourceType::kEsdfGridPath:
-    case ResourceType::kOccupancyGridPath:
-    // TODO(mfehr): don't read and write path resources to file but store it
-    // in the maps meta data.
-
-    //  Fall through intended.
-    case ResourceType::kText:
-      buffer << infile.rdbuf();
-      *resource = buffer.str();
-      break;
-    default:
-      LOG(FATAL) << "Unknown text resource type: "
-                 << ResourceTypeNames[static_cast<size_t>(type)];
-  }
+  buffer << infile.rdbuf();
+  *resource = buffer.str();
   if (resource->empty()) {
     VLOG(1) << "The std::string resource of type "
             << ResourceTypeNames[static_cast<size_t>(type)]
@@ -197,6 +636,31 @@ bool ResourceLoader::loadResourceFromFile<std::string>(
   return true;
 }
 
+template <>
+bool ResourceLoader::encodeResource<std::string>(
+    const ResourceType& type, const std::string& resource,
+    std::string* encoded_resource) const {
+  checkIsTextType(type);
+  *CHECK_NOTNULL(encoded_resource) = resource;
+  return true;
+}
+
+template <>
+bool ResourceLoader::decodeResource<std::string>(
+    const ResourceType& type, const char* data, size_t num_bytes,
+    std::string* resource) const {
+  CHECK_NOTNULL(data);
+  checkIsTextType(type);
+  CHECK_NOTNULL(resource)->assign(data, num_bytes);
+  if (resource->empty()) {
+    VLOG(1) << "The std::string resource of type "
+            << ResourceTypeNames[static_cast<size_t>(type)]
+            << " in the packed container is empty!";
+    return false;
+  }
+  return true;
+}
+
 template <>
 void ResourceLoader::saveResourceToFile<voxblox::TsdfMap>(
     const std::string& file_path, const ResourceType& /*type*/,
@@ -305,25 +769,20 @@ void ResourceLoader::saveResourceToFile(
   CHECK(filebuf.is_open());
 
   std::ostream output_stream(&filebuf);
-  tinyply::PlyFile ply_file;
-
-  // Const-casting is necessary as tinyply requires non-const access to the
-  // vectors for reading.
-  ply_file.add_properties_to_element(
-      "vertex", {"x", "y", "z"}, const_cast<std::vector<float>&>(resource.xyz));
-  if (!resource.normals.empty()) {
-    ply_file.add_properties_to_element(
-        "vertex", {"nx", "ny", "nz"},
-        const_cast<std::vector<float>&>(resource.normals));
-  }
-  if (!resource.colors.empty()) {
-    ply_file.add_properties_to_element(
-        "vertex", {"red", "green", "blue"},
-        const_cast<std::vector<unsigned char>&>(resource.colors));
+  if (FLAGS_resource_point_cloud_chunk_meters > 0.0) {
+    std::string encoded_resource;
+    {
+      const ResourceIoStatistics::ScopedCodecTimer encode_timer;
+      encodeChunkedPointCloud(
+          resource, FLAGS_resource_point_cloud_chunk_meters,
+          &encoded_resource);
+    }
+    output_stream.write(encoded_resource.data(), encoded_resource.size());
+  } else {
+    writePointCloud(resource, &output_stream);
   }
-
-  ply_file.comments.push_back("generated by tinyply from maplab");
-  ply_file.write(output_stream, true);
+  CHECK(output_stream.good())
+      << "Failed to store point cloud to " << file_path << ".";
   filebuf.close();
 }
 
@@ -337,37 +796,101 @@ bool ResourceLoader::loadResourceFromFile(
     return false;
   }
 
+  common::MemoryMappedFile file;
+  if (!file.open(file_path)) {
+    return false;
+  }
+  if (isEncodedChunkedPointCloud(file.data(), file.size())) {
+    decodePointCloud(file.data(), file.size(), resource);
+    return true;
+  }
+
   std::ifstream stream_ply(file_path);
   if (stream_ply.is_open()) {
-    tinyply::PlyFile ply_file(stream_ply);
-    const int xyz_point_count = ply_file.request_properties_from_element(
-        "vertex", {"x", "y", "z"}, resource->xyz);
-    const int colors_count = ply_file.request_properties_from_element(
-        "vertex", {"nx", "ny", "nz"}, resource->normals);
-    const int normals_count = ply_file.request_properties_from_element(
-        "vertex", {"red", "green", "blue"}, resource->colors);
-    if (xyz_point_count > 0) {
-      if (colors_count > 0) {
-        // If colors are present, their count should match the point count.
-        CHECK_EQ(xyz_point_count, colors_count);
-      }
-      if (normals_count > 0) {
-        // If normals are present, their count should match the point count.
-        CHECK_EQ(xyz_point_count, normals_count);
-      }
-
-      ply_file.read(stream_ply);
-    }
+    readPointCloud(&stream_ply, resource);
     stream_ply.close();
     return true;
   }
   return false;
 }
 
-const CacheStatistic& ResourceLoader::getCacheStatistic() const {
+template <>
+bool ResourceLoader::encodeResource(
+    const ResourceType& /*type*/, const resources::PointCloud& resource,
+    std::string* encoded_resource) const {
+  CHECK_NOTNULL(encoded_resource);
+  if (FLAGS_resource_point_cloud_chunk_meters > 0.0) {
+    encodeChunkedPointCloud(
+        resource, FLAGS_resource_point_cloud_chunk_meters, encoded_resource);
+    return true;
+  }
+  std::ostringstream output_stream(std::ios::out | std::ios::binary);
+  writePointCloud(resource, &output_stream);
+  *encoded_resource = output_stream.str();
+  return true;
+}
+
+template <>
+bool ResourceLoader::decodeResource(
+    const ResourceType& /*type*/, const char* data, size_t num_bytes,
+    resources::PointCloud* resource) const {
+  CHECK_NOTNULL(data);
+  CHECK_NOTNULL(resource);
+  decodePointCloud(data, num_bytes, resource);
+  return true;
+}
+
+bool ResourceLoader::loadPointCloudRegion(
+    const ResourceId& id, const ResourceType& type, const std::string& folder,
+    const Eigen::AlignedBox3f& region, const double level_of_detail,
+    resources::PointCloud* point_cloud) const {
+  CHECK(!folder.empty());
+  CHECK_NOTNULL(point_cloud);
+  CHECK_GT(level_of_detail, 0.0);
+  CHECK_LE(level_of_detail, 1.0);
+  const PackedResourceContainer::ReadFunction read_region =
+      [&](const char* data, size_t num_bytes) {
+        if (!isEncodedChunkedPointCloud(data, num_bytes)) {
+          resources::PointCloud full_point_cloud;
+          decodePointCloud(data, num_bytes, &full_point_cloud);
+          cropPointCloud(
+              full_point_cloud, region, level_of_detail, point_cloud);
+          return true;
+        }
+        const ChunkedPointCloudReader reader(data, num_bytes);
+        if (!reader.isValid()) {
+          return false;
+        }
+        reader.readPointCloudInRegion(region, level_of_detail, point_cloud);
+        return true;
+      };
+
+  const PackedResourceContainer* container =
+      getPackedContainer(folder, type, false);
+  if (container != nullptr && container->hasResource(id)) {
+    return container->readResource(id, read_region);
+  }
+  std::string file_path;
+  getResourceFilePath(id, type, folder, &file_path);
+  // Mapping the file only reads the pages of the chunks in the region.
+  common::MemoryMappedFile file;
+  if (!common::fileExists(file_path) || !file.open(file_path) ||
+      file.data() == nullptr) {
+    VLOG(1) << "Failed to open point cloud resource file: " << file_path;
+    return false;
+  }
+  return read_region(file.data(), file.size());
+}
+
+CacheStatistic ResourceLoader::getCacheStatistic() const {
   return cache_.getStatistic();
 }
 
+void ResourceLoader::accumulateCacheMemoryUsage(
+    common::MemoryUsage* usage) const {
+  cache_.accumulateMemoryUsage(usage);
+}
+
 const ResourceCache::Config& ResourceLoader::getCacheConfig() const {
   return cache_.getConfig();
 }
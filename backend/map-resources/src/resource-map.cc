@@ -1,12 +1,34 @@
 #include "map-resources/resource-map.h"
 
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include <aslam/common/reader-writer-lock.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <maplab-common/file-system-tools.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/progress-bar.h>
 
+#include "map-resources/resource-folder-manifest.h"
 #include "map-resources/resource_info_map.pb.h"
 #include "map-resources/resource_metadata.pb.h"
 
+DEFINE_uint64(
+    resource_migration_num_threads, 8u,
+    "Number of threads that move or copy resources to another resource "
+    "folder.");
+DEFINE_bool(
+    resource_use_folder_manifests, true,
+    "Check if resource files exist using a manifest of the files in each "
+    "resource folder, which is stored in the folder and only updated for the "
+    "resource types whose folder changed. Disable it on file systems which "
+    "don't update the modification time of folders.");
+
 namespace backend {
 
 ResourceMap::ResourceMap()
@@ -365,33 +387,71 @@ void ResourceMap::migrateAllResourcesToFolder(
     }
   }
 
-  // Loop over all resources in the resource maps and move them to the new
-  // folder if necessary.
+  // Collect the resources that are not in the new folder yet.
+  struct Migration {
+    ResourceId id;
+    ResourceType type;
+    ResourceFolderIndex old_folder_idx;
+  };
+  std::vector<Migration> migrations;
   for (size_t type_idx = 0u; type_idx < kNumResourceTypes; ++type_idx) {
-    ResourceInfoMap& info_map = resource_info_map_.at(type_idx);
-
-    ResourceInfoMap::iterator it = info_map.begin();
-    for (; it != info_map.end(); ++it) {
-      ResourceFolderIndex& folder_idx = it->second.folder_idx;
+    const ResourceInfoMap& info_map = resource_info_map_.at(type_idx);
+    for (const ResourceInfoMap::value_type& id_and_info : info_map) {
+      const ResourceFolderIndex folder_idx = id_and_info.second.folder_idx;
       const bool resource_already_in_target_folder =
           is_known_folder && folder_idx == target_folder_idx;
       if (!resource_already_in_target_folder) {
-        // Find previous folder for this resource.
-        std::string old_folder;
-        getFolderFromIndex(folder_idx, &old_folder);
-        CHECK(common::pathExists(old_folder))
-            << "Cannot migrate resources, previous resource folder doesn't "
-            << "exist (anmore)! Folder: " << old_folder;
-
-        // Move/copy the resource and update the folder index.
-        resource_loader_.migrateResource(
-            it->first, static_cast<ResourceType>(type_idx), old_folder,
-            target_resource_folder, move_resources);
+        migrations.push_back(
+            {id_and_info.first, static_cast<ResourceType>(type_idx),
+             folder_idx});
       }
+    }
+  }
+
+  // Looks the old folders up once and checks that they exist.
+  std::unordered_map<ResourceFolderIndex, std::string> old_folders;
+  for (const Migration& migration : migrations) {
+    if (old_folders.count(migration.old_folder_idx) == 0u) {
+      std::string& old_folder = old_folders[migration.old_folder_idx];
+      getFolderFromIndex(migration.old_folder_idx, &old_folder);
+      CHECK(common::pathExists(old_folder))
+          << "Cannot migrate resources, previous resource folder doesn't "
+          << "exist (anmore)! Folder: " << old_folder;
+    }
+  }
+
+  // Move/copy the resources in parallel, as most of the time is spent waiting
+  // for the disk. Resources that were migrated by an interrupted previous
+  // call are skipped, so calling this again resumes the migration.
+  if (!migrations.empty()) {
+    VLOG(1) << "Migrating " << migrations.size() << " resources on "
+            << FLAGS_resource_migration_num_threads << " threads.";
+    std::mutex progress_mutex;
+    size_t num_migrated_resources = 0u;
+    common::ProgressBar progress_bar(migrations.size());
+    const std::function<void(size_t, size_t)> migrate_resources =
+        [&](size_t begin, size_t end) {
+          for (size_t idx = begin; idx < end; ++idx) {
+            const Migration& migration = migrations[idx];
+            resource_loader_.migrateResource(
+                migration.id, migration.type,
+                old_folders.at(migration.old_folder_idx),
+                target_resource_folder, move_resources);
+          }
+          std::lock_guard<std::mutex> progress_lock(progress_mutex);
+          num_migrated_resources += end - begin;
+          progress_bar.update(num_migrated_resources);
+        };
+    common::ParallelProcessDynamic(
+        migrations.size(), migrate_resources,
+        std::max<size_t>(FLAGS_resource_migration_num_threads, 1u));
+  }
 
-      // If the new folder is the default folder, we need to set the appropriate
-      // folder idx.
-      folder_idx = is_map_folder ? kMapResourceFolder : 0u;
+  // If the new folder is the default folder, we need to set the appropriate
+  // folder idx.
+  for (ResourceInfoMap& info_map : resource_info_map_) {
+    for (ResourceInfoMap::value_type& id_and_info : info_map) {
+      id_and_info.second.folder_idx = is_map_folder ? kMapResourceFolder : 0u;
     }
   }
 
@@ -611,6 +671,19 @@ void ResourceMap::serializeMetaData(metadata::proto::MetaData* metadata) const {
   meta_data_.serialize(metadata);
 }
 
+void ResourceMap::accumulateResourceMemoryUsage(
+    common::MemoryUsage* usage) const {
+  CHECK_NOTNULL(usage);
+  aslam::ScopedReadLock lock(&resource_mutex_);
+  resource_loader_.accumulateCacheMemoryUsage(usage);
+
+  size_t num_index_bytes = common::getHeapBytes(resource_info_map_);
+  for (const ResourceInfoMap& resource_infos : resource_info_map_) {
+    num_index_bytes += common::getHeapBytes(resource_infos);
+  }
+  usage->add(common::MemoryUsage::Category::kIndexStructures, num_index_bytes);
+}
+
 std::string ResourceMap::printCacheStatistics() const {
   aslam::ScopedReadLock lock(&resource_mutex_);
   return resource_loader_.getCacheStatistic().print();
@@ -660,13 +733,93 @@ bool ResourceMap::resourceFileExists(
   }
 }
 
+bool ResourceMap::getResourceFilePath(
+    const ResourceId& id, const ResourceType& type,
+    std::string* file_path) const {
+  CHECK_NOTNULL(file_path);
+  std::string folder;
+  {
+    aslam::ScopedReadLock lock(&resource_mutex_);
+    const ResourceInfoMap& info_map =
+        resource_info_map_[static_cast<size_t>(type)];
+    const ResourceInfoMap::const_iterator it = info_map.find(id);
+    if (it == info_map.cend()) {
+      return false;
+    }
+    getFolderFromIndex(it->second.folder_idx, &folder);
+  }
+  return resource_loader_.getStandaloneResourceFilePath(
+      id, type, folder, file_path);
+}
+
+bool ResourceMap::hasResourceInfo(
+    const ResourceId& id, const ResourceType& type) const {
+  aslam::ScopedReadLock lock(&resource_mutex_);
+  const ResourceInfoMap& info_map =
+      resource_info_map_[static_cast<size_t>(type)];
+  return info_map.count(id) > 0u;
+}
+
+bool ResourceMap::getPointCloudRegion(
+    const ResourceId& id, const ResourceType& type,
+    const Eigen::AlignedBox3f& region, const double level_of_detail,
+    resources::PointCloud* point_cloud) const {
+  CHECK_NOTNULL(point_cloud);
+  std::string folder;
+  {
+    aslam::ScopedReadLock lock(&resource_mutex_);
+    const ResourceInfoMap& info_map =
+        resource_info_map_[static_cast<size_t>(type)];
+    const ResourceInfoMap::const_iterator it = info_map.find(id);
+    if (it == info_map.cend()) {
+      return false;
+    }
+    getFolderFromIndex(it->second.folder_idx, &folder);
+  }
+  CHECK(resource_loader_.loadPointCloudRegion(
+      id, type, folder, region, level_of_detail, point_cloud))
+      << "Failed to load " << ResourceTypeNames[static_cast<size_t>(type)]
+      << " resource with id " << id.hexString() << " from folder: " << folder;
+  return true;
+}
+
+void ResourceMap::stopPrefetchingResources() const {
+  std::lock_guard<std::mutex> lock(prefetcher_mutex_);
+  prefetcher_.reset();
+}
+
+void ResourceMap::notifyResourcePrefetcher(
+    const ResourceId& id, const ResourceType& type) const {
+  std::lock_guard<std::mutex> lock(prefetcher_mutex_);
+  if (prefetcher_) {
+    prefetcher_->notifyConsumed(id, type);
+  }
+}
+
 bool ResourceMap::checkResourceFileSystem() const {
   aslam::ScopedReadLock lock(&resource_mutex_);
+  // Manifests by folder index, created on first use.
+  std::unordered_map<ResourceFolderIndex, ResourceFolderManifest::Ptr>
+      manifests;
   bool all_files_exist = true;
   for (size_t type_idx = 0u; type_idx < kNumResourceTypes; ++type_idx) {
     const ResourceType type = static_cast<ResourceType>(type_idx);
     for (const ResourceInfoMap::value_type& info_entry :
          resource_info_map_.at(type_idx)) {
+      if (FLAGS_resource_use_folder_manifests) {
+        ResourceFolderManifest::Ptr& manifest =
+            manifests[info_entry.second.folder_idx];
+        if (!manifest) {
+          std::string folder;
+          getFolderFromIndex(info_entry.second.folder_idx, &folder);
+          manifest.reset(new ResourceFolderManifest(folder));
+          manifest->update();
+        }
+        if (manifest->hasResource(info_entry.first, type)) {
+          continue;
+        }
+      }
+      // Packed resources and resources the manifest doesn't know about.
       if (!resourceFileExists(info_entry.first, type)) {
         LOG(ERROR) << "Could not find resource " << info_entry.first.hexString()
                    << " of type " << ResourceTypeNames[type_idx];
@@ -788,6 +941,12 @@ void ResourceMap::cleanupResourceFolders() {
     meta_data_.map_resource_folder = new_map_resource_folder;
     meta_data_.external_resource_folders = clean_external_resource_folders;
 
+    // Reclaim the space of deleted and replaced packed resources.
+    resource_loader_.compactPackedContainers(meta_data_.map_resource_folder);
+    for (const std::string& folder : meta_data_.external_resource_folders) {
+      resource_loader_.compactPackedContainers(folder);
+    }
+
     // Adapt resource references.
     // Loop through resource info and adjust folder index.
     for (size_t resource_type = 0u; resource_type < kNumResourceTypes;
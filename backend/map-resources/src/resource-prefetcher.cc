@@ -0,0 +1,125 @@
+#include "map-resources/resource-prefetcher.h"
+
+#include <algorithm>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+DEFINE_uint64(
+    resource_prefetch_window, 20u,
+    "Maximum number of resources loaded ahead of the consumer when "
+    "prefetching resources. Should not exceed the resource cache size.");
+DEFINE_uint64(
+    resource_prefetch_num_threads, 2u,
+    "Number of threads that load the resources when prefetching resources.");
+
+namespace backend {
+
+ResourcePrefetcher::ResourcePrefetcher(
+    const ResourceIdAndTypeList& sequence, const LoadFunction& load_function)
+    : ResourcePrefetcher(
+          sequence, load_function, FLAGS_resource_prefetch_window,
+          FLAGS_resource_prefetch_num_threads) {}
+
+ResourcePrefetcher::ResourcePrefetcher(
+    const ResourceIdAndTypeList& sequence, const LoadFunction& load_function,
+    size_t window_size, size_t num_threads)
+    : sequence_(sequence),
+      load_function_(load_function),
+      window_size_(window_size),
+      next_index_(0u),
+      consumed_index_(0u),
+      num_prefetched_(0u),
+      stop_requested_(false) {
+  CHECK(load_function_);
+  CHECK_GT(window_size_, 0u);
+  CHECK_GT(num_threads, 0u);
+  sequence_indices_.reserve(sequence_.size());
+  for (size_t index = 0u; index < sequence_.size(); ++index) {
+    // Resources that appear more than once are loaded at their first
+    // position.
+    sequence_indices_.emplace(sequence_[index].first, index);
+  }
+
+  num_threads = std::min(num_threads, std::max<size_t>(sequence_.size(), 1u));
+  threads_.reserve(num_threads);
+  for (size_t thread_idx = 0u; thread_idx < num_threads; ++thread_idx) {
+    threads_.emplace_back(&ResourcePrefetcher::workerLoop, this);
+  }
+}
+
+ResourcePrefetcher::~ResourcePrefetcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_requested_ = true;
+  }
+  condition_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+  VLOG(3) << "Prefetched " << num_prefetched_ << " of " << sequence_.size()
+          << " resources.";
+}
+
+void ResourcePrefetcher::notifyConsumed(
+    const ResourceId& id, const ResourceType& type) {
+  const std::unordered_map<ResourceId, size_t>::const_iterator it =
+      sequence_indices_.find(id);
+  if (it == sequence_indices_.end() || sequence_[it->second].second != type) {
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (it->second >= consumed_index_) {
+    consumed_index_ = it->second + 1u;
+    // Resources the consumer skipped aren't needed anymore.
+    next_index_ = std::max(next_index_, consumed_index_);
+    condition_.notify_all();
+  }
+  condition_.wait(
+      lock, [this, &id]() { return ids_being_loaded_.count(id) == 0u; });
+}
+
+size_t ResourcePrefetcher::getNumPrefetched() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_prefetched_;
+}
+
+void ResourcePrefetcher::workerLoop() {
+  while (true) {
+    ResourceIdAndType id_and_type;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this]() {
+        return stop_requested_ ||
+               (next_index_ < sequence_.size() &&
+                next_index_ < consumed_index_ + window_size_);
+      });
+      if (stop_requested_) {
+        return;
+      }
+      id_and_type = sequence_[next_index_];
+      ++next_index_;
+      if (!ids_being_loaded_.insert(id_and_type.first).second) {
+        continue;
+      }
+      ++num_prefetched_;
+    }
+
+    load_function_(id_and_type.first, id_and_type.second);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ids_being_loaded_.erase(id_and_type.first);
+    }
+    condition_.notify_all();
+
+    // All resources have been taken, the other threads finish the rest.
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (next_index_ >= sequence_.size()) {
+      return;
+    }
+  }
+}
+
+}  // namespace backend
@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <Eigen/Geometry>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "map-resources/chunked-point-cloud.h"
+#include "map-resources/resource-typedefs.h"
+
+namespace backend {
+
+class ChunkedPointCloudTest : public ::testing::Test {
+ protected:
+  static constexpr size_t kNumPointsPerAxis = 20u;
+  static constexpr double kPointSpacingMeters = 0.5;
+  static constexpr double kChunkSizeMeters = 2.0;
+
+  virtual void SetUp() {
+    // Grid of points on [0, 10)^3 meters.
+    for (size_t x = 0u; x < kNumPointsPerAxis; ++x) {
+      for (size_t y = 0u; y < kNumPointsPerAxis; ++y) {
+        for (size_t z = 0u; z < kNumPointsPerAxis; ++z) {
+          point_cloud_.xyz.push_back(x * kPointSpacingMeters);
+          point_cloud_.xyz.push_back(y * kPointSpacingMeters);
+          point_cloud_.xyz.push_back(z * kPointSpacingMeters);
+          point_cloud_.normals.push_back(0.f);
+          point_cloud_.normals.push_back(0.f);
+          point_cloud_.normals.push_back(1.f);
+          point_cloud_.colors.push_back(static_cast<unsigned char>(x));
+          point_cloud_.colors.push_back(static_cast<unsigned char>(y));
+          point_cloud_.colors.push_back(static_cast<unsigned char>(z));
+        }
+      }
+    }
+    encodeChunkedPointCloud(point_cloud_, kChunkSizeMeters, &encoded_);
+  }
+
+  // Coordinates, normal and color of every point, sorted.
+  static std::vector<std::vector<float>> getSortedPoints(
+      const resources::PointCloud& point_cloud) {
+    std::vector<std::vector<float>> points(point_cloud.size());
+    for (size_t point_idx = 0u; point_idx < point_cloud.size(); ++point_idx) {
+      for (size_t i = 3u * point_idx; i < 3u * point_idx + 3u; ++i) {
+        points[point_idx].push_back(point_cloud.xyz[i]);
+        points[point_idx].push_back(point_cloud.normals[i]);
+        points[point_idx].push_back(point_cloud.colors[i]);
+      }
+    }
+    std::sort(points.begin(), points.end());
+    return points;
+  }
+
+  resources::PointCloud point_cloud_;
+  std::string encoded_;
+};
+
+constexpr size_t ChunkedPointCloudTest::kNumPointsPerAxis;
+constexpr double ChunkedPointCloudTest::kPointSpacingMeters;
+constexpr double ChunkedPointCloudTest::kChunkSizeMeters;
+
+TEST_F(ChunkedPointCloudTest, ReadFullPointCloud) {
+  ASSERT_TRUE(isEncodedChunkedPointCloud(encoded_.data(), encoded_.size()));
+  const ChunkedPointCloudReader reader(encoded_.data(), encoded_.size());
+  ASSERT_TRUE(reader.isValid());
+  EXPECT_EQ(point_cloud_.size(), reader.getNumPoints());
+  EXPECT_EQ(125u, reader.getNumChunks());
+
+  // The points are reordered, but the clouds are equal as sets.
+  resources::PointCloud decoded_point_cloud;
+  reader.readPointCloud(1.0, &decoded_point_cloud);
+  EXPECT_EQ(
+      getSortedPoints(point_cloud_), getSortedPoints(decoded_point_cloud));
+}
+
+TEST_F(ChunkedPointCloudTest, ReadRegionAndLevelOfDetail) {
+  const ChunkedPointCloudReader reader(encoded_.data(), encoded_.size());
+  ASSERT_TRUE(reader.isValid());
+
+  // Spans parts of several chunks.
+  const Eigen::AlignedBox3f region(
+      Eigen::Vector3f(1.2f, -1.f, 3.f), Eigen::Vector3f(4.2f, 2.9f, 3.1f));
+  resources::PointCloud region_point_cloud;
+  reader.readPointCloudInRegion(region, 1.0, &region_point_cloud);
+  size_t num_expected_points = 0u;
+  for (size_t point_idx = 0u; point_idx < point_cloud_.size(); ++point_idx) {
+    const Eigen::Vector3f point(
+        point_cloud_.xyz[3u * point_idx], point_cloud_.xyz[3u * point_idx + 1u],
+        point_cloud_.xyz[3u * point_idx + 2u]);
+    if (region.contains(point)) {
+      ++num_expected_points;
+    }
+  }
+  ASSERT_GT(num_expected_points, 0u);
+  ASSERT_EQ(num_expected_points, region_point_cloud.size());
+  ASSERT_EQ(region_point_cloud.xyz.size(), region_point_cloud.normals.size());
+  ASSERT_EQ(region_point_cloud.xyz.size(), region_point_cloud.colors.size());
+  for (size_t point_idx = 0u; point_idx < region_point_cloud.size();
+       ++point_idx) {
+    const size_t offset = 3u * point_idx;
+    EXPECT_TRUE(region.contains(Eigen::Vector3f(
+        region_point_cloud.xyz[offset], region_point_cloud.xyz[offset + 1u],
+        region_point_cloud.xyz[offset + 2u])));
+    // The colors are the grid indices of the points.
+    EXPECT_FLOAT_EQ(
+        region_point_cloud.xyz[offset],
+        region_point_cloud.colors[offset] * kPointSpacingMeters);
+  }
+
+  // Every chunk has 4 x 4 x 4 points, an eighth of them are read. These are
+  // spread over the whole chunk.
+  const Eigen::AlignedBox3f chunk(
+      Eigen::Vector3f::Zero(), Eigen::Vector3f::Constant(1.9f));
+  resources::PointCloud coarse_point_cloud;
+  reader.readPointCloudInRegion(chunk, 0.125, &coarse_point_cloud);
+  ASSERT_EQ(8u, coarse_point_cloud.size());
+  Eigen::AlignedBox3f coarse_box;
+  for (size_t point_idx = 0u; point_idx < coarse_point_cloud.size();
+       ++point_idx) {
+    coarse_box.extend(Eigen::Vector3f(
+        coarse_point_cloud.xyz[3u * point_idx],
+        coarse_point_cloud.xyz[3u * point_idx + 1u],
+        coarse_point_cloud.xyz[3u * point_idx + 2u]));
+  }
+  EXPECT_TRUE(coarse_box.sizes().isApprox(Eigen::Vector3f::Constant(1.f)));
+
+  resources::PointCloud all_coarse_point_cloud;
+  reader.readPointCloud(0.125, &all_coarse_point_cloud);
+  EXPECT_EQ(point_cloud_.size() / 8u, all_coarse_point_cloud.size());
+}
+
+TEST_F(ChunkedPointCloudTest, RejectsInvalidData) {
+  EXPECT_FALSE(ChunkedPointCloudReader(encoded_.data(), 16u).isValid());
+  EXPECT_FALSE(
+      ChunkedPointCloudReader(encoded_.data(), encoded_.size() - 1u)
+          .isValid());
+  const std::string ply_header = "ply\nformat binary_little_endian 1.0\n";
+  EXPECT_FALSE(
+      isEncodedChunkedPointCloud(ply_header.data(), ply_header.size()));
+
+  resources::PointCloud empty_point_cloud;
+  encodeChunkedPointCloud(empty_point_cloud, kChunkSizeMeters, &encoded_);
+  const ChunkedPointCloudReader reader(encoded_.data(), encoded_.size());
+  ASSERT_TRUE(reader.isValid());
+  EXPECT_EQ(0u, reader.getNumPoints());
+  reader.readPointCloud(1.0, &empty_point_cloud);
+  EXPECT_TRUE(empty_point_cloud.empty());
+}
+
+}  // namespace backend
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,84 @@
+#include <string>
+
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <opencv2/core.hpp>
+
+#include "map-resources/depth-map-codec.h"
+
+namespace backend {
+
+namespace {
+void expectRoundTrip(const cv::Mat& depth_map, std::string* encoded) {
+  CHECK_NOTNULL(encoded);
+  encodeDepthMap(depth_map, encoded);
+  ASSERT_TRUE(isEncodedDepthMap(encoded->data(), encoded->size()));
+
+  cv::Mat decoded_depth_map;
+  ASSERT_TRUE(
+      decodeDepthMap(encoded->data(), encoded->size(), &decoded_depth_map));
+  ASSERT_EQ(CV_16UC1, decoded_depth_map.type());
+  ASSERT_EQ(depth_map.rows, decoded_depth_map.rows);
+  ASSERT_EQ(depth_map.cols, decoded_depth_map.cols);
+  for (int row = 0; row < depth_map.rows; ++row) {
+    for (int col = 0; col < depth_map.cols; ++col) {
+      ASSERT_EQ(
+          depth_map.at<uint16_t>(row, col),
+          decoded_depth_map.at<uint16_t>(row, col));
+    }
+  }
+}
+}  // namespace
+
+TEST(DepthMapCodecTest, RoundTrip) {
+  constexpr int kRows = 48;
+  constexpr int kCols = 64;
+  cv::Mat depth_map(kRows, kCols, CV_16UC1);
+  for (int row = 0; row < kRows; ++row) {
+    for (int col = 0; col < kCols; ++col) {
+      uint16_t depth = static_cast<uint16_t>(1000 + 3 * row + 5 * col);
+      if (row % 7 == 0) {
+        // Invalid depth.
+        depth = 0u;
+      } else if (col % 11 == 0) {
+        // Jumps that take every residual size.
+        depth = static_cast<uint16_t>((col % 2 == 0) ? 0xffff : 200 * row);
+      }
+      depth_map.at<uint16_t>(row, col) = depth;
+    }
+  }
+
+  std::string encoded;
+  expectRoundTrip(depth_map, &encoded);
+  EXPECT_LT(encoded.size(), depth_map.total() * sizeof(uint16_t));
+}
+
+TEST(DepthMapCodecTest, LongRunsAndEmptyMap) {
+  // Longer than the maximal run.
+  std::string encoded;
+  expectRoundTrip(cv::Mat(200, 300, CV_16UC1, cv::Scalar(0)), &encoded);
+  expectRoundTrip(cv::Mat(200, 300, CV_16UC1, cv::Scalar(4321)), &encoded);
+  expectRoundTrip(cv::Mat(0, 0, CV_16UC1), &encoded);
+}
+
+TEST(DepthMapCodecTest, RejectsInvalidData) {
+  cv::Mat depth_map(10, 10, CV_16UC1, cv::Scalar(0));
+  depth_map.at<uint16_t>(5, 5) = 12345u;
+  std::string encoded;
+  encodeDepthMap(depth_map, &encoded);
+
+  cv::Mat decoded_depth_map;
+  const std::string pgm_header = "P5\n10 10\n65535\n";
+  EXPECT_FALSE(isEncodedDepthMap(pgm_header.data(), pgm_header.size()));
+  EXPECT_FALSE(
+      decodeDepthMap(pgm_header.data(), pgm_header.size(), &decoded_depth_map));
+  EXPECT_FALSE(
+      decodeDepthMap(encoded.data(), encoded.size() - 1u, &decoded_depth_map));
+  encoded.push_back('\0');
+  EXPECT_FALSE(
+      decodeDepthMap(encoded.data(), encoded.size(), &decoded_depth_map));
+}
+
+}  // namespace backend
+
+MAPLAB_UNITTEST_ENTRYPOINT
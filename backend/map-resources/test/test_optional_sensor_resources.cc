@@ -1,6 +1,10 @@
+#include <algorithm>
+#include <vector>
+
 #include <glog/logging.h>
 #include <maplab-common/test/testing-entrypoint.h>
 
+#include "map-resources/optional-sensor-resource-index.h"
 #include "map-resources/optional-sensor-resources.h"
 #include "map-resources/resource-common.h"
 
@@ -166,6 +170,89 @@ TEST_F(OptionalSensorResourcesTest, TestGetClosestResourceId) {
           202, kToleranceLow, &stamped_resource_id_result));
 }
 
+TEST_F(OptionalSensorResourcesTest, TestIndexMatchesClosestResourceId) {
+  const OptionalSensorResourceIndex index(optional_sensor_resource_);
+  ASSERT_EQ(index.size(), optional_sensor_resource_.size());
+
+  for (const int64_t tolerance_ns : {0, 1, 2, 50}) {
+    for (int64_t timestamp_ns = 0; timestamp_ns <= 260; ++timestamp_ns) {
+      backend::StampedResourceId expected;
+      backend::StampedResourceId result;
+      const bool expected_found =
+          optional_sensor_resource_.getClosestResourceId(
+              timestamp_ns, tolerance_ns, &expected);
+      ASSERT_EQ(
+          expected_found,
+          index.getClosestResourceId(timestamp_ns, tolerance_ns, &result));
+      if (expected_found) {
+        EXPECT_EQ(expected.first, result.first);
+        EXPECT_EQ(expected.second, result.second);
+      }
+    }
+  }
+}
+
+TEST_F(OptionalSensorResourcesTest, TestIndexRange) {
+  const OptionalSensorResourceIndex index(optional_sensor_resource_);
+  std::vector<backend::StampedResourceId> stamped_resource_ids;
+
+  index.getResourceIdsInRange(9, 101, &stamped_resource_ids);
+  ASSERT_EQ(stamped_resource_ids.size(), 3u);
+  EXPECT_EQ(stamped_resource_ids[0].second, resource_id_9_);
+  EXPECT_EQ(stamped_resource_ids[1].second, resource_id_100_);
+  EXPECT_EQ(stamped_resource_ids[2].second, resource_id_101_A_);
+
+  index.getResourceIdsInRange(102, 199, &stamped_resource_ids);
+  EXPECT_TRUE(stamped_resource_ids.empty());
+
+  index.getResourceIdsInRange(0, 1000, &stamped_resource_ids);
+  ASSERT_EQ(stamped_resource_ids.size(), 5u);
+  EXPECT_EQ(stamped_resource_ids.front().first, 2);
+  EXPECT_EQ(stamped_resource_ids.back().first, 200);
+}
+
+TEST_F(OptionalSensorResourcesTest, TestIndexAssociation) {
+  const OptionalSensorResourceIndex index(optional_sensor_resource_);
+  constexpr int64_t kToleranceNs = 3;
+
+  std::vector<int64_t> timestamps_ns;
+  for (int64_t timestamp_ns = 0; timestamp_ns <= 260; timestamp_ns += 3) {
+    timestamps_ns.push_back(timestamp_ns);
+  }
+  // Unsorted timestamps with duplicates have to give the same result.
+  std::vector<int64_t> shuffled_timestamps_ns = timestamps_ns;
+  std::reverse(
+      shuffled_timestamps_ns.begin(), shuffled_timestamps_ns.end());
+  shuffled_timestamps_ns.push_back(99);
+  shuffled_timestamps_ns.push_back(99);
+
+  for (const std::vector<int64_t>& query_timestamps_ns :
+       {timestamps_ns, shuffled_timestamps_ns}) {
+    std::vector<size_t> closest_indices;
+    index.associateClosestIndices(
+        query_timestamps_ns, kToleranceNs, &closest_indices);
+    ASSERT_EQ(closest_indices.size(), query_timestamps_ns.size());
+    for (size_t idx = 0u; idx < query_timestamps_ns.size(); ++idx) {
+      EXPECT_EQ(
+          index.getClosestIndex(query_timestamps_ns[idx], kToleranceNs),
+          closest_indices[idx]);
+    }
+  }
+
+  std::vector<size_t> closest_indices;
+  index.associateClosestIndices({150}, kToleranceNs, &closest_indices);
+  ASSERT_EQ(closest_indices.size(), 1u);
+  EXPECT_EQ(closest_indices[0], OptionalSensorResourceIndex::kInvalidIndex);
+
+  const OptionalSensorResourceIndex empty_index;
+  empty_index.associateClosestIndices(
+      timestamps_ns, kToleranceNs, &closest_indices);
+  ASSERT_EQ(closest_indices.size(), timestamps_ns.size());
+  for (const size_t closest_index : closest_indices) {
+    EXPECT_EQ(closest_index, OptionalSensorResourceIndex::kInvalidIndex);
+  }
+}
+
 }  // namespace backend
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,169 @@
+#include <fstream>  // NOLINT
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <maplab-common/file-system-tools.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "map-resources/packed-resource-container.h"
+#include "map-resources/resource-common.h"
+
+namespace backend {
+
+class PackedResourceContainerTest : public ::testing::Test {
+ protected:
+  static constexpr size_t kNumResources = 10u;
+  // Small enough for the resources to span several segments.
+  static constexpr size_t kMaxSegmentBytes = 256u;
+
+  virtual void SetUp() {
+    container_folder_ = "./packed_resource_container_test";
+    common::removePath(container_folder_);
+    ASSERT_TRUE(common::createPath(container_folder_));
+    for (size_t i = 0u; i < kNumResources; ++i) {
+      ResourceId id;
+      common::generateId(&id);
+      ids_.push_back(id);
+      resources_.emplace_back(10u * (i + 1u), static_cast<char>('a' + i));
+    }
+  }
+
+  virtual void TearDown() {
+    common::removePath(container_folder_);
+  }
+
+  PackedResourceContainer::Ptr openContainer() const {
+    return PackedResourceContainer::Ptr(
+        new PackedResourceContainer(container_folder_, kMaxSegmentBytes));
+  }
+
+  void putAllResources(PackedResourceContainer* container) const {
+    CHECK_NOTNULL(container);
+    for (size_t i = 0u; i < kNumResources; ++i) {
+      container->putResource(ids_[i], resources_[i]);
+    }
+  }
+
+  bool readResource(
+      const PackedResourceContainer& container, const ResourceId& id,
+      std::string* resource) const {
+    CHECK_NOTNULL(resource);
+    return container.readResource(
+        id, [resource](const char* data, size_t num_bytes) {
+          resource->assign(data, num_bytes);
+          return true;
+        });
+  }
+
+  void expectResources(
+      const PackedResourceContainer& container,
+      const size_t num_deleted_resources) const {
+    std::string resource;
+    for (size_t i = 0u; i < num_deleted_resources; ++i) {
+      EXPECT_FALSE(container.hasResource(ids_[i]));
+      EXPECT_FALSE(readResource(container, ids_[i], &resource));
+    }
+    for (size_t i = num_deleted_resources; i < kNumResources; ++i) {
+      ASSERT_TRUE(readResource(container, ids_[i], &resource));
+      EXPECT_EQ(resources_[i], resource);
+    }
+    EXPECT_EQ(
+        kNumResources - num_deleted_resources, container.getNumResources());
+  }
+
+  std::string container_folder_;
+  std::vector<ResourceId> ids_;
+  std::vector<std::string> resources_;
+};
+
+constexpr size_t PackedResourceContainerTest::kNumResources;
+constexpr size_t PackedResourceContainerTest::kMaxSegmentBytes;
+
+TEST_F(PackedResourceContainerTest, PutReadAndReopen) {
+  {
+    PackedResourceContainer::Ptr container = openContainer();
+    putAllResources(container.get());
+    expectResources(*container, 0u);
+    EXPECT_GT(container->getNumSegments(), 1u);
+    EXPECT_EQ(0u, container->getNumUnusedBytes());
+  }
+  PackedResourceContainer::Ptr container = openContainer();
+  expectResources(*container, 0u);
+
+  // Appends to the existing segments.
+  ResourceId id;
+  common::generateId(&id);
+  container->putResource(id, "new resource");
+  std::string resource;
+  ASSERT_TRUE(readResource(*container, id, &resource));
+  EXPECT_EQ("new resource", resource);
+}
+
+TEST_F(PackedResourceContainerTest, ReplaceDeleteAndCompact) {
+  constexpr size_t kNumDeletedResources = 3u;
+  {
+    PackedResourceContainer::Ptr container = openContainer();
+    putAllResources(container.get());
+    for (size_t i = 0u; i < kNumDeletedResources; ++i) {
+      EXPECT_TRUE(container->deleteResource(ids_[i]));
+      EXPECT_FALSE(container->deleteResource(ids_[i]));
+    }
+    resources_.back() = "replaced resource";
+    container->putResource(ids_.back(), resources_.back());
+    expectResources(*container, kNumDeletedResources);
+    EXPECT_GT(container->getNumUnusedBytes(), 0u);
+  }
+
+  PackedResourceContainer::Ptr container = openContainer();
+  expectResources(*container, kNumDeletedResources);
+  const size_t num_bytes = container->getNumBytes();
+  const size_t num_unused_bytes = container->getNumUnusedBytes();
+  container->compact();
+  EXPECT_EQ(0u, container->getNumUnusedBytes());
+  EXPECT_LE(container->getNumBytes(), num_bytes - num_unused_bytes);
+  expectResources(*container, kNumDeletedResources);
+
+  container.reset();
+  container = openContainer();
+  expectResources(*container, kNumDeletedResources);
+  EXPECT_EQ(0u, container->getNumUnusedBytes());
+}
+
+TEST_F(PackedResourceContainerTest, IgnoresTruncatedRecord) {
+  size_t num_segments;
+  {
+    PackedResourceContainer::Ptr container = openContainer();
+    putAllResources(container.get());
+    num_segments = container->getNumSegments();
+  }
+  // Appends half a record to the last segment, as a crash while writing
+  // would.
+  ASSERT_GT(num_segments, 0u);
+  const std::string last_segment_file_path =
+      container_folder_ + "/segment_" + std::to_string(num_segments - 1u) +
+      ".pack";
+  ASSERT_TRUE(common::fileExists(last_segment_file_path));
+  {
+    std::ofstream segment_file(
+        last_segment_file_path, std::ios::binary | std::ios::app);
+    segment_file.write("MRPC", 4u);
+  }
+
+  PackedResourceContainer::Ptr container = openContainer();
+  expectResources(*container, 0u);
+  ResourceId id;
+  common::generateId(&id);
+  container->putResource(id, "new resource");
+  EXPECT_EQ(num_segments + 1u, container->getNumSegments());
+
+  container.reset();
+  container = openContainer();
+  std::string resource;
+  ASSERT_TRUE(readResource(*container, id, &resource));
+  EXPECT_EQ("new resource", resource);
+}
+
+}  // namespace backend
+
+MAPLAB_UNITTEST_ENTRYPOINT
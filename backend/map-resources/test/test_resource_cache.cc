@@ -0,0 +1,258 @@
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "map-resources/resource-cache.h"
+#include "map-resources/resource-common.h"
+
+namespace backend {
+
+class ResourceCacheTest : public ::testing::Test {
+ protected:
+  static constexpr size_t kMaxCacheSize = 3u;
+
+  virtual void SetUp() {
+    ids_.resize(kMaxCacheSize + 1u);
+    for (ResourceId& id : ids_) {
+      common::generateId(&id);
+    }
+  }
+
+  ResourceCache::Config getConfig(const ResourceCache::Strategy strategy) {
+    ResourceCache::Config config;
+    config.max_cache_size = kMaxCacheSize;
+    config.strategy = strategy;
+    return config;
+  }
+
+  // Fills the cache with the first kMaxCacheSize resources.
+  void fillCache(ResourceCache* cache) {
+    CHECK_NOTNULL(cache);
+    for (size_t i = 0u; i < kMaxCacheSize; ++i) {
+      cache->putResource<std::string>(
+          ids_[i], ResourceType::kText, ids_[i].hexString());
+    }
+  }
+
+  bool isCached(const size_t index, ResourceCache* cache) {
+    CHECK_NOTNULL(cache);
+    std::string resource;
+    const bool is_cached = cache->getResource<std::string>(
+        ids_[index], ResourceType::kText, &resource);
+    if (is_cached) {
+      EXPECT_EQ(ids_[index].hexString(), resource);
+    }
+    return is_cached;
+  }
+
+  std::vector<ResourceId> ids_;
+};
+
+constexpr size_t ResourceCacheTest::kMaxCacheSize;
+
+TEST_F(ResourceCacheTest, FifoEvictsOldest) {
+  ResourceCache cache(getConfig(ResourceCache::Strategy::kFIFO));
+  fillCache(&cache);
+  EXPECT_TRUE(isCached(0u, &cache));
+
+  cache.putResource<std::string>(
+      ids_[3], ResourceType::kText, ids_[3].hexString());
+  EXPECT_FALSE(isCached(0u, &cache));
+  EXPECT_TRUE(isCached(1u, &cache));
+  EXPECT_TRUE(isCached(3u, &cache));
+  EXPECT_EQ(1u, cache.getStatistic().getNumEvictions(ResourceType::kText));
+  EXPECT_EQ("fifo", cache.getStatistic().strategy);
+}
+
+TEST_F(ResourceCacheTest, LruEvictsLeastRecentlyUsed) {
+  ResourceCache cache(getConfig(ResourceCache::Strategy::kLRU));
+  fillCache(&cache);
+  EXPECT_TRUE(isCached(0u, &cache));
+
+  cache.putResource<std::string>(
+      ids_[3], ResourceType::kText, ids_[3].hexString());
+  EXPECT_TRUE(isCached(0u, &cache));
+  EXPECT_FALSE(isCached(1u, &cache));
+  EXPECT_TRUE(isCached(2u, &cache));
+  EXPECT_TRUE(isCached(3u, &cache));
+}
+
+TEST_F(ResourceCacheTest, LfuEvictsLeastFrequentlyUsed) {
+  ResourceCache cache(getConfig(ResourceCache::Strategy::kLFU));
+  fillCache(&cache);
+  EXPECT_TRUE(isCached(0u, &cache));
+  EXPECT_TRUE(isCached(0u, &cache));
+  EXPECT_TRUE(isCached(2u, &cache));
+  EXPECT_TRUE(isCached(1u, &cache));
+
+  // 1 and 2 have been accessed once, 2 longer ago.
+  cache.putResource<std::string>(
+      ids_[3], ResourceType::kText, ids_[3].hexString());
+  EXPECT_FALSE(isCached(2u, &cache));
+  EXPECT_TRUE(isCached(3u, &cache));
+  EXPECT_TRUE(isCached(0u, &cache));
+  EXPECT_TRUE(isCached(1u, &cache));
+}
+
+TEST_F(ResourceCacheTest, EvictsToMeetTypeQuota) {
+  ResourceCache::Config config = getConfig(ResourceCache::Strategy::kLRU);
+  const std::string resource(100u, 'x');
+  config.max_cache_bytes_per_type[ResourceType::kText] =
+      2u * getResourceMemoryBytes(resource);
+  ResourceCache cache(config);
+
+  for (size_t i = 0u; i < kMaxCacheSize; ++i) {
+    cache.putResource<std::string>(ids_[i], ResourceType::kText, resource);
+  }
+  std::string cached_resource;
+  EXPECT_FALSE(cache.getResource<std::string>(
+      ids_[0], ResourceType::kText, &cached_resource));
+  EXPECT_TRUE(cache.getResource<std::string>(
+      ids_[2], ResourceType::kText, &cached_resource));
+  EXPECT_EQ(2u, cache.getStatistic().cache_size[static_cast<size_t>(
+                    ResourceType::kText)]);
+
+  // Larger than the whole quota, isn't cached and doesn't evict anything.
+  const std::string large_resource(1000u, 'x');
+  cache.putResource<std::string>(
+      ids_[3], ResourceType::kText, large_resource);
+  EXPECT_FALSE(cache.getResource<std::string>(
+      ids_[3], ResourceType::kText, &cached_resource));
+  EXPECT_TRUE(cache.getResource<std::string>(
+      ids_[2], ResourceType::kText, &cached_resource));
+
+  // Other types have no quota.
+  for (size_t i = 0u; i < kMaxCacheSize; ++i) {
+    cache.putResource<std::string>(
+        ids_[i], ResourceType::kPmvsReconstructionPath, resource);
+  }
+  EXPECT_EQ(
+      kMaxCacheSize,
+      cache.getStatistic().cache_size[static_cast<size_t>(
+          ResourceType::kPmvsReconstructionPath)]);
+}
+
+TEST_F(ResourceCacheTest, EvictsAcrossTypesToMeetBudget) {
+  ResourceCache::Config config = getConfig(ResourceCache::Strategy::kLRU);
+  const std::string resource(100u, 'x');
+  const size_t num_resource_bytes = getResourceMemoryBytes(resource);
+  config.max_total_cache_bytes = 3u * num_resource_bytes;
+  ResourceCache cache(config);
+
+  cache.putResource<std::string>(ids_[0], ResourceType::kText, resource);
+  cache.putResource<std::string>(
+      ids_[1], ResourceType::kPmvsReconstructionPath, resource);
+  cache.putResource<std::string>(ids_[2], ResourceType::kText, resource);
+  std::string cached_resource;
+  EXPECT_TRUE(cache.getResource<std::string>(
+      ids_[0], ResourceType::kText, &cached_resource));
+
+  // The least recently used resource of all types is evicted.
+  cache.putResource<std::string>(ids_[3], ResourceType::kText, resource);
+  EXPECT_FALSE(cache.getResource<std::string>(
+      ids_[1], ResourceType::kPmvsReconstructionPath, &cached_resource));
+  EXPECT_EQ(
+      1u, cache.getStatistic().getNumEvictions(
+              ResourceType::kPmvsReconstructionPath));
+  EXPECT_EQ(
+      3u * num_resource_bytes,
+      cache.getStatistic()
+          .cache_bytes[static_cast<size_t>(ResourceType::kText)]);
+}
+
+TEST_F(ResourceCacheTest, ReleasesMemoryForTheMemoryBudget) {
+  ResourceCache cache(getConfig(ResourceCache::Strategy::kFIFO));
+  const std::string resource(100u, 'x');
+  const size_t num_resource_bytes = getResourceMemoryBytes(resource);
+  for (size_t i = 0u; i < kMaxCacheSize; ++i) {
+    cache.putResource<std::string>(ids_[i], ResourceType::kText, resource);
+  }
+  EXPECT_EQ(
+      kMaxCacheSize * num_resource_bytes, cache.getReleasableMemoryBytes());
+
+  // Evicts whole resources, the oldest first.
+  EXPECT_EQ(
+      2u * num_resource_bytes, cache.releaseMemory(num_resource_bytes + 1u));
+  std::string cached_resource;
+  EXPECT_FALSE(cache.getResource<std::string>(
+      ids_[0], ResourceType::kText, &cached_resource));
+  EXPECT_FALSE(cache.getResource<std::string>(
+      ids_[1], ResourceType::kText, &cached_resource));
+  EXPECT_TRUE(cache.getResource<std::string>(
+      ids_[2], ResourceType::kText, &cached_resource));
+  EXPECT_EQ(num_resource_bytes, cache.getReleasableMemoryBytes());
+}
+
+TEST_F(ResourceCacheTest, DeleteAndHitRate) {
+  ResourceCache cache(getConfig(ResourceCache::Strategy::kLFU));
+  fillCache(&cache);
+  EXPECT_TRUE(isCached(1u, &cache));
+  EXPECT_TRUE(cache.deleteResource<std::string>(ids_[1], ResourceType::kText));
+  EXPECT_FALSE(
+      cache.deleteResource<std::string>(ids_[1], ResourceType::kText));
+  EXPECT_FALSE(isCached(1u, &cache));
+  EXPECT_TRUE(isCached(0u, &cache));
+  EXPECT_TRUE(isCached(2u, &cache));
+
+  const CacheStatistic& statistic = cache.getStatistic();
+  EXPECT_EQ(3u, statistic.getNumHits(ResourceType::kText));
+  EXPECT_EQ(1u, statistic.getNumMiss(ResourceType::kText));
+  EXPECT_DOUBLE_EQ(0.75, statistic.getHitRate(ResourceType::kText));
+  EXPECT_DOUBLE_EQ(0.0, statistic.getHitRate(ResourceType::kRawImage));
+}
+
+TEST_F(ResourceCacheTest, ConcurrentAccess) {
+  ResourceCache::Config config = getConfig(ResourceCache::Strategy::kLRU);
+  const std::string resource(100u, 'x');
+  const size_t num_resource_bytes = getResourceMemoryBytes(resource);
+  config.max_total_cache_bytes = 5u * num_resource_bytes;
+  ResourceCache cache(config);
+
+  constexpr size_t kNumThreads = 4u;
+  constexpr size_t kNumResourcesPerThread = 200u;
+  std::vector<ResourceId> ids(kNumResourcesPerThread);
+  for (ResourceId& id : ids) {
+    common::generateId(&id);
+  }
+
+  // All threads put and get the same resources, with different types.
+  std::vector<std::thread> threads;
+  for (size_t thread_idx = 0u; thread_idx < kNumThreads; ++thread_idx) {
+    const ResourceType type = (thread_idx % 2u == 0u)
+                                  ? ResourceType::kText
+                                  : ResourceType::kPmvsReconstructionPath;
+    threads.emplace_back([&cache, &ids, &resource, type]() {
+      std::string cached_resource;
+      for (const ResourceId& id : ids) {
+        if (!cache.getResource<std::string>(id, type, &cached_resource)) {
+          cache.tryPutResource<std::string>(id, type, resource);
+        } else {
+          EXPECT_EQ(resource, cached_resource);
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  const CacheStatistic statistic = cache.getStatistic();
+  size_t num_cached_bytes = 0u;
+  for (const ResourceType type :
+       {ResourceType::kText, ResourceType::kPmvsReconstructionPath}) {
+    const size_t type_idx = static_cast<size_t>(type);
+    EXPECT_LE(statistic.cache_size[type_idx], kMaxCacheSize);
+    EXPECT_EQ(
+        kNumThreads / 2u * kNumResourcesPerThread,
+        statistic.getNumHits(type) + statistic.getNumMiss(type));
+    num_cached_bytes += statistic.cache_bytes[type_idx];
+  }
+  EXPECT_LE(num_cached_bytes, config.max_total_cache_bytes);
+}
+
+}  // namespace backend
+
+MAPLAB_UNITTEST_ENTRYPOINT
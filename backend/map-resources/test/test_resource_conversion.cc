@@ -127,6 +127,28 @@ TEST_F(ResourceConversionTest, TestVoxbloxWithRgbImageConversion) {
   EXPECT_EQ(colors.size(), kNumValidDepthEntries);
 }
 
+TEST_F(ResourceConversionTest, TestBackProjectionTableConversion) {
+  DepthMapBackProjectionTable table;
+  computeDepthMapBackProjectionTable(
+      *camera_with_distortion_, depth_map_openni_.cols, depth_map_openni_.rows,
+      &table);
+
+  resources::PointCloud point_cloud;
+  EXPECT_TRUE(
+      convertDepthMapToPointCloud(
+          depth_map_openni_, fake_rgb_, table, &point_cloud));
+  resources::PointCloud point_cloud_camera;
+  EXPECT_TRUE(
+      convertDepthMapToPointCloud(
+          depth_map_openni_, fake_rgb_, *camera_with_distortion_,
+          &point_cloud_camera));
+
+  // The table holds the same bearing vectors as the camera model.
+  ASSERT_EQ(point_cloud.size(), point_cloud_camera.size());
+  EXPECT_EQ(point_cloud.xyz, point_cloud_camera.xyz);
+  EXPECT_EQ(point_cloud.colors, point_cloud_camera.colors);
+}
+
 }  // namespace backend
 
 MAPLAB_UNITTEST_ENTRYPOINT
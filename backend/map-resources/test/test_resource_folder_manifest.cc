@@ -0,0 +1,121 @@
+#include <sys/time.h>
+
+#include <ctime>
+#include <fstream>  // NOLINT
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <maplab-common/file-system-tools.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "map-resources/resource-common.h"
+#include "map-resources/resource-folder-manifest.h"
+
+namespace backend {
+
+class ResourceFolderManifestTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    resource_folder_ = "./resource_folder_manifest_test";
+    common::removePath(resource_folder_);
+    ASSERT_TRUE(common::createPath(resource_folder_));
+  }
+
+  virtual void TearDown() {
+    common::removePath(resource_folder_);
+  }
+
+  std::string getTypeFolder(const ResourceType& type) const {
+    return resource_folder_ + "/" +
+           ResourceTypeNames[static_cast<size_t>(type)];
+  }
+
+  ResourceId addResourceFile(const ResourceType& type) const {
+    ResourceId id;
+    common::generateId(&id);
+    CHECK(common::createPath(getTypeFolder(type)));
+    std::ofstream file(
+        getTypeFolder(type) + "/" + id.hexString() +
+        ResourceTypeFileSuffix[static_cast<size_t>(type)]);
+    file << "resource";
+    return id;
+  }
+
+  // Moves the modification time of the type folder to the past, so the scan
+  // happens in a later second and the manifest trusts it afterwards.
+  void ageTypeFolder(const ResourceType& type, const time_t seconds) const {
+    const time_t past = std::time(nullptr) - seconds;
+    const struct timeval times[2] = {{past, 0}, {past, 0}};
+    CHECK_EQ(0, utimes(getTypeFolder(type).c_str(), times));
+  }
+
+  std::string resource_folder_;
+};
+
+TEST_F(ResourceFolderManifestTest, UpdatesIncrementally) {
+  std::vector<ResourceId> image_ids;
+  for (size_t i = 0u; i < 3u; ++i) {
+    image_ids.push_back(addResourceFile(ResourceType::kRawImage));
+  }
+  const ResourceId text_id = addResourceFile(ResourceType::kText);
+  // Not a resource file.
+  std::ofstream(getTypeFolder(ResourceType::kText) + "/notes.txt") << "notes";
+  ageTypeFolder(ResourceType::kRawImage, 200);
+  ageTypeFolder(ResourceType::kText, 200);
+
+  {
+    ResourceFolderManifest manifest(resource_folder_);
+    manifest.update();
+    EXPECT_EQ(kNumResourceTypes, manifest.getNumRescannedTypeFolders());
+    EXPECT_EQ(4u, manifest.getNumResources());
+    for (const ResourceId& id : image_ids) {
+      EXPECT_TRUE(manifest.hasResource(id, ResourceType::kRawImage));
+      EXPECT_FALSE(manifest.hasResource(id, ResourceType::kText));
+    }
+    ResourceFolderManifest::ResourceFileInfo info;
+    ASSERT_TRUE(
+        manifest.getResourceFileInfo(text_id, ResourceType::kText, &info));
+    EXPECT_EQ(8u, info.num_bytes);
+  }
+
+  // Nothing changed, the saved manifest is used as it is.
+  {
+    ResourceFolderManifest manifest(resource_folder_);
+    manifest.update();
+    EXPECT_EQ(0u, manifest.getNumRescannedTypeFolders());
+    EXPECT_EQ(4u, manifest.getNumResources());
+    EXPECT_TRUE(manifest.hasResource(text_id, ResourceType::kText));
+  }
+
+  // Only the changed type folder is rescanned.
+  const ResourceId new_image_id = addResourceFile(ResourceType::kRawImage);
+  ASSERT_TRUE(common::deleteFile(
+      getTypeFolder(ResourceType::kRawImage) + "/" +
+      image_ids.front().hexString() +
+      ResourceTypeFileSuffix[static_cast<size_t>(ResourceType::kRawImage)]));
+  ageTypeFolder(ResourceType::kRawImage, 100);
+  ResourceFolderManifest manifest(resource_folder_);
+  manifest.update();
+  EXPECT_EQ(1u, manifest.getNumRescannedTypeFolders());
+  EXPECT_EQ(4u, manifest.getNumResources());
+  EXPECT_TRUE(manifest.hasResource(new_image_id, ResourceType::kRawImage));
+  EXPECT_FALSE(
+      manifest.hasResource(image_ids.front(), ResourceType::kRawImage));
+  EXPECT_TRUE(manifest.hasResource(text_id, ResourceType::kText));
+}
+
+TEST_F(ResourceFolderManifestTest, IgnoresCorruptManifest) {
+  const ResourceId id = addResourceFile(ResourceType::kRawImage);
+  std::ofstream(resource_folder_ + "/" +
+                ResourceFolderManifest::kManifestFileName)
+      << "maplab_resource_manifest 1\nfolder garbage\n";
+  ResourceFolderManifest manifest(resource_folder_);
+  manifest.update();
+  EXPECT_EQ(kNumResourceTypes, manifest.getNumRescannedTypeFolders());
+  EXPECT_TRUE(manifest.hasResource(id, ResourceType::kRawImage));
+}
+
+}  // namespace backend
+
+MAPLAB_UNITTEST_ENTRYPOINT
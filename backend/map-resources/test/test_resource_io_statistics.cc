@@ -0,0 +1,113 @@
+#include <string>
+
+#include <gtest/gtest.h>
+#include <maplab-common/file-system-tools.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "map-resources/resource-common.h"
+#include "map-resources/resource-io-statistics.h"
+#include "map-resources/resource-loader.h"
+
+namespace backend {
+
+class ResourceIoStatisticsTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    resource_folder_ = "./resource_io_statistics_test";
+    common::removePath(resource_folder_);
+    ASSERT_TRUE(common::createPath(resource_folder_));
+    ResourceIoStatistics::reset();
+  }
+
+  virtual void TearDown() {
+    common::removePath(resource_folder_);
+  }
+
+  std::string resource_folder_;
+};
+
+TEST_F(ResourceIoStatisticsTest, RecordsLoadsAndStores) {
+  ResourceIoStatistics::recordLoad(ResourceType::kRawImage, 100u, 500, 2000);
+  ResourceIoStatistics::recordLoad(
+      ResourceType::kRawImage, 300u, 3000000, 1000);
+  ResourceIoStatistics::recordStore(ResourceType::kText, 10u, 700, 0);
+
+  const ResourceIoStatistic statistic = ResourceIoStatistics::getStatistic();
+  EXPECT_FALSE(statistic.empty());
+  const size_t image_idx = static_cast<size_t>(ResourceType::kRawImage);
+  const size_t text_idx = static_cast<size_t>(ResourceType::kText);
+  EXPECT_EQ(2u, statistic.num_loads[image_idx]);
+  EXPECT_EQ(400u, statistic.bytes_loaded[image_idx]);
+  EXPECT_EQ(3000500, statistic.read_ns[image_idx]);
+  EXPECT_EQ(3000, statistic.decode_ns[image_idx]);
+  EXPECT_EQ(0u, statistic.num_stores[image_idx]);
+  EXPECT_EQ(1u, statistic.num_stores[text_idx]);
+  EXPECT_EQ(10u, statistic.bytes_stored[text_idx]);
+  EXPECT_EQ(700, statistic.write_ns[text_idx]);
+
+  // 0.5 us lands in the first bucket, 3000 us in [2048, 4096) us.
+  EXPECT_EQ(
+      1.0, statistic.getReadLatencyQuantileMicroseconds(
+               ResourceType::kRawImage, 0.5));
+  EXPECT_EQ(
+      4096.0, statistic.getReadLatencyQuantileMicroseconds(
+                  ResourceType::kRawImage, 0.99));
+  EXPECT_EQ(
+      0.0, statistic.getReadLatencyQuantileMicroseconds(
+               ResourceType::kText, 0.5));
+
+  const std::string printed = statistic.print();
+  EXPECT_NE(std::string::npos, printed.find(ResourceTypeNames[image_idx]));
+  EXPECT_EQ(
+      std::string::npos,
+      printed.find(ResourceTypeNames[static_cast<size_t>(
+          ResourceType::kPointCloudXYZ)]));
+
+  ResourceIoStatistics::reset();
+  EXPECT_TRUE(ResourceIoStatistics::getStatistic().empty());
+}
+
+TEST_F(ResourceIoStatisticsTest, DifferenceContainsOnlyLaterOperations) {
+  ResourceIoStatistics::recordLoad(ResourceType::kRawImage, 100u, 500, 2000);
+  const ResourceIoStatistic before = ResourceIoStatistics::getStatistic();
+  EXPECT_TRUE(before.getDifference(before).empty());
+
+  ResourceIoStatistics::recordLoad(ResourceType::kRawImage, 50u, 100, 200);
+  const ResourceIoStatistic difference =
+      ResourceIoStatistics::getStatistic().getDifference(before);
+  const size_t image_idx = static_cast<size_t>(ResourceType::kRawImage);
+  EXPECT_EQ(1u, difference.num_loads[image_idx]);
+  EXPECT_EQ(50u, difference.bytes_loaded[image_idx]);
+  EXPECT_EQ(100, difference.read_ns[image_idx]);
+  EXPECT_EQ(200, difference.decode_ns[image_idx]);
+  EXPECT_EQ(
+      1.0, difference.getReadLatencyQuantileMicroseconds(
+               ResourceType::kRawImage, 1.0));
+}
+
+TEST_F(ResourceIoStatisticsTest, ResourceLoaderRecordsFileOperations) {
+  const std::string kText = "resource io statistics";
+  ResourceId id;
+  common::generateId(&id);
+
+  ResourceLoader loader;
+  loader.addResource<std::string>(
+      id, ResourceType::kText, resource_folder_, kText);
+  std::string loaded_text;
+  ASSERT_TRUE(loader.loadResource<std::string>(
+      id, ResourceType::kText, resource_folder_, &loaded_text));
+  EXPECT_EQ(kText, loaded_text);
+
+  const ResourceIoStatistic statistic = ResourceIoStatistics::getStatistic();
+  const size_t text_idx = static_cast<size_t>(ResourceType::kText);
+  EXPECT_EQ(1u, statistic.num_stores[text_idx]);
+  EXPECT_EQ(1u, statistic.num_loads[text_idx]);
+  EXPECT_GE(statistic.bytes_stored[text_idx], kText.size());
+  EXPECT_EQ(
+      statistic.bytes_stored[text_idx], statistic.bytes_loaded[text_idx]);
+  EXPECT_GT(statistic.read_ns[text_idx], 0);
+}
+
+}  // namespace backend
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -1,3 +1,5 @@
+#include <Eigen/Geometry>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <maplab-common/file-system-tools.h>
 #include <maplab-common/test/testing-entrypoint.h>
@@ -7,6 +9,9 @@
 #include "map-resources/resource-loader.h"
 #include "map-resources/test/resources-test.h"
 
+DECLARE_bool(resource_migration_use_hardlinks);
+DECLARE_double(resource_point_cloud_chunk_meters);
+
 namespace backend {
 
 class ResourceLoaderTest : public ResourceTest {
@@ -1080,6 +1085,135 @@ TEST_F(ResourceLoaderTest, TestResourceCache) {
       2u + max_num_cache_entries_per_type + 2u);
 }
 
+TEST_F(ResourceLoaderTest, TestPackedContainers) {
+  FLAGS_resource_use_packed_containers = true;
+  constexpr bool kIsMapFolder = true;
+  createResourceTemplates(
+      "TestPackedContainers", kTestMapFolderA, kIsMapFolder, &templates_);
+  {
+    ResourceLoader loader;
+    addTemplatesToResourceLoader(&loader, &templates_);
+    getAndCheckTemplatesFromResourceLoader(&loader, &templates_);
+  }
+  // Reopens the containers, nothing is cached.
+  ResourceLoader loader;
+  getAndCheckTemplatesFromResourceLoader(&loader, &templates_);
+
+  const std::string resource_folder =
+      kTestDataBaseFolder + "/TestPackedContainers/" + kTestExternalFolderX;
+  ResourceId resource_id;
+  common::generateId(&resource_id);
+  loader.addResource<std::string>(
+      resource_id, ResourceType::kText, resource_folder, "packed text");
+  std::string file_path;
+  loader.getResourceFilePath(
+      resource_id, ResourceType::kText, resource_folder, &file_path);
+  EXPECT_FALSE(common::fileExists(file_path));
+  EXPECT_TRUE(loader.resourceFileExists(
+      resource_id, ResourceType::kText, resource_folder));
+
+  // Replacing leaves a superseded record that compacting removes.
+  loader.replaceResource<std::string>(
+      resource_id, ResourceType::kText, resource_folder, "replaced text");
+  loader.compactPackedContainers(resource_folder);
+  std::string text;
+  EXPECT_TRUE(loader.loadResource<std::string>(
+      resource_id, ResourceType::kText, resource_folder, &text));
+  EXPECT_EQ("replaced text", text);
+
+  loader.deleteResource<std::string>(
+      resource_id, ResourceType::kText, resource_folder);
+  EXPECT_FALSE(loader.resourceFileExists(
+      resource_id, ResourceType::kText, resource_folder));
+  FLAGS_resource_use_packed_containers = false;
+}
+
+TEST_F(ResourceLoaderTest, TestMigrateResourceResume) {
+  const std::string folder_a =
+      kTestDataBaseFolder + "/TestMigrateResourceResume/" +
+      kTestExternalFolderX;
+  const std::string folder_b =
+      kTestDataBaseFolder + "/TestMigrateResourceResume/" +
+      kTestExternalFolderY;
+  ResourceLoader loader;
+  ResourceId resource_id;
+  common::generateId(&resource_id);
+  loader.addResource<std::string>(
+      resource_id, ResourceType::kText, folder_a, "migrated text");
+
+  // Copies with a hardlink, then resumes the move after the copy.
+  FLAGS_resource_migration_use_hardlinks = true;
+  loader.migrateResource(
+      resource_id, ResourceType::kText, folder_a, folder_b,
+      false /*move_resource*/);
+  FLAGS_resource_migration_use_hardlinks = false;
+  EXPECT_TRUE(
+      loader.resourceFileExists(resource_id, ResourceType::kText, folder_a));
+  loader.migrateResource(
+      resource_id, ResourceType::kText, folder_a, folder_b,
+      true /*move_resource*/);
+  EXPECT_FALSE(
+      loader.resourceFileExists(resource_id, ResourceType::kText, folder_a));
+
+  std::string text;
+  ASSERT_TRUE(loader.loadResource<std::string>(
+      resource_id, ResourceType::kText, folder_b, &text));
+  EXPECT_EQ("migrated text", text);
+
+  // Moves it back by renaming.
+  loader.migrateResource(
+      resource_id, ResourceType::kText, folder_b, folder_a,
+      true /*move_resource*/);
+  EXPECT_FALSE(
+      loader.resourceFileExists(resource_id, ResourceType::kText, folder_b));
+  ASSERT_TRUE(loader.loadResource<std::string>(
+      resource_id, ResourceType::kText, folder_a, &text));
+  EXPECT_EQ("migrated text", text);
+}
+
+TEST_F(ResourceLoaderTest, TestPointCloudRegion) {
+  const std::string resource_folder =
+      kTestDataBaseFolder + "/TestPointCloudRegion/" + kTestExternalFolderX;
+  // Points along the x axis from 0 to 9.9 meters.
+  resources::PointCloud point_cloud;
+  for (size_t point_idx = 0u; point_idx < 100u; ++point_idx) {
+    point_cloud.xyz.push_back(0.1f * point_idx);
+    point_cloud.xyz.push_back(0.f);
+    point_cloud.xyz.push_back(0.f);
+  }
+  const Eigen::AlignedBox3f region(
+      Eigen::Vector3f(1.95f, -1.f, -1.f), Eigen::Vector3f(4.05f, 1.f, 1.f));
+
+  ResourceLoader loader;
+  // Once stored as PLY and once chunked.
+  for (const double chunk_size_meters : {0.0, 1.0}) {
+    FLAGS_resource_point_cloud_chunk_meters = chunk_size_meters;
+    ResourceId resource_id;
+    common::generateId(&resource_id);
+    loader.addResource<resources::PointCloud>(
+        resource_id, ResourceType::kPointCloudXYZ, resource_folder,
+        point_cloud);
+
+    resources::PointCloud loaded_point_cloud;
+    ASSERT_TRUE(loader.loadResource<resources::PointCloud>(
+        resource_id, ResourceType::kPointCloudXYZ, resource_folder,
+        &loaded_point_cloud));
+    EXPECT_EQ(point_cloud.size(), loaded_point_cloud.size());
+
+    resources::PointCloud region_point_cloud;
+    ASSERT_TRUE(loader.loadPointCloudRegion(
+        resource_id, ResourceType::kPointCloudXYZ, resource_folder, region,
+        1.0, &region_point_cloud));
+    EXPECT_EQ(21u, region_point_cloud.size());
+    ASSERT_TRUE(loader.loadPointCloudRegion(
+        resource_id, ResourceType::kPointCloudXYZ, resource_folder, region,
+        0.5, &region_point_cloud));
+    EXPECT_GE(region_point_cloud.size(), 10u);
+    EXPECT_LE(region_point_cloud.size(), 12u);
+  }
+  FLAGS_resource_point_cloud_chunk_meters = 0.0;
+}
+
 }  // namespace backend
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -1,3 +1,6 @@
+#include <string>
+#include <vector>
+
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <maplab-common/file-system-tools.h>
@@ -424,6 +427,21 @@ class ResourceMapTest : public ResourceTest {
     map.printResourceStatisticsToLog(1);
   }
 
+  // Access to the protected resource functions of the map.
+  void addTextToMap(
+      const std::string& text, ResourceMap* map, ResourceId* id) const {
+    CHECK_NOTNULL(map)->addResource<std::string>(ResourceType::kText, text, id);
+  }
+  bool getTextFromMap(
+      const ResourceId& id, const ResourceMap& map, std::string* text) const {
+    return map.getResource<std::string>(id, ResourceType::kText, text);
+  }
+  bool getTextsFromMap(
+      const std::vector<ResourceId>& ids, const ResourceMap& map,
+      std::vector<std::string>* texts) const {
+    return map.getResources<std::string>(ids, ResourceType::kText, texts);
+  }
+
   static constexpr bool kIsExternalFolder = false;
   static constexpr bool kIsMapFolder = true;
 
@@ -1322,6 +1340,58 @@ TEST_F(ResourceMapTest, TestResourceInfoSerializationSplit) {
   }
 }
 
+TEST_F(ResourceMapTest, TestResourceMapGetResources) {
+  ResourceMap map(test_result_folder_ + kTestMapFolderA);
+
+  constexpr size_t kNumResources = 10u;
+  std::vector<ResourceId> ids(kNumResources);
+  std::vector<std::string> texts;
+  for (size_t idx = 0u; idx < kNumResources; ++idx) {
+    texts.push_back("text_" + std::to_string(idx));
+    addTextToMap(texts[idx], &map, &ids[idx]);
+  }
+
+  // One of the resources is cached already.
+  std::string cached_text;
+  ASSERT_TRUE(getTextFromMap(ids[3], map, &cached_text));
+  ResourceId unknown_id;
+  common::generateId(&unknown_id);
+  ids.push_back(unknown_id);
+
+  std::vector<std::string> resources;
+  EXPECT_FALSE(getTextsFromMap(ids, map, &resources));
+  ASSERT_EQ(ids.size(), resources.size());
+  for (size_t idx = 0u; idx < kNumResources; ++idx) {
+    EXPECT_EQ(texts[idx], resources[idx]);
+  }
+  EXPECT_TRUE(resources.back().empty());
+  EXPECT_EQ(1u, map.getNumResourceCacheHits(ResourceType::kText));
+  EXPECT_EQ(kNumResources, map.getNumResourceCacheMiss(ResourceType::kText));
+
+  // The loaded resources have been cached.
+  ids.pop_back();
+  EXPECT_TRUE(getTextsFromMap(ids, map, &resources));
+  ASSERT_EQ(kNumResources, resources.size());
+  EXPECT_EQ(texts, resources);
+  EXPECT_EQ(
+      kNumResources + 1u, map.getNumResourceCacheHits(ResourceType::kText));
+}
+
+TEST_F(ResourceMapTest, TestResourceMapGetResourceFilePath) {
+  ResourceMap map(test_result_folder_ + kTestMapFolderA);
+
+  ResourceId id;
+  addTextToMap("text", &map, &id);
+  std::string file_path;
+  ASSERT_TRUE(map.getResourceFilePath(id, ResourceType::kText, &file_path));
+  EXPECT_TRUE(common::fileExists(file_path));
+
+  ResourceId unknown_id;
+  common::generateId(&unknown_id);
+  EXPECT_FALSE(
+      map.getResourceFilePath(unknown_id, ResourceType::kText, &file_path));
+}
+
 TEST_F(ResourceMapTest, TestResourceInfoSerializationEmpty) {
   ResourceMap map_before(test_result_folder_ + kTestMapFolderA);
 
@@ -0,0 +1,116 @@
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <mutex>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "map-resources/resource-common.h"
+#include "map-resources/resource-prefetcher.h"
+
+namespace backend {
+
+class ResourcePrefetcherTest : public ::testing::Test {
+ protected:
+  static constexpr size_t kNumResources = 10u;
+
+  virtual void SetUp() {
+    for (size_t i = 0u; i < kNumResources; ++i) {
+      ResourceId id;
+      common::generateId(&id);
+      sequence_.emplace_back(id, ResourceType::kRawImage);
+    }
+  }
+
+  ResourcePrefetcher::LoadFunction getLoadFunction() {
+    return [this](const ResourceId& id, const ResourceType& /*type*/) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      loaded_ids_.push_back(id);
+    };
+  }
+
+  size_t getNumLoaded() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return loaded_ids_.size();
+  }
+
+  // Waits for the prefetch threads, which can't be observed directly.
+  void waitForNumLoaded(const size_t num_loaded) {
+    for (size_t i = 0u; i < 1000u && getNumLoaded() < num_loaded; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  ResourceIdAndTypeList sequence_;
+
+  std::mutex mutex_;
+  std::vector<ResourceId> loaded_ids_;
+};
+
+constexpr size_t ResourcePrefetcherTest::kNumResources;
+
+TEST_F(ResourcePrefetcherTest, LoadsInOrderWithinWindow) {
+  constexpr size_t kWindowSize = 3u;
+  constexpr size_t kNumThreads = 1u;
+  ResourcePrefetcher prefetcher(
+      sequence_, getLoadFunction(), kWindowSize, kNumThreads);
+
+  waitForNumLoaded(kWindowSize);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(kWindowSize, getNumLoaded());
+
+  // Consuming moves the window.
+  prefetcher.notifyConsumed(sequence_[0].first, sequence_[0].second);
+  waitForNumLoaded(kWindowSize + 1u);
+  EXPECT_EQ(kWindowSize + 1u, getNumLoaded());
+
+  // Skipping resources moves the window past them.
+  const ResourceIdAndType& last_resource = sequence_.back();
+  prefetcher.notifyConsumed(last_resource.first, last_resource.second);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(kWindowSize + 1u, getNumLoaded());
+  EXPECT_EQ(kWindowSize + 1u, prefetcher.getNumPrefetched());
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0u; i < loaded_ids_.size(); ++i) {
+    EXPECT_EQ(sequence_[i].first, loaded_ids_[i]);
+  }
+}
+
+TEST_F(ResourcePrefetcherTest, IgnoresOtherResources) {
+  ResourcePrefetcher prefetcher(sequence_, getLoadFunction(), 1u, 1u);
+  waitForNumLoaded(1u);
+
+  ResourceId other_id;
+  common::generateId(&other_id);
+  prefetcher.notifyConsumed(other_id, ResourceType::kRawImage);
+  // Same id, but another type.
+  prefetcher.notifyConsumed(sequence_[0].first, ResourceType::kRawDepthMap);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(1u, getNumLoaded());
+}
+
+TEST_F(ResourcePrefetcherTest, ConsumerWaitsForResourceBeingLoaded) {
+  std::atomic<bool> is_loaded(false);
+  std::atomic<bool> is_loading(false);
+  ResourcePrefetcher prefetcher(
+      sequence_,
+      [&is_loaded, &is_loading](
+          const ResourceId& /*id*/, const ResourceType& /*type*/) {
+        is_loading = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        is_loaded = true;
+      },
+      1u, 1u);
+  while (!is_loading) {
+    std::this_thread::yield();
+  }
+  prefetcher.notifyConsumed(sequence_[0].first, sequence_[0].second);
+  EXPECT_TRUE(is_loaded);
+}
+
+}  // namespace backend
+
+MAPLAB_UNITTEST_ENTRYPOINT
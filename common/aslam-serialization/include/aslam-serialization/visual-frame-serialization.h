@@ -1,6 +1,8 @@
 #ifndef ASLAM_SERIALIZATION_VISUAL_FRAME_SERIALIZATION_H_
 #define ASLAM_SERIALIZATION_VISUAL_FRAME_SERIALIZATION_H_
 
+#include <cstdint>
+
 #include <aslam/cameras/camera.h>
 #include <aslam/cameras/ncamera.h>
 #include <aslam/frames/visual-frame.h>
@@ -36,6 +38,10 @@ void deserializeDescriptors(
     const aslam::proto::VisualFrame& proto,
     aslam::VisualFrame::DescriptorsT* descriptors);
 
+// IEEE 754 half precision conversion, rounding to the nearest value.
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t half);
+
 }  // namespace internal
 
 }  // namespace serialization
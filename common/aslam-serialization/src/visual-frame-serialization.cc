@@ -1,5 +1,10 @@
 #include "aslam-serialization/visual-frame-serialization.h"
 
+#include <cmath>
+#include <cstring>
+#include <string>
+
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include <aslam/cameras/camera.h>
@@ -9,9 +14,51 @@
 #include <maplab-common/aslam-id-proto.h>
 #include <maplab-common/eigen-proto.h>
 
+DEFINE_bool(
+    aslam_serialization_compact_keypoints, false,
+    "Serialize the keypoint measurements and sigmas as floats and the "
+    "descriptor scales as half floats, which roughly halves the size of the "
+    "keypoint data. Maps written like this can not be read by older versions.");
+
 namespace aslam {
 namespace serialization {
 
+namespace {
+template <typename Derived>
+void serializeAsFloats(
+    const Eigen::MatrixBase<Derived>& values,
+    google::protobuf::RepeatedField<float>* proto) {
+  CHECK_NOTNULL(proto)->Clear();
+  proto->Reserve(values.size());
+  for (int idx = 0; idx < values.size(); ++idx) {
+    proto->AddAlreadyReserved(static_cast<float>(values.data()[idx]));
+  }
+}
+
+void serializeAsHalfFloats(
+    const Eigen::VectorXd& values, std::string* proto) {
+  CHECK_NOTNULL(proto)->resize(2u * values.size());
+  for (int idx = 0; idx < values.size(); ++idx) {
+    const uint16_t half =
+        internal::floatToHalf(static_cast<float>(values(idx)));
+    (*proto)[2 * idx] = static_cast<char>(half & 0xffu);
+    (*proto)[2 * idx + 1] = static_cast<char>(half >> 8u);
+  }
+}
+
+void deserializeHalfFloats(const std::string& proto, Eigen::VectorXd* values) {
+  CHECK_NOTNULL(values);
+  CHECK_EQ(proto.size() % 2u, 0u);
+  values->resize(proto.size() / 2u);
+  for (int idx = 0; idx < values->rows(); ++idx) {
+    const uint16_t half = static_cast<uint16_t>(
+        static_cast<unsigned char>(proto[2 * idx]) |
+        (static_cast<unsigned char>(proto[2 * idx + 1]) << 8u));
+    (*values)(idx) = internal::halfToFloat(half);
+  }
+}
+}  // namespace
+
 void serializeVisualFrame(
     const aslam::VisualFrame& frame, aslam::proto::VisualFrame* proto) {
   CHECK_NOTNULL(proto);
@@ -20,22 +67,44 @@ void serializeVisualFrame(
   proto->set_timestamp(frame.getTimestampNanoseconds());
 
   if (frame.hasKeypointMeasurements()) {
-    ::common::eigen_proto::serialize(
-        frame.getKeypointMeasurements(),
-        proto->mutable_keypoint_measurements());
-    ::common::eigen_proto::serialize(
-        frame.getKeypointMeasurementUncertainties(),
-        proto->mutable_keypoint_measurement_sigmas());
-    CHECK_EQ(
-        proto->keypoint_measurements_size(),
-        2 * proto->keypoint_measurement_sigmas_size());
-
-    if (frame.hasKeypointScales()) {
+    if (FLAGS_aslam_serialization_compact_keypoints) {
+      serializeAsFloats(
+          frame.getKeypointMeasurements(),
+          proto->mutable_compact_keypoint_measurements());
+      serializeAsFloats(
+          frame.getKeypointMeasurementUncertainties(),
+          proto->mutable_compact_keypoint_measurement_sigmas());
+      CHECK_EQ(
+          proto->compact_keypoint_measurements_size(),
+          2 * proto->compact_keypoint_measurement_sigmas_size());
+
+      if (frame.hasKeypointScales()) {
+        serializeAsHalfFloats(
+            frame.getKeypointScales(),
+            proto->mutable_compact_descriptor_scales());
+        CHECK_EQ(
+            static_cast<size_t>(
+                2 * proto->compact_keypoint_measurement_sigmas_size()),
+            proto->compact_descriptor_scales().size());
+      }
+    } else {
+      ::common::eigen_proto::serialize(
+          frame.getKeypointMeasurements(),
+          proto->mutable_keypoint_measurements());
       ::common::eigen_proto::serialize(
-          frame.getKeypointScales(), proto->mutable_descriptor_scales());
+          frame.getKeypointMeasurementUncertainties(),
+          proto->mutable_keypoint_measurement_sigmas());
       CHECK_EQ(
-          proto->keypoint_measurement_sigmas_size(),
-          proto->descriptor_scales_size());
+          proto->keypoint_measurements_size(),
+          2 * proto->keypoint_measurement_sigmas_size());
+
+      if (frame.hasKeypointScales()) {
+        ::common::eigen_proto::serialize(
+            frame.getKeypointScales(), proto->mutable_descriptor_scales());
+        CHECK_EQ(
+            proto->keypoint_measurement_sigmas_size(),
+            proto->descriptor_scales_size());
+      }
     }
 
     const aslam::VisualFrame::DescriptorsT& descriptors =
@@ -71,27 +140,50 @@ void deserializeVisualFrame(
   ::common::aslam_id_proto::deserialize(proto.id(), &frame_id);
   // If the frame_id is invalid this frame has been un-set.
   if (frame_id.isValid()) {
+    Eigen::Matrix2Xd img_points_distorted;
+    Eigen::VectorXd uncertainties;
+    Eigen::VectorXd scales;
+    const bool is_compact =
+        proto.compact_keypoint_measurements_size() > 0 ||
+        proto.compact_keypoint_measurement_sigmas_size() > 0;
+    if (is_compact) {
+      CHECK_EQ(proto.keypoint_measurements_size(), 0)
+          << "Visual frame with both the compact and the full encoding.";
+      img_points_distorted =
+          Eigen::Map<const Eigen::Matrix2Xf>(
+              proto.compact_keypoint_measurements().data(), 2,
+              proto.compact_keypoint_measurements_size() / 2)
+              .cast<double>();
+      uncertainties = Eigen::Map<const Eigen::VectorXf>(
+                          proto.compact_keypoint_measurement_sigmas().data(),
+                          proto.compact_keypoint_measurement_sigmas_size())
+                          .cast<double>();
+      deserializeHalfFloats(proto.compact_descriptor_scales(), &scales);
+    } else {
+      img_points_distorted = Eigen::Map<const Eigen::Matrix2Xd>(
+          proto.keypoint_measurements().data(), 2,
+          proto.keypoint_measurements_size() / 2);
+      uncertainties = Eigen::Map<const Eigen::VectorXd>(
+          proto.keypoint_measurement_sigmas().data(),
+          proto.keypoint_measurement_sigmas_size());
+      scales = Eigen::Map<const Eigen::VectorXd>(
+          proto.descriptor_scales().data(), proto.descriptor_scales_size());
+    }
+    const int num_measurement_values =
+        is_compact ? proto.compact_keypoint_measurements_size()
+                   : proto.keypoint_measurements_size();
+
     bool success = true;
-    success &=
-        (2 * proto.keypoint_measurement_sigmas_size() ==
-         proto.keypoint_measurements_size());
+    success &= (2 * uncertainties.rows() == num_measurement_values);
     if (proto.keypoint_descriptor_size() != 0) {
       success &=
           (proto.keypoint_descriptors().size() /
                proto.keypoint_descriptor_size() ==
-           static_cast<unsigned int>(proto.keypoint_measurement_sigmas_size()));
+           static_cast<unsigned int>(uncertainties.rows()));
     }
 
     CHECK(success) << "Inconsistent landmark Visual Frame field sizes.";
 
-    Eigen::Map<const Eigen::Matrix2Xd> img_points_distorted(
-        proto.keypoint_measurements().data(), 2,
-        proto.keypoint_measurements_size() / 2);
-    Eigen::Map<const Eigen::VectorXd> uncertainties(
-        proto.keypoint_measurement_sigmas().data(),
-        proto.keypoint_measurement_sigmas_size());
-    Eigen::Map<const Eigen::VectorXd> scales(
-        proto.descriptor_scales().data(), proto.descriptor_scales_size());
     Eigen::Map<const Eigen::VectorXi> track_ids(
         proto.track_ids().data(), proto.track_ids_size());
 
@@ -241,6 +333,60 @@ void deserializeDescriptors(
   }
 }
 
+uint16_t floatToHalf(const float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const uint16_t sign = static_cast<uint16_t>((bits >> 16u) & 0x8000u);
+  const uint32_t float_exponent = (bits >> 23u) & 0xffu;
+  uint32_t mantissa = bits & 0x7fffffu;
+  if (float_exponent == 0xffu) {
+    // Infinity or NaN.
+    return sign | 0x7c00u | (mantissa != 0u ? 0x200u : 0u);
+  }
+  const int exponent = static_cast<int>(float_exponent) - 127 + 15;
+  if (exponent >= 0x1f) {
+    return sign | 0x7c00u;
+  }
+  if (exponent <= 0) {
+    // Subnormal half or zero.
+    if (exponent < -10) {
+      return sign;
+    }
+    mantissa |= 0x800000u;
+    const int shift = 14 - exponent;
+    uint32_t half_mantissa = mantissa >> shift;
+    if ((mantissa >> (shift - 1)) & 1u) {
+      ++half_mantissa;
+    }
+    return sign | static_cast<uint16_t>(half_mantissa);
+  }
+  uint32_t half = (static_cast<uint32_t>(exponent) << 10u) | (mantissa >> 13u);
+  // Rounding may carry into the exponent, which yields the correct result.
+  if (mantissa & 0x1000u) {
+    ++half;
+  }
+  return sign | static_cast<uint16_t>(half);
+}
+
+float halfToFloat(const uint16_t half) {
+  const uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16u;
+  const uint32_t exponent = (half >> 10u) & 0x1fu;
+  const uint32_t mantissa = half & 0x3ffu;
+  if (exponent == 0u) {
+    const float magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+    return sign != 0u ? -magnitude : magnitude;
+  }
+  uint32_t bits;
+  if (exponent == 0x1fu) {
+    bits = sign | 0x7f800000u | (mantissa << 13u);
+  } else {
+    bits = sign | ((exponent - 15u + 127u) << 23u) | (mantissa << 13u);
+  }
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
 }  // namespace internal
 
 }  // namespace serialization
@@ -1,3 +1,7 @@
+#include <cmath>
+
+#include <Eigen/Core>
+#include <gflags/gflags.h>
 #include <maplab-common/test/testing-entrypoint.h>
 
 #include <aslam/cameras/camera-pinhole.h>
@@ -9,6 +13,8 @@
 #include "aslam-serialization/visual-frame-serialization.h"
 #include "aslam-serialization/visual-frame.pb.h"
 
+DECLARE_bool(aslam_serialization_compact_keypoints);
+
 namespace aslam {
 
 TEST(VisualFrameSerialization, SerializeDeserializeFrame) {
@@ -53,6 +59,66 @@ TEST(VisualFrameSerialization, SerializeDeserializeNFrame) {
   EXPECT_EQ(*n_frame, *n_frame_deserialized);
 }
 
+TEST(VisualFrameSerialization, SerializeDeserializeCompactFrame) {
+  const Camera::ConstPtr camera =
+      PinholeCamera::createTestCamera<RadTanDistortion>();
+  constexpr int64_t kTimestampNs = 0;
+  const VisualFrame::Ptr frame =
+      VisualFrame::createEmptyTestVisualFrame(camera, kTimestampNs);
+  constexpr int kNumKeypoints = 100;
+  const Eigen::Matrix2Xd keypoints =
+      (Eigen::Matrix2Xd::Random(2, kNumKeypoints).array() + 1.0) * 320.0;
+  frame->setKeypointMeasurements(keypoints);
+  frame->setKeypointMeasurementUncertainties(
+      Eigen::VectorXd::Constant(kNumKeypoints, 0.8));
+  frame->setKeypointScales(
+      (Eigen::VectorXd::Random(kNumKeypoints).array() + 2.0) * 10.0);
+  frame->setDescriptors(
+      VisualFrame::DescriptorsT::Zero(48, kNumKeypoints));
+
+  FLAGS_aslam_serialization_compact_keypoints = true;
+  proto::VisualFrame frame_proto;
+  serialization::serializeVisualFrame(*frame, &frame_proto);
+  FLAGS_aslam_serialization_compact_keypoints = false;
+  EXPECT_EQ(0, frame_proto.keypoint_measurements_size());
+  EXPECT_EQ(
+      2 * kNumKeypoints, frame_proto.compact_keypoint_measurements_size());
+
+  VisualFrame::Ptr frame_deserialized;
+  serialization::deserializeVisualFrame(
+      frame_proto, camera, &frame_deserialized);
+  ASSERT_TRUE(frame_deserialized != nullptr);
+  EXPECT_EQ(
+      kNumKeypoints,
+      static_cast<int>(frame_deserialized->getNumKeypointMeasurements()));
+
+  // Floats are precise to far below a pixel, half floats keep the scales to
+  // about three significant digits.
+  EXPECT_TRUE(frame_deserialized->getKeypointMeasurements().isApprox(
+      keypoints, 1e-6));
+  EXPECT_TRUE(
+      frame_deserialized->getKeypointMeasurementUncertainties().isApprox(
+          frame->getKeypointMeasurementUncertainties(), 1e-6));
+  EXPECT_TRUE(frame_deserialized->getKeypointScales().isApprox(
+      frame->getKeypointScales(), 1e-3));
+  EXPECT_EQ(frame->getDescriptors(), frame_deserialized->getDescriptors());
+}
+
+TEST(VisualFrameSerialization, HalfFloatConversion) {
+  for (const float value : {0.f, 1.f, -2.5f, 0.125f, 1024.f, 65504.f}) {
+    EXPECT_EQ(
+        value, serialization::internal::halfToFloat(
+                   serialization::internal::floatToHalf(value)));
+  }
+  EXPECT_NEAR(
+      3.3f, serialization::internal::halfToFloat(
+                serialization::internal::floatToHalf(3.3f)),
+      3.3f * 1e-3f);
+  EXPECT_TRUE(std::isinf(
+      serialization::internal::halfToFloat(
+          serialization::internal::floatToHalf(1e6f))));
+}
+
 }  // namespace aslam
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -4,6 +4,7 @@
 #include <functional>
 #include <initializer_list>
 #include <map>
+#include <memory>
 #include <string>
 #include <thread>
 #include <unordered_map>
@@ -28,12 +29,19 @@ class CommandRegisterer {
   CommandRegisterer();
   MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(CommandRegisterer);
 
+  // Commands ending with '&' run as background jobs, as do commands with the
+  // Async processing model. Background jobs can be listed, joined and
+  // cancelled; a SigintBreaker created by the job reports the cancellation.
   int processCommand(const std::string& command);
 
+  static bool isBackgroundCommand(const std::string& command);
+
   void getAllCommands(std::vector<std::string>* all_cmds) const;
 
   void listJobs() const;
   void waitForJobsToFinish() const;
+  bool cancelJob(int job_id) const;
+  bool hasRunningJobs() const;
 
   void clear();
 
@@ -60,15 +68,37 @@ class CommandRegisterer {
   void addCommand(const Command& command);
   const Command& getCommand(const std::string& command_name) const;
 
+  // A placeholder stands in for a command of a plugin that is only loaded once
+  // the command is run. The loader is called before the flags of the command
+  // are parsed and has to add the actual command, which replaces the
+  // placeholder.
+  void addPlaceholderCommand(
+      const Command& command, const std::function<bool()>& loader);
+
+  // The hooks are called with the name of the command before and after every
+  // command that runs in the foreground. Background jobs overlap with other
+  // commands and don't call them.
+  typedef std::function<void(const std::string& command_name)> CommandHook;
+  void addCommandHooks(
+      const CommandHook& before_command, const CommandHook& after_command);
+
  private:
-  void processCommandAsync(const std::string& command);
+  void runCommandHooks(
+      const std::string& command_name, bool before_command) const;
+  void removePlaceholderCommand(size_t command_index);
+  void startJob(
+      const std::function<int()>& function, const std::string& description);
 
   Commands commands_;
 
   typedef std::map<std::string, size_t> CommandIndexMap;
   CommandIndexMap command_map_;
 
+  std::unordered_map<size_t, std::function<bool()> > placeholder_loaders_;
+
   std::unordered_map<int, std::shared_ptr<Job> > jobs_;
+
+  std::vector<std::pair<CommandHook, CommandHook> > command_hooks_;
 };
 }  // namespace common
 #endif  // CONSOLE_COMMON_COMMAND_REGISTERER_H_
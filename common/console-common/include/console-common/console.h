@@ -1,6 +1,7 @@
 #ifndef CONSOLE_COMMON_CONSOLE_H_
 #define CONSOLE_COMMON_CONSOLE_H_
 
+#include <functional>
 #include <list>
 #include <memory>
 #include <set>
@@ -40,12 +41,23 @@ class Console {
   void RunCommandPrompt();
   int RunCommand(const std::string& command);
   void addCommand(const CommandRegisterer::Command& command);
+  // See CommandRegisterer::addCommandHooks.
+  void addCommandHooks(
+      const CommandRegisterer::CommandHook& before_command,
+      const CommandRegisterer::CommandHook& after_command);
   void setConsoleName(const std::string& name);
   void addMapKeyToAutoCompletion(const std::string& map_key);
   void removeMapKeyFromAutoCompletion(const std::string& map_key);
   void addAllGFlagsToCompletion();
 
   void installPlugin(ConsolePluginPtr plugin);
+  // Adds placeholders for the commands of a plugin that isn't loaded yet. The
+  // loader is run once one of the commands is used and has to install the
+  // plugin.
+  void addLazyPlugin(
+      const std::string& plugin_id, const CommandRegisterer::Commands& commands,
+      const std::function<bool()>& loader);
+  // Also contains the plugins that are added lazily.
   void getNamesOfInstalledPlugins(std::vector<std::string>* plugin_names) const;
 
   void setSelectedMapKey(const std::string& selected_map_key);
@@ -58,6 +70,9 @@ class Console {
   // properly closed.
   void uninstallAllPlugins();
 
+  static const CommandRegisterer::Commands& getCommandsOfPlugin(
+      const ConsolePluginBase& plugin);
+
  private:
   class PersistentHistory {
    public:
@@ -111,6 +126,7 @@ class Console {
   AutoCompletion auto_completion_;
 
   std::unordered_set<ConsolePluginPtr> installed_plugins_;
+  std::set<std::string> lazy_plugin_ids_;
 };
 
 }  // namespace common
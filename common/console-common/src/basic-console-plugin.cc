@@ -20,6 +20,7 @@ DEFINE_string(
     "Flag for console commands where another command is to be passed as "
     "argument.");
 DEFINE_string(plugin, "", "Defines the plugin for which to show help.");
+DEFINE_int32(job_id, -1, "Id of the background job to cancel.");
 DEFINE_bool(all, false, "Set to true to display all commands in help.");
 DEFINE_string(
     command_filter, "",
@@ -47,7 +48,9 @@ BasicConsolePlugin::BasicConsolePlugin(
         command_registerer_->listJobs();
         return 0;
       },
-      "List all known jobs.", Processing::Sync);
+      "List all known jobs. Append & to a command to run it as a background "
+      "job.",
+      Processing::Sync);
 
   addCommand(
       {"join"},
@@ -57,6 +60,21 @@ BasicConsolePlugin::BasicConsolePlugin(
       },
       "Wait for all known jobs to complete.", Processing::Sync);
 
+  addCommand(
+      {"kill_job", "kill"},
+      [this]() -> int {
+        const int job_id = FLAGS_job_id;
+        if (job_id < 0) {
+          LOG(ERROR) << "Specify the job to cancel with --job_id.";
+          return kStupidUserError;
+        }
+        return command_registerer_->cancelJob(job_id) ? kSuccess
+                                                       : kStupidUserError;
+      },
+      "Requests the background job given by --job_id to cancel. Only commands "
+      "that check for Ctrl+C stop early.",
+      Processing::Sync);
+
   addCommand(
       {"watch", "w"},
       [this]() -> int {
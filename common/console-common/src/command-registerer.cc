@@ -1,6 +1,7 @@
 #include "console-common/command-registerer.h"
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <exception>
 #include <iostream>  // NOLINT
@@ -14,47 +15,78 @@
 #include <aslam/common/timer.h>
 #include <glog/logging.h>
 #include <maplab-common/accessors.h>
+#include <maplab-common/sigint-breaker.h>
 
 namespace common {
 class Job {
  public:
   Job(const std::function<int()>& function, const std::string& description)
-      : description_(description), running_(false), function_(function) {
+      : description_(description),
+        is_started_(false),
+        is_finished_(false),
+        is_cancel_requested_(false),
+        status_(kSuccess),
+        function_(function) {
     static int id = 0;
     id_ = id++;
     start_time_ = end_time_ = std::chrono::system_clock::now();
   }
+
+  ~Job() {
+    joinThread();
+  }
+
   void startThread() {
     CHECK(function_);
-    running_ = true;
+    CHECK(!is_started_);
+    is_started_ = true;
     std::cout << "Starting job [" << id_ << "] " << description_ << "."
               << std::endl;
+    start_time_ = std::chrono::system_clock::now();
     thread_.reset(new std::thread([this]() {
-      start_time_ = std::chrono::system_clock::now();
-      function_();
+      SigintBreaker::ScopedBreakRequestSource break_request_source(
+          &is_cancel_requested_);
+      int status = kUnknownError;
+      try {
+        status = function_();
+      } catch (const std::exception& e) {  // NOLINT
+        LOG(ERROR) << "Caught exception while processing job [" << id_ << "] "
+                   << description_ << ": " << e.what();
+      }
+      status_ = status;
       end_time_ = std::chrono::system_clock::now();
+      is_finished_ = true;
+      std::cout << "Job [" << id_ << "] " << description_
+                << " finished with status " << status << "." << std::endl;
     }));
   }
 
   void joinThread() {
-    if (running_) {
-      std::cout << "Waiting for job [" << id_ << "] " << description_
-                << " to finish." << std::endl;
-      CHECK(thread_ != nullptr);
+    if (thread_ != nullptr && thread_->joinable()) {
+      if (!is_finished_) {
+        std::cout << "Waiting for job [" << id_ << "] " << description_
+                  << " to finish." << std::endl;
+      }
       thread_->join();
-      running_ = false;
-      end_time_ = std::chrono::system_clock::now();
     }
   }
 
+  // The job only stops early if its command checks a SigintBreaker.
+  void requestCancel() {
+    is_cancel_requested_ = true;
+  }
+
   std::string printInfo() const {
     constexpr double kNumSecondsPerNanosecond = 1e-9;
 
+    // The end time is written by the job thread before it marks the job as
+    // finished.
+    const bool is_finished = is_finished_;
     std::chrono::time_point<std::chrono::system_clock> end;
-    if (running_) {
-      end = std::chrono::system_clock::now();
-    } else {
+    if (is_finished) {
       end = end_time_;
+    } else {
+      end = std::chrono::system_clock::now();
     }
 
     double dt_seconds =
@@ -64,9 +96,16 @@ class Job {
                 .count()) *
         kNumSecondsPerNanosecond;
     std::stringstream ss;
-    ss << "[" << id_ << "] " << description_ << ": "
-       << (running_ ? "Running for " : "Stopped. Took ") << " " << dt_seconds
-       << " secs. " << std::endl;
+    ss << "[" << id_ << "] " << description_ << ": ";
+    if (is_finished) {
+      ss << "Stopped with status " << status_ << ". Took " << dt_seconds
+         << " secs.";
+    } else {
+      ss << (is_cancel_requested_ ? "Cancelling, running for "
+                                  : "Running for ")
+         << dt_seconds << " secs.";
+    }
+    ss << std::endl;
     return ss.str();
   }
 
@@ -74,10 +113,17 @@ class Job {
     return id_;
   }
 
+  bool isRunning() const {
+    return is_started_ && !is_finished_;
+  }
+
  private:
   std::string description_;
   int id_;
-  bool running_;
+  bool is_started_;
+  std::atomic<bool> is_finished_;
+  std::atomic<bool> is_cancel_requested_;
+  std::atomic<int> status_;
   std::chrono::time_point<std::chrono::system_clock> start_time_;
   std::chrono::time_point<std::chrono::system_clock> end_time_;
   std::unique_ptr<std::thread> thread_;
@@ -92,6 +138,11 @@ void CommandRegisterer::addCommand(const Command& command) {
   CHECK_EQ(commands_.size(), command_index + 1u);
 
   for (const std::string& command_string : command.commands) {
+    const CommandIndexMap::const_iterator it = command_map_.find(command_string);
+    if (it != command_map_.end() &&
+        placeholder_loaders_.count(it->second) != 0u) {
+      removePlaceholderCommand(it->second);
+    }
     if (command_map_.count(command_string) != 0u) {
       const std::string& owning_plugin =
           commands_[command_map_[command_string]].plugin_name;
@@ -104,6 +155,30 @@ void CommandRegisterer::addCommand(const Command& command) {
   }
 }
 
+bool CommandRegisterer::isBackgroundCommand(const std::string& command) {
+  const size_t last_char_idx = command.find_last_not_of(' ');
+  return last_char_idx != std::string::npos && command[last_char_idx] == '&';
+}
+
+void CommandRegisterer::addPlaceholderCommand(
+    const Command& command, const std::function<bool()>& loader) {
+  CHECK(loader);
+  const size_t command_index = commands_.size();
+  addCommand(command);
+  CHECK(placeholder_loaders_.emplace(command_index, loader).second);
+}
+
+void CommandRegisterer::removePlaceholderCommand(const size_t command_index) {
+  CHECK_LT(command_index, commands_.size());
+  CHECK_EQ(placeholder_loaders_.erase(command_index), 1u);
+  // The entry stays in place to keep the indices of the other commands.
+  Command& command = commands_[command_index];
+  for (const std::string& command_string : command.commands) {
+    CHECK_EQ(command_map_.erase(command_string), 1u);
+  }
+  command.commands.clear();
+}
+
 int CommandRegisterer::processCommand(const std::string& command) {
   if (command == "") {
     return kStupidUserError;
@@ -113,8 +188,18 @@ int CommandRegisterer::processCommand(const std::string& command) {
     return kStupidUserError;
   }
 
+  // Strip the background marker, wordexp doesn't accept it.
+  const bool run_in_background = isBackgroundCommand(command);
+  std::string command_line = command;
+  if (run_in_background) {
+    command_line.erase(command_line.find_last_not_of(' '));
+    if (command_line.find_first_not_of(' ') == std::string::npos) {
+      return kStupidUserError;
+    }
+  }
+
   wordexp_t result;
-  if (wordexp(command.c_str(), &result, WRDE_SHOWERR)) {
+  if (wordexp(command_line.c_str(), &result, WRDE_SHOWERR)) {
     LOG(ERROR) << "Wordexp error";
     return kStupidUserError;
   }
@@ -129,9 +214,29 @@ int CommandRegisterer::processCommand(const std::string& command) {
     wordfree(&result);
     return kStupidUserError;
   } else {
+    // The flags of a placeholder command are only known once its plugin is
+    // loaded.
+    const std::unordered_map<size_t, std::function<bool()> >::const_iterator
+        loader_it = placeholder_loaders_.find(command_index_it->second);
+    if (loader_it != placeholder_loaders_.end()) {
+      const std::function<bool()> loader = loader_it->second;
+      command_index_it = command_map_.end();
+      if (loader()) {
+        command_index_it = command_map_.find(command_without_flags);
+      }
+      if (command_index_it == command_map_.end() ||
+          placeholder_loaders_.count(command_index_it->second) != 0u) {
+        LOG(ERROR) << "Failed to load the plugin of command "
+                   << command_without_flags << ".";
+        wordfree(&result);
+        return kUnknownError;
+      }
+    }
+
     // Go through all commands and check that the flags exist so we don't exit
     // in case we have a typo.
     int argc = result.we_wordc;
+    bool sets_flags = false;
     for (int i = 1; i < argc; ++i) {
       std::string raw_command = result.we_wordv[i];
       // Process help here since gflags will shutdown the app otherwise.
@@ -160,36 +265,49 @@ int CommandRegisterer::processCommand(const std::string& command) {
         wordfree(&result);
         return kUnknownError;
       }
+      sets_flags |= is_a_flag;
+    }
+
+    if (sets_flags && hasRunningJobs()) {
+      LOG(WARNING) << "The flags are shared with the running background jobs, "
+                   << "changing them affects jobs that still read them.";
     }
 
     google::ParseCommandLineFlags(&argc, &result.we_wordv, false);
 
     CHECK_LT(command_index_it->second, commands_.size());
     const Command& command = commands_[command_index_it->second];
-    if (command.processing_model == Processing::Async) {
-      std::shared_ptr<Job> job(
-          new Job(command.callback, command_without_flags));
-      jobs_[job->getId()] = job;
-      job->startThread();
+    if (run_in_background || command.processing_model == Processing::Async) {
+      startJob(command.callback, command_without_flags);
       wordfree(&result);
       return kSuccess;
     } else {
       try {
         wordfree(&result);
+        runCommandHooks(command_without_flags, true);
         timing::Timer timer("exec - " + std::string(command_without_flags));
         int status = command.callback();
         timer.Stop();
+        runCommandHooks(command_without_flags, false);
         return status;
       } catch (const std::exception& e) {  // NOLINT
         LOG(ERROR) << "Caught exception while processing command "
                    << command_without_flags << ": " << e.what();
         wordfree(&result);
+        runCommandHooks(command_without_flags, false);
         return kUnknownError;
       }
     }
   }
 }
 
+void CommandRegisterer::startJob(
+    const std::function<int()>& function, const std::string& description) {
+  std::shared_ptr<Job> job(new Job(function, description));
+  jobs_[job->getId()] = job;
+  job->startThread();
+}
+
 void CommandRegisterer::listJobs() const {
   if (jobs_.empty()) {
     std::cout << "No jobs started so far." << std::endl;
@@ -217,6 +335,33 @@ void CommandRegisterer::waitForJobsToFinish() const {
   std::cout << "All threads joined." << std::endl;
 }
 
+bool CommandRegisterer::cancelJob(const int job_id) const {
+  const std::unordered_map<int, std::shared_ptr<Job> >::const_iterator it =
+      jobs_.find(job_id);
+  if (it == jobs_.end()) {
+    LOG(ERROR) << "No job with id " << job_id << ".";
+    return false;
+  }
+  CHECK(it->second != nullptr);
+  if (!it->second->isRunning()) {
+    std::cout << "Job [" << job_id << "] isn't running." << std::endl;
+    return true;
+  }
+  it->second->requestCancel();
+  std::cout << "Requested job [" << job_id << "] to cancel." << std::endl;
+  return true;
+}
+
+bool CommandRegisterer::hasRunningJobs() const {
+  for (const std::pair<const int, std::shared_ptr<Job> >& id_job : jobs_) {
+    CHECK(id_job.second != nullptr);
+    if (id_job.second->isRunning()) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void CommandRegisterer::getAllCommands(
     std::vector<std::string>* all_cmds) const {
   CHECK_NOTNULL(all_cmds)->clear();
@@ -236,9 +381,31 @@ const CommandRegisterer::Command& CommandRegisterer::getCommand(
   return commands_[command_index];
 }
 
+void CommandRegisterer::addCommandHooks(
+    const CommandHook& before_command, const CommandHook& after_command) {
+  CHECK(before_command);
+  CHECK(after_command);
+  command_hooks_.emplace_back(before_command, after_command);
+}
+
+void CommandRegisterer::runCommandHooks(
+    const std::string& command_name, const bool before_command) const {
+  for (const std::pair<CommandHook, CommandHook>& hooks : command_hooks_) {
+    if (before_command) {
+      hooks.first(command_name);
+    } else {
+      hooks.second(command_name);
+    }
+  }
+}
+
 void CommandRegisterer::clear() {
+  // The jobs run the callbacks of the commands, destroying them joins them.
+  jobs_.clear();
   commands_.clear();
   command_map_.clear();
+  placeholder_loaders_.clear();
+  command_hooks_.clear();
 }
 
 }  // namespace common
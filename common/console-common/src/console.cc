@@ -80,7 +80,11 @@ Console::Console(const std::string& console_name)
 
 Console::Console() : Console(kConsoleDefaultName) {}
 
-Console::~Console() {}
+Console::~Console() {
+  // Background jobs call into the plugins, so they need to finish before the
+  // plugins are destroyed.
+  command_registerer_ptr_->clear();
+}
 
 void Console::RunCommandPrompt() {
   std::string last_input;
@@ -121,6 +125,12 @@ void Console::addCommand(const CommandRegisterer::Command& command) {
   auto_completion_.addCommandsToIndex(command.commands);
 }
 
+void Console::addCommandHooks(
+    const CommandRegisterer::CommandHook& before_command,
+    const CommandRegisterer::CommandHook& after_command) {
+  command_registerer_ptr_->addCommandHooks(before_command, after_command);
+}
+
 void Console::setConsoleName(const std::string& name) {
   CHECK(!name.empty());
   console_name_ = name;
@@ -337,7 +347,9 @@ int Console::RunCommand(const std::string& command) {
     google::FlagSaver flag_saver_restore_flags;
     command_result = command_registerer_ptr_->processCommand(command);
 
-    if (FLAGS_keep_gflags) {
+    // Background jobs read the flags while they run, so their flags are kept
+    // as if keep_gflags was set.
+    if (FLAGS_keep_gflags || CommandRegisterer::isBackgroundCommand(command)) {
       // If keep_gflags is set, construct another FlagSaver which will be
       // deleted after the intial one, so that the new flags (set by the current
       // command) will be kept persistent.
@@ -362,17 +374,40 @@ void Console::installPlugin(ConsolePluginPtr plugin) {
   installed_plugins_.emplace(std::move(plugin));
 }
 
+void Console::addLazyPlugin(
+    const std::string& plugin_id, const CommandRegisterer::Commands& commands,
+    const std::function<bool()>& loader) {
+  CHECK(!plugin_id.empty());
+  CHECK(loader);
+  auto_completion_.addFlagToIndex(plugin_id);
+  lazy_plugin_ids_.emplace(plugin_id);
+
+  for (const CommandRegisterer::Command& command : commands) {
+    CHECK_NE(command.commands.size(), 0u);
+    command_registerer_ptr_->addPlaceholderCommand(command, loader);
+    auto_completion_.addCommandsToIndex(command.commands);
+  }
+}
+
 void Console::uninstallAllPlugins() {
   command_registerer_ptr_->clear();
   installed_plugins_.clear();
+  lazy_plugin_ids_.clear();
+}
+
+const CommandRegisterer::Commands& Console::getCommandsOfPlugin(
+    const ConsolePluginBase& plugin) {
+  return plugin.commands_;
 }
 
 void Console::getNamesOfInstalledPlugins(
     std::vector<std::string>* plugin_names) const {
   CHECK_NOTNULL(plugin_names)->clear();
+  std::set<std::string> plugin_ids = lazy_plugin_ids_;
   for (const ConsolePluginPtr& plugin : installed_plugins_) {
-    plugin_names->emplace_back(plugin->getPluginId());
+    plugin_ids.emplace(plugin->getPluginId());
   }
+  plugin_names->assign(plugin_ids.begin(), plugin_ids.end());
 }
 
 void Console::setSelectedMapKey(const std::string& selected_map_key) {
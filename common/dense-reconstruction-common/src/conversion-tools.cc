@@ -2,64 +2,169 @@
 
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <glog/logging.h>
 #include <map-resources/resource-conversion.h>
+#include <maplab-common/thread-pool.h>
+#include <maplab-common/threading-helpers.h>
 
 namespace dense_reconstruction {
 
+namespace {
+struct DepthMapConversionJob {
+  vi_map::Vertex* vertex;
+  size_t frame_idx;
+  cv::Mat depth_map;
+  cv::Mat image_for_depth_map;
+  bool has_image;
+  std::shared_ptr<const backend::DepthMapBackProjectionTable> table;
+
+  resources::PointCloud point_cloud;
+  bool success;
+};
+typedef std::vector<DepthMapConversionJob> DepthMapConversionJobs;
+
+// Back-projection tables of all cameras, which are shared by all depth maps of
+// the same camera and size.
+class BackProjectionTableCache {
+ public:
+  std::shared_ptr<const backend::DepthMapBackProjectionTable> getTable(
+      const aslam::Camera& camera, const cv::Mat& depth_map) {
+    std::shared_ptr<const backend::DepthMapBackProjectionTable>& table =
+        tables_[camera.getId()];
+    if (table == nullptr || table->width != depth_map.cols ||
+        table->height != depth_map.rows) {
+      std::shared_ptr<backend::DepthMapBackProjectionTable> new_table =
+          std::make_shared<backend::DepthMapBackProjectionTable>();
+      backend::computeDepthMapBackProjectionTable(
+          camera, depth_map.cols, depth_map.rows, new_table.get());
+      table = new_table;
+    }
+    return table;
+  }
+
+ private:
+  std::unordered_map<
+      aslam::CameraId,
+      std::shared_ptr<const backend::DepthMapBackProjectionTable>>
+      tables_;
+};
+
+void convertDepthMap(DepthMapConversionJob* job) {
+  CHECK_NOTNULL(job);
+  CHECK(job->table != nullptr);
+  if (!job->has_image) {
+    const cv::Mat no_image(1, 1, CV_8UC1);
+    job->success = backend::convertDepthMapToPointCloud(
+        job->depth_map, no_image, *job->table, &job->point_cloud);
+  } else {
+    job->success = backend::convertDepthMapToPointCloud(
+        job->depth_map, job->image_for_depth_map, *job->table,
+        &job->point_cloud);
+  }
+  // The inputs are not needed anymore, release them early.
+  job->depth_map.release();
+  job->image_for_depth_map.release();
+}
+
+size_t storePointClouds(
+    const DepthMapConversionJobs& jobs, vi_map::VIMap* vi_map) {
+  CHECK_NOTNULL(vi_map);
+  size_t num_conversions = 0u;
+  for (const DepthMapConversionJob& job : jobs) {
+    if (!job.success) {
+      continue;
+    }
+    if (job.has_image) {
+      vi_map->storePointCloudXYZRGBN(
+          job.point_cloud, job.frame_idx, job.vertex);
+    } else {
+      vi_map->storePointCloudXYZ(job.point_cloud, job.frame_idx, job.vertex);
+    }
+    ++num_conversions;
+  }
+  return num_conversions;
+}
+}  // namespace
+
 bool convertAllDepthMapsToPointClouds(vi_map::VIMap* vi_map) {
   CHECK_NOTNULL(vi_map);
 
   VLOG(1) << "Converting all depth maps to point clouds...";
+  pose_graph::VertexIdList vertex_ids;
+  vi_map->getAllVertexIds(&vertex_ids);
+
+  // The map is only accessed from this thread: it loads the depth maps of the
+  // next batch and stores the point clouds of the previous batch while the
+  // thread pool converts the current batch.
+  const size_t num_frames_per_batch = 4u * common::getNumHardwareThreads();
+  common::ThreadPoolTaskGroup conversion_tasks(
+      &common::ThreadPool::getGlobal());
+  BackProjectionTableCache table_cache;
+  DepthMapConversionJobs loading_jobs, converting_jobs;
   size_t num_conversions = 0u;
-  vi_map->forEachVertex([&](vi_map::Vertex* vertex) {
+
+  auto start_conversion = [&]() {
+    conversion_tasks.wait();
+    DepthMapConversionJobs converted_jobs;
+    converted_jobs.swap(converting_jobs);
+    converting_jobs.swap(loading_jobs);
+    for (DepthMapConversionJob& job : converting_jobs) {
+      DepthMapConversionJob* job_ptr = &job;
+      conversion_tasks.run([job_ptr]() { convertDepthMap(job_ptr); });
+    }
+    num_conversions += storePointClouds(converted_jobs, vi_map);
+  };
+
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    vi_map::Vertex* vertex = vi_map->getVertexPtr(vertex_id);
     CHECK_NOTNULL(vertex);
-    const vi_map::MissionId& mission_id = vertex->getMissionId();
     const aslam::NCamera& n_camera =
-        vi_map->getSensorManager().getNCameraForMission(mission_id);
-
-    const pose_graph::VertexId& vertex_id = vertex->id();
-    const size_t num_frames = vertex->numFrames();
+        vi_map->getSensorManager().getNCameraForMission(
+            vertex->getMissionId());
     const aslam::VisualNFrame& nframe = vertex->getVisualNFrame();
 
-    for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
-      if (nframe.isFrameSet(frame_idx)) {
-        cv::Mat depth_map;
-        if (vi_map->getOptimizedDepthMap(*vertex, frame_idx, &depth_map)) {
-          // Nothing to do here.
-        } else if (vi_map->getRawDepthMap(*vertex, frame_idx, &depth_map)) {
-          // Nothing to do here.
-        } else {
-          continue;
-        }
-        CHECK(!depth_map.empty()) << "Vertex " << vertex_id << " frame "
-                                  << frame_idx << " has an empty depth map!";
-
-        const aslam::Camera& camera = n_camera.getCamera(frame_idx);
-
-        resources::PointCloud point_cloud;
-        cv::Mat image_for_depth_map;
-        if (vi_map->getImageForDepthMap(
-                *vertex, frame_idx, &image_for_depth_map)) {
-          CHECK(!image_for_depth_map.empty())
-              << "Vertex " << vertex_id << " frame " << frame_idx
-              << " has an empty image for the depth map!";
-          if (backend::convertDepthMapWithImageToPointCloud(
-                  depth_map, image_for_depth_map, camera, &point_cloud)) {
-            vi_map->storePointCloudXYZRGBN(point_cloud, frame_idx, vertex);
-            ++num_conversions;
-          }
-        } else {
-          if (backend::convertDepthMapToPointCloud(
-                  depth_map, camera, &point_cloud)) {
-            vi_map->storePointCloudXYZ(point_cloud, frame_idx, vertex);
-            ++num_conversions;
-          }
-        }
+    for (size_t frame_idx = 0u; frame_idx < vertex->numFrames(); ++frame_idx) {
+      if (!nframe.isFrameSet(frame_idx)) {
+        continue;
+      }
+      DepthMapConversionJob job;
+      if (vi_map->getOptimizedDepthMap(*vertex, frame_idx, &job.depth_map)) {
+        // Nothing to do here.
+      } else if (vi_map->getRawDepthMap(*vertex, frame_idx, &job.depth_map)) {
+        // Nothing to do here.
+      } else {
+        continue;
+      }
+      CHECK(!job.depth_map.empty()) << "Vertex " << vertex_id << " frame "
+                                    << frame_idx << " has an empty depth map!";
+
+      job.has_image = vi_map->getImageForDepthMap(
+          *vertex, frame_idx, &job.image_for_depth_map);
+      if (job.has_image) {
+        CHECK(!job.image_for_depth_map.empty())
+            << "Vertex " << vertex_id << " frame " << frame_idx
+            << " has an empty image for the depth map!";
+      }
+      job.vertex = vertex;
+      job.frame_idx = frame_idx;
+      job.table =
+          table_cache.getTable(n_camera.getCamera(frame_idx), job.depth_map);
+      job.success = false;
+      loading_jobs.emplace_back(std::move(job));
+
+      if (loading_jobs.size() >= num_frames_per_batch) {
+        start_conversion();
       }
     }
-  });
+  }
+  start_conversion();
+  conversion_tasks.wait();
+  num_conversions += storePointClouds(converting_jobs, vi_map);
+
   VLOG(1) << "Done. Converted " << num_conversions << " depth maps.";
   return true;
 }
@@ -0,0 +1,388 @@
+#ifndef MAPLAB_COMMON_FLAT_HASH_MAP_INL_H_
+#define MAPLAB_COMMON_FLAT_HASH_MAP_INL_H_
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <utility>
+
+#include <glog/logging.h>
+
+namespace common {
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+constexpr uint8_t FlatHashMap<Key, Value, Hash, KeyEqual>::kEmpty;
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+constexpr uint8_t FlatHashMap<Key, Value, Hash, KeyEqual>::kDeleted;
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+constexpr size_t FlatHashMap<Key, Value, Hash, KeyEqual>::kMinCapacity;
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+constexpr size_t FlatHashMap<Key, Value, Hash, KeyEqual>::kInvalidIndex;
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+FlatHashMap<Key, Value, Hash, KeyEqual>::FlatHashMap()
+    : slots_(nullptr), capacity_(0u), size_(0u), num_deleted_(0u) {}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+FlatHashMap<Key, Value, Hash, KeyEqual>::FlatHashMap(const FlatHashMap& other)
+    : slots_(nullptr),
+      capacity_(0u),
+      size_(0u),
+      num_deleted_(0u),
+      hash_(other.hash_),
+      key_equal_(other.key_equal_) {
+  copyFrom(other);
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+FlatHashMap<Key, Value, Hash, KeyEqual>::FlatHashMap(
+    FlatHashMap&& other) noexcept
+    : slots_(nullptr), capacity_(0u), size_(0u), num_deleted_(0u) {
+  swap(other);
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+FlatHashMap<Key, Value, Hash, KeyEqual>&
+FlatHashMap<Key, Value, Hash, KeyEqual>::operator=(const FlatHashMap& other) {
+  if (this != &other) {
+    destroyAndDeallocate();
+    hash_ = other.hash_;
+    key_equal_ = other.key_equal_;
+    copyFrom(other);
+  }
+  return *this;
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+FlatHashMap<Key, Value, Hash, KeyEqual>&
+FlatHashMap<Key, Value, Hash, KeyEqual>::operator=(
+    FlatHashMap&& other) noexcept {
+  if (this != &other) {
+    destroyAndDeallocate();
+    swap(other);
+  }
+  return *this;
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+FlatHashMap<Key, Value, Hash, KeyEqual>::~FlatHashMap() {
+  destroyAndDeallocate();
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+typename FlatHashMap<Key, Value, Hash, KeyEqual>::iterator
+FlatHashMap<Key, Value, Hash, KeyEqual>::begin() {
+  iterator it = iteratorAt(0u);
+  it.skipFreeSlots();
+  return it;
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+typename FlatHashMap<Key, Value, Hash, KeyEqual>::iterator
+FlatHashMap<Key, Value, Hash, KeyEqual>::end() {
+  return iteratorAt(capacity_);
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+typename FlatHashMap<Key, Value, Hash, KeyEqual>::const_iterator
+FlatHashMap<Key, Value, Hash, KeyEqual>::begin() const {
+  const_iterator it = iteratorAt(0u);
+  it.skipFreeSlots();
+  return it;
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+typename FlatHashMap<Key, Value, Hash, KeyEqual>::const_iterator
+FlatHashMap<Key, Value, Hash, KeyEqual>::end() const {
+  return iteratorAt(capacity_);
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+typename FlatHashMap<Key, Value, Hash, KeyEqual>::iterator
+FlatHashMap<Key, Value, Hash, KeyEqual>::find(const Key& key) {
+  const size_t index = findIndex(key);
+  return index == kInvalidIndex ? end() : iteratorAt(index);
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+typename FlatHashMap<Key, Value, Hash, KeyEqual>::const_iterator
+FlatHashMap<Key, Value, Hash, KeyEqual>::find(const Key& key) const {
+  const size_t index = findIndex(key);
+  return index == kInvalidIndex ? end() : iteratorAt(index);
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+template <typename... Args>
+std::pair<typename FlatHashMap<Key, Value, Hash, KeyEqual>::iterator, bool>
+FlatHashMap<Key, Value, Hash, KeyEqual>::emplace(
+    const Key& key, Args&&... args) {
+  const size_t existing_index = findIndex(key);
+  if (existing_index != kInvalidIndex) {
+    return std::make_pair(iteratorAt(existing_index), false);
+  }
+
+  // Keep at least 1/8 of the slots empty such that probing terminates fast.
+  if ((size_ + num_deleted_ + 1u) * 8u > capacity_ * 7u) {
+    // Only grow if the map is more than half full, otherwise it is enough to
+    // reclaim the deleted slots.
+    if ((size_ + 1u) * 16u > capacity_ * 7u) {
+      rehash(std::max(getMinCapacityForSize(size_ + 1u), 2u * capacity_));
+    } else {
+      rehash(capacity_);
+    }
+  }
+
+  const size_t hash = hashKey(key);
+  const size_t index = findFreeIndex(hash);
+  ::new (static_cast<void*>(slots_ + index)) value_type(
+      std::piecewise_construct, std::forward_as_tuple(key),
+      std::forward_as_tuple(std::forward<Args>(args)...));
+  if (controls_[index] == kDeleted) {
+    CHECK_GT(num_deleted_, 0u);
+    --num_deleted_;
+  }
+  controls_[index] = static_cast<uint8_t>(hash & 0x7fu);
+  ++size_;
+  return std::make_pair(iteratorAt(index), true);
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+std::pair<typename FlatHashMap<Key, Value, Hash, KeyEqual>::iterator, bool>
+FlatHashMap<Key, Value, Hash, KeyEqual>::insert(const value_type& value) {
+  return emplace(value.first, value.second);
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+Value& FlatHashMap<Key, Value, Hash, KeyEqual>::operator[](const Key& key) {
+  return emplace(key).first->second;
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+typename FlatHashMap<Key, Value, Hash, KeyEqual>::iterator
+FlatHashMap<Key, Value, Hash, KeyEqual>::erase(const_iterator position) {
+  CHECK(position != end());
+  const size_t index = position.control_ - controls_.get();
+  CHECK_LT(index, capacity_);
+  CHECK(isFull(controls_[index]));
+  slots_[index].~value_type();
+  // If the next slot is empty, no probe sequence continues past this slot and
+  // it can be marked empty right away.
+  if (controls_[(index + 1u) & (capacity_ - 1u)] == kEmpty) {
+    controls_[index] = kEmpty;
+  } else {
+    controls_[index] = kDeleted;
+    ++num_deleted_;
+  }
+  --size_;
+
+  iterator next = iteratorAt(index);
+  ++next;
+  return next;
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+size_t FlatHashMap<Key, Value, Hash, KeyEqual>::erase(const Key& key) {
+  const size_t index = findIndex(key);
+  if (index == kInvalidIndex) {
+    return 0u;
+  }
+  erase(const_iterator(iteratorAt(index)));
+  return 1u;
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+void FlatHashMap<Key, Value, Hash, KeyEqual>::clear() {
+  for (size_t index = 0u; index < capacity_; ++index) {
+    if (isFull(controls_[index])) {
+      slots_[index].~value_type();
+    }
+  }
+  if (capacity_ > 0u) {
+    memset(controls_.get(), kEmpty, capacity_);
+  }
+  size_ = 0u;
+  num_deleted_ = 0u;
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+void FlatHashMap<Key, Value, Hash, KeyEqual>::swap(
+    FlatHashMap& other) noexcept {
+  using std::swap;
+  swap(controls_, other.controls_);
+  swap(slots_, other.slots_);
+  swap(capacity_, other.capacity_);
+  swap(size_, other.size_);
+  swap(num_deleted_, other.num_deleted_);
+  swap(hash_, other.hash_);
+  swap(key_equal_, other.key_equal_);
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+void FlatHashMap<Key, Value, Hash, KeyEqual>::reserve(size_t num_values) {
+  const size_t min_capacity = getMinCapacityForSize(num_values);
+  if (min_capacity > capacity_) {
+    rehash(min_capacity);
+  }
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+size_t FlatHashMap<Key, Value, Hash, KeyEqual>::getMinCapacityForSize(
+    size_t num_values) {
+  size_t capacity = kMinCapacity;
+  while (capacity * 7u < num_values * 8u) {
+    capacity *= 2u;
+  }
+  return capacity;
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+size_t FlatHashMap<Key, Value, Hash, KeyEqual>::hashKey(const Key& key) const {
+  // Finalizer of MurmurHash3. Many std::hash implementations, including the
+  // ones of the unique ids, do not mix the bits well enough for masking.
+  uint64_t hash = static_cast<uint64_t>(hash_(key));
+  hash ^= hash >> 33u;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33u;
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  hash ^= hash >> 33u;
+  return static_cast<size_t>(hash);
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+size_t FlatHashMap<Key, Value, Hash, KeyEqual>::findIndex(
+    const Key& key) const {
+  if (size_ == 0u) {
+    return kInvalidIndex;
+  }
+  const size_t hash = hashKey(key);
+  const uint8_t hash_bits = static_cast<uint8_t>(hash & 0x7fu);
+  const size_t mask = capacity_ - 1u;
+  for (size_t index = (hash >> 7u) & mask;; index = (index + 1u) & mask) {
+    const uint8_t control = controls_[index];
+    if (control == hash_bits && key_equal_(slots_[index].first, key)) {
+      return index;
+    }
+    if (control == kEmpty) {
+      return kInvalidIndex;
+    }
+  }
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+size_t FlatHashMap<Key, Value, Hash, KeyEqual>::findFreeIndex(
+    size_t hash) const {
+  CHECK_GT(capacity_, 0u);
+  const size_t mask = capacity_ - 1u;
+  size_t index = (hash >> 7u) & mask;
+  while (isFull(controls_[index])) {
+    index = (index + 1u) & mask;
+  }
+  return index;
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+void FlatHashMap<Key, Value, Hash, KeyEqual>::rehash(size_t new_capacity) {
+  CHECK_GE(new_capacity, kMinCapacity);
+  CHECK_EQ(new_capacity & (new_capacity - 1u), 0u)
+      << "The capacity must be a power of two.";
+  CHECK_GE(new_capacity * 7u, size_ * 8u);
+
+  std::unique_ptr<uint8_t[]> old_controls = std::move(controls_);
+  value_type* old_slots = slots_;
+  const size_t old_capacity = capacity_;
+  allocate(new_capacity);
+
+  for (size_t index = 0u; index < old_capacity; ++index) {
+    if (!isFull(old_controls[index])) {
+      continue;
+    }
+    value_type& old_value = old_slots[index];
+    const size_t new_index = findFreeIndex(hashKey(old_value.first));
+    ::new (static_cast<void*>(slots_ + new_index))
+        value_type(std::move(old_value));
+    controls_[new_index] = old_controls[index];
+    old_value.~value_type();
+  }
+  num_deleted_ = 0u;
+  std::allocator<value_type>().deallocate(old_slots, old_capacity);
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+void FlatHashMap<Key, Value, Hash, KeyEqual>::allocate(size_t capacity) {
+  controls_.reset(new uint8_t[capacity]);
+  memset(controls_.get(), kEmpty, capacity);
+  slots_ = std::allocator<value_type>().allocate(capacity);
+  capacity_ = capacity;
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+void FlatHashMap<Key, Value, Hash, KeyEqual>::destroyAndDeallocate() {
+  clear();
+  if (slots_ != nullptr) {
+    std::allocator<value_type>().deallocate(slots_, capacity_);
+  }
+  controls_.reset();
+  slots_ = nullptr;
+  capacity_ = 0u;
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+void FlatHashMap<Key, Value, Hash, KeyEqual>::copyFrom(
+    const FlatHashMap& other) {
+  CHECK_EQ(capacity_, 0u);
+  if (other.capacity_ == 0u) {
+    return;
+  }
+  // Keep the slot layout, the copy has the same probe sequences.
+  allocate(other.capacity_);
+  for (size_t index = 0u; index < capacity_; ++index) {
+    const uint8_t control = other.controls_[index];
+    if (isFull(control)) {
+      ::new (static_cast<void*>(slots_ + index))
+          value_type(other.slots_[index]);
+    }
+    controls_[index] = control;
+  }
+  size_ = other.size_;
+  num_deleted_ = other.num_deleted_;
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+const Value& getChecked(
+    const FlatHashMap<Key, Value, Hash, KeyEqual>& map, const Key& key) {
+  typename FlatHashMap<Key, Value, Hash, KeyEqual>::const_iterator it =
+      map.find(key);
+  CHECK(it != map.end());
+  return it->second;
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+Value& getChecked(
+    FlatHashMap<Key, Value, Hash, KeyEqual>& map,  // NOLINT
+    const Key& key) {
+  typename FlatHashMap<Key, Value, Hash, KeyEqual>::iterator it =
+      map.find(key);
+  CHECK(it != map.end());
+  return it->second;
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+const Value* getValuePtr(
+    const FlatHashMap<Key, Value, Hash, KeyEqual>& map, const Key& key) {
+  typename FlatHashMap<Key, Value, Hash, KeyEqual>::const_iterator it =
+      map.find(key);
+  return it == map.end() ? nullptr : &it->second;
+}
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+size_t getHeapBytes(const FlatHashMap<Key, Value, Hash, KeyEqual>& map) {
+  typedef typename FlatHashMap<Key, Value, Hash, KeyEqual>::value_type
+      ValueType;
+  return map.capacity() * (sizeof(ValueType) + sizeof(uint8_t));
+}
+
+}  // namespace common
+
+#endif  // MAPLAB_COMMON_FLAT_HASH_MAP_INL_H_
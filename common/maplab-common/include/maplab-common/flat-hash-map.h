@@ -0,0 +1,226 @@
+#ifndef MAPLAB_COMMON_FLAT_HASH_MAP_H_
+#define MAPLAB_COMMON_FLAT_HASH_MAP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include <glog/logging.h>
+
+namespace common {
+
+// Open-addressing hash map with linear probing. All values are stored in one
+// contiguous slot array next to an array with one control byte per slot, so a
+// lookup touches one or two cache lines instead of chasing the node pointers
+// of std::unordered_map. The control byte holds 7 bits of the hash of the key
+// in the slot, most unsuccessful key comparisons are hence avoided without
+// accessing the slot array. Erased slots are marked as deleted and are only
+// reclaimed on rehashing.
+//
+// The interface is the subset of std::unordered_map used for the id indices
+// of the map structures. In contrast to std::unordered_map, inserting a value
+// invalidates all iterators, pointers and references to the values if it
+// triggers a rehash; erasing only invalidates the iterators to the erased
+// values. The iteration order is unspecified.
+template <typename Key, typename Value, typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>>
+class FlatHashMap {
+ public:
+  typedef Key key_type;
+  typedef Value mapped_type;
+  typedef std::pair<const Key, Value> value_type;
+  typedef size_t size_type;
+  typedef Hash hasher;
+  typedef KeyEqual key_equal;
+
+  template <bool kIsConst>
+  class IteratorBase {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef typename FlatHashMap::value_type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef typename std::conditional<kIsConst, const value_type*,
+                                      value_type*>::type pointer;
+    typedef typename std::conditional<kIsConst, const value_type&,
+                                      value_type&>::type reference;
+
+    IteratorBase() : control_(nullptr), control_end_(nullptr), slot_(nullptr) {}
+
+    // Allows the conversion from iterator to const_iterator.
+    template <bool kOtherIsConst,
+              typename = typename std::enable_if<
+                  kIsConst || !kOtherIsConst>::type>
+    IteratorBase(const IteratorBase<kOtherIsConst>& other)  // NOLINT
+        : control_(other.control_),
+          control_end_(other.control_end_),
+          slot_(other.slot_) {}
+
+    reference operator*() const {
+      return *slot_;
+    }
+    pointer operator->() const {
+      return slot_;
+    }
+    IteratorBase& operator++() {
+      ++control_;
+      ++slot_;
+      skipFreeSlots();
+      return *this;
+    }
+    IteratorBase operator++(int) {  // NOLINT
+      IteratorBase previous = *this;
+      ++*this;
+      return previous;
+    }
+    template <bool kOtherIsConst>
+    bool operator==(const IteratorBase<kOtherIsConst>& other) const {
+      return control_ == other.control_;
+    }
+    template <bool kOtherIsConst>
+    bool operator!=(const IteratorBase<kOtherIsConst>& other) const {
+      return control_ != other.control_;
+    }
+
+   private:
+    friend class FlatHashMap;
+    template <bool kOtherIsConst>
+    friend class IteratorBase;
+
+    IteratorBase(const uint8_t* control, const uint8_t* control_end,
+                 pointer slot)
+        : control_(control), control_end_(control_end), slot_(slot) {}
+
+    void skipFreeSlots() {
+      while (control_ != control_end_ && !isFull(*control_)) {
+        ++control_;
+        ++slot_;
+      }
+    }
+
+    const uint8_t* control_;
+    const uint8_t* control_end_;
+    pointer slot_;
+  };
+  typedef IteratorBase<false> iterator;
+  typedef IteratorBase<true> const_iterator;
+
+  FlatHashMap();
+  FlatHashMap(const FlatHashMap& other);
+  FlatHashMap(FlatHashMap&& other) noexcept;
+  FlatHashMap& operator=(const FlatHashMap& other);
+  FlatHashMap& operator=(FlatHashMap&& other) noexcept;
+  ~FlatHashMap();
+
+  iterator begin();
+  iterator end();
+  const_iterator begin() const;
+  const_iterator end() const;
+  const_iterator cbegin() const {
+    return begin();
+  }
+  const_iterator cend() const {
+    return end();
+  }
+
+  size_t size() const {
+    return size_;
+  }
+  bool empty() const {
+    return size_ == 0u;
+  }
+  // Number of slots, the map holds at most 7/8 of this many values.
+  size_t capacity() const {
+    return capacity_;
+  }
+
+  iterator find(const Key& key);
+  const_iterator find(const Key& key) const;
+  size_t count(const Key& key) const {
+    return findIndex(key) == kInvalidIndex ? 0u : 1u;
+  }
+
+  // Constructs the value in place from the arguments if the key is not yet
+  // present, otherwise the arguments are left untouched. Returns the iterator
+  // to the value of the key and whether the value has been inserted.
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(const Key& key, Args&&... args);
+  std::pair<iterator, bool> insert(const value_type& value);
+  Value& operator[](const Key& key);
+
+  // Returns the iterator to the value following the erased value.
+  iterator erase(const_iterator position);
+  iterator erase(iterator position) {
+    return erase(const_iterator(position));
+  }
+  size_t erase(const Key& key);
+
+  void clear();
+  void swap(FlatHashMap& other) noexcept;  // NOLINT
+  // Ensures that num_values values can be held without rehashing.
+  void reserve(size_t num_values);
+
+ private:
+  // Control bytes of free slots have the most significant bit set, full slots
+  // store the 7 least significant bits of the hash of their key.
+  static constexpr uint8_t kEmpty = 0x80u;
+  static constexpr uint8_t kDeleted = 0xfeu;
+  static constexpr size_t kMinCapacity = 16u;
+  static constexpr size_t kInvalidIndex = static_cast<size_t>(-1);
+
+  static bool isFull(uint8_t control) {
+    return (control & 0x80u) == 0u;
+  }
+  static size_t getMinCapacityForSize(size_t num_values);
+
+  size_t hashKey(const Key& key) const;
+  size_t findIndex(const Key& key) const;
+  // Returns the slot index for a key which is not in the map. Expects that
+  // there is at least one empty slot.
+  size_t findFreeIndex(size_t hash) const;
+  void rehash(size_t new_capacity);
+  void allocate(size_t capacity);
+  void destroyAndDeallocate();
+  void copyFrom(const FlatHashMap& other);
+
+  iterator iteratorAt(size_t index) {
+    return iterator(
+        controls_.get() + index, controls_.get() + capacity_, slots_ + index);
+  }
+  const_iterator iteratorAt(size_t index) const {
+    return const_iterator(
+        controls_.get() + index, controls_.get() + capacity_, slots_ + index);
+  }
+
+  std::unique_ptr<uint8_t[]> controls_;
+  value_type* slots_;
+  size_t capacity_;
+  size_t size_;
+  size_t num_deleted_;
+  Hash hash_;
+  KeyEqual key_equal_;
+};
+
+// Overloads of the accessors and the memory accounting for FlatHashMap, see
+// maplab-common/accessors.h and maplab-common/memory-accounting.h.
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+const Value& getChecked(
+    const FlatHashMap<Key, Value, Hash, KeyEqual>& map, const Key& key);
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+Value& getChecked(
+    FlatHashMap<Key, Value, Hash, KeyEqual>& map,  // NOLINT
+    const Key& key);
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+const Value* getValuePtr(
+    const FlatHashMap<Key, Value, Hash, KeyEqual>& map, const Key& key);
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+size_t getHeapBytes(const FlatHashMap<Key, Value, Hash, KeyEqual>& map);
+
+}  // namespace common
+
+#include "maplab-common/flat-hash-map-inl.h"
+
+#endif  // MAPLAB_COMMON_FLAT_HASH_MAP_H_
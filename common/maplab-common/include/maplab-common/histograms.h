@@ -1,6 +1,9 @@
 #ifndef MAPLAB_COMMON_HISTOGRAMS_H_
 #define MAPLAB_COMMON_HISTOGRAMS_H_
 
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <vector>
 
 #include <Eigen/Dense>
@@ -38,6 +41,47 @@ Eigen::MatrixXd downsampleWithIndexAsX(
     const std::vector<std::vector<InputScalar>>& y_values,
     const size_t num_x_bins, const size_t num_y_bins);
 
+// Streaming histogram of non-negative integer samples, e.g. latencies in
+// nanoseconds. The bin widths grow exponentially: bin 0 counts the value 0,
+// bin i > 0 counts the values in [2^(i-1), 2^i). This covers the full range
+// of uint64_t with a constant relative resolution. Samples can be added
+// concurrently from multiple threads without locking.
+class ExponentialHistogram {
+ public:
+  static constexpr size_t kNumBins = 65u;
+
+  ExponentialHistogram();
+  ExponentialHistogram(const ExponentialHistogram& other);
+  ExponentialHistogram& operator=(const ExponentialHistogram& other);
+
+  void addSample(uint64_t value);
+  // Adds all samples of the other histogram.
+  void merge(const ExponentialHistogram& other);
+  void reset();
+
+  uint64_t getNumSamples() const;
+  // Min and max are 0 if there are no samples.
+  uint64_t getMin() const;
+  uint64_t getMax() const;
+  double getMean() const;
+  // Estimates the percentile (in [0, 100]) by interpolating linearly within
+  // the bin that contains it. Returns 0 if there are no samples.
+  double getPercentile(double percentile) const;
+
+  uint64_t getBinCount(size_t bin_index) const;
+  // Smallest value and one past the largest value counted by the bin.
+  static uint64_t getBinLowerBound(size_t bin_index);
+  static uint64_t getBinUpperBound(size_t bin_index);
+  static size_t getBinIndex(uint64_t value);
+
+ private:
+  std::array<std::atomic<uint64_t>, kNumBins> bin_counts_;
+  std::atomic<uint64_t> num_samples_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> min_;
+  std::atomic<uint64_t> max_;
+};
+
 }  // namespace histograms
 
 }  // namespace common
@@ -33,6 +33,8 @@ class UniqueIdHashSeed {
 };
 
 void generateUnique128BitHash(uint64_t hash[2]);
+// Writes num_hashes hashes of two words each to hashes.
+void generateUnique128BitHashes(size_t num_hashes, uint64_t* hashes);
 }  // namespace internal
 }  // namespace common
 
@@ -0,0 +1,321 @@
+#ifndef MAPLAB_COMMON_LOCK_FREE_BOUNDED_QUEUE_H_
+#define MAPLAB_COMMON_LOCK_FREE_BOUNDED_QUEUE_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <glog/logging.h>
+#include <maplab-common/macros.h>
+#include <maplab-common/threadsafe-queue.h>
+
+namespace common {
+
+// Bounded multi-producer multi-consumer queue based on a ring buffer of
+// sequenced cells (D. Vyukov). Pushing and popping only needs a compare and
+// swap on the head or tail index, no mutex is taken as long as no thread has
+// to block. Offers the same interface as ThreadSafeQueue except for the
+// getCopyOf*() accessors, so it can be used as a drop-in replacement in hot
+// pipelines.
+//
+// The capacity is rounded up to the next power of two. In contrast to
+// ThreadSafeQueue, Push() and PushNonBlocking() wait for free space if the
+// queue is full and drop the value only if the queue is shut down meanwhile.
+template <typename QueueType>
+class LockFreeBoundedQueue final : public ThreadSafeQueueBase {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(LockFreeBoundedQueue);
+
+  static constexpr size_t kDefaultCapacity = 1024u;
+
+  explicit LockFreeBoundedQueue(size_t capacity = kDefaultCapacity)
+      : shutdown_(false), num_waiting_(0u) {
+    CHECK_GT(capacity, 0u);
+    size_t rounded_capacity = 1u;
+    while (rounded_capacity < capacity) {
+      rounded_capacity <<= 1u;
+    }
+    capacity_ = rounded_capacity;
+    index_mask_ = capacity_ - 1u;
+    cells_.reset(new Cell[capacity_]);
+    for (size_t i = 0u; i < capacity_; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    enqueue_position_.store(0u, std::memory_order_relaxed);
+    dequeue_position_.store(0u, std::memory_order_relaxed);
+  }
+
+  ~LockFreeBoundedQueue() override {
+    Shutdown();
+  }
+
+  void NotifyAll() const override {
+    std::lock_guard<std::mutex> lock(wait_mutex_);
+    wait_condition_.notify_all();
+  }
+
+  void Shutdown() override {
+    shutdown_ = true;
+    NotifyAll();
+  }
+
+  void Resume() override {
+    shutdown_ = false;
+    NotifyAll();
+  }
+
+  size_t Capacity() const {
+    return capacity_;
+  }
+
+  // Approximate if other threads are pushing or popping concurrently.
+  size_t Size() const override {  // NOLINT
+    const size_t enqueue_position =
+        enqueue_position_.load(std::memory_order_acquire);
+    const size_t dequeue_position =
+        dequeue_position_.load(std::memory_order_acquire);
+    return enqueue_position > dequeue_position
+               ? enqueue_position - dequeue_position
+               : 0u;
+  }
+
+  bool Empty() const override {  // NOLINT
+    return Size() == 0u;
+  }
+
+  // Push to the queue, waits if the queue is full.
+  void Push(const QueueType& value) {
+    PushNonBlocking(value);
+  }
+
+  // Push to the queue, waits if the queue is full.
+  void PushNonBlocking(const QueueType& value) {
+    while (!tryPush(value)) {
+      if (shutdown_) {
+        return;
+      }
+      waitFor([this]() { return Size() < capacity_; });
+    }
+    notifyWaiting();
+  }
+
+  // Returns false if the queue is full.
+  bool TryPush(const QueueType& value) {
+    if (!tryPush(value)) {
+      return false;
+    }
+    notifyWaiting();
+    return true;
+  }
+
+  // Push to the queue if the size is less than max_queue_size, else block.
+  bool PushBlockingIfFull(const QueueType& value, size_t max_queue_size) {
+    CHECK_GT(max_queue_size, 0u);
+    while (!shutdown_) {
+      if (Size() >= max_queue_size) {
+        waitFor([this, max_queue_size]() {
+          return Size() < max_queue_size;
+        });
+        continue;
+      }
+      if (tryPush(value)) {
+        notifyWaiting();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Returns true if oldest was dropped because queue was full.
+  bool PushNonBlockingDroppingOldestElementIfFull(
+      const QueueType& value, size_t max_queue_size) {
+    CHECK_GT(max_queue_size, 0u);
+    bool dropped_oldest = false;
+    QueueType dropped_value;
+    while (Size() >= max_queue_size && tryPop(&dropped_value)) {
+      dropped_oldest = true;
+    }
+    while (!tryPush(value)) {
+      // Another producer filled the queue in the meantime.
+      dropped_oldest |= tryPop(&dropped_value);
+    }
+    notifyWaiting();
+    return dropped_oldest;
+  }
+
+  // Pops from the queue blocking if queue is empty.
+  bool Pop(QueueType* value) {
+    return PopBlocking(value);
+  }
+
+  // Pops from the queue blocking if queue is empty.
+  bool PopBlocking(QueueType* value) {
+    CHECK_NOTNULL(value);
+    while (!shutdown_) {
+      if (tryPop(value)) {
+        notifyWaiting();
+        return true;
+      }
+      waitFor([this]() { return !Empty(); });
+    }
+    return false;
+  }
+
+  // Check queue is empty, if yes return false, not altering value. If queue not
+  // empty update value and return true.
+  bool PopNonBlocking(QueueType* value) {
+    CHECK_NOTNULL(value);
+    if (!tryPop(value)) {
+      return false;
+    }
+    notifyWaiting();
+    return true;
+  }
+
+  // Waits at most timeout_nanoseconds for a value. Returns false if the queue
+  // is still empty afterwards.
+  bool PopTimeout(QueueType* value, int64_t timeout_nanoseconds) {
+    CHECK_NOTNULL(value);
+    const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() +
+        std::chrono::nanoseconds(timeout_nanoseconds);
+    while (true) {
+      if (tryPop(value)) {
+        notifyWaiting();
+        return true;
+      }
+      const std::chrono::steady_clock::time_point now =
+          std::chrono::steady_clock::now();
+      if (now >= deadline || shutdown_) {
+        return false;
+      }
+      waitFor([this]() { return !Empty(); }, deadline - now);
+    }
+  }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    QueueType data;
+  };
+
+  // Number of lock-free retries before a waiting thread goes to sleep.
+  static constexpr int kNumSpinsBeforeSleeping = 64;
+  // Upper bound for a single sleep; guards against missed notifications.
+  static constexpr int64_t kMaxSleepMicroseconds = 1000;
+
+  bool tryPush(const QueueType& value) {
+    size_t position = enqueue_position_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[position & index_mask_];
+      const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      const intptr_t difference =
+          static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+      if (difference == 0) {
+        if (enqueue_position_.compare_exchange_weak(
+                position, position + 1u, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        // Full.
+        return false;
+      } else {
+        position = enqueue_position_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->data = value;
+    cell->sequence.store(position + 1u, std::memory_order_release);
+    return true;
+  }
+
+  bool tryPop(QueueType* value) {
+    CHECK_NOTNULL(value);
+    size_t position = dequeue_position_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[position & index_mask_];
+      const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      const intptr_t difference = static_cast<intptr_t>(sequence) -
+                                  static_cast<intptr_t>(position + 1u);
+      if (difference == 0) {
+        if (dequeue_position_.compare_exchange_weak(
+                position, position + 1u, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        // Empty.
+        return false;
+      } else {
+        position = dequeue_position_.load(std::memory_order_relaxed);
+      }
+    }
+    // Move, so the cell does not keep resources of the value alive.
+    *value = std::move(cell->data);
+    cell->sequence.store(
+        position + index_mask_ + 1u, std::memory_order_release);
+    return true;
+  }
+
+  // Spins for a short while and then sleeps until notified, the timeout
+  // expired or the predicate is fulfilled.
+  template <typename Predicate>
+  void waitFor(
+      const Predicate& predicate,
+      std::chrono::steady_clock::duration timeout =
+          std::chrono::microseconds(kMaxSleepMicroseconds)) {
+    for (int i = 0; i < kNumSpinsBeforeSleeping; ++i) {
+      if (predicate() || shutdown_) {
+        return;
+      }
+      std::this_thread::yield();
+    }
+    const std::chrono::steady_clock::duration max_sleep =
+        std::chrono::microseconds(kMaxSleepMicroseconds);
+    std::unique_lock<std::mutex> lock(wait_mutex_);
+    ++num_waiting_;
+    wait_condition_.wait_for(
+        lock, timeout < max_sleep ? timeout : max_sleep,
+        [this, &predicate]() { return predicate() || shutdown_; });
+    --num_waiting_;
+  }
+
+  // Only takes the mutex if a thread is sleeping.
+  void notifyWaiting() const {
+    if (num_waiting_.load() > 0u) {
+      NotifyAll();
+    }
+  }
+
+  std::unique_ptr<Cell[]> cells_;
+  size_t capacity_;
+  size_t index_mask_;
+
+  // Keep the producer and consumer indices on separate cache lines.
+  static constexpr size_t kCacheLineSize = 64u;
+  char padding_0_[kCacheLineSize];
+  std::atomic<size_t> enqueue_position_;
+  char padding_1_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> dequeue_position_;
+  char padding_2_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+
+  std::atomic_bool shutdown_;
+
+  mutable std::mutex wait_mutex_;
+  mutable std::condition_variable wait_condition_;
+  std::atomic<size_t> num_waiting_;
+
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(LockFreeBoundedQueue);
+};
+
+template <typename QueueType>
+constexpr size_t LockFreeBoundedQueue<QueueType>::kDefaultCapacity;
+
+}  // namespace common
+
+#endif  // MAPLAB_COMMON_LOCK_FREE_BOUNDED_QUEUE_H_
@@ -19,6 +19,21 @@ struct SaveConfig {
     kMigrateResourcesToExternalFolder
   };
 
+  enum class ProtoCompression {
+    /// Compresses the map files if --proto_use_compression is set.
+    kFromFlags,
+
+    /// Stores the map files uncompressed.
+    kNone,
+
+    /// Uses the fastest compression, e.g. for maps that are saved often.
+    kFast,
+
+    /// Uses the strongest compression, e.g. for maps that are archived or
+    /// sent over slow links.
+    kBest
+  };
+
   /// If true, any pre-existing files on the disk will be overwritten.
   bool overwrite_existing_files = false;
 
@@ -41,6 +56,20 @@ struct SaveConfig {
   /// there is a maximum
   /// file size above which protobuf doesn't read the data anymore.
   size_t vertices_per_proto_file = 200u;
+
+  /// If true and the map is saved to the folder it has last been loaded from
+  /// or saved to, only the map files that changed in between are rewritten.
+  bool save_only_changes = false;
+
+  /// Compression of the map proto files. Every file is compressed on its own,
+  /// so the files are compressed and decompressed in parallel. Loading a map
+  /// detects the compression of every file.
+  ProtoCompression proto_compression = ProtoCompression::kFromFlags;
+
+  /// If true, the keypoints and descriptors of the visual frames are stored
+  /// in binary files next to the vertex proto files, which are
+  /// memory-mapped instead of parsed when the map is loaded.
+  bool store_frame_arrays_in_sections = false;
 };
 
 }  // namespace backend
@@ -2,11 +2,16 @@
 #define MAPLAB_COMMON_MAP_TRAITS_H_
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <glog/logging.h>
 #include <maplab-common/map-manager-config.h>
 
+namespace aslam {
+class ReaderWriterMutex;
+}  // namespace aslam
+
 namespace backend {
 
 /// This needs to be implemented for each map type in order to use the map
@@ -46,13 +51,22 @@ struct MapTraits {
 
   // Copy/merge.
   static void deepCopy(const MapType& source_map, MapType* target_map) {
-    CHECK_NOTNULL(target_map)->deepCopyFrom(source_map);
+    CHECK_NOTNULL(target_map)->deepCopy(source_map);
   }
   static void mergeTwoMaps(
       const MapType& source_map_merge_from, MapType* map_merge_base) {
     CHECK_NOTNULL(map_merge_base)
         ->mergeAllMissionsFromMap(source_map_merge_from);
   }
+  // Leaves the source map in a valid but unspecified state. Map types with an
+  // overload mergeAllMissionsFromMap(MapType&&) move the data of the source
+  // map, all other map types copy it.
+  static void mergeAndConsumeMap(
+      MapType* source_map_merge_from, MapType* map_merge_base) {
+    CHECK_NOTNULL(source_map_merge_from);
+    CHECK_NOTNULL(map_merge_base)
+        ->mergeAllMissionsFromMap(std::move(*source_map_merge_from));
+  }
 
   // Save/load.
 
@@ -80,6 +94,15 @@ struct MapTraits {
       const std::string& folder_path, const SaveConfig& config, MapType* map) {
     return CHECK_NOTNULL(map)->saveToFolder(folder_path, config);
   }
+
+  // Per-mission locking. Only needed for the mission accesses of the map
+  // manager, see MapManager::getMissionWriteAccess(). The mutex must live as
+  // long as the map.
+  template <typename MissionIdType>
+  static aslam::ReaderWriterMutex* getMissionMutex(
+      const MapType& map, const MissionIdType& mission_id) {
+    return map.getMissionMutex(mission_id);
+  }
 };
 
 /// This struct defines the basic functions if you want to use advanced map
@@ -100,7 +123,7 @@ struct MapTraits {
 ///   ...
 ///
 ///   // Also implement the functions from MapInterface.
-///   virtual void deepCopyFrom(const MapType& other) override;
+///   virtual void deepCopy(const MapType& other) override;
 ///   ...
 /// };
 /// \endcode
@@ -0,0 +1,94 @@
+#ifndef MAPLAB_COMMON_MEMORY_ACCOUNTING_H_
+#define MAPLAB_COMMON_MEMORY_ACCOUNTING_H_
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace common {
+
+// Estimated number of heap bytes used by the containers of a data structure,
+// grouped by category. The estimates are based on the container capacities
+// and the per-node overhead of a typical STL implementation, allocator
+// bookkeeping is not taken into account.
+class MemoryUsage {
+ public:
+  enum class Category {
+    kDescriptors,
+    kKeypoints,
+    kLandmarkObservations,
+    kLandmarks,
+    kVertices,
+    kEdges,
+    kCachedResources,
+    kIndexStructures,
+    kOther,
+    kNumCategories
+  };
+
+  MemoryUsage();
+
+  void add(Category category, size_t num_bytes);
+  void merge(const MemoryUsage& other);
+  void clear();
+
+  size_t getBytes(Category category) const;
+  size_t getTotalBytes() const;
+
+  // One line per category with a non-zero number of bytes, plus the total.
+  std::string toString() const;
+
+  static const char* getCategoryName(Category category);
+
+ private:
+  static constexpr size_t kNumCategories =
+      static_cast<size_t>(Category::kNumCategories);
+  std::array<size_t, kNumCategories> bytes_per_category_;
+};
+
+// Formats a number of bytes with a binary prefix, e.g. "1.50 GiB".
+std::string formatBytes(size_t num_bytes);
+
+template <typename Type, typename Allocator>
+size_t getHeapBytes(const std::vector<Type, Allocator>& vector) {
+  return vector.capacity() * sizeof(Type);
+}
+
+template <typename Scalar, int Rows, int Cols, int Options, int MaxRows,
+          int MaxCols>
+size_t getHeapBytes(
+    const Eigen::Matrix<Scalar, Rows, Cols, Options, MaxRows, MaxCols>&
+        matrix) {
+  if (Rows != Eigen::Dynamic && Cols != Eigen::Dynamic) {
+    return 0u;
+  }
+  return static_cast<size_t>(matrix.size()) * sizeof(Scalar);
+}
+
+// Each node holds the value, the cached hash and the next pointer, the bucket
+// array one pointer per bucket.
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Allocator>
+size_t getHeapBytes(
+    const std::unordered_map<Key, Value, Hash, Equal, Allocator>& map) {
+  typedef typename std::unordered_map<Key, Value, Hash, Equal,
+                                      Allocator>::value_type ValueType;
+  return map.size() * (sizeof(ValueType) + sizeof(void*) + sizeof(size_t)) +
+         map.bucket_count() * sizeof(void*);
+}
+
+template <typename Key, typename Hash, typename Equal, typename Allocator>
+size_t getHeapBytes(
+    const std::unordered_set<Key, Hash, Equal, Allocator>& set) {
+  return set.size() * (sizeof(Key) + sizeof(void*) + sizeof(size_t)) +
+         set.bucket_count() * sizeof(void*);
+}
+
+}  // namespace common
+
+#endif  // MAPLAB_COMMON_MEMORY_ACCOUNTING_H_
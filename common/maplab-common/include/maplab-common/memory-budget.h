@@ -0,0 +1,83 @@
+#ifndef MAPLAB_COMMON_MEMORY_BUDGET_H_
+#define MAPLAB_COMMON_MEMORY_BUDGET_H_
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <maplab-common/macros.h>
+
+namespace common {
+
+// Process-wide memory budget, set with --memory_budget_mb. Components that
+// hold memory they can give back, e.g. caches of data that can be reloaded
+// from disk, register as consumers. Code that is about to allocate a lot of
+// memory calls requestMemory() first, which asks the consumers to release
+// memory if the resident memory of the process plus the request exceeds the
+// budget. This way, large commands evict and spill data instead of running
+// out of memory. Without a budget, every request succeeds and the consumers
+// are never asked. This class is thread-safe.
+class MemoryBudget {
+ public:
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(MemoryBudget);
+
+  class Consumer {
+   public:
+    virtual ~Consumer() {}
+
+    virtual std::string getMemoryConsumerName() const = 0;
+
+    // Estimated number of bytes the consumer could release right now.
+    virtual size_t getReleasableMemoryBytes() const = 0;
+
+    // Releases about num_bytes, e.g. by evicting or spilling data, and
+    // returns the number of bytes released. Consumers that can only shrink at
+    // a later, safe point return 0 and shrink then. Called on the thread that
+    // requests memory, while the budget is locked, so it must not request
+    // memory or (un)register consumers itself.
+    virtual size_t releaseMemory(size_t num_bytes) = 0;
+  };
+
+  // Returns the budget of the process, initialized from the flags.
+  static MemoryBudget& getInstance();
+
+  MemoryBudget();
+  explicit MemoryBudget(size_t budget_bytes);
+
+  // Consumers have to unregister before they are destroyed.
+  void registerConsumer(Consumer* consumer);
+  void unregisterConsumer(Consumer* consumer);
+  size_t getNumConsumers() const;
+
+  bool hasBudget() const;
+  size_t getBudgetBytes() const;
+  // 0 means no budget.
+  void setBudgetBytes(size_t budget_bytes);
+
+  // Asks the consumers, the one with the most releasable memory first, to
+  // release memory until num_bytes fit in the budget. Returns false if they
+  // don't fit even after the consumers released all they could, the caller
+  // can then degrade, e.g. process less data at once, or go ahead anyway.
+  bool requestMemory(size_t num_bytes, const std::string& requester);
+
+  // The current resident memory of the process, read from /proc/self/statm.
+  // Can be replaced, e.g. for tests.
+  typedef std::function<size_t()> ResidentBytesFunction;
+  void setResidentBytesFunction(const ResidentBytesFunction& function);
+  size_t getResidentBytes() const;
+
+ private:
+  mutable std::mutex mutex_;
+  size_t budget_bytes_;
+  std::vector<Consumer*> consumers_;
+  ResidentBytesFunction resident_bytes_function_;
+};
+
+// Reads the resident set size of the process, 0 if it is not available.
+size_t getProcessResidentBytes();
+
+}  // namespace common
+
+#endif  // MAPLAB_COMMON_MEMORY_BUDGET_H_
@@ -0,0 +1,51 @@
+#ifndef MAPLAB_COMMON_MEMORY_MAPPED_FILE_H_
+#define MAPLAB_COMMON_MEMORY_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+#include <maplab-common/macros.h>
+
+namespace common {
+
+// Maps a file read-only into the address space of the process. The kernel
+// pages the content in on first access, so opening is cheap regardless of the
+// file size and the pages are shared with the page cache. This is not thread
+// safe, but the mapped data can be read concurrently.
+class MemoryMappedFile {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(MemoryMappedFile);
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(MemoryMappedFile);
+
+  MemoryMappedFile();
+  ~MemoryMappedFile();
+
+  // Closes a previously opened file. Returns false if the file cannot be
+  // opened or mapped.
+  bool open(const std::string& file_path);
+  void close();
+
+  bool isOpen() const {
+    return is_open_;
+  }
+  // The data is nullptr for empty files.
+  const char* data() const {
+    return data_;
+  }
+  size_t size() const {
+    return size_;
+  }
+
+  // Hints the kernel that the whole file will be read sequentially soon, so
+  // it reads ahead in large chunks.
+  void adviseSequentialRead() const;
+
+ private:
+  bool is_open_;
+  const char* data_;
+  size_t size_;
+};
+
+}  // namespace common
+
+#endif  // MAPLAB_COMMON_MEMORY_MAPPED_FILE_H_
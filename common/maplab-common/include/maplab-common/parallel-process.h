@@ -1,10 +1,12 @@
 #ifndef MAPLAB_COMMON_PARALLEL_PROCESS_H_
 #define MAPLAB_COMMON_PARALLEL_PROCESS_H_
+#include <algorithm>
+#include <atomic>
 #include <cmath>
-#include <thread>  // NOLINT
 #include <vector>
 
 #include <glog/logging.h>
+#include <maplab-common/thread-pool.h>
 #include <maplab-common/threading-helpers.h>
 
 // This is a helper to call a user provided functor or lamda with block indices
@@ -32,6 +34,21 @@
 //
 // Squarer squarer(data, &results);
 // ParallelProcess(data.size(), squarer, true, 16);
+//
+// The blocks are dispatched onto the process-wide ThreadPool and the calling
+// thread processes blocks as well. Nested calls (ParallelProcess from within
+// a functor) are therefore safe and don't spawn additional threads.
+//
+// If the work per item is very uneven, use ParallelProcessDynamic instead. It
+// calls the functor with half-open index ranges [begin, end) that are handed
+// out lazily to whichever thread is idle:
+// std::function<void(size_t, size_t)> range_squarer =
+//     [&data, &results](size_t begin, size_t end) {
+//       for (size_t i = begin; i < end; ++i) {
+//         results[i] = data[i] * data[i];
+//       }
+//     };
+// ParallelProcessDynamic(data.size(), range_squarer, 16);
 
 namespace common {
 
@@ -62,7 +79,6 @@ void ParallelProcess(
   }
 
   size_t data_index = start_index;
-  std::vector<std::thread> threads;
   for (size_t block_idx = 0u; block_idx < blocks.size(); ++block_idx) {
     std::vector<size_t>& block = blocks[block_idx];
     for (size_t item_idx = 0u;
@@ -73,14 +89,21 @@ void ParallelProcess(
       block.push_back(data_index);
       ++data_index;
     }
-    threads.push_back(
-        std::thread([&functor, &block]() -> void { functor(block); }));
   }
 
-  CHECK_EQ(threads.size(), blocks.size());
-  for (size_t block_idx = 0; block_idx < blocks.size(); ++block_idx) {
-    threads[block_idx].join();
+  if (blocks.size() == 1u) {
+    functor(blocks.front());
+    return;
+  }
+
+  // The first block is processed on the calling thread.
+  ThreadPoolTaskGroup task_group(&ThreadPool::getGlobal());
+  for (size_t block_idx = 1u; block_idx < blocks.size(); ++block_idx) {
+    const std::vector<size_t>& block = blocks[block_idx];
+    task_group.run([&functor, &block]() -> void { functor(block); });
   }
+  functor(blocks.front());
+  task_group.wait();
 }
 
 // Usually batches which are too small are not threaded. Set
@@ -104,5 +127,101 @@ void ParallelProcess(
       kStartIndex, end_index, functor, always_parallelize, num_threads);
 }
 
+enum class ParallelSchedule {
+  // Chunks of a fixed size (min_chunk_size).
+  kDynamic,
+  // Chunks proportional to the number of remaining items divided by the
+  // number of threads, but at least min_chunk_size. Large chunks at the
+  // beginning keep the scheduling overhead low, small chunks at the end
+  // balance the load.
+  kGuided
+};
+
+namespace internal {
+inline bool claimNextRange(
+    const size_t end_index, const size_t num_threads,
+    const ParallelSchedule schedule, const size_t min_chunk_size,
+    std::atomic<size_t>* next_index, size_t* range_begin, size_t* range_end) {
+  CHECK_NOTNULL(next_index);
+  CHECK_NOTNULL(range_begin);
+  CHECK_NOTNULL(range_end);
+
+  size_t begin = next_index->load();
+  size_t chunk_size;
+  do {
+    if (begin >= end_index) {
+      return false;
+    }
+    chunk_size = min_chunk_size;
+    if (schedule == ParallelSchedule::kGuided) {
+      chunk_size =
+          std::max(min_chunk_size, (end_index - begin) / (2u * num_threads));
+    }
+    chunk_size = std::min(chunk_size, end_index - begin);
+  } while (!next_index->compare_exchange_weak(begin, begin + chunk_size));
+
+  *range_begin = begin;
+  *range_end = begin + chunk_size;
+  return true;
+}
+}  // namespace internal
+
+// Processes the indices in [start_index, end_index) by calling the functor
+// with consecutive ranges (begin, end) which are claimed lazily by the
+// participating threads. No per-index storage is allocated.
+template <typename RangeFunctor>
+void ParallelProcessDynamic(
+    const size_t start_index, const size_t end_index,
+    const RangeFunctor& functor, const size_t num_threads,
+    const ParallelSchedule schedule = ParallelSchedule::kGuided,
+    const size_t min_chunk_size = 1u) {
+  CHECK_GT(end_index, start_index)
+      << "End index needs to be bigger than the start index.";
+  CHECK_GT(num_threads, 0u) << "Num threads must be larger than 0.";
+  CHECK_GT(min_chunk_size, 0u);
+
+  const size_t num_items = end_index - start_index;
+  const size_t num_chunks_min_size =
+      (num_items + min_chunk_size - 1u) / min_chunk_size;
+  const size_t num_workers = std::min(num_threads, num_chunks_min_size);
+  if (num_workers <= 1u) {
+    functor(start_index, end_index);
+    return;
+  }
+
+  std::atomic<size_t> next_index(start_index);
+  auto worker = [&]() -> void {
+    size_t range_begin, range_end;
+    while (internal::claimNextRange(
+        end_index, num_workers, schedule, min_chunk_size, &next_index,
+        &range_begin, &range_end)) {
+      functor(range_begin, range_end);
+    }
+  };
+
+  // The calling thread is one of the workers.
+  ThreadPoolTaskGroup task_group(&ThreadPool::getGlobal());
+  for (size_t worker_idx = 1u; worker_idx < num_workers; ++worker_idx) {
+    task_group.run(worker);
+  }
+  worker();
+  task_group.wait();
+}
+
+template <typename RangeFunctor>
+void ParallelProcessDynamic(
+    const size_t num_items, const RangeFunctor& functor,
+    const size_t num_threads,
+    const ParallelSchedule schedule = ParallelSchedule::kGuided,
+    const size_t min_chunk_size = 1u) {
+  if (num_items == 0u) {
+    // Nothing to do here.
+    return;
+  }
+  constexpr size_t kStartIndex = 0u;
+  ParallelProcessDynamic(
+      kStartIndex, num_items, functor, num_threads, schedule, min_chunk_size);
+}
+
 }  // namespace common
 #endif  // MAPLAB_COMMON_PARALLEL_PROCESS_H_
@@ -8,6 +8,13 @@
 namespace common {
 namespace proto_serialization_helper {
 
+/// zlib compression levels of binary proto files. Parsing detects whether a
+/// file is compressed, so files written with any level can be parsed.
+constexpr int kNoCompression = 0;
+constexpr int kFastestCompression = 1;
+constexpr int kDefaultCompression = -1;
+constexpr int kBestCompression = 9;
+
 /// Parses a proto file named \p file_name in the folder \p folder_path and
 /// deserializes it into the given protobuf object \p proto.
 bool parseProtoFromFile(
@@ -25,6 +32,13 @@ bool serializeProtoToFile(
 bool serializeProtoToFile(
     const std::string& folder_path, const std::string& file_name,
     const google::protobuf::Message& proto, const bool use_text_format);
+/// Same as serializeProtoToFile, but compresses the binary proto with the
+/// given zlib level instead of the one set by --proto_use_compression.
+bool serializeProtoToFileWithCompression(
+    const std::string& folder_path, const std::string& file_name,
+    const google::protobuf::Message& proto, const int compression_level);
+/// The compression level serializeProtoToFile uses.
+int getCompressionLevelFromFlags();
 
 // Note: raw_data needs to be manually deleted afterwards, the caller takes
 // ownership of the data!
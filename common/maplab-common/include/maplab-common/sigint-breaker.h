@@ -1,10 +1,26 @@
 #ifndef MAPLAB_COMMON_SIGINT_BREAKER_H_
 #define MAPLAB_COMMON_SIGINT_BREAKER_H_
 
+#include <atomic>
+
 namespace common {
 
 class SigintBreaker {
  public:
+  // Threads that don't receive SIGINT, e.g. the background jobs of the
+  // console, install a break request source instead. While it is alive,
+  // SigintBreakers created on the same thread report its break requests and
+  // don't touch the SIGINT handler.
+  class ScopedBreakRequestSource {
+   public:
+    explicit ScopedBreakRequestSource(
+        const std::atomic<bool>* is_break_requested);
+    ~ScopedBreakRequestSource();
+
+   private:
+    const std::atomic<bool>* previous_break_request_;
+  };
+
   SigintBreaker();
   ~SigintBreaker();
   bool isBreakRequested() const;
@@ -14,6 +30,9 @@ class SigintBreaker {
 
   static bool is_instantiated_;
   static bool is_sigint_raised_;
+  static thread_local const std::atomic<bool>* thread_break_request_;
+
+  const std::atomic<bool>* const break_request_;
   void (*previous_handler_)(int);  // NOLINT
 };
 
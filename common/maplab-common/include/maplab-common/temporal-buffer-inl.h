@@ -52,6 +52,17 @@ void TemporalBuffer<ValueType, AllocatorType>::addValue(
   removeOutdatedItems();
 }
 
+template <typename ValueType, typename AllocatorType>
+template <typename InputIterator>
+void TemporalBuffer<ValueType, AllocatorType>::addValues(
+    InputIterator begin, InputIterator end) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  for (InputIterator it = begin; it != end; ++it) {
+    values_.emplace_hint(values_.end(), it->first, it->second);
+  }
+  removeOutdatedItems();
+}
+
 template <typename ValueType, typename AllocatorType>
 bool TemporalBuffer<ValueType, AllocatorType>::deleteValueAtTime(
     int64_t timestamp_ns) {
@@ -242,7 +253,7 @@ bool TemporalBuffer<ValueType, AllocatorType>::getNearestValueToTime(
     int64_t delta_ns = std::abs(it_last->first - timestamp);
     if (delta_ns <= maximum_delta_ns) {
       *value = it_last->second;
-      *timestamp_at_value_ns = it_lower->first;
+      *timestamp_at_value_ns = it_last->first;
       return true;
     } else {
       return false;
@@ -256,7 +267,7 @@ bool TemporalBuffer<ValueType, AllocatorType>::getNearestValueToTime(
     int64_t delta_ns = std::abs(it_first->first - timestamp);
     if (delta_ns <= maximum_delta_ns) {
       *value = it_first->second;
-      *timestamp_at_value_ns = it_lower->first;
+      *timestamp_at_value_ns = it_first->first;
       return true;
     } else {
       return false;
@@ -271,13 +282,13 @@ bool TemporalBuffer<ValueType, AllocatorType>::getNearestValueToTime(
   if (delta_before_ns < delta_after_ns) {
     if (delta_before_ns <= maximum_delta_ns) {
       *value = it_before->second;
-      *timestamp_at_value_ns = it_lower->first;
+      *timestamp_at_value_ns = it_before->first;
       return true;
     }
   } else {
     if (delta_after_ns <= maximum_delta_ns) {
       *value = it_upper->second;
-      *timestamp_at_value_ns = it_lower->first;
+      *timestamp_at_value_ns = it_upper->first;
       return true;
     }
   }
@@ -36,6 +36,12 @@ class TemporalBuffer {
       const bool emit_warning_on_value_overwrite);
   void insert(const TemporalBuffer& other);
 
+  // Adds a range of (timestamp, value) pairs under one lock. Values sorted by
+  // timestamp are appended in amortized constant time each. Like addValue(),
+  // doesn't overwrite existing values.
+  template <typename InputIterator>
+  void addValues(InputIterator begin, InputIterator end);
+
   inline size_t size() const {
     std::lock_guard<std::recursive_mutex> lock(mutex_);
     return values_.size();
@@ -0,0 +1,387 @@
+#ifndef MAPLAB_COMMON_TEMPORAL_RING_BUFFER_INL_H_
+#define MAPLAB_COMMON_TEMPORAL_RING_BUFFER_INL_H_
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <mutex>
+
+#include <glog/logging.h>
+
+namespace common {
+
+template <typename ValueType, typename AllocatorType>
+TemporalRingBuffer<ValueType, AllocatorType>::TemporalRingBuffer()
+    : TemporalRingBuffer(-1, 0u) {}
+
+template <typename ValueType, typename AllocatorType>
+TemporalRingBuffer<ValueType, AllocatorType>::TemporalRingBuffer(
+    int64_t buffer_length_nanoseconds)
+    : TemporalRingBuffer(buffer_length_nanoseconds, 0u) {}
+
+template <typename ValueType, typename AllocatorType>
+TemporalRingBuffer<ValueType, AllocatorType>::TemporalRingBuffer(
+    int64_t buffer_length_nanoseconds, size_t max_num_values)
+    : head_index_(0u),
+      num_values_(0u),
+      buffer_length_nanoseconds_(buffer_length_nanoseconds),
+      max_num_values_(max_num_values) {}
+
+template <typename ValueType, typename AllocatorType>
+TemporalRingBuffer<ValueType, AllocatorType>::TemporalRingBuffer(
+    const TemporalRingBuffer<ValueType, AllocatorType>& other) {
+  std::lock_guard<std::mutex> lock(other.mutex_);
+  // Linearize the values on copy.
+  storage_.reserve(other.num_values_);
+  for (size_t i = 0u; i < other.num_values_; ++i) {
+    storage_.push_back(other.valueAtIndex(i));
+  }
+  head_index_ = 0u;
+  num_values_ = other.num_values_;
+  buffer_length_nanoseconds_ = other.buffer_length_nanoseconds_;
+  max_num_values_ = other.max_num_values_;
+}
+
+template <typename ValueType, typename AllocatorType>
+void TemporalRingBuffer<ValueType, AllocatorType>::addValue(
+    const int64_t timestamp, const ValueType& value) {
+  constexpr bool kEmitWarningOnValueOverwrite = false;
+  addValue(timestamp, value, kEmitWarningOnValueOverwrite);
+}
+
+template <typename ValueType, typename AllocatorType>
+void TemporalRingBuffer<ValueType, AllocatorType>::addValue(
+    const int64_t timestamp, const ValueType& value,
+    const bool emit_warning_on_value_overwrite) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  addValueImpl(timestamp, value, emit_warning_on_value_overwrite);
+  removeOutdatedItems();
+}
+
+template <typename ValueType, typename AllocatorType>
+void TemporalRingBuffer<ValueType, AllocatorType>::addValueImpl(
+    const int64_t timestamp, const ValueType& value,
+    const bool emit_warning_on_value_overwrite) {
+  // Fast path: appending in chronological order.
+  size_t insert_index = num_values_;
+  if (num_values_ > 0u && valueAtIndex(num_values_ - 1u).first >= timestamp) {
+    insert_index = lowerBoundIndex(timestamp);
+    if (insert_index < num_values_ &&
+        valueAtIndex(insert_index).first == timestamp) {
+      // Same behavior as TemporalBuffer: the existing value is kept.
+      LOG_IF(WARNING, emit_warning_on_value_overwrite)
+          << "A value in temporal buffer at time " << timestamp
+          << " already exists!";
+      return;
+    }
+  }
+
+  if (num_values_ == storage_.size()) {
+    if (max_num_values_ == 0u || storage_.size() < max_num_values_) {
+      growStorage();
+    } else {
+      if (insert_index == 0u) {
+        // The value would be the oldest one and dropped right away.
+        return;
+      }
+      dropOldestValues(1u);
+      --insert_index;
+    }
+  }
+
+  ++num_values_;
+  for (size_t i = num_values_ - 1u; i > insert_index; --i) {
+    valueAtIndex(i) = valueAtIndex(i - 1u);
+  }
+  value_type& new_value = valueAtIndex(insert_index);
+  new_value.first = timestamp;
+  new_value.second = value;
+}
+
+template <typename ValueType, typename AllocatorType>
+void TemporalRingBuffer<ValueType, AllocatorType>::growStorage() {
+  CHECK_EQ(num_values_, storage_.size());
+  constexpr size_t kMinStorageSize = 16u;
+  size_t new_storage_size = std::max(kMinStorageSize, 2u * storage_.size());
+  if (max_num_values_ > 0u) {
+    new_storage_size = std::min(new_storage_size, max_num_values_);
+  }
+  CHECK_GT(new_storage_size, storage_.size());
+
+  // Linearize such that the oldest value is at the front again.
+  std::rotate(
+      storage_.begin(), storage_.begin() + head_index_, storage_.end());
+  head_index_ = 0u;
+  storage_.resize(new_storage_size);
+}
+
+template <typename ValueType, typename AllocatorType>
+void TemporalRingBuffer<ValueType, AllocatorType>::reserve(size_t num_values) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (max_num_values_ > 0u) {
+    num_values = std::min(num_values, max_num_values_);
+  }
+  if (num_values <= storage_.size()) {
+    return;
+  }
+  // Linearize such that the new storage is appended after the newest value.
+  std::rotate(
+      storage_.begin(), storage_.begin() + head_index_, storage_.end());
+  head_index_ = 0u;
+  storage_.resize(num_values);
+}
+
+template <typename ValueType, typename AllocatorType>
+void TemporalRingBuffer<ValueType, AllocatorType>::dropOldestValues(
+    size_t num_values_to_drop) {
+  CHECK_LE(num_values_to_drop, num_values_);
+  num_values_ -= num_values_to_drop;
+  head_index_ = num_values_ == 0u ? 0u : storageIndex(num_values_to_drop);
+}
+
+template <typename ValueType, typename AllocatorType>
+size_t TemporalRingBuffer<ValueType, AllocatorType>::lowerBoundIndex(
+    int64_t timestamp) const {
+  size_t first = 0u;
+  size_t count = num_values_;
+  while (count > 0u) {
+    const size_t step = count / 2u;
+    const size_t index = first + step;
+    if (valueAtIndex(index).first < timestamp) {
+      first = index + 1u;
+      count -= step + 1u;
+    } else {
+      count = step;
+    }
+  }
+  return first;
+}
+
+template <typename ValueType, typename AllocatorType>
+bool TemporalRingBuffer<ValueType, AllocatorType>::deleteValueAtTime(
+    int64_t timestamp_ns) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const size_t index = lowerBoundIndex(timestamp_ns);
+  if (index == num_values_ || valueAtIndex(index).first != timestamp_ns) {
+    return false;
+  }
+  if (index == 0u) {
+    dropOldestValues(1u);
+    return true;
+  }
+  for (size_t i = index; i + 1u < num_values_; ++i) {
+    valueAtIndex(i) = valueAtIndex(i + 1u);
+  }
+  --num_values_;
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+bool TemporalRingBuffer<ValueType, AllocatorType>::getOldestValue(
+    ValueType* value) const {
+  CHECK_NOTNULL(value);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (num_values_ == 0u) {
+    return false;
+  }
+  *value = valueAtIndex(0u).second;
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+bool TemporalRingBuffer<ValueType, AllocatorType>::getNewestValue(
+    ValueType* value) const {
+  CHECK_NOTNULL(value);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (num_values_ == 0u) {
+    return false;
+  }
+  *value = valueAtIndex(num_values_ - 1u).second;
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+bool TemporalRingBuffer<ValueType, AllocatorType>::getValueAtTime(
+    int64_t timestamp, ValueType* value) const {
+  CHECK_NOTNULL(value);
+  std::lock_guard<std::mutex> lock(mutex_);
+  const size_t index = lowerBoundIndex(timestamp);
+  if (index < num_values_ && valueAtIndex(index).first == timestamp) {
+    *value = valueAtIndex(index).second;
+    return true;
+  }
+  return false;
+}
+
+template <typename ValueType, typename AllocatorType>
+bool TemporalRingBuffer<ValueType, AllocatorType>::getNearestValueToTime(
+    int64_t timestamp, ValueType* value) const {
+  CHECK_NOTNULL(value);
+  return getNearestValueToTime(
+      timestamp, std::numeric_limits<int64_t>::max(), value);
+}
+
+template <typename ValueType, typename AllocatorType>
+bool TemporalRingBuffer<ValueType, AllocatorType>::getNearestValueToTime(
+    int64_t timestamp, int64_t maximum_delta_ns, ValueType* value) const {
+  int64_t timestamp_at_value_ns;
+  return getNearestValueToTime(
+      timestamp, maximum_delta_ns, value, &timestamp_at_value_ns);
+}
+
+template <typename ValueType, typename AllocatorType>
+bool TemporalRingBuffer<ValueType, AllocatorType>::getNearestValueToTime(
+    int64_t timestamp, int64_t maximum_delta_ns, ValueType* value,
+    int64_t* timestamp_at_value_ns) const {
+  CHECK_NOTNULL(timestamp_at_value_ns);
+  CHECK_NOTNULL(value);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (num_values_ == 0u) {
+    return false;
+  }
+
+  const size_t index_after = lowerBoundIndex(timestamp);
+  size_t nearest_index;
+  if (index_after == num_values_) {
+    nearest_index = num_values_ - 1u;
+  } else if (index_after == 0u) {
+    nearest_index = 0u;
+  } else {
+    const int64_t delta_before_ns =
+        std::abs(valueAtIndex(index_after - 1u).first - timestamp);
+    const int64_t delta_after_ns =
+        std::abs(valueAtIndex(index_after).first - timestamp);
+    nearest_index =
+        delta_before_ns < delta_after_ns ? index_after - 1u : index_after;
+  }
+
+  const value_type& nearest_value = valueAtIndex(nearest_index);
+  if (std::abs(nearest_value.first - timestamp) > maximum_delta_ns) {
+    return false;
+  }
+  *value = nearest_value.second;
+  *timestamp_at_value_ns = nearest_value.first;
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+bool TemporalRingBuffer<ValueType, AllocatorType>::getValueAtOrBeforeTime(
+    int64_t timestamp, int64_t* timestamp_of_value, ValueType* value) const {
+  CHECK_NOTNULL(timestamp_of_value);
+  CHECK_NOTNULL(value);
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t index = lowerBoundIndex(timestamp);
+  if (index == num_values_ || valueAtIndex(index).first != timestamp) {
+    if (index == 0u) {
+      return false;
+    }
+    --index;
+  }
+  *timestamp_of_value = valueAtIndex(index).first;
+  *value = valueAtIndex(index).second;
+
+  CHECK_LE(*timestamp_of_value, timestamp);
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+bool TemporalRingBuffer<ValueType, AllocatorType>::getValueAtOrAfterTime(
+    int64_t timestamp, int64_t* timestamp_of_value, ValueType* value) const {
+  CHECK_NOTNULL(timestamp_of_value);
+  CHECK_NOTNULL(value);
+  std::lock_guard<std::mutex> lock(mutex_);
+  const size_t index = lowerBoundIndex(timestamp);
+  if (index == num_values_) {
+    return false;
+  }
+  *timestamp_of_value = valueAtIndex(index).first;
+  *value = valueAtIndex(index).second;
+
+  CHECK_GE(*timestamp_of_value, timestamp);
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+template <typename ValueContainerType>
+bool TemporalRingBuffer<ValueType, AllocatorType>::getValuesBetweenTimes(
+    int64_t timestamp_lower_ns, int64_t timestamp_higher_ns,
+    ValueContainerType* values) const {
+  CHECK_NOTNULL(values)->clear();
+  CHECK_GT(timestamp_higher_ns, timestamp_lower_ns);
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  // Early exit if there are too few items.
+  if (num_values_ < 3u) {
+    return false;
+  }
+
+  const int64_t oldest_timestamp = valueAtIndex(0u).first;
+  const int64_t latest_timestamp = valueAtIndex(num_values_ - 1u).first;
+  if (oldest_timestamp > timestamp_lower_ns ||
+      timestamp_higher_ns > latest_timestamp) {
+    return false;
+  }
+
+  // Border values are excluded.
+  for (size_t index = lowerBoundIndex(timestamp_lower_ns + 1);
+       index < num_values_ && valueAtIndex(index).first < timestamp_higher_ns;
+       ++index) {
+    values->emplace_back(valueAtIndex(index).second);
+  }
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+void TemporalRingBuffer<ValueType, AllocatorType>::removeOutdatedItems() {
+  if (num_values_ == 0u || buffer_length_nanoseconds_ <= 0) {
+    return;
+  }
+
+  const int64_t newest_timestamp_ns = valueAtIndex(num_values_ - 1u).first;
+  const int64_t buffer_threshold_ns =
+      newest_timestamp_ns - buffer_length_nanoseconds_;
+  if (valueAtIndex(0u).first < buffer_threshold_ns) {
+    dropOldestValues(lowerBoundIndex(buffer_threshold_ns));
+  }
+}
+
+template <typename ValueType, typename AllocatorType>
+void TemporalRingBuffer<ValueType, AllocatorType>::insert(
+    const TemporalRingBuffer& other) {
+  CHECK_NE(this, &other);
+  std::lock(mutex_, other.mutex_);
+  std::lock_guard<std::mutex> lock(mutex_, std::adopt_lock);
+  std::lock_guard<std::mutex> other_lock(other.mutex_, std::adopt_lock);
+  constexpr bool kEmitWarningOnValueOverwrite = false;
+  for (size_t i = 0u; i < other.num_values_; ++i) {
+    const value_type& other_value = other.valueAtIndex(i);
+    addValueImpl(
+        other_value.first, other_value.second, kEmitWarningOnValueOverwrite);
+  }
+  removeOutdatedItems();
+}
+
+template <typename ValueType, typename AllocatorType>
+bool TemporalRingBuffer<ValueType, AllocatorType>::operator==(
+    const TemporalRingBuffer& other) const {
+  if (this == &other) {
+    return true;
+  }
+  std::lock(mutex_, other.mutex_);
+  std::lock_guard<std::mutex> lock(mutex_, std::adopt_lock);
+  std::lock_guard<std::mutex> other_lock(other.mutex_, std::adopt_lock);
+  if (num_values_ != other.num_values_ ||
+      buffer_length_nanoseconds_ != other.buffer_length_nanoseconds_ ||
+      max_num_values_ != other.max_num_values_) {
+    return false;
+  }
+  for (size_t i = 0u; i < num_values_; ++i) {
+    if (!(valueAtIndex(i) == other.valueAtIndex(i))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace common
+#endif  // MAPLAB_COMMON_TEMPORAL_RING_BUFFER_INL_H_
@@ -0,0 +1,276 @@
+#ifndef MAPLAB_COMMON_TEMPORAL_RING_BUFFER_H_
+#define MAPLAB_COMMON_TEMPORAL_RING_BUFFER_H_
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/macros.h>
+
+namespace common {
+
+// Time-sorted buffer with the same interface as TemporalBuffer, but the
+// values are stored in one contiguous ring buffer instead of a std::map. This
+// avoids one heap allocation per value and lookups are binary searches on
+// contiguous memory. Appending values in chronological order and dropping the
+// oldest values is O(1); inserting a value in the middle of the buffer is
+// linear in the number of newer values.
+//
+// Besides the time-based buffer length, the number of values can be bounded.
+// If the capacity is reached, the oldest value is dropped. With an unbounded
+// capacity (max_num_values == 0) the ring buffer grows like a std::vector.
+//
+// In contrast to TemporalBuffer the mutex is not recursive, so no other
+// method must be called between lockContainer() and unlockContainer().
+template <typename ValueType,
+          typename AllocatorType =
+              std::allocator<std::pair<int64_t, ValueType> > >
+class TemporalRingBuffer {
+ public:
+  typedef std::pair<int64_t, ValueType> value_type;
+  MAPLAB_POINTER_TYPEDEFS(TemporalRingBuffer);
+
+  // Random access iterator over the values in chronological order.
+  class const_iterator {
+   public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef typename TemporalRingBuffer::value_type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const value_type* pointer;
+    typedef const value_type& reference;
+
+    const_iterator() : buffer_(nullptr), index_(0u) {}
+    const_iterator(const TemporalRingBuffer* buffer, size_t index)
+        : buffer_(buffer), index_(index) {}
+
+    reference operator*() const {
+      return buffer_->valueAtIndex(index_);
+    }
+    pointer operator->() const {
+      return &buffer_->valueAtIndex(index_);
+    }
+    reference operator[](difference_type offset) const {
+      return buffer_->valueAtIndex(index_ + offset);
+    }
+    const_iterator& operator++() {
+      ++index_;
+      return *this;
+    }
+    const_iterator operator++(int) {  // NOLINT
+      const_iterator previous = *this;
+      ++index_;
+      return previous;
+    }
+    const_iterator& operator--() {
+      --index_;
+      return *this;
+    }
+    const_iterator operator--(int) {  // NOLINT
+      const_iterator previous = *this;
+      --index_;
+      return previous;
+    }
+    const_iterator& operator+=(difference_type offset) {
+      index_ += offset;
+      return *this;
+    }
+    const_iterator& operator-=(difference_type offset) {
+      index_ -= offset;
+      return *this;
+    }
+    const_iterator operator+(difference_type offset) const {
+      return const_iterator(buffer_, index_ + offset);
+    }
+    const_iterator operator-(difference_type offset) const {
+      return const_iterator(buffer_, index_ - offset);
+    }
+    difference_type operator-(const const_iterator& other) const {
+      return static_cast<difference_type>(index_) -
+             static_cast<difference_type>(other.index_);
+    }
+    bool operator==(const const_iterator& other) const {
+      return buffer_ == other.buffer_ && index_ == other.index_;
+    }
+    bool operator!=(const const_iterator& other) const {
+      return !(*this == other);
+    }
+    bool operator<(const const_iterator& other) const {
+      return index_ < other.index_;
+    }
+    bool operator>(const const_iterator& other) const {
+      return index_ > other.index_;
+    }
+    bool operator<=(const const_iterator& other) const {
+      return index_ <= other.index_;
+    }
+    bool operator>=(const const_iterator& other) const {
+      return index_ >= other.index_;
+    }
+
+   private:
+    const TemporalRingBuffer* buffer_;
+    size_t index_;
+  };
+
+  // Lightweight view on the buffered values that can be iterated over like the
+  // std::map exposed by TemporalBuffer.
+  class BufferType {
+   public:
+    typedef typename TemporalRingBuffer::value_type value_type;
+    typedef typename TemporalRingBuffer::const_iterator const_iterator;
+    typedef const_iterator iterator;
+
+    explicit BufferType(const TemporalRingBuffer* buffer)
+        : buffer_(CHECK_NOTNULL(buffer)) {}
+
+    const_iterator begin() const {
+      return const_iterator(buffer_, 0u);
+    }
+    const_iterator end() const {
+      return const_iterator(buffer_, buffer_->num_values_);
+    }
+    size_t size() const {
+      return buffer_->num_values_;
+    }
+    bool empty() const {
+      return buffer_->num_values_ == 0u;
+    }
+
+   private:
+    const TemporalRingBuffer* buffer_;
+  };
+
+  // Create buffer of infinite length (buffer_length_nanoseconds = -1) and
+  // unbounded capacity.
+  TemporalRingBuffer();
+
+  // Buffer length in nanoseconds defines after which time old entries get
+  // dropped. (buffer_length_nanoseconds == -1: infinite length.)
+  explicit TemporalRingBuffer(int64_t buffer_length_nanoseconds);
+
+  // At most max_num_values are kept. (max_num_values == 0: unbounded.)
+  TemporalRingBuffer(int64_t buffer_length_nanoseconds, size_t max_num_values);
+
+  TemporalRingBuffer(const TemporalRingBuffer& other);
+
+  void addValue(int64_t timestamp, const ValueType& value);
+  void addValue(
+      const int64_t timestamp, const ValueType& value,
+      const bool emit_warning_on_value_overwrite);
+  void insert(const TemporalRingBuffer& other);
+
+  inline size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_values_;
+  }
+  inline bool empty() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_values_ == 0u;
+  }
+  inline size_t capacity() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return max_num_values_;
+  }
+  void clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    num_values_ = 0u;
+    head_index_ = 0u;
+  }
+
+  // Allocates the storage for the given number of values up front, such that
+  // adding values does not allocate until the buffer holds more values. The
+  // reservation is clamped to the capacity of bounded buffers.
+  void reserve(size_t num_values);
+
+  // Returns false if no value at a given timestamp present.
+  bool getValueAtTime(int64_t timestamp_ns, ValueType* value) const;
+
+  bool deleteValueAtTime(int64_t timestamp_ns);
+
+  bool getNearestValueToTime(int64_t timestamp_ns, ValueType* value) const;
+  bool getNearestValueToTime(
+      int64_t timestamp_ns, int64_t maximum_delta_ns, ValueType* value) const;
+  bool getNearestValueToTime(
+      int64_t timestamp, int64_t maximum_delta_ns, ValueType* value,
+      int64_t* timestamp_at_value_ns) const;
+
+  bool getOldestValue(ValueType* value) const;
+  bool getNewestValue(ValueType* value) const;
+
+  bool getValueAtOrBeforeTime(
+      int64_t timestamp_ns, int64_t* timestamp_ns_of_value,
+      ValueType* value) const;
+  bool getValueAtOrAfterTime(
+      int64_t timestamp_ns, int64_t* timestamp_ns_of_value,
+      ValueType* value) const;
+
+  // Get all values between the two specified timestamps excluding the border
+  // values.
+  // Example: content: 2 3 4 5
+  //          getValuesBetweenTimes(2, 5, ...) returns elements at 3, 4.
+  template <typename ValueContainerType>
+  bool getValuesBetweenTimes(
+      int64_t timestamp_lower_ns, int64_t timestamp_higher_ns,
+      ValueContainerType* values) const;
+
+  inline void lockContainer() const {
+    mutex_.lock();
+  }
+  inline void unlockContainer() const {
+    mutex_.unlock();
+  }
+
+  // The view allows to iterate over the values in a linear fashion. The
+  // container is not locked inside this method so call
+  // lockContainer()/unlockContainer() when accessing this.
+  BufferType buffered_values() const {
+    return BufferType(this);
+  }
+
+  bool operator==(const TemporalRingBuffer& other) const;
+
+ private:
+  typedef std::vector<value_type, AllocatorType> StorageType;
+
+  inline const value_type& valueAtIndex(size_t index) const {
+    DCHECK_LT(index, num_values_);
+    return storage_[storageIndex(index)];
+  }
+  inline value_type& valueAtIndex(size_t index) {
+    DCHECK_LT(index, num_values_);
+    return storage_[storageIndex(index)];
+  }
+  inline size_t storageIndex(size_t index) const {
+    const size_t storage_index = head_index_ + index;
+    return storage_index < storage_.size() ? storage_index
+                                           : storage_index - storage_.size();
+  }
+
+  // Index of the first value with a timestamp not less than the given one.
+  size_t lowerBoundIndex(int64_t timestamp) const;
+
+  // The following methods expect the caller to hold the mutex.
+  void addValueImpl(
+      int64_t timestamp, const ValueType& value,
+      bool emit_warning_on_value_overwrite);
+  void growStorage();
+  void dropOldestValues(size_t num_values_to_drop);
+  void removeOutdatedItems();
+
+  StorageType storage_;
+  size_t head_index_;
+  size_t num_values_;
+
+  int64_t buffer_length_nanoseconds_;
+  size_t max_num_values_;
+  mutable std::mutex mutex_;
+};
+}  // namespace common
+
+#include "./temporal-ring-buffer-inl.h"
+
+#endif  // MAPLAB_COMMON_TEMPORAL_RING_BUFFER_H_
@@ -0,0 +1,102 @@
+#ifndef MAPLAB_COMMON_THREAD_POOL_H_
+#define MAPLAB_COMMON_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <maplab-common/macros.h>
+
+namespace common {
+
+/// \brief Persistent pool of worker threads with one task deque per worker.
+///
+/// Workers take tasks from the back of their own deque and steal from the
+/// front of the other deques once they run dry. Tasks enqueued from a worker
+/// thread go to the local deque of that worker, tasks from any other thread
+/// are distributed round-robin.
+///
+/// Threads that wait for the completion of enqueued work should keep calling
+/// tryRunPendingTask() instead of blocking. This makes it safe to enqueue and
+/// wait for tasks from within a task (nested parallelism) without starving
+/// the pool.
+class ThreadPool {
+ public:
+  typedef std::function<void()> Task;
+
+  /// The affinity of the workers is set by applyThreadAffinity().
+  explicit ThreadPool(size_t num_threads);
+  ~ThreadPool();
+
+  /// Returns the process-wide pool. It is created on first use with
+  /// getNumThreadsForSubsystem(ThreadingSubsystem::kGlobalPool) workers.
+  static ThreadPool& getGlobal();
+
+  size_t numThreads() const {
+    return workers_.size();
+  }
+
+  void enqueue(const Task& task);
+
+  /// Executes one pending task on the calling thread. Returns false if no
+  /// task was available.
+  bool tryRunPendingTask();
+
+  /// Returns true if the calling thread is one of the workers of this pool.
+  bool isWorkerThread() const;
+
+ private:
+  struct WorkerQueue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void workerLoop(size_t worker_index);
+  bool popTask(size_t preferred_queue_index, Task* task);
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+  std::vector<std::thread> workers_;
+
+  std::atomic<size_t> num_pending_tasks_;
+  std::atomic<size_t> next_queue_index_;
+
+  std::mutex wakeup_mutex_;
+  std::condition_variable wakeup_condition_;
+  bool shutdown_requested_;
+
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(ThreadPool);
+};
+
+/// \brief Tracks the completion of a set of tasks enqueued on a ThreadPool.
+///
+/// wait() executes pending pool tasks on the calling thread while the tasks of
+/// this group are outstanding, so it can be called from within pool tasks.
+class ThreadPoolTaskGroup {
+ public:
+  explicit ThreadPoolTaskGroup(ThreadPool* pool);
+  ~ThreadPoolTaskGroup();
+
+  void run(const ThreadPool::Task& task);
+  void wait();
+
+ private:
+  void taskFinished();
+
+  ThreadPool* const pool_;
+
+  std::mutex mutex_;
+  std::condition_variable finished_condition_;
+  size_t num_outstanding_tasks_;
+
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(ThreadPoolTaskGroup);
+};
+
+}  // namespace common
+
+#endif  // MAPLAB_COMMON_THREAD_POOL_H_
@@ -2,12 +2,58 @@
 #define MAPLAB_COMMON_THREADING_HELPERS_H_
 
 #include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace common {
 
-// Return the number of concurrent threads supported by the hardware.
+// Return the number of concurrent threads supported by the hardware. This is
+// the global thread budget: --num_hardware_threads if set, otherwise the
+// number of CPU cores of --threading_numa_node if set, otherwise the detected
+// number of hardware threads.
 size_t getNumHardwareThreads();
 
+// Subsystems that size their thread pools independently of each other.
+enum class ThreadingSubsystem {
+  // ThreadPool::getGlobal(), which runs ParallelProcess and the task groups.
+  kGlobalPool,
+  // The message flow dispatchers of the console and ROVIOLI.
+  kMessageFlow,
+  // The per-camera thread pools of the feature tracking.
+  kFeatureTracking,
+  // The Ceres solver of the optimizations.
+  kOptimization,
+};
+
+// Returns the number of threads of the subsystem: its flag
+// --threading_num_threads_<subsystem> if set, default_num_threads otherwise.
+// The result is at least 1 and at most the global thread budget.
+size_t getNumThreadsForSubsystem(
+    ThreadingSubsystem subsystem, size_t default_num_threads);
+// Same with the global thread budget as default.
+size_t getNumThreadsForSubsystem(ThreadingSubsystem subsystem);
+
+// Parses a Linux CPU list, e.g. "0-3,8,10-11". Returns false if the list is
+// malformed.
+bool parseCpuList(const std::string& cpu_list, std::vector<int>* cpu_cores);
+
+// Gets the CPU cores the worker threads may run on, i.e. the cores of
+// --threading_numa_node. Empty if the threads are not restricted.
+void getAllowedCpuCores(std::vector<int>* cpu_cores);
+
+// Sets the CPU affinity of a worker thread according to the threading flags:
+// with --threading_pin_threads, the thread with index thread_idx is pinned to
+// the (thread_idx % num_cores)-th allowed core, otherwise it may run on all
+// allowed cores. Does nothing if the threads are not restricted. Returns false
+// if setting the affinity failed.
+bool applyThreadAffinity(size_t thread_idx, std::thread* thread);
+
+// Pins the thread to the given CPU cores. Returns false if setting the
+// affinity failed or is not supported on this platform.
+bool pinThreadToCpuCores(
+    const std::vector<int>& cpu_cores, std::thread* thread);
+
 }  // namespace common
 
 #endif  // MAPLAB_COMMON_THREADING_HELPERS_H_
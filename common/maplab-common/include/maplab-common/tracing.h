@@ -0,0 +1,80 @@
+#ifndef MAPLAB_COMMON_TRACING_H_
+#define MAPLAB_COMMON_TRACING_H_
+
+#include <cstdint>
+#include <string>
+
+// Low-overhead recording of begin/end events of the main processing stages,
+// which can be exported in the Chrome trace event format (chrome://tracing,
+// https://ui.perfetto.dev).
+//
+// The instrumentation macros are compiled out unless MAPLAB_ENABLE_TRACING is
+// defined (cmake option of the same name). Even when compiled in, events are
+// only recorded between startRecording() and stopRecording():
+//
+// void optimize() {
+//   MAPLAB_TRACE_SCOPE("optimization", "ceres solve");
+//   ...
+// }
+//
+// Category and name must be string literals or otherwise outlive the
+// recorder, only the pointers are stored.
+
+namespace common {
+namespace tracing {
+
+void startRecording();
+void stopRecording();
+bool isRecording();
+
+// Drops all recorded events.
+void clear();
+size_t getNumRecordedEvents();
+
+// Writes all recorded events as Chrome trace JSON. Returns false if the file
+// could not be written.
+bool writeChromeTrace(const std::string& file_path);
+
+int64_t getTimestampNanoseconds();
+void recordEvent(
+    const char* category, const char* name, int64_t start_timestamp_ns,
+    int64_t end_timestamp_ns);
+
+// Records a complete event spanning the lifetime of the object.
+class ScopedTraceEvent {
+ public:
+  ScopedTraceEvent(const char* category, const char* name)
+      : category_(category),
+        name_(name),
+        start_timestamp_ns_(isRecording() ? getTimestampNanoseconds() : -1) {}
+
+  ~ScopedTraceEvent() {
+    if (start_timestamp_ns_ >= 0) {
+      recordEvent(
+          category_, name_, start_timestamp_ns_, getTimestampNanoseconds());
+    }
+  }
+
+ private:
+  const char* const category_;
+  const char* const name_;
+  const int64_t start_timestamp_ns_;
+};
+
+}  // namespace tracing
+}  // namespace common
+
+#define MAPLAB_TRACE_CONCAT_IMPL(a, b) a##b
+#define MAPLAB_TRACE_CONCAT(a, b) MAPLAB_TRACE_CONCAT_IMPL(a, b)
+
+#ifdef MAPLAB_ENABLE_TRACING
+#define MAPLAB_TRACE_SCOPE(category, name)   \
+  ::common::tracing::ScopedTraceEvent        \
+  MAPLAB_TRACE_CONCAT(maplab_trace_event_, __LINE__)(category, name)
+#else
+#define MAPLAB_TRACE_SCOPE(category, name) \
+  do {                                     \
+  } while (false)
+#endif
+
+#endif  // MAPLAB_COMMON_TRACING_H_
@@ -1,6 +1,7 @@
 #ifndef MAPLAB_COMMON_UNIQUE_ID_H_
 #define MAPLAB_COMMON_UNIQUE_ID_H_
 
+#include <algorithm>
 #include <sstream>
 #include <string>
 #include <unordered_set>
@@ -79,6 +80,22 @@ void generateId(IdType* id) {
   id->fromUint64(hash);
 }
 
+// Resizes ids to num_ids and fills it with new ids, with the same uniqueness
+// guarantees as generateId but without the per-id overhead.
+template <typename IdType>
+void generateIds(const size_t num_ids, std::vector<IdType>* ids) {
+  CHECK_NOTNULL(ids)->resize(num_ids);
+  constexpr size_t kNumIdsPerBatch = 256u;
+  uint64_t hashes[2u * kNumIdsPerBatch];
+  for (size_t begin = 0u; begin < num_ids; begin += kNumIdsPerBatch) {
+    const size_t num_ids_in_batch = std::min(kNumIdsPerBatch, num_ids - begin);
+    internal::generateUnique128BitHashes(num_ids_in_batch, hashes);
+    for (size_t idx = 0u; idx < num_ids_in_batch; ++idx) {
+      (*ids)[begin + idx].fromUint64(&hashes[2u * idx]);
+    }
+  }
+}
+
 template <typename IdType>
 IdType createRandomId() {
   IdType id;
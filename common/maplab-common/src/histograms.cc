@@ -1,5 +1,6 @@
 #include "maplab-common/histograms.h"
 
+#include <algorithm>
 #include <cmath>
 #include <limits>
 #include <vector>
@@ -81,6 +82,161 @@ Eigen::MatrixXd downsampleWithIndexAsX(
   return bin_counts.cast<double>() / bin_density;
 }
 
+constexpr size_t ExponentialHistogram::kNumBins;
+
+ExponentialHistogram::ExponentialHistogram() {
+  reset();
+}
+
+ExponentialHistogram::ExponentialHistogram(const ExponentialHistogram& other) {
+  reset();
+  merge(other);
+}
+
+ExponentialHistogram& ExponentialHistogram::operator=(
+    const ExponentialHistogram& other) {
+  if (this != &other) {
+    reset();
+    merge(other);
+  }
+  return *this;
+}
+
+void ExponentialHistogram::addSample(uint64_t value) {
+  bin_counts_[getBinIndex(value)].fetch_add(1u, std::memory_order_relaxed);
+  num_samples_.fetch_add(1u, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+
+  uint64_t current_min = min_.load(std::memory_order_relaxed);
+  while (value < current_min &&
+         !min_.compare_exchange_weak(
+             current_min, value, std::memory_order_relaxed)) {
+  }
+  uint64_t current_max = max_.load(std::memory_order_relaxed);
+  while (value > current_max &&
+         !max_.compare_exchange_weak(
+             current_max, value, std::memory_order_relaxed)) {
+  }
+}
+
+void ExponentialHistogram::merge(const ExponentialHistogram& other) {
+  const uint64_t other_num_samples = other.getNumSamples();
+  if (other_num_samples == 0u) {
+    return;
+  }
+  for (size_t bin_index = 0u; bin_index < kNumBins; ++bin_index) {
+    bin_counts_[bin_index].fetch_add(
+        other.getBinCount(bin_index), std::memory_order_relaxed);
+  }
+  num_samples_.fetch_add(other_num_samples, std::memory_order_relaxed);
+  sum_.fetch_add(
+      other.sum_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  const uint64_t other_min = other.min_.load(std::memory_order_relaxed);
+  uint64_t current_min = min_.load(std::memory_order_relaxed);
+  while (other_min < current_min &&
+         !min_.compare_exchange_weak(
+             current_min, other_min, std::memory_order_relaxed)) {
+  }
+  const uint64_t other_max = other.max_.load(std::memory_order_relaxed);
+  uint64_t current_max = max_.load(std::memory_order_relaxed);
+  while (other_max > current_max &&
+         !max_.compare_exchange_weak(
+             current_max, other_max, std::memory_order_relaxed)) {
+  }
+}
+
+void ExponentialHistogram::reset() {
+  for (std::atomic<uint64_t>& bin_count : bin_counts_) {
+    bin_count.store(0u, std::memory_order_relaxed);
+  }
+  num_samples_.store(0u, std::memory_order_relaxed);
+  sum_.store(0u, std::memory_order_relaxed);
+  min_.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+  max_.store(0u, std::memory_order_relaxed);
+}
+
+uint64_t ExponentialHistogram::getNumSamples() const {
+  return num_samples_.load(std::memory_order_relaxed);
+}
+
+uint64_t ExponentialHistogram::getMin() const {
+  return getNumSamples() == 0u ? 0u : min_.load(std::memory_order_relaxed);
+}
+
+uint64_t ExponentialHistogram::getMax() const {
+  return max_.load(std::memory_order_relaxed);
+}
+
+double ExponentialHistogram::getMean() const {
+  const uint64_t num_samples = getNumSamples();
+  if (num_samples == 0u) {
+    return 0.0;
+  }
+  return static_cast<double>(sum_.load(std::memory_order_relaxed)) /
+         static_cast<double>(num_samples);
+}
+
+double ExponentialHistogram::getPercentile(double percentile) const {
+  CHECK_GE(percentile, 0.0);
+  CHECK_LE(percentile, 100.0);
+  uint64_t num_samples = 0u;
+  std::array<uint64_t, kNumBins> bin_counts;
+  for (size_t bin_index = 0u; bin_index < kNumBins; ++bin_index) {
+    bin_counts[bin_index] = getBinCount(bin_index);
+    num_samples += bin_counts[bin_index];
+  }
+  if (num_samples == 0u) {
+    return 0.0;
+  }
+
+  const double rank = percentile / 100.0 * static_cast<double>(num_samples);
+  uint64_t num_samples_below = 0u;
+  for (size_t bin_index = 0u; bin_index < kNumBins; ++bin_index) {
+    const uint64_t bin_count = bin_counts[bin_index];
+    if (bin_count == 0u ||
+        static_cast<double>(num_samples_below + bin_count) < rank) {
+      num_samples_below += bin_count;
+      continue;
+    }
+    const double lower_bound =
+        std::max(getBinLowerBound(bin_index), getMin());
+    const double upper_bound = std::min(
+        static_cast<double>(getBinUpperBound(bin_index)),
+        static_cast<double>(getMax()));
+    const double fraction =
+        (rank - static_cast<double>(num_samples_below)) / bin_count;
+    return lower_bound + fraction * std::max(upper_bound - lower_bound, 0.0);
+  }
+  return static_cast<double>(getMax());
+}
+
+uint64_t ExponentialHistogram::getBinCount(size_t bin_index) const {
+  CHECK_LT(bin_index, kNumBins);
+  return bin_counts_[bin_index].load(std::memory_order_relaxed);
+}
+
+uint64_t ExponentialHistogram::getBinLowerBound(size_t bin_index) {
+  CHECK_LT(bin_index, kNumBins);
+  return bin_index == 0u ? 0u : (1ull << (bin_index - 1u));
+}
+
+uint64_t ExponentialHistogram::getBinUpperBound(size_t bin_index) {
+  CHECK_LT(bin_index, kNumBins);
+  if (bin_index == kNumBins - 1u) {
+    return std::numeric_limits<uint64_t>::max();
+  }
+  return 1ull << bin_index;
+}
+
+size_t ExponentialHistogram::getBinIndex(uint64_t value) {
+  size_t bin_index = 0u;
+  while (value != 0u) {
+    value >>= 1u;
+    ++bin_index;
+  }
+  return bin_index;
+}
+
 }  // namespace histograms
 
 }  // namespace common
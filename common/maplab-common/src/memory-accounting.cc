@@ -0,0 +1,107 @@
+#include "maplab-common/memory-accounting.h"
+
+#include <iomanip>
+#include <sstream>
+
+#include <glog/logging.h>
+
+namespace common {
+
+constexpr size_t MemoryUsage::kNumCategories;
+
+MemoryUsage::MemoryUsage() {
+  clear();
+}
+
+void MemoryUsage::add(Category category, size_t num_bytes) {
+  const size_t index = static_cast<size_t>(category);
+  CHECK_LT(index, kNumCategories);
+  bytes_per_category_[index] += num_bytes;
+}
+
+void MemoryUsage::merge(const MemoryUsage& other) {
+  for (size_t i = 0u; i < kNumCategories; ++i) {
+    bytes_per_category_[i] += other.bytes_per_category_[i];
+  }
+}
+
+void MemoryUsage::clear() {
+  bytes_per_category_.fill(0u);
+}
+
+size_t MemoryUsage::getBytes(Category category) const {
+  const size_t index = static_cast<size_t>(category);
+  CHECK_LT(index, kNumCategories);
+  return bytes_per_category_[index];
+}
+
+size_t MemoryUsage::getTotalBytes() const {
+  size_t total_bytes = 0u;
+  for (const size_t num_bytes : bytes_per_category_) {
+    total_bytes += num_bytes;
+  }
+  return total_bytes;
+}
+
+std::string MemoryUsage::toString() const {
+  std::stringstream ss;
+  for (size_t i = 0u; i < kNumCategories; ++i) {
+    if (bytes_per_category_[i] == 0u) {
+      continue;
+    }
+    ss << std::left << std::setw(24)
+       << getCategoryName(static_cast<Category>(i))
+       << formatBytes(bytes_per_category_[i]) << std::endl;
+  }
+  ss << std::left << std::setw(24) << "Total"
+     << formatBytes(getTotalBytes()) << std::endl;
+  return ss.str();
+}
+
+const char* MemoryUsage::getCategoryName(Category category) {
+  switch (category) {
+    case Category::kDescriptors:
+      return "Descriptors";
+    case Category::kKeypoints:
+      return "Keypoints";
+    case Category::kLandmarkObservations:
+      return "Landmark observations";
+    case Category::kLandmarks:
+      return "Landmarks";
+    case Category::kVertices:
+      return "Vertices";
+    case Category::kEdges:
+      return "Edges";
+    case Category::kCachedResources:
+      return "Cached resources";
+    case Category::kIndexStructures:
+      return "Index structures";
+    case Category::kOther:
+      return "Other";
+    default:
+      LOG(FATAL) << "Unknown memory category "
+                 << static_cast<size_t>(category) << ".";
+  }
+  return "";
+}
+
+std::string formatBytes(size_t num_bytes) {
+  static const char* const kUnits[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+  constexpr size_t kNumUnits = sizeof(kUnits) / sizeof(kUnits[0]);
+  double value = static_cast<double>(num_bytes);
+  size_t unit_index = 0u;
+  while (value >= 1024.0 && unit_index + 1u < kNumUnits) {
+    value /= 1024.0;
+    ++unit_index;
+  }
+  std::stringstream ss;
+  if (unit_index == 0u) {
+    ss << num_bytes << " " << kUnits[0];
+  } else {
+    ss << std::fixed << std::setprecision(2) << value << " "
+       << kUnits[unit_index];
+  }
+  return ss.str();
+}
+
+}  // namespace common
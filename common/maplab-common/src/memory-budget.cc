@@ -0,0 +1,150 @@
+#include "maplab-common/memory-budget.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>  // NOLINT
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "maplab-common/memory-accounting.h"
+
+DEFINE_uint64(
+    memory_budget_mb, 0u,
+    "Memory budget of the process in MiB. When a large allocation would "
+    "exceed it, caches and other memory consumers evict or spill data. (0: no "
+    "budget)");
+
+namespace common {
+
+size_t getProcessResidentBytes() {
+  std::ifstream statm("/proc/self/statm");
+  size_t num_total_pages = 0u;
+  size_t num_resident_pages = 0u;
+  if (!(statm >> num_total_pages >> num_resident_pages)) {
+    return 0u;
+  }
+  const long page_size = sysconf(_SC_PAGESIZE);  // NOLINT
+  return page_size > 0 ? num_resident_pages * static_cast<size_t>(page_size)
+                       : 0u;
+}
+
+MemoryBudget& MemoryBudget::getInstance() {
+  static MemoryBudget instance(FLAGS_memory_budget_mb * 1024u * 1024u);
+  return instance;
+}
+
+MemoryBudget::MemoryBudget() : MemoryBudget(0u) {}
+
+MemoryBudget::MemoryBudget(size_t budget_bytes)
+    : budget_bytes_(budget_bytes),
+      resident_bytes_function_(&getProcessResidentBytes) {}
+
+void MemoryBudget::registerConsumer(Consumer* consumer) {
+  CHECK_NOTNULL(consumer);
+  std::lock_guard<std::mutex> lock(mutex_);
+  CHECK(
+      std::find(consumers_.begin(), consumers_.end(), consumer) ==
+      consumers_.end())
+      << "The consumer " << consumer->getMemoryConsumerName()
+      << " is registered already.";
+  consumers_.push_back(consumer);
+}
+
+void MemoryBudget::unregisterConsumer(Consumer* consumer) {
+  CHECK_NOTNULL(consumer);
+  std::lock_guard<std::mutex> lock(mutex_);
+  const std::vector<Consumer*>::iterator it =
+      std::find(consumers_.begin(), consumers_.end(), consumer);
+  CHECK(it != consumers_.end()) << "The consumer is not registered.";
+  consumers_.erase(it);
+}
+
+size_t MemoryBudget::getNumConsumers() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return consumers_.size();
+}
+
+bool MemoryBudget::hasBudget() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return budget_bytes_ > 0u;
+}
+
+size_t MemoryBudget::getBudgetBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return budget_bytes_;
+}
+
+void MemoryBudget::setBudgetBytes(size_t budget_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  budget_bytes_ = budget_bytes;
+}
+
+void MemoryBudget::setResidentBytesFunction(
+    const ResidentBytesFunction& function) {
+  CHECK(function);
+  std::lock_guard<std::mutex> lock(mutex_);
+  resident_bytes_function_ = function;
+}
+
+size_t MemoryBudget::getResidentBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return resident_bytes_function_();
+}
+
+bool MemoryBudget::requestMemory(
+    size_t num_bytes, const std::string& requester) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (budget_bytes_ == 0u) {
+    return true;
+  }
+  const size_t resident_bytes = resident_bytes_function_();
+  if (resident_bytes + num_bytes <= budget_bytes_) {
+    return true;
+  }
+
+  // Freed memory is not necessarily returned to the system right away, so the
+  // resident memory is only read once and the consumers are trusted to
+  // release what they report.
+  size_t num_bytes_to_release = resident_bytes + num_bytes - budget_bytes_;
+  VLOG(1) << requester << " requests " << formatBytes(num_bytes) << " with "
+          << formatBytes(resident_bytes) << " resident, releasing "
+          << formatBytes(num_bytes_to_release) << ".";
+
+  std::vector<Consumer*> consumers = consumers_;
+  std::vector<size_t> releasable_bytes;
+  releasable_bytes.reserve(consumers.size());
+  for (const Consumer* consumer : consumers) {
+    releasable_bytes.push_back(consumer->getReleasableMemoryBytes());
+  }
+  std::vector<size_t> order(consumers.size());
+  for (size_t idx = 0u; idx < order.size(); ++idx) {
+    order[idx] = idx;
+  }
+  std::stable_sort(
+      order.begin(), order.end(), [&releasable_bytes](size_t a, size_t b) {
+        return releasable_bytes[a] > releasable_bytes[b];
+      });
+
+  for (const size_t idx : order) {
+    if (num_bytes_to_release == 0u) {
+      break;
+    }
+    // Consumers that only shrink later are notified as well.
+    const size_t num_released = std::min(
+        consumers[idx]->releaseMemory(num_bytes_to_release),
+        num_bytes_to_release);
+    VLOG(2) << consumers[idx]->getMemoryConsumerName() << " released "
+            << formatBytes(num_released) << ".";
+    num_bytes_to_release -= num_released;
+  }
+
+  LOG_IF(WARNING, num_bytes_to_release > 0u)
+      << requester << " exceeds the memory budget of "
+      << formatBytes(budget_bytes_) << " by "
+      << formatBytes(num_bytes_to_release) << ".";
+  return num_bytes_to_release == 0u;
+}
+
+}  // namespace common
@@ -0,0 +1,78 @@
+#include "maplab-common/memory-mapped-file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include <glog/logging.h>
+
+namespace common {
+
+MemoryMappedFile::MemoryMappedFile()
+    : is_open_(false), data_(nullptr), size_(0u) {}
+
+MemoryMappedFile::~MemoryMappedFile() {
+  close();
+}
+
+bool MemoryMappedFile::open(const std::string& file_path) {
+  CHECK(!file_path.empty());
+  close();
+
+  const int file_descriptor = ::open(file_path.c_str(), O_RDONLY);
+  if (file_descriptor < 0) {
+    LOG(ERROR) << "Could not open " << file_path << ": " << strerror(errno);
+    return false;
+  }
+  struct stat file_status;
+  if (fstat(file_descriptor, &file_status) != 0) {
+    LOG(ERROR) << "Could not stat " << file_path << ": " << strerror(errno);
+    ::close(file_descriptor);
+    return false;
+  }
+
+  const size_t size = static_cast<size_t>(file_status.st_size);
+  void* data = nullptr;
+  if (size > 0u) {
+    data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+    if (data == MAP_FAILED) {
+      LOG(ERROR) << "Could not map " << file_path << ": " << strerror(errno);
+      ::close(file_descriptor);
+      return false;
+    }
+  }
+  // The mapping stays valid after closing the descriptor.
+  ::close(file_descriptor);
+
+  is_open_ = true;
+  data_ = static_cast<const char*>(data);
+  size_ = size;
+  return true;
+}
+
+void MemoryMappedFile::close() {
+  if (data_ != nullptr) {
+    CHECK_EQ(munmap(const_cast<char*>(data_), size_), 0) << strerror(errno);
+  }
+  is_open_ = false;
+  data_ = nullptr;
+  size_ = 0u;
+}
+
+void MemoryMappedFile::adviseSequentialRead() const {
+  if (data_ == nullptr) {
+    return;
+  }
+  // The advices are not flags and need to be given one by one.
+  void* data = const_cast<char*>(data_);
+  const bool success = madvise(data, size_, MADV_SEQUENTIAL) == 0 &&
+                       madvise(data, size_, MADV_WILLNEED) == 0;
+  LOG_IF(WARNING, !success) << "madvise failed: " << strerror(errno);
+}
+
+}  // namespace common
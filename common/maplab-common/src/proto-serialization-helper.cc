@@ -19,11 +19,22 @@ DEFINE_int32(
 
 DEFINE_bool(
     proto_use_compression, true,
-    "If enabled, the protobufs will be compressed when storing and "
-    "decompressed when loading.");
+    "If enabled, the protobufs will be compressed when storing. Compressed "
+    "protobufs are detected and decompressed when loading.");
 
 namespace common {
 namespace proto_serialization_helper {
+namespace {
+
+// Every gzip stream starts with this byte, while it is never the first byte
+// of a serialized proto, as it would encode a field with the invalid wire
+// type 7.
+constexpr int kGzipMagicByte = 0x1f;
+// Larger buffers than the default of 64kB reduce the number of calls into
+// zlib for large map protos.
+constexpr int kGzipBufferSizeBytes = 1 << 20;
+
+}  // namespace
 
 bool parseProtoFromFile(
     const std::string& folder_path, const std::string& file_name,
@@ -62,11 +73,12 @@ bool parseProtoFromFile(
     constexpr int kMegabytesToBytes = 1e6;
     const int max_proto_size_bytes =
         kMegabytesToBytes * FLAGS_proto_max_size_megabytes;
-    if (FLAGS_proto_use_compression) {
+    if (file_stream.peek() == kGzipMagicByte) {
       google::protobuf::io::IstreamInputStream proto_istream_input_stream(
           &file_stream);
       google::protobuf::io::GzipInputStream proto_gzip_input_stream(
-          &proto_istream_input_stream);
+          &proto_istream_input_stream,
+          google::protobuf::io::GzipInputStream::GZIP, kGzipBufferSizeBytes);
       google::protobuf::io::CodedInputStream proto_coded_input_stream(
           &proto_gzip_input_stream);
       proto_coded_input_stream.SetTotalBytesLimit(
@@ -98,6 +110,10 @@ bool serializeProtoToFile(
 bool serializeProtoToFile(
     const std::string& folder_path, const std::string& file_name,
     const google::protobuf::Message& proto, const bool use_text_format) {
+  if (!use_text_format) {
+    return serializeProtoToFileWithCompression(
+        folder_path, file_name, proto, getCompressionLevelFromFlags());
+  }
   CHECK(!folder_path.empty());
   CHECK(!file_name.empty());
   std::string complete_file_path;
@@ -110,26 +126,51 @@ bool serializeProtoToFile(
     return false;
   }
 
+  google::protobuf::io::OstreamOutputStream proto_ostream_output_stream(
+      &file_stream);
+  if (!google::protobuf::TextFormat::Print(
+          proto, &proto_ostream_output_stream)) {
+    LOG(ERROR) << "Error writing to file\"" << complete_file_path << "\".";
+    return false;
+  }
+  return true;
+}
+
+bool serializeProtoToFileWithCompression(
+    const std::string& folder_path, const std::string& file_name,
+    const google::protobuf::Message& proto, const int compression_level) {
+  CHECK(!folder_path.empty());
+  CHECK(!file_name.empty());
+  CHECK_GE(compression_level, kDefaultCompression);
+  CHECK_LE(compression_level, kBestCompression);
+  std::string complete_file_path;
+  common::concatenateFolderAndFileName(
+      folder_path, file_name, &complete_file_path);
+
+  std::ofstream file_stream(complete_file_path, std::ofstream::out);
+  if (!file_stream.is_open()) {
+    LOG(ERROR) << "Error writing to file\"" << complete_file_path << "\".";
+    return false;
+  }
+
   bool proto_serialization_successful = false;
-  if (use_text_format) {
+  if (compression_level != kNoCompression) {
     google::protobuf::io::OstreamOutputStream proto_ostream_output_stream(
         &file_stream);
-    proto_serialization_successful = google::protobuf::TextFormat::Print(
-        proto, &proto_ostream_output_stream);
-  } else {
-    if (FLAGS_proto_use_compression) {
-      google::protobuf::io::OstreamOutputStream proto_ostream_output_stream(
-          &file_stream);
-      google::protobuf::io::GzipOutputStream proto_gzip_output_stream(
-          &proto_ostream_output_stream);
+    google::protobuf::io::GzipOutputStream::Options gzip_options;
+    gzip_options.compression_level = compression_level;
+    gzip_options.buffer_size = kGzipBufferSizeBytes;
+    google::protobuf::io::GzipOutputStream proto_gzip_output_stream(
+        &proto_ostream_output_stream, gzip_options);
+    {
       google::protobuf::io::CodedOutputStream proto_coded_output_stream(
           &proto_gzip_output_stream);
-
       proto_serialization_successful =
           proto.SerializeToCodedStream(&proto_coded_output_stream);
-    } else {
-      proto_serialization_successful = proto.SerializeToOstream(&file_stream);
     }
+    proto_serialization_successful &= proto_gzip_output_stream.Close();
+  } else {
+    proto_serialization_successful = proto.SerializeToOstream(&file_stream);
   }
   if (!proto_serialization_successful) {
     LOG(ERROR) << "Error writing to file\"" << complete_file_path << "\".";
@@ -138,6 +179,10 @@ bool serializeProtoToFile(
   return true;
 }
 
+int getCompressionLevelFromFlags() {
+  return FLAGS_proto_use_compression ? kDefaultCompression : kNoCompression;
+}
+
 void serializeToArray(
     const google::protobuf::Message& proto, void** raw_data,
     size_t* data_length_bytes) {
@@ -6,19 +6,40 @@
 
 namespace common {
 
+SigintBreaker::ScopedBreakRequestSource::ScopedBreakRequestSource(
+    const std::atomic<bool>* is_break_requested)
+    : previous_break_request_(thread_break_request_) {
+  CHECK_NOTNULL(is_break_requested);
+  thread_break_request_ = is_break_requested;
+}
+
+SigintBreaker::ScopedBreakRequestSource::~ScopedBreakRequestSource() {
+  thread_break_request_ = previous_break_request_;
+}
+
 SigintBreaker::SigintBreaker()
-    : previous_handler_(signal(SIGINT, &SigintBreaker::handler)) {
+    : break_request_(thread_break_request_), previous_handler_(nullptr) {
+  if (break_request_ != nullptr) {
+    return;
+  }
   CHECK(!is_instantiated_) << "Can't instantiate multiple SigintBreakers!";
+  previous_handler_ = signal(SIGINT, &SigintBreaker::handler);
   is_instantiated_ = true;
   is_sigint_raised_ = false;
 }
 
 SigintBreaker::~SigintBreaker() {
+  if (break_request_ != nullptr) {
+    return;
+  }
   CHECK_EQ(signal(SIGINT, previous_handler_), &SigintBreaker::handler);
   is_instantiated_ = false;
 }
 
 bool SigintBreaker::isBreakRequested() const {
+  if (break_request_ != nullptr) {
+    return break_request_->load();
+  }
   return is_sigint_raised_;
 }
 
@@ -29,5 +50,7 @@ void SigintBreaker::handler(int signal) {
 
 bool SigintBreaker::is_instantiated_ = false;
 bool SigintBreaker::is_sigint_raised_ = false;
+thread_local const std::atomic<bool>* SigintBreaker::thread_break_request_ =
+    nullptr;
 
 }  // namespace common
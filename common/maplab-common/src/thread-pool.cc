@@ -0,0 +1,190 @@
+#include "maplab-common/thread-pool.h"
+
+#include <chrono>
+
+#include <glog/logging.h>
+
+#include "maplab-common/threading-helpers.h"
+
+namespace common {
+namespace {
+// Identifies the pool and the worker index of the calling thread, if it is a
+// pool worker.
+thread_local const ThreadPool* tls_worker_pool = nullptr;
+thread_local size_t tls_worker_index = 0u;
+
+// Poll interval of waiting threads that have no pending task to help with.
+// New tasks can show up while waiting if the outstanding tasks spawn nested
+// work.
+constexpr std::chrono::microseconds kWaitPollInterval(200);
+}  // namespace
+
+ThreadPool::ThreadPool(size_t num_threads)
+    : num_pending_tasks_(0u),
+      next_queue_index_(0u),
+      shutdown_requested_(false) {
+  CHECK_GT(num_threads, 0u);
+  queues_.reserve(num_threads);
+  for (size_t i = 0u; i < num_threads; ++i) {
+    queues_.emplace_back(new WorkerQueue);
+  }
+  workers_.reserve(num_threads);
+  for (size_t i = 0u; i < num_threads; ++i) {
+    workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+    applyThreadAffinity(i, &workers_.back());
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(wakeup_mutex_);
+    shutdown_requested_ = true;
+  }
+  wakeup_condition_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+ThreadPool& ThreadPool::getGlobal() {
+  static ThreadPool global_pool(
+      getNumThreadsForSubsystem(ThreadingSubsystem::kGlobalPool));
+  return global_pool;
+}
+
+bool ThreadPool::isWorkerThread() const {
+  return tls_worker_pool == this;
+}
+
+void ThreadPool::enqueue(const Task& task) {
+  CHECK(task);
+  const size_t queue_index =
+      isWorkerThread() ? tls_worker_index
+                       : next_queue_index_.fetch_add(1u) % queues_.size();
+  {
+    WorkerQueue& queue = *queues_[queue_index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(task);
+  }
+  {
+    // Increment under the wakeup mutex so sleeping workers can't miss it.
+    std::lock_guard<std::mutex> lock(wakeup_mutex_);
+    ++num_pending_tasks_;
+  }
+  wakeup_condition_.notify_one();
+}
+
+bool ThreadPool::popTask(size_t preferred_queue_index, Task* task) {
+  CHECK_NOTNULL(task);
+  if (num_pending_tasks_.load() == 0u) {
+    return false;
+  }
+
+  // LIFO on the own queue keeps nested work cache-local.
+  {
+    WorkerQueue& queue = *queues_[preferred_queue_index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      *task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+      --num_pending_tasks_;
+      return true;
+    }
+  }
+
+  // Steal the oldest task of another queue.
+  const size_t num_queues = queues_.size();
+  for (size_t offset = 1u; offset < num_queues; ++offset) {
+    WorkerQueue& queue =
+        *queues_[(preferred_queue_index + offset) % num_queues];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      *task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      --num_pending_tasks_;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ThreadPool::tryRunPendingTask() {
+  const size_t preferred_queue_index =
+      isWorkerThread() ? tls_worker_index
+                       : next_queue_index_.load() % queues_.size();
+  Task task;
+  if (!popTask(preferred_queue_index, &task)) {
+    return false;
+  }
+  task();
+  return true;
+}
+
+void ThreadPool::workerLoop(size_t worker_index) {
+  tls_worker_pool = this;
+  tls_worker_index = worker_index;
+
+  while (true) {
+    Task task;
+    if (popTask(worker_index, &task)) {
+      task();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(wakeup_mutex_);
+    wakeup_condition_.wait(lock, [this]() {
+      return shutdown_requested_ || num_pending_tasks_.load() > 0u;
+    });
+    if (shutdown_requested_ && num_pending_tasks_.load() == 0u) {
+      return;
+    }
+  }
+}
+
+ThreadPoolTaskGroup::ThreadPoolTaskGroup(ThreadPool* pool)
+    : pool_(CHECK_NOTNULL(pool)), num_outstanding_tasks_(0u) {}
+
+ThreadPoolTaskGroup::~ThreadPoolTaskGroup() {
+  wait();
+}
+
+void ThreadPoolTaskGroup::run(const ThreadPool::Task& task) {
+  CHECK(task);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++num_outstanding_tasks_;
+  }
+  pool_->enqueue([this, task]() {
+    task();
+    taskFinished();
+  });
+}
+
+void ThreadPoolTaskGroup::taskFinished() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  CHECK_GT(num_outstanding_tasks_, 0u);
+  --num_outstanding_tasks_;
+  if (num_outstanding_tasks_ == 0u) {
+    finished_condition_.notify_all();
+  }
+}
+
+void ThreadPoolTaskGroup::wait() {
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (num_outstanding_tasks_ == 0u) {
+        return;
+      }
+    }
+    if (pool_->tryRunPendingTask()) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_condition_.wait_for(lock, kWaitPollInterval, [this]() {
+      return num_outstanding_tasks_ == 0u;
+    });
+  }
+}
+
+}  // namespace common
@@ -1,25 +1,101 @@
 #include "maplab-common/threading-helpers.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>  // NOLINT
+#include <sstream>
 #include <thread>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
 DEFINE_uint64(
     num_hardware_threads, 0u,
     "Number of hardware threads to announce. (0: autodetect)");
+DEFINE_int32(
+    threading_numa_node, -1,
+    "If set, the worker threads of the thread pools only run on the CPU cores "
+    "of this NUMA node, and the number of hardware threads defaults to the "
+    "number of cores of the node. (-1: no restriction)");
+DEFINE_bool(
+    threading_pin_threads, false,
+    "If enabled, every worker thread of the thread pools is pinned to one CPU "
+    "core, round-robin over the cores of --threading_numa_node or all cores.");
+DEFINE_uint64(
+    threading_num_threads_global_pool, 0u,
+    "Number of threads of the global thread pool that runs the parallel "
+    "processing. (0: number of hardware threads)");
+DEFINE_uint64(
+    threading_num_threads_message_flow, 0u,
+    "Number of threads of the message flow dispatcher. (0: number of hardware "
+    "threads)");
+DEFINE_uint64(
+    threading_num_threads_feature_tracking, 0u,
+    "Number of threads of the feature tracking thread pools. (0: one per "
+    "camera)");
+DEFINE_uint64(
+    threading_num_threads_optimization, 0u,
+    "Number of threads of the Ceres optimizations. (0: number of hardware "
+    "threads)");
 
 namespace common {
 namespace internal {
 
 constexpr size_t kDefaultNumHardwareThreads = 4u;
 
+bool getCpuCoresOfNumaNode(int numa_node, std::vector<int>* cpu_cores) {
+  CHECK_NOTNULL(cpu_cores)->clear();
+  CHECK_GE(numa_node, 0);
+  const std::string cpu_list_file = "/sys/devices/system/node/node" +
+                                    std::to_string(numa_node) + "/cpulist";
+  std::ifstream cpu_list_stream(cpu_list_file);
+  std::string cpu_list;
+  if (!cpu_list_stream.is_open() || !std::getline(cpu_list_stream, cpu_list)) {
+    return false;
+  }
+  return parseCpuList(cpu_list, cpu_cores) && !cpu_cores->empty();
+}
+
+std::vector<int> getAllowedCpuCoresImpl() {
+  std::vector<int> cpu_cores;
+  if (FLAGS_threading_numa_node >= 0 &&
+      !getCpuCoresOfNumaNode(FLAGS_threading_numa_node, &cpu_cores)) {
+    LOG(WARNING) << "Could not read the CPU cores of NUMA node "
+                 << FLAGS_threading_numa_node << ", the threads are not "
+                 << "restricted to the node.";
+    cpu_cores.clear();
+  }
+  if (cpu_cores.empty() && FLAGS_threading_pin_threads) {
+    const size_t num_detected_threads = std::thread::hardware_concurrency();
+    for (size_t core = 0u; core < num_detected_threads; ++core) {
+      cpu_cores.push_back(static_cast<int>(core));
+    }
+  }
+  return cpu_cores;
+}
+
+const std::vector<int>& getAllowedCpuCoresCached() {
+  static const std::vector<int> cached_cpu_cores = getAllowedCpuCoresImpl();
+  return cached_cpu_cores;
+}
+
 size_t getNumHardwareThreadsImpl() {
   // Just use the user-provided count if set.
   if (FLAGS_num_hardware_threads > 0) {
     return FLAGS_num_hardware_threads;
   }
 
+  // The threads of a NUMA node don't use the cores of the other nodes.
+  if (FLAGS_threading_numa_node >= 0 && !getAllowedCpuCoresCached().empty()) {
+    return getAllowedCpuCoresCached().size();
+  }
+
   const size_t num_detected_threads = std::thread::hardware_concurrency();
 
   // Fallback to default or user-provided value if the detection failed.
@@ -36,6 +112,23 @@ size_t getNumHardwareThreadsImpl() {
   }
   return num_detected_threads;
 }
+
+size_t getSubsystemNumThreadsFlag(ThreadingSubsystem subsystem) {
+  switch (subsystem) {
+    case ThreadingSubsystem::kGlobalPool:
+      return FLAGS_threading_num_threads_global_pool;
+    case ThreadingSubsystem::kMessageFlow:
+      return FLAGS_threading_num_threads_message_flow;
+    case ThreadingSubsystem::kFeatureTracking:
+      return FLAGS_threading_num_threads_feature_tracking;
+    case ThreadingSubsystem::kOptimization:
+      return FLAGS_threading_num_threads_optimization;
+    default:
+      LOG(FATAL) << "Unknown threading subsystem "
+                 << static_cast<int>(subsystem) << ".";
+  }
+  return 0u;
+}
 }  // namespace internal
 
 size_t getNumHardwareThreads() {
@@ -43,4 +136,94 @@ size_t getNumHardwareThreads() {
   return cached_num_threads;
 }
 
+size_t getNumThreadsForSubsystem(
+    ThreadingSubsystem subsystem, size_t default_num_threads) {
+  const size_t subsystem_num_threads =
+      internal::getSubsystemNumThreadsFlag(subsystem);
+  const size_t num_threads =
+      subsystem_num_threads > 0u ? subsystem_num_threads : default_num_threads;
+  return std::max<size_t>(1u, std::min(num_threads, getNumHardwareThreads()));
+}
+
+size_t getNumThreadsForSubsystem(ThreadingSubsystem subsystem) {
+  return getNumThreadsForSubsystem(subsystem, getNumHardwareThreads());
+}
+
+bool parseCpuList(const std::string& cpu_list, std::vector<int>* cpu_cores) {
+  CHECK_NOTNULL(cpu_cores)->clear();
+  std::stringstream cpu_list_stream(cpu_list);
+  std::string range;
+  while (std::getline(cpu_list_stream, range, ',')) {
+    range.erase(
+        std::remove_if(range.begin(), range.end(), ::isspace), range.end());
+    if (range.empty()) {
+      continue;
+    }
+    const size_t dash_pos = range.find('-');
+    char* end = nullptr;
+    const long first = std::strtol(range.c_str(), &end, 10);  // NOLINT
+    long last = first;  // NOLINT
+    if (dash_pos == std::string::npos) {
+      if (*end != '\0') {
+        return false;
+      }
+    } else {
+      if (end != range.c_str() + dash_pos) {
+        return false;
+      }
+      last = std::strtol(range.c_str() + dash_pos + 1u, &end, 10);
+      if (*end != '\0' || end == range.c_str() + dash_pos + 1u) {
+        return false;
+      }
+    }
+    if (first < 0 || last < first) {
+      return false;
+    }
+    for (long core = first; core <= last; ++core) {  // NOLINT
+      cpu_cores->push_back(static_cast<int>(core));
+    }
+  }
+  return true;
+}
+
+void getAllowedCpuCores(std::vector<int>* cpu_cores) {
+  CHECK_NOTNULL(cpu_cores);
+  *cpu_cores = internal::getAllowedCpuCoresCached();
+}
+
+bool applyThreadAffinity(size_t thread_idx, std::thread* thread) {
+  CHECK_NOTNULL(thread);
+  const std::vector<int>& cpu_cores = internal::getAllowedCpuCoresCached();
+  if (cpu_cores.empty()) {
+    return true;
+  }
+  if (FLAGS_threading_pin_threads) {
+    return pinThreadToCpuCores(
+        {cpu_cores[thread_idx % cpu_cores.size()]}, thread);
+  }
+  return pinThreadToCpuCores(cpu_cores, thread);
+}
+
+bool pinThreadToCpuCores(
+    const std::vector<int>& cpu_cores, std::thread* thread) {
+  CHECK_NOTNULL(thread);
+  CHECK(!cpu_cores.empty());
+#ifdef __linux__
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (const int cpu_core : cpu_cores) {
+    CHECK_GE(cpu_core, 0);
+    CPU_SET(cpu_core, &cpu_set);
+  }
+  const int result = pthread_setaffinity_np(
+      thread->native_handle(), sizeof(cpu_set_t), &cpu_set);
+  LOG_IF(WARNING, result != 0) << "Failed to set the CPU affinity of a thread.";
+  return result == 0;
+#else
+  LOG(WARNING) << "Pinning threads to CPU cores is not supported on this "
+               << "platform.";
+  return false;
+#endif
+}
+
 }  // namespace common
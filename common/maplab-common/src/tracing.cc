@@ -0,0 +1,172 @@
+#include "maplab-common/tracing.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>  // NOLINT
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace common {
+namespace tracing {
+namespace {
+
+struct TraceEvent {
+  const char* category;
+  const char* name;
+  int64_t start_timestamp_ns;
+  int64_t duration_ns;
+};
+
+// Every thread appends to its own buffer, so recording only contends with a
+// concurrent export or clear.
+struct ThreadEventBuffer {
+  explicit ThreadEventBuffer(size_t _thread_index)
+      : thread_index(_thread_index) {}
+  const size_t thread_index;
+  std::mutex mutex;
+  std::vector<TraceEvent> events;
+};
+
+class TraceRecorder {
+ public:
+  static TraceRecorder& getInstance() {
+    static TraceRecorder instance;
+    return instance;
+  }
+
+  std::atomic<bool> is_recording;
+
+  ThreadEventBuffer* getThreadBuffer() {
+    // The registry keeps the buffers of finished threads alive.
+    thread_local ThreadEventBuffer* thread_buffer = nullptr;
+    if (thread_buffer == nullptr) {
+      std::lock_guard<std::mutex> lock(registry_mutex_);
+      thread_buffers_.emplace_back(
+          new ThreadEventBuffer(thread_buffers_.size()));
+      thread_buffer = thread_buffers_.back().get();
+    }
+    return thread_buffer;
+  }
+
+  template <typename Visitor>
+  void forEachThreadBuffer(const Visitor& visitor) {
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    for (const std::unique_ptr<ThreadEventBuffer>& buffer : thread_buffers_) {
+      std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+      visitor(buffer.get());
+    }
+  }
+
+ private:
+  TraceRecorder() : is_recording(false) {}
+
+  std::mutex registry_mutex_;
+  std::vector<std::unique_ptr<ThreadEventBuffer>> thread_buffers_;
+};
+
+void writeEscapedJsonString(const char* string, std::ostream* stream) {
+  CHECK_NOTNULL(stream);
+  *stream << '"';
+  for (const char* c = string; *c != '\0'; ++c) {
+    if (*c == '"' || *c == '\\') {
+      *stream << '\\';
+    }
+    *stream << *c;
+  }
+  *stream << '"';
+}
+
+}  // namespace
+
+void startRecording() {
+  TraceRecorder::getInstance().is_recording = true;
+}
+
+void stopRecording() {
+  TraceRecorder::getInstance().is_recording = false;
+}
+
+bool isRecording() {
+  return TraceRecorder::getInstance().is_recording.load(
+      std::memory_order_relaxed);
+}
+
+void clear() {
+  TraceRecorder::getInstance().forEachThreadBuffer(
+      [](ThreadEventBuffer* buffer) { buffer->events.clear(); });
+}
+
+size_t getNumRecordedEvents() {
+  size_t num_events = 0u;
+  TraceRecorder::getInstance().forEachThreadBuffer(
+      [&num_events](ThreadEventBuffer* buffer) {
+        num_events += buffer->events.size();
+      });
+  return num_events;
+}
+
+int64_t getTimestampNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void recordEvent(
+    const char* category, const char* name, int64_t start_timestamp_ns,
+    int64_t end_timestamp_ns) {
+  CHECK_NOTNULL(category);
+  CHECK_NOTNULL(name);
+  ThreadEventBuffer* buffer = TraceRecorder::getInstance().getThreadBuffer();
+  std::lock_guard<std::mutex> lock(buffer->mutex);
+  buffer->events.push_back(
+      TraceEvent{category, name, start_timestamp_ns,
+                 end_timestamp_ns - start_timestamp_ns});
+}
+
+bool writeChromeTrace(const std::string& file_path) {
+  CHECK(!file_path.empty());
+  std::ofstream stream(file_path);
+  if (!stream.is_open()) {
+    LOG(ERROR) << "Unable to open trace file " << file_path;
+    return false;
+  }
+
+  // Chrome traces expect microseconds.
+  constexpr double kNanosecondsToMicroseconds = 1e-3;
+  stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first_event = true;
+  size_t num_events = 0u;
+  TraceRecorder::getInstance().forEachThreadBuffer(
+      [&](ThreadEventBuffer* buffer) {
+        for (const TraceEvent& event : buffer->events) {
+          if (!first_event) {
+            stream << ",";
+          }
+          first_event = false;
+          stream << "\n{\"ph\":\"X\",\"pid\":1,\"tid\":"
+                 << buffer->thread_index << ",\"cat\":";
+          writeEscapedJsonString(event.category, &stream);
+          stream << ",\"name\":";
+          writeEscapedJsonString(event.name, &stream);
+          stream << ",\"ts\":" << std::fixed
+                 << event.start_timestamp_ns * kNanosecondsToMicroseconds
+                 << ",\"dur\":"
+                 << event.duration_ns * kNanosecondsToMicroseconds << "}";
+          ++num_events;
+        }
+      });
+  stream << "\n]}\n";
+  stream.close();
+  if (!stream) {
+    LOG(ERROR) << "Failed to write trace file " << file_path;
+    return false;
+  }
+  VLOG(1) << "Wrote " << num_events << " trace events to " << file_path;
+  return true;
+}
+
+}  // namespace tracing
+}  // namespace common
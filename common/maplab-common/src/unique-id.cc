@@ -3,20 +3,59 @@
 #include <atomic>
 #include <chrono>
 
+#include <glog/logging.h>
+
 namespace common {
 namespace internal {
-void generateUnique128BitHash(uint64_t hash[2]) {
+namespace {
+// The second word of a hash is a counter that is unique within the process.
+// Every thread takes a block of counter values at once, such that the threads
+// only contend on the shared counter once per block.
+constexpr uint64_t kNumCountersPerBlock = 4096u;
+std::atomic<uint64_t> next_counter_block(1u);
+
+struct ThreadCounterBlock {
+  uint64_t next_counter = 0u;
+  uint64_t end_counter = 0u;
+};
+
+inline uint64_t getNextCounter(ThreadCounterBlock* block) {
+  if (block->next_counter == block->end_counter) {
+    block->next_counter = next_counter_block.fetch_add(kNumCountersPerBlock);
+    block->end_counter = block->next_counter + kNumCountersPerBlock;
+  }
+  return block->next_counter++;
+}
+
+// The first word makes the hashes unique across processes.
+inline uint64_t getTimeSeededWord() {
   static_assert(
       sizeof(size_t) == sizeof(uint64_t),
       "Please adapt the below to your non-64-bit system.");
+  return common::internal::UniqueIdHashSeed::instance().seed() ^
+         std::hash<int>()(
+             std::chrono::high_resolution_clock::now()
+                 .time_since_epoch()
+                 .count());
+}
+
+thread_local ThreadCounterBlock thread_counter_block;
+}  // namespace
+
+void generateUnique128BitHash(uint64_t hash[2]) {
+  hash[0] = getTimeSeededWord();
+  hash[1] = getNextCounter(&thread_counter_block);
+}
 
-  static std::atomic<int> counter;
-  hash[0] =
-      common::internal::UniqueIdHashSeed::instance().seed() ^
-      std::hash<int>()(
-          std::chrono::high_resolution_clock::now().time_since_epoch().count());
-  // Increment must happen here, otherwise the sampling is not atomic.
-  hash[1] = std::hash<int>()(++counter);
+void generateUnique128BitHashes(size_t num_hashes, uint64_t* hashes) {
+  CHECK(num_hashes == 0u || hashes != nullptr);
+  // The counters are unique, so the clock is sampled once for all hashes.
+  const uint64_t time_seeded_word = getTimeSeededWord();
+  ThreadCounterBlock* block = &thread_counter_block;
+  for (size_t hash_idx = 0u; hash_idx < num_hashes; ++hash_idx) {
+    hashes[2u * hash_idx] = time_seeded_word;
+    hashes[2u * hash_idx + 1u] = getNextCounter(block);
+  }
 }
 }  // namespace internal
 }  // namespace common
@@ -1,5 +1,10 @@
+#include <string>
+
 #include <Eigen/Dense>
 #include <glog/logging.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/wire_format_lite.h>
 #include <gtest/gtest.h>
 
 #include <eigen-checks/gtest.h>
@@ -309,6 +314,41 @@ TEST_F(EigenProtoDynamicTest, deserializeInsufficient) {
       deserialize(this->inconsistentProto(), &this->eigen_object_), "^");
 }
 
+TEST_F(EigenProtoDynamicTest, serializeDataAsOneBlock) {
+  serialize(this->referenceEigenObject(), &this->proto_);
+  // Two bytes for each of rows and cols, then one tag and one length byte for
+  // the raw doubles.
+  constexpr int kExpectedByteSize = 2 + 2 + 2 + 6 * sizeof(double);
+  EXPECT_EQ(kExpectedByteSize, this->proto_.ByteSize());
+}
+
+// Maps written before the data fields were packed store every element with
+// its own tag, they must still be readable.
+TEST_F(EigenProtoDynamicTest, deserializeUnpackedEncoding) {
+  typedef google::protobuf::internal::WireFormatLite WireFormatLite;
+  std::string unpacked_encoding;
+  {
+    google::protobuf::io::StringOutputStream string_stream(&unpacked_encoding);
+    google::protobuf::io::CodedOutputStream coded_stream(&string_stream);
+    coded_stream.WriteTag(
+        WireFormatLite::MakeTag(1, WireFormatLite::WIRETYPE_VARINT));
+    coded_stream.WriteVarint32(2u);
+    coded_stream.WriteTag(
+        WireFormatLite::MakeTag(2, WireFormatLite::WIRETYPE_VARINT));
+    coded_stream.WriteVarint32(3u);
+    for (int i = 0; i < 6; ++i) {
+      coded_stream.WriteTag(
+          WireFormatLite::MakeTag(3, WireFormatLite::WIRETYPE_FIXED64));
+      coded_stream.WriteLittleEndian64(WireFormatLite::EncodeDouble(i));
+    }
+  }
+
+  ASSERT_TRUE(this->proto_.ParseFromString(unpacked_encoding));
+  deserialize(this->proto_, &this->eigen_object_);
+  EXPECT_TRUE(
+      EIGEN_MATRIX_EQUAL(this->eigen_object_, this->referenceEigenObject()));
+}
+
 }  // namespace eigen_proto
 }  // namespace common
 
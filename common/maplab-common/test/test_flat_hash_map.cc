@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "maplab-common/flat-hash-map.h"
+#include "maplab-common/memory-accounting.h"
+#include "maplab-common/test/testing-entrypoint.h"
+
+namespace common {
+
+// 128 bit key like the unique ids of the map structures.
+struct TestId {
+  uint64_t upper;
+  uint64_t lower;
+  bool operator==(const TestId& other) const {
+    return upper == other.upper && lower == other.lower;
+  }
+};
+
+struct TestIdHash {
+  size_t operator()(const TestId& id) const {
+    return std::hash<uint64_t>()(id.upper ^ id.lower);
+  }
+};
+
+typedef FlatHashMap<TestId, int, TestIdHash> TestIdMap;
+
+std::vector<TestId> generateTestIds(size_t num_ids, uint64_t seed) {
+  std::mt19937_64 generator(seed);
+  std::vector<TestId> ids(num_ids);
+  for (TestId& id : ids) {
+    id.upper = generator();
+    id.lower = generator();
+  }
+  return ids;
+}
+
+TEST(MaplabCommon, FlatHashMapInsertFindErase) {
+  constexpr size_t kNumIds = 1000u;
+  const std::vector<TestId> ids = generateTestIds(kNumIds, 42u);
+
+  TestIdMap map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(map.begin() == map.end());
+  EXPECT_TRUE(map.find(ids[0]) == map.end());
+
+  for (size_t i = 0u; i < kNumIds; ++i) {
+    EXPECT_TRUE(map.emplace(ids[i], static_cast<int>(i)).second);
+  }
+  EXPECT_EQ(map.size(), kNumIds);
+  EXPECT_FALSE(map.emplace(ids[0], -1).second);
+  EXPECT_EQ(getChecked(map, ids[0]), 0);
+
+  for (size_t i = 0u; i < kNumIds; ++i) {
+    TestIdMap::const_iterator it = map.find(ids[i]);
+    ASSERT_TRUE(it != map.end());
+    EXPECT_EQ(it->second, static_cast<int>(i));
+  }
+
+  // Erase every other id.
+  for (size_t i = 0u; i < kNumIds; i += 2u) {
+    EXPECT_EQ(map.erase(ids[i]), 1u);
+  }
+  EXPECT_EQ(map.erase(ids[0]), 0u);
+  EXPECT_EQ(map.size(), kNumIds / 2u);
+  for (size_t i = 0u; i < kNumIds; ++i) {
+    EXPECT_EQ(map.count(ids[i]), i % 2u);
+  }
+
+  // Reinserting reuses the deleted slots.
+  for (size_t i = 0u; i < kNumIds; i += 2u) {
+    map[ids[i]] = static_cast<int>(i);
+  }
+  EXPECT_EQ(map.size(), kNumIds);
+  for (size_t i = 0u; i < kNumIds; ++i) {
+    EXPECT_EQ(getChecked(map, ids[i]), static_cast<int>(i));
+  }
+  EXPECT_GT(getHeapBytes(map), kNumIds * sizeof(TestIdMap::value_type));
+
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(getValuePtr(map, ids[1]), nullptr);
+}
+
+TEST(MaplabCommon, FlatHashMapIterationAndEraseWhileIterating) {
+  constexpr size_t kNumIds = 500u;
+  const std::vector<TestId> ids = generateTestIds(kNumIds, 7u);
+  TestIdMap map;
+  map.reserve(kNumIds);
+  const size_t reserved_capacity = map.capacity();
+  for (size_t i = 0u; i < kNumIds; ++i) {
+    map.emplace(ids[i], static_cast<int>(i));
+  }
+  EXPECT_EQ(map.capacity(), reserved_capacity);
+
+  int sum = 0;
+  for (const TestIdMap::value_type& value : map) {
+    sum += value.second;
+  }
+  EXPECT_EQ(sum, static_cast<int>(kNumIds * (kNumIds - 1u) / 2u));
+
+  // Remove all odd values while iterating.
+  size_t num_visited = 0u;
+  TestIdMap::iterator it = map.begin();
+  while (it != map.end()) {
+    ++num_visited;
+    if (it->second % 2 == 1) {
+      it = map.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  EXPECT_EQ(num_visited, kNumIds);
+  EXPECT_EQ(map.size(), kNumIds / 2u);
+  for (const TestIdMap::value_type& value : map) {
+    EXPECT_EQ(value.second % 2, 0);
+  }
+}
+
+TEST(MaplabCommon, FlatHashMapMoveOnlyValuesCopyAndSwap) {
+  const std::vector<TestId> ids = generateTestIds(100u, 3u);
+  FlatHashMap<TestId, std::unique_ptr<int>, TestIdHash> unique_map;
+  for (size_t i = 0u; i < ids.size(); ++i) {
+    unique_map.emplace(ids[i], std::unique_ptr<int>(new int(i)));
+  }
+  FlatHashMap<TestId, std::unique_ptr<int>, TestIdHash> moved_map(
+      std::move(unique_map));
+  EXPECT_TRUE(unique_map.empty());  // NOLINT
+  ASSERT_EQ(moved_map.size(), ids.size());
+  EXPECT_EQ(*getChecked(moved_map, ids[10]), 10);
+
+  TestIdMap map;
+  for (size_t i = 0u; i < ids.size(); ++i) {
+    map.emplace(ids[i], static_cast<int>(i));
+  }
+  TestIdMap copy(map);
+  map.erase(ids[0]);
+  EXPECT_EQ(copy.size(), ids.size());
+  EXPECT_EQ(getChecked(copy, ids[0]), 0);
+
+  TestIdMap other;
+  other.swap(copy);
+  EXPECT_TRUE(copy.empty());
+  EXPECT_EQ(other.size(), ids.size());
+  copy = other;
+  EXPECT_EQ(copy.size(), ids.size());
+}
+
+// Compares the flat hash map to std::unordered_map for an index of one
+// million 128 bit ids, the size of the vertex index of a large map. Only the
+// results are checked, the timings are logged.
+TEST(MaplabCommon, FlatHashMapBenchmarkAgainstUnorderedMap) {
+  constexpr size_t kNumIds = 1000000u;
+  const std::vector<TestId> ids = generateTestIds(kNumIds, 1u);
+  const std::vector<TestId> missing_ids = generateTestIds(kNumIds, 2u);
+  std::vector<TestId> shuffled_ids = ids;
+  std::shuffle(shuffled_ids.begin(), shuffled_ids.end(), std::mt19937(3u));
+
+  typedef std::chrono::steady_clock Clock;
+  auto elapsed_ms = [](const Clock::time_point& start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+  };
+
+  std::unordered_map<TestId, int, TestIdHash> unordered_map;
+  Clock::time_point start = Clock::now();
+  for (size_t i = 0u; i < kNumIds; ++i) {
+    unordered_map.emplace(ids[i], static_cast<int>(i));
+  }
+  const double unordered_insert_ms = elapsed_ms(start);
+
+  TestIdMap flat_map;
+  start = Clock::now();
+  for (size_t i = 0u; i < kNumIds; ++i) {
+    flat_map.emplace(ids[i], static_cast<int>(i));
+  }
+  const double flat_insert_ms = elapsed_ms(start);
+
+  int64_t unordered_sum = 0;
+  start = Clock::now();
+  for (const TestId& id : shuffled_ids) {
+    unordered_sum += unordered_map.find(id)->second;
+  }
+  const double unordered_find_ms = elapsed_ms(start);
+
+  int64_t flat_sum = 0;
+  start = Clock::now();
+  for (const TestId& id : shuffled_ids) {
+    flat_sum += flat_map.find(id)->second;
+  }
+  const double flat_find_ms = elapsed_ms(start);
+  EXPECT_EQ(unordered_sum, flat_sum);
+
+  size_t unordered_num_found = 0u;
+  start = Clock::now();
+  for (const TestId& id : missing_ids) {
+    unordered_num_found += unordered_map.count(id);
+  }
+  const double unordered_miss_ms = elapsed_ms(start);
+
+  size_t flat_num_found = 0u;
+  start = Clock::now();
+  for (const TestId& id : missing_ids) {
+    flat_num_found += flat_map.count(id);
+  }
+  const double flat_miss_ms = elapsed_ms(start);
+  EXPECT_EQ(unordered_num_found, 0u);
+  EXPECT_EQ(flat_num_found, 0u);
+
+  start = Clock::now();
+  unordered_sum = 0;
+  for (const std::pair<const TestId, int>& value : unordered_map) {
+    unordered_sum += value.second;
+  }
+  const double unordered_iterate_ms = elapsed_ms(start);
+
+  start = Clock::now();
+  flat_sum = 0;
+  for (const TestIdMap::value_type& value : flat_map) {
+    flat_sum += value.second;
+  }
+  const double flat_iterate_ms = elapsed_ms(start);
+  EXPECT_EQ(unordered_sum, flat_sum);
+
+  LOG(INFO) << "Index of " << kNumIds << " ids [ms], unordered_map / "
+            << "flat_hash_map:\n"
+            << "  insert:          " << unordered_insert_ms << " / "
+            << flat_insert_ms << "\n"
+            << "  find:            " << unordered_find_ms << " / "
+            << flat_find_ms << "\n"
+            << "  find missing:    " << unordered_miss_ms << " / "
+            << flat_miss_ms << "\n"
+            << "  iterate:         " << unordered_iterate_ms << " / "
+            << flat_iterate_ms << "\n"
+            << "  heap bytes:      " << getHeapBytes(unordered_map) << " / "
+            << getHeapBytes(flat_map);
+}
+
+}  // namespace common
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,89 @@
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "maplab-common/histograms.h"
+#include "maplab-common/test/testing-entrypoint.h"
+
+namespace common {
+namespace histograms {
+
+TEST(MaplabCommon, ExponentialHistogramBins) {
+  EXPECT_EQ(ExponentialHistogram::getBinIndex(0u), 0u);
+  EXPECT_EQ(ExponentialHistogram::getBinIndex(1u), 1u);
+  EXPECT_EQ(ExponentialHistogram::getBinIndex(2u), 2u);
+  EXPECT_EQ(ExponentialHistogram::getBinIndex(3u), 2u);
+  EXPECT_EQ(ExponentialHistogram::getBinIndex(1024u), 11u);
+  EXPECT_EQ(
+      ExponentialHistogram::getBinIndex(UINT64_MAX),
+      ExponentialHistogram::kNumBins - 1u);
+
+  for (size_t bin_index = 1u; bin_index < ExponentialHistogram::kNumBins;
+       ++bin_index) {
+    const uint64_t lower_bound =
+        ExponentialHistogram::getBinLowerBound(bin_index);
+    EXPECT_EQ(ExponentialHistogram::getBinIndex(lower_bound), bin_index);
+    EXPECT_EQ(
+        ExponentialHistogram::getBinUpperBound(bin_index - 1u), lower_bound);
+  }
+}
+
+TEST(MaplabCommon, ExponentialHistogramStatistics) {
+  ExponentialHistogram histogram;
+  EXPECT_EQ(histogram.getNumSamples(), 0u);
+  EXPECT_EQ(histogram.getMin(), 0u);
+  EXPECT_EQ(histogram.getMax(), 0u);
+  EXPECT_EQ(histogram.getPercentile(50.0), 0.0);
+
+  for (uint64_t value = 1u; value <= 1000u; ++value) {
+    histogram.addSample(value);
+  }
+  EXPECT_EQ(histogram.getNumSamples(), 1000u);
+  EXPECT_EQ(histogram.getMin(), 1u);
+  EXPECT_EQ(histogram.getMax(), 1000u);
+  EXPECT_DOUBLE_EQ(histogram.getMean(), 500.5);
+  EXPECT_EQ(histogram.getBinCount(10u), 1000u - 512u + 1u);
+
+  // The estimate is exact up to the width of the bin.
+  EXPECT_NEAR(histogram.getPercentile(50.0), 500.0, 256.0);
+  EXPECT_NEAR(histogram.getPercentile(99.0), 990.0, 16.0);
+  EXPECT_EQ(histogram.getPercentile(0.0), 1.0);
+  EXPECT_EQ(histogram.getPercentile(100.0), 1000.0);
+  EXPECT_LE(histogram.getPercentile(50.0), histogram.getPercentile(90.0));
+
+  ExponentialHistogram copy = histogram;
+  histogram.reset();
+  EXPECT_EQ(histogram.getNumSamples(), 0u);
+  EXPECT_EQ(copy.getNumSamples(), 1000u);
+
+  histogram.addSample(5000u);
+  copy.merge(histogram);
+  EXPECT_EQ(copy.getNumSamples(), 1001u);
+  EXPECT_EQ(copy.getMax(), 5000u);
+  EXPECT_EQ(copy.getMin(), 1u);
+}
+
+TEST(MaplabCommon, ExponentialHistogramConcurrentSamples) {
+  constexpr size_t kNumThreads = 4u;
+  constexpr uint64_t kNumSamplesPerThread = 10000u;
+  ExponentialHistogram histogram;
+  std::vector<std::thread> threads;
+  for (size_t thread_idx = 0u; thread_idx < kNumThreads; ++thread_idx) {
+    threads.emplace_back([&histogram]() {
+      for (uint64_t value = 0u; value < kNumSamplesPerThread; ++value) {
+        histogram.addSample(value);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(histogram.getNumSamples(), kNumThreads * kNumSamplesPerThread);
+  EXPECT_EQ(histogram.getMin(), 0u);
+  EXPECT_EQ(histogram.getMax(), kNumSamplesPerThread - 1u);
+}
+
+}  // namespace histograms
+}  // namespace common
+
+MAPLAB_UNITTEST_ENTRYPOINT
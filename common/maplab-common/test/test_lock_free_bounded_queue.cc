@@ -0,0 +1,99 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "maplab-common/lock-free-bounded-queue.h"
+#include "maplab-common/test/testing-entrypoint.h"
+
+namespace common {
+
+TEST(MaplabCommon, LockFreeBoundedQueue_CapacityIsPowerOfTwo) {
+  LockFreeBoundedQueue<int> queue(100u);
+  EXPECT_EQ(queue.Capacity(), 128u);
+  EXPECT_TRUE(queue.Empty());
+
+  for (int i = 0; i < 128; ++i) {
+    EXPECT_TRUE(queue.TryPush(i));
+  }
+  EXPECT_FALSE(queue.TryPush(128));
+  EXPECT_EQ(queue.Size(), 128u);
+
+  for (int i = 0; i < 128; ++i) {
+    int value;
+    ASSERT_TRUE(queue.PopNonBlocking(&value));
+    EXPECT_EQ(value, i);
+  }
+  int value;
+  EXPECT_FALSE(queue.PopNonBlocking(&value));
+}
+
+TEST(MaplabCommon, LockFreeBoundedQueue_DropOldest) {
+  LockFreeBoundedQueue<int> queue(16u);
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_FALSE(queue.PushNonBlockingDroppingOldestElementIfFull(i, 5u));
+  }
+  EXPECT_TRUE(queue.PushNonBlockingDroppingOldestElementIfFull(5, 5u));
+  EXPECT_EQ(queue.Size(), 5u);
+  int value;
+  ASSERT_TRUE(queue.PopNonBlocking(&value));
+  EXPECT_EQ(value, 1);
+}
+
+TEST(MaplabCommon, LockFreeBoundedQueue_PopTimeoutAndShutdown) {
+  LockFreeBoundedQueue<int> queue;
+  int value;
+  constexpr int64_t kTimeoutNanoseconds = 1000000;
+  EXPECT_FALSE(queue.PopTimeout(&value, kTimeoutNanoseconds));
+  queue.Push(3);
+  EXPECT_TRUE(queue.PopTimeout(&value, kTimeoutNanoseconds));
+  EXPECT_EQ(value, 3);
+
+  std::thread consumer([&queue]() {
+    int value;
+    EXPECT_FALSE(queue.PopBlocking(&value));
+  });
+  queue.Shutdown();
+  consumer.join();
+}
+
+TEST(MaplabCommon, LockFreeBoundedQueue_MultiProducerMultiConsumer) {
+  constexpr int kNumProducers = 4;
+  constexpr int kNumConsumers = 4;
+  constexpr int kNumValuesPerProducer = 20000;
+  // Small capacity to exercise the blocking paths.
+  LockFreeBoundedQueue<int> queue(8u);
+
+  std::vector<std::thread> threads;
+  for (int producer = 0; producer < kNumProducers; ++producer) {
+    threads.emplace_back([&queue, producer]() {
+      for (int i = 0; i < kNumValuesPerProducer; ++i) {
+        queue.Push(producer * kNumValuesPerProducer + i);
+      }
+    });
+  }
+
+  std::atomic<int64_t> sum(0);
+  std::atomic<int> num_popped(0);
+  for (int consumer = 0; consumer < kNumConsumers; ++consumer) {
+    threads.emplace_back([&queue, &sum, &num_popped]() {
+      int value;
+      while (queue.PopBlocking(&value)) {
+        sum += value;
+        if (++num_popped == kNumProducers * kNumValuesPerProducer) {
+          queue.Shutdown();
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  const int64_t num_values = kNumProducers * kNumValuesPerProducer;
+  EXPECT_EQ(num_popped.load(), num_values);
+  EXPECT_EQ(sum.load(), num_values * (num_values - 1) / 2);
+}
+
+}  // namespace common
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,62 @@
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "maplab-common/memory-accounting.h"
+#include "maplab-common/test/testing-entrypoint.h"
+
+namespace common {
+
+TEST(MaplabCommon, MemoryUsageAccumulatesPerCategory) {
+  MemoryUsage usage;
+  EXPECT_EQ(usage.getTotalBytes(), 0u);
+
+  usage.add(MemoryUsage::Category::kDescriptors, 100u);
+  usage.add(MemoryUsage::Category::kDescriptors, 28u);
+  usage.add(MemoryUsage::Category::kEdges, 72u);
+  EXPECT_EQ(usage.getBytes(MemoryUsage::Category::kDescriptors), 128u);
+  EXPECT_EQ(usage.getBytes(MemoryUsage::Category::kEdges), 72u);
+  EXPECT_EQ(usage.getBytes(MemoryUsage::Category::kKeypoints), 0u);
+  EXPECT_EQ(usage.getTotalBytes(), 200u);
+
+  MemoryUsage other;
+  other.add(MemoryUsage::Category::kEdges, 8u);
+  other.add(MemoryUsage::Category::kCachedResources, 1024u);
+  usage.merge(other);
+  EXPECT_EQ(usage.getBytes(MemoryUsage::Category::kEdges), 80u);
+  EXPECT_EQ(usage.getBytes(MemoryUsage::Category::kCachedResources), 1024u);
+  EXPECT_EQ(usage.getTotalBytes(), 1232u);
+
+  usage.clear();
+  EXPECT_EQ(usage.getTotalBytes(), 0u);
+}
+
+TEST(MaplabCommon, MemoryUsageContainerEstimates) {
+  std::vector<int> vector;
+  vector.reserve(16u);
+  EXPECT_EQ(getHeapBytes(vector), 16u * sizeof(int));
+
+  Eigen::Matrix2Xd keypoints(2, 10);
+  EXPECT_EQ(getHeapBytes(keypoints), 20u * sizeof(double));
+  Eigen::Matrix3d fixed_size;
+  EXPECT_EQ(getHeapBytes(fixed_size), 0u);
+
+  std::unordered_map<int, double> map;
+  EXPECT_LE(getHeapBytes(map), map.bucket_count() * sizeof(void*));
+  for (int i = 0; i < 10; ++i) {
+    map.emplace(i, 0.0);
+  }
+  EXPECT_GE(getHeapBytes(map), 10u * sizeof(std::pair<const int, double>));
+}
+
+TEST(MaplabCommon, FormatBytes) {
+  EXPECT_EQ(formatBytes(0u), "0 B");
+  EXPECT_EQ(formatBytes(1023u), "1023 B");
+  EXPECT_EQ(formatBytes(1536u), "1.50 KiB");
+  EXPECT_EQ(formatBytes(3u * 1024u * 1024u * 1024u), "3.00 GiB");
+}
+
+}  // namespace common
+
+MAPLAB_UNITTEST_ENTRYPOINT
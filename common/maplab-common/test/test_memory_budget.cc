@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <string>
+
+#include "maplab-common/memory-budget.h"
+#include "maplab-common/test/testing-entrypoint.h"
+
+namespace common {
+
+namespace {
+class FakeConsumer : public MemoryBudget::Consumer {
+ public:
+  FakeConsumer(const std::string& name, size_t num_bytes)
+      : name_(name), num_bytes_(num_bytes), num_calls_(0u) {}
+
+  std::string getMemoryConsumerName() const override {
+    return name_;
+  }
+  size_t getReleasableMemoryBytes() const override {
+    return num_bytes_;
+  }
+  size_t releaseMemory(size_t num_bytes) override {
+    ++num_calls_;
+    const size_t num_released = std::min(num_bytes, num_bytes_);
+    num_bytes_ -= num_released;
+    return num_released;
+  }
+
+  size_t getNumBytes() const {
+    return num_bytes_;
+  }
+  size_t getNumCalls() const {
+    return num_calls_;
+  }
+
+ private:
+  const std::string name_;
+  size_t num_bytes_;
+  size_t num_calls_;
+};
+}  // namespace
+
+TEST(MaplabCommon, MemoryBudgetWithoutBudgetAcceptsAll) {
+  MemoryBudget budget;
+  budget.setResidentBytesFunction([]() { return 1000u; });
+  FakeConsumer consumer("consumer", 500u);
+  budget.registerConsumer(&consumer);
+  EXPECT_FALSE(budget.hasBudget());
+  EXPECT_TRUE(budget.requestMemory(1000000u, "test"));
+  EXPECT_EQ(consumer.getNumCalls(), 0u);
+  budget.unregisterConsumer(&consumer);
+}
+
+TEST(MaplabCommon, MemoryBudgetReleasesLargestConsumerFirst) {
+  MemoryBudget budget(1000u);
+  budget.setResidentBytesFunction([]() { return 800u; });
+  FakeConsumer small("small", 100u);
+  FakeConsumer large("large", 300u);
+  budget.registerConsumer(&small);
+  budget.registerConsumer(&large);
+  EXPECT_EQ(budget.getNumConsumers(), 2u);
+
+  // Fits without releasing anything.
+  EXPECT_TRUE(budget.requestMemory(200u, "test"));
+  EXPECT_EQ(large.getNumCalls(), 0u);
+
+  // 250 bytes have to be released, all of them by the larger consumer.
+  EXPECT_TRUE(budget.requestMemory(450u, "test"));
+  EXPECT_EQ(large.getNumBytes(), 50u);
+  EXPECT_EQ(small.getNumCalls(), 0u);
+
+  budget.unregisterConsumer(&small);
+  budget.unregisterConsumer(&large);
+  EXPECT_EQ(budget.getNumConsumers(), 0u);
+}
+
+TEST(MaplabCommon, MemoryBudgetFailsIfConsumersCantReleaseEnough) {
+  MemoryBudget budget(1000u);
+  budget.setResidentBytesFunction([]() { return 900u; });
+  FakeConsumer consumer_a("a", 100u);
+  FakeConsumer consumer_b("b", 50u);
+  budget.registerConsumer(&consumer_a);
+  budget.registerConsumer(&consumer_b);
+
+  EXPECT_FALSE(budget.requestMemory(300u, "test"));
+  EXPECT_EQ(consumer_a.getNumBytes(), 0u);
+  EXPECT_EQ(consumer_b.getNumBytes(), 0u);
+
+  budget.unregisterConsumer(&consumer_a);
+  budget.unregisterConsumer(&consumer_b);
+}
+
+TEST(MaplabCommon, ProcessResidentBytesAreAvailable) {
+  EXPECT_GT(getProcessResidentBytes(), 0u);
+}
+
+}  // namespace common
+
+MAPLAB_UNITTEST_ENTRYPOINT
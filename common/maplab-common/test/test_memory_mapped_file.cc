@@ -0,0 +1,49 @@
+#include <fstream>  // NOLINT
+#include <string>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include "maplab-common/memory-mapped-file.h"
+#include "maplab-common/test/testing-entrypoint.h"
+
+namespace common {
+
+TEST(MemoryMappedFileTest, MapsTheFileContent) {
+  const std::string kFileName = "test_memory_mapped_file.bin";
+  const std::string kContent("memory\0mapped", 13u);
+  {
+    std::ofstream file(kFileName, std::ios::binary | std::ios::trunc);
+    file.write(kContent.data(), kContent.size());
+  }
+
+  MemoryMappedFile mapped_file;
+  EXPECT_FALSE(mapped_file.isOpen());
+  ASSERT_TRUE(mapped_file.open(kFileName));
+  EXPECT_TRUE(mapped_file.isOpen());
+  ASSERT_EQ(kContent.size(), mapped_file.size());
+  mapped_file.adviseSequentialRead();
+  EXPECT_EQ(kContent, std::string(mapped_file.data(), mapped_file.size()));
+
+  mapped_file.close();
+  EXPECT_FALSE(mapped_file.isOpen());
+  EXPECT_EQ(nullptr, mapped_file.data());
+  EXPECT_EQ(0u, mapped_file.size());
+}
+
+TEST(MemoryMappedFileTest, HandlesEmptyAndMissingFiles) {
+  const std::string kFileName = "test_memory_mapped_file_empty.bin";
+  { std::ofstream file(kFileName, std::ios::binary | std::ios::trunc); }
+
+  MemoryMappedFile mapped_file;
+  ASSERT_TRUE(mapped_file.open(kFileName));
+  EXPECT_EQ(nullptr, mapped_file.data());
+  EXPECT_EQ(0u, mapped_file.size());
+
+  EXPECT_FALSE(mapped_file.open("this_file_does_not_exist.bin"));
+  EXPECT_FALSE(mapped_file.isOpen());
+}
+
+}  // namespace common
+
+MAPLAB_UNITTEST_ENTRYPOINT
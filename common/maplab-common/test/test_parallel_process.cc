@@ -73,6 +73,43 @@ TEST(MaplabCommon, ParallelProcessOddNumberOneThread) {
     EXPECT_EQ(results[i], data[i] * data[i]);
   }
 }
+
+TEST(MaplabCommon, ParallelProcessDynamicCoversAllIndicesOnce) {
+  constexpr size_t kNumValues = 1013u;
+  for (const ParallelSchedule schedule :
+       {ParallelSchedule::kDynamic, ParallelSchedule::kGuided}) {
+    for (const size_t min_chunk_size : {1u, 7u, 2000u}) {
+      std::vector<int> num_visits(kNumValues, 0);
+      std::function<void(size_t, size_t)> visitor =
+          [&num_visits](size_t begin, size_t end) {
+            ASSERT_LT(begin, end);
+            for (size_t i = begin; i < end; ++i) {
+              ++num_visits[i];
+            }
+          };
+      ParallelProcessDynamic(kNumValues, visitor, 8u, schedule, min_chunk_size);
+      for (size_t i = 0u; i < kNumValues; ++i) {
+        EXPECT_EQ(num_visits[i], 1);
+      }
+    }
+  }
+}
+
+TEST(MaplabCommon, ParallelProcessDynamicWithStartIndex) {
+  constexpr size_t kStartIndex = 10u;
+  constexpr size_t kEndIndex = 100u;
+  std::vector<int> num_visits(kEndIndex, 0);
+  std::function<void(size_t, size_t)> visitor =
+      [&num_visits](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          ++num_visits[i];
+        }
+      };
+  ParallelProcessDynamic(kStartIndex, kEndIndex, visitor, 4u);
+  for (size_t i = 0u; i < kEndIndex; ++i) {
+    EXPECT_EQ(num_visits[i], i < kStartIndex ? 0 : 1);
+  }
+}
 }  // namespace common
 
 MAPLAB_UNITTEST_ENTRYPOINT
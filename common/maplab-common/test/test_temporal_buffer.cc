@@ -1,4 +1,6 @@
 #include <thread>
+#include <utility>
+#include <vector>
 
 #include <aslam/common/time.h>
 #include <maplab-common/temporal-buffer.h>
@@ -268,5 +270,30 @@ TEST_F(TemporalBufferFixture, MaintaingBufferLengthWorks) {
   EXPECT_EQ(retrieved_item.timestamp, 150);
 }
 
+TEST_F(TemporalBufferFixture, AddValuesWorks) {
+  addValue(TestData(40));
+  std::vector<std::pair<int64_t, TestData>> values;
+  for (const int64_t timestamp : {0, 20, 40, 60, 80}) {
+    values.emplace_back(timestamp, TestData(timestamp));
+  }
+  // The value at 40 exists already, the one at 30 is not sorted.
+  values.emplace_back(30, TestData(30));
+  buffer_.addValues(values.begin(), values.end());
+  EXPECT_EQ(buffer_.size(), 6u);
+
+  TestData retrieved_item;
+  EXPECT_TRUE(buffer_.getValueAtTime(30, &retrieved_item));
+  EXPECT_EQ(retrieved_item.timestamp, 30);
+  EXPECT_TRUE(buffer_.getOldestValue(&retrieved_item));
+  EXPECT_EQ(retrieved_item.timestamp, 0);
+
+  // The buffer length is maintained.
+  values.clear();
+  values.emplace_back(150, TestData(150));
+  buffer_.addValues(values.begin(), values.end());
+  EXPECT_TRUE(buffer_.getOldestValue(&retrieved_item));
+  EXPECT_EQ(retrieved_item.timestamp, 60);
+}
+
 }  // namespace common
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,199 @@
+#include <random>
+#include <vector>
+
+#include <maplab-common/temporal-buffer.h>
+#include <maplab-common/temporal-ring-buffer.h>
+
+#include "maplab-common/test/testing-entrypoint.h"
+
+namespace common {
+
+struct TestData {
+  explicit TestData(int64_t time) : timestamp(time) {}
+  TestData() = default;
+
+  int64_t timestamp;
+};
+
+class TemporalRingBufferFixture : public ::testing::Test {
+ public:
+  TemporalRingBufferFixture() : buffer_(kBufferLengthNs) {}
+
+ protected:
+  void addValue(const TestData& data) {
+    buffer_.addValue(data.timestamp, data);
+  }
+
+  static constexpr int64_t kBufferLengthNs = 100;
+  TemporalRingBuffer<TestData> buffer_;
+};
+
+TEST_F(TemporalRingBufferFixture, SizeEmptyClearWork) {
+  EXPECT_TRUE(buffer_.empty());
+  EXPECT_EQ(buffer_.size(), 0u);
+
+  addValue(TestData(10));
+  addValue(TestData(20));
+  EXPECT_FALSE(buffer_.empty());
+  EXPECT_EQ(buffer_.size(), 2u);
+
+  buffer_.clear();
+  EXPECT_TRUE(buffer_.empty());
+  EXPECT_EQ(buffer_.size(), 0u);
+}
+
+TEST_F(TemporalRingBufferFixture, UnorderedInsertionAndLookupsWork) {
+  addValue(TestData(30));
+  addValue(TestData(10));
+  addValue(TestData(20));
+  addValue(TestData(40));
+
+  TestData retrieved_item;
+  EXPECT_TRUE(buffer_.getValueAtTime(20, &retrieved_item));
+  EXPECT_EQ(retrieved_item.timestamp, 20);
+  EXPECT_FALSE(buffer_.getValueAtTime(15, &retrieved_item));
+
+  EXPECT_TRUE(buffer_.getNearestValueToTime(16, &retrieved_item));
+  EXPECT_EQ(retrieved_item.timestamp, 20);
+  EXPECT_TRUE(buffer_.getNearestValueToTime(1232, &retrieved_item));
+  EXPECT_EQ(retrieved_item.timestamp, 40);
+  EXPECT_FALSE(buffer_.getNearestValueToTime(0, 5, &retrieved_item));
+
+  int64_t timestamp;
+  EXPECT_TRUE(buffer_.getValueAtOrBeforeTime(15, &timestamp, &retrieved_item));
+  EXPECT_EQ(timestamp, 10);
+  EXPECT_FALSE(buffer_.getValueAtOrBeforeTime(5, &timestamp, &retrieved_item));
+  EXPECT_TRUE(buffer_.getValueAtOrAfterTime(35, &timestamp, &retrieved_item));
+  EXPECT_EQ(timestamp, 40);
+  EXPECT_FALSE(buffer_.getValueAtOrAfterTime(45, &timestamp, &retrieved_item));
+
+  EXPECT_TRUE(buffer_.getOldestValue(&retrieved_item));
+  EXPECT_EQ(retrieved_item.timestamp, 10);
+  EXPECT_TRUE(buffer_.getNewestValue(&retrieved_item));
+  EXPECT_EQ(retrieved_item.timestamp, 40);
+
+  std::vector<TestData> values;
+  ASSERT_TRUE(buffer_.getValuesBetweenTimes(10, 40, &values));
+  ASSERT_EQ(values.size(), 2u);
+  EXPECT_EQ(values[0].timestamp, 20);
+  EXPECT_EQ(values[1].timestamp, 30);
+
+  EXPECT_TRUE(buffer_.deleteValueAtTime(20));
+  EXPECT_FALSE(buffer_.deleteValueAtTime(20));
+  EXPECT_EQ(buffer_.size(), 3u);
+}
+
+TEST_F(TemporalRingBufferFixture, MaintaingBufferLengthWorks) {
+  addValue(TestData(0));
+  addValue(TestData(50));
+  addValue(TestData(100));
+  EXPECT_EQ(buffer_.size(), 3u);
+
+  addValue(TestData(150));
+  EXPECT_EQ(buffer_.size(), 3u);
+
+  TestData retrieved_item;
+  EXPECT_TRUE(buffer_.getOldestValue(&retrieved_item));
+  EXPECT_EQ(retrieved_item.timestamp, 50);
+  EXPECT_TRUE(buffer_.getNewestValue(&retrieved_item));
+  EXPECT_EQ(retrieved_item.timestamp, 150);
+}
+
+TEST(TemporalRingBuffer, CapacityBoundDropsOldestValues) {
+  constexpr size_t kCapacity = 20u;
+  TemporalRingBuffer<TestData> buffer(-1, kCapacity);
+  for (int64_t timestamp = 0; timestamp < 100; ++timestamp) {
+    buffer.addValue(timestamp, TestData(timestamp));
+  }
+  EXPECT_EQ(buffer.size(), kCapacity);
+
+  TestData retrieved_item;
+  EXPECT_TRUE(buffer.getOldestValue(&retrieved_item));
+  EXPECT_EQ(retrieved_item.timestamp, 80);
+
+  // A value older than all buffered values is dropped right away.
+  buffer.addValue(5, TestData(5));
+  EXPECT_FALSE(buffer.getValueAtTime(5, &retrieved_item));
+
+  // Linear iteration across the wrap-around of the ring.
+  buffer.lockContainer();
+  int64_t expected_timestamp = 80;
+  for (const std::pair<int64_t, TestData>& value : buffer.buffered_values()) {
+    EXPECT_EQ(value.first, expected_timestamp);
+    EXPECT_EQ(value.second.timestamp, expected_timestamp);
+    ++expected_timestamp;
+  }
+  buffer.unlockContainer();
+  EXPECT_EQ(expected_timestamp, 100);
+}
+
+TEST(TemporalRingBuffer, ReserveKeepsValuesAcrossWrapAround) {
+  // The buffer length makes the values wrap around the end of the storage.
+  constexpr int64_t kBufferLengthNs = 10;
+  TemporalRingBuffer<TestData> buffer(kBufferLengthNs);
+  for (int64_t timestamp = 0; timestamp < 30; ++timestamp) {
+    buffer.addValue(timestamp, TestData(timestamp));
+  }
+  buffer.reserve(64u);
+  for (int64_t timestamp = 30; timestamp < 40; ++timestamp) {
+    buffer.addValue(timestamp, TestData(timestamp));
+  }
+  EXPECT_EQ(buffer.size(), 11u);
+
+  buffer.lockContainer();
+  int64_t expected_timestamp = 29;
+  for (const std::pair<int64_t, TestData>& value : buffer.buffered_values()) {
+    EXPECT_EQ(value.first, expected_timestamp);
+    EXPECT_EQ(value.second.timestamp, expected_timestamp);
+    ++expected_timestamp;
+  }
+  buffer.unlockContainer();
+  EXPECT_EQ(expected_timestamp, 40);
+
+  // The reservation of bounded buffers is clamped to the capacity.
+  constexpr size_t kCapacity = 20u;
+  TemporalRingBuffer<TestData> bounded_buffer(-1, kCapacity);
+  bounded_buffer.reserve(2u * kCapacity);
+  for (int64_t timestamp = 0; timestamp < 30; ++timestamp) {
+    bounded_buffer.addValue(timestamp, TestData(timestamp));
+  }
+  EXPECT_EQ(bounded_buffer.size(), kCapacity);
+}
+
+TEST(TemporalRingBuffer, BehavesLikeTemporalBuffer) {
+  constexpr int64_t kBufferLengthNs = 500;
+  TemporalBuffer<TestData, std::allocator<std::pair<const int64_t, TestData>>>
+      map_buffer(kBufferLengthNs);
+  TemporalRingBuffer<TestData> ring_buffer(kBufferLengthNs);
+
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<int64_t> jitter(-20, 20);
+  for (int64_t i = 0; i < 2000; ++i) {
+    const int64_t timestamp = 10 * i + jitter(generator);
+    map_buffer.addValue(timestamp, TestData(timestamp));
+    ring_buffer.addValue(timestamp, TestData(timestamp));
+    ASSERT_EQ(map_buffer.size(), ring_buffer.size());
+
+    const int64_t query_timestamp = timestamp + jitter(generator);
+    TestData map_value, ring_value;
+    int64_t map_timestamp, ring_timestamp;
+    ASSERT_EQ(
+        map_buffer.getValueAtOrBeforeTime(
+            query_timestamp, &map_timestamp, &map_value),
+        ring_buffer.getValueAtOrBeforeTime(
+            query_timestamp, &ring_timestamp, &ring_value));
+    ASSERT_EQ(
+        map_buffer.getValueAtOrAfterTime(
+            query_timestamp, &map_timestamp, &map_value),
+        ring_buffer.getValueAtOrAfterTime(
+            query_timestamp, &ring_timestamp, &ring_value));
+    if (ring_buffer.getNearestValueToTime(query_timestamp, &ring_value)) {
+      ASSERT_TRUE(
+          map_buffer.getNearestValueToTime(query_timestamp, &map_value));
+      EXPECT_EQ(map_value.timestamp, ring_value.timestamp);
+    }
+  }
+}
+
+}  // namespace common
+MAPLAB_UNITTEST_ENTRYPOINT
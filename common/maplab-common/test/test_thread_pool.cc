@@ -0,0 +1,116 @@
+#include <atomic>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/thread-pool.h>
+#include <maplab-common/threading-helpers.h>
+
+DECLARE_uint64(threading_num_threads_optimization);
+
+namespace common {
+
+TEST(MaplabCommon, ThreadPoolRunsAllTasks) {
+  ThreadPool pool(4u);
+  EXPECT_EQ(pool.numThreads(), 4u);
+
+  constexpr size_t kNumTasks = 1000u;
+  std::atomic<size_t> num_executed(0u);
+  {
+    ThreadPoolTaskGroup task_group(&pool);
+    for (size_t i = 0u; i < kNumTasks; ++i) {
+      task_group.run([&num_executed]() { ++num_executed; });
+    }
+    task_group.wait();
+    EXPECT_EQ(num_executed.load(), kNumTasks);
+  }
+}
+
+TEST(MaplabCommon, ThreadPoolNestedTaskGroups) {
+  ThreadPool pool(2u);
+
+  constexpr size_t kNumOuterTasks = 16u;
+  constexpr size_t kNumInnerTasks = 16u;
+  std::atomic<size_t> num_executed(0u);
+  ThreadPoolTaskGroup outer_group(&pool);
+  for (size_t i = 0u; i < kNumOuterTasks; ++i) {
+    outer_group.run([&pool, &num_executed]() {
+      ThreadPoolTaskGroup inner_group(&pool);
+      for (size_t j = 0u; j < kNumInnerTasks; ++j) {
+        inner_group.run([&num_executed]() { ++num_executed; });
+      }
+      inner_group.wait();
+    });
+  }
+  outer_group.wait();
+  EXPECT_EQ(num_executed.load(), kNumOuterTasks * kNumInnerTasks);
+}
+
+TEST(MaplabCommon, ParallelProcessNested) {
+  constexpr size_t kNumOuter = 32u;
+  constexpr size_t kNumInner = 64u;
+  std::vector<std::vector<size_t>> results(
+      kNumOuter, std::vector<size_t>(kNumInner, 0u));
+
+  std::function<void(const std::vector<size_t>&)> outer_functor =
+      [&results](const std::vector<size_t>& outer_range) {
+        for (const size_t outer_idx : outer_range) {
+          std::vector<size_t>& row = results[outer_idx];
+          std::function<void(const std::vector<size_t>&)> inner_functor =
+              [&row, outer_idx](const std::vector<size_t>& inner_range) {
+                for (const size_t inner_idx : inner_range) {
+                  row[inner_idx] = outer_idx * kNumInner + inner_idx;
+                }
+              };
+          ParallelProcess(kNumInner, inner_functor, true, 8u);
+        }
+      };
+  ParallelProcess(kNumOuter, outer_functor, true, 8u);
+
+  for (size_t outer_idx = 0u; outer_idx < kNumOuter; ++outer_idx) {
+    for (size_t inner_idx = 0u; inner_idx < kNumInner; ++inner_idx) {
+      EXPECT_EQ(
+          results[outer_idx][inner_idx], outer_idx * kNumInner + inner_idx);
+    }
+  }
+}
+
+TEST(MaplabCommon, ParseCpuList) {
+  std::vector<int> cpu_cores;
+  EXPECT_TRUE(parseCpuList("0-3,8,10-11", &cpu_cores));
+  EXPECT_EQ(cpu_cores, std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_TRUE(parseCpuList(" 5\n", &cpu_cores));
+  EXPECT_EQ(cpu_cores, std::vector<int>({5}));
+  EXPECT_TRUE(parseCpuList("", &cpu_cores));
+  EXPECT_TRUE(cpu_cores.empty());
+
+  EXPECT_FALSE(parseCpuList("3-1", &cpu_cores));
+  EXPECT_FALSE(parseCpuList("a", &cpu_cores));
+  EXPECT_FALSE(parseCpuList("1-", &cpu_cores));
+  EXPECT_FALSE(parseCpuList("1x-2", &cpu_cores));
+}
+
+TEST(MaplabCommon, NumThreadsForSubsystem) {
+  const size_t num_hardware_threads = getNumHardwareThreads();
+  EXPECT_EQ(
+      getNumThreadsForSubsystem(ThreadingSubsystem::kOptimization),
+      num_hardware_threads);
+  EXPECT_EQ(
+      getNumThreadsForSubsystem(ThreadingSubsystem::kFeatureTracking, 1u), 1u);
+  EXPECT_EQ(
+      getNumThreadsForSubsystem(ThreadingSubsystem::kFeatureTracking, 0u), 1u);
+
+  // The subsystem flags are capped by the global budget.
+  FLAGS_threading_num_threads_optimization = num_hardware_threads + 1u;
+  EXPECT_EQ(
+      getNumThreadsForSubsystem(ThreadingSubsystem::kOptimization),
+      num_hardware_threads);
+  FLAGS_threading_num_threads_optimization = 1u;
+  EXPECT_EQ(getNumThreadsForSubsystem(ThreadingSubsystem::kOptimization), 1u);
+  FLAGS_threading_num_threads_optimization = 0u;
+}
+
+}  // namespace common
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,44 @@
+#include <fstream>  // NOLINT
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "maplab-common/test/testing-entrypoint.h"
+#include "maplab-common/tracing.h"
+
+namespace common {
+
+TEST(MaplabCommon, TracingRecordsOnlyWhileRecording) {
+  tracing::clear();
+  { tracing::ScopedTraceEvent event("test", "not recorded"); }
+  EXPECT_EQ(tracing::getNumRecordedEvents(), 0u);
+
+  tracing::startRecording();
+  constexpr size_t kNumThreads = 4u;
+  std::vector<std::thread> threads;
+  for (size_t i = 0u; i < kNumThreads; ++i) {
+    threads.emplace_back(
+        []() { tracing::ScopedTraceEvent event("test", "\"quoted\""); });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  tracing::stopRecording();
+  EXPECT_EQ(tracing::getNumRecordedEvents(), kNumThreads);
+
+  const std::string kTraceFile = "test_trace.json";
+  ASSERT_TRUE(tracing::writeChromeTrace(kTraceFile));
+  std::ifstream stream(kTraceFile);
+  std::stringstream content;
+  content << stream.rdbuf();
+  EXPECT_NE(content.str().find("\"traceEvents\""), std::string::npos);
+  EXPECT_NE(content.str().find("\\\"quoted\\\""), std::string::npos);
+
+  tracing::clear();
+  EXPECT_EQ(tracing::getNumRecordedEvents(), 0u);
+}
+
+}  // namespace common
+
+MAPLAB_UNITTEST_ENTRYPOINT
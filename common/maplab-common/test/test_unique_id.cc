@@ -0,0 +1,66 @@
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include "maplab-common/test/testing-entrypoint.h"
+#include "maplab-common/unique-id.h"
+
+namespace common {
+UNIQUE_ID_DEFINE_ID(TestId);
+}  // namespace common
+UNIQUE_ID_DEFINE_ID_HASH(common::TestId);
+
+namespace common {
+
+TEST(UniqueIdTest, GenerateIdsReturnsValidIds) {
+  constexpr size_t kNumIds = 1000u;
+  std::vector<TestId> ids;
+  generateIds(kNumIds, &ids);
+  ASSERT_EQ(kNumIds, ids.size());
+  const std::unordered_set<TestId> unique_ids(ids.begin(), ids.end());
+  EXPECT_EQ(kNumIds, unique_ids.size());
+  for (const TestId& id : ids) {
+    EXPECT_TRUE(id.isValid());
+  }
+
+  generateIds(0u, &ids);
+  EXPECT_TRUE(ids.empty());
+}
+
+TEST(UniqueIdTest, IdsAreUniqueAcrossThreads) {
+  constexpr size_t kNumThreads = 8u;
+  // Not a multiple of the batch and block sizes of the generators.
+  constexpr size_t kNumBulkIdsPerThread = 5001u;
+  constexpr size_t kNumSingleIdsPerThread = 3001u;
+  std::vector<std::vector<TestId>> ids_per_thread(kNumThreads);
+  std::vector<std::thread> threads;
+  for (size_t thread_idx = 0u; thread_idx < kNumThreads; ++thread_idx) {
+    std::vector<TestId>* ids = &ids_per_thread[thread_idx];
+    threads.emplace_back([ids]() {
+      generateIds(kNumBulkIdsPerThread, ids);
+      for (size_t idx = 0u; idx < kNumSingleIdsPerThread; ++idx) {
+        ids->emplace_back();
+        generateId(&ids->back());
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  std::unordered_set<TestId> unique_ids;
+  for (const std::vector<TestId>& ids : ids_per_thread) {
+    ASSERT_EQ(kNumBulkIdsPerThread + kNumSingleIdsPerThread, ids.size());
+    unique_ids.insert(ids.begin(), ids.end());
+  }
+  EXPECT_EQ(
+      kNumThreads * (kNumBulkIdsPerThread + kNumSingleIdsPerThread),
+      unique_ids.size());
+}
+
+}  // namespace common
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -1,20 +1,53 @@
 #ifndef MESSAGE_FLOW_MESSAGE_DELIVERY_QUEUE_H_
 #define MESSAGE_FLOW_MESSAGE_DELIVERY_QUEUE_H_
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <deque>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <glog/logging.h>
+#include <maplab-common/histograms.h>
 #include <maplab-common/unique-id.h>
 
 namespace message_flow {
 UNIQUE_ID_DEFINE_ID(MessageDeliveryQueueId);
 
+namespace internal {
+inline int64_t getSteadyClockNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+}  // namespace internal
+
+// Defines what happens to a newly published message if the delivery queue of
+// a subscriber already holds max_queue_size undelivered messages.
+enum class QueueFullPolicy {
+  // The publisher waits until the subscriber has taken a message from the
+  // queue. Do not use this for subscribers that (indirectly) publish to
+  // themselves, as the publisher may then wait forever.
+  kBlockPublisher,
+  // The oldest undelivered message is dropped.
+  kDropOldest,
+  // The new message is dropped.
+  kDropNewest,
+  // Only the latest message is kept, i.e. kDropOldest with a queue size of one
+  // independent of max_queue_size.
+  kKeepLatest
+};
+
 struct DeliveryOptions {
-  DeliveryOptions() : exclusivity_group_id(-1) {}
+  DeliveryOptions()
+      : exclusivity_group_id(-1),
+        max_queue_size(0u),
+        queue_full_policy(QueueFullPolicy::kDropOldest) {}
   // Ensures the exclusive execution of deliveries across all subscribers with
   // the same group id. With a FIFO message dispatcher, this will expand the
   // delivery order guarantees across multiple subscribers. I.e. not only all
@@ -23,15 +56,59 @@ struct DeliveryOptions {
   // delivered in the publishing order.
   // A negative value means no exclusivity is enforced.
   int exclusivity_group_id;
+
+  // Maximum number of undelivered messages in the queue of this subscriber.
+  // Zero means the queue is unbounded; then the policy is only used if it is
+  // kKeepLatest.
+  size_t max_queue_size;
+  QueueFullPolicy queue_full_policy;
 };
 
 class MessageDeliveryQueueBase {
  public:
+  MessageDeliveryQueueBase() : num_dropped_messages_(0u) {}
   virtual ~MessageDeliveryQueueBase() {}
   virtual void deliverOldestMessage() = 0;
   virtual std::string getTopicName() const = 0;
   virtual const DeliveryOptions& getDeliveryOptions() const = 0;
   virtual size_t size() const = 0;
+  // Releases all blocked publishers; messages published from now on are
+  // dropped.
+  virtual void shutdown() = 0;
+
+  // Number of messages dropped because the queue was full.
+  size_t getNumDroppedMessages() const {
+    return num_dropped_messages_.load(std::memory_order_relaxed);
+  }
+
+  // Time from publishing a message until its subscriber callback is started,
+  // in nanoseconds. This includes the time spent waiting in the queue and in
+  // the dispatcher.
+  const common::histograms::ExponentialHistogram&
+  getPublishToDeliveryLatencyHistogram() const {
+    return publish_to_delivery_ns_;
+  }
+  // Runtime of the subscriber callback, in nanoseconds.
+  const common::histograms::ExponentialHistogram&
+  getCallbackDurationHistogram() const {
+    return callback_duration_ns_;
+  }
+  void resetLatencyHistograms() {
+    publish_to_delivery_ns_.reset();
+    callback_duration_ns_.reset();
+  }
+
+ protected:
+  static uint64_t getElapsedNanoseconds(
+      int64_t start_time_ns, int64_t end_time_ns) {
+    return end_time_ns > start_time_ns
+               ? static_cast<uint64_t>(end_time_ns - start_time_ns)
+               : 0u;
+  }
+
+  common::histograms::ExponentialHistogram publish_to_delivery_ns_;
+  common::histograms::ExponentialHistogram callback_duration_ns_;
+  std::atomic<size_t> num_dropped_messages_;
 };
 typedef std::shared_ptr<MessageDeliveryQueueBase> MessageDeliveryQueueBasePtr;
 
@@ -46,29 +123,73 @@ class MessageDeliveryQueue : public MessageDeliveryQueueBase {
       const SubscriberCallback& subscriber_callback,
       const DeliveryOptions& delivery_options)
       : delivery_options_(delivery_options),
-        subscriber_callback_(subscriber_callback) {
+        max_queue_size_(
+            delivery_options.queue_full_policy == QueueFullPolicy::kKeepLatest
+                ? 1u
+                : delivery_options.max_queue_size),
+        subscriber_callback_(subscriber_callback),
+        is_shutdown_(false) {
     CHECK(subscriber_callback);
   }
   virtual ~MessageDeliveryQueue() {}
 
-  void queueMessageForDelivery(const MessageType& message) {
-    std::lock_guard<std::mutex> lock(m_message_queue_);
-    message_queue_.emplace_back(message);
+  // Returns false if the message was dropped. Otherwise, the dispatcher needs
+  // to be notified about the new message.
+  bool queueMessageForDelivery(const MessageType& message) {
+    const int64_t publish_time_ns = internal::getSteadyClockNanoseconds();
+    std::unique_lock<std::mutex> lock(m_message_queue_);
+    if (max_queue_size_ > 0u && message_queue_.size() >= max_queue_size_) {
+      switch (delivery_options_.queue_full_policy) {
+        case QueueFullPolicy::kBlockPublisher:
+          cv_queue_not_full_.wait(lock, [this]() {
+            return is_shutdown_ || message_queue_.size() < max_queue_size_;
+          });
+          break;
+        case QueueFullPolicy::kDropOldest:
+        case QueueFullPolicy::kKeepLatest:
+          // The dispatcher has already been notified about the dropped
+          // message; the corresponding delivery will find the new message, so
+          // no further notification is needed.
+          message_queue_.pop_front();
+          message_queue_.emplace_back(publish_time_ns, message);
+          ++num_dropped_messages_;
+          return false;
+        case QueueFullPolicy::kDropNewest:
+          ++num_dropped_messages_;
+          return false;
+        default:
+          LOG(FATAL) << "Unknown queue full policy.";
+      }
+    }
+    if (is_shutdown_) {
+      ++num_dropped_messages_;
+      return false;
+    }
+    message_queue_.emplace_back(publish_time_ns, message);
+    return true;
   }
 
   void deliverOldestMessage() final {
     MessageType message;
+    int64_t publish_time_ns;
     {
       std::lock_guard<std::mutex> lock(m_message_queue_);
       CHECK(!message_queue_.empty());
-      message = message_queue_.front();
+      publish_time_ns = message_queue_.front().first;
+      message = std::move(message_queue_.front().second);
       message_queue_.pop_front();
     }
+    cv_queue_not_full_.notify_one();
 
     // Run the subscriber callback; the lock ensures only one callback can be
     // run simultaneously.
     std::lock_guard<std::mutex> lock_subscriber(m_subscriber_execution_);
+    const int64_t delivery_time_ns = internal::getSteadyClockNanoseconds();
+    publish_to_delivery_ns_.addSample(
+        getElapsedNanoseconds(publish_time_ns, delivery_time_ns));
     subscriber_callback_(message);
+    callback_duration_ns_.addSample(getElapsedNanoseconds(
+        delivery_time_ns, internal::getSteadyClockNanoseconds()));
   }
 
   std::string getTopicName() const final {
@@ -89,16 +210,29 @@ class MessageDeliveryQueue : public MessageDeliveryQueueBase {
     return message_queue_.size();
   }
 
+  void shutdown() final {
+    {
+      std::lock_guard<std::mutex> lock(m_message_queue_);
+      is_shutdown_ = true;
+    }
+    cv_queue_not_full_.notify_all();
+  }
+
  private:
   const DeliveryOptions delivery_options_;
+  // Zero if the queue is unbounded.
+  const size_t max_queue_size_;
 
   // Protects the callback to prevent concurrent calls to the subscriber
   // callback.
   std::mutex m_subscriber_execution_;
   const SubscriberCallback subscriber_callback_;
 
+  // Messages with the steady clock time at which they were queued.
   mutable std::mutex m_message_queue_;
-  std::deque<MessageType> message_queue_;
+  std::deque<std::pair<int64_t, MessageType>> message_queue_;
+  std::condition_variable cv_queue_not_full_;
+  bool is_shutdown_;
 };
 }  // namespace message_flow
 UNIQUE_ID_DEFINE_ID_HASH(message_flow::MessageDeliveryQueueId);
@@ -0,0 +1,86 @@
+#ifndef MESSAGE_FLOW_MESSAGE_DISPATCHER_PRIORITY_H_
+#define MESSAGE_FLOW_MESSAGE_DISPATCHER_PRIORITY_H_
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "message-flow/message-delivery-queue.h"
+#include "message-flow/message-dispatcher.h"
+
+namespace message_flow {
+// Delivers the published messages according to per-topic priorities. Whenever
+// a worker thread becomes available, it delivers the pending message with the
+// highest priority; messages of equal priority are delivered in publishing
+// order. Running callbacks are not interrupted, so an urgent message may still
+// wait for one callback per worker. Latency-critical topics can therefore be
+// served by dedicated worker threads that do not run any other topic.
+// Optionally, worker threads can be pinned to CPU cores.
+//
+// The ordering guarantees of MessageDispatcherFifo hold within each worker
+// group (the shared workers or one dedicated thread): the messages of a
+// subscriber are delivered in publishing order and subscribers with the same
+// exclusivity group id never run concurrently. All subscribers of an
+// exclusivity group must therefore be served by the same worker group.
+class MessageDispatcherPriority : public MessageDispatcher {
+ public:
+  struct TopicOptions {
+    TopicOptions() : priority(0), dedicated_thread(false), cpu_core(-1) {}
+    // Messages with a higher priority are delivered first.
+    int priority;
+    // Run the subscribers of this topic on a separate worker thread.
+    bool dedicated_thread;
+    // Pins the dedicated thread to this CPU core. A negative value means no
+    // pinning.
+    int cpu_core;
+  };
+
+  struct Options {
+    Options() : num_threads(1u), default_priority(0) {}
+    explicit Options(size_t _num_threads)
+        : num_threads(_num_threads), default_priority(0) {}
+
+    // Number of shared worker threads.
+    size_t num_threads;
+    // Shared worker i is pinned to cpu_cores_shared_threads[i % size]. If
+    // empty, the affinity of the workers follows the threading flags, see
+    // common::applyThreadAffinity().
+    std::vector<int> cpu_cores_shared_threads;
+    // Priority of all topics without topic options.
+    int default_priority;
+    // Options per topic name, i.e. the name used in MESSAGE_FLOW_TOPIC.
+    std::unordered_map<std::string, TopicOptions> topic_options;
+  };
+
+  explicit MessageDispatcherPriority(size_t num_threads);
+  explicit MessageDispatcherPriority(const Options& options);
+  virtual ~MessageDispatcherPriority();
+
+  virtual void newMessageInQueue(const MessageDeliveryQueueBasePtr& queue);
+  virtual void shutdown();
+  virtual void waitUntilIdle() const;
+
+ private:
+  // A set of worker threads with a common priority queue of deliveries.
+  class WorkerGroup;
+
+  void initialize();
+  WorkerGroup* getWorkerGroupForTopic(const std::string& topic_name);
+  int getPriorityForTopic(const std::string& topic_name) const;
+
+  const Options options_;
+
+  WorkerGroup* shared_workers_;
+  std::vector<std::unique_ptr<WorkerGroup>> worker_groups_;
+  std::unordered_map<std::string, WorkerGroup*> dedicated_workers_per_topic_;
+
+  // Verifies that all subscribers of an exclusivity group use the same worker
+  // group.
+  std::mutex m_exclusivity_groups_;
+  std::unordered_map<size_t, const WorkerGroup*>
+      worker_group_per_exclusivity_group_;
+};
+}  // namespace message_flow
+#endif  // MESSAGE_FLOW_MESSAGE_DISPATCHER_PRIORITY_H_
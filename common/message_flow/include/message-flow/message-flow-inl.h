@@ -68,10 +68,12 @@ void MessageFlow::registerSubscriber(
     // according to its policy later.
     const auto add_message_to_queue_fct = [&node_queue, this](
         const typename MessageTopicDefinition::message_type& message) -> void {
-      std::static_pointer_cast<MessageQueueDerived>(node_queue)
-          ->queueMessageForDelivery(message);
-      // Signal the dispatcher that a new message has been put into the queues.
-      this->message_dispatcher_->newMessageInQueue(node_queue);
+      // Signal the dispatcher if a new message has been put into the queue;
+      // the queue may also drop it or replace an undelivered message with it.
+      if (std::static_pointer_cast<MessageQueueDerived>(node_queue)
+              ->queueMessageForDelivery(message)) {
+        this->message_dispatcher_->newMessageInQueue(node_queue);
+      }
     };
 
     subscriber_network_.addSubscriber<MessageTopicDefinition>(
@@ -0,0 +1,115 @@
+#ifndef MESSAGE_FLOW_MESSAGE_FLOW_RECORDER_H_
+#define MESSAGE_FLOW_MESSAGE_FLOW_RECORDER_H_
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include <glog/logging.h>
+#include <maplab-common/macros.h>
+
+#include "message-flow/message-delivery-queue.h"
+#include "message-flow/message-flow.h"
+#include "message-flow/message-log.h"
+
+namespace message_flow {
+// Records the messages of selected topics of a message flow to a message log.
+// A MessageSerializer needs to be defined for the message type of every
+// recorded topic. The recorder subscribes to the topics with a common
+// exclusivity group, hence with a FIFO dispatcher the messages are recorded in
+// publishing order. The timestamps are taken from the steady clock on
+// delivery to the recorder.
+class MessageFlowRecorder {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(MessageFlowRecorder);
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(MessageFlowRecorder);
+
+  // The exclusivity group must not be used by any other subscriber.
+  MessageFlowRecorder(const std::string& file_path, int exclusivity_group_id);
+
+  template <typename MessageTopicDefinition>
+  void recordTopic(MessageFlow* flow);
+
+  size_t getNumRecordedMessages() const {
+    return writer_.getNumMessages();
+  }
+
+ private:
+  MessageLogWriter writer_;
+  DeliveryOptions delivery_options_;
+};
+
+// Publishes the messages of a message log on a message flow, in the recorded
+// order and from a single thread. Only the topics registered with
+// replayTopic() are published; the messages of all other topics are skipped.
+// This allows to feed a recording into any subset of the nodes of a pipeline.
+class MessageFlowPlayer {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(MessageFlowPlayer);
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(MessageFlowPlayer);
+
+  explicit MessageFlowPlayer(const std::string& file_path);
+
+  template <typename MessageTopicDefinition>
+  void replayTopic(MessageFlow* flow);
+
+  // Blocks until all messages have been published or stop() is called. With a
+  // playback rate of 1.0, the messages are published with the recorded time
+  // between them, with a rate of 2.0 twice as fast. A rate of zero publishes
+  // the messages as fast as possible. Returns the number of published
+  // messages.
+  size_t play(double playback_rate);
+  void stop() {
+    stop_requested_ = true;
+  }
+
+ private:
+  typedef std::function<bool(const std::string&)> DeserializeAndPublish;
+
+  const std::string file_path_;
+  std::unordered_map<std::string, DeserializeAndPublish> topic_publishers_;
+  std::atomic<bool> stop_requested_;
+};
+
+template <typename MessageTopicDefinition>
+void MessageFlowRecorder::recordTopic(MessageFlow* flow) {
+  CHECK_NOTNULL(flow);
+  typedef typename MessageTopicDefinition::message_type MessageType;
+  static constexpr char kSubscriberNodeName[] = "MessageFlowRecorder";
+  flow->registerSubscriber<MessageTopicDefinition>(
+      kSubscriberNodeName, delivery_options_,
+      [this](const MessageType& message) {
+        std::string payload;
+        MessageSerializer<MessageType>::serialize(message, &payload);
+        writer_.writeMessage(
+            MessageTopicDefinition::kMessageTopic,
+            internal::getSteadyClockNanoseconds(), payload);
+      });
+}
+
+template <typename MessageTopicDefinition>
+void MessageFlowPlayer::replayTopic(MessageFlow* flow) {
+  CHECK_NOTNULL(flow);
+  typedef typename MessageTopicDefinition::message_type MessageType;
+  std::function<void(const MessageType&)> publish =
+      flow->registerPublisher<MessageTopicDefinition>();
+  const bool inserted =
+      topic_publishers_
+          .emplace(
+              MessageTopicDefinition::kMessageTopic,
+              [publish](const std::string& payload) {
+                MessageType message;
+                if (!MessageSerializer<MessageType>::deserialize(
+                        payload, &message)) {
+                  return false;
+                }
+                publish(message);
+                return true;
+              })
+          .second;
+  CHECK(inserted) << "Topic " << MessageTopicDefinition::kMessageTopic
+                  << " is already replayed.";
+}
+}  // namespace message_flow
+#endif  // MESSAGE_FLOW_MESSAGE_FLOW_RECORDER_H_
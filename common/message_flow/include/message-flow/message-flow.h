@@ -4,6 +4,10 @@
 #include <mutex>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <maplab-common/histograms.h>
 
 #include "message-flow/callback-types.h"
 #include "message-flow/message-delivery-queue.h"
@@ -11,13 +15,25 @@
 #include "message-flow/subscriber-network.h"
 
 namespace message_flow {
+// Snapshot of the latency histograms of one subscriber delivery queue.
+struct DeliveryQueueLatencies {
+  std::string subscriber_node_name;
+  std::string topic_name;
+  MessageDeliveryQueueId queue_id;
+  common::histograms::ExponentialHistogram publish_to_delivery_ns;
+  common::histograms::ExponentialHistogram callback_duration_ns;
+  // Messages dropped because the queue was full.
+  size_t num_dropped_messages;
+};
+
 class MessageFlow {
  public:
-  // Caller takes ownership.
-  template <typename MessageDispatcherType>
-  static MessageFlow* create(size_t num_threads) {
-    return new MessageFlow(
-        std::make_shared<MessageDispatcherType>(num_threads));
+  // Caller takes ownership. The arguments are forwarded to the constructor of
+  // the dispatcher, e.g. the number of threads or the dispatcher options.
+  template <typename MessageDispatcherType, typename... DispatcherArgs>
+  static MessageFlow* create(DispatcherArgs&&... dispatcher_args) {
+    return new MessageFlow(std::make_shared<MessageDispatcherType>(
+        std::forward<DispatcherArgs>(dispatcher_args)...));
   }
   ~MessageFlow();
 
@@ -42,6 +58,16 @@ class MessageFlow {
 
   std::string printDeliveryQueueStatistics() const;
 
+  // Latency histograms of all delivery queues, can be queried at runtime and
+  // stay available after shutdown().
+  void getDeliveryQueueLatencies(
+      std::vector<DeliveryQueueLatencies>* latencies) const;
+  std::string printDeliveryQueueLatencyStatistics() const;
+  // Writes the non-empty bins of all latency histograms to a CSV file with the
+  // columns: subscriber, topic, histogram, bin lower bound [ns], bin upper
+  // bound [ns], count.
+  bool exportDeliveryQueueLatencies(const std::string& file_path) const;
+
  protected:
   explicit MessageFlow(const MessageDispatcherPtr& dispatcher);
 
@@ -0,0 +1,109 @@
+#ifndef MESSAGE_FLOW_MESSAGE_LOG_H_
+#define MESSAGE_FLOW_MESSAGE_LOG_H_
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/macros.h>
+
+namespace message_flow {
+// Converts the messages of a topic to and from a binary payload for the
+// message log. Specialize this for every message type that should be recorded
+// or replayed:
+//   template <>
+//   struct MessageSerializer<MyMessage> {
+//     static void serialize(const MyMessage& message, std::string* payload);
+//     static bool deserialize(const std::string& payload, MyMessage* message);
+//   };
+template <typename MessageType>
+struct MessageSerializer;
+
+// Serializer for trivially copyable message types, e.g. to specialize
+// MessageSerializer<double> as MessageSerializer<double> :
+// TriviallyCopyableMessageSerializer<double> {}.
+template <typename MessageType>
+struct TriviallyCopyableMessageSerializer {
+  static_assert(
+      std::is_trivially_copyable<MessageType>::value,
+      "The message type must be trivially copyable.");
+  static void serialize(const MessageType& message, std::string* payload) {
+    CHECK_NOTNULL(payload)->assign(
+        reinterpret_cast<const char*>(&message), sizeof(MessageType));
+  }
+  static bool deserialize(const std::string& payload, MessageType* message) {
+    CHECK_NOTNULL(message);
+    if (payload.size() != sizeof(MessageType)) {
+      return false;
+    }
+    memcpy(message, payload.data(), sizeof(MessageType));
+    return true;
+  }
+};
+
+// Appends messages with their topic and timestamp to a binary log file. The
+// file starts with a magic number and a format version, followed by records
+// of two kinds: a topic record assigns a numeric id to a topic name the first
+// time a topic is written, a message record holds the topic id, the timestamp
+// and the payload of one message. All integers are stored in host byte order.
+// This class is thread-safe.
+class MessageLogWriter {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(MessageLogWriter);
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(MessageLogWriter);
+
+  explicit MessageLogWriter(const std::string& file_path);
+  ~MessageLogWriter();
+
+  void writeMessage(
+      const std::string& topic_name, int64_t timestamp_ns,
+      const std::string& payload);
+  size_t getNumMessages() const;
+
+ private:
+  // Expects the caller to hold the mutex.
+  uint32_t getOrWriteTopicId(const std::string& topic_name);
+
+  mutable std::mutex m_file_;
+  std::ofstream file_;
+  std::unordered_map<std::string, uint32_t> topic_ids_;
+  size_t num_messages_;
+};
+
+// Reads the messages of a log written by MessageLogWriter in order.
+class MessageLogReader {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(MessageLogReader);
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(MessageLogReader);
+
+  struct Message {
+    std::string topic_name;
+    int64_t timestamp_ns;
+    std::string payload;
+  };
+
+  explicit MessageLogReader(const std::string& file_path);
+
+  // Returns false at the end of the log. A truncated last record, e.g. of an
+  // application that crashed while recording, is treated as the end of the
+  // log.
+  bool readNextMessage(Message* message);
+
+ private:
+  std::ifstream file_;
+  std::vector<std::string> topic_names_;
+};
+
+namespace internal {
+constexpr uint32_t kMessageLogMagicNumber = 0x474f4c4du;  // "MLOG"
+constexpr uint32_t kMessageLogVersion = 1u;
+enum class MessageLogRecordType : uint8_t { kTopic = 0u, kMessage = 1u };
+}  // namespace internal
+}  // namespace message_flow
+#endif  // MESSAGE_FLOW_MESSAGE_LOG_H_
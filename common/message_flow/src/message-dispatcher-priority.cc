@@ -0,0 +1,288 @@
+#include "message-flow/message-dispatcher-priority.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/accessors.h>
+#include <maplab-common/threading-helpers.h>
+
+namespace message_flow {
+class MessageDispatcherPriority::WorkerGroup {
+ public:
+  WorkerGroup(size_t num_threads, const std::vector<int>& cpu_cores)
+      : num_pending_deliveries_(0u), next_sequence_number_(0u), stop_(false) {
+    CHECK_GT(num_threads, 0u);
+    threads_.reserve(num_threads);
+    for (size_t thread_idx = 0u; thread_idx < num_threads; ++thread_idx) {
+      threads_.emplace_back(&WorkerGroup::run, this);
+      if (!cpu_cores.empty()) {
+        common::pinThreadToCpuCores(
+            {cpu_cores[thread_idx % cpu_cores.size()]}, &threads_.back());
+      } else {
+        common::applyThreadAffinity(thread_idx, &threads_.back());
+      }
+    }
+  }
+
+  ~WorkerGroup() {
+    stop();
+  }
+
+  void enqueue(
+      size_t exclusivity_group_id, int priority,
+      const MessageDeliveryQueueBasePtr& queue) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_) {
+      return;
+    }
+    ExclusivityGroup& group = exclusivity_groups_[exclusivity_group_id];
+    group.deliveries.emplace_back(queue, priority, next_sequence_number_++);
+    ++num_pending_deliveries_;
+    // Each idle group with pending deliveries has exactly one entry in the
+    // ready queue. A running group is added again once its delivery is done.
+    if (!group.running && group.deliveries.size() == 1u) {
+      pushReadyGroup(exclusivity_group_id, group);
+      cv_work_.notify_one();
+    }
+  }
+
+  // Delivers all pending messages and joins the worker threads.
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_work_.notify_all();
+    for (std::thread& thread : threads_) {
+      if (thread.joinable()) {
+        thread.join();
+      }
+    }
+  }
+
+  void waitUntilIdle() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_idle_.wait(lock, [this]() { return num_pending_deliveries_ == 0u; });
+  }
+
+  bool isIdle() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_pending_deliveries_ == 0u;
+  }
+
+ private:
+  struct Delivery {
+    Delivery(
+        const MessageDeliveryQueueBasePtr& _queue, int _priority,
+        uint64_t _sequence_number)
+        : queue(_queue), priority(_priority),
+          sequence_number(_sequence_number) {}
+    MessageDeliveryQueueBasePtr queue;
+    int priority;
+    uint64_t sequence_number;
+  };
+
+  struct ExclusivityGroup {
+    ExclusivityGroup() : running(false) {}
+    std::deque<Delivery> deliveries;
+    bool running;
+  };
+
+  struct ReadyGroup {
+    int priority;
+    uint64_t sequence_number;
+    size_t exclusivity_group_id;
+
+    // The top of the std::priority_queue is the group with the highest
+    // priority and, among those, the oldest delivery.
+    bool operator<(const ReadyGroup& other) const {
+      if (priority != other.priority) {
+        return priority < other.priority;
+      }
+      return sequence_number > other.sequence_number;
+    }
+  };
+
+  void pushReadyGroup(
+      size_t exclusivity_group_id, const ExclusivityGroup& group) {
+    CHECK(!group.deliveries.empty());
+    ReadyGroup ready_group;
+    ready_group.priority = group.deliveries.front().priority;
+    ready_group.sequence_number = group.deliveries.front().sequence_number;
+    ready_group.exclusivity_group_id = exclusivity_group_id;
+    ready_groups_.push(ready_group);
+  }
+
+  void run() {
+    while (true) {
+      size_t exclusivity_group_id;
+      MessageDeliveryQueueBasePtr queue;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_work_.wait(
+            lock, [this]() { return stop_ || !ready_groups_.empty(); });
+        if (ready_groups_.empty()) {
+          // Only reached on stop.
+          return;
+        }
+        exclusivity_group_id = ready_groups_.top().exclusivity_group_id;
+        ready_groups_.pop();
+        ExclusivityGroup& group =
+            common::getChecked(exclusivity_groups_, exclusivity_group_id);
+        CHECK(!group.running);
+        group.running = true;
+        queue = group.deliveries.front().queue;
+        group.deliveries.pop_front();
+      }
+
+      CHECK(queue);
+      queue->deliverOldestMessage();
+      queue.reset();
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ExclusivityGroup& group =
+            common::getChecked(exclusivity_groups_, exclusivity_group_id);
+        group.running = false;
+        if (group.deliveries.empty()) {
+          exclusivity_groups_.erase(exclusivity_group_id);
+        } else {
+          pushReadyGroup(exclusivity_group_id, group);
+          cv_work_.notify_one();
+        }
+        CHECK_GT(num_pending_deliveries_, 0u);
+        --num_pending_deliveries_;
+        if (num_pending_deliveries_ == 0u) {
+          cv_idle_.notify_all();
+        }
+      }
+    }
+  }
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_work_;
+  mutable std::condition_variable cv_idle_;
+  std::unordered_map<size_t, ExclusivityGroup> exclusivity_groups_;
+  std::priority_queue<ReadyGroup> ready_groups_;
+  // Number of queued and running deliveries.
+  size_t num_pending_deliveries_;
+  uint64_t next_sequence_number_;
+  bool stop_;
+  std::vector<std::thread> threads_;
+};
+
+MessageDispatcherPriority::MessageDispatcherPriority(size_t num_threads)
+    : options_(num_threads), shared_workers_(nullptr) {
+  initialize();
+}
+
+MessageDispatcherPriority::MessageDispatcherPriority(const Options& options)
+    : options_(options), shared_workers_(nullptr) {
+  initialize();
+}
+
+MessageDispatcherPriority::~MessageDispatcherPriority() {
+  shutdown();
+}
+
+void MessageDispatcherPriority::initialize() {
+  CHECK_GT(options_.num_threads, 0u);
+  worker_groups_.emplace_back(
+      new WorkerGroup(options_.num_threads, options_.cpu_cores_shared_threads));
+  shared_workers_ = worker_groups_.back().get();
+
+  for (const std::unordered_map<std::string, TopicOptions>::value_type& value :
+       options_.topic_options) {
+    const TopicOptions& topic_options = value.second;
+    if (!topic_options.dedicated_thread) {
+      continue;
+    }
+    std::vector<int> cpu_cores;
+    if (topic_options.cpu_core >= 0) {
+      cpu_cores.push_back(topic_options.cpu_core);
+    }
+    worker_groups_.emplace_back(new WorkerGroup(1u, cpu_cores));
+    CHECK(
+        dedicated_workers_per_topic_
+            .emplace(value.first, worker_groups_.back().get())
+            .second);
+  }
+}
+
+void MessageDispatcherPriority::newMessageInQueue(
+    const MessageDeliveryQueueBasePtr& queue) {
+  CHECK(queue);
+  const std::string topic_name = queue->getTopicName();
+  WorkerGroup* worker_group = getWorkerGroupForTopic(topic_name);
+  CHECK_NOTNULL(worker_group);
+
+  const DeliveryOptions& delivery_options = queue->getDeliveryOptions();
+  size_t exclusivity_group_id;
+  if (delivery_options.exclusivity_group_id < 0) {
+    // As in MessageDispatcherFifo, the exclusivity is derived from the queue
+    // if none is specified.
+    exclusivity_group_id = reinterpret_cast<size_t>(queue.get());
+  } else {
+    exclusivity_group_id = delivery_options.exclusivity_group_id;
+    std::lock_guard<std::mutex> lock(m_exclusivity_groups_);
+    const WorkerGroup*& group_worker_group =
+        worker_group_per_exclusivity_group_[exclusivity_group_id];
+    if (group_worker_group == nullptr) {
+      group_worker_group = worker_group;
+    }
+    CHECK_EQ(group_worker_group, worker_group)
+        << "All subscribers of exclusivity group " << exclusivity_group_id
+        << " must run on the same worker threads, but topic " << topic_name
+        << " does not.";
+  }
+  worker_group->enqueue(
+      exclusivity_group_id, getPriorityForTopic(topic_name), queue);
+}
+
+void MessageDispatcherPriority::shutdown() {
+  for (const std::unique_ptr<WorkerGroup>& worker_group : worker_groups_) {
+    worker_group->stop();
+  }
+}
+
+void MessageDispatcherPriority::waitUntilIdle() const {
+  // A callback running on one worker group can publish messages to another
+  // group that has already been waited for, so repeat until all are idle.
+  bool all_idle = false;
+  while (!all_idle) {
+    for (const std::unique_ptr<WorkerGroup>& worker_group : worker_groups_) {
+      worker_group->waitUntilIdle();
+    }
+    all_idle = true;
+    for (const std::unique_ptr<WorkerGroup>& worker_group : worker_groups_) {
+      all_idle &= worker_group->isIdle();
+    }
+  }
+}
+
+MessageDispatcherPriority::WorkerGroup*
+MessageDispatcherPriority::getWorkerGroupForTopic(
+    const std::string& topic_name) {
+  std::unordered_map<std::string, WorkerGroup*>::const_iterator it =
+      dedicated_workers_per_topic_.find(topic_name);
+  return it == dedicated_workers_per_topic_.end() ? shared_workers_
+                                                  : it->second;
+}
+
+int MessageDispatcherPriority::getPriorityForTopic(
+    const std::string& topic_name) const {
+  std::unordered_map<std::string, TopicOptions>::const_iterator it =
+      options_.topic_options.find(topic_name);
+  return it == options_.topic_options.end() ? options_.default_priority
+                                            : it->second.priority;
+}
+}  // namespace message_flow
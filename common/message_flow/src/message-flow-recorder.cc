@@ -0,0 +1,62 @@
+#include "message-flow/message-flow-recorder.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <glog/logging.h>
+
+namespace message_flow {
+MessageFlowRecorder::MessageFlowRecorder(
+    const std::string& file_path, int exclusivity_group_id)
+    : writer_(file_path) {
+  CHECK_GE(exclusivity_group_id, 0);
+  delivery_options_.exclusivity_group_id = exclusivity_group_id;
+}
+
+MessageFlowPlayer::MessageFlowPlayer(const std::string& file_path)
+    : file_path_(file_path), stop_requested_(false) {
+  CHECK(!file_path_.empty());
+}
+
+size_t MessageFlowPlayer::play(double playback_rate) {
+  CHECK_GE(playback_rate, 0.0);
+  stop_requested_ = false;
+  MessageLogReader reader(file_path_);
+
+  size_t num_published_messages = 0u;
+  bool is_first_message = true;
+  int64_t first_message_timestamp_ns = 0;
+  std::chrono::steady_clock::time_point playback_start_time;
+  MessageLogReader::Message message;
+  while (!stop_requested_ && reader.readNextMessage(&message)) {
+    std::unordered_map<std::string, DeserializeAndPublish>::const_iterator it =
+        topic_publishers_.find(message.topic_name);
+    if (it == topic_publishers_.end()) {
+      continue;
+    }
+
+    if (is_first_message) {
+      first_message_timestamp_ns = message.timestamp_ns;
+      playback_start_time = std::chrono::steady_clock::now();
+      is_first_message = false;
+    } else if (playback_rate > 0.0) {
+      // Sleep until the scaled recorded time since the first message has
+      // passed, so the playback does not drift due to the publishing time.
+      const std::chrono::nanoseconds time_since_start(
+          static_cast<int64_t>(
+              (message.timestamp_ns - first_message_timestamp_ns) /
+              playback_rate));
+      std::this_thread::sleep_until(playback_start_time + time_since_start);
+    }
+
+    if (it->second(message.payload)) {
+      ++num_published_messages;
+    } else {
+      LOG(WARNING) << "Could not deserialize a message on topic "
+                   << message.topic_name << ".";
+    }
+  }
+  return num_published_messages;
+}
+}  // namespace message_flow
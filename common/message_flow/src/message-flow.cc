@@ -1,9 +1,11 @@
 #include "message-flow/message-flow.h"
 
+#include <fstream>
 #include <iomanip>
 #include <mutex>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include <glog/logging.h>
 #include <maplab-common/accessors.h>
@@ -27,6 +29,13 @@ void MessageFlow::shutdown() {
   // then call to WaitUntilIdle() for a clean shutdown where all remaining
   // tasks can execute until the end.
   std::lock_guard<std::mutex> lock(mutex_network_and_maps_);
+  // Publishers blocked on a full queue hold the lock of the subscriber list, so
+  // they need to be released before the subscribers can be unregistered.
+  for (const MessageDeliveryQueueMap::value_type& value :
+       subscriber_message_queues_) {
+    CHECK(value.second);
+    value.second->shutdown();
+  }
   subscriber_network_.unregisterAllSubscribers();
   message_dispatcher_->shutdown();
 }
@@ -44,7 +53,8 @@ std::string MessageFlow::printDeliveryQueueStatistics() const {
   output << std::setiosflags(std::ios::left) << std::setw(kNumAlignment)
          << "subscriber-node" << std::setw(kNumAlignment) << "queue-topic"
          << std::setw(kNumAlignment) << "queue-id" << std::setw(kNumAlignment)
-         << "num elements" << std::endl;
+         << "num elements" << std::setw(kNumAlignment) << "num dropped"
+         << std::endl;
 
   for (const MessageDeliveryQueueMap::value_type& value :
        subscriber_message_queues_) {
@@ -56,8 +66,120 @@ std::string MessageFlow::printDeliveryQueueStatistics() const {
     output << std::setiosflags(std::ios::left) << std::setw(kNumAlignment)
            << subscriber_node_name << std::setw(kNumAlignment)
            << queue->getTopicName() << std::setw(kNumAlignment) << queue_id
-           << std::setw(kNumAlignment) << queue->size() << std::endl;
+           << std::setw(kNumAlignment) << queue->size()
+           << std::setw(kNumAlignment) << queue->getNumDroppedMessages()
+           << std::endl;
+  }
+  return output.str();
+}
+
+void MessageFlow::getDeliveryQueueLatencies(
+    std::vector<DeliveryQueueLatencies>* latencies) const {
+  CHECK_NOTNULL(latencies)->clear();
+  std::lock_guard<std::mutex> lock(mutex_network_and_maps_);
+  latencies->reserve(subscriber_message_queues_.size());
+  for (const MessageDeliveryQueueMap::value_type& value :
+       subscriber_message_queues_) {
+    const MessageDeliveryQueueBasePtr& queue = value.second;
+    CHECK(queue);
+    latencies->emplace_back();
+    DeliveryQueueLatencies& queue_latencies = latencies->back();
+    queue_latencies.subscriber_node_name =
+        common::getChecked(subscriber_node_names_, value.first);
+    queue_latencies.topic_name = queue->getTopicName();
+    queue_latencies.queue_id = value.first;
+    queue_latencies.publish_to_delivery_ns =
+        queue->getPublishToDeliveryLatencyHistogram();
+    queue_latencies.callback_duration_ns =
+        queue->getCallbackDurationHistogram();
+    queue_latencies.num_dropped_messages = queue->getNumDroppedMessages();
+  }
+}
+
+std::string MessageFlow::printDeliveryQueueLatencyStatistics() const {
+  std::vector<DeliveryQueueLatencies> latencies;
+  getDeliveryQueueLatencies(&latencies);
+
+  const auto print_histogram = [](
+      const common::histograms::ExponentialHistogram& histogram,
+      std::ostream* output) {
+    constexpr size_t kNumAlignmentNumbers = 10u;
+    constexpr double kNanosecondsToMilliseconds = 1e-6;
+    *CHECK_NOTNULL(output)
+        << std::setw(kNumAlignmentNumbers)
+        << histogram.getPercentile(50.0) * kNanosecondsToMilliseconds
+        << std::setw(kNumAlignmentNumbers)
+        << histogram.getPercentile(99.0) * kNanosecondsToMilliseconds
+        << std::setw(kNumAlignmentNumbers)
+        << histogram.getMax() * kNanosecondsToMilliseconds;
+  };
+
+  std::stringstream output;
+  constexpr size_t kNumAlignment = 30u;
+  constexpr size_t kNumAlignmentNumbers = 10u;
+  output << "Message delivery latencies [ms]:" << std::endl;
+  output << std::setiosflags(std::ios::left) << std::setw(kNumAlignment)
+         << "subscriber-node" << std::setw(kNumAlignment) << "queue-topic"
+         << std::setw(kNumAlignmentNumbers) << "count"
+         << std::setw(kNumAlignmentNumbers) << "queue-p50"
+         << std::setw(kNumAlignmentNumbers) << "queue-p99"
+         << std::setw(kNumAlignmentNumbers) << "queue-max"
+         << std::setw(kNumAlignmentNumbers) << "cb-p50"
+         << std::setw(kNumAlignmentNumbers) << "cb-p99"
+         << std::setw(kNumAlignmentNumbers) << "cb-max" << std::endl;
+  output << std::fixed << std::setprecision(3);
+  for (const DeliveryQueueLatencies& queue_latencies : latencies) {
+    output << std::setw(kNumAlignment) << queue_latencies.subscriber_node_name
+           << std::setw(kNumAlignment) << queue_latencies.topic_name
+           << std::setw(kNumAlignmentNumbers)
+           << queue_latencies.callback_duration_ns.getNumSamples();
+    print_histogram(queue_latencies.publish_to_delivery_ns, &output);
+    print_histogram(queue_latencies.callback_duration_ns, &output);
+    output << std::endl;
   }
   return output.str();
 }
+
+bool MessageFlow::exportDeliveryQueueLatencies(
+    const std::string& file_path) const {
+  CHECK(!file_path.empty());
+  std::ofstream file(file_path);
+  if (!file.is_open()) {
+    LOG(ERROR) << "Could not open " << file_path
+               << " to export the message delivery latencies.";
+    return false;
+  }
+
+  std::vector<DeliveryQueueLatencies> latencies;
+  getDeliveryQueueLatencies(&latencies);
+
+  typedef common::histograms::ExponentialHistogram Histogram;
+  const auto write_histogram = [&file](
+      const DeliveryQueueLatencies& queue_latencies,
+      const std::string& histogram_name, const Histogram& histogram) {
+    for (size_t bin_idx = 0u; bin_idx < Histogram::kNumBins; ++bin_idx) {
+      const uint64_t count = histogram.getBinCount(bin_idx);
+      if (count == 0u) {
+        continue;
+      }
+      file << queue_latencies.subscriber_node_name << ","
+           << queue_latencies.topic_name << "," << histogram_name << ","
+           << Histogram::getBinLowerBound(bin_idx) << ","
+           << Histogram::getBinUpperBound(bin_idx) << "," << count
+           << std::endl;
+    }
+  };
+
+  file << "subscriber,topic,histogram,bin_lower_ns,bin_upper_ns,count"
+       << std::endl;
+  for (const DeliveryQueueLatencies& queue_latencies : latencies) {
+    write_histogram(
+        queue_latencies, "publish_to_delivery",
+        queue_latencies.publish_to_delivery_ns);
+    write_histogram(
+        queue_latencies, "callback_duration",
+        queue_latencies.callback_duration_ns);
+  }
+  return file.good();
+}
 }  // namespace message_flow
@@ -0,0 +1,137 @@
+#include "message-flow/message-log.h"
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+#include <glog/logging.h>
+
+namespace message_flow {
+namespace {
+template <typename Type>
+void writeValue(const Type& value, std::ofstream* file) {
+  CHECK_NOTNULL(file)->write(
+      reinterpret_cast<const char*>(&value), sizeof(Type));
+}
+
+void writeString(const std::string& value, std::ofstream* file) {
+  writeValue(static_cast<uint32_t>(value.size()), file);
+  CHECK_NOTNULL(file)->write(value.data(), value.size());
+}
+
+template <typename Type>
+bool readValue(std::ifstream* file, Type* value) {
+  CHECK_NOTNULL(file)->read(reinterpret_cast<char*>(value), sizeof(Type));
+  return static_cast<bool>(*file);
+}
+
+bool readString(std::ifstream* file, std::string* value) {
+  CHECK_NOTNULL(value);
+  uint32_t size;
+  if (!readValue(file, &size)) {
+    return false;
+  }
+  value->resize(size);
+  if (size == 0u) {
+    return true;
+  }
+  file->read(&(*value)[0], size);
+  return static_cast<bool>(*file);
+}
+}  // namespace
+
+MessageLogWriter::MessageLogWriter(const std::string& file_path)
+    : file_(file_path, std::ios::out | std::ios::binary | std::ios::trunc),
+      num_messages_(0u) {
+  CHECK(file_.is_open()) << "Could not open the message log " << file_path
+                         << " for writing.";
+  writeValue(internal::kMessageLogMagicNumber, &file_);
+  writeValue(internal::kMessageLogVersion, &file_);
+}
+
+MessageLogWriter::~MessageLogWriter() {
+  std::lock_guard<std::mutex> lock(m_file_);
+  file_.flush();
+  LOG_IF(ERROR, !file_.good()) << "Writing the message log failed.";
+}
+
+void MessageLogWriter::writeMessage(
+    const std::string& topic_name, int64_t timestamp_ns,
+    const std::string& payload) {
+  std::lock_guard<std::mutex> lock(m_file_);
+  const uint32_t topic_id = getOrWriteTopicId(topic_name);
+  writeValue(internal::MessageLogRecordType::kMessage, &file_);
+  writeValue(topic_id, &file_);
+  writeValue(timestamp_ns, &file_);
+  writeString(payload, &file_);
+  ++num_messages_;
+}
+
+size_t MessageLogWriter::getNumMessages() const {
+  std::lock_guard<std::mutex> lock(m_file_);
+  return num_messages_;
+}
+
+uint32_t MessageLogWriter::getOrWriteTopicId(const std::string& topic_name) {
+  std::unordered_map<std::string, uint32_t>::const_iterator it =
+      topic_ids_.find(topic_name);
+  if (it != topic_ids_.end()) {
+    return it->second;
+  }
+  const uint32_t topic_id = static_cast<uint32_t>(topic_ids_.size());
+  topic_ids_.emplace(topic_name, topic_id);
+  writeValue(internal::MessageLogRecordType::kTopic, &file_);
+  writeValue(topic_id, &file_);
+  writeString(topic_name, &file_);
+  return topic_id;
+}
+
+MessageLogReader::MessageLogReader(const std::string& file_path)
+    : file_(file_path, std::ios::in | std::ios::binary) {
+  CHECK(file_.is_open()) << "Could not open the message log " << file_path
+                         << " for reading.";
+  uint32_t magic_number = 0u;
+  uint32_t version = 0u;
+  CHECK(readValue(&file_, &magic_number) && readValue(&file_, &version))
+      << "The message log " << file_path << " is empty.";
+  CHECK_EQ(magic_number, internal::kMessageLogMagicNumber)
+      << file_path << " is not a message log.";
+  CHECK_EQ(version, internal::kMessageLogVersion)
+      << "Unsupported message log version.";
+}
+
+bool MessageLogReader::readNextMessage(Message* message) {
+  CHECK_NOTNULL(message);
+  while (true) {
+    internal::MessageLogRecordType record_type;
+    uint32_t topic_id;
+    if (!readValue(&file_, &record_type) || !readValue(&file_, &topic_id)) {
+      return false;
+    }
+    switch (record_type) {
+      case internal::MessageLogRecordType::kTopic: {
+        CHECK_EQ(topic_id, topic_names_.size());
+        topic_names_.emplace_back();
+        if (!readString(&file_, &topic_names_.back())) {
+          return false;
+        }
+        break;
+      }
+      case internal::MessageLogRecordType::kMessage: {
+        CHECK_LT(topic_id, topic_names_.size());
+        if (!readValue(&file_, &message->timestamp_ns) ||
+            !readString(&file_, &message->payload)) {
+          return false;
+        }
+        message->topic_name = topic_names_[topic_id];
+        return true;
+      }
+      default:
+        LOG(FATAL) << "Corrupt message log: unknown record type "
+                   << static_cast<int>(record_type) << ".";
+    }
+  }
+  return false;
+}
+}  // namespace message_flow
@@ -0,0 +1,106 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/threadsafe-queue.h>
+
+#include "message-flow/message-dispatcher-fifo.h"
+#include "message-flow/message-flow-recorder.h"
+#include "message-flow/message-flow.h"
+#include "message-flow/message-log.h"
+#include "message-flow/message-topic-registration.h"
+
+MESSAGE_FLOW_TOPIC(RecordedTopicA, double);
+MESSAGE_FLOW_TOPIC(RecordedTopicB, int);
+
+namespace message_flow {
+template <>
+struct MessageSerializer<double>
+    : TriviallyCopyableMessageSerializer<double> {};
+template <>
+struct MessageSerializer<int> : TriviallyCopyableMessageSerializer<int> {};
+
+const std::string kLogFile("message_flow_recorder_test.mlog");
+constexpr int kRecorderExclusivityGroupId = 0;
+
+TEST(MessageFlow, MessageLogRoundTrip) {
+  {
+    MessageLogWriter writer(kLogFile);
+    writer.writeMessage("a", 10, "payload-a");
+    writer.writeMessage("b", 20, "");
+    writer.writeMessage("a", 30, std::string("\0x", 2));
+    EXPECT_EQ(writer.getNumMessages(), 3u);
+  }
+
+  MessageLogReader reader(kLogFile);
+  MessageLogReader::Message message;
+  ASSERT_TRUE(reader.readNextMessage(&message));
+  EXPECT_EQ(message.topic_name, "a");
+  EXPECT_EQ(message.timestamp_ns, 10);
+  EXPECT_EQ(message.payload, "payload-a");
+  ASSERT_TRUE(reader.readNextMessage(&message));
+  EXPECT_EQ(message.topic_name, "b");
+  EXPECT_EQ(message.timestamp_ns, 20);
+  EXPECT_TRUE(message.payload.empty());
+  ASSERT_TRUE(reader.readNextMessage(&message));
+  EXPECT_EQ(message.topic_name, "a");
+  EXPECT_EQ(message.payload, std::string("\0x", 2));
+  EXPECT_FALSE(reader.readNextMessage(&message));
+  std::remove(kLogFile.c_str());
+}
+
+TEST(MessageFlow, RecordAndReplay) {
+  constexpr size_t kNumMessages = 100u;
+  {
+    std::unique_ptr<MessageFlow> flow(
+        MessageFlow::create<MessageDispatcherFifo>(4u));
+    MessageFlowRecorder recorder(kLogFile, kRecorderExclusivityGroupId);
+    recorder.recordTopic<message_flow_topics::RecordedTopicA>(flow.get());
+    recorder.recordTopic<message_flow_topics::RecordedTopicB>(flow.get());
+
+    std::function<void(const double&)> publish_a =
+        flow->registerPublisher<message_flow_topics::RecordedTopicA>();
+    std::function<void(const int&)> publish_b =
+        flow->registerPublisher<message_flow_topics::RecordedTopicB>();
+    for (size_t i = 0u; i < kNumMessages; ++i) {
+      publish_a(static_cast<double>(i));
+      publish_b(static_cast<int>(i));
+    }
+    flow->waitUntilIdle();
+    EXPECT_EQ(recorder.getNumRecordedMessages(), 2u * kNumMessages);
+    flow->shutdown();
+    flow->waitUntilIdle();
+  }
+
+  // Only replay topic A.
+  std::unique_ptr<MessageFlow> flow(
+      MessageFlow::create<MessageDispatcherFifo>(4u));
+  common::ThreadSafeQueue<double> receive_queue;
+  flow->registerSubscriber<message_flow_topics::RecordedTopicA>(
+      "Receiver", DeliveryOptions(),
+      [&receive_queue](double value) { receive_queue.Push(value); });
+  size_t num_received_b = 0u;
+  flow->registerSubscriber<message_flow_topics::RecordedTopicB>(
+      "Receiver", DeliveryOptions(),
+      [&num_received_b](int /*value*/) { ++num_received_b; });
+
+  MessageFlowPlayer player(kLogFile);
+  player.replayTopic<message_flow_topics::RecordedTopicA>(flow.get());
+  constexpr double kMaxSpeed = 0.0;
+  EXPECT_EQ(player.play(kMaxSpeed), kNumMessages);
+  flow->waitUntilIdle();
+
+  ASSERT_EQ(receive_queue.Size(), kNumMessages);
+  double value;
+  for (size_t i = 0u; i < kNumMessages; ++i) {
+    ASSERT_TRUE(receive_queue.PopNonBlocking(&value));
+    EXPECT_EQ(value, static_cast<double>(i));
+  }
+  EXPECT_EQ(num_received_b, 0u);
+  flow->shutdown();
+  flow->waitUntilIdle();
+  std::remove(kLogFile.c_str());
+}
+}  // namespace message_flow
+MAPLAB_UNITTEST_ENTRYPOINT
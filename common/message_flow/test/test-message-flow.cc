@@ -5,6 +5,7 @@
 #include <maplab-common/threadsafe-queue.h>
 
 #include "message-flow/message-dispatcher-fifo.h"
+#include "message-flow/message-dispatcher-priority.h"
 #include "message-flow/message-flow.h"
 #include "message-flow/message-topic-registration.h"
 
@@ -194,5 +195,335 @@ TEST(
   flow->shutdown();
   flow->waitUntilIdle();
 }
+
+TEST(MessageFlow, DeliveryQueueLatencyHistograms) {
+  std::unique_ptr<MessageFlow> flow(
+      MessageFlow::create<MessageDispatcherFifo>(4u));
+
+  std::function<void(const double&)> publish_on_topic_a =
+      flow->registerPublisher<message_flow_topics::TopicA>();
+  constexpr int64_t kCallbackDurationUs = 200;
+  flow->registerSubscriber<message_flow_topics::TopicA>(
+      kSubscriberNode, DeliveryOptions(),
+      [kCallbackDurationUs](double /*value*/) {
+        std::this_thread::sleep_for(
+            std::chrono::microseconds(kCallbackDurationUs));
+      });
+
+  constexpr size_t kNumNumbers = 100u;
+  for (size_t number = 0; number < kNumNumbers; ++number) {
+    publish_on_topic_a(number);
+  }
+  flow->waitUntilIdle();
+  flow->shutdown();
+
+  // The histograms are still available after the shutdown.
+  std::vector<DeliveryQueueLatencies> latencies;
+  flow->getDeliveryQueueLatencies(&latencies);
+  ASSERT_EQ(latencies.size(), 1u);
+  EXPECT_EQ(latencies[0].subscriber_node_name, kSubscriberNode);
+  EXPECT_EQ(latencies[0].publish_to_delivery_ns.getNumSamples(), kNumNumbers);
+  EXPECT_EQ(latencies[0].callback_duration_ns.getNumSamples(), kNumNumbers);
+  EXPECT_GE(
+      latencies[0].callback_duration_ns.getMin(), kCallbackDurationUs * 1000u);
+  // Messages published at once wait for the preceding callbacks.
+  EXPECT_GE(
+      latencies[0].publish_to_delivery_ns.getMax(),
+      latencies[0].callback_duration_ns.getMin());
+
+  LOG(INFO) << flow->printDeliveryQueueLatencyStatistics();
+}
+
+TEST(MessageFlow, MessageDispatcherPriority_HigherPriorityDeliveredFirst) {
+  // A single shared worker is blocked by a message on TopicX. Messages on
+  // TopicA and TopicB published meanwhile are delivered by priority once the
+  // worker is released.
+  MessageDispatcherPriority::Options options(1u);
+  options.topic_options["TopicA"].priority = 10;
+  options.topic_options["TopicB"].priority = 0;
+  std::unique_ptr<MessageFlow> flow(
+      MessageFlow::create<MessageDispatcherPriority>(options));
+
+  std::promise<void> worker_blocked;
+  std::promise<void> release_worker;
+  std::shared_future<void> release_future(release_worker.get_future());
+  flow->registerSubscriber<message_flow_topics::TopicX>(
+      kSubscriberNode, DeliveryOptions(),
+      [&worker_blocked, release_future](double /*value*/) {
+        worker_blocked.set_value();
+        release_future.wait();
+      });
+  common::ThreadSafeQueue<double> receive_queue;
+  const auto receive_callback = [&receive_queue](double value) {
+    receive_queue.Push(value);
+  };
+  flow->registerSubscriber<message_flow_topics::TopicA>(
+      kSubscriberNode, DeliveryOptions(), receive_callback);
+  flow->registerSubscriber<message_flow_topics::TopicB>(
+      kSubscriberNode, DeliveryOptions(), receive_callback);
+
+  std::function<void(const double&)> publish_on_topic_x =
+      flow->registerPublisher<message_flow_topics::TopicX>();
+  std::function<void(const double&)> publish_on_topic_a =
+      flow->registerPublisher<message_flow_topics::TopicA>();
+  std::function<void(const double&)> publish_on_topic_b =
+      flow->registerPublisher<message_flow_topics::TopicB>();
+
+  publish_on_topic_x(0.0);
+  worker_blocked.get_future().wait();
+
+  // Low priority values are negative, high priority values are positive.
+  constexpr size_t kNumNumbers = 100u;
+  for (size_t number = 1u; number <= kNumNumbers; ++number) {
+    publish_on_topic_b(-static_cast<double>(number));
+    publish_on_topic_a(static_cast<double>(number));
+  }
+  release_worker.set_value();
+  flow->waitUntilIdle();
+
+  ASSERT_EQ(receive_queue.Size(), 2u * kNumNumbers);
+  double value;
+  for (size_t number = 1u; number <= kNumNumbers; ++number) {
+    ASSERT_TRUE(receive_queue.PopNonBlocking(&value));
+    EXPECT_EQ(value, static_cast<double>(number));
+  }
+  for (size_t number = 1u; number <= kNumNumbers; ++number) {
+    ASSERT_TRUE(receive_queue.PopNonBlocking(&value));
+    EXPECT_EQ(value, -static_cast<double>(number));
+  }
+  flow->shutdown();
+  flow->waitUntilIdle();
+}
+
+TEST(MessageFlow, MessageDispatcherPriority_MessageDeliveryOrderExclusivity) {
+  // Subscribers in the same exclusivity group are delivered in publishing
+  // order, also with multiple shared workers and different priorities.
+  MessageDispatcherPriority::Options options(8u);
+  options.topic_options["TopicA"].priority = 1;
+  std::unique_ptr<MessageFlow> flow(
+      MessageFlow::create<MessageDispatcherPriority>(options));
+
+  std::function<void(const double&)> publish_on_topic_a =
+      flow->registerPublisher<message_flow_topics::TopicA>();
+  std::function<void(const double&)> publish_on_topic_b =
+      flow->registerPublisher<message_flow_topics::TopicB>();
+  common::ThreadSafeQueue<double> receive_queue;
+  const auto receive_callback = [&receive_queue](double value) {
+    std::this_thread::sleep_for(
+        std::chrono::microseconds(rand() % 10));  // NOLINT
+    receive_queue.Push(value);
+  };
+
+  DeliveryOptions delivery_options;
+  delivery_options.exclusivity_group_id = 0;
+  flow->registerSubscriber<message_flow_topics::TopicA>(
+      kSubscriberNode, delivery_options, receive_callback);
+  flow->registerSubscriber<message_flow_topics::TopicB>(
+      kSubscriberNode, delivery_options, receive_callback);
+
+  size_t kNumNumbers = 1000u;
+  for (size_t number = 0; number < kNumNumbers; ++number) {
+    if (rand() % 2 == 0) {  // NOLINT
+      publish_on_topic_a(number);
+    } else {
+      publish_on_topic_b(number);
+    }
+  }
+  flow->waitUntilIdle();
+
+  ASSERT_EQ(receive_queue.Size(), kNumNumbers);
+  size_t counter = 0u;
+  double value;
+  while (receive_queue.PopNonBlocking(&value)) {
+    EXPECT_EQ(static_cast<double>(counter), value);
+    ++counter;
+  }
+  EXPECT_EQ(counter, kNumNumbers);
+  flow->shutdown();
+  flow->waitUntilIdle();
+}
+
+TEST(MessageFlow, MessageDispatcherPriority_DedicatedThread) {
+  // TopicA runs on a dedicated thread and is delivered while the shared
+  // worker is blocked.
+  MessageDispatcherPriority::Options options(1u);
+  options.topic_options["TopicA"].dedicated_thread = true;
+  std::unique_ptr<MessageFlow> flow(
+      MessageFlow::create<MessageDispatcherPriority>(options));
+
+  std::promise<void> release_worker;
+  std::shared_future<void> release_future(release_worker.get_future());
+  flow->registerSubscriber<message_flow_topics::TopicX>(
+      kSubscriberNode, DeliveryOptions(),
+      [release_future](double /*value*/) { release_future.wait(); });
+  std::promise<double> result_on_topic_a;
+  flow->registerSubscriber<message_flow_topics::TopicA>(
+      kSubscriberNode, DeliveryOptions(),
+      [&result_on_topic_a](double a) { result_on_topic_a.set_value(a); });
+
+  std::function<void(const double&)> publish_on_topic_x =
+      flow->registerPublisher<message_flow_topics::TopicX>();
+  std::function<void(const double&)> publish_on_topic_a =
+      flow->registerPublisher<message_flow_topics::TopicA>();
+
+  publish_on_topic_x(0.0);
+  constexpr double kNumberA = 10.0;
+  publish_on_topic_a(kNumberA);
+  std::future<double> f_result_on_topic_a = result_on_topic_a.get_future();
+  ASSERT_EQ(
+      f_result_on_topic_a.wait_for(std::chrono::seconds(10)),
+      std::future_status::ready);
+  EXPECT_EQ(f_result_on_topic_a.get(), kNumberA);
+
+  release_worker.set_value();
+  flow->waitUntilIdle();
+  flow->shutdown();
+  flow->waitUntilIdle();
+}
+
+class BlockedMessageFlowTest : public ::testing::Test {
+ protected:
+  // Creates a flow with a single worker that is blocked by a message on
+  // TopicX until releaseWorker() is called.
+  virtual void SetUp() {
+    flow_.reset(MessageFlow::create<MessageDispatcherPriority>(1u));
+    std::shared_future<void> release_future(release_worker_.get_future());
+    std::promise<void>* worker_blocked = &worker_blocked_;
+    flow_->registerSubscriber<message_flow_topics::TopicX>(
+        kSubscriberNode, DeliveryOptions(),
+        [worker_blocked, release_future](double /*value*/) {
+          worker_blocked->set_value();
+          release_future.wait();
+        });
+    publish_on_topic_a_ =
+        flow_->registerPublisher<message_flow_topics::TopicA>();
+  }
+
+  void blockWorker() {
+    flow_->registerPublisher<message_flow_topics::TopicX>()(0.0);
+    worker_blocked_.get_future().wait();
+  }
+
+  void releaseWorker() {
+    release_worker_.set_value();
+  }
+
+  void subscribeToTopicA(const DeliveryOptions& delivery_options) {
+    flow_->registerSubscriber<message_flow_topics::TopicA>(
+        kSubscriberNode, delivery_options,
+        [this](double value) { receive_queue_.Push(value); });
+  }
+
+  size_t getNumDroppedMessagesOnTopicA() const {
+    std::vector<DeliveryQueueLatencies> statistics;
+    flow_->getDeliveryQueueLatencies(&statistics);
+    for (const DeliveryQueueLatencies& queue_statistics : statistics) {
+      if (queue_statistics.topic_name == "TopicA") {
+        return queue_statistics.num_dropped_messages;
+      }
+    }
+    return 0u;
+  }
+
+  std::vector<double> getReceivedValues() {
+    std::vector<double> values;
+    double value;
+    while (receive_queue_.PopNonBlocking(&value)) {
+      values.push_back(value);
+    }
+    return values;
+  }
+
+  virtual void TearDown() {
+    flow_->shutdown();
+    flow_->waitUntilIdle();
+  }
+
+  std::unique_ptr<MessageFlow> flow_;
+  std::function<void(const double&)> publish_on_topic_a_;  // NOLINT
+  common::ThreadSafeQueue<double> receive_queue_;
+
+ private:
+  std::promise<void> worker_blocked_;
+  std::promise<void> release_worker_;
+};
+
+TEST_F(BlockedMessageFlowTest, DropOldest) {
+  DeliveryOptions delivery_options;
+  delivery_options.max_queue_size = 3u;
+  delivery_options.queue_full_policy = QueueFullPolicy::kDropOldest;
+  subscribeToTopicA(delivery_options);
+
+  blockWorker();
+  for (size_t number = 0u; number < 10u; ++number) {
+    publish_on_topic_a_(number);
+  }
+  releaseWorker();
+  flow_->waitUntilIdle();
+
+  EXPECT_EQ(getReceivedValues(), std::vector<double>({7.0, 8.0, 9.0}));
+  EXPECT_EQ(getNumDroppedMessagesOnTopicA(), 7u);
+}
+
+TEST_F(BlockedMessageFlowTest, DropNewest) {
+  DeliveryOptions delivery_options;
+  delivery_options.max_queue_size = 3u;
+  delivery_options.queue_full_policy = QueueFullPolicy::kDropNewest;
+  subscribeToTopicA(delivery_options);
+
+  blockWorker();
+  for (size_t number = 0u; number < 10u; ++number) {
+    publish_on_topic_a_(number);
+  }
+  releaseWorker();
+  flow_->waitUntilIdle();
+
+  EXPECT_EQ(getReceivedValues(), std::vector<double>({0.0, 1.0, 2.0}));
+  EXPECT_EQ(getNumDroppedMessagesOnTopicA(), 7u);
+}
+
+TEST_F(BlockedMessageFlowTest, KeepLatest) {
+  DeliveryOptions delivery_options;
+  delivery_options.queue_full_policy = QueueFullPolicy::kKeepLatest;
+  subscribeToTopicA(delivery_options);
+
+  blockWorker();
+  for (size_t number = 0u; number < 10u; ++number) {
+    publish_on_topic_a_(number);
+  }
+  releaseWorker();
+  flow_->waitUntilIdle();
+
+  EXPECT_EQ(getReceivedValues(), std::vector<double>({9.0}));
+  EXPECT_EQ(getNumDroppedMessagesOnTopicA(), 9u);
+}
+
+TEST_F(BlockedMessageFlowTest, BlockPublisher) {
+  DeliveryOptions delivery_options;
+  delivery_options.max_queue_size = 2u;
+  delivery_options.queue_full_policy = QueueFullPolicy::kBlockPublisher;
+  subscribeToTopicA(delivery_options);
+
+  blockWorker();
+  constexpr size_t kNumNumbers = 10u;
+  std::future<void> publisher = std::async(std::launch::async, [this]() {
+    for (size_t number = 0u; number < kNumNumbers; ++number) {
+      publish_on_topic_a_(number);
+    }
+  });
+  EXPECT_EQ(
+      publisher.wait_for(std::chrono::milliseconds(50)),
+      std::future_status::timeout);
+  releaseWorker();
+  publisher.wait();
+  flow_->waitUntilIdle();
+
+  const std::vector<double> values = getReceivedValues();
+  ASSERT_EQ(values.size(), kNumNumbers);
+  for (size_t number = 0u; number < kNumNumbers; ++number) {
+    EXPECT_EQ(values[number], static_cast<double>(number));
+  }
+  EXPECT_EQ(getNumDroppedMessagesOnTopicA(), 0u);
+}
 }  // namespace message_flow
 MAPLAB_UNITTEST_ENTRYPOINT
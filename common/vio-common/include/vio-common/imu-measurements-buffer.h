@@ -11,7 +11,7 @@
 #include <Eigen/Dense>
 #include <glog/logging.h>
 #include <maplab-common/macros.h>
-#include <maplab-common/temporal-buffer.h>
+#include <maplab-common/temporal-ring-buffer.h>
 
 #include "vio-common/vio-types.h"
 
@@ -23,6 +23,9 @@ namespace vio_common {
 /// retrieve a list  of measurements up to a given timestamp. The data is stored
 /// in the order
 /// it is added. So make sure to add it in correct time-wise order.
+/// The measurements are kept in a ring buffer, such that adding measurements
+/// does not allocate once the buffer reached its capacity and the range
+/// queries are binary searches.
 class ImuMeasurementBuffer {
  public:
   MAPLAB_POINTER_TYPEDEFS(ImuMeasurementBuffer);
@@ -44,8 +47,17 @@ class ImuMeasurementBuffer {
     kTooFewMeasurementsAvailable
   };
 
+  typedef Eigen::Matrix<int64_t, 1, Eigen::Dynamic> ImuTimestamps;
+  typedef Eigen::Matrix<double, 6, Eigen::Dynamic> ImuMeasurements;
+
   explicit ImuMeasurementBuffer(int64_t buffer_length_ns)
-      : buffer_(buffer_length_ns), shutdown_(false) {}
+      : ImuMeasurementBuffer(buffer_length_ns, 0u) {}
+  /// Keeps at most max_num_measurements measurements and allocates the
+  /// storage for them up front. (max_num_measurements == 0: unbounded.)
+  ImuMeasurementBuffer(int64_t buffer_length_ns, size_t max_num_measurements)
+      : buffer_(buffer_length_ns, max_num_measurements), shutdown_(false) {
+    buffer_.reserve(max_num_measurements);
+  }
   ~ImuMeasurementBuffer() {
     shutdown();
   }
@@ -79,8 +91,16 @@ class ImuMeasurementBuffer {
   /// @return Was data removed from the buffer?
   QueryResult getImuDataInterpolatedBorders(
       int64_t timestamp_from, int64_t timestamp_to,
-      Eigen::Matrix<int64_t, 1, Eigen::Dynamic>* imu_timestamps,
-      Eigen::Matrix<double, 6, Eigen::Dynamic>* imu_measurements);
+      ImuTimestamps* imu_timestamps, ImuMeasurements* imu_measurements);
+
+  /// Same as above, but writes the measurements into the first
+  /// num_measurements columns of the output matrices. The output matrices
+  /// are only resized if they are too small, so reusing them across queries
+  /// avoids an allocation per query.
+  QueryResult getImuDataInterpolatedBorders(
+      int64_t timestamp_from, int64_t timestamp_to,
+      ImuTimestamps* imu_timestamps, ImuMeasurements* imu_measurements,
+      size_t* num_measurements);
 
   /// Try to pop the requested IMU measurements for the duration of
   /// wait_timeout_nanoseconds.
@@ -89,9 +109,8 @@ class ImuMeasurementBuffer {
   /// will return false and no data will be removed from the buffer.
   QueryResult getImuDataInterpolatedBordersBlocking(
       int64_t timestamp_ns_from, int64_t timestamp_ns_to,
-      int64_t wait_timeout_nanoseconds,
-      Eigen::Matrix<int64_t, 1, Eigen::Dynamic>* imu_timestamps,
-      Eigen::Matrix<double, 6, Eigen::Dynamic>* imu_measurements);
+      int64_t wait_timeout_nanoseconds, ImuTimestamps* imu_timestamps,
+      ImuMeasurements* imu_measurements);
 
   /// Linear interpolation between two imu measurements.
   static void linearInterpolate(
@@ -99,15 +118,23 @@ class ImuMeasurementBuffer {
       int64_t x, vio::ImuData* y);
 
  private:
-  /// Is data available up to this timestamp? Note this function does not lock
-  /// the buffers, the
-  /// caller must hold the lock.
-  QueryResult isDataAvailableUpToImpl(
-      int64_t timestamp_ns_from, int64_t timestamp_ns_to) const;
-
   typedef std::pair<int64_t, vio::ImuMeasurement> BufferElement;
   typedef Eigen::aligned_allocator<BufferElement> BufferAllocator;
-  typedef common::TemporalBuffer<vio::ImuMeasurement, BufferAllocator> Buffer;
+  typedef common::TemporalRingBuffer<vio::ImuMeasurement, BufferAllocator>
+      Buffer;
+
+  /// Is data available up to this timestamp?
+  QueryResult isDataAvailableUpTo(
+      int64_t timestamp_ns_from, int64_t timestamp_ns_to) const;
+  /// Note these functions do not lock the buffer, the caller must hold the
+  /// container lock.
+  QueryResult isDataAvailableUpToImpl(
+      const Buffer::BufferType& values, int64_t timestamp_ns_from,
+      int64_t timestamp_ns_to) const;
+  QueryResult getImuDataInterpolatedBordersImpl(
+      int64_t timestamp_ns_from, int64_t timestamp_ns_to,
+      bool resize_to_fit, ImuTimestamps* imu_timestamps,
+      ImuMeasurements* imu_measurements, size_t* num_measurements) const;
 
   Buffer buffer_;
   mutable std::mutex m_buffer_;
@@ -1,6 +1,9 @@
 #ifndef VIO_COMMON_VIO_TYPES_H_
 #define VIO_COMMON_VIO_TYPES_H_
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <utility>
 #include <vector>
 
@@ -32,6 +35,70 @@ MAPLAB_DEFINE_ENUM_HASHING(LocalizationState, int);
 enum class MotionType : int { kInvalid, kRotationOnly, kGeneralMotion };
 MAPLAB_DEFINE_ENUM_HASHING(MotionType, int);
 
+// Stages of the estimator an image passes on its way to a published estimate,
+// in processing order.
+enum class ProcessingStage : int {
+  // The image has been received by the datasource.
+  kImageReceived,
+  // The nframe containing the image has been released by the synchronizer.
+  kSynchronized,
+  kFeatureTracked,
+  kThrottled,
+  kLocalized,
+  // The ROVIO estimate or VIO update including the image has been created.
+  kEstimated,
+  kPublished,
+  kNumStages
+};
+MAPLAB_DEFINE_ENUM_HASHING(ProcessingStage, int);
+
+// Steady clock times at which a measurement passed the processing stages, for
+// latency statistics. Every stage can be stamped from a different thread,
+// hence the stamps are atomic.
+class ProcessingTimestamps {
+ public:
+  static constexpr size_t kNumStages =
+      static_cast<size_t>(ProcessingStage::kNumStages);
+
+  ProcessingTimestamps() {
+    for (std::atomic<int64_t>& timestamp_ns : timestamps_ns_) {
+      timestamp_ns = kUnsetTimestamp;
+    }
+  }
+  ProcessingTimestamps(const ProcessingTimestamps& other) {
+    *this = other;
+  }
+  ProcessingTimestamps& operator=(const ProcessingTimestamps& other) {
+    for (size_t stage_idx = 0u; stage_idx < kNumStages; ++stage_idx) {
+      timestamps_ns_[stage_idx] = other.timestamps_ns_[stage_idx].load();
+    }
+    return *this;
+  }
+
+  static int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  void stamp(ProcessingStage stage) {
+    set(stage, now());
+  }
+  void set(ProcessingStage stage, int64_t timestamp_ns) {
+    timestamps_ns_[static_cast<size_t>(stage)] = timestamp_ns;
+  }
+  bool has(ProcessingStage stage) const {
+    return get(stage) != kUnsetTimestamp;
+  }
+  int64_t get(ProcessingStage stage) const {
+    return timestamps_ns_[static_cast<size_t>(stage)];
+  }
+
+ private:
+  static constexpr int64_t kUnsetTimestamp = -1;
+  std::array<std::atomic<int64_t>, kNumStages> timestamps_ns_;
+};
+
 struct LocalizationResult {
   MAPLAB_POINTER_TYPEDEFS(LocalizationResult);
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -42,6 +109,9 @@ struct LocalizationResult {
 
   enum class LocalizationMode { kGlobal, kMapTracking };
   LocalizationMode localization_type;
+
+  /// Processing timestamps of the localized nframe.
+  ProcessingTimestamps processing_timestamps;
 };
 
 struct ImageMeasurement {
@@ -50,6 +120,7 @@ struct ImageMeasurement {
   int64_t timestamp;
   int camera_index;
   cv::Mat image;
+  ProcessingTimestamps processing_timestamps;
 
   ImageMeasurement()
       : timestamp(aslam::time::getInvalidTime()), camera_index(-1) {}
@@ -106,6 +177,10 @@ struct SynchronizedNFrameImu {
 
   /// Additional information obtained during feature tracking.
   MotionType motion_wrt_last_nframe;
+
+  /// The nframe is shared read-only between the subscribers of the tracked
+  /// nframes, which still stamp their processing stages.
+  mutable ProcessingTimestamps processing_timestamps;
 };
 
 /// The state of a ViNode (pose, velocity and bias).
@@ -0,0 +1,95 @@
+#ifndef VIO_COMMON_VIO_UPDATE_BINARY_SERIALIZATION_H_
+#define VIO_COMMON_VIO_UPDATE_BINARY_SERIALIZATION_H_
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+
+#include <aslam/cameras/ncamera.h>
+
+#include "vio-common/vio-update.h"
+
+namespace vio {
+namespace serialization {
+
+// Compact binary encoding of VIO updates for recording the VIO output at
+// camera rate, as opposed to the protobuf serialization that stores the full
+// precision of all fields. Per update, the encoding stores:
+//  - the timestamps as varint deltas to the previous update of the stream,
+//    the IMU and frame timestamps as deltas to the update timestamp,
+//  - the keypoints as zigzag varints quantized to keypoint_quantization_px,
+//  - the keypoint uncertainties, scales and IMU measurements as floats,
+//  - the track ids as zigzag varint deltas to the previous track id,
+//  - the descriptors, unless they are omitted,
+//  - the states and transformations in full precision.
+// The covariances of the VIO updates are not stored, as with the protobuf
+// serialization, and the camera rig has to be provided when reading.
+struct CompactVioUpdateEncodingOptions {
+  CompactVioUpdateEncodingOptions()
+      : keypoint_quantization_px(1.0 / 32.0), include_descriptors(true) {}
+  double keypoint_quantization_px;
+  // The read frames have no descriptors if they are omitted.
+  bool include_descriptors;
+};
+
+// Writes a stream of VIO updates. The stream starts with a header holding
+// the encoding options, followed by one length-prefixed record per update.
+class CompactVioUpdateWriter {
+ public:
+  CompactVioUpdateWriter(
+      const CompactVioUpdateEncodingOptions& options, std::ostream* out);
+
+  // Returns false if writing to the stream failed.
+  bool write(const vio::VioUpdate& update);
+
+  size_t getNumBytesWritten() const {
+    return num_bytes_written_;
+  }
+
+ private:
+  bool writeHeader();
+
+  const CompactVioUpdateEncodingOptions options_;
+  std::ostream* const out_;
+  bool header_written_;
+  int64_t last_timestamp_ns_;
+  size_t num_bytes_written_;
+  // Reused between the updates to avoid an allocation per update.
+  std::string record_;
+};
+
+// Reads the stream written by CompactVioUpdateWriter.
+class CompactVioUpdateReader {
+ public:
+  CompactVioUpdateReader(
+      const aslam::NCamera::Ptr& n_camera, std::istream* in);
+
+  // Returns false at the end of the stream or if the stream is corrupt, see
+  // isCorrupt().
+  bool read(vio::VioUpdate* update);
+
+  bool isCorrupt() const {
+    return corrupt_;
+  }
+
+  const CompactVioUpdateEncodingOptions& getOptions() const {
+    return options_;
+  }
+
+ private:
+  bool readHeader();
+
+  const aslam::NCamera::Ptr n_camera_;
+  std::istream* const in_;
+  CompactVioUpdateEncodingOptions options_;
+  bool header_read_;
+  bool corrupt_;
+  int64_t last_timestamp_ns_;
+  std::string record_;
+};
+
+}  // namespace serialization
+}  // namespace vio
+
+#endif  // VIO_COMMON_VIO_UPDATE_BINARY_SERIALIZATION_H_
@@ -15,22 +15,41 @@
 
 namespace vio_common {
 
-ImuMeasurementBuffer::QueryResult ImuMeasurementBuffer::isDataAvailableUpToImpl(
+namespace {
+struct TimestampLess {
+  template <typename BufferElement>
+  bool operator()(const BufferElement& element, int64_t timestamp_ns) const {
+    return element.first < timestamp_ns;
+  }
+};
+}  // namespace
+
+ImuMeasurementBuffer::QueryResult ImuMeasurementBuffer::isDataAvailableUpTo(
     int64_t timestamp_ns_from, int64_t timestamp_ns_to) const {
+  buffer_.lockContainer();
+  const QueryResult query_result = isDataAvailableUpToImpl(
+      buffer_.buffered_values(), timestamp_ns_from, timestamp_ns_to);
+  buffer_.unlockContainer();
+  return query_result;
+}
+
+ImuMeasurementBuffer::QueryResult ImuMeasurementBuffer::isDataAvailableUpToImpl(
+    const Buffer::BufferType& values, int64_t timestamp_ns_from,
+    int64_t timestamp_ns_to) const {
   CHECK_LT(timestamp_ns_from, timestamp_ns_to);
 
-  if (buffer_.empty()) {
+  if (values.empty()) {
     return QueryResult::kDataNotYetAvailable;
   }
 
-  vio::ImuMeasurement value;
-  const bool get_latest_value_success = buffer_.getNewestValue(&value);
-  if (get_latest_value_success && value.timestamp < timestamp_ns_to) {
+  const vio::ImuMeasurement& newest_value = (values.end() - 1)->second;
+  if (newest_value.timestamp < timestamp_ns_to) {
     return QueryResult::kDataNotYetAvailable;
   }
 
-  if (buffer_.getOldestValue(&value) && (value.timestamp >= timestamp_ns_to ||
-                                         timestamp_ns_from < value.timestamp)) {
+  const vio::ImuMeasurement& oldest_value = values.begin()->second;
+  if (oldest_value.timestamp >= timestamp_ns_to ||
+      timestamp_ns_from < oldest_value.timestamp) {
     return QueryResult::kDataNeverAvailable;
   }
   return QueryResult::kDataAvailable;
@@ -52,78 +71,111 @@ void ImuMeasurementBuffer::linearInterpolate(
 ImuMeasurementBuffer::QueryResult
 ImuMeasurementBuffer::getImuDataInterpolatedBorders(
     int64_t timestamp_ns_from, int64_t timestamp_ns_to,
-    Eigen::Matrix<int64_t, 1, Eigen::Dynamic>* imu_timestamps,
-    Eigen::Matrix<double, 6, Eigen::Dynamic>* imu_measurements) {
+    ImuTimestamps* imu_timestamps, ImuMeasurements* imu_measurements) {
+  size_t num_measurements;
+  constexpr bool kResizeToFit = true;
+  return getImuDataInterpolatedBordersImpl(
+      timestamp_ns_from, timestamp_ns_to, kResizeToFit, imu_timestamps,
+      imu_measurements, &num_measurements);
+}
+
+ImuMeasurementBuffer::QueryResult
+ImuMeasurementBuffer::getImuDataInterpolatedBorders(
+    int64_t timestamp_ns_from, int64_t timestamp_ns_to,
+    ImuTimestamps* imu_timestamps, ImuMeasurements* imu_measurements,
+    size_t* num_measurements) {
+  constexpr bool kResizeToFit = false;
+  return getImuDataInterpolatedBordersImpl(
+      timestamp_ns_from, timestamp_ns_to, kResizeToFit, imu_timestamps,
+      imu_measurements, num_measurements);
+}
+
+ImuMeasurementBuffer::QueryResult
+ImuMeasurementBuffer::getImuDataInterpolatedBordersImpl(
+    int64_t timestamp_ns_from, int64_t timestamp_ns_to, bool resize_to_fit,
+    ImuTimestamps* imu_timestamps, ImuMeasurements* imu_measurements,
+    size_t* num_measurements) const {
   CHECK_NOTNULL(imu_timestamps);
   CHECK_NOTNULL(imu_measurements);
+  CHECK_NOTNULL(num_measurements);
+  *num_measurements = 0u;
 
+  // The whole query runs on one consistent state of the buffer and copies
+  // the values straight into the output.
+  buffer_.lockContainer();
+  const Buffer::BufferType values = buffer_.buffered_values();
   QueryResult query_result =
-      isDataAvailableUpToImpl(timestamp_ns_from, timestamp_ns_to);
+      isDataAvailableUpToImpl(values, timestamp_ns_from, timestamp_ns_to);
+
+  // The data is available, so the oldest value is at or before
+  // timestamp_ns_from and the newest value at or after timestamp_ns_to.
+  Buffer::const_iterator it_after_from, it_at_or_after_to;
+  if (query_result == QueryResult::kDataAvailable) {
+    it_after_from = std::lower_bound(
+        values.begin(), values.end(), timestamp_ns_from + 1, TimestampLess());
+    it_at_or_after_to = std::lower_bound(
+        it_after_from, values.end(), timestamp_ns_to, TimestampLess());
+    CHECK(it_after_from != values.begin());
+    CHECK(it_at_or_after_to != values.end());
+    if (it_after_from == it_at_or_after_to) {
+      LOG(WARNING) << "Too few IMU measurements available between time "
+                   << timestamp_ns_from << "[ns] and " << timestamp_ns_to
+                   << "[ns].";
+      query_result = QueryResult::kTooFewMeasurementsAvailable;
+    }
+  }
   if (query_result != QueryResult::kDataAvailable) {
-    imu_timestamps->resize(Eigen::NoChange, 0);
-    imu_measurements->resize(Eigen::NoChange, 0);
+    buffer_.unlockContainer();
+    if (resize_to_fit) {
+      imu_timestamps->resize(Eigen::NoChange, 0);
+      imu_measurements->resize(Eigen::NoChange, 0);
+    }
     return query_result;
   }
 
-  // Copy the data with timestamp_up_to <= timestamps_buffer from the buffer.
-  Aligned<std::vector, vio::ImuMeasurement> between_values;
-  CHECK(
-      buffer_.getValuesBetweenTimes(
-          timestamp_ns_from, timestamp_ns_to, &between_values));
-
-  if (between_values.empty()) {
-    LOG(WARNING) << "Too few IMU measurements available between time "
-                 << timestamp_ns_from << "[ns] and " << timestamp_ns_to
-                 << "[ns].";
-    imu_timestamps->resize(Eigen::NoChange, 0);
-    imu_measurements->resize(Eigen::NoChange, 0);
-    return QueryResult::kTooFewMeasurementsAvailable;
-  }
-
   // The first and last index will be replaced with the interpolated values.
-  const size_t num_measurements = between_values.size() + 2u;
-  imu_timestamps->resize(Eigen::NoChange, num_measurements);
-  imu_measurements->resize(Eigen::NoChange, num_measurements);
+  const size_t num_between_values = it_at_or_after_to - it_after_from;
+  *num_measurements = num_between_values + 2u;
+  const int num_columns = static_cast<int>(*num_measurements);
+  if (resize_to_fit || imu_timestamps->cols() < num_columns) {
+    imu_timestamps->resize(Eigen::NoChange, num_columns);
+  }
+  if (resize_to_fit || imu_measurements->cols() < num_columns) {
+    imu_measurements->resize(Eigen::NoChange, num_columns);
+  }
 
-  for (size_t idx = 1u; idx < num_measurements - 1u; ++idx) {
-    (*imu_timestamps)(idx) = between_values[idx - 1u].timestamp;
-    (*imu_measurements).col(idx) = between_values[idx - 1u].imu_data;
+  Buffer::const_iterator it = it_after_from;
+  for (size_t idx = 1u; idx <= num_between_values; ++idx, ++it) {
+    (*imu_timestamps)(idx) = it->second.timestamp;
+    imu_measurements->col(idx) = it->second.imu_data;
   }
 
-  // Interpolate border values.
-  int64_t pre_border_timestamp, post_border_timestamp;
-  vio::ImuMeasurement pre_border_value, post_border_value;
+  // Interpolate lower border between the values at or before and at or
+  // after timestamp_ns_from.
   vio::ImuData interpolated_measurement;
-
-  // Interpolate lower border.
-  CHECK(
-      buffer_.getValueAtOrBeforeTime(
-          timestamp_ns_from, &pre_border_timestamp, &pre_border_value));
-  CHECK_EQ(pre_border_timestamp, pre_border_value.timestamp);
-  CHECK(
-      buffer_.getValueAtOrAfterTime(
-          timestamp_ns_from, &post_border_timestamp, &post_border_value));
-  CHECK_EQ(post_border_timestamp, post_border_value.timestamp);
-  linearInterpolate(pre_border_value.timestamp, pre_border_value.imu_data,
-                    post_border_value.timestamp, post_border_value.imu_data,
-                    timestamp_ns_from, &interpolated_measurement);
-  (*imu_timestamps).leftCols<1>()(0) = timestamp_ns_from;
-  (*imu_measurements).leftCols<1>() = interpolated_measurement;
+  const vio::ImuMeasurement& pre_from_value = (it_after_from - 1)->second;
+  const vio::ImuMeasurement& post_from_value =
+      pre_from_value.timestamp == timestamp_ns_from ? pre_from_value
+                                                    : it_after_from->second;
+  linearInterpolate(
+      pre_from_value.timestamp, pre_from_value.imu_data,
+      post_from_value.timestamp, post_from_value.imu_data, timestamp_ns_from,
+      &interpolated_measurement);
+  (*imu_timestamps)(0) = timestamp_ns_from;
+  imu_measurements->col(0) = interpolated_measurement;
 
   // Interpolate upper border.
-  CHECK(
-      buffer_.getValueAtOrBeforeTime(
-          timestamp_ns_to, &pre_border_timestamp, &pre_border_value));
-  CHECK_EQ(pre_border_timestamp, pre_border_value.timestamp);
-  CHECK(
-      buffer_.getValueAtOrAfterTime(
-          timestamp_ns_to, &post_border_timestamp, &post_border_value));
-  CHECK_EQ(post_border_timestamp, post_border_value.timestamp);
-  linearInterpolate(pre_border_value.timestamp, pre_border_value.imu_data,
-                    post_border_value.timestamp, post_border_value.imu_data,
-                    timestamp_ns_to, &interpolated_measurement);
-  (*imu_timestamps).rightCols<1>()(0) = timestamp_ns_to;
-  (*imu_measurements).rightCols<1>() = interpolated_measurement;
+  const vio::ImuMeasurement& post_to_value = it_at_or_after_to->second;
+  const vio::ImuMeasurement& pre_to_value =
+      post_to_value.timestamp == timestamp_ns_to
+          ? post_to_value
+          : (it_at_or_after_to - 1)->second;
+  linearInterpolate(
+      pre_to_value.timestamp, pre_to_value.imu_data, post_to_value.timestamp,
+      post_to_value.imu_data, timestamp_ns_to, &interpolated_measurement);
+  (*imu_timestamps)(num_columns - 1) = timestamp_ns_to;
+  imu_measurements->col(num_columns - 1) = interpolated_measurement;
+  buffer_.unlockContainer();
 
   return query_result;
 }
@@ -131,9 +183,8 @@ ImuMeasurementBuffer::getImuDataInterpolatedBorders(
 ImuMeasurementBuffer::QueryResult
 ImuMeasurementBuffer::getImuDataInterpolatedBordersBlocking(
     int64_t timestamp_ns_from, int64_t timestamp_ns_to,
-    int64_t wait_timeout_nanoseconds,
-    Eigen::Matrix<int64_t, 1, Eigen::Dynamic>* imu_timestamps,
-    Eigen::Matrix<double, 6, Eigen::Dynamic>* imu_measurements) {
+    int64_t wait_timeout_nanoseconds, ImuTimestamps* imu_timestamps,
+    ImuMeasurements* imu_measurements) {
   CHECK_NOTNULL(imu_timestamps);
   CHECK_NOTNULL(imu_measurements);
 
@@ -145,7 +196,7 @@ ImuMeasurementBuffer::getImuDataInterpolatedBordersBlocking(
   {
     std::unique_lock<std::mutex> lock(m_buffer_);
     while ((query_result =
-                isDataAvailableUpToImpl(timestamp_ns_from, timestamp_ns_to)) !=
+                isDataAvailableUpTo(timestamp_ns_from, timestamp_ns_to)) !=
            QueryResult::kDataAvailable) {
       cv_new_measurement_.wait_for(
           lock, std::chrono::nanoseconds(wait_timeout_nanoseconds));
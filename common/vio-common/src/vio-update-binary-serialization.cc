@@ -0,0 +1,690 @@
+#include "vio-common/vio-update-binary-serialization.h"
+
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+#include <aslam/common/memory.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe.h>
+#include <glog/logging.h>
+
+#include "vio-common/vio-types.h"
+
+namespace vio {
+namespace serialization {
+namespace {
+constexpr char kMagic[] = "MVIO";
+constexpr size_t kMagicSize = 4u;
+constexpr uint64_t kVersion = 1u;
+// Guards against allocating huge buffers for corrupt streams.
+constexpr uint64_t kMaxRecordSizeBytes = 1u << 30;
+
+uint64_t encodeZigZag(const int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+int64_t decodeZigZag(const uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1u);
+}
+
+// Appends little-endian and varint encoded values to a string.
+class ByteWriter {
+ public:
+  explicit ByteWriter(std::string* bytes) : bytes_(CHECK_NOTNULL(bytes)) {}
+
+  void writeVarint(uint64_t value) {
+    while (value >= 0x80u) {
+      bytes_->push_back(static_cast<char>((value & 0x7fu) | 0x80u));
+      value >>= 7;
+    }
+    bytes_->push_back(static_cast<char>(value));
+  }
+
+  void writeSignedVarint(const int64_t value) {
+    writeVarint(encodeZigZag(value));
+  }
+
+  void writeFixed64(const uint64_t value) {
+    for (int byte_idx = 0; byte_idx < 8; ++byte_idx) {
+      bytes_->push_back(static_cast<char>((value >> (8 * byte_idx)) & 0xffu));
+    }
+  }
+
+  void writeFixed32(const uint32_t value) {
+    for (int byte_idx = 0; byte_idx < 4; ++byte_idx) {
+      bytes_->push_back(static_cast<char>((value >> (8 * byte_idx)) & 0xffu));
+    }
+  }
+
+  void writeDouble(const double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    writeFixed64(bits);
+  }
+
+  void writeFloat(const float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    writeFixed32(bits);
+  }
+
+  void writeBytes(const void* data, const size_t num_bytes) {
+    bytes_->append(static_cast<const char*>(data), num_bytes);
+  }
+
+  template <typename IdType>
+  void writeId(const IdType& id) {
+    uint64_t id_values[2];
+    id.toUint64(id_values);
+    writeFixed64(id_values[0]);
+    writeFixed64(id_values[1]);
+  }
+
+  template <typename Derived>
+  void writeDoubles(const Eigen::MatrixBase<Derived>& values) {
+    for (int i = 0; i < values.size(); ++i) {
+      writeDouble(values(i));
+    }
+  }
+
+ private:
+  std::string* const bytes_;
+};
+
+// Reads the values written by ByteWriter, all reads fail once the end of the
+// bytes is reached.
+class ByteReader {
+ public:
+  explicit ByteReader(const std::string& bytes) : bytes_(bytes), pos_(0u) {}
+
+  bool readVarint(uint64_t* value) {
+    CHECK_NOTNULL(value);
+    *value = 0u;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (pos_ >= bytes_.size()) {
+        return false;
+      }
+      const uint8_t byte = static_cast<uint8_t>(bytes_[pos_++]);
+      *value |= static_cast<uint64_t>(byte & 0x7fu) << shift;
+      if ((byte & 0x80u) == 0u) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool readSignedVarint(int64_t* value) {
+    CHECK_NOTNULL(value);
+    uint64_t encoded_value;
+    if (!readVarint(&encoded_value)) {
+      return false;
+    }
+    *value = decodeZigZag(encoded_value);
+    return true;
+  }
+
+  bool readFixed64(uint64_t* value) {
+    CHECK_NOTNULL(value);
+    if (bytes_.size() - pos_ < 8u) {
+      return false;
+    }
+    *value = 0u;
+    for (int byte_idx = 0; byte_idx < 8; ++byte_idx) {
+      *value |= static_cast<uint64_t>(static_cast<uint8_t>(bytes_[pos_++]))
+                << (8 * byte_idx);
+    }
+    return true;
+  }
+
+  bool readFixed32(uint32_t* value) {
+    CHECK_NOTNULL(value);
+    if (bytes_.size() - pos_ < 4u) {
+      return false;
+    }
+    *value = 0u;
+    for (int byte_idx = 0; byte_idx < 4; ++byte_idx) {
+      *value |= static_cast<uint32_t>(static_cast<uint8_t>(bytes_[pos_++]))
+                << (8 * byte_idx);
+    }
+    return true;
+  }
+
+  bool readDouble(double* value) {
+    CHECK_NOTNULL(value);
+    uint64_t bits;
+    if (!readFixed64(&bits)) {
+      return false;
+    }
+    std::memcpy(value, &bits, sizeof(bits));
+    return true;
+  }
+
+  bool readFloat(float* value) {
+    CHECK_NOTNULL(value);
+    uint32_t bits;
+    if (!readFixed32(&bits)) {
+      return false;
+    }
+    std::memcpy(value, &bits, sizeof(bits));
+    return true;
+  }
+
+  bool readBytes(const size_t num_bytes, void* data) {
+    CHECK_NOTNULL(data);
+    if (bytes_.size() - pos_ < num_bytes) {
+      return false;
+    }
+    std::memcpy(data, bytes_.data() + pos_, num_bytes);
+    pos_ += num_bytes;
+    return true;
+  }
+
+  template <typename IdType>
+  bool readId(IdType* id) {
+    CHECK_NOTNULL(id);
+    uint64_t id_values[2];
+    if (!readFixed64(&id_values[0]) || !readFixed64(&id_values[1])) {
+      return false;
+    }
+    id->fromUint64(id_values);
+    return true;
+  }
+
+  template <typename Derived>
+  bool readDoubles(Eigen::MatrixBase<Derived>* values) {
+    CHECK_NOTNULL(values);
+    for (int i = 0; i < values->size(); ++i) {
+      if (!readDouble(&values->derived()(i))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Checks that a count of elements with at least the given size fits into
+  // the remaining bytes.
+  bool readCount(const size_t min_element_size_bytes, size_t* count) {
+    CHECK_NOTNULL(count);
+    uint64_t value;
+    if (!readVarint(&value) ||
+        value * min_element_size_bytes > bytes_.size() - pos_) {
+      return false;
+    }
+    *count = static_cast<size_t>(value);
+    return true;
+  }
+
+  bool isAtEnd() const {
+    return pos_ == bytes_.size();
+  }
+
+ private:
+  const std::string& bytes_;
+  size_t pos_;
+};
+
+void writeTransformation(
+    const aslam::Transformation& transformation, ByteWriter* writer) {
+  CHECK_NOTNULL(writer);
+  writer->writeDoubles(
+      transformation.getRotation().toImplementation().coeffs());
+  writer->writeDoubles(transformation.getPosition());
+}
+
+bool readTransformation(
+    ByteReader* reader, aslam::Transformation* transformation) {
+  CHECK_NOTNULL(reader);
+  CHECK_NOTNULL(transformation);
+  Eigen::Vector4d rotation_coeffs;
+  Eigen::Vector3d position;
+  if (!reader->readDoubles(&rotation_coeffs) ||
+      !reader->readDoubles(&position)) {
+    return false;
+  }
+  Eigen::Quaterniond rotation(rotation_coeffs);
+  rotation.normalize();
+  *transformation = aslam::Transformation(rotation, position);
+  return true;
+}
+
+void writeVisualFrame(
+    const aslam::VisualFrame& frame, const int64_t timestamp_ns,
+    const CompactVioUpdateEncodingOptions& options, ByteWriter* writer) {
+  CHECK_NOTNULL(writer);
+  writer->writeId(frame.getId());
+  writer->writeSignedVarint(frame.getTimestampNanoseconds() - timestamp_ns);
+  writer->writeVarint(frame.isValid() ? 1u : 0u);
+
+  const size_t num_keypoints =
+      frame.hasKeypointMeasurements() ? frame.getNumKeypointMeasurements() : 0u;
+  writer->writeVarint(num_keypoints);
+  if (num_keypoints == 0u) {
+    return;
+  }
+  const Eigen::Matrix2Xd& keypoints = frame.getKeypointMeasurements();
+  for (int i = 0; i < keypoints.size(); ++i) {
+    writer->writeSignedVarint(
+        std::llround(keypoints(i) / options.keypoint_quantization_px));
+  }
+  const Eigen::VectorXd& uncertainties =
+      frame.getKeypointMeasurementUncertainties();
+  CHECK_EQ(static_cast<size_t>(uncertainties.size()), num_keypoints);
+  for (int i = 0; i < uncertainties.size(); ++i) {
+    writer->writeFloat(static_cast<float>(uncertainties(i)));
+  }
+
+  const bool has_scales = frame.hasKeypointScales();
+  writer->writeVarint(has_scales ? 1u : 0u);
+  if (has_scales) {
+    const Eigen::VectorXd& scales = frame.getKeypointScales();
+    CHECK_EQ(static_cast<size_t>(scales.size()), num_keypoints);
+    for (int i = 0; i < scales.size(); ++i) {
+      writer->writeFloat(static_cast<float>(scales(i)));
+    }
+  }
+
+  const bool has_track_ids = frame.hasTrackIds();
+  writer->writeVarint(has_track_ids ? 1u : 0u);
+  if (has_track_ids) {
+    const Eigen::VectorXi& track_ids = frame.getTrackIds();
+    CHECK_EQ(static_cast<size_t>(track_ids.size()), num_keypoints);
+    int64_t previous_track_id = 0;
+    for (int i = 0; i < track_ids.size(); ++i) {
+      writer->writeSignedVarint(track_ids(i) - previous_track_id);
+      previous_track_id = track_ids(i);
+    }
+  }
+
+  if (options.include_descriptors) {
+    const aslam::VisualFrame::DescriptorsT& descriptors =
+        frame.getDescriptors();
+    CHECK_EQ(static_cast<size_t>(descriptors.cols()), num_keypoints);
+    writer->writeVarint(descriptors.rows());
+    writer->writeBytes(descriptors.data(), descriptors.size());
+  }
+}
+
+bool readVisualFrame(
+    const int64_t timestamp_ns, const CompactVioUpdateEncodingOptions& options,
+    const aslam::Camera::Ptr& camera, ByteReader* reader,
+    aslam::VisualFrame::Ptr* frame) {
+  CHECK_NOTNULL(reader);
+  CHECK_NOTNULL(frame);
+  aslam::FrameId frame_id;
+  int64_t timestamp_delta_ns;
+  uint64_t is_valid;
+  size_t num_keypoints;
+  if (!reader->readId(&frame_id) ||
+      !reader->readSignedVarint(&timestamp_delta_ns) ||
+      !reader->readVarint(&is_valid) ||
+      !reader->readCount(2u, &num_keypoints)) {
+    return false;
+  }
+
+  *frame = aligned_shared<aslam::VisualFrame>();
+  aslam::VisualFrame& frame_ref = **frame;
+  if (camera != nullptr) {
+    frame_ref.setCameraGeometry(camera);
+  }
+  frame_ref.setId(frame_id);
+  frame_ref.setTimestampNanoseconds(timestamp_ns + timestamp_delta_ns);
+  if (is_valid == 0u) {
+    frame_ref.invalidate();
+  }
+  if (num_keypoints == 0u) {
+    return true;
+  }
+
+  Eigen::Matrix2Xd keypoints(2, num_keypoints);
+  for (int i = 0; i < keypoints.size(); ++i) {
+    int64_t quantized_value;
+    if (!reader->readSignedVarint(&quantized_value)) {
+      return false;
+    }
+    keypoints(i) = quantized_value * options.keypoint_quantization_px;
+  }
+  Eigen::VectorXd uncertainties(num_keypoints);
+  for (int i = 0; i < uncertainties.size(); ++i) {
+    float uncertainty;
+    if (!reader->readFloat(&uncertainty)) {
+      return false;
+    }
+    uncertainties(i) = uncertainty;
+  }
+  frame_ref.setKeypointMeasurements(keypoints);
+  frame_ref.setKeypointMeasurementUncertainties(uncertainties);
+
+  uint64_t has_scales;
+  if (!reader->readVarint(&has_scales)) {
+    return false;
+  }
+  if (has_scales != 0u) {
+    Eigen::VectorXd scales(num_keypoints);
+    for (int i = 0; i < scales.size(); ++i) {
+      float scale;
+      if (!reader->readFloat(&scale)) {
+        return false;
+      }
+      scales(i) = scale;
+    }
+    frame_ref.setKeypointScales(scales);
+  }
+
+  uint64_t has_track_ids;
+  if (!reader->readVarint(&has_track_ids)) {
+    return false;
+  }
+  if (has_track_ids != 0u) {
+    Eigen::VectorXi track_ids(num_keypoints);
+    int64_t track_id = 0;
+    for (int i = 0; i < track_ids.size(); ++i) {
+      int64_t track_id_delta;
+      if (!reader->readSignedVarint(&track_id_delta)) {
+        return false;
+      }
+      track_id += track_id_delta;
+      track_ids(i) = static_cast<int>(track_id);
+    }
+    frame_ref.setTrackIds(track_ids);
+  }
+
+  if (options.include_descriptors) {
+    uint64_t descriptor_size_bytes;
+    if (!reader->readVarint(&descriptor_size_bytes)) {
+      return false;
+    }
+    aslam::VisualFrame::DescriptorsT descriptors(
+        descriptor_size_bytes, num_keypoints);
+    if (!reader->readBytes(descriptors.size(), descriptors.data())) {
+      return false;
+    }
+    frame_ref.setDescriptors(descriptors);
+  }
+  return true;
+}
+
+void writeVioUpdate(
+    const vio::VioUpdate& update, const int64_t last_timestamp_ns,
+    const CompactVioUpdateEncodingOptions& options, ByteWriter* writer) {
+  CHECK_NOTNULL(writer);
+  CHECK(update.check());
+  const vio::SynchronizedNFrameImu& keyframe_and_imudata =
+      *update.keyframe_and_imudata;
+  CHECK(keyframe_and_imudata.nframe != nullptr);
+
+  writer->writeSignedVarint(update.timestamp_ns - last_timestamp_ns);
+  writer->writeVarint(static_cast<uint64_t>(update.vio_state));
+  writer->writeVarint(static_cast<uint64_t>(update.vio_update_type));
+  writer->writeVarint(static_cast<uint64_t>(update.localization_state));
+  writer->writeVarint(
+      static_cast<uint64_t>(keyframe_and_imudata.motion_wrt_last_nframe));
+
+  writeTransformation(update.vinode.get_T_M_I(), writer);
+  writer->writeDoubles(update.vinode.get_v_M_I());
+  writer->writeDoubles(update.vinode.getAccBias());
+  writer->writeDoubles(update.vinode.getGyroBias());
+  writeTransformation(update.T_G_M, writer);
+
+  // The IMU timestamps are stored as deltas to the previous one, starting at
+  // the update timestamp.
+  const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps =
+      keyframe_and_imudata.imu_timestamps;
+  const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_measurements =
+      keyframe_and_imudata.imu_measurements;
+  CHECK_EQ(imu_timestamps.cols(), imu_measurements.cols());
+  writer->writeVarint(imu_timestamps.cols());
+  int64_t previous_imu_timestamp_ns = update.timestamp_ns;
+  for (int i = 0; i < imu_timestamps.cols(); ++i) {
+    writer->writeSignedVarint(imu_timestamps(i) - previous_imu_timestamp_ns);
+    previous_imu_timestamp_ns = imu_timestamps(i);
+    for (int row = 0; row < imu_measurements.rows(); ++row) {
+      writer->writeFloat(static_cast<float>(imu_measurements(row, i)));
+    }
+  }
+
+  const aslam::VisualNFrame& nframe = *keyframe_and_imudata.nframe;
+  writer->writeId(nframe.getId());
+  writer->writeVarint(nframe.getNumFrames());
+  for (size_t frame_idx = 0u; frame_idx < nframe.getNumFrames(); ++frame_idx) {
+    const bool is_frame_set = nframe.isFrameSet(frame_idx);
+    writer->writeVarint(is_frame_set ? 1u : 0u);
+    if (is_frame_set) {
+      writeVisualFrame(
+          nframe.getFrame(frame_idx), update.timestamp_ns, options, writer);
+    }
+  }
+}
+
+bool readVioUpdate(
+    const int64_t last_timestamp_ns,
+    const CompactVioUpdateEncodingOptions& options,
+    const aslam::NCamera::Ptr& n_camera, ByteReader* reader,
+    vio::VioUpdate* update) {
+  CHECK_NOTNULL(reader);
+  CHECK_NOTNULL(update);
+  int64_t timestamp_delta_ns;
+  uint64_t vio_state, vio_update_type, localization_state,
+      motion_wrt_last_nframe;
+  if (!reader->readSignedVarint(&timestamp_delta_ns) ||
+      !reader->readVarint(&vio_state) ||
+      !reader->readVarint(&vio_update_type) ||
+      !reader->readVarint(&localization_state) ||
+      !reader->readVarint(&motion_wrt_last_nframe)) {
+    return false;
+  }
+  update->timestamp_ns = last_timestamp_ns + timestamp_delta_ns;
+  update->vio_state = static_cast<vio::EstimatorState>(vio_state);
+  update->vio_update_type = static_cast<vio::UpdateType>(vio_update_type);
+  update->localization_state =
+      static_cast<vio::LocalizationState>(localization_state);
+
+  aslam::Transformation T_M_I;
+  Eigen::Vector3d v_M_I, acc_bias, gyro_bias;
+  if (!readTransformation(reader, &T_M_I) || !reader->readDoubles(&v_M_I) ||
+      !reader->readDoubles(&acc_bias) || !reader->readDoubles(&gyro_bias) ||
+      !readTransformation(reader, &update->T_G_M)) {
+    return false;
+  }
+  update->vinode.set_T_M_I(T_M_I);
+  update->vinode.set_v_M_I(v_M_I);
+  update->vinode.setAccBias(acc_bias);
+  update->vinode.setGyroBias(gyro_bias);
+
+  vio::SynchronizedNFrameImu::Ptr keyframe_and_imudata =
+      std::make_shared<vio::SynchronizedNFrameImu>();
+  keyframe_and_imudata->motion_wrt_last_nframe =
+      static_cast<vio::MotionType>(motion_wrt_last_nframe);
+  size_t num_imu_measurements;
+  constexpr size_t kMinImuMeasurementSizeBytes = 1u + 6u * sizeof(float);
+  if (!reader->readCount(kMinImuMeasurementSizeBytes, &num_imu_measurements)) {
+    return false;
+  }
+  keyframe_and_imudata->imu_timestamps.resize(1, num_imu_measurements);
+  keyframe_and_imudata->imu_measurements.resize(6, num_imu_measurements);
+  int64_t imu_timestamp_ns = update->timestamp_ns;
+  for (size_t i = 0u; i < num_imu_measurements; ++i) {
+    int64_t imu_timestamp_delta_ns;
+    if (!reader->readSignedVarint(&imu_timestamp_delta_ns)) {
+      return false;
+    }
+    imu_timestamp_ns += imu_timestamp_delta_ns;
+    keyframe_and_imudata->imu_timestamps(i) = imu_timestamp_ns;
+    for (int row = 0; row < 6; ++row) {
+      float value;
+      if (!reader->readFloat(&value)) {
+        return false;
+      }
+      keyframe_and_imudata->imu_measurements(row, i) = value;
+    }
+  }
+
+  aslam::NFramesId nframe_id;
+  size_t num_frames;
+  if (!reader->readId(&nframe_id) || !reader->readCount(1u, &num_frames) ||
+      num_frames == 0u) {
+    return false;
+  }
+  if (n_camera != nullptr && n_camera->numCameras() != num_frames) {
+    LOG(ERROR) << "The camera rig has " << n_camera->numCameras()
+               << " cameras, but the nframe " << num_frames << " frames.";
+    return false;
+  }
+  aslam::VisualNFrame::Ptr nframe(
+      new aslam::VisualNFrame(nframe_id, num_frames));
+  if (n_camera != nullptr) {
+    nframe->setNCameras(n_camera);
+  }
+  for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+    uint64_t is_frame_set;
+    if (!reader->readVarint(&is_frame_set)) {
+      return false;
+    }
+    if (is_frame_set == 0u) {
+      nframe->unSetFrame(frame_idx);
+      continue;
+    }
+    aslam::VisualFrame::Ptr frame;
+    const aslam::Camera::Ptr camera =
+        n_camera != nullptr ? n_camera->getCameraShared(frame_idx) : nullptr;
+    if (!readVisualFrame(
+            update->timestamp_ns, options, camera, reader, &frame)) {
+      return false;
+    }
+    nframe->setFrame(frame_idx, frame);
+  }
+  keyframe_and_imudata->nframe = nframe;
+  update->keyframe_and_imudata = keyframe_and_imudata;
+  return reader->isAtEnd();
+}
+}  // namespace
+
+CompactVioUpdateWriter::CompactVioUpdateWriter(
+    const CompactVioUpdateEncodingOptions& options, std::ostream* out)
+    : options_(options),
+      out_(CHECK_NOTNULL(out)),
+      header_written_(false),
+      last_timestamp_ns_(0),
+      num_bytes_written_(0u) {
+  CHECK_GT(options_.keypoint_quantization_px, 0.0);
+}
+
+bool CompactVioUpdateWriter::writeHeader() {
+  record_.clear();
+  ByteWriter writer(&record_);
+  writer.writeBytes(kMagic, kMagicSize);
+  writer.writeVarint(kVersion);
+  writer.writeDouble(options_.keypoint_quantization_px);
+  writer.writeVarint(options_.include_descriptors ? 1u : 0u);
+  out_->write(record_.data(), record_.size());
+  num_bytes_written_ += record_.size();
+  return out_->good();
+}
+
+bool CompactVioUpdateWriter::write(const vio::VioUpdate& update) {
+  if (!header_written_) {
+    if (!writeHeader()) {
+      return false;
+    }
+    header_written_ = true;
+  }
+
+  record_.clear();
+  ByteWriter record_writer(&record_);
+  writeVioUpdate(update, last_timestamp_ns_, options_, &record_writer);
+  last_timestamp_ns_ = update.timestamp_ns;
+
+  std::string length_prefix;
+  ByteWriter(&length_prefix).writeVarint(record_.size());
+  out_->write(length_prefix.data(), length_prefix.size());
+  out_->write(record_.data(), record_.size());
+  num_bytes_written_ += length_prefix.size() + record_.size();
+  return out_->good();
+}
+
+CompactVioUpdateReader::CompactVioUpdateReader(
+    const aslam::NCamera::Ptr& n_camera, std::istream* in)
+    : n_camera_(n_camera),
+      in_(CHECK_NOTNULL(in)),
+      header_read_(false),
+      corrupt_(false),
+      last_timestamp_ns_(0) {}
+
+bool CompactVioUpdateReader::readHeader() {
+  char magic[kMagicSize];
+  if (!in_->read(magic, kMagicSize) ||
+      std::memcmp(magic, kMagic, kMagicSize) != 0) {
+    LOG(ERROR) << "The stream is not a compact VIO update stream.";
+    return false;
+  }
+  // The version and options have a bounded size, the double is followed by
+  // two varints of one byte.
+  record_.resize(1u + sizeof(double) + 1u);
+  if (!in_->read(&record_.front(), record_.size())) {
+    return false;
+  }
+  ByteReader reader(record_);
+  uint64_t version, include_descriptors;
+  if (!reader.readVarint(&version) || version != kVersion) {
+    LOG(ERROR) << "Unsupported version of the compact VIO update stream.";
+    return false;
+  }
+  if (!reader.readDouble(&options_.keypoint_quantization_px) ||
+      !reader.readVarint(&include_descriptors) ||
+      !(options_.keypoint_quantization_px > 0.0)) {
+    return false;
+  }
+  options_.include_descriptors = include_descriptors != 0u;
+  return true;
+}
+
+bool CompactVioUpdateReader::read(vio::VioUpdate* update) {
+  CHECK_NOTNULL(update);
+  if (corrupt_) {
+    return false;
+  }
+  if (!header_read_) {
+    if (!readHeader()) {
+      corrupt_ = true;
+      return false;
+    }
+    header_read_ = true;
+  }
+
+  // A clean end of the stream is only allowed between records.
+  uint64_t record_size = 0u;
+  for (int shift = 0; shift < 64; shift += 7) {
+    const int byte = in_->get();
+    if (byte == std::char_traits<char>::eof()) {
+      corrupt_ = shift > 0;
+      return false;
+    }
+    record_size |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      break;
+    }
+  }
+  if (record_size == 0u || record_size > kMaxRecordSizeBytes) {
+    corrupt_ = true;
+    return false;
+  }
+  record_.resize(record_size);
+  if (!in_->read(&record_.front(), record_size)) {
+    corrupt_ = true;
+    return false;
+  }
+
+  ByteReader reader(record_);
+  if (!readVioUpdate(
+          last_timestamp_ns_, options_, n_camera_, &reader, update)) {
+    LOG(ERROR) << "Corrupt record in the compact VIO update stream.";
+    corrupt_ = true;
+    return false;
+  }
+  last_timestamp_ns_ = update->timestamp_ns;
+  return true;
+}
+
+}  // namespace serialization
+}  // namespace vio
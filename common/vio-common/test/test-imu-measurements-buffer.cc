@@ -128,6 +128,78 @@ TEST(ImuMeasurementBuffer, getImuDataInterpolatedBorders) {
   EXPECT_EQ(imu_measurements.col(2)(0), 29.0);
 }
 
+TEST(ImuMeasurementBuffer, getImuDataInterpolatedBordersIntoReusedOutput) {
+  vio_common::ImuMeasurementBuffer buffer(-1);
+  for (int64_t timestamp = 10; timestamp <= 50; timestamp += 5) {
+    buffer.addMeasurement(
+        timestamp, vio::ImuData::Constant(static_cast<double>(timestamp)));
+  }
+
+  vio_common::ImuMeasurementBuffer::ImuTimestamps imu_timestamps(1, 20);
+  vio_common::ImuMeasurementBuffer::ImuMeasurements imu_measurements(6, 20);
+  const int64_t* timestamps_data = imu_timestamps.data();
+  size_t num_measurements;
+  vio_common::ImuMeasurementBuffer::QueryResult result =
+      buffer.getImuDataInterpolatedBorders(
+          12, 38, &imu_timestamps, &imu_measurements, &num_measurements);
+  ASSERT_EQ(
+      result, vio_common::ImuMeasurementBuffer::QueryResult::kDataAvailable);
+  ASSERT_EQ(num_measurements, 7u);
+  // The output fits into the provided matrices, so they are not reallocated.
+  EXPECT_EQ(imu_timestamps.cols(), 20);
+  EXPECT_EQ(imu_timestamps.data(), timestamps_data);
+  const int64_t kExpectedTimestamps[] = {12, 15, 20, 25, 30, 35, 38};
+  for (size_t idx = 0u; idx < num_measurements; ++idx) {
+    EXPECT_EQ(imu_timestamps(idx), kExpectedTimestamps[idx]);
+    EXPECT_DOUBLE_EQ(
+        imu_measurements(0, idx),
+        static_cast<double>(kExpectedTimestamps[idx]));
+  }
+
+  // Too small outputs are grown.
+  imu_timestamps.resize(Eigen::NoChange, 2);
+  imu_measurements.resize(Eigen::NoChange, 2);
+  result = buffer.getImuDataInterpolatedBorders(
+      10, 50, &imu_timestamps, &imu_measurements, &num_measurements);
+  ASSERT_EQ(
+      result, vio_common::ImuMeasurementBuffer::QueryResult::kDataAvailable);
+  ASSERT_EQ(num_measurements, 9u);
+  EXPECT_GE(imu_timestamps.cols(), 9);
+  EXPECT_GE(imu_measurements.cols(), 9);
+  EXPECT_EQ(imu_timestamps(8), 50);
+
+  result = buffer.getImuDataInterpolatedBorders(
+      40, 60, &imu_timestamps, &imu_measurements, &num_measurements);
+  EXPECT_EQ(
+      result,
+      vio_common::ImuMeasurementBuffer::QueryResult::kDataNotYetAvailable);
+  EXPECT_EQ(num_measurements, 0u);
+}
+
+TEST(ImuMeasurementBuffer, BoundedBufferDropsOldestMeasurements) {
+  constexpr size_t kMaxNumMeasurements = 4u;
+  vio_common::ImuMeasurementBuffer buffer(-1, kMaxNumMeasurements);
+  for (int64_t timestamp = 10; timestamp <= 50; timestamp += 5) {
+    buffer.addMeasurement(
+        timestamp, vio::ImuData::Constant(static_cast<double>(timestamp)));
+  }
+  EXPECT_EQ(buffer.size(), kMaxNumMeasurements);
+
+  Eigen::Matrix<int64_t, 1, Eigen::Dynamic> imu_timestamps;
+  Eigen::Matrix<double, 6, Eigen::Dynamic> imu_measurements;
+  EXPECT_EQ(
+      buffer.getImuDataInterpolatedBorders(
+          30, 40, &imu_timestamps, &imu_measurements),
+      vio_common::ImuMeasurementBuffer::QueryResult::kDataNeverAvailable);
+  ASSERT_EQ(
+      buffer.getImuDataInterpolatedBorders(
+          36, 49, &imu_timestamps, &imu_measurements),
+      vio_common::ImuMeasurementBuffer::QueryResult::kDataAvailable);
+  ASSERT_EQ(imu_timestamps.cols(), 4);
+  EXPECT_EQ(imu_timestamps(1), 40);
+  EXPECT_EQ(imu_timestamps(2), 45);
+}
+
 TEST(ImuMeasurementBuffer, DeathOnAddDataNotIncreasingTimestamp) {
   vio_common::ImuMeasurementBuffer buffer(-1);
 
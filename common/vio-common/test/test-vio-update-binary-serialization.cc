@@ -0,0 +1,182 @@
+#include <sstream>
+#include <string>
+
+#include <aslam/cameras/ncamera.h>
+#include <eigen-checks/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+
+#include "vio-common/test/vio-update-simulation.h"
+#include "vio-common/vio-update-binary-serialization.h"
+#include "vio-common/vio-update-serialization.h"
+#include "vio-common/vio-update.h"
+
+#include "vio-common/vio_update.pb.h"
+
+namespace {
+
+void compareVioUpdates(
+    const vio::VioUpdate& vio_update_a, const vio::VioUpdate& vio_update_b,
+    const vio::serialization::CompactVioUpdateEncodingOptions& options) {
+  constexpr double kPrecision = 1e-10;
+  // The IMU measurements and uncertainties are stored as floats.
+  constexpr double kFloatPrecision = 1e-4;
+  EXPECT_EQ(vio_update_a.timestamp_ns, vio_update_b.timestamp_ns);
+  EXPECT_EQ(vio_update_a.vio_state, vio_update_b.vio_state);
+  EXPECT_EQ(vio_update_a.vio_update_type, vio_update_b.vio_update_type);
+  EXPECT_EQ(vio_update_a.localization_state, vio_update_b.localization_state);
+  EXPECT_NEAR_ASLAM_TRANSFORMATION(
+      vio_update_a.T_G_M, vio_update_b.T_G_M, kPrecision);
+  EXPECT_NEAR_ASLAM_TRANSFORMATION(
+      vio_update_a.vinode.get_T_M_I(), vio_update_b.vinode.get_T_M_I(),
+      kPrecision);
+  EXPECT_NEAR_EIGEN(
+      vio_update_a.vinode.get_v_M_I(), vio_update_b.vinode.get_v_M_I(),
+      kPrecision);
+  EXPECT_NEAR_EIGEN(
+      vio_update_a.vinode.getImuBias(), vio_update_b.vinode.getImuBias(),
+      kPrecision);
+
+  ASSERT_NE(vio_update_a.keyframe_and_imudata, nullptr);
+  ASSERT_NE(vio_update_b.keyframe_and_imudata, nullptr);
+  const vio::SynchronizedNFrameImu& data_a = *vio_update_a.keyframe_and_imudata;
+  const vio::SynchronizedNFrameImu& data_b = *vio_update_b.keyframe_and_imudata;
+  EXPECT_EQ(data_a.motion_wrt_last_nframe, data_b.motion_wrt_last_nframe);
+  ASSERT_EQ(data_a.imu_timestamps.cols(), data_b.imu_timestamps.cols());
+  if (data_a.imu_timestamps.cols() > 0) {
+    EXPECT_TRUE(data_a.imu_timestamps == data_b.imu_timestamps);
+    EXPECT_NEAR_EIGEN(
+        data_a.imu_measurements, data_b.imu_measurements, kFloatPrecision);
+  }
+
+  const aslam::VisualNFrame& n_frame_a = *data_a.nframe;
+  const aslam::VisualNFrame& n_frame_b = *data_b.nframe;
+  EXPECT_EQ(n_frame_a.getId(), n_frame_b.getId());
+  ASSERT_EQ(n_frame_a.getNumFrames(), n_frame_b.getNumFrames());
+  for (size_t frame_idx = 0u; frame_idx < n_frame_a.getNumFrames();
+       ++frame_idx) {
+    ASSERT_EQ(n_frame_a.isFrameSet(frame_idx), n_frame_b.isFrameSet(frame_idx));
+    if (!n_frame_a.isFrameSet(frame_idx)) {
+      continue;
+    }
+    const aslam::VisualFrame& frame_a = n_frame_a.getFrame(frame_idx);
+    const aslam::VisualFrame& frame_b = n_frame_b.getFrame(frame_idx);
+    EXPECT_EQ(frame_a.getId(), frame_b.getId());
+    EXPECT_EQ(
+        frame_a.getTimestampNanoseconds(), frame_b.getTimestampNanoseconds());
+    EXPECT_EQ(*frame_a.getCameraGeometry(), *frame_b.getCameraGeometry());
+
+    ASSERT_TRUE(frame_b.hasKeypointMeasurements());
+    EXPECT_NEAR_EIGEN(
+        frame_a.getKeypointMeasurements(), frame_b.getKeypointMeasurements(),
+        0.5 * options.keypoint_quantization_px);
+    EXPECT_NEAR_EIGEN(
+        frame_a.getKeypointMeasurementUncertainties(),
+        frame_b.getKeypointMeasurementUncertainties(), kFloatPrecision);
+    ASSERT_EQ(frame_a.hasTrackIds(), frame_b.hasTrackIds());
+    if (frame_a.hasTrackIds()) {
+      EXPECT_TRUE(frame_a.getTrackIds() == frame_b.getTrackIds());
+    }
+    if (options.include_descriptors) {
+      ASSERT_TRUE(frame_b.hasDescriptors());
+      EXPECT_TRUE(frame_a.getDescriptors() == frame_b.getDescriptors());
+    } else {
+      EXPECT_FALSE(frame_b.hasDescriptors());
+    }
+  }
+}
+
+class CompactVioUpdateSerializationTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    simulation_.generateVioUpdates();
+    ASSERT_GT(simulation_.getNumberOfVioUpdates(), 1u);
+  }
+
+  // Writes all simulated updates, reads them back and compares them.
+  void writeAndReadAllUpdates(
+      const vio::serialization::CompactVioUpdateEncodingOptions& options,
+      std::string* bytes) {
+    CHECK_NOTNULL(bytes);
+    std::stringstream stream;
+    vio::serialization::CompactVioUpdateWriter writer(options, &stream);
+    for (const vio::VioUpdate::Ptr& vio_update :
+         simulation_.getAllVioUpdates()) {
+      ASSERT_TRUE(writer.write(*vio_update));
+    }
+    *bytes = stream.str();
+    EXPECT_EQ(writer.getNumBytesWritten(), bytes->size());
+
+    vio::serialization::CompactVioUpdateReader reader(
+        simulation_.getNCamera(), &stream);
+    for (const vio::VioUpdate::Ptr& vio_update :
+         simulation_.getAllVioUpdates()) {
+      vio::VioUpdate vio_update_read;
+      ASSERT_TRUE(reader.read(&vio_update_read));
+      compareVioUpdates(*vio_update, vio_update_read, options);
+    }
+    vio::VioUpdate vio_update_read;
+    EXPECT_FALSE(reader.read(&vio_update_read));
+    EXPECT_FALSE(reader.isCorrupt());
+    EXPECT_EQ(
+        reader.getOptions().include_descriptors, options.include_descriptors);
+  }
+
+  vio::VioUpdateSimulation simulation_;
+};
+
+TEST_F(CompactVioUpdateSerializationTest, WriteAndRead) {
+  vio::serialization::CompactVioUpdateEncodingOptions options;
+  std::string bytes;
+  writeAndReadAllUpdates(options, &bytes);
+
+  // The compact stream has to be smaller than the protobuf serialization.
+  size_t num_proto_bytes = 0u;
+  for (const vio::VioUpdate::Ptr& vio_update : simulation_.getAllVioUpdates()) {
+    vio::proto::VioUpdate vio_update_proto;
+    vio::serialization::serializeVioUpdate(*vio_update, &vio_update_proto);
+    num_proto_bytes += vio_update_proto.ByteSize();
+  }
+  EXPECT_LT(bytes.size(), num_proto_bytes);
+}
+
+TEST_F(CompactVioUpdateSerializationTest, WriteAndReadWithoutDescriptors) {
+  vio::serialization::CompactVioUpdateEncodingOptions options;
+  std::string bytes_with_descriptors;
+  writeAndReadAllUpdates(options, &bytes_with_descriptors);
+
+  options.include_descriptors = false;
+  std::string bytes_without_descriptors;
+  writeAndReadAllUpdates(options, &bytes_without_descriptors);
+  EXPECT_LT(bytes_without_descriptors.size(), bytes_with_descriptors.size());
+}
+
+TEST_F(CompactVioUpdateSerializationTest, TruncatedStreamIsCorrupt) {
+  vio::serialization::CompactVioUpdateEncodingOptions options;
+  std::stringstream stream;
+  vio::serialization::CompactVioUpdateWriter writer(options, &stream);
+  ASSERT_TRUE(writer.write(*simulation_.getVioUpdate(0u)));
+  ASSERT_TRUE(writer.write(*simulation_.getVioUpdate(1u)));
+  const std::string bytes = stream.str();
+
+  std::stringstream truncated_stream(bytes.substr(0u, bytes.size() - 1u));
+  vio::serialization::CompactVioUpdateReader reader(
+      simulation_.getNCamera(), &truncated_stream);
+  vio::VioUpdate vio_update_read;
+  EXPECT_TRUE(reader.read(&vio_update_read));
+  EXPECT_FALSE(reader.read(&vio_update_read));
+  EXPECT_TRUE(reader.isCorrupt());
+}
+
+TEST_F(CompactVioUpdateSerializationTest, InvalidHeaderIsCorrupt) {
+  std::stringstream stream("not a vio update stream");
+  vio::serialization::CompactVioUpdateReader reader(
+      simulation_.getNCamera(), &stream);
+  vio::VioUpdate vio_update_read;
+  EXPECT_FALSE(reader.read(&vio_update_read));
+  EXPECT_TRUE(reader.isCorrupt());
+}
+
+}  // namespace
+
+MAPLAB_UNITTEST_ENTRYPOINT
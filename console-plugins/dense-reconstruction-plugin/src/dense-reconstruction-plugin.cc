@@ -2,6 +2,7 @@
 
 #include <cstring>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <console-common/console.h>
@@ -11,11 +12,13 @@
 #include <dense-reconstruction/stereo-dense-reconstruction.h>
 #include <gflags/gflags.h>
 #include <map-manager/map-manager.h>
+#include <map-resources/resource-conversion.h>
 #include <maplab-common/file-system-tools.h>
 #include <vi-map/unique-id.h>
 #include <vi-map/vi-map.h>
 #include <visualization/viwls-graph-plotter.h>
 #include <voxblox-interface/integration.h>
+#include <voxblox-interface/mesh-tiles.h>
 #include <voxblox/core/tsdf_map.h>
 #include <voxblox/integrator/tsdf_integrator.h>
 #include <voxblox/io/mesh_ply.h>
@@ -35,6 +38,12 @@ DEFINE_string(
     "Path to the PLY mesh file that is generated from the "
     "reconstruction command.");
 
+DEFINE_string(
+    dense_result_mesh_tiles_output_folder, "",
+    "Folder to which the mesh is exported as one PLY tile per TSDF block. If "
+    "the folder holds the tiles of an earlier export, only the tiles of the "
+    "blocks that changed since then are meshed and written again.");
+
 DEFINE_double(
     dense_tsdf_voxel_size_m, 0.02, "Voxel size of the TSDF grid [m].");
 
@@ -64,10 +73,22 @@ DEFINE_double(
     dense_tsdf_max_ray_length_m, 20.,
     "Maximum ray length integrated into the TSDF grid.");
 
+DEFINE_uint64(
+    dense_tsdf_block_sharded_batch_size, 0u,
+    "If larger than 0, create_tsdf_from_depth_resource integrates the depth "
+    "resources of this many frames at a time with the block-sharded TSDF "
+    "integrator, whose result does not depend on the number of threads. "
+    "Otherwise the merged TSDF integrator of Voxblox is used.");
+
 DEFINE_string(
     dense_image_export_path, "",
     "Export folder for image export function. console command: "
     "export_timestamped_images");
+DEFINE_bool(
+    dense_image_export_copy_resource_files, true,
+    "If enabled, export_timestamped_images copies the image resource files "
+    "instead of decoding and encoding the images again. Resources that are "
+    "not stored in a file of their own are always encoded again.");
 
 DEFINE_int32(
     dense_depth_resource_output_type, 17,
@@ -77,6 +98,12 @@ DEFINE_int32(
     "Supported types: "
     "PointCloudXYZRGBN = 17, RawDepthMap = 8");
 
+DEFINE_bool(
+    dense_stereo_fusion_store_depth_resources, false,
+    "If enabled, the stereo_dense_fusion command also stores the computed "
+    "depth as resources, otherwise the depth is only integrated into the TSDF "
+    "map.");
+
 DEFINE_int32(
     dense_depth_resource_input_type, 17,
     "Input resource type of the dense reconstruction algorithms."
@@ -152,6 +179,160 @@ common::CommandStatus exportTsdfMeshToFile(
   return common::kSuccess;
 }
 
+voxblox::TsdfIntegratorBase::Config getTsdfIntegratorConfigFromGflags() {
+  voxblox::TsdfIntegratorBase::Config tsdf_integrator_config;
+  tsdf_integrator_config.voxel_carving_enabled =
+      FLAGS_dense_tsdf_voxel_carving_enabled;
+  tsdf_integrator_config.allow_clear = FLAGS_dense_tsdf_voxel_use_clearing_rays;
+  tsdf_integrator_config.default_truncation_distance =
+      static_cast<float>(FLAGS_dense_tsdf_truncation_distance_m);
+  tsdf_integrator_config.min_ray_length_m =
+      static_cast<voxblox::FloatingPoint>(FLAGS_dense_tsdf_min_ray_length_m);
+  tsdf_integrator_config.max_ray_length_m =
+      static_cast<voxblox::FloatingPoint>(FLAGS_dense_tsdf_max_ray_length_m);
+  return tsdf_integrator_config;
+}
+
+voxblox::TsdfMap::Config getTsdfMapConfigFromGflags() {
+  voxblox::TsdfMap::Config tsdf_map_config;
+  tsdf_map_config.tsdf_voxel_size =
+      static_cast<voxblox::FloatingPoint>(FLAGS_dense_tsdf_voxel_size_m);
+  tsdf_map_config.tsdf_voxels_per_side = FLAGS_dense_tsdf_voxels_per_side;
+  return tsdf_map_config;
+}
+
+// Stores the TSDF map as resource of the missions and exports its mesh if
+// --dense_result_mesh_output_file or --dense_result_mesh_tiles_output_folder
+// is set.
+common::CommandStatus storeTsdfMapAndExportMesh(
+    const vi_map::MissionIdList& mission_ids, voxblox::TsdfMap* tsdf_map,
+    vi_map::VIMap* vi_map) {
+  CHECK_NOTNULL(tsdf_map);
+  CHECK_NOTNULL(vi_map);
+
+  const bool has_resource = vi_map->hasVoxbloxTsdfMap(mission_ids);
+  if (has_resource && FLAGS_overwrite) {
+    vi_map->replaceVoxbloxTsdfMap(mission_ids, *tsdf_map);
+  } else if (has_resource && !FLAGS_overwrite) {
+    LOG(ERROR) << "Could not store the Voxblox TSDF map, because there is "
+               << "already a map stored. Use --overwrite!";
+    return common::kStupidUserError;
+  } else {
+    vi_map->storeVoxbloxTsdfMap(*tsdf_map, mission_ids);
+  }
+
+  constexpr double kBytesToMegaBytes = 1e-6;
+  LOG(INFO) << "TSDF map:";
+  LOG(INFO) << "  allocated blocks: "
+            << tsdf_map->getTsdfLayer().getNumberOfAllocatedBlocks();
+  LOG(INFO) << "  size: "
+            << tsdf_map->getTsdfLayer().getMemorySize() * kBytesToMegaBytes
+            << "MB";
+
+  if (!FLAGS_dense_result_mesh_tiles_output_folder.empty()) {
+    const common::CommandStatus status = exportTsdfMeshTilesToFolder(
+        FLAGS_dense_result_mesh_tiles_output_folder, tsdf_map);
+    if (status != common::kSuccess) {
+      return status;
+    }
+  }
+  if (!FLAGS_dense_result_mesh_output_file.empty()) {
+    return exportTsdfMeshToFile(FLAGS_dense_result_mesh_output_file, tsdf_map);
+  }
+  return common::kSuccess;
+}
+
+// Integrates the depth of the stereo dense reconstruction into the TSDF map
+// while it is computed. For depth maps, the camera without distortion is used
+// for the reprojection, unless use_distorted_camera is set, the same as for
+// integrateAllDepthResourcesOfType.
+class StereoDepthFusion {
+ public:
+  StereoDepthFusion(
+      const vi_map::VIMap& vi_map, const bool use_distorted_camera,
+      const voxblox::TsdfIntegratorBase::Config& integrator_config,
+      voxblox::TsdfMap* tsdf_map)
+      : vi_map_(vi_map),
+        use_distorted_camera_(use_distorted_camera),
+        tsdf_integrator_(
+            integrator_config, CHECK_NOTNULL(tsdf_map)->getTsdfLayerPtr()),
+        num_integrated_depths_(0u) {}
+
+  void integrate(const StereoDepth& depth) {
+    CHECK_NOTNULL(depth.vertex);
+    const vi_map::MissionId& mission_id = depth.vertex->getMissionId();
+    const aslam::NCamera& n_camera =
+        vi_map_.getSensorManager().getNCameraForMission(mission_id);
+    const aslam::Transformation& T_G_M =
+        vi_map_.getMissionBaseFrameForMission(mission_id).get_T_G_M();
+    const aslam::Transformation T_I_C =
+        n_camera.get_T_C_B(depth.camera_idx).inverse();
+    const aslam::Transformation T_G_C =
+        T_G_M * depth.vertex->get_T_M_I() * T_I_C;
+
+    if (!depth.depth_map.empty()) {
+      const aslam::Camera& camera = getCamera(n_camera, depth.camera_idx);
+      if (depth.image.empty()) {
+        voxblox_interface::integrateDepthMap(
+            T_G_C, depth.depth_map, camera, &tsdf_integrator_);
+      } else {
+        voxblox_interface::integrateDepthMap(
+            T_G_C, depth.depth_map, depth.image, camera, &tsdf_integrator_);
+      }
+    } else if (depth.point_cloud.size() > 0u) {
+      voxblox_interface::integratePointCloud(
+          T_G_C, depth.point_cloud, &tsdf_integrator_);
+    } else {
+      VLOG(3) << "Nothing to integrate.";
+      return;
+    }
+    ++num_integrated_depths_;
+  }
+
+  size_t getNumIntegratedDepths() const {
+    return num_integrated_depths_;
+  }
+
+ private:
+  const aslam::Camera& getCamera(
+      const aslam::NCamera& n_camera, const size_t camera_idx) {
+    const aslam::Camera& camera = n_camera.getCamera(camera_idx);
+    if (use_distorted_camera_) {
+      return camera;
+    }
+    aslam::Camera::ConstPtr& camera_no_distortion =
+        cameras_without_distortion_[camera.getId()];
+    if (!camera_no_distortion) {
+      aslam::Camera::Ptr new_camera;
+      backend::createCameraWithoutDistortion(camera, &new_camera);
+      CHECK(new_camera);
+      camera_no_distortion = new_camera;
+    }
+    return *camera_no_distortion;
+  }
+
+  const vi_map::VIMap& vi_map_;
+  const bool use_distorted_camera_;
+  voxblox::MergedTsdfIntegrator tsdf_integrator_;
+  std::unordered_map<aslam::CameraId, aslam::Camera::ConstPtr>
+      cameras_without_distortion_;
+  size_t num_integrated_depths_;
+};
+
+common::CommandStatus exportTsdfMeshTilesToFolder(
+    const std::string& tile_folder, voxblox::TsdfMap* tsdf_map) {
+  CHECK_NOTNULL(tsdf_map);
+  size_t num_exported_tiles = 0u;
+  if (!voxblox_interface::exportTsdfMeshTiles(
+          tile_folder, tsdf_map, &num_exported_tiles)) {
+    LOG(ERROR) << "Unable to export the mesh tiles to " << tile_folder;
+    return common::kUnknownError;
+  }
+  LOG(INFO) << "Exported " << num_exported_tiles << " updated mesh tiles to "
+            << tile_folder;
+  return common::kSuccess;
+}
+
 DenseReconstructionPlugin::DenseReconstructionPlugin(
     common::Console* console, visualization::ViwlsGraphRvizPlotter* plotter)
     : common::ConsolePluginBaseWithPlotter(console, plotter) {
@@ -174,7 +355,8 @@ DenseReconstructionPlugin::DenseReconstructionPlugin(
         }
 
         if (!dense_reconstruction::exportAllImagesForCalibration(
-                FLAGS_dense_image_export_path, map.get())) {
+                FLAGS_dense_image_export_path,
+                FLAGS_dense_image_export_copy_resource_files, map.get())) {
           return common::kUnknownError;
         }
         return common::kSuccess;
@@ -300,65 +482,34 @@ DenseReconstructionPlugin::DenseReconstructionPlugin(
           map.get()->getAllMissionIdsSortedByTimestamp(&mission_ids);
         }
 
-        voxblox::TsdfIntegratorBase::Config tsdf_integrator_config;
-
-        tsdf_integrator_config.voxel_carving_enabled =
-            FLAGS_dense_tsdf_voxel_carving_enabled;
-        tsdf_integrator_config.allow_clear =
-            FLAGS_dense_tsdf_voxel_use_clearing_rays;
-        tsdf_integrator_config.default_truncation_distance =
-            static_cast<float>(FLAGS_dense_tsdf_truncation_distance_m);
-        tsdf_integrator_config.min_ray_length_m =
-            static_cast<voxblox::FloatingPoint>(
-                FLAGS_dense_tsdf_min_ray_length_m);
-        tsdf_integrator_config.max_ray_length_m =
-            static_cast<voxblox::FloatingPoint>(
-                FLAGS_dense_tsdf_max_ray_length_m);
-
-        voxblox::TsdfMap::Config tsdf_map_config;
-        tsdf_map_config.tsdf_voxel_size =
-            static_cast<voxblox::FloatingPoint>(FLAGS_dense_tsdf_voxel_size_m);
-        tsdf_map_config.tsdf_voxels_per_side = FLAGS_dense_tsdf_voxels_per_side;
-
-        voxblox::TsdfMap tsdf_map(tsdf_map_config);
+        const voxblox::TsdfIntegratorBase::Config tsdf_integrator_config =
+            getTsdfIntegratorConfigFromGflags();
+        voxblox::TsdfMap tsdf_map(getTsdfMapConfigFromGflags());
 
         const backend::ResourceType input_resource_type =
             static_cast<backend::ResourceType>(
                 FLAGS_dense_depth_resource_input_type);
 
-        if (!voxblox_interface::integrateAllDepthResourcesOfType(
-                mission_ids, input_resource_type,
-                FLAGS_dense_use_distorted_camera, tsdf_integrator_config,
-                map.get(), &tsdf_map)) {
-          LOG(ERROR) << "Unable to compute Voxblox TSDF grid.";
-          return common::kStupidUserError;
+        bool success;
+        if (FLAGS_dense_tsdf_block_sharded_batch_size > 0u) {
+          success =
+              voxblox_interface::integrateAllDepthResourcesOfTypeBlockSharded(
+                  mission_ids, input_resource_type,
+                  FLAGS_dense_use_distorted_camera, tsdf_integrator_config,
+                  FLAGS_dense_tsdf_block_sharded_batch_size, map.get(),
+                  &tsdf_map);
+        } else {
+          success = voxblox_interface::integrateAllDepthResourcesOfType(
+              mission_ids, input_resource_type,
+              FLAGS_dense_use_distorted_camera, tsdf_integrator_config,
+              map.get(), &tsdf_map);
         }
-
-        const bool has_resource = map->hasVoxbloxTsdfMap(mission_ids);
-        if (has_resource && FLAGS_overwrite) {
-          map->replaceVoxbloxTsdfMap(mission_ids, tsdf_map);
-        } else if (has_resource && !FLAGS_overwrite) {
-          LOG(ERROR)
-              << "Could not store the Voxblox TSDF map, because there is "
-              << "already a map stored. Use --overwrite!";
+        if (!success) {
+          LOG(ERROR) << "Unable to compute Voxblox TSDF grid.";
           return common::kStupidUserError;
-        } else {
-          map->storeVoxbloxTsdfMap(tsdf_map, mission_ids);
         }
 
-        constexpr double kBytesToMegaBytes = 1e-6;
-        LOG(INFO) << "TSDF map:";
-        LOG(INFO) << "  allocated blocks: "
-                  << tsdf_map.getTsdfLayer().getNumberOfAllocatedBlocks();
-        LOG(INFO) << "  size: "
-                  << tsdf_map.getTsdfLayer().getMemorySize() * kBytesToMegaBytes
-                  << "MB";
-
-        if (!FLAGS_dense_result_mesh_output_file.empty()) {
-          return exportTsdfMeshToFile(
-              FLAGS_dense_result_mesh_output_file, &tsdf_map);
-        }
-        return common::kSuccess;
+        return storeTsdfMapAndExportMesh(mission_ids, &tsdf_map, map.get());
       },
       "Use all depth resources the selected missions "
       "and integrate them into a Voxblox TSDF map. The map is then stored as "
@@ -367,6 +518,56 @@ DenseReconstructionPlugin::DenseReconstructionPlugin(
       "--dense_depth_resource_input_type if available.",
       common::Processing::Sync);
 
+  addCommand(
+      {"stereo_dense_fusion", "stereo_tsdf"},
+      [this]() -> int {
+        // Select map.
+        std::string selected_map_key;
+        if (!getSelectedMapKeyIfSet(&selected_map_key)) {
+          return common::kStupidUserError;
+        }
+        vi_map::VIMapManager map_manager;
+        vi_map::VIMapManager::MapWriteAccess map =
+            map_manager.getMapWriteAccess(selected_map_key);
+
+        vi_map::MissionIdList mission_ids;
+        if (!parseMultipleMissionIds(*(map.get()), &mission_ids)) {
+          return common::kStupidUserError;
+        }
+
+        // If no mission were selected, use all missions.
+        if (mission_ids.empty()) {
+          map.get()->getAllMissionIdsSortedByTimestamp(&mission_ids);
+        }
+
+        const backend::ResourceType output_resource_type =
+            static_cast<backend::ResourceType>(
+                FLAGS_dense_depth_resource_output_type);
+
+        voxblox::TsdfMap tsdf_map(getTsdfMapConfigFromGflags());
+        StereoDepthFusion depth_fusion(
+            *(map.get()), FLAGS_dense_use_distorted_camera,
+            getTsdfIntegratorConfigFromGflags(), &tsdf_map);
+        dense_reconstruction::computeDepthForAllStereoCameras(
+            output_resource_type, mission_ids,
+            FLAGS_dense_stereo_fusion_store_depth_resources,
+            [&depth_fusion](const StereoDepth& depth) {
+              depth_fusion.integrate(depth);
+            },
+            map.get());
+        LOG(INFO) << "Integrated " << depth_fusion.getNumIntegratedDepths()
+                  << " depth maps or point clouds into the TSDF map.";
+
+        return storeTsdfMapAndExportMesh(mission_ids, &tsdf_map, map.get());
+      },
+      "Combines stereo_dense_reconstruction and "
+      "create_tsdf_from_depth_resource: computes the depth of all stereo "
+      "cameras of the selected missions and integrates it into a Voxblox TSDF "
+      "map while it is computed. The depth is only stored as resources if "
+      "--dense_stereo_fusion_store_depth_resources is set. The depth type is "
+      "set by --dense_depth_resource_output_type.",
+      common::Processing::Sync);
+
   addCommand(
       {"create_mesh_from_tsdf_grid", "export_tsdf"},
       [this]() -> int {
@@ -397,11 +598,21 @@ DenseReconstructionPlugin::DenseReconstructionPlugin(
           return common::kStupidUserError;
         }
 
+        if (!FLAGS_dense_result_mesh_tiles_output_folder.empty()) {
+          const common::CommandStatus status = exportTsdfMeshTilesToFolder(
+              FLAGS_dense_result_mesh_tiles_output_folder, &tsdf_map);
+          if (status != common::kSuccess ||
+              FLAGS_dense_result_mesh_output_file.empty()) {
+            return status;
+          }
+        }
         return exportTsdfMeshToFile(
             FLAGS_dense_result_mesh_output_file, &tsdf_map);
       },
       "Compute mesh of the Voxblox TSDF grid resource associated with "
-      "the selected missions.",
+      "the selected missions. Use --dense_result_mesh_output_file to export "
+      "the whole mesh, or --dense_result_mesh_tiles_output_folder to only "
+      "update the tiles of the blocks that changed since the last export.",
       common::Processing::Sync);
 }
 
@@ -21,6 +21,7 @@ class LandmarkManipulationPlugin : public common::ConsolePluginBaseWithPlotter {
  private:
   int retriangulateLandmarks();
   int evaluateLandmarkQuality();
+  int evaluateUnknownLandmarkQuality();
   int resetLandmarkQualityToUnknown();
   int initTrackLandmarks();
   int removeBadLandmarks();
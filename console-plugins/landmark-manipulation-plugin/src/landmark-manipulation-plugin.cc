@@ -25,6 +25,12 @@ LandmarkManipulationPlugin::LandmarkManipulationPlugin(
       [this]() -> int { return evaluateLandmarkQuality(); },
       "Evaluates and sets the landmark quality of all landmarks.",
       common::Processing::Sync);
+  addCommand(
+      {"evaluate_unknown_landmark_quality", "eulq"},
+      [this]() -> int { return evaluateUnknownLandmarkQuality(); },
+      "Evaluates and sets the landmark quality of all landmarks with unknown "
+      "quality, e.g. the ones touched since the last evaluation.",
+      common::Processing::Sync);
   addCommand(
       {"reset_landmark_quality", "rlq"},
       [this]() -> int { return resetLandmarkQualityToUnknown(); },
@@ -69,6 +75,23 @@ int LandmarkManipulationPlugin::evaluateLandmarkQuality() {
   return common::kSuccess;
 }
 
+int LandmarkManipulationPlugin::evaluateUnknownLandmarkQuality() {
+  std::string selected_map_key;
+  if (!getSelectedMapKeyIfSet(&selected_map_key)) {
+    return common::kStupidUserError;
+  }
+
+  vi_map::VIMapManager map_manager;
+  vi_map::VIMapManager::MapWriteAccess map =
+      map_manager.getMapWriteAccess(selected_map_key);
+
+  const size_t num_evaluated_landmarks =
+      vi_map_helpers::evaluateUnknownLandmarkQuality(map.get());
+  VLOG(1) << "Evaluated the quality of " << num_evaluated_landmarks
+          << " landmarks.";
+  return common::kSuccess;
+}
+
 int LandmarkManipulationPlugin::resetLandmarkQualityToUnknown() {
   std::string selected_map_key;
   if (!getSelectedMapKeyIfSet(&selected_map_key)) {
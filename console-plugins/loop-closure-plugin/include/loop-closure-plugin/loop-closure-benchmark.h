@@ -0,0 +1,78 @@
+#ifndef LOOP_CLOSURE_PLUGIN_LOOP_CLOSURE_BENCHMARK_H_
+#define LOOP_CLOSURE_PLUGIN_LOOP_CLOSURE_BENCHMARK_H_
+
+#include <string>
+
+#include <maplab-common/histograms.h>
+#include <maplab-common/memory-accounting.h>
+#include <maplab-common/pose_types.h>
+#include <posegraph/unique-id.h>
+#include <vi-map/unique-id.h>
+
+namespace vi_map {
+class VIMap;
+}  // namespace vi_map
+
+namespace loop_closure_plugin {
+
+struct LoopClosureBenchmarkStats {
+  LoopClosureBenchmarkStats();
+
+  // Number of query vertices, of queries that returned a pose and of returned
+  // poses that agree with the pose of the vertex in the map.
+  size_t num_queries;
+  size_t num_successful_queries;
+  size_t num_correct_queries;
+
+  double database_build_time_seconds;
+  double query_time_seconds;
+  common::histograms::ExponentialHistogram query_latency_nanoseconds;
+  common::MemoryUsage database_memory_usage;
+
+  // Correct queries over successful queries, 0 if there are none.
+  double getPrecision() const;
+  // Correct queries over all queries, 0 if there are none.
+  double getRecall() const;
+  double getQueriesPerSecond() const;
+
+  std::string toString() const;
+};
+
+// Benchmarks the loop closure and localization against a map whose vertex
+// poses are taken as ground truth, e.g. an optimized map of the test data. A
+// query counts as correct if the estimated pose of the vertex is within
+// --lc_benchmark_max_position_error_m and
+// --lc_benchmark_max_orientation_error_deg of its pose in the map.
+class LoopClosureBenchmark {
+ public:
+  explicit LoopClosureBenchmark(vi_map::VIMap* map);
+
+  // Queries every vertex of the mission against a loop detector database of
+  // all missions. The engine skips frames of the same mission that are less
+  // than --lc_min_image_time_seconds apart.
+  void benchmarkMissionToDatabase(
+      const vi_map::MissionId& query_mission_id,
+      LoopClosureBenchmarkStats* stats) const;
+
+  // Localizes every vertex of the mission against a summary map of the well
+  // constrained landmarks of all other missions. If the map only has one
+  // mission, its own landmarks are used, which overestimates the recall.
+  void benchmarkLocalization(
+      const vi_map::MissionId& query_mission_id,
+      LoopClosureBenchmarkStats* stats) const;
+
+  // Runs the loop closure of the "lc" command, which merges the landmarks
+  // of all missions, and returns its wall time. This modifies the map.
+  double benchmarkLoopClosureBetweenAllMissions();
+
+ private:
+  bool isPoseCorrect(
+      const pose_graph::VertexId& vertex_id,
+      const pose::Transformation& T_G_I_estimate) const;
+
+  vi_map::VIMap* map_;
+};
+
+}  // namespace loop_closure_plugin
+
+#endif  // LOOP_CLOSURE_PLUGIN_LOOP_CLOSURE_BENCHMARK_H_
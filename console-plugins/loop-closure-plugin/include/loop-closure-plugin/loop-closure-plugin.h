@@ -30,6 +30,7 @@ class LoopClosurePlugin : public common::ConsolePluginBaseWithPlotter {
   int serializeLoopDetector() const;
   int alignMissionsForEvaluation() const;
   int evaluateLocalization() const;
+  int evaluateLocalizationOfAllMissions() const;
 };
 }  // namespace loop_closure_plugin
 
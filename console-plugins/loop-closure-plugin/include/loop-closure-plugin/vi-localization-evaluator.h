@@ -24,8 +24,14 @@ class VILocalizationEvaluator {
   };
 
   void alignMissionsForEvaluation(const vi_map::MissionId& query_mission_id);
+  // Evaluates the query mission against all other missions.
   void evaluateLocalizationPerformance(
       const vi_map::MissionId& query_mission_id);
+  // Builds the database from the given missions once and evaluates all query
+  // missions against it in parallel.
+  void evaluateLocalizationPerformance(
+      const vi_map::MissionIdList& query_mission_ids,
+      const vi_map::MissionIdSet& db_mission_ids);
 
  private:
   vi_map::VIMap* map_;
@@ -0,0 +1,64 @@
+#include <string>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <vi-map/vi-map-serialization.h>
+#include <vi-map/vi-map.h>
+
+#include "loop-closure-plugin/loop-closure-benchmark.h"
+
+// Benchmarks the loop closure stack on a fixed map, by default the loop
+// closure test map of maplab_test_data:
+//   loop_closure_benchmark --lc_benchmark_map_folder=<map folder>
+// Every mission is queried against the loop detector database of all
+// missions and localized against a summary map of the other missions.
+// Afterwards, the loop closure with landmark merge of the "lc" command is
+// timed. Each phase reports the queries/s, the latency percentiles, the
+// database memory and the precision and recall with respect to the vertex
+// poses of the map.
+
+DEFINE_string(
+    lc_benchmark_map_folder, "./test_maps/lc_app_test",
+    "Folder of the map to benchmark the loop closure on.");
+DEFINE_bool(
+    lc_benchmark_run_landmark_merge, true,
+    "Also time the loop closure with landmark merge between all missions.");
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InstallFailureSignalHandler();
+  FLAGS_alsologtostderr = true;
+  FLAGS_colorlogtostderr = true;
+
+  vi_map::VIMap map;
+  if (!vi_map::serialization::loadMapFromFolder(
+          FLAGS_lc_benchmark_map_folder, &map)) {
+    LOG(ERROR) << "Loading the map from " << FLAGS_lc_benchmark_map_folder
+               << " failed.";
+    return 1;
+  }
+
+  loop_closure_plugin::LoopClosureBenchmark benchmark(&map);
+  vi_map::MissionIdList mission_ids;
+  map.getAllMissionIds(&mission_ids);
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    loop_closure_plugin::LoopClosureBenchmarkStats stats;
+    benchmark.benchmarkMissionToDatabase(mission_id, &stats);
+    LOG(INFO) << "Mission to database, mission " << mission_id << ":\n"
+              << stats.toString();
+
+    benchmark.benchmarkLocalization(mission_id, &stats);
+    LOG(INFO) << "Localization, mission " << mission_id << ":\n"
+              << stats.toString();
+  }
+
+  if (FLAGS_lc_benchmark_run_landmark_merge) {
+    const size_t num_landmarks_before = map.numLandmarks();
+    const double seconds = benchmark.benchmarkLoopClosureBetweenAllMissions();
+    LOG(INFO) << "Loop closure with landmark merge: " << seconds << " s, "
+              << num_landmarks_before << " landmarks before and "
+              << map.numLandmarks() << " after the merge.";
+  }
+  return 0;
+}
@@ -0,0 +1,229 @@
+#include "loop-closure-plugin/loop-closure-benchmark.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <sstream>  // NOLINT
+#include <vector>
+
+#include <Eigen/Geometry>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <localization-summary-map/localization-summary-map-creation.h>
+#include <localization-summary-map/localization-summary-map.h>
+#include <loop-closure-handler/loop-detector-node.h>
+#include <vi-map-helpers/vi-map-queries.h>
+#include <vi-map/vi-map.h>
+
+#include "loop-closure-plugin/vi-map-merger.h"
+
+DEFINE_double(
+    lc_benchmark_max_position_error_m, 0.5,
+    "Maximal position error of a loop closure or localization query to count "
+    "as correct in the loop closure benchmark.");
+DEFINE_double(
+    lc_benchmark_max_orientation_error_deg, 5.0,
+    "Maximal orientation error of a loop closure or localization query to "
+    "count as correct in the loop closure benchmark.");
+
+namespace loop_closure_plugin {
+
+namespace {
+typedef std::chrono::steady_clock Clock;
+
+double getSecondsSince(const Clock::time_point& start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+uint64_t getNanosecondsSince(const Clock::time_point& start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             Clock::now() - start)
+      .count();
+}
+}  // namespace
+
+LoopClosureBenchmarkStats::LoopClosureBenchmarkStats()
+    : num_queries(0u),
+      num_successful_queries(0u),
+      num_correct_queries(0u),
+      database_build_time_seconds(0.0),
+      query_time_seconds(0.0) {}
+
+double LoopClosureBenchmarkStats::getPrecision() const {
+  if (num_successful_queries == 0u) {
+    return 0.0;
+  }
+  return static_cast<double>(num_correct_queries) / num_successful_queries;
+}
+
+double LoopClosureBenchmarkStats::getRecall() const {
+  if (num_queries == 0u) {
+    return 0.0;
+  }
+  return static_cast<double>(num_correct_queries) / num_queries;
+}
+
+double LoopClosureBenchmarkStats::getQueriesPerSecond() const {
+  if (query_time_seconds <= 0.0) {
+    return 0.0;
+  }
+  return num_queries / query_time_seconds;
+}
+
+std::string LoopClosureBenchmarkStats::toString() const {
+  constexpr double kNanosecondsToMilliseconds = 1e-6;
+  std::ostringstream out;
+  out << "Queries: " << num_queries << " (" << num_successful_queries
+      << " successful, " << num_correct_queries << " correct)\n";
+  out << "Precision: " << getPrecision() << ", recall: " << getRecall()
+      << '\n';
+  out << "Database build time: " << database_build_time_seconds << " s\n";
+  out << "Queries/s: " << getQueriesPerSecond() << '\n';
+  out << "Latency p50: "
+      << query_latency_nanoseconds.getPercentile(50.0) *
+             kNanosecondsToMilliseconds
+      << " ms, p99: "
+      << query_latency_nanoseconds.getPercentile(99.0) *
+             kNanosecondsToMilliseconds
+      << " ms, max: "
+      << query_latency_nanoseconds.getMax() * kNanosecondsToMilliseconds
+      << " ms\n";
+  out << "Database memory:\n" << database_memory_usage.toString();
+  return out.str();
+}
+
+LoopClosureBenchmark::LoopClosureBenchmark(vi_map::VIMap* map) : map_(map) {
+  CHECK_NOTNULL(map_);
+}
+
+void LoopClosureBenchmark::benchmarkMissionToDatabase(
+    const vi_map::MissionId& query_mission_id,
+    LoopClosureBenchmarkStats* stats) const {
+  CHECK_NOTNULL(stats);
+  CHECK(map_->hasMission(query_mission_id));
+  *stats = LoopClosureBenchmarkStats();
+
+  loop_detector_node::LoopDetectorNode loop_detector;
+  vi_map::MissionIdList mission_ids;
+  map_->getAllMissionIds(&mission_ids);
+  const Clock::time_point build_start = Clock::now();
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    loop_detector.addMissionToDatabase(mission_id, *map_);
+  }
+  stats->database_build_time_seconds = getSecondsSince(build_start);
+  loop_detector.getMemoryUsage(&stats->database_memory_usage);
+
+  pose_graph::VertexIdList vertex_ids;
+  map_->getAllVertexIdsInMissionAlongGraph(query_mission_id, &vertex_ids);
+  constexpr bool kMergeLandmarks = false;
+  constexpr bool kAddLoopClosureEdges = false;
+  const Clock::time_point query_start = Clock::now();
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    pose::Transformation T_G_I;
+    unsigned int num_matches = 0u;
+    vi_map::LoopClosureConstraint inlier_constraint;
+    const Clock::time_point start = Clock::now();
+    const bool success = loop_detector.findVertexInDatabase(
+        map_->getVertex(vertex_id), kMergeLandmarks, kAddLoopClosureEdges,
+        map_, &T_G_I, &num_matches, &inlier_constraint);
+    stats->query_latency_nanoseconds.addSample(getNanosecondsSince(start));
+
+    ++stats->num_queries;
+    if (success) {
+      ++stats->num_successful_queries;
+      if (isPoseCorrect(vertex_id, T_G_I)) {
+        ++stats->num_correct_queries;
+      }
+    }
+  }
+  stats->query_time_seconds = getSecondsSince(query_start);
+}
+
+void LoopClosureBenchmark::benchmarkLocalization(
+    const vi_map::MissionId& query_mission_id,
+    LoopClosureBenchmarkStats* stats) const {
+  CHECK_NOTNULL(stats);
+  CHECK(map_->hasMission(query_mission_id));
+  *stats = LoopClosureBenchmarkStats();
+
+  vi_map_helpers::VIMapQueries queries(*map_);
+  vi_map::LandmarkIdList well_constrained_landmark_ids;
+  queries.getAllWellConstrainedLandmarkIds(&well_constrained_landmark_ids);
+  const bool use_own_landmarks = map_->numMissions() == 1u;
+  if (use_own_landmarks) {
+    LOG(WARNING) << "The map only has one mission, the localization is "
+                 << "benchmarked against its own landmarks.";
+  }
+  vi_map::LandmarkIdList landmark_ids;
+  for (const vi_map::LandmarkId& landmark_id : well_constrained_landmark_ids) {
+    if (use_own_landmarks ||
+        map_->getMissionIdForLandmark(landmark_id) != query_mission_id) {
+      landmark_ids.push_back(landmark_id);
+    }
+  }
+  if (landmark_ids.empty()) {
+    LOG(WARNING) << "No well constrained landmarks to localize against.";
+    return;
+  }
+
+  const Clock::time_point build_start = Clock::now();
+  summary_map::LocalizationSummaryMap summary_map;
+  summary_map::LocalizationSummaryMapId summary_map_id;
+  common::generateId(&summary_map_id);
+  summary_map.setId(summary_map_id);
+  summary_map::createLocalizationSummaryMapFromLandmarkList(
+      *map_, landmark_ids, &summary_map);
+  loop_detector_node::LoopDetectorNode loop_detector;
+  loop_detector.addLocalizationSummaryMapToDatabase(summary_map);
+  stats->database_build_time_seconds = getSecondsSince(build_start);
+  loop_detector.getMemoryUsage(&stats->database_memory_usage);
+
+  pose_graph::VertexIdList vertex_ids;
+  map_->getAllVertexIdsInMissionAlongGraph(query_mission_id, &vertex_ids);
+  constexpr bool kSkipUntrackedKeypoints = false;
+  const Clock::time_point query_start = Clock::now();
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    pose::Transformation T_G_I;
+    unsigned int num_matches = 0u;
+    vi_map::VertexKeyPointToStructureMatchList inlier_structure_matches;
+    const Clock::time_point start = Clock::now();
+    const bool success = loop_detector.findNFrameInSummaryMapDatabase(
+        map_->getVertex(vertex_id).getVisualNFrame(), kSkipUntrackedKeypoints,
+        summary_map, &T_G_I, &num_matches, &inlier_structure_matches);
+    stats->query_latency_nanoseconds.addSample(getNanosecondsSince(start));
+
+    ++stats->num_queries;
+    if (success) {
+      ++stats->num_successful_queries;
+      if (isPoseCorrect(vertex_id, T_G_I)) {
+        ++stats->num_correct_queries;
+      }
+    }
+  }
+  stats->query_time_seconds = getSecondsSince(query_start);
+}
+
+double LoopClosureBenchmark::benchmarkLoopClosureBetweenAllMissions() {
+  constexpr std::nullptr_t kPlotter = nullptr;
+  VIMapMerger merger(map_, kPlotter);
+  const Clock::time_point start = Clock::now();
+  const int status = merger.findLoopClosuresBetweenAllMissions();
+  const double seconds = getSecondsSince(start);
+  LOG_IF(WARNING, status != common::kSuccess)
+      << "The loop closure failed with status " << status << '.';
+  return seconds;
+}
+
+bool LoopClosureBenchmark::isPoseCorrect(
+    const pose_graph::VertexId& vertex_id,
+    const pose::Transformation& T_G_I_estimate) const {
+  const pose::Transformation T_G_I = map_->getVertex_T_G_I(vertex_id);
+  const pose::Transformation T_error = T_G_I.inverse() * T_G_I_estimate;
+  const double position_error_m = T_error.getPosition().norm();
+  const double orientation_error_deg =
+      Eigen::AngleAxisd(T_error.getRotationMatrix()).angle() * 180.0 / M_PI;
+  return position_error_m <= FLAGS_lc_benchmark_max_position_error_m &&
+         orientation_error_deg <= FLAGS_lc_benchmark_max_orientation_error_deg;
+}
+
+}  // namespace loop_closure_plugin
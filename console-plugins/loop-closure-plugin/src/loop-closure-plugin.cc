@@ -4,6 +4,7 @@
 #include <map-manager/map-manager.h>
 #include <posegraph/pose-graph.h>
 #include <posegraph/unique-id.h>
+#include <vi-map/unique-id.h>
 #include <vi-map/vi-map-serialization.h>
 #include <vi-map/vi-map.h>
 #include <visualization/viwls-graph-plotter.h>
@@ -13,6 +14,13 @@
 #include "loop-closure-plugin/vi-map-merger.h"
 
 DECLARE_string(map_mission);
+DECLARE_string(map_mission_list);
+
+DEFINE_string(
+    eloc_database_mission_list, "",
+    "Comma-separated list of the missions that form the localization database "
+    "of evaluate_localization_all_missions. All other missions are queried "
+    "against it, unless --map_mission_list selects the query missions.");
 
 namespace loop_closure_plugin {
 
@@ -54,6 +62,14 @@ LoopClosurePlugin::LoopClosurePlugin(
       "Evaluation localization between a query and database missions. "
       "Please align the missions first.",
       common::Processing::Sync);
+
+  addCommand(
+      {"elocam", "evaluate_localization_all_missions"},
+      [this]() -> int { return evaluateLocalizationOfAllMissions(); },
+      "Evaluate localization of several query missions against one database "
+      "of the missions given by --eloc_database_mission_list, which is built "
+      "only once. Please align the missions first.",
+      common::Processing::Sync);
 }
 
 bool areQualitiesOfAllLandmarksSet(const vi_map::VIMap& map) {
@@ -196,6 +212,70 @@ int LoopClosurePlugin::evaluateLocalization() const {
   return common::kSuccess;
 }
 
+int LoopClosurePlugin::evaluateLocalizationOfAllMissions() const {
+  std::string selected_map_key;
+  if (!getSelectedMapKeyIfSet(&selected_map_key)) {
+    return common::kStupidUserError;
+  }
+  vi_map::VIMapManager map_manager;
+  vi_map::VIMapManager::MapWriteAccess map =
+      map_manager.getMapWriteAccess(selected_map_key);
+
+  vi_map::MissionIdList db_mission_id_list;
+  if (FLAGS_eloc_database_mission_list.empty() ||
+      !vi_map::csvIdStringToIdList(
+          FLAGS_eloc_database_mission_list, &db_mission_id_list)) {
+    LOG(ERROR) << "Specify the database missions with a valid "
+               << "--eloc_database_mission_list.";
+    return common::kStupidUserError;
+  }
+  const vi_map::MissionIdSet db_mission_ids(
+      db_mission_id_list.begin(), db_mission_id_list.end());
+  for (const vi_map::MissionId& mission_id : db_mission_ids) {
+    if (!map->hasMission(mission_id)) {
+      LOG(ERROR) << "The database mission " << mission_id
+                 << " is not in the map.";
+      return common::kStupidUserError;
+    }
+  }
+
+  vi_map::MissionIdList query_mission_ids;
+  if (FLAGS_map_mission_list.empty()) {
+    vi_map::MissionIdList all_mission_ids;
+    map->getAllMissionIds(&all_mission_ids);
+    for (const vi_map::MissionId& mission_id : all_mission_ids) {
+      if (db_mission_ids.count(mission_id) == 0u) {
+        query_mission_ids.push_back(mission_id);
+      }
+    }
+  } else if (!vi_map::csvIdStringToIdList(
+                 FLAGS_map_mission_list, &query_mission_ids)) {
+    LOG(ERROR) << "The provided CSV mission id list is not valid!";
+    return common::kStupidUserError;
+  }
+  for (const vi_map::MissionId& mission_id : query_mission_ids) {
+    if (!map->hasMission(mission_id)) {
+      LOG(ERROR) << "The query mission " << mission_id
+                 << " is not in the map.";
+      return common::kStupidUserError;
+    }
+    if (db_mission_ids.count(mission_id) > 0u) {
+      LOG(ERROR) << "The query mission " << mission_id
+                 << " is part of the database.";
+      return common::kStupidUserError;
+    }
+  }
+  if (query_mission_ids.empty()) {
+    LOG(ERROR) << "No missions to query against the database.";
+    return common::kStupidUserError;
+  }
+
+  VILocalizationEvaluator evaluator(map.get(), plotter_);
+  evaluator.evaluateLocalizationPerformance(query_mission_ids, db_mission_ids);
+
+  return common::kSuccess;
+}
+
 }  // namespace loop_closure_plugin
 
 MAPLAB_CREATE_CONSOLE_PLUGIN_WITH_PLOTTER(
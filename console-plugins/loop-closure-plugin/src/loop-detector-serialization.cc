@@ -8,6 +8,11 @@
 #include <vi-map/unique-id.h>
 #include <vi-map/vi-map.h>
 
+DEFINE_bool(
+    lc_serialize_loop_detector_binary, false,
+    "Save the loop detector in the memory-mappable binary layout instead of "
+    "as protobuf. Loop closure prefers the binary file if both exist.");
+
 namespace loop_closure_plugin {
 
 int generateLoopDetectorForVIMapAndSerialize(
@@ -28,15 +33,22 @@ int generateLoopDetectorForVIMapAndSerialize(
   }
 
   const std::string loop_detector_serialization_filename =
-      loop_detector_node.getDefaultSerializationFilename();
+      FLAGS_lc_serialize_loop_detector_binary
+          ? loop_detector_node.getDefaultBinarySerializationFilename()
+          : loop_detector_node.getDefaultSerializationFilename();
   std::string loop_detector_serialization_filepath;
   common::concatenateFolderAndFileName(
       map_folder, loop_detector_serialization_filename,
       &loop_detector_serialization_filepath);
   VLOG(1) << "Serializing loop detector to "
           << loop_detector_serialization_filepath;
-  if (!loop_detector_node.serializeToFile(
-          loop_detector_serialization_filepath)) {
+  const bool success =
+      FLAGS_lc_serialize_loop_detector_binary
+          ? loop_detector_node.saveToBinaryFile(
+                loop_detector_serialization_filepath)
+          : loop_detector_node.serializeToFile(
+                loop_detector_serialization_filepath);
+  if (!success) {
     LOG(ERROR) << "Failed to serialize loop detector!";
     return common::kUnknownError;
   }
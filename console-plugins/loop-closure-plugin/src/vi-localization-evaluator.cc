@@ -1,5 +1,7 @@
 #include "loop-closure-plugin/vi-localization-evaluator.h"
 
+#include <vector>
+
 #include <localization-evaluator/localization-evaluator.h>
 #include <localization-evaluator/mission-aligner.h>
 #include <maplab-common/file-system-tools.h>
@@ -41,9 +43,16 @@ void VILocalizationEvaluator::evaluateLocalizationPerformance(
   CHECK_GT(db_mission_ids.count(query_mission_id), 0u);
   db_mission_ids.erase(query_mission_id);
 
+  evaluateLocalizationPerformance({query_mission_id}, db_mission_ids);
+}
+
+void VILocalizationEvaluator::evaluateLocalizationPerformance(
+    const vi_map::MissionIdList& query_mission_ids,
+    const vi_map::MissionIdSet& db_mission_ids) {
   // Collect all database landmarks.
   vi_map::LandmarkIdSet selected_landmarks;
   for (const vi_map::MissionId& mission_id : db_mission_ids) {
+    CHECK(map_->hasMission(mission_id));
     vi_map::LandmarkIdList mission_landmarks;
     map_->getAllLandmarkIdsInMission(mission_id, &mission_landmarks);
     selected_landmarks.insert(
@@ -52,19 +61,28 @@ void VILocalizationEvaluator::evaluateLocalizationPerformance(
   LOG(INFO) << "Will query against " << selected_landmarks.size()
             << " landmarks.";
 
-  localization_evaluator::MissionEvaluationStats mission_statistics;
+  Aligned<std::vector, localization_evaluator::MissionEvaluationStats>
+      mission_statistics;
   localization_evaluator::LocalizationEvaluator benchmark(
       selected_landmarks, map_);
-  LOG(INFO) << "Evaluating the localizations.";
-  benchmark.evaluateMission(query_mission_id, &mission_statistics);
+  LOG(INFO) << "Evaluating the localizations of " << query_mission_ids.size()
+            << " mission(s).";
+  benchmark.evaluateMissions(query_mission_ids, &mission_statistics);
+  CHECK_EQ(mission_statistics.size(), query_mission_ids.size());
 
-  if (mission_statistics.num_vertices > 0u) {
-    LOG(INFO) << "Recall: "
-              << (static_cast<float>(
-                      mission_statistics.successful_localizations) /
-                  mission_statistics.num_vertices);
-  } else {
-    LOG(WARNING) << "No vertices evaluated!";
+  for (size_t mission_idx = 0u; mission_idx < query_mission_ids.size();
+       ++mission_idx) {
+    const localization_evaluator::MissionEvaluationStats& statistics =
+        mission_statistics[mission_idx];
+    if (statistics.num_vertices > 0u) {
+      LOG(INFO) << "Recall of mission " << query_mission_ids[mission_idx]
+                << ": "
+                << (static_cast<float>(statistics.successful_localizations) /
+                    statistics.num_vertices);
+    } else {
+      LOG(WARNING) << "No vertices evaluated for mission "
+                   << query_mission_ids[mission_idx] << "!";
+    }
   }
 }
 
@@ -49,17 +49,33 @@ int VIMapMerger::findLoopClosuresBetweenMissions(
   common::concatenateFolderAndFileName(
       map_folder, loop_detector_serialization_filename,
       &loop_detector_serialization_filepath);
+  std::string loop_detector_binary_filepath;
+  common::concatenateFolderAndFileName(
+      map_folder,
+      loop_detector_node::LoopDetectorNode::
+          getDefaultBinarySerializationFilename(),
+      &loop_detector_binary_filepath);
+  const bool has_binary_loop_detector =
+      common::fileExists(loop_detector_binary_filepath);
 
-  if (common::fileExists(loop_detector_serialization_filepath)) {
+  if (has_binary_loop_detector ||
+      common::fileExists(loop_detector_serialization_filepath)) {
+    if (has_binary_loop_detector) {
+      loop_detector_serialization_filepath = loop_detector_binary_filepath;
+    }
     VLOG(1) << "Using serialized loop-detector from file "
-            << loop_detector_serialization_filename << '.';
+            << loop_detector_serialization_filepath << '.';
     loop_detector_node::LoopDetectorNode loop_detector;
     if (plotter_ != nullptr) {
       loop_detector.instantiateVisualizer();
     }
-    CHECK(
-        loop_detector.deserializeFromFile(
-            loop_detector_serialization_filepath));
+    if (has_binary_loop_detector) {
+      CHECK(loop_detector.mapFromBinaryFile(loop_detector_binary_filepath));
+    } else {
+      CHECK(
+          loop_detector.deserializeFromFile(
+              loop_detector_serialization_filepath));
+    }
     LOG_IF(WARNING, FLAGS_lc_only_against_other_missions)
         << "Flag -lc_skip_self_lc is set "
         << "to true but has no effect since the loop-closure database is "
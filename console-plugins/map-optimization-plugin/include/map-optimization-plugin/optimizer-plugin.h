@@ -25,6 +25,9 @@ class OptimizerPlugin : public common::ConsolePluginBaseWithPlotter {
 
  private:
   int optimizeVisualInertial(bool visual_only, bool outlier_rejection);
+  int optimizeVisualInertialLocally(bool outlier_rejection);
+  int optimizeVisualInertialHierarchically(bool outlier_rejection);
+  int optimizeVisualInertialReduced();
 
   int relaxMap();
   int relaxMapMissionsSeparately();
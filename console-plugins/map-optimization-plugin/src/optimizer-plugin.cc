@@ -6,6 +6,7 @@
 #include <map-manager/map-manager.h>
 #include <map-optimization/outlier-rejection-solver.h>
 #include <map-optimization/vi-optimization-builder.h>
+#include <posegraph/unique-id.h>
 #include <vi-map/vi-map.h>
 #include <visualization/viwls-graph-plotter.h>
 
@@ -15,10 +16,57 @@
 DEFINE_bool(
     ba_use_outlier_rejection_solver, true,
     "Reject outlier landmarks during the solve?");
+DEFINE_int32(
+    ba_hierarchical_num_partitions, 8,
+    "Number of partitions that optimize_visual_inertial_hierarchical splits "
+    "the map into.");
+DEFINE_int32(
+    ba_local_num_hops, 2,
+    "Number of co-visibility hops around the seed vertices that are "
+    "optimized by optimize_visual_inertial_local.");
+DEFINE_string(
+    ba_local_seed_vertex_list, "",
+    "Comma-separated list of the seed vertices of "
+    "optimize_visual_inertial_local. Per default all vertices with a loop "
+    "closure edge are used.");
 DECLARE_string(map_mission);
 DECLARE_string(map_mission_list);
 
 namespace map_optimization_plugin {
+namespace {
+// Selects --map_mission, --map_mission_list or per default all missions.
+bool getMissionsToOptimize(
+    const vi_map::VIMap& map, vi_map::MissionIdSet* missions_to_optimize) {
+  CHECK_NOTNULL(missions_to_optimize)->clear();
+  vi_map::MissionIdList missions_to_optimize_list;
+  if (!FLAGS_map_mission.empty()) {
+    if (!FLAGS_map_mission_list.empty()) {
+      LOG(ERROR) << "Please provide only one of --map_mission and "
+                 << "--map_mission_list.";
+      return false;
+    }
+    vi_map::MissionId mission_id;
+    if (!map.hexStringToMissionIdIfValid(FLAGS_map_mission, &mission_id)) {
+      LOG(ERROR) << "The given mission id \"" << FLAGS_map_mission
+                 << "\" is not valid.";
+      return false;
+    }
+    missions_to_optimize_list.emplace_back(mission_id);
+  } else if (!FLAGS_map_mission_list.empty()) {
+    if (!vi_map::csvIdStringToIdList(
+            FLAGS_map_mission_list, &missions_to_optimize_list)) {
+      LOG(ERROR) << "The provided CSV mission id list is not valid!";
+      return false;
+    }
+  } else {
+    map.getAllMissionIds(&missions_to_optimize_list);
+  }
+  missions_to_optimize->insert(
+      missions_to_optimize_list.begin(), missions_to_optimize_list.end());
+  return true;
+}
+}  // namespace
+
 OptimizerPlugin::OptimizerPlugin(
     common::Console* console, visualization::ViwlsGraphRvizPlotter* plotter)
     : common::ConsolePluginBaseWithPlotter(console, plotter) {
@@ -42,13 +90,43 @@ OptimizerPlugin::OptimizerPlugin(
       "Visual-inertial optimization over the selected missions "
       "(per default all).",
       common::Processing::Sync);
+  addCommand(
+      {"optimize_visual_inertial_local", "optvil"},
+      [this]() -> int {
+        return optimizeVisualInertialLocally(
+            FLAGS_ba_use_outlier_rejection_solver);
+      },
+      "Visual-inertial optimization of the neighborhood of the vertices given "
+      "by --ba_local_seed_vertex_list (per default all loop closure "
+      "vertices), the rest of the map is kept fixed.",
+      common::Processing::Sync);
+  addCommand(
+      {"optimize_visual_inertial_hierarchical", "optvih"},
+      [this]() -> int {
+        return optimizeVisualInertialHierarchically(
+            FLAGS_ba_use_outlier_rejection_solver);
+      },
+      "Visual-inertial optimization over the selected missions (per default "
+      "all) that solves --ba_hierarchical_num_partitions partitions of the map "
+      "in parallel and then aligns them.",
+      common::Processing::Sync);
+  addCommand(
+      {"optimize_visual_inertial_reduced", "optvir"},
+      [this]() -> int { return optimizeVisualInertialReduced(); },
+      "Cheap visual-inertial re-optimization over the selected missions (per "
+      "default all) with the landmarks eliminated into pose constraints at the "
+      "current state of the map, followed by re-estimating the landmarks. Use "
+      "after optvi.",
+      common::Processing::Sync);
   addCommand(
       {"relax"}, [this]() -> int { return relaxMap(); }, "nRelax posegraph.",
       common::Processing::Sync);
   addCommand(
       {"relax_missions_independently", "srelax"},
       [this]() -> int { return relaxMapMissionsSeparately(); },
-      "Relax missions separately.", common::Processing::Sync);
+      "Relax missions separately. The missions are solved in parallel, see "
+      "--relax_missions_num_parallel.",
+      common::Processing::Sync);
 }
 
 int OptimizerPlugin::optimizeVisualInertial(
@@ -62,31 +140,10 @@ int OptimizerPlugin::optimizeVisualInertial(
   vi_map::VIMapManager::MapWriteAccess map =
       map_manager.getMapWriteAccess(selected_map_key);
 
-  vi_map::MissionIdList missions_to_optimize_list;
-  if (!FLAGS_map_mission.empty()) {
-    if (!FLAGS_map_mission_list.empty()) {
-      LOG(ERROR) << "Please provide only one of --map_mission and "
-                 << "--map_mission_list.";
-      return common::kStupidUserError;
-    }
-    vi_map::MissionId mission_id;
-    if (!map->hexStringToMissionIdIfValid(FLAGS_map_mission, &mission_id)) {
-      LOG(ERROR) << "The given mission id \"" << FLAGS_map_mission
-                 << "\" is not valid.";
-      return common::kStupidUserError;
-    }
-    missions_to_optimize_list.emplace_back(mission_id);
-  } else if (!FLAGS_map_mission_list.empty()) {
-    if (!vi_map::csvIdStringToIdList(
-            FLAGS_map_mission_list, &missions_to_optimize_list)) {
-      LOG(ERROR) << "The provided CSV mission id list is not valid!";
-      return common::kStupidUserError;
-    }
-  } else {
-    map->getAllMissionIds(&missions_to_optimize_list);
+  vi_map::MissionIdSet missions_to_optimize;
+  if (!getMissionsToOptimize(*map, &missions_to_optimize)) {
+    return common::kStupidUserError;
   }
-  vi_map::MissionIdSet missions_to_optimize(
-      missions_to_optimize_list.begin(), missions_to_optimize_list.end());
 
   map_optimization::ViProblemOptions options =
       map_optimization::ViProblemOptions::initFromGFlags();
@@ -111,6 +168,140 @@ int OptimizerPlugin::optimizeVisualInertial(
   return common::kSuccess;
 }
 
+int OptimizerPlugin::optimizeVisualInertialReduced() {
+  std::string selected_map_key;
+  if (!getSelectedMapKeyIfSet(&selected_map_key)) {
+    return common::kStupidUserError;
+  }
+  vi_map::VIMapManager map_manager;
+  vi_map::VIMapManager::MapWriteAccess map =
+      map_manager.getMapWriteAccess(selected_map_key);
+
+  vi_map::MissionIdSet missions_to_optimize;
+  if (!getMissionsToOptimize(*map, &missions_to_optimize)) {
+    return common::kStupidUserError;
+  }
+
+  map_optimization::ViProblemOptions options =
+      map_optimization::ViProblemOptions::initFromGFlags();
+
+  map_optimization::VIMapOptimizer optimizer(plotter_, kSignalHandlerEnabled);
+  if (!optimizer.optimizeVisualInertialReduced(
+          options, missions_to_optimize, map.get())) {
+    return common::kUnknownError;
+  }
+  return common::kSuccess;
+}
+
+int OptimizerPlugin::optimizeVisualInertialHierarchically(
+    bool outlier_rejection) {
+  std::string selected_map_key;
+  if (!getSelectedMapKeyIfSet(&selected_map_key)) {
+    return common::kStupidUserError;
+  }
+  vi_map::VIMapManager map_manager;
+  vi_map::VIMapManager::MapWriteAccess map =
+      map_manager.getMapWriteAccess(selected_map_key);
+
+  vi_map::MissionIdSet missions_to_optimize;
+  if (!getMissionsToOptimize(*map, &missions_to_optimize)) {
+    return common::kStupidUserError;
+  }
+  if (FLAGS_ba_hierarchical_num_partitions <= 0) {
+    LOG(ERROR) << "--ba_hierarchical_num_partitions must be positive.";
+    return common::kStupidUserError;
+  }
+
+  map_optimization::ViProblemOptions options =
+      map_optimization::ViProblemOptions::initFromGFlags();
+
+  map_optimization::VIMapOptimizer optimizer(plotter_, kSignalHandlerEnabled);
+  bool success;
+  if (outlier_rejection) {
+    map_optimization::OutlierRejectionSolverOptions outlier_rejection_options =
+        map_optimization::OutlierRejectionSolverOptions::initFromFlags();
+    success = optimizer.optimizeVisualInertialHierarchically(
+        options, missions_to_optimize, FLAGS_ba_hierarchical_num_partitions,
+        &outlier_rejection_options, map.get());
+  } else {
+    success = optimizer.optimizeVisualInertialHierarchically(
+        options, missions_to_optimize, FLAGS_ba_hierarchical_num_partitions,
+        nullptr, map.get());
+  }
+  if (!success) {
+    return common::kUnknownError;
+  }
+  return common::kSuccess;
+}
+
+int OptimizerPlugin::optimizeVisualInertialLocally(bool outlier_rejection) {
+  std::string selected_map_key;
+  if (!getSelectedMapKeyIfSet(&selected_map_key)) {
+    return common::kStupidUserError;
+  }
+  vi_map::VIMapManager map_manager;
+  vi_map::VIMapManager::MapWriteAccess map =
+      map_manager.getMapWriteAccess(selected_map_key);
+
+  if (FLAGS_ba_local_num_hops < 0) {
+    LOG(ERROR) << "--ba_local_num_hops must not be negative.";
+    return common::kStupidUserError;
+  }
+
+  pose_graph::VertexIdSet seed_vertex_ids;
+  if (!FLAGS_ba_local_seed_vertex_list.empty()) {
+    pose_graph::VertexIdList seed_vertex_id_list;
+    if (!vi_map::csvIdStringToIdList(
+            FLAGS_ba_local_seed_vertex_list, &seed_vertex_id_list)) {
+      LOG(ERROR) << "The provided CSV vertex id list is not valid!";
+      return common::kStupidUserError;
+    }
+    for (const pose_graph::VertexId& vertex_id : seed_vertex_id_list) {
+      if (!map->hasVertex(vertex_id)) {
+        LOG(ERROR) << "The seed vertex " << vertex_id << " is not in the map.";
+        return common::kStupidUserError;
+      }
+      seed_vertex_ids.insert(vertex_id);
+    }
+  } else {
+    pose_graph::EdgeIdList edge_ids;
+    map->getAllEdgeIds(&edge_ids);
+    for (const pose_graph::EdgeId& edge_id : edge_ids) {
+      if (map->getEdgeType(edge_id) ==
+          pose_graph::Edge::EdgeType::kLoopClosure) {
+        const vi_map::Edge& edge = map->getEdgeAs<vi_map::Edge>(edge_id);
+        seed_vertex_ids.insert(edge.from());
+        seed_vertex_ids.insert(edge.to());
+      }
+    }
+  }
+  if (seed_vertex_ids.empty()) {
+    LOG(ERROR) << "No seed vertices, specify --ba_local_seed_vertex_list or "
+               << "add loop closure edges.";
+    return common::kStupidUserError;
+  }
+
+  map_optimization::ViProblemOptions options =
+      map_optimization::ViProblemOptions::initFromGFlags();
+
+  map_optimization::VIMapOptimizer optimizer(plotter_, kSignalHandlerEnabled);
+  bool success;
+  if (outlier_rejection) {
+    map_optimization::OutlierRejectionSolverOptions outlier_rejection_options =
+        map_optimization::OutlierRejectionSolverOptions::initFromFlags();
+    success = optimizer.optimizeVisualInertialLocally(
+        options, seed_vertex_ids, FLAGS_ba_local_num_hops,
+        &outlier_rejection_options, map.get());
+  } else {
+    success = optimizer.optimizeVisualInertialLocally(
+        options, seed_vertex_ids, FLAGS_ba_local_num_hops, nullptr, map.get());
+  }
+  if (!success) {
+    return common::kUnknownError;
+  }
+  return common::kSuccess;
+}
+
 int OptimizerPlugin::relaxMap() {
   std::string selected_map_key;
   if (!getSelectedMapKeyIfSet(&selected_map_key)) {
@@ -147,10 +338,9 @@ int OptimizerPlugin::relaxMapMissionsSeparately() {
   vi_map::MissionIdList mission_id_list;
   map.get()->getAllMissionIds(&mission_id_list);
 
-  for (const vi_map::MissionId& mission_id : mission_id_list) {
-    relaxation.relax({mission_id}, map.get());
+  if (!relaxation.relaxMissionsIndependently(mission_id_list, map.get())) {
+    return common::kUnknownError;
   }
-
   return common::kSuccess;
 }
 
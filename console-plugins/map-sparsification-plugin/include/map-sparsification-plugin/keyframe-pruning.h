@@ -14,5 +14,12 @@ int keyframeMapBasedOnHeuristics(
     const vi_map::MissionId& mission_id,
     visualization::ViwlsGraphRvizPlotter* plotter, vi_map::VIMap* map);
 
+// Keyframes all given missions. The keyframes of the missions are selected in
+// parallel, the vertices between them are then removed mission by mission.
+int keyframeMapBasedOnHeuristics(
+    const map_sparsification::KeyframingHeuristicsOptions& options,
+    const vi_map::MissionIdList& mission_ids,
+    visualization::ViwlsGraphRvizPlotter* plotter, vi_map::VIMap* map);
+
 }  // namespace map_sparsification_plugin
 #endif  // MAP_SPARSIFICATION_PLUGIN_KEYFRAME_PRUNING_H_
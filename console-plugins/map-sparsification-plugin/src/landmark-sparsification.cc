@@ -1,9 +1,19 @@
 #include "map-sparsification-plugin/landmark-sparsification.h"
 
+#include <string>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
 #include <map-sparsification/sampler-base.h>
 #include <map-sparsification/sampler-factory.h>
 #include <vi-map-helpers/vi-map-queries.h>
 
+DEFINE_string(
+    landmark_sparsification_solver, "lp_solve",
+    "Solver used to select the landmarks to keep: \"lp_solve\" solves an "
+    "ILP per map partition, \"greedy\" selects the landmarks greedily, "
+    "which scales to much larger partitions.");
+
 namespace map_sparsification_plugin {
 
 bool sparsifyMapLandmarks(
@@ -24,8 +34,18 @@ bool sparsifyMapLandmarks(
   }
 
   using map_sparsification::SamplerBase;
-  SamplerBase::Ptr sampler = map_sparsification::createSampler(
-      SamplerBase::Type::kLpsolvePartitionIlp);
+  SamplerBase::Type sampler_type;
+  if (FLAGS_landmark_sparsification_solver == "lp_solve") {
+    sampler_type = SamplerBase::Type::kLpsolvePartitionIlp;
+  } else if (FLAGS_landmark_sparsification_solver == "greedy") {
+    sampler_type = SamplerBase::Type::kGreedyCoveragePartition;
+  } else {
+    LOG(ERROR) << "Unknown landmark sparsification solver \""
+               << FLAGS_landmark_sparsification_solver
+               << "\", use \"lp_solve\" or \"greedy\".";
+    return false;
+  }
+  SamplerBase::Ptr sampler = map_sparsification::createSampler(sampler_type);
 
   vi_map::LandmarkIdSet landmarks_to_keep;
   sampler->sample(*map, num_landmarks_to_keep, &landmarks_to_keep);
@@ -70,14 +70,13 @@ MapSparsificationPlugin::MapSparsificationPlugin(
         using map_sparsification::KeyframingHeuristicsOptions;
         KeyframingHeuristicsOptions options =
             KeyframingHeuristicsOptions::initializeFromGFlags();
-        for (const vi_map::MissionId& mission_id : missions_to_keyframe) {
-          VLOG(1) << "Keyframing mission " << mission_id << '.';
-          if (keyframeMapBasedOnHeuristics(
-                  options, mission_id, plotter_, map.get()) !=
-              common::kSuccess) {
-            LOG(ERROR) << "Keyframing of mission " << mission_id << " failed.";
-            return common::kUnknownError;
-          }
+        VLOG(1) << "Keyframing " << missions_to_keyframe.size()
+                << " missions.";
+        if (keyframeMapBasedOnHeuristics(
+                options, missions_to_keyframe, plotter_, map.get()) !=
+            common::kSuccess) {
+          LOG(ERROR) << "Keyframing of the missions failed.";
+          return common::kUnknownError;
         }
         return common::kSuccess;
       },
@@ -108,7 +107,8 @@ MapSparsificationPlugin::MapSparsificationPlugin(
         return common::kSuccess;
       },
       "Sparsify landmarks using summarization techniques. Use the flag "
-      "--num_of_landmarks_to_keep to set the number of desired landmarks.",
+      "--num_of_landmarks_to_keep to set the number of desired landmarks "
+      "and --landmark_sparsification_solver to select the solver.",
       common::Processing::Sync);
 }
 
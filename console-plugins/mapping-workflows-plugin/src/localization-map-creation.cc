@@ -11,6 +11,7 @@
 #include <map-sparsification-plugin/keyframe-pruning.h>
 #include <vi-map-helpers/vi-map-landmark-quality-evaluation.h>
 #include <vi-map-helpers/vi-map-manipulation.h>
+#include <vi-map/check-map-consistency.h>
 #include <vi-map/vi-map.h>
 
 DECLARE_uint64(vi_map_landmark_quality_min_observers);
@@ -41,6 +42,10 @@ int processVIMapToLocalizationMap(
   }
   const vi_map::MissionId& mission_id = mission_ids.front();
 
+  // The consistency checks that the steps request are run once when the
+  // workflow returns.
+  vi_map::ScopedDeferredConsistencyCheck consistency_check(*map);
+
   // Initialize landmarks by triangulation.
   if (initialize_landmarks) {
     vi_map_helpers::VIMapManipulation manipulation(map);
@@ -49,6 +54,7 @@ int processVIMapToLocalizationMap(
     landmark_triangulation::retriangulateLandmarksOfMission(mission_id, map);
   }
   CHECK_GT(map->numLandmarks(), 0u);
+  consistency_check.checkpoint("landmark initialization");
 
   // Select keyframes along the mission. Unconditionally add the last vertex as
   // a keyframe if it isn't a keyframe already.
@@ -58,6 +64,7 @@ int processVIMapToLocalizationMap(
     LOG(ERROR) << "Keyframing failed! Aborting.";
     return retval;
   }
+  consistency_check.checkpoint("keyframing");
 
   // Evaluate the quality of landmarks after keyframing the map.
   FLAGS_vi_map_landmark_quality_min_observers = 2;
@@ -81,6 +88,7 @@ int processVIMapToLocalizationMap(
     LOG(ERROR) << "Optimization failed! Aborting.";
     return common::CommandStatus::kUnknownError;
   }
+  consistency_check.checkpoint("the initial optimization");
 
   // Overwrite the number of iterations to a reasonable value.
   // TODO(dymczykm) A temporary solution for the optimization not to take too
@@ -95,6 +103,7 @@ int processVIMapToLocalizationMap(
     LOG(WARNING) << "Pose-graph relaxation failed, but this might be fine if "
                  << "no loopclosures are present in the dataset.";
   }
+  consistency_check.checkpoint("relaxation");
 
   // Loop-close the map.
   loop_closure_plugin::VIMapMerger merger(map, plotter);
@@ -103,6 +112,7 @@ int processVIMapToLocalizationMap(
     LOG(ERROR) << "Loop-closure failed! Aborting.";
     return retval;
   }
+  consistency_check.checkpoint("loop closure");
 
   // Optimize the map.
   success = optimizer.optimizeVisualInertial(
@@ -5,6 +5,13 @@
 #include <aslam/common/statistics/statistics.h>
 #include <aslam/common/timer.h>
 #include <console-common/console.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <maplab-common/tracing.h>
+
+DEFINE_string(
+    trace_file, "maplab_trace.json",
+    "Output file of the recorded trace events in Chrome trace JSON format.");
 
 namespace statistics_plugin {
 
@@ -25,6 +32,49 @@ StatisticsPlugin::StatisticsPlugin(common::Console* console)
         return common::kSuccess;
       },
       "Print statistics.", common::Processing::Sync);
+
+  addCommand(
+      {"trace_start"},
+      []() -> int {
+#ifndef MAPLAB_ENABLE_TRACING
+        LOG(WARNING) << "Tracing is compiled out, rebuild with "
+                     << "-DMAPLAB_ENABLE_TRACING=ON to record trace events.";
+#endif
+        common::tracing::startRecording();
+        return common::kSuccess;
+      },
+      "Start recording trace events of the main processing stages.",
+      common::Processing::Sync);
+
+  addCommand(
+      {"trace_stop"},
+      []() -> int {
+        common::tracing::stopRecording();
+        return common::kSuccess;
+      },
+      "Stop recording trace events.", common::Processing::Sync);
+
+  addCommand(
+      {"trace_save"},
+      []() -> int {
+        LOG(INFO) << "Writing " << common::tracing::getNumRecordedEvents()
+                  << " trace events to " << FLAGS_trace_file << ".";
+        if (!common::tracing::writeChromeTrace(FLAGS_trace_file)) {
+          return common::kUnknownError;
+        }
+        return common::kSuccess;
+      },
+      "Save the recorded trace events as Chrome trace JSON to --trace_file. "
+      "Open it in chrome://tracing or ui.perfetto.dev.",
+      common::Processing::Sync);
+
+  addCommand(
+      {"trace_clear"},
+      []() -> int {
+        common::tracing::clear();
+        return common::kSuccess;
+      },
+      "Drop all recorded trace events.", common::Processing::Sync);
 }
 
 }  // namespace statistics_plugin
@@ -2,10 +2,12 @@
 #define VI_MAP_BASIC_PLUGIN_VI_MAP_BASIC_PLUGIN_H_
 
 #include <string>
+#include <vector>
 
 #include <console-common/console-plugin-base-with-plotter.h>
 #include <console-common/console-plugin-base.h>
 #include <console-common/console.h>
+#include <map-manager/background-map-save.h>
 #include <maplab-common/map-manager-config.h>
 
 namespace visualization {
@@ -13,6 +15,7 @@ class ViwlsGraphRvizPlotter;
 }  // namespace visualization
 
 namespace vi_map {
+class VIMap;
 
 backend::SaveConfig parseSaveConfigFromGFlags();
 
@@ -45,6 +48,8 @@ class VIMapBasicPlugin : public common::ConsolePluginBaseWithPlotter {
   int loadAllMaps();
   int saveMap();
   int saveAllMaps();
+  int saveMapInBackground();
+  int listBackgroundSaves();
 
   int loadMergeMap();
   int loadMergeAllMaps();
@@ -60,6 +65,7 @@ class VIMapBasicPlugin : public common::ConsolePluginBaseWithPlotter {
   int useExternalResourceFolder();
   int printResourceStatistics();
   int printResourceCacheStatistics();
+  int printResourceIoStatistics();
 
   int checkMapConsistency();
 
@@ -76,6 +82,12 @@ class VIMapBasicPlugin : public common::ConsolePluginBaseWithPlotter {
   int spatiallyDistributeMissions();
 
   int convertMapToNewFormat();
+
+  // Removes the finished saves and reports their result.
+  void removeFinishedBackgroundSaves();
+
+  // Saves in progress. Waits for them to finish when the plugin is destroyed.
+  std::vector<backend::BackgroundMapSave<VIMap>::Ptr> background_saves_;
 };
 
 }  // namespace vi_map
@@ -14,6 +14,7 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <map-manager/map-manager.h>
+#include <map-resources/resource-io-statistics.h>
 #include <map-resources/resource-map.h>
 #include <maplab-common/file-system-tools.h>
 #include <maplab-common/map-manager-config.h>
@@ -21,6 +22,7 @@
 #include <vi-map-helpers/mission-clustering-coobservation.h>
 #include <vi-map/check-map-consistency.h>
 #include <vi-map/semantics-manager.h>
+#include <vi-map/vi-map-summary.h>
 #include <vi-map/vi-map.h>
 #include <visualization/sequential-plotter.h>
 #include <visualization/viwls-graph-plotter.h>
@@ -59,6 +61,19 @@ DEFINE_uint64(
     vertices_per_proto_file, 200u,
     "Determines the number of vertices that are stored in one proto file. "
     "NOTE: If this is set too large, the map can't be read anymore.");
+DEFINE_bool(
+    save_only_changes, true,
+    "When saving a map to the folder it has been loaded from, only rewrite "
+    "the map files that changed.");
+DEFINE_string(
+    map_compression, "",
+    "Compression of the saved map files, either \"none\", \"fast\" or "
+    "\"best\". If empty, the files are compressed if "
+    "--proto_use_compression is set.");
+DEFINE_bool(
+    save_frame_arrays_in_sections, false,
+    "Store the keypoints and descriptors of the saved map in memory-mappable "
+    "binary files next to the vertex files, which load much faster.");
 DEFINE_string(
     maps_folder, ".",
     "Folder which contains one or more maps on the filesystem.");
@@ -72,6 +87,13 @@ DEFINE_int32(
 DEFINE_bool(
     spatially_distribute_missions_around_circle, false,
     "Should sdm distribute the missions around a circle.");
+DEFINE_bool(
+    map_stats_memory_usage, true,
+    "Print the estimated memory usage per subsystem in map_stats.");
+DEFINE_bool(
+    resource_io_statistics_per_command, false,
+    "Print the resource loads and stores of every console command that read "
+    "or wrote resources.");
 
 namespace vi_map {
 
@@ -115,6 +137,22 @@ backend::SaveConfig parseSaveConfigFromGFlags() {
   config.vertices_per_proto_file = FLAGS_vertices_per_proto_file;
   static constexpr size_t kMaxVerticesPerProtoFile = 300u;
   CHECK_LE(config.vertices_per_proto_file, kMaxVerticesPerProtoFile);
+  config.save_only_changes = FLAGS_save_only_changes;
+  config.store_frame_arrays_in_sections = FLAGS_save_frame_arrays_in_sections;
+
+  if (FLAGS_map_compression == "none") {
+    config.proto_compression = backend::SaveConfig::ProtoCompression::kNone;
+  } else if (FLAGS_map_compression == "fast") {
+    config.proto_compression = backend::SaveConfig::ProtoCompression::kFast;
+  } else if (FLAGS_map_compression == "best") {
+    config.proto_compression = backend::SaveConfig::ProtoCompression::kBest;
+  } else {
+    LOG_IF(WARNING, !FLAGS_map_compression.empty())
+        << "Unknown map compression \"" << FLAGS_map_compression
+        << "\", using --proto_use_compression instead.";
+    config.proto_compression =
+        backend::SaveConfig::ProtoCompression::kFromFlags;
+  }
 
   return config;
 }
@@ -122,6 +160,30 @@ backend::SaveConfig parseSaveConfigFromGFlags() {
 VIMapBasicPlugin::VIMapBasicPlugin(
     common::Console* console, visualization::ViwlsGraphRvizPlotter* plotter)
     : common::ConsolePluginBaseWithPlotter(CHECK_NOTNULL(console), plotter) {
+  // The resource I/O of a command is the difference of the process-wide
+  // statistic before and after it.
+  std::shared_ptr<backend::ResourceIoStatistic> statistic_before_command =
+      std::make_shared<backend::ResourceIoStatistic>();
+  console->addCommandHooks(
+      [statistic_before_command](const std::string& /*command_name*/) {
+        if (FLAGS_resource_io_statistics_per_command) {
+          *statistic_before_command =
+              backend::ResourceIoStatistics::getStatistic();
+        }
+      },
+      [statistic_before_command](const std::string& command_name) {
+        if (!FLAGS_resource_io_statistics_per_command) {
+          return;
+        }
+        const backend::ResourceIoStatistic statistic_of_command =
+            backend::ResourceIoStatistics::getStatistic().getDifference(
+                *statistic_before_command);
+        if (!statistic_of_command.empty()) {
+          std::cout << command_name << ": " << statistic_of_command.print()
+                    << std::endl;
+        }
+      });
+
   // General commands.
   addCommand(
       {"select_map", "select"}, [this]() -> int { return selectMap(); },
@@ -133,7 +195,8 @@ VIMapBasicPlugin::VIMapBasicPlugin(
   addCommand(
       {"list_maps_on_file_system"},
       [this]() -> int { return listMapsOnFileSystem(); },
-      "List all maps found on the file system in the given folder."
+      "List all maps found on the file system in the given folder, with the "
+      "summary of their missions if they have one. "
       "Usage: list_maps_on_file_system [--maps_folder=<path>]. ",
       common::Processing::Sync);
 
@@ -207,6 +270,24 @@ VIMapBasicPlugin::VIMapBasicPlugin(
       "map will be saved in the map folder (defined by the map metadata).",
       common::Processing::Sync);
 
+  addCommand(
+      {"save_in_background", "bsave"},
+      [this]() -> int { return saveMapInBackground(); },
+      "Saves a snapshot of the selected map on a background thread, the map "
+      "can be used while it is being saved. Usage: save_in_background "
+      "[--overwrite] [--map_folder=<path>] "
+      "[--copy_resources_to_map_folder=<true/false> / "
+      "--copy_resources_to_external_folder=<path>]. If --map_folder isn't "
+      "specified, the map will be saved in the map folder (defined by the map "
+      "metadata). Resources can't be moved.",
+      common::Processing::Sync);
+  addCommand(
+      {"list_background_saves"},
+      [this]() -> int { return listBackgroundSaves(); },
+      "Lists the saves running in the background and reports the finished "
+      "ones.",
+      common::Processing::Sync);
+
   addCommand(
       {"load_merge_map"}, [this]() -> int { return loadMergeMap(); },
       "Loads the map from the given path and merges the map with the currently "
@@ -270,6 +351,13 @@ VIMapBasicPlugin::VIMapBasicPlugin(
       [this]() -> int { return printResourceCacheStatistics(); },
       "Prints resource cache statistics for the selected map.",
       common::Processing::Sync);
+  addCommand(
+      {"resource_io_statistics", "res_io_stats"},
+      [this]() -> int { return printResourceIoStatistics(); },
+      "Prints the resource loads and stores from and to disk of all maps since "
+      "the console was started. Set --resource_io_statistics_per_command to "
+      "print them after every command.",
+      common::Processing::Sync);
 
   addCommand(
       {"check_map_consistency"},
@@ -558,19 +646,12 @@ int VIMapBasicPlugin::joinAllMaps() {
   const std::string& base_map_key = all_current_map_keys.front();
   VLOG(1) << "Selected \"" << base_map_key << "\" as base map for merging.";
 
-  vi_map::VIMapManager::MapWriteAccess base_map =
-      map_manager.getMapWriteAccess(base_map_key);
-
-  // Merge all other maps into base maps and delete them.
+  // Merge all other maps into base maps and delete them. Their data is moved
+  // rather than copied.
   for (std::vector<std::string>::const_iterator it_map_keys =
            all_current_map_keys.cbegin() + 1;
        it_map_keys != all_current_map_keys.cend(); ++it_map_keys) {
-    {
-      vi_map::VIMapManager::MapReadAccess map_to_be_merged =
-          map_manager.getMapReadAccess(*it_map_keys);
-      base_map->mergeAllMissionsFromMap(*map_to_be_merged);
-    }
-    map_manager.deleteMap(*it_map_keys);
+    map_manager.mergeAndDeleteMap(base_map_key, *it_map_keys);
     console_->removeMapKeyFromAutoCompletion(*it_map_keys);
     CHECK(!map_manager.hasMap(*it_map_keys));
     LOG(INFO) << "Merging \"" << *it_map_keys << "\" into \"" << base_map_key
@@ -613,9 +694,17 @@ int VIMapBasicPlugin::listMapsOnFileSystem() {
   } else {
     LOG(INFO) << "Found the following (" << map_keys.size()
               << ") map(s) in folder " << maps_folder << ':';
-    for (const std::string& map_key : map_keys) {
+    CHECK_EQ(map_list.size(), map_keys.size());
+    for (size_t map_idx = 0u; map_idx < map_keys.size(); ++map_idx) {
       LOG(INFO) << "\t - Default key: "
-                << common::formatText(map_key, common::FormatOptions::kBold);
+                << common::formatText(
+                       map_keys[map_idx], common::FormatOptions::kBold);
+      // The summary is only available for maps saved with a summary file.
+      vi_map::proto::MapSummary summary;
+      if (vi_map::serialization::loadMapSummaryFromFolder(
+              map_list[map_idx], &summary)) {
+        LOG(INFO) << vi_map::serialization::printMapSummary(summary);
+      }
     }
   }
 
@@ -745,18 +834,11 @@ int VIMapBasicPlugin::loadMergeAllMaps() {
   VLOG(1) << "Using \"" << selected_map_key
           << "\" as the base for future merge operations.";
 
-  vi_map::VIMapManager::MapWriteAccess base_map =
-      map_manager.getMapWriteAccess(selected_map_key);
-  for (const std::string& loaded_key : loaded_keys) {
-    {
-      vi_map::VIMapManager::MapReadAccess map_to_be_merged =
-          map_manager.getMapReadAccess(loaded_key);
-      base_map->mergeAllMissionsFromMap(*map_to_be_merged);
-    }
-    map_manager.deleteMap(loaded_key);
-    VLOG(1) << "Merging \"" << loaded_key << "\" into \"" << selected_map_key
-            << "\".";
-  }
+  const std::vector<std::string> keys_to_merge(
+      loaded_keys.begin(), loaded_keys.end());
+  VLOG(1) << "Merging " << keys_to_merge.size() << " maps into \""
+          << selected_map_key << "\".";
+  map_manager.mergeAndDeleteMaps(selected_map_key, keys_to_merge);
 
   LOG(INFO) << "Merged " << loaded_keys.size() << " maps into \""
             << selected_map_key << "\".";
@@ -835,6 +917,87 @@ int VIMapBasicPlugin::saveAllMaps() {
   return common::kSuccess;
 }
 
+int VIMapBasicPlugin::saveMapInBackground() {
+  std::string selected_map_key;
+  if (!getSelectedMapKeyIfSet(&selected_map_key)) {
+    return common::kStupidUserError;
+  }
+  removeFinishedBackgroundSaves();
+
+  vi_map::VIMapManager map_manager;
+  std::string map_folder = FLAGS_map_folder;
+  if (map_folder.empty()) {
+    const vi_map::VIMapManager::MapReadAccess map =
+        map_manager.getMapReadAccess(selected_map_key);
+    if (!map->hasMapFolder()) {
+      LOG(ERROR) << "Selected map doesn't have a map folder. Please use "
+                 << "\"set_map_folder --map_folder=<path>\" or "
+                 << "\"save_in_background --map_folder=<path>\" to set the "
+                 << "map folder.";
+      return common::kStupidUserError;
+    }
+    map->getMapFolder(&map_folder);
+  }
+
+  for (const backend::BackgroundMapSave<VIMap>::Ptr& background_save :
+       background_saves_) {
+    if (background_save->getFolderPath() == map_folder) {
+      LOG(ERROR) << "A map is already being saved to " << map_folder
+                 << ". Wait for it to finish, see list_background_saves.";
+      return common::kStupidUserError;
+    }
+  }
+
+  backend::BackgroundMapSave<VIMap>::Ptr background_save =
+      map_manager.saveMapToFolderInBackground(
+          selected_map_key, map_folder, parseSaveConfigFromGFlags());
+  if (!background_save) {
+    return common::kUnknownError;
+  }
+  background_saves_.emplace_back(background_save);
+  LOG(INFO) << "Saving map \"" << selected_map_key << "\" to " << map_folder
+            << " in the background.";
+  return common::kSuccess;
+}
+
+int VIMapBasicPlugin::listBackgroundSaves() {
+  for (const backend::BackgroundMapSave<VIMap>::Ptr& background_save :
+       background_saves_) {
+    if (!background_save->isDone()) {
+      std::cout << "Saving map \"" << background_save->getMapKey() << "\" to "
+                << background_save->getFolderPath() << " since "
+                << background_save->getElapsedSeconds() << " s." << std::endl;
+    }
+  }
+  removeFinishedBackgroundSaves();
+  if (background_saves_.empty()) {
+    std::cout << "No saves are running in the background." << std::endl;
+  }
+  return common::kSuccess;
+}
+
+void VIMapBasicPlugin::removeFinishedBackgroundSaves() {
+  std::vector<backend::BackgroundMapSave<VIMap>::Ptr> running_saves;
+  for (const backend::BackgroundMapSave<VIMap>::Ptr& background_save :
+       background_saves_) {
+    if (!background_save->isDone()) {
+      running_saves.emplace_back(background_save);
+      continue;
+    }
+    // The save has logged the result already.
+    if (background_save->wait()) {
+      std::cout << "Finished saving map \"" << background_save->getMapKey()
+                << "\" to " << background_save->getFolderPath() << " in "
+                << background_save->getElapsedSeconds() << " s." << std::endl;
+    } else {
+      std::cout << "Failed to save map \"" << background_save->getMapKey()
+                << "\" to " << background_save->getFolderPath() << "."
+                << std::endl;
+    }
+  }
+  background_saves_.swap(running_saves);
+}
+
 int VIMapBasicPlugin::getMapFolder() {
   std::string selected_map_key;
   if (!getSelectedMapKeyIfSet(&selected_map_key)) {
@@ -1027,6 +1190,12 @@ int VIMapBasicPlugin::printResourceCacheStatistics() {
   return common::kSuccess;
 }
 
+int VIMapBasicPlugin::printResourceIoStatistics() {
+  std::cout << backend::ResourceIoStatistics::getStatistic().print()
+            << std::endl;
+  return common::kSuccess;
+}
+
 int VIMapBasicPlugin::checkMapConsistency() {
   std::string selected_map_key;
   if (!getSelectedMapKeyIfSet(&selected_map_key)) {
@@ -1053,6 +1222,9 @@ int VIMapBasicPlugin::mapStatistics() {
   if (map->numMissions() > 1u) {
     std::cout << map->printMapAccumulatedStatistics() << std::endl;
   }
+  if (FLAGS_map_stats_memory_usage) {
+    std::cout << map->printMapMemoryUsage() << std::endl;
+  }
 
   return common::kSuccess;
 }
@@ -1383,6 +1555,9 @@ int VIMapBasicPlugin::visualizeMap() {
   const vi_map::VIMapManager map_manager;
   vi_map::VIMapManager::MapReadAccess map =
       map_manager.getMapReadAccess(selected_map_key);
+  // An explicit visualization republishes everything, e.g. for a restarted
+  // RViz.
+  plotter_->resetPublishedMissions();
   plotter_->visualizeMap(*map);
 
   return common::kSuccess;
@@ -2,10 +2,12 @@
 #define VI_MAP_DATA_IMPORT_EXPORT_PLUGIN_IMPORT_EXPORT_GPS_DATA_INL_H_
 
 #include <string>
+#include <vector>
 
 #include <aslam/common/time.h>
 #include <glog/logging.h>
 #include <maplab-common/file-logger.h>
+#include <sensors/measurement-time-series.h>
 #include <vi-map/vi-map.h>
 
 namespace data_import_export {
@@ -69,9 +71,9 @@ void exportGpsDataMatchedToVerticesToCsv(
 
     const vi_map::SensorId& gps_sensor_id = *gps_sensor_ids.begin();
     CHECK(gps_sensor_id.isValid());
-    const vi_map::MeasurementBuffer<GpsMeasurement>& gps_utm_measurements =
+    const vi_map::MeasurementTimeSeries<GpsMeasurement> gps_measurements(
         map.getOptionalSensorMeasurements<GpsMeasurement>(
-            gps_sensor_id, mission_id);
+            gps_sensor_id, mission_id));
 
     VLOG(1) << "Exporting GPS UTM measurements of mission "
             << mission_id.hexString() << '.';
@@ -79,14 +81,31 @@ void exportGpsDataMatchedToVerticesToCsv(
     pose_graph::VertexIdList vertex_ids;
     map.getAllVertexIdsInMissionAlongGraph(mission_id, &vertex_ids);
 
+    // The vertex timestamps along the graph are sorted, so that all of them
+    // are matched in one sweep through the measurements.
+    std::vector<int64_t> vertex_timestamps_nanoseconds;
+    vertex_timestamps_nanoseconds.reserve(vertex_ids.size());
     for (const pose_graph::VertexId& vertex_id : vertex_ids) {
       CHECK(vertex_id.isValid());
+      vertex_timestamps_nanoseconds.push_back(
+          map.getVertex(vertex_id).getMinTimestampNanoseconds());
+    }
+    constexpr int64_t kNoMaxDelta = -1;
+    std::vector<size_t> measurement_indices;
+    gps_measurements.getNearestIndices(
+        vertex_timestamps_nanoseconds, kNoMaxDelta, &measurement_indices);
+
+    for (size_t vertex_idx = 0u; vertex_idx < vertex_ids.size();
+         ++vertex_idx) {
+      const pose_graph::VertexId& vertex_id = vertex_ids[vertex_idx];
       const int64_t timestamp_nanosecond =
-          map.getVertex(vertex_id).getMinTimestampNanoseconds();
+          vertex_timestamps_nanoseconds[vertex_idx];
+      const size_t measurement_idx = measurement_indices[vertex_idx];
 
-      GpsMeasurement gps_measurement;
-      if (gps_utm_measurements.getNearestValueToTime(
-              timestamp_nanosecond, &gps_measurement)) {
+      if (measurement_idx !=
+          vi_map::MeasurementTimeSeries<GpsMeasurement>::kInvalidIndex) {
+        const GpsMeasurement& gps_measurement =
+            gps_measurements.getMeasurement(measurement_idx);
         if (std::abs(
                 gps_measurement.getTimestampNanoseconds() -
                 timestamp_nanosecond) > kTimestampToleranceNanoseconds) {
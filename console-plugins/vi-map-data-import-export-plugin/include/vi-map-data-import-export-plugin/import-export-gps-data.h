@@ -2,16 +2,35 @@
 #define VI_MAP_DATA_IMPORT_EXPORT_PLUGIN_IMPORT_EXPORT_GPS_DATA_H_
 
 #include <string>
+#include <vector>
 
 #include <vi-map/vi-map.h>
 
 namespace data_import_export {
 
+// A rosbag topic and the YAML file of the sensor that recorded it.
+struct OptionalSensorTopic {
+  OptionalSensorTopic(
+      const std::string& _topic, const std::string& _sensor_yaml)
+      : topic(_topic), sensor_yaml(_sensor_yaml) {}
+  std::string topic;
+  std::string sensor_yaml;
+};
+
 void importGpsDataFromRosbag(
     const std::string& bag_filename, const std::string& gps_topic,
     const std::string& gps_yaml, const vi_map::MissionId& mission_id,
     vi_map::VIMap* map);
 
+// Imports the measurements of all topics in a single pass over the bag. The
+// messages are demultiplexed by topic and added to the optional sensor data
+// of the mission in batches. Replaces the measurements of previous imports
+// of the same sensors. Supports GPS UTM and WGS sensors.
+void importOptionalSensorDataFromRosbag(
+    const std::string& bag_filename,
+    const std::vector<OptionalSensorTopic>& sensor_topics,
+    const vi_map::MissionId& mission_id, vi_map::VIMap* map);
+
 template <typename GpsMeasurement>
 void exportGpsDataMatchedToVerticesToCsv(
     const vi_map::VIMap& map, const std::string& csv_filename);
@@ -1,8 +1,12 @@
 #include "vi-map-data-import-export-plugin/data-import-export-plugin.h"
 
+#include <string>
+#include <vector>
+
 #include <console-common/console.h>
 #include <csv-export/csv-export.h>
 #include <map-manager/map-manager.h>
+#include <maplab-common/string-tools.h>
 #include <vi-map-data-import-export-plugin/export-sensors.h>
 #include <vi-map/vi-map.h>
 #include "vi-map-data-import-export-plugin/export-ncamera-calibration.h"
@@ -13,6 +17,10 @@ DECLARE_string(map_mission);
 
 DEFINE_string(csv_export_path, "", "Path to save the map in CSV format into.");
 
+DEFINE_string(
+    columnar_export_path, "",
+    "Path to save the map in the binary columnar format into.");
+
 DEFINE_string(
     ncamera_calibration_export_folder, "",
     "Folder to export the ncamera calibration into.");
@@ -24,11 +32,14 @@ DEFINE_string(pose_export_file, "", "File to export poses to.");
 DEFINE_string(bag_file, "", "Bag file to import data from.");
 
 DEFINE_string(
-    gps_topic, "", "The topic name for importing GPS/UTM data from a rosbag.");
+    gps_topic, "",
+    "The topic name for importing GPS/UTM data from a rosbag. Several topics "
+    "can be imported in one pass over the bag as comma-separated list.");
 
 DEFINE_string(
     gps_yaml, "",
-    "The GPS sensor YAML file containing ID, type and calibration parameters.");
+    "The GPS sensor YAML file containing ID, type and calibration parameters. "
+    "Takes a comma-separated list with one file per topic of --gps_topic.");
 
 namespace data_import_export {
 
@@ -60,6 +71,32 @@ DataImportExportPlugin::DataImportExportPlugin(common::Console* console)
       "files in a folder specified by --csv_export_path. Check the "
       "documentation for information on the CSV format.",
       common::Processing::Sync);
+  addCommand(
+      {"columnar_export"},
+      [this]() -> int {
+        std::string selected_map_key;
+        if (!getSelectedMapKeyIfSet(&selected_map_key)) {
+          return common::kStupidUserError;
+        }
+
+        vi_map::VIMapManager map_manager;
+        vi_map::VIMapManager::MapReadAccess map =
+            map_manager.getMapReadAccess(selected_map_key);
+        const std::string& save_path = FLAGS_columnar_export_path;
+        if (save_path.empty()) {
+          LOG(ERROR) << "No path to export the columnar tables into has been "
+                        "specified. Please specify using the "
+                        "--columnar_export_path flag.";
+          return common::kStupidUserError;
+        }
+
+        csv_export::exportMapToColumnarBinary(*map, save_path);
+        return common::kSuccess;
+      },
+      "Exports the same tables as csv_export into a folder specified by "
+      "--columnar_export_path, with one raw binary file per column that can "
+      "be read without parsing.",
+      common::Processing::Sync);
   addCommand(
       {"export_trajectory_to_csv", "ettc"},
       [this]() -> int { return exportPosesVelocitiesAndBiasesToCsv(); },
@@ -86,7 +123,7 @@ DataImportExportPlugin::DataImportExportPlugin(common::Console* console)
       [this]() -> int { return importGpsDataFromRosbag(); },
       "Imports GPS (UTM, WGS) data from the rosbag specified with --bag_file. "
       "The topic can be specified with --gps_topic and the YAML file with "
-      "--gps_yaml.",
+      "--gps_yaml. Several topics are imported in a single pass over the bag.",
       common::Processing::Sync);
 
   addCommand(
@@ -200,27 +237,40 @@ int DataImportExportPlugin::importGpsDataFromRosbag() const {
     return common::kStupidUserError;
   }
 
-  const std::string& gps_topic = FLAGS_gps_topic;
-  if (gps_topic.empty()) {
+  constexpr bool kRemoveEmpty = true;
+  std::vector<std::string> gps_topics;
+  common::tokenizeString(FLAGS_gps_topic, ',', kRemoveEmpty, &gps_topics);
+  if (gps_topics.empty()) {
     LOG(ERROR) << "GPS topic is empty. Please specify "
                << "valid GPS topic with --gps_topic.";
     return common::kStupidUserError;
   }
 
-  const std::string& gps_yaml = FLAGS_gps_yaml;
-  if (gps_yaml.empty()) {
+  std::vector<std::string> gps_yamls;
+  common::tokenizeString(FLAGS_gps_yaml, ',', kRemoveEmpty, &gps_yamls);
+  if (gps_yamls.empty()) {
     LOG(ERROR) << "The specified GPS YAML file parameter is empty. "
                << "Please specify a valid yaml file with --gps_yaml.";
     return common::kStupidUserError;
   }
 
-  if (!common::fileExists(gps_yaml)) {
-    LOG(ERROR) << "The specified GPS YAML file does not "
-               << "exist on the file-system. Please point to an existing YAML "
-               << "file with --gps_yaml.";
+  if (gps_yamls.size() != gps_topics.size()) {
+    LOG(ERROR) << "Please specify one GPS YAML file with --gps_yaml for each "
+               << "topic of --gps_topic.";
     return common::kStupidUserError;
   }
 
+  std::vector<OptionalSensorTopic> sensor_topics;
+  for (size_t idx = 0u; idx < gps_topics.size(); ++idx) {
+    if (!common::fileExists(gps_yamls[idx])) {
+      LOG(ERROR) << "The specified GPS YAML file " << gps_yamls[idx]
+                 << " does not exist on the file-system. Please point to an "
+                 << "existing YAML file with --gps_yaml.";
+      return common::kStupidUserError;
+    }
+    sensor_topics.emplace_back(gps_topics[idx], gps_yamls[idx]);
+  }
+
   std::string selected_map_key;
   if (!getSelectedMapKeyIfSet(&selected_map_key)) {
     return common::kStupidUserError;
@@ -252,8 +302,8 @@ int DataImportExportPlugin::importGpsDataFromRosbag() const {
     map->ensureMissionIdValid(FLAGS_map_mission, &mission_id);
   }
   CHECK(mission_id.isValid());
-  data_import_export::importGpsDataFromRosbag(
-      bag_file, gps_topic, gps_yaml, mission_id, map.get());
+  data_import_export::importOptionalSensorDataFromRosbag(
+      bag_file, sensor_topics, mission_id, map.get());
 
   return common::kSuccess;
 }
@@ -1,7 +1,13 @@
 #include "vi-map-data-import-export-plugin/import-export-gps-data.h"
 
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <aslam/common/memory.h>
 #include <aslam/common/time.h>
 #include <glog/logging.h>
+#include <maplab-common/accessors.h>
 #include <maplab-common/progress-bar.h>
 #include <nav_msgs/Odometry.h>
 #include <rosbag/bag.h>
@@ -17,10 +23,14 @@ inline int64_t rosTimeToNanoseconds(const ros::Time& rostime) {
          static_cast<int64_t>(rostime.nsec);
 }
 
+namespace {
+// Number of measurements of a sensor that are added to the map at once.
+constexpr size_t kNumMeasurementsPerBatch = 1000u;
+
 bool processGpsWgsMeasurement(
     const rosbag::MessageInstance& message, const vi_map::SensorId& sensor_id,
-    vi_map::OptionalSensorData* const optional_sensor_data) {
-  CHECK_NOTNULL(optional_sensor_data);
+    Aligned<std::vector, vi_map::GpsWgsMeasurement>* measurements) {
+  CHECK_NOTNULL(measurements);
   sensor_msgs::NavSatFixConstPtr gps_wgs_message =
       message.instantiate<sensor_msgs::NavSatFix>();
   if (!gps_wgs_message) {
@@ -31,20 +41,18 @@ bool processGpsWgsMeasurement(
     return false;
   }
 
-  const vi_map::GpsWgsMeasurement gps_wgs_measurement(
+  measurements->emplace_back(
       sensor_id, rosTimeToNanoseconds(gps_wgs_message->header.stamp),
       gps_wgs_message->latitude, gps_wgs_message->longitude,
       gps_wgs_message->altitude);
 
-  optional_sensor_data->addMeasurement(gps_wgs_measurement);
-
   return true;
 }
 
 bool processGpsUtmMeasurement(
     const rosbag::MessageInstance& message, const vi_map::SensorId& sensor_id,
-    vi_map::OptionalSensorData* const optional_sensor_data) {
-  CHECK_NOTNULL(optional_sensor_data);
+    Aligned<std::vector, vi_map::GpsUtmMeasurement>* measurements) {
+  CHECK_NOTNULL(measurements);
 
   nav_msgs::OdometryConstPtr gps_utm_message =
       message.instantiate<nav_msgs::Odometry>();
@@ -66,15 +74,54 @@ bool processGpsUtmMeasurement(
       gps_utm_message->pose.pose.position.y,
       gps_utm_message->pose.pose.position.z);
 
-  const vi_map::GpsUtmMeasurement gps_utm_measurement(
+  measurements->emplace_back(
       sensor_id, rosTimeToNanoseconds(gps_utm_message->header.stamp),
       aslam::Transformation(q_R_S, p_R_S), vi_map::UtmZone::createInvalid());
 
-  optional_sensor_data->addMeasurement(gps_utm_measurement);
-
   return true;
 }
 
+// Collects the measurements of one topic and adds them to the map in
+// batches.
+struct OptionalSensorTopicImport {
+  std::string topic;
+  vi_map::SensorId sensor_id;
+  vi_map::SensorType sensor_type;
+  Aligned<std::vector, vi_map::GpsUtmMeasurement> gps_utm_measurements;
+  Aligned<std::vector, vi_map::GpsWgsMeasurement> gps_wgs_measurements;
+  size_t num_added;
+  bool failed;
+
+  bool processMessage(const rosbag::MessageInstance& message) {
+    switch (sensor_type) {
+      case vi_map::SensorType::kGpsWgs:
+        return processGpsWgsMeasurement(
+            message, sensor_id, &gps_wgs_measurements);
+      case vi_map::SensorType::kGpsUtm:
+        return processGpsUtmMeasurement(
+            message, sensor_id, &gps_utm_measurements);
+      default:
+        LOG(FATAL) << "Unsupported sensor type.";
+    }
+    return false;
+  }
+
+  size_t numPendingMeasurements() const {
+    return gps_utm_measurements.size() + gps_wgs_measurements.size();
+  }
+
+  void addPendingMeasurements(
+      vi_map::OptionalSensorData* optional_sensor_data) {
+    CHECK_NOTNULL(optional_sensor_data);
+    num_added += numPendingMeasurements();
+    optional_sensor_data->addMeasurements(gps_utm_measurements);
+    optional_sensor_data->addMeasurements(gps_wgs_measurements);
+    gps_utm_measurements.clear();
+    gps_wgs_measurements.clear();
+  }
+};
+}  // namespace
+
 template <>
 void getCsvHeaderLine<vi_map::GpsUtmMeasurement>(std::string* csv_header_line) {
   CHECK_NOTNULL(csv_header_line)->clear();
@@ -128,10 +175,18 @@ void importGpsDataFromRosbag(
     const std::string& bag_filename, const std::string& gps_topic,
     const std::string& gps_yaml, const vi_map::MissionId& mission_id,
     vi_map::VIMap* map) {
+  importOptionalSensorDataFromRosbag(
+      bag_filename, {OptionalSensorTopic(gps_topic, gps_yaml)}, mission_id,
+      map);
+}
+
+void importOptionalSensorDataFromRosbag(
+    const std::string& bag_filename,
+    const std::vector<OptionalSensorTopic>& sensor_topics,
+    const vi_map::MissionId& mission_id, vi_map::VIMap* map) {
   CHECK_NOTNULL(map);
   CHECK(map->hasMission(mission_id));
-  CHECK(common::fileExists(gps_yaml));
-  CHECK(!gps_topic.empty());
+  CHECK(!sensor_topics.empty());
 
   rosbag::Bag bag;
 
@@ -143,62 +198,89 @@ void importGpsDataFromRosbag(
                << bag_exception.what();
   }
 
+  vi_map::OptionalSensorData& optional_sensor_data =
+      map->getOptionalSensorData(mission_id);
+
   std::vector<std::string> topics;
-  topics.emplace_back(gps_topic);
-
-  vi_map::Sensor::UniquePtr sensor = vi_map::createSensorFromYaml(gps_yaml);
-  CHECK(sensor);
-  const vi_map::SensorType sensor_type = sensor->getSensorType();
-  CHECK(
-      sensor_type == vi_map::SensorType::kGpsUtm ||
-      sensor_type == vi_map::SensorType::kGpsWgs);
-  const vi_map::SensorId gps_sensor_id = sensor->getId();
-  CHECK(gps_sensor_id.isValid());
-  map->getSensorManager().addSensor(std::move(sensor), mission_id);
+  std::vector<OptionalSensorTopicImport> imports(sensor_topics.size());
+  std::unordered_map<std::string, OptionalSensorTopicImport*> topic_to_import;
+  for (size_t idx = 0u; idx < sensor_topics.size(); ++idx) {
+    const OptionalSensorTopic& sensor_topic = sensor_topics[idx];
+    CHECK(!sensor_topic.topic.empty());
+    CHECK(common::fileExists(sensor_topic.sensor_yaml));
+
+    vi_map::Sensor::UniquePtr sensor =
+        vi_map::createSensorFromYaml(sensor_topic.sensor_yaml);
+    CHECK(sensor);
+    OptionalSensorTopicImport& topic_import = imports[idx];
+    topic_import.topic = sensor_topic.topic;
+    topic_import.sensor_type = sensor->getSensorType();
+    topic_import.sensor_id = sensor->getId();
+    topic_import.num_added = 0u;
+    topic_import.failed = false;
+    CHECK(
+        topic_import.sensor_type == vi_map::SensorType::kGpsUtm ||
+        topic_import.sensor_type == vi_map::SensorType::kGpsWgs)
+        << "Unsupported sensor type in " << sensor_topic.sensor_yaml << ".";
+    CHECK(topic_import.sensor_id.isValid());
+    map->getSensorManager().addSensor(std::move(sensor), mission_id);
+
+    // Replaces the measurements of a previous import of the sensor.
+    if (topic_import.sensor_type == vi_map::SensorType::kGpsWgs) {
+      if (optional_sensor_data.hasMeasurements<vi_map::GpsWgsMeasurement>(
+              topic_import.sensor_id)) {
+        optional_sensor_data.clear<vi_map::GpsWgsMeasurement>(
+            topic_import.sensor_id);
+      }
+    } else if (optional_sensor_data
+                   .hasMeasurements<vi_map::GpsUtmMeasurement>(
+                       topic_import.sensor_id)) {
+      optional_sensor_data.clear<vi_map::GpsUtmMeasurement>(
+          topic_import.sensor_id);
+    }
+
+    CHECK(topic_to_import.emplace(sensor_topic.topic, &topic_import).second)
+        << "The topic " << sensor_topic.topic << " is imported twice.";
+    topics.emplace_back(sensor_topic.topic);
+  }
 
+  // A single pass over the bag, the messages are demultiplexed by topic.
   rosbag::View view(bag, rosbag::TopicQuery(topics));
 
   const size_t num_messages = view.size();
   if (num_messages == 0u) {
+    std::string selected_topics;
+    for (const std::string& topic : topics) {
+      selected_topics += " " + topic;
+    }
     LOG(ERROR) << "The bag view contains zero messages. "
-               << "Selected GPS topic: " << gps_topic;
+               << "Selected topics:" << selected_topics;
     return;
   }
 
-  vi_map::OptionalSensorData& optional_sensor_data =
-      map->getOptionalSensorData(mission_id);
-
-  std::function<bool(
-      const rosbag::MessageInstance& message, const vi_map::SensorId& sensor_id,
-      vi_map::OptionalSensorData* optional_sensor_data)>
-      process_gps_measurement;
-
-  switch (sensor_type) {
-    case vi_map::SensorType::kGpsWgs:
-      process_gps_measurement = &processGpsWgsMeasurement;
-      optional_sensor_data.clear<vi_map::GpsWgsMeasurement>(gps_sensor_id);
-      break;
-    case vi_map::SensorType::kGpsUtm:
-      process_gps_measurement = &processGpsUtmMeasurement;
-      optional_sensor_data.clear<vi_map::GpsUtmMeasurement>(gps_sensor_id);
-      break;
-    default:
-      LOG(ERROR) << "Unknown sensor type in GPS YAML file.";
-      return;
-  }
-
   common::ProgressBar progress_bar(num_messages);
-  size_t num_added = 0u;
-  for (rosbag::MessageInstance& message : view) {
-    CHECK_EQ(message.getTopic(), gps_topic);
-    if (!process_gps_measurement(
-            message, gps_sensor_id, &optional_sensor_data)) {
-      LOG(ERROR) << "Unable to process message. Aborting. Added " << num_added
-                 << " GPS measurements.";
-      break;
-    }
-    ++num_added;
+  for (const rosbag::MessageInstance& message : view) {
     progress_bar.increment();
+    OptionalSensorTopicImport& topic_import =
+        *common::getChecked(topic_to_import, message.getTopic());
+    if (topic_import.failed) {
+      continue;
+    }
+    if (!topic_import.processMessage(message)) {
+      LOG(ERROR) << "Unable to process message of topic " << topic_import.topic
+                 << ". Skipping the remaining messages of the topic.";
+      topic_import.failed = true;
+      continue;
+    }
+    if (topic_import.numPendingMeasurements() >= kNumMeasurementsPerBatch) {
+      topic_import.addPendingMeasurements(&optional_sensor_data);
+    }
+  }
+
+  for (OptionalSensorTopicImport& topic_import : imports) {
+    topic_import.addPendingMeasurements(&optional_sensor_data);
+    LOG(INFO) << "Added " << topic_import.num_added
+              << " measurements of topic " << topic_import.topic << ".";
   }
 }
 
@@ -19,6 +19,7 @@ class SummarizationPlugin : public common::ConsolePluginBase {
 
  private:
   int saveSummaryMapToDisk() const;
+  int appendMissionsToSummaryMapOnDisk() const;
 };
 
 }  // namespace summarization_plugin
@@ -1,14 +1,23 @@
 #include "vi-map-summarization-plugin/summarization-plugin.h"
 
+#include <memory>
+
 #include <console-common/console.h>
 #include <localization-summary-map/localization-summary-map-creation.h>
 #include <localization-summary-map/localization-summary-map.h>
+#include <localization-summary-map/projected-descriptor-cache.h>
+#include <localization-summary-map/tiled-localization-summary-map.h>
 #include <map-manager/map-manager.h>
 #include <maplab-common/file-system-tools.h>
 #include <vi-map/vi-map.h>
 
 DEFINE_string(summary_map_save_path, "", "Save path of the summary map.");
+DEFINE_double(
+    summary_map_tile_size_m, 0.0,
+    "If positive, the summary map is saved as square tiles of this size in "
+    "the x-y plane, which ROVIOLI loads on demand around its position.");
 DECLARE_bool(overwrite);
+DECLARE_string(map_mission_list);
 
 namespace summarization_plugin {
 
@@ -20,6 +29,15 @@ SummarizationPlugin::SummarizationPlugin(common::Console* console)
       "Generate a summary map of the selected map and save it to the path "
       "given by --summary_map_save_path.",
       common::Processing::Sync);
+  addCommand(
+      {"append_missions_to_summary_map_on_disk", "append_summary_map"},
+      [this]() -> int { return appendMissionsToSummaryMapOnDisk(); },
+      "Append the well constrained landmarks of the missions given by "
+      "--map_mission_list of the selected map to the summary map at "
+      "--summary_map_save_path, e.g. after a new mission has been added to "
+      "the map. Only the new landmarks are projected, the existing ones are "
+      "kept as they are. Tiled summary maps are not supported.",
+      common::Processing::Sync);
 }
 
 int SummarizationPlugin::saveSummaryMapToDisk() const {
@@ -35,14 +53,106 @@ int SummarizationPlugin::saveSummaryMapToDisk() const {
   }
 
   vi_map::VIMapManager map_manager;
-  vi_map::VIMapManager::MapReadAccess map =
-      map_manager.getMapReadAccess(selected_map_key);
   summary_map::LocalizationSummaryMap summary_map;
-  summary_map::createLocalizationSummaryMapForWellConstrainedLandmarks(
-      *map, &summary_map);
+  if (FLAGS_lc_use_projected_descriptor_cache) {
+    // The projected descriptors are stored back into the map.
+    vi_map::VIMapManager::MapWriteAccess map =
+        map_manager.getMapWriteAccess(selected_map_key);
+    std::unique_ptr<summary_map::ProjectedDescriptorCache>
+        projected_descriptor_cache =
+            summary_map::createProjectedDescriptorCacheForSummaryMap();
+    summary_map::createLocalizationSummaryMapForWellConstrainedLandmarks(
+        *map, projected_descriptor_cache.get(), &summary_map);
+    projected_descriptor_cache->saveToMap(map.get());
+  } else {
+    vi_map::VIMapManager::MapReadAccess map =
+        map_manager.getMapReadAccess(selected_map_key);
+    summary_map::createLocalizationSummaryMapForWellConstrainedLandmarks(
+        *map, &summary_map);
+  }
 
   backend::SaveConfig save_config;
   save_config.overwrite_existing_files = FLAGS_overwrite;
+  const bool success =
+      FLAGS_summary_map_tile_size_m > 0.0
+          ? summary_map::TiledLocalizationSummaryMap::saveTilesToFolder(
+                summary_map, FLAGS_summary_map_tile_size_m,
+                FLAGS_summary_map_save_path, save_config)
+          : summary_map.saveToFolder(FLAGS_summary_map_save_path, save_config);
+  if (!success) {
+    LOG(ERROR) << "Saving summary map failed.";
+    return common::kUnknownError;
+  }
+
+  return common::kSuccess;
+}
+
+int SummarizationPlugin::appendMissionsToSummaryMapOnDisk() const {
+  std::string selected_map_key;
+  if (!getSelectedMapKeyIfSet(&selected_map_key)) {
+    return common::kStupidUserError;
+  }
+
+  if (FLAGS_summary_map_save_path.empty()) {
+    LOG(ERROR) << "No path of the summary map has been provided. Use "
+               << "--summary_map_save_path to set one.";
+    return common::kStupidUserError;
+  }
+  if (FLAGS_summary_map_tile_size_m > 0.0) {
+    LOG(ERROR) << "Appending to tiled summary maps is not supported.";
+    return common::kStupidUserError;
+  }
+
+  vi_map::MissionIdList mission_ids;
+  if (!vi_map::csvIdStringToIdList(FLAGS_map_mission_list, &mission_ids) ||
+      mission_ids.empty()) {
+    LOG(ERROR) << "Provide the missions to append with --map_mission_list.";
+    return common::kStupidUserError;
+  }
+
+  vi_map::VIMapManager map_manager;
+  {
+    vi_map::VIMapManager::MapReadAccess map =
+        map_manager.getMapReadAccess(selected_map_key);
+    for (const vi_map::MissionId& mission_id : mission_ids) {
+      if (!map->hasMission(mission_id)) {
+        LOG(ERROR) << "The map has no mission " << mission_id << '.';
+        return common::kStupidUserError;
+      }
+    }
+  }
+
+  summary_map::LocalizationSummaryMap summary_map;
+  if (!summary_map.loadFromFolder(FLAGS_summary_map_save_path)) {
+    LOG(ERROR) << "Loading the summary map from \""
+               << FLAGS_summary_map_save_path << "\" failed.";
+    return common::kStupidUserError;
+  }
+
+  bool appended_landmarks;
+  if (FLAGS_lc_use_projected_descriptor_cache) {
+    // The projected descriptors are stored back into the map.
+    vi_map::VIMapManager::MapWriteAccess map =
+        map_manager.getMapWriteAccess(selected_map_key);
+    std::unique_ptr<summary_map::ProjectedDescriptorCache>
+        projected_descriptor_cache =
+            summary_map::createProjectedDescriptorCacheForSummaryMap();
+    appended_landmarks = summary_map::appendMissionsToLocalizationSummaryMap(
+        *map, mission_ids, projected_descriptor_cache.get(), &summary_map);
+    projected_descriptor_cache->saveToMap(map.get());
+  } else {
+    vi_map::VIMapManager::MapReadAccess map =
+        map_manager.getMapReadAccess(selected_map_key);
+    appended_landmarks = summary_map::appendMissionsToLocalizationSummaryMap(
+        *map, mission_ids, nullptr, &summary_map);
+  }
+  if (!appended_landmarks) {
+    return common::kUnknownError;
+  }
+
+  // The summary map is updated in place.
+  backend::SaveConfig save_config;
+  save_config.overwrite_existing_files = true;
   if (!summary_map.saveToFolder(FLAGS_summary_map_save_path, save_config)) {
     LOG(ERROR) << "Saving summary map failed.";
     return common::kUnknownError;
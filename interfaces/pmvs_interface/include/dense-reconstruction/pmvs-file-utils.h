@@ -19,8 +19,13 @@
 
 namespace dense_reconstruction {
 
+// Exports the image resources of all frames, named after the frame
+// timestamps. The images are decoded and encoded in parallel, in batches that
+// bound the memory. With copy_resource_files, the resource files are copied
+// instead, unless a resource is not stored in a file of its own.
 bool exportAllImagesForCalibration(
-    const std::string& export_folder, vi_map::VIMap* vi_map);
+    const std::string& export_folder, const bool copy_resource_files,
+    vi_map::VIMap* vi_map);
 
 void createBundleFileForCmvs(
     const PmvsConfig& config, const std::string& folder_prefix,
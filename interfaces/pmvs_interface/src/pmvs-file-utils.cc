@@ -1,17 +1,217 @@
 #include "dense-reconstruction/pmvs-file-utils.h"
 
+#include <algorithm>
+#include <atomic>
+#include <iterator>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <Eigen/Core>
 #include <aslam/common/memory.h>
 #include <glog/logging.h>
 #include <maplab-common/file-logger.h>
+#include <maplab-common/file-system-tools.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/thread-pool.h>
+#include <maplab-common/threading-helpers.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
 namespace dense_reconstruction {
 
+namespace {
+// Number of images loaded at once, bounds the memory of the loaded images.
+constexpr size_t kNumImagesPerBatch = 64u;
+
+// Undistorts and converts the image of the observer pose and writes it
+// together with its projection matrix. The undistortion maps of the cameras
+// are computed once and only read here, so the observer poses can be written
+// in parallel.
+void writeObserverPoseAndImage(
+    const PmvsConfig& config, const std::string& image_folder,
+    const std::string& txt_folder, const ObserverCameraMap& observer_cameras,
+    const ObserverPose& observer_pose, cv::Mat* image) {
+  CHECK_NOTNULL(image);
+  const size_t observer_number = observer_pose.camera_number;
+  char image_name[1024];
+  snprintf(
+      image_name, sizeof(image_name), config.kImageFileNameString_.c_str(),
+      image_folder.c_str(), observer_number);
+
+  if (observer_pose.needsUndistortion()) {
+    const ObserverCamera& observer_camera =
+        common::getChecked(observer_cameras, observer_pose.camera_id);
+    cv::Mat undistorted_image;
+    observer_camera.undistortImage(*image, &undistorted_image);
+    *image = undistorted_image;
+  }
+
+  cv::Mat color_image;
+  if (image->channels() == 3 && image->type() == CV_8UC3) {
+    color_image = *image;
+  } else {
+    // PMVS expects color images, therefore we convert the grayscale image
+    // to a pseudo color image.
+    VLOG(2) << "Convert grayscale image to pseudo color image.";
+    cv::cvtColor(*image, color_image, CV_GRAY2RGB);
+  }
+  // Save to visualize folder.
+  cv::imwrite(std::string(image_name), color_image);
+
+  // Write camera projection matrix to txt folder.
+  char camera_file_name_buffer[1024];
+  snprintf(
+      camera_file_name_buffer, sizeof(camera_file_name_buffer),
+      config.kCameraFileNameString_.c_str(), txt_folder.c_str(),
+      observer_number);
+  std::string camera_file_name(camera_file_name_buffer);
+  common::FileLogger camera_file(camera_file_name);
+  CHECK(camera_file.isOpen())
+      << "Could not write to camera projection matrix file: "
+      << camera_file_name;
+  camera_file << "CONTOUR" << std::endl;
+  camera_file << observer_pose.P_undistorted;
+}
+
+// Loads the images of the observer poses. The frame images of the same type
+// are loaded in one batch, which decodes them in parallel.
+void loadObserverImages(
+    const vi_map::VIMap& vi_map,
+    const std::vector<const ObserverPose*>& observer_poses,
+    std::vector<cv::Mat>* images) {
+  CHECK_NOTNULL(images)->clear();
+  images->resize(observer_poses.size());
+
+  std::unordered_map<
+      backend::ResourceType, std::vector<size_t>, backend::ResourceTypeHash>
+      frame_image_indices;
+  for (size_t idx = 0u; idx < observer_poses.size(); ++idx) {
+    const ObserverPose& observer_pose = *CHECK_NOTNULL(observer_poses[idx]);
+    if (observer_pose.is_optional_camera_image) {
+      observer_pose.loadImage(vi_map, &(*images)[idx]);
+    } else {
+      frame_image_indices[observer_pose.image_type].push_back(idx);
+    }
+  }
+
+  for (const std::unordered_map<
+           backend::ResourceType, std::vector<size_t>,
+           backend::ResourceTypeHash>::value_type& type_and_indices :
+       frame_image_indices) {
+    const std::vector<size_t>& indices = type_and_indices.second;
+    std::vector<vi_map::VisualFrameIdentifier> frame_ids;
+    frame_ids.reserve(indices.size());
+    for (const size_t idx : indices) {
+      frame_ids.emplace_back(
+          observer_poses[idx]->vertex_id, observer_poses[idx]->frame_idx);
+    }
+    std::vector<cv::Mat> frame_images;
+    std::vector<bool> has_image;
+    vi_map.getFrameResources(
+        frame_ids, type_and_indices.first, &frame_images, &has_image);
+    for (size_t frame_num = 0u; frame_num < indices.size(); ++frame_num) {
+      CHECK(has_image[frame_num])
+          << "Vertex " << frame_ids[frame_num].vertex_id << " frame "
+          << frame_ids[frame_num].frame_index << " has no image of type "
+          << backend::ResourceTypeNames[static_cast<size_t>(
+                 type_and_indices.first)]
+          << ".";
+      (*images)[indices[frame_num]] = frame_images[frame_num];
+    }
+  }
+}
+
+// An image to export, named after the timestamp of its frame. The image is
+// copied from its resource file if source_file_path is set, loaded and
+// re-encoded otherwise.
+struct ImageExportJob {
+  vi_map::VisualFrameIdentifier frame_id;
+  std::string file_path;
+  std::string source_file_path;
+  cv::Mat image;
+};
+typedef std::vector<ImageExportJob> ImageExportJobs;
+
+// Collects the frames that have an image of the type, in the order of the
+// vertices.
+void collectImageExportJobs(
+    const vi_map::VIMap& vi_map, const pose_graph::VertexIdList& vertex_ids,
+    const backend::ResourceType& resource_type,
+    const std::string& resource_type_folder, const bool copy_resource_files,
+    ImageExportJobs* jobs) {
+  CHECK_NOTNULL(jobs)->clear();
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    const vi_map::Vertex& vertex = vi_map.getVertex(vertex_id);
+    const size_t num_frames = vertex.numFrames();
+    for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+      backend::ResourceIdSet resource_ids;
+      vertex.getFrameResourceIdsOfType(frame_idx, resource_type, &resource_ids);
+      if (resource_ids.empty()) {
+        continue;
+      }
+      ImageExportJob job;
+      job.frame_id = vi_map::VisualFrameIdentifier(vertex_id, frame_idx);
+      const int64_t frame_timestamp_ns =
+          vertex.getVisualFrame(frame_idx).getTimestampNanoseconds();
+      job.file_path =
+          resource_type_folder + std::to_string(frame_timestamp_ns) +
+          backend::ResourceTypeFileSuffix[static_cast<int>(resource_type)];
+      // The resource files have the same format as the exported images.
+      if (copy_resource_files &&
+          !vi_map.getFrameResourceFilePath(
+              vertex, frame_idx, resource_type, &job.source_file_path)) {
+        job.source_file_path.clear();
+      }
+      jobs->emplace_back(std::move(job));
+    }
+  }
+}
+
+// Loads the images of the jobs that can't be copied in one batch, which
+// decodes them in parallel.
+void loadImagesToExport(
+    const vi_map::VIMap& vi_map, const backend::ResourceType& resource_type,
+    ImageExportJobs* jobs) {
+  CHECK_NOTNULL(jobs);
+  std::vector<vi_map::VisualFrameIdentifier> frame_ids;
+  std::vector<size_t> job_indices;
+  for (size_t idx = 0u; idx < jobs->size(); ++idx) {
+    if ((*jobs)[idx].source_file_path.empty()) {
+      frame_ids.push_back((*jobs)[idx].frame_id);
+      job_indices.push_back(idx);
+    }
+  }
+  if (frame_ids.empty()) {
+    return;
+  }
+  std::vector<cv::Mat> images;
+  std::vector<bool> has_image;
+  vi_map.getFrameResources(frame_ids, resource_type, &images, &has_image);
+  for (size_t idx = 0u; idx < job_indices.size(); ++idx) {
+    CHECK(has_image[idx]);
+    (*jobs)[job_indices[idx]].image = images[idx];
+  }
+}
+
+// Releases the image of the job after writing it.
+bool exportImage(
+    const backend::ResourceLoader& resource_loader,
+    const backend::ResourceType& resource_type, ImageExportJob* job) {
+  CHECK_NOTNULL(job);
+  if (!job->source_file_path.empty()) {
+    constexpr mode_t kFileMode = 0644;
+    constexpr bool kOverwrite = true;
+    return common::copyFile(
+        job->source_file_path, job->file_path, kFileMode, kOverwrite);
+  }
+  CHECK(!job->image.empty());
+  resource_loader.saveResourceToFile(job->file_path, resource_type, job->image);
+  job->image.release();
+  return true;
+}
+}  // namespace
+
 void createBundleFileForCmvs(
     const PmvsConfig& config, const std::string& folder_prefix,
     const unsigned int total_num_images, const unsigned int num_landmarks,
@@ -62,54 +262,38 @@ void writeObserverPosesAndImagesToFileSystem(
     const std::string& image_folder, const std::string& txt_folder,
     const ObserverCameraMap& observer_cameras,
     const ObserverPosesMap& observer_poses) {
+  std::vector<const ObserverPose*> all_observer_poses;
   for (const ObserverPosesMap::value_type& observer_pose_w_vertex_id :
        observer_poses) {
     const ObserverPoseSet& observer_pose_set = observer_pose_w_vertex_id.second;
     for (const ObserverPose& observer_pose : observer_pose_set) {
-      const size_t observer_number = observer_pose.camera_number;
-      char image_name[1024];
-      snprintf(
-          image_name, sizeof(image_name), config.kImageFileNameString_.c_str(),
-          image_folder.c_str(), observer_number);
-
-      cv::Mat image;
-      observer_pose.loadImage(vi_map, &image);
-
-      if (observer_pose.needsUndistortion()) {
-        const ObserverCamera& observer_camera =
-            common::getChecked(observer_cameras, observer_pose.camera_id);
-        cv::Mat undistorted_image;
-        observer_camera.undistortImage(image, &undistorted_image);
-        image = undistorted_image;
-      }
-
-      cv::Mat color_image;
-      if (image.channels() == 3 && image.type() == CV_8UC3) {
-        color_image = image;
-      } else {
-        // PMVS expects color images, therefore we convert the grayscale image
-        // to a pseudo color image.
-        VLOG(2) << "Convert grayscale image to pseudo color image.";
-        cv::cvtColor(image, color_image, CV_GRAY2RGB);
-      }
-      // Save to visualize folder.
-      cv::imwrite(std::string(image_name), color_image);
-
-      // Write camera projection matrix to txt folder.
-      char camera_file_name_buffer[1024];
-      snprintf(
-          camera_file_name_buffer, sizeof(camera_file_name_buffer),
-          config.kCameraFileNameString_.c_str(), txt_folder.c_str(),
-          observer_number);
-      std::string camera_file_name(camera_file_name_buffer);
-      common::FileLogger camera_file(camera_file_name);
-      CHECK(camera_file.isOpen())
-          << "Could not write to camera projection matrix file: "
-          << camera_file_name;
-      camera_file << "CONTOUR" << std::endl;
-      camera_file << observer_pose.P_undistorted;
+      all_observer_poses.push_back(&observer_pose);
     }
   }
+
+  const size_t num_threads = common::getNumHardwareThreads();
+  for (size_t batch_begin = 0u; batch_begin < all_observer_poses.size();
+       batch_begin += kNumImagesPerBatch) {
+    const std::vector<const ObserverPose*> batch_observer_poses(
+        all_observer_poses.begin() + batch_begin,
+        all_observer_poses.begin() +
+            std::min(
+                batch_begin + kNumImagesPerBatch, all_observer_poses.size()));
+    std::vector<cv::Mat> images;
+    loadObserverImages(vi_map, batch_observer_poses, &images);
+
+    common::ParallelProcessDynamic(
+        batch_observer_poses.size(),
+        [&](const size_t batch_begin_idx, const size_t batch_end_idx) {
+          for (size_t batch_idx = batch_begin_idx; batch_idx < batch_end_idx;
+               ++batch_idx) {
+            writeObserverPoseAndImage(
+                config, image_folder, txt_folder, observer_cameras,
+                *batch_observer_poses[batch_idx], &images[batch_idx]);
+          }
+        },
+        num_threads);
+  }
 }
 
 void createReconstructionFolders(
@@ -140,7 +324,8 @@ void createReconstructionFolders(
 }
 
 bool exportAllImagesForCalibration(
-    const std::string& export_folder, vi_map::VIMap* vi_map) {
+    const std::string& export_folder, const bool copy_resource_files,
+    vi_map::VIMap* vi_map) {
   CHECK_NOTNULL(vi_map);
   CHECK(!export_folder.empty());
 
@@ -158,7 +343,8 @@ bool exportAllImagesForCalibration(
   cv_mat_resource_types.assign(
       cv_mat_resources_array, std::end(cv_mat_resources_array));
 
-  backend::ResourceLoader resource_loader;
+  const backend::ResourceLoader resource_loader;
+  std::atomic<size_t> num_failed_exports(0u);
 
   vi_map::MissionIdList mission_ids;
   vi_map->getAllMissionIds(&mission_ids);
@@ -171,36 +357,50 @@ bool exportAllImagesForCalibration(
           export_folder + "/" + mission_id.hexString() + "/" +
           backend::ResourceTypeNames[static_cast<int>(resource_type)] + "/";
 
-      bool created_path = false;
-
-      for (const pose_graph::VertexId& vertex_id : vertex_ids) {
-        const vi_map::Vertex& vertex = vi_map->getVertex(vertex_id);
-        const size_t num_frames = vertex.numFrames();
-
-        for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
-          cv::Mat resource;
-          if (!vi_map->getFrameResource(
-                  vertex, frame_idx, resource_type, &resource)) {
-            continue;
-          }
-
-          if (!created_path) {
-            CHECK(common::createPath(resource_type_folder));
-            created_path = true;
-          }
+      ImageExportJobs jobs;
+      collectImageExportJobs(
+          *vi_map, vertex_ids, resource_type, resource_type_folder,
+          copy_resource_files, &jobs);
+      if (jobs.empty()) {
+        continue;
+      }
+      CHECK(common::createPath(resource_type_folder));
 
-          const int64_t frame_timestamp_ns =
-              vertex.getVisualFrame(frame_idx).getTimestampNanoseconds();
-          const std::string file_path =
-              resource_type_folder + std::to_string(frame_timestamp_ns) +
-              backend::ResourceTypeFileSuffix[static_cast<int>(resource_type)];
+      // The images of the next batch are loaded while the thread pool writes
+      // the current batch, such that at most two batches are in memory.
+      common::ThreadPoolTaskGroup export_tasks(
+          &common::ThreadPool::getGlobal());
+      ImageExportJobs writing_jobs;
+      for (size_t batch_begin = 0u; batch_begin < jobs.size();
+           batch_begin += kNumImagesPerBatch) {
+        ImageExportJobs batch_jobs(
+            std::make_move_iterator(jobs.begin() + batch_begin),
+            std::make_move_iterator(
+                jobs.begin() +
+                std::min(batch_begin + kNumImagesPerBatch, jobs.size())));
+        loadImagesToExport(*vi_map, resource_type, &batch_jobs);
 
-          resource_loader.saveResourceToFile(
-              file_path, resource_type, resource);
+        export_tasks.wait();
+        writing_jobs.swap(batch_jobs);
+        for (ImageExportJob& job : writing_jobs) {
+          ImageExportJob* job_ptr = &job;
+          export_tasks.run(
+              [&resource_loader, &num_failed_exports, resource_type,
+               job_ptr]() {
+                if (!exportImage(resource_loader, resource_type, job_ptr)) {
+                  ++num_failed_exports;
+                }
+              });
         }
       }
+      export_tasks.wait();
     }
   }
+  if (num_failed_exports > 0u) {
+    LOG(ERROR) << "Failed to export " << num_failed_exports.load()
+               << " images.";
+    return false;
+  }
   return true;
 }
 
@@ -1,13 +1,16 @@
 #include "dense-reconstruction/pmvs-interface.h"
 
+#include <algorithm>
 #include <map>
 #include <stdlib.h>
+#include <vector>
 
 #include <Eigen/Core>
 #include <aslam/cameras/camera-factory.h>
 #include <aslam/cameras/camera-pinhole.h>
 #include <aslam/cameras/camera-unified-projection.h>
 #include <aslam/cameras/camera.h>
+#include <aslam/common/memory.h>
 #include <aslam/common/timer.h>
 #include <aslam/common/undistort-helpers.h>
 #include <aslam/frames/visual-frame.h>
@@ -16,11 +19,14 @@
 #include <landmark-triangulation/pose-interpolator.h>
 #include <maplab-common/accessors.h>
 #include <maplab-common/file-system-tools.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 #include <maplab-common/vector-window-operations.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/imgproc/types_c.h>
+#include <vi-map/camera-batch-projection.h>
 #include <vi-map/unique-id.h>
 
 #include "dense-reconstruction/pmvs-config.h"
@@ -89,28 +95,53 @@ void getObserverPosesFromOptionalCameras(
         std::end(pmvs_settings.supported_grayscale_image_types));
   }
 
+  const size_t num_image_types = supported_image_types.size();
   for (const vi_map::MissionId& mission_id : mission_ids) {
     const vi_map::VIMission& mission = vi_map.getMission(mission_id);
     pose_graph::VertexIdList vertex_ids;
     vi_map.getAllVertexIdsInMissionAlongGraph(mission_id, &vertex_ids);
-    for (const pose_graph::VertexId& vertex_id : vertex_ids) {
-      const vi_map::Vertex& vertex = vi_map.getVertex(vertex_id);
-      const int64_t vertex_timestamp_ns = vertex.getMinTimestampNanoseconds();
+    const size_t num_vertices = vertex_ids.size();
+    std::vector<int64_t> vertex_timestamps_ns(num_vertices);
+    for (size_t vertex_idx = 0u; vertex_idx < num_vertices; ++vertex_idx) {
+      vertex_timestamps_ns[vertex_idx] =
+          vi_map.getVertex(vertex_ids[vertex_idx])
+              .getMinTimestampNanoseconds();
+    }
+
+    // Associate the optional camera resources of every type with all vertices
+    // at once, instead of searching the resources for every vertex.
+    std::vector<aslam::CameraIdList> opt_camera_ids(num_image_types);
+    std::vector<std::vector<std::vector<int64_t>>> closest_timestamps_ns(
+        num_image_types);
+    for (size_t type_idx = 0u; type_idx < num_image_types; ++type_idx) {
+      mission.associateOptionalCameraResources(
+          supported_image_types[type_idx], vertex_timestamps_ns,
+          pmvs_settings.kOptionalCameraResourceMatchingToleranceNs,
+          &opt_camera_ids[type_idx], &closest_timestamps_ns[type_idx]);
+      CHECK_EQ(
+          opt_camera_ids[type_idx].size(),
+          closest_timestamps_ns[type_idx].size());
+    }
+
+    for (size_t vertex_idx = 0u; vertex_idx < num_vertices; ++vertex_idx) {
+      const pose_graph::VertexId& vertex_id = vertex_ids[vertex_idx];
 
       // Loop over all supported resource types and try to find a optional
       // camera resource that fits.
       aslam::CameraIdSet optional_cameras;
-      for (const backend::ResourceType& resource_type : supported_image_types) {
-        aslam::CameraIdList opt_camera_ids;
-        std::vector<int64_t> closest_timestamps_ns;
-        mission.findAllCloseOptionalCameraResources(
-            resource_type, vertex_timestamp_ns,
-            pmvs_settings.kOptionalCameraResourceMatchingToleranceNs,
-            &opt_camera_ids, &closest_timestamps_ns);
-        const size_t num_opt_cameras = opt_camera_ids.size();
-        CHECK_EQ(num_opt_cameras, closest_timestamps_ns.size());
+      for (size_t type_idx = 0u; type_idx < num_image_types; ++type_idx) {
+        const backend::ResourceType& resource_type =
+            supported_image_types[type_idx];
+        const size_t num_opt_cameras = opt_camera_ids[type_idx].size();
         for (size_t idx = 0u; idx < num_opt_cameras; ++idx) {
-          const aslam::CameraId& optional_camera_id = opt_camera_ids[idx];
+          const int64_t observer_timestamp_ns =
+              closest_timestamps_ns[type_idx][idx][vertex_idx];
+          if (observer_timestamp_ns < 0) {
+            continue;
+          }
+
+          const aslam::CameraId& optional_camera_id =
+              opt_camera_ids[type_idx][idx];
           // If we already have a resource of this camera we discard all
           // subsequent resource types, because the supported image types are
           // sorted by priority, i.e. if we found an undistorted color image
@@ -119,7 +150,6 @@ void getObserverPosesFromOptionalCameras(
             continue;
           }
 
-          const int64_t observer_timestamp_ns = closest_timestamps_ns[idx];
           const size_t observer_number = (*number_of_observers)++;
           const ObserverCamera& observer_camera =
               common::getChecked(observer_camera_map, optional_camera_id);
@@ -206,6 +236,138 @@ void getObserverPosesFromNCamera(
   }
 }
 
+namespace {
+// Returns the camera of the observer, from either the optional cameras or the
+// NCamera of the vertex.
+const aslam::Camera& getCameraOfObserver(
+    const vi_map::VIMap& vi_map, const vi_map::Vertex& vertex,
+    const ObserverCamera& observer_camera) {
+  const aslam::Camera* camera = nullptr;
+  if (observer_camera.is_optional_camera) {
+    const backend::CameraWithExtrinsics& cam_with_extrinsics =
+        vi_map.getMission(observer_camera.mission_id)
+            .getOptionalCameraWithExtrinsics(observer_camera.camera_id);
+    camera = cam_with_extrinsics.second.get();
+  } else {
+    CHECK_LT(observer_camera.frame_idx, vertex.numFrames());
+    camera = vertex.getCamera(observer_camera.frame_idx).get();
+  }
+  return *CHECK_NOTNULL(camera);
+}
+
+bool isLandmarkVisibleInCamera(
+    const aslam::Camera& camera, const aslam::Transformation& T_C_G,
+    const Eigen::Vector3d& p_G) {
+  const Eigen::Vector3d p_C = T_C_G * p_G;
+  if (p_C.z() < 0.0) {
+    return false;
+  }
+  Eigen::Vector2d keypoint_out;
+  return camera.project3(p_C, &keypoint_out).isKeypointVisible();
+}
+
+// The observer numbers of the observer poses of a vertex that see a landmark
+// observed by the vertex.
+struct LandmarkObservers {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+  vi_map::LandmarkId landmark_id;
+  Eigen::Vector3d p_G;
+  std::vector<size_t> observer_numbers;
+};
+typedef Aligned<std::vector, LandmarkObservers> LandmarkObserversList;
+
+void getLandmarkObserversOfVertex(
+    const vi_map::VIMap& vi_map, const PmvsConfig& config,
+    const vi_map::Vertex& vertex, const ObserverCameraMap& observer_cameras,
+    const ObserverPoseSet& observer_poses_for_vertex,
+    LandmarkObserversList* landmark_observers) {
+  CHECK_NOTNULL(landmark_observers)->clear();
+  CHECK(!observer_poses_for_vertex.empty());
+
+  VLOG(3) << "Found " << observer_poses_for_vertex.size()
+          << " observers for vertex " << vertex.id();
+
+  // The cameras and poses of the observers are looked up once per vertex
+  // instead of once per landmark.
+  std::vector<const aslam::Camera*> cameras;
+  aslam::TransformationVector T_C_G_of_observers;
+  std::vector<size_t> observer_numbers;
+  for (const ObserverPose& observer_pose : observer_poses_for_vertex) {
+    const ObserverCamera& observer_camera =
+        common::getChecked(observer_cameras, observer_pose.camera_id);
+    cameras.push_back(&getCameraOfObserver(vi_map, vertex, observer_camera));
+    T_C_G_of_observers.push_back(observer_pose.T_G_C.inverse());
+    observer_numbers.push_back(observer_pose.camera_number);
+  }
+  const size_t num_observers = observer_numbers.size();
+
+  vi_map::LandmarkIdList observed_landmark_ids;
+  vertex.getAllObservedLandmarkIds(&observed_landmark_ids);
+  vi_map::LandmarkIdList landmark_ids;
+  landmark_ids.reserve(observed_landmark_ids.size());
+  for (const vi_map::LandmarkId& landmark_id : observed_landmark_ids) {
+    if (!landmark_id.isValid()) {
+      VLOG(3) << "Discard invalid landmark!";
+      continue;
+    }
+
+    if (config.cmvs_use_only_good_landmarks) {
+      if (vi_map.getLandmark(landmark_id).getQuality() !=
+          vi_map::Landmark::Quality::kGood) {
+        continue;
+      }
+    }
+    landmark_ids.push_back(landmark_id);
+  }
+  const size_t num_landmarks = landmark_ids.size();
+
+  Eigen::Matrix3Xd p_G_of_landmarks(3, num_landmarks);
+  for (size_t landmark_idx = 0u; landmark_idx < num_landmarks;
+       ++landmark_idx) {
+    p_G_of_landmarks.col(landmark_idx) =
+        vi_map.getLandmark_G_p_fi(landmark_ids[landmark_idx]);
+  }
+
+  // Find out which observer poses see the landmarks. All landmarks of the
+  // vertex are projected into one observer at a time.
+  std::vector<std::vector<size_t>> observer_numbers_of_landmarks(
+      num_landmarks);
+  std::vector<char> is_visible;
+  for (size_t observer_idx = 0u; observer_idx < num_observers;
+       ++observer_idx) {
+    vi_map::getPointsVisibleInCamera(
+        *cameras[observer_idx], T_C_G_of_observers[observer_idx],
+        p_G_of_landmarks, &is_visible);
+    for (size_t landmark_idx = 0u; landmark_idx < num_landmarks;
+         ++landmark_idx) {
+      if (is_visible[landmark_idx] != 0) {
+        observer_numbers_of_landmarks[landmark_idx].push_back(
+            observer_numbers[observer_idx]);
+        VLOG(4) << "Landmark: " << landmark_ids[landmark_idx]
+                << " is visible from observer number "
+                << observer_numbers[observer_idx];
+      }
+    }
+  }
+
+  for (size_t landmark_idx = 0u; landmark_idx < num_landmarks;
+       ++landmark_idx) {
+    if (observer_numbers_of_landmarks[landmark_idx].empty()) {
+      VLOG(3) << "Landmark " << landmark_ids[landmark_idx]
+              << " has no observers!";
+      continue;
+    }
+    LandmarkObservers observers;
+    observers.landmark_id = landmark_ids[landmark_idx];
+    observers.p_G = p_G_of_landmarks.col(landmark_idx);
+    observers.observer_numbers.swap(
+        observer_numbers_of_landmarks[landmark_idx]);
+    landmark_observers->push_back(observers);
+  }
+}
+}  // namespace
+
 void getObservedLandmarksAndCovisibilityInformation(
     const vi_map::VIMap& vi_map, const PmvsConfig& config,
     const vi_map::MissionIdList& mission_ids,
@@ -215,9 +377,8 @@ void getObservedLandmarksAndCovisibilityInformation(
   CHECK_NOTNULL(observed_landmarks);
   CHECK(!mission_ids.empty());
 
-  size_t landmark_number = 0u;
-  vi_map::LandmarkIdSet actually_observed_landmarks_ids;
-
+  std::vector<const vi_map::Vertex*> vertices;
+  std::vector<const ObserverPoseSet*> observer_poses_of_vertices;
   vi_map.forEachVertex([&](const vi_map::Vertex& vertex) {
     const vi_map::MissionId& mission_id = vertex.getMissionId();
     if (std::find(mission_ids.begin(), mission_ids.end(), mission_id) ==
@@ -225,60 +386,40 @@ void getObservedLandmarksAndCovisibilityInformation(
       return;
     }
     const pose_graph::VertexId& vertex_id = vertex.id();
-
-    vi_map::LandmarkIdList observed_landmark_ids;
-    vertex.getAllObservedLandmarkIds(&observed_landmark_ids);
-
     const ObserverPosesMap::const_iterator it = observer_poses.find(vertex_id);
     if (it == observer_poses.cend()) {
       VLOG(3) << "No observer poses found for vertex " << vertex_id;
       return;
     }
-    const ObserverPoseSet& observer_poses_for_vertex = it->second;
-    CHECK(!observer_poses_for_vertex.empty());
-
-    VLOG(3) << "Found " << observer_poses_for_vertex.size()
-            << " observers for vertex " << vertex_id;
-
-    for (const vi_map::LandmarkId& landmark_id : observed_landmark_ids) {
-      if (!landmark_id.isValid()) {
-        VLOG(3) << "Discard invalid landmark!";
-        continue;
-      }
-
-      if (config.cmvs_use_only_good_landmarks) {
-        if (vi_map.getLandmark(landmark_id).getQuality() !=
-            vi_map::Landmark::Quality::kGood) {
-          continue;
-        }
-      }
-
-      const Eigen::Vector3d p_G = vi_map.getLandmark_G_p_fi(landmark_id);
-
-      // Find out which observer poses see this landmark.
-      std::unordered_set<size_t> observer_camera_numbers;
-      for (const ObserverPose& observer_pose : observer_poses_for_vertex) {
-        const ObserverCamera& observer_camera =
-            common::getChecked(observer_cameras, observer_pose.camera_id);
-        if (isLandmarkVisibleForObserverCamera(
-                vi_map, vertex, landmark_id, p_G, observer_camera,
-                observer_pose)) {
-          observer_camera_numbers.insert(observer_pose.camera_number);
-          VLOG(4) << "Landmark: " << landmark_id
-                  << " is visible from observer number "
-                  << observer_pose.camera_number;
-        } else {
-          VLOG(4) << "Landmark: " << landmark_id
-                  << " is NOT visible from observer number "
-                  << observer_pose.camera_number;
+    vertices.push_back(&vertex);
+    observer_poses_of_vertices.push_back(&it->second);
+  });
+  const size_t num_vertices = vertices.size();
+
+  // The observers of the landmarks are found for all vertices in parallel.
+  // They are merged in the order of the vertices, such that the landmark
+  // numbers don't depend on the number of threads.
+  std::vector<LandmarkObserversList> landmark_observers_of_vertices(
+      num_vertices);
+  common::ParallelProcessDynamic(
+      num_vertices,
+      [&](const size_t vertex_begin, const size_t vertex_end) {
+        for (size_t vertex_idx = vertex_begin; vertex_idx < vertex_end;
+             ++vertex_idx) {
+          getLandmarkObserversOfVertex(
+              vi_map, config, *vertices[vertex_idx], observer_cameras,
+              *observer_poses_of_vertices[vertex_idx],
+              &landmark_observers_of_vertices[vertex_idx]);
         }
-      }
-
-      if (observer_camera_numbers.empty()) {
-        VLOG(3) << "Landmark " << landmark_id << " has no observers!";
-        continue;
-      }
+      },
+      common::getNumHardwareThreads());
 
+  size_t landmark_number = 0u;
+  for (const LandmarkObserversList& landmark_observers_of_vertex :
+       landmark_observers_of_vertices) {
+    for (const LandmarkObservers& landmark_observers :
+         landmark_observers_of_vertex) {
+      const vi_map::LandmarkId& landmark_id = landmark_observers.landmark_id;
       ObservedLandmarks::iterator it = observed_landmarks->find(landmark_id);
       // Initialize the observed landmark if it doesnt exists already.
       ObservedLandmark* observed_landmark = nullptr;
@@ -286,7 +427,7 @@ void getObservedLandmarksAndCovisibilityInformation(
         observed_landmark = &((*observed_landmarks)[landmark_id]);
         CHECK_NOTNULL(observed_landmark);
 
-        observed_landmark->p_G = vi_map.getLandmark_G_p_fi(landmark_id);
+        observed_landmark->p_G = landmark_observers.p_G;
         observed_landmark->landmark_id = landmark_id;
         observed_landmark->landmark_number = landmark_number++;
         VLOG(4) << "New observed landmark created: " << landmark_id;
@@ -299,55 +440,30 @@ void getObservedLandmarksAndCovisibilityInformation(
       }
 
       observed_landmark->observer_pose_numbers.insert(
-          observer_camera_numbers.cbegin(), observer_camera_numbers.cend());
+          landmark_observers.observer_numbers.cbegin(),
+          landmark_observers.observer_numbers.cend());
 
-      VLOG(3) << "Added " << observer_camera_numbers.size()
+      VLOG(3) << "Added " << landmark_observers.observer_numbers.size()
               << " observers for landmark " << landmark_id
               << ". Total number of observers are now "
               << observed_landmark->observer_pose_numbers.size();
     }
-  });
+  }
 }
 
 bool isLandmarkVisibleForObserverCamera(
     const vi_map::VIMap& vi_map, const vi_map::Vertex& vertex,
     const vi_map::LandmarkId& landmark_id, const Eigen::Vector3d& p_G,
     const ObserverCamera& observer_camera, const ObserverPose& observer_pose) {
-  const vi_map::VIMission& mission =
-      vi_map.getMission(observer_camera.mission_id);
-
-  // Retrieve aslam::Camera from either optional cameras or NCamera.
-  const aslam::Camera* camera = nullptr;
-  if (observer_camera.is_optional_camera) {
-    const backend::CameraWithExtrinsics& cam_with_extrinsics =
-        mission.getOptionalCameraWithExtrinsics(observer_camera.camera_id);
-    camera = cam_with_extrinsics.second.get();
-  } else {
-    CHECK_LT(observer_camera.frame_idx, vertex.numFrames());
-    camera = vertex.getCamera(observer_camera.frame_idx).get();
-  }
-  CHECK_NOTNULL(camera);
-
-  Eigen::Vector3d p_C = observer_pose.T_G_C.inverse() * p_G;
-
-  if (p_C.z() < 0.0) {
-    VLOG(4) << "Landmark " << landmark_id << " is behind camera "
-            << observer_camera.camera_id;
-    return false;
-  }
-
-  Eigen::Vector2d keypoint_out;
-  const aslam::ProjectionResult& projection_result =
-      camera->project3(p_C, &keypoint_out);
-
-  if (projection_result) {
+  const aslam::Camera& camera =
+      getCameraOfObserver(vi_map, vertex, observer_camera);
+  if (isLandmarkVisibleInCamera(camera, observer_pose.T_G_C.inverse(), p_G)) {
     VLOG(4) << "Landmark " << landmark_id << " is visible in camera "
             << observer_camera.camera_id;
     return true;
-  } else {
-    VLOG(4) << "Landmark " << landmark_id << " is NOT visible in camera "
-            << observer_camera.camera_id;
   }
+  VLOG(4) << "Landmark " << landmark_id << " is NOT visible in camera "
+          << observer_camera.camera_id;
   return false;
 }
 
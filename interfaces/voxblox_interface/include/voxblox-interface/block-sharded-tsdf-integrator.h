@@ -0,0 +1,90 @@
+#ifndef VOXBLOX_INTERFACE_BLOCK_SHARDED_TSDF_INTEGRATOR_H_
+#define VOXBLOX_INTERFACE_BLOCK_SHARDED_TSDF_INTEGRATOR_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <voxblox/core/common.h>
+#include <voxblox/core/layer.h>
+#include <voxblox/core/voxel.h>
+#include <voxblox/integrator/tsdf_integrator.h>
+
+namespace voxblox_interface {
+
+// Integrates point clouds with config.integrator_threads threads, such that
+// the result is the same as integrating every point in order with a
+// voxblox::SimpleTsdfIntegrator. Several point clouds can be collected in a
+// batch and integrated together, which keeps all threads busy for small point
+// clouds.
+//
+// The rays are cast in parallel and the resulting voxel updates are sharded by
+// the voxblox block they fall into. Every shard is then updated by a single
+// thread in the order of the points, so the threads update disjoint blocks and
+// the updates of every voxel are applied in the same order for any number of
+// threads. The points are processed in passes of at most kMaxNumPointsPerPass
+// points to bound the memory of the buffered voxel updates.
+class BlockShardedTsdfIntegrator : public voxblox::TsdfIntegratorBase {
+ public:
+  static constexpr size_t kMaxNumPointsPerPass = 1u << 14;
+
+  BlockShardedTsdfIntegrator(
+      const Config& config, voxblox::Layer<voxblox::TsdfVoxel>* layer);
+
+  // Integrates the point cloud and any point clouds that are still in the
+  // batch.
+  void integratePointCloud(
+      const voxblox::Transformation& T_G_C,
+      const voxblox::Pointcloud& points_C, const voxblox::Colors& colors,
+      const bool freespace_points = false) override;
+
+  // Adds the point cloud to the batch without integrating it.
+  void addPointCloudToBatch(
+      const voxblox::Transformation& T_G_C,
+      const voxblox::Pointcloud& points_C, const voxblox::Colors& colors,
+      const bool freespace_points = false);
+
+  // Integrates and clears the batch.
+  void integrateBatch();
+
+  size_t getNumPointCloudsInBatch() const {
+    return num_point_clouds_in_batch_;
+  }
+
+  size_t getNumPointsInBatch() const {
+    return batch_points_.size();
+  }
+
+ private:
+  // A point of the batch that is valid for integration.
+  struct BatchPoint {
+    voxblox::Point origin;
+    voxblox::Point point_G;
+    voxblox::Color color;
+    float weight;
+    bool is_clearing;
+  };
+
+  struct VoxelUpdate {
+    voxblox::GlobalIndex global_voxel_idx;
+    uint32_t batch_point_idx;
+  };
+  typedef std::vector<VoxelUpdate> VoxelUpdates;
+
+  void integratePass(const size_t point_begin, const size_t point_end);
+
+  size_t getShardIndex(const voxblox::GlobalIndex& global_voxel_idx) const;
+
+  const size_t num_threads_;
+  const size_t num_shards_;
+
+  std::vector<BatchPoint> batch_points_;
+  size_t num_point_clouds_in_batch_;
+
+  // Voxel updates of every chunk of points and shard, indexed by
+  // chunk_idx * num_shards_ + shard_idx. Reused between passes.
+  std::vector<VoxelUpdates> voxel_updates_;
+};
+
+}  // namespace voxblox_interface
+
+#endif  // VOXBLOX_INTERFACE_BLOCK_SHARDED_TSDF_INTEGRATOR_H_
@@ -26,6 +26,18 @@ bool integrateAllDepthResourcesOfType(
     const voxblox::TsdfIntegratorBase::Config& integrator_config,
     vi_map::VIMap* vi_map, voxblox::TsdfMap* tsdf_map);
 
+// Same as above, but the depth resources of num_frames_per_batch frames are
+// integrated together by a BlockShardedTsdfIntegrator with
+// integrator_config.integrator_threads threads. The result does not depend on
+// the number of threads.
+bool integrateAllDepthResourcesOfTypeBlockSharded(
+    const vi_map::MissionIdList& mission_ids,
+    const backend::ResourceType& input_resource_type,
+    const bool use_distorted_camera,
+    const voxblox::TsdfIntegratorBase::Config& integrator_config,
+    const size_t num_frames_per_batch, vi_map::VIMap* vi_map,
+    voxblox::TsdfMap* tsdf_map);
+
 // Integrates a 3D point cloud into a TSDF map.
 void integratePointCloud(
     const pose::Transformation& T_G_C, const pose::Position3DVector& points_C,
@@ -0,0 +1,31 @@
+#ifndef VOXBLOX_INTERFACE_MESH_TILES_H_
+#define VOXBLOX_INTERFACE_MESH_TILES_H_
+
+#include <cstdint>
+#include <string>
+
+#include <voxblox/core/block.h>
+#include <voxblox/core/tsdf_map.h>
+#include <voxblox/core/voxel.h>
+
+namespace voxblox_interface {
+
+// Exports the mesh of the TSDF map as one PLY tile per block into the folder,
+// together with a manifest of the fingerprints of the voxels of every block.
+// If the folder already holds the tiles of an earlier export, only the tiles
+// of the blocks whose voxels changed since then, or whose neighbors the mesh
+// of the block depends on changed, are meshed and written again. Tiles of
+// blocks that no longer exist are deleted. The updated flags of the blocks
+// are overwritten. Returns false if the folder or a tile could not be written.
+bool exportTsdfMeshTiles(
+    const std::string& tile_folder, voxblox::TsdfMap* tsdf_map,
+    size_t* num_exported_tiles);
+
+// Returns a hash of the distances, weights and colors of all voxels of the
+// block.
+uint64_t computeBlockFingerprint(
+    const voxblox::Block<voxblox::TsdfVoxel>& block);
+
+}  // namespace voxblox_interface
+
+#endif  // VOXBLOX_INTERFACE_MESH_TILES_H_
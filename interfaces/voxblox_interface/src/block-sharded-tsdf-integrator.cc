@@ -0,0 +1,153 @@
+#include "voxblox-interface/block-sharded-tsdf-integrator.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+#include <voxblox/core/block_hash.h>
+#include <voxblox/integrator/integrator_utils.h>
+
+namespace voxblox_interface {
+
+constexpr size_t BlockShardedTsdfIntegrator::kMaxNumPointsPerPass;
+
+namespace {
+// More shards than threads, such that the threads are balanced if the voxel
+// updates are not evenly distributed over the blocks.
+constexpr size_t kNumShardsPerThread = 4u;
+}  // namespace
+
+BlockShardedTsdfIntegrator::BlockShardedTsdfIntegrator(
+    const Config& config, voxblox::Layer<voxblox::TsdfVoxel>* layer)
+    : voxblox::TsdfIntegratorBase(config, layer),
+      num_threads_(std::max<size_t>(config.integrator_threads, 1u)),
+      num_shards_(num_threads_ * kNumShardsPerThread),
+      num_point_clouds_in_batch_(0u) {
+  voxel_updates_.resize(num_threads_ * num_shards_);
+}
+
+void BlockShardedTsdfIntegrator::integratePointCloud(
+    const voxblox::Transformation& T_G_C, const voxblox::Pointcloud& points_C,
+    const voxblox::Colors& colors, const bool freespace_points) {
+  addPointCloudToBatch(T_G_C, points_C, colors, freespace_points);
+  integrateBatch();
+}
+
+void BlockShardedTsdfIntegrator::addPointCloudToBatch(
+    const voxblox::Transformation& T_G_C, const voxblox::Pointcloud& points_C,
+    const voxblox::Colors& colors, const bool freespace_points) {
+  CHECK_EQ(points_C.size(), colors.size());
+  CHECK_LE(
+      batch_points_.size() + points_C.size(),
+      std::numeric_limits<uint32_t>::max());
+
+  const voxblox::Point origin = T_G_C.getPosition();
+  batch_points_.reserve(batch_points_.size() + points_C.size());
+  for (size_t point_idx = 0u; point_idx < points_C.size(); ++point_idx) {
+    const voxblox::Point& point_C = points_C[point_idx];
+    bool is_clearing;
+    if (!isPointValid(point_C, freespace_points, &is_clearing)) {
+      continue;
+    }
+    BatchPoint batch_point;
+    batch_point.origin = origin;
+    batch_point.point_G = T_G_C * point_C;
+    batch_point.color = colors[point_idx];
+    batch_point.weight = getVoxelWeight(point_C);
+    batch_point.is_clearing = is_clearing;
+    batch_points_.push_back(batch_point);
+  }
+  ++num_point_clouds_in_batch_;
+}
+
+void BlockShardedTsdfIntegrator::integrateBatch() {
+  const size_t num_points = batch_points_.size();
+  for (size_t point_begin = 0u; point_begin < num_points;
+       point_begin += kMaxNumPointsPerPass) {
+    integratePass(
+        point_begin, std::min(point_begin + kMaxNumPointsPerPass, num_points));
+  }
+  batch_points_.clear();
+  num_point_clouds_in_batch_ = 0u;
+}
+
+void BlockShardedTsdfIntegrator::integratePass(
+    const size_t point_begin, const size_t point_end) {
+  CHECK_LT(point_begin, point_end);
+  const size_t num_points = point_end - point_begin;
+  const size_t num_chunks = std::min(num_threads_, num_points);
+
+  // Cast the rays of consecutive chunks of points in parallel and sort the
+  // voxel updates into the shards of their block.
+  auto castRaysOfChunks = [&](
+      const size_t chunk_begin, const size_t chunk_end) {
+    for (size_t chunk_idx = chunk_begin; chunk_idx < chunk_end; ++chunk_idx) {
+      VoxelUpdates* shards_of_chunk = &voxel_updates_[chunk_idx * num_shards_];
+      for (size_t shard_idx = 0u; shard_idx < num_shards_; ++shard_idx) {
+        shards_of_chunk[shard_idx].clear();
+      }
+
+      const size_t chunk_point_begin =
+          point_begin + (chunk_idx * num_points) / num_chunks;
+      const size_t chunk_point_end =
+          point_begin + ((chunk_idx + 1u) * num_points) / num_chunks;
+      for (size_t point_idx = chunk_point_begin; point_idx < chunk_point_end;
+           ++point_idx) {
+        const BatchPoint& batch_point = batch_points_[point_idx];
+        voxblox::RayCaster ray_caster(
+            batch_point.origin, batch_point.point_G, batch_point.is_clearing,
+            config_.voxel_carving_enabled, config_.max_ray_length_m,
+            voxel_size_inv_, config_.default_truncation_distance);
+        VoxelUpdate voxel_update;
+        voxel_update.batch_point_idx = static_cast<uint32_t>(point_idx);
+        while (ray_caster.nextRayIndex(&voxel_update.global_voxel_idx)) {
+          shards_of_chunk[getShardIndex(voxel_update.global_voxel_idx)]
+              .push_back(voxel_update);
+        }
+      }
+    }
+  };
+  common::ParallelProcessDynamic(
+      num_chunks, castRaysOfChunks, num_chunks,
+      common::ParallelSchedule::kDynamic);
+
+  // Every shard is updated by one thread. Going through the chunks in order
+  // applies the updates of every voxel in the order of the points.
+  auto updateShards = [&](const size_t shard_begin, const size_t shard_end) {
+    for (size_t shard_idx = shard_begin; shard_idx < shard_end; ++shard_idx) {
+      voxblox::Block<voxblox::TsdfVoxel>::Ptr block;
+      voxblox::BlockIndex block_idx;
+      for (size_t chunk_idx = 0u; chunk_idx < num_chunks; ++chunk_idx) {
+        for (const VoxelUpdate& voxel_update :
+             voxel_updates_[chunk_idx * num_shards_ + shard_idx]) {
+          const BatchPoint& batch_point =
+              batch_points_[voxel_update.batch_point_idx];
+          voxblox::TsdfVoxel* voxel = allocateStorageAndGetVoxelPtr(
+              voxel_update.global_voxel_idx, &block, &block_idx);
+          updateTsdfVoxel(
+              batch_point.origin, batch_point.point_G,
+              voxel_update.global_voxel_idx, batch_point.color,
+              batch_point.weight, voxel);
+        }
+      }
+    }
+  };
+  common::ParallelProcessDynamic(
+      num_shards_, updateShards, num_threads_,
+      common::ParallelSchedule::kDynamic);
+
+  // Move the blocks that were allocated during the pass into the layer.
+  updateLayerWithStoredBlocks();
+}
+
+size_t BlockShardedTsdfIntegrator::getShardIndex(
+    const voxblox::GlobalIndex& global_voxel_idx) const {
+  const voxblox::BlockIndex block_idx =
+      voxblox::getBlockIndexFromGlobalVoxelIndex(
+          global_voxel_idx, voxels_per_side_inv_);
+  return voxblox::AnyIndexHash()(block_idx) % num_shards_;
+}
+
+}  // namespace voxblox_interface
@@ -1,6 +1,8 @@
 #include "voxblox-interface/integration.h"
 
+#include <functional>
 #include <type_traits>
+#include <vector>
 
 #include <Eigen/Core>
 #include <aslam/common/pose-types.h>
@@ -13,6 +15,8 @@
 #include <vi-map/unique-id.h>
 #include <vi-map/vertex.h>
 
+#include "voxblox-interface/block-sharded-tsdf-integrator.h"
+
 namespace voxblox_interface {
 
 void integrateAllLandmarks(
@@ -151,28 +155,29 @@ static std::unordered_set<backend::ResourceType, backend::ResourceTypeHash>
                               backend::ResourceType::kOptimizedDepthMap,
                               backend::ResourceType::kPointCloudXYZRGBN};
 
-bool integrateAllDepthResourcesOfType(
+namespace {
+typedef std::function<void(
+    const pose::Transformation& T_G_C, const pose::Position3DVector& points_C,
+    const voxblox::Colors& colors)>
+    DepthPointCloudFunction;
+
+// Calls the function with the depth resources of all frames of the missions,
+// converted to color point clouds in the camera frame.
+void forEachDepthResourceOfType(
     const vi_map::MissionIdList& mission_ids,
     const backend::ResourceType& input_resource_type,
-    const bool use_distorted_camera,
-    const voxblox::TsdfIntegratorBase::Config& integrator_config,
-    vi_map::VIMap* vi_map, voxblox::TsdfMap* tsdf_map) {
-  CHECK_NOTNULL(vi_map);
-  CHECK_NOTNULL(tsdf_map);
+    const bool use_distorted_camera, const vi_map::VIMap& vi_map,
+    const DepthPointCloudFunction& function) {
+  CHECK(function);
   CHECK_GT(kSupportedDepthInputTypes.count(input_resource_type), 0)
       << "This depth type is not supported! type: "
       << backend::ResourceTypeNames[static_cast<int>(input_resource_type)];
 
-  // Init Voxblox map and integrator.
-  voxblox::MergedTsdfIntegrator tsdf_integrator(
-      integrator_config, tsdf_map->getTsdfLayerPtr());
-
-  // Start integration.
   for (const vi_map::MissionId& mission_id : mission_ids) {
     VLOG(1) << "Integrating mission " << mission_id;
 
     const aslam::NCamera& n_camera =
-        vi_map->getSensorManager().getNCameraForMission(mission_id);
+        vi_map.getSensorManager().getNCameraForMission(mission_id);
 
     // Get cameras for depth map reprojection if necessary. If the flag is set
     // we use the camera without distortion.
@@ -193,10 +198,10 @@ bool integrateAllDepthResourcesOfType(
       }
     }
     const aslam::Transformation& T_G_M =
-        vi_map->getMissionBaseFrameForMission(mission_id).get_T_G_M();
+        vi_map.getMissionBaseFrameForMission(mission_id).get_T_G_M();
 
     pose_graph::VertexIdList vertex_ids;
-    vi_map->getAllVertexIdsInMissionAlongGraph(mission_id, &vertex_ids);
+    vi_map.getAllVertexIdsInMissionAlongGraph(mission_id, &vertex_ids);
 
     common::ProgressBar tsdf_progress_bar(vertex_ids.size());
     size_t vertex_counter = 0u;
@@ -207,7 +212,7 @@ bool integrateAllDepthResourcesOfType(
       }
       ++vertex_counter;
 
-      vi_map::Vertex& vertex = vi_map->getVertex(vertex_id);
+      const vi_map::Vertex& vertex = vi_map.getVertex(vertex_id);
 
       const aslam::Transformation T_G_I = T_G_M * vertex.get_T_M_I();
 
@@ -221,6 +226,8 @@ bool integrateAllDepthResourcesOfType(
             n_camera.get_T_C_B(frame_idx).inverse();
         const aslam::Transformation T_G_C = T_G_I * T_I_C;
 
+        pose::Position3DVector points_C;
+        voxblox::Colors colors;
         switch (input_resource_type) {
           case backend::ResourceType::kRawDepthMap:
           // Fall through intended.
@@ -229,7 +236,7 @@ bool integrateAllDepthResourcesOfType(
             CHECK_LT(frame_idx, num_cameras);
             CHECK(cameras[frame_idx]);
             cv::Mat depth_map;
-            if (!vi_map->getFrameResource(
+            if (!vi_map.getFrameResource(
                     vertex, frame_idx, input_resource_type, &depth_map)) {
               VLOG(3) << "Nothing to integrate.";
               continue;
@@ -238,11 +245,11 @@ bool integrateAllDepthResourcesOfType(
             // use the normal grayscale image.
             cv::Mat image;
             bool has_image = false;
-            if (vi_map->getImageForDepthMap(vertex, frame_idx, &image)) {
+            if (vi_map.getImageForDepthMap(vertex, frame_idx, &image)) {
               VLOG(3) << "Found depth map with intensity information "
                          "from the dedicated grayscale image.";
               has_image = true;
-            } else if (vi_map->getRawImage(vertex, frame_idx, &image)) {
+            } else if (vi_map.getRawImage(vertex, frame_idx, &image)) {
               VLOG(3) << "Found depth map with intensity information "
                          "from the raw grayscale image.";
               has_image = true;
@@ -250,38 +257,99 @@ bool integrateAllDepthResourcesOfType(
               VLOG(3) << "Found depth map without intensity information.";
             }
 
-            // Integrate with or without intensity information.
+            // Convert with or without intensity information.
             if (has_image) {
-              integrateDepthMap(
-                  T_G_C, depth_map, image, *cameras[frame_idx],
-                  &tsdf_integrator);
+              backend::convertDepthMapWithImageToPointCloud(
+                  depth_map, image, *cameras[frame_idx], &points_C, &colors);
             } else {
-              integrateDepthMap(
-                  T_G_C, depth_map, *cameras[frame_idx], &tsdf_integrator);
+              backend::convertDepthMapToPointCloud(
+                  depth_map, *cameras[frame_idx], &points_C);
+              colors.resize(points_C.size());
             }
-            continue;
+            break;
           }
           case backend::ResourceType::kPointCloudXYZRGBN: {
             // Check if a point cloud is available.
             resources::PointCloud point_cloud;
-            if (!vi_map->getFrameResource(
+            if (!vi_map.getFrameResource(
                     vertex, frame_idx, input_resource_type, &point_cloud)) {
               VLOG(3) << "Nothing to integrate.";
               continue;
             }
 
             VLOG(3) << "Found point cloud.";
-            integratePointCloud(T_G_C, point_cloud, &tsdf_integrator);
-            continue;
+            resources::VoxbloxColorPointCloud voxblox_point_cloud;
+            voxblox_point_cloud.points_C = &points_C;
+            voxblox_point_cloud.colors = &colors;
+            CHECK(backend::convertPointCloudType(
+                point_cloud, &voxblox_point_cloud));
+            break;
           }
           default:
             LOG(FATAL) << "This depth type is not supported! type: "
                        << backend::ResourceTypeNames[static_cast<int>(
                               input_resource_type)];
         }
+        function(T_G_C, points_C, colors);
       }
     }
   }
+}
+}  // namespace
+
+bool integrateAllDepthResourcesOfType(
+    const vi_map::MissionIdList& mission_ids,
+    const backend::ResourceType& input_resource_type,
+    const bool use_distorted_camera,
+    const voxblox::TsdfIntegratorBase::Config& integrator_config,
+    vi_map::VIMap* vi_map, voxblox::TsdfMap* tsdf_map) {
+  CHECK_NOTNULL(vi_map);
+  CHECK_NOTNULL(tsdf_map);
+
+  // Init Voxblox map and integrator.
+  voxblox::MergedTsdfIntegrator tsdf_integrator(
+      integrator_config, tsdf_map->getTsdfLayerPtr());
+
+  forEachDepthResourceOfType(
+      mission_ids, input_resource_type, use_distorted_camera, *vi_map,
+      [&tsdf_integrator](
+          const pose::Transformation& T_G_C,
+          const pose::Position3DVector& points_C,
+          const voxblox::Colors& colors) {
+        integrateColorPointCloud(T_G_C, points_C, colors, &tsdf_integrator);
+      });
+  return true;
+}
+
+bool integrateAllDepthResourcesOfTypeBlockSharded(
+    const vi_map::MissionIdList& mission_ids,
+    const backend::ResourceType& input_resource_type,
+    const bool use_distorted_camera,
+    const voxblox::TsdfIntegratorBase::Config& integrator_config,
+    const size_t num_frames_per_batch, vi_map::VIMap* vi_map,
+    voxblox::TsdfMap* tsdf_map) {
+  CHECK_NOTNULL(vi_map);
+  CHECK_NOTNULL(tsdf_map);
+  CHECK_GT(num_frames_per_batch, 0u);
+
+  BlockShardedTsdfIntegrator tsdf_integrator(
+      integrator_config, tsdf_map->getTsdfLayerPtr());
+
+  forEachDepthResourceOfType(
+      mission_ids, input_resource_type, use_distorted_camera, *vi_map,
+      [&tsdf_integrator, num_frames_per_batch](
+          const pose::Transformation& T_G_C,
+          const pose::Position3DVector& points_C,
+          const voxblox::Colors& colors) {
+        tsdf_integrator.addPointCloudToBatch(
+            static_cast<voxblox::Transformation>(T_G_C),
+            static_cast<voxblox::Pointcloud>(points_C), colors);
+        if (tsdf_integrator.getNumPointCloudsInBatch() >=
+            num_frames_per_batch) {
+          tsdf_integrator.integrateBatch();
+        }
+      });
+  tsdf_integrator.integrateBatch();
   return true;
 }
 
@@ -0,0 +1,235 @@
+#include "voxblox-interface/mesh-tiles.h"
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/file-system-tools.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
+#include <voxblox/core/block_hash.h>
+#include <voxblox/io/mesh_ply.h>
+#include <voxblox/mesh/mesh_integrator.h>
+#include <voxblox/mesh/mesh_layer.h>
+
+namespace voxblox_interface {
+
+namespace {
+const std::string kManifestFileName = "mesh_tiles.txt";  // NOLINT
+
+typedef voxblox::AnyIndexHashMapType<uint64_t>::type BlockFingerprintMap;
+
+std::string getTileFileName(const voxblox::BlockIndex& block_idx) {
+  std::stringstream file_name;
+  file_name << "mesh_" << block_idx.x() << "_" << block_idx.y() << "_"
+            << block_idx.z() << ".ply";
+  return file_name.str();
+}
+
+// Every line of the manifest holds the block index and the fingerprint of a
+// block: "x y z fingerprint".
+bool loadManifest(
+    const std::string& manifest_path, BlockFingerprintMap* fingerprints) {
+  CHECK_NOTNULL(fingerprints)->clear();
+  if (!common::fileExists(manifest_path)) {
+    return true;
+  }
+  std::ifstream manifest(manifest_path);
+  if (!manifest.is_open()) {
+    LOG(ERROR) << "Unable to open the mesh tile manifest " << manifest_path;
+    return false;
+  }
+  voxblox::BlockIndex block_idx;
+  uint64_t fingerprint;
+  while (manifest >> block_idx.x() >> block_idx.y() >> block_idx.z() >>
+         fingerprint) {
+    (*fingerprints)[block_idx] = fingerprint;
+  }
+  return true;
+}
+
+bool saveManifest(
+    const std::string& manifest_path,
+    const BlockFingerprintMap& fingerprints) {
+  std::ofstream manifest(manifest_path);
+  if (!manifest.is_open()) {
+    LOG(ERROR) << "Unable to write the mesh tile manifest " << manifest_path;
+    return false;
+  }
+  for (const BlockFingerprintMap::value_type& block_fingerprint :
+       fingerprints) {
+    const voxblox::BlockIndex& block_idx = block_fingerprint.first;
+    manifest << block_idx.x() << " " << block_idx.y() << " " << block_idx.z()
+             << " " << block_fingerprint.second << "\n";
+  }
+  return manifest.good();
+}
+}  // namespace
+
+uint64_t computeBlockFingerprint(
+    const voxblox::Block<voxblox::TsdfVoxel>& block) {
+  // 64 bit FNV-1a hash.
+  uint64_t hash = 14695981039346656037ull;
+  auto hashBytes = [&hash](const void* data, const size_t num_bytes) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t byte_idx = 0u; byte_idx < num_bytes; ++byte_idx) {
+      hash ^= bytes[byte_idx];
+      hash *= 1099511628211ull;
+    }
+  };
+  for (size_t voxel_idx = 0u; voxel_idx < block.num_voxels(); ++voxel_idx) {
+    const voxblox::TsdfVoxel& voxel = block.getVoxelByLinearIndex(voxel_idx);
+    hashBytes(&voxel.distance, sizeof(voxel.distance));
+    hashBytes(&voxel.weight, sizeof(voxel.weight));
+    hashBytes(&voxel.color.r, sizeof(voxel.color.r));
+    hashBytes(&voxel.color.g, sizeof(voxel.color.g));
+    hashBytes(&voxel.color.b, sizeof(voxel.color.b));
+    hashBytes(&voxel.color.a, sizeof(voxel.color.a));
+  }
+  return hash;
+}
+
+bool exportTsdfMeshTiles(
+    const std::string& tile_folder, voxblox::TsdfMap* tsdf_map,
+    size_t* num_exported_tiles) {
+  CHECK(!tile_folder.empty());
+  CHECK_NOTNULL(tsdf_map);
+  CHECK_NOTNULL(num_exported_tiles);
+  *num_exported_tiles = 0u;
+
+  if (!common::createPath(tile_folder)) {
+    LOG(ERROR) << "Unable to create the mesh tile folder " << tile_folder;
+    return false;
+  }
+  const std::string manifest_path =
+      common::concatenateFolderAndFileName(tile_folder, kManifestFileName);
+  BlockFingerprintMap previous_fingerprints;
+  if (!loadManifest(manifest_path, &previous_fingerprints)) {
+    return false;
+  }
+
+  voxblox::Layer<voxblox::TsdfVoxel>* tsdf_layer = tsdf_map->getTsdfLayerPtr();
+  voxblox::BlockIndexList block_indices;
+  tsdf_layer->getAllAllocatedBlocks(&block_indices);
+  const size_t num_blocks = block_indices.size();
+
+  std::vector<uint64_t> block_fingerprints(num_blocks);
+  const size_t num_threads = common::getNumHardwareThreads();
+  common::ParallelProcessDynamic(
+      num_blocks,
+      [&](const size_t block_begin, const size_t block_end) {
+        for (size_t block_idx = block_begin; block_idx < block_end;
+             ++block_idx) {
+          block_fingerprints[block_idx] = computeBlockFingerprint(
+              tsdf_layer->getBlockByIndex(block_indices[block_idx]));
+        }
+      },
+      num_threads);
+
+  // Collect the blocks that were added, changed or removed since the last
+  // export. The mesh of a block also depends on the voxels of its neighbors
+  // in positive direction, so the tiles of the neighbors in negative
+  // direction need to be updated as well.
+  BlockFingerprintMap fingerprints;
+  voxblox::BlockIndexList changed_blocks;
+  for (size_t block_idx = 0u; block_idx < num_blocks; ++block_idx) {
+    const voxblox::BlockIndex& block_index = block_indices[block_idx];
+    fingerprints[block_index] = block_fingerprints[block_idx];
+    const BlockFingerprintMap::const_iterator it =
+        previous_fingerprints.find(block_index);
+    if (it == previous_fingerprints.end() ||
+        it->second != block_fingerprints[block_idx]) {
+      changed_blocks.push_back(block_index);
+    }
+  }
+  voxblox::BlockIndexList removed_blocks;
+  for (const BlockFingerprintMap::value_type& block_fingerprint :
+       previous_fingerprints) {
+    if (fingerprints.count(block_fingerprint.first) == 0u) {
+      changed_blocks.push_back(block_fingerprint.first);
+      removed_blocks.push_back(block_fingerprint.first);
+    }
+  }
+
+  voxblox::IndexSet tiles_to_update;
+  for (const voxblox::BlockIndex& changed_block : changed_blocks) {
+    for (int dx = 0; dx <= 1; ++dx) {
+      for (int dy = 0; dy <= 1; ++dy) {
+        for (int dz = 0; dz <= 1; ++dz) {
+          const voxblox::BlockIndex block_index =
+              changed_block - voxblox::BlockIndex(dx, dy, dz);
+          if (tsdf_layer->hasBlock(block_index)) {
+            tiles_to_update.insert(block_index);
+          }
+        }
+      }
+    }
+  }
+  VLOG(1) << "Updating " << tiles_to_update.size() << " of " << num_blocks
+          << " mesh tiles, removing " << removed_blocks.size() << " tiles.";
+
+  for (const voxblox::BlockIndex& removed_block : removed_blocks) {
+    const std::string tile_path = common::concatenateFolderAndFileName(
+        tile_folder, getTileFileName(removed_block));
+    if (common::fileExists(tile_path) && !common::deleteFile(tile_path)) {
+      LOG(ERROR) << "Unable to delete the mesh tile " << tile_path;
+      return false;
+    }
+  }
+
+  // Only mesh the blocks of the tiles to update, the marching cubes of the
+  // blocks run in parallel in the mesh integrator.
+  for (const voxblox::BlockIndex& block_index : block_indices) {
+    tsdf_layer->getBlockByIndex(block_index)
+        .set_updated(tiles_to_update.count(block_index) > 0u);
+  }
+  voxblox::MeshLayer mesh_layer(tsdf_map->block_size());
+  voxblox::MeshIntegrator<voxblox::TsdfVoxel>::Config mesh_config;
+  voxblox::MeshIntegrator<voxblox::TsdfVoxel> mesh_integrator(
+      mesh_config, tsdf_layer, &mesh_layer);
+  constexpr bool kMeshOnlyUpdatedBlocks = true;
+  constexpr bool kResetUpdatedFlag = true;
+  mesh_integrator.generateMesh(kMeshOnlyUpdatedBlocks, kResetUpdatedFlag);
+
+  const voxblox::BlockIndexList tiles(
+      tiles_to_update.begin(), tiles_to_update.end());
+  std::atomic<bool> success(true);
+  std::atomic<size_t> num_written_tiles(0u);
+  common::ParallelProcessDynamic(
+      tiles.size(),
+      [&](const size_t tile_begin, const size_t tile_end) {
+        for (size_t tile_idx = tile_begin; tile_idx < tile_end; ++tile_idx) {
+          const voxblox::BlockIndex& block_index = tiles[tile_idx];
+          const std::string tile_path = common::concatenateFolderAndFileName(
+              tile_folder, getTileFileName(block_index));
+          if (mesh_layer.hasMesh(block_index) &&
+              mesh_layer.getMeshByIndex(block_index).hasVertices()) {
+            if (!voxblox::outputMeshAsPly(
+                    tile_path, mesh_layer.getMeshByIndex(block_index))) {
+              LOG(ERROR) << "Unable to write the mesh tile " << tile_path;
+              success = false;
+            }
+            ++num_written_tiles;
+          } else if (
+              common::fileExists(tile_path) &&
+              !common::deleteFile(tile_path)) {
+            LOG(ERROR) << "Unable to delete the mesh tile " << tile_path;
+            success = false;
+          }
+        }
+      },
+      num_threads);
+  *num_exported_tiles = num_written_tiles;
+
+  if (!success) {
+    // Keep the previous manifest, such that the next export writes the tiles
+    // of the changed blocks again.
+    return false;
+  }
+  return saveManifest(manifest_path, fingerprints);
+}
+
+}  // namespace voxblox_interface
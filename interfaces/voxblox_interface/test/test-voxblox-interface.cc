@@ -1,5 +1,8 @@
+#include <algorithm>
 #include <limits>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <aslam/cameras/camera-factory.h>
 #include <aslam/cameras/camera-pinhole.h>
@@ -7,6 +10,8 @@
 #include <glog/logging.h>
 #include <landmark-triangulation/landmark-triangulation.h>
 #include <map-manager/map-manager.h>
+#include <map-resources/resource-conversion.h>
+#include <maplab-common/file-system-tools.h>
 #include <maplab-common/pose_types.h>
 #include <maplab-common/test/testing-entrypoint.h>
 #include <maplab-common/test/testing-predicates.h>
@@ -19,7 +24,9 @@
 #include <voxblox/io/mesh_ply.h>
 #include <voxblox/mesh/mesh_integrator.h>
 
+#include "voxblox-interface/block-sharded-tsdf-integrator.h"
 #include "voxblox-interface/integration.h"
+#include "voxblox-interface/mesh-tiles.h"
 
 const std::string kTestDataBaseFolder = "./map_resources_test_data/"; // NOLINT
 
@@ -149,4 +156,131 @@ TEST_F(VoxbloxInterfaceTest, TestIntegrateDepthMap) {
       "test_results/TestIntegrateDepthMap.ply", mesh_layer);
 }
 
+TEST_F(VoxbloxInterfaceTest, TestBlockShardedIntegration) {
+  voxblox::TsdfMap::Config tsdf_map_config;
+  tsdf_map_config.tsdf_voxel_size = 0.5;
+  tsdf_map_config.tsdf_voxels_per_side = 16u;
+  voxblox::TsdfIntegratorBase::Config integrator_config =
+      getDepthmapTsdfIntegratorConfig();
+
+  // Integrate the depth map from two poses, such that voxels are updated by
+  // several point clouds of the batch.
+  pose::Transformation T_G_C_2 = T_G_C_;
+  T_G_C_2.getPosition() << 0.3, -0.2, 0.1;
+  pose::Position3DVector points_C;
+  voxblox::Colors colors;
+  backend::convertDepthMapWithImageToPointCloud(
+      depth_map_openni_, image_, *camera_without_distortion_, &points_C,
+      &colors);
+
+  voxblox::TsdfMap simple_tsdf_map(tsdf_map_config);
+  voxblox::SimpleTsdfIntegrator simple_integrator(
+      integrator_config, simple_tsdf_map.getTsdfLayerPtr());
+  voxblox_interface::integrateColorPointCloud(
+      T_G_C_, points_C, colors, &simple_integrator);
+  voxblox_interface::integrateColorPointCloud(
+      T_G_C_2, points_C, colors, &simple_integrator);
+
+  const std::vector<size_t> kNumThreads = {1u, 4u};
+  std::vector<std::unique_ptr<voxblox::TsdfMap>> sharded_tsdf_maps;
+  for (const size_t num_threads : kNumThreads) {
+    integrator_config.integrator_threads = num_threads;
+    sharded_tsdf_maps.emplace_back(new voxblox::TsdfMap(tsdf_map_config));
+    voxblox_interface::BlockShardedTsdfIntegrator sharded_integrator(
+        integrator_config, sharded_tsdf_maps.back()->getTsdfLayerPtr());
+
+    sharded_integrator.addPointCloudToBatch(T_G_C_, points_C, colors);
+    sharded_integrator.addPointCloudToBatch(T_G_C_2, points_C, colors);
+    EXPECT_EQ(sharded_integrator.getNumPointCloudsInBatch(), 2u);
+    sharded_integrator.integrateBatch();
+    EXPECT_EQ(sharded_integrator.getNumPointsInBatch(), 0u);
+  }
+
+  // The sharded integration is the same for any number of threads and, up to
+  // the order of the updates of the simple integrator, the same as the simple
+  // integration.
+  const voxblox::Layer<voxblox::TsdfVoxel>& simple_layer =
+      simple_tsdf_map.getTsdfLayer();
+  const voxblox::Layer<voxblox::TsdfVoxel>& single_thread_layer =
+      sharded_tsdf_maps.front()->getTsdfLayer();
+  const voxblox::Layer<voxblox::TsdfVoxel>& multi_thread_layer =
+      sharded_tsdf_maps.back()->getTsdfLayer();
+  ASSERT_EQ(
+      single_thread_layer.getNumberOfAllocatedBlocks(),
+      simple_layer.getNumberOfAllocatedBlocks());
+  ASSERT_EQ(
+      multi_thread_layer.getNumberOfAllocatedBlocks(),
+      simple_layer.getNumberOfAllocatedBlocks());
+
+  constexpr float kTolerance = 1e-4f;
+  voxblox::BlockIndexList block_indices;
+  simple_layer.getAllAllocatedBlocks(&block_indices);
+  for (const voxblox::BlockIndex& block_idx : block_indices) {
+    ASSERT_TRUE(single_thread_layer.hasBlock(block_idx));
+    ASSERT_TRUE(multi_thread_layer.hasBlock(block_idx));
+    const voxblox::Block<voxblox::TsdfVoxel>& simple_block =
+        simple_layer.getBlockByIndex(block_idx);
+    const voxblox::Block<voxblox::TsdfVoxel>& single_thread_block =
+        single_thread_layer.getBlockByIndex(block_idx);
+    const voxblox::Block<voxblox::TsdfVoxel>& multi_thread_block =
+        multi_thread_layer.getBlockByIndex(block_idx);
+    for (size_t voxel_idx = 0u; voxel_idx < simple_block.num_voxels();
+         ++voxel_idx) {
+      const voxblox::TsdfVoxel& simple_voxel =
+          simple_block.getVoxelByLinearIndex(voxel_idx);
+      const voxblox::TsdfVoxel& single_thread_voxel =
+          single_thread_block.getVoxelByLinearIndex(voxel_idx);
+      const voxblox::TsdfVoxel& multi_thread_voxel =
+          multi_thread_block.getVoxelByLinearIndex(voxel_idx);
+      EXPECT_EQ(multi_thread_voxel.distance, single_thread_voxel.distance);
+      EXPECT_EQ(multi_thread_voxel.weight, single_thread_voxel.weight);
+      EXPECT_NEAR(
+          single_thread_voxel.distance, simple_voxel.distance, kTolerance);
+      EXPECT_NEAR(
+          single_thread_voxel.weight, simple_voxel.weight,
+          kTolerance * std::max(simple_voxel.weight, 1.0f));
+    }
+  }
+}
+
+TEST_F(VoxbloxInterfaceTest, TestIncrementalMeshTiles) {
+  voxblox::TsdfMap::Config tsdf_map_config;
+  tsdf_map_config.tsdf_voxel_size = 0.5;
+  tsdf_map_config.tsdf_voxels_per_side = 16u;
+  voxblox::TsdfMap tsdf_map(tsdf_map_config);
+  voxblox::SimpleTsdfIntegrator tsdf_integrator(
+      getDepthmapTsdfIntegratorConfig(), tsdf_map.getTsdfLayerPtr());
+  voxblox_interface::integrateDepthMap(
+      T_G_C_, depth_map_openni_, image_, *camera_without_distortion_,
+      &tsdf_integrator);
+
+  const std::string kTileFolder = "test_results/mesh_tiles";
+  ASSERT_TRUE(common::removeIfExistsAndCreatePath(kTileFolder));
+
+  size_t num_exported_tiles = 0u;
+  ASSERT_TRUE(
+      voxblox_interface::exportTsdfMeshTiles(
+          kTileFolder, &tsdf_map, &num_exported_tiles));
+  EXPECT_GT(num_exported_tiles, 0u);
+  EXPECT_LE(
+      num_exported_tiles, tsdf_map.getTsdfLayer().getNumberOfAllocatedBlocks());
+
+  // Nothing changed, so no tile is written again.
+  ASSERT_TRUE(
+      voxblox_interface::exportTsdfMeshTiles(
+          kTileFolder, &tsdf_map, &num_exported_tiles));
+  EXPECT_EQ(num_exported_tiles, 0u);
+
+  // Only the tiles of the blocks changed by the new depth map are updated.
+  pose::Transformation T_G_C_2 = T_G_C_;
+  T_G_C_2.getPosition() << 0.5, 0.0, 0.0;
+  voxblox_interface::integrateDepthMap(
+      T_G_C_2, depth_map_openni_, image_, *camera_without_distortion_,
+      &tsdf_integrator);
+  ASSERT_TRUE(
+      voxblox_interface::exportTsdfMeshTiles(
+          kTileFolder, &tsdf_map, &num_exported_tiles));
+  EXPECT_GT(num_exported_tiles, 0u);
+}
+
 MAPLAB_UNITTEST_ENTRYPOINT
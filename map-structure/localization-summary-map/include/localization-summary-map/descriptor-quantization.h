@@ -0,0 +1,34 @@
+#ifndef LOCALIZATION_SUMMARY_MAP_DESCRIPTOR_QUANTIZATION_H_
+#define LOCALIZATION_SUMMARY_MAP_DESCRIPTOR_QUANTIZATION_H_
+
+#include <cstdint>
+
+#include <Eigen/Core>
+
+namespace summary_map {
+
+// Projected descriptors quantized to one signed byte per dimension, which
+// stores them in a quarter of the float size. Every dimension is mapped
+// linearly from its [min, max] range over all descriptors to the 256 codes:
+//   descriptor(d) ~= offset(d) + scale(d) * (code(d) + 128)
+// so the error per dimension is at most scale(d) / 2.
+struct QuantizedDescriptors {
+  typedef Eigen::Matrix<int8_t, Eigen::Dynamic, Eigen::Dynamic> CodeMatrix;
+
+  Eigen::VectorXf scale;
+  Eigen::VectorXf offset;
+  // One column per descriptor.
+  CodeMatrix codes;
+};
+
+void quantizeDescriptors(
+    const Eigen::MatrixXf& descriptors,
+    QuantizedDescriptors* quantized_descriptors);
+
+void dequantizeDescriptors(
+    const QuantizedDescriptors& quantized_descriptors,
+    Eigen::MatrixXf* descriptors);
+
+}  // namespace summary_map
+
+#endif  // LOCALIZATION_SUMMARY_MAP_DESCRIPTOR_QUANTIZATION_H_
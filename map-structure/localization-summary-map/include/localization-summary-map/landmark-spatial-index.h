@@ -0,0 +1,49 @@
+#ifndef LOCALIZATION_SUMMARY_MAP_LANDMARK_SPATIAL_INDEX_H_
+#define LOCALIZATION_SUMMARY_MAP_LANDMARK_SPATIAL_INDEX_H_
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+#include <maplab-common/macros.h>
+
+namespace summary_map {
+
+// Uniform grid over the landmark positions of a localization summary map for
+// "all within radius" queries. The cost of a query only depends on the number
+// of landmarks close to the query position, not on the size of the map. The
+// landmark positions are referenced, not copied, and must outlive the index.
+class LandmarkSpatialIndex {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(LandmarkSpatialIndex);
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(LandmarkSpatialIndex);
+
+  LandmarkSpatialIndex(
+      const Eigen::Matrix3Xf& G_landmark_position, const double cell_size_m);
+
+  // Returns the indices (columns of G_landmark_position) of all landmarks
+  // within the given radius of p_G, in ascending order.
+  void getLandmarkIndicesWithinRadius(
+      const Eigen::Vector3d& p_G, const double radius_m,
+      std::vector<int>* landmark_indices) const;
+
+  size_t numLandmarks() const {
+    return static_cast<size_t>(G_landmark_position_.cols());
+  }
+
+ private:
+  typedef Eigen::Vector3i CellIndex;
+  struct CellIndexHash {
+    size_t operator()(const CellIndex& cell_index) const;
+  };
+
+  CellIndex getCellIndex(const Eigen::Vector3d& p_G) const;
+
+  const Eigen::Matrix3Xf& G_landmark_position_;
+  const double cell_size_m_;
+  std::unordered_map<CellIndex, std::vector<int>, CellIndexHash> cells_;
+};
+
+}  // namespace summary_map
+#endif  // LOCALIZATION_SUMMARY_MAP_LANDMARK_SPATIAL_INDEX_H_
@@ -12,6 +12,7 @@
 namespace summary_map {
 
 // This class stores projected descriptors to speed up the summary map creation.
+// Lookups may run concurrently, but not while descriptors are added.
 class LocalizationSummaryMapCache {
  public:
   // Gets the projected descriptor if it's stored. Returns true if a descriptor
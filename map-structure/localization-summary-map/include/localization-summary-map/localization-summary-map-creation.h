@@ -1,6 +1,9 @@
 #ifndef LOCALIZATION_SUMMARY_MAP_LOCALIZATION_SUMMARY_MAP_CREATION_H_
 #define LOCALIZATION_SUMMARY_MAP_LOCALIZATION_SUMMARY_MAP_CREATION_H_
 
+#include <memory>
+#include <vector>
+
 #include <vi-map/unique-id.h>
 
 namespace vi_map {
@@ -10,10 +13,18 @@ class VIMap;
 namespace summary_map {
 class LocalizationSummaryMap;
 class LocalizationSummaryMapCache;
+class ProjectedDescriptorCache;
 
 void createLocalizationSummaryMapForWellConstrainedLandmarks(
     const vi_map::VIMap& map, summary_map::LocalizationSummaryMap* summary_map);
 
+// The projected descriptors are taken from the given cache if it isn't
+// nullptr.
+void createLocalizationSummaryMapForWellConstrainedLandmarks(
+    const vi_map::VIMap& map,
+    ProjectedDescriptorCache* projected_descriptor_cache,
+    summary_map::LocalizationSummaryMap* summary_map);
+
 void createLocalizationSummaryMapForSummarizedLandmarks(
     const vi_map::VIMap& map, const double landmark_keep_fraction,
     summary_map::LocalizationSummaryMap* summary_map);
@@ -27,5 +38,56 @@ void createLocalizationSummaryMapFromLandmarkList(
     LocalizationSummaryMapCache* summary_map_cache,
     summary_map::LocalizationSummaryMap* summary_map);
 
+void createLocalizationSummaryMapFromLandmarkList(
+    const vi_map::VIMap& map, const vi_map::LandmarkIdList& landmark_ids,
+    LocalizationSummaryMapCache* summary_map_cache,
+    ProjectedDescriptorCache* projected_descriptor_cache,
+    summary_map::LocalizationSummaryMap* summary_map);
+
+// Creates a projected descriptor cache that uses the same projection as the
+// summary map creation.
+std::unique_ptr<ProjectedDescriptorCache>
+createProjectedDescriptorCacheForSummaryMap();
+
+// Creates a summary map that only contains the given landmarks of another
+// summary map, together with their observations and observers. The landmark
+// indices must be unique and the list must not be empty. The id of the new
+// summary map should be set beforehand, as the landmark ids are derived from
+// it.
+void createLocalizationSummaryMapFromLandmarkIndices(
+    const summary_map::LocalizationSummaryMap& source_summary_map,
+    const std::vector<int>& landmark_indices,
+    summary_map::LocalizationSummaryMap* summary_map);
+
+// Concatenates the landmarks, observers and observations of several summary
+// maps, e.g. of the loaded tiles of a tiled summary map. The summary maps
+// must have the same descriptor dimensions. Observers are not deduplicated
+// between the summary maps.
+void mergeLocalizationSummaryMaps(
+    const std::vector<const summary_map::LocalizationSummaryMap*>&
+        source_summary_maps,
+    summary_map::LocalizationSummaryMap* summary_map);
+
+// Appends the given landmarks of the map to an existing summary map, e.g. the
+// landmarks of a new mission, instead of recreating the whole summary map.
+// Only the descriptors of the new landmarks are projected. The landmarks,
+// observers and observations of the existing summary map keep their indices
+// and thereby their ids, so the loop detector database of the existing
+// summary map can be extended with the appended observers. The landmarks must
+// not be in the summary map yet, observations of the existing landmarks are
+// not updated and observers are not deduplicated with the existing ones.
+void appendLandmarksToLocalizationSummaryMap(
+    const vi_map::VIMap& map, const vi_map::LandmarkIdList& landmark_ids,
+    ProjectedDescriptorCache* projected_descriptor_cache,
+    summary_map::LocalizationSummaryMap* summary_map);
+
+// Appends the well constrained landmarks that are stored in the given
+// missions, see appendLandmarksToLocalizationSummaryMap. Returns false if the
+// missions have no well constrained landmarks.
+bool appendMissionsToLocalizationSummaryMap(
+    const vi_map::VIMap& map, const vi_map::MissionIdList& mission_ids,
+    ProjectedDescriptorCache* projected_descriptor_cache,
+    summary_map::LocalizationSummaryMap* summary_map);
+
 }  // namespace summary_map
 #endif  // LOCALIZATION_SUMMARY_MAP_LOCALIZATION_SUMMARY_MAP_CREATION_H_
@@ -43,10 +43,16 @@ class LocalizationSummaryMap {
       const LocalizationSummaryMapId& localization_summary_map_id,
       const proto::LocalizationSummaryMap& proto);
 
+  // Loads the binary layout if the folder contains it and the protobuf
+  // otherwise.
   bool loadFromFolder(const std::string& folder_path);
   bool loadFromFolder(
       const LocalizationSummaryMapId& summary_map_id,
       const std::string& folder_path);
+  // Saves the map as protobuf, or in the binary layout if
+  // --localization_summary_map_save_binary is set. The descriptors are saved
+  // with one byte per dimension if
+  // --localization_summary_map_quantize_descriptors is set.
   bool saveToFolder(
       const std::string& folder_path, const backend::SaveConfig& config);
   static bool hasMapOnFileSystem(const std::string& folder_path);
@@ -81,6 +87,16 @@ class LocalizationSummaryMap {
 
  private:
   static constexpr char kFileName[] = "localization_summary_map";
+  // The binary layout stores the arrays of the map as raw, 64 byte aligned
+  // sections behind a fixed size header. The file is memory-mapped on
+  // loading, so the arrays are paged in and copied instead of parsed.
+  static constexpr char kBinaryFileName[] = "localization_summary_map.bin";
+
+  bool loadFromBinaryFile(
+      const LocalizationSummaryMapId& summary_map_id,
+      const std::string& file_path);
+  bool saveToBinaryFile(const std::string& file_path) const;
+  void initializeObserverIds(int num_observers);
 
   // The goal here is to get the most compact representation (memory).
   // So instead of storing for every descriptor a vertex+frame id pair, we just
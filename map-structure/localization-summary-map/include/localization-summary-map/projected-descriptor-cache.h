@@ -0,0 +1,104 @@
+#ifndef LOCALIZATION_SUMMARY_MAP_PROJECTED_DESCRIPTOR_CACHE_H_
+#define LOCALIZATION_SUMMARY_MAP_PROJECTED_DESCRIPTOR_CACHE_H_
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <Eigen/Core>
+#include <aslam/frames/visual-frame.h>
+#include <gflags/gflags.h>
+#include <vi-map/unique-id.h>
+
+DECLARE_bool(lc_use_projected_descriptor_cache);
+
+namespace vi_map {
+class VIMap;
+}  // namespace vi_map
+
+namespace summary_map {
+
+// Persists the projected descriptors of the visual frames of a map as one
+// mission resource per mission, such that repeated runs of the loop closure
+// or the summary map creation don't project the descriptors again. Every
+// frame keeps the projection of all of its descriptors. A cached projection
+// is only used if the projection and the descriptors of the frame haven't
+// changed since it was stored, which is checked with a fingerprint of the
+// projection and a hash of the descriptors.
+//
+// The missions are loaded from the map on their first access. All methods
+// are thread-safe.
+class ProjectedDescriptorCache {
+ public:
+  typedef std::function<void(
+      const aslam::VisualFrame::DescriptorsT&, Eigen::MatrixXf*)>
+      ProjectionFunction;
+
+  // Increase if the layout of the serialized cache changes.
+  static constexpr uint32_t kSerializationVersion = 1u;
+
+  explicit ProjectedDescriptorCache(const ProjectionFunction& project);
+
+  // Projects all descriptors of the frame, or gets them from the cache.
+  void getProjectedDescriptors(
+      const vi_map::VIMap& map, const vi_map::VisualFrameIdentifier& frame_id,
+      const aslam::VisualFrame::DescriptorsT& descriptors,
+      Eigen::MatrixXf* projected_descriptors);
+
+  // Stores the missions that have new or changed projected descriptors as
+  // mission resources. Frames that are no longer part of the map are
+  // dropped.
+  void saveToMap(vi_map::VIMap* map);
+
+  size_t numCacheHits() const;
+  size_t numCacheMisses() const;
+
+  // Serializes the frames of a mission with the current projection.
+  void serializeMission(const vi_map::MissionId& mission_id, std::string* data);
+  // Returns false if the data has been stored with another serialization
+  // version or projection, or is corrupt.
+  bool deserializeMission(
+      const vi_map::MissionId& mission_id, const std::string& data);
+
+  static uint64_t hashDescriptors(
+      const aslam::VisualFrame::DescriptorsT& descriptors);
+
+ private:
+  struct CachedFrame {
+    uint64_t descriptor_hash;
+    Eigen::MatrixXf projected_descriptors;
+  };
+  typedef std::unordered_map<vi_map::VisualFrameIdentifier, CachedFrame>
+      FrameToCachedFrameMap;
+  struct MissionCache {
+    FrameToCachedFrameMap frames;
+    uint32_t descriptor_size_bytes = 0u;
+    bool is_modified = false;
+  };
+
+  // Loads the mission from the map if it hasn't been loaded yet. The mutex
+  // needs to be held.
+  MissionCache& getMissionCache(
+      const vi_map::VIMap& map, const vi_map::MissionId& mission_id);
+  // Projects a fixed set of pseudo-random descriptors of the given size and
+  // hashes the result. The mutex needs to be held.
+  uint64_t getProjectionFingerprint(uint32_t descriptor_size_bytes);
+  // The mutex needs to be held.
+  void serializeMissionCache(
+      const MissionCache& mission_cache, std::string* data);
+  bool deserializeMissionCache(
+      const std::string& data, MissionCache* mission_cache);
+
+  const ProjectionFunction project_;
+  std::unordered_map<vi_map::MissionId, MissionCache> mission_caches_;
+  std::unordered_map<uint32_t, uint64_t> projection_fingerprints_;
+  size_t num_cache_hits_;
+  size_t num_cache_misses_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace summary_map
+
+#endif  // LOCALIZATION_SUMMARY_MAP_PROJECTED_DESCRIPTOR_CACHE_H_
@@ -0,0 +1,86 @@
+#ifndef LOCALIZATION_SUMMARY_MAP_TILED_LOCALIZATION_SUMMARY_MAP_H_
+#define LOCALIZATION_SUMMARY_MAP_TILED_LOCALIZATION_SUMMARY_MAP_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <maplab-common/macros.h>
+#include <maplab-common/map-manager-config.h>
+
+#include "localization-summary-map/localization-summary-map.h"
+
+namespace summary_map {
+
+// A localization summary map that is split into square tiles in the x-y plane
+// of the global frame, such that only the tiles around the current position
+// need to be loaded. Every tile is a self-contained summary map of the
+// landmarks within the tile, their observations and observers, saved in its
+// own subfolder. The tile directory, which is loaded up front, only holds the
+// extent and size of every tile.
+class TiledLocalizationSummaryMap {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(TiledLocalizationSummaryMap);
+
+  struct Tile {
+    // The tile covers [x, x + 1) * tile size and [y, y + 1) * tile size.
+    int x;
+    int y;
+    size_t num_landmarks;
+    // Memory of the loaded tile.
+    size_t num_bytes;
+    // Relative to the folder of the tiled map.
+    std::string folder_name;
+  };
+
+  TiledLocalizationSummaryMap();
+
+  // Splits the summary map into tiles of the given size and saves them
+  // together with the tile directory. Observers that see landmarks of
+  // several tiles are stored in each of these tiles.
+  static bool saveTilesToFolder(
+      const LocalizationSummaryMap& summary_map, const double tile_size_m,
+      const std::string& folder_path, const backend::SaveConfig& config);
+  static bool hasTilesOnFileSystem(const std::string& folder_path);
+
+  // Only loads the tile directory, the tiles are loaded with loadTile().
+  bool loadFromFolder(const std::string& folder_path);
+
+  // Returns the indices of all tiles that are within radius_m of p_G in the
+  // x-y plane, sorted by their distance to p_G.
+  void getTilesWithinRadius(
+      const Eigen::Vector3d& p_G, const double radius_m,
+      std::vector<size_t>* tile_indices) const;
+  // Returns the indices of all tiles sorted by their distance to p_G.
+  void getTilesSortedByDistance(
+      const Eigen::Vector3d& p_G, std::vector<size_t>* tile_indices) const;
+
+  // Returns nullptr if loading the tile failed.
+  LocalizationSummaryMap::Ptr loadTile(const size_t tile_index) const;
+
+  size_t numTiles() const {
+    return tiles_.size();
+  }
+  const Tile& getTile(const size_t tile_index) const;
+  double tileSizeMeters() const {
+    return tile_size_m_;
+  }
+  const std::string& folderPath() const {
+    return folder_path_;
+  }
+
+ private:
+  static constexpr char kDirectoryFileName[] =
+      "localization_summary_map_tiles";
+
+  // Distance of p_G to the closest point of the tile in the x-y plane.
+  double getDistanceToTile(const Eigen::Vector3d& p_G, const Tile& tile) const;
+
+  double tile_size_m_;
+  std::string folder_path_;
+  std::vector<Tile> tiles_;
+};
+
+}  // namespace summary_map
+#endif  // LOCALIZATION_SUMMARY_MAP_TILED_LOCALIZATION_SUMMARY_MAP_H_
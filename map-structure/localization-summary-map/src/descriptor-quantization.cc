@@ -0,0 +1,74 @@
+#include "localization-summary-map/descriptor-quantization.h"
+
+#include <cmath>
+
+#include <glog/logging.h>
+
+namespace summary_map {
+namespace {
+constexpr float kNumCodeSteps = 255.f;
+constexpr float kCodeOffset = 128.f;
+}  // namespace
+
+void quantizeDescriptors(
+    const Eigen::MatrixXf& descriptors,
+    QuantizedDescriptors* quantized_descriptors) {
+  CHECK_NOTNULL(quantized_descriptors);
+  const int num_dimensions = descriptors.rows();
+  const int num_descriptors = descriptors.cols();
+  quantized_descriptors->scale.setOnes(num_dimensions);
+  quantized_descriptors->offset.setZero(num_dimensions);
+  quantized_descriptors->codes.resize(num_dimensions, num_descriptors);
+  if (num_descriptors == 0) {
+    return;
+  }
+
+  quantized_descriptors->offset = descriptors.rowwise().minCoeff();
+  const Eigen::VectorXf range =
+      descriptors.rowwise().maxCoeff() - quantized_descriptors->offset;
+  for (int dimension = 0; dimension < num_dimensions; ++dimension) {
+    // Constant dimensions keep a scale of one and are stored exactly.
+    if (range(dimension) > 0.f) {
+      quantized_descriptors->scale(dimension) =
+          range(dimension) / kNumCodeSteps;
+    }
+  }
+
+  const Eigen::ArrayXf inverse_scale =
+      quantized_descriptors->scale.array().inverse();
+  for (int descriptor_idx = 0; descriptor_idx < num_descriptors;
+       ++descriptor_idx) {
+    const Eigen::ArrayXf steps =
+        ((descriptors.col(descriptor_idx) - quantized_descriptors->offset)
+             .array() *
+         inverse_scale)
+            .round()
+            .min(kNumCodeSteps)
+            .max(0.f);
+    quantized_descriptors->codes.col(descriptor_idx) =
+        (steps - kCodeOffset).cast<int8_t>().matrix();
+  }
+}
+
+void dequantizeDescriptors(
+    const QuantizedDescriptors& quantized_descriptors,
+    Eigen::MatrixXf* descriptors) {
+  CHECK_NOTNULL(descriptors);
+  const int num_dimensions = quantized_descriptors.codes.rows();
+  CHECK_EQ(num_dimensions, quantized_descriptors.scale.rows());
+  CHECK_EQ(num_dimensions, quantized_descriptors.offset.rows());
+  descriptors->resize(num_dimensions, quantized_descriptors.codes.cols());
+  for (int descriptor_idx = 0;
+       descriptor_idx < quantized_descriptors.codes.cols(); ++descriptor_idx) {
+    descriptors->col(descriptor_idx) =
+        ((quantized_descriptors.codes.col(descriptor_idx)
+              .cast<float>()
+              .array() +
+          kCodeOffset) *
+             quantized_descriptors.scale.array() +
+         quantized_descriptors.offset.array())
+            .matrix();
+  }
+}
+
+}  // namespace summary_map
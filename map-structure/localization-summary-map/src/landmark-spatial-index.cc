@@ -0,0 +1,73 @@
+#include "localization-summary-map/landmark-spatial-index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+
+namespace summary_map {
+
+size_t LandmarkSpatialIndex::CellIndexHash::operator()(
+    const CellIndex& cell_index) const {
+  // Large primes as in "Optimized Spatial Hashing for Collision Detection of
+  // Deformable Objects", Teschner et al., 2003.
+  return static_cast<size_t>(cell_index.x()) * 73856093u ^
+         static_cast<size_t>(cell_index.y()) * 19349663u ^
+         static_cast<size_t>(cell_index.z()) * 83492791u;
+}
+
+LandmarkSpatialIndex::LandmarkSpatialIndex(
+    const Eigen::Matrix3Xf& G_landmark_position, const double cell_size_m)
+    : G_landmark_position_(G_landmark_position), cell_size_m_(cell_size_m) {
+  CHECK_GT(cell_size_m_, 0.0);
+  const int num_landmarks = G_landmark_position_.cols();
+  for (int landmark_idx = 0; landmark_idx < num_landmarks; ++landmark_idx) {
+    cells_[getCellIndex(G_landmark_position_.col(landmark_idx).cast<double>())]
+        .push_back(landmark_idx);
+  }
+}
+
+void LandmarkSpatialIndex::getLandmarkIndicesWithinRadius(
+    const Eigen::Vector3d& p_G, const double radius_m,
+    std::vector<int>* landmark_indices) const {
+  CHECK_NOTNULL(landmark_indices)->clear();
+  CHECK_GE(radius_m, 0.0);
+
+  const Eigen::Vector3d radius_vector = Eigen::Vector3d::Constant(radius_m);
+  const CellIndex min_cell_index = getCellIndex(p_G - radius_vector);
+  const CellIndex max_cell_index = getCellIndex(p_G + radius_vector);
+  const double radius_squared = radius_m * radius_m;
+
+  CellIndex cell_index;
+  for (cell_index.x() = min_cell_index.x();
+       cell_index.x() <= max_cell_index.x(); ++cell_index.x()) {
+    for (cell_index.y() = min_cell_index.y();
+         cell_index.y() <= max_cell_index.y(); ++cell_index.y()) {
+      for (cell_index.z() = min_cell_index.z();
+           cell_index.z() <= max_cell_index.z(); ++cell_index.z()) {
+        const std::unordered_map<CellIndex, std::vector<int>,
+                                 CellIndexHash>::const_iterator it =
+            cells_.find(cell_index);
+        if (it == cells_.end()) {
+          continue;
+        }
+        for (const int landmark_idx : it->second) {
+          if ((G_landmark_position_.col(landmark_idx).cast<double>() - p_G)
+                  .squaredNorm() <= radius_squared) {
+            landmark_indices->push_back(landmark_idx);
+          }
+        }
+      }
+    }
+  }
+  std::sort(landmark_indices->begin(), landmark_indices->end());
+}
+
+LandmarkSpatialIndex::CellIndex LandmarkSpatialIndex::getCellIndex(
+    const Eigen::Vector3d& p_G) const {
+  return (p_G / cell_size_m_).array().floor().cast<int>();
+}
+
+}  // namespace summary_map
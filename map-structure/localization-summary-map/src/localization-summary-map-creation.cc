@@ -1,8 +1,13 @@
 #include "localization-summary-map/localization-summary-map-creation.h"
 
+#include <algorithm>
 #include <fstream>  // NOLINT
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include <Eigen/Core>
+#include <descriptor-projection/batched-projection.h>
 #include <descriptor-projection/descriptor-projection.h>
 #include <loopclosure-common/flags.h>
 #include <loopclosure-common/types.h>
@@ -10,23 +15,85 @@
 #include <map-sparsification/sampler-factory.h>
 #include <maplab-common/binary-serialization.h>
 #include <maplab-common/eigen-proto.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 #include <vi-map-helpers/vi-map-queries.h>
+#include <vi-map/landmark-quality-metrics.h>
 #include <vi-map/vi-map.h>
 
 #include "localization-summary-map/localization-summary-map-cache.h"
 #include "localization-summary-map/localization-summary-map.h"
+#include "localization-summary-map/projected-descriptor-cache.h"
 
 namespace summary_map {
 
+namespace {
+
+// Begin of the block_idx-th of num_blocks contiguous blocks of num_items.
+size_t getBlockBegin(
+    const size_t block_idx, const size_t num_blocks, const size_t num_items) {
+  return block_idx * num_items / num_blocks;
+}
+
+void loadProjectionMatrix(Eigen::MatrixXf* projection_matrix) {
+  CHECK_NOTNULL(projection_matrix);
+  const char* loop_closure_files_path = getenv("MAPLAB_LOOPCLOSURE_DIR");
+  CHECK_NE(loop_closure_files_path, static_cast<char*>(NULL))
+      << "MAPLAB_LOOPCLOSURE_DIR environment variable is not set.\n"
+         "Source the MapLab environment from your workspace:\n"
+         "  . devel/setup.bash";
+
+  if (FLAGS_feature_descriptor_type == loop_closure::kFeatureDescriptorFREAK) {
+    if (FLAGS_lc_projection_matrix_filename == "") {
+      FLAGS_lc_projection_matrix_filename =
+          std::string(loop_closure_files_path) + "/projection_matrix_freak.dat";
+    }
+  } else {
+    if (FLAGS_lc_projection_matrix_filename == "") {
+      FLAGS_lc_projection_matrix_filename =
+          std::string(loop_closure_files_path) + "/projection_matrix_brisk.dat";
+    }
+  }
+  std::ifstream deserializer(FLAGS_lc_projection_matrix_filename);
+  CHECK(deserializer.is_open()) << "Cannot load projection matrix from file: "
+                                << FLAGS_lc_projection_matrix_filename;
+  common::Deserialize(projection_matrix, &deserializer);
+}
+
+}  // namespace
+
+std::unique_ptr<ProjectedDescriptorCache>
+createProjectedDescriptorCacheForSummaryMap() {
+  Eigen::MatrixXf projection_matrix;
+  loadProjectionMatrix(&projection_matrix);
+  return std::unique_ptr<ProjectedDescriptorCache>(
+      new ProjectedDescriptorCache(
+          [projection_matrix](
+              const aslam::VisualFrame::DescriptorsT& descriptors,
+              Eigen::MatrixXf* projected_descriptors) {
+            descriptor_projection::ProjectDescriptorBlock(
+                descriptors, projection_matrix,
+                FLAGS_lc_target_dimensionality, projected_descriptors);
+          }));
+}
+
+void createLocalizationSummaryMapForWellConstrainedLandmarks(
+    const vi_map::VIMap& map,
+    summary_map::LocalizationSummaryMap* summary_map) {
+  createLocalizationSummaryMapForWellConstrainedLandmarks(
+      map, nullptr, summary_map);
+}
+
 void createLocalizationSummaryMapForWellConstrainedLandmarks(
     const vi_map::VIMap& map,
+    ProjectedDescriptorCache* projected_descriptor_cache,
     summary_map::LocalizationSummaryMap* summary_map) {
   vi_map_helpers::VIMapQueries queries(map);
   vi_map::LandmarkIdList landmark_ids;
   queries.getAllWellConstrainedLandmarkIds(&landmark_ids);
 
   createLocalizationSummaryMapFromLandmarkList(
-      map, landmark_ids, nullptr, summary_map);
+      map, landmark_ids, nullptr, projected_descriptor_cache, summary_map);
 }
 
 void createLocalizationSummaryMapForSummarizedLandmarks(
@@ -60,10 +127,18 @@ void createLocalizationSummaryMapFromLandmarkList(
 }
 
 void createLocalizationSummaryMapFromLandmarkList(
-    const vi_map::VIMap& map,
-    const vi_map::LandmarkIdList& landmark_ids,
+    const vi_map::VIMap& map, const vi_map::LandmarkIdList& landmark_ids,
     LocalizationSummaryMapCache* summary_map_cache,
     summary_map::LocalizationSummaryMap* summary_map) {
+  createLocalizationSummaryMapFromLandmarkList(
+      map, landmark_ids, summary_map_cache, nullptr, summary_map);
+}
+
+void createLocalizationSummaryMapFromLandmarkList(
+    const vi_map::VIMap& map, const vi_map::LandmarkIdList& landmark_ids,
+    LocalizationSummaryMapCache* summary_map_cache,
+    ProjectedDescriptorCache* projected_descriptor_cache,
+    summary_map::LocalizationSummaryMap* summary_map) {
   CHECK_NOTNULL(summary_map);
   /// The position of the landmarks in the global frame of reference.
   Eigen::Matrix3Xd G_landmark_position;
@@ -79,67 +154,95 @@ void createLocalizationSummaryMapFromLandmarkList(
   CHECK(!landmark_ids.empty());
   G_landmark_position.resize(Eigen::NoChange, landmark_ids.size());
 
-  std::vector<vi_map::KeypointIdentifier> observations;
-  // Best guess reserve.
-  observations.reserve(landmark_ids.size() * 4);
-
-  std::vector<unsigned int> observation_to_landmark;
-  observation_to_landmark.reserve(landmark_ids.size() * 4);
+  // The landmarks and later the observations are split into one contiguous
+  // block per thread. Every block is gathered into its own buffers, which are
+  // concatenated in block order, so the result doesn't depend on the number
+  // of threads.
+  const size_t num_threads = common::getNumHardwareThreads();
+  constexpr bool kAlwaysParallelize = true;
 
   // We first collect all observations to the landmarks in question.
-  for (size_t landmark_index = 0; landmark_index < landmark_ids.size();
-       ++landmark_index) {
-    const vi_map::LandmarkId& landmark_id = landmark_ids[landmark_index];
-    const vi_map::Landmark& landmark = map.getLandmark(landmark_id);
-    G_landmark_position.col(landmark_index) =
-        map.getLandmark_G_p_fi(landmark_id);
-
-    const std::vector<vi_map::KeypointIdentifier>& landmark_observations =
-        landmark.getObservations();
-    observations.insert(
-        observations.end(), landmark_observations.begin(),
-        landmark_observations.end());
+  const size_t num_landmark_blocks =
+      std::min(num_threads, landmark_ids.size());
+  std::vector<std::vector<vi_map::KeypointIdentifier>> block_observations(
+      num_landmark_blocks);
+  std::vector<std::vector<unsigned int>> block_observation_to_landmark(
+      num_landmark_blocks);
+  common::ParallelProcess(
+      num_landmark_blocks,
+      [&](const std::vector<size_t>& block_indices) {
+        for (const size_t block_idx : block_indices) {
+          const size_t begin = getBlockBegin(
+              block_idx, num_landmark_blocks, landmark_ids.size());
+          const size_t end = getBlockBegin(
+              block_idx + 1u, num_landmark_blocks, landmark_ids.size());
+          std::vector<vi_map::KeypointIdentifier>& observations =
+              block_observations[block_idx];
+          std::vector<unsigned int>& observation_to_landmark =
+              block_observation_to_landmark[block_idx];
+          // Best guess reserve.
+          observations.reserve((end - begin) * 4u);
+          observation_to_landmark.reserve((end - begin) * 4u);
+          for (size_t landmark_index = begin; landmark_index < end;
+               ++landmark_index) {
+            const vi_map::LandmarkId& landmark_id =
+                landmark_ids[landmark_index];
+            const vi_map::Landmark& landmark = map.getLandmark(landmark_id);
+            G_landmark_position.col(landmark_index) =
+                map.getLandmark_G_p_fi(landmark_id);
 
-    // Push the index of the landmark for all the observations.
-    for (size_t i = 0; i < landmark_observations.size(); ++i) {
-      observation_to_landmark.push_back(landmark_index);
-    }
+            const std::vector<vi_map::KeypointIdentifier>&
+                landmark_observations = landmark.getObservations();
+            observations.insert(
+                observations.end(), landmark_observations.begin(),
+                landmark_observations.end());
+
+            // Push the index of the landmark for all the observations.
+            observation_to_landmark.insert(
+                observation_to_landmark.end(), landmark_observations.size(),
+                landmark_index);
+          }
+        }
+      },
+      kAlwaysParallelize, num_threads);
+
+  size_t num_observations = 0u;
+  for (const std::vector<vi_map::KeypointIdentifier>& observations :
+       block_observations) {
+    num_observations += observations.size();
   }
-  CHECK(!observations.empty()) << "No landmark observations for summary map.";
+  CHECK_GT(num_observations, 0u)
+      << "No landmark observations for summary map.";
+  std::vector<vi_map::KeypointIdentifier> observations;
+  observations.reserve(num_observations);
+  std::vector<unsigned int> observation_to_landmark;
+  observation_to_landmark.reserve(num_observations);
+  for (size_t block_idx = 0u; block_idx < num_landmark_blocks; ++block_idx) {
+    observations.insert(
+        observations.end(), block_observations[block_idx].begin(),
+        block_observations[block_idx].end());
+    observation_to_landmark.insert(
+        observation_to_landmark.end(),
+        block_observation_to_landmark[block_idx].begin(),
+        block_observation_to_landmark[block_idx].end());
+  }
+  block_observations.clear();
+  block_observation_to_landmark.clear();
 
   // Copy all the observation to landmark indices into the summary-map format.
   observation_to_landmark_index =
       Eigen::Map<const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1> >(
           observation_to_landmark.data(), observation_to_landmark.size(), 1);
 
-  const char* loop_closure_files_path = getenv("MAPLAB_LOOPCLOSURE_DIR");
-  CHECK_NE(loop_closure_files_path, static_cast<char*>(NULL))
-      << "MAPLAB_LOOPCLOSURE_DIR environment variable is not set.\n"
-         "Source the MapLab environment from your workspace:\n"
-         "  . devel/setup.bash";
-
-  if (FLAGS_feature_descriptor_type == loop_closure::kFeatureDescriptorFREAK) {
-    if (FLAGS_lc_projection_matrix_filename == "") {
-      FLAGS_lc_projection_matrix_filename =
-          std::string(loop_closure_files_path) + "/projection_matrix_freak.dat";
-    }
-  } else {
-    if (FLAGS_lc_projection_matrix_filename == "") {
-      FLAGS_lc_projection_matrix_filename =
-          std::string(loop_closure_files_path) + "/projection_matrix_brisk.dat";
-    }
-  }
   Eigen::MatrixXf projection_matrix;
-  std::ifstream deserializer(FLAGS_lc_projection_matrix_filename);
-  CHECK(deserializer.is_open()) << "Cannot load projection matrix from file: "
-                                << FLAGS_lc_projection_matrix_filename;
-  common::Deserialize(&projection_matrix, &deserializer);
+  loadProjectionMatrix(&projection_matrix);
 
   projected_descriptors.resize(
       FLAGS_lc_target_dimensionality, observations.size());
   observer_indices.resize(observations.size());
   Aligned<std::vector, Eigen::Vector3d> G_observer_positions;
 
+  // The observers are numbered in the order of their first observation.
   std::unordered_map<vi_map::VisualFrameIdentifier, int> frame_id_to_index;
   int observer_index = 0;
   for (size_t observation_index = 0; observation_index < observations.size();
@@ -159,33 +262,96 @@ void createLocalizationSummaryMapFromLandmarkList(
       ++observer_index;
     }
     observer_indices(observation_index, 0) = it->second;
+  }
+
+  // The descriptors of every block are written to their own columns. The
+  // summary map cache is only read concurrently, the observations that need
+  // to be added to it are collected per block and added afterwards.
+  const size_t num_observation_blocks =
+      std::min(num_threads, observations.size());
+  std::vector<std::vector<size_t>> block_observations_to_add_to_cache(
+      num_observation_blocks);
+  common::ParallelProcess(
+      num_observation_blocks,
+      [&](const std::vector<size_t>& block_indices) {
+        for (const size_t block_idx : block_indices) {
+          const size_t begin = getBlockBegin(
+              block_idx, num_observation_blocks, observations.size());
+          const size_t end = getBlockBegin(
+              block_idx + 1u, num_observation_blocks, observations.size());
 
-    CHECK_LT(observation_index, observation_to_landmark.size());
-    const size_t landmark_index = observation_to_landmark[observation_index];
-    CHECK_LT(landmark_index, landmark_ids.size());
-    const vi_map::LandmarkId& landmark_id = landmark_ids[landmark_index];
-    if (summary_map_cache == nullptr ||
-        !summary_map_cache->getProjectedDescriptorForLandmark(
-            observation, landmark_id,
-            projected_descriptors.col(observation_index))) {
-      // No projected descriptor is stored yet, need to compute first.
-      const aslam::VisualFrame& frame =
-          map.getVertex(observation.frame_id.vertex_id)
-              .getVisualFrame(observation.frame_id.frame_index);
-
-      Eigen::Map<const Eigen::Matrix<unsigned char, Eigen::Dynamic, 1> >
-          raw_descriptor(
-              frame.getDescriptor(observation.keypoint_index),
-              frame.getDescriptorSizeBytes(), 1);
-
-      // Project the descriptors directly into the descriptor storage.
-      descriptor_projection::ProjectDescriptor(
-          raw_descriptor, projection_matrix, FLAGS_lc_target_dimensionality,
-          projected_descriptors.col(observation_index));
-
-      if (summary_map_cache != nullptr) {
+          // The projection of all descriptors of a frame if the projected
+          // descriptor cache is used, such that every frame is only looked up
+          // once per block.
+          std::unordered_map<vi_map::VisualFrameIdentifier, Eigen::MatrixXf>
+              frame_id_to_projected_descriptors;
+          // Without the projected descriptor cache, the descriptors are
+          // projected in batches directly into the descriptor storage.
+          descriptor_projection::BatchedDescriptorProjector projector(
+              projection_matrix, FLAGS_lc_target_dimensionality,
+              FLAGS_lc_projection_batch_size, &projected_descriptors);
+
+          for (size_t observation_index = begin; observation_index < end;
+               ++observation_index) {
+            const vi_map::KeypointIdentifier& observation =
+                observations[observation_index];
+            const size_t landmark_index =
+                observation_to_landmark[observation_index];
+            CHECK_LT(landmark_index, landmark_ids.size());
+            const vi_map::LandmarkId& landmark_id =
+                landmark_ids[landmark_index];
+            if (summary_map_cache != nullptr &&
+                summary_map_cache->getProjectedDescriptorForLandmark(
+                    observation, landmark_id,
+                    projected_descriptors.col(observation_index))) {
+              continue;
+            }
+
+            // No projected descriptor is stored yet, need to compute first.
+            const aslam::VisualFrame& frame =
+                map.getVertex(observation.frame_id.vertex_id)
+                    .getVisualFrame(observation.frame_id.frame_index);
+            if (projected_descriptor_cache != nullptr) {
+              std::unordered_map<vi_map::VisualFrameIdentifier,
+                                 Eigen::MatrixXf>::iterator frame_it =
+                  frame_id_to_projected_descriptors.find(observation.frame_id);
+              if (frame_it == frame_id_to_projected_descriptors.end()) {
+                frame_it =
+                    frame_id_to_projected_descriptors
+                        .emplace(observation.frame_id, Eigen::MatrixXf())
+                        .first;
+                projected_descriptor_cache->getProjectedDescriptors(
+                    map, observation.frame_id, frame.getDescriptors(),
+                    &frame_it->second);
+              }
+              CHECK_LT(
+                  static_cast<int>(observation.keypoint_index),
+                  frame_it->second.cols());
+              projected_descriptors.col(observation_index) =
+                  frame_it->second.col(observation.keypoint_index);
+            } else {
+              projector.addDescriptor(
+                  frame.getDescriptor(observation.keypoint_index),
+                  frame.getDescriptorSizeBytes(), observation_index);
+            }
+
+            if (summary_map_cache != nullptr) {
+              block_observations_to_add_to_cache[block_idx].push_back(
+                  observation_index);
+            }
+          }
+          projector.flush();
+        }
+      },
+      kAlwaysParallelize, num_threads);
+
+  if (summary_map_cache != nullptr) {
+    for (const std::vector<size_t>& observations_to_add_to_cache :
+         block_observations_to_add_to_cache) {
+      for (const size_t observation_index : observations_to_add_to_cache) {
         summary_map_cache->addProjectedDescriptor(
-            observation, landmark_id,
+            observations[observation_index],
+            landmark_ids[observation_to_landmark[observation_index]],
             projected_descriptors.col(observation_index));
       }
     }
@@ -201,4 +367,210 @@ void createLocalizationSummaryMapFromLandmarkList(
   summary_map->setObserverIndices(observer_indices);
   summary_map->setObservationToLandmarkIndex(observation_to_landmark_index);
 }
+
+void createLocalizationSummaryMapFromLandmarkIndices(
+    const summary_map::LocalizationSummaryMap& source_summary_map,
+    const std::vector<int>& landmark_indices,
+    summary_map::LocalizationSummaryMap* summary_map) {
+  CHECK_NOTNULL(summary_map);
+  CHECK(!landmark_indices.empty());
+
+  const Eigen::Matrix3Xf& source_G_landmark_position =
+      source_summary_map.GLandmarkPosition();
+  const Eigen::Matrix3Xf& source_G_observer_position =
+      source_summary_map.GObserverPosition();
+  const Eigen::MatrixXf& source_descriptors =
+      source_summary_map.projectedDescriptors();
+  const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>&
+      source_observer_indices = source_summary_map.observerIndices();
+  const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>&
+      source_observation_to_landmark_index =
+          source_summary_map.observationToLandmarkIndex();
+  CHECK_EQ(source_descriptors.cols(), source_observer_indices.rows());
+  CHECK_EQ(
+      source_descriptors.cols(), source_observation_to_landmark_index.rows());
+
+  // Maps the source landmark and observer indices to the new ones, -1 means
+  // not contained in the new summary map.
+  std::vector<int> new_landmark_index(source_G_landmark_position.cols(), -1);
+  const int num_landmarks = static_cast<int>(landmark_indices.size());
+  Eigen::Matrix3Xd G_landmark_position(3, num_landmarks);
+  for (int i = 0; i < num_landmarks; ++i) {
+    const int landmark_index = landmark_indices[i];
+    CHECK_GE(landmark_index, 0);
+    CHECK_LT(landmark_index, source_G_landmark_position.cols());
+    CHECK_EQ(new_landmark_index[landmark_index], -1)
+        << "Landmark index " << landmark_index << " is not unique.";
+    new_landmark_index[landmark_index] = i;
+    G_landmark_position.col(i) =
+        source_G_landmark_position.col(landmark_index).cast<double>();
+  }
+
+  std::vector<int> observations;
+  for (int i = 0; i < source_observation_to_landmark_index.rows(); ++i) {
+    CHECK_LT(
+        source_observation_to_landmark_index(i, 0), new_landmark_index.size());
+    if (new_landmark_index[source_observation_to_landmark_index(i, 0)] >= 0) {
+      observations.push_back(i);
+    }
+  }
+
+  const int num_observations = static_cast<int>(observations.size());
+  std::vector<int> new_observer_index(source_G_observer_position.cols(), -1);
+  std::vector<int> observers;
+  Eigen::MatrixXf descriptors(source_descriptors.rows(), num_observations);
+  Eigen::Matrix<unsigned int, Eigen::Dynamic, 1> observer_indices(
+      num_observations);
+  Eigen::Matrix<unsigned int, Eigen::Dynamic, 1> observation_to_landmark_index(
+      num_observations);
+  for (int i = 0; i < num_observations; ++i) {
+    const int observation = observations[i];
+    const unsigned int observer = source_observer_indices(observation, 0);
+    CHECK_LT(observer, new_observer_index.size());
+    if (new_observer_index[observer] < 0) {
+      new_observer_index[observer] = static_cast<int>(observers.size());
+      observers.push_back(observer);
+    }
+    descriptors.col(i) = source_descriptors.col(observation);
+    observer_indices(i, 0) = new_observer_index[observer];
+    observation_to_landmark_index(i, 0) =
+        new_landmark_index[source_observation_to_landmark_index(
+            observation, 0)];
+  }
+
+  Eigen::Matrix3Xd G_observer_position(3, observers.size());
+  for (size_t i = 0u; i < observers.size(); ++i) {
+    G_observer_position.col(i) =
+        source_G_observer_position.col(observers[i]).cast<double>();
+  }
+
+  summary_map->setGLandmarkPosition(G_landmark_position);
+  summary_map->setGObserverPosition(G_observer_position);
+  summary_map->setProjectedDescriptors(descriptors);
+  summary_map->setObserverIndices(observer_indices);
+  summary_map->setObservationToLandmarkIndex(observation_to_landmark_index);
+}
+
+void mergeLocalizationSummaryMaps(
+    const std::vector<const summary_map::LocalizationSummaryMap*>&
+        source_summary_maps,
+    summary_map::LocalizationSummaryMap* summary_map) {
+  CHECK_NOTNULL(summary_map);
+  CHECK(!source_summary_maps.empty());
+
+  int num_landmarks = 0;
+  int num_observers = 0;
+  int num_observations = 0;
+  const int descriptor_dimensions =
+      CHECK_NOTNULL(source_summary_maps.front())->projectedDescriptors().rows();
+  for (const summary_map::LocalizationSummaryMap* source_summary_map :
+       source_summary_maps) {
+    CHECK_NOTNULL(source_summary_map);
+    CHECK_EQ(
+        descriptor_dimensions,
+        source_summary_map->projectedDescriptors().rows());
+    num_landmarks += source_summary_map->GLandmarkPosition().cols();
+    num_observers += source_summary_map->GObserverPosition().cols();
+    num_observations += source_summary_map->projectedDescriptors().cols();
+  }
+
+  Eigen::Matrix3Xd G_landmark_position(3, num_landmarks);
+  Eigen::Matrix3Xd G_observer_position(3, num_observers);
+  Eigen::MatrixXf descriptors(descriptor_dimensions, num_observations);
+  Eigen::Matrix<unsigned int, Eigen::Dynamic, 1> observer_indices(
+      num_observations);
+  Eigen::Matrix<unsigned int, Eigen::Dynamic, 1> observation_to_landmark_index(
+      num_observations);
+  int landmark_offset = 0;
+  int observer_offset = 0;
+  int observation_offset = 0;
+  for (const summary_map::LocalizationSummaryMap* source_summary_map :
+       source_summary_maps) {
+    const int source_num_landmarks =
+        source_summary_map->GLandmarkPosition().cols();
+    const int source_num_observers =
+        source_summary_map->GObserverPosition().cols();
+    const int source_num_observations =
+        source_summary_map->projectedDescriptors().cols();
+    G_landmark_position.middleCols(landmark_offset, source_num_landmarks) =
+        source_summary_map->GLandmarkPosition().cast<double>();
+    G_observer_position.middleCols(observer_offset, source_num_observers) =
+        source_summary_map->GObserverPosition().cast<double>();
+    descriptors.middleCols(observation_offset, source_num_observations) =
+        source_summary_map->projectedDescriptors();
+    observer_indices.segment(observation_offset, source_num_observations) =
+        source_summary_map->observerIndices().array() +
+        static_cast<unsigned int>(observer_offset);
+    observation_to_landmark_index.segment(
+        observation_offset, source_num_observations) =
+        source_summary_map->observationToLandmarkIndex().array() +
+        static_cast<unsigned int>(landmark_offset);
+    landmark_offset += source_num_landmarks;
+    observer_offset += source_num_observers;
+    observation_offset += source_num_observations;
+  }
+
+  summary_map->setGLandmarkPosition(G_landmark_position);
+  summary_map->setGObserverPosition(G_observer_position);
+  summary_map->setProjectedDescriptors(descriptors);
+  summary_map->setObserverIndices(observer_indices);
+  summary_map->setObservationToLandmarkIndex(observation_to_landmark_index);
+}
+
+void appendLandmarksToLocalizationSummaryMap(
+    const vi_map::VIMap& map, const vi_map::LandmarkIdList& landmark_ids,
+    ProjectedDescriptorCache* projected_descriptor_cache,
+    summary_map::LocalizationSummaryMap* summary_map) {
+  CHECK_NOTNULL(summary_map);
+  CHECK(!landmark_ids.empty());
+
+  summary_map::LocalizationSummaryMap appended_summary_map;
+  appended_summary_map.setId(summary_map->id());
+  createLocalizationSummaryMapFromLandmarkList(
+      map, landmark_ids, nullptr, projected_descriptor_cache,
+      &appended_summary_map);
+  if (summary_map->GLandmarkPosition().cols() == 0) {
+    *summary_map = appended_summary_map;
+    return;
+  }
+
+  // The merged summary map has the same id, so the ids of the existing
+  // landmarks stay the same.
+  summary_map::LocalizationSummaryMap merged_summary_map;
+  merged_summary_map.setId(summary_map->id());
+  mergeLocalizationSummaryMaps(
+      {summary_map, &appended_summary_map}, &merged_summary_map);
+  *summary_map = merged_summary_map;
+}
+
+bool appendMissionsToLocalizationSummaryMap(
+    const vi_map::VIMap& map, const vi_map::MissionIdList& mission_ids,
+    ProjectedDescriptorCache* projected_descriptor_cache,
+    summary_map::LocalizationSummaryMap* summary_map) {
+  CHECK_NOTNULL(summary_map);
+
+  vi_map::LandmarkIdList landmark_ids;
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    vi_map::LandmarkIdList mission_landmark_ids;
+    map.getAllLandmarkIdsInMission(mission_id, &mission_landmark_ids);
+    for (const vi_map::LandmarkId& landmark_id : mission_landmark_ids) {
+      if (vi_map::isLandmarkWellConstrained(
+              map, map.getLandmark(landmark_id))) {
+        landmark_ids.push_back(landmark_id);
+      }
+    }
+  }
+  if (landmark_ids.empty()) {
+    LOG(WARNING) << "The missions have no well constrained landmarks that "
+                 << "could be appended to the summary map.";
+    return false;
+  }
+
+  VLOG(1) << "Appending " << landmark_ids.size() << " landmarks of "
+          << mission_ids.size() << " missions to the summary map.";
+  appendLandmarksToLocalizationSummaryMap(
+      map, landmark_ids, projected_descriptor_cache, summary_map);
+  return true;
+}
+
 }  // namespace summary_map
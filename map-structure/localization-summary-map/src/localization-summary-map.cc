@@ -1,15 +1,117 @@
 #include "localization-summary-map/localization-summary-map.h"
 
+#include <cstdint>
+#include <cstring>
+#include <fstream>  // NOLINT
+#include <string>
+
+#include <gflags/gflags.h>
 #include <maplab-common/eigen-proto.h>
 #include <maplab-common/file-system-tools.h>
+#include <maplab-common/memory-mapped-file.h>
 #include <maplab-common/proto-serialization-helper.h>
 #include <vi-map/vi-map.h>
 
+#include "localization-summary-map/descriptor-quantization.h"
 #include "localization-summary-map/localization-summary-map.pb.h"
 
+DEFINE_bool(
+    localization_summary_map_save_binary, false,
+    "Save localization summary maps in the memory-mappable binary layout "
+    "instead of as protobuf. Loading detects the format automatically.");
+DEFINE_bool(
+    localization_summary_map_quantize_descriptors, false,
+    "Save the projected descriptors of localization summary maps quantized to "
+    "one byte per dimension, which shrinks them to a quarter. They are "
+    "dequantized on loading.");
+
 namespace summary_map {
+namespace {
+constexpr uint32_t kBinaryMagicNumber = 0x424d534cu;  // "LSMB"
+// Version 1 stores float descriptors, version 2 quantized descriptors.
+constexpr uint32_t kBinaryVersion = 1u;
+constexpr uint32_t kBinaryVersionQuantized = 2u;
+constexpr uint64_t kBinarySectionAlignment = 64u;
+
+struct BinaryHeader {
+  uint32_t magic_number;
+  uint32_t version;
+  uint64_t num_landmarks;
+  uint64_t num_observers;
+  uint64_t num_observations;
+  uint64_t descriptor_dimensions;
+  // Byte offsets of the sections from the beginning of the file.
+  uint64_t landmark_position_offset;
+  uint64_t observer_position_offset;
+  uint64_t descriptors_offset;
+  uint64_t observer_indices_offset;
+  uint64_t observation_to_landmark_index_offset;
+  uint64_t file_size;
+};
+
+uint64_t alignSectionOffset(uint64_t offset) {
+  return (offset + kBinarySectionAlignment - 1u) / kBinarySectionAlignment *
+         kBinarySectionAlignment;
+}
+
+// Computes the section offsets and the file size from the sizes.
+void computeBinaryLayout(BinaryHeader* header) {
+  CHECK_NOTNULL(header);
+  uint64_t offset = alignSectionOffset(sizeof(BinaryHeader));
+  header->landmark_position_offset = offset;
+  offset += 3u * header->num_landmarks * sizeof(float);
+  header->observer_position_offset = offset = alignSectionOffset(offset);
+  offset += 3u * header->num_observers * sizeof(float);
+  header->descriptors_offset = offset = alignSectionOffset(offset);
+  if (header->version == kBinaryVersionQuantized) {
+    // The scale and offset per dimension, followed by the codes.
+    offset += 2u * header->descriptor_dimensions * sizeof(float) +
+              header->descriptor_dimensions * header->num_observations *
+                  sizeof(int8_t);
+  } else {
+    offset += header->descriptor_dimensions * header->num_observations *
+              sizeof(float);
+  }
+  header->observer_indices_offset = offset = alignSectionOffset(offset);
+  offset += header->num_observations * sizeof(unsigned int);
+  header->observation_to_landmark_index_offset = offset =
+      alignSectionOffset(offset);
+  offset += header->num_observations * sizeof(unsigned int);
+  header->file_size = offset;
+}
+
+bool writeSection(
+    uint64_t section_offset, const void* data, uint64_t num_bytes,
+    std::ofstream* file) {
+  CHECK_NOTNULL(file);
+  const uint64_t position = static_cast<uint64_t>(file->tellp());
+  CHECK_LE(position, section_offset);
+  const std::string padding(section_offset - position, '\0');
+  file->write(padding.data(), padding.size());
+  if (num_bytes > 0u) {
+    file->write(static_cast<const char*>(data), num_bytes);
+  }
+  return file->good();
+}
+
+// Returns the offset behind the copied data.
+template <typename MatrixType>
+uint64_t copySection(
+    const common::MemoryMappedFile& mapped_file, uint64_t section_offset,
+    MatrixType* matrix) {
+  CHECK_NOTNULL(matrix);
+  const size_t num_bytes =
+      matrix->size() * sizeof(typename MatrixType::Scalar);
+  CHECK_LE(section_offset + num_bytes, mapped_file.size());
+  if (num_bytes > 0u) {
+    memcpy(matrix->data(), mapped_file.data() + section_offset, num_bytes);
+  }
+  return section_offset + num_bytes;
+}
+}  // namespace
 
 constexpr char LocalizationSummaryMap::kFileName[];
+constexpr char LocalizationSummaryMap::kBinaryFileName[];
 
 bool LocalizationSummaryMap::operator==(
     const LocalizationSummaryMap& other) const {
@@ -42,8 +144,27 @@ void LocalizationSummaryMap::serialize(
       proto->mutable_uncompressed_map();
   common::eigen_proto::serialize(
       G_observer_position_, uncompressed_map->mutable_g_observer_position());
-  common::eigen_proto::serialize(
-      projected_descriptors_, uncompressed_map->mutable_descriptors());
+  if (FLAGS_localization_summary_map_quantize_descriptors) {
+    QuantizedDescriptors quantized_descriptors;
+    quantizeDescriptors(projected_descriptors_, &quantized_descriptors);
+    proto::QuantizedDescriptors* quantized_descriptors_proto =
+        uncompressed_map->mutable_quantized_descriptors();
+    quantized_descriptors_proto->set_rows(quantized_descriptors.codes.rows());
+    quantized_descriptors_proto->set_cols(quantized_descriptors.codes.cols());
+    for (int dimension = 0; dimension < quantized_descriptors.scale.rows();
+         ++dimension) {
+      quantized_descriptors_proto->add_scale(
+          quantized_descriptors.scale(dimension));
+      quantized_descriptors_proto->add_offset(
+          quantized_descriptors.offset(dimension));
+    }
+    quantized_descriptors_proto->set_codes(
+        reinterpret_cast<const char*>(quantized_descriptors.codes.data()),
+        quantized_descriptors.codes.size());
+  } else {
+    common::eigen_proto::serialize(
+        projected_descriptors_, uncompressed_map->mutable_descriptors());
+  }
   common::eigen_proto::serialize(
       observer_indices_, uncompressed_map->mutable_observer_indices());
   common::eigen_proto::serialize(
@@ -64,21 +185,33 @@ void LocalizationSummaryMap::deserialize(
         proto.uncompressed_map();
     common::eigen_proto::deserialize(
         uncompressed_map.g_observer_position(), &G_observer_position_);
+    initializeObserverIds(G_observer_position_.cols());
 
-    // Create deterministic IDs based on the loc-summary-map-id.
-    constexpr int kMarsennePrime = 131071;
-    const int hash_seed = id_.hashToSizeT() ^ kMarsennePrime;
-    // Generate arbitrary IDs for the vertices. They are only necessary to
-    // communicate with the loop-closure backend and the map.
-    for (int i = 0; i < G_observer_position_.cols(); ++i) {
-      pose_graph::VertexId vertex_id;
-      common::generateIdFromInt(hash_seed + i, &vertex_id);
-      CHECK(vertex_id_to_index_.insert(std::make_pair(vertex_id, i)).second)
-          << "VertexId collision.";
+    if (uncompressed_map.has_quantized_descriptors()) {
+      const proto::QuantizedDescriptors& quantized_descriptors_proto =
+          uncompressed_map.quantized_descriptors();
+      const int num_dimensions = quantized_descriptors_proto.rows();
+      QuantizedDescriptors quantized_descriptors;
+      CHECK_EQ(num_dimensions, quantized_descriptors_proto.scale_size());
+      CHECK_EQ(num_dimensions, quantized_descriptors_proto.offset_size());
+      quantized_descriptors.scale = Eigen::Map<const Eigen::VectorXf>(
+          quantized_descriptors_proto.scale().data(), num_dimensions);
+      quantized_descriptors.offset = Eigen::Map<const Eigen::VectorXf>(
+          quantized_descriptors_proto.offset().data(), num_dimensions);
+      quantized_descriptors.codes.resize(
+          num_dimensions, quantized_descriptors_proto.cols());
+      CHECK_EQ(
+          static_cast<size_t>(quantized_descriptors.codes.size()),
+          quantized_descriptors_proto.codes().size());
+      memcpy(
+          quantized_descriptors.codes.data(),
+          quantized_descriptors_proto.codes().data(),
+          quantized_descriptors_proto.codes().size());
+      dequantizeDescriptors(quantized_descriptors, &projected_descriptors_);
+    } else {
+      common::eigen_proto::deserialize(
+          uncompressed_map.descriptors(), &projected_descriptors_);
     }
-
-    common::eigen_proto::deserialize(
-        uncompressed_map.descriptors(), &projected_descriptors_);
     common::eigen_proto::deserialize(
         uncompressed_map.observer_indices(), &observer_indices_);
     common::eigen_proto::deserialize(
@@ -106,6 +239,12 @@ bool LocalizationSummaryMap::loadFromFolder(
     return false;
   }
 
+  const std::string binary_file_path = common::concatenateFolderAndFileName(
+      common::getRealPath(folder_path), kBinaryFileName);
+  if (common::fileExists(binary_file_path)) {
+    return loadFromBinaryFile(summary_map_id, binary_file_path);
+  }
+
   proto::LocalizationSummaryMap proto;
   if (!common::proto_serialization_helper::parseProtoFromFile(
           folder_path, kFileName, &proto)) {
@@ -132,21 +271,183 @@ bool LocalizationSummaryMap::saveToFolder(
     return false;
   }
 
+  // Remove the file of the other format, as loading prefers the binary one.
+  const std::string proto_file_path =
+      common::concatenateFolderAndFileName(folder_path, kFileName);
+  const std::string binary_file_path =
+      common::concatenateFolderAndFileName(folder_path, kBinaryFileName);
+  const std::string& stale_file_path =
+      FLAGS_localization_summary_map_save_binary ? proto_file_path
+                                                 : binary_file_path;
+  if (common::fileExists(stale_file_path) &&
+      !common::deleteFile(stale_file_path)) {
+    LOG(ERROR) << "Could not remove \"" << stale_file_path << "\".";
+    return false;
+  }
+
+  if (FLAGS_localization_summary_map_save_binary) {
+    return saveToBinaryFile(binary_file_path);
+  }
+
   proto::LocalizationSummaryMap proto;
   serialize(&proto);
   return common::proto_serialization_helper::serializeProtoToFile(
       folder_path, kFileName, proto);
 }
 
+bool LocalizationSummaryMap::saveToBinaryFile(
+    const std::string& file_path) const {
+  CHECK(!file_path.empty());
+  CHECK_EQ(projected_descriptors_.cols(), observer_indices_.rows());
+  CHECK_EQ(
+      projected_descriptors_.cols(), observation_to_landmark_index_.rows());
+
+  BinaryHeader header;
+  memset(&header, 0, sizeof(BinaryHeader));
+  header.magic_number = kBinaryMagicNumber;
+  header.version = FLAGS_localization_summary_map_quantize_descriptors
+                       ? kBinaryVersionQuantized
+                       : kBinaryVersion;
+  header.num_landmarks = G_landmark_position_.cols();
+  header.num_observers = G_observer_position_.cols();
+  header.num_observations = projected_descriptors_.cols();
+  header.descriptor_dimensions = projected_descriptors_.rows();
+  computeBinaryLayout(&header);
+
+  std::ofstream file(file_path, std::ios::out | std::ios::binary);
+  if (!file.is_open()) {
+    LOG(ERROR) << "Could not open \"" << file_path << "\" for writing.";
+    return false;
+  }
+  file.write(reinterpret_cast<const char*>(&header), sizeof(BinaryHeader));
+  bool success =
+      writeSection(
+          header.landmark_position_offset, G_landmark_position_.data(),
+          G_landmark_position_.size() * sizeof(float), &file) &&
+      writeSection(
+          header.observer_position_offset, G_observer_position_.data(),
+          G_observer_position_.size() * sizeof(float), &file);
+  if (header.version == kBinaryVersionQuantized) {
+    QuantizedDescriptors quantized_descriptors;
+    quantizeDescriptors(projected_descriptors_, &quantized_descriptors);
+    const uint64_t dimensions_num_bytes =
+        header.descriptor_dimensions * sizeof(float);
+    success = success &&
+              writeSection(
+                  header.descriptors_offset,
+                  quantized_descriptors.scale.data(), dimensions_num_bytes,
+                  &file) &&
+              writeSection(
+                  header.descriptors_offset + dimensions_num_bytes,
+                  quantized_descriptors.offset.data(), dimensions_num_bytes,
+                  &file) &&
+              writeSection(
+                  header.descriptors_offset + 2u * dimensions_num_bytes,
+                  quantized_descriptors.codes.data(),
+                  quantized_descriptors.codes.size() * sizeof(int8_t),
+                  &file);
+  } else {
+    success = success &&
+              writeSection(
+                  header.descriptors_offset, projected_descriptors_.data(),
+                  projected_descriptors_.size() * sizeof(float), &file);
+  }
+  success = success &&
+            writeSection(
+                header.observer_indices_offset, observer_indices_.data(),
+                observer_indices_.size() * sizeof(unsigned int), &file) &&
+            writeSection(
+                header.observation_to_landmark_index_offset,
+                observation_to_landmark_index_.data(),
+                observation_to_landmark_index_.size() * sizeof(unsigned int),
+                &file) &&
+            writeSection(header.file_size, nullptr, 0u, &file);
+  LOG_IF(ERROR, !success) << "Writing \"" << file_path << "\" failed.";
+  return success;
+}
+
+bool LocalizationSummaryMap::loadFromBinaryFile(
+    const LocalizationSummaryMapId& summary_map_id,
+    const std::string& file_path) {
+  common::MemoryMappedFile mapped_file;
+  if (!mapped_file.open(file_path)) {
+    return false;
+  }
+  BinaryHeader header;
+  if (mapped_file.size() < sizeof(BinaryHeader)) {
+    LOG(ERROR) << "\"" << file_path << "\" is too small for a summary map.";
+    return false;
+  }
+  memcpy(&header, mapped_file.data(), sizeof(BinaryHeader));
+  if (header.magic_number != kBinaryMagicNumber ||
+      (header.version != kBinaryVersion &&
+       header.version != kBinaryVersionQuantized)) {
+    LOG(ERROR) << "\"" << file_path << "\" is not a binary summary map of "
+               << "version " << kBinaryVersion << " or "
+               << kBinaryVersionQuantized << ".";
+    return false;
+  }
+  BinaryHeader expected_layout = header;
+  computeBinaryLayout(&expected_layout);
+  if (memcmp(&header, &expected_layout, sizeof(BinaryHeader)) != 0 ||
+      mapped_file.size() < header.file_size) {
+    LOG(ERROR) << "The binary summary map \"" << file_path
+               << "\" is corrupt or truncated.";
+    return false;
+  }
+  mapped_file.adviseSequentialRead();
+
+  id_ = summary_map_id;
+  G_landmark_position_.resize(Eigen::NoChange, header.num_landmarks);
+  copySection(
+      mapped_file, header.landmark_position_offset, &G_landmark_position_);
+  initializeLandmarkIds(G_landmark_position_.cols());
+
+  G_observer_position_.resize(Eigen::NoChange, header.num_observers);
+  copySection(
+      mapped_file, header.observer_position_offset, &G_observer_position_);
+  initializeObserverIds(G_observer_position_.cols());
+
+  if (header.version == kBinaryVersionQuantized) {
+    QuantizedDescriptors quantized_descriptors;
+    quantized_descriptors.scale.resize(header.descriptor_dimensions);
+    quantized_descriptors.offset.resize(header.descriptor_dimensions);
+    quantized_descriptors.codes.resize(
+        header.descriptor_dimensions, header.num_observations);
+    uint64_t offset = copySection(
+        mapped_file, header.descriptors_offset, &quantized_descriptors.scale);
+    offset =
+        copySection(mapped_file, offset, &quantized_descriptors.offset);
+    copySection(mapped_file, offset, &quantized_descriptors.codes);
+    dequantizeDescriptors(quantized_descriptors, &projected_descriptors_);
+  } else {
+    projected_descriptors_.resize(
+        header.descriptor_dimensions, header.num_observations);
+    copySection(
+        mapped_file, header.descriptors_offset, &projected_descriptors_);
+  }
+  observer_indices_.resize(header.num_observations);
+  copySection(mapped_file, header.observer_indices_offset, &observer_indices_);
+  observation_to_landmark_index_.resize(header.num_observations);
+  copySection(
+      mapped_file, header.observation_to_landmark_index_offset,
+      &observation_to_landmark_index_);
+  return true;
+}
+
 bool LocalizationSummaryMap::hasMapOnFileSystem(
     const std::string& folder_path) {
   CHECK(!folder_path.empty());
   if (!common::pathExists(folder_path)) {
     return false;
   }
-  const std::string complete_file_name = common::concatenateFolderAndFileName(
-      common::getRealPath(folder_path), kFileName);
-  return common::fileExists(complete_file_name);
+  const std::string real_folder_path = common::getRealPath(folder_path);
+  return common::fileExists(
+             common::concatenateFolderAndFileName(
+                 real_folder_path, kFileName)) ||
+         common::fileExists(
+             common::concatenateFolderAndFileName(
+                 real_folder_path, kBinaryFileName));
 }
 
 bool LocalizationSummaryMap::hasLandmark(
@@ -215,6 +516,7 @@ void LocalizationSummaryMap::setGLandmarkPosition(
 
 void LocalizationSummaryMap::initializeLandmarkIds(int num_landmarks) {
   landmark_id_to_landmark_index_.clear();
+  landmark_id_to_landmark_index_.reserve(num_landmarks);
 
   // Create deterministic IDs based on the loc-summary-map-id.
   constexpr int kMarsennePrime = 524287;
@@ -231,6 +533,23 @@ void LocalizationSummaryMap::initializeLandmarkIds(int num_landmarks) {
   }
 }
 
+void LocalizationSummaryMap::initializeObserverIds(int num_observers) {
+  vertex_id_to_index_.clear();
+  vertex_id_to_index_.reserve(num_observers);
+
+  // Create deterministic IDs based on the loc-summary-map-id.
+  constexpr int kMarsennePrime = 131071;
+  const int hash_seed = id_.hashToSizeT() ^ kMarsennePrime;
+  // Generate arbitrary IDs for the vertices. They are only necessary to
+  // communicate with the loop-closure backend and the map.
+  for (int i = 0; i < num_observers; ++i) {
+    pose_graph::VertexId vertex_id;
+    common::generateIdFromInt(hash_seed + i, &vertex_id);
+    CHECK(vertex_id_to_index_.insert(std::make_pair(vertex_id, i)).second)
+        << "VertexId collision.";
+  }
+}
+
 void LocalizationSummaryMap::setGObserverPosition(
     const Eigen::Matrix3Xd& G_observer_position) {
   G_observer_position_ = G_observer_position.cast<float>();
@@ -0,0 +1,332 @@
+#include "localization-summary-map/projected-descriptor-cache.h"
+
+#include <random>
+#include <sstream>  // NOLINT
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/binary-serialization.h>
+#include <vi-map/vi-map.h>
+
+DEFINE_bool(
+    lc_use_projected_descriptor_cache, false,
+    "Store the projected descriptors of the visual frames as mission "
+    "resources of the map and reuse them in later runs of the loop closure "
+    "and the summary map creation, as long as the projection and the "
+    "descriptors haven't changed. The map needs to be saved to keep them.");
+
+namespace summary_map {
+
+namespace {
+constexpr uint64_t kFnvOffsetBasis = 14695981039346656037ull;
+constexpr uint64_t kFnvPrime = 1099511628211ull;
+
+// 64 bit FNV-1a hash.
+uint64_t hashBytes(const char* data, const size_t num_bytes, uint64_t hash) {
+  for (size_t byte_idx = 0u; byte_idx < num_bytes; ++byte_idx) {
+    hash ^= static_cast<unsigned char>(data[byte_idx]);
+    hash *= kFnvPrime;
+  }
+  return hash;
+}
+
+template <typename Value>
+uint64_t hashValue(const Value& value, const uint64_t hash) {
+  return hashBytes(reinterpret_cast<const char*>(&value), sizeof(value), hash);
+}
+
+size_t getNumRemainingBytes(const std::string& data, std::istream* in) {
+  CHECK_NOTNULL(in);
+  const std::streamoff position = in->tellg();
+  CHECK_GE(position, 0);
+  return data.size() - static_cast<size_t>(position);
+}
+
+const char kMagic[] = "MLPD";
+constexpr size_t kMagicSize = 4u;
+constexpr size_t kNumProbeDescriptors = 8u;
+// IDs are serialized as hex string with its length.
+constexpr size_t kSerializedIdSize =
+    sizeof(uint32_t) + 2u * sizeof(aslam::HashId);
+}  // namespace
+
+constexpr uint32_t ProjectedDescriptorCache::kSerializationVersion;
+
+ProjectedDescriptorCache::ProjectedDescriptorCache(
+    const ProjectionFunction& project)
+    : project_(project), num_cache_hits_(0u), num_cache_misses_(0u) {
+  CHECK(project_);
+}
+
+void ProjectedDescriptorCache::getProjectedDescriptors(
+    const vi_map::VIMap& map, const vi_map::VisualFrameIdentifier& frame_id,
+    const aslam::VisualFrame::DescriptorsT& descriptors,
+    Eigen::MatrixXf* projected_descriptors) {
+  CHECK_NOTNULL(projected_descriptors);
+  const vi_map::MissionId& mission_id =
+      map.getVertex(frame_id.vertex_id).getMissionId();
+  const uint64_t descriptor_hash = hashDescriptors(descriptors);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const MissionCache& mission_cache = getMissionCache(map, mission_id);
+    const FrameToCachedFrameMap::const_iterator it =
+        mission_cache.frames.find(frame_id);
+    if (it != mission_cache.frames.cend() &&
+        it->second.descriptor_hash == descriptor_hash &&
+        mission_cache.descriptor_size_bytes ==
+            static_cast<uint32_t>(descriptors.rows())) {
+      *projected_descriptors = it->second.projected_descriptors;
+      ++num_cache_hits_;
+      return;
+    }
+    ++num_cache_misses_;
+  }
+
+  // Projects without holding the lock.
+  project_(descriptors, projected_descriptors);
+  CHECK_EQ(projected_descriptors->cols(), descriptors.cols());
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  MissionCache& mission_cache = getMissionCache(map, mission_id);
+  if (mission_cache.descriptor_size_bytes !=
+      static_cast<uint32_t>(descriptors.rows())) {
+    // The descriptor type changed, which invalidates the whole mission.
+    mission_cache.frames.clear();
+    mission_cache.descriptor_size_bytes =
+        static_cast<uint32_t>(descriptors.rows());
+  }
+  CachedFrame& cached_frame = mission_cache.frames[frame_id];
+  cached_frame.descriptor_hash = descriptor_hash;
+  cached_frame.projected_descriptors = *projected_descriptors;
+  mission_cache.is_modified = true;
+}
+
+void ProjectedDescriptorCache::saveToMap(vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  if (!map->hasMapFolder()) {
+    LOG(WARNING) << "The map has no map folder, the projected descriptors "
+                 << "are not stored.";
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (std::unordered_map<vi_map::MissionId, MissionCache>::value_type&
+           mission_id_and_cache : mission_caches_) {
+    const vi_map::MissionId& mission_id = mission_id_and_cache.first;
+    MissionCache& mission_cache = mission_id_and_cache.second;
+    if (!mission_cache.is_modified || !map->hasMission(mission_id)) {
+      continue;
+    }
+    FrameToCachedFrameMap::iterator it = mission_cache.frames.begin();
+    while (it != mission_cache.frames.end()) {
+      if (map->hasVertex(it->first.vertex_id)) {
+        ++it;
+      } else {
+        it = mission_cache.frames.erase(it);
+      }
+    }
+    std::string data;
+    serializeMissionCache(mission_cache, &data);
+    VLOG(1) << "Storing " << mission_cache.frames.size()
+            << " frames of projected descriptors of mission " << mission_id
+            << '.';
+    map->replaceProjectedDescriptorCache({mission_id}, data);
+    mission_cache.is_modified = false;
+  }
+}
+
+size_t ProjectedDescriptorCache::numCacheHits() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_cache_hits_;
+}
+
+size_t ProjectedDescriptorCache::numCacheMisses() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_cache_misses_;
+}
+
+void ProjectedDescriptorCache::serializeMission(
+    const vi_map::MissionId& mission_id, std::string* data) {
+  CHECK_NOTNULL(data)->clear();
+  std::lock_guard<std::mutex> lock(mutex_);
+  const std::unordered_map<vi_map::MissionId, MissionCache>::const_iterator
+      it = mission_caches_.find(mission_id);
+  if (it != mission_caches_.cend()) {
+    serializeMissionCache(it->second, data);
+  }
+}
+
+bool ProjectedDescriptorCache::deserializeMission(
+    const vi_map::MissionId& mission_id, const std::string& data) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  MissionCache mission_cache;
+  if (!deserializeMissionCache(data, &mission_cache)) {
+    return false;
+  }
+  mission_caches_[mission_id] = std::move(mission_cache);
+  return true;
+}
+
+uint64_t ProjectedDescriptorCache::hashDescriptors(
+    const aslam::VisualFrame::DescriptorsT& descriptors) {
+  uint64_t hash = hashValue(descriptors.rows(), kFnvOffsetBasis);
+  hash = hashValue(descriptors.cols(), hash);
+  return hashBytes(
+      reinterpret_cast<const char*>(descriptors.data()),
+      descriptors.size() * sizeof(aslam::VisualFrame::DescriptorsT::Scalar),
+      hash);
+}
+
+ProjectedDescriptorCache::MissionCache&
+ProjectedDescriptorCache::getMissionCache(
+    const vi_map::VIMap& map, const vi_map::MissionId& mission_id) {
+  std::unordered_map<vi_map::MissionId, MissionCache>::iterator it =
+      mission_caches_.find(mission_id);
+  if (it != mission_caches_.end()) {
+    return it->second;
+  }
+  MissionCache& mission_cache = mission_caches_[mission_id];
+  std::string data;
+  if (map.hasProjectedDescriptorCache({mission_id}) &&
+      map.getProjectedDescriptorCache({mission_id}, &data)) {
+    if (deserializeMissionCache(data, &mission_cache)) {
+      VLOG(1) << "Loaded " << mission_cache.frames.size()
+              << " frames of projected descriptors of mission " << mission_id
+              << '.';
+    } else {
+      VLOG(1) << "The projected descriptors of mission " << mission_id
+              << " have been stored with another projection and are "
+              << "discarded.";
+      mission_cache = MissionCache();
+      // Replaces the outdated resource on the next save.
+      mission_cache.is_modified = true;
+    }
+  }
+  return mission_cache;
+}
+
+uint64_t ProjectedDescriptorCache::getProjectionFingerprint(
+    const uint32_t descriptor_size_bytes) {
+  std::unordered_map<uint32_t, uint64_t>::const_iterator it =
+      projection_fingerprints_.find(descriptor_size_bytes);
+  if (it != projection_fingerprints_.cend()) {
+    return it->second;
+  }
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<int> byte_distribution(0, 255);
+  aslam::VisualFrame::DescriptorsT probe_descriptors(
+      descriptor_size_bytes, kNumProbeDescriptors);
+  for (int col = 0; col < probe_descriptors.cols(); ++col) {
+    for (int row = 0; row < probe_descriptors.rows(); ++row) {
+      probe_descriptors(row, col) =
+          static_cast<unsigned char>(byte_distribution(generator));
+    }
+  }
+  Eigen::MatrixXf projected_probe_descriptors;
+  project_(probe_descriptors, &projected_probe_descriptors);
+  uint64_t fingerprint =
+      hashValue(projected_probe_descriptors.rows(), kFnvOffsetBasis);
+  fingerprint = hashBytes(
+      reinterpret_cast<const char*>(projected_probe_descriptors.data()),
+      projected_probe_descriptors.size() * sizeof(float), fingerprint);
+  projection_fingerprints_.emplace(descriptor_size_bytes, fingerprint);
+  return fingerprint;
+}
+
+void ProjectedDescriptorCache::serializeMissionCache(
+    const MissionCache& mission_cache, std::string* data) {
+  CHECK_NOTNULL(data);
+  std::ostringstream out;
+  common::Serialize(kMagic, kMagicSize, &out);
+  common::Serialize(kSerializationVersion, &out);
+  common::Serialize(mission_cache.descriptor_size_bytes, &out);
+  const uint64_t fingerprint =
+      getProjectionFingerprint(mission_cache.descriptor_size_bytes);
+  common::Serialize(fingerprint, &out);
+  common::Serialize(static_cast<uint64_t>(mission_cache.frames.size()), &out);
+  for (const FrameToCachedFrameMap::value_type& frame_id_and_cached_frame :
+       mission_cache.frames) {
+    const vi_map::VisualFrameIdentifier& frame_id =
+        frame_id_and_cached_frame.first;
+    const CachedFrame& cached_frame = frame_id_and_cached_frame.second;
+    common::Serialize(frame_id.vertex_id, &out);
+    common::Serialize(static_cast<uint32_t>(frame_id.frame_index), &out);
+    common::Serialize(cached_frame.descriptor_hash, &out);
+    common::Serialize(
+        static_cast<uint32_t>(cached_frame.projected_descriptors.rows()),
+        &out);
+    common::Serialize(
+        static_cast<uint32_t>(cached_frame.projected_descriptors.cols()),
+        &out);
+    common::Serialize(
+        reinterpret_cast<const char*>(
+            cached_frame.projected_descriptors.data()),
+        cached_frame.projected_descriptors.size() * sizeof(float), &out);
+  }
+  *data = out.str();
+}
+
+bool ProjectedDescriptorCache::deserializeMissionCache(
+    const std::string& data, MissionCache* mission_cache) {
+  CHECK_NOTNULL(mission_cache)->frames.clear();
+  constexpr size_t kHeaderSize = kMagicSize + 2u * sizeof(uint32_t) +
+                                 2u * sizeof(uint64_t);
+  if (data.size() < kHeaderSize || data.compare(0u, kMagicSize, kMagic) != 0) {
+    VLOG(1) << "The projected descriptor cache is corrupt.";
+    return false;
+  }
+  std::istringstream in(data);
+  in.seekg(kMagicSize);
+  uint32_t version;
+  common::Deserialize(&version, &in);
+  if (version != kSerializationVersion) {
+    VLOG(1) << "The projected descriptor cache has version " << version
+            << " instead of " << kSerializationVersion << '.';
+    return false;
+  }
+  common::Deserialize(&mission_cache->descriptor_size_bytes, &in);
+  uint64_t fingerprint;
+  common::Deserialize(&fingerprint, &in);
+  if (fingerprint !=
+      getProjectionFingerprint(mission_cache->descriptor_size_bytes)) {
+    return false;
+  }
+  uint64_t num_frames;
+  common::Deserialize(&num_frames, &in);
+
+  constexpr size_t kFrameHeaderSize =
+      kSerializedIdSize + 3u * sizeof(uint32_t) + sizeof(uint64_t);
+  mission_cache->frames.reserve(num_frames);
+  for (uint64_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+    if (getNumRemainingBytes(data, &in) < kFrameHeaderSize) {
+      VLOG(1) << "The projected descriptor cache is truncated.";
+      mission_cache->frames.clear();
+      return false;
+    }
+    vi_map::VisualFrameIdentifier frame_id;
+    common::Deserialize(&frame_id.vertex_id, &in);
+    uint32_t frame_index;
+    common::Deserialize(&frame_index, &in);
+    frame_id.frame_index = frame_index;
+    CachedFrame& cached_frame = mission_cache->frames[frame_id];
+    common::Deserialize(&cached_frame.descriptor_hash, &in);
+    uint32_t rows, cols;
+    common::Deserialize(&rows, &in);
+    common::Deserialize(&cols, &in);
+    const size_t num_bytes =
+        static_cast<size_t>(rows) * static_cast<size_t>(cols) * sizeof(float);
+    if (getNumRemainingBytes(data, &in) < num_bytes) {
+      VLOG(1) << "The projected descriptor cache is truncated.";
+      mission_cache->frames.clear();
+      return false;
+    }
+    cached_frame.projected_descriptors.resize(rows, cols);
+    common::Deserialize(
+        reinterpret_cast<char*>(cached_frame.projected_descriptors.data()),
+        num_bytes, &in);
+  }
+  return true;
+}
+
+}  // namespace summary_map
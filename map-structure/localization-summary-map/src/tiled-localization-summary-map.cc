@@ -0,0 +1,212 @@
+#include "localization-summary-map/tiled-localization-summary-map.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/file-system-tools.h>
+#include <maplab-common/memory-accounting.h>
+#include <maplab-common/proto-serialization-helper.h>
+#include <maplab-common/unique-id.h>
+
+#include "localization-summary-map/localization-summary-map-creation.h"
+#include "localization-summary-map/localization-summary-map.pb.h"
+
+namespace summary_map {
+namespace {
+size_t getSummaryMapBytes(const LocalizationSummaryMap& summary_map) {
+  return common::getHeapBytes(summary_map.GLandmarkPosition()) +
+         common::getHeapBytes(summary_map.GObserverPosition()) +
+         common::getHeapBytes(summary_map.projectedDescriptors()) +
+         common::getHeapBytes(summary_map.observerIndices()) +
+         common::getHeapBytes(summary_map.observationToLandmarkIndex());
+}
+
+std::string getTileFolderName(const int x, const int y) {
+  return "tile_" + std::to_string(x) + "_" + std::to_string(y);
+}
+}  // namespace
+
+constexpr char TiledLocalizationSummaryMap::kDirectoryFileName[];
+
+TiledLocalizationSummaryMap::TiledLocalizationSummaryMap()
+    : tile_size_m_(0.0) {}
+
+bool TiledLocalizationSummaryMap::saveTilesToFolder(
+    const LocalizationSummaryMap& summary_map, const double tile_size_m,
+    const std::string& folder_path, const backend::SaveConfig& config) {
+  CHECK_GT(tile_size_m, 0.0);
+  CHECK(!folder_path.empty());
+  if (!config.overwrite_existing_files && hasTilesOnFileSystem(folder_path)) {
+    LOG(ERROR) << "A tiled summary map already exists under \"" << folder_path
+               << "\".";
+    return false;
+  }
+  if (!common::createPath(folder_path)) {
+    LOG(ERROR) << "Creating path to \"" << folder_path << "\" failed.";
+    return false;
+  }
+
+  // Ordered, such that the tiles are saved in a deterministic order.
+  std::map<std::pair<int, int>, std::vector<int>> tile_to_landmark_indices;
+  const Eigen::Matrix3Xf& G_landmark_position = summary_map.GLandmarkPosition();
+  for (int landmark_idx = 0; landmark_idx < G_landmark_position.cols();
+       ++landmark_idx) {
+    const int x = static_cast<int>(
+        std::floor(G_landmark_position(0, landmark_idx) / tile_size_m));
+    const int y = static_cast<int>(
+        std::floor(G_landmark_position(1, landmark_idx) / tile_size_m));
+    tile_to_landmark_indices[std::make_pair(x, y)].push_back(landmark_idx);
+  }
+
+  proto::LocalizationSummaryMapTileDirectory directory;
+  directory.set_tile_size_m(tile_size_m);
+  for (const std::pair<const std::pair<int, int>, std::vector<int>>&
+           tile_and_landmark_indices : tile_to_landmark_indices) {
+    const int x = tile_and_landmark_indices.first.first;
+    const int y = tile_and_landmark_indices.first.second;
+    LocalizationSummaryMap tile_summary_map;
+    LocalizationSummaryMapId tile_summary_map_id;
+    common::generateId(&tile_summary_map_id);
+    tile_summary_map.setId(tile_summary_map_id);
+    createLocalizationSummaryMapFromLandmarkIndices(
+        summary_map, tile_and_landmark_indices.second, &tile_summary_map);
+
+    const std::string folder_name = getTileFolderName(x, y);
+    if (!tile_summary_map.saveToFolder(
+            common::concatenateFolderAndFileName(folder_path, folder_name),
+            config)) {
+      LOG(ERROR) << "Saving the tile " << folder_name << " failed.";
+      return false;
+    }
+
+    proto::LocalizationSummaryMapTile* proto_tile = directory.add_tiles();
+    proto_tile->set_x(x);
+    proto_tile->set_y(y);
+    proto_tile->set_num_landmarks(tile_and_landmark_indices.second.size());
+    proto_tile->set_num_bytes(getSummaryMapBytes(tile_summary_map));
+    proto_tile->set_folder_name(folder_name);
+  }
+  VLOG(1) << "Saved " << directory.tiles_size() << " tiles of "
+          << tile_size_m << " m to \"" << folder_path << "\".";
+  return common::proto_serialization_helper::serializeProtoToFile(
+      folder_path, kDirectoryFileName, directory);
+}
+
+bool TiledLocalizationSummaryMap::hasTilesOnFileSystem(
+    const std::string& folder_path) {
+  CHECK(!folder_path.empty());
+  if (!common::pathExists(folder_path)) {
+    return false;
+  }
+  return common::fileExists(
+      common::concatenateFolderAndFileName(
+          common::getRealPath(folder_path), kDirectoryFileName));
+}
+
+bool TiledLocalizationSummaryMap::loadFromFolder(
+    const std::string& folder_path) {
+  CHECK(!folder_path.empty());
+  if (!hasTilesOnFileSystem(folder_path)) {
+    LOG(ERROR) << "No tiled summary map could be found under \""
+               << folder_path << "\".";
+    return false;
+  }
+
+  proto::LocalizationSummaryMapTileDirectory directory;
+  if (!common::proto_serialization_helper::parseProtoFromFile(
+          folder_path, kDirectoryFileName, &directory)) {
+    LOG(ERROR) << "The tile directory under \"" << folder_path
+               << "\" couldn't be parsed by protobuf.";
+    return false;
+  }
+  if (directory.tile_size_m() <= 0.0) {
+    LOG(ERROR) << "Invalid tile size " << directory.tile_size_m() << ".";
+    return false;
+  }
+
+  tile_size_m_ = directory.tile_size_m();
+  folder_path_ = common::getRealPath(folder_path);
+  tiles_.clear();
+  tiles_.reserve(directory.tiles_size());
+  for (const proto::LocalizationSummaryMapTile& proto_tile :
+       directory.tiles()) {
+    Tile tile;
+    tile.x = proto_tile.x();
+    tile.y = proto_tile.y();
+    tile.num_landmarks = proto_tile.num_landmarks();
+    tile.num_bytes = proto_tile.num_bytes();
+    tile.folder_name = proto_tile.folder_name();
+    tiles_.push_back(tile);
+  }
+  return true;
+}
+
+double TiledLocalizationSummaryMap::getDistanceToTile(
+    const Eigen::Vector3d& p_G, const Tile& tile) const {
+  const Eigen::Vector2d tile_min(tile.x * tile_size_m_, tile.y * tile_size_m_);
+  const Eigen::Vector2d tile_max =
+      tile_min + Eigen::Vector2d::Constant(tile_size_m_);
+  const Eigen::Vector2d p_G_xy = p_G.head<2>();
+  const Eigen::Vector2d closest_point =
+      p_G_xy.cwiseMax(tile_min).cwiseMin(tile_max);
+  return (p_G_xy - closest_point).norm();
+}
+
+void TiledLocalizationSummaryMap::getTilesSortedByDistance(
+    const Eigen::Vector3d& p_G, std::vector<size_t>* tile_indices) const {
+  CHECK_NOTNULL(tile_indices)->clear();
+  std::vector<std::pair<double, size_t>> distance_and_tile_indices;
+  distance_and_tile_indices.reserve(tiles_.size());
+  for (size_t tile_idx = 0u; tile_idx < tiles_.size(); ++tile_idx) {
+    distance_and_tile_indices.emplace_back(
+        getDistanceToTile(p_G, tiles_[tile_idx]), tile_idx);
+  }
+  std::sort(
+      distance_and_tile_indices.begin(), distance_and_tile_indices.end());
+  tile_indices->reserve(distance_and_tile_indices.size());
+  for (const std::pair<double, size_t>& distance_and_tile_index :
+       distance_and_tile_indices) {
+    tile_indices->push_back(distance_and_tile_index.second);
+  }
+}
+
+void TiledLocalizationSummaryMap::getTilesWithinRadius(
+    const Eigen::Vector3d& p_G, const double radius_m,
+    std::vector<size_t>* tile_indices) const {
+  CHECK_NOTNULL(tile_indices);
+  CHECK_GE(radius_m, 0.0);
+  getTilesSortedByDistance(p_G, tile_indices);
+  const std::vector<size_t>::iterator first_outside = std::find_if(
+      tile_indices->begin(), tile_indices->end(),
+      [this, &p_G, radius_m](const size_t tile_idx) {
+        return getDistanceToTile(p_G, tiles_[tile_idx]) > radius_m;
+      });
+  tile_indices->erase(first_outside, tile_indices->end());
+}
+
+LocalizationSummaryMap::Ptr TiledLocalizationSummaryMap::loadTile(
+    const size_t tile_index) const {
+  const Tile& tile = getTile(tile_index);
+  LocalizationSummaryMap::Ptr summary_map =
+      aligned_shared<LocalizationSummaryMap>();
+  if (!summary_map->loadFromFolder(
+          common::concatenateFolderAndFileName(
+              folder_path_, tile.folder_name))) {
+    LOG(ERROR) << "Loading the tile " << tile.folder_name << " failed.";
+    return nullptr;
+  }
+  return summary_map;
+}
+
+const TiledLocalizationSummaryMap::Tile& TiledLocalizationSummaryMap::getTile(
+    const size_t tile_index) const {
+  CHECK_LT(tile_index, tiles_.size());
+  return tiles_[tile_index];
+}
+
+}  // namespace summary_map
@@ -0,0 +1,61 @@
+#include <Eigen/Core>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+
+#include "localization-summary-map/descriptor-quantization.h"
+
+namespace summary_map {
+
+TEST(DescriptorQuantizationTest, ErrorIsBoundedByHalfAStep) {
+  constexpr int kNumDimensions = 10;
+  constexpr int kNumDescriptors = 1000;
+  std::srand(42);
+  Eigen::MatrixXf descriptors =
+      Eigen::MatrixXf::Random(kNumDimensions, kNumDescriptors);
+  // Dimensions with different ranges, including a constant one.
+  descriptors.row(1) *= 100.f;
+  descriptors.row(2).array() += 5.f;
+  descriptors.row(3).setConstant(-3.f);
+
+  QuantizedDescriptors quantized_descriptors;
+  quantizeDescriptors(descriptors, &quantized_descriptors);
+  ASSERT_EQ(kNumDimensions, quantized_descriptors.codes.rows());
+  ASSERT_EQ(kNumDescriptors, quantized_descriptors.codes.cols());
+
+  Eigen::MatrixXf dequantized_descriptors;
+  dequantizeDescriptors(quantized_descriptors, &dequantized_descriptors);
+  ASSERT_EQ(kNumDimensions, dequantized_descriptors.rows());
+  ASSERT_EQ(kNumDescriptors, dequantized_descriptors.cols());
+  for (int dimension = 0; dimension < kNumDimensions; ++dimension) {
+    const float max_error =
+        (descriptors.row(dimension).maxCoeff() -
+         descriptors.row(dimension).minCoeff()) /
+            (2.f * 255.f) +
+        1e-5f * (1.f + descriptors.row(dimension).cwiseAbs().maxCoeff());
+    EXPECT_LE(
+        (descriptors.row(dimension) - dequantized_descriptors.row(dimension))
+            .cwiseAbs()
+            .maxCoeff(),
+        max_error);
+  }
+  EXPECT_EQ(descriptors.row(3), dequantized_descriptors.row(3));
+
+  // The extremes of every dimension map to the outermost codes.
+  EXPECT_EQ(-128, quantized_descriptors.codes.row(0).minCoeff());
+  EXPECT_EQ(127, quantized_descriptors.codes.row(0).maxCoeff());
+}
+
+TEST(DescriptorQuantizationTest, EmptyDescriptors) {
+  const Eigen::MatrixXf descriptors(10, 0);
+  QuantizedDescriptors quantized_descriptors;
+  quantizeDescriptors(descriptors, &quantized_descriptors);
+  Eigen::MatrixXf dequantized_descriptors;
+  dequantizeDescriptors(quantized_descriptors, &dequantized_descriptors);
+  EXPECT_EQ(10, dequantized_descriptors.rows());
+  EXPECT_EQ(0, dequantized_descriptors.cols());
+}
+
+}  // namespace summary_map
+
+MAPLAB_UNITTEST_ENTRYPOINT
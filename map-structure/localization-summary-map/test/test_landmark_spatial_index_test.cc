@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "localization-summary-map/landmark-spatial-index.h"
+
+namespace summary_map {
+
+void getLandmarkIndicesWithinRadiusBruteForce(
+    const Eigen::Matrix3Xf& G_landmark_position, const Eigen::Vector3d& p_G,
+    const double radius_m, std::vector<int>* landmark_indices) {
+  CHECK_NOTNULL(landmark_indices)->clear();
+  for (int i = 0; i < G_landmark_position.cols(); ++i) {
+    if ((G_landmark_position.col(i).cast<double>() - p_G).norm() <=
+        radius_m) {
+      landmark_indices->push_back(i);
+    }
+  }
+}
+
+TEST(LandmarkSpatialIndexTest, RadiusQueryMatchesBruteForce) {
+  constexpr int kNumLandmarks = 5000;
+  constexpr double kMapExtentMeters = 100.0;
+  std::mt19937 random_engine(42);
+  std::uniform_real_distribution<double> coordinate_distribution(
+      -kMapExtentMeters / 2.0, kMapExtentMeters / 2.0);
+
+  Eigen::Matrix3Xf G_landmark_position(3, kNumLandmarks);
+  for (int i = 0; i < kNumLandmarks; ++i) {
+    G_landmark_position.col(i) << coordinate_distribution(random_engine),
+        coordinate_distribution(random_engine),
+        coordinate_distribution(random_engine);
+  }
+
+  constexpr double kCellSizeMeters = 7.0;
+  LandmarkSpatialIndex index(G_landmark_position, kCellSizeMeters);
+  EXPECT_EQ(static_cast<size_t>(kNumLandmarks), index.numLandmarks());
+
+  constexpr int kNumQueries = 100;
+  const std::vector<double> kRadiiMeters = {0.0, 3.0, 10.0, 25.0, 200.0};
+  for (int query_idx = 0; query_idx < kNumQueries; ++query_idx) {
+    const Eigen::Vector3d p_G(
+        coordinate_distribution(random_engine),
+        coordinate_distribution(random_engine),
+        coordinate_distribution(random_engine));
+    for (const double radius_m : kRadiiMeters) {
+      std::vector<int> expected_indices;
+      getLandmarkIndicesWithinRadiusBruteForce(
+          G_landmark_position, p_G, radius_m, &expected_indices);
+      std::vector<int> landmark_indices;
+      index.getLandmarkIndicesWithinRadius(p_G, radius_m, &landmark_indices);
+      EXPECT_EQ(expected_indices, landmark_indices);
+    }
+  }
+
+  // A query at a landmark position with zero radius returns the landmark.
+  std::vector<int> landmark_indices;
+  index.getLandmarkIndicesWithinRadius(
+      G_landmark_position.col(17).cast<double>(), 0.0, &landmark_indices);
+  ASSERT_EQ(1u, landmark_indices.size());
+  EXPECT_EQ(17, landmark_indices[0]);
+}
+
+TEST(LandmarkSpatialIndexTest, EmptyIndex) {
+  const Eigen::Matrix3Xf G_landmark_position(3, 0);
+  constexpr double kCellSizeMeters = 1.0;
+  LandmarkSpatialIndex index(G_landmark_position, kCellSizeMeters);
+  std::vector<int> landmark_indices = {1, 2};
+  index.getLandmarkIndicesWithinRadius(
+      Eigen::Vector3d::Zero(), 10.0, &landmark_indices);
+  EXPECT_TRUE(landmark_indices.empty());
+}
+
+}  // namespace summary_map
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -3,6 +3,8 @@
 
 #include <Eigen/Core>
 #include <aslam/common/hash-id.h>
+#include <gflags/gflags.h>
+#include <maplab-common/map-manager-config.h>
 #include <maplab-common/pose_types.h>
 #include <maplab-common/test/testing-entrypoint.h>
 #include <maplab-common/test/testing-predicates.h>
@@ -15,6 +17,9 @@
 #include "localization-summary-map/localization-summary-map.h"
 #include "localization-summary-map/localization-summary-map.pb.h"
 
+DECLARE_bool(localization_summary_map_quantize_descriptors);
+DECLARE_bool(localization_summary_map_save_binary);
+
 namespace summary_map {
 
 class LocalizationSummaryMapTest : public ::testing::Test {
@@ -123,6 +128,68 @@ TEST_F(
   EXPECT_NE(*initial_summary_map_, *summary_map_from_msg_);
 }
 
+TEST_F(LocalizationSummaryMapTest, LocalizationSummaryMapBinaryFileTest) {
+  constructLocalizationSummaryMap();
+  const std::string kFolder = "localization_summary_map_binary_test";
+  backend::SaveConfig save_config;
+  save_config.overwrite_existing_files = true;
+
+  FLAGS_localization_summary_map_save_binary = true;
+  ASSERT_TRUE(initial_summary_map_->saveToFolder(kFolder, save_config));
+  EXPECT_TRUE(LocalizationSummaryMap::hasMapOnFileSystem(kFolder));
+  LocalizationSummaryMap binary_summary_map;
+  ASSERT_TRUE(
+      binary_summary_map.loadFromFolder(initial_summary_map_->id(), kFolder));
+  EXPECT_EQ(*initial_summary_map_, binary_summary_map);
+  pose_graph::VertexIdList binary_observer_ids;
+  binary_summary_map.getAllObserverIds(&binary_observer_ids);
+  EXPECT_EQ(
+      static_cast<size_t>(initial_summary_map_->GObserverPosition().cols()),
+      binary_observer_ids.size());
+
+  // Saving as protobuf replaces the binary file.
+  FLAGS_localization_summary_map_save_binary = false;
+  ASSERT_TRUE(initial_summary_map_->saveToFolder(kFolder, save_config));
+  LocalizationSummaryMap proto_summary_map;
+  ASSERT_TRUE(
+      proto_summary_map.loadFromFolder(initial_summary_map_->id(), kFolder));
+  EXPECT_EQ(*initial_summary_map_, proto_summary_map);
+}
+
+TEST_F(LocalizationSummaryMapTest, QuantizedDescriptorsFileTest) {
+  constructLocalizationSummaryMap();
+  const std::string kFolder = "localization_summary_map_quantized_test";
+  backend::SaveConfig save_config;
+  save_config.overwrite_existing_files = true;
+
+  // The random descriptors are in [-1, 1], so the quantization error is at
+  // most 1 / 255.
+  constexpr double kMaxQuantizationError = 1.0 / 255.0 + 1e-6;
+  FLAGS_localization_summary_map_quantize_descriptors = true;
+  for (const bool save_binary : {false, true}) {
+    FLAGS_localization_summary_map_save_binary = save_binary;
+    ASSERT_TRUE(initial_summary_map_->saveToFolder(kFolder, save_config));
+    LocalizationSummaryMap loaded_summary_map;
+    ASSERT_TRUE(
+        loaded_summary_map.loadFromFolder(
+            initial_summary_map_->id(), kFolder));
+    EXPECT_EQ(
+        initial_summary_map_->GLandmarkPosition(),
+        loaded_summary_map.GLandmarkPosition());
+    EXPECT_EQ(
+        initial_summary_map_->observerIndices(),
+        loaded_summary_map.observerIndices());
+    EXPECT_EQ(
+        initial_summary_map_->observationToLandmarkIndex(),
+        loaded_summary_map.observationToLandmarkIndex());
+    EXPECT_NEAR_EIGEN(
+        initial_summary_map_->projectedDescriptors(),
+        loaded_summary_map.projectedDescriptors(), kMaxQuantizationError);
+  }
+  FLAGS_localization_summary_map_quantize_descriptors = false;
+  FLAGS_localization_summary_map_save_binary = false;
+}
+
 }  // namespace summary_map
 
 MAPLAB_UNITTEST_ENTRYPOINT
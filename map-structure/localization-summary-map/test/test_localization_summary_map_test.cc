@@ -1,4 +1,5 @@
 #include <memory>
+#include <vector>
 
 #include <Eigen/Core>
 #include <aslam/common/hash-id.h>
@@ -85,4 +86,121 @@ TEST_F(LocalizationSummaryMapTest, LocalizationSummaryCreationFromMapTest) {
   EXPECT_EQ(2, landmark_observers(4, 0));
 }
 
+TEST_F(LocalizationSummaryMapTest, SummaryMapFromLandmarkIndicesTest) {
+  summary_map::LocalizationSummaryMap summary_map;
+  summary_map::LocalizationSummaryMapId id;
+  common::generateId(&id);
+  summary_map.setId(id);
+
+  vi_map::LandmarkIdList summary_landmark_ids;
+  summary_landmark_ids.push_back(landmark_1_id_);
+  summary_landmark_ids.push_back(landmark_2_id_);
+  summary_landmark_ids.push_back(landmark_3_id_);
+  summary_map::createLocalizationSummaryMapFromLandmarkList(
+      map_, summary_landmark_ids, &summary_map);
+
+  summary_map::LocalizationSummaryMap sub_summary_map;
+  summary_map::LocalizationSummaryMapId sub_id;
+  common::generateId(&sub_id);
+  sub_summary_map.setId(sub_id);
+  const std::vector<int> kLandmarkIndices = {1, 2};
+  summary_map::createLocalizationSummaryMapFromLandmarkIndices(
+      summary_map, kLandmarkIndices, &sub_summary_map);
+
+  const Eigen::Matrix3Xf& G_landmark_position =
+      sub_summary_map.GLandmarkPosition();
+  ASSERT_EQ(G_landmark_position.cols(), 2);
+  EXPECT_NEAR_EIGEN(G_landmark_position.col(0), Eigen::Vector3f(0, 0, 2), 1e-9);
+  EXPECT_NEAR_EIGEN(G_landmark_position.col(1), Eigen::Vector3f(0, 0, 3), 1e-9);
+
+  // Landmark 2 is observed by v2 and v3, landmark 3 by v1 and v2.
+  const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>& obs_to_landmark =
+      sub_summary_map.observationToLandmarkIndex();
+  const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>& landmark_observers =
+      sub_summary_map.observerIndices();
+  ASSERT_EQ(4, obs_to_landmark.rows());
+  ASSERT_EQ(4, landmark_observers.rows());
+  ASSERT_EQ(4, sub_summary_map.projectedDescriptors().cols());
+  EXPECT_EQ(3, sub_summary_map.GObserverPosition().cols());
+
+  // Every observation keeps its descriptor and the position of its observer.
+  const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>&
+      source_obs_to_landmark = summary_map.observationToLandmarkIndex();
+  int sub_observation = 0;
+  for (int i = 0; i < source_obs_to_landmark.rows(); ++i) {
+    if (source_obs_to_landmark(i, 0) == 0u) {
+      continue;
+    }
+    ASSERT_LT(sub_observation, obs_to_landmark.rows());
+    EXPECT_EQ(
+        source_obs_to_landmark(i, 0) - 1u, obs_to_landmark(sub_observation, 0));
+    EXPECT_NEAR_EIGEN(
+        summary_map.projectedDescriptors().col(i),
+        sub_summary_map.projectedDescriptors().col(sub_observation), 1e-9);
+    EXPECT_NEAR_EIGEN(
+        summary_map.GObserverPosition().col(
+            summary_map.observerIndices()(i, 0)),
+        sub_summary_map.GObserverPosition().col(
+            landmark_observers(sub_observation, 0)),
+        1e-9);
+    ++sub_observation;
+  }
+  EXPECT_EQ(4, sub_observation);
+}
+
+TEST_F(LocalizationSummaryMapTest, AppendLandmarksToSummaryMap) {
+  summary_map::LocalizationSummaryMapId id;
+  common::generateId(&id);
+
+  summary_map::LocalizationSummaryMap full_summary_map;
+  full_summary_map.setId(id);
+  const vi_map::LandmarkIdList kAllLandmarkIds = {
+      landmark_1_id_, landmark_2_id_, landmark_3_id_};
+  summary_map::createLocalizationSummaryMapFromLandmarkList(
+      map_, kAllLandmarkIds, &full_summary_map);
+
+  summary_map::LocalizationSummaryMap summary_map;
+  summary_map.setId(id);
+  summary_map::createLocalizationSummaryMapFromLandmarkList(
+      map_, {landmark_1_id_, landmark_2_id_}, &summary_map);
+  const int num_existing_observations =
+      summary_map.projectedDescriptors().cols();
+  vi_map::LandmarkIdList existing_landmark_ids;
+  summary_map.getAllLandmarkIds(&existing_landmark_ids);
+
+  summary_map::appendLandmarksToLocalizationSummaryMap(
+      map_, {landmark_3_id_}, nullptr, &summary_map);
+
+  EXPECT_EQ(id, summary_map.id());
+  EXPECT_NEAR_EIGEN(
+      full_summary_map.GLandmarkPosition(), summary_map.GLandmarkPosition(),
+      1e-9);
+  vi_map::LandmarkIdList landmark_ids;
+  summary_map.getAllLandmarkIds(&landmark_ids);
+  ASSERT_EQ(3u, landmark_ids.size());
+  for (size_t i = 0u; i < existing_landmark_ids.size(); ++i) {
+    EXPECT_EQ(existing_landmark_ids[i], landmark_ids[i]);
+  }
+
+  // The observations are in landmark order in both summary maps, the
+  // appended ones come after the existing ones.
+  const int num_observations = full_summary_map.projectedDescriptors().cols();
+  ASSERT_EQ(num_observations, summary_map.projectedDescriptors().cols());
+  EXPECT_LT(num_existing_observations, num_observations);
+  for (int i = 0; i < num_observations; ++i) {
+    EXPECT_EQ(
+        full_summary_map.observationToLandmarkIndex()(i, 0),
+        summary_map.observationToLandmarkIndex()(i, 0));
+    EXPECT_NEAR_EIGEN(
+        full_summary_map.projectedDescriptors().col(i),
+        summary_map.projectedDescriptors().col(i), 1e-9);
+    EXPECT_NEAR_EIGEN(
+        full_summary_map.GObserverPosition().col(
+            full_summary_map.observerIndices()(i, 0)),
+        summary_map.GObserverPosition().col(
+            summary_map.observerIndices()(i, 0)),
+        1e-9);
+  }
+}
+
 MAPLAB_UNITTEST_ENTRYPOINT
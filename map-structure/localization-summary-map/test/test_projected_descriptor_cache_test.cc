@@ -0,0 +1,115 @@
+#include <string>
+
+#include <Eigen/Core>
+#include <aslam/frames/visual-frame.h>
+#include <maplab-common/pose_types.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+#include <vi-map/test/vi-map-generator.h>
+#include <vi-map/unique-id.h>
+#include <vi-map/vi-map.h>
+
+#include "localization-summary-map/projected-descriptor-cache.h"
+
+namespace summary_map {
+
+class ProjectedDescriptorCacheTest : public ::testing::Test {
+ protected:
+  static constexpr int kDescriptorSizeBytes = 48;
+  static constexpr int kNumDescriptors = 20;
+
+  virtual void SetUp() {
+    vi_map::VIMapGenerator generator(map_, 42);
+    mission_id_ = generator.createMission(pose::Transformation());
+    frame_id_.vertex_id =
+        generator.createVertex(mission_id_, pose::Transformation());
+    frame_id_.frame_index = 0u;
+    generator.generateMap();
+
+    descriptors_ = aslam::VisualFrame::DescriptorsT::Random(
+        kDescriptorSizeBytes, kNumDescriptors);
+    num_projections_ = 0;
+  }
+
+  ProjectedDescriptorCache::ProjectionFunction getProjection(
+      const float scale) {
+    return [this, scale](
+               const aslam::VisualFrame::DescriptorsT& descriptors,
+               Eigen::MatrixXf* projected_descriptors) {
+      ++num_projections_;
+      *projected_descriptors = scale * descriptors.topRows(10).cast<float>();
+    };
+  }
+
+  vi_map::VIMap map_;
+  vi_map::MissionId mission_id_;
+  vi_map::VisualFrameIdentifier frame_id_;
+  aslam::VisualFrame::DescriptorsT descriptors_;
+  int num_projections_;
+};
+
+TEST_F(ProjectedDescriptorCacheTest, ProjectsEveryFrameOnce) {
+  ProjectedDescriptorCache cache(getProjection(1.0f));
+  Eigen::MatrixXf projected_descriptors;
+  cache.getProjectedDescriptors(
+      map_, frame_id_, descriptors_, &projected_descriptors);
+  EXPECT_EQ(1, num_projections_);
+  EXPECT_EQ(0u, cache.numCacheHits());
+  EXPECT_EQ(1u, cache.numCacheMisses());
+
+  Eigen::MatrixXf cached_projected_descriptors;
+  cache.getProjectedDescriptors(
+      map_, frame_id_, descriptors_, &cached_projected_descriptors);
+  EXPECT_EQ(1, num_projections_);
+  EXPECT_EQ(1u, cache.numCacheHits());
+  EXPECT_NEAR_EIGEN(projected_descriptors, cached_projected_descriptors, 1e-9);
+
+  // Changed descriptors invalidate the frame.
+  descriptors_(0, 0) = ~descriptors_(0, 0);
+  cache.getProjectedDescriptors(
+      map_, frame_id_, descriptors_, &projected_descriptors);
+  EXPECT_EQ(2, num_projections_);
+  EXPECT_EQ(2u, cache.numCacheMisses());
+}
+
+TEST_F(ProjectedDescriptorCacheTest, SerializationRoundTrip) {
+  ProjectedDescriptorCache cache(getProjection(1.0f));
+  Eigen::MatrixXf projected_descriptors;
+  cache.getProjectedDescriptors(
+      map_, frame_id_, descriptors_, &projected_descriptors);
+  std::string data;
+  cache.serializeMission(mission_id_, &data);
+  ASSERT_FALSE(data.empty());
+
+  ProjectedDescriptorCache deserialized_cache(getProjection(1.0f));
+  ASSERT_TRUE(deserialized_cache.deserializeMission(mission_id_, data));
+  const int num_projections = num_projections_;
+  Eigen::MatrixXf cached_projected_descriptors;
+  deserialized_cache.getProjectedDescriptors(
+      map_, frame_id_, descriptors_, &cached_projected_descriptors);
+  EXPECT_EQ(num_projections, num_projections_);
+  EXPECT_EQ(1u, deserialized_cache.numCacheHits());
+  EXPECT_NEAR_EIGEN(projected_descriptors, cached_projected_descriptors, 1e-9);
+}
+
+TEST_F(ProjectedDescriptorCacheTest, RejectsOtherProjectionAndCorruptData) {
+  ProjectedDescriptorCache cache(getProjection(1.0f));
+  Eigen::MatrixXf projected_descriptors;
+  cache.getProjectedDescriptors(
+      map_, frame_id_, descriptors_, &projected_descriptors);
+  std::string data;
+  cache.serializeMission(mission_id_, &data);
+
+  ProjectedDescriptorCache other_projection_cache(getProjection(2.0f));
+  EXPECT_FALSE(other_projection_cache.deserializeMission(mission_id_, data));
+
+  ProjectedDescriptorCache same_projection_cache(getProjection(1.0f));
+  EXPECT_FALSE(same_projection_cache.deserializeMission(
+      mission_id_, data.substr(0u, data.size() - 1u)));
+  EXPECT_FALSE(same_projection_cache.deserializeMission(
+      mission_id_, "not a projected descriptor cache"));
+}
+
+}  // namespace summary_map
+
+MAPLAB_UNITTEST_ENTRYPOINT
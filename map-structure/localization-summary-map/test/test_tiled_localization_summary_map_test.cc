@@ -0,0 +1,175 @@
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <gtest/gtest.h>
+#include <maplab-common/map-manager-config.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+#include <maplab-common/unique-id.h>
+
+#include "localization-summary-map/localization-summary-map-creation.h"
+#include "localization-summary-map/localization-summary-map.h"
+#include "localization-summary-map/tiled-localization-summary-map.h"
+
+namespace summary_map {
+namespace {
+constexpr double kTileSizeMeters = 10.0;
+constexpr int kDescriptorDimensions = 10;
+}  // namespace
+
+class TiledLocalizationSummaryMapTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    LocalizationSummaryMapId id;
+    common::generateId(&id);
+    summary_map_.setId(id);
+
+    // One landmark in each of the tiles (0, 0), (1, 0) and (-1, 2), the
+    // second observer sees the landmarks of the first two tiles.
+    Eigen::Matrix3Xd G_landmark_position(3, 3);
+    G_landmark_position << 5.0, 15.0, -5.0, 5.0, 5.0, 25.0, 0.0, 1.0, 2.0;
+    summary_map_.setGLandmarkPosition(G_landmark_position);
+
+    Eigen::Matrix3Xd G_observer_position(3, 3);
+    G_observer_position.setRandom();
+    summary_map_.setGObserverPosition(G_observer_position);
+
+    constexpr int kNumObservations = 4;
+    Eigen::MatrixXf descriptors(kDescriptorDimensions, kNumObservations);
+    descriptors.setRandom();
+    summary_map_.setProjectedDescriptors(descriptors);
+
+    Eigen::Matrix<unsigned int, Eigen::Dynamic, 1> observer_indices(
+        kNumObservations);
+    observer_indices << 0, 1, 1, 2;
+    summary_map_.setObserverIndices(observer_indices);
+    Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>
+        observation_to_landmark_index(kNumObservations);
+    observation_to_landmark_index << 0, 0, 1, 2;
+    summary_map_.setObservationToLandmarkIndex(observation_to_landmark_index);
+  }
+
+  LocalizationSummaryMap summary_map_;
+};
+
+TEST_F(TiledLocalizationSummaryMapTest, SaveAndLoadTiles) {
+  const std::string kFolder = "tiled_localization_summary_map_test";
+  backend::SaveConfig save_config;
+  save_config.overwrite_existing_files = true;
+  ASSERT_TRUE(
+      TiledLocalizationSummaryMap::saveTilesToFolder(
+          summary_map_, kTileSizeMeters, kFolder, save_config));
+  EXPECT_TRUE(TiledLocalizationSummaryMap::hasTilesOnFileSystem(kFolder));
+
+  TiledLocalizationSummaryMap tiled_summary_map;
+  ASSERT_TRUE(tiled_summary_map.loadFromFolder(kFolder));
+  EXPECT_EQ(kTileSizeMeters, tiled_summary_map.tileSizeMeters());
+  ASSERT_EQ(3u, tiled_summary_map.numTiles());
+
+  size_t num_landmarks = 0u;
+  for (size_t tile_idx = 0u; tile_idx < tiled_summary_map.numTiles();
+       ++tile_idx) {
+    const TiledLocalizationSummaryMap::Tile& tile =
+        tiled_summary_map.getTile(tile_idx);
+    EXPECT_EQ(1u, tile.num_landmarks);
+    EXPECT_GT(tile.num_bytes, 0u);
+    num_landmarks += tile.num_landmarks;
+
+    LocalizationSummaryMap::Ptr tile_summary_map =
+        tiled_summary_map.loadTile(tile_idx);
+    ASSERT_TRUE(tile_summary_map != nullptr);
+    ASSERT_EQ(1, tile_summary_map->GLandmarkPosition().cols());
+    const Eigen::Vector3f p_G_landmark =
+        tile_summary_map->GLandmarkPosition().col(0);
+    EXPECT_GE(p_G_landmark.x(), tile.x * kTileSizeMeters);
+    EXPECT_LT(p_G_landmark.x(), (tile.x + 1) * kTileSizeMeters);
+    EXPECT_GE(p_G_landmark.y(), tile.y * kTileSizeMeters);
+    EXPECT_LT(p_G_landmark.y(), (tile.y + 1) * kTileSizeMeters);
+  }
+  EXPECT_EQ(3u, num_landmarks);
+}
+
+TEST_F(TiledLocalizationSummaryMapTest, TilesWithinRadius) {
+  const std::string kFolder = "tiled_localization_summary_map_radius_test";
+  backend::SaveConfig save_config;
+  save_config.overwrite_existing_files = true;
+  ASSERT_TRUE(
+      TiledLocalizationSummaryMap::saveTilesToFolder(
+          summary_map_, kTileSizeMeters, kFolder, save_config));
+  TiledLocalizationSummaryMap tiled_summary_map;
+  ASSERT_TRUE(tiled_summary_map.loadFromFolder(kFolder));
+
+  // Inside tile (0, 0), 2 m away from tile (1, 0) and 12 m away from tile
+  // (-1, 2).
+  const Eigen::Vector3d p_G(8.0, 8.0, 100.0);
+  std::vector<size_t> tile_indices;
+  tiled_summary_map.getTilesWithinRadius(p_G, 0.0, &tile_indices);
+  ASSERT_EQ(1u, tile_indices.size());
+  EXPECT_EQ(0, tiled_summary_map.getTile(tile_indices[0]).x);
+  EXPECT_EQ(0, tiled_summary_map.getTile(tile_indices[0]).y);
+
+  tiled_summary_map.getTilesWithinRadius(p_G, 5.0, &tile_indices);
+  ASSERT_EQ(2u, tile_indices.size());
+  EXPECT_EQ(1, tiled_summary_map.getTile(tile_indices[1]).x);
+  EXPECT_EQ(0, tiled_summary_map.getTile(tile_indices[1]).y);
+
+  tiled_summary_map.getTilesWithinRadius(p_G, 15.0, &tile_indices);
+  ASSERT_EQ(3u, tile_indices.size());
+  EXPECT_EQ(-1, tiled_summary_map.getTile(tile_indices[2]).x);
+  EXPECT_EQ(2, tiled_summary_map.getTile(tile_indices[2]).y);
+}
+
+TEST_F(TiledLocalizationSummaryMapTest, MergeSummaryMaps) {
+  LocalizationSummaryMap first_part;
+  LocalizationSummaryMap second_part;
+  const std::vector<LocalizationSummaryMap*> parts = {
+      &first_part, &second_part};
+  const std::vector<std::vector<int>> part_landmark_indices = {{0, 1}, {2}};
+  for (size_t i = 0u; i < parts.size(); ++i) {
+    LocalizationSummaryMapId id;
+    common::generateId(&id);
+    parts[i]->setId(id);
+    createLocalizationSummaryMapFromLandmarkIndices(
+        summary_map_, part_landmark_indices[i], parts[i]);
+  }
+
+  LocalizationSummaryMap merged_summary_map;
+  LocalizationSummaryMapId id;
+  common::generateId(&id);
+  merged_summary_map.setId(id);
+  mergeLocalizationSummaryMaps(
+      {&first_part, &second_part}, &merged_summary_map);
+
+  EXPECT_NEAR_EIGEN(
+      summary_map_.GLandmarkPosition(), merged_summary_map.GLandmarkPosition(),
+      1e-6);
+  const int num_observations = merged_summary_map.projectedDescriptors().cols();
+  ASSERT_EQ(summary_map_.projectedDescriptors().cols(), num_observations);
+  for (int i = 0; i < num_observations; ++i) {
+    // Every observation must still point to its landmark and observer.
+    const unsigned int landmark_idx =
+        merged_summary_map.observationToLandmarkIndex()(i);
+    ASSERT_LT(landmark_idx, 3u);
+    const unsigned int observer_idx = merged_summary_map.observerIndices()(i);
+    ASSERT_LT(
+        static_cast<int>(observer_idx),
+        merged_summary_map.GObserverPosition().cols());
+    bool found_original_observation = false;
+    for (int j = 0; j < summary_map_.projectedDescriptors().cols(); ++j) {
+      if (summary_map_.observationToLandmarkIndex()(j) == landmark_idx &&
+          summary_map_.projectedDescriptors().col(j) ==
+              merged_summary_map.projectedDescriptors().col(i) &&
+          summary_map_.GObserverPosition().col(
+              summary_map_.observerIndices()(j)) ==
+              merged_summary_map.GObserverPosition().col(observer_idx)) {
+        found_original_observation = true;
+      }
+    }
+    EXPECT_TRUE(found_original_observation);
+  }
+}
+
+}  // namespace summary_map
+
+MAPLAB_UNITTEST_ENTRYPOINT
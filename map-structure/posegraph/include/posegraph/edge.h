@@ -45,6 +45,10 @@ class Edge {
   virtual const VertexId& from() const = 0;
   virtual const VertexId& to() const = 0;
 
+  // Copies the edge including the data of the derived class. The pose graph
+  // uses this to unshare an edge before handing out mutable access to it.
+  virtual Edge::UniquePtr clone() const = 0;
+
   inline EdgeType getType() const {
     return edge_type_;
   }
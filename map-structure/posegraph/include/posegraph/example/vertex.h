@@ -15,6 +15,7 @@ class Vertex : public pose_graph::Vertex {
   virtual ~Vertex();
 
   virtual const VertexId& id() const;
+  virtual pose_graph::Vertex::UniquePtr clone() const;
 
   virtual bool addIncomingEdge(const EdgeId& edge);
   virtual bool addOutgoingEdge(const EdgeId& edge);
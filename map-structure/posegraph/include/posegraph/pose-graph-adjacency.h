@@ -0,0 +1,138 @@
+#ifndef POSEGRAPH_POSE_GRAPH_ADJACENCY_H_
+#define POSEGRAPH_POSE_GRAPH_ADJACENCY_H_
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/flat-hash-map.h>
+#include <maplab-common/macros.h>
+
+#include "posegraph/edge.h"
+#include "posegraph/unique-id.h"
+
+namespace pose_graph {
+class PoseGraph;
+
+// Immutable snapshot of the connectivity of a pose graph in compressed sparse
+// row form. The vertices get dense indices and the outgoing and incoming edges
+// of every vertex are stored next to each other in flat arrays, together with
+// their type and the index of the vertex at their other end. Traversals then
+// scan contiguous memory instead of looking up every vertex and edge by id.
+// Use PoseGraph::getAdjacency() to get a snapshot that is kept until the
+// graph is modified.
+class PoseGraphAdjacency {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(PoseGraphAdjacency);
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(PoseGraphAdjacency);
+
+  typedef uint32_t VertexIndex;
+  typedef uint32_t EdgeIndex;
+  static constexpr VertexIndex kInvalidVertexIndex =
+      std::numeric_limits<VertexIndex>::max();
+
+  struct AdjacentEdge {
+    // The vertex at the other end of the edge.
+    VertexIndex vertex_index;
+    EdgeIndex edge_index;
+    Edge::EdgeType type;
+  };
+
+  class AdjacentEdgeRange {
+   public:
+    AdjacentEdgeRange(const AdjacentEdge* begin, const AdjacentEdge* end)
+        : begin_(begin), end_(end) {}
+    const AdjacentEdge* begin() const {
+      return begin_;
+    }
+    const AdjacentEdge* end() const {
+      return end_;
+    }
+    size_t size() const {
+      return static_cast<size_t>(end_ - begin_);
+    }
+    bool empty() const {
+      return begin_ == end_;
+    }
+
+   private:
+    const AdjacentEdge* begin_;
+    const AdjacentEdge* end_;
+  };
+
+  explicit PoseGraphAdjacency(const PoseGraph& pose_graph);
+
+  size_t numVertices() const {
+    return vertex_ids_.size();
+  }
+  size_t numEdges() const {
+    return edge_ids_.size();
+  }
+
+  bool hasVertex(const VertexId& vertex_id) const {
+    return vertex_id_to_index_.count(vertex_id) > 0u;
+  }
+  VertexIndex getVertexIndex(const VertexId& vertex_id) const;
+  const VertexId& getVertexId(VertexIndex vertex_index) const {
+    CHECK_LT(vertex_index, vertex_ids_.size());
+    return vertex_ids_[vertex_index];
+  }
+  const EdgeId& getEdgeId(EdgeIndex edge_index) const {
+    CHECK_LT(edge_index, edge_ids_.size());
+    return edge_ids_[edge_index];
+  }
+
+  AdjacentEdgeRange getOutgoingEdges(VertexIndex vertex_index) const {
+    return getRange(outgoing_offsets_, outgoing_edges_, vertex_index);
+  }
+  AdjacentEdgeRange getIncomingEdges(VertexIndex vertex_index) const {
+    return getRange(incoming_offsets_, incoming_edges_, vertex_index);
+  }
+
+  // Same semantics as VIMap::getNextVertex and VIMap::getPreviousVertex:
+  // follow the first outgoing or incoming edge of the given type.
+  bool getNextVertex(
+      VertexIndex vertex_index, Edge::EdgeType edge_type,
+      VertexIndex* next_vertex_index) const;
+  bool getPreviousVertex(
+      VertexIndex vertex_index, Edge::EdgeType edge_type,
+      VertexIndex* previous_vertex_index) const;
+
+  // Appends the given vertex and all vertices following it along the edges
+  // of the given type. CHECKs that the edges don't form a cycle.
+  void getVertexIdsAlongEdges(
+      VertexIndex start_vertex_index, Edge::EdgeType edge_type,
+      VertexIdList* vertex_ids) const;
+
+  // Visits the vertices reachable from the start vertex in breadth-first
+  // order, following the edges of the given type in both directions, up to
+  // max_hops edges away. Appends the start vertex first.
+  void getVertexIdsWithinHops(
+      VertexIndex start_vertex_index, Edge::EdgeType edge_type,
+      size_t max_hops, VertexIdList* vertex_ids) const;
+
+ private:
+  AdjacentEdgeRange getRange(
+      const std::vector<EdgeIndex>& offsets,
+      const std::vector<AdjacentEdge>& edges, VertexIndex vertex_index) const {
+    CHECK_LT(vertex_index, vertex_ids_.size());
+    const AdjacentEdge* data = edges.data();
+    return AdjacentEdgeRange(
+        data + offsets[vertex_index], data + offsets[vertex_index + 1u]);
+  }
+
+  VertexIdList vertex_ids_;
+  EdgeIdList edge_ids_;
+  common::FlatHashMap<VertexId, VertexIndex> vertex_id_to_index_;
+
+  // The edges of vertex i are in [offsets[i], offsets[i + 1]).
+  std::vector<EdgeIndex> outgoing_offsets_;
+  std::vector<AdjacentEdge> outgoing_edges_;
+  std::vector<EdgeIndex> incoming_offsets_;
+  std::vector<AdjacentEdge> incoming_edges_;
+};
+
+}  // namespace pose_graph
+
+#endif  // POSEGRAPH_POSE_GRAPH_ADJACENCY_H_
@@ -28,6 +28,8 @@ size_t PoseGraph::removeEdgesOfType() {
 void PoseGraph::clear() {
   vertices_.clear();
   edges_.clear();
+  may_share_elements_ = false;
+  invalidateAdjacency();
 }
 
 }  // namespace pose_graph
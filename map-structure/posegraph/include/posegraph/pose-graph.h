@@ -2,10 +2,15 @@
 #define POSEGRAPH_POSE_GRAPH_H_
 
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
+#include <maplab-common/flat-hash-map.h>
+#include <maplab-common/memory-accounting.h>
+
 #include "posegraph/edge.h"
+#include "posegraph/pose-graph-adjacency.h"
 #include "posegraph/unique-id.h"
 #include "posegraph/vertex.h"
 
@@ -13,12 +18,22 @@ namespace pose_graph {
 
 class PoseGraph {
  protected:
-  // Accessible by derived classes for more flexible extension.
-  typedef std::unordered_map<VertexId, AlignedUniquePtr<Vertex>> VertexMap;
+  // Accessible by derived classes for more flexible extension. The id
+  // lookups are among the hottest operations on large maps, hence the
+  // vertices and edges are indexed in open-addressing hash maps. Inserting
+  // invalidates iterators, but the vertices and edges themselves never move.
+  // They are held by shared pointers, as copies of a pose graph can share
+  // them, see addSharedVerticesAndEdgesOf().
+  typedef common::FlatHashMap<VertexId, std::shared_ptr<Vertex>> VertexMap;
   VertexMap vertices_;
-  typedef std::unordered_map<EdgeId, AlignedUniquePtr<Edge>> EdgeMap;
+  typedef common::FlatHashMap<EdgeId, std::shared_ptr<Edge>> EdgeMap;
   EdgeMap edges_;
 
+  // Derived classes that modify the maps directly must call this.
+  void invalidateAdjacency() {
+    adjacency_.reset();
+  }
+
  public:
   MAPLAB_POINTER_TYPEDEFS(PoseGraph);
 
@@ -34,6 +49,24 @@ class PoseGraph {
 
   void addEdge(AlignedUniquePtr<Edge> edge);
 
+  // Adds the vertices and edges of the other pose graph without copying them.
+  // Both graphs share them until either graph hands out mutable access to one
+  // of them, which first copies this vertex or edge for the graph. The graphs
+  // must not have any vertex or edge ids in common.
+  void addSharedVerticesAndEdgesOf(const PoseGraph& other);
+
+  // Moves the vertices and edges of the other pose graph into this one, the
+  // other graph is empty afterwards. The graphs must not have any vertex or
+  // edge ids in common.
+  void moveVerticesAndEdgesFrom(PoseGraph* other);
+
+  // Pre-allocates the vertex and edge maps for bulk insertion, avoids
+  // repeated rehashing when building up large graphs.
+  void reserve(size_t num_vertices, size_t num_edges) {
+    vertices_.reserve(num_vertices);
+    edges_.reserve(num_edges);
+  }
+
   /****************************************
    * Const ops
    ****************************************/
@@ -60,6 +93,8 @@ class PoseGraph {
   // returns an Edge with the given ID.
   const Edge& getEdge(const EdgeId& id) const;
 
+  // The mutable accessors may be called concurrently, also for the same
+  // vertex or edge.
   // returns a Vertex with the given ID.
   Vertex& getVertexMutable(const VertexId& id);
 
@@ -88,7 +123,34 @@ class PoseGraph {
     return edges_.size();
   }
 
+  // Memory used by the vertex and edge maps, excluding the vertices and edges.
+  size_t getIndexMemoryUsageBytes() const {
+    return common::getHeapBytes(vertices_) + common::getHeapBytes(edges_);
+  }
+
   inline void clear();
+
+  // Returns a snapshot of the connectivity of the graph for fast traversals.
+  // It is built on the first call and kept until vertices or edges are added
+  // or removed, so it pays off for repeated traversals of an unchanged graph.
+  // Holders of the snapshot can keep using it after the graph changes, it
+  // just no longer reflects the graph. May be called concurrently, but not
+  // concurrently with modifications of the graph.
+  PoseGraphAdjacency::ConstPtr getAdjacency() const;
+
+ private:
+  friend class PoseGraphAdjacency;
+
+  // Copies the vertex or edge if it is shared with another pose graph.
+  template <typename ElementType>
+  ElementType* getUnshared(std::shared_ptr<ElementType>* element);
+
+  // Set once this graph has shared vertices or edges with another graph.
+  mutable bool may_share_elements_ = false;
+  std::mutex unshare_mutex_;
+
+  mutable PoseGraphAdjacency::ConstPtr adjacency_;
+  mutable std::mutex adjacency_mutex_;
 };
 
 }  // namespace pose_graph
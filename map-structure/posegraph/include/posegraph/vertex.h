@@ -20,6 +20,10 @@ class Vertex {
 
   virtual const VertexId& id() const = 0;
 
+  // Copies the vertex including the data of the derived class. The pose graph
+  // uses this to unshare a vertex before handing out mutable access to it.
+  virtual Vertex::UniquePtr clone() const = 0;
+
   virtual bool addIncomingEdge(const EdgeId& edge) = 0;
   virtual bool addOutgoingEdge(const EdgeId& edge) = 0;
 
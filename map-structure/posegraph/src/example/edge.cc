@@ -23,5 +23,9 @@ const VertexId& Edge::to() const {
   return to_;
 }
 
+pose_graph::Edge::UniquePtr Edge::clone() const {
+  return pose_graph::Edge::UniquePtr(new Edge(*this));
+}
+
 }  // namespace example
 }  // namespace pose_graph
@@ -15,12 +15,14 @@ void PoseGraph::addVertex(const VertexId& id) {
   Vertex* vertex_ptr(new Vertex(id));
   CHECK(vertices_.emplace(id, Vertex::UniquePtr(vertex_ptr)).second)
       << "Vertex with ID " << id.hexString() << " already exists.";
+  invalidateAdjacency();
 }
 
 void PoseGraph::addVertex(Vertex::UniquePtr vertex) {
   CHECK(vertex != nullptr);
   CHECK(vertices_.emplace(vertex->id(), std::move(vertex)).second)
       << "Vertex with ID " << vertex->id().hexString() << " already exists.";
+  invalidateAdjacency();
 }
 
 }  // namespace example
@@ -12,6 +12,10 @@ const VertexId& Vertex::id() const {
   return id_;
 }
 
+pose_graph::Vertex::UniquePtr Vertex::clone() const {
+  return pose_graph::Vertex::UniquePtr(new Vertex(*this));
+}
+
 bool Vertex::addIncomingEdge(const EdgeId& edge) {
   return incoming_.insert(edge).second;
 }
@@ -0,0 +1,174 @@
+#include "posegraph/pose-graph-adjacency.h"
+
+#include <limits>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "posegraph/pose-graph.h"
+
+namespace pose_graph {
+
+constexpr PoseGraphAdjacency::VertexIndex
+    PoseGraphAdjacency::kInvalidVertexIndex;
+
+namespace {
+typedef PoseGraphAdjacency::EdgeIndex EdgeIndex;
+
+// Turns the per vertex edge counts into the offsets of the edge ranges.
+void countsToOffsets(std::vector<EdgeIndex>* offsets) {
+  CHECK_NOTNULL(offsets);
+  EdgeIndex offset = 0u;
+  for (EdgeIndex& count_or_offset : *offsets) {
+    const EdgeIndex count = count_or_offset;
+    count_or_offset = offset;
+    offset += count;
+  }
+}
+}  // namespace
+
+PoseGraphAdjacency::PoseGraphAdjacency(const PoseGraph& pose_graph) {
+  CHECK_LT(
+      pose_graph.vertices_.size(),
+      static_cast<size_t>(std::numeric_limits<VertexIndex>::max()));
+  CHECK_LT(
+      pose_graph.edges_.size(),
+      static_cast<size_t>(std::numeric_limits<EdgeIndex>::max()));
+
+  const size_t num_vertices = pose_graph.vertices_.size();
+  vertex_ids_.reserve(num_vertices);
+  vertex_id_to_index_.reserve(num_vertices);
+  for (const PoseGraph::VertexMap::value_type& vertex : pose_graph.vertices_) {
+    vertex_id_to_index_.emplace(
+        vertex.first, static_cast<VertexIndex>(vertex_ids_.size()));
+    vertex_ids_.push_back(vertex.first);
+  }
+
+  // Resolve the end points of every edge once, then count the edges of every
+  // vertex to lay out the ranges.
+  const size_t num_edges = pose_graph.edges_.size();
+  edge_ids_.reserve(num_edges);
+  std::vector<VertexIndex> edge_from(num_edges);
+  std::vector<VertexIndex> edge_to(num_edges);
+  std::vector<Edge::EdgeType> edge_types(num_edges);
+  outgoing_offsets_.assign(num_vertices + 1u, 0u);
+  incoming_offsets_.assign(num_vertices + 1u, 0u);
+  for (const PoseGraph::EdgeMap::value_type& edge : pose_graph.edges_) {
+    const size_t edge_index = edge_ids_.size();
+    edge_ids_.push_back(edge.first);
+    edge_from[edge_index] = getVertexIndex(edge.second->from());
+    edge_to[edge_index] = getVertexIndex(edge.second->to());
+    edge_types[edge_index] = edge.second->getType();
+    ++outgoing_offsets_[edge_from[edge_index]];
+    ++incoming_offsets_[edge_to[edge_index]];
+  }
+  countsToOffsets(&outgoing_offsets_);
+  countsToOffsets(&incoming_offsets_);
+
+  // Fill the ranges front to back, starting at their offsets.
+  outgoing_edges_.resize(num_edges);
+  incoming_edges_.resize(num_edges);
+  std::vector<EdgeIndex> outgoing_positions(
+      outgoing_offsets_.begin(), outgoing_offsets_.end() - 1);
+  std::vector<EdgeIndex> incoming_positions(
+      incoming_offsets_.begin(), incoming_offsets_.end() - 1);
+  for (size_t edge_index = 0u; edge_index < num_edges; ++edge_index) {
+    AdjacentEdge& outgoing_edge =
+        outgoing_edges_[outgoing_positions[edge_from[edge_index]]++];
+    outgoing_edge.vertex_index = edge_to[edge_index];
+    outgoing_edge.edge_index = static_cast<EdgeIndex>(edge_index);
+    outgoing_edge.type = edge_types[edge_index];
+
+    AdjacentEdge& incoming_edge =
+        incoming_edges_[incoming_positions[edge_to[edge_index]]++];
+    incoming_edge.vertex_index = edge_from[edge_index];
+    incoming_edge.edge_index = static_cast<EdgeIndex>(edge_index);
+    incoming_edge.type = edge_types[edge_index];
+  }
+}
+
+PoseGraphAdjacency::VertexIndex PoseGraphAdjacency::getVertexIndex(
+    const VertexId& vertex_id) const {
+  const common::FlatHashMap<VertexId, VertexIndex>::const_iterator it =
+      vertex_id_to_index_.find(vertex_id);
+  CHECK(it != vertex_id_to_index_.end())
+      << "Vertex with ID " << vertex_id << " not in the adjacency.";
+  return it->second;
+}
+
+bool PoseGraphAdjacency::getNextVertex(
+    VertexIndex vertex_index, Edge::EdgeType edge_type,
+    VertexIndex* next_vertex_index) const {
+  CHECK_NOTNULL(next_vertex_index);
+  for (const AdjacentEdge& edge : getOutgoingEdges(vertex_index)) {
+    if (edge.type == edge_type) {
+      *next_vertex_index = edge.vertex_index;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool PoseGraphAdjacency::getPreviousVertex(
+    VertexIndex vertex_index, Edge::EdgeType edge_type,
+    VertexIndex* previous_vertex_index) const {
+  CHECK_NOTNULL(previous_vertex_index);
+  for (const AdjacentEdge& edge : getIncomingEdges(vertex_index)) {
+    if (edge.type == edge_type) {
+      *previous_vertex_index = edge.vertex_index;
+      return true;
+    }
+  }
+  return false;
+}
+
+void PoseGraphAdjacency::getVertexIdsAlongEdges(
+    VertexIndex start_vertex_index, Edge::EdgeType edge_type,
+    VertexIdList* vertex_ids) const {
+  CHECK_NOTNULL(vertex_ids);
+  const size_t max_num_vertex_ids = vertex_ids->size() + numVertices();
+  VertexIndex vertex_index = start_vertex_index;
+  do {
+    CHECK_LT(vertex_ids->size(), max_num_vertex_ids)
+        << "The edges of type " << Edge::edgeTypeToString(edge_type)
+        << " form a cycle.";
+    vertex_ids->push_back(getVertexId(vertex_index));
+  } while (getNextVertex(vertex_index, edge_type, &vertex_index));
+}
+
+void PoseGraphAdjacency::getVertexIdsWithinHops(
+    VertexIndex start_vertex_index, Edge::EdgeType edge_type, size_t max_hops,
+    VertexIdList* vertex_ids) const {
+  CHECK_NOTNULL(vertex_ids);
+  CHECK_LT(start_vertex_index, numVertices());
+
+  // The queue is never popped, the vertices of the current hop are those
+  // between hop_begin and hop_end.
+  std::vector<bool> visited(numVertices(), false);
+  std::vector<VertexIndex> queue;
+  queue.push_back(start_vertex_index);
+  visited[start_vertex_index] = true;
+  size_t hop_begin = 0u;
+  for (size_t hop = 0u; hop < max_hops && hop_begin < queue.size(); ++hop) {
+    const size_t hop_end = queue.size();
+    for (size_t i = hop_begin; i < hop_end; ++i) {
+      for (const AdjacentEdgeRange& edges :
+           {getOutgoingEdges(queue[i]), getIncomingEdges(queue[i])}) {
+        for (const AdjacentEdge& edge : edges) {
+          if (edge.type == edge_type && !visited[edge.vertex_index]) {
+            visited[edge.vertex_index] = true;
+            queue.push_back(edge.vertex_index);
+          }
+        }
+      }
+    }
+    hop_begin = hop_end;
+  }
+
+  vertex_ids->reserve(vertex_ids->size() + queue.size());
+  for (const VertexIndex vertex_index : queue) {
+    vertex_ids->push_back(vertex_ids_[vertex_index]);
+  }
+}
+
+}  // namespace pose_graph
@@ -1,6 +1,9 @@
 #include "posegraph/pose-graph.h"
 
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <utility>
 
 #include <aslam/common/memory.h>
 #include <glog/logging.h>
@@ -15,6 +18,8 @@ void PoseGraph::swap(PoseGraph* other) {
   CHECK_NOTNULL(other);
   vertices_.swap(other->vertices_);
   edges_.swap(other->edges_);
+  std::swap(may_share_elements_, other->may_share_elements_);
+  adjacency_.swap(other->adjacency_);
 }
 
 void PoseGraph::addVertex(Vertex::UniquePtr vertex) {
@@ -22,6 +27,7 @@ void PoseGraph::addVertex(Vertex::UniquePtr vertex) {
   const VertexId& vertex_id = vertex->id();
   CHECK(vertices_.emplace(vertex_id, std::move(vertex)).second)
       << "Vertex already exists.";
+  invalidateAdjacency();
 }
 
 void PoseGraph::addEdge(Edge::UniquePtr edge) {
@@ -35,6 +41,73 @@ void PoseGraph::addEdge(Edge::UniquePtr edge) {
   CHECK(
       vertex_from.addOutgoingEdge(edge_raw->id()) &&
       vertex_to.addIncomingEdge(edge_raw->id()));
+  invalidateAdjacency();
+}
+
+void PoseGraph::addSharedVerticesAndEdgesOf(const PoseGraph& other) {
+  CHECK_NE(&other, this);
+  if (other.vertices_.empty() && other.edges_.empty()) {
+    return;
+  }
+  reserve(
+      vertices_.size() + other.vertices_.size(),
+      edges_.size() + other.edges_.size());
+  for (const VertexMap::value_type& vertex : other.vertices_) {
+    CHECK(vertices_.emplace(vertex.first, vertex.second).second)
+        << "Vertex " << vertex.first << " already exists.";
+  }
+  for (const EdgeMap::value_type& edge : other.edges_) {
+    CHECK(edges_.emplace(edge.first, edge.second).second)
+        << "Edge " << edge.first << " already exists.";
+  }
+  may_share_elements_ = true;
+  other.may_share_elements_ = true;
+  invalidateAdjacency();
+}
+
+void PoseGraph::moveVerticesAndEdgesFrom(PoseGraph* other) {
+  CHECK_NOTNULL(other);
+  CHECK_NE(other, this);
+  if (vertices_.empty() && edges_.empty()) {
+    swap(other);
+    return;
+  }
+  reserve(
+      vertices_.size() + other->vertices_.size(),
+      edges_.size() + other->edges_.size());
+  for (VertexMap::value_type& vertex : other->vertices_) {
+    CHECK(vertices_.emplace(vertex.first, std::move(vertex.second)).second)
+        << "Vertex " << vertex.first << " already exists.";
+  }
+  for (EdgeMap::value_type& edge : other->edges_) {
+    CHECK(edges_.emplace(edge.first, std::move(edge.second)).second)
+        << "Edge " << edge.first << " already exists.";
+  }
+  // The moved elements may still be shared with a third graph.
+  may_share_elements_ = may_share_elements_ || other->may_share_elements_;
+  other->clear();
+  invalidateAdjacency();
+}
+
+PoseGraphAdjacency::ConstPtr PoseGraph::getAdjacency() const {
+  std::lock_guard<std::mutex> lock(adjacency_mutex_);
+  if (adjacency_ == nullptr) {
+    adjacency_ = std::make_shared<const PoseGraphAdjacency>(*this);
+  }
+  return adjacency_;
+}
+
+template <typename ElementType>
+ElementType* PoseGraph::getUnshared(std::shared_ptr<ElementType>* element) {
+  CHECK_NOTNULL(element);
+  if (may_share_elements_) {
+    // Guards against two threads copying the same element.
+    std::lock_guard<std::mutex> lock(unshare_mutex_);
+    if (element->use_count() > 1) {
+      *element = (*element)->clone();
+    }
+  }
+  return element->get();
 }
 
 const Vertex& PoseGraph::getVertex(const VertexId& id) const {
@@ -59,11 +132,11 @@ Edge& PoseGraph::getEdgeMutable(const EdgeId& id) {
 }
 
 Vertex* PoseGraph::getVertexPtrMutable(const VertexId& id) {
-  return common::getChecked(vertices_, id).get();
+  return getUnshared(&common::getChecked(vertices_, id));
 }
 
 Edge* PoseGraph::getEdgePtrMutable(const EdgeId& id) {
-  return common::getChecked(edges_, id).get();
+  return getUnshared(&common::getChecked(edges_, id));
 }
 
 const Vertex* PoseGraph::getVertexPtr(const VertexId& id) const {
@@ -121,6 +194,7 @@ typename PoseGraph::EdgeMap::iterator PoseGraph::removeEdge(
                                        << " does not exist.";
   getVertexPtrMutable(edge_iterator->second->from())->removeOutgoingEdge(id);
   getVertexPtrMutable(edge_iterator->second->to())->removeIncomingEdge(id);
+  invalidateAdjacency();
   return edges_.erase(edge_iterator);
 }
 
@@ -132,6 +206,7 @@ void PoseGraph::removeVertex(const pose_graph::VertexId& id) {
   CHECK(!it->second->hasOutgoingEdges())
       << "Vertex can't be linked with edges if you want to remove it.";
   vertices_.erase(it);
+  invalidateAdjacency();
 }
 
 }  // namespace pose_graph
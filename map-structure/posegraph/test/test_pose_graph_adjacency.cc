@@ -0,0 +1,156 @@
+#include <unordered_set>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/unique-id.h>
+#include <posegraph/example/pose-graph.h>
+#include <posegraph/pose-graph-adjacency.h>
+
+namespace pose_graph {
+namespace example {
+
+class PoseGraphAdjacencyTest : public ::testing::Test {
+ protected:
+  // Builds the chain 0 -> 1 -> 2 -> 3.
+  void SetUp() override {
+    vertex_ids_.resize(4u);
+    for (VertexId& vertex_id : vertex_ids_) {
+      common::generateId(&vertex_id);
+      pose_graph_.addVertex(vertex_id);
+    }
+    for (size_t i = 0u; i + 1u < vertex_ids_.size(); ++i) {
+      addEdge(vertex_ids_[i], vertex_ids_[i + 1u]);
+    }
+  }
+
+  void addEdge(const VertexId& from, const VertexId& to) {
+    EdgeId edge_id;
+    common::generateId(&edge_id);
+    pose_graph_.addEdge(from, to, edge_id);
+  }
+
+  PoseGraph pose_graph_;
+  VertexIdList vertex_ids_;
+  static constexpr Edge::EdgeType kEdgeType = Edge::EdgeType::kUndefined;
+};
+
+constexpr Edge::EdgeType PoseGraphAdjacencyTest::kEdgeType;
+
+TEST_F(PoseGraphAdjacencyTest, MatchesPoseGraph) {
+  addEdge(vertex_ids_[0], vertex_ids_[2]);
+  const PoseGraphAdjacency::ConstPtr adjacency = pose_graph_.getAdjacency();
+  ASSERT_TRUE(adjacency != nullptr);
+  EXPECT_EQ(pose_graph_.numVertices(), adjacency->numVertices());
+  EXPECT_EQ(pose_graph_.numEdges(), adjacency->numEdges());
+
+  for (const VertexId& vertex_id : vertex_ids_) {
+    ASSERT_TRUE(adjacency->hasVertex(vertex_id));
+    const PoseGraphAdjacency::VertexIndex vertex_index =
+        adjacency->getVertexIndex(vertex_id);
+    EXPECT_EQ(vertex_id, adjacency->getVertexId(vertex_index));
+
+    EdgeIdSet outgoing_edges;
+    pose_graph_.getVertex(vertex_id).getOutgoingEdges(&outgoing_edges);
+    EdgeIdSet adjacency_outgoing_edges;
+    for (const PoseGraphAdjacency::AdjacentEdge& edge :
+         adjacency->getOutgoingEdges(vertex_index)) {
+      const EdgeId& edge_id = adjacency->getEdgeId(edge.edge_index);
+      adjacency_outgoing_edges.insert(edge_id);
+      EXPECT_EQ(
+          pose_graph_.getEdge(edge_id).to(),
+          adjacency->getVertexId(edge.vertex_index));
+      EXPECT_EQ(kEdgeType, edge.type);
+    }
+    EXPECT_EQ(outgoing_edges, adjacency_outgoing_edges);
+
+    EdgeIdSet incoming_edges;
+    pose_graph_.getVertex(vertex_id).getIncomingEdges(&incoming_edges);
+    EdgeIdSet adjacency_incoming_edges;
+    for (const PoseGraphAdjacency::AdjacentEdge& edge :
+         adjacency->getIncomingEdges(vertex_index)) {
+      const EdgeId& edge_id = adjacency->getEdgeId(edge.edge_index);
+      adjacency_incoming_edges.insert(edge_id);
+      EXPECT_EQ(
+          pose_graph_.getEdge(edge_id).from(),
+          adjacency->getVertexId(edge.vertex_index));
+    }
+    EXPECT_EQ(incoming_edges, adjacency_incoming_edges);
+  }
+}
+
+TEST_F(PoseGraphAdjacencyTest, TraversesAlongEdges) {
+  const PoseGraphAdjacency::ConstPtr adjacency = pose_graph_.getAdjacency();
+
+  VertexIdList traversed_vertex_ids;
+  adjacency->getVertexIdsAlongEdges(
+      adjacency->getVertexIndex(vertex_ids_[0]), kEdgeType,
+      &traversed_vertex_ids);
+  EXPECT_EQ(vertex_ids_, traversed_vertex_ids);
+
+  traversed_vertex_ids.clear();
+  adjacency->getVertexIdsAlongEdges(
+      adjacency->getVertexIndex(vertex_ids_[0]), Edge::EdgeType::kViwls,
+      &traversed_vertex_ids);
+  ASSERT_EQ(1u, traversed_vertex_ids.size());
+  EXPECT_EQ(vertex_ids_[0], traversed_vertex_ids[0]);
+
+  PoseGraphAdjacency::VertexIndex previous_vertex_index;
+  EXPECT_FALSE(
+      adjacency->getPreviousVertex(
+          adjacency->getVertexIndex(vertex_ids_[0]), kEdgeType,
+          &previous_vertex_index));
+  ASSERT_TRUE(
+      adjacency->getPreviousVertex(
+          adjacency->getVertexIndex(vertex_ids_[3]), kEdgeType,
+          &previous_vertex_index));
+  EXPECT_EQ(vertex_ids_[2], adjacency->getVertexId(previous_vertex_index));
+}
+
+TEST_F(PoseGraphAdjacencyTest, VisitsVerticesWithinHops) {
+  const PoseGraphAdjacency::ConstPtr adjacency = pose_graph_.getAdjacency();
+
+  VertexIdList vertex_ids_within_hops;
+  constexpr size_t kMaxHops = 1u;
+  adjacency->getVertexIdsWithinHops(
+      adjacency->getVertexIndex(vertex_ids_[1]), kEdgeType, kMaxHops,
+      &vertex_ids_within_hops);
+  ASSERT_EQ(3u, vertex_ids_within_hops.size());
+  EXPECT_EQ(vertex_ids_[1], vertex_ids_within_hops[0]);
+  const std::unordered_set<VertexId> neighbors(
+      vertex_ids_within_hops.begin() + 1, vertex_ids_within_hops.end());
+  EXPECT_EQ(1u, neighbors.count(vertex_ids_[0]));
+  EXPECT_EQ(1u, neighbors.count(vertex_ids_[2]));
+
+  vertex_ids_within_hops.clear();
+  adjacency->getVertexIdsWithinHops(
+      adjacency->getVertexIndex(vertex_ids_[0]), kEdgeType,
+      vertex_ids_.size(), &vertex_ids_within_hops);
+  EXPECT_EQ(vertex_ids_, vertex_ids_within_hops);
+}
+
+TEST_F(PoseGraphAdjacencyTest, IsRebuiltAfterModification) {
+  const PoseGraphAdjacency::ConstPtr adjacency = pose_graph_.getAdjacency();
+  EXPECT_EQ(adjacency.get(), pose_graph_.getAdjacency().get());
+
+  VertexId new_vertex_id;
+  common::generateId(&new_vertex_id);
+  pose_graph_.addVertex(new_vertex_id);
+  addEdge(vertex_ids_.back(), new_vertex_id);
+
+  const PoseGraphAdjacency::ConstPtr new_adjacency =
+      pose_graph_.getAdjacency();
+  EXPECT_NE(adjacency.get(), new_adjacency.get());
+  EXPECT_FALSE(adjacency->hasVertex(new_vertex_id));
+  EXPECT_TRUE(new_adjacency->hasVertex(new_vertex_id));
+  EXPECT_EQ(pose_graph_.numEdges(), new_adjacency->numEdges());
+
+  pose_graph_.clear();
+  EXPECT_EQ(0u, pose_graph_.getAdjacency()->numVertices());
+}
+
+}  // namespace example
+}  // namespace pose_graph
+
+MAPLAB_UNITTEST_ENTRYPOINT
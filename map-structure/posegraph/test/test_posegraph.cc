@@ -51,6 +51,52 @@ TEST(AslamPosegraph, DataStructureSizes) {
   EXPECT_EQ(2u, vertex_ids.size());
 }
 
+TEST(AslamPosegraph, SharedVerticesAndEdgesAreCopiedOnWrite) {
+  PoseGraph pose_graph;
+  pose_graph::VertexId vertex1;
+  pose_graph::VertexId vertex2;
+  pose_graph::VertexId vertex3;
+  CHECK(vertex1.fromHexString("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa1"));
+  CHECK(vertex2.fromHexString("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa2"));
+  CHECK(vertex3.fromHexString("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa3"));
+  pose_graph.addVertex(vertex1);
+  pose_graph.addVertex(vertex2);
+  pose_graph::EdgeId edge1;
+  pose_graph::EdgeId edge2;
+  CHECK(edge1.fromHexString("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa4"));
+  CHECK(edge2.fromHexString("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa5"));
+  pose_graph.addEdge(vertex1, vertex2, edge1);
+
+  PoseGraph copied_pose_graph;
+  copied_pose_graph.addSharedVerticesAndEdgesOf(pose_graph);
+  EXPECT_EQ(2u, copied_pose_graph.numVertices());
+  EXPECT_EQ(1u, copied_pose_graph.numEdges());
+  EXPECT_EQ(
+      &pose_graph.getVertex(vertex1), &copied_pose_graph.getVertex(vertex1));
+  EXPECT_EQ(&pose_graph.getEdge(edge1), &copied_pose_graph.getEdge(edge1));
+
+  // Adding an edge modifies the vertices it connects.
+  copied_pose_graph.addVertex(vertex3);
+  copied_pose_graph.addEdge(vertex1, vertex3, edge2);
+  EXPECT_NE(
+      &pose_graph.getVertex(vertex1), &copied_pose_graph.getVertex(vertex1));
+  EXPECT_EQ(
+      &pose_graph.getVertex(vertex2), &copied_pose_graph.getVertex(vertex2));
+  EXPECT_FALSE(pose_graph.vertexExists(vertex3));
+
+  EdgeIdSet outgoing_edges;
+  pose_graph.getVertex(vertex1).getOutgoingEdges(&outgoing_edges);
+  EXPECT_EQ(1u, outgoing_edges.size());
+  outgoing_edges.clear();
+  copied_pose_graph.getVertex(vertex1).getOutgoingEdges(&outgoing_edges);
+  EXPECT_EQ(2u, outgoing_edges.size());
+
+  // Once the copy is gone, the original is no longer shared.
+  copied_pose_graph.clear();
+  const pose_graph::Vertex* vertex2_ptr = &pose_graph.getVertex(vertex2);
+  EXPECT_EQ(vertex2_ptr, pose_graph.getVertexPtrMutable(vertex2));
+}
+
 TEST(AslamPosegraph, StaticOperators) {
   PoseGraph pose_graph;
 
@@ -117,6 +117,10 @@ class GpsUtmMeasurement final : public Measurement {
     return T_UTM_S_;
   }
 
+  const UtmZone& getUtmZone() const {
+    return utm_zone_;
+  }
+
   void serialize(
       measurements::proto::GpsUtmMeasurement* proto_measurement) const;
   void deserialize(
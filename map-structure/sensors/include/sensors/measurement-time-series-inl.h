@@ -0,0 +1,186 @@
+#ifndef SENSORS_MEASUREMENT_TIME_SERIES_INL_H_
+#define SENSORS_MEASUREMENT_TIME_SERIES_INL_H_
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace vi_map {
+
+template <class MeasurementType>
+constexpr size_t MeasurementTimeSeries<MeasurementType>::kInvalidIndex;
+
+template <class MeasurementType>
+MeasurementTimeSeries<MeasurementType>::MeasurementTimeSeries(
+    const MeasurementBuffer<MeasurementType>& buffer) {
+  buffer.lockContainer();
+  const size_t num_measurements = buffer.buffered_values().size();
+  timestamps_nanoseconds_.reserve(num_measurements);
+  measurements_.reserve(num_measurements);
+  // The buffer is sorted by time already.
+  for (const std::pair<const int64_t, MeasurementType>& timestamp_measurement :
+       buffer.buffered_values()) {
+    timestamps_nanoseconds_.push_back(timestamp_measurement.first);
+    measurements_.push_back(timestamp_measurement.second);
+  }
+  buffer.unlockContainer();
+}
+
+template <class MeasurementType>
+size_t MeasurementTimeSeries<MeasurementType>::lowerBound(
+    int64_t timestamp_nanoseconds, size_t first_index) const {
+  DCHECK_LE(first_index, timestamps_nanoseconds_.size());
+  return std::lower_bound(
+             timestamps_nanoseconds_.begin() + first_index,
+             timestamps_nanoseconds_.end(), timestamp_nanoseconds) -
+         timestamps_nanoseconds_.begin();
+}
+
+template <class MeasurementType>
+void MeasurementTimeSeries<MeasurementType>::getIndexRange(
+    int64_t timestamp_begin_nanoseconds, int64_t timestamp_end_nanoseconds,
+    size_t* begin_index, size_t* end_index) const {
+  CHECK_NOTNULL(begin_index);
+  CHECK_NOTNULL(end_index);
+  CHECK_LE(timestamp_begin_nanoseconds, timestamp_end_nanoseconds);
+  *begin_index = lowerBound(timestamp_begin_nanoseconds, 0u);
+  *end_index = std::upper_bound(
+                   timestamps_nanoseconds_.begin() + *begin_index,
+                   timestamps_nanoseconds_.end(), timestamp_end_nanoseconds) -
+               timestamps_nanoseconds_.begin();
+}
+
+template <class MeasurementType>
+void MeasurementTimeSeries<MeasurementType>::getMeasurementsInRange(
+    int64_t timestamp_begin_nanoseconds, int64_t timestamp_end_nanoseconds,
+    MeasurementList* measurements) const {
+  CHECK_NOTNULL(measurements)->clear();
+  size_t begin_index;
+  size_t end_index;
+  getIndexRange(
+      timestamp_begin_nanoseconds, timestamp_end_nanoseconds, &begin_index,
+      &end_index);
+  measurements->assign(
+      measurements_.begin() + begin_index, measurements_.begin() + end_index);
+}
+
+template <class MeasurementType>
+size_t MeasurementTimeSeries<MeasurementType>::getNearestIndex(
+    int64_t timestamp_nanoseconds, int64_t max_delta_nanoseconds,
+    size_t lower_bound) const {
+  if (timestamps_nanoseconds_.empty()) {
+    return kInvalidIndex;
+  }
+  size_t nearest_index = lower_bound;
+  if (lower_bound == timestamps_nanoseconds_.size() ||
+      (lower_bound > 0u &&
+       timestamp_nanoseconds - timestamps_nanoseconds_[lower_bound - 1u] <
+           timestamps_nanoseconds_[lower_bound] - timestamp_nanoseconds)) {
+    nearest_index = lower_bound - 1u;
+  }
+  const int64_t delta_nanoseconds =
+      std::abs(timestamps_nanoseconds_[nearest_index] - timestamp_nanoseconds);
+  if (max_delta_nanoseconds >= 0 && delta_nanoseconds > max_delta_nanoseconds) {
+    return kInvalidIndex;
+  }
+  return nearest_index;
+}
+
+template <class MeasurementType>
+size_t MeasurementTimeSeries<MeasurementType>::getNearestIndex(
+    int64_t timestamp_nanoseconds, int64_t max_delta_nanoseconds) const {
+  return getNearestIndex(
+      timestamp_nanoseconds, max_delta_nanoseconds,
+      lowerBound(timestamp_nanoseconds, 0u));
+}
+
+template <class MeasurementType>
+size_t MeasurementTimeSeries<MeasurementType>::getNearestIndex(
+    int64_t timestamp_nanoseconds) const {
+  constexpr int64_t kNoMaxDelta = -1;
+  return getNearestIndex(timestamp_nanoseconds, kNoMaxDelta);
+}
+
+template <class MeasurementType>
+void MeasurementTimeSeries<MeasurementType>::getNearestIndices(
+    const std::vector<int64_t>& timestamps_nanoseconds,
+    int64_t max_delta_nanoseconds, std::vector<size_t>* indices) const {
+  CHECK_NOTNULL(indices)->clear();
+  indices->reserve(timestamps_nanoseconds.size());
+  size_t lower_bound = 0u;
+  for (size_t i = 0u; i < timestamps_nanoseconds.size(); ++i) {
+    // The search continues from the previous lower bound while the
+    // timestamps are sorted.
+    if (i > 0u && timestamps_nanoseconds[i] < timestamps_nanoseconds[i - 1u]) {
+      lower_bound = 0u;
+    }
+    lower_bound = lowerBound(timestamps_nanoseconds[i], lower_bound);
+    indices->push_back(
+        getNearestIndex(
+            timestamps_nanoseconds[i], max_delta_nanoseconds, lower_bound));
+  }
+}
+
+template <class MeasurementType>
+bool MeasurementTimeSeries<MeasurementType>::interpolate(
+    int64_t timestamp_nanoseconds, int64_t max_gap_nanoseconds,
+    size_t lower_bound, MeasurementType* measurement) const {
+  CHECK_NOTNULL(measurement);
+  if (lower_bound == timestamps_nanoseconds_.size()) {
+    return false;
+  }
+  if (timestamps_nanoseconds_[lower_bound] == timestamp_nanoseconds) {
+    *measurement = measurements_[lower_bound];
+    return true;
+  }
+  if (lower_bound == 0u) {
+    return false;
+  }
+  const size_t index_before = lower_bound - 1u;
+  if (max_gap_nanoseconds >= 0 &&
+      timestamps_nanoseconds_[lower_bound] -
+              timestamps_nanoseconds_[index_before] >
+          max_gap_nanoseconds) {
+    return false;
+  }
+  return interpolateMeasurements(
+      measurements_[index_before], measurements_[lower_bound],
+      timestamp_nanoseconds, measurement);
+}
+
+template <class MeasurementType>
+bool MeasurementTimeSeries<MeasurementType>::interpolate(
+    int64_t timestamp_nanoseconds, int64_t max_gap_nanoseconds,
+    MeasurementType* measurement) const {
+  return interpolate(
+      timestamp_nanoseconds, max_gap_nanoseconds,
+      lowerBound(timestamp_nanoseconds, 0u), measurement);
+}
+
+template <class MeasurementType>
+void MeasurementTimeSeries<MeasurementType>::interpolate(
+    const std::vector<int64_t>& timestamps_nanoseconds,
+    int64_t max_gap_nanoseconds, MeasurementList* measurements,
+    std::vector<bool>* is_valid) const {
+  CHECK_NOTNULL(measurements)->clear();
+  CHECK_NOTNULL(is_valid)->clear();
+  measurements->resize(timestamps_nanoseconds.size());
+  is_valid->resize(timestamps_nanoseconds.size(), false);
+  size_t lower_bound = 0u;
+  for (size_t i = 0u; i < timestamps_nanoseconds.size(); ++i) {
+    if (i > 0u && timestamps_nanoseconds[i] < timestamps_nanoseconds[i - 1u]) {
+      lower_bound = 0u;
+    }
+    lower_bound = lowerBound(timestamps_nanoseconds[i], lower_bound);
+    (*is_valid)[i] = interpolate(
+        timestamps_nanoseconds[i], max_gap_nanoseconds, lower_bound,
+        &(*measurements)[i]);
+  }
+}
+
+}  // namespace vi_map
+
+#endif  // SENSORS_MEASUREMENT_TIME_SERIES_INL_H_
@@ -0,0 +1,115 @@
+#ifndef SENSORS_MEASUREMENT_TIME_SERIES_H_
+#define SENSORS_MEASUREMENT_TIME_SERIES_H_
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <aslam/common/memory.h>
+#include <maplab-common/macros.h>
+
+#include "sensors/measurement.h"
+
+namespace vi_map {
+
+// Interpolates between two measurements of the same sensor at a timestamp
+// between theirs. Returns false if the measurements can't be interpolated,
+// e.g. GPS UTM measurements of different zones. Specialized for the
+// measurement types that support interpolation.
+template <class MeasurementType>
+bool interpolateMeasurements(
+    const MeasurementType& measurement_before,
+    const MeasurementType& measurement_after, int64_t timestamp_nanoseconds,
+    MeasurementType* interpolated_measurement);
+
+// Measurements sorted by time in contiguous arrays, with the timestamps in an
+// array of their own. Queries are binary searches over the timestamps, and
+// the batched queries for sorted timestamps, e.g. those of the vertices of a
+// mission along the graph, sweep through the arrays once. The series is a
+// snapshot: build it from a measurement buffer once the buffer is complete.
+template <class MeasurementType>
+class MeasurementTimeSeries {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(MeasurementTimeSeries);
+  typedef Aligned<std::vector, MeasurementType> MeasurementList;
+  static constexpr size_t kInvalidIndex = std::numeric_limits<size_t>::max();
+
+  MeasurementTimeSeries() = default;
+  explicit MeasurementTimeSeries(
+      const MeasurementBuffer<MeasurementType>& buffer);
+
+  size_t size() const {
+    return timestamps_nanoseconds_.size();
+  }
+  bool empty() const {
+    return timestamps_nanoseconds_.empty();
+  }
+  const std::vector<int64_t>& getTimestampsNanoseconds() const {
+    return timestamps_nanoseconds_;
+  }
+  const MeasurementList& getMeasurements() const {
+    return measurements_;
+  }
+  const MeasurementType& getMeasurement(size_t index) const {
+    CHECK_LT(index, measurements_.size());
+    return measurements_[index];
+  }
+
+  // Returns the half-open index range of the measurements with a timestamp in
+  // [timestamp_begin_nanoseconds, timestamp_end_nanoseconds].
+  void getIndexRange(
+      int64_t timestamp_begin_nanoseconds, int64_t timestamp_end_nanoseconds,
+      size_t* begin_index, size_t* end_index) const;
+  // Same as the index range, but copies the measurements.
+  void getMeasurementsInRange(
+      int64_t timestamp_begin_nanoseconds, int64_t timestamp_end_nanoseconds,
+      MeasurementList* measurements) const;
+
+  // Index of the measurement closest in time. Returns kInvalidIndex if the
+  // series is empty or the closest measurement is more than
+  // max_delta_nanoseconds away; a negative max_delta_nanoseconds disables
+  // the limit.
+  size_t getNearestIndex(
+      int64_t timestamp_nanoseconds, int64_t max_delta_nanoseconds) const;
+  size_t getNearestIndex(int64_t timestamp_nanoseconds) const;
+  // Same for many timestamps at once. Sorted timestamps are looked up in
+  // one sweep, unsorted ones fall back to binary searches.
+  void getNearestIndices(
+      const std::vector<int64_t>& timestamps_nanoseconds,
+      int64_t max_delta_nanoseconds, std::vector<size_t>* indices) const;
+
+  // Interpolates between the measurements before and after the timestamp.
+  // Returns false if the timestamp is outside of the series, if the two
+  // measurements are more than max_gap_nanoseconds apart (negative: no
+  // limit), or if they can't be interpolated. Timestamps of measurements
+  // return the measurement itself.
+  bool interpolate(
+      int64_t timestamp_nanoseconds, int64_t max_gap_nanoseconds,
+      MeasurementType* measurement) const;
+  // Same for many timestamps at once, e.g. the vertex timestamps of a
+  // mission. is_valid tells which measurements could be interpolated.
+  void interpolate(
+      const std::vector<int64_t>& timestamps_nanoseconds,
+      int64_t max_gap_nanoseconds, MeasurementList* measurements,
+      std::vector<bool>* is_valid) const;
+
+ private:
+  // Index of the first measurement at or after the timestamp, searching from
+  // the given index on.
+  size_t lowerBound(int64_t timestamp_nanoseconds, size_t first_index) const;
+  size_t getNearestIndex(
+      int64_t timestamp_nanoseconds, int64_t max_delta_nanoseconds,
+      size_t lower_bound) const;
+  bool interpolate(
+      int64_t timestamp_nanoseconds, int64_t max_gap_nanoseconds,
+      size_t lower_bound, MeasurementType* measurement) const;
+
+  std::vector<int64_t> timestamps_nanoseconds_;
+  MeasurementList measurements_;
+};
+
+}  // namespace vi_map
+
+#include "./measurement-time-series-inl.h"
+
+#endif  // SENSORS_MEASUREMENT_TIME_SERIES_H_
@@ -2,6 +2,9 @@
 
 #include <aslam/common/yaml-serialization.h>
 #include <maplab-common/eigen-proto.h>
+#include <maplab-common/interpolation-helpers.h>
+
+#include "sensors/measurement-time-series.h"
 
 namespace vi_map {
 
@@ -15,6 +18,34 @@ SensorType measurementToSensorType<GpsUtmMeasurement>() {
   return SensorType::kGpsUtm;
 }
 
+template <>
+bool interpolateMeasurements<GpsUtmMeasurement>(
+    const GpsUtmMeasurement& measurement_before,
+    const GpsUtmMeasurement& measurement_after,
+    int64_t timestamp_nanoseconds,
+    GpsUtmMeasurement* interpolated_measurement) {
+  CHECK_NOTNULL(interpolated_measurement);
+  CHECK(measurement_before.getSensorId() == measurement_after.getSensorId());
+  const int64_t timestamp_before_nanoseconds =
+      measurement_before.getTimestampNanoseconds();
+  const int64_t timestamp_after_nanoseconds =
+      measurement_after.getTimestampNanoseconds();
+  // The coordinates of different zones don't share a frame.
+  if (!(measurement_before.getUtmZone() == measurement_after.getUtmZone())) {
+    return false;
+  }
+
+  aslam::Transformation T_UTM_S;
+  common::interpolateTransformation(
+      timestamp_before_nanoseconds, measurement_before.get_T_UTM_S(),
+      timestamp_after_nanoseconds, measurement_after.get_T_UTM_S(),
+      timestamp_nanoseconds, &T_UTM_S);
+  *interpolated_measurement = GpsUtmMeasurement(
+      measurement_before.getSensorId(), timestamp_nanoseconds, T_UTM_S,
+      measurement_before.getUtmZone());
+  return true;
+}
+
 constexpr char kDefaultGpsUtmHardwareId[] = "gps_utm";
 
 GpsUtm::GpsUtm()
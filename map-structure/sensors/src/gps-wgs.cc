@@ -2,6 +2,9 @@
 
 #include <aslam/common/yaml-serialization.h>
 #include <maplab-common/eigen-proto.h>
+#include <maplab-common/interpolation-helpers.h>
+
+#include "sensors/measurement-time-series.h"
 
 namespace vi_map {
 
@@ -15,6 +18,56 @@ SensorType measurementToSensorType<GpsWgsMeasurement>() {
   return SensorType::kGpsWgs;
 }
 
+template <>
+bool interpolateMeasurements<GpsWgsMeasurement>(
+    const GpsWgsMeasurement& measurement_before,
+    const GpsWgsMeasurement& measurement_after,
+    int64_t timestamp_nanoseconds,
+    GpsWgsMeasurement* interpolated_measurement) {
+  CHECK_NOTNULL(interpolated_measurement);
+  CHECK(measurement_before.getSensorId() == measurement_after.getSensorId());
+  const int64_t timestamp_before_nanoseconds =
+      measurement_before.getTimestampNanoseconds();
+  const int64_t timestamp_after_nanoseconds =
+      measurement_after.getTimestampNanoseconds();
+  double latitude_deg;
+  common::linerarInterpolation(
+      timestamp_before_nanoseconds, measurement_before.getLatitudeDeg(),
+      timestamp_after_nanoseconds, measurement_after.getLatitudeDeg(),
+      timestamp_nanoseconds, &latitude_deg);
+  double altitude_meters;
+  common::linerarInterpolation(
+      timestamp_before_nanoseconds, measurement_before.getAltitudeMeters(),
+      timestamp_after_nanoseconds, measurement_after.getAltitudeMeters(),
+      timestamp_nanoseconds, &altitude_meters);
+
+  // Interpolate along the shorter way around if the measurements are on
+  // different sides of the antimeridian.
+  const double kFullCircleDeg = kMaxLongitudeDeg - kMinLongitudeDeg;
+  double longitude_delta_deg = measurement_after.getLongitudeDeg() -
+                               measurement_before.getLongitudeDeg();
+  if (longitude_delta_deg > kMaxLongitudeDeg) {
+    longitude_delta_deg -= kFullCircleDeg;
+  } else if (longitude_delta_deg < kMinLongitudeDeg) {
+    longitude_delta_deg += kFullCircleDeg;
+  }
+  double longitude_deg;
+  common::linerarInterpolation(
+      timestamp_before_nanoseconds, measurement_before.getLongitudeDeg(),
+      timestamp_after_nanoseconds,
+      measurement_before.getLongitudeDeg() + longitude_delta_deg,
+      timestamp_nanoseconds, &longitude_deg);
+  if (longitude_deg > kMaxLongitudeDeg) {
+    longitude_deg -= kFullCircleDeg;
+  } else if (longitude_deg < kMinLongitudeDeg) {
+    longitude_deg += kFullCircleDeg;
+  }
+  *interpolated_measurement = GpsWgsMeasurement(
+      measurement_before.getSensorId(), timestamp_nanoseconds, latitude_deg,
+      longitude_deg, altitude_meters);
+  return true;
+}
+
 constexpr char kDefaultGpsWgsHardwareId[] = "gps_wgs";
 
 GpsWgs::GpsWgs()
@@ -0,0 +1,176 @@
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+
+#include "sensors/gps-utm.h"
+#include "sensors/gps-wgs.h"
+#include "sensors/measurement-time-series.h"
+
+namespace vi_map {
+
+class MeasurementTimeSeriesTest : public ::testing::Test {
+ protected:
+  static constexpr size_t kNumMeasurements = 10u;
+  static constexpr int64_t kTimestepNanoseconds = 100;
+
+  virtual void SetUp() {
+    common::generateId(&sensor_id_);
+    // Measurements at 100, 200, ..., 1000 ns, added in reverse.
+    for (size_t i = kNumMeasurements; i > 0u; --i) {
+      const int64_t timestamp_nanoseconds =
+          static_cast<int64_t>(i) * kTimestepNanoseconds;
+      buffer_.addValue(
+          timestamp_nanoseconds,
+          GpsWgsMeasurement(
+              sensor_id_, timestamp_nanoseconds, static_cast<double>(i),
+              static_cast<double>(i), 10.0 * static_cast<double>(i)));
+    }
+  }
+
+  SensorId sensor_id_;
+  GpsWgsMeasurementBuffer buffer_;
+};
+
+constexpr size_t MeasurementTimeSeriesTest::kNumMeasurements;
+constexpr int64_t MeasurementTimeSeriesTest::kTimestepNanoseconds;
+
+TEST_F(MeasurementTimeSeriesTest, IsSortedSnapshotOfBuffer) {
+  const MeasurementTimeSeries<GpsWgsMeasurement> time_series(buffer_);
+  ASSERT_EQ(kNumMeasurements, time_series.size());
+  for (size_t i = 0u; i < kNumMeasurements; ++i) {
+    const int64_t timestamp_nanoseconds =
+        static_cast<int64_t>(i + 1u) * kTimestepNanoseconds;
+    EXPECT_EQ(
+        timestamp_nanoseconds, time_series.getTimestampsNanoseconds()[i]);
+    EXPECT_EQ(
+        timestamp_nanoseconds,
+        time_series.getMeasurement(i).getTimestampNanoseconds());
+  }
+
+  EXPECT_TRUE(MeasurementTimeSeries<GpsWgsMeasurement>().empty());
+}
+
+TEST_F(MeasurementTimeSeriesTest, RangeQueries) {
+  const MeasurementTimeSeries<GpsWgsMeasurement> time_series(buffer_);
+  size_t begin_index;
+  size_t end_index;
+  time_series.getIndexRange(200, 500, &begin_index, &end_index);
+  EXPECT_EQ(1u, begin_index);
+  EXPECT_EQ(5u, end_index);
+
+  time_series.getIndexRange(250, 260, &begin_index, &end_index);
+  EXPECT_EQ(begin_index, end_index);
+
+  GpsWgsMeasurementList measurements;
+  time_series.getMeasurementsInRange(0, 250, &measurements);
+  ASSERT_EQ(2u, measurements.size());
+  EXPECT_EQ(100, measurements[0].getTimestampNanoseconds());
+  EXPECT_EQ(200, measurements[1].getTimestampNanoseconds());
+}
+
+TEST_F(MeasurementTimeSeriesTest, NearestQueries) {
+  const MeasurementTimeSeries<GpsWgsMeasurement> time_series(buffer_);
+  EXPECT_EQ(0u, time_series.getNearestIndex(0));
+  EXPECT_EQ(0u, time_series.getNearestIndex(140));
+  EXPECT_EQ(1u, time_series.getNearestIndex(160));
+  EXPECT_EQ(kNumMeasurements - 1u, time_series.getNearestIndex(5000));
+
+  constexpr int64_t kMaxDeltaNanoseconds = 20;
+  EXPECT_EQ(
+      MeasurementTimeSeries<GpsWgsMeasurement>::kInvalidIndex,
+      time_series.getNearestIndex(150, kMaxDeltaNanoseconds));
+  EXPECT_EQ(2u, time_series.getNearestIndex(310, kMaxDeltaNanoseconds));
+
+  // The batched query matches the single queries, for sorted and unsorted
+  // timestamps.
+  const std::vector<int64_t> timestamps_nanoseconds = {
+      90, 120, 330, 360, 990, 5000, 110, 440};
+  std::vector<size_t> indices;
+  time_series.getNearestIndices(
+      timestamps_nanoseconds, kMaxDeltaNanoseconds, &indices);
+  ASSERT_EQ(timestamps_nanoseconds.size(), indices.size());
+  for (size_t i = 0u; i < timestamps_nanoseconds.size(); ++i) {
+    EXPECT_EQ(
+        time_series.getNearestIndex(
+            timestamps_nanoseconds[i], kMaxDeltaNanoseconds),
+        indices[i]);
+  }
+}
+
+TEST_F(MeasurementTimeSeriesTest, InterpolatesGpsWgs) {
+  const MeasurementTimeSeries<GpsWgsMeasurement> time_series(buffer_);
+  constexpr int64_t kNoMaxGap = -1;
+  GpsWgsMeasurement measurement;
+  EXPECT_FALSE(time_series.interpolate(50, kNoMaxGap, &measurement));
+  EXPECT_FALSE(time_series.interpolate(1050, kNoMaxGap, &measurement));
+
+  ASSERT_TRUE(time_series.interpolate(250, kNoMaxGap, &measurement));
+  EXPECT_EQ(250, measurement.getTimestampNanoseconds());
+  EXPECT_NEAR(2.5, measurement.getLatitudeDeg(), 1e-9);
+  EXPECT_NEAR(2.5, measurement.getLongitudeDeg(), 1e-9);
+  EXPECT_NEAR(25.0, measurement.getAltitudeMeters(), 1e-9);
+
+  constexpr int64_t kMaxGapNanoseconds = kTimestepNanoseconds / 2;
+  EXPECT_FALSE(time_series.interpolate(250, kMaxGapNanoseconds, &measurement));
+  ASSERT_TRUE(time_series.interpolate(300, kMaxGapNanoseconds, &measurement));
+  EXPECT_EQ(time_series.getMeasurement(2u), measurement);
+
+  const std::vector<int64_t> timestamps_nanoseconds = {50, 150, 975};
+  GpsWgsMeasurementList measurements;
+  std::vector<bool> is_valid;
+  time_series.interpolate(
+      timestamps_nanoseconds, kNoMaxGap, &measurements, &is_valid);
+  ASSERT_EQ(3u, measurements.size());
+  ASSERT_EQ(3u, is_valid.size());
+  EXPECT_FALSE(is_valid[0]);
+  EXPECT_TRUE(is_valid[1]);
+  EXPECT_NEAR(1.5, measurements[1].getLatitudeDeg(), 1e-9);
+  EXPECT_TRUE(is_valid[2]);
+  EXPECT_NEAR(97.5, measurements[2].getAltitudeMeters(), 1e-9);
+}
+
+TEST_F(MeasurementTimeSeriesTest, InterpolatesGpsWgsAcrossAntimeridian) {
+  GpsWgsMeasurementBuffer buffer;
+  buffer.addValue(100, GpsWgsMeasurement(sensor_id_, 100, 0.0, 179.0, 0.0));
+  buffer.addValue(200, GpsWgsMeasurement(sensor_id_, 200, 0.0, -179.0, 0.0));
+  const MeasurementTimeSeries<GpsWgsMeasurement> time_series(buffer);
+
+  constexpr int64_t kNoMaxGap = -1;
+  GpsWgsMeasurement measurement;
+  ASSERT_TRUE(time_series.interpolate(125, kNoMaxGap, &measurement));
+  EXPECT_NEAR(179.5, measurement.getLongitudeDeg(), 1e-9);
+  ASSERT_TRUE(time_series.interpolate(175, kNoMaxGap, &measurement));
+  EXPECT_NEAR(-179.5, measurement.getLongitudeDeg(), 1e-9);
+}
+
+TEST_F(MeasurementTimeSeriesTest, InterpolatesGpsUtmWithinZone) {
+  aslam::Transformation T_UTM_S_before;
+  aslam::Transformation T_UTM_S_after;
+  T_UTM_S_after.getPosition() << 2.0, 4.0, 6.0;
+  GpsUtmMeasurementBuffer buffer;
+  buffer.addValue(
+      100, GpsUtmMeasurement(
+               sensor_id_, 100, T_UTM_S_before, UtmZone(32u, 'T')));
+  buffer.addValue(
+      200, GpsUtmMeasurement(
+               sensor_id_, 200, T_UTM_S_after, UtmZone(32u, 'T')));
+  buffer.addValue(
+      300, GpsUtmMeasurement(
+               sensor_id_, 300, T_UTM_S_after, UtmZone(33u, 'T')));
+  const MeasurementTimeSeries<GpsUtmMeasurement> time_series(buffer);
+
+  constexpr int64_t kNoMaxGap = -1;
+  GpsUtmMeasurement measurement;
+  ASSERT_TRUE(time_series.interpolate(150, kNoMaxGap, &measurement));
+  EXPECT_NEAR_EIGEN(
+      Eigen::Vector3d(1.0, 2.0, 3.0), measurement.get_T_UTM_S().getPosition(),
+      1e-9);
+  EXPECT_TRUE(measurement.getUtmZone() == UtmZone(32u, 'T'));
+  EXPECT_FALSE(time_series.interpolate(250, kNoMaxGap, &measurement));
+}
+
+}  // namespace vi_map
+
+MAPLAB_UNITTEST_ENTRYPOINT
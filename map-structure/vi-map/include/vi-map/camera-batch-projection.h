@@ -0,0 +1,32 @@
+#ifndef VI_MAP_CAMERA_BATCH_PROJECTION_H_
+#define VI_MAP_CAMERA_BATCH_PROJECTION_H_
+
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/cameras/camera.h>
+#include <aslam/common/pose-types.h>
+
+namespace vi_map {
+
+// Projects a block of points, given in the camera frame, into the camera.
+// The results are the same as calling camera.project3 on every point, but
+// the camera and distortion model are dispatched once per block to a kernel
+// that is specialized for the model and runs on the coordinates of many
+// points at once, such that the compiler can vectorize it. Pinhole cameras
+// without masks and with no, radial-tangential or equidistant distortion
+// are supported; all other cameras fall back to camera.project3Vectorized.
+void projectPointsIntoCamera(
+    const aslam::Camera& camera, const Eigen::Matrix3Xd& points_C,
+    Eigen::Matrix2Xd* keypoints,
+    std::vector<aslam::ProjectionResult>* projection_results);
+
+// Transforms a block of global points into the camera frame with T_C_G and
+// marks the points that project into the image of the camera.
+void getPointsVisibleInCamera(
+    const aslam::Camera& camera, const aslam::Transformation& T_C_G,
+    const Eigen::Matrix3Xd& points_G, std::vector<char>* is_visible);
+
+}  // namespace vi_map
+
+#endif  // VI_MAP_CAMERA_BATCH_PROJECTION_H_
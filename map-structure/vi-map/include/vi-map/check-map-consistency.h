@@ -1,6 +1,9 @@
 #ifndef VI_MAP_CHECK_MAP_CONSISTENCY_H_
 #define VI_MAP_CHECK_MAP_CONSISTENCY_H_
 
+#include <string>
+
+#include <maplab-common/macros.h>
 #include <posegraph/vertex.h>
 #include <vi-map/mission.h>
 
@@ -8,10 +11,42 @@ namespace vi_map {
 class VIMap;
 bool isGpsReferenceVertex(
     const vi_map::VIMap& vi_map, const pose_graph::VertexId& vertex_id);
+// Checks the whole map unless --vi_map_consistency_check_sample_fraction is
+// below 1. Only records the request and returns true while the checks of the
+// map are deferred by a ScopedDeferredConsistencyCheck.
 bool checkMapConsistency(const vi_map::VIMap& vi_map);
+// Fast mode for production pipelines: the frames and landmark references are
+// only verified for a fixed subset of about sample_fraction of the vertices and
+// landmarks, all other checks cover the whole map.
+bool checkMapConsistency(
+    const vi_map::VIMap& vi_map, const double sample_fraction);
 bool checkPosegraphConsistency(
     const vi_map::VIMap& vi_map, const vi_map::MissionId& mission_id);
 bool checkForOrphanedPosegraphItems(const vi_map::VIMap& vi_map);
 bool checkSensorConsistency(const vi_map::VIMap& vi_map);
+
+// Defers the consistency checks of the steps of a workflow, e.g. of a command
+// that chains triangulation, keyframing, optimization and loop closure. The
+// checks that the steps request with checkMapConsistency(map) are coalesced
+// into a single check of the whole map when the outermost scope of the map
+// ends. The map isn't checked at all if no step requested a check. Nested
+// scopes, e.g. of a workflow that runs other workflows, join the outermost
+// one.
+class ScopedDeferredConsistencyCheck {
+ public:
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(ScopedDeferredConsistencyCheck);
+
+  explicit ScopedDeferredConsistencyCheck(const vi_map::VIMap& vi_map);
+  // CHECK-fails if the deferred check fails, like the steps would have.
+  ~ScopedDeferredConsistencyCheck();
+
+  // Checks the sample of the map given by
+  // --vi_map_workflow_consistency_check_sample_fraction after a step of the
+  // workflow. Does nothing if the flag is 0, which is the default.
+  void checkpoint(const std::string& step_name) const;
+
+ private:
+  const vi_map::VIMap& vi_map_;
+};
 }  // namespace vi_map
 #endif  // VI_MAP_CHECK_MAP_CONSISTENCY_H_
@@ -28,6 +28,10 @@ class CklamEdge : public vi_map::Edge {
       const Eigen::Matrix<double, 7, 1>& keyframe_T_G_B_to);
   virtual ~CklamEdge() {}
 
+  size_t getMemoryUsageBytes() const override {
+    return sizeof(CklamEdge);
+  }
+
   virtual bool operator==(const CklamEdge& other) const {
     bool is_same = true;
     is_same &= static_cast<const vi_map::Edge&>(*this) == other;
@@ -0,0 +1,93 @@
+#ifndef VI_MAP_DESCRIPTOR_ARENA_H_
+#define VI_MAP_DESCRIPTOR_ARENA_H_
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/frames/visual-frame.h>
+#include <maplab-common/macros.h>
+#include <posegraph/unique-id.h>
+
+#include "vi-map/unique-id.h"
+
+namespace vi_map {
+class VIMap;
+
+// Packs the descriptors of the visual frames of a set of vertices, e.g. of a
+// mission, into a single matrix with one column per keypoint. Every visual
+// frame owns its own descriptor matrix, so algorithms going over the
+// descriptors of many frames otherwise visit thousands of small heap blocks.
+// The arena is a snapshot: it is not updated if the frames change afterwards.
+class DescriptorArena {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(DescriptorArena);
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(DescriptorArena);
+  typedef aslam::VisualFrame::DescriptorsT DescriptorsT;
+  typedef DescriptorsT::ConstColsBlockXpr ConstDescriptorsBlock;
+
+  // Copies the descriptors of all visual frames of the given vertices, in the
+  // given order. Paged out descriptors are loaded first.
+  DescriptorArena(
+      const VIMap& map, const pose_graph::VertexIdList& vertex_ids);
+  // Same for all vertices of the mission, in the order along the graph.
+  DescriptorArena(const VIMap& map, const MissionId& mission_id);
+
+  size_t numDescriptors() const {
+    return static_cast<size_t>(descriptors_.cols());
+  }
+  size_t numFrames() const {
+    return frames_.size();
+  }
+  // Zero if the arena holds no descriptors.
+  size_t getDescriptorSizeBytes() const {
+    return static_cast<size_t>(descriptors_.rows());
+  }
+  const DescriptorsT& getDescriptors() const {
+    return descriptors_;
+  }
+
+  bool hasFrame(const VisualFrameIdentifier& frame_id) const;
+  // The descriptors of the frame, one column per keypoint.
+  ConstDescriptorsBlock getFrameDescriptors(
+      const VisualFrameIdentifier& frame_id) const;
+  const unsigned char* getDescriptor(
+      const KeypointIdentifier& keypoint_id) const;
+
+  // Gathers the descriptors of the given observations into the columns of
+  // descriptors, e.g. those of a landmark.
+  void getDescriptorsOfObservations(
+      const KeypointIdentifierList& observations,
+      DescriptorsT* descriptors) const;
+
+  // Calls the function for every frame with the block of its descriptors, in
+  // the order of the arena, i.e. streaming through the memory once.
+  typedef std::function<void(
+      const VisualFrameIdentifier&, const ConstDescriptorsBlock&)>
+      FrameDescriptorsFunction;
+  void forEachFrame(const FrameDescriptorsFunction& function) const;
+  // Same for every single descriptor.
+  typedef std::function<void(
+      const KeypointIdentifier&, const DescriptorsT::ConstColXpr&)>
+      DescriptorFunction;
+  void forEachDescriptor(const DescriptorFunction& function) const;
+
+ private:
+  struct FrameRange {
+    VisualFrameIdentifier frame_id;
+    size_t first_column;
+    size_t num_columns;
+  };
+
+  void build(const VIMap& map, const pose_graph::VertexIdList& vertex_ids);
+  const FrameRange& getFrameRange(const VisualFrameIdentifier& frame_id) const;
+
+  DescriptorsT descriptors_;
+  std::vector<FrameRange> frames_;
+  std::unordered_map<VisualFrameIdentifier, size_t> frame_id_to_range_index_;
+};
+
+}  // namespace vi_map
+
+#endif  // VI_MAP_DESCRIPTOR_ARENA_H_
@@ -0,0 +1,112 @@
+#ifndef VI_MAP_DESCRIPTOR_PAGER_H_
+#define VI_MAP_DESCRIPTOR_PAGER_H_
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <maplab-common/macros.h>
+#include <maplab-common/memory-budget.h>
+#include <posegraph/unique-id.h>
+
+namespace vi_map {
+class Vertex;
+class VIMap;
+
+// Keeps the visual frame descriptors of a loaded map only partially in memory.
+// The descriptors are by far the largest part of a map, but only a few
+// commands, e.g. loop closure, need them. When a map is loaded in paged mode,
+// the descriptors of every vertex are dropped after deserialization, and the
+// pager remembers which vertex proto file holds them. They are restored on
+// demand for the requested vertices, which parses each involved vertex file
+// once. The least recently used vertices are paged out again as soon as the
+// resident descriptors exceed the memory budget.
+//
+// A vertex whose frames have been modified since loading, i.e. whose frames
+// no longer have the number of keypoints they were loaded with, is never
+// paged out again, as its descriptors can no longer be restored from the map
+// files. The pager registers with the memory budget of the process. As the
+// descriptors can only be dropped while the pager is in use, memory requests
+// of other components lower the budget of the next loadDescriptors() call
+// instead of paging out right away. This class is thread-safe.
+class DescriptorPager : public common::MemoryBudget::Consumer {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(DescriptorPager);
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(DescriptorPager);
+
+  DescriptorPager(const std::string& vertex_proto_folder, size_t budget_bytes);
+  virtual ~DescriptorPager();
+
+  // Drops the descriptors of a vertex that has just been deserialized from the
+  // vertex at position proto_vertex_index of the given proto file.
+  void addPagedOutVertex(
+      const std::string& proto_file_name, int proto_vertex_index,
+      Vertex* vertex);
+
+  // Restores the descriptors of all given vertices that are paged out and
+  // marks the vertices as most recently used. The requested vertices stay
+  // resident even if they exceed the budget on their own.
+  void loadDescriptors(const pose_graph::VertexIdList& vertex_ids, VIMap* map);
+  // Restores the descriptors of all vertices, after which the pager no longer
+  // tracks any vertex.
+  void loadAllDescriptors(VIMap* map);
+
+  size_t getNumPagedOutVertices() const;
+  size_t getNumResidentVertices() const;
+  size_t getResidentBytes() const;
+  size_t getBudgetBytes() const {
+    return budget_bytes_;
+  }
+
+  // common::MemoryBudget::Consumer
+  std::string getMemoryConsumerName() const override;
+  size_t getReleasableMemoryBytes() const override;
+  size_t releaseMemory(size_t num_bytes) override;
+
+ private:
+  struct VertexLocation {
+    size_t file_index;
+    int proto_vertex_index;
+    // Number of keypoints of every frame when the vertex was loaded, -1 for
+    // frames that are not set.
+    std::vector<int> num_keypoints_per_frame;
+  };
+  struct ResidentVertex {
+    std::list<pose_graph::VertexId>::iterator lru_position;
+    size_t num_bytes;
+  };
+
+  // All of the following methods expect the caller to hold the mutex.
+  void loadDescriptorsOfPagedOutVertices(
+      const pose_graph::VertexIdList& vertex_ids, VIMap* map);
+  void evictLeastRecentlyUsedVertices(
+      const std::unordered_set<pose_graph::VertexId>& requested_vertices,
+      size_t max_resident_bytes, VIMap* map);
+  bool isVertexUnmodified(
+      const VertexLocation& location, const Vertex& vertex) const;
+  void markAsMostRecentlyUsed(const pose_graph::VertexId& vertex_id);
+
+  const std::string vertex_proto_folder_;
+  const size_t budget_bytes_;
+
+  mutable std::mutex mutex_;
+  std::vector<std::string> proto_file_names_;
+  std::unordered_map<std::string, size_t> proto_file_name_to_index_;
+  std::unordered_map<pose_graph::VertexId, VertexLocation> vertex_locations_;
+  std::unordered_map<pose_graph::VertexId, ResidentVertex> resident_vertices_;
+  // Front is the most recently used vertex.
+  std::list<pose_graph::VertexId> lru_vertices_;
+  size_t resident_bytes_;
+
+  // Bytes requested by the memory budget, released at the next
+  // loadDescriptors().
+  std::atomic<size_t> num_bytes_to_release_;
+};
+
+}  // namespace vi_map
+
+#endif  // VI_MAP_DESCRIPTOR_PAGER_H_
@@ -2,6 +2,7 @@
 #define VI_MAP_EDGE_H_
 
 #include <aslam/common/memory.h>
+#include <maplab-common/memory-accounting.h>
 #include <posegraph/edge.h>
 
 #include "vi-map/mission.h"
@@ -43,6 +44,11 @@ class Edge : public pose_graph::Edge {
     return static_cast<const pose_graph::Edge&>(*this) == other;
   }
 
+  // Size of the edge object plus the heap memory of its measurement data.
+  virtual size_t getMemoryUsageBytes() const {
+    return sizeof(Edge);
+  }
+
   void serialize(vi_map::proto::Edge* proto) const;
   static Edge::UniquePtr deserialize(
       const pose_graph::EdgeId& edge_id, const vi_map::proto::Edge& proto);
@@ -53,6 +59,7 @@ class Edge : public pose_graph::Edge {
   // Copies this object into a new edge.
   // Input: pointer to a shared pointer which should store the copied edge.
   void copyEdgeInto(Edge** new_edge) const;
+  virtual pose_graph::Edge::UniquePtr clone() const;
 
  protected:
   // Helper function to copy edge.
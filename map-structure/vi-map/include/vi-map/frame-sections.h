@@ -0,0 +1,41 @@
+#ifndef VI_MAP_FRAME_SECTIONS_H_
+#define VI_MAP_FRAME_SECTIONS_H_
+
+#include <string>
+#include <vector>
+
+#include "vi-map/vi_map.pb.h"
+
+namespace vi_map {
+class Vertex;
+
+namespace serialization {
+
+// Suffix of the binary file that holds the frame arrays of a vertex proto
+// file, e.g. "vertices0.frames" for "vertices0".
+constexpr char kFrameSectionsFileSuffix[] = ".frames";
+
+// The keypoint measurements, their uncertainties, scales and track ids as
+// well as the descriptors make up most of a vertex proto file. Parsing them
+// from protobuf is much slower than copying them into the frames. These
+// functions store them in a binary file next to the vertex proto file, with
+// every kind of array in its own 64-byte aligned section. Loading maps the
+// file into memory and copies every array into its frame at once.
+//
+// Moves the arrays of all visual frames of the given vertices proto into the
+// file, the proto only keeps the remaining fields of the frames. Returns
+// false if the file can't be written.
+bool moveFrameArraysToSectionsFile(
+    const std::string& file_path, proto::VIMap* vertices_proto);
+
+// Restores the arrays into the frames of the vertices that have been
+// deserialized from the vertices proto passed to
+// moveFrameArraysToSectionsFile, given in the order of the proto. Returns
+// false if the file is missing, corrupt or doesn't match the vertices.
+bool loadFrameArraysFromSectionsFile(
+    const std::string& file_path, const std::vector<Vertex*>& vertices);
+
+}  // namespace serialization
+}  // namespace vi_map
+
+#endif  // VI_MAP_FRAME_SECTIONS_H_
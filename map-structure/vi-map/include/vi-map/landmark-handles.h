@@ -0,0 +1,120 @@
+#ifndef VI_MAP_LANDMARK_HANDLES_H_
+#define VI_MAP_LANDMARK_HANDLES_H_
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/flat-hash-map.h>
+#include <maplab-common/macros.h>
+#include <posegraph/unique-id.h>
+
+#include "vi-map/unique-id.h"
+
+namespace vi_map {
+class VIMap;
+
+// Dense 32-bit handles of the landmarks and vertices of a map, which index
+// into arrays instead of hash maps.
+typedef uint32_t LandmarkHandle;
+typedef uint32_t VertexHandle;
+constexpr LandmarkHandle kInvalidLandmarkHandle =
+    std::numeric_limits<LandmarkHandle>::max();
+constexpr VertexHandle kInvalidVertexHandle =
+    std::numeric_limits<VertexHandle>::max();
+
+// A visual frame of a vertex, in a quarter of the memory of a
+// KeypointIdentifier.
+struct FrameHandle {
+  VertexHandle vertex;
+  uint32_t frame_index;
+};
+
+// Interns the landmark and vertex ids of a map into dense handles and stores
+// the landmark observations of the vertices and the observing frames of the
+// landmarks (the backlinks) by handle. Algorithms that visit many
+// observations resolve every id once here, after which every access to the
+// storing vertex or the observations of a landmark is an array lookup instead
+// of a query of the landmark index and the landmark store.
+//
+// Like the covisibility graph, the table is a snapshot that is built on
+// demand and is not updated if the map changes. update() refreshes it from
+// the map. The handles are persistent: a landmark or vertex keeps its handle
+// for the lifetime of the table, new ones get the next free handles and the
+// handles of removed ones are not reused, they have no storing vertex and no
+// observations after the update. Observations of vertices that are not in the
+// map are dropped.
+class LandmarkHandleTable {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(LandmarkHandleTable);
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(LandmarkHandleTable);
+
+  explicit LandmarkHandleTable(const VIMap& map);
+
+  // Interns the new landmarks and vertices of the map and rebuilds the
+  // observations and backlinks.
+  void update(const VIMap& map);
+
+  size_t numLandmarkHandles() const {
+    return landmark_ids_.size();
+  }
+  size_t numVertexHandles() const {
+    return vertex_ids_.size();
+  }
+
+  // Returns the invalid handle if the id has never been interned.
+  LandmarkHandle getLandmarkHandle(const LandmarkId& landmark_id) const;
+  VertexHandle getVertexHandle(const pose_graph::VertexId& vertex_id) const;
+
+  const LandmarkId& getLandmarkId(const LandmarkHandle landmark) const {
+    CHECK_LT(landmark, landmark_ids_.size());
+    return landmark_ids_[landmark];
+  }
+  const pose_graph::VertexId& getVertexId(const VertexHandle vertex) const {
+    CHECK_LT(vertex, vertex_ids_.size());
+    return vertex_ids_[vertex];
+  }
+
+  // The invalid handle if the landmark has been removed from the map.
+  VertexHandle getStoringVertex(const LandmarkHandle landmark) const {
+    CHECK_LT(landmark, storing_vertices_.size());
+    return storing_vertices_[landmark];
+  }
+
+  // One handle per keypoint of the frame, the invalid handle for keypoints
+  // without a landmark. Empty for frames that are not set.
+  const std::vector<LandmarkHandle>& getFrameObservedLandmarks(
+      const VertexHandle vertex, const size_t frame_index) const {
+    CHECK_LT(vertex, vertex_observations_.size());
+    CHECK_LT(frame_index, vertex_observations_[vertex].size());
+    return vertex_observations_[vertex][frame_index];
+  }
+  size_t numFrames(const VertexHandle vertex) const {
+    CHECK_LT(vertex, vertex_observations_.size());
+    return vertex_observations_[vertex].size();
+  }
+
+  // One frame per observation of the landmark, i.e. a frame that observes the
+  // landmark with several keypoints is listed several times.
+  const std::vector<FrameHandle>& getObservingFrames(
+      const LandmarkHandle landmark) const {
+    CHECK_LT(landmark, landmark_backlinks_.size());
+    return landmark_backlinks_[landmark];
+  }
+
+ private:
+  common::FlatHashMap<LandmarkId, LandmarkHandle> landmark_id_to_handle_;
+  common::FlatHashMap<pose_graph::VertexId, VertexHandle> vertex_id_to_handle_;
+  std::vector<LandmarkId> landmark_ids_;
+  std::vector<pose_graph::VertexId> vertex_ids_;
+
+  std::vector<VertexHandle> storing_vertices_;
+  // Per vertex and frame.
+  std::vector<std::vector<std::vector<LandmarkHandle>>> vertex_observations_;
+  std::vector<std::vector<FrameHandle>> landmark_backlinks_;
+};
+
+}  // namespace vi_map
+
+#endif  // VI_MAP_LANDMARK_HANDLES_H_
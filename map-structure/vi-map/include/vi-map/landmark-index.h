@@ -2,6 +2,8 @@
 #define VI_MAP_LANDMARK_INDEX_H_
 
 #include <algorithm>
+#include <array>
+#include <functional>
 #include <mutex>
 #include <unordered_map>
 #include <unordered_set>
@@ -10,6 +12,8 @@
 
 #include <gtest/gtest_prod.h>
 #include <maplab-common/accessors.h>
+#include <maplab-common/flat-hash-map.h>
+#include <maplab-common/memory-accounting.h>
 #include <vi-map/unique-id.h>
 
 class LoopClosureHandlerTest;
@@ -22,9 +26,16 @@ class SixDofVIMapGenerator;
 namespace vi_map {
 class VIMap;
 
-typedef std::unordered_map<LandmarkId, pose_graph::VertexId>
+// Open-addressing hash map, as this index is queried for every landmark
+// observation.
+typedef common::FlatHashMap<LandmarkId, pose_graph::VertexId>
     LandmarkToVertexMap;
 
+// The index is split into shards by landmark id, each guarded by its own
+// mutex, so concurrent queries and updates from worker threads only contend
+// if they hit the same shard. Methods which visit all landmarks lock one
+// shard after the other and hence do not return a consistent snapshot if the
+// index is modified at the same time.
 class LandmarkIndex {
   friend VIMap;
   friend ::LoopClosureHandlerTest;                     // Test.
@@ -35,22 +46,63 @@ class LandmarkIndex {
   LandmarkIndex() {}
 
   void shallowCopyFrom(const LandmarkIndex& other) {
-    std::lock_guard<std::mutex> lock(access_mutex_);
-    index_ = other.index_;
+    for (size_t shard_idx = 0u; shard_idx < kNumShards; ++shard_idx) {
+      const Shard& other_shard = other.shards_[shard_idx];
+      Shard& shard = shards_[shard_idx];
+      std::lock(shard.mutex, other_shard.mutex);
+      std::lock_guard<std::mutex> lock(shard.mutex, std::adopt_lock);
+      std::lock_guard<std::mutex> other_lock(
+          other_shard.mutex, std::adopt_lock);
+      shard.index = other_shard.index;
+    }
   }
 
   void swap(LandmarkIndex* other) {
-    std::lock_guard<std::mutex> lock(access_mutex_);
-    index_.swap(other->index_);
+    CHECK_NOTNULL(other);
+    for (size_t shard_idx = 0u; shard_idx < kNumShards; ++shard_idx) {
+      Shard& other_shard = other->shards_[shard_idx];
+      Shard& shard = shards_[shard_idx];
+      std::lock(shard.mutex, other_shard.mutex);
+      std::lock_guard<std::mutex> lock(shard.mutex, std::adopt_lock);
+      std::lock_guard<std::mutex> other_lock(
+          other_shard.mutex, std::adopt_lock);
+      shard.index.swap(other_shard.index);
+    }
+  }
+
+  // Moves all entries of the other index into this one, the other index is
+  // empty afterwards. Shards that are empty in this index are swapped.
+  void mergeFrom(LandmarkIndex* other) {
+    CHECK_NOTNULL(other);
+    CHECK_NE(other, this);
+    for (size_t shard_idx = 0u; shard_idx < kNumShards; ++shard_idx) {
+      Shard& other_shard = other->shards_[shard_idx];
+      Shard& shard = shards_[shard_idx];
+      std::lock(shard.mutex, other_shard.mutex);
+      std::lock_guard<std::mutex> lock(shard.mutex, std::adopt_lock);
+      std::lock_guard<std::mutex> other_lock(
+          other_shard.mutex, std::adopt_lock);
+      if (shard.index.empty()) {
+        shard.index.swap(other_shard.index);
+        continue;
+      }
+      shard.index.reserve(shard.index.size() + other_shard.index.size());
+      for (const LandmarkToVertexMap::value_type& item : other_shard.index) {
+        CHECK(shard.index.emplace(item.first, item.second).second)
+            << "Landmark " << item.first << " is already in the index!";
+      }
+      other_shard.index.clear();
+    }
   }
 
   inline pose_graph::VertexId getStoringVertexId(
       const LandmarkId& landmark_id) const {
     CHECK(landmark_id.isValid()) << "The landark is is not valid.";
-    std::lock_guard<std::mutex> lock(access_mutex_);
-    LandmarkToVertexMap::const_iterator it = index_.find(landmark_id);
-    CHECK(it != index_.end()) << "Landmark " << landmark_id << " is not "
-                              << "present in the landmark index.";
+    const Shard& shard = getShard(landmark_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    LandmarkToVertexMap::const_iterator it = shard.index.find(landmark_id);
+    CHECK(it != shard.index.end()) << "Landmark " << landmark_id << " is not "
+                                   << "present in the landmark index.";
     return it->second;
   }
 
@@ -58,78 +110,144 @@ class LandmarkIndex {
       const vi_map::LandmarkId& landmark_id,
       const pose_graph::VertexId& vertex_id) {
     CHECK(landmark_id.isValid());
-    std::lock_guard<std::mutex> lock(access_mutex_);
-    CHECK(!hasLandmarkInternal(landmark_id)) << "Landmark " << landmark_id
-                                             << " is already in the index!";
-    index_.emplace(landmark_id, vertex_id);
+    Shard& shard = getShard(landmark_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    CHECK(shard.index.emplace(landmark_id, vertex_id).second)
+        << "Landmark " << landmark_id << " is already in the index!";
   }
 
   inline void getAllLandmarkIds(
       std::unordered_set<LandmarkId>* landmark_ids) const {
     CHECK_NOTNULL(landmark_ids)->clear();
-    std::lock_guard<std::mutex> lock(access_mutex_);
-    for (const LandmarkToVertexMap::value_type& item : index_) {
-      landmark_ids->emplace(item.first);
+    landmark_ids->reserve(numLandmarks());
+    for (const Shard& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      for (const LandmarkToVertexMap::value_type& item : shard.index) {
+        landmark_ids->emplace(item.first);
+      }
     }
   }
 
   inline void getAllLandmarkIds(
       std::vector<LandmarkId>* landmark_ids) const {
     CHECK_NOTNULL(landmark_ids)->clear();
-    landmark_ids->resize(index_.size());
-
-    std::lock_guard<std::mutex> lock(access_mutex_);
-    size_t idx = 0u;
-    for (const LandmarkToVertexMap::value_type& item : index_) {
-      (*landmark_ids)[idx] = item.first;
-      ++idx;
+    landmark_ids->reserve(numLandmarks());
+    for (const Shard& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      for (const LandmarkToVertexMap::value_type& item : shard.index) {
+        landmark_ids->emplace_back(item.first);
+      }
     }
   }
 
   inline size_t numLandmarks() const {
-    std::lock_guard<std::mutex> lock(access_mutex_);
-    return index_.size();
+    size_t num_landmarks = 0u;
+    for (const Shard& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      num_landmarks += shard.index.size();
+    }
+    return num_landmarks;
+  }
+
+  inline size_t getMemoryUsageBytes() const {
+    size_t num_bytes = 0u;
+    for (const Shard& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      num_bytes += common::getHeapBytes(shard.index);
+    }
+    return num_bytes;
   }
 
   inline bool hasLandmark(const LandmarkId& landmark_id) const {
-    std::lock_guard<std::mutex> lock(access_mutex_);
-    return index_.count(landmark_id) > 0u;
+    const Shard& shard = getShard(landmark_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.index.count(landmark_id) > 0u;
   }
 
   inline void updateVertexOfLandmark(
       const LandmarkId& landmark_id,
       const pose_graph::VertexId& vertex_id) {
-    std::lock_guard<std::mutex> lock(access_mutex_);
-    LandmarkToVertexMap::iterator it = index_.find(landmark_id);
-    CHECK(it != index_.end());
+    Shard& shard = getShard(landmark_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    LandmarkToVertexMap::iterator it = shard.index.find(landmark_id);
+    CHECK(it != shard.index.end());
     it->second = vertex_id;
   }
 
   inline void removeLandmark(
       const LandmarkId& landmark_id) {
-    std::lock_guard<std::mutex> lock(access_mutex_);
-    CHECK(hasLandmarkInternal(landmark_id)) << "Tried to remove a landmark "
-        << "that does not exist!";
-    index_.erase(landmark_id);
+    Shard& shard = getShard(landmark_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    CHECK_EQ(shard.index.erase(landmark_id), 1u)
+        << "Tried to remove a landmark that does not exist!";
+  }
+
+  // Locks every shard only once, for bulk removals.
+  void removeLandmarks(const std::vector<LandmarkId>& landmark_ids) {
+    std::array<std::vector<LandmarkId>, kNumShards> landmark_ids_per_shard;
+    for (const LandmarkId& landmark_id : landmark_ids) {
+      landmark_ids_per_shard[getShardIndex(landmark_id)].push_back(
+          landmark_id);
+    }
+    for (size_t shard_idx = 0u; shard_idx < kNumShards; ++shard_idx) {
+      if (landmark_ids_per_shard[shard_idx].empty()) {
+        continue;
+      }
+      Shard& shard = shards_[shard_idx];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      for (const LandmarkId& landmark_id : landmark_ids_per_shard[shard_idx]) {
+        CHECK_EQ(shard.index.erase(landmark_id), 1u)
+            << "Tried to remove a landmark that does not exist!";
+      }
+    }
   }
 
   void setLandmarkToVertexMap(
       const LandmarkToVertexMap& landmark_to_vertex) {
-    std::lock_guard<std::mutex> lock(access_mutex_);
-    index_ = landmark_to_vertex;
+    clear();
+    reserve(landmark_to_vertex.size());
+    for (const LandmarkToVertexMap::value_type& item : landmark_to_vertex) {
+      addLandmarkAndVertexReference(item.first, item.second);
+    }
   }
 
   inline void clear() {
-    index_.clear();
+    for (Shard& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.index.clear();
+    }
+  }
+
+  inline void reserve(size_t num_landmarks) {
+    // The landmark ids are random, so the shards fill up evenly. Leave some
+    // slack for the deviation from the mean.
+    const size_t num_landmarks_per_shard =
+        (num_landmarks + kNumShards - 1u) / kNumShards * 9u / 8u;
+    for (Shard& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.index.reserve(num_landmarks_per_shard);
+    }
   }
 
  private:
-  inline bool hasLandmarkInternal(const LandmarkId& landmark_id) const {
-    return index_.count(landmark_id) > 0u;
+  static constexpr size_t kNumShards = 64u;
+
+  struct Shard {
+    LandmarkToVertexMap index;
+    mutable std::mutex mutex;
+  };
+
+  static inline size_t getShardIndex(const LandmarkId& landmark_id) {
+    return std::hash<LandmarkId>()(landmark_id) % kNumShards;
+  }
+  inline Shard& getShard(const LandmarkId& landmark_id) {
+    return shards_[getShardIndex(landmark_id)];
+  }
+  inline const Shard& getShard(const LandmarkId& landmark_id) const {
+    return shards_[getShardIndex(landmark_id)];
   }
 
-  LandmarkToVertexMap index_;
-  mutable std::mutex access_mutex_;
+  std::array<Shard, kNumShards> shards_;
 };
 
 }  // namespace vi_map
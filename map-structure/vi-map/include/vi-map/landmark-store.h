@@ -5,6 +5,7 @@
 #include <vector>
 
 #include <aslam/common/memory.h>
+#include <maplab-common/memory-accounting.h>
 
 #include "vi-map/landmark.h"
 #include "vi-map/unique-id.h"
@@ -23,6 +24,9 @@ class LandmarkStore {
 
   void addLandmark(const Landmark& landmark);
   void removeLandmark(const LandmarkId& landmark_id);
+  // Same as above for many landmarks at once, in a single pass over the
+  // store instead of one pass per removed landmark.
+  void removeLandmarks(const LandmarkIdSet& landmark_ids);
   bool hasLandmark(const LandmarkId& landmark_id) const;
 
   unsigned int size() const;
@@ -30,6 +34,10 @@ class LandmarkStore {
   void serialize(vi_map::proto::LandmarkStore* proto) const;
   void deserialize(const vi_map::proto::LandmarkStore& proto);
 
+  // Adds the memory used by the landmarks, their observations and the
+  // id-to-index map.
+  void accumulateMemoryUsage(common::MemoryUsage* usage) const;
+
   inline LandmarkVector::iterator begin() {
     return landmarks_.begin();
   }
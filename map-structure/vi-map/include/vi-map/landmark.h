@@ -1,12 +1,14 @@
 #ifndef VI_MAP_LANDMARK_H_
 #define VI_MAP_LANDMARK_H_
 
+#include <memory>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include <aslam/common/memory.h>
 #include <maplab-common/macros.h>
+#include <maplab-common/memory-accounting.h>
 #include <maplab-common/pose_types.h>
 #include <posegraph/vertex.h>
 
@@ -33,17 +35,26 @@ class Landmark {
     *this = lhs;
   }
 
+  Landmark(Landmark&& lhs) noexcept {
+    *this = std::move(lhs);
+  }
+
   inline Landmark& operator=(const Landmark& lhs) {
     id_ = lhs.id_;
-    observations_ = lhs.observations_;
     quality_ = lhs.quality_;
     B_position_ = lhs.B_position_;
-    appearances_ = lhs.appearances_;
+    cold_data_.reset(
+        lhs.cold_data_ != nullptr ? new ColdData(*lhs.cold_data_) : nullptr);
+    return *this;
+  }
 
-    // Clone covariance if set.
-    if (lhs.B_covariance_ != nullptr) {
-      B_covariance_ = aligned_unique<Eigen::Matrix3d>(*lhs.B_covariance_);
-    }
+  // Moving only passes on the out-of-line data, which makes reordering and
+  // compacting the landmark store cheap.
+  inline Landmark& operator=(Landmark&& lhs) noexcept {
+    id_ = lhs.id_;
+    quality_ = lhs.quality_;
+    B_position_ = lhs.B_position_;
+    cold_data_ = std::move(lhs.cold_data_);
     return *this;
   }
 
@@ -65,23 +76,29 @@ class Landmark {
 
   inline bool get_p_B_Covariance(Eigen::Matrix3d* covariance) const {
     CHECK_NOTNULL(covariance);
-    if (B_covariance_ == nullptr) {
+    const AlignedUniquePtr<Eigen::Matrix3d>& B_covariance =
+        getColdData().B_covariance;
+    if (B_covariance == nullptr) {
       covariance->setZero();
       return false;
     }
-    *covariance = *B_covariance_;
+    *covariance = *B_covariance;
     return true;
   }
 
   inline void set_p_B_Covariance(const Eigen::Matrix3d& covariance) {
-    if (B_covariance_ == nullptr) {
-      B_covariance_ = aligned_unique<Eigen::Matrix3d>();
+    AlignedUniquePtr<Eigen::Matrix3d>& B_covariance =
+        getColdDataMutable().B_covariance;
+    if (B_covariance == nullptr) {
+      B_covariance = aligned_unique<Eigen::Matrix3d>();
     }
-    *B_covariance_ = covariance;
+    *B_covariance = covariance;
   }
 
   inline void unsetCovariance() {
-    B_covariance_.reset();
+    if (cold_data_ != nullptr) {
+      cold_data_->B_covariance.reset();
+    }
   }
 
   inline void setQuality(Quality quality) {
@@ -114,19 +131,7 @@ class Landmark {
 
   void removeObservation(const KeypointIdentifier& observation);
 
-  inline void removeObservation(size_t index) {
-    CHECK_LT(index, observations_.size());
-    if (!appearances_.empty()) {
-      CHECK_EQ(appearances_.size(), observations_.size())
-          << "The appearances "
-          << "of landmark with store id " << id_.hexString() << " are not in "
-          << "sync with the observations as their respective number of "
-             "elements "
-          << "differs.";
-      appearances_.erase(appearances_.begin() + index);
-    }
-    observations_.erase(observations_.begin() + index);
-  }
+  void removeObservation(size_t index);
 
   unsigned int numberOfObserverVertices() const;
 
@@ -169,7 +174,7 @@ class Landmark {
 
   // Allows checking, if appearances have been allocated or not.
   bool areAppearancesAllocated() const {
-    return !appearances_.empty();
+    return !getColdData().appearances.empty();
   }
 
   // Returns the appearances vector.
@@ -181,16 +186,22 @@ class Landmark {
   void serialize(vi_map::proto::Landmark* proto) const;
   void deserialize(const vi_map::proto::Landmark& proto);
 
+  // Adds the heap memory of the observations, appearances and covariance.
+  void accumulateMemoryUsage(common::MemoryUsage* usage) const;
+
   inline bool operator==(const Landmark& lhs) const {
     bool is_same = true;
     is_same &= quality_ == lhs.quality_;
     is_same &= B_position_ == lhs.B_position_;
 
-    if (B_covariance_.get() != nullptr && lhs.B_covariance_.get() != nullptr) {
-      is_same &= (*B_covariance_ == *lhs.B_covariance_);
+    const AlignedUniquePtr<Eigen::Matrix3d>& B_covariance =
+        getColdData().B_covariance;
+    const AlignedUniquePtr<Eigen::Matrix3d>& lhs_B_covariance =
+        lhs.getColdData().B_covariance;
+    if (B_covariance != nullptr && lhs_B_covariance != nullptr) {
+      is_same &= (*B_covariance == *lhs_B_covariance);
     } else {
-      is_same &=
-          B_covariance_.get() == nullptr && lhs.B_covariance_.get() == nullptr;
+      is_same &= B_covariance == nullptr && lhs_B_covariance == nullptr;
     }
     return is_same;
   }
@@ -201,17 +212,36 @@ class Landmark {
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
  private:
-  LandmarkId id_;
-  KeypointIdentifierList observations_;
-  Quality quality_;
+  // The data that most passes over the landmarks do not need. It is kept out
+  // of line, such that the landmark itself only holds the id, position and
+  // quality and the landmarks of a store are densely packed.
+  struct ColdData {
+    ColdData() = default;
+    ColdData(const ColdData& lhs)
+        : observations(lhs.observations), appearances(lhs.appearances) {
+      if (lhs.B_covariance != nullptr) {
+        B_covariance = aligned_unique<Eigen::Matrix3d>(*lhs.B_covariance);
+      }
+    }
 
-  // Appearance vector, with one appearance per observation.
-  std::vector<int> appearances_;
+    KeypointIdentifierList observations;
+    // Appearance vector, with one appearance per observation.
+    std::vector<int> appearances;
+    // Covariance w.r.t. the landmark baseframe. It is optional to reduce the
+    // memory usage.
+    AlignedUniquePtr<Eigen::Matrix3d> B_covariance;
+  };
+
+  // Returns empty data if none was allocated yet.
+  const ColdData& getColdData() const;
+  // Allocates the data on first use.
+  ColdData& getColdDataMutable();
 
-  // Position and covariance w.r.t. landmark baseframe. The covariance is
-  // optional to reduce the memory usage.
+  LandmarkId id_;
+  Quality quality_;
+  // Position w.r.t. landmark baseframe.
   pose::Position3D B_position_;
-  AlignedUniquePtr<Eigen::Matrix3d> B_covariance_;
+  std::unique_ptr<ColdData> cold_data_;
 };
 }  // namespace vi_map
 
@@ -34,6 +34,11 @@ class LaserEdge : public vi_map::Edge {
 
   virtual ~LaserEdge() {}
 
+  size_t getMemoryUsageBytes() const override {
+    return sizeof(LaserEdge) + common::getHeapBytes(laser_timestamps_ns_) +
+           common::getHeapBytes(laser_data_xyzi_);
+  }
+
   void serialize(vi_map::proto::LaserEdge* proto) const;
   void deserialize(
       const pose_graph::EdgeId& id, const vi_map::proto::LaserEdge& proto);
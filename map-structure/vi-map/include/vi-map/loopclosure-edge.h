@@ -29,6 +29,10 @@ class LoopClosureEdge : public vi_map::Edge {
                   const Eigen::Matrix<double, 6, 6>& T_A_B_covariance);
   virtual ~LoopClosureEdge() {}
 
+  size_t getMemoryUsageBytes() const override {
+    return sizeof(LoopClosureEdge);
+  }
+
   void serialize(vi_map::proto::LoopclosureEdge* proto) const;
   void deserialize(
       const pose_graph::EdgeId& id,
@@ -0,0 +1,86 @@
+#ifndef VI_MAP_MAP_CHANGE_TRACKER_H_
+#define VI_MAP_MAP_CHANGE_TRACKER_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include <glog/logging.h>
+#include <maplab-common/macros.h>
+
+#include "vi-map/vi-map-serialization.h"
+
+namespace vi_map {
+
+// Records which proto files of a map folder no longer match the VIMap that has
+// last been loaded from or saved to this folder, so that saving to the same
+// folder again only needs to rewrite these files. The files are identified by
+// their index in the list of map protos, see serialization::internal.
+//
+// Marking files as changed is lock-free and may happen concurrently, e.g. from
+// algorithms modifying vertices in parallel. All other methods must not be
+// called concurrently with any other method.
+class MapChangeTracker {
+ public:
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(MapChangeTracker);
+
+  MapChangeTracker();
+
+  // Starts tracking the changes with respect to the given folder, which holds
+  // num_proto_files proto files that all match the map.
+  void startTracking(const std::string& proto_folder, size_t num_proto_files);
+  void stopTracking();
+  bool isTracking() const {
+    return num_proto_files_ > 0u;
+  }
+  bool isTrackingFolder(const std::string& proto_folder) const;
+  const std::string& getTrackedFolder() const {
+    return proto_folder_;
+  }
+
+  size_t getNumProtoFiles() const {
+    return num_proto_files_;
+  }
+  size_t getNumVertexProtoFiles() const;
+  bool isProtoFileChanged(size_t proto_file_index) const;
+  size_t getNumChangedProtoFiles() const;
+
+  // A no-op if no folder is tracked. A vertex_file_index of -1 denotes a vertex
+  // that is not stored in any vertex file yet, which is always saved.
+  void markVertexFileChanged(int vertex_file_index) {
+    if (vertex_file_index >= 0) {
+      markProtoFileChanged(
+          serialization::internal::kProtoListVerticesStartIndex +
+          static_cast<size_t>(vertex_file_index));
+    }
+  }
+  void markMissionsChanged() {
+    markProtoFileChanged(serialization::internal::kProtoListMissionsIndex);
+  }
+  void markEdgesChanged() {
+    markProtoFileChanged(serialization::internal::kProtoListEdgesIndex);
+  }
+  void markLandmarkIndexChanged() {
+    markProtoFileChanged(serialization::internal::kProtoListLandmarkIndexIndex);
+  }
+  void markOptionalSensorDataChanged() {
+    markProtoFileChanged(serialization::internal::kProtoListOptionalSensorData);
+  }
+
+ private:
+  void markProtoFileChanged(size_t proto_file_index) {
+    // Vertices added after loading can yield indices beyond the tracked files.
+    if (proto_file_index < num_proto_files_) {
+      changed_proto_files_[proto_file_index].store(
+          true, std::memory_order_relaxed);
+    }
+  }
+
+  std::string proto_folder_;
+  size_t num_proto_files_;
+  std::unique_ptr<std::atomic<bool>[]> changed_proto_files_;
+};
+
+}  // namespace vi_map
+
+#endif  // VI_MAP_MAP_CHANGE_TRACKER_H_
@@ -2,8 +2,10 @@
 #define VI_MAP_OPTIONAL_SENSOR_DATA_H_
 
 #include <mutex>
+#include <vector>
 
 #include <Eigen/Core>
+#include <aslam/common/memory.h>
 #include <aslam/common/pose-types.h>
 #include <maplab-common/macros.h>
 #include <maplab-common/temporal-buffer.h>
@@ -22,6 +24,8 @@ class OptionalSensorData final {
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
   OptionalSensorData() = default;
   explicit OptionalSensorData(const OptionalSensorData& other);
+  // Moves the measurement buffers, the mutex is not moved.
+  explicit OptionalSensorData(OptionalSensorData&& other);
   explicit OptionalSensorData(
       const proto::OptionalSensorData& proto_optional_sensor_data);
   ~OptionalSensorData() = default;
@@ -36,6 +40,12 @@ class OptionalSensorData final {
   template <class MeasurementType>
   void addMeasurement(const MeasurementType& measurement);
 
+  // Adds the measurements of one sensor at once, which is much faster than
+  // adding them one by one if they are sorted by timestamp.
+  template <class MeasurementType>
+  void addMeasurements(
+      const Aligned<std::vector, MeasurementType>& measurements);
+
   void getAllSensorIds(SensorIdSet* sensor_ids) const;
 
   template<class MeasurementType>
@@ -69,6 +79,11 @@ class OptionalSensorData final {
   template<class MeasurementType>
   using SensorIdToMeasurementsMap =
       AlignedUnorderedMap<SensorId, MeasurementBuffer<MeasurementType>>;
+
+  template <class MeasurementType>
+  void addMeasurementsImpl(
+      const Aligned<std::vector, MeasurementType>& measurements,
+      SensorIdToMeasurementsMap<MeasurementType>* sensor_id_to_measurements);
   SensorIdToMeasurementsMap<GpsUtmMeasurement>
       sensor_id_to_gps_utm_measurements_;
   SensorIdToMeasurementsMap<GpsWgsMeasurement>
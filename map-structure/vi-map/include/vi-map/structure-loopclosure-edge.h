@@ -67,6 +67,12 @@ class StructureLoopclosureEdge : public vi_map::Edge {
       const pose_graph::VertexId& to, const double switch_variable);
   virtual ~StructureLoopclosureEdge() {}
 
+  size_t getMemoryUsageBytes() const override {
+    return sizeof(StructureLoopclosureEdge) +
+           common::getHeapBytes(
+               landmark_observations_.keypoint_vertex_observation_list);
+  }
+
   inline void setSwitchVariable(double switch_variable) {
     switch_variable_ = switch_variable;
   }
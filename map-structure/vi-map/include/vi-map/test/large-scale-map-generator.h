@@ -0,0 +1,96 @@
+#ifndef VI_MAP_TEST_LARGE_SCALE_MAP_GENERATOR_H_
+#define VI_MAP_TEST_LARGE_SCALE_MAP_GENERATOR_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <aslam/cameras/ncamera.h>
+#include <maplab-common/pose_types.h>
+
+#include "vi-map/vi-map.h"
+
+namespace vi_map {
+
+struct LargeScaleMapGeneratorOptions {
+  // Maps generated with the same options and seed have the same mission,
+  // vertex, edge and landmark ids and the same content.
+  uint64_t seed = 42u;
+
+  size_t num_missions = 1u;
+  size_t num_vertices_per_mission = 1000u;
+  // Distance between two consecutive vertices of a mission.
+  double vertex_spacing_m = 0.5;
+
+  // Every mission drives in circles of this many vertices, such that it
+  // revisits the same places every lap. The missions start at different
+  // places of the same circle. If zero, the missions follow parallel straight
+  // lines and never revisit a place.
+  size_t num_vertices_per_loop = 0u;
+
+  // Number of new landmarks that are observed at every vertex.
+  size_t num_landmarks_per_vertex = 10u;
+  // Number of consecutive vertices, starting at the first observer, observing
+  // every landmark. Controls the co-visibility within a mission.
+  size_t track_length = 10u;
+
+  // When a vertex revisits a place, this fraction of its landmarks are the
+  // landmarks of the first visit of the place, i.e. the loop is already
+  // closed. The other landmarks are duplicates with the same position and
+  // descriptor, which loop closure can find and merge.
+  double revisit_landmark_reuse_ratio = 0.5;
+
+  // Number of threads used to generate the map, 0 uses all hardware threads.
+  size_t num_threads = 0u;
+};
+
+// Generates synthetic maps at the scale of production maps, e.g. many
+// missions with millions of vertices and hundreds of millions of
+// observations, to benchmark loading, loop closure, optimization or
+// sparsification. Unlike VIMapGenerator, the vertices are generated in
+// parallel and no intermediate bookkeeping per landmark is needed: the
+// observations of every vertex follow directly from its mission and index.
+//
+// Every vertex has one frame observing track_length * num_landmarks_per_vertex
+// landmarks, except the first vertices of a mission, and the vertices are
+// connected by odometry edges.
+class LargeScaleMapGenerator {
+ public:
+  explicit LargeScaleMapGenerator(const LargeScaleMapGeneratorOptions& options);
+
+  // Uses a pinhole camera without distortion by default.
+  void setCameraRig(const aslam::NCamera::Ptr& n_camera);
+
+  // Adds the generated missions to the map, which needs to be empty.
+  void generateMap(VIMap* map) const;
+
+ private:
+  size_t getGlobalVertexIndex(size_t mission_idx, size_t vertex_idx) const;
+  size_t getFirstPlaceOfMission(size_t mission_idx) const;
+  size_t getPlaceOfVertex(size_t mission_idx, size_t vertex_idx) const;
+  pose::Transformation getPlacePose(size_t place) const;
+  pose::Transformation getVertexPose(
+      size_t mission_idx, size_t vertex_idx) const;
+  Eigen::Vector3d getLandmarkPosition(size_t place, size_t slot_idx) const;
+
+  // Returns the global index of the vertex that creates the landmark observed
+  // in the given slot of the visit of the given vertex.
+  size_t getLandmarkCreatingVertex(
+      size_t mission_idx, size_t vertex_idx, size_t slot_idx) const;
+  bool isLandmarkReused(size_t global_vertex_idx, size_t slot_idx) const;
+
+  vi_map::Vertex::UniquePtr generateVertex(
+      size_t mission_idx, size_t vertex_idx) const;
+  void addLandmarksStoredInVertex(
+      size_t mission_idx, size_t vertex_idx, vi_map::Vertex* vertex) const;
+
+  const LargeScaleMapGeneratorOptions options_;
+  aslam::NCamera::Ptr n_camera_;
+  // The global index of the vertex that first visits every place of the
+  // loop, or an invalid index if no mission visits the place.
+  std::vector<size_t> first_visit_of_place_;
+};
+
+}  // namespace vi_map
+
+#endif  // VI_MAP_TEST_LARGE_SCALE_MAP_GENERATOR_H_
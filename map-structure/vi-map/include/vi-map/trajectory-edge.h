@@ -35,6 +35,12 @@ class TrajectoryEdge : public vi_map::Edge {
 
   virtual ~TrajectoryEdge() {}
 
+  size_t getMemoryUsageBytes() const override {
+    return sizeof(TrajectoryEdge) +
+           common::getHeapBytes(trajectory_timestamps_ns_) +
+           common::getHeapBytes(trajectory_G_T_I_pq_);
+  }
+
   void serialize(vi_map::proto::TrajectoryEdge* proto) const;
   void deserialize(
       const pose_graph::EdgeId& id, const vi_map::proto::TrajectoryEdge& proto);
@@ -37,6 +37,10 @@ class TransformationEdge : public vi_map::Edge {
       const SensorId& sensor_id);
   virtual ~TransformationEdge() {}
 
+  size_t getMemoryUsageBytes() const override {
+    return sizeof(TransformationEdge);
+  }
+
   virtual bool operator==(const TransformationEdge& other) const {
     bool is_same = true;
     is_same &= static_cast<const vi_map::Edge&>(*this) == other;
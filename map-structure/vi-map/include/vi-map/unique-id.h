@@ -47,6 +47,7 @@ struct VisualFrameIdentifier {
 typedef std::vector<VisualFrameIdentifier> VisualFrameIdentifierList;
 typedef std::unordered_map<aslam::FrameId, VisualFrameIdentifier>
     FrameIdToFrameIdentifierMap;
+typedef std::unordered_map<LandmarkId, LandmarkId> LandmarkToLandmarkMap;
 
 struct KeypointIdentifier {
   VisualFrameIdentifier frame_id;
@@ -161,6 +161,15 @@ int64_t Vertex::getMinTimestampNanoseconds() const {
   return n_frame_->getMinTimestampNanoseconds();
 }
 
+int Vertex::getVertexFileIndex() const {
+  return vertex_file_index_;
+}
+
+void Vertex::setVertexFileIndex(int vertex_file_index) {
+  CHECK_GE(vertex_file_index, -1);
+  vertex_file_index_ = vertex_file_index;
+}
+
 inline bool Vertex::operator==(const Vertex& lhs) const {
   return isSameApartFromOutgoingEdges(lhs) &&
          outgoing_edges_ == lhs.outgoing_edges_;
@@ -15,6 +15,7 @@
 #include <aslam/frames/visual-nframe.h>
 #include <map-resources/resource-common.h>
 #include <maplab-common/macros.h>
+#include <maplab-common/memory-accounting.h>
 #include <maplab-common/pose_types.h>
 #include <maplab-common/proto-helpers.h>
 #include <maplab-common/traits.h>
@@ -69,7 +70,7 @@ class Vertex : public pose_graph::Vertex {
       const pose_graph::VertexId& vertex_id,
       const Eigen::Matrix<double, 6, 1>& imu_ba_bw,
       const aslam::VisualNFrame::Ptr visual_n_frame,
-      const std::vector<std::vector<LandmarkId>>& n_frame_landmarks,
+      std::vector<std::vector<LandmarkId>> n_frame_landmarks,
       const vi_map::MissionId& mission_id);
 
   Vertex(
@@ -89,6 +90,9 @@ class Vertex : public pose_graph::Vertex {
   virtual const pose_graph::VertexId& id() const;
   void setId(const pose_graph::VertexId& id);
 
+  // Uses the copy constructor, i.e. the visual n-frame is shared.
+  virtual pose_graph::Vertex::UniquePtr clone() const;
+
   void set_T_M_I(const pose::Transformation& T_M_I);
   void set_p_M_I(const Eigen::Vector3d& p_M_I);
   void set_q_M_I(const Eigen::Quaterniond& q_M_I);
@@ -251,13 +255,32 @@ class Vertex : public pose_graph::Vertex {
 
   std::string getComparisonString(const Vertex& other) const;
 
+  // Adds the memory used by this vertex: the vertex itself, its visual frames
+  // (descriptors, keypoints and raw images), landmark observations, stored
+  // landmarks, edge ids and frame resource ids. Cameras are shared between
+  // vertices and are not included.
+  void accumulateMemoryUsage(common::MemoryUsage* usage) const;
+
   inline int64_t getMinTimestampNanoseconds() const;
 
+  // Index of the vertex proto file of the map folder that holds this vertex,
+  // -1 if the vertex has not been saved yet. Maintained by the VIMap to track
+  // which files need to be rewritten on saving, see MapChangeTracker.
+  inline int getVertexFileIndex() const;
+  inline void setVertexFileIndex(int vertex_file_index);
+
   // Updates an entry in the observed landmark ids list. This is needed after a
   // landmark has been merged to get rid of the old, deleted id entry and
   // replace it with the new id.
   void updateIdInObservedLandmarkIdList(
       const LandmarkId& old_landmark_id, const LandmarkId& new_landmark_id);
+  // Same as above for many merged landmarks at once, in a single pass over
+  // the observed landmark ids. Returns the number of replaced entries.
+  size_t updateIdsInObservedLandmarkIdList(
+      const LandmarkToLandmarkMap& old_to_new_landmark_ids);
+  // Invalidates the observed landmark ids of removed landmarks in a single
+  // pass. Returns the number of invalidated entries.
+  size_t invalidateObservedLandmarkIds(const LandmarkIdSet& landmark_ids);
 
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
@@ -298,6 +321,8 @@ class Vertex : public pose_graph::Vertex {
 
   // VisualFrame resources;
   FrameResourceMap resource_map_;
+
+  int vertex_file_index_;
 };
 
 }  // namespace vi_map
@@ -50,10 +50,8 @@ bool VIMap::hasVertex(const pose_graph::VertexId& id) const {
   return vertex_exists;
 }
 vi_map::Vertex& VIMap::getVertex(const pose_graph::VertexId& id) {
-  CHECK(id.isValid());
-  vi_map::Vertex& vertex =
-      posegraph.getVertexPtrMutable(id)->getAs<vi_map::Vertex>();
-  CHECK(vertex.getNCameras() != nullptr);
+  vi_map::Vertex& vertex = getVertexWithoutTrackingChanges(id);
+  change_tracker_.markVertexFileChanged(vertex.getVertexFileIndex());
   return vertex;
 }
 vi_map::Vertex* VIMap::getVertexPtr(const pose_graph::VertexId& id) {
@@ -62,8 +60,21 @@ vi_map::Vertex* VIMap::getVertexPtr(const pose_graph::VertexId& id) {
       posegraph.getVertexPtrMutable(id));
   CHECK(vertex_ptr != nullptr);
   CHECK(vertex_ptr->getNCameras() != nullptr);
+  change_tracker_.markVertexFileChanged(vertex_ptr->getVertexFileIndex());
   return vertex_ptr;
 }
+vi_map::Vertex& VIMap::getVertexWithoutTrackingChanges(
+    const pose_graph::VertexId& id) {
+  CHECK(id.isValid());
+  vi_map::Vertex& vertex =
+      posegraph.getVertexPtrMutable(id)->getAs<vi_map::Vertex>();
+  CHECK(vertex.getNCameras() != nullptr);
+  return vertex;
+}
+void VIMap::markVertexChanged(const pose_graph::VertexId& id) {
+  change_tracker_.markVertexFileChanged(
+      getVertexWithoutTrackingChanges(id).getVertexFileIndex());
+}
 const vi_map::Vertex& VIMap::getVertex(const pose_graph::VertexId& id) const {
   CHECK(id.isValid());
   const vi_map::Vertex& vertex =
@@ -108,8 +119,20 @@ bool VIMap::hasEdge(const pose_graph::EdgeId& id) const {
   }
   return edge_exists;
 }
+
+pose_graph::PoseGraphAdjacency::ConstPtr VIMap::getPoseGraphAdjacency() const {
+  return posegraph.getAdjacency();
+}
+void VIMap::markEdgeChanged(const pose_graph::EdgeId& id) {
+  const pose_graph::Edge* edge = posegraph.getEdgePtr(id);
+  CHECK_NOTNULL(edge);
+  change_tracker_.markEdgesChanged();
+  markVertexChanged(edge->from());
+  markVertexChanged(edge->to());
+}
 template <typename EdgeType>
 EdgeType& VIMap::getEdgeAs(const pose_graph::EdgeId& id) {
+  change_tracker_.markEdgesChanged();
   return posegraph.getEdgePtrMutable(id)->getAs<EdgeType>();
 }
 template <typename EdgeType>
@@ -118,6 +141,7 @@ const EdgeType& VIMap::getEdgeAs(const pose_graph::EdgeId& id) const {
 }
 template <typename EdgeType>
 EdgeType* VIMap::getEdgePtrAs(const pose_graph::EdgeId& id) {
+  change_tracker_.markEdgesChanged();
   EdgeType* edge_ptr =
       dynamic_cast<EdgeType*>(posegraph.getEdgePtrMutable(id));  // NOLINT
   CHECK(edge_ptr != nullptr);
@@ -150,6 +174,7 @@ bool VIMap::hasMission(const vi_map::MissionId& id) const {
 
 vi_map::VIMission& VIMap::getMission(const vi_map::MissionId& id) {
   CHECK(id.isValid());
+  change_tracker_.markMissionsChanged();
   vi_map::VIMission& mission =
       common::getChecked(missions, id)->getAs<vi_map::VIMission>();
   return mission;
@@ -179,6 +204,7 @@ bool VIMap::hasMissionBaseFrame(const vi_map::MissionBaseFrameId& id) const {
 vi_map::MissionBaseFrame& VIMap::getMissionBaseFrame(
     const vi_map::MissionBaseFrameId& id) {
   CHECK(id.isValid());
+  change_tracker_.markMissionsChanged();
   return common::getChecked(mission_base_frames, id);
 }
 const vi_map::MissionBaseFrame& VIMap::getMissionBaseFrame(
@@ -235,6 +261,7 @@ bool VIMap::hasLandmark(const vi_map::LandmarkId& id) const {
 void VIMap::updateLandmarkIndexReference(
     const vi_map::LandmarkId& landmark_id,
     const pose_graph::VertexId& vertex_id) {
+  change_tracker_.markLandmarkIndexChanged();
   landmark_index.updateVertexOfLandmark(landmark_id, vertex_id);
 }
 
@@ -775,6 +802,7 @@ void VIMap::removeLandmark(const LandmarkId landmark_id) {
         invalid_global_landmark_id);
     landmark.removeObservation(observation);
   }
+  change_tracker_.markLandmarkIndexChanged();
   landmark_index.removeLandmark(landmark_id);
   store_vertex.getLandmarks().removeLandmark(landmark_id);
 }
@@ -784,6 +812,8 @@ void VIMap::addVertex(vi_map::Vertex::UniquePtr vertex_ptr) {
   CHECK(!hasVertex(vertex_ptr->id())) << "A vertex with id " << vertex_ptr->id()
                                       << " already exists.";
 
+  // The vertex is stored in a new vertex file on the next save.
+  vertex_ptr->setVertexFileIndex(-1);
   posegraph.addVertex(std::move(vertex_ptr));
 }
 
@@ -793,6 +823,9 @@ void VIMap::addEdge(vi_map::Edge::UniquePtr edge_ptr) {
   CHECK(hasMission(getMissionIdForVertex(edge_ptr->from())));
   CHECK(!hasEdge(edge_ptr->id()));
 
+  change_tracker_.markEdgesChanged();
+  markVertexChanged(edge_ptr->from());
+  markVertexChanged(edge_ptr->to());
   posegraph.addEdge(std::move(edge_ptr));
 }
 
@@ -878,15 +911,27 @@ void VIMap::removeVertex(pose_graph::VertexId vertex_id) {
     }
   }
 
+  change_tracker_.markVertexFileChanged(vertex.getVertexFileIndex());
   posegraph.removeVertex(vertex_id);
 }
 
 void VIMap::removeEdge(pose_graph::EdgeId edge_id) {
   CHECK(hasEdge(edge_id));
+  markEdgeChanged(edge_id);
   posegraph.removeEdge(edge_id);
 }
 
 size_t VIMap::removeLoopClosureEdges() {
+  if (change_tracker_.isTracking()) {
+    pose_graph::EdgeIdList edge_ids;
+    posegraph.getAllEdgeIds(&edge_ids);
+    for (const pose_graph::EdgeId& edge_id : edge_ids) {
+      if (posegraph.getEdgePtr(edge_id)->getType() ==
+          pose_graph::Edge::EdgeType::kLoopClosure) {
+        markEdgeChanged(edge_id);
+      }
+    }
+  }
   return posegraph
       .removeEdgesOfType<pose_graph::Edge::EdgeType::kLoopClosure>();
 }
@@ -1016,6 +1061,82 @@ bool VIMap::getFrameResource(
   return false;
 }
 
+template <typename DataType>
+void VIMap::getFrameResources(
+    const std::vector<VisualFrameIdentifier>& frame_ids,
+    const backend::ResourceType& resource_type,
+    std::vector<DataType>* resources, std::vector<bool>* has_resource) const {
+  CHECK_NOTNULL(resources)->clear();
+  CHECK_NOTNULL(has_resource)->assign(frame_ids.size(), false);
+  resources->resize(frame_ids.size());
+
+  std::lock_guard<std::recursive_mutex> lock(resource_mutex_);
+  std::vector<backend::ResourceId> resource_ids;
+  std::vector<size_t> frame_indices;
+  for (size_t idx = 0u; idx < frame_ids.size(); ++idx) {
+    const VisualFrameIdentifier& frame_id = frame_ids[idx];
+    const Vertex& vertex = getVertex(frame_id.vertex_id);
+    backend::ResourceIdSet frame_resource_ids;
+    vertex.getFrameResourceIdsOfType(
+        frame_id.frame_index, resource_type, &frame_resource_ids);
+    if (frame_resource_ids.size() == 1u) {
+      resource_ids.push_back(*frame_resource_ids.begin());
+      frame_indices.push_back(idx);
+    } else if (frame_resource_ids.size() > 1u) {
+      LOG(FATAL) << "VisualFrame " << frame_id.frame_index << " of Vertex "
+                 << frame_id.vertex_id << " has an invalid number ("
+                 << frame_resource_ids.size() << ") of resources of type "
+                 << backend::ResourceTypeNames[static_cast<size_t>(
+                        resource_type)]
+                 << ".";
+    }
+  }
+
+  std::vector<DataType> frame_resources;
+  getResources(resource_ids, resource_type, &frame_resources);
+  CHECK_EQ(frame_resources.size(), frame_indices.size());
+  for (size_t idx = 0u; idx < frame_indices.size(); ++idx) {
+    (*resources)[frame_indices[idx]] = frame_resources[idx];
+    (*has_resource)[frame_indices[idx]] = true;
+  }
+}
+
+template <typename DataType>
+void VIMap::getFrameResources(
+    const pose_graph::VertexIdList& vertex_ids, const unsigned int frame_idx,
+    const backend::ResourceType& resource_type,
+    std::vector<DataType>* resources, std::vector<bool>* has_resource) const {
+  std::vector<VisualFrameIdentifier> frame_ids;
+  frame_ids.reserve(vertex_ids.size());
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    frame_ids.emplace_back(vertex_id, frame_idx);
+  }
+  getFrameResources(frame_ids, resource_type, resources, has_resource);
+}
+
+template <typename DataType>
+void VIMap::prefetchFrameResources(
+    const pose_graph::VertexIdList& vertex_ids,
+    const backend::ResourceType& resource_type) const {
+  backend::ResourceIdAndTypeList sequence;
+  {
+    std::lock_guard<std::recursive_mutex> lock(resource_mutex_);
+    for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+      const Vertex& vertex = getVertex(vertex_id);
+      const unsigned int num_frames = vertex.numFrames();
+      for (unsigned int frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+        backend::ResourceIdSet resource_ids;
+        vertex.getFrameResourceIdsOfType(
+            frame_idx, resource_type, &resource_ids);
+        for (const backend::ResourceId& resource_id : resource_ids) {
+          sequence.emplace_back(resource_id, resource_type);
+        }
+      }
+    }
+  }
+  prefetchResources<DataType>(sequence);
+}
+
 template <typename DataType>
 bool VIMap::hasFrameResource(
     const Vertex& vertex, const unsigned int frame_idx,
@@ -1059,6 +1180,8 @@ void VIMap::clear() {
   mission_base_frames.clear();
   landmark_index.clear();
   selected_missions_.clear();
+  descriptor_pager_.reset();
+  change_tracker_.stopTracking();
 }
 
 template <typename DataType>
@@ -1197,6 +1320,7 @@ inline void VIMap::addOptionalSensorMeasurement(
   CHECK(sensor_manager_.hasSensor(sensor_id));
   OptionalSensorDataMap::iterator optional_sensor_data_iterator =
       optional_sensor_data_map_.find(mission_id);
+  change_tracker_.markOptionalSensorDataChanged();
   if (optional_sensor_data_iterator == optional_sensor_data_map_.end()) {
     OptionalSensorData optional_sensor_data;
     optional_sensor_data.addMeasurement(measurement);
@@ -1,16 +1,23 @@
 #ifndef VI_MAP_VI_MAP_SERIALIZATION_H_
 #define VI_MAP_VI_MAP_SERIALIZATION_H_
 
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <maplab-common/map-manager-config.h>
 #include <maplab-common/network-common.h>
+#include <posegraph/unique-id.h>
 
+#include "vi-map/unique-id.h"
 #include "vi-map/vi_map.pb.h"
 
 namespace vi_map {
 
+class DescriptorPager;
+class Vertex;
 class VIMap;
 
 namespace serialization {
@@ -40,12 +47,44 @@ constexpr char kFileNameOptionalSensorData[] = "optional_sensor_data";
 
 constexpr char kYamlSensorsFilename[] = "sensors.yaml";
 
+// Block sizes of the arena the map protos are parsed into while loading.
+constexpr size_t kProtoArenaStartBlockSize = 1u << 20u;
+constexpr size_t kProtoArenaMaxBlockSize = 64u << 20u;
+
 const std::vector<std::string> kMinimumVIMapProtoFiles = {
     kFileNameMissions, kFileNameEdges, kFileNameLandmarkIndex,
     kFileNameOptionalSensorData};
 
 size_t numberOfProtos(const VIMap& map, const backend::SaveConfig& save_config);
 
+// The zlib level the map proto files are written with, see
+// common::proto_serialization_helper.
+int getCompressionLevel(
+    const backend::SaveConfig::ProtoCompression proto_compression);
+
+// Determines which vertices are stored in which vertex file and which protos
+// of the list of map protos are serialized.
+struct SerializationPlan {
+  std::vector<pose_graph::VertexIdList> vertex_ids_per_file;
+  std::vector<size_t> proto_indices;
+
+  size_t numProtos() const {
+    return kMinNumProtos + vertex_ids_per_file.size();
+  }
+};
+
+// Plans to serialize all protos, with the vertices split into files of
+// save_config.vertices_per_proto_file vertices.
+void planFullSerialization(
+    const VIMap& map, const backend::SaveConfig& save_config,
+    SerializationPlan* plan);
+// Plans to serialize only the protos that changed since the map has been
+// loaded from or saved to the folder tracked by its MapChangeTracker. The
+// vertices keep their vertex file, new vertices are appended in new files.
+void planIncrementalSerialization(
+    const VIMap& map, const backend::SaveConfig& save_config,
+    SerializationPlan* plan);
+
 }  // namespace internal
 
 void serializeVertices(const vi_map::VIMap& map, vi_map::proto::VIMap* proto);
@@ -55,6 +94,9 @@ void serializeVertices(const vi_map::VIMap& map, vi_map::proto::VIMap* proto);
 size_t serializeVertices(
     const vi_map::VIMap& map, const size_t start_index,
     const size_t vertices_per_proto, vi_map::proto::VIMap* proto);
+void serializeVertices(
+    const vi_map::VIMap& map, const pose_graph::VertexIdList& vertex_ids,
+    vi_map::proto::VIMap* proto);
 void serializeEdges(const vi_map::VIMap& map, vi_map::proto::VIMap* proto);
 void serializeMissionsAndBaseframes(
     const vi_map::VIMap& map, vi_map::proto::VIMap* proto);
@@ -68,6 +110,14 @@ void serializeSensorManagerToArray(
 
 // Note: Missions have to be deserialized before vertices.
 void deserializeVertices(const vi_map::proto::VIMap& proto, vi_map::VIMap* map);
+// Deserializes the vertices of the vertex file with the given index in the map
+// folder, which the change tracking of the map refers to. If a descriptor
+// pager is given, the descriptors of the vertices are dropped and restored
+// from the file proto_file_name on demand.
+void deserializeVertices(
+    const vi_map::proto::VIMap& proto, int vertex_file_index,
+    const std::string& proto_file_name, DescriptorPager* descriptor_pager,
+    vi_map::VIMap* map);
 void deserializeEdges(const vi_map::proto::VIMap& proto, vi_map::VIMap* map);
 void deserializeMissionsAndBaseframes(
     const vi_map::proto::VIMap& proto, vi_map::VIMap* map);
@@ -95,6 +145,12 @@ size_t serializeToFunction(
     const vi_map::VIMap& map, const backend::SaveConfig& save_config,
     const std::function<bool(const size_t, const proto::VIMap&)>&  // NOLINT
     function);
+// Only serializes the protos given by the plan.
+// The function may modify the protos before processing them.
+void serializeToFunction(
+    const vi_map::VIMap& map, const internal::SerializationPlan& plan,
+    const std::function<bool(const size_t, proto::VIMap*)>&  // NOLINT
+    function);
 
 // ============================
 // INTERACTION WITH FILE SYSTEM
@@ -121,6 +177,63 @@ void deserializeFromRawArray(
     const network::RawMessageDataList& raw_data, const size_t start_index,
     vi_map::VIMap* map);
 
+// ==========
+// MAP DELTAS
+// ==========
+// A map delta only transfers the part of a map its receiver doesn't have yet,
+// e.g. between a robot and the map server. The receiver first sends the base
+// of the delta, i.e. which missions, vertices and edges it has, to the sender,
+// which replies with the delta relative to this base:
+//  - the new missions with their base frames and optional sensor data,
+//  - the new vertices and the vertices whose fingerprint differs from the
+//    base, which includes the landmarks stored in them,
+//  - the new edges,
+//  - the references of the resources of these vertices.
+// The delta only adds and updates, elements the sender has removed are kept
+// by the receiver. The resource files are not part of the delta, they are
+// transferred separately.
+struct MapDeltaBase {
+  MissionIdSet mission_ids;
+  std::unordered_map<pose_graph::VertexId, uint64_t> vertex_fingerprints;
+  pose_graph::EdgeIdSet edge_ids;
+};
+
+struct MapDeltaStatistics {
+  size_t num_new_missions = 0u;
+  size_t num_new_vertices = 0u;
+  size_t num_changed_vertices = 0u;
+  size_t num_new_edges = 0u;
+  size_t num_resource_references = 0u;
+};
+
+// Hash of everything of the vertex the delta transfers, apart from the
+// descriptors, which are not always resident and never change on their own,
+// and the edges, which are compared by their ids. Independent of the platform,
+// such that the fingerprints of the sender and the receiver can be compared.
+uint64_t computeVertexFingerprint(const vi_map::Vertex& vertex);
+void computeMapDeltaBase(const vi_map::VIMap& map, MapDeltaBase* base);
+
+void serializeMapDeltaBaseToRawArray(
+    const MapDeltaBase& base, network::RawMessageDataList* raw_data);
+void deserializeMapDeltaBaseFromRawArray(
+    const network::RawMessageDataList& raw_data, const size_t start_index,
+    MapDeltaBase* base);
+
+// Appends the delta of the map relative to the base to the raw data. The
+// statistics are optional.
+void serializeMapDeltaToRawArray(
+    const vi_map::VIMap& map, const MapDeltaBase& base,
+    network::RawMessageDataList* raw_data, MapDeltaStatistics* statistics);
+// Applies a delta to the map it has been computed for. The new missions are
+// added with VIMap::mergeAllMissionsFromMap(). The referenced resources are
+// expected in the map folder resource_map_folder, which is added as external
+// resource folder, they are not registered if it is empty. The statistics are
+// optional.
+void applyMapDeltaFromRawArray(
+    const network::RawMessageDataList& raw_data, const size_t start_index,
+    const std::string& resource_map_folder, vi_map::VIMap* map,
+    MapDeltaStatistics* statistics);
+
 }  // namespace serialization
 
 }  // namespace vi_map
@@ -0,0 +1,39 @@
+#ifndef VI_MAP_VI_MAP_SUMMARY_H_
+#define VI_MAP_VI_MAP_SUMMARY_H_
+
+#include <string>
+
+#include "vi-map/vi_map.pb.h"
+
+namespace vi_map {
+class VIMap;
+
+namespace serialization {
+
+// Name of the summary file in the vi_map folder of a map.
+constexpr char kFileNameSummary[] = "summary";
+// Incremented whenever the meaning of a field of the summary changes.
+constexpr unsigned int kMapSummaryFormatVersion = 1u;
+
+// The summary holds the missions with their vertex and landmark counts, time
+// ranges and bounding boxes, the number of edges and the number of resources
+// per type. It is written whenever the map is saved, such that tools can
+// inspect and select maps on the file system without loading them.
+void computeMapSummary(const VIMap& map, proto::MapSummary* summary);
+
+// The map folder is the folder the map has been saved to, i.e. the folder
+// that contains the vi_map folder. Returns false if the file can't be written.
+bool saveMapSummaryToFolder(
+    const std::string& map_folder, const proto::MapSummary& summary);
+// Returns false if the map has no summary, e.g. because it has been saved
+// before summaries were introduced, or if the summary is from a newer format.
+bool loadMapSummaryFromFolder(
+    const std::string& map_folder, proto::MapSummary* summary);
+
+// One line per mission and one for the totals, for printing on the console.
+std::string printMapSummary(const proto::MapSummary& summary);
+
+}  // namespace serialization
+}  // namespace vi_map
+
+#endif  // VI_MAP_VI_MAP_SUMMARY_H_
@@ -15,21 +15,26 @@
 #include <Eigen/SparseCore>
 #include <aslam/common/memory.h>
 #include <aslam/common/pose-types.h>
+#include <aslam/common/reader-writer-lock.h>
 #include <map-resources/resource-common.h>
 #include <map-resources/resource-map.h>
 #include <maplab-common/file-serializable.h>
 #include <maplab-common/macros.h>
 #include <maplab-common/map-manager-config.h>
 #include <maplab-common/map-traits.h>
+#include <maplab-common/memory-accounting.h>
+#include <maplab-common/network-common.h>
 #include <posegraph/pose-graph.h>
 #include <posegraph/unique-id.h>
 
 #include "vi-map/cklam-edge.h"
+#include "vi-map/descriptor-pager.h"
 #include "vi-map/landmark-index.h"
 #include "vi-map/landmark.h"
 #include "vi-map/laser-edge.h"
 #include "vi-map/loopclosure-edge.h"
 #include "vi-map/macros.h"
+#include "vi-map/map-change-tracker.h"
 #include "vi-map/mission-baseframe.h"
 #include "vi-map/mission.h"
 #include "vi-map/pose-graph.h"
@@ -66,8 +71,13 @@ namespace vi_map {
 class SemanticsManager;
 
 namespace serialization {
+struct MapDeltaStatistics;
 void deserializeMissionsAndBaseframes(
     const proto::VIMap& proto, vi_map::VIMap* map);
+void applyMapDeltaFromRawArray(
+    const network::RawMessageDataList& raw_data, const size_t start_index,
+    const std::string& resource_map_folder, vi_map::VIMap* map,
+    MapDeltaStatistics* statistics);
 }  // namespace serialization
 
 typedef std::unordered_map<backend::ResourceId, MissionIdList>
@@ -78,6 +88,26 @@ typedef std::unordered_map<MissionId, pose_graph::VertexIdList>
 
 typedef std::pair<MissionId, pose_graph::VertexIdList> MissionVertexIdPair;
 
+// Statistics of the vertices, landmarks and edges of a mission, see
+// VIMap::getStatisticsOfMissions.
+struct MissionStatistics {
+  // Landmarks by the camera of their first observation.
+  std::vector<size_t> num_good_landmarks_per_camera;
+  std::vector<size_t> num_bad_landmarks_per_camera;
+  std::vector<size_t> num_unknown_landmarks_per_camera;
+  std::vector<size_t> total_num_landmarks_per_camera;
+  size_t num_landmarks = 0u;
+  size_t num_vertices = 0u;
+  size_t num_observations = 0u;
+  size_t num_imu_edges = 0u;
+  size_t num_wheel_odometry_edges = 0u;
+  size_t num_loop_closure_edges = 0u;
+  double distance_travelled_m = 0.0;
+  double duration_s = 0.0;
+  int64_t start_time_ns = 0;
+  int64_t end_time_ns = 0;
+};
+
 class VIMap : public backend::ResourceMap,
               public backend::MapInterface<vi_map::VIMap> {
   friend ::LoopClosureHandlerTest;                     // Test.
@@ -86,6 +116,7 @@ class VIMap : public backend::ResourceMap,
   friend class map_optimization_legacy::SixDofVIMapGenerator;  // Test.
   friend bool checkMapConsistency(const VIMap&);
   friend class VIMapStats;
+  friend class DescriptorPager;
 
  public:
   MAPLAB_POINTER_TYPEDEFS(VIMap);
@@ -96,6 +127,10 @@ class VIMap : public backend::ResourceMap,
       MissionToLandmarkCountMap;
   friend void serialization::deserializeMissionsAndBaseframes(
       const proto::VIMap& proto, vi_map::VIMap* map);
+  friend void serialization::applyMapDeltaFromRawArray(
+      const network::RawMessageDataList& raw_data, const size_t start_index,
+      const std::string& resource_map_folder, vi_map::VIMap* map,
+      serialization::MapDeltaStatistics* statistics);
 
   explicit VIMap(const std::string& map_folder);
   explicit VIMap(const metadata::proto::MetaData& metadata_proto);
@@ -104,8 +139,40 @@ class VIMap : public backend::ResourceMap,
 
   // Discards any data that is not stored in MappedContainerBase-s.
   void deepCopy(const VIMap& other) override;
+
+  /// Pre-allocates the vertex, edge and landmark indices for inserting the
+  /// given number of additional elements in bulk.
+  void reserveAdditional(
+      size_t num_vertices, size_t num_edges, size_t num_landmarks);
   void swap(VIMap* other);  // NOLINT
 
+  /// The descriptors of a map loaded with --vi_map_paged_descriptors are only
+  /// kept partially in memory, see DescriptorPager. Algorithms using the
+  /// descriptors need to ensure they are loaded for the vertices they access.
+  /// All calls are no-ops if the map is not paged, and are thread-safe with
+  /// respect to each other.
+  bool hasDescriptorPager() const;
+  void setDescriptorPager(DescriptorPager::UniquePtr descriptor_pager);
+  void ensureDescriptorsLoaded(
+      const pose_graph::VertexIdList& vertex_ids) const;
+  void ensureDescriptorsLoadedForMission(const MissionId& mission_id) const;
+  /// Restores all paged out descriptors and stops paging.
+  void loadAllPagedOutDescriptors() const;
+
+  /// The changes of the map are tracked with respect to the map folder it has
+  /// last been loaded from or saved to, such that saving to the same folder
+  /// only rewrites the proto files that changed. Any access through a
+  /// non-const accessor counts as a change.
+  const MapChangeTracker& getChangeTracker() const;
+  void startChangeTracking(
+      const std::string& proto_folder, size_t num_proto_files);
+  void stopChangeTracking();
+  bool canSaveIncrementallyTo(const std::string& proto_folder) const;
+  /// Records that the vertices are stored in the given vertex proto file,
+  /// without counting this as a change.
+  void setVertexFileIndex(
+      const pose_graph::VertexIdList& vertex_ids, int vertex_file_index);
+
   bool hexStringToMissionIdIfValid(
       const std::string& map_mission_id_string,
       vi_map::MissionId* mission_id) const;
@@ -152,6 +219,7 @@ class VIMap : public backend::ResourceMap,
 
   template<typename... _Args>
   inline void emplaceOptionalSensorData(_Args&&... __arg) {
+    change_tracker_.markOptionalSensorDataChanged();
     optional_sensor_data_map_.emplace(
         std::piecewise_construct, std::forward_as_tuple(__arg)...);
   }
@@ -172,6 +240,10 @@ class VIMap : public backend::ResourceMap,
 
   inline size_t numEdges() const;
   inline bool hasEdge(const pose_graph::EdgeId& id) const;
+  // Snapshot of the connectivity of the whole pose graph for fast traversals,
+  // ignoring the mission selection. Kept until the graph is modified.
+  inline pose_graph::PoseGraphAdjacency::ConstPtr getPoseGraphAdjacency()
+      const;
   template <typename EdgeType>
   EdgeType& getEdgeAs(const pose_graph::EdgeId& id);
   template <typename EdgeType>
@@ -197,6 +269,10 @@ class VIMap : public backend::ResourceMap,
   inline bool hasMission(const vi_map::MissionId& id) const;
   inline vi_map::VIMission& getMission(const vi_map::MissionId& id);
   inline const vi_map::VIMission& getMission(const vi_map::MissionId& id) const;
+  // Mutex of the mission for the mission accesses of the map manager, see
+  // backend::MapManager::getMissionWriteAccess(). Created on first use; the
+  // mutexes live as long as the map, also if their missions are removed.
+  aslam::ReaderWriterMutex* getMissionMutex(const vi_map::MissionId& id) const;
 
   inline size_t numMissionBaseFrames() const;
   inline bool hasMissionBaseFrame(const vi_map::MissionBaseFrameId& id) const;
@@ -436,6 +512,10 @@ class VIMap : public backend::ResourceMap,
       vi_map::LandmarkIdSet* observed_landmarks) const;
 
   inline void removeLandmark(const LandmarkId landmark_id);
+  /// Same as above for many landmarks at once. Every observer and storing
+  /// vertex is updated once, in parallel, and the landmark index is updated
+  /// once, which is much faster than removing the landmarks one by one.
+  void removeLandmarks(const LandmarkIdList& landmark_ids);
 
   inline void addVertex(vi_map::Vertex::UniquePtr vertex_ptr);
   inline void addEdge(vi_map::Edge::UniquePtr edge_ptr);
@@ -473,6 +553,14 @@ class VIMap : public backend::ResourceMap,
       const vi_map::LandmarkId landmark_id_to_merge,
       const vi_map::LandmarkId& landmark_id_into);
 
+  /// Same as above for many pairs at once, each key is merged into its value.
+  /// Chains, i.e. a landmark that is merged into one that is itself merged,
+  /// are resolved to the landmark that remains. Every observer vertex and the
+  /// landmark index are only updated once, which is much faster than merging
+  /// the pairs one by one. Returns the number of removed landmarks.
+  size_t mergeLandmarks(
+      const vi_map::LandmarkToLandmarkMap& landmark_id_to_merge_to_into);
+
   /// Moves a given landmark to be stored in the "to" vertex
   /// and updating all the references to it.
   void moveLandmarkToOtherVertex(
@@ -499,6 +587,11 @@ class VIMap : public backend::ResourceMap,
       std::vector<size_t>* total_num_landmarks_per_camera,
       size_t* num_landmarks, size_t* num_vertices, size_t* num_observations,
       double* duration_s, int64_t* start_time, int64_t* end_time) const;
+  // Computes the statistics of all given missions in one parallel pass over
+  // their vertices, with the same order as mission_ids.
+  void getStatisticsOfMissions(
+      const vi_map::MissionIdList& mission_ids,
+      std::vector<MissionStatistics>* statistics) const;
 
   std::string printMapStatistics(
       const vi_map::MissionId& mission, const unsigned int mission_number,
@@ -507,6 +600,11 @@ class VIMap : public backend::ResourceMap,
   std::string printMapStatistics(void) const;
   std::string printMapAccumulatedStatistics() const;
 
+  /// Adds the estimated memory used by all vertices, edges, landmarks, the
+  /// landmark and pose-graph indices and the resource cache.
+  void accumulateMemoryUsage(common::MemoryUsage* usage) const;
+  std::string printMapMemoryUsage() const;
+
   /// Merge two vertices which are directly connected in the pose-graph
   /// (neighbors) by moving the landmarks from the "from" vertex to the "to"
   /// vertex. The "from" vertex is then deleted.
@@ -514,6 +612,16 @@ class VIMap : public backend::ResourceMap,
       const pose_graph::VertexId& vertex_id_from,
       const pose_graph::VertexId& vertex_id_to);
 
+  /// Merges all vertices between two consecutive vertices of the list into
+  /// the first of the two, with the same result as merging them one after
+  /// the other with mergeNeighboringVertices. The IMU edges between two kept
+  /// vertices are concatenated into a single new edge once and the
+  /// observation backlinks of every affected landmark are rewritten in a
+  /// single pass. The kept vertices must be of one mission and in the order
+  /// of its traversal edges. Returns the number of merged vertices.
+  size_t mergeAllVerticesBetweenVertices(
+      const pose_graph::VertexIdList& kept_vertex_ids);
+
   void duplicateMission(const vi_map::MissionId& source_mission_id);
 
   // Removes references to the mission object - assumes mission is empty.
@@ -606,6 +714,9 @@ class VIMap : public backend::ResourceMap,
   MISSION_RESOURCE_CONVENIENCE_FUNCTIONS(
       VoxbloxOccupancyMap, backend::ResourceType::kVoxbloxOccupancyMap,
       voxblox::OccupancyMap);
+  MISSION_RESOURCE_CONVENIENCE_FUNCTIONS(
+      ProjectedDescriptorCache,
+      backend::ResourceType::kProjectedDescriptorCache, std::string);
 
   // VisualFrame-based resources
   // ===========================
@@ -630,6 +741,43 @@ class VIMap : public backend::ResourceMap,
       const Vertex& vertex, const unsigned int frame_idx,
       const backend::ResourceType& type) const;
 
+  // Gets the resources of many frames at once, in the order of the frames,
+  // see backend::ResourceMap::getResources(). has_resource tells which
+  // frames have a resource of the type.
+  template <typename DataType>
+  void getFrameResources(
+      const std::vector<VisualFrameIdentifier>& frame_ids,
+      const backend::ResourceType& type, std::vector<DataType>* resources,
+      std::vector<bool>* has_resource) const;
+  // Same for one frame of each of the vertices.
+  template <typename DataType>
+  void getFrameResources(
+      const pose_graph::VertexIdList& vertex_ids, const unsigned int frame_idx,
+      const backend::ResourceType& type, std::vector<DataType>* resources,
+      std::vector<bool>* has_resource) const;
+
+  // Gets the points of the point cloud resource of a frame that are inside of
+  // the region, see backend::ResourceMap::getPointCloudRegion().
+  bool getFramePointCloudRegion(
+      const Vertex& vertex, const unsigned int frame_idx,
+      const backend::ResourceType& type, const Eigen::AlignedBox3f& region,
+      const double level_of_detail, resources::PointCloud* point_cloud) const;
+
+  // Gets the file the resource of a frame is stored in, such that it can be
+  // copied without decoding it, see
+  // backend::ResourceMap::getResourceFilePath().
+  bool getFrameResourceFilePath(
+      const Vertex& vertex, const unsigned int frame_idx,
+      const backend::ResourceType& type, std::string* file_path) const;
+
+  // Loads the frame resources of the vertices in the background, in the
+  // order of the vertices and their frames. Call it before getting the
+  // resources in that order, see backend::ResourceMap::prefetchResources().
+  template <typename DataType>
+  void prefetchFrameResources(
+      const pose_graph::VertexIdList& vertex_ids,
+      const backend::ResourceType& type) const;
+
   template <typename DataType>
   void replaceFrameResource(
       const DataType& resource, const unsigned int frame_idx,
@@ -739,6 +887,9 @@ class VIMap : public backend::ResourceMap,
   // MAP INTERFACE (for map manager)
   // ===============================
   void mergeAllMissionsFromMap(const vi_map::VIMap& other) override;
+  // Moves the vertices, edges and landmark index entries of the other map
+  // instead of copying them. The other map has no missions afterwards.
+  void mergeAllMissionsFromMap(vi_map::VIMap&& other);
   static std::string getSubFolderName();
 
   /// \brief Returns the list of all existing map files in the given map folder.
@@ -762,6 +913,13 @@ class VIMap : public backend::ResourceMap,
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
  private:
+  std::string printMapStatistics(
+      const vi_map::MissionId& mission_id, const unsigned int mission_number,
+      const SemanticsManager& semantics,
+      const MissionStatistics& statistics) const;
+  std::string printMapAccumulatedStatistics(
+      const std::vector<MissionStatistics>& statistics) const;
+
   // Functions to retrieve and modify the resource ids associated with a set of
   // missions of this VIMap.These functinos are NOT threadsafe and should only
   // be used by the public mission resource functions defined above.
@@ -795,9 +953,21 @@ class VIMap : public backend::ResourceMap,
 
   inline void clear();
 
+  // Accesses a vertex without counting it as changed, e.g. for paging in its
+  // descriptors from the map files.
+  inline vi_map::Vertex& getVertexWithoutTrackingChanges(
+      const pose_graph::VertexId& id);
+  // Marks the vertex files of the given vertex or of both vertices of the edge
+  // as changed.
+  inline void markVertexChanged(const pose_graph::VertexId& id);
+  inline void markEdgeChanged(const pose_graph::EdgeId& id);
+
   // Merges only the part inside the VIMap, not the objects related to the
   // ResourceMap.
   void mergeAllMissionsFromMapWithoutResources(const vi_map::VIMap& source_map);
+  // Adds the missions, base frames and sensors of the other map, the first
+  // step of both merges.
+  void mergeMissionsAndSensorsFromMap(const vi_map::VIMap& other);
 
   // To force const accessors in non-const methods.
   const VIMap* const const_this;
@@ -809,11 +979,23 @@ class VIMap : public backend::ResourceMap,
   OptionalSensorDataMap optional_sensor_data_map_;
   // Adding new data? Don't forget to add it to deepCopy() and swap()!
 
+  // The paged out descriptors are treated as a cache, paging them in is hence
+  // allowed from const methods.
+  mutable DescriptorPager::UniquePtr descriptor_pager_;
+
+  MapChangeTracker change_tracker_;
+
   // Used for mission-selective VIMap.
   mutable std::unordered_set<vi_map::MissionId> selected_missions_;
   mutable std::default_random_engine generator_;
 
   mutable std::recursive_mutex resource_mutex_;
+
+  // Not part of the map data: neither copied nor swapped.
+  mutable std::unordered_map<
+      vi_map::MissionId, std::unique_ptr<aslam::ReaderWriterMutex>>
+      mission_mutexes_;
+  mutable std::mutex mission_mutexes_mutex_;
 };
 
 }  // namespace vi_map
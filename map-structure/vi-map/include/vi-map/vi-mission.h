@@ -113,6 +113,20 @@ class VIMission : public Mission {
       const int64_t tolerance_ns, aslam::CameraIdList* camera_ids,
       std::vector<int64_t>* closest_timestamps_ns) const;
 
+  // Batched version of findAllCloseOptionalCameraResources for many
+  // timestamps, e.g. the timestamps of all vertices of the mission. The
+  // resources of every camera are associated with all timestamps in one
+  // sweep over a sorted index. For every camera that has resources of this
+  // type, closest_timestamps_ns contains the timestamp of the closest
+  // resource for every input timestamp, or -1 if there is none within the
+  // tolerance. The cameras are in the same order as returned by
+  // findAllCloseOptionalCameraResources.
+  bool associateOptionalCameraResources(
+      const backend::ResourceType& type,
+      const std::vector<int64_t>& timestamps_ns, const int64_t tolerance_ns,
+      aslam::CameraIdList* camera_ids,
+      std::vector<std::vector<int64_t>>* closest_timestamps_ns) const;
+
   const backend::CameraWithExtrinsics& getOptionalCameraWithExtrinsics(
       const aslam::CameraId& camera_id) const;
 
@@ -24,6 +24,12 @@ class ViwlsEdge : public vi_map::Edge {
       const pose_graph::VertexId& to,
       const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps,
       const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_data);
+  // Takes over the IMU measurements.
+  ViwlsEdge(
+      const pose_graph::EdgeId& id, const pose_graph::VertexId& from,
+      const pose_graph::VertexId& to,
+      Eigen::Matrix<int64_t, 1, Eigen::Dynamic>&& imu_timestamps,
+      Eigen::Matrix<double, 6, Eigen::Dynamic>&& imu_data);
 
   // Constructors used for testing.
   ViwlsEdge(
@@ -34,6 +40,11 @@ class ViwlsEdge : public vi_map::Edge {
 
   virtual ~ViwlsEdge() {}
 
+  size_t getMemoryUsageBytes() const override {
+    return sizeof(ViwlsEdge) + common::getHeapBytes(imu_timestamps_) +
+           common::getHeapBytes(imu_data_);
+  }
+
   void serialize(vi_map::proto::ViwlsEdge* proto) const;
   void deserialize(
       const pose_graph::EdgeId& id, const vi_map::proto::ViwlsEdge& proto);
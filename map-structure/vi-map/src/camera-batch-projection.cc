@@ -0,0 +1,196 @@
+#include "vi-map/camera-batch-projection.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <aslam/cameras/distortion.h>
+#include <glog/logging.h>
+
+namespace vi_map {
+
+namespace {
+// The points are projected in chunks of this many points. The coordinates of
+// a chunk are stored in fixed-size arrays, such that every operation of the
+// kernels runs on contiguous memory and can be vectorized.
+constexpr int kChunkSize = 64;
+typedef Eigen::Array<double, kChunkSize, 1> ChunkArray;
+
+// Same as the minimum depth of aslam's pinhole camera.
+constexpr double kMinimumDepth = 1e-10;
+
+struct NoDistortionKernel {
+  void distort(ChunkArray* /*x*/, ChunkArray* /*y*/) const {}
+};
+
+// See aslam::RadTanDistortion::distortUsingExternalCoefficients.
+struct RadTanDistortionKernel {
+  explicit RadTanDistortionKernel(const Eigen::VectorXd& parameters)
+      : k1(parameters(0)),
+        k2(parameters(1)),
+        p1(parameters(2)),
+        p2(parameters(3)) {}
+
+  void distort(ChunkArray* x, ChunkArray* y) const {
+    const ChunkArray mx2 = x->square();
+    const ChunkArray my2 = y->square();
+    const ChunkArray mxy = *x * *y;
+    const ChunkArray rho2 = mx2 + my2;
+    const ChunkArray rad_dist = k1 * rho2 + k2 * rho2.square();
+    const ChunkArray x_distorted =
+        *x + *x * rad_dist + 2.0 * p1 * mxy + p2 * (rho2 + 2.0 * mx2);
+    *y += *y * rad_dist + 2.0 * p2 * mxy + p1 * (rho2 + 2.0 * my2);
+    *x = x_distorted;
+  }
+
+  const double k1;
+  const double k2;
+  const double p1;
+  const double p2;
+};
+
+// See aslam::EquidistantDistortion::distortUsingExternalCoefficients.
+struct EquidistantDistortionKernel {
+  explicit EquidistantDistortionKernel(const Eigen::VectorXd& parameters)
+      : k1(parameters(0)),
+        k2(parameters(1)),
+        k3(parameters(2)),
+        k4(parameters(3)) {}
+
+  void distort(ChunkArray* x, ChunkArray* y) const {
+    constexpr double kMinRadius = 1e-8;
+    const ChunkArray r = (x->square() + y->square()).sqrt();
+    const ChunkArray theta = r.atan();
+    const ChunkArray theta2 = theta.square();
+    const ChunkArray theta4 = theta2.square();
+    const ChunkArray thetad =
+        theta * (1.0 + k1 * theta2 + k2 * theta4 + k3 * theta4 * theta2 +
+                 k4 * theta4.square());
+    const ChunkArray scaling =
+        (r > kMinRadius).select(thetad / r.max(kMinRadius), 1.0);
+    *x *= scaling;
+    *y *= scaling;
+  }
+
+  const double k1;
+  const double k2;
+  const double k3;
+  const double k4;
+};
+
+template <typename DistortionKernel>
+void projectPointsIntoPinholeCamera(
+    const aslam::Camera& camera, const DistortionKernel& distortion,
+    const Eigen::Matrix3Xd& points_C, Eigen::Matrix2Xd* keypoints,
+    std::vector<aslam::ProjectionResult>* projection_results) {
+  CHECK_NOTNULL(keypoints);
+  CHECK_NOTNULL(projection_results);
+  const Eigen::VectorXd& intrinsics = camera.getParameters();
+  CHECK_EQ(intrinsics.size(), 4);
+  const double fu = intrinsics(0);
+  const double fv = intrinsics(1);
+  const double cu = intrinsics(2);
+  const double cv = intrinsics(3);
+  const double image_width = camera.imageWidth();
+  const double image_height = camera.imageHeight();
+
+  const int num_points = points_C.cols();
+  keypoints->resize(Eigen::NoChange, num_points);
+  projection_results->resize(num_points);
+
+  ChunkArray x, y, z;
+  for (int chunk_start = 0; chunk_start < num_points;
+       chunk_start += kChunkSize) {
+    const int chunk_size = std::min(kChunkSize, num_points - chunk_start);
+    // The unused elements of the last chunk are padded with valid points.
+    x.setZero();
+    y.setZero();
+    z.setOnes();
+    for (int idx = 0; idx < chunk_size; ++idx) {
+      x(idx) = points_C(0, chunk_start + idx);
+      y(idx) = points_C(1, chunk_start + idx);
+      z(idx) = points_C(2, chunk_start + idx);
+    }
+
+    const ChunkArray z_inverse = z.inverse();
+    x *= z_inverse;
+    y *= z_inverse;
+    distortion.distort(&x, &y);
+    x = fu * x + cu;
+    y = fv * y + cv;
+
+    for (int idx = 0; idx < chunk_size; ++idx) {
+      const int point_idx = chunk_start + idx;
+      (*keypoints)(0, point_idx) = x(idx);
+      (*keypoints)(1, point_idx) = y(idx);
+
+      // See aslam::PinholeCamera::evaluateProjectionResult.
+      const bool is_keypoint_visible = x(idx) >= 0.0 && y(idx) >= 0.0 &&
+                                       x(idx) < image_width &&
+                                       y(idx) < image_height;
+      aslam::ProjectionResult::Status status;
+      if (z(idx) > kMinimumDepth) {
+        status = is_keypoint_visible
+                     ? aslam::ProjectionResult::Status::KEYPOINT_VISIBLE
+                     : aslam::ProjectionResult::Status::
+                           KEYPOINT_OUTSIDE_IMAGE_BOX;
+      } else if (z(idx) < 0.0) {
+        status = aslam::ProjectionResult::Status::POINT_BEHIND_CAMERA;
+      } else {
+        status = aslam::ProjectionResult::Status::PROJECTION_INVALID;
+      }
+      (*projection_results)[point_idx] = aslam::ProjectionResult(status);
+    }
+  }
+}
+}  // namespace
+
+void projectPointsIntoCamera(
+    const aslam::Camera& camera, const Eigen::Matrix3Xd& points_C,
+    Eigen::Matrix2Xd* keypoints,
+    std::vector<aslam::ProjectionResult>* projection_results) {
+  CHECK_NOTNULL(keypoints);
+  CHECK_NOTNULL(projection_results);
+  if (camera.getType() == aslam::Camera::Type::kPinhole &&
+      !camera.hasMask()) {
+    const aslam::Distortion& distortion = camera.getDistortion();
+    switch (distortion.getType()) {
+      case aslam::Distortion::Type::kNoDistortion:
+        projectPointsIntoPinholeCamera(
+            camera, NoDistortionKernel(), points_C, keypoints,
+            projection_results);
+        return;
+      case aslam::Distortion::Type::kRadTan:
+        projectPointsIntoPinholeCamera(
+            camera, RadTanDistortionKernel(distortion.getParameters()),
+            points_C, keypoints, projection_results);
+        return;
+      case aslam::Distortion::Type::kEquidistant:
+        projectPointsIntoPinholeCamera(
+            camera, EquidistantDistortionKernel(distortion.getParameters()),
+            points_C, keypoints, projection_results);
+        return;
+      default:
+        break;
+    }
+  }
+  camera.project3Vectorized(points_C, keypoints, projection_results);
+}
+
+void getPointsVisibleInCamera(
+    const aslam::Camera& camera, const aslam::Transformation& T_C_G,
+    const Eigen::Matrix3Xd& points_G, std::vector<char>* is_visible) {
+  CHECK_NOTNULL(is_visible);
+  const Eigen::Matrix3Xd points_C =
+      (T_C_G.getRotationMatrix() * points_G).colwise() + T_C_G.getPosition();
+
+  Eigen::Matrix2Xd keypoints;
+  std::vector<aslam::ProjectionResult> projection_results;
+  projectPointsIntoCamera(camera, points_C, &keypoints, &projection_results);
+
+  is_visible->resize(points_G.cols());
+  for (int idx = 0; idx < points_G.cols(); ++idx) {
+    (*is_visible)[idx] = projection_results[idx].isKeypointVisible();
+  }
+}
+
+}  // namespace vi_map
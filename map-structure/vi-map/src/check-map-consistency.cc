@@ -1,11 +1,380 @@
 #include <vi-map/check-map-consistency.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <mutex>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include <gflags/gflags.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 #include <vi-map/vi-map.h>
 
+DEFINE_double(
+    vi_map_consistency_check_sample_fraction, 1.0,
+    "Fraction of the vertices and landmarks whose frames and landmark "
+    "references are verified by the map consistency check. Values below 1 "
+    "trade completeness for speed, all other checks still cover the whole "
+    "map.");
+DEFINE_double(
+    vi_map_workflow_consistency_check_sample_fraction, 0.0,
+    "Fraction of the map that is checked for consistency between the steps "
+    "of a workflow. 0 only checks the map once at the end of the workflow, "
+    "and only if one of its steps requested a check.");
+
 namespace vi_map {
 
+namespace {
+typedef std::unordered_multimap<vi_map::LandmarkId, pose_graph::VertexId>
+    LandmarkToVertexMap;
+
+// The observers of the landmarks are split into shards by landmark id, so
+// that the shards can be built in parallel without a shared map.
+constexpr size_t kNumLandmarkObserverShards = 64u;
+constexpr bool kAlwaysParallelize = true;
+
+// Sampling checks every sample_stride-th vertex and the landmarks whose id
+// hash is a multiple of sample_stride, i.e. the same subset on every run.
+size_t getSampleStride(const double sample_fraction) {
+  CHECK_GT(sample_fraction, 0.0);
+  CHECK_LE(sample_fraction, 1.0);
+  return std::max<size_t>(
+      1u, static_cast<size_t>(std::round(1.0 / sample_fraction)));
+}
+
+bool isLandmarkSampled(
+    const vi_map::LandmarkId& landmark_id, const size_t sample_stride) {
+  return std::hash<vi_map::LandmarkId>()(landmark_id) % sample_stride == 0u;
+}
+
+size_t getLandmarkObserverShard(
+    const vi_map::LandmarkId& landmark_id, const size_t sample_stride) {
+  // All sampled landmarks share the remainder modulo the stride.
+  return (std::hash<vi_map::LandmarkId>()(landmark_id) / sample_stride) %
+         kNumLandmarkObserverShards;
+}
+
+// The maps whose checks are deferred, with the number of scopes and whether a
+// check has been requested since the outermost scope started.
+struct DeferredConsistencyChecks {
+  std::mutex mutex;
+  std::unordered_map<const vi_map::VIMap*, std::pair<size_t, bool>> maps;
+};
+
+DeferredConsistencyChecks& getDeferredConsistencyChecks() {
+  static DeferredConsistencyChecks deferred_checks;
+  return deferred_checks;
+}
+
+// Returns true and records the request if the checks of the map are deferred.
+bool deferConsistencyCheck(const vi_map::VIMap& vi_map) {
+  DeferredConsistencyChecks& deferred_checks = getDeferredConsistencyChecks();
+  std::lock_guard<std::mutex> lock(deferred_checks.mutex);
+  const std::unordered_map<const vi_map::VIMap*,
+                           std::pair<size_t, bool>>::iterator it =
+      deferred_checks.maps.find(&vi_map);
+  if (it == deferred_checks.maps.end()) {
+    return false;
+  }
+  it->second.second = true;
+  return true;
+}
+
+// Creates a map of all vertices that have a reference to a given sampled
+// landmark in order to check the back-reference from landmark to vertices.
+void buildLandmarkObserverShards(
+    const vi_map::VIMap& vi_map, const pose_graph::VertexIdList& all_vertices,
+    const size_t sample_stride, std::vector<LandmarkToVertexMap>* shards) {
+  CHECK_NOTNULL(shards)->clear();
+  shards->resize(kNumLandmarkObserverShards);
+
+  typedef std::vector<std::pair<vi_map::LandmarkId, pose_graph::VertexId> >
+      ObservationList;
+  std::vector<ObservationList> shard_observations(kNumLandmarkObserverShards);
+  std::vector<std::mutex> shard_mutexes(kNumLandmarkObserverShards);
+  const size_t num_threads = common::getNumHardwareThreads();
+
+  common::ParallelProcess(
+      all_vertices.size(),
+      [&](const std::vector<size_t>& range) {
+        std::vector<ObservationList> block_observations(
+            kNumLandmarkObserverShards);
+        for (const size_t vertex_idx : range) {
+          const pose_graph::VertexId& vertex_id = all_vertices[vertex_idx];
+          if (!vi_map.hasVertex(vertex_id)) {
+            // Already reported by the vertex check.
+            continue;
+          }
+          const vi_map::Vertex& vertex = vi_map.getVertex(vertex_id);
+          for (unsigned int i = 0; i < vertex.numFrames(); ++i) {
+            if (!vertex.isVisualFrameSet(i)) {
+              continue;
+            }
+            for (size_t j = 0; j < vertex.observedLandmarkIdsSize(i); ++j) {
+              const vi_map::LandmarkId& landmark_id =
+                  vertex.getObservedLandmarkId(i, j);
+              if (landmark_id.isValid() &&
+                  isLandmarkSampled(landmark_id, sample_stride)) {
+                block_observations[getLandmarkObserverShard(
+                                       landmark_id, sample_stride)]
+                    .emplace_back(landmark_id, vertex_id);
+              }
+            }
+          }
+        }
+        for (size_t shard_idx = 0u; shard_idx < kNumLandmarkObserverShards;
+             ++shard_idx) {
+          const ObservationList& block = block_observations[shard_idx];
+          std::lock_guard<std::mutex> lock(shard_mutexes[shard_idx]);
+          ObservationList& observations = shard_observations[shard_idx];
+          observations.insert(observations.end(), block.begin(), block.end());
+        }
+      },
+      kAlwaysParallelize, num_threads);
+
+  common::ParallelProcess(
+      kNumLandmarkObserverShards,
+      [&](const std::vector<size_t>& range) {
+        for (const size_t shard_idx : range) {
+          ObservationList& observations = shard_observations[shard_idx];
+          LandmarkToVertexMap& shard = (*shards)[shard_idx];
+          shard.reserve(observations.size());
+          for (const std::pair<vi_map::LandmarkId, pose_graph::VertexId>&
+                   observation : observations) {
+            shard.emplace(observation.first, observation.second);
+          }
+          ObservationList().swap(observations);
+        }
+      },
+      kAlwaysParallelize, num_threads);
+}
+
+// Verifies the landmark ids observed by the frames of the vertex if
+// check_frames is set, and the back-references of the sampled landmarks in its
+// store.
+bool checkLandmarkReferencesOfVertex(
+    const vi_map::VIMap& vi_map, const pose_graph::VertexId& vertex_id,
+    const bool check_frames, const size_t sample_stride,
+    const std::vector<LandmarkToVertexMap>& landmark_observer_shards) {
+  bool is_consistent = true;
+  const Vertex& vertex = vi_map.getVertex(vertex_id);
+
+  // Verify that the Landmark IDs in the visual frame are sane:
+  // These tests look for errors that have a soft bound, the thresholds
+  // here are rather arbitrary.
+  // If we find two times the same landmark ID, how far are they allowed to
+  // be apart in image space before we warn or fail.
+  static constexpr double kImageDisparitySameLandmarkWarn = 10.;
+  static constexpr double kImageDisparitySameLandmarkError = 75;
+  // How often can the same landmark ID occur before we declare a map
+  // inconsistent.
+  static constexpr int kMaxNumSameLandmarkId = 5;
+  std::unordered_map<LandmarkId, int> appearance_count;
+  const int num_frames = check_frames ? vertex.numFrames() : 0;
+  for (int i = 0; i < num_frames; ++i) {
+    if (vertex.isVisualFrameSet(i)) {
+      if (!vertex.getVisualFrame(i).getId().isValid()) {
+        LOG(ERROR) << "Visual frame id for frame " << i << " in vertex "
+                   << vertex_id << " is invalid.";
+        is_consistent = false;
+        continue;
+      }
+      const int num_observed_landmarks = vertex.observedLandmarkIdsSize(i);
+      for (int j = 0; j < num_observed_landmarks; ++j) {
+        LandmarkId observed_landmark_j = vertex.getObservedLandmarkId(i, j);
+        if (!observed_landmark_j.isValid()) {
+          continue;
+        }
+        ++appearance_count[observed_landmark_j];
+        if (appearance_count[observed_landmark_j] > kMaxNumSameLandmarkId) {
+          LOG(ERROR) << "Landmark " << observed_landmark_j << " is observed "
+                     << appearance_count[observed_landmark_j]
+                     << "times in the same frame (" << vertex_id
+                     << ") which is considered an "
+                     << "error (threshold evaluates to "
+                     << kMaxNumSameLandmarkId << ").";
+        }
+
+        for (int k = j + 1; k < num_observed_landmarks; ++k) {
+          LandmarkId observed_landmark_k = vertex.getObservedLandmarkId(i, k);
+          if (!observed_landmark_k.isValid()) {
+            continue;
+          }
+          if (observed_landmark_j != observed_landmark_k) {
+            continue;
+          }
+          // Same landmark id, check the distance in image space.
+          if (vertex.getVisualFrame(i).hasKeypointMeasurements()) {
+            Eigen::Matrix<double, 2, 1> measurement_i =
+                vertex.getVisualFrame(i).getKeypointMeasurement(j);
+            Eigen::Matrix<double, 2, 1> measurement_j =
+                vertex.getVisualFrame(i).getKeypointMeasurement(k);
+            double distance = (measurement_i - measurement_j).norm();
+            if (distance > kImageDisparitySameLandmarkError) {
+              LOG(ERROR) << "Landmark " << observed_landmark_j
+                         << " is observed "
+                         << " twice from the same frame (" << vertex_id
+                         << "), but the "
+                         << "observations evaluate to ["
+                         << measurement_i.transpose() << "] and ["
+                         << measurement_j.transpose() << "] (distance of "
+                         << distance << ") and threshold evaluates to "
+                         << kImageDisparitySameLandmarkError;
+              is_consistent = false;
+            } else if (distance > kImageDisparitySameLandmarkWarn) {
+              LOG(WARNING)
+                  << "Landmark " << observed_landmark_j << " is observed "
+                  << " twice from the same frame (" << vertex_id
+                  << "), but the "
+                  << "observations evaluate to [" << measurement_i.transpose()
+                  << "] and [" << measurement_j.transpose()
+                  << "] (distance of " << distance
+                  << ") and threshold evaluates to "
+                  << kImageDisparitySameLandmarkWarn;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  const vi_map::LandmarkStore& landmark_store = vertex.getLandmarks();
+
+  for (const vi_map::Landmark& landmark : landmark_store) {
+    const vi_map::LandmarkId& landmark_id = landmark.id();
+
+    // If this landmark id is non valid, it should not be in the global map.
+    if (!landmark_id.isValid()) {
+      LOG(ERROR) << "Landmark " << landmark_id.hexString()
+                 << " stored in vertex " << vertex_id.hexString()
+                 << " is invalid. Only valid landmarks should be in the "
+                    "store.";
+      is_consistent = false;
+      continue;
+    }
+    if (!isLandmarkSampled(landmark_id, sample_stride)) {
+      continue;
+    }
+    // Every landmark in the store should be in the global map.
+    if (!vi_map.hasLandmark(landmark_id)) {
+      LOG(ERROR) << "Landmark " << landmark_id.hexString()
+                 << " stored in vertex " << vertex_id.hexString()
+                 << " is not found in the global map.";
+      is_consistent = false;
+    }
+
+    const KeypointIdentifierList& vertex_id_frame_idx_kp_idx =
+        landmark_store.getLandmark(landmark_id).getObservations();
+
+    // Count how often we expect to find every vertex in the backwards
+    // reference list of the current landmark.
+    const LandmarkToVertexMap& landmark_observing_vertices =
+        landmark_observer_shards[getLandmarkObserverShard(
+            landmark_id, sample_stride)];
+    std::pair<LandmarkToVertexMap::const_iterator,
+              LandmarkToVertexMap::const_iterator>
+        range = landmark_observing_vertices.equal_range(landmark_id);
+    std::unordered_map<pose_graph::VertexId, int> refound_map;
+    for (LandmarkToVertexMap::const_iterator it_vertex = range.first;
+         it_vertex != range.second; ++it_vertex) {
+      // Increment the number of times we expect to find this to be
+      // back-referenced from the landmarks.
+      ++refound_map[it_vertex->second];
+    }
+
+    VLOG(5) << "refound map:";
+    for (const std::pair<pose_graph::VertexId, int>& observation_counts :
+         refound_map) {
+      VLOG(5) << "Back-references to vertex "
+              << observation_counts.first.hexString() << " from landmark "
+              << landmark_id.hexString() << "  " << observation_counts.second;
+    }
+
+    // Check that all other observing vertices of this landmark have
+    // set the ID to the same state.
+    for (unsigned int j = 0; j < vertex_id_frame_idx_kp_idx.size(); ++j) {
+      const pose_graph::VertexId& observer_vertex_id =
+          vertex_id_frame_idx_kp_idx[j].frame_id.vertex_id;
+      if (!vi_map.hasVertex(observer_vertex_id)) {
+        LOG(ERROR) << "Landmark " << landmark_id.hexString()
+                   << " stored in vertex " << vertex_id
+                   << " lists the vertex " << observer_vertex_id
+                   << " as observer, but that vertex does not exist.";
+        is_consistent = false;
+        continue;
+      }
+
+      const Vertex& observer_vertex = vi_map.getVertex(observer_vertex_id);
+
+      // Check that we have seen this vertex before.
+      if (refound_map.count(observer_vertex_id) == 0u) {
+        LOG(ERROR) << "Landmark " << landmark_id.hexString()
+                   << " has an unknown vertex listed as observer: "
+                   << observer_vertex_id.hexString();
+        is_consistent = false;
+      }
+      // Check that there is still an unmatched observation for this vertex.
+      if (refound_map[observer_vertex_id] <= 0) {
+        LOG(ERROR)
+            << "The landmark " << landmark_id.hexString()
+            << " has the vertex " << observer_vertex_id.hexString()
+            << " in the list of back-references, but all back-references to"
+            << " this vertex have already been matched.";
+        is_consistent = false;
+      }
+      // Mark as found.
+      --refound_map[observer_vertex_id];
+
+      if (vertex_id_frame_idx_kp_idx[j].keypoint_index >=
+          observer_vertex.observedLandmarkIdsSize(
+              vertex_id_frame_idx_kp_idx[j].frame_id.frame_index)) {
+        LOG(ERROR) << "Keypoint index "
+                   << vertex_id_frame_idx_kp_idx[j].keypoint_index
+                   << " to retrieve landmark ID "
+                   << vertex_id_frame_idx_kp_idx[j].frame_id.vertex_id
+                   << " is out of bounds.";
+        is_consistent = false;
+        continue;
+      }
+
+      const vi_map::LandmarkId& observer_landmark_id =
+          observer_vertex.getObservedLandmarkId(
+              vertex_id_frame_idx_kp_idx[j].frame_id.frame_index,
+              vertex_id_frame_idx_kp_idx[j].keypoint_index);
+      if (!observer_landmark_id.isValid()) {
+        LOG(ERROR) << "The store landmark id " << landmark_id.hexString()
+                   << " has a backlink to an observer that has an invalid"
+                   << " landmark ID.";
+        is_consistent = false;
+      } else if (observer_landmark_id != landmark_id) {
+        LOG(ERROR) << "The store vertex of landmark id "
+                   << landmark_id.hexString()
+                   << " and landmark id in the observer table "
+                   << observer_landmark_id.hexString()
+                   << " are inconsistent";
+        is_consistent = false;
+      }
+    }
+
+    for (const std::pair<pose_graph::VertexId, int>& observation_counts :
+         refound_map) {
+      if (observation_counts.second != 0) {
+        LOG(ERROR) << "Back-references to vertex "
+                   << observation_counts.first.hexString()
+                   << " missing in the list of back-references of landmark "
+                   << landmark_id.hexString();
+        is_consistent = false;
+      }
+    }
+  }
+  return is_consistent;
+}
+}  // namespace
+
 /// Checks whether a given vertex is a GPS reference vertex.
 /// GPS reference vertices have no incoming edges and only GPS outgoing edges,
 /// of which at least one.
@@ -29,7 +398,21 @@ bool isGpsReferenceVertex(
 }
 
 bool checkMapConsistency(const vi_map::VIMap& vi_map) {
-  bool is_consistent = true;
+  if (deferConsistencyCheck(vi_map)) {
+    VLOG(1) << "Deferring the map consistency check to the end of the "
+            << "workflow.";
+    return true;
+  }
+  return checkMapConsistency(
+      vi_map, FLAGS_vi_map_consistency_check_sample_fraction);
+}
+
+bool checkMapConsistency(
+    const vi_map::VIMap& vi_map, const double sample_fraction) {
+  const size_t sample_stride = getSampleStride(sample_fraction);
+  const size_t num_threads = common::getNumHardwareThreads();
+  // Written concurrently by the parallel checks below.
+  std::atomic<bool> is_consistent(true);
   // Verify that every mission has a valid base-frame.
   LOG(INFO) << "Verifying mission base-frames...";
 
@@ -111,335 +494,91 @@ bool checkMapConsistency(const vi_map::VIMap& vi_map) {
   LOG(INFO) << "Verifying landmark validity...";
   vi_map::LandmarkIdList all_landmark_ids;
   vi_map.getAllLandmarkIds(&all_landmark_ids);
-
-  // Build a list of landmarks that we expect to find in every vertex, so
-  // we can then check every vertex in batch for its landmarks which is more
-  // cache efficient.
-  typedef std::unordered_map<pose_graph::VertexId,
-                             std::vector<vi_map::LandmarkId> >
-      ExpectedVertexLandmarks;
-  ExpectedVertexLandmarks vertex_expected_landmarks;
-
-  for (const vi_map::LandmarkId& landmark_id : all_landmark_ids) {
-    if (!vi_map.hasLandmark(landmark_id)) {
-      LOG(ERROR) << "Vi map claims to have global landmark " << landmark_id
-                 << " but then returns false when retrieving it.";
-      is_consistent = false;
-      continue;
-    }
-
-    const pose_graph::VertexId& storing_vertex_id =
-        vi_map.getLandmarkStoreVertexId(landmark_id);
-
-    if (!vi_map.hasVertex(storing_vertex_id)) {
-      LOG(ERROR) << "Landmark: " << landmark_id
-                 << " points to vertex " << storing_vertex_id
-                 << " but this vertex is not in the map.";
-      is_consistent = false;
-      continue;
-    }
-
-    vertex_expected_landmarks[storing_vertex_id].push_back(landmark_id);
-  }
-
-  // Now check all landmarks for every vertex in batch. Iterate through vertices
-  // in cache friendly order too.
-  for (const pose_graph::VertexId& vertex_id : all_vertices) {
-    ExpectedVertexLandmarks::const_iterator it =
-        vertex_expected_landmarks.find(vertex_id);
-    if (it == vertex_expected_landmarks.end()) {
-      LOG(WARNING) << "Skip vertex " << vertex_id << " since no landmarks.";
-      continue;
-    }
-    CHECK(vi_map.hasVertex(vertex_id)) << "No vertex with id "
-                                       << vertex_id.hexString();
-    const vi_map::Vertex& vertex = vi_map.getVertex(vertex_id);
-    const vi_map::LandmarkStore& landmark_store = vertex.getLandmarks();
-    for (const vi_map::LandmarkId& landmark_id : it->second) {
-      if (!landmark_store.hasLandmark(landmark_id)) {
-        LOG(ERROR) << "Landmark to vertex table claims that landmark: "
-                   << landmark_id.hexString() << " resides in vertex "
-                   << vertex_id.hexString() << " which is not the case.";
-        is_consistent = false;
-      }
-    }
-
-    for (const vi_map::Landmark& landmark : landmark_store) {
-      if (!landmark.id().isValid()) {
-        LOG(ERROR) << "Landmark stored in vertex " << vertex_id.hexString()
-                   << " has an invalid ID.";
-        is_consistent = false;
-      } else if (!vi_map.hasLandmark(landmark.id())) {
-        LOG(ERROR) << "Landmark " << landmark.id().hexString() << " stored in "
-                   << "vertex " << vertex_id.hexString() << " has no entry in "
-                   << "landmark index.";
-        is_consistent = false;
-      }
-    }
+  if (sample_stride > 1u) {
+    LOG(INFO) << "Checking a sample of 1/" << sample_stride
+              << " of the vertices and landmarks.";
   }
 
-  LOG_IF(INFO, is_consistent) << "OK.";
-
-  // Create a map of all vertices that have a reference to a given landmark
-  // in order to check the back-reference from landmark to vertices.
-  typedef std::unordered_multimap<vi_map::LandmarkId, pose_graph::VertexId>
-      LandmarkToVertexMap;
-  LandmarkToVertexMap landmark_observing_vertices;
-  LOG(INFO) << "Building landmark observers list...";
-  for (const pose_graph::VertexId& vertex_id : all_vertices) {
-    if (!vi_map.hasVertex(vertex_id)) {
-      LOG(ERROR) << "Vi map claims to have vertex " << vertex_id
-                 << " but then returns false when retrieving it.";
-      is_consistent = false;
-      continue;
-    }
-
-    const vi_map::Vertex& vertex = vi_map.getVertex(vertex_id);
-
-    for (unsigned int i = 0; i < vertex.numFrames(); ++i) {
-      if (vertex.isVisualFrameSet(i)) {
-        for (size_t j = 0; j < vertex.observedLandmarkIdsSize(i); ++j) {
-          vi_map::LandmarkId landmark_id =
-              vertex.getObservedLandmarkId(i, j);
-          if (landmark_id.isValid()) {
-            landmark_observing_vertices.emplace(landmark_id, vertex_id);
-          }
-        }
-      }
-    }
-  }
-  LOG_IF(INFO, is_consistent) << "OK.";
-
-  LOG(INFO) << "Verifying landmark references...";
-  int num_checked = 0;
-  for (const pose_graph::VertexId& vertex_id : all_vertices) {
-    // Existence in map verified above.
-    const Vertex& vertex = vi_map.getVertex(vertex_id);
-
-    LOG_EVERY_N(INFO, static_cast<int>(all_vertices.size()) / 10)
-        << "Verifying vertices... "
-        << std::round(
-               static_cast<double>(num_checked + 1) / all_vertices.size() *
-               100.)
-        << "%";
-
-    // Verify that the Landmark IDs in the visual frame are sane:
-    // These tests look for errors that have a soft bound, the thresholds
-    // here are rather arbitrary.
-    // If we find two times the same landmark ID, how far are they allowed to
-    // be apart in image space before we warn or fail.
-    static constexpr double kImageDisparitySameLandmarkWarn = 10.;
-    static constexpr double kImageDisparitySameLandmarkError = 75;
-    // How often can the same landmark ID occur before we declare a map
-    // inconsistent.
-    static constexpr int kMaxNumSameLandmarkId = 5;
-    std::unordered_map<LandmarkId, int> appearance_count;
-    const int num_frames = vertex.numFrames();
-    for (int i = 0; i < num_frames; ++i) {
-      if (vertex.isVisualFrameSet(i)) {
-        if (!vertex.getVisualFrame(i).getId().isValid()) {
-          LOG(ERROR) << "Visual frame id for frame " << i << " in vertex "
-                     << vertex_id << " is invalid.";
-          is_consistent = false;
-          continue;
-        }
-        const int num_observed_landmarks = vertex.observedLandmarkIdsSize(i);
-        for (int j = 0; j < num_observed_landmarks; ++j) {
-          LandmarkId observed_landmark_j = vertex.getObservedLandmarkId(i, j);
-          if (!observed_landmark_j.isValid()) {
+  common::ParallelProcess(
+      all_landmark_ids.size(),
+      [&](const std::vector<size_t>& range) {
+        for (const size_t landmark_idx : range) {
+          const vi_map::LandmarkId& landmark_id =
+              all_landmark_ids[landmark_idx];
+          if (!isLandmarkSampled(landmark_id, sample_stride)) {
             continue;
           }
-          ++appearance_count[observed_landmark_j];
-          if (appearance_count[observed_landmark_j] > kMaxNumSameLandmarkId) {
-            LOG(ERROR) << "Landmark " << observed_landmark_j << " is observed "
-                       << appearance_count[observed_landmark_j]
-                       << "times in the same frame (" << vertex_id
-                       << ") which is considered an "
-                       << "error (threshold evaluates to "
-                       << kMaxNumSameLandmarkId << ").";
-          }
-
-          for (int k = j + 1; k < num_observed_landmarks; ++k) {
-            LandmarkId observed_landmark_k =
-                vertex.getObservedLandmarkId(i, k);
-            if (!observed_landmark_k.isValid()) {
-              continue;
-            }
-            if (observed_landmark_j != observed_landmark_k) {
-              continue;
-            }
-            // Same landmark id, check the distance in image space.
-            if (vertex.getVisualFrame(i).hasKeypointMeasurements()) {
-              Eigen::Matrix<double, 2, 1> measurement_i =
-                  vertex.getVisualFrame(i).getKeypointMeasurement(j);
-              Eigen::Matrix<double, 2, 1> measurement_j =
-                  vertex.getVisualFrame(i).getKeypointMeasurement(k);
-              double distance = (measurement_i - measurement_j).norm();
-              if (distance > kImageDisparitySameLandmarkError) {
-                LOG(ERROR) << "Landmark " << observed_landmark_j
-                           << " is observed "
-                           << " twice from the same frame (" << vertex_id
-                           << "), but the "
-                           << "observations evaluate to ["
-                           << measurement_i.transpose() << "] and ["
-                           << measurement_j.transpose() << "] (distance of "
-                           << distance << ") and threshold evaluates to "
-                           << kImageDisparitySameLandmarkError;
-                is_consistent = false;
-              } else if (distance > kImageDisparitySameLandmarkWarn) {
-                LOG(WARNING)
-                    << "Landmark " << observed_landmark_j << " is observed "
-                    << " twice from the same frame (" << vertex_id
-                    << "), but the "
-                    << "observations evaluate to [" << measurement_i.transpose()
-                    << "] and [" << measurement_j.transpose()
-                    << "] (distance of " << distance
-                    << ") and threshold evaluates to "
-                    << kImageDisparitySameLandmarkWarn;
-              }
-            }
+          if (!vi_map.hasLandmark(landmark_id)) {
+            LOG(ERROR) << "Vi map claims to have global landmark "
+                       << landmark_id
+                       << " but then returns false when retrieving it.";
+            is_consistent = false;
+            continue;
           }
-        }
-      }
-    }
-
-    const vi_map::LandmarkStore& landmark_store = vertex.getLandmarks();
-
-    for (const vi_map::Landmark& landmark : landmark_store) {
-      const vi_map::LandmarkId& landmark_id = landmark.id();
-
-      // If this landmark id is non valid, it should not be in the global map.
-      if (!landmark_id.isValid()) {
-        LOG(ERROR) << "Landmark " << landmark_id.hexString()
-                   << " stored in vertex " << vertex_id.hexString()
-                   << " is invalid. Only valid landmarks should be in the "
-                      "store.";
-        is_consistent = false;
-      }
-      // Every landmark in the store should be in the global map.
-      if (!vi_map.hasLandmark(landmark_id)) {
-        LOG(ERROR) << "Landmark " << landmark_id.hexString()
-                   << " stored in vertex " << vertex_id.hexString()
-                   << " is not found in the global map.";
-        is_consistent = false;
-      }
 
-      const KeypointIdentifierList& vertex_id_frame_idx_kp_idx =
-          landmark_store.getLandmark(landmark_id).getObservations();
-
-      // Count how often we expect to find every vertex in the backwards
-      // reference list of the current landmark.
-      std::pair<LandmarkToVertexMap::iterator,
-                LandmarkToVertexMap::iterator>
-          range = landmark_observing_vertices.equal_range(landmark_id);
-      std::unordered_map<pose_graph::VertexId, int> refound_map;
-      for (LandmarkToVertexMap::iterator it_vertex = range.first;
-           it_vertex != range.second; ++it_vertex) {
-        // Increment the number of times we expect to find this to be
-        // back-referenced from the landmarks.
-        if (refound_map.count(it_vertex->second) == 0) {
-          refound_map[it_vertex->second] = 1;
-        } else {
-          ++refound_map[it_vertex->second];
-        }
-      }
+          const pose_graph::VertexId& storing_vertex_id =
+              vi_map.getLandmarkStoreVertexId(landmark_id);
 
-      VLOG(5) << "refound map:";
-      for (const std::pair<pose_graph::VertexId, int>& observation_counts :
-           refound_map) {
-        VLOG(5) << "Back-references to vertex "
-                << observation_counts.first.hexString() << " from landmark "
-                << landmark_id.hexString() << "  " << observation_counts.second;
-      }
-
-      // Check that all other observing vertices of this landmark have
-      // set the ID to the same state.
-      for (unsigned int j = 0; j < vertex_id_frame_idx_kp_idx.size(); ++j) {
-        const pose_graph::VertexId& observer_vertex_id =
-            vertex_id_frame_idx_kp_idx[j].frame_id.vertex_id;
-        if (!vi_map.hasVertex(observer_vertex_id)) {
-          LOG(ERROR) << "Landmark " << landmark_id.hexString()
-                     << " stored in vertex " << vertex_id
-                     << " lists the vertex " << observer_vertex_id
-                     << " as observer, but that vertex does not exist.";
-          is_consistent = false;
-        }
-
-        const Vertex& observer_vertex = vi_map.getVertex(observer_vertex_id);
+          if (!vi_map.hasVertex(storing_vertex_id)) {
+            LOG(ERROR) << "Landmark: " << landmark_id << " points to vertex "
+                       << storing_vertex_id
+                       << " but this vertex is not in the map.";
+            is_consistent = false;
+            continue;
+          }
 
-        // Check that we have seen this vertex before.
-        if (refound_map.count(observer_vertex_id) == 0u) {
-          LOG(ERROR) << "Landmark " << landmark_id.hexString()
-                     << " has an unknown vertex listed as observer: "
-                     << observer_vertex_id.hexString();
-          is_consistent = false;
-        }
-        // Check that there is still an unmatched observation for this vertex.
-        if (refound_map[observer_vertex_id] <= 0) {
-          LOG(ERROR)
-              << "The landmark " << landmark_id.hexString()
-              << " has the vertex " << observer_vertex_id.hexString()
-              << " in the list of back-references, but all back-references to"
-              << " this vertex have already been matched.";
-          is_consistent = false;
-        }
-        // Mark as found.
-        --refound_map[observer_vertex_id];
-
-        if (vertex_id_frame_idx_kp_idx[j].keypoint_index >=
-            observer_vertex.observedLandmarkIdsSize(
-                vertex_id_frame_idx_kp_idx[j].frame_id.frame_index)) {
-          LOG(ERROR) << "Keypoint index "
-                     << vertex_id_frame_idx_kp_idx[j].keypoint_index
-                     << " to retrieve landmark ID "
-                     << vertex_id_frame_idx_kp_idx[j].frame_id.vertex_id
-                     << " is out of bounds.";
-          is_consistent = false;
-          continue;
+          if (!vi_map.getVertex(storing_vertex_id)
+                   .getLandmarks()
+                   .hasLandmark(landmark_id)) {
+            LOG(ERROR) << "Landmark to vertex table claims that landmark: "
+                       << landmark_id.hexString() << " resides in vertex "
+                       << storing_vertex_id.hexString()
+                       << " which is not the case.";
+            is_consistent = false;
+          }
         }
+      },
+      kAlwaysParallelize, num_threads);
+  LOG_IF(INFO, is_consistent) << "OK.";
 
-        const vi_map::LandmarkId& observer_landmark_id =
-            observer_vertex.getObservedLandmarkId(
-                vertex_id_frame_idx_kp_idx[j].frame_id.frame_index,
-                vertex_id_frame_idx_kp_idx[j].keypoint_index);
-        if (!observer_landmark_id.isValid()) {
-          LOG(ERROR) << "The store landmark id " << landmark_id.hexString()
-                     << " has a backlink to an observer that has an invalid"
-                     << " landmark ID.";
-          is_consistent = false;
-        } else if (
-            observer_landmark_id != landmark_id) {
-          LOG(ERROR) << "The store vertex of landmark id "
-                     << landmark_id.hexString()
-                     << " and landmark id in the observer table "
-                     << observer_landmark_id.hexString()
-                     << " are inconsistent";
-          is_consistent = false;
-        }
+  LOG(INFO) << "Building landmark observers list...";
+  std::vector<LandmarkToVertexMap> landmark_observer_shards;
+  buildLandmarkObserverShards(
+      vi_map, all_vertices, sample_stride, &landmark_observer_shards);
+  LOG_IF(INFO, is_consistent) << "OK.";
 
-        if (landmark_id.isValid() != observer_landmark_id.isValid()) {
-          LOG(ERROR)
-              << "The valid state of corresponding landmarks stored in vertex "
-              << vertex_id.hexString() << " and "
-              << vertex_id_frame_idx_kp_idx[j].frame_id.vertex_id.hexString()
-              << " are inconsistent";
-          is_consistent = false;
-        }
-      }
+  LOG(INFO) << "Verifying landmark references...";
+  // The number of landmarks per vertex varies a lot, hence the vertices are
+  // handed out in small chunks to whichever thread is idle.
+  constexpr size_t kMinNumVerticesPerChunk = 16u;
+  const size_t num_vertices_per_progress_step =
+      std::max<size_t>(1u, all_vertices.size() / 10u);
+  std::atomic<size_t> num_checked(0u);
+  std::function<void(size_t, size_t)> check_landmark_references =
+      [&](size_t range_begin, size_t range_end) {
+        for (size_t vertex_idx = range_begin; vertex_idx < range_end;
+             ++vertex_idx) {
+          const pose_graph::VertexId& vertex_id = all_vertices[vertex_idx];
+          // Missing vertices have been reported above.
+          if (vi_map.hasVertex(vertex_id) &&
+              !checkLandmarkReferencesOfVertex(
+                  vi_map, vertex_id, vertex_idx % sample_stride == 0u,
+                  sample_stride, landmark_observer_shards)) {
+            is_consistent = false;
+          }
 
-      for (const std::pair<pose_graph::VertexId, int>& observation_counts :
-           refound_map) {
-        if (observation_counts.second != 0) {
-          LOG(ERROR) << "Back-references to vertex "
-                     << observation_counts.first.hexString()
-                     << " missing in the list of back-references of landmark "
-                     << landmark_id.hexString();
-          is_consistent = false;
+          const size_t num_checked_now = ++num_checked;
+          LOG_IF(INFO, num_checked_now % num_vertices_per_progress_step == 0u)
+              << "Verifying vertices... "
+              << std::round(
+                     static_cast<double>(num_checked_now) /
+                     all_vertices.size() * 100.)
+              << "%";
         }
-      }
-    }
-    ++num_checked;
-  }
+      };
+  common::ParallelProcessDynamic(
+      all_vertices.size(), check_landmark_references, num_threads,
+      common::ParallelSchedule::kGuided, kMinNumVerticesPerChunk);
   LOG_IF(INFO, is_consistent) << "OK.";
 
   LOG(INFO) << "Verifying sensor consistency...";
@@ -450,23 +589,31 @@ bool checkMapConsistency(const vi_map::VIMap& vi_map) {
     LOG(INFO) << "OK.";
   }
 
+  // The backbones of the missions are traversed independently.
   LOG(INFO) << "Verifying posegraph consistency for each mission...";
-  for (const vi_map::MissionId& mission_id : mission_ids) {
-    LOG(INFO) << "Verifying mission: " << mission_id << "...";
-    if (!vi_map.hasMission(mission_id)) {
-      LOG(ERROR) << "Vi map claims to have mission " << mission_id
-                 << " but then returns false when retrieving it.";
-      is_consistent = false;
-      continue;
-    }
+  common::ParallelProcess(
+      mission_ids.size(),
+      [&](const std::vector<size_t>& range) {
+        for (const size_t mission_idx : range) {
+          const vi_map::MissionId& mission_id = mission_ids[mission_idx];
+          LOG(INFO) << "Verifying mission: " << mission_id << "...";
+          if (!vi_map.hasMission(mission_id)) {
+            LOG(ERROR) << "Vi map claims to have mission " << mission_id
+                       << " but then returns false when retrieving it.";
+            is_consistent = false;
+            continue;
+          }
 
-    if (!checkPosegraphConsistency(vi_map, mission_id)) {
-      LOG(ERROR) << "Posegraph inconsistent.";
-      is_consistent = false;
-    } else {
-      LOG(INFO) << "OK.";
-    }
-  }
+          if (!checkPosegraphConsistency(vi_map, mission_id)) {
+            LOG(ERROR) << "Posegraph of mission " << mission_id
+                       << " inconsistent.";
+            is_consistent = false;
+          } else {
+            LOG(INFO) << "Mission " << mission_id << " OK.";
+          }
+        }
+      },
+      kAlwaysParallelize, num_threads);
 
   LOG(INFO) << "Looking for orphaned posegraph items...";
   if (!checkForOrphanedPosegraphItems(vi_map)) {
@@ -807,4 +954,48 @@ bool checkSensorConsistency(const vi_map::VIMap& vi_map) {
   return true;
 }
 
+
+ScopedDeferredConsistencyCheck::ScopedDeferredConsistencyCheck(
+    const vi_map::VIMap& vi_map)
+    : vi_map_(vi_map) {
+  DeferredConsistencyChecks& deferred_checks = getDeferredConsistencyChecks();
+  std::lock_guard<std::mutex> lock(deferred_checks.mutex);
+  ++deferred_checks.maps[&vi_map_].first;
+}
+
+ScopedDeferredConsistencyCheck::~ScopedDeferredConsistencyCheck() {
+  bool is_check_requested = false;
+  {
+    DeferredConsistencyChecks& deferred_checks =
+        getDeferredConsistencyChecks();
+    std::lock_guard<std::mutex> lock(deferred_checks.mutex);
+    const std::unordered_map<const vi_map::VIMap*,
+                             std::pair<size_t, bool>>::iterator it =
+        deferred_checks.maps.find(&vi_map_);
+    CHECK(it != deferred_checks.maps.end());
+    CHECK_GT(it->second.first, 0u);
+    if (--it->second.first > 0u) {
+      return;
+    }
+    is_check_requested = it->second.second;
+    deferred_checks.maps.erase(it);
+  }
+  if (is_check_requested) {
+    LOG(INFO) << "Running the deferred map consistency check.";
+    CHECK(checkMapConsistency(
+        vi_map_, FLAGS_vi_map_consistency_check_sample_fraction));
+  }
+}
+
+void ScopedDeferredConsistencyCheck::checkpoint(
+    const std::string& step_name) const {
+  if (FLAGS_vi_map_workflow_consistency_check_sample_fraction <= 0.0) {
+    return;
+  }
+  LOG(INFO) << "Checking the map consistency after " << step_name << '.';
+  CHECK(checkMapConsistency(
+      vi_map_, FLAGS_vi_map_workflow_consistency_check_sample_fraction))
+      << "The map is inconsistent after " << step_name << '.';
+}
+
 }  // namespace vi_map
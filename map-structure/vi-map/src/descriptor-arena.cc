@@ -0,0 +1,131 @@
+#include "vi-map/descriptor-arena.h"
+
+#include <glog/logging.h>
+#include <maplab-common/accessors.h>
+
+#include "vi-map/vertex.h"
+#include "vi-map/vi-map.h"
+
+namespace vi_map {
+
+DescriptorArena::DescriptorArena(
+    const VIMap& map, const pose_graph::VertexIdList& vertex_ids) {
+  build(map, vertex_ids);
+}
+
+DescriptorArena::DescriptorArena(
+    const VIMap& map, const MissionId& mission_id) {
+  pose_graph::VertexIdList vertex_ids;
+  map.getAllVertexIdsInMission(mission_id, &vertex_ids);
+  build(map, vertex_ids);
+}
+
+void DescriptorArena::build(
+    const VIMap& map, const pose_graph::VertexIdList& vertex_ids) {
+  map.ensureDescriptorsLoaded(vertex_ids);
+
+  // Size the arena first so that the descriptors are copied only once.
+  size_t num_descriptors = 0u;
+  int descriptor_size_bytes = 0;
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    const Vertex& vertex = map.getVertex(vertex_id);
+    for (size_t frame_idx = 0u; frame_idx < vertex.numFrames(); ++frame_idx) {
+      if (!vertex.isVisualFrameSet(frame_idx)) {
+        continue;
+      }
+      const DescriptorsT& descriptors =
+          vertex.getVisualFrame(frame_idx).getDescriptors();
+      if (descriptors.cols() == 0) {
+        continue;
+      }
+      if (descriptor_size_bytes == 0) {
+        descriptor_size_bytes = descriptors.rows();
+      }
+      CHECK_EQ(descriptors.rows(), descriptor_size_bytes)
+          << "All descriptors of an arena must have the same size.";
+      num_descriptors += descriptors.cols();
+      frames_.emplace_back();
+      frames_.back().frame_id = VisualFrameIdentifier(vertex_id, frame_idx);
+      frames_.back().num_columns = descriptors.cols();
+    }
+  }
+
+  descriptors_.resize(descriptor_size_bytes, num_descriptors);
+  frame_id_to_range_index_.reserve(frames_.size());
+  size_t first_column = 0u;
+  for (size_t range_idx = 0u; range_idx < frames_.size(); ++range_idx) {
+    FrameRange& range = frames_[range_idx];
+    range.first_column = first_column;
+    first_column += range.num_columns;
+    descriptors_.middleCols(range.first_column, range.num_columns) =
+        map.getVertex(range.frame_id.vertex_id)
+            .getVisualFrame(range.frame_id.frame_index)
+            .getDescriptors();
+    CHECK(frame_id_to_range_index_.emplace(range.frame_id, range_idx).second)
+        << "The vertex " << range.frame_id.vertex_id
+        << " has been added to the arena twice.";
+  }
+  CHECK_EQ(first_column, num_descriptors);
+}
+
+bool DescriptorArena::hasFrame(const VisualFrameIdentifier& frame_id) const {
+  return frame_id_to_range_index_.count(frame_id) > 0u;
+}
+
+DescriptorArena::ConstDescriptorsBlock DescriptorArena::getFrameDescriptors(
+    const VisualFrameIdentifier& frame_id) const {
+  const FrameRange& range = getFrameRange(frame_id);
+  return descriptors_.middleCols(range.first_column, range.num_columns);
+}
+
+const unsigned char* DescriptorArena::getDescriptor(
+    const KeypointIdentifier& keypoint_id) const {
+  const FrameRange& range = getFrameRange(keypoint_id.frame_id);
+  CHECK_LT(keypoint_id.keypoint_index, range.num_columns);
+  return descriptors_.col(range.first_column + keypoint_id.keypoint_index)
+      .data();
+}
+
+void DescriptorArena::getDescriptorsOfObservations(
+    const KeypointIdentifierList& observations,
+    DescriptorsT* descriptors) const {
+  CHECK_NOTNULL(descriptors);
+  descriptors->resize(descriptors_.rows(), observations.size());
+  for (size_t i = 0u; i < observations.size(); ++i) {
+    const FrameRange& range = getFrameRange(observations[i].frame_id);
+    CHECK_LT(observations[i].keypoint_index, range.num_columns);
+    descriptors->col(i) =
+        descriptors_.col(range.first_column + observations[i].keypoint_index);
+  }
+}
+
+void DescriptorArena::forEachFrame(
+    const FrameDescriptorsFunction& function) const {
+  for (const FrameRange& range : frames_) {
+    function(
+        range.frame_id,
+        descriptors_.middleCols(range.first_column, range.num_columns));
+  }
+}
+
+void DescriptorArena::forEachDescriptor(
+    const DescriptorFunction& function) const {
+  for (const FrameRange& range : frames_) {
+    for (size_t keypoint_idx = 0u; keypoint_idx < range.num_columns;
+         ++keypoint_idx) {
+      function(
+          KeypointIdentifier(range.frame_id, keypoint_idx),
+          descriptors_.col(range.first_column + keypoint_idx));
+    }
+  }
+}
+
+const DescriptorArena::FrameRange& DescriptorArena::getFrameRange(
+    const VisualFrameIdentifier& frame_id) const {
+  const size_t range_idx =
+      common::getChecked(frame_id_to_range_index_, frame_id);
+  CHECK_LT(range_idx, frames_.size());
+  return frames_[range_idx];
+}
+
+}  // namespace vi_map
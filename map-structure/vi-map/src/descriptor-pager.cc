@@ -0,0 +1,309 @@
+#include "vi-map/descriptor-pager.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <aslam-serialization/visual-frame-serialization.h>
+#include <aslam/frames/visual-frame.h>
+#include <glog/logging.h>
+#include <google/protobuf/arena.h>
+#include <maplab-common/accessors.h>
+#include <maplab-common/proto-serialization-helper.h>
+
+#include "vi-map/vertex.h"
+#include "vi-map/vi-map-serialization.h"
+#include "vi-map/vi-map.h"
+#include "vi-map/vi_map.pb.h"
+
+namespace vi_map {
+
+DescriptorPager::DescriptorPager(
+    const std::string& vertex_proto_folder, size_t budget_bytes)
+    : vertex_proto_folder_(vertex_proto_folder),
+      budget_bytes_(budget_bytes),
+      resident_bytes_(0u),
+      num_bytes_to_release_(0u) {
+  CHECK(!vertex_proto_folder_.empty());
+  common::MemoryBudget::getInstance().registerConsumer(this);
+}
+
+DescriptorPager::~DescriptorPager() {
+  common::MemoryBudget::getInstance().unregisterConsumer(this);
+}
+
+void DescriptorPager::addPagedOutVertex(
+    const std::string& proto_file_name, int proto_vertex_index,
+    Vertex* vertex) {
+  CHECK(!proto_file_name.empty());
+  CHECK_GE(proto_vertex_index, 0);
+  CHECK_NOTNULL(vertex);
+
+  VertexLocation location;
+  location.proto_vertex_index = proto_vertex_index;
+  const size_t num_frames = vertex->numFrames();
+  location.num_keypoints_per_frame.resize(num_frames, -1);
+  for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+    if (!vertex->isVisualFrameSet(frame_idx)) {
+      continue;
+    }
+    aslam::VisualFrame& frame = vertex->getVisualFrame(frame_idx);
+    location.num_keypoints_per_frame[frame_idx] =
+        static_cast<int>(frame.getNumKeypointMeasurements());
+    frame.setDescriptors(aslam::VisualFrame::DescriptorsT());
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unordered_map<std::string, size_t>::const_iterator file_it =
+      proto_file_name_to_index_.find(proto_file_name);
+  if (file_it == proto_file_name_to_index_.end()) {
+    file_it = proto_file_name_to_index_
+                  .emplace(proto_file_name, proto_file_names_.size())
+                  .first;
+    proto_file_names_.push_back(proto_file_name);
+  }
+  location.file_index = file_it->second;
+  CHECK(vertex_locations_.emplace(vertex->id(), std::move(location)).second)
+      << "Vertex " << vertex->id() << " has already been paged out.";
+}
+
+void DescriptorPager::loadDescriptors(
+    const pose_graph::VertexIdList& vertex_ids, VIMap* map) {
+  CHECK_NOTNULL(map);
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  pose_graph::VertexIdList paged_out_vertex_ids;
+  std::unordered_set<pose_graph::VertexId> requested_vertices;
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    if (vertex_locations_.count(vertex_id) == 0u ||
+        !requested_vertices.insert(vertex_id).second) {
+      continue;
+    }
+    if (resident_vertices_.count(vertex_id) > 0u) {
+      markAsMostRecentlyUsed(vertex_id);
+    } else {
+      paged_out_vertex_ids.push_back(vertex_id);
+    }
+  }
+  if (!paged_out_vertex_ids.empty()) {
+    loadDescriptorsOfPagedOutVertices(paged_out_vertex_ids, map);
+  }
+
+  size_t max_resident_bytes = budget_bytes_;
+  const size_t num_bytes_to_release = num_bytes_to_release_.exchange(0u);
+  if (num_bytes_to_release > 0u) {
+    max_resident_bytes = std::min(
+        max_resident_bytes, resident_bytes_ > num_bytes_to_release
+                                ? resident_bytes_ - num_bytes_to_release
+                                : 0u);
+  }
+  evictLeastRecentlyUsedVertices(requested_vertices, max_resident_bytes, map);
+}
+
+void DescriptorPager::loadAllDescriptors(VIMap* map) {
+  CHECK_NOTNULL(map);
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  pose_graph::VertexIdList paged_out_vertex_ids;
+  for (const std::pair<const pose_graph::VertexId, VertexLocation>& value :
+       vertex_locations_) {
+    if (resident_vertices_.count(value.first) == 0u) {
+      paged_out_vertex_ids.push_back(value.first);
+    }
+  }
+  if (!paged_out_vertex_ids.empty()) {
+    loadDescriptorsOfPagedOutVertices(paged_out_vertex_ids, map);
+  }
+
+  vertex_locations_.clear();
+  resident_vertices_.clear();
+  lru_vertices_.clear();
+  resident_bytes_ = 0u;
+}
+
+size_t DescriptorPager::getNumPagedOutVertices() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return vertex_locations_.size() - resident_vertices_.size();
+}
+
+size_t DescriptorPager::getNumResidentVertices() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return resident_vertices_.size();
+}
+
+size_t DescriptorPager::getResidentBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return resident_bytes_;
+}
+
+std::string DescriptorPager::getMemoryConsumerName() const {
+  return "descriptor pager";
+}
+
+size_t DescriptorPager::getReleasableMemoryBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return resident_bytes_;
+}
+
+size_t DescriptorPager::releaseMemory(size_t num_bytes) {
+  // The map can't be modified from here, the vertices are paged out at the
+  // next loadDescriptors().
+  num_bytes_to_release_ += num_bytes;
+  return 0u;
+}
+
+void DescriptorPager::loadDescriptorsOfPagedOutVertices(
+    const pose_graph::VertexIdList& vertex_ids, VIMap* map) {
+  CHECK_NOTNULL(map);
+
+  // Group the vertices by file so that every file is parsed only once.
+  std::vector<pose_graph::VertexIdList> vertex_ids_per_file(
+      proto_file_names_.size());
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    if (!map->hasVertex(vertex_id)) {
+      // The vertex has been removed from the map since loading.
+      vertex_locations_.erase(vertex_id);
+      continue;
+    }
+    const VertexLocation& location =
+        common::getChecked(vertex_locations_, vertex_id);
+    CHECK_LT(location.file_index, vertex_ids_per_file.size());
+    vertex_ids_per_file[location.file_index].push_back(vertex_id);
+  }
+
+  google::protobuf::ArenaOptions arena_options;
+  arena_options.start_block_size =
+      serialization::internal::kProtoArenaStartBlockSize;
+  arena_options.max_block_size =
+      serialization::internal::kProtoArenaMaxBlockSize;
+  google::protobuf::Arena arena(arena_options);
+
+  for (size_t file_idx = 0u; file_idx < vertex_ids_per_file.size();
+       ++file_idx) {
+    if (vertex_ids_per_file[file_idx].empty()) {
+      continue;
+    }
+    proto::VIMap& proto =
+        *google::protobuf::Arena::CreateMessage<proto::VIMap>(&arena);
+    CHECK(
+        common::proto_serialization_helper::parseProtoFromFile(
+            vertex_proto_folder_, proto_file_names_[file_idx], &proto))
+        << "Could not page in the descriptors from "
+        << proto_file_names_[file_idx] << " in " << vertex_proto_folder_
+        << ".";
+
+    for (const pose_graph::VertexId& vertex_id :
+         vertex_ids_per_file[file_idx]) {
+      const VertexLocation& location =
+          common::getChecked(vertex_locations_, vertex_id);
+      Vertex& vertex = map->getVertexWithoutTrackingChanges(vertex_id);
+      if (!isVertexUnmodified(location, vertex)) {
+        // The frames of the vertex have changed, the stored descriptors no
+        // longer belong to its keypoints.
+        LOG(WARNING) << "The frames of the paged out vertex " << vertex_id
+                     << " have been modified, its descriptors are lost.";
+        vertex_locations_.erase(vertex_id);
+        continue;
+      }
+
+      CHECK_LT(location.proto_vertex_index, proto.vertices_size());
+      pose_graph::VertexId proto_vertex_id;
+      proto_vertex_id.deserialize(
+          proto.vertex_ids(location.proto_vertex_index));
+      CHECK_EQ(proto_vertex_id, vertex_id);
+      const aslam::proto::VisualNFrame& proto_n_frame =
+          proto.vertices(location.proto_vertex_index).n_visual_frame();
+      CHECK_EQ(
+          static_cast<size_t>(proto_n_frame.frames_size()),
+          location.num_keypoints_per_frame.size());
+
+      size_t num_bytes = 0u;
+      for (size_t frame_idx = 0u;
+           frame_idx < location.num_keypoints_per_frame.size(); ++frame_idx) {
+        if (location.num_keypoints_per_frame[frame_idx] < 0) {
+          continue;
+        }
+        aslam::VisualFrame::DescriptorsT descriptors;
+        aslam::serialization::internal::deserializeDescriptors(
+            proto_n_frame.frames(frame_idx), &descriptors);
+        CHECK_EQ(
+            descriptors.cols(), location.num_keypoints_per_frame[frame_idx]);
+        num_bytes += descriptors.size() *
+                     sizeof(aslam::VisualFrame::DescriptorsT::Scalar);
+        vertex.getVisualFrame(frame_idx).swapDescriptors(&descriptors);
+      }
+
+      lru_vertices_.push_front(vertex_id);
+      ResidentVertex& resident_vertex = resident_vertices_[vertex_id];
+      resident_vertex.lru_position = lru_vertices_.begin();
+      resident_vertex.num_bytes = num_bytes;
+      resident_bytes_ += num_bytes;
+    }
+    arena.Reset();
+  }
+}
+
+void DescriptorPager::evictLeastRecentlyUsedVertices(
+    const std::unordered_set<pose_graph::VertexId>& requested_vertices,
+    size_t max_resident_bytes, VIMap* map) {
+  CHECK_NOTNULL(map);
+  while (resident_bytes_ > max_resident_bytes && !lru_vertices_.empty()) {
+    const pose_graph::VertexId vertex_id = lru_vertices_.back();
+    if (requested_vertices.count(vertex_id) > 0u) {
+      // All remaining vertices have just been requested.
+      break;
+    }
+    lru_vertices_.pop_back();
+    resident_bytes_ -= common::getChecked(resident_vertices_, vertex_id)
+                           .num_bytes;
+    resident_vertices_.erase(vertex_id);
+
+    if (!map->hasVertex(vertex_id)) {
+      vertex_locations_.erase(vertex_id);
+      continue;
+    }
+    Vertex& vertex = map->getVertexWithoutTrackingChanges(vertex_id);
+    const VertexLocation& location =
+        common::getChecked(vertex_locations_, vertex_id);
+    if (!isVertexUnmodified(location, vertex)) {
+      // Keep the descriptors of modified vertices, they can't be restored.
+      vertex_locations_.erase(vertex_id);
+      continue;
+    }
+    for (size_t frame_idx = 0u;
+         frame_idx < location.num_keypoints_per_frame.size(); ++frame_idx) {
+      if (location.num_keypoints_per_frame[frame_idx] >= 0) {
+        vertex.getVisualFrame(frame_idx).setDescriptors(
+            aslam::VisualFrame::DescriptorsT());
+      }
+    }
+  }
+}
+
+bool DescriptorPager::isVertexUnmodified(
+    const VertexLocation& location, const Vertex& vertex) const {
+  const size_t num_frames = vertex.numFrames();
+  if (num_frames != location.num_keypoints_per_frame.size()) {
+    return false;
+  }
+  for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+    const int num_keypoints =
+        vertex.isVisualFrameSet(frame_idx)
+            ? static_cast<int>(
+                  vertex.getVisualFrame(frame_idx).getNumKeypointMeasurements())
+            : -1;
+    if (num_keypoints != location.num_keypoints_per_frame[frame_idx]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void DescriptorPager::markAsMostRecentlyUsed(
+    const pose_graph::VertexId& vertex_id) {
+  ResidentVertex& resident_vertex =
+      common::getChecked(resident_vertices_, vertex_id);
+  lru_vertices_.splice(
+      lru_vertices_.begin(), lru_vertices_, resident_vertex.lru_position);
+}
+
+}  // namespace vi_map
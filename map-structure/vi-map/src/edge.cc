@@ -135,6 +135,12 @@ Edge::UniquePtr Edge::deserialize(
   }
 }
 
+pose_graph::Edge::UniquePtr Edge::clone() const {
+  Edge* copied_edge;
+  copyEdgeInto(&copied_edge);
+  return pose_graph::Edge::UniquePtr(copied_edge);
+}
+
 void Edge::copyEdgeInto(Edge** new_edge) const {
   CHECK_NOTNULL(new_edge);
 
@@ -0,0 +1,325 @@
+#include "vi-map/frame-sections.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>  // NOLINT
+#include <string>
+#include <vector>
+
+#include <aslam/frames/visual-frame.h>
+#include <glog/logging.h>
+#include <maplab-common/memory-mapped-file.h>
+
+#include "vi-map/vertex.h"
+
+namespace vi_map {
+namespace serialization {
+namespace {
+constexpr uint32_t kMagicNumber = 0x53464d56u;  // "VMFS"
+constexpr uint32_t kVersion = 1u;
+constexpr uint64_t kSectionAlignment = 64u;
+
+struct SectionsHeader {
+  uint32_t magic_number;
+  uint32_t version;
+  uint64_t num_frames;
+  uint64_t num_keypoints;
+  uint64_t num_scales;
+  uint64_t num_track_ids;
+  uint64_t num_descriptor_bytes;
+  // Byte offsets of the sections from the beginning of the file.
+  uint64_t frames_offset;
+  uint64_t keypoints_offset;
+  uint64_t uncertainties_offset;
+  uint64_t scales_offset;
+  uint64_t track_ids_offset;
+  uint64_t descriptors_offset;
+  uint64_t file_size;
+};
+
+// Describes where the arrays of one frame are stored. The offsets count
+// elements from the beginning of the respective section.
+struct FrameEntry {
+  uint32_t vertex_index;
+  uint32_t frame_index;
+  uint32_t num_keypoints;
+  uint32_t descriptor_size_bytes;
+  uint32_t has_scales;
+  uint32_t has_track_ids;
+  uint64_t keypoint_offset;
+  uint64_t scale_offset;
+  uint64_t track_id_offset;
+  uint64_t descriptor_offset;
+};
+
+uint64_t alignSectionOffset(uint64_t offset) {
+  return (offset + kSectionAlignment - 1u) / kSectionAlignment *
+         kSectionAlignment;
+}
+
+// Computes the section offsets and the file size from the sizes.
+void computeLayout(SectionsHeader* header) {
+  CHECK_NOTNULL(header);
+  uint64_t offset = alignSectionOffset(sizeof(SectionsHeader));
+  header->frames_offset = offset;
+  offset += header->num_frames * sizeof(FrameEntry);
+  header->keypoints_offset = offset = alignSectionOffset(offset);
+  offset += 2u * header->num_keypoints * sizeof(double);
+  header->uncertainties_offset = offset = alignSectionOffset(offset);
+  offset += header->num_keypoints * sizeof(double);
+  header->scales_offset = offset = alignSectionOffset(offset);
+  offset += header->num_scales * sizeof(double);
+  header->track_ids_offset = offset = alignSectionOffset(offset);
+  offset += header->num_track_ids * sizeof(int32_t);
+  header->descriptors_offset = offset = alignSectionOffset(offset);
+  offset += header->num_descriptor_bytes;
+  header->file_size = offset;
+}
+
+bool padToOffset(uint64_t section_offset, std::ofstream* file) {
+  CHECK_NOTNULL(file);
+  const uint64_t position = static_cast<uint64_t>(file->tellp());
+  CHECK_LE(position, section_offset);
+  const std::string padding(section_offset - position, '\0');
+  file->write(padding.data(), padding.size());
+  return file->good();
+}
+
+void writeData(const void* data, uint64_t num_bytes, std::ofstream* file) {
+  CHECK_NOTNULL(file);
+  if (num_bytes > 0u) {
+    file->write(static_cast<const char*>(data), num_bytes);
+  }
+}
+
+const aslam::proto::VisualFrame& getFrameProto(
+    const proto::VIMap& vertices_proto, const FrameEntry& entry) {
+  return vertices_proto.vertices(entry.vertex_index)
+      .n_visual_frame()
+      .frames(entry.frame_index);
+}
+}  // namespace
+
+bool moveFrameArraysToSectionsFile(
+    const std::string& file_path, proto::VIMap* vertices_proto) {
+  CHECK(!file_path.empty());
+  CHECK_NOTNULL(vertices_proto);
+
+  SectionsHeader header;
+  memset(&header, 0, sizeof(SectionsHeader));
+  header.magic_number = kMagicNumber;
+  header.version = kVersion;
+
+  std::vector<FrameEntry> entries;
+  for (int vertex_idx = 0; vertex_idx < vertices_proto->vertices_size();
+       ++vertex_idx) {
+    const aslam::proto::VisualNFrame& n_frame_proto =
+        vertices_proto->vertices(vertex_idx).n_visual_frame();
+    for (int frame_idx = 0; frame_idx < n_frame_proto.frames_size();
+         ++frame_idx) {
+      const aslam::proto::VisualFrame& frame_proto =
+          n_frame_proto.frames(frame_idx);
+      const uint64_t num_keypoints =
+          frame_proto.keypoint_measurement_sigmas_size();
+      if (num_keypoints == 0u && frame_proto.keypoint_descriptors().empty()) {
+        continue;
+      }
+      CHECK_EQ(
+          static_cast<uint64_t>(frame_proto.keypoint_measurements_size()),
+          2u * num_keypoints);
+
+      FrameEntry entry;
+      memset(&entry, 0, sizeof(FrameEntry));
+      entry.vertex_index = static_cast<uint32_t>(vertex_idx);
+      entry.frame_index = static_cast<uint32_t>(frame_idx);
+      entry.num_keypoints = static_cast<uint32_t>(num_keypoints);
+      entry.descriptor_size_bytes = frame_proto.keypoint_descriptor_size();
+      CHECK_EQ(
+          frame_proto.keypoint_descriptors().size(),
+          entry.descriptor_size_bytes * num_keypoints);
+      entry.has_scales = frame_proto.descriptor_scales_size() > 0 ? 1u : 0u;
+      if (entry.has_scales != 0u) {
+        CHECK_EQ(
+            static_cast<uint64_t>(frame_proto.descriptor_scales_size()),
+            num_keypoints);
+      }
+      entry.has_track_ids = frame_proto.track_ids_size() > 0 ? 1u : 0u;
+      if (entry.has_track_ids != 0u) {
+        CHECK_EQ(
+            static_cast<uint64_t>(frame_proto.track_ids_size()),
+            num_keypoints);
+      }
+
+      entry.keypoint_offset = header.num_keypoints;
+      header.num_keypoints += num_keypoints;
+      entry.scale_offset = header.num_scales;
+      header.num_scales += entry.has_scales * num_keypoints;
+      entry.track_id_offset = header.num_track_ids;
+      header.num_track_ids += entry.has_track_ids * num_keypoints;
+      entry.descriptor_offset = header.num_descriptor_bytes;
+      header.num_descriptor_bytes += frame_proto.keypoint_descriptors().size();
+      entries.push_back(entry);
+    }
+  }
+  header.num_frames = entries.size();
+  computeLayout(&header);
+
+  std::ofstream file(file_path, std::ios::out | std::ios::binary);
+  if (!file.is_open()) {
+    LOG(ERROR) << "Could not open \"" << file_path << "\" for writing.";
+    return false;
+  }
+  file.write(reinterpret_cast<const char*>(&header), sizeof(SectionsHeader));
+
+  // Every section is written straight from the protos, frame by frame.
+  bool success = padToOffset(header.frames_offset, &file);
+  writeData(entries.data(), entries.size() * sizeof(FrameEntry), &file);
+  success &= padToOffset(header.keypoints_offset, &file);
+  for (const FrameEntry& entry : entries) {
+    writeData(
+        getFrameProto(*vertices_proto, entry).keypoint_measurements().data(),
+        2u * entry.num_keypoints * sizeof(double), &file);
+  }
+  success &= padToOffset(header.uncertainties_offset, &file);
+  for (const FrameEntry& entry : entries) {
+    writeData(
+        getFrameProto(*vertices_proto, entry)
+            .keypoint_measurement_sigmas()
+            .data(),
+        entry.num_keypoints * sizeof(double), &file);
+  }
+  success &= padToOffset(header.scales_offset, &file);
+  for (const FrameEntry& entry : entries) {
+    writeData(
+        getFrameProto(*vertices_proto, entry).descriptor_scales().data(),
+        entry.has_scales * entry.num_keypoints * sizeof(double), &file);
+  }
+  success &= padToOffset(header.track_ids_offset, &file);
+  for (const FrameEntry& entry : entries) {
+    writeData(
+        getFrameProto(*vertices_proto, entry).track_ids().data(),
+        entry.has_track_ids * entry.num_keypoints * sizeof(int32_t), &file);
+  }
+  success &= padToOffset(header.descriptors_offset, &file);
+  for (const FrameEntry& entry : entries) {
+    const std::string& descriptors =
+        getFrameProto(*vertices_proto, entry).keypoint_descriptors();
+    writeData(descriptors.data(), descriptors.size(), &file);
+  }
+  success &= padToOffset(header.file_size, &file);
+  if (!success) {
+    LOG(ERROR) << "Writing \"" << file_path << "\" failed.";
+    return false;
+  }
+
+  for (const FrameEntry& entry : entries) {
+    aslam::proto::VisualFrame* frame_proto =
+        vertices_proto->mutable_vertices(entry.vertex_index)
+            ->mutable_n_visual_frame()
+            ->mutable_frames(entry.frame_index);
+    frame_proto->clear_keypoint_measurements();
+    frame_proto->clear_keypoint_measurement_sigmas();
+    frame_proto->clear_descriptor_scales();
+    frame_proto->clear_track_ids();
+    frame_proto->clear_keypoint_descriptors();
+    frame_proto->clear_keypoint_descriptor_size();
+  }
+  return true;
+}
+
+bool loadFrameArraysFromSectionsFile(
+    const std::string& file_path, const std::vector<Vertex*>& vertices) {
+  common::MemoryMappedFile mapped_file;
+  if (!mapped_file.open(file_path)) {
+    return false;
+  }
+  SectionsHeader header;
+  if (mapped_file.size() < sizeof(SectionsHeader)) {
+    LOG(ERROR) << "\"" << file_path << "\" is too small for frame sections.";
+    return false;
+  }
+  memcpy(&header, mapped_file.data(), sizeof(SectionsHeader));
+  if (header.magic_number != kMagicNumber || header.version != kVersion) {
+    LOG(ERROR) << "\"" << file_path << "\" doesn't hold frame sections of "
+               << "version " << kVersion << ".";
+    return false;
+  }
+  SectionsHeader expected_layout = header;
+  computeLayout(&expected_layout);
+  if (memcmp(&header, &expected_layout, sizeof(SectionsHeader)) != 0 ||
+      mapped_file.size() < header.file_size) {
+    LOG(ERROR) << "The frame sections \"" << file_path
+               << "\" are corrupt or truncated.";
+    return false;
+  }
+  mapped_file.adviseSequentialRead();
+
+  const char* data = mapped_file.data();
+  for (uint64_t entry_idx = 0u; entry_idx < header.num_frames; ++entry_idx) {
+    FrameEntry entry;
+    memcpy(
+        &entry, data + header.frames_offset + entry_idx * sizeof(FrameEntry),
+        sizeof(FrameEntry));
+    const uint64_t num_keypoints = entry.num_keypoints;
+    if (entry.vertex_index >= vertices.size() ||
+        entry.keypoint_offset + num_keypoints > header.num_keypoints ||
+        entry.scale_offset + entry.has_scales * num_keypoints >
+            header.num_scales ||
+        entry.track_id_offset + entry.has_track_ids * num_keypoints >
+            header.num_track_ids ||
+        entry.descriptor_offset + entry.descriptor_size_bytes * num_keypoints >
+            header.num_descriptor_bytes) {
+      LOG(ERROR) << "Frame " << entry_idx << " of \"" << file_path
+                 << "\" is out of bounds.";
+      return false;
+    }
+    Vertex& vertex = *CHECK_NOTNULL(vertices[entry.vertex_index]);
+    if (entry.frame_index >= vertex.numFrames() ||
+        !vertex.isVisualFrameSet(entry.frame_index)) {
+      LOG(ERROR) << "Frame " << entry_idx << " of \"" << file_path
+                 << "\" doesn't match the frames of vertex " << vertex.id()
+                 << ".";
+      return false;
+    }
+    aslam::VisualFrame& frame = vertex.getVisualFrame(entry.frame_index);
+
+    frame.setKeypointMeasurements(
+        Eigen::Map<const Eigen::Matrix2Xd>(
+            reinterpret_cast<const double*>(
+                data + header.keypoints_offset) +
+                2u * entry.keypoint_offset,
+            2, num_keypoints));
+    frame.setKeypointMeasurementUncertainties(
+        Eigen::Map<const Eigen::VectorXd>(
+            reinterpret_cast<const double*>(
+                data + header.uncertainties_offset) +
+                entry.keypoint_offset,
+            num_keypoints));
+    if (entry.has_scales != 0u) {
+      frame.setKeypointScales(
+          Eigen::Map<const Eigen::VectorXd>(
+              reinterpret_cast<const double*>(data + header.scales_offset) +
+                  entry.scale_offset,
+              num_keypoints));
+    }
+    if (entry.has_track_ids != 0u) {
+      frame.setTrackIds(
+          Eigen::Map<const Eigen::VectorXi>(
+              reinterpret_cast<const int32_t*>(
+                  data + header.track_ids_offset) +
+                  entry.track_id_offset,
+              num_keypoints));
+    }
+    if (entry.descriptor_size_bytes > 0u) {
+      *frame.getDescriptorsMutable() =
+          Eigen::Map<const aslam::VisualFrame::DescriptorsT>(
+              reinterpret_cast<const unsigned char*>(
+                  data + header.descriptors_offset + entry.descriptor_offset),
+              entry.descriptor_size_bytes, num_keypoints);
+    }
+  }
+  return true;
+}
+
+}  // namespace serialization
+}  // namespace vi_map
@@ -0,0 +1,126 @@
+#include "vi-map/landmark-handles.h"
+
+#include <vector>
+
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
+
+#include "vi-map/vi-map.h"
+
+namespace vi_map {
+
+LandmarkHandleTable::LandmarkHandleTable(const VIMap& map) {
+  update(map);
+}
+
+void LandmarkHandleTable::update(const VIMap& map) {
+  LandmarkIdList landmark_ids;
+  map.getAllLandmarkIds(&landmark_ids);
+  landmark_id_to_handle_.reserve(landmark_ids_.size() + landmark_ids.size());
+  for (const LandmarkId& landmark_id : landmark_ids) {
+    if (landmark_id_to_handle_
+            .emplace(
+                landmark_id, static_cast<LandmarkHandle>(landmark_ids_.size()))
+            .second) {
+      landmark_ids_.push_back(landmark_id);
+    }
+  }
+  CHECK_LT(landmark_ids_.size(), kInvalidLandmarkHandle);
+
+  pose_graph::VertexIdList vertex_ids;
+  map.getAllVertexIds(&vertex_ids);
+  vertex_id_to_handle_.reserve(vertex_ids_.size() + vertex_ids.size());
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    if (vertex_id_to_handle_
+            .emplace(vertex_id, static_cast<VertexHandle>(vertex_ids_.size()))
+            .second) {
+      vertex_ids_.push_back(vertex_id);
+    }
+  }
+  CHECK_LT(vertex_ids_.size(), kInvalidVertexHandle);
+  // Observations are only kept for the vertices that are still in the map.
+  std::vector<char> is_vertex_in_map(vertex_ids_.size(), false);
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    is_vertex_in_map[getVertexHandle(vertex_id)] = true;
+  }
+
+  // Removed landmarks and vertices keep their handle but lose their data.
+  storing_vertices_.assign(landmark_ids_.size(), kInvalidVertexHandle);
+  landmark_backlinks_.clear();
+  landmark_backlinks_.resize(landmark_ids_.size());
+  vertex_observations_.clear();
+  vertex_observations_.resize(vertex_ids_.size());
+
+  // Every landmark is stored in exactly one vertex, so the vertices write
+  // disjoint elements of the landmark arrays.
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      vertex_ids.size(),
+      [&](const std::vector<size_t>& range) {
+        for (const size_t idx : range) {
+          const Vertex& vertex = map.getVertex(vertex_ids[idx]);
+          const VertexHandle vertex_handle = getVertexHandle(vertex.id());
+
+          std::vector<std::vector<LandmarkHandle>>& frame_observations =
+              vertex_observations_[vertex_handle];
+          frame_observations.resize(vertex.numFrames());
+          for (size_t frame_idx = 0u; frame_idx < vertex.numFrames();
+               ++frame_idx) {
+            if (!vertex.isVisualFrameSet(frame_idx)) {
+              continue;
+            }
+            const LandmarkIdList& observed_landmark_ids =
+                vertex.getFrameObservedLandmarkIds(frame_idx);
+            std::vector<LandmarkHandle>& observations =
+                frame_observations[frame_idx];
+            observations.reserve(observed_landmark_ids.size());
+            for (const LandmarkId& landmark_id : observed_landmark_ids) {
+              observations.push_back(
+                  landmark_id.isValid() ? getLandmarkHandle(landmark_id)
+                                        : kInvalidLandmarkHandle);
+            }
+          }
+
+          for (const Landmark& landmark : vertex.getLandmarks()) {
+            const LandmarkHandle landmark_handle =
+                getLandmarkHandle(landmark.id());
+            CHECK_NE(landmark_handle, kInvalidLandmarkHandle)
+                << "Landmark " << landmark.id() << " of vertex "
+                << vertex.id() << " is not in the landmark index.";
+            storing_vertices_[landmark_handle] = vertex_handle;
+            std::vector<FrameHandle>& backlinks =
+                landmark_backlinks_[landmark_handle];
+            backlinks.reserve(landmark.numberOfObservations());
+            landmark.forEachObservation(
+                [&](const KeypointIdentifier& keypoint_id) {
+                  const VertexHandle observer =
+                      getVertexHandle(keypoint_id.frame_id.vertex_id);
+                  if (observer != kInvalidVertexHandle &&
+                      is_vertex_in_map[observer]) {
+                    backlinks.push_back(
+                        {observer, static_cast<uint32_t>(
+                                       keypoint_id.frame_id.frame_index)});
+                  }
+                });
+          }
+        }
+      },
+      kAlwaysParallelize, common::getNumHardwareThreads());
+}
+
+LandmarkHandle LandmarkHandleTable::getLandmarkHandle(
+    const LandmarkId& landmark_id) const {
+  const common::FlatHashMap<LandmarkId, LandmarkHandle>::const_iterator it =
+      landmark_id_to_handle_.find(landmark_id);
+  return it == landmark_id_to_handle_.end() ? kInvalidLandmarkHandle
+                                            : it->second;
+}
+
+VertexHandle LandmarkHandleTable::getVertexHandle(
+    const pose_graph::VertexId& vertex_id) const {
+  const common::FlatHashMap<pose_graph::VertexId, VertexHandle>::const_iterator
+      it = vertex_id_to_handle_.find(vertex_id);
+  return it == vertex_id_to_handle_.end() ? kInvalidVertexHandle : it->second;
+}
+
+}  // namespace vi_map
@@ -1,5 +1,7 @@
 #include <vi-map/landmark-store.h>
 
+#include <utility>
+
 #include <glog/logging.h>
 
 namespace vi_map {
@@ -66,6 +68,24 @@ void LandmarkStore::removeLandmark(const LandmarkId& landmark_id) {
   CHECK_EQ(landmarks_.size(), landmark_id_map_.size());
 }
 
+void LandmarkStore::removeLandmarks(const LandmarkIdSet& landmark_ids) {
+  size_t num_kept = 0u;
+  for (size_t idx = 0u; idx < landmarks_.size(); ++idx) {
+    const LandmarkId& landmark_id = landmarks_[idx].id();
+    if (landmark_ids.count(landmark_id) > 0u) {
+      CHECK_EQ(landmark_id_map_.erase(landmark_id), 1u);
+      continue;
+    }
+    if (num_kept != idx) {
+      landmarks_[num_kept] = std::move(landmarks_[idx]);
+      landmark_id_map_[landmark_id] = num_kept;
+    }
+    ++num_kept;
+  }
+  landmarks_.resize(num_kept);
+  CHECK_EQ(landmarks_.size(), landmark_id_map_.size());
+}
+
 void LandmarkStore::serialize(vi_map::proto::LandmarkStore* proto) const {
   CHECK_NOTNULL(proto);
 
@@ -81,12 +101,23 @@ void LandmarkStore::serialize(vi_map::proto::LandmarkStore* proto) const {
 
 void LandmarkStore::deserialize(const vi_map::proto::LandmarkStore& proto) {
   landmarks_.resize(proto.landmarks_size());
+  landmark_id_map_.reserve(proto.landmarks_size());
   for (int i = 0; i < proto.landmarks_size(); ++i) {
-    Landmark landmark;
-    landmark.deserialize(proto.landmarks(i));
+    landmarks_[i].deserialize(proto.landmarks(i));
+    landmark_id_map_.emplace(landmarks_[i].id(), i);
+  }
+}
 
-    landmarks_[i] = landmark;
-    landmark_id_map_.emplace(landmark.id(), i);
+void LandmarkStore::accumulateMemoryUsage(common::MemoryUsage* usage) const {
+  CHECK_NOTNULL(usage);
+  usage->add(
+      common::MemoryUsage::Category::kLandmarks,
+      common::getHeapBytes(landmarks_));
+  usage->add(
+      common::MemoryUsage::Category::kIndexStructures,
+      common::getHeapBytes(landmark_id_map_));
+  for (const Landmark& landmark : landmarks_) {
+    landmark.accumulateMemoryUsage(usage);
   }
 }
 
@@ -9,17 +9,31 @@ namespace vi_map {
 
 constexpr int Landmark::kInvalidAppearance;
 
+const Landmark::ColdData& Landmark::getColdData() const {
+  static const ColdData kEmptyColdData;
+  return cold_data_ != nullptr ? *cold_data_ : kEmptyColdData;
+}
+
+Landmark::ColdData& Landmark::getColdDataMutable() {
+  if (cold_data_ == nullptr) {
+    cold_data_.reset(new ColdData);
+  }
+  return *cold_data_;
+}
+
 double* Landmark::get_p_B_Mutable() {
   return B_position_.data();
 }
 
 double* Landmark::get_p_B_CovarianceMutable() {
   // Allocate memory for the covariance if it wasn't yet set.
-  if (B_covariance_ == nullptr) {
-    B_covariance_ = aligned_unique<Eigen::Matrix3d>();
-    B_covariance_->setIdentity();
+  AlignedUniquePtr<Eigen::Matrix3d>& B_covariance =
+      getColdDataMutable().B_covariance;
+  if (B_covariance == nullptr) {
+    B_covariance = aligned_unique<Eigen::Matrix3d>();
+    B_covariance->setIdentity();
   }
-  return B_covariance_->data();
+  return B_covariance->data();
 }
 
 void Landmark::addObservation(
@@ -29,36 +43,33 @@ void Landmark::addObservation(
   backlink.frame_id.vertex_id = vertex_id;
   backlink.frame_id.frame_index = frame_idx;
   backlink.keypoint_index = keypoint_index;
-  observations_.push_back(backlink);
-
-  if (!appearances_.empty()) {
-    appearances_.emplace_back(-1);
-  }
+  addObservation(backlink);
 }
 
 void Landmark::addObservation(const KeypointIdentifier& keypoint_id) {
-  observations_.push_back(keypoint_id);
+  ColdData& cold_data = getColdDataMutable();
+  cold_data.observations.push_back(keypoint_id);
 
-  if (!appearances_.empty()) {
-    appearances_.emplace_back(-1);
+  if (!cold_data.appearances.empty()) {
+    cold_data.appearances.emplace_back(-1);
   }
 }
 
 void Landmark::addObservations(const KeypointIdentifierList& new_observations) {
-  observations_.insert(
-      observations_.end(), new_observations.begin(), new_observations.end());
-  if (!appearances_.empty()) {
-    std::vector<int> invalid_appearances(new_observations.size(), -1);
-    appearances_.insert(
-        appearances_.end(), invalid_appearances.begin(),
-        invalid_appearances.end());
+  ColdData& cold_data = getColdDataMutable();
+  cold_data.observations.insert(
+      cold_data.observations.end(), new_observations.begin(),
+      new_observations.end());
+  if (!cold_data.appearances.empty()) {
+    cold_data.appearances.resize(
+        cold_data.observations.size(), kInvalidAppearance);
   }
 }
 
 bool Landmark::hasObservation(
     const pose_graph::VertexId& vertex_id, size_t frame_idx,
     size_t keypoint_index) const {
-  for (const KeypointIdentifier& backlink : observations_) {
+  for (const KeypointIdentifier& backlink : getColdData().observations) {
     if (backlink.frame_id.vertex_id == vertex_id &&
         backlink.frame_id.frame_index == frame_idx &&
         backlink.keypoint_index == keypoint_index) {
@@ -71,19 +82,24 @@ bool Landmark::hasObservation(
 void Landmark::removeAllObservationsAccordingToPredicate(
     const std::function<bool(const KeypointIdentifier&)>& // NOLINT
         predicate) {
-  std::vector<int>::iterator appearance_iterator = appearances_.begin();
-  KeypointIdentifierList::iterator observation_iterator = observations_.begin();
-  while (observation_iterator != observations_.end()) {
+  if (cold_data_ == nullptr) {
+    return;
+  }
+  KeypointIdentifierList& observations = cold_data_->observations;
+  std::vector<int>& appearances = cold_data_->appearances;
+  std::vector<int>::iterator appearance_iterator = appearances.begin();
+  KeypointIdentifierList::iterator observation_iterator = observations.begin();
+  while (observation_iterator != observations.end()) {
     if (predicate(*observation_iterator)) {
-      observation_iterator = observations_.erase(observation_iterator);
+      observation_iterator = observations.erase(observation_iterator);
 
-      if (appearance_iterator != appearances_.end()) {
-        appearance_iterator = appearances_.erase(appearance_iterator);
+      if (appearance_iterator != appearances.end()) {
+        appearance_iterator = appearances.erase(appearance_iterator);
       }
     } else {
       ++observation_iterator;
 
-      if (appearance_iterator != appearances_.end()) {
+      if (appearance_iterator != appearances.end()) {
         ++appearance_iterator;
       }
     }
@@ -98,6 +114,22 @@ void Landmark::removeObservation(const KeypointIdentifier& observation) {
   removeAllObservationsAccordingToPredicate(predicate);
 }
 
+void Landmark::removeObservation(size_t index) {
+  CHECK_LT(index, numberOfObservations());
+  KeypointIdentifierList& observations = cold_data_->observations;
+  std::vector<int>& appearances = cold_data_->appearances;
+  if (!appearances.empty()) {
+    CHECK_EQ(appearances.size(), observations.size())
+        << "The appearances "
+        << "of landmark with store id " << id_.hexString() << " are not in "
+        << "sync with the observations as their respective number of "
+           "elements "
+        << "differs.";
+    appearances.erase(appearances.begin() + index);
+  }
+  observations.erase(observations.begin() + index);
+}
+
 void Landmark::removeAllObservationsOfVertex(
     const pose_graph::VertexId& vertex_id) {
   std::function<bool(const KeypointIdentifier& observation)> // NOLINT
@@ -121,32 +153,33 @@ void Landmark::removeAllObservationsOfVertexAndFrame(
 
 unsigned int Landmark::numberOfObserverVertices() const {
   pose_graph::VertexIdSet vertices;
-  for (const KeypointIdentifier& backlink : observations_) {
+  for (const KeypointIdentifier& backlink : getColdData().observations) {
     vertices.insert(backlink.frame_id.vertex_id);
   }
   return vertices.size();
 }
 
 bool Landmark::hasObservation(const KeypointIdentifier& keypoint_id) const {
-  return std::find(observations_.begin(), observations_.end(), keypoint_id) !=
-         observations_.end();
+  const KeypointIdentifierList& observations = getColdData().observations;
+  return std::find(observations.begin(), observations.end(), keypoint_id) !=
+         observations.end();
 }
 
 const KeypointIdentifierList& Landmark::getObservations() const {
-  return observations_;
+  return getColdData().observations;
 }
 
 unsigned int Landmark::numberOfObservations() const {
-  return observations_.size();
+  return getColdData().observations.size();
 }
 
 bool Landmark::hasObservations() const {
-  return !observations_.empty();
+  return !getColdData().observations.empty();
 }
 
 void Landmark::forEachObservation(
     const std::function<void(const KeypointIdentifier&)>& action) const {
-  for (const KeypointIdentifier& observation : observations_) {
+  for (const KeypointIdentifier& observation : getColdData().observations) {
     action(observation);
   }
 }
@@ -154,61 +187,68 @@ void Landmark::forEachObservation(
 void Landmark::forEachObservation(
     const std::function<void(const KeypointIdentifier&, const size_t)>& action)
     const {
-  for (size_t i = 0u; i < observations_.size(); ++i) {
-    action(observations_[i], i);
+  const KeypointIdentifierList& observations = getColdData().observations;
+  for (size_t i = 0u; i < observations.size(); ++i) {
+    action(observations[i], i);
   }
 }
 
 int Landmark::getAppearanceForObservationIndex(size_t observation_index) const {
-  CHECK(!appearances_.empty())
+  const ColdData& cold_data = getColdData();
+  CHECK(!cold_data.appearances.empty())
       << "No appearances have been allocated. You "
       << "first need to allocate appearances explicitly by calling "
       << "allocateAppearances() and setAppearance(...).";
-  CHECK_LT(observation_index, appearances_.size());
-  CHECK_EQ(appearances_.size(), observations_.size())
+  CHECK_LT(observation_index, cold_data.appearances.size());
+  CHECK_EQ(cold_data.appearances.size(), cold_data.observations.size())
       << "The appearances of "
       << "landmark with store id " << id_.hexString() << " are not in sync with"
       << " the observations as their respective number of elements differs.";
 
-  return appearances_[observation_index];
+  return cold_data.appearances[observation_index];
 }
 
 void Landmark::setAppearance(size_t observation_index, int appearance) {
-  CHECK(!appearances_.empty())
+  ColdData& cold_data = getColdDataMutable();
+  CHECK(!cold_data.appearances.empty())
       << "No appearances have been allocated. You "
       << "first need to allocate appearances explicitly by calling "
       << "allocateAppearances() and setAppearance(...).";
-  CHECK_LT(observation_index, observations_.size())
+  CHECK_LT(observation_index, cold_data.observations.size())
       << "No observation with "
       << "index " << observation_index << " exists for landmark with store id "
       << id_.hexString();
-  CHECK_EQ(appearances_.size(), observations_.size())
+  CHECK_EQ(cold_data.appearances.size(), cold_data.observations.size())
       << "The appearances of "
       << "landmark with store id " << id_.hexString() << " are in sync with the"
       << " observations as their respective number of elements differs.";
 
-  appearances_[observation_index] = appearance;
+  cold_data.appearances[observation_index] = appearance;
 }
 
 void Landmark::allocateAppearances() {
-  CHECK(appearances_.empty()) << "Appearances have already been allocated.";
-  appearances_.resize(observations_.size(), kInvalidAppearance);
+  ColdData& cold_data = getColdDataMutable();
+  CHECK(cold_data.appearances.empty())
+      << "Appearances have already been allocated.";
+  cold_data.appearances.resize(
+      cold_data.observations.size(), kInvalidAppearance);
 }
 
 void Landmark::getAllDistinctAppearances(
     std::unordered_set<int>* distinct_appearances) const {
   CHECK_NOTNULL(distinct_appearances)->clear();
-  CHECK(!appearances_.empty())
+  const ColdData& cold_data = getColdData();
+  CHECK(!cold_data.appearances.empty())
       << "No appearances have been allocated. You "
       << "first need to allocate appearances explicitly by calling "
       << "allocateAppearances() and setAppearance(...).";
-  CHECK_EQ(appearances_.size(), observations_.size())
+  CHECK_EQ(cold_data.appearances.size(), cold_data.observations.size())
       << "The appearances of "
       << "landmark with store id " << id_.hexString() << " are not in sync with"
       << " the observations as their respective number of elements differs.";
 
-  distinct_appearances->reserve(appearances_.size());
-  for (int appearance : appearances_) {
+  distinct_appearances->reserve(cold_data.appearances.size());
+  for (int appearance : cold_data.appearances) {
     if (appearance >= 0) {
       distinct_appearances->insert(appearance);
     }
@@ -218,36 +258,54 @@ void Landmark::getAllDistinctAppearances(
 void Landmark::getAllObservationsOfAppearance(
     int appearance, KeypointIdentifierList* observations) const {
   CHECK_NOTNULL(observations)->clear();
-  CHECK(!appearances_.empty())
+  const ColdData& cold_data = getColdData();
+  CHECK(!cold_data.appearances.empty())
       << "No appearances have been allocated. You "
       << "first need to allocate appearances explicitly by calling "
       << "allocateAppearances() and setAppearance(...).";
   CHECK_GE(appearance, 0);
-  CHECK_EQ(appearances_.size(), observations_.size())
+  CHECK_EQ(cold_data.appearances.size(), cold_data.observations.size())
       << "The appearances of "
       << "landmark with store id " << id_.hexString() << " are not in sync with"
       << " the observations as their respective number of elements differs.";
 
-  const size_t num_observations = observations_.size();
-  CHECK_EQ(num_observations, appearances_.size());
+  const size_t num_observations = cold_data.observations.size();
+  CHECK_EQ(num_observations, cold_data.appearances.size());
   observations->reserve(num_observations);
 
   for (size_t observation_idx = 0u; observation_idx < num_observations;
        ++observation_idx) {
-    if (appearances_[observation_idx] == appearance) {
-      observations->push_back(observations_[observation_idx]);
+    if (cold_data.appearances[observation_idx] == appearance) {
+      observations->push_back(cold_data.observations[observation_idx]);
     }
   }
 }
 
+void Landmark::accumulateMemoryUsage(common::MemoryUsage* usage) const {
+  CHECK_NOTNULL(usage);
+  if (cold_data_ == nullptr) {
+    return;
+  }
+  const ColdData& cold_data = *cold_data_;
+  usage->add(
+      common::MemoryUsage::Category::kLandmarkObservations,
+      sizeof(ColdData) + common::getHeapBytes(cold_data.observations) +
+          common::getHeapBytes(cold_data.appearances));
+  if (cold_data.B_covariance != nullptr) {
+    usage->add(
+        common::MemoryUsage::Category::kLandmarks, sizeof(Eigen::Matrix3d));
+  }
+}
+
 void Landmark::serialize(vi_map::proto::Landmark* proto) const {
   CHECK_NOTNULL(proto);
+  const ColdData& cold_data = getColdData();
 
   proto->Clear();
   id_.serialize(proto->mutable_id());
 
   {
-    const size_t num_observations = observations_.size();
+    const size_t num_observations = cold_data.observations.size();
     google::protobuf::RepeatedPtrField<common::proto::Id>* vertex_ids_proto =
         proto->mutable_vertex_ids();
     google::protobuf::RepeatedField<google::protobuf::uint32>*
@@ -258,7 +316,7 @@ void Landmark::serialize(vi_map::proto::Landmark* proto) const {
     frame_indices_proto->Reserve(num_observations);
     keypoint_indices_proto->Reserve(num_observations);
     for (unsigned int i = 0u; i < num_observations; ++i) {
-      const KeypointIdentifier& observation = observations_[i];
+      const KeypointIdentifier& observation = cold_data.observations[i];
       observation.frame_id.vertex_id.serialize(vertex_ids_proto->Add());
       frame_indices_proto->Add(observation.frame_id.frame_index);
       keypoint_indices_proto->Add(observation.keypoint_index);
@@ -266,20 +324,21 @@ void Landmark::serialize(vi_map::proto::Landmark* proto) const {
   }
 
   {
-    const size_t num_appearances = appearances_.size();
+    const size_t num_appearances = cold_data.appearances.size();
     google::protobuf::RepeatedField<google::protobuf::int32>*
         appearances_proto = proto->mutable_appearances();
     appearances_proto->Reserve(num_appearances);
     for (unsigned int appearance_index = 0u; appearance_index < num_appearances;
          ++appearance_index) {
-      appearances_proto->Add(appearances_[appearance_index]);
+      appearances_proto->Add(cold_data.appearances[appearance_index]);
     }
   }
 
   common::eigen_proto::serialize(B_position_, proto->mutable_position());
   // Serialize the covariance if it is set.
-  if (B_covariance_ != nullptr) {
-    common::eigen_proto::serialize(*B_covariance_, proto->mutable_covariance());
+  if (cold_data.B_covariance != nullptr) {
+    common::eigen_proto::serialize(
+        *cold_data.B_covariance, proto->mutable_covariance());
   }
 
   switch (quality_) {
@@ -303,24 +362,27 @@ void Landmark::serialize(vi_map::proto::Landmark* proto) const {
 }
 
 void Landmark::clearObservations() {
-  observations_.clear();
-  appearances_.clear();
+  ColdData& cold_data = getColdDataMutable();
+  cold_data.observations.clear();
+  cold_data.appearances.clear();
 }
 
 const std::vector<int>& Landmark::getAppearances() const {
-  CHECK(!appearances_.empty())
+  const ColdData& cold_data = getColdData();
+  CHECK(!cold_data.appearances.empty())
       << "No appearances have been allocated. You "
       << "first need to allocate appearances explicitly by calling "
       << "allocateAppearances() and setAppearance(...).";
-  return appearances_;
+  return cold_data.appearances;
 }
 
 void Landmark::deserialize(const vi_map::proto::Landmark& proto) {
+  ColdData& cold_data = getColdDataMutable();
   id_.deserialize(proto.id());
 
   CHECK_EQ(proto.vertex_ids_size(), proto.keypoint_indices_size());
 
-  observations_.resize(proto.keypoint_indices_size());
+  cold_data.observations.resize(proto.keypoint_indices_size());
   for (int i = 0; i < proto.keypoint_indices_size(); ++i) {
     KeypointIdentifier backlink;
     backlink.frame_id.vertex_id.deserialize(proto.vertex_ids(i));
@@ -330,12 +392,12 @@ void Landmark::deserialize(const vi_map::proto::Landmark& proto) {
         << "Couldn't deserialize the frame indices for the keypoints. Possibly "
         << "your map format is outdated.";
     backlink.frame_id.frame_index = proto.frame_indices(i);
-    observations_[i] = backlink;
+    cold_data.observations[i] = backlink;
   }
 
-  appearances_.resize(proto.appearances_size());
+  cold_data.appearances.resize(proto.appearances_size());
   for (int i = 0; i < proto.appearances_size(); ++i) {
-    appearances_[i] = proto.appearances(i);
+    cold_data.appearances[i] = proto.appearances(i);
   }
 
   if (proto.has_quality()) {
@@ -367,11 +429,11 @@ void Landmark::deserialize(const vi_map::proto::Landmark& proto) {
   // Deserialize the covariance if it is set.
   if (proto.covariance_size() > 0) {
     // Allocate the covariance memory if needed.
-    if (B_covariance_ == nullptr) {
-      B_covariance_ = aligned_unique<Eigen::Matrix3d>();
+    if (cold_data.B_covariance == nullptr) {
+      cold_data.B_covariance = aligned_unique<Eigen::Matrix3d>();
     }
     common::eigen_proto::deserialize(
-        proto.covariance(), CHECK_NOTNULL(B_covariance_.get()));
+        proto.covariance(), CHECK_NOTNULL(cold_data.B_covariance.get()));
   }
 }
 }  // namespace vi_map
@@ -0,0 +1,51 @@
+#include "vi-map/map-change-tracker.h"
+
+namespace vi_map {
+
+MapChangeTracker::MapChangeTracker() : num_proto_files_(0u) {}
+
+void MapChangeTracker::startTracking(
+    const std::string& proto_folder, size_t num_proto_files) {
+  CHECK(!proto_folder.empty());
+  CHECK_GE(num_proto_files, serialization::internal::kMinNumProtos);
+  proto_folder_ = proto_folder;
+  num_proto_files_ = num_proto_files;
+  changed_proto_files_.reset(new std::atomic<bool>[num_proto_files]);
+  for (size_t i = 0u; i < num_proto_files; ++i) {
+    changed_proto_files_[i].store(false, std::memory_order_relaxed);
+  }
+}
+
+void MapChangeTracker::stopTracking() {
+  proto_folder_.clear();
+  num_proto_files_ = 0u;
+  changed_proto_files_.reset();
+}
+
+bool MapChangeTracker::isTrackingFolder(
+    const std::string& proto_folder) const {
+  return isTracking() && proto_folder_ == proto_folder;
+}
+
+size_t MapChangeTracker::getNumVertexProtoFiles() const {
+  CHECK(isTracking());
+  return num_proto_files_ - serialization::internal::kMinNumProtos;
+}
+
+bool MapChangeTracker::isProtoFileChanged(size_t proto_file_index) const {
+  CHECK_LT(proto_file_index, num_proto_files_);
+  return changed_proto_files_[proto_file_index].load(
+      std::memory_order_relaxed);
+}
+
+size_t MapChangeTracker::getNumChangedProtoFiles() const {
+  size_t num_changed_files = 0u;
+  for (size_t i = 0u; i < num_proto_files_; ++i) {
+    if (isProtoFileChanged(i)) {
+      ++num_changed_files;
+    }
+  }
+  return num_changed_files;
+}
+
+}  // namespace vi_map
@@ -1,5 +1,8 @@
 #include "vi-map/optional-sensor-data.h"
 
+#include <utility>
+#include <vector>
+
 #include <glog/logging.h>
 #include <maplab-common/accessors.h>
 
@@ -11,6 +14,12 @@ OptionalSensorData::OptionalSensorData(const OptionalSensorData& other)
     sensor_id_to_gps_wgs_measurements_(
         other.sensor_id_to_gps_wgs_measurements_) {}
 
+OptionalSensorData::OptionalSensorData(OptionalSensorData&& other)
+  : sensor_id_to_gps_utm_measurements_(
+      std::move(other.sensor_id_to_gps_utm_measurements_)),
+    sensor_id_to_gps_wgs_measurements_(
+        std::move(other.sensor_id_to_gps_wgs_measurements_)) {}
+
 OptionalSensorData::OptionalSensorData(
     const proto::OptionalSensorData& proto_optional_sensor_data) {
   deserialize(proto_optional_sensor_data);
@@ -119,6 +128,47 @@ void OptionalSensorData::addMeasurement<GpsWgsMeasurement>(
   }
 }
 
+template <class MeasurementType>
+void OptionalSensorData::addMeasurementsImpl(
+    const Aligned<std::vector, MeasurementType>& measurements,
+    SensorIdToMeasurementsMap<MeasurementType>* sensor_id_to_measurements) {
+  CHECK_NOTNULL(sensor_id_to_measurements);
+  if (measurements.empty()) {
+    return;
+  }
+  const vi_map::SensorId& sensor_id = measurements.front().getSensorId();
+  CHECK(sensor_id.isValid());
+
+  typedef std::pair<const int64_t, MeasurementType> TimestampedMeasurement;
+  std::vector<
+      TimestampedMeasurement, Eigen::aligned_allocator<TimestampedMeasurement>>
+      timestamped_measurements;
+  timestamped_measurements.reserve(measurements.size());
+  for (const MeasurementType& measurement : measurements) {
+    CHECK_GT(measurement.getTimestampNanoseconds(), 0);
+    CHECK_EQ(measurement.getSensorId(), sensor_id)
+        << "All measurements have to be of the same sensor.";
+    timestamped_measurements.emplace_back(
+        measurement.getTimestampNanoseconds(), measurement);
+  }
+
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  (*sensor_id_to_measurements)[sensor_id].addValues(
+      timestamped_measurements.begin(), timestamped_measurements.end());
+}
+
+template <>
+void OptionalSensorData::addMeasurements<GpsUtmMeasurement>(
+    const Aligned<std::vector, GpsUtmMeasurement>& measurements) {
+  addMeasurementsImpl(measurements, &sensor_id_to_gps_utm_measurements_);
+}
+
+template <>
+void OptionalSensorData::addMeasurements<GpsWgsMeasurement>(
+    const Aligned<std::vector, GpsWgsMeasurement>& measurements) {
+  addMeasurementsImpl(measurements, &sensor_id_to_gps_wgs_measurements_);
+}
+
 void OptionalSensorData::getAllSensorIds(SensorIdSet* sensor_ids) const {
   CHECK_NOTNULL(sensor_ids)->clear();
   for (const SensorIdToMeasurementsMap<GpsUtmMeasurement>::value_type&
@@ -0,0 +1,519 @@
+#include "vi-map/test/large-scale-map-generator.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <utility>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/cameras/distortion-null.h>
+#include <aslam/common/memory.h>
+#include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
+
+namespace vi_map {
+
+namespace {
+constexpr size_t kInvalidIndex = std::numeric_limits<size_t>::max();
+
+constexpr uint32_t kCameraWidth = 640u;
+constexpr uint32_t kCameraHeight = 480u;
+constexpr double kFocalLength = 320.0;
+constexpr size_t kDescriptorSizeBytes = 48u;
+constexpr double kKeypointUncertainty = 0.8;
+
+// Distance of the lines driven by the missions without loops.
+constexpr double kMissionLineDistanceM = 100.0;
+// The missions driving in loops are shifted sideways by up to 3 times this
+// distance, such that the revisits do not have exactly the same pose.
+constexpr double kMissionLateralOffsetM = 0.25;
+constexpr double kMinLandmarkDepthM = 5.0;
+constexpr double kMaxLandmarkDepthM = 15.0;
+constexpr double kMaxLandmarkOffsetM = 2.0;
+
+constexpr int64_t kVertexTimeDeltaNs = 100000000;
+constexpr int64_t kMissionTimeOffsetNs = 1000000000000;
+constexpr double kOdometryCovariance = 1e-4;
+
+// Every kind of id is generated from its own index space.
+enum class IdTag : uint64_t {
+  kMission = 1u,
+  kVertex = 2u,
+  kFrame = 3u,
+  kEdge = 4u,
+  kLandmark = 5u,
+  kLandmarkPosition = 6u,
+  kLandmarkReuse = 7u,
+  kDescriptor = 8u
+};
+constexpr size_t kNumIndexBits = 56u;
+
+// A bijection on 64 bit integers with a good avalanche effect, see
+// http://xorshift.di.unimi.it/splitmix64.c
+inline uint64_t mixBits(uint64_t value) {
+  value += 0x9e3779b97f4a7c15u;
+  value = (value ^ (value >> 30u)) * 0xbf58476d1ce4e5b9u;
+  value = (value ^ (value >> 27u)) * 0x94d049bb133111ebu;
+  return value ^ (value >> 31u);
+}
+
+inline uint64_t hashIndex(
+    const IdTag tag, const uint64_t index, const uint64_t seed) {
+  CHECK_LT(index, uint64_t{1u} << kNumIndexBits);
+  return mixBits(
+      mixBits(seed) ^ ((static_cast<uint64_t>(tag) << kNumIndexBits) | index));
+}
+
+// Returns a number in [0, 1).
+inline double hashToUniform(const uint64_t hash) {
+  return static_cast<double>(hash >> 11u) / static_cast<double>(1ull << 53u);
+}
+
+// The first half of the id is unique for every tag and index, as mixBits is a
+// bijection. The second half differs between the seeds.
+template <typename IdType>
+void generateDeterministicId(
+    const IdTag tag, const uint64_t index, const uint64_t seed, IdType* id) {
+  CHECK_NOTNULL(id);
+  CHECK_LT(index, uint64_t{1u} << kNumIndexBits);
+  const uint64_t first_half =
+      mixBits((static_cast<uint64_t>(tag) << kNumIndexBits) | index);
+  const uint64_t second_half = mixBits(seed);
+  char hex_string[33];
+  std::snprintf(
+      hex_string, sizeof(hex_string), "%016" PRIx64 "%016" PRIx64, first_half,
+      second_half);
+  CHECK(id->fromHexString(hex_string));
+}
+}  // namespace
+
+LargeScaleMapGenerator::LargeScaleMapGenerator(
+    const LargeScaleMapGeneratorOptions& options)
+    : options_(options) {
+  CHECK_GT(options_.num_missions, 0u);
+  CHECK_GT(options_.num_vertices_per_mission, 0u);
+  CHECK_GT(options_.vertex_spacing_m, 0.0);
+  CHECK_GT(options_.num_landmarks_per_vertex, 0u);
+  CHECK_GT(options_.track_length, 0u);
+  CHECK_GE(options_.revisit_landmark_reuse_ratio, 0.0);
+  CHECK_LE(options_.revisit_landmark_reuse_ratio, 1.0);
+  // A vertex must not observe two visits of the same place in its track.
+  CHECK(
+      options_.num_vertices_per_loop == 0u ||
+      options_.num_vertices_per_loop >= options_.track_length)
+      << "The loop needs at least track_length vertices.";
+
+  Eigen::VectorXd intrinsics(4);
+  intrinsics << kFocalLength, kFocalLength, kCameraWidth / 2.0,
+      kCameraHeight / 2.0;
+  aslam::Camera::Ptr camera(new aslam::PinholeCamera(
+      intrinsics, kCameraWidth, kCameraHeight,
+      aslam::Distortion::UniquePtr(new aslam::NullDistortion)));
+  aslam::CameraId camera_id;
+  common::generateId(&camera_id);
+  camera->setId(camera_id);
+  aslam::NCameraId n_camera_id;
+  common::generateId(&n_camera_id);
+  n_camera_.reset(new aslam::NCamera(
+      n_camera_id, {aslam::Transformation()}, {camera},
+      "Large scale map generator camera"));
+
+  const size_t num_places = options_.num_vertices_per_loop;
+  first_visit_of_place_.resize(num_places, kInvalidIndex);
+  for (size_t place = 0u; place < num_places; ++place) {
+    for (size_t mission_idx = 0u; mission_idx < options_.num_missions;
+         ++mission_idx) {
+      const size_t first_vertex_idx =
+          (place + num_places - getFirstPlaceOfMission(mission_idx)) %
+          num_places;
+      if (first_vertex_idx < options_.num_vertices_per_mission) {
+        first_visit_of_place_[place] =
+            getGlobalVertexIndex(mission_idx, first_vertex_idx);
+        break;
+      }
+    }
+  }
+}
+
+void LargeScaleMapGenerator::setCameraRig(
+    const aslam::NCamera::Ptr& n_camera) {
+  CHECK(n_camera);
+  CHECK_GT(n_camera->numCameras(), 0u);
+  n_camera_ = n_camera;
+}
+
+size_t LargeScaleMapGenerator::getGlobalVertexIndex(
+    const size_t mission_idx, const size_t vertex_idx) const {
+  return mission_idx * options_.num_vertices_per_mission + vertex_idx;
+}
+
+size_t LargeScaleMapGenerator::getFirstPlaceOfMission(
+    const size_t mission_idx) const {
+  return mission_idx * options_.num_vertices_per_loop / options_.num_missions;
+}
+
+size_t LargeScaleMapGenerator::getPlaceOfVertex(
+    const size_t mission_idx, const size_t vertex_idx) const {
+  if (options_.num_vertices_per_loop == 0u) {
+    return getGlobalVertexIndex(mission_idx, vertex_idx);
+  }
+  return (getFirstPlaceOfMission(mission_idx) + vertex_idx) %
+         options_.num_vertices_per_loop;
+}
+
+pose::Transformation LargeScaleMapGenerator::getPlacePose(
+    const size_t place) const {
+  // The camera looks sideways, along the normal of the trajectory.
+  Eigen::Vector3d p_G_I;
+  Eigen::Vector3d normal;
+  if (options_.num_vertices_per_loop == 0u) {
+    const size_t mission_idx = place / options_.num_vertices_per_mission;
+    const size_t vertex_idx = place % options_.num_vertices_per_mission;
+    p_G_I << vertex_idx * options_.vertex_spacing_m,
+        mission_idx * kMissionLineDistanceM, 0.0;
+    normal = Eigen::Vector3d::UnitY();
+  } else {
+    const double angle =
+        2.0 * M_PI * place / options_.num_vertices_per_loop;
+    const double radius = options_.num_vertices_per_loop *
+                          options_.vertex_spacing_m / (2.0 * M_PI);
+    normal << std::cos(angle), std::sin(angle), 0.0;
+    p_G_I = radius * normal;
+  }
+  Eigen::Matrix3d R_G_I;
+  R_G_I.col(2) = normal;
+  R_G_I.col(1) = -Eigen::Vector3d::UnitZ();
+  R_G_I.col(0) = R_G_I.col(1).cross(R_G_I.col(2));
+  return pose::Transformation(pose::Quaternion(R_G_I), p_G_I);
+}
+
+pose::Transformation LargeScaleMapGenerator::getVertexPose(
+    const size_t mission_idx, const size_t vertex_idx) const {
+  pose::Transformation T_G_I =
+      getPlacePose(getPlaceOfVertex(mission_idx, vertex_idx));
+  if (options_.num_vertices_per_loop > 0u) {
+    const Eigen::Vector3d normal = T_G_I.getRotationMatrix().col(2);
+    T_G_I.getPosition() -=
+        normal * kMissionLateralOffsetM * static_cast<double>(mission_idx % 4u);
+  }
+  return T_G_I;
+}
+
+Eigen::Vector3d LargeScaleMapGenerator::getLandmarkPosition(
+    const size_t place, const size_t slot_idx) const {
+  const uint64_t index = place * options_.num_landmarks_per_vertex + slot_idx;
+  const uint64_t hash =
+      hashIndex(IdTag::kLandmarkPosition, index, options_.seed);
+  const double depth =
+      kMinLandmarkDepthM +
+      hashToUniform(mixBits(hash)) * (kMaxLandmarkDepthM - kMinLandmarkDepthM);
+  const Eigen::Vector3d p_I_fi(
+      (2.0 * hashToUniform(mixBits(hash + 1u)) - 1.0) * kMaxLandmarkOffsetM,
+      (2.0 * hashToUniform(mixBits(hash + 2u)) - 1.0) * kMaxLandmarkOffsetM,
+      depth);
+  return getPlacePose(place) * p_I_fi;
+}
+
+bool LargeScaleMapGenerator::isLandmarkReused(
+    const size_t global_vertex_idx, const size_t slot_idx) const {
+  const uint64_t index =
+      global_vertex_idx * options_.num_landmarks_per_vertex + slot_idx;
+  return hashToUniform(hashIndex(IdTag::kLandmarkReuse, index, options_.seed)) <
+         options_.revisit_landmark_reuse_ratio;
+}
+
+size_t LargeScaleMapGenerator::getLandmarkCreatingVertex(
+    const size_t mission_idx, const size_t vertex_idx,
+    const size_t slot_idx) const {
+  const size_t global_vertex_idx =
+      getGlobalVertexIndex(mission_idx, vertex_idx);
+  if (options_.num_vertices_per_loop == 0u) {
+    return global_vertex_idx;
+  }
+  const size_t first_visit =
+      first_visit_of_place_[getPlaceOfVertex(mission_idx, vertex_idx)];
+  CHECK_NE(first_visit, kInvalidIndex);
+  if (first_visit != global_vertex_idx &&
+      isLandmarkReused(global_vertex_idx, slot_idx)) {
+    return first_visit;
+  }
+  return global_vertex_idx;
+}
+
+vi_map::Vertex::UniquePtr LargeScaleMapGenerator::generateVertex(
+    const size_t mission_idx, const size_t vertex_idx) const {
+  const size_t num_slots = options_.num_landmarks_per_vertex;
+  const size_t num_tracked_visits =
+      std::min(vertex_idx + 1u, options_.track_length);
+  const size_t num_keypoints = num_tracked_visits * num_slots;
+
+  const pose::Transformation T_G_I = getVertexPose(mission_idx, vertex_idx);
+  const pose::Transformation T_C_G =
+      n_camera_->get_T_C_B(0u) * T_G_I.inverse();
+  const aslam::Camera& camera = n_camera_->getCamera(0u);
+
+  // The keypoint of the slot of a visit tracked_visit_idx vertices back has
+  // the index tracked_visit_idx * num_slots + slot_idx.
+  Eigen::Matrix2Xd keypoints(2, num_keypoints);
+  aslam::VisualFrame::DescriptorsT descriptors(
+      kDescriptorSizeBytes, num_keypoints);
+  LandmarkIdList observed_landmark_ids(num_keypoints);
+  for (size_t tracked_visit_idx = 0u; tracked_visit_idx < num_tracked_visits;
+       ++tracked_visit_idx) {
+    const size_t visit_vertex_idx = vertex_idx - tracked_visit_idx;
+    const size_t place = getPlaceOfVertex(mission_idx, visit_vertex_idx);
+    for (size_t slot_idx = 0u; slot_idx < num_slots; ++slot_idx) {
+      const size_t keypoint_idx = tracked_visit_idx * num_slots + slot_idx;
+
+      // The visibility is not enforced, the keypoints can be outside of the
+      // image.
+      Eigen::Vector2d keypoint;
+      camera.project3(
+          T_C_G * getLandmarkPosition(place, slot_idx), &keypoint);
+      keypoints.col(keypoint_idx) = keypoint;
+
+      // All observations of the landmarks of a place share the descriptor.
+      const uint64_t descriptor_hash = hashIndex(
+          IdTag::kDescriptor, place * num_slots + slot_idx, options_.seed);
+      for (size_t byte_idx = 0u; byte_idx < kDescriptorSizeBytes;
+           byte_idx += sizeof(uint64_t)) {
+        const uint64_t bits = mixBits(descriptor_hash + byte_idx);
+        for (size_t bit_byte_idx = 0u;
+             bit_byte_idx < sizeof(uint64_t) &&
+             byte_idx + bit_byte_idx < kDescriptorSizeBytes;
+             ++bit_byte_idx) {
+          descriptors(byte_idx + bit_byte_idx, keypoint_idx) =
+              static_cast<unsigned char>(bits >> (8u * bit_byte_idx));
+        }
+      }
+
+      const size_t creating_vertex_idx = getLandmarkCreatingVertex(
+          mission_idx, visit_vertex_idx, slot_idx);
+      generateDeterministicId(
+          IdTag::kLandmark, creating_vertex_idx * num_slots + slot_idx,
+          options_.seed, &observed_landmark_ids[keypoint_idx]);
+    }
+  }
+
+  const size_t global_vertex_idx =
+      getGlobalVertexIndex(mission_idx, vertex_idx);
+  pose_graph::VertexId vertex_id;
+  generateDeterministicId(
+      IdTag::kVertex, global_vertex_idx, options_.seed, &vertex_id);
+  aslam::FrameId frame_id;
+  generateDeterministicId(
+      IdTag::kFrame, global_vertex_idx, options_.seed, &frame_id);
+  MissionId mission_id;
+  generateDeterministicId(
+      IdTag::kMission, mission_idx, options_.seed, &mission_id);
+  const int64_t timestamp_ns = mission_idx * kMissionTimeOffsetNs +
+                               vertex_idx * kVertexTimeDeltaNs;
+
+  vi_map::Vertex::UniquePtr vertex(new vi_map::Vertex(
+      vertex_id, Eigen::Matrix<double, 6, 1>::Zero(), keypoints,
+      Eigen::VectorXd::Constant(num_keypoints, kKeypointUncertainty),
+      descriptors, observed_landmark_ids, mission_id, frame_id, timestamp_ns,
+      n_camera_));
+  // The missions have the identity as baseframe transformation.
+  vertex->set_T_M_I(T_G_I);
+  addLandmarksStoredInVertex(mission_idx, vertex_idx, vertex.get());
+  return vertex;
+}
+
+void LargeScaleMapGenerator::addLandmarksStoredInVertex(
+    const size_t mission_idx, const size_t vertex_idx,
+    vi_map::Vertex* vertex) const {
+  CHECK_NOTNULL(vertex);
+  const size_t num_slots = options_.num_landmarks_per_vertex;
+  const size_t num_vertices_per_mission = options_.num_vertices_per_mission;
+  const size_t num_places = options_.num_vertices_per_loop;
+  const size_t global_vertex_idx =
+      getGlobalVertexIndex(mission_idx, vertex_idx);
+  const size_t place = getPlaceOfVertex(mission_idx, vertex_idx);
+  const bool is_first_visit =
+      num_places > 0u && first_visit_of_place_[place] == global_vertex_idx;
+  const pose::Transformation T_I_G = vertex->get_T_M_I().inverse();
+
+  // Adds the observations of the given visit to the landmark, i.e. the
+  // vertices tracking the visit.
+  auto add_track_observations = [&](
+      const size_t visit_mission_idx, const size_t visit_vertex_idx,
+      const size_t slot_idx, Landmark* landmark) {
+    const size_t end_vertex_idx = std::min(
+        visit_vertex_idx + options_.track_length, num_vertices_per_mission);
+    for (size_t observer_vertex_idx = visit_vertex_idx;
+         observer_vertex_idx < end_vertex_idx; ++observer_vertex_idx) {
+      pose_graph::VertexId observer_vertex_id;
+      generateDeterministicId(
+          IdTag::kVertex,
+          getGlobalVertexIndex(visit_mission_idx, observer_vertex_idx),
+          options_.seed, &observer_vertex_id);
+      const size_t tracked_visit_idx = observer_vertex_idx - visit_vertex_idx;
+      landmark->addObservation(
+          observer_vertex_id, 0u, tracked_visit_idx * num_slots + slot_idx);
+    }
+  };
+
+  for (size_t slot_idx = 0u; slot_idx < num_slots; ++slot_idx) {
+    if (getLandmarkCreatingVertex(mission_idx, vertex_idx, slot_idx) !=
+        global_vertex_idx) {
+      continue;
+    }
+    Landmark landmark;
+    LandmarkId landmark_id;
+    generateDeterministicId(
+        IdTag::kLandmark, global_vertex_idx * num_slots + slot_idx,
+        options_.seed, &landmark_id);
+    landmark.setId(landmark_id);
+    landmark.set_p_B(T_I_G * getLandmarkPosition(place, slot_idx));
+
+    add_track_observations(mission_idx, vertex_idx, slot_idx, &landmark);
+    if (is_first_visit) {
+      // The revisits of the place reusing this landmark.
+      for (size_t visit_mission_idx = 0u;
+           visit_mission_idx < options_.num_missions; ++visit_mission_idx) {
+        const size_t first_vertex_idx =
+            (place + num_places - getFirstPlaceOfMission(visit_mission_idx)) %
+            num_places;
+        for (size_t visit_vertex_idx = first_vertex_idx;
+             visit_vertex_idx < num_vertices_per_mission;
+             visit_vertex_idx += num_places) {
+          const size_t global_visit_idx =
+              getGlobalVertexIndex(visit_mission_idx, visit_vertex_idx);
+          if (global_visit_idx != global_vertex_idx &&
+              isLandmarkReused(global_visit_idx, slot_idx)) {
+            add_track_observations(
+                visit_mission_idx, visit_vertex_idx, slot_idx, &landmark);
+          }
+        }
+      }
+    }
+    vertex->getLandmarks().addLandmark(landmark);
+  }
+}
+
+void LargeScaleMapGenerator::generateMap(VIMap* map) const {
+  CHECK_NOTNULL(map);
+  CHECK_EQ(0u, map->numVertices());
+  CHECK_EQ(0u, map->numMissions());
+  CHECK(n_camera_);
+
+  const size_t num_threads = options_.num_threads > 0u
+                                 ? options_.num_threads
+                                 : common::getNumHardwareThreads();
+  const size_t num_missions = options_.num_missions;
+  const size_t num_vertices_per_mission = options_.num_vertices_per_mission;
+  const size_t num_vertices = num_missions * num_vertices_per_mission;
+
+  SensorManager& sensor_manager = map->getSensorManager();
+  ImuSigmas imu_sigmas;
+  imu_sigmas.gyro_noise_density = 0.1;
+  imu_sigmas.gyro_bias_random_walk_noise_density = 0.1;
+  imu_sigmas.acc_noise_density = 0.1;
+  imu_sigmas.acc_bias_random_walk_noise_density = 0.1;
+  SensorId imu_sensor_id;
+  common::generateId(&imu_sensor_id);
+  Imu::UniquePtr imu_sensor =
+      aligned_unique<Imu>(imu_sensor_id, static_cast<std::string>("imu0"));
+  imu_sensor->setImuSigmas(imu_sigmas);
+  sensor_manager.addSensor(std::move(imu_sensor));
+
+  MissionIdList mission_ids(num_missions);
+  for (size_t mission_idx = 0u; mission_idx < num_missions; ++mission_idx) {
+    generateDeterministicId(
+        IdTag::kMission, mission_idx, options_.seed,
+        &mission_ids[mission_idx]);
+    map->addNewMissionWithBaseframe(
+        mission_ids[mission_idx], pose::Transformation(),
+        Eigen::Matrix<double, 6, 6>::Zero(), n_camera_,
+        Mission::BackBone::kOdometry);
+    sensor_manager.associateExistingSensorWithMission(
+        imu_sensor_id, mission_ids[mission_idx]);
+  }
+
+  // The vertices, including their keypoints and stored landmarks, don't
+  // depend on each other and are generated in parallel.
+  std::vector<vi_map::Vertex::UniquePtr> vertices(num_vertices);
+  common::ParallelProcessDynamic(
+      num_vertices,
+      [&](const size_t begin, const size_t end) {
+        for (size_t global_vertex_idx = begin; global_vertex_idx < end;
+             ++global_vertex_idx) {
+          vertices[global_vertex_idx] = generateVertex(
+              global_vertex_idx / num_vertices_per_mission,
+              global_vertex_idx % num_vertices_per_mission);
+        }
+      },
+      num_threads);
+
+  // The stored landmarks are needed for the landmark index and the edges for
+  // the relative poses.
+  std::vector<std::pair<LandmarkId, pose_graph::VertexId>> stored_landmarks;
+  Aligned<std::vector, pose::Transformation> T_M_I(num_vertices);
+  for (size_t global_vertex_idx = 0u; global_vertex_idx < num_vertices;
+       ++global_vertex_idx) {
+    const vi_map::Vertex& vertex = *vertices[global_vertex_idx];
+    T_M_I[global_vertex_idx] = vertex.get_T_M_I();
+    for (const Landmark& landmark : vertex.getLandmarks()) {
+      stored_landmarks.emplace_back(landmark.id(), vertex.id());
+    }
+  }
+
+  const size_t num_edges = num_missions * (num_vertices_per_mission - 1u);
+  map->reserveAdditional(num_vertices, num_edges, stored_landmarks.size());
+  for (vi_map::Vertex::UniquePtr& vertex : vertices) {
+    map->addVertex(std::move(vertex));
+  }
+  vertices.clear();
+
+  Eigen::Matrix<double, 6, 6> T_covariance =
+      Eigen::Matrix<double, 6, 6>::Identity() * kOdometryCovariance;
+  for (size_t mission_idx = 0u; mission_idx < num_missions; ++mission_idx) {
+    pose_graph::VertexId root_vertex_id;
+    generateDeterministicId(
+        IdTag::kVertex, getGlobalVertexIndex(mission_idx, 0u), options_.seed,
+        &root_vertex_id);
+    map->getMission(mission_ids[mission_idx]).setRootVertexId(root_vertex_id);
+
+    pose_graph::VertexId from_vertex_id = root_vertex_id;
+    for (size_t vertex_idx = 1u; vertex_idx < num_vertices_per_mission;
+         ++vertex_idx) {
+      const size_t global_vertex_idx =
+          getGlobalVertexIndex(mission_idx, vertex_idx);
+      pose_graph::VertexId to_vertex_id;
+      generateDeterministicId(
+          IdTag::kVertex, global_vertex_idx, options_.seed, &to_vertex_id);
+      pose_graph::EdgeId edge_id;
+      generateDeterministicId(
+          IdTag::kEdge, global_vertex_idx, options_.seed, &edge_id);
+      map->addEdge(vi_map::Edge::UniquePtr(new TransformationEdge(
+          vi_map::Edge::EdgeType::kOdometry, edge_id, from_vertex_id,
+          to_vertex_id,
+          T_M_I[global_vertex_idx - 1u].inverse() * T_M_I[global_vertex_idx],
+          T_covariance)));
+      from_vertex_id = to_vertex_id;
+    }
+  }
+
+  // The landmark index is sharded and can be filled in parallel.
+  common::ParallelProcessDynamic(
+      stored_landmarks.size(),
+      [&](const size_t begin, const size_t end) {
+        for (size_t landmark_idx = begin; landmark_idx < end; ++landmark_idx) {
+          map->addLandmarkIndexReference(
+              stored_landmarks[landmark_idx].first,
+              stored_landmarks[landmark_idx].second);
+        }
+      },
+      num_threads);
+
+  LOG(INFO) << "Generated a map with " << num_missions << " missions, "
+            << num_vertices << " vertices, " << num_edges << " edges and "
+            << stored_landmarks.size() << " landmarks.";
+}
+
+}  // namespace vi_map
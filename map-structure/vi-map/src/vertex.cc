@@ -2,6 +2,7 @@
 
 #include <string>
 #include <unordered_set>
+#include <utility>
 
 #include <glog/logging.h>
 
@@ -41,7 +42,7 @@ Vertex::Vertex(
     const std::vector<LandmarkId>& observed_landmark_ids,
     const vi_map::MissionId& mission_id, const aslam::FrameId& frame_id,
     int64_t frame_timestamp, const aslam::NCamera::Ptr cameras)
-    : id_(vertex_id), mission_id_(mission_id) {
+    : id_(vertex_id), mission_id_(mission_id), vertex_file_index_(-1) {
   CHECK(cameras != nullptr);
   CHECK_EQ(1u, cameras->numCameras())
       << "This constructor supports "
@@ -106,12 +107,13 @@ Vertex::Vertex(
     const pose_graph::VertexId& vertex_id,
     const Eigen::Matrix<double, 6, 1>& imu_ba_bw,
     const aslam::VisualNFrame::Ptr visual_n_frame,
-    const std::vector<std::vector<LandmarkId>>& observed_landmark_ids,
+    std::vector<std::vector<LandmarkId>> observed_landmark_ids,
     const vi_map::MissionId& mission_id)
     : id_(vertex_id),
       mission_id_(mission_id),
       n_frame_(visual_n_frame),
-      observed_landmark_ids_(observed_landmark_ids) {
+      observed_landmark_ids_(std::move(observed_landmark_ids)),
+      vertex_file_index_(-1) {
   CHECK(n_frame_ != nullptr);
 
   checkConsistencyOfVisualObservationContainers();
@@ -127,7 +129,10 @@ Vertex::Vertex(
     const pose_graph::VertexId& vertex_id,
     const aslam::VisualNFrame::Ptr visual_n_frame,
     const vi_map::MissionId& mission_id)
-    : id_(vertex_id), mission_id_(mission_id), n_frame_(visual_n_frame) {
+    : id_(vertex_id),
+      mission_id_(mission_id),
+      n_frame_(visual_n_frame),
+      vertex_file_index_(-1) {
   CHECK(n_frame_ != nullptr);
 
   observed_landmark_ids_.resize(n_frame_->getNumFrames());
@@ -146,7 +151,7 @@ Vertex::Vertex(
   resource_map_.resize(n_frame_->getNumFrames());
 }
 
-Vertex::Vertex(const aslam::NCamera::Ptr cameras) {
+Vertex::Vertex(const aslam::NCamera::Ptr cameras) : vertex_file_index_(-1) {
   CHECK(cameras != nullptr);
   n_frame_.reset(new aslam::VisualNFrame(cameras));
   observed_landmark_ids_.resize(n_frame_->getNumFrames());
@@ -175,7 +180,7 @@ Vertex::Vertex(const aslam::NCamera::Ptr cameras) {
   resource_map_.resize(n_frame_->getNumFrames());
 }
 
-Vertex::Vertex() {
+Vertex::Vertex() : vertex_file_index_(-1) {
   T_M_I_.setIdentity();
   v_M_.setZero();
   accel_bias_.setZero();
@@ -186,6 +191,10 @@ const pose_graph::VertexId& Vertex::id() const {
   return id_;
 }
 
+pose_graph::Vertex::UniquePtr Vertex::clone() const {
+  return aligned_unique<Vertex>(*this);
+}
+
 void Vertex::setId(const pose_graph::VertexId& id) {
   id_ = id;
 }
@@ -236,6 +245,77 @@ void Vertex::removeOutgoingEdge(const pose_graph::EdgeId& edge_id) {
   outgoing_edges_.erase(edge_id);
 }
 
+void Vertex::accumulateMemoryUsage(common::MemoryUsage* usage) const {
+  CHECK_NOTNULL(usage);
+  typedef common::MemoryUsage::Category Category;
+  usage->add(Category::kVertices, sizeof(Vertex));
+  usage->add(
+      Category::kEdges, common::getHeapBytes(incoming_edges_) +
+                            common::getHeapBytes(outgoing_edges_));
+
+  size_t num_observation_bytes = common::getHeapBytes(observed_landmark_ids_);
+  for (const LandmarkIdList& landmark_ids : observed_landmark_ids_) {
+    num_observation_bytes += common::getHeapBytes(landmark_ids);
+  }
+  usage->add(Category::kLandmarkObservations, num_observation_bytes);
+  landmarks_.accumulateMemoryUsage(usage);
+
+  size_t num_resource_id_bytes = common::getHeapBytes(resource_map_);
+  for (const backend::ResourceTypeToIdsMap& type_to_ids : resource_map_) {
+    num_resource_id_bytes += common::getHeapBytes(type_to_ids);
+    for (const backend::ResourceTypeToIdsMap::value_type& ids : type_to_ids) {
+      num_resource_id_bytes += common::getHeapBytes(ids.second);
+    }
+  }
+  usage->add(Category::kIndexStructures, num_resource_id_bytes);
+
+  if (!n_frame_) {
+    return;
+  }
+  usage->add(Category::kVertices, sizeof(aslam::VisualNFrame));
+  for (size_t frame_idx = 0u; frame_idx < numFrames(); ++frame_idx) {
+    if (!isVisualFrameSet(frame_idx)) {
+      continue;
+    }
+    const aslam::VisualFrame& frame = getVisualFrame(frame_idx);
+    usage->add(Category::kVertices, sizeof(aslam::VisualFrame));
+    if (frame.hasDescriptors()) {
+      usage->add(
+          Category::kDescriptors,
+          common::getHeapBytes(frame.getDescriptors()));
+    }
+
+    size_t num_keypoint_bytes = 0u;
+    if (frame.hasKeypointMeasurements()) {
+      num_keypoint_bytes +=
+          common::getHeapBytes(frame.getKeypointMeasurements());
+    }
+    if (frame.hasKeypointMeasurementUncertainties()) {
+      num_keypoint_bytes +=
+          common::getHeapBytes(frame.getKeypointMeasurementUncertainties());
+    }
+    if (frame.hasKeypointOrientations()) {
+      num_keypoint_bytes +=
+          common::getHeapBytes(frame.getKeypointOrientations());
+    }
+    if (frame.hasKeypointScales()) {
+      num_keypoint_bytes += common::getHeapBytes(frame.getKeypointScales());
+    }
+    if (frame.hasKeypointScores()) {
+      num_keypoint_bytes += common::getHeapBytes(frame.getKeypointScores());
+    }
+    if (frame.hasTrackIds()) {
+      num_keypoint_bytes += common::getHeapBytes(frame.getTrackIds());
+    }
+    usage->add(Category::kKeypoints, num_keypoint_bytes);
+
+    if (frame.hasRawImage()) {
+      const cv::Mat& raw_image = frame.getRawImage();
+      usage->add(Category::kOther, raw_image.total() * raw_image.elemSize());
+    }
+  }
+}
+
 void Vertex::serialize(vi_map::proto::ViwlsVertex* proto) const {
   CHECK_NOTNULL(proto);
   proto->Clear();
@@ -313,7 +393,8 @@ void Vertex::deserialize(
   observed_landmark_ids_.resize(num_frames);
   for (int i = 0; i < num_frames; ++i) {
     if (n_frame_->isFrameSet(static_cast<size_t>(i))) {
-      aslam::proto::VisualFrame visual_frame = proto.n_visual_frame().frames(i);
+      const aslam::proto::VisualFrame& visual_frame =
+          proto.n_visual_frame().frames(i);
       observed_landmark_ids_[i].resize(visual_frame.landmark_ids_size());
       for (int j = 0; j < visual_frame.landmark_ids_size(); ++j) {
         observed_landmark_ids_[i][j].deserialize(visual_frame.landmark_ids(j));
@@ -605,6 +686,39 @@ void Vertex::updateIdInObservedLandmarkIdList(
   }
 }
 
+size_t Vertex::updateIdsInObservedLandmarkIdList(
+    const LandmarkToLandmarkMap& old_to_new_landmark_ids) {
+  size_t num_replaced = 0u;
+  for (LandmarkIdList& landmark_ids : observed_landmark_ids_) {
+    for (LandmarkId& landmark_id : landmark_ids) {
+      if (!landmark_id.isValid()) {
+        continue;
+      }
+      LandmarkToLandmarkMap::const_iterator it =
+          old_to_new_landmark_ids.find(landmark_id);
+      if (it != old_to_new_landmark_ids.end()) {
+        landmark_id = it->second;
+        ++num_replaced;
+      }
+    }
+  }
+  return num_replaced;
+}
+
+size_t Vertex::invalidateObservedLandmarkIds(
+    const LandmarkIdSet& landmark_ids) {
+  size_t num_invalidated = 0u;
+  for (LandmarkIdList& observed_landmark_ids : observed_landmark_ids_) {
+    for (LandmarkId& landmark_id : observed_landmark_ids) {
+      if (landmark_id.isValid() && landmark_ids.count(landmark_id) > 0u) {
+        landmark_id.setInvalid();
+        ++num_invalidated;
+      }
+    }
+  }
+  return num_invalidated;
+}
+
 std::string Vertex::getComparisonString(const Vertex& other) const {
   if (operator==(other)) {
     return "There is no difference between the given vertices!\n";
@@ -0,0 +1,522 @@
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <aslam/common/memory.h>
+#include <glog/logging.h>
+#include <map-resources/resource-common.h>
+#include <map-resources/resource-map.h>
+#include <map-resources/resource_info_map.pb.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/proto-serialization-helper.h>
+#include <maplab-common/threading-helpers.h>
+
+#include "vi-map/vertex.h"
+#include "vi-map/vi-map-serialization.h"
+#include "vi-map/vi-map.h"
+#include "vi-map/vi_map.pb.h"
+
+namespace vi_map {
+namespace serialization {
+
+namespace {
+// Layout of a map delta in the raw data list.
+constexpr size_t kMapDeltaSensorManagerIndex = 0u;
+constexpr size_t kMapDeltaProtoIndex = 1u;
+constexpr size_t kMapDeltaResourceInfoIndex = 2u;
+constexpr size_t kMapDeltaNumParts = 3u;
+
+// FNV-1a over the bytes of the values, which is the same on every platform, as
+// opposed to std::hash.
+class FingerprintBuilder {
+ public:
+  FingerprintBuilder() : hash_(kOffsetBasis) {}
+
+  void addBytes(const void* data, size_t num_bytes) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t idx = 0u; idx < num_bytes; ++idx) {
+      hash_ ^= bytes[idx];
+      hash_ *= kPrime;
+    }
+  }
+  void addInteger(int64_t value) {
+    addBytes(&value, sizeof(value));
+  }
+  // Quantized, such that the round trip through the serialization, e.g. the
+  // normalization of the rotations, doesn't change the fingerprint.
+  void addDouble(double value) {
+    constexpr double kQuantization = 1e9;
+    addInteger(static_cast<int64_t>(std::llround(value * kQuantization)));
+  }
+  template <typename Derived>
+  void addMatrix(const Eigen::MatrixBase<Derived>& matrix) {
+    addInteger(matrix.rows());
+    addInteger(matrix.cols());
+    for (int col = 0; col < matrix.cols(); ++col) {
+      for (int row = 0; row < matrix.rows(); ++row) {
+        addDouble(matrix(row, col));
+      }
+    }
+  }
+  void addId(const aslam::HashId& id) {
+    const std::string hex_string = id.hexString();
+    addBytes(hex_string.data(), hex_string.size());
+  }
+  void addFingerprint(uint64_t fingerprint) {
+    addBytes(&fingerprint, sizeof(fingerprint));
+  }
+
+  uint64_t get() const {
+    return hash_;
+  }
+
+ private:
+  static constexpr uint64_t kOffsetBasis = 14695981039346656037ull;
+  static constexpr uint64_t kPrime = 1099511628211ull;
+  uint64_t hash_;
+};
+
+// The frame resources are stored in unordered containers, hence the
+// fingerprints of the ids are summed up.
+uint64_t computeFrameResourcesFingerprint(
+    const backend::ResourceTypeToIdsMap& resources) {
+  uint64_t fingerprint = 0u;
+  for (const backend::ResourceTypeToIdsMap::value_type& type_and_ids :
+       resources) {
+    for (const backend::ResourceId& resource_id : type_and_ids.second) {
+      FingerprintBuilder builder;
+      builder.addInteger(static_cast<int64_t>(type_and_ids.first));
+      builder.addId(resource_id);
+      fingerprint += builder.get();
+    }
+  }
+  return fingerprint;
+}
+
+void serializeNewMissions(
+    const vi_map::VIMap& map, const MissionIdList& mission_ids,
+    proto::VIMap* proto) {
+  CHECK_NOTNULL(proto);
+  for (const MissionId& mission_id : mission_ids) {
+    const VIMission& mission = map.getMission(mission_id);
+    mission_id.serialize(proto->add_mission_ids());
+    mission.serialize(proto->add_missions());
+    mission.getBaseFrameId().serialize(proto->add_mission_base_frame_ids());
+    map.getMissionBaseFrame(mission.getBaseFrameId())
+        .serialize(proto->add_mission_base_frames());
+
+    if (map.hasOptionalSensorData(mission_id)) {
+      proto::OptionalSensorDataMissionPair* optional_sensor_data_proto =
+          proto->add_optional_sensor_data_mission_id_pair();
+      mission_id.serialize(optional_sensor_data_proto->mutable_mission_id());
+      map.getOptionalSensorData(mission_id).serialize(
+          optional_sensor_data_proto->mutable_optional_sensor_data());
+    }
+  }
+}
+
+void serializeResourceReferences(
+    const vi_map::VIMap& map, const pose_graph::VertexIdList& vertex_ids,
+    resource_info::proto::ResourceInfoMap* proto) {
+  CHECK_NOTNULL(proto);
+  std::unordered_set<backend::ResourceId> serialized_resource_ids;
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    for (const backend::ResourceTypeToIdsMap& frame_resources :
+         map.getVertex(vertex_id).getFrameResourceMap()) {
+      for (const backend::ResourceTypeToIdsMap::value_type& type_and_ids :
+           frame_resources) {
+        for (const backend::ResourceId& resource_id : type_and_ids.second) {
+          if (!map.hasResourceInfo(resource_id, type_and_ids.first) ||
+              !serialized_resource_ids.insert(resource_id).second) {
+            continue;
+          }
+          proto->add_resource_type(static_cast<uint32_t>(type_and_ids.first));
+          resource_id.serialize(proto->add_resource_id());
+          // Refers to the resource folder given to the receiver.
+          proto->add_resource_info()->set_folder_idx(
+              backend::ResourceMap::kMapResourceFolder);
+        }
+      }
+    }
+  }
+}
+
+// Points the landmark index to the vertex for all landmarks stored in it.
+void indexStoredLandmarks(const vi_map::Vertex& vertex, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  for (const Landmark& landmark : vertex.getLandmarks()) {
+    if (!map->hasLandmark(landmark.id())) {
+      map->addLandmarkIndexReference(landmark.id(), vertex.id());
+    } else if (map->getLandmarkStoreVertexId(landmark.id()) != vertex.id()) {
+      map->updateLandmarkIndexReference(landmark.id(), vertex.id());
+    }
+  }
+}
+}  // namespace
+
+uint64_t computeVertexFingerprint(const vi_map::Vertex& vertex) {
+  FingerprintBuilder builder;
+  builder.addId(vertex.getMissionId());
+  builder.addMatrix(vertex.get_T_M_I().getPosition());
+  builder.addMatrix(
+      vertex.get_T_M_I().getRotation().toImplementation().coeffs());
+  builder.addMatrix(vertex.get_v_M());
+  builder.addMatrix(vertex.getAccelBias());
+  builder.addMatrix(vertex.getGyroBias());
+
+  builder.addInteger(vertex.numFrames());
+  for (size_t frame_idx = 0u; frame_idx < vertex.numFrames(); ++frame_idx) {
+    if (!vertex.isVisualFrameSet(frame_idx)) {
+      builder.addInteger(-1);
+      continue;
+    }
+    builder.addMatrix(
+        vertex.getVisualFrame(frame_idx).getKeypointMeasurements());
+    for (const LandmarkId& landmark_id :
+         vertex.getFrameObservedLandmarkIds(frame_idx)) {
+      builder.addId(landmark_id);
+    }
+  }
+  for (const backend::ResourceTypeToIdsMap& frame_resources :
+       vertex.getFrameResourceMap()) {
+    builder.addFingerprint(computeFrameResourcesFingerprint(frame_resources));
+  }
+
+  builder.addInteger(vertex.getLandmarks().size());
+  for (const Landmark& landmark : vertex.getLandmarks()) {
+    builder.addId(landmark.id());
+    builder.addMatrix(landmark.get_p_B());
+    builder.addInteger(static_cast<int64_t>(landmark.getQuality()));
+    landmark.forEachObservation(
+        [&builder](const KeypointIdentifier& keypoint_id) {
+          builder.addId(keypoint_id.frame_id.vertex_id);
+          builder.addInteger(keypoint_id.frame_id.frame_index);
+          builder.addInteger(keypoint_id.keypoint_index);
+        });
+  }
+  return builder.get();
+}
+
+void computeMapDeltaBase(const vi_map::VIMap& map, MapDeltaBase* base) {
+  CHECK_NOTNULL(base);
+  map.getAllMissionIds(&base->mission_ids);
+
+  pose_graph::VertexIdList vertex_ids;
+  map.getAllVertexIds(&vertex_ids);
+  std::vector<uint64_t> fingerprints(vertex_ids.size());
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      vertex_ids.size(),
+      [&map, &vertex_ids, &fingerprints](const std::vector<size_t>& range) {
+        for (const size_t idx : range) {
+          fingerprints[idx] =
+              computeVertexFingerprint(map.getVertex(vertex_ids[idx]));
+        }
+      },
+      kAlwaysParallelize, common::getNumHardwareThreads());
+  base->vertex_fingerprints.clear();
+  base->vertex_fingerprints.reserve(vertex_ids.size());
+  for (size_t idx = 0u; idx < vertex_ids.size(); ++idx) {
+    base->vertex_fingerprints.emplace(vertex_ids[idx], fingerprints[idx]);
+  }
+
+  pose_graph::EdgeIdList edge_ids;
+  map.getAllEdgeIds(&edge_ids);
+  base->edge_ids.clear();
+  base->edge_ids.insert(edge_ids.begin(), edge_ids.end());
+}
+
+void serializeMapDeltaBaseToRawArray(
+    const MapDeltaBase& base, network::RawMessageDataList* raw_data) {
+  CHECK_NOTNULL(raw_data);
+  proto::MapDeltaBase proto;
+  for (const MissionId& mission_id : base.mission_ids) {
+    mission_id.serialize(proto.add_mission_ids());
+  }
+  proto.mutable_vertex_ids()->Reserve(base.vertex_fingerprints.size());
+  proto.mutable_vertex_fingerprints()->Reserve(base.vertex_fingerprints.size());
+  for (const std::pair<const pose_graph::VertexId, uint64_t>& value :
+       base.vertex_fingerprints) {
+    value.first.serialize(proto.add_vertex_ids());
+    proto.add_vertex_fingerprints(value.second);
+  }
+  for (const pose_graph::EdgeId& edge_id : base.edge_ids) {
+    edge_id.serialize(proto.add_edge_ids());
+  }
+
+  raw_data->emplace_back();
+  common::proto_serialization_helper::serializeToArray(
+      proto, &raw_data->back().first, &raw_data->back().second);
+}
+
+void deserializeMapDeltaBaseFromRawArray(
+    const network::RawMessageDataList& raw_data, const size_t start_index,
+    MapDeltaBase* base) {
+  CHECK_NOTNULL(base);
+  const network::RawMessageData& raw_data_element =
+      network::checkAndGetEntry(raw_data, start_index);
+  proto::MapDeltaBase proto;
+  common::proto_serialization_helper::deserializeFromArray(
+      raw_data_element.first, raw_data_element.second, &proto);
+  CHECK_EQ(proto.vertex_ids_size(), proto.vertex_fingerprints_size());
+
+  base->mission_ids.clear();
+  for (const common::proto::Id& mission_id_proto : proto.mission_ids()) {
+    MissionId mission_id;
+    mission_id.deserialize(mission_id_proto);
+    base->mission_ids.insert(mission_id);
+  }
+  base->vertex_fingerprints.clear();
+  base->vertex_fingerprints.reserve(proto.vertex_ids_size());
+  for (int idx = 0; idx < proto.vertex_ids_size(); ++idx) {
+    pose_graph::VertexId vertex_id;
+    vertex_id.deserialize(proto.vertex_ids(idx));
+    base->vertex_fingerprints.emplace(
+        vertex_id, proto.vertex_fingerprints(idx));
+  }
+  base->edge_ids.clear();
+  for (const common::proto::Id& edge_id_proto : proto.edge_ids()) {
+    pose_graph::EdgeId edge_id;
+    edge_id.deserialize(edge_id_proto);
+    base->edge_ids.insert(edge_id);
+  }
+}
+
+void serializeMapDeltaToRawArray(
+    const vi_map::VIMap& map, const MapDeltaBase& base,
+    network::RawMessageDataList* raw_data, MapDeltaStatistics* statistics) {
+  CHECK_NOTNULL(raw_data);
+  MapDeltaStatistics delta_statistics;
+  proto::VIMap proto;
+
+  MissionIdList mission_ids;
+  map.getAllMissionIds(&mission_ids);
+  MissionIdList new_mission_ids;
+  for (const MissionId& mission_id : mission_ids) {
+    if (base.mission_ids.count(mission_id) == 0u) {
+      new_mission_ids.push_back(mission_id);
+    }
+  }
+  serializeNewMissions(map, new_mission_ids, &proto);
+  delta_statistics.num_new_missions = new_mission_ids.size();
+
+  pose_graph::VertexIdList vertex_ids;
+  map.getAllVertexIds(&vertex_ids);
+  std::vector<char> is_vertex_in_delta(vertex_ids.size(), false);
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      vertex_ids.size(),
+      [&](const std::vector<size_t>& range) {
+        for (const size_t idx : range) {
+          const pose_graph::VertexId& vertex_id = vertex_ids[idx];
+          const std::unordered_map<pose_graph::VertexId, uint64_t>::
+              const_iterator it = base.vertex_fingerprints.find(vertex_id);
+          is_vertex_in_delta[idx] =
+              it == base.vertex_fingerprints.end() ||
+              it->second != computeVertexFingerprint(map.getVertex(vertex_id));
+        }
+      },
+      kAlwaysParallelize, common::getNumHardwareThreads());
+  pose_graph::VertexIdList delta_vertex_ids;
+  for (size_t idx = 0u; idx < vertex_ids.size(); ++idx) {
+    if (!is_vertex_in_delta[idx]) {
+      continue;
+    }
+    delta_vertex_ids.push_back(vertex_ids[idx]);
+    if (base.vertex_fingerprints.count(vertex_ids[idx]) > 0u) {
+      ++delta_statistics.num_changed_vertices;
+    } else {
+      ++delta_statistics.num_new_vertices;
+    }
+  }
+  map.ensureDescriptorsLoaded(delta_vertex_ids);
+  serializeVertices(map, delta_vertex_ids, &proto);
+
+  pose_graph::EdgeIdList edge_ids;
+  map.getAllEdgeIds(&edge_ids);
+  for (const pose_graph::EdgeId& edge_id : edge_ids) {
+    if (base.edge_ids.count(edge_id) == 0u) {
+      edge_id.serialize(proto.add_edge_ids());
+      map.getEdgeAs<vi_map::Edge>(edge_id).serialize(proto.add_edges());
+      ++delta_statistics.num_new_edges;
+    }
+  }
+
+  resource_info::proto::ResourceInfoMap resource_info_proto;
+  serializeResourceReferences(map, delta_vertex_ids, &resource_info_proto);
+  delta_statistics.num_resource_references =
+      resource_info_proto.resource_id_size();
+
+  const size_t begin_index = raw_data->size();
+  raw_data->resize(begin_index + kMapDeltaNumParts);
+  serializeSensorManagerToArray(
+      map, &(*raw_data)[begin_index + kMapDeltaSensorManagerIndex]);
+  network::RawMessageData& proto_raw_data =
+      (*raw_data)[begin_index + kMapDeltaProtoIndex];
+  common::proto_serialization_helper::serializeToArray(
+      proto, &proto_raw_data.first, &proto_raw_data.second);
+  network::RawMessageData& resource_info_raw_data =
+      (*raw_data)[begin_index + kMapDeltaResourceInfoIndex];
+  common::proto_serialization_helper::serializeToArray(
+      resource_info_proto, &resource_info_raw_data.first,
+      &resource_info_raw_data.second);
+
+  VLOG(1) << "Map delta: " << delta_statistics.num_new_missions
+          << " new missions, " << delta_statistics.num_new_vertices
+          << " new and " << delta_statistics.num_changed_vertices
+          << " changed vertices, " << delta_statistics.num_new_edges
+          << " new edges, " << delta_statistics.num_resource_references
+          << " resource references.";
+  if (statistics != nullptr) {
+    *statistics = delta_statistics;
+  }
+}
+
+void applyMapDeltaFromRawArray(
+    const network::RawMessageDataList& raw_data, const size_t start_index,
+    const std::string& resource_map_folder, vi_map::VIMap* map,
+    MapDeltaStatistics* statistics) {
+  CHECK_NOTNULL(map);
+  CHECK_GE(raw_data.size(), start_index + kMapDeltaNumParts);
+  MapDeltaStatistics delta_statistics;
+
+  proto::VIMap proto;
+  const network::RawMessageData& proto_raw_data =
+      raw_data[start_index + kMapDeltaProtoIndex];
+  common::proto_serialization_helper::deserializeFromArray(
+      proto_raw_data.first, proto_raw_data.second, &proto);
+  resource_info::proto::ResourceInfoMap resource_info_proto;
+  const network::RawMessageData& resource_info_raw_data =
+      raw_data[start_index + kMapDeltaResourceInfoIndex];
+  common::proto_serialization_helper::deserializeFromArray(
+      resource_info_raw_data.first, resource_info_raw_data.second,
+      &resource_info_proto);
+
+  // The new missions, their sensors and the resource references are added by
+  // merging a map that only holds them.
+  resource_info::proto::ResourceInfoMap new_resource_info_proto;
+  if (!resource_map_folder.empty()) {
+    for (int idx = 0; idx < resource_info_proto.resource_id_size(); ++idx) {
+      backend::ResourceId resource_id;
+      resource_id.deserialize(resource_info_proto.resource_id(idx));
+      if (!map->hasResourceInfo(
+              resource_id, static_cast<backend::ResourceType>(
+                               resource_info_proto.resource_type(idx)))) {
+        new_resource_info_proto.add_resource_type(
+            resource_info_proto.resource_type(idx));
+        *new_resource_info_proto.add_resource_id() =
+            resource_info_proto.resource_id(idx);
+        *new_resource_info_proto.add_resource_info() =
+            resource_info_proto.resource_info(idx);
+      }
+    }
+  } else if (resource_info_proto.resource_id_size() > 0) {
+    LOG(WARNING) << "No resource folder given, the "
+                 << resource_info_proto.resource_id_size()
+                 << " resource references of the map delta are dropped.";
+  }
+  delta_statistics.num_new_missions = proto.mission_ids_size();
+  delta_statistics.num_resource_references =
+      new_resource_info_proto.resource_id_size();
+  if (proto.mission_ids_size() > 0 ||
+      new_resource_info_proto.resource_id_size() > 0) {
+    vi_map::VIMap delta_map;
+    deserializeSensorManagerFromArray(
+        raw_data[start_index + kMapDeltaSensorManagerIndex], &delta_map);
+    deserializeMissionsAndBaseframes(proto, &delta_map);
+    deserializeOptionalSensorData(proto, &delta_map);
+    if (new_resource_info_proto.resource_id_size() > 0) {
+      delta_map.setMapFolder(resource_map_folder);
+      delta_map.deserializeResourceInfo(new_resource_info_proto);
+    }
+    map->mergeAllMissionsFromMap(std::move(delta_map));
+  }
+
+  CHECK_EQ(proto.vertex_ids_size(), proto.vertices_size());
+  std::vector<vi_map::Vertex::UniquePtr> changed_vertices;
+  std::vector<const vi_map::Vertex*> new_vertices;
+  for (int idx = 0; idx < proto.vertex_ids_size(); ++idx) {
+    pose_graph::VertexId vertex_id;
+    vertex_id.deserialize(proto.vertex_ids(idx));
+    vi_map::Vertex::UniquePtr vertex = aligned_unique<vi_map::Vertex>();
+    vertex->deserialize(vertex_id, proto.vertices(idx));
+    CHECK(map->hasMission(vertex->getMissionId()))
+        << "The map delta does not belong to this map.";
+    vertex->setNCameras(map->getSensorManager().getNCameraSharedForMission(
+        vertex->getMissionId()));
+    if (map->hasVertex(vertex_id)) {
+      changed_vertices.emplace_back(std::move(vertex));
+    } else {
+      new_vertices.push_back(vertex.get());
+      map->addVertex(std::move(vertex));
+    }
+  }
+  delta_statistics.num_new_vertices = new_vertices.size();
+  delta_statistics.num_changed_vertices = changed_vertices.size();
+
+  // The edges of the changed vertices are kept, the new edges are added below.
+  for (vi_map::Vertex::UniquePtr& changed_vertex : changed_vertices) {
+    vi_map::Vertex& vertex = map->getVertex(changed_vertex->id());
+    CHECK_EQ(vertex.getMissionId(), changed_vertex->getMissionId());
+    // Landmarks that are no longer stored in the vertex have been removed or
+    // moved to another vertex of the delta, which updates the index again.
+    for (const Landmark& landmark : vertex.getLandmarks()) {
+      if (!changed_vertex->hasStoredLandmark(landmark.id()) &&
+          map->getLandmarkStoreVertexId(landmark.id()) == vertex.id()) {
+        map->change_tracker_.markLandmarkIndexChanged();
+        map->landmark_index.removeLandmark(landmark.id());
+      }
+    }
+
+    vertex.set_T_M_I(changed_vertex->get_T_M_I());
+    vertex.set_v_M(changed_vertex->get_v_M());
+    vertex.setAccelBias(changed_vertex->getAccelBias());
+    vertex.setGyroBias(changed_vertex->getGyroBias());
+    vertex.getVisualNFrameShared() = changed_vertex->getVisualNFrameShared();
+    vertex.resetObservedLandmarkIdsToInvalid();
+    for (size_t frame_idx = 0u; frame_idx < vertex.numFrames(); ++frame_idx) {
+      const LandmarkIdList& landmark_ids =
+          changed_vertex->getFrameObservedLandmarkIds(frame_idx);
+      for (size_t keypoint_idx = 0u; keypoint_idx < landmark_ids.size();
+           ++keypoint_idx) {
+        vertex.setObservedLandmarkId(
+            frame_idx, keypoint_idx, landmark_ids[keypoint_idx]);
+      }
+    }
+    vertex.setLandmarks(changed_vertex->getLandmarks());
+    vertex.setFrameResourceMap(changed_vertex->getFrameResourceMap());
+  }
+
+  for (const vi_map::Vertex* vertex : new_vertices) {
+    indexStoredLandmarks(*vertex, map);
+  }
+  for (const vi_map::Vertex::UniquePtr& changed_vertex : changed_vertices) {
+    indexStoredLandmarks(map->getVertex(changed_vertex->id()), map);
+  }
+
+  CHECK_EQ(proto.edge_ids_size(), proto.edges_size());
+  for (int idx = 0; idx < proto.edge_ids_size(); ++idx) {
+    pose_graph::EdgeId edge_id;
+    edge_id.deserialize(proto.edge_ids(idx));
+    if (!map->hasEdge(edge_id)) {
+      map->addEdge(vi_map::Edge::deserialize(edge_id, proto.edges(idx)));
+      ++delta_statistics.num_new_edges;
+    }
+  }
+
+  VLOG(1) << "Applied map delta: " << delta_statistics.num_new_missions
+          << " new missions, " << delta_statistics.num_new_vertices
+          << " new and " << delta_statistics.num_changed_vertices
+          << " changed vertices, " << delta_statistics.num_new_edges
+          << " new edges, " << delta_statistics.num_resource_references
+          << " resource references.";
+  if (statistics != nullptr) {
+    *statistics = delta_statistics;
+  }
+}
+
+}  // namespace serialization
+}  // namespace vi_map
@@ -1,13 +1,15 @@
 #include "vi-map/vi-map-serialization.h"
 
 #include <functional>
-#include <mutex>  // NOLINT
 #include <string>
 #include <thread>  // NOLINT
+#include <utility>
 
 #include <aslam/common/timer.h>
 #include <aslam/common/yaml-serialization.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
+#include <google/protobuf/arena.h>
 #include <map-resources/resource-map-serialization.h>
 #include <maplab-common/eigen-proto.h>
 #include <maplab-common/file-system-tools.h>
@@ -15,10 +17,23 @@
 #include <maplab-common/multi-threaded-progress-bar.h>
 #include <maplab-common/parallel-process.h>
 #include <maplab-common/proto-serialization-helper.h>
+#include <maplab-common/tracing.h>
 
+#include "vi-map/descriptor-pager.h"
+#include "vi-map/frame-sections.h"
+#include "vi-map/vi-map-summary.h"
 #include "vi-map/vi-map.h"
 #include "vi-map/vi_map.pb.h"
 
+DEFINE_bool(
+    vi_map_paged_descriptors, false,
+    "Only keep the visual frame descriptors of a loaded map partially in "
+    "memory and restore them from the map files on demand.");
+DEFINE_int32(
+    vi_map_paged_descriptors_budget_mb, 1024,
+    "Memory budget in MB for the resident descriptors of a map loaded with "
+    "--vi_map_paged_descriptors.");
+
 namespace vi_map {
 namespace serialization {
 
@@ -37,16 +52,27 @@ size_t serializeVertices(
   map.getAllVertexIds(&vertex_ids);
   const size_t end_index =
       std::min(vertex_ids.size(), start_index + vertices_per_proto);
-  size_t counter = start_index;
-  proto->mutable_vertex_ids()->Reserve(end_index - counter);
-  proto->mutable_vertices()->Reserve(end_index - counter);
-  for (; counter < end_index; ++counter) {
-    const pose_graph::VertexId& id = vertex_ids[counter];
+  if (start_index >= end_index) {
+    return start_index;
+  }
+  serializeVertices(
+      map,
+      pose_graph::VertexIdList(
+          vertex_ids.begin() + start_index, vertex_ids.begin() + end_index),
+      proto);
+  return end_index;
+}
+
+void serializeVertices(
+    const vi_map::VIMap& map, const pose_graph::VertexIdList& vertex_ids,
+    vi_map::proto::VIMap* proto) {
+  CHECK_NOTNULL(proto);
+  proto->mutable_vertex_ids()->Reserve(vertex_ids.size());
+  proto->mutable_vertices()->Reserve(vertex_ids.size());
+  for (const pose_graph::VertexId& id : vertex_ids) {
     id.serialize(proto->add_vertex_ids());
     map.getVertex(id).serialize(proto->add_vertices());
   }
-
-  return counter;
 }
 
 void serializeEdges(const vi_map::VIMap& map, vi_map::proto::VIMap* proto) {
@@ -117,14 +143,36 @@ void serializeOptionalSensorData(const VIMap& map, proto::VIMap* proto) {
   }
 }
 
-void deserializeVertices(
-    const vi_map::proto::VIMap& proto, vi_map::VIMap* map) {
+namespace {
+
+// The map elements decoded from a single map proto. Decoding only reads the
+// missions and sensors of the map, so multiple protos can be decoded
+// concurrently without any locking, as long as nothing modifies the map. The
+// elements are inserted into the map afterwards by mergeDecodedProtos.
+struct DecodedProto {
+  DecodedProto() : vertex_file_index(-1), has_legacy_landmark_ids(false) {}
+
+  std::vector<vi_map::Vertex::UniquePtr> vertices;
+  int vertex_file_index;
+  std::vector<vi_map::Edge::UniquePtr> edges;
+  std::vector<std::pair<LandmarkId, pose_graph::VertexId>> landmark_index;
+  bool has_legacy_landmark_ids;
+};
+
+void decodeVertices(
+    const vi_map::proto::VIMap& proto, int vertex_file_index,
+    const std::string& proto_file_name, vi_map::VIMap* map,
+    DescriptorPager* descriptor_pager, DecodedProto* decoded_proto) {
   CHECK_NOTNULL(map);
+  CHECK_NOTNULL(decoded_proto);
   CHECK_EQ(proto.vertex_ids_size(), proto.vertices_size());
+  decoded_proto->vertex_file_index = vertex_file_index;
+  decoded_proto->vertices.reserve(
+      decoded_proto->vertices.size() + proto.vertex_ids_size());
   for (int i = 0; i < proto.vertex_ids_size(); ++i) {
     pose_graph::VertexId id;
     id.deserialize(proto.vertex_ids(i));
-    vi_map::Vertex* vertex(new vi_map::Vertex);
+    vi_map::Vertex::UniquePtr vertex = aligned_unique<vi_map::Vertex>();
     vertex->deserialize(id, proto.vertices(i));
 
     const vi_map::MissionId& mission_id = vertex->getMissionId();
@@ -133,21 +181,143 @@ void deserializeVertices(
         map->getSensorManager().getNCameraSharedForMission(mission_id);
     CHECK(ncamera);
     vertex->setNCameras(ncamera);
-
-    map->addVertex(vi_map::Vertex::UniquePtr(vertex));
+    if (descriptor_pager != nullptr) {
+      descriptor_pager->addPagedOutVertex(proto_file_name, i, vertex.get());
+    }
+    decoded_proto->vertices.emplace_back(std::move(vertex));
   }
 }
 
-void deserializeEdges(const vi_map::proto::VIMap& proto, vi_map::VIMap* map) {
-  CHECK_NOTNULL(map);
+void decodeEdges(
+    const vi_map::proto::VIMap& proto, DecodedProto* decoded_proto) {
+  CHECK_NOTNULL(decoded_proto);
   CHECK_EQ(proto.edge_ids_size(), proto.edges_size());
+  decoded_proto->edges.reserve(
+      decoded_proto->edges.size() + proto.edge_ids_size());
   for (int i = 0; i < proto.edge_ids_size(); ++i) {
     pose_graph::EdgeId id;
     id.deserialize(proto.edge_ids(i));
-    map->addEdge(vi_map::Edge::deserialize(id, proto.edges(i)));
+    decoded_proto->edges.emplace_back(
+        vi_map::Edge::deserialize(id, proto.edges(i)));
+  }
+}
+
+void decodeLandmarkIndex(
+    const vi_map::proto::VIMap& proto, DecodedProto* decoded_proto) {
+  CHECK_NOTNULL(decoded_proto);
+  decoded_proto->landmark_index.reserve(
+      decoded_proto->landmark_index.size() + proto.landmark_index_size());
+  for (int i = 0; i < proto.landmark_index_size(); ++i) {
+    LandmarkId landmark_id;
+    landmark_id.deserialize(proto.landmark_index(i).landmark_id());
+    pose_graph::VertexId storing_vertex_id;
+    storing_vertex_id.deserialize(proto.landmark_index(i).vertex_id());
+    decoded_proto->landmark_index.emplace_back(landmark_id, storing_vertex_id);
+  }
+
+  if (proto.landmark_index_ids_size() > 0) {
+    CHECK_EQ(proto.landmark_index_size(), proto.landmark_index_ids_size());
+    decoded_proto->has_legacy_landmark_ids = true;
   }
 }
 
+void cleanUpLegacyLandmarkIds(vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  LOG(WARNING) << "Legacy map with store/global landmark ids found. "
+               << "Cleaning up the ids.";
+  // Go over all the landmarks and change the ids in the visualframes
+  // to the actual landmark id (instead of the old global landmark id).
+  vi_map::LandmarkIdList landmark_ids;
+  map->getAllLandmarkIds(&landmark_ids);
+  for (const vi_map::LandmarkId& actual_landmark_id : landmark_ids) {
+    const vi_map::Landmark& landmark = map->getLandmark(actual_landmark_id);
+    landmark.forEachObservation(
+        [&](const vi_map::KeypointIdentifier& keypoint_id) {
+          vi_map::Vertex& vertex =
+              map->getVertex(keypoint_id.frame_id.vertex_id);
+          vertex.setObservedLandmarkId(keypoint_id, actual_landmark_id);
+        });
+  }
+}
+
+// Inserts all decoded elements into the map, whose indices are reserved for
+// all of them at once. The vertices are inserted first, as the edges and
+// landmarks refer to them.
+void mergeDecodedProtos(
+    std::vector<DecodedProto>* decoded_protos, vi_map::VIMap* map) {
+  CHECK_NOTNULL(decoded_protos);
+  CHECK_NOTNULL(map);
+
+  size_t num_vertices = 0u;
+  size_t num_edges = 0u;
+  size_t num_landmarks = 0u;
+  for (const DecodedProto& decoded_proto : *decoded_protos) {
+    num_vertices += decoded_proto.vertices.size();
+    num_edges += decoded_proto.edges.size();
+    num_landmarks += decoded_proto.landmark_index.size();
+  }
+  map->reserveAdditional(num_vertices, num_edges, num_landmarks);
+
+  for (DecodedProto& decoded_proto : *decoded_protos) {
+    for (vi_map::Vertex::UniquePtr& vertex : decoded_proto.vertices) {
+      vi_map::Vertex* vertex_ptr = vertex.get();
+      map->addVertex(std::move(vertex));
+      vertex_ptr->setVertexFileIndex(decoded_proto.vertex_file_index);
+    }
+    decoded_proto.vertices.clear();
+  }
+
+  bool has_legacy_landmark_ids = false;
+  for (DecodedProto& decoded_proto : *decoded_protos) {
+    for (vi_map::Edge::UniquePtr& edge : decoded_proto.edges) {
+      map->addEdge(std::move(edge));
+    }
+    decoded_proto.edges.clear();
+
+    for (const std::pair<LandmarkId, pose_graph::VertexId>& value :
+         decoded_proto.landmark_index) {
+      if (map->hasLandmark(value.first)) {
+        CHECK_EQ(value.second, map->getLandmarkStoreVertexId(value.first));
+      } else {
+        map->addLandmarkIndexReference(value.first, value.second);
+      }
+    }
+    decoded_proto.landmark_index.clear();
+    has_legacy_landmark_ids |= decoded_proto.has_legacy_landmark_ids;
+  }
+
+  if (has_legacy_landmark_ids) {
+    cleanUpLegacyLandmarkIds(map);
+  }
+}
+
+}  // namespace
+
+void deserializeVertices(
+    const vi_map::proto::VIMap& proto, vi_map::VIMap* map) {
+  constexpr int kNoVertexFile = -1;
+  deserializeVertices(proto, kNoVertexFile, "", nullptr, map);
+}
+
+void deserializeVertices(
+    const vi_map::proto::VIMap& proto, int vertex_file_index,
+    const std::string& proto_file_name, DescriptorPager* descriptor_pager,
+    vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  std::vector<DecodedProto> decoded_protos(1u);
+  decodeVertices(
+      proto, vertex_file_index, proto_file_name, map, descriptor_pager,
+      &decoded_protos.front());
+  mergeDecodedProtos(&decoded_protos, map);
+}
+
+void deserializeEdges(const vi_map::proto::VIMap& proto, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  std::vector<DecodedProto> decoded_protos(1u);
+  decodeEdges(proto, &decoded_protos.front());
+  mergeDecodedProtos(&decoded_protos, map);
+}
+
 void deserializeMissionsAndBaseframes(
     const vi_map::proto::VIMap& proto, vi_map::VIMap* map) {
   CHECK_NOTNULL(map);
@@ -193,38 +363,9 @@ void deserializeMissionsAndBaseframes(
 void deserializeLandmarkIndex(
     const vi_map::proto::VIMap& proto, vi_map::VIMap* map) {
   CHECK_NOTNULL(map);
-  for (int i = 0; i < proto.landmark_index_size(); ++i) {
-    LandmarkId landmark_id;
-    landmark_id.deserialize(proto.landmark_index(i).landmark_id());
-    pose_graph::VertexId storing_vertex_id;
-    storing_vertex_id.deserialize(proto.landmark_index(i).vertex_id());
-
-    if (map->hasLandmark(landmark_id)) {
-      CHECK_EQ(storing_vertex_id, map->getLandmarkStoreVertexId(landmark_id));
-    } else {
-      map->addLandmarkIndexReference(landmark_id, storing_vertex_id);
-    }
-  }
-
-  if (proto.landmark_index_ids_size() > 0) {
-    LOG(WARNING) << "Legacy map with store/global landmark ids found. "
-                 << "Cleaning up the ids.";
-    CHECK_EQ(proto.landmark_index_size(), proto.landmark_index_ids_size());
-
-    // Go over all the landmarks and change the ids in the visualframes
-    // to the actual landmark id (instead of the old global landmark id).
-    vi_map::LandmarkIdList landmark_ids;
-    map->getAllLandmarkIds(&landmark_ids);
-    for (const vi_map::LandmarkId& actual_landmark_id : landmark_ids) {
-      const vi_map::Landmark& landmark = map->getLandmark(actual_landmark_id);
-      landmark.forEachObservation(
-          [&](const vi_map::KeypointIdentifier& keypoint_id) {
-            vi_map::Vertex& vertex =
-                map->getVertex(keypoint_id.frame_id.vertex_id);
-            vertex.setObservedLandmarkId(keypoint_id, actual_landmark_id);
-          });
-    }
-  }
+  std::vector<DecodedProto> decoded_protos(1u);
+  decodeLandmarkIndex(proto, &decoded_protos.front());
+  mergeDecodedProtos(&decoded_protos, map);
 }
 
 void deserializeOptionalSensorData(const proto::VIMap& proto, VIMap* map) {
@@ -242,6 +383,25 @@ void deserializeOptionalSensorData(const proto::VIMap& proto, VIMap* map) {
 
 namespace internal {
 
+int getCompressionLevel(
+    const backend::SaveConfig::ProtoCompression proto_compression) {
+  switch (proto_compression) {
+    case backend::SaveConfig::ProtoCompression::kFromFlags:
+      return common::proto_serialization_helper::
+          getCompressionLevelFromFlags();
+    case backend::SaveConfig::ProtoCompression::kNone:
+      return common::proto_serialization_helper::kNoCompression;
+    case backend::SaveConfig::ProtoCompression::kFast:
+      return common::proto_serialization_helper::kFastestCompression;
+    case backend::SaveConfig::ProtoCompression::kBest:
+      return common::proto_serialization_helper::kBestCompression;
+    default:
+      LOG(FATAL) << "Unknown proto compression "
+                 << static_cast<int>(proto_compression) << ".";
+  }
+  return common::proto_serialization_helper::kDefaultCompression;
+}
+
 size_t numberOfProtos(
     const VIMap& map, const backend::SaveConfig& save_config) {
   const size_t num_vertices = map.numVertices();
@@ -251,6 +411,78 @@ size_t numberOfProtos(
   return internal::kMinNumProtos + num_vertices_protos;
 }
 
+void planFullSerialization(
+    const VIMap& map, const backend::SaveConfig& save_config,
+    SerializationPlan* plan) {
+  CHECK_NOTNULL(plan);
+  CHECK_GT(save_config.vertices_per_proto_file, 0u);
+  plan->vertex_ids_per_file.clear();
+  pose_graph::VertexIdList vertex_ids;
+  map.getAllVertexIds(&vertex_ids);
+  for (size_t start_index = 0u; start_index < vertex_ids.size();
+       start_index += save_config.vertices_per_proto_file) {
+    const size_t end_index = std::min(
+        vertex_ids.size(), start_index + save_config.vertices_per_proto_file);
+    plan->vertex_ids_per_file.emplace_back(
+        vertex_ids.begin() + start_index, vertex_ids.begin() + end_index);
+  }
+
+  const size_t num_protos = plan->numProtos();
+  CHECK_EQ(num_protos, numberOfProtos(map, save_config));
+  plan->proto_indices.resize(num_protos);
+  for (size_t proto_idx = 0u; proto_idx < num_protos; ++proto_idx) {
+    plan->proto_indices[proto_idx] = proto_idx;
+  }
+}
+
+void planIncrementalSerialization(
+    const VIMap& map, const backend::SaveConfig& save_config,
+    SerializationPlan* plan) {
+  CHECK_NOTNULL(plan);
+  CHECK_GT(save_config.vertices_per_proto_file, 0u);
+  const MapChangeTracker& change_tracker = map.getChangeTracker();
+  CHECK(change_tracker.isTracking());
+
+  // Keep every vertex in the file it has been loaded from or saved to. This
+  // pass over the vertex ids is cheap compared to serializing the vertices.
+  const size_t num_tracked_vertex_files =
+      change_tracker.getNumVertexProtoFiles();
+  plan->vertex_ids_per_file.clear();
+  plan->vertex_ids_per_file.resize(num_tracked_vertex_files);
+  pose_graph::VertexIdList vertex_ids;
+  map.getAllVertexIds(&vertex_ids);
+  pose_graph::VertexIdList new_vertex_ids;
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    const int vertex_file_index = map.getVertex(vertex_id).getVertexFileIndex();
+    if (vertex_file_index >= 0 &&
+        static_cast<size_t>(vertex_file_index) < num_tracked_vertex_files) {
+      plan->vertex_ids_per_file[vertex_file_index].push_back(vertex_id);
+    } else {
+      new_vertex_ids.push_back(vertex_id);
+    }
+  }
+  for (size_t start_index = 0u; start_index < new_vertex_ids.size();
+       start_index += save_config.vertices_per_proto_file) {
+    const size_t end_index = std::min(
+        new_vertex_ids.size(),
+        start_index + save_config.vertices_per_proto_file);
+    plan->vertex_ids_per_file.emplace_back(
+        new_vertex_ids.begin() + start_index,
+        new_vertex_ids.begin() + end_index);
+  }
+
+  // Files that lost all their vertices are still written, as the vertex files
+  // need to be numbered consecutively.
+  plan->proto_indices.clear();
+  const size_t num_protos = plan->numProtos();
+  for (size_t proto_idx = 0u; proto_idx < num_protos; ++proto_idx) {
+    if (proto_idx >= change_tracker.getNumProtoFiles() ||
+        change_tracker.isProtoFileChanged(proto_idx)) {
+      plan->proto_indices.push_back(proto_idx);
+    }
+  }
+}
+
 }  // namespace internal
 
 void serializeToListOfProtos(
@@ -275,8 +507,23 @@ size_t serializeToFunction(
     const vi_map::VIMap& map, const backend::SaveConfig& save_config,
     const std::function<bool(const size_t, const proto::VIMap&)>&  // NOLINT
     function) {
+  internal::SerializationPlan plan;
+  internal::planFullSerialization(map, save_config, &plan);
   CHECK(function);
-  const size_t num_protos = internal::numberOfProtos(map, save_config);
+  serializeToFunction(
+      map, plan,
+      [&function](const size_t task_idx, proto::VIMap* proto) -> bool {
+        return function(task_idx, *proto);
+      });
+  return plan.numProtos();
+}
+
+void serializeToFunction(
+    const vi_map::VIMap& map, const internal::SerializationPlan& plan,
+    const std::function<bool(const size_t, proto::VIMap*)>&  // NOLINT
+    function) {
+  CHECK(function);
+  const size_t num_protos = plan.numProtos();
 
   common::MultiThreadedProgressBar progress_bar;
   std::function<void(const std::vector<size_t>)> serialize_function =
@@ -284,7 +531,10 @@ size_t serializeToFunction(
         size_t num_processed_tasks = 0u;
         progress_bar.setNumElements(2u * range.size());
         proto::VIMap proto;
-        for (size_t task_idx : range) {
+        for (size_t plan_idx : range) {
+          CHECK_LT(plan_idx, plan.proto_indices.size());
+          const size_t task_idx = plan.proto_indices[plan_idx];
+          CHECK_LT(task_idx, num_protos);
           proto.Clear();
           switch (task_idx) {
             case internal::kProtoListMissionsIndex:
@@ -302,15 +552,16 @@ size_t serializeToFunction(
             default: {
               // Case vertices.
               serializeVertices(
-                  map, (task_idx - internal::kProtoListVerticesStartIndex) *
-                           save_config.vertices_per_proto_file,
-                  save_config.vertices_per_proto_file, &proto);
+                  map,
+                  plan.vertex_ids_per_file
+                      [task_idx - internal::kProtoListVerticesStartIndex],
+                  &proto);
               break;
             }
           }
           progress_bar.update(++num_processed_tasks);
 
-          CHECK(function(task_idx, proto));
+          CHECK(function(task_idx, &proto));
           progress_bar.update(++num_processed_tasks);
         }
       };
@@ -320,8 +571,8 @@ size_t serializeToFunction(
   const size_t num_threads =
       std::min(common::getNumHardwareThreads(), kMaxNumberOfThreads);
   common::ParallelProcess(
-      num_protos, serialize_function, kAlwaysParallelize, num_threads);
-  return num_protos;
+      plan.proto_indices.size(), serialize_function, kAlwaysParallelize,
+      num_threads);
 }
 
 void deserializeFromListOfProtos(
@@ -333,17 +584,44 @@ void deserializeFromListOfProtos(
   deserializeMissionsAndBaseframes(
       list_of_protos[internal::kProtoListMissionsIndex], map);
 
-  // Deserialize vertices first after missions. This is because other fields
-  // might depend on edges and can't be inserted into the map without the
-  // corresponding vertices being present.
-  for (size_t vertices_index = internal::kProtoListVerticesStartIndex;
-       vertices_index < list_of_protos.size(); ++vertices_index) {
-    deserializeVertices(list_of_protos[vertices_index], map);
-  }
+  // Decode the vertices, edges and landmark index in parallel, then insert
+  // them into the map at once. The vertices are inserted first, as the other
+  // elements can't be inserted into the map without the corresponding
+  // vertices being present.
+  const size_t num_protos = list_of_protos.size();
+  std::vector<DecodedProto> decoded_protos(num_protos);
+  std::function<void(const std::vector<size_t>&)> decode_function =
+      [&list_of_protos, &decoded_protos,
+       map](const std::vector<size_t>& range) {
+        for (const size_t proto_idx : range) {
+          const vi_map::proto::VIMap& proto = list_of_protos[proto_idx];
+          DecodedProto* decoded_proto = &decoded_protos[proto_idx];
+          switch (proto_idx) {
+            case internal::kProtoListEdgesIndex:
+              decodeEdges(proto, decoded_proto);
+              break;
+            case internal::kProtoListLandmarkIndexIndex:
+              decodeLandmarkIndex(proto, decoded_proto);
+              break;
+            case internal::kProtoListOptionalSensorData:
+              // Deserialized after the vertices have been inserted.
+              break;
+            default: {
+              CHECK_GE(proto_idx, internal::kProtoListVerticesStartIndex);
+              constexpr int kNoVertexFile = -1;
+              decodeVertices(
+                  proto, kNoVertexFile, "", map, nullptr, decoded_proto);
+            } break;
+          }
+        }
+      };
+  constexpr bool kAlwaysParallelize = false;
+  const size_t num_threads = common::getNumHardwareThreads();
+  common::ParallelProcess(
+      internal::kProtoListEdgesIndex, num_protos, decode_function,
+      kAlwaysParallelize, num_threads);
+  mergeDecodedProtos(&decoded_protos, map);
 
-  deserializeEdges(list_of_protos[internal::kProtoListEdgesIndex], map);
-  deserializeLandmarkIndex(
-      list_of_protos[internal::kProtoListLandmarkIndexIndex], map);
   deserializeOptionalSensorData(
       list_of_protos[internal::kProtoListOptionalSensorData], map);
 }
@@ -461,6 +739,7 @@ std::string getFileNameFromIndex(const size_t index) {
 }
 
 bool loadMapFromFolder(const std::string& folder_path, vi_map::VIMap* map) {
+  MAPLAB_TRACE_SCOPE("serialization", "load map");
   CHECK_NOTNULL(map);
   std::string sensors_yaml_filepath;
   std::vector<std::string> list_of_resource_filepaths;
@@ -495,20 +774,41 @@ bool loadMapFromFolder(const std::string& folder_path, vi_map::VIMap* map) {
   common::concatenateFolderAndFileName(
       folder_path, internal::kFolderName, &path_to_map_file);
 
-  std::mutex map_mutex;
+  // The vertices, edges and landmarks of every proto are decoded into their
+  // own slot without locking and merged into the map at once afterwards.
+  std::vector<DecodedProto> decoded_protos(number_of_protos);
+
+  DescriptorPager::UniquePtr descriptor_pager;
+  if (FLAGS_vi_map_paged_descriptors) {
+    CHECK_GT(FLAGS_vi_map_paged_descriptors_budget_mb, 0);
+    constexpr size_t kBytesPerMegabyte = 1024u * 1024u;
+    descriptor_pager = aligned_unique<DescriptorPager>(
+        path_to_map_file,
+        static_cast<size_t>(FLAGS_vi_map_paged_descriptors_budget_mb) *
+            kBytesPerMegabyte);
+  }
 
   std::function<void(const std::vector<size_t>)> load_function =
       [&map, list_of_map_proto_filepaths, path_to_map_file, &progress_bar,
-       &map_mutex](const std::vector<size_t> range) {
+       &decoded_protos, &descriptor_pager](const std::vector<size_t> range) {
         progress_bar.setNumElements(range.size());
         size_t num_processed_tasks = 0u;
 
+        // The parsed protos consist of millions of small messages and
+        // strings. Allocating them on an arena turns this into a few large
+        // blocks, which are released at once after each file.
+        google::protobuf::ArenaOptions arena_options;
+        arena_options.start_block_size = internal::kProtoArenaStartBlockSize;
+        arena_options.max_block_size = internal::kProtoArenaMaxBlockSize;
+        google::protobuf::Arena arena(arena_options);
+
         for (const size_t& task_idx : range) {
           CHECK_LT(task_idx, list_of_map_proto_filepaths.size());
           const std::string file_name =
               list_of_map_proto_filepaths[task_idx].substr(
                   std::strlen(internal::kFolderName) + 1u);
-          proto::VIMap proto;
+          proto::VIMap& proto =
+              *google::protobuf::Arena::CreateMessage<proto::VIMap>(&arena);
 
           // If the map was saved in an old map format, the file may not
           // exist. This is ok to do here since we already check for all
@@ -524,66 +824,99 @@ bool loadMapFromFolder(const std::string& folder_path, vi_map::VIMap* map) {
                     path_to_map_file, file_name, &proto));
 
             switch (task_idx) {
-              case internal::kProtoListMissionsIndex: {
-                std::lock_guard<std::mutex> guard(map_mutex);
+              case internal::kProtoListMissionsIndex:
                 deserializeMissionsAndBaseframes(proto, map);
-              } break;
-              case internal::kProtoListEdgesIndex: {
-                std::lock_guard<std::mutex> guard(map_mutex);
-                deserializeEdges(proto, map);
-              } break;
-              case internal::kProtoListLandmarkIndexIndex: {
-                std::lock_guard<std::mutex> guard(map_mutex);
-                deserializeLandmarkIndex(proto, map);
-              } break;
-              case internal::kProtoListOptionalSensorData: {
-                std::lock_guard<std::mutex> guard(map_mutex);
+                break;
+              case internal::kProtoListEdgesIndex:
+                decodeEdges(proto, &decoded_protos[task_idx]);
+                break;
+              case internal::kProtoListLandmarkIndexIndex:
+                decodeLandmarkIndex(proto, &decoded_protos[task_idx]);
+                break;
+              case internal::kProtoListOptionalSensorData:
                 deserializeOptionalSensorData(proto, map);
-              } break;
+                break;
               default: {
                 CHECK_GE(task_idx, internal::kProtoListVerticesStartIndex);
-                std::lock_guard<std::mutex> guard(map_mutex);
-                deserializeVertices(proto, map);
+                const std::string sections_file_path =
+                    complete_path_to_file + kFrameSectionsFileSuffix;
+                const bool has_frame_sections =
+                    common::fileExists(sections_file_path);
+                // The descriptors in the frame sections are not paged.
+                DecodedProto& decoded_proto = decoded_protos[task_idx];
+                decodeVertices(
+                    proto,
+                    static_cast<int>(
+                        task_idx - internal::kProtoListVerticesStartIndex),
+                    file_name, map,
+                    has_frame_sections ? nullptr : descriptor_pager.get(),
+                    &decoded_proto);
+                if (has_frame_sections) {
+                  std::vector<Vertex*> vertices;
+                  vertices.reserve(decoded_proto.vertices.size());
+                  for (const Vertex::UniquePtr& vertex :
+                       decoded_proto.vertices) {
+                    vertices.push_back(vertex.get());
+                  }
+                  CHECK(
+                      loadFrameArraysFromSectionsFile(
+                          sections_file_path, vertices));
+                }
               } break;
             }
           } else {
             LOG(FATAL) << "Trying to read a proto file that does not exist!: "
                        << file_name;
           }
+          arena.Reset();
           progress_bar.update(++num_processed_tasks);
         }
       };
 
+  // The missions and baseframes are inserted first, decoding the vertices
+  // requires them.
   VLOG(1) << "Reading missions...";
   load_function({internal::kProtoListMissionsIndex});
 
-  // Deserialize vertices first after missions. This is because other fields
-  // might depend on edges and can't be inserted into the map without the
-  // corresponding vertices being present.
-  constexpr bool kAlwaysParallelize = true;
-  constexpr size_t kMaxNumberOfThreads = 8;
-  const size_t num_threads =
-      std::min(common::getNumHardwareThreads(), kMaxNumberOfThreads);
-
-  const size_t end_index = number_of_protos;
-  const size_t start_index = internal::kProtoListVerticesStartIndex;
-  if (end_index > start_index) {
-    VLOG(1) << "Reading vertices...";
-    common::ParallelProcess(
-        start_index, end_index, load_function, kAlwaysParallelize, num_threads);
-  } else {
-    VLOG(1) << "No vertex data found.";
+  // Decoding only reads the missions and sensors of the map, hence all
+  // vertex, edge and landmark index protos are decoded in parallel.
+  std::vector<size_t> decoding_tasks = {
+      internal::kProtoListEdgesIndex, internal::kProtoListLandmarkIndexIndex};
+  for (size_t task_idx = internal::kProtoListVerticesStartIndex;
+       task_idx < number_of_protos; ++task_idx) {
+    decoding_tasks.push_back(task_idx);
   }
+  std::function<void(const std::vector<size_t>&)> decode_function =
+      [&load_function, &decoding_tasks](const std::vector<size_t>& range) {
+        std::vector<size_t> tasks;
+        tasks.reserve(range.size());
+        for (const size_t decoding_task_idx : range) {
+          tasks.push_back(decoding_tasks[decoding_task_idx]);
+        }
+        load_function(tasks);
+      };
+  constexpr bool kAlwaysParallelize = true;
+  const size_t num_threads = common::getNumHardwareThreads();
+  VLOG(1) << "Reading vertices, edges and landmarks...";
+  common::ParallelProcess(
+      decoding_tasks.size(), decode_function, kAlwaysParallelize, num_threads);
 
-  VLOG(1) << "Reading edges...";
-  load_function({internal::kProtoListEdgesIndex});
-
-  VLOG(1) << "Reading landmarks...";
-  load_function({internal::kProtoListLandmarkIndexIndex});
+  VLOG(1) << "Inserting vertices, edges and landmarks...";
+  mergeDecodedProtos(&decoded_protos, map);
+  decoded_protos.clear();
 
   VLOG(1) << "Reading optional sensor data...";
   load_function({internal::kProtoListOptionalSensorData});
 
+  // The map now matches the files in the folder.
+  map->startChangeTracking(path_to_map_file, number_of_protos);
+
+  if (descriptor_pager) {
+    LOG(INFO) << "Paged out the descriptors of "
+              << descriptor_pager->getNumPagedOutVertices() << " vertices.";
+    map->setDescriptorPager(std::move(descriptor_pager));
+  }
+
   CHECK(
       backend::resource_map_serialization::loadMapFromFolder(folder_path, map));
 
@@ -594,6 +927,7 @@ bool loadMapFromFolder(const std::string& folder_path, vi_map::VIMap* map) {
 bool saveMapToFolder(
     const std::string& folder_path, const backend::SaveConfig& config,
     vi_map::VIMap* map) {
+  MAPLAB_TRACE_SCOPE("serialization", "save map");
   std::string complete_folder_path;
   common::concatenateFolderAndFileName(
       folder_path, getSubFolderName(), &complete_folder_path);
@@ -611,6 +945,13 @@ bool saveMapToFolder(
     return false;
   }
 
+  if (map->hasDescriptorPager()) {
+    // The paged out descriptors are read from the files that are about to be
+    // overwritten.
+    LOG(WARNING) << "Loading all paged out descriptors before saving the map.";
+    map->loadAllPagedOutDescriptors();
+  }
+
   map->setMapFolder(folder_path);
 
   // Serialize the sensors.
@@ -620,15 +961,63 @@ bool saveMapToFolder(
       &sensors_yaml_filepath);
   map->getSensorManager().serializeToFile(sensors_yaml_filepath);
 
-  const size_t num_files = serializeToFunction(
-      *map, config,
-      [&complete_folder_path](
-          const size_t task_idx, const proto::VIMap& proto) -> bool {
+  internal::SerializationPlan plan;
+  const bool save_incrementally =
+      config.save_only_changes &&
+      map->canSaveIncrementallyTo(complete_folder_path);
+  if (save_incrementally) {
+    internal::planIncrementalSerialization(*map, config, &plan);
+    VLOG(1) << "Saving " << plan.proto_indices.size() << " of "
+            << plan.numProtos() << " map protos that changed.";
+  } else {
+    internal::planFullSerialization(*map, config, &plan);
+  }
+  const int compression_level =
+      internal::getCompressionLevel(config.proto_compression);
+  const bool store_frame_arrays_in_sections =
+      config.store_frame_arrays_in_sections;
+  serializeToFunction(
+      *map, plan,
+      [&complete_folder_path, compression_level,
+       store_frame_arrays_in_sections](
+          const size_t task_idx, proto::VIMap* proto) -> bool {
+        CHECK_NOTNULL(proto);
         const std::string file_name = getFileNameFromIndex(task_idx);
         CHECK(!file_name.empty());
-        return common::proto_serialization_helper::serializeProtoToFile(
-            complete_folder_path, file_name, proto);
+        if (task_idx >= internal::kProtoListVerticesStartIndex) {
+          const std::string sections_file_path =
+              common::concatenateFolderAndFileName(
+                  complete_folder_path, file_name) +
+              kFrameSectionsFileSuffix;
+          if (store_frame_arrays_in_sections) {
+            if (!moveFrameArraysToSectionsFile(sections_file_path, proto)) {
+              return false;
+            }
+          } else if (
+              common::fileExists(sections_file_path) &&
+              !common::deleteFile(sections_file_path)) {
+            LOG(ERROR) << "Could not remove \"" << sections_file_path << "\".";
+            return false;
+          }
+        }
+        return common::proto_serialization_helper::
+            serializeProtoToFileWithCompression(
+                complete_folder_path, file_name, *proto, compression_level);
       });
+  const size_t num_files = plan.numProtos();
+
+  // Record the files of the vertices. After an incremental save, only the
+  // vertices in the newly added files have moved.
+  const size_t first_reassigned_vertex_file =
+      save_incrementally ? map->getChangeTracker().getNumVertexProtoFiles()
+                         : 0u;
+  for (size_t vertex_file_idx = first_reassigned_vertex_file;
+       vertex_file_idx < plan.vertex_ids_per_file.size(); ++vertex_file_idx) {
+    map->setVertexFileIndex(
+        plan.vertex_ids_per_file[vertex_file_idx],
+        static_cast<int>(vertex_file_idx));
+  }
+  map->startChangeTracking(complete_folder_path, num_files);
 
   // Delete leftover vertex files from previous maps.
   size_t vertex_file_index_to_delete = num_files - internal::kMinNumProtos;
@@ -638,7 +1027,13 @@ bool saveMapToFolder(
       complete_folder_path, vertex_file_to_delete);
   while (common::fileExists(path_to_vertex_file)) {
     CHECK(common::deleteFile(path_to_vertex_file));
+    const std::string path_to_sections_file =
+        path_to_vertex_file + kFrameSectionsFileSuffix;
+    if (common::fileExists(path_to_sections_file)) {
+      CHECK(common::deleteFile(path_to_sections_file));
+    }
 
+    ++vertex_file_index_to_delete;
     vertex_file_to_delete = internal::kFileNameVertices +
                             std::to_string(vertex_file_index_to_delete);
     path_to_vertex_file = common::concatenateFolderAndFileName(
@@ -649,6 +1044,14 @@ bool saveMapToFolder(
   backend::resource_map_serialization::saveMapToFolder(
       folder_path, config, map);
 
+  // The summary is written last, as it counts the resources of the map.
+  proto::MapSummary summary;
+  computeMapSummary(*map, &summary);
+  if (!saveMapSummaryToFolder(folder_path, summary)) {
+    LOG(WARNING) << "Could not save the summary of the map in \""
+                 << folder_path << "\".";
+  }
+
   LOG(INFO) << "Saved map in \"" << folder_path << "\".";
   return true;
 }
@@ -0,0 +1,168 @@
+#include "vi-map/vi-map-summary.h"
+
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/time.h>
+#include <glog/logging.h>
+#include <map-resources/resource-common.h>
+#include <maplab-common/file-system-tools.h>
+#include <maplab-common/proto-serialization-helper.h>
+
+#include "vi-map/vi-map-serialization.h"
+#include "vi-map/vi-map.h"
+
+namespace vi_map {
+namespace serialization {
+
+namespace {
+void printVector(
+    const google::protobuf::RepeatedField<double>& values,
+    std::ostream* out) {
+  CHECK_NOTNULL(out);
+  *out << '[';
+  for (int idx = 0; idx < values.size(); ++idx) {
+    *out << (idx > 0 ? ", " : "") << values.Get(idx);
+  }
+  *out << ']';
+}
+}  // namespace
+
+void computeMapSummary(const VIMap& map, proto::MapSummary* summary) {
+  CHECK_NOTNULL(summary)->Clear();
+  summary->set_format_version(kMapSummaryFormatVersion);
+  summary->set_save_time_ns(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+
+  MissionIdList mission_ids;
+  map.getAllMissionIds(&mission_ids);
+  std::vector<MissionStatistics> statistics;
+  map.getStatisticsOfMissions(mission_ids, &statistics);
+  CHECK_EQ(mission_ids.size(), statistics.size());
+  for (size_t mission_idx = 0u; mission_idx < mission_ids.size();
+       ++mission_idx) {
+    const MissionStatistics& mission_statistics = statistics[mission_idx];
+    proto::MapSummary::Mission* mission_proto = summary->add_missions();
+    mission_ids[mission_idx].serialize(mission_proto->mutable_mission_id());
+    mission_proto->set_num_vertices(mission_statistics.num_vertices);
+    mission_proto->set_num_landmarks(mission_statistics.num_landmarks);
+    mission_proto->set_start_time_ns(mission_statistics.start_time_ns);
+    mission_proto->set_end_time_ns(mission_statistics.end_time_ns);
+    mission_proto->set_distance_travelled_m(
+        mission_statistics.distance_travelled_m);
+
+    pose_graph::VertexIdList vertex_ids;
+    map.getAllVertexIdsInMission(mission_ids[mission_idx], &vertex_ids);
+    if (vertex_ids.empty()) {
+      continue;
+    }
+    Eigen::Vector3d min_G = map.getVertex_G_p_I(vertex_ids.front());
+    Eigen::Vector3d max_G = min_G;
+    for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+      const Eigen::Vector3d p_G_I = map.getVertex_G_p_I(vertex_id);
+      min_G = min_G.cwiseMin(p_G_I);
+      max_G = max_G.cwiseMax(p_G_I);
+    }
+    for (int dim = 0; dim < 3; ++dim) {
+      mission_proto->add_bounding_box_min_G(min_G[dim]);
+      mission_proto->add_bounding_box_max_G(max_G[dim]);
+    }
+  }
+
+  summary->set_num_edges(map.numEdges());
+  for (size_t type_idx = 0u; type_idx < backend::kNumResourceTypes;
+       ++type_idx) {
+    const size_t num_resources =
+        map.numResourcesOfType(static_cast<backend::ResourceType>(type_idx));
+    if (num_resources > 0u) {
+      proto::MapSummary::ResourceCount* resource_count =
+          summary->add_resource_counts();
+      resource_count->set_type(type_idx);
+      resource_count->set_num_resources(num_resources);
+    }
+  }
+}
+
+bool saveMapSummaryToFolder(
+    const std::string& map_folder, const proto::MapSummary& summary) {
+  const std::string vi_map_folder =
+      common::concatenateFolderAndFileName(map_folder, getSubFolderName());
+  return common::proto_serialization_helper::serializeProtoToFile(
+      vi_map_folder, kFileNameSummary, summary);
+}
+
+bool loadMapSummaryFromFolder(
+    const std::string& map_folder, proto::MapSummary* summary) {
+  CHECK_NOTNULL(summary)->Clear();
+  const std::string vi_map_folder =
+      common::concatenateFolderAndFileName(map_folder, getSubFolderName());
+  if (!common::fileExists(
+          common::concatenateFolderAndFileName(
+              vi_map_folder, kFileNameSummary))) {
+    return false;
+  }
+  if (!common::proto_serialization_helper::parseProtoFromFile(
+          vi_map_folder, kFileNameSummary, summary)) {
+    LOG(WARNING) << "Could not read the summary of the map in \""
+                 << map_folder << "\".";
+    return false;
+  }
+  if (summary->format_version() > kMapSummaryFormatVersion) {
+    LOG(WARNING) << "The summary of the map in \"" << map_folder
+                 << "\" has the unknown format version "
+                 << summary->format_version() << '.';
+    return false;
+  }
+  return true;
+}
+
+std::string printMapSummary(const proto::MapSummary& summary) {
+  std::stringstream out;
+  out << std::fixed << std::setprecision(1);
+  uint64_t num_vertices = 0u;
+  uint64_t num_landmarks = 0u;
+  for (int mission_idx = 0; mission_idx < summary.missions_size();
+       ++mission_idx) {
+    const proto::MapSummary::Mission& mission = summary.missions(mission_idx);
+    MissionId mission_id;
+    mission_id.deserialize(mission.mission_id());
+    num_vertices += mission.num_vertices();
+    num_landmarks += mission.num_landmarks();
+
+    out << "Mission " << mission_idx << " (" << mission_id.shortHex()
+        << "): " << mission.num_vertices() << " vertices, "
+        << mission.num_landmarks() << " landmarks, "
+        << aslam::time::nanoSecondsToSeconds(
+               mission.end_time_ns() - mission.start_time_ns())
+        << " s, " << mission.distance_travelled_m() << " m";
+    if (mission.bounding_box_min_G_size() == 3 &&
+        mission.bounding_box_max_G_size() == 3) {
+      out << ", bounding box ";
+      printVector(mission.bounding_box_min_G(), &out);
+      out << " - ";
+      printVector(mission.bounding_box_max_G(), &out);
+    }
+    out << '\n';
+  }
+
+  out << "Total: " << summary.missions_size() << " missions, " << num_vertices
+      << " vertices, " << num_landmarks << " landmarks, "
+      << summary.num_edges() << " edges";
+  for (const proto::MapSummary::ResourceCount& resource_count :
+       summary.resource_counts()) {
+    if (resource_count.type() < backend::kNumResourceTypes) {
+      out << ", " << resource_count.num_resources() << ' '
+          << backend::ResourceTypeNames[resource_count.type()];
+    }
+  }
+  return out.str();
+}
+
+}  // namespace serialization
+}  // namespace vi_map
@@ -1,12 +1,21 @@
 #include "vi-map/vi-map.h"
 
+#include <algorithm>
+#include <functional>
 #include <limits>
+#include <mutex>
+#include <numeric>
 #include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <aslam/common/memory.h>
 #include <aslam/common/time.h>
 #include <map-resources/resource_metadata.pb.h>
 #include <maplab-common/file-system-tools.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 
 #include "vi-map/deprecated/vi-map-serialization-deprecated.h"
 #include "vi-map/semantics-manager.h"
@@ -41,8 +50,19 @@ void VIMap::deepCopy(const VIMap& other) {
   ResourceMap::deepCopyFrom(other);
 }
 
-void VIMap::mergeAllMissionsFromMapWithoutResources(
-    const vi_map::VIMap& other) {
+void VIMap::reserveAdditional(
+    size_t num_vertices, size_t num_edges, size_t num_landmarks) {
+  posegraph.reserve(
+      posegraph.numVertices() + num_vertices, posegraph.numEdges() + num_edges);
+  landmark_index.reserve(landmark_index.numLandmarks() + num_landmarks);
+}
+
+void VIMap::mergeMissionsAndSensorsFromMap(const vi_map::VIMap& other) {
+  // Copies of the descriptors can't be paged out again.
+  other.loadAllPagedOutDescriptors();
+  // The copied vertices refer to the vertex files of the other map, the next
+  // save hence needs to rewrite all files.
+  change_tracker_.stopTracking();
   const SensorManager& other_sensor_manager = other.getSensorManager();
 
   // Get all missions from old map and add them into the new map.
@@ -83,28 +103,17 @@ void VIMap::mergeAllMissionsFromMapWithoutResources(
     vi_map::Mission& copied_mission = getMission(other_mission_id);
     copied_mission.setRootVertexId(other_mission.getRootVertexId());
   }
+}
 
-  // Get all vertices and add them into the new map.
-  pose_graph::VertexIdList vertex_ids;
-  other.getAllVertexIds(&vertex_ids);
-
-  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
-    const vi_map::Vertex& original_vertex = other.getVertex(vertex_id);
-    vi_map::Vertex::UniquePtr copied_vertex =
-        aligned_unique<vi_map::Vertex>(original_vertex);
-    addVertex(std::move(copied_vertex));
-  }
-
-  // Add all edges into the new map.
-  pose_graph::EdgeIdList edge_ids;
-  other.getAllEdgeIds(&edge_ids);
+void VIMap::mergeAllMissionsFromMapWithoutResources(
+    const vi_map::VIMap& other) {
+  mergeMissionsAndSensorsFromMap(other);
 
-  for (const pose_graph::EdgeId& edge_id : edge_ids) {
-    const vi_map::Edge& original_edge = other.getEdgeAs<vi_map::Edge>(edge_id);
-    vi_map::Edge* copied_edge;
-    original_edge.copyEdgeInto(&copied_edge);
-    addEdge(vi_map::Edge::UniquePtr(copied_edge));
-  }
+  // Share all vertices and edges with the other map, a vertex or edge is only
+  // copied once either map modifies it. Their vertex file indices are only
+  // used while the change tracker is running, which has been stopped above.
+  reserveAdditional(0u, 0u, other.landmark_index.numLandmarks());
+  posegraph.addSharedVerticesAndEdgesOf(other.posegraph);
 
   // Add landmarks into copy of map.
   const LandmarkIndex& original_landmark_index = other.landmark_index;
@@ -138,6 +147,32 @@ void VIMap::mergeAllMissionsFromMap(const vi_map::VIMap& other) {
   ResourceMap::mergeFromMap(other);
 }
 
+void VIMap::mergeAllMissionsFromMap(vi_map::VIMap&& other) {
+  CHECK_NE(&other, this);
+  VLOG(1) << "Merging from VI-Map by moving its missions.";
+  // The missions and sensors are few, they are copied.
+  mergeMissionsAndSensorsFromMap(other);
+  posegraph.moveVerticesAndEdgesFrom(&other.posegraph);
+  landmark_index.mergeFrom(&other.landmark_index);
+  for (OptionalSensorDataMap::value_type& other_optional_sensor_data :
+       other.optional_sensor_data_map_) {
+    const MissionId& mission_id = other_optional_sensor_data.first;
+    CHECK(hasMission(mission_id));
+    CHECK(optional_sensor_data_map_
+              .emplace(
+                  std::piecewise_construct, std::forward_as_tuple(mission_id),
+                  std::forward_as_tuple(
+                      std::move(other_optional_sensor_data.second)))
+              .second);
+  }
+
+  VLOG(1) << "Copying metadata and resource infos.";
+  ResourceMap::mergeFromMap(other);
+
+  other.optional_sensor_data_map_.clear();
+  other.clear();
+}
+
 void VIMap::swap(VIMap* other) {
   CHECK_NOTNULL(other);
   posegraph.swap(&other->posegraph);
@@ -145,6 +180,90 @@ void VIMap::swap(VIMap* other) {
   mission_base_frames.swap(other->mission_base_frames);
   landmark_index.swap(&other->landmark_index);
   optional_sensor_data_map_.swap(other->optional_sensor_data_map_);
+  descriptor_pager_.swap(other->descriptor_pager_);
+  // The tracked folders belong to the map folders, which are not swapped.
+  change_tracker_.stopTracking();
+  other->change_tracker_.stopTracking();
+}
+
+bool VIMap::hasDescriptorPager() const {
+  return static_cast<bool>(descriptor_pager_);
+}
+
+void VIMap::setDescriptorPager(DescriptorPager::UniquePtr descriptor_pager) {
+  descriptor_pager_ = std::move(descriptor_pager);
+}
+
+void VIMap::ensureDescriptorsLoaded(
+    const pose_graph::VertexIdList& vertex_ids) const {
+  if (descriptor_pager_) {
+    descriptor_pager_->loadDescriptors(vertex_ids, const_cast<VIMap*>(this));
+  }
+}
+
+void VIMap::ensureDescriptorsLoadedForMission(
+    const MissionId& mission_id) const {
+  if (descriptor_pager_) {
+    pose_graph::VertexIdList vertex_ids;
+    getAllVertexIdsInMission(mission_id, &vertex_ids);
+    ensureDescriptorsLoaded(vertex_ids);
+  }
+}
+
+void VIMap::loadAllPagedOutDescriptors() const {
+  if (descriptor_pager_) {
+    descriptor_pager_->loadAllDescriptors(const_cast<VIMap*>(this));
+    descriptor_pager_.reset();
+  }
+}
+
+const MapChangeTracker& VIMap::getChangeTracker() const {
+  return change_tracker_;
+}
+
+void VIMap::startChangeTracking(
+    const std::string& proto_folder, size_t num_proto_files) {
+  if (selected_missions_.empty()) {
+    change_tracker_.startTracking(proto_folder, num_proto_files);
+  } else {
+    // The files only hold the selected missions.
+    change_tracker_.stopTracking();
+  }
+}
+
+void VIMap::stopChangeTracking() {
+  change_tracker_.stopTracking();
+}
+
+bool VIMap::canSaveIncrementallyTo(const std::string& proto_folder) const {
+  // Saving with a mission selection only writes the selected missions.
+  return selected_missions_.empty() &&
+         change_tracker_.isTrackingFolder(proto_folder);
+}
+
+void VIMap::setVertexFileIndex(
+    const pose_graph::VertexIdList& vertex_ids, int vertex_file_index) {
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    // Only access the vertex mutably if needed, this would copy it if it is
+    // shared with a copy of the map.
+    if (const_this->getVertex(vertex_id).getVertexFileIndex() !=
+        vertex_file_index) {
+      getVertexWithoutTrackingChanges(vertex_id).setVertexFileIndex(
+          vertex_file_index);
+    }
+  }
+}
+
+aslam::ReaderWriterMutex* VIMap::getMissionMutex(
+    const vi_map::MissionId& id) const {
+  CHECK(hasMission(id)) << "Mission " << id << " is not in the map.";
+  std::lock_guard<std::mutex> lock(mission_mutexes_mutex_);
+  std::unique_ptr<aslam::ReaderWriterMutex>& mission_mutex =
+      mission_mutexes_[id];
+  if (!mission_mutex) {
+    mission_mutex.reset(new aslam::ReaderWriterMutex);
+  }
+  return mission_mutex.get();
 }
 
 bool VIMap::hexStringToMissionIdIfValid(
@@ -322,85 +441,244 @@ void VIMap::getStatisticsOfMission(
     std::vector<size_t>* total_num_landmarks_per_camera, size_t* num_landmarks,
     size_t* num_vertices, size_t* num_observations, double* duration_s,
     int64_t* start_time_ns, int64_t* end_time_ns) const {
-  CHECK_NOTNULL(num_good_landmarks_per_camera)->clear();
-  CHECK_NOTNULL(num_bad_landmarks_per_camera)->clear();
-  CHECK_NOTNULL(num_unknown_landmarks_per_camera)->clear();
-  CHECK_NOTNULL(total_num_landmarks_per_camera)->clear();
+  CHECK_NOTNULL(num_good_landmarks_per_camera);
+  CHECK_NOTNULL(num_bad_landmarks_per_camera);
+  CHECK_NOTNULL(num_unknown_landmarks_per_camera);
+  CHECK_NOTNULL(total_num_landmarks_per_camera);
+  CHECK_NOTNULL(num_landmarks);
+  CHECK_NOTNULL(num_vertices);
   CHECK_NOTNULL(num_observations);
   CHECK_NOTNULL(duration_s);
   CHECK_NOTNULL(start_time_ns);
   CHECK_NOTNULL(end_time_ns);
-  CHECK(mission_id.isValid());
-  *num_observations = 0u;
-  *num_vertices = 0u;
-  *num_landmarks = 0u;
 
-  const aslam::NCameraId& ncamera_id =
-      sensor_manager_.getNCameraForMission(mission_id).getId();
-  CHECK(ncamera_id.isValid());
-  const aslam::NCamera& ncamera = sensor_manager_.getNCamera(ncamera_id);
-  const size_t num_cameras = ncamera.numCameras();
-  num_good_landmarks_per_camera->resize(num_cameras, 0u);
-  num_bad_landmarks_per_camera->resize(num_cameras, 0u);
-  num_unknown_landmarks_per_camera->resize(num_cameras, 0u);
-  total_num_landmarks_per_camera->resize(num_cameras, 0u);
-
-  pose_graph::VertexIdList vertex_ids;
-  getAllVertexIdsInMissionAlongGraph(mission_id, &vertex_ids);
-  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
-    const vi_map::Vertex& vertex = getVertex(vertex_id);
-    ++(*num_vertices);
-    *num_landmarks += vertex.getLandmarks().size();
-    for (const vi_map::Landmark& landmark : vertex.getLandmarks()) {
-      const KeypointIdentifierList& observations = landmark.getObservations();
-      if (!observations.empty()) {
-        const size_t first_observation_frame_idx =
-            observations.front().frame_id.frame_index;
-        CHECK_LT(first_observation_frame_idx, num_cameras);
-
-        if (landmark.getQuality() == vi_map::Landmark::Quality::kUnknown) {
-          ++((*num_unknown_landmarks_per_camera)[first_observation_frame_idx]);
-        } else if (landmark.getQuality() == vi_map::Landmark::Quality::kBad) {
-          ++((*num_bad_landmarks_per_camera)[first_observation_frame_idx]);
-        } else if (landmark.getQuality() == vi_map::Landmark::Quality::kGood) {
-          ++((*num_good_landmarks_per_camera)[first_observation_frame_idx]);
-        }
-        ++((*total_num_landmarks_per_camera)[first_observation_frame_idx]);
-      }
+  std::vector<MissionStatistics> statistics;
+  getStatisticsOfMissions({mission_id}, &statistics);
+  CHECK_EQ(statistics.size(), 1u);
+  MissionStatistics& mission_statistics = statistics.front();
+  num_good_landmarks_per_camera->swap(
+      mission_statistics.num_good_landmarks_per_camera);
+  num_bad_landmarks_per_camera->swap(
+      mission_statistics.num_bad_landmarks_per_camera);
+  num_unknown_landmarks_per_camera->swap(
+      mission_statistics.num_unknown_landmarks_per_camera);
+  total_num_landmarks_per_camera->swap(
+      mission_statistics.total_num_landmarks_per_camera);
+  *num_landmarks = mission_statistics.num_landmarks;
+  *num_vertices = mission_statistics.num_vertices;
+  *num_observations = mission_statistics.num_observations;
+  *duration_s = mission_statistics.duration_s;
+  *start_time_ns = mission_statistics.start_time_ns;
+  *end_time_ns = mission_statistics.end_time_ns;
+}
+
+void VIMap::getStatisticsOfMissions(
+    const vi_map::MissionIdList& mission_ids,
+    std::vector<MissionStatistics>* statistics) const {
+  CHECK_NOTNULL(statistics)->clear();
+  const size_t num_missions = mission_ids.size();
+  statistics->resize(num_missions);
+
+  // The vertices of all missions are processed as one list of pairs of
+  // mission and vertex indices.
+  std::vector<pose_graph::VertexIdList> mission_vertex_ids(num_missions);
+  std::vector<std::pair<size_t, size_t>> mission_and_vertex_indices;
+  for (size_t mission_idx = 0u; mission_idx < num_missions; ++mission_idx) {
+    const vi_map::MissionId& mission_id = mission_ids[mission_idx];
+    CHECK(mission_id.isValid());
+    MissionStatistics& mission_statistics = (*statistics)[mission_idx];
+
+    const aslam::NCameraId& ncamera_id =
+        sensor_manager_.getNCameraForMission(mission_id).getId();
+    CHECK(ncamera_id.isValid());
+    const size_t num_cameras =
+        sensor_manager_.getNCamera(ncamera_id).numCameras();
+    mission_statistics.num_good_landmarks_per_camera.resize(num_cameras, 0u);
+    mission_statistics.num_bad_landmarks_per_camera.resize(num_cameras, 0u);
+    mission_statistics.num_unknown_landmarks_per_camera.resize(
+        num_cameras, 0u);
+    mission_statistics.total_num_landmarks_per_camera.resize(num_cameras, 0u);
+
+    pose_graph::VertexIdList& vertex_ids = mission_vertex_ids[mission_idx];
+    getAllVertexIdsInMissionAlongGraph(mission_id, &vertex_ids);
+    mission_statistics.num_vertices = vertex_ids.size();
+    for (size_t vertex_idx = 0u; vertex_idx < vertex_ids.size();
+         ++vertex_idx) {
+      mission_and_vertex_indices.emplace_back(mission_idx, vertex_idx);
     }
 
-    const unsigned int num_frames = vertex.numFrames();
-    for (unsigned int frame_idx = 0; frame_idx < num_frames; ++frame_idx) {
-      if (vertex.isVisualFrameSet(frame_idx) &&
-          vertex.isVisualFrameValid(frame_idx)) {
-        *num_observations +=
-            vertex.getVisualFrame(frame_idx).getNumKeypointMeasurements();
+    if (!vertex_ids.empty()) {
+      const vi_map::Vertex& first_vertex = getVertex(vertex_ids.front());
+      const vi_map::Vertex& last_vertex = getVertex(vertex_ids.back());
+      const unsigned int kFirstFrameIndex = 0u;
+      if (first_vertex.isFrameIndexValid(kFirstFrameIndex) &&
+          last_vertex.isFrameIndexValid(kFirstFrameIndex)) {
+        mission_statistics.start_time_ns =
+            first_vertex.getVisualFrame(kFirstFrameIndex)
+                .getTimestampNanoseconds();
+        mission_statistics.end_time_ns =
+            last_vertex.getVisualFrame(kFirstFrameIndex)
+                .getTimestampNanoseconds();
+        mission_statistics.duration_s = aslam::time::nanoSecondsToSeconds(
+            mission_statistics.end_time_ns - mission_statistics.start_time_ns);
       }
     }
   }
 
-  *duration_s = 0.0;
-  *start_time_ns = 0;
-  *end_time_ns = 0;
-  if (!vertex_ids.empty()) {
-    const vi_map::Vertex& first_vertex = getVertex(vertex_ids.front());
-    const vi_map::Vertex& last_vertex = getVertex(vertex_ids.back());
-    const unsigned int kFirstFrameIndex = 0u;
-    if (first_vertex.isFrameIndexValid(kFirstFrameIndex) &&
-        last_vertex.isFrameIndexValid(kFirstFrameIndex)) {
-      *start_time_ns = first_vertex.getVisualFrame(kFirstFrameIndex)
-                           .getTimestampNanoseconds();
-      *end_time_ns = last_vertex.getVisualFrame(kFirstFrameIndex)
-                         .getTimestampNanoseconds();
-      *duration_s =
-          aslam::time::nanoSecondsToSeconds(*end_time_ns - *start_time_ns);
-    }
-  }
+  // Every range of vertices is counted with its own accumulators, which are
+  // added to the statistics at the end.
+  std::mutex statistics_mutex;
+  common::ParallelProcessDynamic(
+      mission_and_vertex_indices.size(),
+      [&](const size_t begin, const size_t end) {
+        std::vector<MissionStatistics> range_statistics(num_missions);
+        for (size_t mission_idx = 0u; mission_idx < num_missions;
+             ++mission_idx) {
+          const size_t num_cameras =
+              (*statistics)[mission_idx].total_num_landmarks_per_camera.size();
+          MissionStatistics& mission_statistics =
+              range_statistics[mission_idx];
+          mission_statistics.num_good_landmarks_per_camera.resize(
+              num_cameras, 0u);
+          mission_statistics.num_bad_landmarks_per_camera.resize(
+              num_cameras, 0u);
+          mission_statistics.num_unknown_landmarks_per_camera.resize(
+              num_cameras, 0u);
+          mission_statistics.total_num_landmarks_per_camera.resize(
+              num_cameras, 0u);
+        }
+
+        for (size_t idx = begin; idx < end; ++idx) {
+          const size_t mission_idx = mission_and_vertex_indices[idx].first;
+          const size_t vertex_idx = mission_and_vertex_indices[idx].second;
+          const pose_graph::VertexIdList& vertex_ids =
+              mission_vertex_ids[mission_idx];
+          const vi_map::Vertex& vertex = getVertex(vertex_ids[vertex_idx]);
+          MissionStatistics& mission_statistics =
+              range_statistics[mission_idx];
+          const size_t num_cameras =
+              mission_statistics.total_num_landmarks_per_camera.size();
+
+          mission_statistics.num_landmarks += vertex.getLandmarks().size();
+          for (const vi_map::Landmark& landmark : vertex.getLandmarks()) {
+            const KeypointIdentifierList& observations =
+                landmark.getObservations();
+            if (observations.empty()) {
+              continue;
+            }
+            // The landmarks are counted by the camera of their first
+            // observation.
+            const size_t camera_idx =
+                observations.front().frame_id.frame_index;
+            CHECK_LT(camera_idx, num_cameras);
+            switch (landmark.getQuality()) {
+              case vi_map::Landmark::Quality::kUnknown:
+                ++mission_statistics.num_unknown_landmarks_per_camera
+                      [camera_idx];
+                break;
+              case vi_map::Landmark::Quality::kBad:
+                ++mission_statistics.num_bad_landmarks_per_camera[camera_idx];
+                break;
+              case vi_map::Landmark::Quality::kGood:
+                ++mission_statistics.num_good_landmarks_per_camera[camera_idx];
+                break;
+              default:
+                break;
+            }
+            ++mission_statistics.total_num_landmarks_per_camera[camera_idx];
+          }
+
+          const unsigned int num_frames = vertex.numFrames();
+          for (unsigned int frame_idx = 0; frame_idx < num_frames;
+               ++frame_idx) {
+            if (vertex.isVisualFrameSet(frame_idx) &&
+                vertex.isVisualFrameValid(frame_idx)) {
+              mission_statistics.num_observations +=
+                  vertex.getVisualFrame(frame_idx).getNumKeypointMeasurements();
+            }
+          }
+
+          pose_graph::EdgeIdSet outgoing_edges;
+          vertex.getOutgoingEdges(&outgoing_edges);
+          for (const pose_graph::EdgeId& edge_id : outgoing_edges) {
+            CHECK(edge_id.isValid());
+            switch (getEdgeType(edge_id)) {
+              case pose_graph::Edge::EdgeType::kOdometry:
+                ++mission_statistics.num_wheel_odometry_edges;
+                break;
+              case pose_graph::Edge::EdgeType::kLoopClosure:
+                ++mission_statistics.num_loop_closure_edges;
+                break;
+              case pose_graph::Edge::EdgeType::kViwls:
+                ++mission_statistics.num_imu_edges;
+                break;
+              default:
+                break;
+            }
+          }
+
+          if (vertex_idx > 0u) {
+            const vi_map::Vertex& previous_vertex =
+                getVertex(vertex_ids[vertex_idx - 1u]);
+            mission_statistics.distance_travelled_m +=
+                (vertex.get_p_M_I() - previous_vertex.get_p_M_I()).norm();
+          }
+        }
+
+        std::lock_guard<std::mutex> lock(statistics_mutex);
+        for (size_t mission_idx = 0u; mission_idx < num_missions;
+             ++mission_idx) {
+          const MissionStatistics& range_mission_statistics =
+              range_statistics[mission_idx];
+          MissionStatistics& mission_statistics = (*statistics)[mission_idx];
+          const size_t num_cameras =
+              mission_statistics.total_num_landmarks_per_camera.size();
+          for (size_t camera_idx = 0u; camera_idx < num_cameras;
+               ++camera_idx) {
+            mission_statistics.num_good_landmarks_per_camera[camera_idx] +=
+                range_mission_statistics
+                    .num_good_landmarks_per_camera[camera_idx];
+            mission_statistics.num_bad_landmarks_per_camera[camera_idx] +=
+                range_mission_statistics
+                    .num_bad_landmarks_per_camera[camera_idx];
+            mission_statistics.num_unknown_landmarks_per_camera[camera_idx] +=
+                range_mission_statistics
+                    .num_unknown_landmarks_per_camera[camera_idx];
+            mission_statistics.total_num_landmarks_per_camera[camera_idx] +=
+                range_mission_statistics
+                    .total_num_landmarks_per_camera[camera_idx];
+          }
+          mission_statistics.num_landmarks +=
+              range_mission_statistics.num_landmarks;
+          mission_statistics.num_observations +=
+              range_mission_statistics.num_observations;
+          mission_statistics.num_imu_edges +=
+              range_mission_statistics.num_imu_edges;
+          mission_statistics.num_wheel_odometry_edges +=
+              range_mission_statistics.num_wheel_odometry_edges;
+          mission_statistics.num_loop_closure_edges +=
+              range_mission_statistics.num_loop_closure_edges;
+          mission_statistics.distance_travelled_m +=
+              range_mission_statistics.distance_travelled_m;
+        }
+      },
+      common::getNumHardwareThreads());
 }
 
 std::string VIMap::printMapStatistics(
     const vi_map::MissionId& mission_id, const unsigned int mission_number,
     const SemanticsManager& semantics) const {
+  std::vector<MissionStatistics> statistics;
+  getStatisticsOfMissions({mission_id}, &statistics);
+  CHECK_EQ(statistics.size(), 1u);
+  return printMapStatistics(
+      mission_id, mission_number, semantics, statistics.front());
+}
+
+std::string VIMap::printMapStatistics(
+    const vi_map::MissionId& mission_id, const unsigned int mission_number,
+    const SemanticsManager& semantics,
+    const MissionStatistics& statistics) const {
   std::stringstream stats_text;
 
   static constexpr int kMaxLength = 20;
@@ -418,44 +696,6 @@ std::string VIMap::printMapStatistics(
   };
 
   std::string name = semantics.getNameOfMission(mission_id);
-  std::vector<size_t> num_good_landmarks_per_camera;
-  std::vector<size_t> num_bad_landmarks_per_camera;
-  std::vector<size_t> num_unknown_landmarks_per_camera;
-  std::vector<size_t> total_num_landmarks_per_camera;
-  size_t num_landmarks = 0u;
-  size_t num_vertices = 0u;
-  size_t num_observations = 0u;
-  double duration_s = 0.0;
-  int64_t start_time_ns = 0u;
-  int64_t end_time_ns = 0u;
-  getStatisticsOfMission(
-      mission_id, &num_good_landmarks_per_camera, &num_bad_landmarks_per_camera,
-      &num_unknown_landmarks_per_camera, &total_num_landmarks_per_camera,
-      &num_landmarks, &num_vertices, &num_observations, &duration_s,
-      &start_time_ns, &end_time_ns);
-
-  size_t num_wheel_odometry_edges = 0u;
-  size_t num_imu_edges = 0u;
-  size_t num_loop_closure_edges = 0u;
-
-  pose_graph::EdgeIdList edge_ids;
-  getAllEdgeIdsInMissionAlongGraph(mission_id, &edge_ids);
-  for (const pose_graph::EdgeId& edge_id : edge_ids) {
-    CHECK(edge_id.isValid());
-    switch (getEdgeType(edge_id)) {
-      case pose_graph::Edge::EdgeType::kOdometry:
-        ++num_wheel_odometry_edges;
-        break;
-      case pose_graph::Edge::EdgeType::kLoopClosure:
-        ++num_loop_closure_edges;
-        break;
-      case pose_graph::Edge::EdgeType::kViwls:
-        ++num_imu_edges;
-        break;
-      default:
-        break;
-    }
-  }
 
   const vi_map::VIMission& mission = getMission(mission_id);
   stats_text << std::endl;
@@ -523,40 +763,51 @@ std::string VIMap::printMapStatistics(
     print_aligned("GPS WGS Sensor: ", sensor_id.hexString(), 1);
   }
 
-  print_aligned("Vertices:", std::to_string(num_vertices), 1);
+  print_aligned("Vertices:", std::to_string(statistics.num_vertices), 1);
 
-  print_aligned("Landmarks:", std::to_string(num_landmarks), 1);
+  print_aligned(
+      "Landmarks:", std::to_string(statistics.num_landmarks), 1);
   print_aligned("Landmarks by first observer backlink:", "", 1);
   for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
     print_aligned(
         "Camera " + std::to_string(camera_idx) + ":",
-        std::to_string(total_num_landmarks_per_camera[camera_idx]) +
-            " (g:" + std::to_string(num_good_landmarks_per_camera[camera_idx]) +
-            " b:" + std::to_string(num_bad_landmarks_per_camera[camera_idx]) +
+        std::to_string(statistics.total_num_landmarks_per_camera[camera_idx]) +
+            " (g:" +
+            std::to_string(
+                statistics.num_good_landmarks_per_camera[camera_idx]) +
+            " b:" +
+            std::to_string(
+                statistics.num_bad_landmarks_per_camera[camera_idx]) +
             " u:" +
-            std::to_string(num_unknown_landmarks_per_camera[camera_idx]) + ")",
+            std::to_string(
+                statistics.num_unknown_landmarks_per_camera[camera_idx]) +
+            ")",
         1);
   }
-  print_aligned("Observations:", std::to_string(num_observations), 1);
+  print_aligned(
+      "Observations:", std::to_string(statistics.num_observations), 1);
   print_aligned("Num edges by type: ", "", 1);
-  print_aligned("IMU: ", std::to_string(num_imu_edges), 1);
+  print_aligned("IMU: ", std::to_string(statistics.num_imu_edges), 1);
   print_aligned(
-      "Wheel-odometry: ", std::to_string(num_wheel_odometry_edges), 1);
-  print_aligned("Loop-closure: ", std::to_string(num_loop_closure_edges), 1);
-  double distance = 0;
-  getDistanceTravelledPerMission(mission_id, &distance);
-  print_aligned("Distance travelled [m]:", std::to_string(distance), 1);
+      "Wheel-odometry: ", std::to_string(statistics.num_wheel_odometry_edges),
+      1);
+  print_aligned(
+      "Loop-closure: ", std::to_string(statistics.num_loop_closure_edges), 1);
+  print_aligned(
+      "Distance travelled [m]:",
+      std::to_string(statistics.distance_travelled_m), 1);
 
   if (!selected_missions_.empty()) {
     const bool is_selected = (selected_missions_.count(mission_id) > 0);
     print_aligned("Selected:", std::to_string(is_selected), 1);
   }
 
-  if (num_vertices > 0) {
-    time_t start_time(aslam::time::nanoSecondsToSeconds(start_time_ns));
+  if (statistics.num_vertices > 0) {
+    time_t start_time(
+        aslam::time::nanoSecondsToSeconds(statistics.start_time_ns));
     std::string start_time_str = common::generateDateString(&start_time);
 
-    time_t end_time(aslam::time::nanoSecondsToSeconds(end_time_ns));
+    time_t end_time(aslam::time::nanoSecondsToSeconds(statistics.end_time_ns));
     std::string end_time_str = common::generateDateString(&end_time);
     print_aligned(
         "Start to end time: ", start_time_str + " to " + end_time_str, 1);
@@ -599,14 +850,18 @@ std::string VIMap::printMapStatistics(
 std::string VIMap::printMapStatistics(void) const {
   vi_map::MissionIdList all_missions;
   getAllMissionIdsSortedByTimestamp(&all_missions);
+  std::vector<MissionStatistics> statistics;
+  getStatisticsOfMissions(all_missions, &statistics);
+  CHECK_EQ(statistics.size(), all_missions.size());
 
   std::stringstream stats_text;
   stats_text << "Mission statistics: " << std::endl;
-  unsigned int mission_number = 0u;
-  for (const vi_map::MissionId& mission_id : all_missions) {
+  const vi_map::SemanticsManager semantics;
+  for (unsigned int mission_number = 0u; mission_number < all_missions.size();
+       ++mission_number) {
     stats_text << printMapStatistics(
-        mission_id, mission_number, vi_map::SemanticsManager());
-    ++mission_number;
+        all_missions[mission_number], mission_number, semantics,
+        statistics[mission_number]);
   }
   return stats_text.str();
 }
@@ -614,7 +869,13 @@ std::string VIMap::printMapStatistics(void) const {
 std::string VIMap::printMapAccumulatedStatistics() const {
   vi_map::MissionIdList all_missions;
   getAllMissionIdsSortedByTimestamp(&all_missions);
+  std::vector<MissionStatistics> statistics;
+  getStatisticsOfMissions(all_missions, &statistics);
+  return printMapAccumulatedStatistics(statistics);
+}
 
+std::string VIMap::printMapAccumulatedStatistics(
+    const std::vector<MissionStatistics>& statistics) const {
   double total_distance_travelled = 0.0;
   size_t total_num_vertices = 0u;
   size_t total_num_landmarks = 0u;
@@ -624,41 +885,22 @@ std::string VIMap::printMapAccumulatedStatistics() const {
   size_t total_num_unknown_landmarks = 0u;
   double total_duration_s = 0.0;
 
-  for (const vi_map::MissionId& mission_id : all_missions) {
-    std::vector<size_t> num_good_landmarks_per_camera;
-    std::vector<size_t> num_bad_landmarks_per_camera;
-    std::vector<size_t> num_unknown_landmarks_per_camera;
-    std::vector<size_t> total_num_landmarks_per_camera;
-    size_t num_landmarks;
-    size_t num_vertices;
-    size_t num_observations;
-    double duration_s;
-    int64_t start_time_ns;
-    int64_t end_time_ns;
-    getStatisticsOfMission(
-        mission_id, &num_good_landmarks_per_camera,
-        &num_bad_landmarks_per_camera, &num_unknown_landmarks_per_camera,
-        &total_num_landmarks_per_camera, &num_landmarks, &num_vertices,
-        &num_observations, &duration_s, &start_time_ns, &end_time_ns);
-
+  for (const MissionStatistics& mission_statistics : statistics) {
     total_num_good_landmarks += std::accumulate(
-        num_good_landmarks_per_camera.begin(),
-        num_good_landmarks_per_camera.end(), 0u);
+        mission_statistics.num_good_landmarks_per_camera.begin(),
+        mission_statistics.num_good_landmarks_per_camera.end(), size_t{0u});
     total_num_bad_landmarks += std::accumulate(
-        num_bad_landmarks_per_camera.begin(),
-        num_bad_landmarks_per_camera.end(), 0u);
+        mission_statistics.num_bad_landmarks_per_camera.begin(),
+        mission_statistics.num_bad_landmarks_per_camera.end(), size_t{0u});
     total_num_unknown_landmarks += std::accumulate(
-        num_unknown_landmarks_per_camera.begin(),
-        num_unknown_landmarks_per_camera.end(), 0u);
-    total_num_landmarks += num_landmarks;
-    total_num_observations += num_observations;
-    total_num_vertices += num_vertices;
-
-    total_duration_s += duration_s;
-
-    double distance_travelled;
-    getDistanceTravelledPerMission(mission_id, &distance_travelled);
-    total_distance_travelled += distance_travelled;
+        mission_statistics.num_unknown_landmarks_per_camera.begin(),
+        mission_statistics.num_unknown_landmarks_per_camera.end(),
+        size_t{0u});
+    total_num_landmarks += mission_statistics.num_landmarks;
+    total_num_observations += mission_statistics.num_observations;
+    total_num_vertices += mission_statistics.num_vertices;
+    total_duration_s += mission_statistics.duration_s;
+    total_distance_travelled += mission_statistics.distance_travelled_m;
   }
 
   std::stringstream stats_text;
@@ -691,6 +933,42 @@ std::string VIMap::printMapAccumulatedStatistics() const {
   return stats_text.str();
 }
 
+void VIMap::accumulateMemoryUsage(common::MemoryUsage* usage) const {
+  CHECK_NOTNULL(usage);
+  typedef common::MemoryUsage::Category Category;
+
+  pose_graph::VertexIdList all_vertex_ids;
+  posegraph.getAllVertexIds(&all_vertex_ids);
+  for (const pose_graph::VertexId& vertex_id : all_vertex_ids) {
+    getVertex(vertex_id).accumulateMemoryUsage(usage);
+  }
+
+  pose_graph::EdgeIdList all_edge_ids;
+  posegraph.getAllEdgeIds(&all_edge_ids);
+  size_t num_edge_bytes = 0u;
+  for (const pose_graph::EdgeId& edge_id : all_edge_ids) {
+    num_edge_bytes +=
+        getEdgePtrAs<vi_map::Edge>(edge_id)->getMemoryUsageBytes();
+  }
+  usage->add(Category::kEdges, num_edge_bytes);
+
+  usage->add(
+      Category::kIndexStructures, posegraph.getIndexMemoryUsageBytes() +
+                                      landmark_index.getMemoryUsageBytes());
+
+  accumulateResourceMemoryUsage(usage);
+}
+
+std::string VIMap::printMapMemoryUsage() const {
+  common::MemoryUsage usage;
+  accumulateMemoryUsage(&usage);
+
+  std::stringstream stats_text;
+  stats_text << "Estimated memory usage:" << std::endl;
+  stats_text << usage.toString();
+  return stats_text.str();
+}
+
 void VIMap::getDistanceTravelledPerMission(
     const vi_map::MissionId& mission_id, double* distance) const {
   CHECK_NOTNULL(distance);
@@ -753,6 +1031,7 @@ void VIMap::addNewMissionWithBaseframe(
   const MissionBaseFrameId& mission_base_frame_id = mission_base_frame.id();
   CHECK(mission_base_frame_id.isValid());
   CHECK_EQ(mission->getBaseFrameId(), mission_base_frame_id);
+  change_tracker_.markMissionsChanged();
   missions.emplace(mission_id, std::move(mission));
   mission_base_frames.emplace(mission_base_frame_id, mission_base_frame);
 }
@@ -767,6 +1046,7 @@ void VIMap::addNewMissionWithBaseframe(
   MissionBaseFrame new_mission_base_frame(
       mission_baseframe_id, T_G_M, T_G_M_covariance);
 
+  change_tracker_.markMissionsChanged();
   mission_base_frames.emplace(mission_baseframe_id, new_mission_base_frame);
 
   // Create and add new mission.
@@ -804,6 +1084,7 @@ void VIMap::addNewLandmark(
   getVertex(keypoint_and_store_vertex_id).getLandmarks().addLandmark(landmark);
 
   const vi_map::LandmarkId& landmark_id = landmark.id();
+  change_tracker_.markLandmarkIndexChanged();
   landmark_index.addLandmarkAndVertexReference(
       landmark_id, keypoint_and_store_vertex_id);
   CHECK(hasLandmark(landmark_id));
@@ -894,6 +1175,7 @@ void VIMap::addLandmarkIndexReference(
       << "Landmark " << landmark_id << " not found in vertex "
       << storing_vertex_id << "!";
 
+  change_tracker_.markLandmarkIndexChanged();
   landmark_index.addLandmarkAndVertexReference(landmark_id, storing_vertex_id);
 }
 
@@ -931,7 +1213,7 @@ void VIMap::moveLandmarksToOtherVertex(
     new_landmark.set_p_B(pose::Position3D(p_I_fi));
 
     CHECK_EQ(getLandmarkStoreVertexId(landmark_id), vertex_id_from);
-    landmark_index.updateVertexOfLandmark(landmark_id, vertex_id_to);
+    updateLandmarkIndexReference(landmark_id, vertex_id_to);
 
     landmarks_to_be_removed.insert(landmark_id);
   }
@@ -995,16 +1277,20 @@ void VIMap::mergeNeighboringVertices(
   // Remove all other edges from vertex.
   for (const pose_graph::EdgeId& incoming_edge : incoming) {
     if (getEdgeType(incoming_edge) != pose_graph::Edge::EdgeType::kViwls) {
+      markEdgeChanged(incoming_edge);
       posegraph.removeEdge(incoming_edge);
     }
   }
   for (const pose_graph::EdgeId& outgoing_edge : outgoing) {
     if (getEdgeType(outgoing_edge) != pose_graph::Edge::EdgeType::kViwls) {
+      markEdgeChanged(outgoing_edge);
       posegraph.removeEdge(outgoing_edge);
     }
   }
 
+  markEdgeChanged(edge_between_vertices->id());
   if (edge_after_next_vertex != nullptr) {
+    markEdgeChanged(edge_after_next_vertex->id());
     posegraph.mergeNeighboringViwlsEdges(
         merge_into_vertex_id, *edge_between_vertices, *edge_after_next_vertex);
   } else {
@@ -1047,9 +1333,177 @@ void VIMap::mergeNeighboringVertices(
   }
 
   // Remove the vertex.
+  markVertexChanged(next_vertex_id);
   posegraph.removeVertex(next_vertex_id);
 }
 
+size_t VIMap::mergeAllVerticesBetweenVertices(
+    const pose_graph::VertexIdList& kept_vertex_ids) {
+  if (kept_vertex_ids.size() < 2u) {
+    return 0u;
+  }
+  const vi_map::MissionId& mission_id =
+      getMissionIdForVertex(kept_vertex_ids.front());
+  const pose_graph::Edge::EdgeType traversal_edge =
+      getGraphTraversalEdgeType(mission_id);
+
+  // Move the landmarks into the kept vertices and replace the IMU edges
+  // between every two kept vertices by one concatenated edge.
+  pose_graph::VertexIdList merged_vertex_ids;
+  for (size_t kept_idx = 0u; kept_idx + 1u < kept_vertex_ids.size();
+       ++kept_idx) {
+    const pose_graph::VertexId& kept_vertex_id = kept_vertex_ids[kept_idx];
+    const pose_graph::VertexId& next_kept_vertex_id =
+        kept_vertex_ids[kept_idx + 1u];
+    CHECK_EQ(mission_id, getMissionIdForVertex(next_kept_vertex_id))
+        << "All kept vertices must be of the same mission.";
+
+    pose_graph::VertexIdList vertex_ids_in_between;
+    pose_graph::VertexId current_vertex_id = kept_vertex_id;
+    while (
+        getNextVertex(current_vertex_id, traversal_edge, &current_vertex_id) &&
+        current_vertex_id != next_kept_vertex_id) {
+      vertex_ids_in_between.push_back(current_vertex_id);
+    }
+    CHECK_EQ(current_vertex_id, next_kept_vertex_id)
+        << "The kept vertices must be in the order of the traversal edges.";
+    if (vertex_ids_in_between.empty()) {
+      continue;
+    }
+
+    // The IMU edges of the chain from the kept vertex to the next one.
+    std::vector<const vi_map::ViwlsEdge*> viwls_edges;
+    const vi_map::ViwlsEdge* outgoing_viwls_edge = nullptr;
+    for (const pose_graph::VertexId& vertex_id : vertex_ids_in_between) {
+      VLOG(4) << "Merging vertices: " << vertex_id << " into "
+              << kept_vertex_id;
+      moveLandmarksToOtherVertex(vertex_id, kept_vertex_id);
+
+      // Remove all other edges of the vertex.
+      std::unordered_set<pose_graph::EdgeId> incoming, outgoing;
+      const vi_map::Vertex& vertex = const_this->getVertex(vertex_id);
+      vertex.getIncomingEdges(&incoming);
+      vertex.getOutgoingEdges(&outgoing);
+      size_t num_incoming_viwls_edges = 0u, num_outgoing_viwls_edges = 0u;
+      for (const pose_graph::EdgeId& incoming_edge : incoming) {
+        if (getEdgeType(incoming_edge) == pose_graph::Edge::EdgeType::kViwls) {
+          viwls_edges.push_back(getEdgePtrAs<vi_map::ViwlsEdge>(incoming_edge));
+          ++num_incoming_viwls_edges;
+        } else {
+          markEdgeChanged(incoming_edge);
+          posegraph.removeEdge(incoming_edge);
+        }
+      }
+      for (const pose_graph::EdgeId& outgoing_edge : outgoing) {
+        if (getEdgeType(outgoing_edge) == pose_graph::Edge::EdgeType::kViwls) {
+          outgoing_viwls_edge = getEdgePtrAs<vi_map::ViwlsEdge>(outgoing_edge);
+          ++num_outgoing_viwls_edges;
+        } else {
+          markEdgeChanged(outgoing_edge);
+          posegraph.removeEdge(outgoing_edge);
+        }
+      }
+      CHECK_EQ(1u, num_outgoing_viwls_edges)
+          << "A vertex can have only one outgoing edge in VIWLS graph";
+      CHECK_EQ(1u, num_incoming_viwls_edges)
+          << "A vertex can have only one incoming edge in VIWLS graph";
+    }
+    viwls_edges.push_back(CHECK_NOTNULL(outgoing_viwls_edge));
+    CHECK_EQ(viwls_edges.size(), vertex_ids_in_between.size() + 1u);
+
+    // Every edge shares its first IMU measurement with the last one of the
+    // previous edge.
+    int num_imu_measurements = 1;
+    for (const vi_map::ViwlsEdge* viwls_edge : viwls_edges) {
+      CHECK_EQ(
+          viwls_edge->getImuTimestamps().cols(),
+          viwls_edge->getImuData().cols());
+      CHECK_GT(viwls_edge->getImuTimestamps().cols(), 0);
+      num_imu_measurements += viwls_edge->getImuTimestamps().cols() - 1;
+    }
+    Eigen::Matrix<int64_t, 1, Eigen::Dynamic> imu_timestamps(
+        1, num_imu_measurements);
+    Eigen::Matrix<double, 6, Eigen::Dynamic> imu_data(6, num_imu_measurements);
+    int first_col = 0;
+    for (size_t edge_idx = 0u; edge_idx < viwls_edges.size(); ++edge_idx) {
+      const vi_map::ViwlsEdge& viwls_edge = *viwls_edges[edge_idx];
+      const int num_cols = (edge_idx + 1u < viwls_edges.size())
+                               ? viwls_edge.getImuTimestamps().cols() - 1
+                               : viwls_edge.getImuTimestamps().cols();
+      imu_timestamps.middleCols(first_col, num_cols) =
+          viwls_edge.getImuTimestamps().leftCols(num_cols);
+      imu_data.middleCols(first_col, num_cols) =
+          viwls_edge.getImuData().leftCols(num_cols);
+      first_col += num_cols;
+    }
+    CHECK_EQ(first_col, num_imu_measurements);
+
+    for (const vi_map::ViwlsEdge* viwls_edge : viwls_edges) {
+      const pose_graph::EdgeId edge_id = viwls_edge->id();
+      markEdgeChanged(edge_id);
+      posegraph.removeEdge(edge_id);
+    }
+    pose_graph::EdgeId new_edge_id;
+    common::generateId(&new_edge_id);
+    posegraph.addVIEdge(
+        new_edge_id, kept_vertex_id, next_kept_vertex_id, imu_timestamps,
+        imu_data);
+
+    merged_vertex_ids.insert(
+        merged_vertex_ids.end(), vertex_ids_in_between.begin(),
+        vertex_ids_in_between.end());
+  }
+  if (merged_vertex_ids.empty()) {
+    return 0u;
+  }
+
+  // Remove the observations of the merged vertices from every landmark they
+  // observe once. Landmarks only observed by merged vertices are removed.
+  const pose_graph::VertexIdSet merged_vertex_id_set(
+      merged_vertex_ids.begin(), merged_vertex_ids.end());
+  vi_map::LandmarkIdSet observed_landmark_ids;
+  for (const pose_graph::VertexId& vertex_id : merged_vertex_ids) {
+    const vi_map::Vertex& vertex = const_this->getVertex(vertex_id);
+    for (unsigned int frame_idx = 0u; frame_idx < vertex.numFrames();
+         ++frame_idx) {
+      if (!vertex.isVisualFrameSet(frame_idx)) {
+        continue;
+      }
+      const size_t num_keypoints = vertex.observedLandmarkIdsSize(frame_idx);
+      for (size_t keypoint_idx = 0u; keypoint_idx < num_keypoints;
+           ++keypoint_idx) {
+        const vi_map::LandmarkId landmark_id =
+            vertex.getObservedLandmarkId(frame_idx, keypoint_idx);
+        if (landmark_id.isValid()) {
+          observed_landmark_ids.insert(landmark_id);
+        }
+      }
+    }
+  }
+  std::function<bool(const KeypointIdentifier&)> is_merged_observation =
+      [&merged_vertex_id_set](const KeypointIdentifier& observation) {
+        return merged_vertex_id_set.count(observation.frame_id.vertex_id) >
+               0u;
+      };
+  for (const vi_map::LandmarkId& landmark_id : observed_landmark_ids) {
+    vi_map::Landmark& landmark = getLandmark(landmark_id);
+    const KeypointIdentifierList& observations = landmark.getObservations();
+    if (std::all_of(
+            observations.begin(), observations.end(), is_merged_observation)) {
+      removeLandmark(landmark_id);
+    } else {
+      landmark.removeAllObservationsAccordingToPredicate(
+          is_merged_observation);
+    }
+  }
+
+  for (const pose_graph::VertexId& vertex_id : merged_vertex_ids) {
+    markVertexChanged(vertex_id);
+    posegraph.removeVertex(vertex_id);
+  }
+  return merged_vertex_ids.size();
+}
+
 void VIMap::mergeLandmarks(
     const vi_map::LandmarkId landmark_id_to_merge,
     const vi_map::LandmarkId& landmark_id_into) {
@@ -1106,12 +1560,168 @@ void VIMap::mergeLandmarks(
       landmark_id_to_merge));
 
   // Remove the landmark from the landmark index.
+  change_tracker_.markLandmarkIndexChanged();
   landmark_index.removeLandmark(landmark_id_to_merge);
 
   // After the merge, we should have minus 1 entry in the landmark index.
   CHECK_EQ(landmark_index_size_before - 1, landmark_index.numLandmarks());
 }
 
+size_t VIMap::mergeLandmarks(
+    const vi_map::LandmarkToLandmarkMap& landmark_id_to_merge_to_into) {
+  // Resolve every landmark to the one it ends up in, compressing the chains
+  // on the way so that every chain is only followed once.
+  vi_map::LandmarkToLandmarkMap resolved_to_merge_to_into;
+  resolved_to_merge_to_into.reserve(landmark_id_to_merge_to_into.size());
+  vi_map::LandmarkIdList chain;
+  for (const vi_map::LandmarkToLandmarkMap::value_type& pair :
+       landmark_id_to_merge_to_into) {
+    chain.clear();
+    vi_map::LandmarkId landmark_id_into = pair.first;
+    while (true) {
+      vi_map::LandmarkToLandmarkMap::const_iterator it =
+          resolved_to_merge_to_into.find(landmark_id_into);
+      if (it != resolved_to_merge_to_into.end()) {
+        landmark_id_into = it->second;
+        break;
+      }
+      it = landmark_id_to_merge_to_into.find(landmark_id_into);
+      if (it == landmark_id_to_merge_to_into.end() ||
+          it->second == landmark_id_into) {
+        break;
+      }
+      chain.push_back(landmark_id_into);
+      CHECK_LE(chain.size(), landmark_id_to_merge_to_into.size())
+          << "The landmark merges contain a cycle.";
+      landmark_id_into = it->second;
+    }
+    for (const vi_map::LandmarkId& landmark_id_to_merge : chain) {
+      resolved_to_merge_to_into.emplace(landmark_id_to_merge, landmark_id_into);
+    }
+  }
+  if (resolved_to_merge_to_into.empty()) {
+    return 0u;
+  }
+
+  // Move the observations into the remaining landmarks and collect the
+  // vertices that observe a merged landmark.
+  pose_graph::VertexIdSet observer_vertex_ids;
+  vi_map::LandmarkIdList landmark_ids_to_merge;
+  landmark_ids_to_merge.reserve(resolved_to_merge_to_into.size());
+  for (const vi_map::LandmarkToLandmarkMap::value_type& pair :
+       resolved_to_merge_to_into) {
+    const vi_map::LandmarkId& landmark_id_to_merge = pair.first;
+    const vi_map::LandmarkId& landmark_id_into = pair.second;
+    CHECK(hasLandmark(landmark_id_to_merge));
+    CHECK(hasLandmark(landmark_id_into));
+    landmark_ids_to_merge.push_back(landmark_id_to_merge);
+
+    vi_map::Landmark& landmark_into = getLandmark(landmark_id_into);
+    const vi_map::Landmark& landmark_to_merge =
+        getLandmark(landmark_id_to_merge);
+    landmark_into.addObservations(landmark_to_merge.getObservations());
+    if (landmark_into.getQuality() != Landmark::Quality::kGood) {
+      if (landmark_to_merge.getQuality() == Landmark::Quality::kGood) {
+        landmark_into.setQuality(Landmark::Quality::kGood);
+      } else {
+        landmark_into.setQuality(Landmark::Quality::kUnknown);
+      }
+    }
+    landmark_to_merge.forEachObservation(
+        [&](const KeypointIdentifier& observation) {
+          observer_vertex_ids.emplace(observation.frame_id.vertex_id);
+        });
+  }
+
+  // Update the observed landmark ids of every observer vertex in one pass.
+  const pose_graph::VertexIdList observer_vertex_id_list(
+      observer_vertex_ids.begin(), observer_vertex_ids.end());
+  std::function<void(const std::vector<size_t>&)> update_observers =
+      [&](const std::vector<size_t>& batch) {
+        for (const size_t idx : batch) {
+          getVertex(observer_vertex_id_list[idx])
+              .updateIdsInObservedLandmarkIdList(resolved_to_merge_to_into);
+        }
+      };
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      observer_vertex_id_list.size(), update_observers, kAlwaysParallelize,
+      common::getNumHardwareThreads());
+
+  // Remove the merged landmarks from their vertices, then from the index.
+  for (const vi_map::LandmarkId& landmark_id_to_merge : landmark_ids_to_merge) {
+    getLandmarkStoreVertex(landmark_id_to_merge)
+        .getLandmarks()
+        .removeLandmark(landmark_id_to_merge);
+  }
+  change_tracker_.markLandmarkIndexChanged();
+  landmark_index.removeLandmarks(landmark_ids_to_merge);
+  return landmark_ids_to_merge.size();
+}
+
+void VIMap::removeLandmarks(const LandmarkIdList& landmark_ids) {
+  if (landmark_ids.empty()) {
+    return;
+  }
+  const LandmarkIdSet landmark_id_set(landmark_ids.begin(), landmark_ids.end());
+  CHECK_EQ(landmark_id_set.size(), landmark_ids.size())
+      << "The landmarks to remove contain duplicates.";
+
+  // Collect the vertices that observe or store a removed landmark.
+  pose_graph::VertexIdSet observer_vertex_ids;
+  std::unordered_map<pose_graph::VertexId, LandmarkIdSet>
+      store_vertex_to_landmark_ids;
+  for (const LandmarkId& landmark_id : landmark_ids) {
+    CHECK(hasLandmark(landmark_id));
+    store_vertex_to_landmark_ids[landmark_index.getStoringVertexId(
+                                     landmark_id)]
+        .emplace(landmark_id);
+    getLandmark(landmark_id)
+        .forEachObservation([&](const KeypointIdentifier& observation) {
+          observer_vertex_ids.emplace(observation.frame_id.vertex_id);
+        });
+  }
+
+  // Every vertex is only touched by one thread, first as an observer, then
+  // as the store of the removed landmarks.
+  constexpr bool kAlwaysParallelize = false;
+  const size_t num_threads = common::getNumHardwareThreads();
+  const pose_graph::VertexIdList observer_vertex_id_list(
+      observer_vertex_ids.begin(), observer_vertex_ids.end());
+  std::function<void(const std::vector<size_t>&)> invalidate_observations =
+      [&](const std::vector<size_t>& batch) {
+        for (const size_t idx : batch) {
+          getVertex(observer_vertex_id_list[idx])
+              .invalidateObservedLandmarkIds(landmark_id_set);
+        }
+      };
+  common::ParallelProcess(
+      observer_vertex_id_list.size(), invalidate_observations,
+      kAlwaysParallelize, num_threads);
+
+  std::vector<std::pair<pose_graph::VertexId, const LandmarkIdSet*>>
+      store_vertices;
+  store_vertices.reserve(store_vertex_to_landmark_ids.size());
+  for (const std::unordered_map<pose_graph::VertexId, LandmarkIdSet>::
+           value_type& item : store_vertex_to_landmark_ids) {
+    store_vertices.emplace_back(item.first, &item.second);
+  }
+  std::function<void(const std::vector<size_t>&)> remove_from_stores =
+      [&](const std::vector<size_t>& batch) {
+        for (const size_t idx : batch) {
+          getVertex(store_vertices[idx].first)
+              .getLandmarks()
+              .removeLandmarks(*store_vertices[idx].second);
+        }
+      };
+  common::ParallelProcess(
+      store_vertices.size(), remove_from_stores, kAlwaysParallelize,
+      num_threads);
+
+  change_tracker_.markLandmarkIndexChanged();
+  landmark_index.removeLandmarks(landmark_ids);
+}
+
 void VIMap::duplicateMission(const vi_map::MissionId& source_mission_id) {
   CHECK(hasMission(source_mission_id));
 
@@ -1129,6 +1739,10 @@ void VIMap::duplicateMission(const vi_map::MissionId& source_mission_id) {
   baseframe.set_p_G_M(source_baseframe.get_p_G_M());
   baseframe.set_q_G_M(source_baseframe.get_q_G_M());
   baseframe.set_T_G_M_Covariance(source_baseframe.get_T_G_M_Covariance());
+  // The duplicated vertices are new, only the other protos change.
+  change_tracker_.markMissionsChanged();
+  change_tracker_.markEdgesChanged();
+  change_tracker_.markLandmarkIndexChanged();
   mission_base_frames.emplace(baseframe_id, baseframe);
 
   // Copy mission.
@@ -1542,70 +2156,95 @@ unsigned int VIMap::numExpectedLandmarkObserverMissions(
 
 void VIMap::removeMission(
     const vi_map::MissionId& mission_id, bool remove_baseframe) {
-  // Delete all the vertices and edges in the mission.
+  // Delete all the vertices and edges in the mission. All ids are collected
+  // first, so that every landmark and the landmark index only need to be
+  // updated once instead of once per vertex and observation.
   CHECK(mission_id.isValid());
   CHECK(hasMission(mission_id));
 
   vi_map::VIMission& mission = getMission(mission_id);
   pose_graph::VertexIdList vertices;
   getAllVertexIdsInMission(mission_id, &vertices);
+  const pose_graph::VertexIdSet mission_vertices(
+      vertices.begin(), vertices.end());
 
-  for (pose_graph::VertexId vertex_id : vertices) {
-    vi_map::Vertex* vertex = getVertexPtr(vertex_id);
-    // Delete all edges.
-    pose_graph::EdgeIdSet incoming_edges;
-    vertex->getIncomingEdges(&incoming_edges);
-    for (pose_graph::EdgeId incoming_edge_id : incoming_edges) {
-      if (hasEdge(incoming_edge_id)) {
-        removeEdge(incoming_edge_id);
-      }
-    }
-    pose_graph::EdgeIdSet outgoing_edges;
-    vertex->getOutgoingEdges(&outgoing_edges);
-    for (pose_graph::EdgeId outgoing_edge_id : outgoing_edges) {
-      if (hasEdge(outgoing_edge_id)) {
-        removeEdge(outgoing_edge_id);
+  pose_graph::EdgeIdSet edges;
+  vi_map::LandmarkIdSet stored_landmarks;
+  vi_map::LandmarkIdSet observed_landmarks;
+  for (const pose_graph::VertexId& vertex_id : vertices) {
+    const vi_map::Vertex& vertex = const_this->getVertex(vertex_id);
+    pose_graph::EdgeIdSet vertex_edges;
+    vertex.getAllEdges(&vertex_edges);
+    edges.insert(vertex_edges.begin(), vertex_edges.end());
+    vi_map::LandmarkIdList vertex_landmarks;
+    vertex.getStoredLandmarkIdList(&vertex_landmarks);
+    stored_landmarks.insert(vertex_landmarks.begin(), vertex_landmarks.end());
+    for (unsigned int frame_idx = 0u; frame_idx < vertex.numFrames();
+         ++frame_idx) {
+      for (const vi_map::LandmarkId& landmark_id :
+           vertex.getFrameObservedLandmarkIds(frame_idx)) {
+        if (landmark_id.isValid()) {
+          observed_landmarks.emplace(landmark_id);
+        }
       }
     }
+  }
 
-    // Delete all landmarks.
-    vi_map::LandmarkIdList landmark_ids;
-    vertex->getStoredLandmarkIdList(&landmark_ids);
-    for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
-      removeLandmark(landmark_id);
+  // Delete all edges, including the ones to vertices of other missions.
+  for (const pose_graph::EdgeId& edge_id : edges) {
+    removeEdge(edge_id);
+  }
+
+  // Invalidate the observations of the landmarks stored in the mission by
+  // vertices of other missions.
+  vi_map::LandmarkId invalid_landmark_id;
+  invalid_landmark_id.setInvalid();
+  vi_map::LandmarkIdList landmarks_to_remove(
+      stored_landmarks.begin(), stored_landmarks.end());
+  for (const vi_map::LandmarkId& landmark_id : landmarks_to_remove) {
+    getLandmark(landmark_id)
+        .forEachObservation([&](const KeypointIdentifier& observation) {
+          if (mission_vertices.count(observation.frame_id.vertex_id) == 0u) {
+            getVertex(observation.frame_id.vertex_id)
+                .setObservedLandmarkId(observation, invalid_landmark_id);
+          }
+        });
+  }
+
+  // Strip the observations by the mission from all landmarks stored in other
+  // missions in a single sweep per landmark. If the mission was the only
+  // observer of such a landmark, the orphaned landmark is removed as well.
+  std::function<bool(const KeypointIdentifier&)>  // NOLINT
+      is_observed_by_mission = [&](const KeypointIdentifier& observation) {
+        return mission_vertices.count(observation.frame_id.vertex_id) > 0u;
+      };
+  for (const vi_map::LandmarkId& landmark_id : observed_landmarks) {
+    if (stored_landmarks.count(landmark_id) > 0u) {
+      continue;
     }
-    CHECK_EQ(0u, vertex->getLandmarks().size());
+    vi_map::Vertex& store_vertex = getLandmarkStoreVertex(landmark_id);
+    vi_map::Landmark& landmark =
+        store_vertex.getLandmarks().getLandmark(landmark_id);
+    landmark.removeAllObservationsAccordingToPredicate(is_observed_by_mission);
+    if (!landmark.hasObservations()) {
+      store_vertex.getLandmarks().removeLandmark(landmark_id);
+      landmarks_to_remove.push_back(landmark_id);
+    }
+  }
+  change_tracker_.markLandmarkIndexChanged();
+  landmark_index.removeLandmarks(landmarks_to_remove);
 
-    // Remove references to global landmarks and landmark backlinks.
-    for (unsigned int frame_idx = 0u; frame_idx < vertex->numFrames();
+  for (const pose_graph::VertexId& vertex_id : vertices) {
+    vi_map::Vertex& vertex = getVertex(vertex_id);
+    vertex.setLandmarks(vi_map::LandmarkStore());
+    for (unsigned int frame_idx = 0u; frame_idx < vertex.numFrames();
          ++frame_idx) {
-      vi_map::LandmarkIdList frame_landmark_ids;
-      vertex->getFrameObservedLandmarkIds(frame_idx, &frame_landmark_ids);
-
-      for (size_t i = 0; i < frame_landmark_ids.size(); ++i) {
-        if (frame_landmark_ids[i].isValid()) {
-          const vi_map::LandmarkId& landmark_id = frame_landmark_ids[i];
-
-          vi_map::Landmark& landmark = getLandmark(landmark_id);
-          landmark.removeAllObservationsOfVertex(vertex_id);
-
-          // Also clean up the global landmark id list in the current vertex
-          // so that we feed a consistent state to the removeVertex method
-          // below.
-          vi_map::LandmarkId invalid_landmark_id;
-          invalid_landmark_id.setInvalid();
-          vertex->setObservedLandmarkId(frame_idx, i, invalid_landmark_id);
-
-          // If the current vertex was the only observer of the landmark stored
-          // in some other mission, we should remove this orphaned landmark.
-          if (getMissionIdForLandmark(landmark_id) != mission_id &&
-              !landmark.hasObservations()) {
-            removeLandmark(landmark.id());
-          }
-        }
+      const size_t num_observed_landmarks =
+          vertex.observedLandmarkIdsSize(frame_idx);
+      for (size_t i = 0u; i < num_observed_landmarks; ++i) {
+        vertex.setObservedLandmarkId(frame_idx, i, invalid_landmark_id);
       }
     }
-
     removeVertex(vertex_id);
   }
 
@@ -1627,6 +2266,7 @@ void VIMap::removeMissionObject(
   CHECK(!mission.getRootVertexId().isValid())
       << "Root vertex ID of a mission you want to delete should be invalid.";
 
+  change_tracker_.markMissionsChanged();
   if (remove_baseframe) {
     mission_base_frames.erase(mission.getBaseFrameId());
   }
@@ -2128,6 +2768,44 @@ void VIMap::deleteResourceIdForMissions(
 
 // NOTE: [ADD_RESOURCE_TYPE] [ADD_RESOURCE_DATA_TYPE] Add a switch case if the
 // resource is a frame resource.
+bool VIMap::getFramePointCloudRegion(
+    const Vertex& vertex, const unsigned int frame_idx,
+    const backend::ResourceType& type, const Eigen::AlignedBox3f& region,
+    const double level_of_detail, resources::PointCloud* point_cloud) const {
+  CHECK_NOTNULL(point_cloud);
+  std::lock_guard<std::recursive_mutex> lock(resource_mutex_);
+  backend::ResourceIdSet resource_ids;
+  vertex.getFrameResourceIdsOfType(frame_idx, type, &resource_ids);
+  if (resource_ids.size() == 1u) {
+    return getPointCloudRegion(
+        *(resource_ids.begin()), type, region, level_of_detail, point_cloud);
+  } else if (resource_ids.size() > 1u) {
+    LOG(FATAL) << "VisualFrame " << frame_idx << " of Vertex " << vertex.id()
+               << " has an invalid number (" << resource_ids.size()
+               << ") of resources of type "
+               << backend::ResourceTypeNames[static_cast<size_t>(type)] << ".";
+  }
+  return false;
+}
+
+bool VIMap::getFrameResourceFilePath(
+    const Vertex& vertex, const unsigned int frame_idx,
+    const backend::ResourceType& type, std::string* file_path) const {
+  CHECK_NOTNULL(file_path);
+  std::lock_guard<std::recursive_mutex> lock(resource_mutex_);
+  backend::ResourceIdSet resource_ids;
+  vertex.getFrameResourceIdsOfType(frame_idx, type, &resource_ids);
+  if (resource_ids.size() == 1u) {
+    return getResourceFilePath(*(resource_ids.begin()), type, file_path);
+  } else if (resource_ids.size() > 1u) {
+    LOG(FATAL) << "VisualFrame " << frame_idx << " of Vertex " << vertex.id()
+               << " has an invalid number (" << resource_ids.size()
+               << ") of resources of type "
+               << backend::ResourceTypeNames[static_cast<size_t>(type)] << ".";
+  }
+  return false;
+}
+
 void VIMap::deleteAllFrameResources(
     const unsigned int frame_idx, Vertex* vertex_ptr) {
   CHECK_NOTNULL(vertex_ptr);
@@ -2218,6 +2896,7 @@ bool VIMap::findAllCloseOptionalCameraResources(
 
 OptionalSensorData& VIMap::getOptionalSensorData(const MissionId& mission_id) {
   CHECK(hasMission(mission_id));
+  change_tracker_.markOptionalSensorDataChanged();
   return common::getChecked(optional_sensor_data_map_, mission_id);
 }
 
@@ -1,9 +1,11 @@
 #include "vi-map/vi-mission.h"
 
 #include <ostream>  // NOLINT
+#include <vector>
 
 #include <aslam-serialization/camera-serialization.h>
 #include <aslam/cameras/camera-factory.h>
+#include <map-resources/optional-sensor-resource-index.h>
 #include <maplab-common/aslam-id-proto.h>
 #include <maplab-common/eigen-proto.h>
 #include <maplab-common/quaternion-math.h>
@@ -567,6 +569,45 @@ bool VIMission::findAllCloseOptionalCameraResources(
   return num_resources_found > 0u;
 }
 
+bool VIMission::associateOptionalCameraResources(
+    const backend::ResourceType& type,
+    const std::vector<int64_t>& timestamps_ns, const int64_t tolerance_ns,
+    aslam::CameraIdList* camera_ids,
+    std::vector<std::vector<int64_t>>* closest_timestamps_ns) const {
+  CHECK_NOTNULL(camera_ids)->clear();
+  CHECK_NOTNULL(closest_timestamps_ns)->clear();
+
+  const backend::OptionalCameraResourcesMap* optional_resources =
+      getAllOptionalCameraResourceIdsOfType(type);
+
+  if (optional_resources == nullptr) {
+    return false;
+  }
+
+  std::vector<size_t> closest_indices;
+  for (const backend::OptionalCameraResourcesMap::value_type&
+           resources_per_camera : *optional_resources) {
+    const backend::OptionalSensorResourceIndex index(
+        resources_per_camera.second);
+    index.associateClosestIndices(
+        timestamps_ns, tolerance_ns, &closest_indices);
+
+    camera_ids->push_back(resources_per_camera.first);
+    closest_timestamps_ns->emplace_back(timestamps_ns.size(), -1);
+    std::vector<int64_t>& closest_timestamps_ns_of_camera =
+        closest_timestamps_ns->back();
+    for (size_t idx = 0u; idx < closest_indices.size(); ++idx) {
+      if (closest_indices[idx] !=
+          backend::OptionalSensorResourceIndex::kInvalidIndex) {
+        closest_timestamps_ns_of_camera[idx] =
+            index.getTimestampNs(closest_indices[idx]);
+      }
+    }
+  }
+
+  return !camera_ids->empty();
+}
+
 const backend::OptionalCameraMap&
 VIMission::getOptionalCameraWithExtrinsicsMap() const {
   return optional_cameras_;
@@ -1,3 +1,5 @@
+#include <utility>
+
 #include <glog/logging.h>
 #include <maplab-common/eigen-proto.h>
 #include <vi-map/viwls-edge.h>
@@ -17,6 +19,17 @@ ViwlsEdge::ViwlsEdge(
   CHECK_EQ(imu_timestamps.cols(), imu_data.cols());
 }
 
+ViwlsEdge::ViwlsEdge(
+    const pose_graph::EdgeId& id, const pose_graph::VertexId& from,
+    const pose_graph::VertexId& to,
+    Eigen::Matrix<int64_t, 1, Eigen::Dynamic>&& imu_timestamps,
+    Eigen::Matrix<double, 6, Eigen::Dynamic>&& imu_data)
+    : vi_map::Edge(pose_graph::Edge::EdgeType::kViwls, id, from, to),
+      imu_timestamps_(std::move(imu_timestamps)),
+      imu_data_(std::move(imu_data)) {
+  CHECK_EQ(imu_timestamps_.cols(), imu_data_.cols());
+}
+
 ViwlsEdge::ViwlsEdge(
     const pose_graph::EdgeId& id, const pose_graph::VertexId& from,
     const pose_graph::VertexId& to)
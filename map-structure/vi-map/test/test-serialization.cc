@@ -1,9 +1,16 @@
+#include <string>
+#include <vector>
+
+#include <maplab-common/file-system-tools.h>
+#include <maplab-common/map-manager-config.h>
 #include <maplab-common/network-common.h>
 #include <maplab-common/test/testing-entrypoint.h>
 
+#include "vi-map/frame-sections.h"
 #include "vi-map/test/vi-map-generator.h"
 #include "vi-map/test/vi-map-test-helpers.h"
 #include "vi-map/vi-map-serialization.h"
+#include "vi-map/vi-map-summary.h"
 #include "vi-map/vi-map.h"
 
 void deleteRawData(const network::RawMessageDataList& raw_data) {
@@ -26,6 +33,75 @@ TEST(Serialization, SerializeMapToRawArray) {
   deleteRawData(raw_data);
 }
 
+TEST(Serialization, ApplyMapDeltaToEmptyMap) {
+  vi_map::VIMap test_map, synced_map;
+  vi_map::test::generateMap(&test_map);
+
+  vi_map::serialization::MapDeltaBase base;
+  vi_map::serialization::computeMapDeltaBase(synced_map, &base);
+  network::RawMessageDataList raw_data;
+  vi_map::serialization::MapDeltaStatistics statistics;
+  vi_map::serialization::serializeMapDeltaToRawArray(
+      test_map, base, &raw_data, &statistics);
+  EXPECT_EQ(test_map.numMissions(), statistics.num_new_missions);
+  EXPECT_EQ(test_map.numVertices(), statistics.num_new_vertices);
+  EXPECT_EQ(0u, statistics.num_changed_vertices);
+
+  constexpr size_t kStartIndex = 0u;
+  const std::string kNoResourceFolder;
+  vi_map::serialization::applyMapDeltaFromRawArray(
+      raw_data, kStartIndex, kNoResourceFolder, &synced_map, &statistics);
+  EXPECT_EQ(test_map.numVertices(), statistics.num_new_vertices);
+  EXPECT_TRUE(vi_map::test::compareVIMap(test_map, synced_map));
+  deleteRawData(raw_data);
+}
+
+TEST(Serialization, ApplyMapDeltaWithChangedVertex) {
+  vi_map::VIMap test_map, synced_map;
+  vi_map::test::generateMap(&test_map);
+  network::RawMessageDataList raw_data;
+  vi_map::serialization::serializeToRawArray(test_map, &raw_data);
+  constexpr size_t kStartIndex = 0u;
+  vi_map::serialization::deserializeFromRawArray(
+      raw_data, kStartIndex, &synced_map);
+  deleteRawData(raw_data);
+  raw_data.clear();
+
+  // The base is sent by the server and received by the robot.
+  vi_map::serialization::MapDeltaBase server_base;
+  vi_map::serialization::computeMapDeltaBase(synced_map, &server_base);
+  vi_map::serialization::serializeMapDeltaBaseToRawArray(
+      server_base, &raw_data);
+  vi_map::serialization::MapDeltaBase base;
+  vi_map::serialization::deserializeMapDeltaBaseFromRawArray(
+      raw_data, kStartIndex, &base);
+  deleteRawData(raw_data);
+  raw_data.clear();
+  EXPECT_EQ(server_base.vertex_fingerprints, base.vertex_fingerprints);
+  EXPECT_EQ(server_base.edge_ids, base.edge_ids);
+
+  pose_graph::VertexIdList vertex_ids;
+  test_map.getAllVertexIds(&vertex_ids);
+  ASSERT_FALSE(vertex_ids.empty());
+  vi_map::Vertex& vertex = test_map.getVertex(vertex_ids.front());
+  vertex.set_p_M_I(vertex.get_p_M_I() + Eigen::Vector3d::UnitX());
+
+  vi_map::serialization::MapDeltaStatistics statistics;
+  vi_map::serialization::serializeMapDeltaToRawArray(
+      test_map, base, &raw_data, &statistics);
+  EXPECT_EQ(0u, statistics.num_new_missions);
+  EXPECT_EQ(0u, statistics.num_new_vertices);
+  EXPECT_EQ(1u, statistics.num_changed_vertices);
+  EXPECT_EQ(0u, statistics.num_new_edges);
+
+  const std::string kNoResourceFolder;
+  vi_map::serialization::applyMapDeltaFromRawArray(
+      raw_data, kStartIndex, kNoResourceFolder, &synced_map, &statistics);
+  EXPECT_EQ(1u, statistics.num_changed_vertices);
+  EXPECT_TRUE(vi_map::test::compareVIMap(test_map, synced_map));
+  deleteRawData(raw_data);
+}
+
 TEST(Serialization, SerializeMapWithOptionalCameraResources) {
   const std::string test_folder = "SerializeMapWithOptionalCameraResources";
   const std::string map_folder = test_folder + "/" + "test_map";
@@ -47,4 +123,178 @@ TEST(Serialization, SerializeMapWithOptionalCameraResources) {
   deleteRawData(raw_data);
 }
 
+TEST(Serialization, SaveOnlyChangedMapFiles) {
+  const std::string map_folder = "SaveOnlyChangedMapFiles";
+  common::removeIfExistsAndCreatePath(map_folder);
+  const std::string proto_folder =
+      map_folder + "/" + vi_map::serialization::getSubFolderName();
+
+  constexpr size_t kNumVertices = 20u;
+  vi_map::VIMap test_map;
+  vi_map::test::generateMap(kNumVertices, &test_map);
+
+  backend::SaveConfig save_config;
+  save_config.overwrite_existing_files = true;
+  save_config.save_only_changes = true;
+  save_config.vertices_per_proto_file = 5u;
+  ASSERT_TRUE(
+      vi_map::serialization::saveMapToFolder(
+          map_folder, save_config, &test_map));
+
+  vi_map::VIMap loaded_map;
+  ASSERT_TRUE(
+      vi_map::serialization::loadMapFromFolder(map_folder, &loaded_map));
+  const vi_map::MapChangeTracker& change_tracker =
+      loaded_map.getChangeTracker();
+  EXPECT_TRUE(change_tracker.isTrackingFolder(proto_folder));
+  EXPECT_EQ(change_tracker.getNumVertexProtoFiles(), 4u);
+  EXPECT_EQ(change_tracker.getNumChangedProtoFiles(), 0u);
+
+  pose_graph::VertexIdList vertex_ids;
+  loaded_map.getAllVertexIds(&vertex_ids);
+  ASSERT_FALSE(vertex_ids.empty());
+  vi_map::Vertex& vertex = loaded_map.getVertex(vertex_ids.front());
+  vertex.set_v_M(Eigen::Vector3d(1.0, 2.0, 3.0));
+  EXPECT_EQ(change_tracker.getNumChangedProtoFiles(), 1u);
+  const int changed_vertex_file = vertex.getVertexFileIndex();
+  ASSERT_GE(changed_vertex_file, 0);
+
+  // Files that are not rewritten by the next save stay deleted.
+  const std::string missions_file = proto_folder + "/missions";
+  const std::string changed_vertex_file_path =
+      proto_folder + "/vertices" + std::to_string(changed_vertex_file);
+  ASSERT_TRUE(common::fileExists(missions_file));
+  ASSERT_TRUE(common::deleteFile(missions_file));
+  ASSERT_TRUE(common::deleteFile(changed_vertex_file_path));
+
+  ASSERT_TRUE(
+      vi_map::serialization::saveMapToFolder(
+          map_folder, save_config, &loaded_map));
+  EXPECT_FALSE(common::fileExists(missions_file));
+  EXPECT_TRUE(common::fileExists(changed_vertex_file_path));
+  EXPECT_EQ(change_tracker.getNumChangedProtoFiles(), 0u);
+
+  // A full save restores the missions, after which the map is unchanged.
+  save_config.save_only_changes = false;
+  ASSERT_TRUE(
+      vi_map::serialization::saveMapToFolder(
+          map_folder, save_config, &loaded_map));
+  EXPECT_TRUE(common::fileExists(missions_file));
+
+  vi_map::VIMap reloaded_map;
+  ASSERT_TRUE(
+      vi_map::serialization::loadMapFromFolder(map_folder, &reloaded_map));
+  EXPECT_TRUE(vi_map::test::compareVIMap(loaded_map, reloaded_map));
+}
+
+TEST(Serialization, SaveAndLoadWithAllProtoCompressions) {
+  const std::string test_folder = "SaveAndLoadWithAllProtoCompressions";
+  common::removeIfExistsAndCreatePath(test_folder);
+
+  constexpr size_t kNumVertices = 20u;
+  vi_map::VIMap test_map;
+  vi_map::test::generateMap(kNumVertices, &test_map);
+
+  const std::vector<backend::SaveConfig::ProtoCompression> compressions = {
+      backend::SaveConfig::ProtoCompression::kFromFlags,
+      backend::SaveConfig::ProtoCompression::kNone,
+      backend::SaveConfig::ProtoCompression::kFast,
+      backend::SaveConfig::ProtoCompression::kBest};
+  for (size_t i = 0u; i < compressions.size(); ++i) {
+    const std::string map_folder = test_folder + "/map_" + std::to_string(i);
+    backend::SaveConfig save_config;
+    save_config.vertices_per_proto_file = 5u;
+    save_config.proto_compression = compressions[i];
+    ASSERT_TRUE(
+        vi_map::serialization::saveMapToFolder(
+            map_folder, save_config, &test_map));
+
+    vi_map::VIMap loaded_map;
+    ASSERT_TRUE(
+        vi_map::serialization::loadMapFromFolder(map_folder, &loaded_map));
+    EXPECT_TRUE(vi_map::test::compareVIMap(test_map, loaded_map));
+  }
+}
+
+TEST(Serialization, SaveAndLoadFrameArraysInSections) {
+  const std::string map_folder = "SaveAndLoadFrameArraysInSections";
+  common::removeIfExistsAndCreatePath(map_folder);
+  const std::string sections_file =
+      map_folder + "/" + vi_map::serialization::getSubFolderName() +
+      "/vertices0" + vi_map::serialization::kFrameSectionsFileSuffix;
+
+  constexpr size_t kNumVertices = 20u;
+  vi_map::VIMap test_map;
+  vi_map::test::generateMap(kNumVertices, &test_map);
+
+  backend::SaveConfig save_config;
+  save_config.overwrite_existing_files = true;
+  save_config.vertices_per_proto_file = 5u;
+  save_config.store_frame_arrays_in_sections = true;
+  ASSERT_TRUE(
+      vi_map::serialization::saveMapToFolder(
+          map_folder, save_config, &test_map));
+  EXPECT_TRUE(common::fileExists(sections_file));
+
+  vi_map::VIMap loaded_map;
+  ASSERT_TRUE(
+      vi_map::serialization::loadMapFromFolder(map_folder, &loaded_map));
+  EXPECT_TRUE(vi_map::test::compareVIMap(test_map, loaded_map));
+
+  // Saving without sections removes the stale files.
+  save_config.store_frame_arrays_in_sections = false;
+  ASSERT_TRUE(
+      vi_map::serialization::saveMapToFolder(
+          map_folder, save_config, &loaded_map));
+  EXPECT_FALSE(common::fileExists(sections_file));
+
+  vi_map::VIMap reloaded_map;
+  ASSERT_TRUE(
+      vi_map::serialization::loadMapFromFolder(map_folder, &reloaded_map));
+  EXPECT_TRUE(vi_map::test::compareVIMap(test_map, reloaded_map));
+}
+
+TEST(Serialization, SaveAndLoadMapSummary) {
+  const std::string map_folder = "SaveAndLoadMapSummary";
+  common::removeIfExistsAndCreatePath(map_folder);
+  vi_map::proto::MapSummary summary;
+  EXPECT_FALSE(
+      vi_map::serialization::loadMapSummaryFromFolder(map_folder, &summary));
+
+  vi_map::VIMap test_map;
+  vi_map::test::generateMap(&test_map);
+  backend::SaveConfig save_config;
+  save_config.overwrite_existing_files = true;
+  ASSERT_TRUE(
+      vi_map::serialization::saveMapToFolder(
+          map_folder, save_config, &test_map));
+
+  ASSERT_TRUE(
+      vi_map::serialization::loadMapSummaryFromFolder(map_folder, &summary));
+  EXPECT_EQ(
+      vi_map::serialization::kMapSummaryFormatVersion,
+      summary.format_version());
+  ASSERT_EQ(
+      test_map.numMissions(), static_cast<size_t>(summary.missions_size()));
+  EXPECT_EQ(test_map.numEdges(), summary.num_edges());
+  uint64_t num_vertices = 0u;
+  uint64_t num_landmarks = 0u;
+  for (const vi_map::proto::MapSummary::Mission& mission :
+       summary.missions()) {
+    vi_map::MissionId mission_id;
+    mission_id.deserialize(mission.mission_id());
+    EXPECT_TRUE(test_map.hasMission(mission_id));
+    num_vertices += mission.num_vertices();
+    num_landmarks += mission.num_landmarks();
+    ASSERT_EQ(3, mission.bounding_box_min_G_size());
+    ASSERT_EQ(3, mission.bounding_box_max_G_size());
+    for (int dim = 0; dim < 3; ++dim) {
+      EXPECT_LE(
+          mission.bounding_box_min_G(dim), mission.bounding_box_max_G(dim));
+    }
+  }
+  EXPECT_EQ(test_map.numVertices(), num_vertices);
+  EXPECT_EQ(test_map.numLandmarks(), num_landmarks);
+}
+
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,92 @@
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/cameras/camera-unified-projection.h>
+#include <aslam/cameras/distortion-equidistant.h>
+#include <aslam/cameras/distortion-radtan.h>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "vi-map/camera-batch-projection.h"
+
+namespace vi_map {
+
+// Random points in front of, next to and behind the camera, such that all
+// projection results are covered.
+Eigen::Matrix3Xd generateTestPoints(const size_t num_points) {
+  Eigen::Matrix3Xd points = Eigen::Matrix3Xd::Random(3, num_points);
+  points.row(2) *= 5.0;
+  points.row(2).array() += 2.0;
+  return points;
+}
+
+void expectSameAsSingleProjections(
+    const aslam::Camera& camera, const Eigen::Matrix3Xd& points_C) {
+  Eigen::Matrix2Xd keypoints;
+  std::vector<aslam::ProjectionResult> projection_results;
+  projectPointsIntoCamera(camera, points_C, &keypoints, &projection_results);
+  ASSERT_EQ(points_C.cols(), keypoints.cols());
+  ASSERT_EQ(static_cast<size_t>(points_C.cols()), projection_results.size());
+
+  for (int idx = 0; idx < points_C.cols(); ++idx) {
+    Eigen::Vector2d keypoint;
+    const aslam::ProjectionResult projection_result =
+        camera.project3(points_C.col(idx), &keypoint);
+    EXPECT_EQ(
+        projection_result.getDetailedStatus(),
+        projection_results[idx].getDetailedStatus());
+    if (projection_result.isKeypointVisible()) {
+      EXPECT_NEAR(keypoint(0), keypoints(0, idx), 1e-6);
+      EXPECT_NEAR(keypoint(1), keypoints(1, idx), 1e-6);
+    }
+  }
+}
+
+TEST(CameraBatchProjectionTest, PinholeWithoutDistortion) {
+  const aslam::Camera::Ptr camera = aslam::PinholeCamera::createTestCamera();
+  // Not a multiple of the chunk size, such that the padding is covered.
+  expectSameAsSingleProjections(*camera, generateTestPoints(1001u));
+}
+
+TEST(CameraBatchProjectionTest, PinholeWithRadTanDistortion) {
+  const aslam::Camera::Ptr camera =
+      aslam::PinholeCamera::createTestCamera<aslam::RadTanDistortion>();
+  expectSameAsSingleProjections(*camera, generateTestPoints(1001u));
+}
+
+TEST(CameraBatchProjectionTest, PinholeWithEquidistantDistortion) {
+  const aslam::Camera::Ptr camera =
+      aslam::PinholeCamera::createTestCamera<aslam::EquidistantDistortion>();
+  expectSameAsSingleProjections(*camera, generateTestPoints(1001u));
+}
+
+TEST(CameraBatchProjectionTest, UnsupportedCameraFallsBack) {
+  const aslam::Camera::Ptr camera =
+      aslam::UnifiedProjectionCamera::createTestCamera<
+          aslam::RadTanDistortion>();
+  expectSameAsSingleProjections(*camera, generateTestPoints(101u));
+}
+
+TEST(CameraBatchProjectionTest, VisibilityOfGlobalPoints) {
+  const aslam::Camera::Ptr camera =
+      aslam::PinholeCamera::createTestCamera<aslam::RadTanDistortion>();
+  const aslam::Transformation T_C_G(
+      aslam::Quaternion(), Eigen::Vector3d(0.1, -0.2, 0.3));
+  const Eigen::Matrix3Xd points_G = generateTestPoints(500u);
+
+  std::vector<char> is_visible;
+  getPointsVisibleInCamera(*camera, T_C_G, points_G, &is_visible);
+  ASSERT_EQ(static_cast<size_t>(points_G.cols()), is_visible.size());
+  for (int idx = 0; idx < points_G.cols(); ++idx) {
+    Eigen::Vector2d keypoint;
+    EXPECT_EQ(
+        camera->project3(T_C_G * points_G.col(idx), &keypoint)
+            .isKeypointVisible(),
+        is_visible[idx] != 0);
+  }
+}
+
+}  // namespace vi_map
+
+MAPLAB_UNITTEST_ENTRYPOINT
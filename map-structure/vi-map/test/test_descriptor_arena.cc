@@ -0,0 +1,80 @@
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "vi-map/descriptor-arena.h"
+#include "vi-map/test/vi-map-test-helpers.h"
+#include "vi-map/vertex.h"
+#include "vi-map/vi-map.h"
+
+namespace vi_map {
+
+class DescriptorArenaTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    test::generateMap(&map_);
+  }
+
+  VIMap map_;
+};
+
+TEST_F(DescriptorArenaTest, ArenaMatchesFrameDescriptors) {
+  const DescriptorArena arena(map_, map_.getIdOfFirstMission());
+
+  pose_graph::VertexIdList vertex_ids;
+  map_.getAllVertexIds(&vertex_ids);
+  size_t num_descriptors = 0u;
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    const Vertex& vertex = map_.getVertex(vertex_id);
+    for (size_t frame_idx = 0u; frame_idx < vertex.numFrames(); ++frame_idx) {
+      const aslam::VisualFrame::DescriptorsT& descriptors =
+          vertex.getVisualFrame(frame_idx).getDescriptors();
+      num_descriptors += descriptors.cols();
+      if (descriptors.cols() == 0) {
+        continue;
+      }
+      const VisualFrameIdentifier frame_id(vertex_id, frame_idx);
+      ASSERT_TRUE(arena.hasFrame(frame_id));
+      EXPECT_TRUE(arena.getFrameDescriptors(frame_id) == descriptors);
+      // The descriptors of a frame are stored contiguously.
+      EXPECT_EQ(
+          arena.getDescriptor(KeypointIdentifier(frame_id, 0u)) +
+              (descriptors.cols() - 1) * descriptors.rows(),
+          arena.getDescriptor(
+              KeypointIdentifier(frame_id, descriptors.cols() - 1)));
+    }
+  }
+  ASSERT_GT(num_descriptors, 0u);
+  EXPECT_EQ(num_descriptors, arena.numDescriptors());
+
+  size_t num_visited = 0u;
+  arena.forEachDescriptor(
+      [&](const KeypointIdentifier& keypoint_id,
+          const DescriptorArena::DescriptorsT::ConstColXpr& descriptor) {
+        const aslam::VisualFrame& frame =
+            map_.getVertex(keypoint_id.frame_id.vertex_id)
+                .getVisualFrame(keypoint_id.frame_id.frame_index);
+        EXPECT_TRUE(
+            descriptor ==
+            frame.getDescriptors().col(keypoint_id.keypoint_index));
+        ++num_visited;
+      });
+  EXPECT_EQ(num_descriptors, num_visited);
+}
+
+TEST_F(DescriptorArenaTest, GatherLandmarkDescriptors) {
+  const DescriptorArena arena(map_, map_.getIdOfFirstMission());
+  LandmarkIdList landmark_ids;
+  map_.getAllLandmarkIds(&landmark_ids);
+  ASSERT_FALSE(landmark_ids.empty());
+  for (const LandmarkId& landmark_id : landmark_ids) {
+    VIMap::DescriptorsType expected_descriptors;
+    map_.getLandmarkDescriptors(landmark_id, &expected_descriptors);
+    DescriptorArena::DescriptorsT descriptors;
+    arena.getDescriptorsOfObservations(
+        map_.getLandmark(landmark_id).getObservations(), &descriptors);
+    EXPECT_TRUE(expected_descriptors == descriptors);
+  }
+}
+
+}  // namespace vi_map
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -1,3 +1,4 @@
+#include <utility>
 #include <vector>
 
 #include <aslam/common/memory.h>
@@ -540,6 +541,44 @@ TEST_F(
   // Frame Index:  {}.
   EXPECT_DEATH(landmark_.getAppearances(), "");
 }
+
+TEST_F(LandmarkTest, TestCopyAndMove) {
+  KeypointIdentifierList observations;
+  generateObservations(5u, &observations);
+  landmark_.addObservations(observations);
+  allocateIncrementalAppearances();
+  landmark_.set_p_B(pose::Position3D(1.0, 2.0, 3.0));
+  landmark_.set_p_B_Covariance(Eigen::Matrix3d::Identity());
+
+  // Copies are deep, such that changing the copy leaves the original intact.
+  Landmark copy = landmark_;
+  EXPECT_EQ(copy, landmark_);
+  EXPECT_EQ(copy.getObservations(), observations);
+  EXPECT_TRUE(verifyIncrementalAppearances(copy));
+  copy.removeObservation(0u);
+  copy.unsetCovariance();
+  EXPECT_EQ(landmark_.getObservations(), observations);
+  EXPECT_NE(copy, landmark_);
+
+  // Assigning a landmark without covariance removes the covariance.
+  Landmark without_covariance = landmark_;
+  without_covariance = copy;
+  Eigen::Matrix3d covariance;
+  EXPECT_FALSE(without_covariance.get_p_B_Covariance(&covariance));
+
+  Landmark moved = std::move(copy);
+  EXPECT_EQ(moved.getObservations().size(), observations.size() - 1u);
+  EXPECT_EQ(moved.get_p_B(), landmark_.get_p_B());
+
+  // Landmarks without any observations need no out-of-line data.
+  Landmark empty_landmark;
+  EXPECT_FALSE(empty_landmark.hasObservations());
+  EXPECT_FALSE(empty_landmark.areAppearancesAllocated());
+  EXPECT_FALSE(empty_landmark.get_p_B_Covariance(&covariance));
+  empty_landmark.removeAllObservationsOfVertex(
+      observations[0].frame_id.vertex_id);
+  EXPECT_EQ(empty_landmark, Landmark());
+}
 }  // namespace vi_map
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,115 @@
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "vi-map/landmark-handles.h"
+#include "vi-map/test/vi-map-test-helpers.h"
+#include "vi-map/vi-map.h"
+
+namespace vi_map {
+
+class LandmarkHandleTableTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    vi_map::test::generateMap(kNumVertices, &map_);
+    ASSERT_GT(map_.numLandmarks(), 0u);
+  }
+
+  // Compares the table with the observations and landmark stores of the map.
+  void expectTableMatchesMap(const LandmarkHandleTable& table) {
+    pose_graph::VertexIdList vertex_ids;
+    map_.getAllVertexIds(&vertex_ids);
+    for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+      const VertexHandle vertex_handle = table.getVertexHandle(vertex_id);
+      ASSERT_NE(kInvalidVertexHandle, vertex_handle);
+      EXPECT_EQ(vertex_id, table.getVertexId(vertex_handle));
+
+      const Vertex& vertex = map_.getVertex(vertex_id);
+      ASSERT_EQ(vertex.numFrames(), table.numFrames(vertex_handle));
+      for (size_t frame_idx = 0u; frame_idx < vertex.numFrames();
+           ++frame_idx) {
+        const LandmarkIdList& landmark_ids =
+            vertex.getFrameObservedLandmarkIds(frame_idx);
+        const std::vector<LandmarkHandle>& landmark_handles =
+            table.getFrameObservedLandmarks(vertex_handle, frame_idx);
+        ASSERT_EQ(landmark_ids.size(), landmark_handles.size());
+        for (size_t idx = 0u; idx < landmark_ids.size(); ++idx) {
+          if (landmark_ids[idx].isValid()) {
+            EXPECT_EQ(
+                landmark_ids[idx], table.getLandmarkId(landmark_handles[idx]));
+          } else {
+            EXPECT_EQ(kInvalidLandmarkHandle, landmark_handles[idx]);
+          }
+        }
+      }
+
+      for (const Landmark& landmark : vertex.getLandmarks()) {
+        const LandmarkHandle landmark_handle =
+            table.getLandmarkHandle(landmark.id());
+        ASSERT_NE(kInvalidLandmarkHandle, landmark_handle);
+        EXPECT_EQ(landmark.id(), table.getLandmarkId(landmark_handle));
+        EXPECT_EQ(vertex_handle, table.getStoringVertex(landmark_handle));
+
+        const std::vector<FrameHandle>& frames =
+            table.getObservingFrames(landmark_handle);
+        ASSERT_EQ(landmark.numberOfObservations(), frames.size());
+        size_t observation_idx = 0u;
+        landmark.forEachObservation(
+            [&](const KeypointIdentifier& keypoint_id) {
+              const FrameHandle& frame = frames[observation_idx++];
+              EXPECT_EQ(
+                  keypoint_id.frame_id.vertex_id,
+                  table.getVertexId(frame.vertex));
+              EXPECT_EQ(keypoint_id.frame_id.frame_index, frame.frame_index);
+            });
+      }
+    }
+  }
+
+  static constexpr size_t kNumVertices = 50u;
+  VIMap map_;
+};
+
+constexpr size_t LandmarkHandleTableTest::kNumVertices;
+
+TEST_F(LandmarkHandleTableTest, TableMatchesMap) {
+  const LandmarkHandleTable table(map_);
+  EXPECT_EQ(map_.numLandmarks(), table.numLandmarkHandles());
+  EXPECT_EQ(map_.numVertices(), table.numVertexHandles());
+  expectTableMatchesMap(table);
+
+  LandmarkId unknown_landmark_id;
+  common::generateId(&unknown_landmark_id);
+  EXPECT_EQ(
+      kInvalidLandmarkHandle, table.getLandmarkHandle(unknown_landmark_id));
+}
+
+TEST_F(LandmarkHandleTableTest, HandlesArePersistentAcrossUpdates) {
+  LandmarkHandleTable table(map_);
+  LandmarkIdList landmark_ids;
+  map_.getAllLandmarkIds(&landmark_ids);
+  std::vector<LandmarkHandle> handles_before;
+  for (const LandmarkId& landmark_id : landmark_ids) {
+    handles_before.push_back(table.getLandmarkHandle(landmark_id));
+  }
+
+  const LandmarkId removed_landmark_id = landmark_ids.front();
+  map_.removeLandmark(removed_landmark_id);
+  table.update(map_);
+
+  // The removed landmark keeps its handle, but has no data anymore.
+  EXPECT_EQ(landmark_ids.size(), table.numLandmarkHandles());
+  for (size_t idx = 0u; idx < landmark_ids.size(); ++idx) {
+    EXPECT_EQ(handles_before[idx], table.getLandmarkHandle(landmark_ids[idx]));
+  }
+  const LandmarkHandle removed_handle = handles_before.front();
+  EXPECT_EQ(kInvalidVertexHandle, table.getStoringVertex(removed_handle));
+  EXPECT_TRUE(table.getObservingFrames(removed_handle).empty());
+  expectTableMatchesMap(table);
+}
+
+}  // namespace vi_map
+
+MAPLAB_UNITTEST_ENTRYPOINT
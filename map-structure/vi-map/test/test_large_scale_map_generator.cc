@@ -0,0 +1,150 @@
+#include <algorithm>
+
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "vi-map/check-map-consistency.h"
+#include "vi-map/test/large-scale-map-generator.h"
+#include "vi-map/vi-map.h"
+
+namespace vi_map {
+
+class LargeScaleMapGeneratorTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    options_.num_missions = 3u;
+    options_.num_vertices_per_mission = 50u;
+    options_.num_landmarks_per_vertex = 4u;
+    options_.track_length = 5u;
+    options_.num_threads = 4u;
+  }
+
+  size_t getExpectedNumObservations() const {
+    size_t num_observations = 0u;
+    for (size_t vertex_idx = 0u;
+         vertex_idx < options_.num_vertices_per_mission; ++vertex_idx) {
+      num_observations += std::min(vertex_idx + 1u, options_.track_length) *
+                          options_.num_landmarks_per_vertex;
+    }
+    return num_observations * options_.num_missions;
+  }
+
+  // Returns the number of observations and the number of landmarks observed
+  // by more than one mission.
+  void countObservations(
+      const VIMap& map, size_t* num_observations,
+      size_t* num_landmarks_observed_in_multiple_missions) const {
+    CHECK_NOTNULL(num_observations);
+    CHECK_NOTNULL(num_landmarks_observed_in_multiple_missions);
+    *num_observations = 0u;
+    *num_landmarks_observed_in_multiple_missions = 0u;
+    LandmarkIdSet landmark_ids;
+    map.getAllLandmarkIds(&landmark_ids);
+    for (const LandmarkId& landmark_id : landmark_ids) {
+      MissionIdSet observer_missions;
+      for (const KeypointIdentifier& observation :
+           map.getLandmark(landmark_id).getObservations()) {
+        observer_missions.insert(
+            map.getVertex(observation.frame_id.vertex_id).getMissionId());
+        ++(*num_observations);
+      }
+      if (observer_missions.size() > 1u) {
+        ++(*num_landmarks_observed_in_multiple_missions);
+      }
+    }
+  }
+
+  LargeScaleMapGeneratorOptions options_;
+};
+
+TEST_F(LargeScaleMapGeneratorTest, MissionsWithoutLoops) {
+  VIMap map;
+  LargeScaleMapGenerator(options_).generateMap(&map);
+
+  const size_t num_vertices =
+      options_.num_missions * options_.num_vertices_per_mission;
+  EXPECT_EQ(options_.num_missions, map.numMissions());
+  EXPECT_EQ(num_vertices, map.numVertices());
+  EXPECT_EQ(num_vertices - options_.num_missions, map.numEdges());
+  EXPECT_EQ(
+      num_vertices * options_.num_landmarks_per_vertex, map.numLandmarks());
+  EXPECT_TRUE(checkMapConsistency(map));
+
+  size_t num_observations, num_landmarks_observed_in_multiple_missions;
+  countObservations(
+      map, &num_observations, &num_landmarks_observed_in_multiple_missions);
+  EXPECT_EQ(getExpectedNumObservations(), num_observations);
+  EXPECT_EQ(0u, num_landmarks_observed_in_multiple_missions);
+}
+
+TEST_F(LargeScaleMapGeneratorTest, LoopsReuseLandmarksAcrossMissions) {
+  options_.num_vertices_per_loop = 20u;
+  options_.revisit_landmark_reuse_ratio = 0.5;
+  VIMap map;
+  LargeScaleMapGenerator(options_).generateMap(&map);
+
+  const size_t num_vertices =
+      options_.num_missions * options_.num_vertices_per_mission;
+  EXPECT_EQ(num_vertices, map.numVertices());
+  EXPECT_LT(
+      map.numLandmarks(), num_vertices * options_.num_landmarks_per_vertex);
+  EXPECT_TRUE(checkMapConsistency(map));
+
+  size_t num_observations, num_landmarks_observed_in_multiple_missions;
+  countObservations(
+      map, &num_observations, &num_landmarks_observed_in_multiple_missions);
+  EXPECT_EQ(getExpectedNumObservations(), num_observations);
+  EXPECT_GT(num_landmarks_observed_in_multiple_missions, 0u);
+}
+
+TEST_F(LargeScaleMapGeneratorTest, LoopsWithoutReuseOnlyDuplicateLandmarks) {
+  options_.num_vertices_per_loop = 20u;
+  options_.revisit_landmark_reuse_ratio = 0.0;
+  VIMap map;
+  LargeScaleMapGenerator(options_).generateMap(&map);
+
+  EXPECT_EQ(
+      map.numVertices() * options_.num_landmarks_per_vertex,
+      map.numLandmarks());
+  EXPECT_TRUE(checkMapConsistency(map));
+
+  size_t num_observations, num_landmarks_observed_in_multiple_missions;
+  countObservations(
+      map, &num_observations, &num_landmarks_observed_in_multiple_missions);
+  EXPECT_EQ(getExpectedNumObservations(), num_observations);
+  EXPECT_EQ(0u, num_landmarks_observed_in_multiple_missions);
+}
+
+TEST_F(LargeScaleMapGeneratorTest, SameSeedGivesSameMap) {
+  options_.num_vertices_per_loop = 20u;
+  VIMap map_a, map_b;
+  LargeScaleMapGenerator(options_).generateMap(&map_a);
+  options_.num_threads = 1u;
+  LargeScaleMapGenerator(options_).generateMap(&map_b);
+
+  pose_graph::VertexIdList vertex_ids_a, vertex_ids_b;
+  map_a.getAllVertexIds(&vertex_ids_a);
+  map_b.getAllVertexIds(&vertex_ids_b);
+  EXPECT_EQ(
+      pose_graph::VertexIdSet(vertex_ids_a.begin(), vertex_ids_a.end()),
+      pose_graph::VertexIdSet(vertex_ids_b.begin(), vertex_ids_b.end()));
+
+  LandmarkIdSet landmark_ids_a, landmark_ids_b;
+  map_a.getAllLandmarkIds(&landmark_ids_a);
+  map_b.getAllLandmarkIds(&landmark_ids_b);
+  EXPECT_EQ(landmark_ids_a, landmark_ids_b);
+  for (const LandmarkId& landmark_id : landmark_ids_a) {
+    EXPECT_EQ(
+        map_a.getLandmark_G_p_fi(landmark_id),
+        map_b.getLandmark_G_p_fi(landmark_id));
+  }
+
+  options_.seed += 1u;
+  VIMap map_c;
+  LargeScaleMapGenerator(options_).generateMap(&map_c);
+  EXPECT_FALSE(map_c.hasVertex(vertex_ids_a.front()));
+}
+
+}  // namespace vi_map
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -444,6 +444,40 @@ TEST_F(MapConsistencyCheckTest, MapConsistencyLoopClosureEdges) {
   EXPECT_TRUE(vi_map::checkMapConsistency(map_));
 }
 
+TEST_F(MapConsistencyCheckTest, MapConsistencySampled) {
+  constexpr double kSampleFraction = 0.25;
+  addMissionWithVisualNFrame();
+  EXPECT_TRUE(vi_map::checkMapConsistency(map_, kSampleFraction));
+
+  // The posegraph checks are never sampled.
+  addOrphanedVertex();
+  EXPECT_FALSE(vi_map::checkMapConsistency(map_, kSampleFraction));
+}
+
+TEST_F(MapConsistencyCheckTest, DeferredMapConsistencyCheck) {
+  addOrphanedVertex();
+  EXPECT_DEATH(
+      {
+        vi_map::ScopedDeferredConsistencyCheck consistency_check(map_);
+        {
+          // Nested scopes don't run the check.
+          vi_map::ScopedDeferredConsistencyCheck nested_check(map_);
+          EXPECT_TRUE(vi_map::checkMapConsistency(map_));
+        }
+        EXPECT_TRUE(vi_map::checkMapConsistency(map_));
+        LOG(INFO) << "Leaving the workflow.";
+      },
+      "Leaving the workflow(.|\n)*checkMapConsistency");
+
+  // The explicit overload is never deferred, and the deferral ends with the
+  // scope.
+  {
+    vi_map::ScopedDeferredConsistencyCheck consistency_check(map_);
+    EXPECT_FALSE(vi_map::checkMapConsistency(map_, 1.0));
+  }
+  EXPECT_FALSE(vi_map::checkMapConsistency(map_));
+}
+
 }  // namespace vi_map
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -1,6 +1,9 @@
 #include <string>
+#include <utility>
 
+#include <Eigen/Core>
 #include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
 
 #include "vi-map/test/vi-map-test-helpers.h"
 #include "vi-map/vi-map.h"
@@ -28,6 +31,115 @@ TEST_F(MergeMapTest, MergeIntoEmptyMap) {
   EXPECT_TRUE(test::compareVIMap(empty_map_, second_map));
 }
 
+TEST_F(MergeMapTest, DeepCopySharesVerticesUntilModified) {
+  vi_map::VIMap copied_map;
+  copied_map.deepCopy(map_);
+  const vi_map::VIMap& const_map = map_;
+  const vi_map::VIMap& const_copied_map = copied_map;
+
+  pose_graph::VertexIdList vertex_ids;
+  map_.getAllVertexIds(&vertex_ids);
+  ASSERT_GE(vertex_ids.size(), 2u);
+  const pose_graph::VertexId& modified_vertex_id = vertex_ids[0];
+  const pose_graph::VertexId& unmodified_vertex_id = vertex_ids[1];
+  EXPECT_EQ(
+      &const_map.getVertex(modified_vertex_id),
+      &const_copied_map.getVertex(modified_vertex_id));
+
+  const Eigen::Vector3d p_M_I =
+      const_map.getVertex(modified_vertex_id).get_p_M_I();
+  copied_map.getVertex(modified_vertex_id)
+      .set_p_M_I(p_M_I + Eigen::Vector3d::Ones());
+  EXPECT_NE(
+      &const_map.getVertex(modified_vertex_id),
+      &const_copied_map.getVertex(modified_vertex_id));
+  EXPECT_NEAR_EIGEN(
+      p_M_I, const_map.getVertex(modified_vertex_id).get_p_M_I(), 0.0);
+  EXPECT_NEAR_EIGEN(
+      p_M_I + Eigen::Vector3d::Ones(),
+      const_copied_map.getVertex(modified_vertex_id).get_p_M_I(), 0.0);
+  EXPECT_EQ(
+      &const_map.getVertex(unmodified_vertex_id),
+      &const_copied_map.getVertex(unmodified_vertex_id));
+}
+
+TEST_F(MergeMapTest, MergeByMovingIntoEmptyMap) {
+  vi_map::VIMap moved_map;
+  moved_map.deepCopy(map_);
+  empty_map_.mergeAllMissionsFromMap(std::move(moved_map));
+  EXPECT_TRUE(test::compareVIMap(map_, empty_map_));
+  EXPECT_EQ(0u, moved_map.numVertices());
+  EXPECT_EQ(0u, moved_map.numMissions());
+  EXPECT_EQ(0u, moved_map.numLandmarks());
+}
+
+TEST_F(MergeMapTest, MergeLandmarksInBatch) {
+  vi_map::LandmarkIdList landmark_ids;
+  map_.getAllLandmarkIds(&landmark_ids);
+  ASSERT_GE(landmark_ids.size(), 5u);
+  const size_t num_landmarks_before = map_.numLandmarks();
+
+  vi_map::KeypointIdentifierList observations_of_first_landmark;
+  map_.getLandmark(landmark_ids[0])
+      .forEachObservation([&](const vi_map::KeypointIdentifier& observation) {
+        observations_of_first_landmark.push_back(observation);
+      });
+
+  // Contains the chain 0 -> 1 -> 2 and a landmark merged into itself.
+  vi_map::LandmarkToLandmarkMap landmark_id_to_merge_to_into;
+  landmark_id_to_merge_to_into[landmark_ids[0]] = landmark_ids[1];
+  landmark_id_to_merge_to_into[landmark_ids[1]] = landmark_ids[2];
+  landmark_id_to_merge_to_into[landmark_ids[3]] = landmark_ids[2];
+  landmark_id_to_merge_to_into[landmark_ids[4]] = landmark_ids[4];
+  EXPECT_EQ(3u, map_.mergeLandmarks(landmark_id_to_merge_to_into));
+
+  EXPECT_TRUE(checkMapConsistency(map_));
+  EXPECT_EQ(num_landmarks_before - 3u, map_.numLandmarks());
+  EXPECT_FALSE(map_.hasLandmark(landmark_ids[0]));
+  EXPECT_FALSE(map_.hasLandmark(landmark_ids[1]));
+  EXPECT_FALSE(map_.hasLandmark(landmark_ids[3]));
+  EXPECT_TRUE(map_.hasLandmark(landmark_ids[2]));
+  EXPECT_TRUE(map_.hasLandmark(landmark_ids[4]));
+  for (const vi_map::KeypointIdentifier& observation :
+       observations_of_first_landmark) {
+    EXPECT_EQ(
+        landmark_ids[2], map_.getVertex(observation.frame_id.vertex_id)
+                             .getObservedLandmarkId(observation));
+  }
+}
+
+TEST_F(MergeMapTest, RemoveLandmarksInBatch) {
+  vi_map::LandmarkIdList landmark_ids;
+  map_.getAllLandmarkIds(&landmark_ids);
+  ASSERT_GE(landmark_ids.size(), 4u);
+  const size_t num_landmarks_before = map_.numLandmarks();
+
+  const vi_map::LandmarkIdList removed_landmark_ids(
+      landmark_ids.begin(), landmark_ids.begin() + 3);
+  vi_map::KeypointIdentifierList observations_of_removed_landmarks;
+  for (const vi_map::LandmarkId& landmark_id : removed_landmark_ids) {
+    map_.getLandmark(landmark_id)
+        .forEachObservation([&](const vi_map::KeypointIdentifier& observation) {
+          observations_of_removed_landmarks.push_back(observation);
+        });
+  }
+
+  map_.removeLandmarks(removed_landmark_ids);
+
+  EXPECT_TRUE(checkMapConsistency(map_));
+  EXPECT_EQ(num_landmarks_before - 3u, map_.numLandmarks());
+  for (const vi_map::LandmarkId& landmark_id : removed_landmark_ids) {
+    EXPECT_FALSE(map_.hasLandmark(landmark_id));
+  }
+  EXPECT_TRUE(map_.hasLandmark(landmark_ids[3]));
+  for (const vi_map::KeypointIdentifier& observation :
+       observations_of_removed_landmarks) {
+    EXPECT_FALSE(map_.getVertex(observation.frame_id.vertex_id)
+                     .getObservedLandmarkId(observation)
+                     .isValid());
+  }
+}
+
 TEST_F(MergeMapTest, MergeIntoSameMap) {
   const std::string kErrorMessage =
       "NCamera with id .* is already associated with mission .*.";
@@ -56,6 +168,27 @@ TEST_F(MergeMapTest, MergeIntoNonEmpty) {
       num_landmarks_before + map_.numLandmarks(), second_map.numLandmarks());
 }
 
+TEST_F(MergeMapTest, MergeByMovingIntoNonEmpty) {
+  vi_map::VIMap second_map;
+  test::generateMap(&second_map);
+  const size_t num_vertices_before = second_map.numVertices();
+  const size_t num_edges_before = second_map.numEdges();
+  const size_t num_landmarks_before = second_map.numLandmarks();
+  const size_t num_vertices_moved = map_.numVertices();
+  const size_t num_edges_moved = map_.numEdges();
+  const size_t num_landmarks_moved = map_.numLandmarks();
+
+  second_map.mergeAllMissionsFromMap(std::move(map_));
+  EXPECT_EQ(2u, second_map.numMissions());
+  EXPECT_EQ(
+      num_vertices_before + num_vertices_moved, second_map.numVertices());
+  EXPECT_EQ(num_edges_before + num_edges_moved, second_map.numEdges());
+  EXPECT_EQ(
+      num_landmarks_before + num_landmarks_moved, second_map.numLandmarks());
+  EXPECT_TRUE(checkMapConsistency(second_map));
+  EXPECT_EQ(0u, map_.numVertices());
+}
+
 TEST_F(MergeMapTest, MergeMapWithTwoLinkedMissions) {
   vi_map::MissionIdList all_mission_ids;
   map_.getAllMissionIds(&all_mission_ids);
@@ -0,0 +1,104 @@
+#include <numeric>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "vi-map/test/vi-map-test-helpers.h"
+#include "vi-map/vi-map.h"
+
+namespace vi_map {
+
+class VIMapMissionStatisticsTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    vi_map::test::generateMap(kNumVertices, &map_);
+    mission_id_ = map_.getIdOfFirstMission();
+  }
+
+  static constexpr size_t kNumVertices = 50u;
+
+  VIMap map_;
+  vi_map::MissionId mission_id_;
+};
+
+constexpr size_t VIMapMissionStatisticsTest::kNumVertices;
+
+TEST_F(VIMapMissionStatisticsTest, StatisticsMatchSequentialCounts) {
+  std::vector<MissionStatistics> statistics;
+  map_.getStatisticsOfMissions({mission_id_}, &statistics);
+  ASSERT_EQ(1u, statistics.size());
+  const MissionStatistics& mission_statistics = statistics.front();
+
+  pose_graph::VertexIdList vertex_ids;
+  map_.getAllVertexIdsInMissionAlongGraph(mission_id_, &vertex_ids);
+  size_t expected_num_landmarks = 0u;
+  size_t expected_num_landmarks_with_observations = 0u;
+  size_t expected_num_observations = 0u;
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    const Vertex& vertex = map_.getVertex(vertex_id);
+    expected_num_landmarks += vertex.getLandmarks().size();
+    for (const Landmark& landmark : vertex.getLandmarks()) {
+      if (landmark.hasObservations()) {
+        ++expected_num_landmarks_with_observations;
+      }
+    }
+    for (unsigned int frame_idx = 0u; frame_idx < vertex.numFrames();
+         ++frame_idx) {
+      if (vertex.isVisualFrameSet(frame_idx) &&
+          vertex.isVisualFrameValid(frame_idx)) {
+        expected_num_observations +=
+            vertex.getVisualFrame(frame_idx).getNumKeypointMeasurements();
+      }
+    }
+  }
+  EXPECT_EQ(vertex_ids.size(), mission_statistics.num_vertices);
+  EXPECT_EQ(expected_num_landmarks, mission_statistics.num_landmarks);
+  EXPECT_GT(expected_num_landmarks, 0u);
+  EXPECT_EQ(
+      expected_num_landmarks_with_observations,
+      std::accumulate(
+          mission_statistics.total_num_landmarks_per_camera.begin(),
+          mission_statistics.total_num_landmarks_per_camera.end(),
+          size_t{0u}));
+  EXPECT_EQ(expected_num_observations, mission_statistics.num_observations);
+
+  pose_graph::EdgeIdList imu_edge_ids;
+  map_.getAllEdgeIdsInMissionAlongGraph(
+      mission_id_, pose_graph::Edge::EdgeType::kViwls, &imu_edge_ids);
+  EXPECT_EQ(imu_edge_ids.size(), mission_statistics.num_imu_edges);
+
+  double expected_distance_travelled_m;
+  map_.getDistanceTravelledPerMission(
+      mission_id_, &expected_distance_travelled_m);
+  EXPECT_NEAR(
+      expected_distance_travelled_m, mission_statistics.distance_travelled_m,
+      1e-9 * (1.0 + expected_distance_travelled_m));
+
+  // The single mission getter returns the same statistics.
+  std::vector<size_t> num_good_landmarks_per_camera;
+  std::vector<size_t> num_bad_landmarks_per_camera;
+  std::vector<size_t> num_unknown_landmarks_per_camera;
+  std::vector<size_t> total_num_landmarks_per_camera;
+  size_t num_landmarks, num_vertices, num_observations;
+  double duration_s;
+  int64_t start_time_ns, end_time_ns;
+  map_.getStatisticsOfMission(
+      mission_id_, &num_good_landmarks_per_camera,
+      &num_bad_landmarks_per_camera, &num_unknown_landmarks_per_camera,
+      &total_num_landmarks_per_camera, &num_landmarks, &num_vertices,
+      &num_observations, &duration_s, &start_time_ns, &end_time_ns);
+  EXPECT_EQ(
+      mission_statistics.total_num_landmarks_per_camera,
+      total_num_landmarks_per_camera);
+  EXPECT_EQ(mission_statistics.num_landmarks, num_landmarks);
+  EXPECT_EQ(mission_statistics.num_vertices, num_vertices);
+  EXPECT_EQ(mission_statistics.num_observations, num_observations);
+  EXPECT_EQ(mission_statistics.start_time_ns, start_time_ns);
+  EXPECT_EQ(mission_statistics.end_time_ns, end_time_ns);
+}
+
+}  // namespace vi_map
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,172 @@
+#include <unordered_set>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/unique-id.h>
+#include <posegraph/unique-id.h>
+
+#include "vi-map/test/vi-map-test-helpers.h"
+#include "vi-map/vi-map.h"
+#include "vi-map/viwls-edge.h"
+
+namespace vi_map {
+
+class VIMapVertexMergingTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    vi_map::test::generateMap(kNumVertices, &map_);
+    addImuDataToViwlsEdges();
+    mission_id_ = map_.getIdOfFirstMission();
+    map_.getAllVertexIdsInMissionAlongGraph(mission_id_, &initial_vertices_);
+    ASSERT_EQ(kNumVertices, initial_vertices_.size());
+
+    // Keep every n-th vertex and the last one.
+    for (size_t vertex_idx = 0u; vertex_idx < initial_vertices_.size();
+         vertex_idx += kKeepEveryNthVertex) {
+      kept_vertices_.push_back(initial_vertices_[vertex_idx]);
+    }
+    if (kept_vertices_.back() != initial_vertices_.back()) {
+      kept_vertices_.push_back(initial_vertices_.back());
+    }
+  }
+
+  // The generated edges don't hold IMU data, replace them by edges with three
+  // measurements each, the first one shared with the previous edge.
+  void addImuDataToViwlsEdges();
+
+  // Merges the vertices one by one with mergeNeighboringVertices.
+  size_t mergeVerticesSequentially(VIMap* map) const;
+
+  void expectEqualMaps(const VIMap& expected_map, const VIMap& map) const;
+
+  static constexpr size_t kNumVertices = 50u;
+  static constexpr size_t kKeepEveryNthVertex = 4u;
+
+  VIMap map_;
+  vi_map::MissionId mission_id_;
+  pose_graph::VertexIdList initial_vertices_;
+  pose_graph::VertexIdList kept_vertices_;
+};
+
+constexpr size_t VIMapVertexMergingTest::kNumVertices;
+constexpr size_t VIMapVertexMergingTest::kKeepEveryNthVertex;
+
+void VIMapVertexMergingTest::addImuDataToViwlsEdges() {
+  pose_graph::EdgeIdList edge_ids;
+  map_.getAllEdgeIds(&edge_ids);
+  for (const pose_graph::EdgeId& edge_id : edge_ids) {
+    if (map_.getEdgeType(edge_id) != pose_graph::Edge::EdgeType::kViwls) {
+      continue;
+    }
+    const pose_graph::VertexId from = map_.getEdgeAs<ViwlsEdge>(edge_id).from();
+    const pose_graph::VertexId to = map_.getEdgeAs<ViwlsEdge>(edge_id).to();
+    const int64_t from_timestamp_ns =
+        map_.getVertex(from).getMinTimestampNanoseconds();
+    const int64_t to_timestamp_ns =
+        map_.getVertex(to).getMinTimestampNanoseconds();
+
+    Eigen::Matrix<int64_t, 1, Eigen::Dynamic> imu_timestamps(1, 3);
+    imu_timestamps << from_timestamp_ns,
+        (from_timestamp_ns + to_timestamp_ns) / 2, to_timestamp_ns;
+    Eigen::Matrix<double, 6, Eigen::Dynamic> imu_data =
+        Eigen::Matrix<double, 6, Eigen::Dynamic>::Random(6, 3);
+
+    map_.removeEdge(edge_id);
+    pose_graph::EdgeId new_edge_id;
+    common::generateId(&new_edge_id);
+    map_.addEdge(
+        vi_map::Edge::UniquePtr(
+            new ViwlsEdge(new_edge_id, from, to, imu_timestamps, imu_data)));
+  }
+}
+
+size_t VIMapVertexMergingTest::mergeVerticesSequentially(VIMap* map) const {
+  CHECK_NOTNULL(map);
+  const pose_graph::Edge::EdgeType traversal_edge =
+      map->getGraphTraversalEdgeType(mission_id_);
+  size_t num_merged_vertices = 0u;
+  for (size_t kept_idx = 0u; kept_idx + 1u < kept_vertices_.size();
+       ++kept_idx) {
+    pose_graph::VertexId next_vertex_id;
+    while (map->getNextVertex(
+               kept_vertices_[kept_idx], traversal_edge, &next_vertex_id) &&
+           next_vertex_id != kept_vertices_[kept_idx + 1u]) {
+      map->mergeNeighboringVertices(kept_vertices_[kept_idx], next_vertex_id);
+      ++num_merged_vertices;
+    }
+  }
+  return num_merged_vertices;
+}
+
+void VIMapVertexMergingTest::expectEqualMaps(
+    const VIMap& expected_map, const VIMap& map) const {
+  pose_graph::VertexIdList expected_vertices, vertices;
+  expected_map.getAllVertexIdsInMissionAlongGraph(
+      mission_id_, &expected_vertices);
+  map.getAllVertexIdsInMissionAlongGraph(mission_id_, &vertices);
+  EXPECT_EQ(kept_vertices_, expected_vertices);
+  EXPECT_EQ(kept_vertices_, vertices);
+  EXPECT_EQ(expected_map.numEdges(), map.numEdges());
+
+  LandmarkIdSet expected_landmarks, landmarks;
+  expected_map.getAllLandmarkIds(&expected_landmarks);
+  map.getAllLandmarkIds(&landmarks);
+  EXPECT_EQ(expected_landmarks, landmarks);
+  for (const LandmarkId& landmark_id : expected_landmarks) {
+    if (landmarks.count(landmark_id) == 0u) {
+      continue;
+    }
+    EXPECT_EQ(
+        expected_map.getLandmark(landmark_id).numberOfObservations(),
+        map.getLandmark(landmark_id).numberOfObservations());
+    EXPECT_EQ(
+        expected_map.getLandmarkStoreVertexId(landmark_id),
+        map.getLandmarkStoreVertexId(landmark_id));
+  }
+
+  // Compare the IMU data of the edges between the kept vertices.
+  for (const pose_graph::VertexId& vertex_id : kept_vertices_) {
+    pose_graph::EdgeIdSet expected_edges, edges;
+    expected_map.getVertex(vertex_id).getOutgoingEdges(&expected_edges);
+    map.getVertex(vertex_id).getOutgoingEdges(&edges);
+    ASSERT_EQ(expected_edges.size(), edges.size());
+    if (edges.empty()) {
+      continue;
+    }
+    ASSERT_EQ(1u, edges.size());
+    const ViwlsEdge& expected_edge =
+        expected_map.getEdgeAs<ViwlsEdge>(*expected_edges.begin());
+    const ViwlsEdge& edge = map.getEdgeAs<ViwlsEdge>(*edges.begin());
+    EXPECT_EQ(expected_edge.to(), edge.to());
+    EXPECT_EQ(expected_edge.getImuTimestamps(), edge.getImuTimestamps());
+    EXPECT_EQ(expected_edge.getImuData(), edge.getImuData());
+  }
+}
+
+TEST_F(VIMapVertexMergingTest, MergeAllVerticesMatchesSequentialMerging) {
+  VIMap expected_map;
+  expected_map.deepCopy(map_);
+
+  const size_t expected_num_merged_vertices =
+      mergeVerticesSequentially(&expected_map);
+  EXPECT_EQ(
+      kNumVertices - kept_vertices_.size(), expected_num_merged_vertices);
+
+  EXPECT_EQ(
+      expected_num_merged_vertices,
+      map_.mergeAllVerticesBetweenVertices(kept_vertices_));
+  expectEqualMaps(expected_map, map_);
+}
+
+TEST_F(VIMapVertexMergingTest, MergeAllVerticesWithoutVerticesInBetween) {
+  EXPECT_EQ(0u, map_.mergeAllVerticesBetweenVertices(initial_vertices_));
+  pose_graph::VertexIdList vertices;
+  map_.getAllVertexIdsInMissionAlongGraph(mission_id_, &vertices);
+  EXPECT_EQ(initial_vertices_, vertices);
+}
+
+}  // namespace vi_map
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,82 @@
+#ifndef VI_MAPPING_TEST_APP_PERFORMANCE_RECORDER_H_
+#define VI_MAPPING_TEST_APP_PERFORMANCE_RECORDER_H_
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+namespace visual_inertial_mapping {
+
+struct StagePerformance {
+  StagePerformance() : wall_time_s(0.0), peak_rss_bytes(0u) {}
+  std::string name;
+  double wall_time_s;
+  // Peak resident set size of the process at the end of the stage.
+  size_t peak_rss_bytes;
+};
+
+struct PipelinePerformance {
+  PipelinePerformance() : total_wall_time_s(0.0), peak_rss_bytes(0u) {}
+  std::string dataset;
+  double total_wall_time_s;
+  size_t peak_rss_bytes;
+  std::vector<StagePerformance> stages;
+
+  const StagePerformance* getStage(const std::string& name) const;
+  std::string toString() const;
+};
+
+// Records the wall time and the peak resident set size of the stages of a
+// pipeline run. The peak resident set size is the one of the whole process,
+// so a process should only run the pipeline on one dataset.
+class PerformanceRecorder {
+ public:
+  explicit PerformanceRecorder(const std::string& dataset);
+
+  void startStage(const std::string& name);
+  void stopStage();
+
+  // Finishes a running stage and the total wall time.
+  const PipelinePerformance& finish();
+
+  static size_t getPeakRssBytes();
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  PipelinePerformance performance_;
+  const Clock::time_point start_time_;
+  Clock::time_point stage_start_time_;
+  bool stage_running_;
+};
+
+// Compares the total and per-stage wall times and the peak resident set size
+// to the baseline and adds a message for every value that is larger than the
+// baseline by more than the given relative threshold. Stages missing in the
+// baseline are not compared. Returns true if there is no regression.
+bool checkForPerformanceRegressions(
+    const PipelinePerformance& baseline, const PipelinePerformance& current,
+    double wall_time_threshold, double peak_rss_threshold,
+    std::vector<std::string>* regressions);
+
+}  // namespace visual_inertial_mapping
+
+namespace YAML {
+template <>
+struct convert<visual_inertial_mapping::StagePerformance> {
+  static Node encode(const visual_inertial_mapping::StagePerformance& rhs);
+  static bool decode(
+      const Node& node, visual_inertial_mapping::StagePerformance& rhs);
+};
+
+template <>
+struct convert<visual_inertial_mapping::PipelinePerformance> {
+  static Node encode(const visual_inertial_mapping::PipelinePerformance& rhs);
+  static bool decode(
+      const Node& node, visual_inertial_mapping::PipelinePerformance& rhs);
+};
+}  // namespace YAML
+
+#endif  // VI_MAPPING_TEST_APP_PERFORMANCE_RECORDER_H_
@@ -0,0 +1,192 @@
+#include "vi-mapping-test-app/performance-recorder.h"
+
+#include <sys/resource.h>
+
+#include <iomanip>
+#include <sstream>
+
+#include <aslam/common/yaml-serialization.h>
+#include <glog/logging.h>
+#include <maplab-common/memory-accounting.h>
+
+namespace visual_inertial_mapping {
+
+const StagePerformance* PipelinePerformance::getStage(
+    const std::string& name) const {
+  for (const StagePerformance& stage : stages) {
+    if (stage.name == name) {
+      return &stage;
+    }
+  }
+  return nullptr;
+}
+
+std::string PipelinePerformance::toString() const {
+  std::stringstream out;
+  out << "Performance of " << dataset << ":\n";
+  for (const StagePerformance& stage : stages) {
+    out << "  " << std::setw(40) << std::left << stage.name << std::right
+        << std::setw(10) << std::fixed << std::setprecision(2)
+        << stage.wall_time_s << " s  peak RSS "
+        << common::formatBytes(stage.peak_rss_bytes) << "\n";
+  }
+  out << "  " << std::setw(40) << std::left << "total" << std::right
+      << std::setw(10) << std::fixed << std::setprecision(2)
+      << total_wall_time_s << " s  peak RSS "
+      << common::formatBytes(peak_rss_bytes);
+  return out.str();
+}
+
+PerformanceRecorder::PerformanceRecorder(const std::string& dataset)
+    : start_time_(Clock::now()), stage_running_(false) {
+  performance_.dataset = dataset;
+}
+
+void PerformanceRecorder::startStage(const std::string& name) {
+  if (stage_running_) {
+    stopStage();
+  }
+  StagePerformance stage;
+  stage.name = name;
+  performance_.stages.push_back(stage);
+  stage_start_time_ = Clock::now();
+  stage_running_ = true;
+}
+
+void PerformanceRecorder::stopStage() {
+  CHECK(stage_running_) << "No stage is running.";
+  CHECK(!performance_.stages.empty());
+  StagePerformance& stage = performance_.stages.back();
+  stage.wall_time_s =
+      std::chrono::duration<double>(Clock::now() - stage_start_time_).count();
+  stage.peak_rss_bytes = getPeakRssBytes();
+  stage_running_ = false;
+}
+
+const PipelinePerformance& PerformanceRecorder::finish() {
+  if (stage_running_) {
+    stopStage();
+  }
+  performance_.total_wall_time_s =
+      std::chrono::duration<double>(Clock::now() - start_time_).count();
+  performance_.peak_rss_bytes = getPeakRssBytes();
+  return performance_;
+}
+
+size_t PerformanceRecorder::getPeakRssBytes() {
+  struct rusage usage;
+  CHECK_EQ(getrusage(RUSAGE_SELF, &usage), 0);
+#ifdef __APPLE__
+  // Reported in bytes on macOS.
+  return static_cast<size_t>(usage.ru_maxrss);
+#else
+  // Reported in kilobytes on Linux.
+  return static_cast<size_t>(usage.ru_maxrss) * 1024u;
+#endif
+}
+
+namespace {
+// Adds a message if the value grew by more than the relative threshold. Tiny
+// baseline values are not compared, as their relative changes are noise.
+void checkValue(
+    const std::string& description, const double baseline_value,
+    const double current_value, const double threshold,
+    const double min_baseline_value, std::vector<std::string>* regressions) {
+  CHECK_NOTNULL(regressions);
+  if (baseline_value < min_baseline_value) {
+    return;
+  }
+  const double relative_change = current_value / baseline_value - 1.0;
+  if (relative_change > threshold) {
+    std::stringstream message;
+    message << description << " increased by " << std::fixed
+            << std::setprecision(1) << 100.0 * relative_change << "% from "
+            << baseline_value << " to " << current_value
+            << " (threshold: " << 100.0 * threshold << "%).";
+    regressions->push_back(message.str());
+  }
+}
+}  // namespace
+
+bool checkForPerformanceRegressions(
+    const PipelinePerformance& baseline, const PipelinePerformance& current,
+    const double wall_time_threshold, const double peak_rss_threshold,
+    std::vector<std::string>* regressions) {
+  CHECK_NOTNULL(regressions)->clear();
+  CHECK_GE(wall_time_threshold, 0.0);
+  CHECK_GE(peak_rss_threshold, 0.0);
+  constexpr double kMinWallTimeSeconds = 0.1;
+  constexpr double kBytesPerMegabyte = 1024.0 * 1024.0;
+  constexpr double kMinPeakRssMegabytes = 1.0;
+
+  checkValue(
+      "Total wall time [s]", baseline.total_wall_time_s,
+      current.total_wall_time_s, wall_time_threshold, kMinWallTimeSeconds,
+      regressions);
+  checkValue(
+      "Peak RSS [MiB]", baseline.peak_rss_bytes / kBytesPerMegabyte,
+      current.peak_rss_bytes / kBytesPerMegabyte, peak_rss_threshold,
+      kMinPeakRssMegabytes, regressions);
+  for (const StagePerformance& stage : current.stages) {
+    const StagePerformance* baseline_stage = baseline.getStage(stage.name);
+    if (baseline_stage == nullptr) {
+      LOG(WARNING) << "Stage \"" << stage.name << "\" is not in the baseline.";
+      continue;
+    }
+    checkValue(
+        "Wall time of \"" + stage.name + "\" [s]", baseline_stage->wall_time_s,
+        stage.wall_time_s, wall_time_threshold, kMinWallTimeSeconds,
+        regressions);
+  }
+  return regressions->empty();
+}
+
+}  // namespace visual_inertial_mapping
+
+namespace YAML {
+
+Node convert<visual_inertial_mapping::StagePerformance>::encode(
+    const visual_inertial_mapping::StagePerformance& rhs) {
+  Node node;
+  node["name"] = rhs.name;
+  node["wall_time_s"] = rhs.wall_time_s;
+  node["peak_rss_bytes"] = static_cast<uint64_t>(rhs.peak_rss_bytes);
+  return node;
+}
+
+bool convert<visual_inertial_mapping::StagePerformance>::decode(
+    const Node& node,
+    visual_inertial_mapping::StagePerformance& rhs) {  // NOLINT
+  bool success = true;
+  uint64_t peak_rss_bytes = 0u;
+  success &= YAML::safeGet(node, "name", &rhs.name);
+  success &= YAML::safeGet(node, "wall_time_s", &rhs.wall_time_s);
+  success &= YAML::safeGet(node, "peak_rss_bytes", &peak_rss_bytes);
+  rhs.peak_rss_bytes = static_cast<size_t>(peak_rss_bytes);
+  return success;
+}
+
+Node convert<visual_inertial_mapping::PipelinePerformance>::encode(
+    const visual_inertial_mapping::PipelinePerformance& rhs) {
+  Node node;
+  node["dataset"] = rhs.dataset;
+  node["total_wall_time_s"] = rhs.total_wall_time_s;
+  node["peak_rss_bytes"] = static_cast<uint64_t>(rhs.peak_rss_bytes);
+  node["stages"] = rhs.stages;
+  return node;
+}
+
+bool convert<visual_inertial_mapping::PipelinePerformance>::decode(
+    const Node& node,
+    visual_inertial_mapping::PipelinePerformance& rhs) {  // NOLINT
+  bool success = true;
+  uint64_t peak_rss_bytes = 0u;
+  success &= YAML::safeGet(node, "dataset", &rhs.dataset);
+  success &= YAML::safeGet(node, "total_wall_time_s", &rhs.total_wall_time_s);
+  success &= YAML::safeGet(node, "peak_rss_bytes", &peak_rss_bytes);
+  success &= YAML::safeGet(node, "stages", &rhs.stages);
+  rhs.peak_rss_bytes = static_cast<size_t>(peak_rss_bytes);
+  return success;
+}
+
+}  // namespace YAML
@@ -0,0 +1,152 @@
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <console-common/console.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <maplab-common/string-tools.h>
+#include <maplab-common/yaml-serialization.h>
+#include <maplab-console/maplab-console.h>
+
+#include "vi-mapping-test-app/performance-recorder.h"
+
+// Runs the standard mapping pipeline on a reference dataset and records the
+// wall time and peak resident set size of every stage. The results are
+// written to a yaml file, which can serve as baseline for later runs:
+//
+//   vi_mapping_performance_test --performance_test_map_folder=<dataset>
+//       --performance_test_output_file=baseline.yaml
+//   vi_mapping_performance_test --performance_test_map_folder=<dataset>
+//       --performance_test_baseline_file=baseline.yaml
+//
+// The test fails if a command fails or, given a baseline, if the run got
+// slower or used more memory than the thresholds allow. The peak resident
+// set size covers the whole process, so every dataset is run in its own
+// process.
+
+DEFINE_string(
+    performance_test_map_folder, "",
+    "Folder of the reference map to run the pipeline on.");
+DEFINE_string(
+    performance_test_commands,
+    "itl,lc,optvi,kfh,summary_map --summary_map_save_path=<SUMMARY_MAP_FOLDER> "
+    "--overwrite",
+    "Comma-separated list of console commands that make up the pipeline. "
+    "<SUMMARY_MAP_FOLDER> is replaced by performance_test_summary_map_folder.");
+DEFINE_string(
+    performance_test_summary_map_folder, "/tmp/vi_mapping_performance_test",
+    "Folder the summary map of the pipeline is saved to.");
+DEFINE_string(
+    performance_test_output_file, "",
+    "If set, the recorded performance is written to this yaml file.");
+DEFINE_string(
+    performance_test_baseline_file, "",
+    "If set, the recorded performance is compared to the baseline in this "
+    "yaml file.");
+DEFINE_double(
+    performance_test_wall_time_threshold, 0.2,
+    "Relative increase of the total or a stage wall time over the baseline "
+    "that counts as regression.");
+DEFINE_double(
+    performance_test_peak_rss_threshold, 0.1,
+    "Relative increase of the peak resident set size over the baseline that "
+    "counts as regression.");
+
+namespace {
+constexpr char kConsoleName[] = "vi-mapping-performance-test";
+const std::string kSummaryMapFolderTemplate("<SUMMARY_MAP_FOLDER>");
+
+std::string getStageName(const std::string& command) {
+  return command.substr(0u, command.find(' '));
+}
+
+bool runStage(
+    const std::string& command, maplab::MapLabConsole* console,
+    visual_inertial_mapping::PerformanceRecorder* recorder) {
+  CHECK_NOTNULL(console);
+  CHECK_NOTNULL(recorder);
+  LOG(INFO) << "Running command: " << command;
+  recorder->startStage(getStageName(command));
+  const int result = console->RunCommand(command);
+  recorder->stopStage();
+  if (result != common::kSuccess) {
+    LOG(ERROR) << "Command failed: " << command;
+    return false;
+  }
+  return true;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  google::InstallFailureSignalHandler();
+  FLAGS_alsologtostderr = true;
+  FLAGS_colorlogtostderr = true;
+
+  // Parses the command line flags after loading the plugins.
+  maplab::MapLabConsole console(kConsoleName, argc, argv);
+
+  CHECK(!FLAGS_performance_test_map_folder.empty())
+      << "You have to provide the folder of the reference map.";
+  CHECK_GE(FLAGS_performance_test_wall_time_threshold, 0.0);
+  CHECK_GE(FLAGS_performance_test_peak_rss_threshold, 0.0);
+
+  visual_inertial_mapping::PipelinePerformance baseline;
+  const bool has_baseline = !FLAGS_performance_test_baseline_file.empty();
+  if (has_baseline &&
+      !YAML::Load(FLAGS_performance_test_baseline_file, &baseline)) {
+    LOG(FATAL) << "Failed to read the baseline "
+               << FLAGS_performance_test_baseline_file;
+  }
+
+  std::vector<std::string> commands;
+  constexpr bool kRemoveEmpty = true;
+  common::tokenizeString(
+      FLAGS_performance_test_commands, ',', kRemoveEmpty, &commands);
+  for (std::string& command : commands) {
+    const size_t template_pos = command.find(kSummaryMapFolderTemplate);
+    if (template_pos != std::string::npos) {
+      command.replace(
+          template_pos, kSummaryMapFolderTemplate.length(),
+          FLAGS_performance_test_summary_map_folder);
+    }
+  }
+
+  visual_inertial_mapping::PerformanceRecorder recorder(
+      FLAGS_performance_test_map_folder);
+  bool success = runStage(
+      "load --map_folder=" + FLAGS_performance_test_map_folder, &console,
+      &recorder);
+  for (size_t command_idx = 0u; success && command_idx < commands.size();
+       ++command_idx) {
+    success = runStage(commands[command_idx], &console, &recorder);
+  }
+  const visual_inertial_mapping::PipelinePerformance& performance =
+      recorder.finish();
+  LOG(INFO) << performance.toString();
+  if (!success) {
+    return EXIT_FAILURE;
+  }
+
+  if (!FLAGS_performance_test_output_file.empty()) {
+    YAML::Save(performance, FLAGS_performance_test_output_file);
+    LOG(INFO) << "Wrote the performance to "
+              << FLAGS_performance_test_output_file;
+  }
+
+  if (has_baseline) {
+    std::vector<std::string> regressions;
+    if (!visual_inertial_mapping::checkForPerformanceRegressions(
+            baseline, performance, FLAGS_performance_test_wall_time_threshold,
+            FLAGS_performance_test_peak_rss_threshold, &regressions)) {
+      for (const std::string& regression : regressions) {
+        LOG(ERROR) << "Performance regression: " << regression;
+      }
+      return EXIT_FAILURE;
+    }
+    LOG(INFO) << "No performance regression compared to "
+              << FLAGS_performance_test_baseline_file;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,70 @@
+#!/usr/bin/env python
+"""
+Compares two result files of maplab_benchmarks written with
+--benchmark_out_format=json and fails if a benchmark got slower than the
+threshold.
+
+  compare_benchmarks.py baseline.json benchmarks.json --threshold 0.1
+"""
+
+import argparse
+import json
+import sys
+
+
+def load_benchmark_times(path, time_key):
+  with open(path) as json_file:
+    results = json.load(json_file)
+  times = {}
+  for benchmark in results['benchmarks']:
+    # Skip the aggregates of repeated runs except for the median, and the
+    # benchmarks that were skipped with an error.
+    if benchmark.get('error_occurred', False):
+      continue
+    if benchmark.get('run_type') == 'aggregate' and \
+        benchmark.get('aggregate_name') != 'median':
+      continue
+    times[benchmark['name']] = benchmark[time_key]
+  return times
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__)
+  parser.add_argument('baseline', help='JSON results of the baseline.')
+  parser.add_argument('contender', help='JSON results to compare.')
+  parser.add_argument(
+      '--threshold', type=float, default=0.1,
+      help='Relative slowdown above which a benchmark counts as regression.')
+  parser.add_argument(
+      '--time', choices=['real_time', 'cpu_time'], default='cpu_time',
+      help='Time of the benchmarks to compare.')
+  args = parser.parse_args()
+
+  baseline = load_benchmark_times(args.baseline, args.time)
+  contender = load_benchmark_times(args.contender, args.time)
+
+  regressions = []
+  for name in sorted(set(baseline) & set(contender)):
+    if baseline[name] <= 0.0:
+      continue
+    change = contender[name] / baseline[name] - 1.0
+    marker = ''
+    if change > args.threshold:
+      regressions.append(name)
+      marker = '  <-- regression'
+    print('{:<70} {:>+8.1%}{}'.format(name, change, marker))
+
+  for name in sorted(set(baseline) - set(contender)):
+    print('{:<70} {:>9}'.format(name, 'removed'))
+  for name in sorted(set(contender) - set(baseline)):
+    print('{:<70} {:>9}'.format(name, 'new'))
+
+  if regressions:
+    print('\n{} benchmark(s) slower than the threshold of {:.0%}.'.format(
+        len(regressions), args.threshold))
+    return 1
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -0,0 +1,138 @@
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/memory.h>
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+#include <map-resources/resource-cache.h>
+#include <map-resources/resource-common.h>
+#include <maplab-common/temporal-buffer.h>
+#include <maplab-common/unique-id.h>
+
+namespace {
+constexpr int64_t kBufferPeriodNs = 5000000;
+constexpr int kNumLookups = 1000;
+
+typedef Eigen::Matrix<double, 6, 1> ImuData;
+typedef common::TemporalBuffer<
+    ImuData, Eigen::aligned_allocator<std::pair<const int64_t, ImuData>>>
+    ImuDataBuffer;
+
+// Lookups in a buffer of IMU-like measurements, the benchmark argument is the
+// number of buffered values.
+class TemporalBufferFixture : public benchmark::Fixture {
+ public:
+  void SetUp(const benchmark::State& state) override {
+    buffer_.clear();
+    const int64_t num_values = state.range(0);
+    for (int64_t i = 0; i < num_values; ++i) {
+      buffer_.addValue(i * kBufferPeriodNs, ImuData::Constant(i));
+    }
+    srand(42);
+    lookup_timestamps_ns_.clear();
+    for (int i = 0; i < kNumLookups; ++i) {
+      lookup_timestamps_ns_.push_back(
+          (static_cast<int64_t>(rand()) % num_values) *  // NOLINT
+              kBufferPeriodNs +
+          kBufferPeriodNs / 3);
+    }
+  }
+
+ protected:
+  ImuDataBuffer buffer_;
+  std::vector<int64_t> lookup_timestamps_ns_;
+};
+
+BENCHMARK_DEFINE_F(TemporalBufferFixture, GetNearestValue)
+(benchmark::State& state) {  // NOLINT
+  ImuData value;
+  for (auto _ : state) {
+    for (const int64_t timestamp_ns : lookup_timestamps_ns_) {
+      benchmark::DoNotOptimize(
+          buffer_.getNearestValueToTime(timestamp_ns, &value));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kNumLookups);
+}
+BENCHMARK_REGISTER_F(TemporalBufferFixture, GetNearestValue)
+    ->Arg(1000)
+    ->Arg(100000);
+
+BENCHMARK_DEFINE_F(TemporalBufferFixture, GetValuesBetweenTimes)
+(benchmark::State& state) {  // NOLINT
+  constexpr int64_t kIntervalNs = 20 * kBufferPeriodNs;
+  Aligned<std::vector, ImuData> values;
+  for (auto _ : state) {
+    for (const int64_t timestamp_ns : lookup_timestamps_ns_) {
+      benchmark::DoNotOptimize(buffer_.getValuesBetweenTimes(
+          timestamp_ns, timestamp_ns + kIntervalNs, &values));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kNumLookups);
+}
+BENCHMARK_REGISTER_F(TemporalBufferFixture, GetValuesBetweenTimes)
+    ->Arg(1000)
+    ->Arg(100000);
+
+// Text resources of the size of a small image, in a cache holding the number
+// of resources given by the benchmark argument.
+class ResourceCacheFixture : public benchmark::Fixture {
+ public:
+  void SetUp(const benchmark::State& state) override {
+    constexpr size_t kResourceSizeBytes = 64u * 1024u;
+    resource_.assign(kResourceSizeBytes, 'x');
+    // Twice as many resources as the cache can hold, such that putting them
+    // in order always evicts a resource.
+    const size_t max_cache_size = static_cast<size_t>(state.range(0));
+    common::generateIds(2u * max_cache_size, &resource_ids_);
+    config_.max_cache_size = max_cache_size;
+    config_.strategy = backend::ResourceCache::Strategy::kLRU;
+  }
+
+ protected:
+  std::string resource_;
+  std::vector<backend::ResourceId> resource_ids_;
+  backend::ResourceCache::Config config_;
+};
+
+BENCHMARK_DEFINE_F(ResourceCacheFixture, GetHit)
+(benchmark::State& state) {  // NOLINT
+  backend::ResourceCache cache(config_);
+  const size_t num_cached_resources = config_.max_cache_size;
+  for (size_t i = 0u; i < num_cached_resources; ++i) {
+    cache.putResource(
+        resource_ids_[i], backend::ResourceType::kText, resource_);
+  }
+  std::string resource;
+  size_t resource_idx = 0u;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cache.getResource(
+        resource_ids_[resource_idx], backend::ResourceType::kText,
+        &resource));
+    resource_idx = (resource_idx + 1u) % num_cached_resources;
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * resource_.size());
+}
+BENCHMARK_REGISTER_F(ResourceCacheFixture, GetHit)->Arg(10)->Arg(1000);
+
+BENCHMARK_DEFINE_F(ResourceCacheFixture, PutWithEviction)
+(benchmark::State& state) {  // NOLINT
+  backend::ResourceCache cache(config_);
+  size_t resource_idx = 0u;
+  for (auto _ : state) {
+    cache.putResource(
+        resource_ids_[resource_idx], backend::ResourceType::kText, resource_);
+    resource_idx = (resource_idx + 1u) % resource_ids_.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * resource_.size());
+}
+BENCHMARK_REGISTER_F(ResourceCacheFixture, PutWithEviction)
+    ->Arg(10)
+    ->Arg(1000);
+}  // namespace
@@ -0,0 +1,166 @@
+#include <cstdlib>
+#include <memory>
+
+#include <Eigen/Core>
+#include <benchmark/benchmark.h>
+#include <descriptor-projection/descriptor-projection.h>
+#include <glog/logging.h>
+#include <inverted-multi-index/inverted-multi-index.h>
+#include <vocabulary-tree/hamming.h>
+
+namespace {
+constexpr int kDescriptorSizeBytes = 48;
+constexpr int kNumDescriptors = 1024;
+constexpr int kProjectedDimensions = 10;
+constexpr int kDimSubVectors = kProjectedDimensions / 2;
+constexpr int kNumWordsPerSubVocabulary = 100;
+constexpr int kNumClosestWords = 10;
+constexpr int kNumQueries = 256;
+constexpr int kNumNeighbors = 10;
+
+Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic>
+createRandomDescriptors(const int num_bytes, const int num_descriptors) {
+  srand(42);
+  Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic> descriptors(
+      num_bytes, num_descriptors);
+  for (int i = 0; i < descriptors.size(); ++i) {
+    descriptors(i) = static_cast<unsigned char>(rand());  // NOLINT
+  }
+  return descriptors;
+}
+
+// Distances of one query to all descriptors, with the kernel that is selected
+// for the CPU.
+void BM_HammingDistance(benchmark::State& state) {  // NOLINT
+  const int num_bytes = static_cast<int>(state.range(0));
+  const Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic>
+      descriptors = createRandomDescriptors(num_bytes, kNumDescriptors);
+  for (auto _ : state) {
+    unsigned int distance_sum = 0u;
+    for (int i = 1; i < kNumDescriptors; ++i) {
+      distance_sum += loop_closure::HammingDistanceOfBytes(
+          descriptors.col(0).data(), descriptors.col(i).data(), num_bytes);
+    }
+    benchmark::DoNotOptimize(distance_sum);
+  }
+  state.SetItemsProcessed(state.iterations() * (kNumDescriptors - 1));
+  state.SetLabel(loop_closure::getHammingKernelName(
+      loop_closure::getSelectedHammingKernel()));
+}
+BENCHMARK(BM_HammingDistance)->Arg(16)->Arg(kDescriptorSizeBytes)->Arg(64);
+
+// Compares the kernels on descriptors of the default size.
+void BM_HammingDistanceKernel(benchmark::State& state) {  // NOLINT
+  const loop_closure::HammingKernel kernel =
+      static_cast<loop_closure::HammingKernel>(state.range(0));
+  state.SetLabel(loop_closure::getHammingKernelName(kernel));
+  if (!loop_closure::isHammingKernelSupported(kernel)) {
+    state.SkipWithError("Kernel not supported by the CPU.");
+    return;
+  }
+  const loop_closure::HammingKernelFunction function =
+      loop_closure::getHammingKernelFunction(kernel);
+  const Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic>
+      descriptors =
+          createRandomDescriptors(kDescriptorSizeBytes, kNumDescriptors);
+  for (auto _ : state) {
+    unsigned int distance_sum = 0u;
+    for (int i = 1; i < kNumDescriptors; ++i) {
+      distance_sum += function(
+          descriptors.col(0).data(), descriptors.col(i).data(),
+          kDescriptorSizeBytes);
+    }
+    benchmark::DoNotOptimize(distance_sum);
+  }
+  state.SetItemsProcessed(state.iterations() * (kNumDescriptors - 1));
+}
+BENCHMARK(BM_HammingDistanceKernel)
+    ->DenseRange(
+        0, static_cast<int>(loop_closure::HammingKernel::kNumKernels) - 1);
+
+// Projection of binary descriptors to the space of the inverted multi-index.
+class DescriptorProjectionFixture : public benchmark::Fixture {
+ public:
+  void SetUp(const benchmark::State& /*state*/) override {
+    descriptors_ =
+        createRandomDescriptors(kDescriptorSizeBytes, kNumDescriptors);
+    projection_matrix_ =
+        Eigen::MatrixXf::Random(kProjectedDimensions, kDescriptorSizeBytes * 8);
+  }
+
+ protected:
+  Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic> descriptors_;
+  Eigen::MatrixXf projection_matrix_;
+};
+
+BENCHMARK_F(DescriptorProjectionFixture, ProjectOneByOne)
+(benchmark::State& state) {  // NOLINT
+  Eigen::MatrixXf projected_descriptors(kProjectedDimensions, kNumDescriptors);
+  for (auto _ : state) {
+    for (int i = 0; i < kNumDescriptors; ++i) {
+      descriptor_projection::ProjectDescriptor(
+          descriptors_.col(i), projection_matrix_, kProjectedDimensions,
+          projected_descriptors.col(i));
+    }
+    benchmark::DoNotOptimize(projected_descriptors.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kNumDescriptors);
+}
+
+BENCHMARK_F(DescriptorProjectionFixture, ProjectBlock)
+(benchmark::State& state) {  // NOLINT
+  Eigen::MatrixXf projected_descriptors;
+  for (auto _ : state) {
+    descriptor_projection::ProjectDescriptorBlock(
+        descriptors_, projection_matrix_, kProjectedDimensions,
+        &projected_descriptors);
+    benchmark::DoNotOptimize(projected_descriptors.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kNumDescriptors);
+}
+
+// Nearest neighbor queries of projected descriptors, with the dimensions of
+// the default loop closure settings.
+class InvertedMultiIndexFixture : public benchmark::Fixture {
+ public:
+  typedef loop_closure::inverted_multi_index::InvertedMultiIndex<
+      kDimSubVectors>
+      Index;
+
+  void SetUp(const benchmark::State& state) override {
+    srand(42);
+    index_.reset(new Index(
+        Eigen::MatrixXf::Random(kDimSubVectors, kNumWordsPerSubVocabulary),
+        Eigen::MatrixXf::Random(kDimSubVectors, kNumWordsPerSubVocabulary),
+        kNumClosestWords));
+    index_->AddDescriptors(
+        Index::DescriptorMatrixType::Random(
+            2 * kDimSubVectors, static_cast<int>(state.range(0))));
+    queries_ = Index::DescriptorMatrixType::Random(
+        2 * kDimSubVectors, kNumQueries);
+  }
+
+  void TearDown(const benchmark::State& /*state*/) override {
+    index_.reset();
+  }
+
+ protected:
+  std::unique_ptr<Index> index_;
+  Index::DescriptorMatrixType queries_;
+};
+
+BENCHMARK_DEFINE_F(InvertedMultiIndexFixture, Query)
+(benchmark::State& state) {  // NOLINT
+  Eigen::MatrixXi indices(kNumNeighbors, kNumQueries);
+  Eigen::MatrixXf distances(kNumNeighbors, kNumQueries);
+  for (auto _ : state) {
+    index_->GetNNearestNeighborsForFeatures(
+        queries_, kNumNeighbors, indices, distances);
+    benchmark::DoNotOptimize(indices.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kNumQueries);
+}
+BENCHMARK_REGISTER_F(InvertedMultiIndexFixture, Query)
+    ->Arg(10000)
+    ->Arg(100000);
+}  // namespace
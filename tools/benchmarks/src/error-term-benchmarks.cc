@@ -0,0 +1,156 @@
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/cameras/distortion-fisheye.h>
+#include <benchmark/benchmark.h>
+#include <ceres-error-terms/inertial-error-term.h>
+#include <ceres-error-terms/visual-error-term.h>
+#include <glog/logging.h>
+
+namespace {
+// Evaluates the residuals and, if requested by the benchmark argument, the
+// Jacobians of a cost function. The parameter and Jacobian blocks are
+// allocated once.
+class CostFunctionEvaluator {
+ public:
+  explicit CostFunctionEvaluator(const ceres::CostFunction& cost_function)
+      : cost_function_(cost_function),
+        residuals_(cost_function.num_residuals()) {
+    for (const int block_size : cost_function.parameter_block_sizes()) {
+      jacobian_blocks_.emplace_back(cost_function.num_residuals() * block_size);
+      jacobians_.push_back(jacobian_blocks_.back().data());
+    }
+  }
+
+  bool evaluate(
+      const std::vector<double*>& parameters, const bool with_jacobians) {
+    return cost_function_.Evaluate(
+        parameters.data(), residuals_.data(),
+        with_jacobians ? jacobians_.data() : nullptr);
+  }
+
+  const double* residuals() const {
+    return residuals_.data();
+  }
+
+ private:
+  const ceres::CostFunction& cost_function_;
+  std::vector<double> residuals_;
+  std::vector<std::vector<double>> jacobian_blocks_;
+  std::vector<double*> jacobians_;
+};
+
+void BM_VisualErrorTerm(benchmark::State& state) {  // NOLINT
+  const bool with_jacobians = state.range(0) != 0;
+  typedef aslam::PinholeCamera CameraType;
+  typedef aslam::FisheyeDistortion DistortionType;
+
+  Eigen::VectorXd distortion_parameters(1);
+  distortion_parameters << 0.9;
+  Eigen::VectorXd intrinsics(4);
+  intrinsics << 300, 300, 320, 240;
+  CameraType camera(
+      intrinsics, 640, 480,
+      aslam::Distortion::UniquePtr(new DistortionType(distortion_parameters)));
+
+  Eigen::Vector3d landmark_position(0.2, -0.1, 3.0);
+  Eigen::Matrix<double, 7, 1> landmark_base_pose, landmark_mission_base_pose,
+      imu_mission_base_pose, imu_pose;
+  landmark_base_pose << 0, 0, 0, 1, 0, 0, 0;
+  landmark_mission_base_pose << 0, 0, 0, 1, 0, 0, 0;
+  imu_mission_base_pose << 0, 0, 0, 1, 0, 0, 0;
+  imu_pose << 0, 0, 0, 1, 0.1, 0.05, 0;
+  Eigen::Vector4d camera_q_CI(0, 0, 0, 1);
+  Eigen::Vector3d camera_p_CI = Eigen::Vector3d::Zero();
+
+  const ceres_error_terms::VisualReprojectionError<CameraType, DistortionType>
+      error_term(
+          Eigen::Vector2d(330.0, 230.0), 0.8,
+          ceres_error_terms::visual::VisualErrorType::kGlobal, &camera);
+  const std::vector<double*> parameters = {
+      landmark_position.data(),
+      landmark_base_pose.data(),
+      landmark_mission_base_pose.data(),
+      imu_mission_base_pose.data(),
+      imu_pose.data(),
+      camera_q_CI.data(),
+      camera_p_CI.data(),
+      camera.getParametersMutable(),
+      camera.getDistortionMutable()->getParametersMutable()};
+
+  CostFunctionEvaluator evaluator(error_term);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(evaluator.evaluate(parameters, with_jacobians));
+    benchmark::DoNotOptimize(evaluator.residuals());
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetLabel(with_jacobians ? "with jacobians" : "residuals only");
+}
+BENCHMARK(BM_VisualErrorTerm)->Arg(0)->Arg(1);
+
+// The inertial error term caches the integration of the IMU measurements for
+// the last linearization point. The first argument selects if the evaluations
+// alternate between two linearization points, which integrates every time, or
+// hit the cache. The second one enables the Jacobians.
+void BM_InertialErrorTerm(benchmark::State& state) {  // NOLINT
+  const bool integrate_every_time = state.range(0) != 0;
+  const bool with_jacobians = state.range(1) != 0;
+  constexpr int kNumImuMeasurements = 20;
+  constexpr int64_t kImuPeriodNs = 5000000;
+  constexpr double kSigma = 1e-2;
+  constexpr double kGravityMagnitude = 9.81;
+
+  srand(42);
+  Eigen::Matrix<double, 6, Eigen::Dynamic> imu_data =
+      0.1 * Eigen::Matrix<double, 6, Eigen::Dynamic>::Random(
+                6, kNumImuMeasurements);
+  imu_data.row(2).array() += kGravityMagnitude;
+  Eigen::Matrix<int64_t, 1, Eigen::Dynamic> imu_timestamps(
+      1, kNumImuMeasurements);
+  for (int i = 0; i < kNumImuMeasurements; ++i) {
+    imu_timestamps(i) = i * kImuPeriodNs;
+  }
+  const ceres_error_terms::InertialErrorTerm error_term(
+      imu_data, imu_timestamps, kSigma, kSigma, kSigma, kSigma,
+      kGravityMagnitude);
+
+  Eigen::Matrix<double, 7, 1> pose_from, pose_to;
+  pose_from << 0, 0, 0, 1, 0, 0, 0;
+  pose_to << 0, 0, 0, 1, 0.1, 0, 0;
+  Eigen::Vector3d gyro_bias_from = Eigen::Vector3d::Zero();
+  Eigen::Vector3d velocity_from(1.0, 0.0, 0.0);
+  Eigen::Vector3d accel_bias_from = Eigen::Vector3d::Zero();
+  Eigen::Vector3d gyro_bias_to = Eigen::Vector3d::Zero();
+  Eigen::Vector3d velocity_to(1.0, 0.0, 0.0);
+  Eigen::Vector3d accel_bias_to = Eigen::Vector3d::Zero();
+  const std::vector<double*> parameters = {
+      pose_from.data(),
+      gyro_bias_from.data(),
+      velocity_from.data(),
+      accel_bias_from.data(),
+      pose_to.data(),
+      gyro_bias_to.data(),
+      velocity_to.data(),
+      accel_bias_to.data()};
+
+  CostFunctionEvaluator evaluator(error_term);
+  constexpr double kVelocityChange = 1e-3;
+  for (auto _ : state) {
+    if (integrate_every_time) {
+      velocity_from.x() = -velocity_from.x() + kVelocityChange;
+    }
+    benchmark::DoNotOptimize(evaluator.evaluate(parameters, with_jacobians));
+    benchmark::DoNotOptimize(evaluator.residuals());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_InertialErrorTerm)
+    ->ArgNames({"integrate", "jacobians"})
+    ->Args({0, 0})
+    ->Args({0, 1})
+    ->Args({1, 0})
+    ->Args({1, 1});
+}  // namespace
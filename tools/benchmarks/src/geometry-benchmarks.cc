@@ -0,0 +1,125 @@
+#include <cstdlib>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/memory.h>
+#include <benchmark/benchmark.h>
+#include <geometric-vision/linear-triangulation.h>
+#include <glog/logging.h>
+#include <imu-integrator/imu-integrator.h>
+#include <maplab-common/pose_types.h>
+
+namespace {
+constexpr int kNumLandmarks = 1000;
+
+// Observations of landmarks in front of cameras on a line, every landmark is
+// observed by a number of consecutive cameras given by the benchmark
+// argument.
+class TriangulationFixture : public benchmark::Fixture {
+ public:
+  void SetUp(const benchmark::State& state) override {
+    srand(42);
+    const int num_observations_per_landmark = static_cast<int>(state.range(0));
+    G_T_C_.clear();
+    for (int camera_idx = 0; camera_idx < num_observations_per_landmark;
+         ++camera_idx) {
+      G_T_C_.emplace_back(
+          pose::Quaternion(), Eigen::Vector3d(0.3 * camera_idx, 0.0, 0.0));
+    }
+
+    normalized_measurements_.clear();
+    normalized_measurements_.resize(kNumLandmarks);
+    G_bearing_vectors_.resize(3, kNumLandmarks * num_observations_per_landmark);
+    G_p_C_.resize(3, kNumLandmarks * num_observations_per_landmark);
+    observation_offsets_.assign(1u, 0u);
+    for (int landmark_idx = 0; landmark_idx < kNumLandmarks; ++landmark_idx) {
+      const Eigen::Vector3d G_p_fi =
+          Eigen::Vector3d::Random() + Eigen::Vector3d(0.0, 0.0, 6.0);
+      for (int camera_idx = 0; camera_idx < num_observations_per_landmark;
+           ++camera_idx) {
+        const Eigen::Vector3d C_p_fi = G_T_C_[camera_idx].inverse() * G_p_fi;
+        normalized_measurements_[landmark_idx].push_back(
+            C_p_fi.head<2>() / C_p_fi.z());
+        const int observation_idx = static_cast<int>(
+            observation_offsets_.back() + camera_idx);
+        G_bearing_vectors_.col(observation_idx) =
+            G_T_C_[camera_idx].getRotationMatrix() * C_p_fi.normalized();
+        G_p_C_.col(observation_idx) = G_T_C_[camera_idx].getPosition();
+      }
+      observation_offsets_.push_back(
+          observation_offsets_.back() + num_observations_per_landmark);
+    }
+  }
+
+ protected:
+  Aligned<std::vector, pose::Transformation> G_T_C_;
+  std::vector<Aligned<std::vector, Eigen::Vector2d>> normalized_measurements_;
+  Eigen::Matrix3Xd G_bearing_vectors_;
+  Eigen::Matrix3Xd G_p_C_;
+  std::vector<size_t> observation_offsets_;
+};
+
+BENCHMARK_DEFINE_F(TriangulationFixture, NViews)
+(benchmark::State& state) {  // NOLINT
+  geometric_vision::LinearTriangulation triangulator;
+  Eigen::Vector3d G_p_fi;
+  for (auto _ : state) {
+    for (int landmark_idx = 0; landmark_idx < kNumLandmarks; ++landmark_idx) {
+      benchmark::DoNotOptimize(triangulator.triangulateFromNormalizedNViews(
+          normalized_measurements_[landmark_idx], G_T_C_, &G_p_fi));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kNumLandmarks);
+}
+BENCHMARK_REGISTER_F(TriangulationFixture, NViews)->Arg(2)->Arg(10);
+
+BENCHMARK_DEFINE_F(TriangulationFixture, BatchFromBearings)
+(benchmark::State& state) {  // NOLINT
+  geometric_vision::LinearTriangulation triangulator;
+  Eigen::Matrix3Xd G_triangulated_points;
+  std::vector<bool> success;
+  for (auto _ : state) {
+    triangulator.triangulateBatchFromBearings(
+        G_bearing_vectors_, G_p_C_, observation_offsets_,
+        &G_triangulated_points, &success);
+    benchmark::DoNotOptimize(G_triangulated_points.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kNumLandmarks);
+}
+BENCHMARK_REGISTER_F(TriangulationFixture, BatchFromBearings)
+    ->Arg(2)
+    ->Arg(10);
+
+// One RK4 step between two IMU measurements, with and without the
+// propagation of the state transition and the covariance.
+void BM_ImuIntegrationRK4(benchmark::State& state) {  // NOLINT
+  const bool propagate_covariance = state.range(0) != 0;
+  constexpr double kSigma = 1e-2;
+  constexpr double kGravityMagnitude = 9.81;
+  const imu_integrator::ImuIntegratorRK4 integrator(
+      kSigma, kSigma, kSigma, kSigma, kGravityMagnitude);
+
+  Eigen::Matrix<double, imu_integrator::kStateSize, 1> state_vector;
+  state_vector.setZero();
+  state_vector(imu_integrator::kStateOrientationOffset + 3) = 1.0;
+  Eigen::Matrix<double, 2 * imu_integrator::kImuReadingSize, 1> imu_readings;
+  imu_readings << 0.1, 0.2, 9.81, 0.01, -0.02, 0.03, 0.12, 0.18, 9.79, 0.01,
+      -0.01, 0.04;
+  constexpr double kDeltaTimeSeconds = 0.005;
+
+  Eigen::Matrix<double, imu_integrator::kStateSize, 1> next_state;
+  Eigen::Matrix<double, imu_integrator::kErrorStateSize,
+                imu_integrator::kErrorStateSize>
+      phi, covariance;
+  for (auto _ : state) {
+    integrator.integrate(
+        state_vector, imu_readings, kDeltaTimeSeconds, &next_state,
+        propagate_covariance ? &phi : nullptr,
+        propagate_covariance ? &covariance : nullptr);
+    benchmark::DoNotOptimize(next_state.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetLabel(propagate_covariance ? "with covariance" : "state only");
+}
+BENCHMARK(BM_ImuIntegrationRK4)->Arg(0)->Arg(1);
+}  // namespace
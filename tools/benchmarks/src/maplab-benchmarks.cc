@@ -0,0 +1,26 @@
+#include <benchmark/benchmark.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+// Microbenchmarks of the hot kernels of maplab, each source file of this
+// package covers one area. Run them with
+//   rosrun maplab_benchmarks maplab_benchmarks \
+//       --benchmark_out=benchmarks.json --benchmark_out_format=json
+// to get machine-readable results, --benchmark_filter=<regex> selects a
+// subset. Two result files can be compared with
+//   scripts/compare_benchmarks.py baseline.json benchmarks.json
+// which fails if a benchmark became slower than the given threshold.
+//
+// The benchmark flags are consumed before gflags parses the command line, so
+// the flags of maplab, e.g. --lc_projection_batch_size, can be set as well.
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  benchmark::Initialize(&argc, argv);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InstallFailureSignalHandler();
+  FLAGS_alsologtostderr = true;
+
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
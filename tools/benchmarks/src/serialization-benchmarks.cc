@@ -0,0 +1,69 @@
+#include <memory>
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+#include <vi-map/test/large-scale-map-generator.h>
+#include <vi-map/vi-map-serialization.h>
+#include <vi-map/vi-map.h>
+#include <vi-map/vi_map.pb.h>
+
+namespace {
+// The vertices of a generated map with the given number of vertices, which
+// make up most of the serialized map.
+class MapSerializationFixture : public benchmark::Fixture {
+ public:
+  void SetUp(const benchmark::State& state) override {
+    vi_map::LargeScaleMapGeneratorOptions options;
+    options.num_vertices_per_mission = static_cast<size_t>(state.range(0));
+    options.num_landmarks_per_vertex = 20u;
+    options.track_length = 10u;
+    map_.reset(new vi_map::VIMap);
+    vi_map::LargeScaleMapGenerator(options).generateMap(map_.get());
+
+    vi_map::proto::VIMap proto;
+    vi_map::serialization::serializeVertices(*map_, &proto);
+    CHECK(proto.SerializeToString(&serialized_vertices_));
+  }
+
+  void TearDown(const benchmark::State& /*state*/) override {
+    map_.reset();
+    serialized_vertices_.clear();
+  }
+
+ protected:
+  std::unique_ptr<vi_map::VIMap> map_;
+  std::string serialized_vertices_;
+};
+
+BENCHMARK_DEFINE_F(MapSerializationFixture, SerializeVertices)
+(benchmark::State& state) {  // NOLINT
+  std::string serialized_vertices;
+  for (auto _ : state) {
+    vi_map::proto::VIMap proto;
+    vi_map::serialization::serializeVertices(*map_, &proto);
+    CHECK(proto.SerializeToString(&serialized_vertices));
+  }
+  state.SetItemsProcessed(state.iterations() * map_->numVertices());
+  state.SetBytesProcessed(state.iterations() * serialized_vertices_.size());
+}
+BENCHMARK_REGISTER_F(MapSerializationFixture, SerializeVertices)
+    ->Arg(100)
+    ->Arg(1000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_DEFINE_F(MapSerializationFixture, ParseVertices)
+(benchmark::State& state) {  // NOLINT
+  for (auto _ : state) {
+    vi_map::proto::VIMap proto;
+    CHECK(proto.ParseFromString(serialized_vertices_));
+    benchmark::DoNotOptimize(proto.vertices().vertices_size());
+  }
+  state.SetItemsProcessed(state.iterations() * map_->numVertices());
+  state.SetBytesProcessed(state.iterations() * serialized_vertices_.size());
+}
+BENCHMARK_REGISTER_F(MapSerializationFixture, ParseVertices)
+    ->Arg(100)
+    ->Arg(1000)
+    ->Unit(benchmark::kMillisecond);
+}  // namespace
@@ -8,9 +8,17 @@
 
 namespace csv_export {
 
+// Exports the vertices, tracks, descriptors, landmarks, observations and IMU
+// data of every mission to CSV files in <base path>/<mission id>/. The rows
+// are formatted in parallel and written in blocks.
 void exportMapToCsv(
     const vi_map::VIMap& map, const std::string& export_base_filename);
 
+// Exports the same tables as exportMapToCsv, but every table is written to a
+// folder with one binary file per column, see ColumnarTableWriter.
+void exportMapToColumnarBinary(
+    const vi_map::VIMap& map, const std::string& export_base_filename);
+
 }  // namespace csv_export
 
 #endif  // CSV_EXPORT_CSV_EXPORT_H_
@@ -0,0 +1,127 @@
+#ifndef CSV_EXPORT_TABLE_WRITER_H_
+#define CSV_EXPORT_TABLE_WRITER_H_
+
+#include <cstdint>
+#include <fstream>  // NOLINT
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+
+namespace csv_export {
+
+enum class ColumnType { kInt64, kFloat64, kUInt8 };
+
+// A column holds width values per row, e.g. 3 for a position or the number of
+// bytes for a descriptor.
+struct Column {
+  Column(const std::string& _name, ColumnType _type, size_t _width = 1u)
+      : name(_name), type(_type), width(_width) {}
+
+  std::string name;
+  ColumnType type;
+  size_t width;
+};
+
+struct TableSchema {
+  // Name of the table, used as file name of the exported table.
+  std::string name;
+  // The header line of the CSV file, without the new line.
+  std::string csv_header;
+  std::vector<Column> columns;
+
+  size_t getNumValuesPerRow() const;
+};
+
+// Rows of a table, stored row by row. The type of every value is given by the
+// column it belongs to.
+class TableRows {
+ public:
+  union Value {
+    int64_t integer;
+    double real;
+  };
+
+  void addInteger(const int64_t integer) {
+    Value value;
+    value.integer = integer;
+    values_.push_back(value);
+  }
+
+  void addReal(const double real) {
+    Value value;
+    value.real = real;
+    values_.push_back(value);
+  }
+
+  template <typename Derived>
+  void addReals(const Eigen::MatrixBase<Derived>& reals) {
+    for (int idx = 0; idx < reals.size(); ++idx) {
+      addReal(reals(idx));
+    }
+  }
+
+  const std::vector<Value>& getValues() const {
+    return values_;
+  }
+
+ private:
+  std::vector<Value> values_;
+};
+
+// Writes a table block by block. Serializing a block is thread-safe, such that
+// the blocks can be serialized in parallel and then written in order.
+class TableWriter {
+ public:
+  virtual ~TableWriter() {}
+
+  // Serializes the rows into one buffer per output file.
+  virtual void serialize(
+      const TableRows& rows, std::vector<std::string>* buffers) const = 0;
+  // Appends the buffers of one block to the output files.
+  virtual void write(const std::vector<std::string>& buffers) = 0;
+};
+
+// Writes the table to <folder>/<table name>.csv with the formatting of
+// common::FileLogger, i.e. the integers in decimal and the reals with 15
+// significant digits.
+class CsvTableWriter : public TableWriter {
+ public:
+  CsvTableWriter(
+      const TableSchema& schema, const std::string& folder,
+      const std::string& delimiter);
+
+  void serialize(
+      const TableRows& rows, std::vector<std::string>* buffers) const override;
+  void write(const std::vector<std::string>& buffers) override;
+
+ private:
+  const TableSchema schema_;
+  const std::string delimiter_;
+  std::ofstream file_;
+};
+
+// Writes the table to the folder <folder>/<table name>/ with one file per
+// column. The files hold the raw values of the column row by row in the byte
+// order of the machine and are named after the column, with the value type and
+// the width as extension, e.g. "position_m.float64x3" or "timestamp_ns.int64".
+// They can be read without parsing, e.g. with
+// numpy.fromfile(path, numpy.float64).reshape(-1, 3).
+class ColumnarTableWriter : public TableWriter {
+ public:
+  ColumnarTableWriter(const TableSchema& schema, const std::string& folder);
+
+  void serialize(
+      const TableRows& rows, std::vector<std::string>* buffers) const override;
+  void write(const std::vector<std::string>& buffers) override;
+
+ private:
+  const TableSchema schema_;
+  std::vector<std::unique_ptr<std::ofstream>> column_files_;
+};
+
+}  // namespace csv_export
+
+#endif  // CSV_EXPORT_TABLE_WRITER_H_
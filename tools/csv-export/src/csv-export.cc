@@ -1,17 +1,22 @@
 #include "csv-export/csv-export.h"
 
-#include <fstream>  // NOLINT
-#include <gflags/gflags.h>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <descriptor-projection/descriptor-projection.h>
 #include <descriptor-projection/flags.h>
-#include <maplab-common/binary-serialization.h>
-#include <maplab-common/conversions.h>
-#include <maplab-common/file-logger.h>
+#include <gflags/gflags.h>
 #include <maplab-common/file-system-tools.h>
+#include <maplab-common/parallel-process.h>
 #include <maplab-common/progress-bar.h>
 #include <vi-map/landmark-quality-metrics.h>
 
+#include "csv-export/table-writer.h"
+
 DEFINE_bool(
     only_export_high_quality_landmarks, false,
     "If true export only "
@@ -30,176 +35,352 @@ namespace {
 
 static constexpr char kDelimiter[] = ", ";
 
+// Number of vertices, landmarks or edges whose rows are filled and serialized
+// as one block.
+constexpr size_t kNumItemsPerBlock = 64u;
+// Number of blocks per thread that are held in memory before they are
+// written, which bounds the memory of the export.
+constexpr size_t kNumBlocksInMemoryPerThread = 8u;
+
+enum class ExportFormat { kCsv, kColumnar };
+
 typedef std::unordered_map<pose_graph::VertexId, size_t> VertexIdToIndexMap;
+typedef std::vector<std::unique_ptr<TableWriter>> TableWriters;
+
+// Fills the rows of the tables for the given range of items, one TableRows per
+// table writer.
+typedef std::function<void(size_t, size_t, std::vector<TableRows>*)>
+    RowFiller;
+
+std::string joinWithDelimiter(const std::vector<std::string>& strings) {
+  std::string joined;
+  for (size_t idx = 0u; idx < strings.size(); ++idx) {
+    if (idx != 0u) {
+      joined += kDelimiter;
+    }
+    joined += strings[idx];
+  }
+  return joined;
+}
 
-void exportVerticesAndTracksToCsv(
-    const vi_map::VIMap& map, const vi_map::MissionId& mission_id,
-    const std::string& base_path, size_t* vertex_index,
-    VertexIdToIndexMap* vertex_id_to_index_map) {
-  CHECK_NOTNULL(vertex_index);
-  CHECK_NOTNULL(vertex_id_to_index_map);
-
-  const std::string path_vertices =
-      common::concatenateFolderAndFileName(base_path, "vertices.csv");
-  common::FileLogger logger_vertices(path_vertices);
-  logger_vertices.writeDataWithDelimiterAndNewLine(
-      kDelimiter, "vertex index", "timestamp [ns]", "position x [m]",
-      "position y [m]", "position z [m]", "quaternion x", "quaternion y",
-      "quaternion z", "quaternion w", "velocity x [m/s]", "velocity y [m/s]",
-      "velocity z [m/s]", "acc bias x [m/s^2]", "acc bias y [m/s^2]",
-      "acc bias z [m/s^2]", "gyro bias x [rad/s]", "gyro bias y [rad/s]",
-      "gyro bias z [rad/s]");
-
-  const std::string path_tracks =
-      common::concatenateFolderAndFileName(base_path, "tracks.csv");
-  common::FileLogger logger_tracks(path_tracks);
-  logger_tracks.writeDataWithDelimiterAndNewLine(
-      kDelimiter, "timestamp [ns]", "vertex index", "frame index",
-      "keypoint index", "keypoint measurement 0 [px]",
-      "keypoint measurement 1 [px]", "keypoint measurement uncertainty",
-      "keypoint scale", "keypoint track id");
-
-  const std::string path_descriptor =
-      common::concatenateFolderAndFileName(base_path, "descriptor.csv");
-  common::FileLogger logger_descriptor(path_descriptor);
-  logger_tracks.writeDataWithDelimiterAndNewLine(
-      kDelimiter, "Descriptor byte as integer 1-N");
-
-  pose_graph::VertexIdList vertex_ids_in_mission;
-  map.getAllVertexIdsInMissionAlongGraph(mission_id, &vertex_ids_in_mission);
-
-  common::ProgressBar progress_bar(vertex_ids_in_mission.size());
-  for (const pose_graph::VertexId& vertex_id : vertex_ids_in_mission) {
-    const vi_map::Vertex& vertex = map.getVertex(vertex_id);
+std::unique_ptr<TableWriter> createTableWriter(
+    const TableSchema& schema, const std::string& folder,
+    const ExportFormat format) {
+  if (format == ExportFormat::kCsv) {
+    return std::unique_ptr<TableWriter>(
+        new CsvTableWriter(schema, folder, kDelimiter));
+  }
+  return std::unique_ptr<TableWriter>(new ColumnarTableWriter(schema, folder));
+}
 
-    // Write vertex data itself.
-    const aslam::Transformation T_G_I = map.getVertex_T_G_I(vertex_id);
-    const Eigen::Vector3d& v_M = vertex.get_v_M();
-    const Eigen::Vector3d& acc_bias = vertex.getAccelBias();
-    const Eigen::Vector3d& gyro_bias = vertex.getGyroBias();
-
-    logger_vertices.writeDataWithDelimiterAndNewLine(
-        kDelimiter, *vertex_index, vertex.getMinTimestampNanoseconds(),
-        T_G_I.getPosition(), T_G_I.getEigenQuaternion(), v_M, acc_bias,
-        gyro_bias);
-
-    vertex_id_to_index_map->emplace(vertex_id, *vertex_index);
-
-    // Frame data.
-    vertex.forEachFrame(
-        [&](const unsigned int frame_index, const aslam::VisualFrame& frame) {
-          const size_t num_keypoints = frame.getNumKeypointMeasurements();
-          const size_t num_bytes_per_descriptor =
-              frame.getDescriptorSizeBytes();
-
-          const int64_t timestamp_ns = frame.getTimestampNanoseconds();
-          const Eigen::Matrix2Xd& keypoint_measurements =
-              frame.getKeypointMeasurements();
-          const Eigen::VectorXd& keypoint_measurment_uncertainties =
-              frame.getKeypointMeasurementUncertainties();
-          const Eigen::VectorXd& keypoint_scales = frame.getKeypointScales();
-          const Eigen::VectorXi& track_ids = frame.getTrackIds();
-          for (size_t keypoint_idx = 0u; keypoint_idx < num_keypoints;
-               ++keypoint_idx) {
-            logger_tracks.writeDataWithDelimiterAndNewLine(
-                kDelimiter, timestamp_ns, *vertex_index, frame_index,
-                keypoint_idx, keypoint_measurements(0, keypoint_idx),
-                keypoint_measurements(1, keypoint_idx),
-                keypoint_measurment_uncertainties(keypoint_idx),
-                keypoint_scales(keypoint_idx), track_ids(keypoint_idx));
-
-            const unsigned char* descriptor =
-                CHECK_NOTNULL(frame.getDescriptor(keypoint_idx));
-            for (size_t descriptor_idx = 0u;
-                 descriptor_idx < num_bytes_per_descriptor; ++descriptor_idx) {
-              if (descriptor_idx != 0u) {
-                logger_descriptor << kDelimiter;
-              }
-              logger_descriptor
-                  << static_cast<size_t>(descriptor[descriptor_idx]);
+// Fills and serializes the rows of blocks of items in parallel and writes the
+// blocks in order. Only a bounded number of blocks is held in memory.
+void exportTablesInBlocks(
+    const size_t num_items, const RowFiller& fill_rows,
+    const TableWriters& writers, common::ProgressBar* progress_bar) {
+  const size_t num_threads = common::getNumHardwareThreads();
+  const size_t num_blocks =
+      (num_items + kNumItemsPerBlock - 1u) / kNumItemsPerBlock;
+  const size_t max_num_blocks_in_memory =
+      num_threads * kNumBlocksInMemoryPerThread;
+
+  for (size_t first_block_idx = 0u; first_block_idx < num_blocks;
+       first_block_idx += max_num_blocks_in_memory) {
+    const size_t num_blocks_in_memory =
+        std::min(max_num_blocks_in_memory, num_blocks - first_block_idx);
+    // The serialized buffers of every block and table writer.
+    std::vector<std::vector<std::vector<std::string>>> block_buffers(
+        num_blocks_in_memory);
+    common::ParallelProcessDynamic(
+        num_blocks_in_memory,
+        [&](const size_t begin, const size_t end) {
+          for (size_t block_idx = begin; block_idx < end; ++block_idx) {
+            const size_t begin_item =
+                (first_block_idx + block_idx) * kNumItemsPerBlock;
+            const size_t end_item =
+                std::min(begin_item + kNumItemsPerBlock, num_items);
+            std::vector<TableRows> rows(writers.size());
+            fill_rows(begin_item, end_item, &rows);
+
+            block_buffers[block_idx].resize(writers.size());
+            for (size_t writer_idx = 0u; writer_idx < writers.size();
+                 ++writer_idx) {
+              writers[writer_idx]->serialize(
+                  rows[writer_idx], &block_buffers[block_idx][writer_idx]);
             }
-            logger_descriptor << std::endl;
           }
-        });
+        },
+        num_threads);
+
+    for (const std::vector<std::vector<std::string>>& buffers :
+         block_buffers) {
+      for (size_t writer_idx = 0u; writer_idx < writers.size();
+           ++writer_idx) {
+        writers[writer_idx]->write(buffers[writer_idx]);
+      }
+    }
+    if (progress_bar != nullptr) {
+      progress_bar->update(
+          std::min(
+              (first_block_idx + num_blocks_in_memory) * kNumItemsPerBlock,
+              num_items));
+    }
+  }
+}
 
-    ++(*vertex_index);
-    progress_bar.increment();
+// Returns the descriptor size of the first frame with keypoints, all frames
+// of the mission are expected to have descriptors of the same size.
+size_t getDescriptorSizeBytes(
+    const vi_map::VIMap& map, const pose_graph::VertexIdList& vertex_ids) {
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    const vi_map::Vertex& vertex = map.getVertex(vertex_id);
+    for (size_t frame_idx = 0u; frame_idx < vertex.numFrames(); ++frame_idx) {
+      const aslam::VisualFrame& frame = vertex.getVisualFrame(frame_idx);
+      if (frame.getNumKeypointMeasurements() > 0u) {
+        return frame.getDescriptorSizeBytes();
+      }
+    }
   }
+  return 0u;
+}
+
+void exportVerticesAndTracks(
+    const vi_map::VIMap& map, const pose_graph::VertexIdList& vertex_ids,
+    const size_t first_vertex_index, const std::string& base_path,
+    const ExportFormat format) {
+  TableSchema vertices_schema;
+  vertices_schema.name = "vertices";
+  vertices_schema.csv_header = joinWithDelimiter(
+      {"vertex index", "timestamp [ns]", "position x [m]", "position y [m]",
+       "position z [m]", "quaternion x", "quaternion y", "quaternion z",
+       "quaternion w", "velocity x [m/s]", "velocity y [m/s]",
+       "velocity z [m/s]", "acc bias x [m/s^2]", "acc bias y [m/s^2]",
+       "acc bias z [m/s^2]", "gyro bias x [rad/s]", "gyro bias y [rad/s]",
+       "gyro bias z [rad/s]"});
+  vertices_schema.columns = {
+      Column("vertex_index", ColumnType::kInt64),
+      Column("timestamp_ns", ColumnType::kInt64),
+      Column("position_m", ColumnType::kFloat64, 3u),
+      Column("quaternion_xyzw", ColumnType::kFloat64, 4u),
+      Column("velocity_m_s", ColumnType::kFloat64, 3u),
+      Column("acc_bias_m_s2", ColumnType::kFloat64, 3u),
+      Column("gyro_bias_rad_s", ColumnType::kFloat64, 3u)};
+
+  TableSchema tracks_schema;
+  tracks_schema.name = "tracks";
+  tracks_schema.csv_header = joinWithDelimiter(
+      {"timestamp [ns]", "vertex index", "frame index", "keypoint index",
+       "keypoint measurement 0 [px]", "keypoint measurement 1 [px]",
+       "keypoint measurement uncertainty", "keypoint scale",
+       "keypoint track id"});
+  tracks_schema.columns = {
+      Column("timestamp_ns", ColumnType::kInt64),
+      Column("vertex_index", ColumnType::kInt64),
+      Column("frame_index", ColumnType::kInt64),
+      Column("keypoint_index", ColumnType::kInt64),
+      Column("keypoint_measurement_px", ColumnType::kFloat64, 2u),
+      Column("keypoint_measurement_uncertainty", ColumnType::kFloat64),
+      Column("keypoint_scale", ColumnType::kFloat64),
+      Column("keypoint_track_id", ColumnType::kInt64)};
+
+  const size_t descriptor_size_bytes = getDescriptorSizeBytes(map, vertex_ids);
+  TableSchema descriptor_schema;
+  descriptor_schema.name = "descriptor";
+  descriptor_schema.csv_header = "Descriptor byte as integer 1-N";
+  descriptor_schema.columns = {
+      Column("descriptor", ColumnType::kUInt8, descriptor_size_bytes)};
+
+  enum TableIndex { kVertices, kTracks, kDescriptor };
+  TableWriters writers;
+  writers.push_back(createTableWriter(vertices_schema, base_path, format));
+  writers.push_back(createTableWriter(tracks_schema, base_path, format));
+  writers.push_back(createTableWriter(descriptor_schema, base_path, format));
+
+  const RowFiller fill_rows = [&](
+      const size_t begin, const size_t end, std::vector<TableRows>* rows) {
+    CHECK_NOTNULL(rows);
+    TableRows& vertex_rows = (*rows)[kVertices];
+    TableRows& track_rows = (*rows)[kTracks];
+    TableRows& descriptor_rows = (*rows)[kDescriptor];
+    for (size_t idx = begin; idx < end; ++idx) {
+      const pose_graph::VertexId& vertex_id = vertex_ids[idx];
+      const vi_map::Vertex& vertex = map.getVertex(vertex_id);
+      const size_t vertex_index = first_vertex_index + idx;
+
+      // Write vertex data itself.
+      const aslam::Transformation T_G_I = map.getVertex_T_G_I(vertex_id);
+      vertex_rows.addInteger(vertex_index);
+      vertex_rows.addInteger(vertex.getMinTimestampNanoseconds());
+      vertex_rows.addReals(T_G_I.getPosition());
+      vertex_rows.addReals(T_G_I.getEigenQuaternion().coeffs());
+      vertex_rows.addReals(vertex.get_v_M());
+      vertex_rows.addReals(vertex.getAccelBias());
+      vertex_rows.addReals(vertex.getGyroBias());
+
+      // Frame data.
+      vertex.forEachFrame(
+          [&](const unsigned int frame_index, const aslam::VisualFrame& frame) {
+            const size_t num_keypoints = frame.getNumKeypointMeasurements();
+            if (num_keypoints == 0u) {
+              return;
+            }
+            CHECK_EQ(frame.getDescriptorSizeBytes(), descriptor_size_bytes)
+                << "All frames of a mission need to have descriptors of the "
+                << "same size.";
+
+            const int64_t timestamp_ns = frame.getTimestampNanoseconds();
+            const Eigen::Matrix2Xd& keypoint_measurements =
+                frame.getKeypointMeasurements();
+            const Eigen::VectorXd& keypoint_measurement_uncertainties =
+                frame.getKeypointMeasurementUncertainties();
+            const Eigen::VectorXd& keypoint_scales = frame.getKeypointScales();
+            const Eigen::VectorXi& track_ids = frame.getTrackIds();
+            for (size_t keypoint_idx = 0u; keypoint_idx < num_keypoints;
+                 ++keypoint_idx) {
+              track_rows.addInteger(timestamp_ns);
+              track_rows.addInteger(vertex_index);
+              track_rows.addInteger(frame_index);
+              track_rows.addInteger(keypoint_idx);
+              track_rows.addReals(keypoint_measurements.col(keypoint_idx));
+              track_rows.addReal(
+                  keypoint_measurement_uncertainties(keypoint_idx));
+              track_rows.addReal(keypoint_scales(keypoint_idx));
+              track_rows.addInteger(track_ids(keypoint_idx));
+
+              const unsigned char* descriptor =
+                  CHECK_NOTNULL(frame.getDescriptor(keypoint_idx));
+              for (size_t byte_idx = 0u; byte_idx < descriptor_size_bytes;
+                   ++byte_idx) {
+                descriptor_rows.addInteger(descriptor[byte_idx]);
+              }
+            }
+          });
+    }
+  };
+
+  common::ProgressBar progress_bar(vertex_ids.size());
+  exportTablesInBlocks(vertex_ids.size(), fill_rows, writers, &progress_bar);
 }
 
-void exportLandmarksAndObservationsToCsv(
+void exportLandmarksAndObservations(
     const vi_map::VIMap& map, const vi_map::MissionId& mission_id,
     const std::string& base_path,
-    const VertexIdToIndexMap& vertex_id_to_index_map, size_t* landmark_index) {
+    const VertexIdToIndexMap& vertex_id_to_index_map,
+    const ExportFormat format, size_t* landmark_index) {
   CHECK_NOTNULL(landmark_index);
 
-  const std::string path_landmarks =
-      common::concatenateFolderAndFileName(base_path, "landmarks.csv");
-  common::FileLogger logger_landmarks(path_landmarks);
-  logger_landmarks.writeDataWithDelimiterAndNewLine(
-      kDelimiter, "landmark index", "landmark position x [m]",
-      "landmark position y [m]", "landmark position z [m]");
-
-  const std::string path_observations =
-      common::concatenateFolderAndFileName(base_path, "observations.csv");
-  common::FileLogger logger_observations(path_observations);
-  logger_observations.writeDataWithDelimiterAndNewLine(
-      kDelimiter, "vertex index", "frame index", "keypoint index",
-      "landmark index");
-
+  TableSchema landmarks_schema;
+  landmarks_schema.name = "landmarks";
+  landmarks_schema.csv_header = joinWithDelimiter(
+      {"landmark index", "landmark position x [m]", "landmark position y [m]",
+       "landmark position z [m]"});
+  landmarks_schema.columns = {
+      Column("landmark_index", ColumnType::kInt64),
+      Column("landmark_position_m", ColumnType::kFloat64, 3u)};
+
+  TableSchema observations_schema;
+  observations_schema.name = "observations";
+  observations_schema.csv_header = joinWithDelimiter(
+      {"vertex index", "frame index", "keypoint index", "landmark index"});
+  observations_schema.columns = {
+      Column("vertex_index", ColumnType::kInt64),
+      Column("frame_index", ColumnType::kInt64),
+      Column("keypoint_index", ColumnType::kInt64),
+      Column("landmark_index", ColumnType::kInt64)};
+
+  enum TableIndex { kLandmarks, kObservations };
+  TableWriters writers;
+  writers.push_back(createTableWriter(landmarks_schema, base_path, format));
+  writers.push_back(createTableWriter(observations_schema, base_path, format));
+
+  // The landmark indices are consecutive over the exported landmarks, so the
+  // landmarks are filtered before they are exported.
   vi_map::LandmarkIdList all_landmarks_in_mission;
   map.getAllLandmarkIdsInMission(mission_id, &all_landmarks_in_mission);
-  for (const vi_map::LandmarkId& landmark_id : all_landmarks_in_mission) {
-    if (!landmark_id.isValid()) {
-      continue;
+  std::vector<unsigned char> is_landmark_exported(
+      all_landmarks_in_mission.size(), 0u);
+  common::ParallelProcessDynamic(
+      all_landmarks_in_mission.size(),
+      [&](const size_t begin, const size_t end) {
+        for (size_t idx = begin; idx < end; ++idx) {
+          const vi_map::LandmarkId& landmark_id = all_landmarks_in_mission[idx];
+          is_landmark_exported[idx] =
+              landmark_id.isValid() &&
+              (!FLAGS_only_export_high_quality_landmarks ||
+               vi_map::isLandmarkWellConstrained(
+                   map, map.getLandmark(landmark_id)));
+        }
+      },
+      common::getNumHardwareThreads());
+  vi_map::LandmarkIdList exported_landmarks;
+  for (size_t idx = 0u; idx < all_landmarks_in_mission.size(); ++idx) {
+    if (is_landmark_exported[idx]) {
+      exported_landmarks.push_back(all_landmarks_in_mission[idx]);
     }
-    if (FLAGS_only_export_high_quality_landmarks) {
-      if (!vi_map::isLandmarkWellConstrained(
-              map, map.getLandmark(landmark_id))) {
-        continue;
+  }
+  const size_t first_landmark_index = *landmark_index;
+
+  const RowFiller fill_rows = [&](
+      const size_t begin, const size_t end, std::vector<TableRows>* rows) {
+    CHECK_NOTNULL(rows);
+    TableRows& landmark_rows = (*rows)[kLandmarks];
+    TableRows& observation_rows = (*rows)[kObservations];
+    for (size_t idx = begin; idx < end; ++idx) {
+      const vi_map::LandmarkId& landmark_id = exported_landmarks[idx];
+      const size_t landmark_index = first_landmark_index + idx;
+
+      landmark_rows.addInteger(landmark_index);
+      landmark_rows.addReals(map.getLandmark_G_p_fi(landmark_id));
+
+      // Write observations.
+      const vi_map::KeypointIdentifierList& keypoint_identifier_list =
+          map.getLandmark(landmark_id).getObservations();
+      for (const vi_map::KeypointIdentifier& keypoint_identifier :
+           keypoint_identifier_list) {
+        const VertexIdToIndexMap::const_iterator it_vertex_id_to_index =
+            vertex_id_to_index_map.find(
+                keypoint_identifier.frame_id.vertex_id);
+        CHECK(it_vertex_id_to_index != vertex_id_to_index_map.end());
+        observation_rows.addInteger(it_vertex_id_to_index->second);
+        observation_rows.addInteger(keypoint_identifier.frame_id.frame_index);
+        observation_rows.addInteger(keypoint_identifier.keypoint_index);
+        observation_rows.addInteger(landmark_index);
       }
     }
+  };
 
-    const vi_map::Landmark& landmark = map.getLandmark(landmark_id);
-    const Eigen::Vector3d landmark_position =
-        map.getLandmark_G_p_fi(landmark_id);
-
-    logger_landmarks.writeDataWithDelimiterAndNewLine(
-        kDelimiter, *landmark_index, landmark_position);
-
-    // Write observations.
-    const vi_map::KeypointIdentifierList& keypoint_identifier_list =
-        landmark.getObservations();
-    for (const vi_map::KeypointIdentifier& keypoint_identifier :
-         keypoint_identifier_list) {
-      const pose_graph::VertexId& vertex_id =
-          keypoint_identifier.frame_id.vertex_id;
-      const VertexIdToIndexMap::const_iterator it_vertex_id_to_index =
-          vertex_id_to_index_map.find(vertex_id);
-      CHECK(it_vertex_id_to_index != vertex_id_to_index_map.end());
-      logger_observations.writeDataWithDelimiterAndNewLine(
-          kDelimiter, it_vertex_id_to_index->second,
-          keypoint_identifier.frame_id.frame_index,
-          keypoint_identifier.keypoint_index, *landmark_index);
-    }
-
-    ++(*landmark_index);
-  }
+  exportTablesInBlocks(exported_landmarks.size(), fill_rows, writers, nullptr);
+  *landmark_index += exported_landmarks.size();
 }
 
-void exportImuDataToCsv(
+void exportImuData(
     const vi_map::VIMap& map, const vi_map::MissionId& mission_id,
-    const std::string& base_path) {
-  const std::string path_imu =
-      common::concatenateFolderAndFileName(base_path, "imu.csv");
-  common::FileLogger logger_imu(path_imu);
-  logger_imu.writeDataWithDelimiterAndNewLine(
-      kDelimiter, "timestamp [ns]", "acc x [m/s^2]", "acc y [m/s^2]",
-      "acc z [m/s^2]", "gyro x [rad/s]", "gyro y [rad/s]", "gyro z [rad/s]");
+    const std::string& base_path, const ExportFormat format) {
+  TableSchema imu_schema;
+  imu_schema.name = "imu";
+  imu_schema.csv_header = joinWithDelimiter(
+      {"timestamp [ns]", "acc x [m/s^2]", "acc y [m/s^2]", "acc z [m/s^2]",
+       "gyro x [rad/s]", "gyro y [rad/s]", "gyro z [rad/s]"});
+  imu_schema.columns = {
+      Column("timestamp_ns", ColumnType::kInt64),
+      Column("acc_m_s2", ColumnType::kFloat64, 3u),
+      Column("gyro_rad_s", ColumnType::kFloat64, 3u)};
+
+  TableWriters writers;
+  writers.push_back(createTableWriter(imu_schema, base_path, format));
+
   pose_graph::EdgeIdList all_edges_in_mission;
   map.getAllEdgeIdsInMissionAlongGraph(mission_id, &all_edges_in_mission);
-  for (const pose_graph::EdgeId& edge_id : all_edges_in_mission) {
-    if (map.getEdgeType(edge_id) == vi_map::Edge::EdgeType::kViwls) {
+
+  const RowFiller fill_rows = [&](
+      const size_t begin, const size_t end, std::vector<TableRows>* rows) {
+    CHECK_NOTNULL(rows);
+    TableRows& imu_rows = rows->front();
+    for (size_t idx = begin; idx < end; ++idx) {
+      const pose_graph::EdgeId& edge_id = all_edges_in_mission[idx];
+      if (map.getEdgeType(edge_id) != vi_map::Edge::EdgeType::kViwls) {
+        continue;
+      }
       const vi_map::ViwlsEdge& viwls_edge =
           map.getEdgeAs<vi_map::ViwlsEdge>(edge_id);
       const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps =
@@ -210,43 +391,75 @@ void exportImuDataToCsv(
       const int num_measurements = imu_timestamps.cols();
       CHECK_EQ(num_measurements, imu_data.cols());
       for (int i = 0; i < num_measurements; ++i) {
-        logger_imu.writeDataWithDelimiterAndNewLine(
-            kDelimiter, imu_timestamps(i), imu_data.col(i));
+        imu_rows.addInteger(imu_timestamps(i));
+        imu_rows.addReals(imu_data.col(i));
       }
     }
-  }
-}
+  };
 
-}  // namespace
+  exportTablesInBlocks(
+      all_edges_in_mission.size(), fill_rows, writers, nullptr);
+}
 
-void exportMapToCsv(const vi_map::VIMap& map, const std::string& base_path) {
+void exportMap(
+    const vi_map::VIMap& map, const std::string& base_path,
+    const ExportFormat format) {
   CHECK(!base_path.empty());
   CHECK(common::createPath(base_path));
 
   vi_map::MissionIdList all_mission_ids;
   map.getAllMissionIds(&all_mission_ids);
 
+  // The vertex indices of all missions are assigned up front, such that the
+  // observations can refer to vertices of any mission.
+  std::vector<pose_graph::VertexIdList> vertex_ids_of_missions(
+      all_mission_ids.size());
   VertexIdToIndexMap vertex_id_to_index_map;
+  std::vector<size_t> first_vertex_index_of_missions(all_mission_ids.size());
   size_t vertex_index = 0u;
-  size_t landmark_index = 0u;
+  for (size_t mission_idx = 0u; mission_idx < all_mission_ids.size();
+       ++mission_idx) {
+    map.getAllVertexIdsInMissionAlongGraph(
+        all_mission_ids[mission_idx], &vertex_ids_of_missions[mission_idx]);
+    first_vertex_index_of_missions[mission_idx] = vertex_index;
+    for (const pose_graph::VertexId& vertex_id :
+         vertex_ids_of_missions[mission_idx]) {
+      vertex_id_to_index_map.emplace(vertex_id, vertex_index++);
+    }
+  }
 
-  for (const vi_map::MissionId& mission_id : all_mission_ids) {
+  size_t landmark_index = 0u;
+  for (size_t mission_idx = 0u; mission_idx < all_mission_ids.size();
+       ++mission_idx) {
+    const vi_map::MissionId& mission_id = all_mission_ids[mission_idx];
     const std::string base_path_for_mission =
         common::concatenateFolderAndFileName(base_path, mission_id.hexString());
     CHECK(common::createPath(base_path_for_mission));
 
     LOG(INFO) << "Exporting data from mission " << mission_id << ".";
 
-    exportVerticesAndTracksToCsv(
-        map, mission_id, base_path_for_mission, &vertex_index,
-        &vertex_id_to_index_map);
+    exportVerticesAndTracks(
+        map, vertex_ids_of_missions[mission_idx],
+        first_vertex_index_of_missions[mission_idx], base_path_for_mission,
+        format);
 
-    exportLandmarksAndObservationsToCsv(
-        map, mission_id, base_path_for_mission, vertex_id_to_index_map,
+    exportLandmarksAndObservations(
+        map, mission_id, base_path_for_mission, vertex_id_to_index_map, format,
         &landmark_index);
 
-    exportImuDataToCsv(map, mission_id, base_path_for_mission);
+    exportImuData(map, mission_id, base_path_for_mission, format);
   }
 }
 
+}  // namespace
+
+void exportMapToCsv(const vi_map::VIMap& map, const std::string& base_path) {
+  exportMap(map, base_path, ExportFormat::kCsv);
+}
+
+void exportMapToColumnarBinary(
+    const vi_map::VIMap& map, const std::string& base_path) {
+  exportMap(map, base_path, ExportFormat::kColumnar);
+}
+
 }  // namespace csv_export
@@ -0,0 +1,180 @@
+#include "csv-export/table-writer.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+#include <maplab-common/file-system-tools.h>
+
+namespace csv_export {
+
+namespace {
+// Reproduces the formatting of common::FileLogger, which prints the reals with
+// std::numeric_limits<double>::digits10 significant digits.
+void appendValue(
+    const TableRows::Value& value, const ColumnType type,
+    std::string* buffer) {
+  CHECK_NOTNULL(buffer);
+  char formatted[32];
+  int num_chars;
+  if (type == ColumnType::kFloat64) {
+    num_chars =
+        std::snprintf(formatted, sizeof(formatted), "%.15g", value.real);
+  } else {
+    num_chars = std::snprintf(
+        formatted, sizeof(formatted), "%" PRId64, value.integer);
+  }
+  CHECK_GT(num_chars, 0);
+  buffer->append(formatted, num_chars);
+}
+
+std::string getColumnFileName(const Column& column) {
+  std::string file_name = column.name;
+  switch (column.type) {
+    case ColumnType::kInt64:
+      file_name += ".int64";
+      break;
+    case ColumnType::kFloat64:
+      file_name += ".float64";
+      break;
+    case ColumnType::kUInt8:
+      file_name += ".uint8";
+      break;
+    default:
+      LOG(FATAL) << "Unknown column type " << static_cast<int>(column.type);
+  }
+  if (column.width > 1u) {
+    file_name += 'x' + std::to_string(column.width);
+  }
+  return file_name;
+}
+}  // namespace
+
+size_t TableSchema::getNumValuesPerRow() const {
+  size_t num_values_per_row = 0u;
+  for (const Column& column : columns) {
+    num_values_per_row += column.width;
+  }
+  return num_values_per_row;
+}
+
+CsvTableWriter::CsvTableWriter(
+    const TableSchema& schema, const std::string& folder,
+    const std::string& delimiter)
+    : schema_(schema), delimiter_(delimiter) {
+  const std::string path =
+      common::concatenateFolderAndFileName(folder, schema_.name + ".csv");
+  file_.open(path, std::ofstream::out | std::ofstream::trunc);
+  CHECK(file_.is_open()) << "Could not open: " << path;
+  file_ << schema_.csv_header << '\n';
+}
+
+void CsvTableWriter::serialize(
+    const TableRows& rows, std::vector<std::string>* buffers) const {
+  CHECK_NOTNULL(buffers)->assign(1u, std::string());
+  std::string& buffer = buffers->front();
+
+  const std::vector<TableRows::Value>& values = rows.getValues();
+  if (values.empty()) {
+    return;
+  }
+  const size_t num_values_per_row = schema_.getNumValuesPerRow();
+  CHECK_GT(num_values_per_row, 0u);
+  CHECK_EQ(values.size() % num_values_per_row, 0u);
+  // A rough guess to avoid most of the reallocations.
+  constexpr size_t kNumCharsPerValue = 12u;
+  buffer.reserve(values.size() * (kNumCharsPerValue + delimiter_.size()));
+
+  size_t value_idx = 0u;
+  while (value_idx < values.size()) {
+    bool is_first_value_of_row = true;
+    for (const Column& column : schema_.columns) {
+      for (size_t element_idx = 0u; element_idx < column.width;
+           ++element_idx) {
+        if (!is_first_value_of_row) {
+          buffer += delimiter_;
+        }
+        is_first_value_of_row = false;
+        appendValue(values[value_idx++], column.type, &buffer);
+      }
+    }
+    buffer += '\n';
+  }
+}
+
+void CsvTableWriter::write(const std::vector<std::string>& buffers) {
+  CHECK_EQ(buffers.size(), 1u);
+  file_.write(buffers.front().data(), buffers.front().size());
+  CHECK(file_.good()) << "Writing the table " << schema_.name << " failed.";
+}
+
+ColumnarTableWriter::ColumnarTableWriter(
+    const TableSchema& schema, const std::string& folder)
+    : schema_(schema) {
+  const std::string table_folder =
+      common::concatenateFolderAndFileName(folder, schema_.name);
+  CHECK(common::createPath(table_folder));
+  for (const Column& column : schema_.columns) {
+    const std::string path = common::concatenateFolderAndFileName(
+        table_folder, getColumnFileName(column));
+    column_files_.emplace_back(new std::ofstream(
+        path, std::ofstream::out | std::ofstream::trunc |
+                  std::ofstream::binary));
+    CHECK(column_files_.back()->is_open()) << "Could not open: " << path;
+  }
+}
+
+void ColumnarTableWriter::serialize(
+    const TableRows& rows, std::vector<std::string>* buffers) const {
+  const size_t num_columns = schema_.columns.size();
+  CHECK_NOTNULL(buffers)->assign(num_columns, std::string());
+
+  const std::vector<TableRows::Value>& values = rows.getValues();
+  if (values.empty()) {
+    return;
+  }
+  const size_t num_values_per_row = schema_.getNumValuesPerRow();
+  CHECK_GT(num_values_per_row, 0u);
+  CHECK_EQ(values.size() % num_values_per_row, 0u);
+  const size_t num_rows = values.size() / num_values_per_row;
+
+  size_t first_value_of_column = 0u;
+  for (size_t column_idx = 0u; column_idx < num_columns; ++column_idx) {
+    const Column& column = schema_.columns[column_idx];
+    std::string& buffer = (*buffers)[column_idx];
+    const size_t value_size_bytes =
+        column.type == ColumnType::kUInt8 ? 1u : sizeof(TableRows::Value);
+    buffer.resize(num_rows * column.width * value_size_bytes);
+
+    char* data = &buffer[0];
+    for (size_t row_idx = 0u; row_idx < num_rows; ++row_idx) {
+      const TableRows::Value* row_values =
+          &values[row_idx * num_values_per_row + first_value_of_column];
+      for (size_t element_idx = 0u; element_idx < column.width;
+           ++element_idx) {
+        if (column.type == ColumnType::kUInt8) {
+          *data = static_cast<char>(
+              static_cast<uint8_t>(row_values[element_idx].integer));
+        } else {
+          // Both value types have 8 bytes, so the raw value is copied.
+          std::memcpy(data, &row_values[element_idx], value_size_bytes);
+        }
+        data += value_size_bytes;
+      }
+    }
+    first_value_of_column += column.width;
+  }
+}
+
+void ColumnarTableWriter::write(const std::vector<std::string>& buffers) {
+  CHECK_EQ(buffers.size(), column_files_.size());
+  for (size_t column_idx = 0u; column_idx < buffers.size(); ++column_idx) {
+    std::ofstream& file = *column_files_[column_idx];
+    file.write(buffers[column_idx].data(), buffers[column_idx].size());
+    CHECK(file.good()) << "Writing the column "
+                       << schema_.columns[column_idx].name << " of the table "
+                       << schema_.name << " failed.";
+  }
+}
+
+}  // namespace csv_export
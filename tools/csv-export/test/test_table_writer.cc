@@ -0,0 +1,125 @@
+#include <cstdint>
+#include <cstring>
+#include <fstream>  // NOLINT
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <gtest/gtest.h>
+#include <maplab-common/file-system-tools.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "csv-export/table-writer.h"
+
+namespace csv_export {
+
+class TableWriterTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    schema_.name = "table";
+    schema_.csv_header = "index, position x, position y, position z, byte";
+    schema_.columns = {Column("index", ColumnType::kInt64),
+                       Column("position", ColumnType::kFloat64, 3u),
+                       Column("byte", ColumnType::kUInt8)};
+
+    for (size_t row_idx = 0u; row_idx < kNumRows; ++row_idx) {
+      indices_.push_back(static_cast<int64_t>(row_idx) - 2);
+      positions_.push_back(Eigen::Vector3d::Random() * 1e3);
+      bytes_.push_back(static_cast<uint8_t>(250u + row_idx));
+    }
+    CHECK(common::createPath(kFolder));
+  }
+
+  // Writes the rows in two blocks.
+  void writeTable(TableWriter* writer) const {
+    CHECK_NOTNULL(writer);
+    const size_t kNumRowsInFirstBlock = 2u;
+    for (const std::pair<size_t, size_t>& block :
+         {std::make_pair(size_t{0u}, kNumRowsInFirstBlock),
+          std::make_pair(kNumRowsInFirstBlock, kNumRows)}) {
+      TableRows rows;
+      for (size_t row_idx = block.first; row_idx < block.second; ++row_idx) {
+        rows.addInteger(indices_[row_idx]);
+        rows.addReals(positions_[row_idx]);
+        rows.addInteger(bytes_[row_idx]);
+      }
+      std::vector<std::string> buffers;
+      writer->serialize(rows, &buffers);
+      writer->write(buffers);
+    }
+  }
+
+  static std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ifstream::binary);
+    EXPECT_TRUE(file.is_open()) << path;
+    return std::string(
+        std::istreambuf_iterator<char>(file),
+        std::istreambuf_iterator<char>());
+  }
+
+  static constexpr size_t kNumRows = 5u;
+  const std::string kFolder = "./table_writer_test";
+
+  TableSchema schema_;
+  std::vector<int64_t> indices_;
+  std::vector<Eigen::Vector3d> positions_;
+  std::vector<uint8_t> bytes_;
+};
+
+constexpr size_t TableWriterTest::kNumRows;
+
+TEST_F(TableWriterTest, CsvMatchesStreamFormatting) {
+  {
+    CsvTableWriter writer(schema_, kFolder, ", ");
+    writeTable(&writer);
+  }
+
+  // The same formatting as common::FileLogger.
+  std::ostringstream expected;
+  expected.precision(std::numeric_limits<double>::digits10);
+  expected << schema_.csv_header << '\n';
+  for (size_t row_idx = 0u; row_idx < kNumRows; ++row_idx) {
+    expected << indices_[row_idx] << ", " << positions_[row_idx].x() << ", "
+             << positions_[row_idx].y() << ", " << positions_[row_idx].z()
+             << ", " << static_cast<size_t>(bytes_[row_idx]) << '\n';
+  }
+  EXPECT_EQ(expected.str(), readFile(kFolder + "/table.csv"));
+}
+
+TEST_F(TableWriterTest, ColumnarHoldsRawColumns) {
+  {
+    ColumnarTableWriter writer(schema_, kFolder);
+    writeTable(&writer);
+  }
+
+  const std::string index_data = readFile(kFolder + "/table/index.int64");
+  ASSERT_EQ(kNumRows * sizeof(int64_t), index_data.size());
+  const std::string position_data =
+      readFile(kFolder + "/table/position.float64x3");
+  ASSERT_EQ(kNumRows * 3u * sizeof(double), position_data.size());
+  const std::string byte_data = readFile(kFolder + "/table/byte.uint8");
+  ASSERT_EQ(kNumRows, byte_data.size());
+
+  for (size_t row_idx = 0u; row_idx < kNumRows; ++row_idx) {
+    int64_t index;
+    std::memcpy(
+        &index, index_data.data() + row_idx * sizeof(int64_t), sizeof(index));
+    EXPECT_EQ(indices_[row_idx], index);
+
+    Eigen::Vector3d position;
+    std::memcpy(
+        position.data(), position_data.data() + row_idx * 3u * sizeof(double),
+        3u * sizeof(double));
+    EXPECT_EQ(positions_[row_idx], position);
+
+    EXPECT_EQ(bytes_[row_idx], static_cast<uint8_t>(byte_data[row_idx]));
+  }
+}
+
+}  // namespace csv_export
+
+MAPLAB_UNITTEST_ENTRYPOINT
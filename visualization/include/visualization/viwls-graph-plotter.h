@@ -1,7 +1,9 @@
 #ifndef VISUALIZATION_VIWLS_GRAPH_PLOTTER_H_
 #define VISUALIZATION_VIWLS_GRAPH_PLOTTER_H_
 
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <Eigen/Core>
@@ -28,11 +30,22 @@ class ViwlsGraphRvizPlotter {
       bool publish_edges, bool publish_landmarks) const;
   void visualizeMap(const vi_map::VIMap& map) const;
 
+  // Unless vis_publish_only_changed_missions is false, only the parts of the
+  // missions that changed since they were last published are republished.
   void visualizeMissions(
       const vi_map::VIMap& map, const vi_map::MissionIdList& mission_ids,
       bool publish_baseframes, bool publish_vertices, bool publish_edges,
       bool publish_landmarks) const;
 
+  // Overrides vis_landmark_voxel_size_m and vis_max_num_primitives for the
+  // landmark clouds published by this plotter, e.g. to keep the clouds of
+  // online visualization small.
+  void setLandmarkDecimation(double voxel_size_m, size_t max_num_landmarks);
+
+  // Forgets which missions were published, such that the next visualization
+  // republishes all of them, e.g. after RViz was restarted.
+  void resetPublishedMissions() const;
+
   void plotSlidingWindowLocalizationResult(
       const aslam::Transformation& T_G_B, size_t marker_id) const;
 
@@ -127,8 +140,39 @@ class ViwlsGraphRvizPlotter {
   static const std::string kSensorExtrinsicsTopic;
 
  private:
+  // Hashes of the visualized content of a mission, zero if not published.
+  struct MissionSignatures {
+    size_t baseframe = 0u;
+    size_t vertices = 0u;
+    size_t edges = 0u;
+    size_t landmarks = 0u;
+  };
+
+  void computeMissionSignatures(
+      const vi_map::VIMap& map, const vi_map::MissionId& mission_id,
+      size_t settings_signature, MissionSignatures* signatures) const;
+
+  // Clears the markers of the chunks that were published on the topic with
+  // the marker id before, but are not part of the latest num_chunks anymore.
+  void clearStaleLineChunks(
+      const std::string& topic, size_t marker_id, size_t num_chunks) const;
+
+  void decimateLandmarks(visualization::SphereVector* spheres) const;
+
   visualization::LineSegmentVector reference_edges_line_segments_;
   Eigen::Vector3d origin_;
+
+  bool has_landmark_decimation_override_;
+  double landmark_voxel_size_m_;
+  size_t max_num_landmarks_;
+
+  mutable std::mutex published_state_mutex_;
+  mutable std::unordered_map<vi_map::MissionId, MissionSignatures>
+      published_missions_;
+  mutable std::unordered_map<vi_map::MissionId, visualization::SphereVector>
+      published_mission_spheres_;
+  mutable size_t published_landmark_cloud_signature_ = 0u;
+  mutable std::unordered_map<std::string, size_t> num_published_line_chunks_;
 };
 
 }  // namespace visualization
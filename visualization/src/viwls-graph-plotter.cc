@@ -1,8 +1,12 @@
 #include "visualization/viwls-graph-plotter.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <functional>
 #include <limits>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -74,7 +78,147 @@ DEFINE_int32(
     "Minimum number of observer missions for a landmark to be "
     "visualized.");
 
+DEFINE_double(
+    vis_landmark_voxel_size_m, 0.0,
+    "If positive, only one landmark per voxel of this size is visualized.");
+DEFINE_uint64(
+    vis_max_num_primitives, 1000000u,
+    "Maximum number of landmarks, edges and vertices that are visualized per "
+    "call, larger sets are decimated evenly. (0: unlimited)");
+DEFINE_uint64(
+    vis_num_primitives_per_chunk, 50000u,
+    "Edges and vertices are published in messages of at most this many "
+    "primitives. (0: one message)");
+DEFINE_int32(
+    vis_chunk_publish_period_ms, 20,
+    "Pause between publishing two chunks of edges or vertices, such that RViz "
+    "keeps up.");
+DEFINE_bool(
+    vis_publish_only_changed_missions, true,
+    "Only republish the baseframes, vertices, edges and landmarks of missions "
+    "that changed since they were last published. Set to false to force a "
+    "full republish, e.g. after restarting RViz.");
+
 namespace visualization {
+
+namespace {
+// Returns the stride with which the primitives are decimated to fit into the
+// budget given by vis_max_num_primitives.
+size_t getDecimationStride(
+    const size_t num_primitives, const size_t max_num_primitives) {
+  if (max_num_primitives == 0u || num_primitives <= max_num_primitives) {
+    return 1u;
+  }
+  return (num_primitives + max_num_primitives - 1u) / max_num_primitives;
+}
+
+size_t getDecimationStride(const size_t num_primitives) {
+  return getDecimationStride(num_primitives, FLAGS_vis_max_num_primitives);
+}
+
+struct VoxelIndexHash {
+  size_t operator()(const Eigen::Vector3i& voxel_index) const {
+    constexpr size_t kPrime1 = 73856093u;
+    constexpr size_t kPrime2 = 19349663u;
+    constexpr size_t kPrime3 = 83492791u;
+    return (static_cast<size_t>(voxel_index.x()) * kPrime1) ^
+           (static_cast<size_t>(voxel_index.y()) * kPrime2) ^
+           (static_cast<size_t>(voxel_index.z()) * kPrime3);
+  }
+};
+
+// Keeps the first landmark of every voxel and decimates the remaining ones to
+// fit into the budget.
+void decimateLandmarkSpheres(
+    const double voxel_size_m, const size_t max_num_landmarks,
+    visualization::SphereVector* spheres) {
+  CHECK_NOTNULL(spheres);
+  if (voxel_size_m > 0.0) {
+    std::unordered_set<Eigen::Vector3i, VoxelIndexHash> occupied_voxels;
+    occupied_voxels.reserve(spheres->size());
+    size_t num_kept_spheres = 0u;
+    for (const visualization::Sphere& sphere : *spheres) {
+      const Eigen::Vector3i voxel_index =
+          (sphere.position / voxel_size_m)
+              .array()
+              .floor()
+              .cast<int>()
+              .matrix();
+      if (occupied_voxels.insert(voxel_index).second) {
+        (*spheres)[num_kept_spheres++] = sphere;
+      }
+    }
+    spheres->resize(num_kept_spheres);
+  }
+
+  const size_t stride =
+      getDecimationStride(spheres->size(), max_num_landmarks);
+  if (stride > 1u) {
+    size_t num_kept_spheres = 0u;
+    for (size_t idx = 0u; idx < spheres->size(); idx += stride) {
+      (*spheres)[num_kept_spheres++] = (*spheres)[idx];
+    }
+    spheres->resize(num_kept_spheres);
+  }
+}
+
+// Publishes the primitives in chunks of vis_num_primitives_per_chunk, pausing
+// between the chunks. Returns the number of published chunks.
+template <typename PrimitiveVector>
+size_t publishInChunks(
+    const PrimitiveVector& primitives,
+    const std::function<void(const PrimitiveVector&, size_t)>& publish_chunk) {
+  const size_t num_primitives_per_chunk =
+      FLAGS_vis_num_primitives_per_chunk > 0u
+          ? FLAGS_vis_num_primitives_per_chunk
+          : std::max<size_t>(primitives.size(), 1u);
+  size_t chunk_idx = 0u;
+  for (size_t begin = 0u; begin < primitives.size();
+       begin += num_primitives_per_chunk, ++chunk_idx) {
+    if (chunk_idx > 0u && FLAGS_vis_chunk_publish_period_ms > 0) {
+      std::this_thread::sleep_for(
+          std::chrono::milliseconds(FLAGS_vis_chunk_publish_period_ms));
+    }
+    const size_t end =
+        std::min(begin + num_primitives_per_chunk, primitives.size());
+    const PrimitiveVector chunk(
+        primitives.begin() + begin, primitives.begin() + end);
+    publish_chunk(chunk, chunk_idx);
+  }
+  return chunk_idx;
+}
+
+// Combines the hash of the value into the seed, like boost::hash_combine.
+template <typename Type>
+void combineHash(const Type& value, size_t* seed) {
+  CHECK_NOTNULL(seed);
+  *seed ^= std::hash<Type>()(value) + 0x9e3779b9 + (*seed << 6) + (*seed >> 2);
+}
+
+template <typename Derived>
+void combineMatrixHash(
+    const Eigen::MatrixBase<Derived>& matrix, size_t* seed) {
+  for (int idx = 0; idx < matrix.size(); ++idx) {
+    combineHash<double>(matrix(idx), seed);
+  }
+}
+
+// Returns a hash of the values of all visualization flags, such that changing
+// any of them republishes all missions.
+size_t getVisualizationSettingsSignature() {
+  std::vector<google::CommandLineFlagInfo> flags;
+  google::GetAllFlags(&flags);
+  size_t signature = 0u;
+  for (const google::CommandLineFlagInfo& flag : flags) {
+    if (flag.name.compare(0u, 4u, "vis_") == 0) {
+      combineHash(flag.name, &signature);
+      combineHash(flag.current_value, &signature);
+    }
+  }
+  return signature;
+}
+}  // namespace
+
 const std::string ViwlsGraphRvizPlotter::kCamPredictionTopic =
     "cam_predictions";
 const std::string ViwlsGraphRvizPlotter::kEdgeTopic =
@@ -105,7 +249,31 @@ const std::string ViwlsGraphRvizPlotter::kSensorExtrinsicsTopic =
 
 ViwlsGraphRvizPlotter::ViwlsGraphRvizPlotter()
     : origin_(
-          FLAGS_vis_offset_x_m, FLAGS_vis_offset_y_m, FLAGS_vis_offset_z_m) {}
+          FLAGS_vis_offset_x_m, FLAGS_vis_offset_y_m, FLAGS_vis_offset_z_m),
+      has_landmark_decimation_override_(false),
+      landmark_voxel_size_m_(0.0),
+      max_num_landmarks_(0u) {}
+
+void ViwlsGraphRvizPlotter::setLandmarkDecimation(
+    const double voxel_size_m, const size_t max_num_landmarks) {
+  CHECK_GE(voxel_size_m, 0.0);
+  has_landmark_decimation_override_ = true;
+  landmark_voxel_size_m_ = voxel_size_m;
+  max_num_landmarks_ = max_num_landmarks;
+}
+
+void ViwlsGraphRvizPlotter::decimateLandmarks(
+    visualization::SphereVector* spheres) const {
+  CHECK_NOTNULL(spheres);
+  if (has_landmark_decimation_override_) {
+    decimateLandmarkSpheres(
+        landmark_voxel_size_m_, max_num_landmarks_, spheres);
+  } else {
+    decimateLandmarkSpheres(
+        FLAGS_vis_landmark_voxel_size_m, FLAGS_vis_max_num_primitives,
+        spheres);
+  }
+}
 
 void ViwlsGraphRvizPlotter::publishEdges(
     const vi_map::VIMap& map, const vi_map::MissionIdList& missions) const {
@@ -175,12 +343,26 @@ void ViwlsGraphRvizPlotter::publishEdges(
       GetPalette(visualization::Palette::PaletteTypes::kFalseColor1);
   visualization::Color local_color = color;
 
-  for (const pose_graph::EdgeId& edge_id : edges) {
+  // Chained edges are decimated by replacing them with one edge from the
+  // first to the last vertex of the chain.
+  const size_t stride = getDecimationStride(edges.size());
+  for (size_t edge_idx = 0u; edge_idx < edges.size(); edge_idx += stride) {
     const pose_graph::Edge* edge_ptr =
-        map.getEdgePtrAs<pose_graph::Edge>(edge_id);
+        map.getEdgePtrAs<pose_graph::Edge>(edges[edge_idx]);
+    pose_graph::VertexId to_vertex_id = edge_ptr->to();
+    const size_t end_idx = std::min(edge_idx + stride, edges.size());
+    for (size_t next_edge_idx = edge_idx + 1u; next_edge_idx < end_idx;
+         ++next_edge_idx) {
+      const pose_graph::Edge& next_edge =
+          map.getEdgeAs<pose_graph::Edge>(edges[next_edge_idx]);
+      if (next_edge.from() != to_vertex_id) {
+        break;
+      }
+      to_vertex_id = next_edge.to();
+    }
 
     const vi_map::Vertex& vertex_from = map.getVertex(edge_ptr->from());
-    const vi_map::Vertex& vertex_to = map.getVertex(edge_ptr->to());
+    const vi_map::Vertex& vertex_to = map.getVertex(to_vertex_id);
 
     const Eigen::Vector3d& M_p_I_from = vertex_from.get_p_M_I() - origin_;
     const Eigen::Vector3d& M_p_I_to = vertex_to.get_p_M_I() - origin_;
@@ -255,16 +437,52 @@ void ViwlsGraphRvizPlotter::publishEdges(
     line_segments.push_back(line_segment);
   }
 
-  if (!line_segments.empty()) {
-    visualization::publishLines(
-        line_segments, marker_id, visualization::kDefaultMapFrame,
-        visualization::kDefaultNamespace, kEdgeTopic + '/' + topic_extension);
+  // Every chunk is a separate marker.
+  const std::string edge_topic = kEdgeTopic + '/' + topic_extension;
+  const size_t num_edge_chunks =
+      publishInChunks<visualization::LineSegmentVector>(
+          line_segments, [&](const visualization::LineSegmentVector& chunk,
+                             const size_t chunk_idx) {
+            visualization::publishLines(
+                chunk, marker_id + chunk_idx, visualization::kDefaultMapFrame,
+                visualization::kDefaultNamespace, edge_topic);
+          });
+  clearStaleLineChunks(edge_topic, marker_id, num_edge_chunks);
+
+  const std::string lc_transformation_topic =
+      kEdgeTopic + "/loop_closure_transformations";
+  const size_t num_lc_transformation_chunks =
+      publishInChunks<visualization::LineSegmentVector>(
+          lc_transformation_line_segments,
+          [&](const visualization::LineSegmentVector& chunk,
+              const size_t chunk_idx) {
+            visualization::publishLines(
+                chunk, marker_id + chunk_idx, visualization::kDefaultMapFrame,
+                visualization::kDefaultNamespace, lc_transformation_topic);
+          });
+  clearStaleLineChunks(
+      lc_transformation_topic, marker_id, num_lc_transformation_chunks);
+}
+
+void ViwlsGraphRvizPlotter::clearStaleLineChunks(
+    const std::string& topic, const size_t marker_id,
+    const size_t num_chunks) const {
+  size_t num_previous_chunks;
+  {
+    std::lock_guard<std::mutex> lock(published_state_mutex_);
+    size_t& num_published_chunks =
+        num_published_line_chunks_[topic + '/' + std::to_string(marker_id)];
+    num_previous_chunks = num_published_chunks;
+    num_published_chunks = num_chunks;
   }
-  if (!lc_transformation_line_segments.empty()) {
+  // An empty line list replaces the marker of a chunk that is not needed
+  // anymore.
+  for (size_t chunk_idx = num_chunks; chunk_idx < num_previous_chunks;
+       ++chunk_idx) {
     visualization::publishLines(
-        lc_transformation_line_segments, marker_id,
+        visualization::LineSegmentVector(), marker_id + chunk_idx,
         visualization::kDefaultMapFrame, visualization::kDefaultNamespace,
-        kEdgeTopic + "/loop_closure_transformations");
+        topic);
   }
 }
 
@@ -283,7 +501,10 @@ void ViwlsGraphRvizPlotter::publishVertices(
 void ViwlsGraphRvizPlotter::publishVertices(
     const vi_map::VIMap& map, const pose_graph::VertexIdList& vertices) const {
   visualization::PoseVector poses;
-  for (const pose_graph::VertexId& vertex_id : vertices) {
+  const size_t stride = getDecimationStride(vertices.size());
+  for (size_t vertex_idx = 0u; vertex_idx < vertices.size();
+       vertex_idx += stride) {
+    const pose_graph::VertexId& vertex_id = vertices[vertex_idx];
     const vi_map::Vertex& vertex = map.getVertex(vertex_id);
 
     const Eigen::Vector3d M_p_I = vertex.get_p_M_I();
@@ -308,8 +529,11 @@ void ViwlsGraphRvizPlotter::publishVertices(
   }
 
   const std::string& kNamespace = "vertices";
-  visualization::publishVerticesFromPoseVector(
-      poses, visualization::kDefaultMapFrame, kNamespace, kVertexTopic);
+  publishInChunks<visualization::PoseVector>(
+      poses, [&](const visualization::PoseVector& chunk, const size_t) {
+        visualization::publishVerticesFromPoseVector(
+            chunk, visualization::kDefaultMapFrame, kNamespace, kVertexTopic);
+      });
 }
 
 void ViwlsGraphRvizPlotter::publishBaseFrames(
@@ -353,6 +577,7 @@ void ViwlsGraphRvizPlotter::publishLandmarks(
     const vi_map::VIMap& map, const vi_map::MissionIdList& missions) const {
   visualization::SphereVector spheres;
   appendLandmarksToSphereVector(map, missions, &spheres);
+  decimateLandmarks(&spheres);
 
   visualization::publishSpheresAsPointCloud(
       spheres, visualization::kDefaultMapFrame, kLandmarkTopic);
@@ -809,29 +1034,67 @@ void ViwlsGraphRvizPlotter::visualizeMissions(
     return;
   }
 
+  const bool publish_only_changed_missions =
+      FLAGS_vis_publish_only_changed_missions;
+  if (!publish_only_changed_missions) {
+    resetPublishedMissions();
+  }
+  const size_t settings_signature = getVisualizationSettingsSignature();
+
+  std::vector<MissionSignatures> signatures(mission_ids.size());
+  std::vector<unsigned char> are_landmarks_changed(mission_ids.size(), 1u);
   Aligned<std::vector, visualization::SphereVector> mission_spheres(
       mission_ids.size());
 
-  // For memory saving reasons we publish one mission at a time.
+  // For memory saving reasons we publish one mission at a time. Parts of a
+  // mission that didn't change since they were last published are skipped.
   std::function<void(const std::vector<size_t>&)> visualizer =
       [&, this](const std::vector<size_t>& batch) {
         for (size_t item : batch) {
           const vi_map::MissionId& mission_id = mission_ids[item];
-          if (publish_baseframes) {
+          computeMissionSignatures(
+              map, mission_id, settings_signature, &signatures[item]);
+          MissionSignatures published;
+          if (publish_only_changed_missions) {
+            std::lock_guard<std::mutex> lock(published_state_mutex_);
+            const std::unordered_map<vi_map::MissionId,
+                                     MissionSignatures>::const_iterator it =
+                published_missions_.find(mission_id);
+            if (it != published_missions_.end()) {
+              published = it->second;
+            }
+          }
+
+          if (publish_baseframes &&
+              published.baseframe != signatures[item].baseframe) {
             publishBaseFrames(map, {mission_id});
+            published.baseframe = signatures[item].baseframe;
           }
-          if (publish_vertices) {
+          if (publish_vertices &&
+              published.vertices != signatures[item].vertices) {
             publishVertices(map, {mission_id});
+            published.vertices = signatures[item].vertices;
           }
-          if (publish_edges) {
+          if (publish_edges && published.edges != signatures[item].edges) {
             publishEdges(map, {mission_id});
+            published.edges = signatures[item].edges;
           }
           if (publish_landmarks) {
             // The landmarks have to be published together since rviz displays
-            // just
-            // one point cloud at a time.
-            appendLandmarksToSphereVector(
-                map, {mission_id}, &mission_spheres[item]);
+            // just one point cloud at a time, only the spheres of the changed
+            // missions are recomputed.
+            are_landmarks_changed[item] =
+                published.landmarks != signatures[item].landmarks;
+            if (are_landmarks_changed[item]) {
+              appendLandmarksToSphereVector(
+                  map, {mission_id}, &mission_spheres[item]);
+              published.landmarks = signatures[item].landmarks;
+            }
+          }
+
+          if (publish_only_changed_missions) {
+            std::lock_guard<std::mutex> lock(published_state_mutex_);
+            published_missions_[mission_id] = published;
           }
         }
       };
@@ -841,14 +1104,112 @@ void ViwlsGraphRvizPlotter::visualizeMissions(
   common::ParallelProcess(
       mission_ids.size(), visualizer, kAlwaysParallelize, num_threads);
 
+  if (!publish_landmarks) {
+    return;
+  }
+
+  // The point cloud only needs to be republished if the landmarks of one of
+  // the missions or the set of missions changed.
+  size_t landmark_cloud_signature = 0u;
+  for (const MissionSignatures& mission_signatures : signatures) {
+    combineHash(mission_signatures.landmarks, &landmark_cloud_signature);
+  }
+
   visualization::SphereVector all_spheres;
-  for (const visualization::SphereVector& spheres : mission_spheres) {
-    all_spheres.insert(all_spheres.end(), spheres.begin(), spheres.end());
+  {
+    std::lock_guard<std::mutex> lock(published_state_mutex_);
+    if (publish_only_changed_missions &&
+        landmark_cloud_signature == published_landmark_cloud_signature_) {
+      return;
+    }
+    for (size_t item = 0u; item < mission_ids.size(); ++item) {
+      const visualization::SphereVector* spheres = &mission_spheres[item];
+      if (publish_only_changed_missions) {
+        visualization::SphereVector& cached_spheres =
+            published_mission_spheres_[mission_ids[item]];
+        if (are_landmarks_changed[item]) {
+          cached_spheres.swap(mission_spheres[item]);
+        }
+        spheres = &cached_spheres;
+      }
+      all_spheres.insert(all_spheres.end(), spheres->begin(), spheres->end());
+    }
+    published_landmark_cloud_signature_ = landmark_cloud_signature;
   }
+  decimateLandmarks(&all_spheres);
   visualization::publishSpheresAsPointCloud(
       all_spheres, visualization::kDefaultMapFrame, kLandmarkTopic);
 }
 
+void ViwlsGraphRvizPlotter::resetPublishedMissions() const {
+  std::lock_guard<std::mutex> lock(published_state_mutex_);
+  published_missions_.clear();
+  published_mission_spheres_.clear();
+  published_landmark_cloud_signature_ = 0u;
+}
+
+void ViwlsGraphRvizPlotter::computeMissionSignatures(
+    const vi_map::VIMap& map, const vi_map::MissionId& mission_id,
+    const size_t settings_signature, MissionSignatures* signatures) const {
+  CHECK_NOTNULL(signatures);
+  const vi_map::MissionBaseFrame& baseframe =
+      map.getMissionBaseFrame(map.getMission(mission_id).getBaseFrameId());
+
+  size_t baseframe_signature = settings_signature;
+  combineHash(mission_id.hashToSizeT(), &baseframe_signature);
+  combineMatrixHash(baseframe.get_p_G_M(), &baseframe_signature);
+  combineMatrixHash(baseframe.get_q_G_M().coeffs(), &baseframe_signature);
+  combineHash(baseframe.is_T_G_M_known(), &baseframe_signature);
+
+  // The hashes of the vertices, landmarks and edges are summed up, such that
+  // the signatures don't depend on the iteration order of the map.
+  size_t vertices_hash_sum = 0u;
+  size_t landmarks_hash_sum = 0u;
+  pose_graph::VertexIdList vertex_ids;
+  map.getAllVertexIdsInMission(mission_id, &vertex_ids);
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    const vi_map::Vertex& vertex = map.getVertex(vertex_id);
+    size_t vertex_hash = vertex_id.hashToSizeT();
+    combineMatrixHash(vertex.get_p_M_I(), &vertex_hash);
+    combineMatrixHash(vertex.get_q_M_I().coeffs(), &vertex_hash);
+    vertices_hash_sum += vertex_hash;
+
+    for (const vi_map::Landmark& landmark : vertex.getLandmarks()) {
+      size_t landmark_hash = vertex_hash;
+      combineHash(landmark.id().hashToSizeT(), &landmark_hash);
+      combineMatrixHash(landmark.get_p_B(), &landmark_hash);
+      combineHash(static_cast<int>(landmark.getQuality()), &landmark_hash);
+      combineHash(landmark.numberOfObservations(), &landmark_hash);
+      landmarks_hash_sum += landmark_hash;
+    }
+  }
+
+  size_t edges_hash_sum = 0u;
+  pose_graph::EdgeIdList edge_ids;
+  map.getAllEdgeIdsInMissionAlongGraph(mission_id, &edge_ids);
+  for (const pose_graph::EdgeId& edge_id : edge_ids) {
+    const pose_graph::Edge& edge = map.getEdgeAs<pose_graph::Edge>(edge_id);
+    size_t edge_hash = edge_id.hashToSizeT();
+    combineHash(static_cast<int>(edge.getType()), &edge_hash);
+    if (edge.getType() == pose_graph::Edge::EdgeType::kLoopClosure) {
+      const vi_map::LoopClosureEdge& loop_closure_edge =
+          edge.getAs<vi_map::LoopClosureEdge>();
+      combineHash(loop_closure_edge.getSwitchVariable(), &edge_hash);
+      combineMatrixHash(
+          loop_closure_edge.getT_A_B().getPosition(), &edge_hash);
+    }
+    edges_hash_sum += edge_hash;
+  }
+
+  signatures->baseframe = baseframe_signature;
+  signatures->vertices = baseframe_signature;
+  combineHash(vertices_hash_sum, &signatures->vertices);
+  signatures->edges = signatures->vertices;
+  combineHash(edges_hash_sum, &signatures->edges);
+  signatures->landmarks = baseframe_signature;
+  combineHash(landmarks_hash_sum, &signatures->landmarks);
+}
+
 void ViwlsGraphRvizPlotter::plotSlidingWindowLocalizationResult(
     const aslam::Transformation& T_G_B, size_t marker_id) const {
   visualization::SphereVector spheres;